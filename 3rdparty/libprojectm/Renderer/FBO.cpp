@@ -88,7 +88,7 @@ return -1;
 }
 
 /** Creates new pbuffers */
-RenderTarget::RenderTarget(int texsize, int width, int height) : useFBO(false) {
+RenderTarget::RenderTarget(int texsize, int width, int height) : useFBO(false), outputFbo(0) {
 
    int mindim = 0;
    int origtexsize = 0;
@@ -245,7 +245,7 @@ void RenderTarget::unlock() {
       glCopyTexSubImage2D( GL_TEXTURE_2D,
                          0, 0, 0, 0, 0, 
                          this->texsize, this->texsize );
-      glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+      glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, this->outputFbo);
       return;
     }
 #endif
@@ -66,6 +66,9 @@ public:
   int useFBO;
   int renderToTexture;
 
+  /** Framebuffer to go back to once the frame is rendered */
+  GLuint outputFbo;
+
   ~RenderTarget();
 
   RenderTarget( int texsize, int width, int height );
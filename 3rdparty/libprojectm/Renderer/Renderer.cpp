@@ -109,8 +109,10 @@ void Renderer::ResetTextures()
 {
 	textureManager->Clear();
 
+	GLuint outputFbo = renderTarget->outputFbo;
 	delete (renderTarget);
 	renderTarget = new RenderTarget(texsize, vw, vh);
+	renderTarget->outputFbo = outputFbo;
 	reset(vw, vh);
 
 	textureManager->Preload();
@@ -238,7 +240,7 @@ void Renderer::Pass2(const Pipeline &pipeline, const PipelineContext &pipelineCo
 
 #ifdef USE_FBO
 	if (renderTarget->renderToTexture)
-		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, renderTarget->outputFbo);
 #endif
 }
 
@@ -387,6 +389,11 @@ Renderer::~Renderer()
 	//	std::cerr << "exiting destructor" << std::endl;
 }
 
+void Renderer::setOutputFramebuffer(GLuint fbo)
+{
+	renderTarget->outputFbo = fbo;
+}
+
 void Renderer::reset(int w, int h)
 {
 	aspect = (float) h / (float) w;
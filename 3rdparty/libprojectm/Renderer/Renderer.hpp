@@ -71,6 +71,7 @@ public:
   void RenderFrame(const Pipeline &pipeline, const PipelineContext &pipelineContext);
   void ResetTextures();
   void reset(int w, int h);
+  void setOutputFramebuffer(GLuint fbo);
   GLuint initRenderToTexture();
 
 
@@ -119,7 +119,7 @@ void projectM::projectM_resetTextures()
 
 
 projectM::projectM ( std::string config_file, int flags) :
-beatDetect ( 0 ), renderer ( 0 ),  _pcm(0), m_presetPos(0), m_flags(flags), _pipelineContext(new PipelineContext()), _pipelineContext2(new PipelineContext())
+beatDetect ( 0 ), renderer ( 0 ),  _pcm(0), m_presetPos(0), m_flags(flags), _pipelineContext(new PipelineContext()), _pipelineContext2(new PipelineContext()), _outputFramebuffer(0)
 {
     readConfig(config_file);
     projectM_reset();
@@ -128,7 +128,7 @@ beatDetect ( 0 ), renderer ( 0 ),  _pcm(0), m_presetPos(0), m_flags(flags), _pip
 }
 
 projectM::projectM(Settings settings, int flags):
-beatDetect ( 0 ), renderer ( 0 ),  _pcm(0), m_presetPos(0), m_flags(flags), _pipelineContext(new PipelineContext()), _pipelineContext2(new PipelineContext())
+beatDetect ( 0 ), renderer ( 0 ),  _pcm(0), m_presetPos(0), m_flags(flags), _pipelineContext(new PipelineContext()), _pipelineContext2(new PipelineContext()), _outputFramebuffer(0)
 {
     readSettings(settings);
     projectM_reset();
@@ -497,6 +497,7 @@ static void *thread_callback(void *prjm) {
         else mspf = 0;
 
         this->renderer = new Renderer ( width, height, gx, gy, texsize,  beatDetect, settings().presetURL, settings().titleFontURL, settings().menuFontURL );
+        this->renderer->setOutputFramebuffer(_outputFramebuffer);
 
         running = true;
 
@@ -917,6 +918,13 @@ void projectM::changeTextureSize(int size) {
                           _settings.meshX, _settings.meshY,
                           _settings.textureSize, beatDetect, _settings.presetURL,
                           _settings.titleFontURL, _settings.menuFontURL);
+  renderer->setOutputFramebuffer(_outputFramebuffer);
+}
+
+void projectM::setOutputFramebuffer(unsigned int fbo) {
+  _outputFramebuffer = fbo;
+  if (renderer)
+    renderer->setOutputFramebuffer(fbo);
 }
 
 void projectM::changePresetDuration(int seconds) {
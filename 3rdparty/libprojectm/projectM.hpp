@@ -156,6 +156,10 @@ public:
   void changeTextureSize(int size);
   void changePresetDuration(int seconds);
 
+  /// Sets the framebuffer object the final image is drawn into.  0 is the
+  /// window system's framebuffer.
+  void setOutputFramebuffer(unsigned int fbo);
+
 
   const Settings & settings() const {
 		return _settings;
@@ -318,6 +322,8 @@ private:
 
   Pipeline* currentPipe;
 
+  unsigned int _outputFramebuffer;
+
 void switchPreset(std::unique_ptr<Preset> & targetPreset);
 
 
@@ -62,16 +62,28 @@ CREATE TABLE device_%deviceid_songs (
   lyrics TEXT,
 
   originalyear INTEGER,
-  effective_originalyear INTEGER
+  effective_originalyear INTEGER,
+  duplicate_key INTEGER,
+
+  track_gain REAL,
+  track_peak REAL,
+  album_gain REAL,
+  album_peak REAL,
+
+  artist_sort_key TEXT,
+  albumartist_sort_key TEXT,
+  album_sort_key TEXT
 );
 
 CREATE INDEX idx_device_%deviceid_songs_album ON device_%deviceid_songs (album);
 
 CREATE INDEX idx_device_%deviceid_songs_comp_artist ON device_%deviceid_songs (effective_compilation, artist);
 
-CREATE VIRTUAL TABLE device_%deviceid_fts USING fts3(
-  ftstitle, ftsalbum, ftsartist, ftsalbumartist, ftscomposer, ftsperformer, ftsgrouping, ftsgenre, ftscomment, ftsyear
-  tokenize=unicode
+CREATE INDEX idx_device_%deviceid_songs_artist_album ON device_%deviceid_songs (artist, album, effective_compilation, unavailable);
+
+CREATE VIRTUAL TABLE device_%deviceid_fts USING fts5(
+  ftstitle, ftsalbum, ftsartist, ftsalbumartist, ftscomposer, ftsperformer, ftsgrouping, ftsgenre, ftscomment, ftsyear,
+  tokenize=unicode, prefix='1 2 3'
 );
 
 UPDATE devices SET schema_version=0 WHERE ROWID=%deviceid;
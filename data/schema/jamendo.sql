@@ -1,6 +1,7 @@
 /* Schema should be kept identical to the "songs" table, even though most of
-   it isn't used by jamendo */
-CREATE TABLE jamendo.songs (
+   it isn't used by jamendo.  Jamendo's own database and the main one that
+   attaches it can both find it empty and create these. */
+CREATE TABLE IF NOT EXISTS jamendo.songs (
   title TEXT,
   album TEXT,
   artist TEXT,
@@ -49,20 +50,30 @@ CREATE TABLE jamendo.songs (
   lyrics TEXT,
 
   originalyear INTEGER,
-  effective_originalyear INTEGER
+  effective_originalyear INTEGER,
+  duplicate_key INTEGER,
+
+  track_gain REAL,
+  track_peak REAL,
+  album_gain REAL,
+  album_peak REAL,
+
+  artist_sort_key TEXT,
+  albumartist_sort_key TEXT,
+  album_sort_key TEXT
 );
 
-CREATE VIRTUAL TABLE jamendo.songs_fts USING fts3(
+CREATE VIRTUAL TABLE IF NOT EXISTS jamendo.songs_fts USING fts5(
   ftstitle, ftsalbum, ftsartist, ftsalbumartist, ftscomposer, ftsperformer, ftsgrouping, ftsgenre, ftscomment, ftsyear,
-  tokenize=unicode
+  tokenize=unicode, prefix='1 2 3'
 );
 
-CREATE INDEX jamendo.idx_jamendo_comp_artist ON songs (effective_compilation, artist);
+CREATE INDEX IF NOT EXISTS jamendo.idx_jamendo_comp_artist ON songs (effective_compilation, artist);
 
-CREATE TABLE jamendo.track_ids (
+CREATE TABLE IF NOT EXISTS jamendo.track_ids (
   songs_row_id INTEGER PRIMARY KEY,
   track_id INTEGER
 );
 
-CREATE INDEX jamendo.idx_jamendo_track_id ON track_ids(track_id);
+CREATE INDEX IF NOT EXISTS jamendo.idx_jamendo_track_id ON track_ids(track_id);
 
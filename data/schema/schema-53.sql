@@ -0,0 +1,15 @@
+ALTER TABLE %allsongstables ADD COLUMN duplicate_key INTEGER;
+
+CREATE INDEX idx_songs_duplicate_key ON songs (duplicate_key);
+
+DROP VIEW duplicated_songs;
+
+CREATE VIEW duplicated_songs as
+select duplicate_key dup_key
+  from songs
+ where duplicate_key != 0
+   and unavailable = 0
+ group by duplicate_key
+having count(*) > 1;
+
+UPDATE schema_version SET version=53;
@@ -0,0 +1,15 @@
+CREATE INDEX idx_artist_album ON songs (artist, album, effective_compilation, unavailable);
+
+CREATE INDEX idx_albumartist_album ON songs (effective_albumartist, album, unavailable);
+
+CREATE INDEX idx_genre_artist_album ON songs (genre, artist, album, effective_compilation, unavailable);
+
+CREATE INDEX idx_year_album ON songs (year, album, grouping, unavailable);
+
+CREATE INDEX idx_composer_album ON songs (composer, album, unavailable);
+
+DROP INDEX idx_album;
+
+CREATE INDEX idx_album ON songs (album, unavailable);
+
+UPDATE schema_version SET version=55;
\ No newline at end of file
@@ -0,0 +1,5 @@
+ALTER TABLE podcasts ADD COLUMN etag TEXT;
+
+ALTER TABLE podcasts ADD COLUMN last_modified TEXT;
+
+UPDATE schema_version SET version=56;
@@ -0,0 +1,9 @@
+ALTER TABLE %allsongstables ADD COLUMN track_gain REAL;
+
+ALTER TABLE %allsongstables ADD COLUMN track_peak REAL;
+
+ALTER TABLE %allsongstables ADD COLUMN album_gain REAL;
+
+ALTER TABLE %allsongstables ADD COLUMN album_peak REAL;
+
+UPDATE schema_version SET version=57;
@@ -0,0 +1,3 @@
+ALTER TABLE devices ADD COLUMN listing_key TEXT;
+
+UPDATE schema_version SET version=58;
@@ -0,0 +1,36 @@
+CREATE TABLE library_export_version (
+  version INTEGER NOT NULL
+);
+
+INSERT INTO library_export_version (version) VALUES (0);
+
+CREATE TABLE songs_export_log (
+  song_id INTEGER PRIMARY KEY,
+  version INTEGER NOT NULL,
+  deleted INTEGER NOT NULL DEFAULT 0
+);
+
+CREATE INDEX idx_songs_export_log_version ON songs_export_log (version);
+
+CREATE TRIGGER songs_export_insert AFTER INSERT ON songs
+BEGIN
+  UPDATE library_export_version SET version = version + 1;
+  INSERT OR REPLACE INTO songs_export_log (song_id, version, deleted)
+    SELECT new.ROWID, version, 0 FROM library_export_version;
+END;
+
+CREATE TRIGGER songs_export_update AFTER UPDATE ON songs
+BEGIN
+  UPDATE library_export_version SET version = version + 1;
+  INSERT OR REPLACE INTO songs_export_log (song_id, version, deleted)
+    SELECT new.ROWID, version, 0 FROM library_export_version;
+END;
+
+CREATE TRIGGER songs_export_delete AFTER DELETE ON songs
+BEGIN
+  UPDATE library_export_version SET version = version + 1;
+  INSERT OR REPLACE INTO songs_export_log (song_id, version, deleted)
+    SELECT old.ROWID, version, 1 FROM library_export_version;
+END;
+
+UPDATE schema_version SET version=59;
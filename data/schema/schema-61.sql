@@ -0,0 +1,14 @@
+CREATE TABLE lastfm_scrobble_queue (
+  username TEXT NOT NULL,
+  artist TEXT NOT NULL,
+  album_artist TEXT,
+  album TEXT,
+  title TEXT NOT NULL,
+  track INTEGER,
+  length INTEGER,
+  timestamp INTEGER NOT NULL
+);
+
+CREATE INDEX idx_lastfm_scrobble_queue_username ON lastfm_scrobble_queue (username, timestamp);
+
+UPDATE schema_version SET version=61;
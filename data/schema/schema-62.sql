@@ -0,0 +1,13 @@
+ALTER TABLE %allsongstables ADD COLUMN artist_sort_key TEXT;
+
+ALTER TABLE %allsongstables ADD COLUMN albumartist_sort_key TEXT;
+
+ALTER TABLE %allsongstables ADD COLUMN album_sort_key TEXT;
+
+CREATE INDEX idx_artist_sort_key ON songs (artist_sort_key, artist, effective_compilation, unavailable);
+
+CREATE INDEX idx_albumartist_sort_key ON songs (albumartist_sort_key, effective_albumartist, unavailable);
+
+CREATE INDEX idx_album_sort_key ON songs (album_sort_key, album, unavailable);
+
+UPDATE schema_version SET version=62;
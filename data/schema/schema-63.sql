@@ -0,0 +1,7 @@
+CREATE TABLE acoustic_fingerprints (
+  song_id INTEGER PRIMARY KEY,
+  mtime INTEGER NOT NULL,
+  fingerprint BLOB NOT NULL
+);
+
+UPDATE schema_version SET version=63;
@@ -0,0 +1,106 @@
+ALTER TABLE playlists ADD COLUMN item_count INTEGER NOT NULL DEFAULT 0;
+
+ALTER TABLE playlists ADD COLUMN length_nanosec INTEGER NOT NULL DEFAULT 0;
+
+UPDATE playlists SET
+  item_count = (SELECT COUNT(*) FROM playlist_items AS p
+                WHERE p.playlist = playlists.ROWID),
+  length_nanosec = IFNULL((
+    SELECT SUM(MAX(0, IFNULL(CASE WHEN p.type = 'Library' THEN songs.length
+                                  ELSE p.length END, 0)))
+    FROM playlist_items AS p
+    LEFT JOIN songs ON p.type = 'Library' AND p.library_id = songs.ROWID
+    WHERE p.playlist = playlists.ROWID), 0);
+
+CREATE TRIGGER playlist_items_summary_insert AFTER INSERT ON playlist_items
+BEGIN
+  UPDATE playlists SET
+    item_count = item_count + 1,
+    length_nanosec = length_nanosec + MAX(0, IFNULL(
+      CASE WHEN NEW.type = 'Library'
+           THEN (SELECT length FROM songs WHERE ROWID = NEW.library_id)
+           ELSE NEW.length END, 0))
+  WHERE ROWID = NEW.playlist;
+END;
+
+CREATE TRIGGER playlist_items_summary_delete AFTER DELETE ON playlist_items
+BEGIN
+  UPDATE playlists SET
+    item_count = item_count - 1,
+    length_nanosec = length_nanosec - MAX(0, IFNULL(
+      CASE WHEN OLD.type = 'Library'
+           THEN (SELECT length FROM songs WHERE ROWID = OLD.library_id)
+           ELSE OLD.length END, 0))
+  WHERE ROWID = OLD.playlist;
+END;
+
+CREATE TRIGGER playlist_items_summary_update
+AFTER UPDATE OF type, library_id, length ON playlist_items
+BEGIN
+  UPDATE playlists SET
+    length_nanosec = length_nanosec
+      - MAX(0, IFNULL(
+          CASE WHEN OLD.type = 'Library'
+               THEN (SELECT length FROM songs WHERE ROWID = OLD.library_id)
+               ELSE OLD.length END, 0))
+      + MAX(0, IFNULL(
+          CASE WHEN NEW.type = 'Library'
+               THEN (SELECT length FROM songs WHERE ROWID = NEW.library_id)
+               ELSE NEW.length END, 0))
+  WHERE ROWID = NEW.playlist;
+END;
+
+DELETE FROM playlist_items_fts;
+
+INSERT INTO playlist_items_fts (ROWID, ftstitle, ftsalbum, ftsartist,
+    ftsalbumartist, ftscomposer, ftsperformer, ftsgrouping, ftsgenre,
+    ftscomment, ftsyear)
+  SELECT p.ROWID, IFNULL(songs.title, p.title), IFNULL(songs.album, p.album),
+      IFNULL(songs.artist, p.artist), IFNULL(songs.albumartist, p.albumartist),
+      IFNULL(songs.composer, p.composer), IFNULL(songs.performer, p.performer),
+      IFNULL(songs.grouping, p.grouping), IFNULL(songs.genre, p.genre),
+      IFNULL(songs.comment, p.comment), IFNULL(songs.year, p.year)
+  FROM playlist_items AS p
+  LEFT JOIN songs ON p.type = 'Library' AND p.library_id = songs.ROWID;
+
+CREATE TRIGGER playlist_items_fts_insert AFTER INSERT ON playlist_items
+BEGIN
+  INSERT INTO playlist_items_fts (ROWID, ftstitle, ftsalbum, ftsartist,
+      ftsalbumartist, ftscomposer, ftsperformer, ftsgrouping, ftsgenre,
+      ftscomment, ftsyear)
+    SELECT NEW.ROWID, IFNULL(songs.title, NEW.title),
+        IFNULL(songs.album, NEW.album), IFNULL(songs.artist, NEW.artist),
+        IFNULL(songs.albumartist, NEW.albumartist),
+        IFNULL(songs.composer, NEW.composer),
+        IFNULL(songs.performer, NEW.performer),
+        IFNULL(songs.grouping, NEW.grouping), IFNULL(songs.genre, NEW.genre),
+        IFNULL(songs.comment, NEW.comment), IFNULL(songs.year, NEW.year)
+    FROM (SELECT 1)
+    LEFT JOIN songs ON NEW.type = 'Library' AND NEW.library_id = songs.ROWID;
+END;
+
+CREATE TRIGGER playlist_items_fts_delete AFTER DELETE ON playlist_items
+BEGIN
+  DELETE FROM playlist_items_fts WHERE ROWID = OLD.ROWID;
+END;
+
+CREATE TRIGGER playlist_items_fts_update
+AFTER UPDATE OF type, library_id, title, album, artist, albumartist, composer,
+    performer, grouping, genre, comment, year ON playlist_items
+BEGIN
+  DELETE FROM playlist_items_fts WHERE ROWID = OLD.ROWID;
+  INSERT INTO playlist_items_fts (ROWID, ftstitle, ftsalbum, ftsartist,
+      ftsalbumartist, ftscomposer, ftsperformer, ftsgrouping, ftsgenre,
+      ftscomment, ftsyear)
+    SELECT NEW.ROWID, IFNULL(songs.title, NEW.title),
+        IFNULL(songs.album, NEW.album), IFNULL(songs.artist, NEW.artist),
+        IFNULL(songs.albumartist, NEW.albumartist),
+        IFNULL(songs.composer, NEW.composer),
+        IFNULL(songs.performer, NEW.performer),
+        IFNULL(songs.grouping, NEW.grouping), IFNULL(songs.genre, NEW.genre),
+        IFNULL(songs.comment, NEW.comment), IFNULL(songs.year, NEW.year)
+    FROM (SELECT 1)
+    LEFT JOIN songs ON NEW.type = 'Library' AND NEW.library_id = songs.ROWID;
+END;
+
+UPDATE schema_version SET version=64;
@@ -24,6 +24,8 @@
 
 #include <cstring>
 
+const int MediaPipeline::kBufferDurationMsec = 100;
+
 MediaPipeline::MediaPipeline(int port, quint64 length_msec)
     : port_(port),
       length_msec_(length_msec),
@@ -31,13 +33,25 @@ MediaPipeline::MediaPipeline(int port, quint64 length_msec)
       pipeline_(nullptr),
       appsrc_(nullptr),
       byte_rate_(1),
-      offset_bytes_(0) {}
+      offset_bytes_(0),
+      pool_(nullptr),
+      buffer_size_(0),
+      pending_(nullptr),
+      pending_bytes_(0) {}
 
 MediaPipeline::~MediaPipeline() {
+  if (pending_) {
+    gst_buffer_unmap(pending_, &pending_map_);
+    gst_buffer_unref(pending_);
+  }
   if (pipeline_) {
     gst_element_set_state(pipeline_, GST_STATE_NULL);
     gst_object_unref(GST_OBJECT(pipeline_));
   }
+  if (pool_) {
+    gst_buffer_pool_set_active(pool_, FALSE);
+    gst_object_unref(GST_OBJECT(pool_));
+  }
 }
 
 bool MediaPipeline::Init(int sample_rate, int channels) {
@@ -112,13 +126,31 @@ bool MediaPipeline::Init(int sample_rate, int channels) {
       "interleaved", nullptr);
 
   gst_app_src_set_caps(appsrc_, caps);
-  gst_caps_unref(caps);
 
   // Set size
   byte_rate_ = quint64(sample_rate) * channels * 2;
   const quint64 bytes = byte_rate_ * length_msec_ / 1000;
   gst_app_src_set_size(appsrc_, bytes);
 
+  // Whole frames only, so every buffer's timestamp lands on a sample.
+  const int frame_size = channels * 2;
+  buffer_size_ = byte_rate_ * kBufferDurationMsec / 1000;
+  buffer_size_ =
+      qMax(gsize(frame_size), buffer_size_ / frame_size * frame_size);
+
+  pool_ = gst_buffer_pool_new();
+  GstStructure* config = gst_buffer_pool_get_config(pool_);
+  gst_buffer_pool_config_set_params(config, caps, buffer_size_, 4, 0);
+  if (!gst_buffer_pool_set_config(pool_, config) ||
+      !gst_buffer_pool_set_active(pool_, TRUE)) {
+    qLog(Warning) << "Couldn't set up a buffer pool, allocating buffers as "
+                     "they're needed";
+    gst_object_unref(GST_OBJECT(pool_));
+    pool_ = nullptr;
+  }
+
+  gst_caps_unref(caps);
+
   // Ready to go
   return gst_element_set_state(pipeline_, GST_STATE_PLAYING) !=
          GST_STATE_CHANGE_FAILURE;
@@ -127,25 +159,63 @@ bool MediaPipeline::Init(int sample_rate, int channels) {
 void MediaPipeline::WriteData(const char* data, qint64 length) {
   if (!is_initialised()) return;
 
-  GstBuffer* buffer = gst_buffer_new_allocate(nullptr, length, nullptr);
-  GstMapInfo map_info;
-  gst_buffer_map(buffer, &map_info, GST_MAP_WRITE);
+  while (length > 0) {
+    if (!pending_ && !StartBuffer()) return;
 
-  memcpy(map_info.data, data, length);
+    const gsize count = qMin(gsize(length), buffer_size_ - pending_bytes_);
+    memcpy(pending_map_.data + pending_bytes_, data, count);
+    pending_bytes_ += count;
+    data += count;
+    length -= count;
 
-  gst_buffer_unmap(buffer, &map_info);
+    if (pending_bytes_ == buffer_size_) PushBuffer();
+  }
+}
 
-  GST_BUFFER_PTS(buffer) = offset_bytes_ * kNsecPerSec / byte_rate_;
-  GST_BUFFER_DURATION(buffer) = length * kNsecPerSec / byte_rate_;
+bool MediaPipeline::StartBuffer() {
+  pending_ = nullptr;
+  if (pool_) {
+    gst_buffer_pool_acquire_buffer(pool_, &pending_, nullptr);
+  }
+  if (!pending_) {
+    pending_ = gst_buffer_new_allocate(nullptr, buffer_size_, nullptr);
+    if (!pending_) return false;
+  }
+
+  gst_buffer_map(pending_, &pending_map_, GST_MAP_WRITE);
+  pending_bytes_ = 0;
+  return true;
+}
+
+void MediaPipeline::PushBuffer() {
+  gst_buffer_unmap(pending_, &pending_map_);
+  // The pool puts the size back when the buffer is returned to it.
+  gst_buffer_set_size(pending_, pending_bytes_);
 
-  offset_bytes_ += length;
+  GST_BUFFER_PTS(pending_) = offset_bytes_ * kNsecPerSec / byte_rate_;
+  GST_BUFFER_DURATION(pending_) = pending_bytes_ * kNsecPerSec / byte_rate_;
 
-  gst_app_src_push_buffer(appsrc_, buffer);
+  offset_bytes_ += pending_bytes_;
+
+  // appsrc takes ownership of the buffer.
+  gst_app_src_push_buffer(appsrc_, pending_);
+  pending_ = nullptr;
+  pending_bytes_ = 0;
 }
 
 void MediaPipeline::EndStream() {
   if (!is_initialised()) return;
 
+  if (pending_) {
+    if (pending_bytes_ > 0) {
+      PushBuffer();
+    } else {
+      gst_buffer_unmap(pending_, &pending_map_);
+      gst_buffer_unref(pending_);
+      pending_ = nullptr;
+    }
+  }
+
   gst_app_src_end_of_stream(appsrc_);
 }
 
@@ -35,10 +35,20 @@ class MediaPipeline {
   bool is_accepting_data() const { return accepting_data_; }
   bool Init(int sample_rate, int channels);
 
+  // Copies the data into the buffer currently being filled.  Full buffers
+  // are pushed to the pipeline.
   void WriteData(const char* data, qint64 length);
   void EndStream();
 
  private:
+  // Buffers are pushed once they hold this much audio, so the gdp header and
+  // the socket write are paid for every 100ms of audio rather than for every
+  // callback from libspotify.
+  static const int kBufferDurationMsec;
+
+  bool StartBuffer();
+  void PushBuffer();
+
   static void NeedDataCallback(GstAppSrc* src, guint length, void* data);
   static void EnoughDataCallback(GstAppSrc* src, void* data);
   static gboolean SeekDataCallback(GstAppSrc* src, guint64 offset, void* data);
@@ -57,6 +67,16 @@ class MediaPipeline {
 
   quint64 byte_rate_;
   quint64 offset_bytes_;
+
+  // Buffers are reused once the pipeline has finished with them, instead of
+  // allocating a new one for every write.
+  GstBufferPool* pool_;
+  gsize buffer_size_;
+
+  // The buffer being filled, and how much of it has been written.
+  GstBuffer* pending_;
+  GstMapInfo pending_map_;
+  gsize pending_bytes_;
 };
 
 #endif  // MEDIAPIPELINE_H
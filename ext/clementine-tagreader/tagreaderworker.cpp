@@ -17,6 +17,8 @@
 
 #include "tagreaderworker.h"
 
+#include <functional>
+
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QFileInfo>
@@ -24,8 +26,21 @@
 #include <QTextCodec>
 #include <QUrl>
 
+#include "core/closure.h"
+#include "core/concurrentrun.h"
+
+#ifdef HAVE_GOOGLE_DRIVE
+const int TagReaderWorker::kMaxParallelCloudReads = 4;
+#endif
+
 TagReaderWorker::TagReaderWorker(QIODevice* socket, QObject* parent)
-    : AbstractMessageHandler<pb::tagreader::Message>(socket, parent) {}
+    : AbstractMessageHandler<pb::tagreader::Message>(socket, parent) {
+#ifdef HAVE_GOOGLE_DRIVE
+  cloud_thread_pool_.setMaxThreadCount(kMaxParallelCloudReads);
+  // Each thread keeps its connections to the service, so keep the threads.
+  cloud_thread_pool_.setExpiryTimeout(-1);
+#endif
+}
 
 void TagReaderWorker::MessageArrived(const pb::tagreader::Message& message) {
   pb::tagreader::Message reply;
@@ -41,7 +56,16 @@ void TagReaderWorker::MessageArrived(const pb::tagreader::Message& message) {
   if (message.has_read_file_request()) {
     tag_reader_.ReadFile(
         QStringFromStdString(message.read_file_request().filename()),
-        reply.mutable_read_file_response()->mutable_metadata());
+        reply.mutable_read_file_response()->mutable_metadata(),
+        message.read_file_request().mode());
+  } else if (message.has_read_files_request()) {
+    const pb::tagreader::ReadFilesRequest& req = message.read_files_request();
+    pb::tagreader::ReadFilesResponse* response =
+        reply.mutable_read_files_response();
+    for (const std::string& filename : req.filenames()) {
+      tag_reader_.ReadFile(QStringFromStdString(filename),
+                           response->add_metadata(), req.mode());
+    }
   } else if (message.has_save_file_request()) {
     reply.mutable_save_file_response()->set_success(tag_reader_.SaveFile(
         QStringFromStdString(message.save_file_request().filename()),
@@ -58,33 +82,68 @@ void TagReaderWorker::MessageArrived(const pb::tagreader::Message& message) {
             QStringFromStdString(
                 message.save_song_rating_to_file_request().filename()),
             message.save_song_rating_to_file_request().metadata()));
+  } else if (message.has_save_song_replaygain_to_file_request()) {
+    reply.mutable_save_song_replaygain_to_file_response()->set_success(
+        tag_reader_.SaveSongReplayGainToFile(
+            QStringFromStdString(
+                message.save_song_replaygain_to_file_request().filename()),
+            message.save_song_replaygain_to_file_request().metadata()));
   } else if (message.has_is_media_file_request()) {
     reply.mutable_is_media_file_response()->set_success(tag_reader_.IsMediaFile(
-        QStringFromStdString(message.is_media_file_request().filename())));
+        QStringFromStdString(message.is_media_file_request().filename()),
+        message.is_media_file_request().mode()));
   } else if (message.has_load_embedded_art_request()) {
-    QByteArray data = tag_reader_.LoadEmbeddedArt(
-        QStringFromStdString(message.load_embedded_art_request().filename()));
-    reply.mutable_load_embedded_art_response()->set_data(data.constData(),
-                                                         data.size());
+    const pb::tagreader::LoadEmbeddedArtRequest& req =
+        message.load_embedded_art_request();
+    pb::tagreader::LoadEmbeddedArtResponse* response =
+        reply.mutable_load_embedded_art_response();
+
+    QByteArray data =
+        tag_reader_.LoadEmbeddedArt(QStringFromStdString(req.filename()));
+    const QString shared_file = WriteSharedPayload(
+        QStringFromStdString(req.shared_payload_dir()), data);
+    if (!shared_file.isEmpty()) {
+      response->set_shared_payload_file(DataCommaSizeFromQString(shared_file));
+    } else {
+      response->set_data(data.constData(), data.size());
+    }
   } else if (message.has_read_cloud_file_request()) {
 #ifdef HAVE_GOOGLE_DRIVE
-    const pb::tagreader::ReadCloudFileRequest& req =
-        message.read_cloud_file_request();
-    if (!tag_reader_.ReadCloudFile(
-             QUrl::fromEncoded(QByteArray(req.download_url().data(),
-                                          req.download_url().size())),
-             QStringFromStdString(req.title()), req.size(),
-             QStringFromStdString(req.mime_type()),
-             QStringFromStdString(req.authorisation_header()),
-             reply.mutable_read_cloud_file_response()->mutable_metadata())) {
-      reply.mutable_read_cloud_file_response()->clear_metadata();
-    }
+    // Replied to when it finishes, which might be after later requests.
+    QFuture<pb::tagreader::Message> future =
+        ConcurrentRun::Run<pb::tagreader::Message>(
+            &cloud_thread_pool_,
+            std::bind(&TagReaderWorker::ReadCloudFile, this, message));
+    NewClosure(future, [this, message, future]() {
+      pb::tagreader::Message reply = future.result();
+      SendReply(message, &reply);
+    });
+    return;
 #endif
   }
 
   SendReply(message, &reply);
 }
 
+#ifdef HAVE_GOOGLE_DRIVE
+pb::tagreader::Message TagReaderWorker::ReadCloudFile(
+    const pb::tagreader::Message& message) {
+  pb::tagreader::Message reply;
+  const pb::tagreader::ReadCloudFileRequest& req =
+      message.read_cloud_file_request();
+  if (!tag_reader_.ReadCloudFile(
+           QUrl::fromEncoded(QByteArray(req.download_url().data(),
+                                        req.download_url().size())),
+           QStringFromStdString(req.title()), req.size(),
+           QStringFromStdString(req.mime_type()),
+           QStringFromStdString(req.authorisation_header()),
+           reply.mutable_read_cloud_file_response()->mutable_metadata())) {
+    reply.mutable_read_cloud_file_response()->clear_metadata();
+  }
+  return reply;
+}
+#endif
+
 void TagReaderWorker::DeviceClosed() {
   AbstractMessageHandler<pb::tagreader::Message>::DeviceClosed();
 
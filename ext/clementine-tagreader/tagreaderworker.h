@@ -23,6 +23,8 @@
 #include "tagreadermessages.pb.h"
 #include "core/messagehandler.h"
 
+#include <QThreadPool>
+
 class TagReaderWorker : public AbstractMessageHandler<pb::tagreader::Message> {
  public:
   TagReaderWorker(QIODevice* socket, QObject* parent = NULL);
@@ -32,6 +34,16 @@ class TagReaderWorker : public AbstractMessageHandler<pb::tagreader::Message> {
   void DeviceClosed();
 
  private:
+#ifdef HAVE_GOOGLE_DRIVE
+  // Cloud files spend most of their time waiting for the network, so several
+  // are read at once on cloud_thread_pool_.
+  static const int kMaxParallelCloudReads;
+
+  pb::tagreader::Message ReadCloudFile(const pb::tagreader::Message& message);
+
+  QThreadPool cloud_thread_pool_;
+#endif
+
   TagReader tag_reader_;
 };
 
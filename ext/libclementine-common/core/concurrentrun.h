@@ -51,18 +51,27 @@ class ThreadFunctorBase : public QFutureInterface<ReturnType>,
  public:
   ThreadFunctorBase() {}
 
-  QFuture<ReturnType> Start(QThreadPool* thread_pool) {
+  // Higher priority functors are started first when the pool is busy.
+  QFuture<ReturnType> Start(QThreadPool* thread_pool, int priority = 0) {
     this->setRunnable(this);
     this->reportStarted();
     Q_ASSERT(thread_pool);
     QFuture<ReturnType> future = this->future();
-    thread_pool->start(this, 0 /* priority: currently we do not support
-                                  changing the priority. Might be added later
-                                  if needed */);
+    thread_pool->start(this, priority);
     return future;
   }
 
-  virtual void run() = 0;
+  // Functors that were cancelled through their QFuture before a thread
+  // picked them up finish without running.
+  virtual void run() {
+    if (!this->isCanceled()) {
+      Call();
+    }
+    this->reportFinished();
+  }
+
+ protected:
+  virtual void Call() = 0;
 };
 
 template <typename ReturnType, typename... Args>
@@ -71,10 +80,8 @@ class ThreadFunctor : public ThreadFunctorBase<ReturnType> {
   ThreadFunctor(std::function<ReturnType(Args...)> function, Args... args)
       : function_(std::bind(function, args...)) {}
 
-  virtual void run() {
-    this->reportResult(function_());
-    this->reportFinished();
-  }
+ protected:
+  virtual void Call() { this->reportResult(function_()); }
 
  private:
   std::function<ReturnType()> function_;
@@ -87,10 +94,8 @@ class ThreadFunctor<void, Args...> : public ThreadFunctorBase<void> {
   ThreadFunctor(std::function<void(Args...)> function, Args... args)
       : function_(std::bind(function, args...)) {}
 
-  virtual void run() {
-    function_();
-    this->reportFinished();
-  }
+ protected:
+  virtual void Call() { function_(); }
 
  private:
   std::function<void()> function_;
@@ -25,13 +25,21 @@
 #include <execinfo.h>
 #endif
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include <QBuffer>
 #include <QCoreApplication>
 #include <QDateTime>
+#include <QHash>
 #include <QStringList>
+#include <QThreadStorage>
 #include <QtMessageHandler>
 #include <QTextStream>
 
@@ -41,6 +49,7 @@
 
 namespace logging {
 
+Level sMaxLevel = Level_Debug;
 static Level sDefaultLevel = Level_Debug;
 static QMap<QString, Level>* sClassLevels = nullptr;
 static QIODevice* sNullDevice = nullptr;
@@ -58,6 +67,208 @@ template <class T>
 static T CreateLogger(Level level, const QString& class_name, int line,
                       const char* category);
 
+namespace {
+
+// Lines start with the time they were logged as 16 hex digits of msecs since
+// the epoch.  Turning that into local time is left to the writer.
+const int kTimestampLength = 16;
+
+// Holds lines until the writer thread gets to them.  Any thread can push,
+// only the writer pops.  This is Dmitry Vyukov's bounded queue: each cell
+// has a sequence number that says whose turn it is, so neither side takes a
+// lock.
+class LineQueue {
+ public:
+  LineQueue() : enqueue_pos_(0), dequeue_pos_(0) {
+    for (size_t i = 0; i < kCapacity; ++i) {
+      cells_[i].sequence_.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns false if the queue is full.
+  bool Push(QByteArray&& line) {
+    Cell* cell = nullptr;
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    forever {
+      cell = &cells_[pos & (kCapacity - 1)];
+      const size_t seq = cell->sequence_.load(std::memory_order_acquire);
+      const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->line_ = std::move(line);
+    cell->sequence_.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Must only be called from the writer thread.
+  bool Pop(QByteArray* line) {
+    Cell* cell = &cells_[dequeue_pos_ & (kCapacity - 1)];
+    const size_t seq = cell->sequence_.load(std::memory_order_acquire);
+    if (intptr_t(seq) - intptr_t(dequeue_pos_ + 1) < 0) {
+      return false;
+    }
+
+    *line = std::move(cell->line_);
+    cell->line_ = QByteArray();
+    cell->sequence_.store(dequeue_pos_ + kCapacity, std::memory_order_release);
+    dequeue_pos_++;
+    return true;
+  }
+
+ private:
+  static const size_t kCapacity = 4096;  // Must be a power of two.
+
+  struct Cell {
+    std::atomic<size_t> sequence_;
+    QByteArray line_;
+  };
+
+  Cell cells_[kCapacity];
+  std::atomic<size_t> enqueue_pos_;
+  size_t dequeue_pos_;
+};
+
+// The last kRecentOutputSize bytes written, as a ring.
+const size_t kRecentOutputSize = 64 * 1024;
+char sRecentOutput[kRecentOutputSize];
+std::atomic<size_t> sRecentOutputWritten(0);
+
+class AsyncWriter {
+ public:
+  AsyncWriter() : pushed_(0), written_(0), sleeping_(false) {
+    std::thread(&AsyncWriter::Run, this).detach();
+  }
+
+  void Write(QByteArray line) {
+    if (!queue_.Push(std::move(line))) {
+      // The writer can't keep up.  Don't lose the line, write it here.
+      Output(line);
+      return;
+    }
+
+    pushed_++;
+    if (sleeping_.load()) {
+      wake_.notify_one();
+    }
+  }
+
+  void Flush() {
+    const quint64 target = pushed_.load();
+    wake_.notify_one();
+
+    // Don't hang forever if the writer is stuck on a blocked stderr.
+    for (int i = 0; i < 2000 && written_.load() < target; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  // Can be called from any thread.
+  void Output(const QByteArray& line) {
+    QByteArray out;
+    bool ok = false;
+    const qint64 msec = line.left(kTimestampLength).toLongLong(&ok, 16);
+    if (ok && line.size() >= kTimestampLength) {
+      out = QDateTime::fromMSecsSinceEpoch(msec)
+                .toString("hh:mm:ss.zzz")
+                .toLatin1();
+      out.append(line.constData() + kTimestampLength,
+                 line.size() - kTimestampLength);
+    } else {
+      out = line;
+    }
+    out.append('\n');
+
+    std::lock_guard<std::mutex> l(output_mutex_);
+    fwrite(out.constData(), 1, out.size(), stderr);
+
+    size_t written = sRecentOutputWritten.load(std::memory_order_relaxed);
+    for (char c : out) {
+      sRecentOutput[written++ % kRecentOutputSize] = c;
+    }
+    sRecentOutputWritten.store(written, std::memory_order_release);
+  }
+
+ private:
+  void Run() {
+    QByteArray line;
+    forever {
+      while (queue_.Pop(&line)) {
+        Output(line);
+        written_++;
+      }
+
+      std::unique_lock<std::mutex> l(wake_mutex_);
+      sleeping_ = true;
+      // A line pushed just before sleeping_ was set doesn't wake us, so
+      // don't sleep for long.
+      wake_.wait_for(l, std::chrono::milliseconds(50));
+      sleeping_ = false;
+    }
+  }
+
+  LineQueue queue_;
+  std::atomic<quint64> pushed_;
+  std::atomic<quint64> written_;
+
+  std::atomic<bool> sleeping_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+
+  std::mutex output_mutex_;
+};
+
+// Never deleted: the writer thread runs until the process exits, and lines
+// still in the queue are written by the atexit handler.
+std::atomic<AsyncWriter*> sWriter(nullptr);
+
+void FlushAtExit() { Flush(); }
+
+void WriteLine(QByteArray line) {
+  AsyncWriter* writer = sWriter.load();
+  if (writer) {
+    writer->Write(std::move(line));
+  } else {
+    fprintf(stderr, "%s\n", line.constData());
+  }
+}
+
+}  // namespace
+
+void Flush() {
+  AsyncWriter* writer = sWriter.load();
+  if (writer) {
+    writer->Flush();
+  }
+  fflush(stderr);
+}
+
+void GetRecentOutput(const char** first, size_t* first_size,
+                     const char** second, size_t* second_size) {
+  const size_t written = sRecentOutputWritten.load(std::memory_order_acquire);
+  if (written <= kRecentOutputSize) {
+    *first = sRecentOutput;
+    *first_size = written;
+    *second = nullptr;
+    *second_size = 0;
+  } else {
+    const size_t start = written % kRecentOutputSize;
+    *first = sRecentOutput + start;
+    *first_size = kRecentOutputSize - start;
+    *second = sRecentOutput;
+    *second_size = start;
+  }
+}
+
 void GLog(const char* domain, int level, const char* message, void* user_data) {
   switch (level) {
     case G_LOG_FLAG_RECURSION:
@@ -118,8 +329,12 @@ class LoggedDebug : public DebugBase<LoggedDebug> {
 };
 
 static void MessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message) {
-  if (strncmp(kMessageHandlerMagic, message.toLocal8Bit().data(), kMessageHandlerMagicLength) == 0) {
-    fprintf(stderr, "%s\n", message.toLocal8Bit().data() + kMessageHandlerMagicLength);
+  if (message.startsWith(QLatin1String(kMessageHandlerMagic))) {
+    WriteLine(message.mid(kMessageHandlerMagicLength).toLocal8Bit());
+    if (type == QtFatalMsg) {
+      // Qt aborts as soon as we return.
+      Flush();
+    }
     return;
   }
 
@@ -144,11 +359,12 @@ static void MessageHandler(QtMsgType type, const QMessageLogContext &context, co
     d << line.toLocal8Bit().constData();
     if (d.buf_) {
       d.buf_->close();
-      fprintf(stderr, "%s\n", d.buf_->buffer().data());
+      WriteLine(d.buf_->buffer());
     }
   }
 
   if (type == QtFatalMsg) {
+    Flush();
     abort();
   }
 }
@@ -165,6 +381,11 @@ void Init() {
   if (!sOriginalMessageHandler) {
     sOriginalMessageHandler = qInstallMessageHandler(MessageHandler);
   }
+
+  if (!sWriter.load()) {
+    sWriter = new AsyncWriter;
+    std::atexit(FlushAtExit);
+  }
 }
 
 void SetLevels(const QString& levels) {
@@ -194,6 +415,11 @@ void SetLevels(const QString& levels) {
       sClassLevels->insert(class_name, (Level)level);
     }
   }
+
+  sMaxLevel = sDefaultLevel;
+  for (Level level : *sClassLevels) {
+    sMaxLevel = qMax(sMaxLevel, level);
+  }
 }
 
 static QString ParsePrettyFunction(const char* pretty_function) {
@@ -217,6 +443,19 @@ static QString ParsePrettyFunction(const char* pretty_function) {
   return class_name;
 }
 
+static QString ClassNameForFunction(const char* pretty_function) {
+  // __PRETTY_FUNCTION__ is a string literal, so its address is enough to
+  // look it up by.
+  static QThreadStorage<QHash<const char*, QString>> sCache;
+  QHash<const char*, QString>& cache = sCache.localData();
+
+  auto it = cache.find(pretty_function);
+  if (it == cache.end()) {
+    it = cache.insert(pretty_function, ParsePrettyFunction(pretty_function));
+  }
+  return it.value();
+}
+
 template <class T>
 static T CreateLogger(Level level, const QString& class_name, int line,
                       const char* category) {
@@ -264,12 +503,14 @@ static T CreateLogger(Level level, const QString& class_name, int line,
     type = QtFatalMsg;
   }
 
+  // The writer turns this into the local time.
+  char timestamp[kTimestampLength + 1];
+  qsnprintf(timestamp, sizeof(timestamp), "%016llx",
+            static_cast<unsigned long long>(
+                QDateTime::currentMSecsSinceEpoch()));
+
   T ret(type);
-  ret.nospace() << QDateTime::currentDateTime()
-                       .toString("hh:mm:ss.zzz")
-                       .toLatin1()
-                       .constData()
-                << level_name
+  ret.nospace() << timestamp << level_name
                 << function_line.leftJustified(32).toLatin1().constData();
 
   return ret.space();
@@ -313,6 +554,9 @@ QString DemangleSymbol(const QString& symbol) {
 }
 
 void DumpStackTrace() {
+  // Keep the trace after whatever was logged before it.
+  Flush();
+
 #ifdef Q_OS_UNIX
   void* callstack[128];
   int callstack_size =
@@ -335,7 +579,7 @@ void DumpStackTrace() {
 // doesn't override any behavior that should be needed after return.
 #define qCreateLogger(line, pretty_function, category, level)                \
   logging::CreateLogger<LoggedDebug>(                                        \
-      logging::Level_##level, logging::ParsePrettyFunction(pretty_function), \
+      logging::Level_##level, logging::ClassNameForFunction(pretty_function), \
       line, category)
 
 QDebug CreateLoggerFatal(int line, const char* pretty_function,
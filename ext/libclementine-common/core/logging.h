@@ -34,15 +34,21 @@
   while (false) QNoDebug()
 #else
 
-#define qLog(level) \
-  logging::CreateLogger##level(__LINE__, __PRETTY_FUNCTION__, nullptr)
+// Messages above the most verbose level that's enabled anywhere are thrown
+// away before anything is formatted.
+#define qLog(level)                                    \
+  if (logging::Level_##level > logging::sMaxLevel) {  \
+  } else                                               \
+    logging::CreateLogger##level(__LINE__, __PRETTY_FUNCTION__, nullptr)
 
 // This macro specifies a separate category for message filtering. The default
 // qLog will use the class name extracted from the function name for this
 // purpose. The category is also printed in the message along with the class
 // name.
-#define qLogCat(level, category) \
-  logging::CreateLogger##level(__LINE__, __PRETTY_FUNCTION__, category)
+#define qLogCat(level, category)                       \
+  if (logging::Level_##level > logging::sMaxLevel) {  \
+  } else                                               \
+    logging::CreateLogger##level(__LINE__, __PRETTY_FUNCTION__, category)
 
 #endif  // QT_NO_DEBUG_STREAM
 
@@ -61,9 +67,23 @@ enum Level {
   Level_Debug,
 };
 
+// The most verbose level of any class.  Set by SetLevels.
+extern Level sMaxLevel;
+
+// Log lines are written to stderr by a background thread, so logging doesn't
+// block the thread that logs.  Fatal messages are written before returning.
 void Init();
 void SetLevels(const QString& levels);
 
+// Returns once everything logged so far has been written.
+void Flush();
+
+// The last few KB of log output are kept in memory to go with crash reports.
+// This returns them in up to two pieces, oldest first, without allocating or
+// locking, so it's safe to call from a crash handler.
+void GetRecentOutput(const char** first, size_t* first_size,
+                     const char** second, size_t* second_size);
+
 void DumpStackTrace();
 
 QDebug CreateLoggerFatal(int line, const char* pretty_function,
@@ -22,8 +22,69 @@
 #include "core/logging.h"
 
 #include <QAbstractSocket>
-#include <QLocalSocket>
 #include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QLocalSocket>
+#include <QTemporaryFile>
+
+const int _MessageHandlerBase::kSharedPayloadThreshold = 64 * 1024;
+
+MappedPayload::MappedPayload(const QString& directory,
+                             const QString& filename)
+    : data_(nullptr), size_(0) {
+  // The name came from another process, so don't trust it with anything
+  // outside the directory we gave it.
+  if (directory.isEmpty() ||
+      QFileInfo(filename).absolutePath() != QDir(directory).absolutePath()) {
+    qLog(Warning) << "Ignoring shared payload outside" << directory << ":"
+                  << filename;
+    return;
+  }
+
+  file_.setFileName(filename);
+  if (!file_.open(QIODevice::ReadOnly)) {
+    qLog(Warning) << "Couldn't open shared payload" << filename;
+    return;
+  }
+
+  size_ = file_.size();
+  data_ = file_.map(0, size_);
+  if (!data_) {
+    size_ = 0;
+  }
+}
+
+MappedPayload::~MappedPayload() {
+  if (data_) {
+    file_.unmap(data_);
+  }
+  if (!file_.fileName().isEmpty()) {
+    file_.remove();
+  }
+}
+
+QByteArray MappedPayload::ToByteArray() const {
+  if (!data_) return QByteArray();
+  return QByteArray(reinterpret_cast<const char*>(data_), size_);
+}
+
+QString _MessageHandlerBase::WriteSharedPayload(const QString& directory,
+                                                const QByteArray& data) {
+  if (directory.isEmpty() || data.size() < kSharedPayloadThreshold) {
+    return QString();
+  }
+
+  QTemporaryFile file(directory + "/payload-XXXXXX");
+  if (!file.open() || file.write(data) != data.size()) {
+    qLog(Warning) << "Couldn't write shared payload to" << directory;
+    return QString();
+  }
+
+  // The receiving side removes it once it's mapped.
+  file.setAutoRemove(false);
+  return file.fileName();
+}
 
 _MessageHandlerBase::_MessageHandlerBase(QIODevice* device, QObject* parent)
     : QObject(parent),
@@ -32,7 +93,12 @@ _MessageHandlerBase::_MessageHandlerBase(QIODevice* device, QObject* parent)
       flush_local_socket_(nullptr),
       reading_protobuf_(false),
       expected_length_(0),
-      is_device_closed_(false) {
+      is_device_closed_(false),
+      completed_requests_(0),
+      total_latency_msec_(0),
+      max_latency_msec_(0) {
+  clock_.start();
+
   if (device) {
     SetDevice(device);
   }
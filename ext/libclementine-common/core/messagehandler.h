@@ -22,6 +22,8 @@
 #define MESSAGEHANDLER_H
 
 #include <QBuffer>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QMap>
 #include <QMutex>
 #include <QMutexLocker>
@@ -39,6 +41,33 @@ class QLocalSocket;
 #define QStringFromStdString(x) QString::fromUtf8(x.data(), x.size())
 #define DataCommaSizeFromQString(x) x.toUtf8().constData(), x.toUtf8().length()
 
+// Large blobs, like cover art, don't have to go through the socket.  The
+// side sending them writes them once to a file in a directory the receiving
+// side chose (see WorkerPool::shared_payload_dir()), which is in RAM where
+// the system has a shared memory filesystem, and puts the file's name in the
+// message instead.  The receiving side maps the file with MappedPayload.
+class MappedPayload {
+ public:
+  // filename must be inside directory, otherwise nothing is mapped.  The file
+  // is removed when the MappedPayload is destroyed.
+  MappedPayload(const QString& directory, const QString& filename);
+  ~MappedPayload();
+
+  bool is_valid() const { return data_ != nullptr; }
+  const uchar* data() const { return data_; }
+  qint64 size() const { return size_; }
+
+  // Returns a copy of the data, or an empty array if nothing is mapped.
+  QByteArray ToByteArray() const;
+
+ private:
+  Q_DISABLE_COPY(MappedPayload)
+
+  QFile file_;
+  uchar* data_;
+  qint64 size_;
+};
+
 // Reads and writes uint32 length encoded protobufs to a socket.
 // This base QObject is separate from AbstractMessageHandler because moc can't
 // handle templated classes.  Use AbstractMessageHandler instead.
@@ -55,6 +84,26 @@ class _MessageHandlerBase : public QObject {
   // After this is true, messages cannot be sent to the handler any more.
   bool is_device_closed() const { return is_device_closed_; }
 
+  // Blobs smaller than this are cheaper to send in the message.
+  static const int kSharedPayloadThreshold;
+
+  // Writes data to a new file in directory for the other side to map with
+  // MappedPayload.  Returns the file's name, or an empty string if data is
+  // below the threshold or the file couldn't be written, in which case data
+  // should be sent in the message as usual.
+  static QString WriteSharedPayload(const QString& directory,
+                                    const QByteArray& data);
+
+  // Statistics about the requests sent with SendRequest.  Latency is measured
+  // from the moment a request is written until its reply arrives.
+  int completed_request_count() const { return completed_requests_; }
+  qint64 total_request_latency_msec() const { return total_latency_msec_; }
+  qint64 max_request_latency_msec() const { return max_latency_msec_; }
+
+signals:
+  // Emitted whenever a reply to a request sent with SendRequest arrives.
+  void RequestFinished();
+
  protected slots:
   void WriteMessage(const QByteArray& data);
   void DeviceReadyRead();
@@ -77,6 +126,11 @@ class _MessageHandlerBase : public QObject {
   QBuffer buffer_;
 
   bool is_device_closed_;
+
+  QElapsedTimer clock_;
+  int completed_requests_;
+  qint64 total_latency_msec_;
+  qint64 max_latency_msec_;
 };
 
 // Reads and writes uint32 length encoded MessageType messages to a socket.
@@ -108,6 +162,10 @@ class AbstractMessageHandler : public _MessageHandlerBase {
   // reply on the socket.  Used on the worker side.
   void SendReply(const MessageType& request, MessageType* reply);
 
+  // The number of requests sent with SendRequest that haven't been answered
+  // yet.  Must be called from my thread.
+  int pending_request_count() const { return pending_replies_.count(); }
+
  protected:
   // Called when a message is received from the socket.
   virtual void MessageArrived(const MessageType& message) {}
@@ -118,6 +176,8 @@ class AbstractMessageHandler : public _MessageHandlerBase {
 
  private:
   QMap<int, ReplyType*> pending_replies_;
+  // When each pending request was sent, according to clock_.
+  QMap<int, qint64> request_sent_msec_;
 };
 
 template <typename MT>
@@ -144,6 +204,7 @@ void AbstractMessageHandler<MT>::SendMessageAsync(const MessageType& message) {
 template <typename MT>
 void AbstractMessageHandler<MT>::SendRequest(ReplyType* reply) {
   pending_replies_[reply->id()] = reply;
+  request_sent_msec_[reply->id()] = clock_.elapsed();
   SendMessage(reply->request_message());
 }
 
@@ -165,7 +226,14 @@ bool AbstractMessageHandler<MT>::RawMessageArrived(const QByteArray& data) {
 
   if (reply) {
     // This is a reply to a message that we created earlier.
+    const qint64 latency =
+        clock_.elapsed() - request_sent_msec_.take(message.id());
+    completed_requests_++;
+    total_latency_msec_ += latency;
+    max_latency_msec_ = qMax(max_latency_msec_, latency);
+
     reply->SetReply(message);
+    emit RequestFinished();
   } else {
     MessageArrived(message);
   }
@@ -179,6 +247,7 @@ void AbstractMessageHandler<MT>::AbortAll() {
     reply->Abort();
   }
   pending_replies_.clear();
+  request_sent_msec_.clear();
 }
 
 #endif  // MESSAGEHANDLER_H
@@ -18,8 +18,12 @@
 #ifndef WORKERPOOL_H
 #define WORKERPOOL_H
 
+#include <memory>
+
 #include <QAtomicInt>
 #include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QLocalServer>
 #include <QLocalSocket>
@@ -27,7 +31,9 @@
 #include <QObject>
 #include <QProcess>
 #include <QQueue>
+#include <QTemporaryDir>
 #include <QThread>
+#include <QTimerEvent>
 
 #include "core/closure.h"
 #include "core/logging.h"
@@ -40,6 +46,19 @@ class _WorkerPoolBase : public QObject {
  public:
   _WorkerPoolBase(QObject* parent = nullptr);
 
+  struct WorkerStats {
+    WorkerStats()
+        : pending_requests(0),
+          completed_requests(0),
+          mean_latency_msec(0),
+          max_latency_msec(0) {}
+
+    int pending_requests;
+    int completed_requests;
+    qint64 mean_latency_msec;
+    qint64 max_latency_msec;
+  };
+
 signals:
   // Emitted when a worker failed to start.  This usually happens when the
   // worker wasn't found, or couldn't be executed.
@@ -57,6 +76,10 @@ signals:
 // argv[1].  The process is expected to connect back to the socket server, and
 // when it does a HandlerType is created for it.
 // Instances of HandlerType are created in the WorkerPool's thread.
+// The pool starts with a minimum number of processes and starts more, up to
+// the worker count, while requests are queued faster than the running
+// workers can answer them.  Workers that stay idle are stopped again.
+// Requests go to the worker with the fewest requests in flight.
 template <typename HandlerType>
 class WorkerPool : public _WorkerPoolBase {
  public:
@@ -71,10 +94,14 @@ class WorkerPool : public _WorkerPoolBase {
   // Start().
   void SetExecutableName(const QString& executable_name);
 
-  // Sets the number of worker process to use.  Defaults to
+  // Sets the maximum number of worker process to use.  Defaults to
   // 1 <= (processors / 2) <= 2.
   void SetWorkerCount(int count);
 
+  // Sets the number of worker processes that are always kept running.
+  // Defaults to 1.
+  void SetMinWorkerCount(int count);
+
   // Sets the prefix to use for the local server (on unix this is a named pipe
   // in /tmp).  Defaults to QApplication::applicationName().  A random number
   // is appended to this name when creating each server.
@@ -88,6 +115,20 @@ class WorkerPool : public _WorkerPoolBase {
   // worker.  Can be called from any thread.
   ReplyType* SendMessageWithReply(MessageType* message);
 
+  // Returns statistics about each connected worker.  Must be called from my
+  // thread.
+  QList<WorkerStats> worker_stats() const;
+
+  // The number of requests waiting for a free worker.  Can be called from
+  // any thread.
+  int queued_message_count() const;
+
+  // Where workers should write large blobs for us to map, see
+  // MappedPayload.  Empty if the directory couldn't be created.  It's removed,
+  // with anything still in it, when the pool is destroyed.  Can be called
+  // from any thread.
+  QString shared_payload_dir() const;
+
  protected:
   // These are all reimplemented slots, they are called on the WorkerPool's
   // thread.
@@ -96,23 +137,49 @@ class WorkerPool : public _WorkerPoolBase {
   void ProcessError(QProcess::ProcessError error);
   void SendQueuedMessages();
 
+  void timerEvent(QTimerEvent* e);
+
  private:
   struct Worker {
     Worker()
         : local_server_(NULL),
           local_socket_(NULL),
           process_(NULL),
-          handler_(NULL) {}
+          handler_(NULL),
+          last_completed_requests_(0),
+          idle_since_msec_(0) {}
 
     QLocalServer* local_server_;
     QLocalSocket* local_socket_;
     QProcess* process_;
     HandlerType* handler_;
+
+    // Used to find workers that haven't done anything for a while.
+    int last_completed_requests_;
+    qint64 idle_since_msec_;
   };
 
+  // A worker isn't given any more requests while it has this many in flight,
+  // so that the rest stay queued for workers that become free, or for new
+  // ones.
+  static const int kMaxRequestsPerWorker = 4;
+  // How often idle workers are looked for, and how long a worker must be idle
+  // before it is stopped.
+  static const int kIdleCheckIntervalMsec = 10000;
+  static const int kIdleWorkerTimeoutMsec = 60000;
+
   // Must only ever be called on my thread.
   void StartOneWorker(Worker* worker);
 
+  // Starts a new worker if there are more requests than the running workers
+  // can take and we're still allowed to.  Must be called on my thread with
+  // message_queue_mutex_ held.
+  void MaybeStartAnotherWorker();
+
+  // Closes the worker's socket, which makes it exit, and forgets about it.
+  // The worker must not have any requests in flight.
+  void StopWorker(int index);
+
   template <typename T>
   Worker* FindWorker(T Worker::*member, T value) {
     for (typename QList<Worker>::iterator it = workers_.begin();
@@ -137,8 +204,8 @@ class WorkerPool : public _WorkerPoolBase {
   // thread
   ReplyType* NewReply(MessageType* message);
 
-  // Returns the next handler, or NULL if there isn't one.  Must be called from
-  // my thread.
+  // Returns the connected handler with the fewest requests in flight, or NULL
+  // if they are all full.  Must be called from my thread.
   HandlerType* NextHandler() const;
 
  private:
@@ -147,22 +214,40 @@ class WorkerPool : public _WorkerPoolBase {
   QString executable_path_;
 
   int worker_count_;
+  int min_worker_count_;
+  bool failed_to_start_;
   mutable int next_worker_;
   QList<Worker> workers_;
 
+  QElapsedTimer clock_;
+
   QAtomicInt next_id_;
 
-  QMutex message_queue_mutex_;
+  mutable QMutex message_queue_mutex_;
   QQueue<ReplyType*> message_queue_;
+
+  std::unique_ptr<QTemporaryDir> shared_payload_dir_;
 };
 
 template <typename HandlerType>
 WorkerPool<HandlerType>::WorkerPool(QObject* parent)
-    : _WorkerPoolBase(parent), next_worker_(0), next_id_(0) {
+    : _WorkerPoolBase(parent),
+      min_worker_count_(1),
+      failed_to_start_(false),
+      next_worker_(0),
+      next_id_(0) {
   worker_count_ = qBound(1, QThread::idealThreadCount() / 2, 2);
   local_server_name_ = qApp->applicationName().toLower();
 
   if (local_server_name_.isEmpty()) local_server_name_ = "workerpool";
+
+  // Prefer a directory that lives in memory.
+  QString base = QDir::tempPath();
+#ifdef Q_OS_LINUX
+  if (QDir("/dev/shm").exists()) base = "/dev/shm";
+#endif
+  shared_payload_dir_.reset(
+      new QTemporaryDir(base + "/" + local_server_name_ + "-XXXXXX"));
 }
 
 template <typename HandlerType>
@@ -193,12 +278,24 @@ WorkerPool<HandlerType>::~WorkerPool() {
   }
 }
 
+template <typename HandlerType>
+QString WorkerPool<HandlerType>::shared_payload_dir() const {
+  if (!shared_payload_dir_->isValid()) return QString();
+  return shared_payload_dir_->path();
+}
+
 template <typename HandlerType>
 void WorkerPool<HandlerType>::SetWorkerCount(int count) {
   Q_ASSERT(workers_.isEmpty());
   worker_count_ = count;
 }
 
+template <typename HandlerType>
+void WorkerPool<HandlerType>::SetMinWorkerCount(int count) {
+  Q_ASSERT(workers_.isEmpty());
+  min_worker_count_ = count;
+}
+
 template <typename HandlerType>
 void WorkerPool<HandlerType>::SetLocalServerName(
     const QString& local_server_name) {
@@ -241,13 +338,17 @@ void WorkerPool<HandlerType>::DoStart() {
     }
   }
 
-  // Start all the workers
-  for (int i = 0; i < worker_count_; ++i) {
+  // Start the minimum number of workers, more are started when needed.
+  const int initial_count = qBound(1, min_worker_count_, worker_count_);
+  for (int i = 0; i < initial_count; ++i) {
     Worker worker;
     StartOneWorker(&worker);
 
     workers_ << worker;
   }
+
+  clock_.start();
+  startTimer(kIdleCheckIntervalMsec);
 }
 
 template <typename HandlerType>
@@ -311,6 +412,9 @@ void WorkerPool<HandlerType>::NewConnection() {
 
   // Create the handler.
   worker->handler_ = new HandlerType(worker->local_socket_, this);
+  worker->idle_since_msec_ = clock_.elapsed();
+  connect(worker->handler_, SIGNAL(RequestFinished()),
+          SLOT(SendQueuedMessages()));
 
   SendQueuedMessages();
 }
@@ -331,6 +435,7 @@ void WorkerPool<HandlerType>::ProcessError(QProcess::ProcessError error) {
       // installed.  Don't restart the process, but tell our owner, who will
       // probably want to do something fatal.
       qLog(Error) << "Worker failed to start";
+      failed_to_start_ = true;
       emit WorkerFailedToStart();
       break;
 
@@ -374,34 +479,156 @@ void WorkerPool<HandlerType>::SendQueuedMessages() {
   QMutexLocker l(&message_queue_mutex_);
 
   while (!message_queue_.isEmpty()) {
-    ReplyType* reply = message_queue_.dequeue();
-
     // Find a worker for this message
     HandlerType* handler = NextHandler();
     if (!handler) {
-      // No available handlers - put the message on the front of the queue.
-      message_queue_.prepend(reply);
-      qLog(Debug) << "No available handlers to process request";
+      // No available handlers - leave the message on the queue until one of
+      // them finishes a request.
       break;
     }
 
-    handler->SendRequest(reply);
+    handler->SendRequest(message_queue_.dequeue());
   }
+
+  MaybeStartAnotherWorker();
 }
 
 template <typename HandlerType>
 HandlerType* WorkerPool<HandlerType>::NextHandler() const {
+  HandlerType* best = NULL;
+  int best_pending = kMaxRequestsPerWorker;
+  int best_index = 0;
+
+  // Start looking after the last worker we picked so that idle workers take
+  // turns.
   for (int i = 0; i < workers_.count(); ++i) {
     const int worker_index = (next_worker_ + i) % workers_.count();
+    HandlerType* handler = workers_[worker_index].handler_;
+
+    if (handler && !handler->is_device_closed() &&
+        handler->pending_request_count() < best_pending) {
+      best = handler;
+      best_pending = handler->pending_request_count();
+      best_index = worker_index;
+    }
+  }
+
+  if (best) {
+    next_worker_ = (best_index + 1) % workers_.count();
+  }
+  return best;
+}
 
-    if (workers_[worker_index].handler_ &&
-        !workers_[worker_index].handler_->is_device_closed()) {
-      next_worker_ = (worker_index + 1) % workers_.count();
-      return workers_[worker_index].handler_;
+template <typename HandlerType>
+void WorkerPool<HandlerType>::MaybeStartAnotherWorker() {
+  if (failed_to_start_ || message_queue_.isEmpty() ||
+      workers_.count() >= worker_count_) {
+    return;
+  }
+
+  // Wait for workers that are still starting up before starting any more.
+  for (const Worker& worker : workers_) {
+    if (!worker.handler_) return;
+  }
+
+  Worker worker;
+  StartOneWorker(&worker);
+  workers_ << worker;
+
+  qLog(Debug) << message_queue_.count() << "requests queued, now using"
+              << workers_.count() << "of" << worker_count_ << "workers";
+}
+
+template <typename HandlerType>
+void WorkerPool<HandlerType>::StopWorker(int index) {
+  Worker worker = workers_.takeAt(index);
+  if (next_worker_ >= workers_.count()) next_worker_ = 0;
+
+  qLog(Debug) << "Stopping idle worker, now using" << workers_.count() << "of"
+              << worker_count_ << "workers";
+
+  // Don't restart the worker when it exits.
+  disconnect(worker.process_, SIGNAL(error(QProcess::ProcessError)), this,
+             SLOT(ProcessError(QProcess::ProcessError)));
+  connect(worker.process_, SIGNAL(finished(int, QProcess::ExitStatus)),
+          worker.process_, SLOT(deleteLater()));
+
+  // The worker exits when its socket is closed.
+  worker.local_socket_->close();
+  DeleteQObjectPointerLater(&worker.handler_);
+  DeleteQObjectPointerLater(&worker.local_socket_);
+}
+
+template <typename HandlerType>
+void WorkerPool<HandlerType>::timerEvent(QTimerEvent*) {
+  const qint64 now = clock_.elapsed();
+
+  int connected = 0;
+  int idle_index = -1;
+  bool busy = false;
+
+  for (int i = 0; i < workers_.count(); ++i) {
+    Worker* worker = &workers_[i];
+    HandlerType* handler = worker->handler_;
+    if (!handler || handler->is_device_closed()) continue;
+
+    connected++;
+
+    if (handler->pending_request_count() != 0 ||
+        handler->completed_request_count() !=
+            worker->last_completed_requests_) {
+      // It's been busy since we last looked.
+      worker->last_completed_requests_ = handler->completed_request_count();
+      worker->idle_since_msec_ = now;
+      busy = true;
+    } else if (now - worker->idle_since_msec_ >= kIdleWorkerTimeoutMsec) {
+      idle_index = i;
     }
   }
 
-  return NULL;
+  if (busy) {
+    int i = 0;
+    for (const WorkerStats& stats : worker_stats()) {
+      qLog(Debug) << "Worker" << i++ << "pending" << stats.pending_requests
+                  << "completed" << stats.completed_requests << "mean latency"
+                  << stats.mean_latency_msec << "ms, max"
+                  << stats.max_latency_msec << "ms";
+    }
+    qLog(Debug) << queued_message_count() << "requests queued";
+  }
+
+  // Stop at most one worker each time so the pool shrinks gradually.
+  if (idle_index != -1 && connected > min_worker_count_) {
+    StopWorker(idle_index);
+  }
+}
+
+template <typename HandlerType>
+QList<_WorkerPoolBase::WorkerStats> WorkerPool<HandlerType>::worker_stats()
+    const {
+  Q_ASSERT(QThread::currentThread() == thread());
+
+  QList<WorkerStats> ret;
+  for (const Worker& worker : workers_) {
+    if (!worker.handler_) continue;
+
+    WorkerStats stats;
+    stats.pending_requests = worker.handler_->pending_request_count();
+    stats.completed_requests = worker.handler_->completed_request_count();
+    stats.max_latency_msec = worker.handler_->max_request_latency_msec();
+    if (stats.completed_requests) {
+      stats.mean_latency_msec = worker.handler_->total_request_latency_msec() /
+                                stats.completed_requests;
+    }
+    ret << stats;
+  }
+  return ret;
+}
+
+template <typename HandlerType>
+int WorkerPool<HandlerType>::queued_message_count() const {
+  QMutexLocker l(&message_queue_mutex_);
+  return message_queue_.count();
 }
 
 #endif  // WORKERPOOL_H
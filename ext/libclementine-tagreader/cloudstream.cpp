@@ -21,6 +21,7 @@
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QThreadStorage>
 
 #include <taglib/id3v2framefactory.h>
 #include <taglib/mpegfile.h>
@@ -30,6 +31,22 @@
 namespace {
 static const int kTaglibPrefixCacheBytes = 64 * 1024;  // Should be enough.
 static const int kTaglibSuffixCacheBytes = 8 * 1024;
+
+// Reads that miss the cache fetch at least this much, doubling each time
+// TagLib carries on reading from where the last miss ended (big ID3v2 tags
+// with embedded art, MP4 atoms).
+static const int kMinReadAheadBytes = 16 * 1024;
+static const int kMaxReadAheadBytes = 512 * 1024;
+
+// Keeping one QNetworkAccessManager per thread lets requests for the next
+// file reuse the connections (and TLS sessions) to the service.
+QNetworkAccessManager* ThreadNetworkAccessManager() {
+  static QThreadStorage<QNetworkAccessManager*> network;
+  if (!network.hasLocalData()) {
+    network.setLocalData(new QNetworkAccessManager);
+  }
+  return network.localData();
+}
 }
 
 CloudStream::CloudStream(const QUrl& url, const QString& filename,
@@ -40,9 +57,11 @@ CloudStream::CloudStream(const QUrl& url, const QString& filename,
       length_(length),
       auth_(auth),
       cursor_(0),
-      network_(new QNetworkAccessManager),
+      network_(ThreadNetworkAccessManager()),
       cache_(length),
-      num_requests_(0) {}
+      num_requests_(0),
+      read_ahead_(kMinReadAheadBytes),
+      next_sequential_read_(-1) {}
 
 TagLib::FileName CloudStream::name() const { return encoded_filename_.data(); }
 
@@ -82,13 +101,68 @@ void CloudStream::Precache() {
   // So, if we precache the first 64KB and the last 8KB we should be sorted :-)
   // Ideally, we would use bytes=0-655364,-8096 but Google Drive does not seem
   // to support multipart byte ranges yet so we have to make do with two
-  // requests.
+  // requests.  They're sent together so we only wait for one round trip.
+  if (length_ == 0) return;
+
+  if (length_ <= ulong(kTaglibPrefixCacheBytes + kTaglibSuffixCacheBytes)) {
+    Fetch(RangeList() << Range(0, length_ - 1));
+  } else {
+    Fetch(RangeList() << Range(0, kTaglibPrefixCacheBytes - 1)
+                      << Range(length_ - kTaglibSuffixCacheBytes,
+                               length_ - 1));
+  }
+}
+
+bool CloudStream::Fetch(const RangeList& ranges) {
+  QList<QNetworkReply*> replies;
+  for (const Range& range : ranges) {
+    QNetworkRequest request = QNetworkRequest(url_);
+    if (!auth_.isEmpty()) {
+      request.setRawHeader("Authorization", auth_.toUtf8());
+    }
+    request.setRawHeader(
+        "Range",
+        QString("bytes=%1-%2").arg(range.first).arg(range.second).toUtf8());
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
+                         QNetworkRequest::AlwaysNetwork);
+
+    QNetworkReply* reply = network_->get(request);
+    connect(reply, SIGNAL(sslErrors(QList<QSslError>)),
+            SLOT(SSLErrors(QList<QSslError>)));
+    ++num_requests_;
+    replies << reply;
+  }
 
-  seek(0, TagLib::IOStream::Beginning);
-  readBlock(kTaglibPrefixCacheBytes);
-  seek(kTaglibSuffixCacheBytes, TagLib::IOStream::End);
-  readBlock(kTaglibSuffixCacheBytes);
-  clear();
+  QEventLoop loop;
+  for (QNetworkReply* reply : replies) {
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+  }
+  forever {
+    bool finished = true;
+    for (QNetworkReply* reply : replies) {
+      finished = finished && reply->isFinished();
+    }
+    if (finished) break;
+    loop.exec();
+  }
+
+  bool ok = true;
+  for (int i = 0; i < replies.count(); ++i) {
+    QNetworkReply* reply = replies[i];
+    reply->deleteLater();
+
+    int code =
+        reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (code >= 400) {
+      qLog(Debug) << "Error retrieving url to tag:" << url_;
+      ok = false;
+      continue;
+    }
+
+    QByteArray data = reply->readAll();
+    FillCache(ranges[i].first, TagLib::ByteVector(data.data(), data.size()));
+  }
+  return ok;
 }
 
 TagLib::ByteVector CloudStream::readBlock(ulong length) {
@@ -99,43 +173,38 @@ TagLib::ByteVector CloudStream::readBlock(ulong length) {
     return TagLib::ByteVector();
   }
 
-  if (CheckCache(start, end)) {
-    TagLib::ByteVector cached = GetCached(start, end);
-    cursor_ += cached.size();
-    return cached;
-  }
+  if (!CheckCache(start, end)) {
+    // Only fetch from the first byte we don't have, and read ahead a bit so
+    // the next few reads don't need a round trip of their own.
+    uint fetch_start = start;
+    while (cache_.test(fetch_start)) ++fetch_start;
 
-  QNetworkRequest request = QNetworkRequest(url_);
-  if (!auth_.isEmpty()) {
-    request.setRawHeader("Authorization", auth_.toUtf8());
-  }
-  request.setRawHeader("Range",
-                       QString("bytes=%1-%2").arg(start).arg(end).toUtf8());
-  request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
-                       QNetworkRequest::AlwaysNetwork);
+    if (int(start) == next_sequential_read_) {
+      read_ahead_ = qMin(read_ahead_ * 2, kMaxReadAheadBytes);
+    } else {
+      read_ahead_ = kMinReadAheadBytes;
+    }
 
-  QNetworkReply* reply = network_->get(request);
-  connect(reply, SIGNAL(sslErrors(QList<QSslError>)),
-          SLOT(SSLErrors(QList<QSslError>)));
-  ++num_requests_;
+    uint fetch_end =
+        qMin(ulong(qMax(end, fetch_start + read_ahead_ - 1)), length_ - 1);
+    while (fetch_end > end && cache_.test(fetch_end)) --fetch_end;
 
-  QEventLoop loop;
-  QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
-  loop.exec();
-  reply->deleteLater();
+    if (!Fetch(RangeList() << Range(fetch_start, fetch_end))) {
+      return TagLib::ByteVector();
+    }
+  }
+  next_sequential_read_ = end + 1;
 
-  int code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-  if (code >= 400) {
-    qLog(Debug) << "Error retrieving url to tag:" << url_;
+  // The server might have sent less than we asked for.
+  uint available_end = start;
+  while (available_end <= end && cache_.test(available_end)) ++available_end;
+  if (available_end == start) {
     return TagLib::ByteVector();
   }
 
-  QByteArray data = reply->readAll();
-  TagLib::ByteVector bytes(data.data(), data.size());
-  cursor_ += data.size();
-
-  FillCache(start, bytes);
-  return bytes;
+  TagLib::ByteVector cached = GetCached(start, available_end - 1);
+  cursor_ += cached.size();
+  return cached;
 }
 
 void CloudStream::writeBlock(const TagLib::ByteVector&) {
@@ -21,6 +21,7 @@
 #include <QList>
 #include <QNetworkAccessManager>
 #include <QObject>
+#include <QPair>
 #include <QSslError>
 #include <QUrl>
 
@@ -57,10 +58,18 @@ class CloudStream : public QObject, public TagLib::IOStream {
   void Precache();
 
  private:
+  // Inclusive byte ranges.
+  typedef QPair<int, int> Range;
+  typedef QList<Range> RangeList;
+
   bool CheckCache(int start, int end);
   void FillCache(int start, TagLib::ByteVector data);
   TagLib::ByteVector GetCached(int start, int end);
 
+  // Requests all the ranges at once, waits for them and puts them in the
+  // cache.  Returns false if any of them failed.
+  bool Fetch(const RangeList& ranges);
+
  private slots:
   void SSLErrors(const QList<QSslError>& errors);
 
@@ -72,10 +81,16 @@ class CloudStream : public QObject, public TagLib::IOStream {
   const QString auth_;
 
   int cursor_;
-  std::unique_ptr<QNetworkAccessManager> network_;
+  // Shared by every stream on this thread.
+  QNetworkAccessManager* network_;
 
   google::sparsetable<char> cache_;
   int num_requests_;
+
+  // How much to fetch on the next cache miss, and where a miss has to start
+  // to count as reading on from the last one.
+  int read_ahead_;
+  int next_sequential_read_;
 };
 
 #endif  // GOOGLEDRIVESTREAM_H
@@ -33,7 +33,9 @@
 
 #include <QCoreApplication>
 #include <QDateTime>
+#include <QFile>
 #include <QFileInfo>
+#include <QPair>
 #include <QTextCodec>
 #include <QUrl>
 #include <QVector>
@@ -49,6 +51,7 @@
 #include <tag.h>
 #include <tdebuglistener.h>
 #include <textidentificationframe.h>
+#include <tpropertymap.h>
 #include <trueaudiofile.h>
 #include <tstring.h>
 #include <unsynchronizedlyricsframe.h>
@@ -77,11 +80,17 @@
 
 class TagLibFileRefFactory : public FileRefFactory {
  public:
-  virtual TagLib::FileRef* GetFileRef(const QString& filename) {
+  virtual TagLib::FileRef* GetFileRef(const QString& filename,
+                                      pb::tagreader::ReadMode mode) {
+    // Fast doesn't scan VBR files for an accurate bitrate.
+    const TagLib::AudioProperties::ReadStyle style =
+        mode == pb::tagreader::READ_FAST ? TagLib::AudioProperties::Fast
+                                         : TagLib::AudioProperties::Average;
 #ifdef Q_OS_WIN32
-    return new TagLib::FileRef(filename.toStdWString().c_str());
+    return new TagLib::FileRef(filename.toStdWString().c_str(), true, style);
 #else
-    return new TagLib::FileRef(QFile::encodeName(filename).constData());
+    return new TagLib::FileRef(QFile::encodeName(filename).constData(), true,
+                               style);
 #endif
   }
 };
@@ -127,6 +136,27 @@ const char* kMP4_OriginalYear_ID = "----:com.apple.iTunes:ORIGINAL YEAR";
 const char* kASF_OriginalDate_ID = "WM/OriginalReleaseTime";
 const char* kASF_OriginalYear_ID = "WM/OriginalReleaseYear";
 
+// ReplayGain tag names.  ID3v2 keeps these in TXXX frames and MP4 in freeform
+// iTunes atoms, everything else has them as plain fields.
+const char* kReplayGainTrackGain = "REPLAYGAIN_TRACK_GAIN";
+const char* kReplayGainTrackPeak = "REPLAYGAIN_TRACK_PEAK";
+const char* kReplayGainAlbumGain = "REPLAYGAIN_ALBUM_GAIN";
+const char* kReplayGainAlbumPeak = "REPLAYGAIN_ALBUM_PEAK";
+const char* kMP4_Freeform_Prefix = "----:com.apple.iTunes:";
+
+// Gains are written like "-6.48 dB".
+bool ParseReplayGainValue(const TagLib::PropertyMap& map, const char* key,
+                          float* value) {
+  TagLib::PropertyMap::ConstIterator it = map.find(key);
+  if (it == map.end() || it->second.isEmpty()) return false;
+
+  bool ok = false;
+  *value = TStringToQString(it->second.front())
+               .section(' ', 0, 0, QString::SectionSkipEmpty)
+               .toFloat(&ok);
+  return ok;
+}
+
 // Helpers for GuessArtistAndTitle()
 QString WithoutExtension(const QString& s) {
   if (s.isEmpty()) return s;
@@ -191,7 +221,8 @@ TagReader::TagReader()
     : factory_(new TagLibFileRefFactory), kEmbeddedCover("(embedded)") {}
 
 void TagReader::ReadFile(const QString& filename,
-                         pb::tagreader::SongMetadata* song) const {
+                         pb::tagreader::SongMetadata* song,
+                         pb::tagreader::ReadMode mode) const {
   const QByteArray url(QUrl::fromLocalFile(filename).toEncoded());
   const QFileInfo info(filename);
 
@@ -227,7 +258,8 @@ void TagReader::ReadFile(const QString& filename,
               << "size=" << info.size() << "; mtime=" << mtime
               << "; birthtime=" << btime;
 
-  std::unique_ptr<TagLib::FileRef> fileref(factory_->GetFileRef(filename));
+  std::unique_ptr<TagLib::FileRef> fileref(
+      factory_->GetFileRef(filename, mode));
   if (fileref->isNull()) {
     qLog(Info) << "TagLib hasn't been able to read " << filename << " file";
 
@@ -623,6 +655,28 @@ void TagReader::ReadFile(const QString& filename,
 
   if (!lyrics.isEmpty()) song->set_lyrics(lyrics.toStdString());
 
+  if (TagLib::MP4::File* file =
+          dynamic_cast<TagLib::MP4::File*>(fileref->file())) {
+    // TagLib doesn't map freeform atoms to properties, and their case varies
+    // between taggers.
+    TagLib::PropertyMap properties;
+    if (file->tag()) {
+      const TagLib::MP4::ItemListMap& items = file->tag()->itemListMap();
+      for (TagLib::MP4::ItemListMap::ConstIterator it = items.begin();
+           it != items.end(); ++it) {
+        if (it->first.startsWith(kMP4_Freeform_Prefix)) {
+          properties.insert(
+              it->first.substr(TagLib::String(kMP4_Freeform_Prefix).size())
+                  .upper(),
+              it->second.toStringList());
+        }
+      }
+    }
+    ParseReplayGain(properties, song);
+  } else {
+    ParseReplayGain(fileref->file()->properties(), song);
+  }
+
   if (fileref->audioProperties()) {
     song->set_bitrate(fileref->audioProperties()->bitrate());
     song->set_samplerate(fileref->audioProperties()->sampleRate());
@@ -714,6 +768,24 @@ void TagReader::ParseFMPSFrame(const QString& name, const QString& value,
   }
 }
 
+void TagReader::ParseReplayGain(const TagLib::PropertyMap& map,
+                                pb::tagreader::SongMetadata* song) const {
+  float gain = 0;
+  float peak = 0;
+
+  // Some taggers leave the peak out.
+  if (ParseReplayGainValue(map, kReplayGainTrackGain, &gain)) {
+    if (!ParseReplayGainValue(map, kReplayGainTrackPeak, &peak)) peak = 1.0;
+    song->set_track_gain(gain);
+    song->set_track_peak(peak);
+  }
+  if (ParseReplayGainValue(map, kReplayGainAlbumGain, &gain)) {
+    if (!ParseReplayGainValue(map, kReplayGainAlbumPeak, &peak)) peak = 1.0;
+    song->set_album_gain(gain);
+    song->set_album_peak(peak);
+  }
+}
+
 void TagReader::ParseOggTag(const TagLib::Ogg::FieldListMap& map,
                             const QTextCodec* codec, QString* disc,
                             QString* compilation,
@@ -1165,6 +1237,94 @@ bool TagReader::SaveSongRatingToFile(
   return ret;
 }
 
+bool TagReader::SaveSongReplayGainToFile(
+    const QString& filename, const pb::tagreader::SongMetadata& song) const {
+  if (filename.isNull()) return false;
+  if (!song.has_track_peak() && !song.has_album_peak()) return true;
+
+  qLog(Debug) << "Saving ReplayGain tags to" << filename;
+
+  std::unique_ptr<TagLib::FileRef> fileref(factory_->GetFileRef(filename));
+
+  if (!fileref || fileref->isNull())  // The file probably doesn't exist
+    return false;
+
+  QList<QPair<QString, QString>> values;
+  if (song.has_track_peak()) {
+    values << qMakePair(
+                  QString(kReplayGainTrackGain),
+                  QString::number(song.track_gain(), 'f', 2) + " dB")
+           << qMakePair(QString(kReplayGainTrackPeak),
+                        QString::number(song.track_peak(), 'f', 6));
+  }
+  if (song.has_album_peak()) {
+    values << qMakePair(
+                  QString(kReplayGainAlbumGain),
+                  QString::number(song.album_gain(), 'f', 2) + " dB")
+           << qMakePair(QString(kReplayGainAlbumPeak),
+                        QString::number(song.album_peak(), 'f', 6));
+  }
+
+  auto saveApeReplayGain = [&](TagLib::APE::Tag* tag) {
+    for (const auto& value : values) {
+      tag->setItem(QStringToTaglibString(value.first),
+                   TagLib::APE::Item(QStringToTaglibString(value.first),
+                                     QStringToTaglibString(value.second)));
+    }
+  };
+  auto saveVorbisReplayGain = [&](TagLib::Ogg::XiphComment* tag) {
+    for (const auto& value : values) {
+      tag->addField(QStringToTaglibString(value.first),
+                    QStringToTaglibString(value.second), true);
+    }
+  };
+
+  if (TagLib::MPEG::File* file =
+          dynamic_cast<TagLib::MPEG::File*>(fileref->file())) {
+    TagLib::ID3v2::Tag* tag = file->ID3v2Tag(true);
+    for (const auto& value : values) {
+      SetUserTextFrame(value.first, value.second, tag);
+    }
+  } else if (TagLib::FLAC::File* file =
+                 dynamic_cast<TagLib::FLAC::File*>(fileref->file())) {
+    saveVorbisReplayGain(file->xiphComment(true));
+  } else if (TagLib::Ogg::XiphComment* tag =
+                 dynamic_cast<TagLib::Ogg::XiphComment*>(
+                     fileref->file()->tag())) {
+    saveVorbisReplayGain(tag);
+  } else if (TagLib::MP4::File* file =
+                 dynamic_cast<TagLib::MP4::File*>(fileref->file())) {
+    TagLib::MP4::Tag* tag = file->tag();
+    for (const auto& value : values) {
+      tag->itemListMap()[kMP4_Freeform_Prefix +
+                         QStringToTaglibString(value.first.toLower())] =
+          TagLib::StringList(QStringToTaglibString(value.second));
+    }
+  } else if (TagLib::APE::File* file =
+                 dynamic_cast<TagLib::APE::File*>(fileref->file())) {
+    saveApeReplayGain(file->APETag(true));
+  } else if (TagLib::MPC::File* file =
+                 dynamic_cast<TagLib::MPC::File*>(fileref->file())) {
+    saveApeReplayGain(file->APETag(true));
+  } else if (TagLib::WavPack::File* file =
+                 dynamic_cast<TagLib::WavPack::File*>(fileref->file())) {
+    saveApeReplayGain(file->APETag(true));
+  } else {
+    // Nothing to save: stop now
+    return true;
+  }
+
+  bool ret = fileref->save();
+#ifdef Q_OS_LINUX
+  if (ret) {
+    // Linux: inotify doesn't seem to notice the change to the file unless we
+    // change the timestamps as well. (this is what touch does)
+    utimensat(0, QFile::encodeName(filename).constData(), nullptr, 0);
+  }
+#endif  // Q_OS_LINUX
+  return ret;
+}
+
 void TagReader::SetUserTextFrame(const QString& description,
                                  const QString& value,
                                  TagLib::ID3v2::Tag* tag) const {
@@ -1267,13 +1427,60 @@ void TagReader::SetUnsyncLyricsFrame(const std::string& value,
   }
 }
 
-bool TagReader::IsMediaFile(const QString& filename) const {
+bool TagReader::IsMediaFile(const QString& filename,
+                            pb::tagreader::ReadMode mode) const {
   qLog(Debug) << "Checking for valid file" << filename;
 
-  std::unique_ptr<TagLib::FileRef> fileref(factory_->GetFileRef(filename));
+  if (mode == pb::tagreader::READ_FAST && HasKnownMagic(filename)) {
+    return true;
+  }
+
+  std::unique_ptr<TagLib::FileRef> fileref(
+      factory_->GetFileRef(filename, mode));
   return !fileref->isNull() && fileref->tag();
 }
 
+bool TagReader::HasKnownMagic(const QString& filename) {
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly)) return false;
+  const QByteArray head = file.read(12);
+  if (head.size() < 12) return false;
+
+  const QString suffix = QFileInfo(filename).suffix().toLower();
+  const uchar b0 = head[0];
+  const uchar b1 = head[1];
+
+  if (suffix == "mp3") {
+    // An ID3v2 tag or an MPEG frame sync.
+    return head.startsWith("ID3") || (b0 == 0xff && (b1 & 0xe0) == 0xe0);
+  } else if (suffix == "flac") {
+    return head.startsWith("fLaC") || head.startsWith("ID3");
+  } else if (suffix == "ogg" || suffix == "oga" || suffix == "opus" ||
+             suffix == "spx") {
+    return head.startsWith("OggS");
+  } else if (suffix == "m4a" || suffix == "m4b" || suffix == "mp4" ||
+             suffix == "aac") {
+    return head.mid(4, 4) == "ftyp";
+  } else if (suffix == "wav") {
+    return head.startsWith("RIFF") && head.mid(8, 4) == "WAVE";
+  } else if (suffix == "aif" || suffix == "aiff") {
+    return head.startsWith("FORM") &&
+           (head.mid(8, 4) == "AIFF" || head.mid(8, 4) == "AIFC");
+  } else if (suffix == "ape") {
+    return head.startsWith("MAC ");
+  } else if (suffix == "wv") {
+    return head.startsWith("wvpk");
+  } else if (suffix == "mpc") {
+    return head.startsWith("MPCK") || head.startsWith("MP+");
+  } else if (suffix == "tta") {
+    return head.startsWith("TTA1") || head.startsWith("ID3");
+  } else if (suffix == "wma" || suffix == "asf") {
+    // The start of the ASF header object's GUID.
+    return head.startsWith("\x30\x26\xb2\x75");
+  }
+  return false;
+}
+
 QByteArray TagReader::LoadEmbeddedArt(const QString& filename) const {
   if (filename.isEmpty()) return QByteArray();
 
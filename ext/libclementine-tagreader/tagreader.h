@@ -33,6 +33,7 @@ class QUrl;
 
 namespace TagLib {
 class FileRef;
+class PropertyMap;
 class String;
 
 namespace ID3v2 {
@@ -44,7 +45,9 @@ class PopularimeterFrame;
 class FileRefFactory {
  public:
   virtual ~FileRefFactory() {}
-  virtual TagLib::FileRef* GetFileRef(const QString& filename) = 0;
+  virtual TagLib::FileRef* GetFileRef(
+      const QString& filename,
+      pb::tagreader::ReadMode mode = pb::tagreader::READ_FULL) = 0;
 };
 
 /**
@@ -56,8 +59,8 @@ class TagReader {
  public:
   TagReader();
 
-  void ReadFile(const QString& filename,
-                pb::tagreader::SongMetadata* song) const;
+  void ReadFile(const QString& filename, pb::tagreader::SongMetadata* song,
+                pb::tagreader::ReadMode mode = pb::tagreader::READ_FULL) const;
   bool SaveFile(const QString& filename,
                 const pb::tagreader::SongMetadata& song) const;
   // Returns false if something went wrong; returns true otherwise (might
@@ -67,8 +70,13 @@ class TagReader {
                                 const pb::tagreader::SongMetadata& song) const;
   bool SaveSongRatingToFile(const QString& filename,
                             const pb::tagreader::SongMetadata& song) const;
+  // Writes the song's ReplayGain values as REPLAYGAIN_* tags.
+  bool SaveSongReplayGainToFile(const QString& filename,
+                                const pb::tagreader::SongMetadata& song) const;
 
-  bool IsMediaFile(const QString& filename) const;
+  bool IsMediaFile(
+      const QString& filename,
+      pb::tagreader::ReadMode mode = pb::tagreader::READ_FULL) const;
   QByteArray LoadEmbeddedArt(const QString& filename) const;
 
 #ifdef HAVE_GOOGLE_DRIVE
@@ -84,6 +92,8 @@ class TagReader {
 
   void ParseFMPSFrame(const QString& name, const QString& value,
                       pb::tagreader::SongMetadata* song) const;
+  void ParseReplayGain(const TagLib::PropertyMap& map,
+                       pb::tagreader::SongMetadata* song) const;
   void ParseOggTag(const TagLib::Ogg::FieldListMap& map,
                    const QTextCodec* codec, QString* disc, QString* compilation,
                    pb::tagreader::SongMetadata* song) const;
@@ -126,6 +136,9 @@ class TagReader {
   static int ConvertToPOPMRating(const float rating);
   static TagLib::ID3v2::PopularimeterFrame* GetPOPMFrameFromTag(
       TagLib::ID3v2::Tag* tag);
+  // True if the file's extension is one TagLib reads and its first bytes
+  // look like that kind of file.
+  static bool HasKnownMagic(const QString& filename);
 
   std::unique_ptr<FileRefFactory> factory_;
 
@@ -31,6 +31,8 @@
 #include <QEvent>
 #include <QPainter>
 #include <QPaintEvent>
+#include <QScreen>
+#include <QWindow>
 #include <QtDebug>
 
 #include "core/arraysize.h"
@@ -61,9 +63,18 @@ static const int sBarkBands[] = {
 
 static const int sBarkBandCount = arraysize(sBarkBands);
 
+const int Analyzer::Base::kIdleTimeoutMsec = 100;
+const int Analyzer::Base::kIdleStopMsec = 3000;
+const float Analyzer::Base::kSilenceLevel = 0.001f;
+
 Analyzer::Base::Base(QWidget* parent, uint scopeSize)
-    : QWidget(parent),
+    : Surface(parent),
       timeout_(40),  // msec
+      timer_interval_(0),
+      pacing_(Pacing_Active),
+      idle_msec_(0),
+      power_saving_(false),
+      exposed_(true),
       fht_(new FHT(scopeSize)),
       engine_(nullptr),
       lastScope_(512),
@@ -74,9 +85,79 @@ Analyzer::Base::Base(QWidget* parent, uint scopeSize)
       bands_(0),
       psychedelic_enabled_(false) {}
 
-void Analyzer::Base::hideEvent(QHideEvent*) { timer_.stop(); }
+void Analyzer::Base::set_engine(EngineBase* engine) {
+  if (engine_) disconnect(engine_, nullptr, this, nullptr);
+  engine_ = engine;
+  if (engine_) {
+    connect(engine_, SIGNAL(StateChanged(Engine::State)),
+            SLOT(EngineStateChanged(Engine::State)));
+  }
+}
+
+void Analyzer::Base::set_power_saving(bool enabled) {
+  power_saving_ = enabled;
+  SetPacing(Pacing_Active);
+}
+
+void Analyzer::Base::EngineStateChanged(Engine::State) {
+  SetPacing(Pacing_Active);
+  update();
+}
+
+void Analyzer::Base::hideEvent(QHideEvent*) { UpdateTimer(); }
+
+void Analyzer::Base::showEvent(QShowEvent*) {
+  // Covered or minimised windows get an expose event without being hidden.
+  if (QWindow* handle = window()->windowHandle()) {
+    handle->installEventFilter(this);
+    exposed_ = handle->isExposed();
+  }
+  UpdateTimer();
+}
+
+bool Analyzer::Base::eventFilter(QObject* object, QEvent* event) {
+  if (event->type() == QEvent::Expose &&
+      object == window()->windowHandle()) {
+    exposed_ = window()->windowHandle()->isExposed();
+    UpdateTimer();
+  }
+  return Surface::eventFilter(object, event);
+}
+
+int Analyzer::Base::ActiveTimeout() const {
+  int ret = timeout_;
+  const QWindow* handle = window()->windowHandle();
+  if (handle && handle->screen() && handle->screen()->refreshRate() > 0) {
+    ret = qMax(ret, qRound(1000 / handle->screen()->refreshRate()));
+  }
+  return ret;
+}
 
-void Analyzer::Base::showEvent(QShowEvent*) { timer_.start(timeout(), this); }
+void Analyzer::Base::SetPacing(Pacing pacing) {
+  if (pacing == Pacing_Active) idle_msec_ = 0;
+  if (pacing == pacing_) return;
+
+  pacing_ = pacing;
+  UpdateTimer();
+}
+
+void Analyzer::Base::UpdateTimer() {
+  int interval = 0;
+  if (isVisible() && exposed_) {
+    if (!power_saving_ || pacing_ == Pacing_Active) {
+      interval = ActiveTimeout();
+    } else if (pacing_ == Pacing_Idle) {
+      interval = kIdleTimeoutMsec;
+    }
+  }
+
+  if (interval == 0) {
+    timer_.stop();
+  } else if (!timer_.isActive() || interval != timer_interval_) {
+    timer_.start(interval, this);
+  }
+  timer_interval_ = interval;
+}
 
 void Analyzer::Base::transform(Scope& scope) {
   // this is a standard transformation that should give
@@ -99,11 +180,25 @@ void Analyzer::Base::transform(Scope& scope) {
   scope.resize(fht_->size() / 2);  // second half of values are rubbish
 }
 
+#ifdef HAVE_OPENGL_ANALYZERS
+void Analyzer::Base::paintGL() {
+  QPainter p(this);
+  paint(p, rect());
+}
+#else
 void Analyzer::Base::paintEvent(QPaintEvent* e) {
   QPainter p(this);
-  p.fillRect(e->rect(), palette().color(QPalette::Window));
+  paint(p, e->rect());
+}
+#endif
+
+void Analyzer::Base::paint(QPainter& p, const QRect& rect) {
+  p.fillRect(rect, palette().color(QPalette::Window));
 
-  switch (engine_->state()) {
+  const Engine::State state = engine_->state();
+  bool silent = true;
+
+  switch (state) {
     case Engine::Playing: {
       const Engine::Scope& thescope = engine_->scope(timeout_);
       int i = 0;
@@ -113,6 +208,7 @@ void Analyzer::Base::paintEvent(QPaintEvent* e) {
       for (uint x = 0; static_cast<int>(x) < fht_->size(); ++x) {
         lastScope_[x] = static_cast<double>(thescope[i] + thescope[i + 1]) /
                         (2 * (1 << 15));
+        if (std::abs(lastScope_[x]) >= kSilenceLevel) silent = false;
         i += 2;
       }
 
@@ -134,6 +230,20 @@ void Analyzer::Base::paintEvent(QPaintEvent* e) {
       demo(p);
   }
 
+  // Only count the frames the timer asked for, not repaints.
+  if (new_frame_) {
+    if (!silent) {
+      SetPacing(Pacing_Active);
+    } else {
+      // Paused and stopped analyzers are just decaying or showing the demo,
+      // but music might start again at any moment after a silent bit.
+      idle_msec_ += timer_interval_;
+      SetPacing(state != Engine::Playing && idle_msec_ >= kIdleStopMsec
+                    ? Pacing_Stopped
+                    : Pacing_Idle);
+    }
+  }
+
   new_frame_ = false;
 }
 
@@ -279,7 +389,7 @@ void Analyzer::initSin(Scope& v, const uint size) {
 }
 
 void Analyzer::Base::timerEvent(QTimerEvent* e) {
-  QWidget::timerEvent(e);
+  Surface::timerEvent(e);
   if (e->timerId() != timer_.timerId()) return;
 
   new_frame_ = true;
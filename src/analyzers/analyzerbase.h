@@ -40,6 +40,10 @@
 #include <QWidget>
 #include <vector>
 
+#ifdef HAVE_OPENGL_ANALYZERS
+#include <QOpenGLWidget>
+#endif
+
 #ifdef HAVE_OPENGL
 #include <QGLWidget>
 #ifdef Q_OS_MACX
@@ -59,7 +63,15 @@ namespace Analyzer {
 
 typedef std::vector<float> Scope;
 
-class Base : public QWidget {
+// Analyzers paint with QPainter either way, but on an OpenGL surface that's
+// done by the GPU, and they can also draw with OpenGL directly.
+#ifdef HAVE_OPENGL_ANALYZERS
+typedef QOpenGLWidget Surface;
+#else
+typedef QWidget Surface;
+#endif
+
+class Base : public Surface {
   Q_OBJECT
 
  public:
@@ -67,26 +79,43 @@ class Base : public QWidget {
 
   uint timeout() const { return timeout_; }
 
-  void set_engine(EngineBase* engine) { engine_ = engine; }
+  void set_engine(EngineBase* engine);
 
   void changeTimeout(uint newTimeout) {
     timeout_ = newTimeout;
-    if (timer_.isActive()) {
-      timer_.stop();
-      timer_.start(timeout_, this);
-    }
+    UpdateTimer();
   }
 
+  // When power saving is on the analyzer slows down while nothing is
+  // playing or it's silent, and stops altogether a few seconds after
+  // playback stops or pauses.  It always stops when it can't be seen.
+  void set_power_saving(bool enabled);
+
   virtual void framerateChanged() {}
   virtual void psychedelicModeChanged(bool);
 
  protected:
   explicit Base(QWidget*, uint scopeSize = 7);
 
+  // Interval between frames while idle with power saving on.
+  static const int kIdleTimeoutMsec;
+  // How long to stay idle before stopping with power saving on.
+  static const int kIdleStopMsec;
+  // Samples quieter than this count as silence.
+  static const float kSilenceLevel;
+
+  enum Pacing { Pacing_Active, Pacing_Idle, Pacing_Stopped };
+
   void hideEvent(QHideEvent*);
   void showEvent(QShowEvent*);
+  bool eventFilter(QObject* object, QEvent* event);
+#ifdef HAVE_OPENGL_ANALYZERS
+  void paintGL();
+#else
   void paintEvent(QPaintEvent*);
+#endif
   void timerEvent(QTimerEvent*);
+  void paint(QPainter& p, const QRect& rect);
 
   void polishEvent();
 
@@ -95,6 +124,11 @@ class Base : public QWidget {
   int BandFrequency(int) const;
   void updateBandSize(const int);
   QColor getPsychedelicColor(const Scope&, const int, const int);
+  // Starts, restarts or stops the timer to suit the current pacing.
+  void UpdateTimer();
+  // timeout_, but no faster than the screen can show the frames.
+  int ActiveTimeout() const;
+  void SetPacing(Pacing pacing);
   virtual void init() {}
   virtual void transform(Scope&);
   virtual void analyze(QPainter& p, const Scope&, bool new_frame) = 0;
@@ -106,6 +140,11 @@ class Base : public QWidget {
 
   QBasicTimer timer_;
   uint timeout_;
+  int timer_interval_;
+  Pacing pacing_;
+  int idle_msec_;
+  bool power_saving_;
+  bool exposed_;
   FHT* fht_;
   EngineBase* engine_;
   Scope lastScope_;
@@ -118,6 +157,9 @@ class Base : public QWidget {
   int prev_color_index_;
   int bands_;
   bool psychedelic_enabled_;
+
+ private slots:
+  void EngineStateChanged(Engine::State state);
 };
 
 void interpolate(const Scope&, Scope&);
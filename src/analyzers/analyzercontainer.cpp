@@ -55,6 +55,7 @@ AnalyzerContainer::AnalyzerContainer(QWidget* parent)
       double_click_timer_(new QTimer(this)),
       ignore_next_click_(false),
       psychedelic_colors_on_(false),
+      power_saving_on_(true),
       current_analyzer_(nullptr),
       engine_(nullptr) {
   QHBoxLayout* layout = new QHBoxLayout(this);
@@ -88,6 +89,9 @@ AnalyzerContainer::AnalyzerContainer(QWidget* parent)
   psychedelic_enable_ = context_menu_->addAction(
       tr("Use Psychedelic Colors"), this, SLOT(TogglePsychedelicColors()));
   psychedelic_enable_->setCheckable(true);
+  power_saving_enable_ = context_menu_->addAction(
+      tr("Save power when idle"), this, SLOT(TogglePowerSaving()));
+  power_saving_enable_->setCheckable(true);
 
   context_menu_->addSeparator();
   // Visualisation action gets added in SetActions
@@ -154,6 +158,14 @@ void AnalyzerContainer::TogglePsychedelicColors() {
   SavePsychedelic();
 }
 
+void AnalyzerContainer::TogglePowerSaving() {
+  power_saving_on_ = !power_saving_on_;
+  if (current_analyzer_) {
+    current_analyzer_->set_power_saving(power_saving_on_);
+  }
+  SavePowerSaving();
+}
+
 void AnalyzerContainer::ChangeAnalyzer(int id) {
   QObject* instance =
       analyzer_types_[id]->newInstance(Q_ARG(QWidget*, this));
@@ -172,6 +184,7 @@ void AnalyzerContainer::ChangeAnalyzer(int id) {
       current_framerate_ == 0 ? kMediumFramerate : current_framerate_;
   current_analyzer_->changeTimeout(1000 / current_framerate_);
   current_analyzer_->psychedelicModeChanged(psychedelic_colors_on_);
+  current_analyzer_->set_power_saving(power_saving_on_);
 
   layout()->addWidget(current_analyzer_);
 
@@ -198,6 +211,10 @@ void AnalyzerContainer::Load() {
   psychedelic_colors_on_ = s.value("psychedelic", false).toBool();
   psychedelic_enable_->setChecked(psychedelic_colors_on_);
 
+  // Power saving
+  power_saving_on_ = s.value("power_saving", true).toBool();
+  power_saving_enable_->setChecked(power_saving_on_);
+
   // Analyzer
   QString type = s.value("type", "BlockAnalyzer").toString();
   if (type.isEmpty()) {
@@ -249,6 +266,13 @@ void AnalyzerContainer::SavePsychedelic() {
   s.setValue("psychedelic", psychedelic_colors_on_);
 }
 
+void AnalyzerContainer::SavePowerSaving() {
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+
+  s.setValue("power_saving", power_saving_on_);
+}
+
 void AnalyzerContainer::AddFramerate(const QString& name, int framerate) {
   QAction* action = context_menu_framerate_->addAction(name);
   group_framerate_->addAction(action);
@@ -54,6 +54,7 @@ signals:
   void DisableAnalyzer();
   void ShowPopupMenu();
   void TogglePsychedelicColors();
+  void TogglePowerSaving();
 
  private:
   static const int kLowFramerate;
@@ -65,6 +66,7 @@ signals:
   void Save();
   void SaveFramerate(int framerate);
   void SavePsychedelic();
+  void SavePowerSaving();
   template <typename T>
   void AddAnalyzerType();
   void AddFramerate(const QString& name, int framerate);
@@ -81,12 +83,14 @@ signals:
   QList<QAction*> actions_;
   QAction* disable_action_;
   QAction* psychedelic_enable_;
+  QAction* power_saving_enable_;
 
   QAction* visualisation_action_;
   QTimer* double_click_timer_;
   QPoint last_click_pos_;
   bool ignore_next_click_;
   bool psychedelic_colors_on_;
+  bool power_saving_on_;
 
   Analyzer::Base* current_analyzer_;
   EngineBase* engine_;
@@ -66,7 +66,7 @@ BlockAnalyzer::BlockAnalyzer(QWidget* parent)
 BlockAnalyzer::~BlockAnalyzer() {}
 
 void BlockAnalyzer::resizeEvent(QResizeEvent* e) {
-  QWidget::resizeEvent(e);
+  Analyzer::Base::resizeEvent(e);
 
   background_ = QPixmap(size());
   canvas_ = QPixmap(size());
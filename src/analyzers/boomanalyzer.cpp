@@ -23,6 +23,7 @@
  */
 
 #include "boomanalyzer.h"
+#include <algorithm>
 #include <cmath>
 #include <QPainter>
 
@@ -48,9 +49,23 @@ BoomAnalyzer::BoomAnalyzer(QWidget* parent)
       bar_height_(kMaxBandCount, 0),
       peak_height_(kMaxBandCount, 0),
       peak_speed_(kMaxBandCount, 0.01),
-      barPixmap_(kColumnWidth, 50) {
+      barPixmap_(kColumnWidth, 50),
+      drawn_bar_height_(kMaxBandCount, -1),
+      drawn_peak_height_(kMaxBandCount, -1) {
   setMinimumWidth(kMinBandCount * (kColumnWidth + 1) - 1);
   setMaximumWidth(kMaxBandCount * (kColumnWidth + 1) - 1);
+#ifdef HAVE_OPENGL_ANALYZERS
+  bar_renderer_.reset(new GLBarRenderer);
+#endif
+}
+
+BoomAnalyzer::~BoomAnalyzer() {
+#ifdef HAVE_OPENGL_ANALYZERS
+  // The renderer's textures belong to our context.
+  makeCurrent();
+  bar_renderer_.reset();
+  doneCurrent();
+#endif
 }
 
 void BoomAnalyzer::changeK_barHeight(int newValue) {
@@ -62,7 +77,7 @@ void BoomAnalyzer::changeF_peakSpeed(int newValue) {
 }
 
 void BoomAnalyzer::resizeEvent(QResizeEvent* e) {
-  QWidget::resizeEvent(e);
+  Analyzer::Base::resizeEvent(e);
 
   const uint HEIGHT = height() - 2;
   const double h = 1.2 / HEIGHT;
@@ -78,6 +93,9 @@ void BoomAnalyzer::resizeEvent(QResizeEvent* e) {
   barPixmap_ = QPixmap(kColumnWidth - 2, HEIGHT);
   canvas_ = QPixmap(size());
   canvas_.fill(palette().color(QPalette::Background));
+  drawn_background_ = palette().color(QPalette::Background);
+  std::fill(drawn_bar_height_.begin(), drawn_bar_height_.end(), -1);
+  std::fill(drawn_peak_height_.begin(), drawn_peak_height_.end(), -1);
 
   QPainter p(&barPixmap_);
   for (uint y = 0; y < HEIGHT; ++y) {
@@ -92,6 +110,31 @@ void BoomAnalyzer::resizeEvent(QResizeEvent* e) {
   updateBandSize(bands_);
 }
 
+void BoomAnalyzer::PrepareCanvas() {
+  const QColor background = palette().color(QPalette::Background);
+  if (fg_ == drawn_fg_ && background == drawn_background_) return;
+
+  canvas_.fill(background);
+  drawn_fg_ = fg_;
+  drawn_background_ = background;
+  std::fill(drawn_bar_height_.begin(), drawn_bar_height_.end(), -1);
+  std::fill(drawn_peak_height_.begin(), drawn_peak_height_.end(), -1);
+}
+
+bool BoomAnalyzer::ClearBandIfChanged(QPainter& canvas_painter, uint i,
+                                      uint x) {
+  const int bar = static_cast<int>(bar_height_[i]);
+  const int peak = static_cast<int>(peak_height_[i]);
+  if (bar == drawn_bar_height_[i] && peak == drawn_peak_height_[i]) {
+    return false;
+  }
+
+  drawn_bar_height_[i] = bar;
+  drawn_peak_height_[i] = peak;
+  canvas_painter.fillRect(x, 0, kColumnWidth, height(), drawn_background_);
+  return true;
+}
+
 void BoomAnalyzer::transform(Scope& s) {
   fht_->spectrum(s.data());
   fht_->scale(s.data(), 1.0 / 50);
@@ -102,15 +145,12 @@ void BoomAnalyzer::transform(Scope& s) {
 
 void BoomAnalyzer::analyze(QPainter& p, const Scope& scope, bool new_frame) {
   if (!new_frame || engine_->state() == Engine::Paused) {
-    p.drawPixmap(0, 0, canvas_);
+    DrawBars(p, false);
     return;
   }
   float h;
   const uint MAX_HEIGHT = height() - 1;
 
-  QPainter canvas_painter(&canvas_);
-  canvas_.fill(palette().color(QPalette::Background));
-
   Analyzer::interpolate(scope, scope_);
 
   // update the graphics with the new colour
@@ -118,7 +158,7 @@ void BoomAnalyzer::analyze(QPainter& p, const Scope& scope, bool new_frame) {
     paletteChange(QPalette());
   }
 
-  for (uint i = 0, x = 0, y; i < bands_; ++i, x += kColumnWidth + 1) {
+  for (uint i = 0; i < bands_; ++i) {
     h = log10(scope_[i] * 256.0) * F_;
 
     if (h > MAX_HEIGHT) h = MAX_HEIGHT;
@@ -148,20 +188,52 @@ void BoomAnalyzer::analyze(QPainter& p, const Scope& scope, bool new_frame) {
         if (peak_height_[i] < 0.0) peak_height_[i] = 0.0;
       }
     }
+  }
 
-    y = height() - uint(bar_height_[i]);
-    canvas_painter.drawPixmap(x + 1, y, barPixmap_, 0, y, -1, -1);
-    canvas_painter.setPen(fg_);
-    if (bar_height_[i] > 0)
-      canvas_painter.drawRect(x, y, kColumnWidth - 1, height() - y - 1);
+  DrawBars(p, true);
+}
 
-    y = height() - uint(peak_height_[i]);
-    canvas_painter.setPen(palette().color(QPalette::Midlight));
-    canvas_painter.drawLine(x, y, x + kColumnWidth - 1, y);
+#ifdef HAVE_OPENGL_ANALYZERS
+void BoomAnalyzer::DrawBars(QPainter& p, bool) {
+  GLBarRenderer::Style style;
+  style.column_width = kColumnWidth;
+  style.background = palette().color(QPalette::Background);
+  style.outline = fg_;
+  style.peak = palette().color(QPalette::Midlight);
+  // The same gradient as barPixmap_
+  style.gradient_top = QColor(255, 255, 255);
+  style.gradient_bottom = QColor(26, 26, 64);
+  style.gradient_scale = 1.2;
+
+  p.beginNativePainting();
+  bar_renderer_->Draw(size(), devicePixelRatioF(), style, bar_height_,
+                     peak_height_, bands_);
+  p.endNativePainting();
+}
+#else
+void BoomAnalyzer::DrawBars(QPainter& p, bool changed) {
+  if (changed) {
+    PrepareCanvas();
+    QPainter canvas_painter(&canvas_);
+
+    for (uint i = 0, x = 0, y; i < bands_; ++i, x += kColumnWidth + 1) {
+      if (!ClearBandIfChanged(canvas_painter, i, x)) continue;
+
+      y = height() - uint(bar_height_[i]);
+      canvas_painter.drawPixmap(x + 1, y, barPixmap_, 0, y, -1, -1);
+      canvas_painter.setPen(fg_);
+      if (bar_height_[i] > 0)
+        canvas_painter.drawRect(x, y, kColumnWidth - 1, height() - y - 1);
+
+      y = height() - uint(peak_height_[i]);
+      canvas_painter.setPen(palette().color(QPalette::Midlight));
+      canvas_painter.drawLine(x, y, x + kColumnWidth - 1, y);
+    }
   }
 
   p.drawPixmap(0, 0, canvas_);
 }
+#endif
 
 void BoomAnalyzer::psychedelicModeChanged(bool enabled) {
   psychedelic_enabled_ = enabled;
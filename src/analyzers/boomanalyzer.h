@@ -27,11 +27,18 @@
 
 #include "analyzerbase.h"
 
+#include <memory>
+
+#ifdef HAVE_OPENGL_ANALYZERS
+#include "glbarrenderer.h"
+#endif
+
 class BoomAnalyzer : public Analyzer::Base {
   Q_OBJECT
 
  public:
   Q_INVOKABLE BoomAnalyzer(QWidget*);
+  ~BoomAnalyzer();
 
   static const char* kName;
 
@@ -46,6 +53,13 @@ class BoomAnalyzer : public Analyzer::Base {
  protected:
   void resizeEvent(QResizeEvent* e);
   void paletteChange(const QPalette&);
+  // changed is false if the bars haven't moved since they were last drawn.
+  void DrawBars(QPainter& p, bool changed);
+  // Refills canvas_ if the colours have changed since it was last drawn.
+  void PrepareCanvas();
+  // Returns true if band i has moved since it was last drawn on canvas_,
+  // and clears its column so it can be drawn again.
+  bool ClearBandIfChanged(QPainter& canvas_painter, uint i, uint x);
 
   static const uint kColumnWidth;
   static const uint kMaxBandCount;
@@ -63,6 +77,15 @@ class BoomAnalyzer : public Analyzer::Base {
 
   QPixmap barPixmap_;
   QPixmap canvas_;
+  // What canvas_ currently shows, so only the bands that moved are redrawn.
+  std::vector<int> drawn_bar_height_;
+  std::vector<int> drawn_peak_height_;
+  QColor drawn_fg_;
+  QColor drawn_background_;
+
+#ifdef HAVE_OPENGL_ANALYZERS
+  std::unique_ptr<GLBarRenderer> bar_renderer_;
+#endif
 };
 
 #endif  // ANALYZERS_BOOMANALYZER_H_
@@ -23,6 +23,116 @@
 #include <cmath>
 #include "fht.h"
 
+// The kernels below work on four floats at a time where SSE2 or NEON is
+// available.  Both are part of the baseline on x86-64 and AArch64, so they're
+// chosen when compiling rather than at runtime.
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FHT_SIMD
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FHT_SIMD
+#endif
+
+namespace {
+
+#if defined(__SSE2__)
+typedef __m128 float4;
+inline float4 Load(const float* p) { return _mm_loadu_ps(p); }
+inline void Store(float* p, float4 v) { _mm_storeu_ps(p, v); }
+inline float4 Splat(float f) { return _mm_set1_ps(f); }
+inline float4 Add(float4 a, float4 b) { return _mm_add_ps(a, b); }
+inline float4 Sub(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+inline float4 Mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+
+// Loads p[3], p[2], p[1], p[0].
+inline float4 LoadReversed(const float* p) {
+  float4 v = _mm_loadu_ps(p);
+  return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+// Loads p[0], p[2], p[4], p[6] and p[1], p[3], p[5], p[7].
+inline void LoadDeinterleaved(const float* p, float4* even, float4* odd) {
+  float4 a = _mm_loadu_ps(p);
+  float4 b = _mm_loadu_ps(p + 4);
+  *even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+  *odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+}
+#elif defined(__ARM_NEON)
+typedef float32x4_t float4;
+inline float4 Load(const float* p) { return vld1q_f32(p); }
+inline void Store(float* p, float4 v) { vst1q_f32(p, v); }
+inline float4 Splat(float f) { return vdupq_n_f32(f); }
+inline float4 Add(float4 a, float4 b) { return vaddq_f32(a, b); }
+inline float4 Sub(float4 a, float4 b) { return vsubq_f32(a, b); }
+inline float4 Mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+
+inline float4 LoadReversed(const float* p) {
+  float4 v = vrev64q_f32(vld1q_f32(p));
+  return vcombine_f32(vget_high_f32(v), vget_low_f32(v));
+}
+
+inline void LoadDeinterleaved(const float* p, float4* even, float4* odd) {
+  float32x4x2_t v = vld2q_f32(p);
+  *even = v.val[0];
+  *odd = v.val[1];
+}
+#endif
+
+// even[i] = p[2i], odd[i] = p[2i + 1]
+void Deinterleave(const float* p, float* even, float* odd, int n) {
+  int i = 0;
+#ifdef FHT_SIMD
+  for (; i + 4 <= n; i += 4) {
+    float4 e, o;
+    LoadDeinterleaved(p + 2 * i, &e, &o);
+    Store(even + i, e);
+    Store(odd + i, o);
+  }
+#endif
+  for (; i < n; i++) {
+    even[i] = p[2 * i];
+    odd[i] = p[2 * i + 1];
+  }
+}
+
+// a = costab[i] * x[i] + sintab[i] * rev[-i],
+// sum[i] = y[i] + a and diff[i] = y[i] - a for i from 1 to n - 1.
+void Butterfly(const float* y, const float* x, const float* rev,
+               const float* costab, const float* sintab, float* sum,
+               float* diff, int n) {
+  int i = 1;
+#ifdef FHT_SIMD
+  for (; i + 4 <= n; i += 4) {
+    float4 a = Add(Mul(Load(costab + i), Load(x + i)),
+                   Mul(Load(sintab + i), LoadReversed(rev - i - 3)));
+    float4 v = Load(y + i);
+    Store(sum + i, Add(v, a));
+    Store(diff + i, Sub(v, a));
+  }
+#endif
+  for (; i < n; i++) {
+    float a = costab[i] * x[i] + sintab[i] * rev[-i];
+    sum[i] = y[i] + a;
+    diff[i] = y[i] - a;
+  }
+}
+
+// p[i] = p[i]^2 + rev[-i]^2 for i from 1 to n - 1.
+void SumOfSquares(float* p, const float* rev, int n) {
+  int i = 1;
+#ifdef FHT_SIMD
+  for (; i + 4 <= n; i += 4) {
+    float4 v = Load(p + i);
+    float4 r = LoadReversed(rev - i - 3);
+    Store(p + i, Add(Mul(v, v), Mul(r, r)));
+  }
+#endif
+  for (; i < n; i++) p[i] = p[i] * p[i] + rev[-i] * rev[-i];
+}
+
+}  // namespace
+
 FHT::FHT(int n) : num_((n < 3) ? 0 : 1 << n), exp2_((n < 3) ? -1 : n) {
   if (n > 3) {
     buf_vector_.resize(num_);
@@ -52,16 +162,42 @@ void FHT::makeCasTable(void) {
     sintab += 2;
     if (sintab > tab_() + num_ * 2) sintab = tab_() + 1;
   }
+
+  // Each step of _transform uses every (num_ / ndiv2)th pair of values, so
+  // give each step its own contiguous copy of the ones it needs.  The step
+  // for n values starts at n - 16.
+  level_tab_vector_.resize(num_ * 2 - 16);
+  for (int n = 16; n <= num_; n *= 2) {
+    const int ndiv2 = n / 2;
+    const int stride = num_ / ndiv2;
+    float* level = level_tab_vector_.data() + n - 16;
+    for (int i = 0; i < ndiv2; i++) {
+      level[i] = tab_vector_[i * stride];
+      level[ndiv2 + i] = tab_vector_[i * stride + 1];
+    }
+  }
 }
 
 void FHT::scale(float* p, float d) {
-  for (int i = 0; i < (num_ / 2); i++) *p++ *= d;
+  int i = 0;
+#ifdef FHT_SIMD
+  const float4 dv = Splat(d);
+  for (; i + 4 <= num_ / 2; i += 4) Store(p + i, Mul(Load(p + i), dv));
+#endif
+  for (; i < (num_ / 2); i++) p[i] *= d;
 }
 
 void FHT::ewma(float* d, float* s, float w) {
-  for (int i = 0; i < (num_ / 2); i++, d++, s++) *d = *d * w + *s * (1 - w);
+  int i = 0;
+#ifdef FHT_SIMD
+  const float4 wv = Splat(w);
+  const float4 w1v = Splat(1 - w);
+  for (; i + 4 <= num_ / 2; i += 4) {
+    Store(d + i, Add(Mul(Load(d + i), wv), Mul(Load(s + i), w1v)));
+  }
+#endif
+  for (; i < (num_ / 2); i++) d[i] = d[i] * w + s[i] * (1 - w);
 }
-
 void FHT::logSpectrum(float* out, float* p) {
   int n = num_ / 2, i, j, k, *r;
   if (log_vector_.size() < n) {
@@ -89,34 +225,28 @@ void FHT::logSpectrum(float* out, float* p) {
 void FHT::semiLogSpectrum(float* p) {
   power2(p);
   for (int i = 0; i < (num_ / 2); i++, p++) {
-    float e = 10.0 * log10(sqrt(*p / 2));
+    // 10 * log10(sqrt(x)) without the sqrt
+    float e = 5.0f * std::log10(*p / 2);
     *p = e < 0 ? 0 : e;
   }
 }
 
 void FHT::spectrum(float* p) {
   power2(p);
-  for (int i = 0; i < (num_ / 2); i++, p++)
-    *p = static_cast<float>(sqrt(*p / 2));
+  scale(p, 0.5f);
+  for (int i = 0; i < (num_ / 2); i++) p[i] = std::sqrt(p[i]);
 }
 
 void FHT::power(float* p) {
   power2(p);
-  for (int i = 0; i < (num_ / 2); i++) *p++ /= 2;
+  scale(p, 0.5f);
 }
 
 void FHT::power2(float* p) {
   _transform(p, num_, 0);
 
-  *p = static_cast<float>(2 * pow(*p, 2));
-  p++;
-
-  float* q = p + num_ - 2;
-  for (int i = 1; i < (num_ / 2); i++) {
-    *p = static_cast<float>(pow(*p, 2) + pow(*q, 2));
-    p++;
-    q--;
-  }
+  p[0] = 2 * p[0] * p[0];
+  SumOfSquares(p, p + num_, num_ / 2);
 }
 
 void FHT::transform(float* p) {
@@ -159,38 +289,25 @@ void FHT::_transform(float* p, int n, int k) {
     return;
   }
 
-  int i, j, ndiv2 = n / 2;
-  float a, *t1, *t2, *t3, *t4, *ptab, *pp;
+  const int ndiv2 = n / 2;
+  float* pp = p + k;
+  float* t1 = buf_();
+  float* t2 = buf_() + ndiv2;
 
-  for (i = 0, t1 = buf_(), t2 = buf_() + ndiv2, pp = &p[k]; i < ndiv2; i++)
-    *t1++ = *pp++, *t2++ = *pp++;
-
-  std::copy(buf_(), buf_() + n, p + k);
+  Deinterleave(pp, t1, t2, ndiv2);
+  std::copy(buf_(), buf_() + n, pp);
 
   _transform(p, ndiv2, k);
   _transform(p, ndiv2, k + ndiv2);
 
-  j = num_ / ndiv2 - 1;
-  t1 = buf_();
-  t2 = t1 + ndiv2;
-  t3 = p + k + ndiv2;
-  ptab = tab_();
-  pp = p + k;
-
-  a = *ptab++ * *t3++;
-  a += *ptab * *pp;
-  ptab += j;
+  const float* costab = level_tab_vector_.data() + n - 16;
+  const float* sintab = costab + ndiv2;
+  const float* t3 = pp + ndiv2;
 
-  *t1++ = *pp + a;
-  *t2++ = *pp++ - a;
-
-  for (i = 1, t4 = p + k + n; i < ndiv2; i++, ptab += j) {
-    a = *ptab++ * *t3++;
-    a += *ptab * *--t4;
-
-    *t1++ = *pp + a;
-    *t2++ = *pp++ - a;
-  }
+  float a = costab[0] * t3[0] + sintab[0] * pp[0];
+  t1[0] = pp[0] + a;
+  t2[0] = pp[0] - a;
+  Butterfly(pp, t3, pp + n, costab, sintab, t1, t2, ndiv2);
 
-  std::copy(buf_(), buf_() + n, p + k);
+  std::copy(buf_(), buf_() + n, pp);
 }
@@ -39,6 +39,7 @@ class FHT {
 
   QVector<float> buf_vector_;
   QVector<float> tab_vector_;
+  QVector<float> level_tab_vector_;
   QVector<int> log_vector_;
 
   float* buf_();
@@ -0,0 +1,181 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "glbarrenderer.h"
+
+#include "core/logging.h"
+
+namespace {
+
+const char* kVertexShader =
+    "attribute vec2 position;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(position, 0.0, 1.0);\n"
+    "}\n";
+
+// Each texel holds a bar's height in R and G and its peak in B and A, as
+// 16 bit fractions of the viewport height.
+const char* kFragmentShader =
+    "#ifdef GL_ES\n"
+    "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+    "precision highp float;\n"
+    "#else\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "#endif\n"
+    "uniform sampler2D heights;\n"
+    "uniform float bands;\n"
+    "uniform float ratio;\n"
+    "uniform float height;\n"
+    "uniform float column;\n"
+    "uniform vec4 background;\n"
+    "uniform vec4 outline;\n"
+    "uniform vec4 peak;\n"
+    "uniform vec4 gradient_top;\n"
+    "uniform vec4 gradient_bottom;\n"
+    "uniform float gradient_scale;\n"
+    "\n"
+    "float Decode(vec2 v) {\n"
+    "  return floor((v.x * 65280.0 + v.y * 255.0) / 65535.0 * height + 0.5);\n"
+    "}\n"
+    "\n"
+    "void main() {\n"
+    "  vec2 px = floor(gl_FragCoord.xy / ratio);\n"
+    "  float band = floor(px.x / (column + 1.0));\n"
+    "  float x = px.x - band * (column + 1.0);\n"
+    "  float y = px.y;\n"
+    "  vec4 colour = background;\n"
+    "  if (band < bands && x < column) {\n"
+    "    vec4 t = texture2D(heights, vec2((band + 0.5) / bands, 0.5));\n"
+    "    float bar = Decode(t.rg);\n"
+    "    if (y < bar) {\n"
+    "      if (x == 0.0 || x == column - 1.0 || y == 0.0 || y == bar - 1.0) {\n"
+    "        colour = outline;\n"
+    "      } else {\n"
+    "        float f = (height - 1.0 - y) / height * gradient_scale;\n"
+    "        colour = clamp(mix(gradient_top, gradient_bottom, f), 0.0, 1.0);\n"
+    "      }\n"
+    "    }\n"
+    "    if (y == Decode(t.ba) - 1.0) colour = peak;\n"
+    "  }\n"
+    "  gl_FragColor = colour;\n"
+    "}\n";
+
+const GLfloat kQuad[] = {-1.0, -1.0, 1.0, -1.0, -1.0, 1.0, 1.0, 1.0};
+
+void Encode(float value, float height, unsigned char* texel) {
+  const int v = qBound(0, static_cast<int>(value / height * 65535), 65535);
+  texel[0] = v >> 8;
+  texel[1] = v & 0xff;
+}
+
+}  // namespace
+
+GLBarRenderer::GLBarRenderer()
+    : initialised_(false),
+      vertices_(QOpenGLBuffer::VertexBuffer),
+      texture_(0),
+      texture_width_(0) {}
+
+GLBarRenderer::~GLBarRenderer() {
+  if (texture_) glDeleteTextures(1, &texture_);
+  vertices_.destroy();
+}
+
+bool GLBarRenderer::Init() {
+  initializeOpenGLFunctions();
+
+  program_.reset(new QOpenGLShaderProgram);
+  program_->bindAttributeLocation("position", 0);
+  if (!program_->addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                         kVertexShader) ||
+      !program_->addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                         kFragmentShader) ||
+      !program_->link()) {
+    qLog(Warning) << "Couldn't build the analyzer shaders" << program_->log();
+    return false;
+  }
+
+  if (!vertices_.create()) return false;
+  vertices_.bind();
+  vertices_.allocate(kQuad, sizeof(kQuad));
+  vertices_.release();
+
+  glGenTextures(1, &texture_);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return true;
+}
+
+void GLBarRenderer::Draw(const QSize& size, qreal device_pixel_ratio,
+                         const Style& style, const std::vector<float>& bars,
+                         const std::vector<float>& peaks, int count) {
+  if (!initialised_) {
+    initialised_ = true;
+    if (!Init()) program_.reset();
+  }
+  if (!program_ || size.isEmpty()) return;
+
+  count = qMin(count, static_cast<int>(qMin(bars.size(), peaks.size())));
+  if (count <= 0) return;
+
+  const float height = size.height();
+  texels_.resize(count * 4);
+  for (int i = 0; i < count; ++i) {
+    Encode(bars[i], height, &texels_[i * 4]);
+    Encode(peaks[i], height, &texels_[i * 4 + 2]);
+  }
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  if (count != texture_width_) {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, count, 1, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, texels_.data());
+    texture_width_ = count;
+  } else {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, count, 1, GL_RGBA,
+                    GL_UNSIGNED_BYTE, texels_.data());
+  }
+
+  program_->bind();
+  program_->setUniformValue("heights", 0);
+  program_->setUniformValue("bands", static_cast<GLfloat>(count));
+  program_->setUniformValue("ratio", static_cast<GLfloat>(device_pixel_ratio));
+  program_->setUniformValue("height", height);
+  program_->setUniformValue("column",
+                            static_cast<GLfloat>(style.column_width));
+  program_->setUniformValue("background", style.background);
+  program_->setUniformValue("outline", style.outline);
+  program_->setUniformValue("peak", style.peak);
+  program_->setUniformValue("gradient_top", style.gradient_top);
+  program_->setUniformValue("gradient_bottom", style.gradient_bottom);
+  program_->setUniformValue("gradient_scale", style.gradient_scale);
+
+  vertices_.bind();
+  program_->enableAttributeArray(0);
+  program_->setAttributeBuffer(0, GL_FLOAT, 0, 2);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  program_->disableAttributeArray(0);
+  vertices_.release();
+
+  program_->release();
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
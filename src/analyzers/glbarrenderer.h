@@ -0,0 +1,72 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ANALYZERS_GLBARRENDERER_H_
+#define ANALYZERS_GLBARRENDERER_H_
+
+#include <memory>
+#include <vector>
+
+#include <QColor>
+#include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QSize>
+
+// Draws a row of outlined bars with peak markers in a single pass.  The bar
+// and peak heights are uploaded as a one row texture and the fragment shader
+// works out what colour each pixel is, so the CPU only does one draw call per
+// frame whatever the number of bars.
+//
+// Must be used with the same OpenGL context current every time, including
+// when it's destroyed.
+class GLBarRenderer : protected QOpenGLFunctions {
+ public:
+  struct Style {
+    int column_width;  // Plus a one pixel gap between columns
+    QColor background;
+    QColor outline;
+    QColor peak;
+
+    // The inside of each bar fades from gradient_top at the top of the widget
+    // to gradient_bottom at 1/gradient_scale of the way down.
+    QColor gradient_top;
+    QColor gradient_bottom;
+    float gradient_scale;
+  };
+
+  GLBarRenderer();
+  ~GLBarRenderer();
+
+  // Heights are in pixels from the bottom of the viewport.  size is in device
+  // independent pixels, like the widget's.
+  void Draw(const QSize& size, qreal device_pixel_ratio, const Style& style,
+            const std::vector<float>& bars, const std::vector<float>& peaks,
+            int count);
+
+ private:
+  bool Init();
+
+  bool initialised_;
+  std::unique_ptr<QOpenGLShaderProgram> program_;
+  QOpenGLBuffer vertices_;
+  GLuint texture_;
+  int texture_width_;
+  std::vector<unsigned char> texels_;
+};
+
+#endif  // ANALYZERS_GLBARRENDERER_H_
@@ -32,12 +32,12 @@ const char* Sonogram::kName =
     QT_TRANSLATE_NOOP("AnalyzerContainer", "Sonogram");
 
 Sonogram::Sonogram(QWidget* parent)
-    : Analyzer::Base(parent, 9), scope_size_(128) {}
+    : Analyzer::Base(parent, 9), canvas_pos_(0), scope_size_(128) {}
 
 Sonogram::~Sonogram() {}
 
 void Sonogram::resizeEvent(QResizeEvent* e) {
-  QWidget::resizeEvent(e);
+  Analyzer::Base::resizeEvent(e);
 
 // only for gcc < 4.0
 #if !(__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 0))
@@ -46,6 +46,8 @@ void Sonogram::resizeEvent(QResizeEvent* e) {
 
   canvas_ = QPixmap(size());
   canvas_.fill(palette().color(QPalette::Background));
+  canvas_pos_ = 0;
+  column_ = QImage(1, height(), QImage::Format_RGB32);
   updateBandSize(scope_size_);
 }
 
@@ -55,16 +57,13 @@ void Sonogram::psychedelicModeChanged(bool enabled) {
 }
 
 void Sonogram::analyze(QPainter& p, const Scope& s, bool new_frame) {
-  if (!new_frame || engine_->state() == Engine::Paused) {
-    p.drawPixmap(0, 0, canvas_);
+  if (!new_frame || engine_->state() == Engine::Paused || canvas_.isNull()) {
+    DrawCanvas(p);
     return;
   }
 
-  int x = width() - 1;
   QColor c;
-
-  QPainter canvas_painter(&canvas_);
-  canvas_painter.drawPixmap(0, 0, canvas_, 1, 0, x, -1);
+  column_.fill(palette().color(QPalette::Background));
 
   Scope::const_iterator it = s.begin(), end = s.end();
   if (scope_size_ != s.size()) {
@@ -85,8 +84,7 @@ void Sonogram::analyze(QPainter& p, const Scope& s, bool new_frame) {
         c = getPsychedelicColor(s, 10, 50);
       }
 
-      canvas_painter.setPen(c);
-      canvas_painter.drawPoint(x, y--);
+      column_.setPixel(0, y--, c.rgb());
 
       if (it < end) ++it;
     }
@@ -101,16 +99,27 @@ void Sonogram::analyze(QPainter& p, const Scope& s, bool new_frame) {
       else
         c = Qt::red;
 
-      canvas_painter.setPen(c);
-      canvas_painter.drawPoint(x, y--);
+      column_.setPixel(0, y--, c.rgb());
 
       if (it < end) ++it;
     }
   }
 
+  QPainter canvas_painter(&canvas_);
+  canvas_painter.drawImage(canvas_pos_, 0, column_);
   canvas_painter.end();
+  canvas_pos_ = (canvas_pos_ + 1) % canvas_.width();
 
-  p.drawPixmap(0, 0, canvas_);
+  DrawCanvas(p);
+}
+
+void Sonogram::DrawCanvas(QPainter& p) {
+  // canvas_pos_ is the oldest column.
+  const int w = canvas_.width();
+  p.drawPixmap(0, 0, canvas_, canvas_pos_, 0, w - canvas_pos_, -1);
+  if (canvas_pos_ > 0) {
+    p.drawPixmap(w - canvas_pos_, 0, canvas_, 0, 0, canvas_pos_, -1);
+  }
 }
 
 void Sonogram::transform(Scope& scope) {
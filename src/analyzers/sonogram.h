@@ -27,6 +27,8 @@
 
 #include "analyzerbase.h"
 
+#include <QImage>
+
 class Sonogram : public Analyzer::Base {
   Q_OBJECT
  public:
@@ -42,7 +44,15 @@ class Sonogram : public Analyzer::Base {
   void resizeEvent(QResizeEvent*);
   void psychedelicModeChanged(bool);
 
+ private:
+  // Draws the canvas with its oldest column at the left.
+  void DrawCanvas(QPainter& p);
+
+  // A ring of columns.  Each frame replaces the oldest column with the
+  // newest one, instead of scrolling everything along by a pixel.
   QPixmap canvas_;
+  int canvas_pos_;
+  QImage column_;
   int scope_size_;
 };
 
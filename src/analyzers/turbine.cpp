@@ -43,9 +43,6 @@ void TurbineAnalyzer::analyze(QPainter& p, const Scope& scope, bool new_frame) {
   const uint hd2 = height() / 2;
   const uint kMaxHeight = hd2 - 1;
 
-  QPainter canvas_painter(&canvas_);
-  canvas_.fill(palette().color(QPalette::Background));
-
   Analyzer::interpolate(scope, scope_);
 
   // update the graphics with the new colour
@@ -53,6 +50,9 @@ void TurbineAnalyzer::analyze(QPainter& p, const Scope& scope, bool new_frame) {
     paletteChange(QPalette());
   }
 
+  PrepareCanvas();
+  QPainter canvas_painter(&canvas_);
+
   for (uint i = 0, x = 0, y; i < bands_; ++i, x += kColumnWidth + 1) {
     float h = std::min(log10(scope_[i] * 256.0) * F_ * 0.5, kMaxHeight * 1.0);
 
@@ -79,6 +79,8 @@ void TurbineAnalyzer::analyze(QPainter& p, const Scope& scope, bool new_frame) {
       }
     }
 
+    if (!ClearBandIfChanged(canvas_painter, i, x)) continue;
+
     y = hd2 - static_cast<uint>(bar_height_[i]);
     canvas_painter.drawPixmap(x + 1, y, barPixmap_, 0, y, -1, -1);
     canvas_painter.drawPixmap(x + 1, hd2, barPixmap_, 0,
@@ -30,6 +30,7 @@
 #include "core/database.h"
 #include "core/lazy.h"
 #include "core/player.h"
+#include "core/startuptrace.h"
 #include "core/tagreaderclient.h"
 #include "core/taskmanager.h"
 #include "covers/albumcoverloader.h"
@@ -63,6 +64,7 @@
 #ifdef HAVE_MOODBAR
 #include "moodbar/moodbarcontroller.h"
 #include "moodbar/moodbarloader.h"
+#include "moodbar/moodbarrendercache.h"
 #endif
 
 bool Application::kIsPortable = false;
@@ -70,6 +72,20 @@ const char* Application::kLegacyPortableDataDir = "data";
 const char* Application::kDefaultPortableDataDir = "clementine-data";
 const char* Application::kPortableDataDir = nullptr;
 
+namespace {
+
+// Gets a subsystem, adding its construction to the startup trace if this is
+// the first time it's been asked for.
+template <typename T>
+T* Traced(const Lazy<T>& lazy, const char* name) {
+  if (lazy) return lazy.get();
+
+  StartupTrace::Scope trace(name);
+  return lazy.get();
+}
+
+}  // namespace
+
 class ApplicationImpl {
  public:
   ApplicationImpl(Application* app)
@@ -140,6 +156,13 @@ class ApplicationImpl {
           return new MoodbarController(app, app);
 #else
           return nullptr;
+#endif
+        }),
+        moodbar_render_cache_([=]() {
+#ifdef HAVE_MOODBAR
+          return new MoodbarRenderCache(app);
+#else
+          return nullptr;
 #endif
         }),
         // Since NetworkRemote is moved to a different thread and creates
@@ -185,6 +208,7 @@ class ApplicationImpl {
   Lazy<GPodderSync> gpodder_sync_;
   Lazy<MoodbarLoader> moodbar_loader_;
   Lazy<MoodbarController> moodbar_controller_;
+  Lazy<MoodbarRenderCache> moodbar_render_cache_;
   Lazy<NetworkRemote> network_remote_;
   Lazy<NetworkRemoteHelper> network_remote_helper_;
   Lazy<Scrobbler> scrobbler_;
@@ -215,6 +239,24 @@ Application::~Application() {
   // thread, including some device library backends.
   p_->device_manager_.reset();
 
+  // Playlist saves are held back for a moment; write any that are still
+  // waiting before the database thread stops.
+  if (p_->playlist_backend_) {
+    QMetaObject::invokeMethod(p_->playlist_backend_.get(), "FlushPendingSaves",
+                              Qt::BlockingQueuedConnection);
+  }
+
+  // And play counts and ratings.
+  if (p_->library_) {
+    QMetaObject::invokeMethod(p_->library_->backend(), "FlushStatistics",
+                              Qt::BlockingQueuedConnection);
+  }
+
+  // Same for tag changes that haven't been written to the files yet.
+  if (p_->tag_reader_client_) {
+    p_->tag_reader_client_->FlushPendingWrites();
+  }
+
   for (QThread* thread : threads_) {
     thread->quit();
   }
@@ -259,38 +301,44 @@ void Application::OpenSettingsDialogAtPage(SettingsDialog::Page page) {
 }
 
 AlbumCoverLoader* Application::album_cover_loader() const {
-  return p_->album_cover_loader_.get();
+  return Traced(p_->album_cover_loader_, "AlbumCoverLoader");
 }
 
-Appearance* Application::appearance() const { return p_->appearance_.get(); }
+Appearance* Application::appearance() const {
+  return Traced(p_->appearance_, "Appearance");
+}
 
 CoverProviders* Application::cover_providers() const {
-  return p_->cover_providers_.get();
+  return Traced(p_->cover_providers_, "CoverProviders");
 }
 
 CurrentArtLoader* Application::current_art_loader() const {
-  return p_->current_art_loader_.get();
+  return Traced(p_->current_art_loader_, "CurrentArtLoader");
 }
 
-Database* Application::database() const { return p_->database_.get(); }
+Database* Application::database() const {
+  return Traced(p_->database_, "Database");
+}
 
 DeviceManager* Application::device_manager() const {
-  return p_->device_manager_.get();
+  return Traced(p_->device_manager_, "DeviceManager");
 }
 
 GlobalSearch* Application::global_search() const {
-  return p_->global_search_.get();
+  return Traced(p_->global_search_, "GlobalSearch");
 }
 
 GPodderSync* Application::gpodder_sync() const {
-  return p_->gpodder_sync_.get();
+  return Traced(p_->gpodder_sync_, "GPodderSync");
 }
 
 InternetModel* Application::internet_model() const {
-  return p_->internet_model_.get();
+  return Traced(p_->internet_model_, "InternetModel");
 }
 
-Library* Application::library() const { return p_->library_.get(); }
+Library* Application::library() const {
+  return Traced(p_->library_, "Library");
+}
 
 LibraryBackend* Application::library_backend() const {
   return library()->backend();
@@ -303,55 +351,61 @@ LibraryDirectoryModel* Application::directory_model() const {
 LibraryModel* Application::library_model() const { return library()->model(); }
 
 MoodbarController* Application::moodbar_controller() const {
-  return p_->moodbar_controller_.get();
+  return Traced(p_->moodbar_controller_, "MoodbarController");
 }
 
 MoodbarLoader* Application::moodbar_loader() const {
-  return p_->moodbar_loader_.get();
+  return Traced(p_->moodbar_loader_, "MoodbarLoader");
+}
+
+MoodbarRenderCache* Application::moodbar_render_cache() const {
+  return Traced(p_->moodbar_render_cache_, "MoodbarRenderCache");
 }
 
 NetworkRemoteHelper* Application::network_remote_helper() const {
-  return p_->network_remote_helper_.get();
+  return Traced(p_->network_remote_helper_, "NetworkRemoteHelper");
 }
 
 NetworkRemote* Application::network_remote() const {
-  return p_->network_remote_.get();
+  return Traced(p_->network_remote_, "NetworkRemote");
 }
 
-Player* Application::player() const { return p_->player_.get(); }
+Player* Application::player() const { return Traced(p_->player_, "Player"); }
 
 PlaylistBackend* Application::playlist_backend() const {
-  return p_->playlist_backend_.get();
+  return Traced(p_->playlist_backend_, "PlaylistBackend");
 }
 
 PlaylistManager* Application::playlist_manager() const {
-  return p_->playlist_manager_.get();
+  return Traced(p_->playlist_manager_, "PlaylistManager");
 }
 
 PodcastBackend* Application::podcast_backend() const {
-  return p_->podcast_backend_.get();
+  return Traced(p_->podcast_backend_, "PodcastBackend");
 }
 
 PodcastDeleter* Application::podcast_deleter() const {
-  return p_->podcast_deleter_.get();
+  return Traced(p_->podcast_deleter_, "PodcastDeleter");
 }
 
 PodcastDownloader* Application::podcast_downloader() const {
-  return p_->podcast_downloader_.get();
+  return Traced(p_->podcast_downloader_, "PodcastDownloader");
 }
 
 PodcastUpdater* Application::podcast_updater() const {
-  return p_->podcast_updater_.get();
+  return Traced(p_->podcast_updater_, "PodcastUpdater");
 }
 
-Scrobbler* Application::scrobbler() const { return p_->scrobbler_.get(); }
+Scrobbler* Application::scrobbler() const {
+  return Traced(p_->scrobbler_, "Scrobbler");
+}
 
 TagReaderClient* Application::tag_reader_client() const {
-  return p_->tag_reader_client_.get();
+  return Traced(p_->tag_reader_client_, "TagReaderClient");
 }
 
 TaskManager* Application::task_manager() const {
-  return p_->task_manager_.get();
+  return Traced(p_->task_manager_, "TaskManager");
 }
 
 void Application::DirtySettings() { p_->settings_timer_.start(); }
@@ -45,6 +45,7 @@ class LibraryBackend;
 class LibraryModel;
 class MoodbarController;
 class MoodbarLoader;
+class MoodbarRenderCache;
 class NetworkRemote;
 class NetworkRemoteHelper;
 class Player;
@@ -92,6 +93,7 @@ class Application : public QObject {
   LibraryModel* library_model() const;
   MoodbarController* moodbar_controller() const;
   MoodbarLoader* moodbar_loader() const;
+  MoodbarRenderCache* moodbar_render_cache() const;
   NetworkRemoteHelper* network_remote_helper() const;
   NetworkRemote* network_remote() const;
   Player* player() const;
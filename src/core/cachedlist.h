@@ -22,17 +22,24 @@
 
 #include <algorithm>
 
+#include <QDataStream>
 #include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QSaveFile>
 #include <QSettings>
 
+#include "core/utilities.h"
+
 template <typename T>
 class CachedList {
  public:
   // Use a CachedList when you want to download and save a list of things from a
   // remote service, updating it only periodically.
-  // T must be a registered metatype and must support being stored in
-  // QSettings.  This usually means you have to implement QDataStream streaming
-  // operators, and use qRegisterMetaTypeStreamOperators.
+  // T must support QDataStream streaming operators.  The list is kept in its
+  // own binary file in the cache directory rather than in QSettings, so big
+  // lists don't bloat the config file that gets parsed at startup.
 
   typedef QList<T> ListType;
 
@@ -40,66 +47,122 @@ class CachedList {
              int cache_duration_secs)
       : settings_group_(settings_group),
         name_(name),
-        cache_duration_secs_(cache_duration_secs) {}
-
-  void Load() {
-    QSettings s;
-    s.beginGroup(settings_group_);
-
-    last_updated_ = s.value("last_refreshed_" + name_).toDateTime();
-    data_.clear();
+        cache_duration_secs_(cache_duration_secs),
+        loaded_(true) {}
 
-    const int count = s.beginReadArray(name_ + "_data");
-    for (int i = 0; i < count; ++i) {
-      s.setArrayIndex(i);
-      data_ << s.value("value").value<T>();
-    }
-    s.endArray();
-  }
+  // The file isn't read until the list is first used.
+  void Load() { loaded_ = false; }
 
   void Save() const {
-    QSettings s;
-    s.beginGroup(settings_group_);
+    EnsureLoaded();
 
-    s.setValue("last_refreshed_" + name_, last_updated_);
+    QDir().mkpath(QFileInfo(Filename()).path());
+    QSaveFile file(Filename());
+    if (!file.open(QIODevice::WriteOnly)) return;
 
-    s.beginWriteArray(name_ + "_data", data_.size());
-    for (int i = 0; i < data_.size(); ++i) {
-      s.setArrayIndex(i);
-      s.setValue("value", QVariant::fromValue(data_[i]));
+    QDataStream s(&file);
+    s.setVersion(QDataStream::Qt_5_0);
+    s << kMagic << kVersion << last_updated_ << data_;
+    if (s.status() == QDataStream::Ok) {
+      file.commit();
     }
-    s.endArray();
   }
 
   void Update(const ListType& data) {
     data_ = data;
     last_updated_ = QDateTime::currentDateTime();
+    loaded_ = true;
     Save();
   }
 
   bool IsStale() const {
+    EnsureLoaded();
     return last_updated_.isNull() ||
            last_updated_.secsTo(QDateTime::currentDateTime()) >
                cache_duration_secs_;
   }
 
-  void Sort() { std::sort(data_.begin(), data_.end()); }
+  void Sort() {
+    EnsureLoaded();
+    std::sort(data_.begin(), data_.end());
+  }
 
-  const ListType& Data() const { return data_; }
-  operator ListType() const { return data_; }
+  const ListType& Data() const {
+    EnsureLoaded();
+    return data_;
+  }
+  operator ListType() const { return Data(); }
 
   // Q_FOREACH support
   typedef typename ListType::const_iterator const_iterator;
-  const_iterator begin() const { return data_.begin(); }
-  const_iterator end() const { return data_.end(); }
+  const_iterator begin() const { return Data().begin(); }
+  const_iterator end() const { return Data().end(); }
 
  private:
+  static const quint32 kMagic = 0x434c5354;  // "CLST"
+  static const quint32 kVersion = 1;
+
+  QString Filename() const {
+    return Utilities::GetConfigPath(Utilities::Path_CacheRoot) + "/lists/" +
+           settings_group_ + "_" + name_ + ".dat";
+  }
+
+  void EnsureLoaded() const {
+    if (loaded_) return;
+    loaded_ = true;
+
+    last_updated_ = QDateTime();
+    data_.clear();
+
+    QFile file(Filename());
+    if (!file.open(QIODevice::ReadOnly)) {
+      LoadFromSettings();
+      return;
+    }
+
+    QDataStream s(&file);
+    s.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    s >> magic >> version;
+    if (magic != kMagic || version != kVersion) return;
+
+    s >> last_updated_ >> data_;
+    if (s.status() != QDataStream::Ok) {
+      // A truncated file - fetch the list again.
+      last_updated_ = QDateTime();
+      data_.clear();
+    }
+  }
+
+  // Older versions kept the list in QSettings.  Move it to the file.
+  void LoadFromSettings() const {
+    QSettings s;
+    s.beginGroup(settings_group_);
+    if (!s.contains("last_refreshed_" + name_)) return;
+
+    last_updated_ = s.value("last_refreshed_" + name_).toDateTime();
+
+    const int count = s.beginReadArray(name_ + "_data");
+    for (int i = 0; i < count; ++i) {
+      s.setArrayIndex(i);
+      data_ << s.value("value").value<T>();
+    }
+    s.endArray();
+
+    s.remove("last_refreshed_" + name_);
+    s.remove(name_ + "_data");
+    Save();
+  }
+
   const QString settings_group_;
   const QString name_;
   const int cache_duration_secs_;
 
-  QDateTime last_updated_;
-  ListType data_;
+  mutable bool loaded_;
+  mutable QDateTime last_updated_;
+  mutable ListType data_;
 };
 
 #endif  // CORE_CACHEDLIST_H_
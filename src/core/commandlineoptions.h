@@ -73,6 +73,7 @@ class CommandlineOptions {
   bool delete_current_track() const { return delete_current_track_; }
   bool show_osd() const { return show_osd_; }
   bool toggle_pretty_osd() const { return toggle_pretty_osd_; }
+  bool headless() const { return headless_; }
   QList<QUrl> urls() const { return urls_; }
   QString language() const { return language_; }
   QString log_levels() const { return log_levels_; }
@@ -95,7 +96,8 @@ class CommandlineOptions {
     Version,
     VolumeIncreaseBy,
     VolumeDecreaseBy,
-    RestartOrPrevious
+    RestartOrPrevious,
+    Headless
   };
 
   QString tr(const char* source_text);
@@ -117,6 +119,8 @@ class CommandlineOptions {
   bool delete_current_track_;
   bool show_osd_;
   bool toggle_pretty_osd_;
+  // Only affects the instance that's starting, so it isn't serialised.
+  bool headless_;
   QString language_;
   QString log_levels_;
   QString playlist_name_;
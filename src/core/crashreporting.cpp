@@ -33,6 +33,8 @@
 #include <QtDebug>
 
 #if defined(HAVE_BREAKPAD) and defined(Q_OS_LINUX)
+#include <fcntl.h>
+
 #include "client/linux/handler/exception_handler.h"
 #include "third_party/lss/linux_syscall_support.h"
 #endif
@@ -82,6 +84,36 @@ bool CrashReporting::Handler(const char* dump_path, const char* minidump_id,
   Print(dump_path);
   Print("/");
   Print(minidump_id);
+
+  // Save the end of the log next to the dump.  Nothing here may allocate.
+  char log_path[PATH_MAX];
+  const size_t dump_path_length = strlen(dump_path);
+  const size_t minidump_id_length = strlen(minidump_id);
+  if (dump_path_length + minidump_id_length + 6 < sizeof(log_path)) {
+    char* p = log_path;
+    memcpy(p, dump_path, dump_path_length);
+    p += dump_path_length;
+    *p++ = '/';
+    memcpy(p, minidump_id, minidump_id_length);
+    p += minidump_id_length;
+    memcpy(p, ".log", 5);
+
+    const int fd = sys_open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd >= 0) {
+      const char* first = nullptr;
+      const char* second = nullptr;
+      size_t first_size = 0;
+      size_t second_size = 0;
+      logging::GetRecentOutput(&first, &first_size, &second, &second_size);
+      if (first_size) sys_write(fd, first, first_size);
+      if (second_size) sys_write(fd, second, second_size);
+      sys_close(fd);
+
+      Print("\nand the last lines of the log to:\n  ");
+      Print(log_path);
+    }
+  }
+
   Print(
       "\n\nPlease send this to the developers so they can fix the problem:\n"
       "  http://code.google.com/p/clementine-player/issues/entry\n\n");
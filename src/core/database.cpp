@@ -31,28 +31,64 @@
 #include "core/logging.h"
 #include "core/taskmanager.h"
 
-#include <boost/scope_exit.hpp>
-
 #include <sqlite3.h>
 
+#if SQLITE_VERSION_NUMBER < 3020000
+#error "Full text search needs SQLite 3.20 or later, built with FTS5"
+#endif
+
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
 #include <QLibrary>
 #include <QLibraryInfo>
+#include <QSettings>
 #include <QSqlDriver>
 #include <QSqlQuery>
 #include <QtDebug>
 #include <QThread>
+#include <QTimer>
 #include <QUrl>
 #include <QVariant>
 
 const char* Database::kDatabaseFilename = "clementine.db";
-const int Database::kSchemaVersion = 51;
+const int Database::kSchemaVersion = 64;
 const char* Database::kMagicAllSongsTables = "%allsongstables";
+const char* Database::kSettingsGroup = "Database";
+const int Database::kInterruptCheckInstructions = 1000;
+const int Database::kBackupPagesPerStep = 256;
+const int Database::kBackupStepIntervalMsec = 20;
+const int Database::kIntegrityCheckIntervalDays = 7;
 
 int Database::sNextConnectionId = 1;
 QMutex Database::sNextConnectionIdMutex;
 
+namespace {
+
+// Pragma keywords can't be bound as values, so only pass through the ones
+// SQLite knows about.
+QString PragmaKeyword(const QString& value, const QStringList& allowed,
+                      const QString& fallback) {
+  const QString upper = value.toUpper();
+  if (allowed.contains(upper)) return upper;
+
+  qLog(Warning) << "Ignoring unknown database setting" << value;
+  return fallback;
+}
+
+}  // namespace
+
+Database::TuningProfile::TuningProfile()
+    : journal_mode("WAL"),
+      mmap_size(256 * 1024 * 1024),
+      // Negative values are in KiB rather than pages
+      cache_size(-16 * 1024),
+      synchronous("NORMAL"),
+      temp_store("MEMORY"),
+      explain_queries(false) {}
+
 Database::Token::Token(const QString& token, int start, int end)
     : token(token), start_offset(start), end_offset(end) {}
 
@@ -105,12 +141,7 @@ int Database::FTSDestroy(sqlite3_tokenizer* tokenizer) {
   return SQLITE_OK;
 }
 
-int Database::FTSOpen(sqlite3_tokenizer* pTokenizer, const char* input,
-                      int bytes, sqlite3_tokenizer_cursor** cursor) {
-  UnicodeTokenizerCursor* new_cursor = new UnicodeTokenizerCursor;
-  new_cursor->pTokenizer = pTokenizer;
-  new_cursor->position = 0;
-
+QList<Database::Token> Database::Tokenize(const char* input, int bytes) {
   QString str = QString::fromUtf8(input, bytes).toLower();
   QChar* data = str.data();
   // Decompose and strip punctuation.
@@ -158,7 +189,15 @@ int Database::FTSOpen(sqlite3_tokenizer* pTokenizer, const char* input,
     }
   }
 
-  new_cursor->tokens = tokens;
+  return tokens;
+}
+
+int Database::FTSOpen(sqlite3_tokenizer* pTokenizer, const char* input,
+                      int bytes, sqlite3_tokenizer_cursor** cursor) {
+  UnicodeTokenizerCursor* new_cursor = new UnicodeTokenizerCursor;
+  new_cursor->pTokenizer = pTokenizer;
+  new_cursor->position = 0;
+  new_cursor->tokens = Tokenize(input, bytes);
   *cursor = reinterpret_cast<sqlite3_tokenizer_cursor*>(new_cursor);
 
   return SQLITE_OK;
@@ -196,6 +235,50 @@ int Database::FTSNext(sqlite3_tokenizer_cursor* cursor, const char** token,
   return SQLITE_OK;
 }
 
+int Database::FTS5Create(void*, const char**, int,
+                         Fts5Tokenizer** tokenizer) {
+  *tokenizer = reinterpret_cast<Fts5Tokenizer*>(new UnicodeTokenizer);
+  return SQLITE_OK;
+}
+
+void Database::FTS5Delete(Fts5Tokenizer* tokenizer) {
+  delete reinterpret_cast<UnicodeTokenizer*>(tokenizer);
+}
+
+int Database::FTS5Tokenize(Fts5Tokenizer*, void* context, int, const char* text,
+                           int bytes, FTS5TokenCallback callback) {
+  for (const Token& token : Tokenize(text, bytes)) {
+    const QByteArray utf8 = token.token.toUtf8();
+    const int rc = callback(context, 0, utf8.constData(), utf8.size(),
+                            token.start_offset, token.end_offset);
+    if (rc != SQLITE_OK) return rc;
+  }
+  return SQLITE_OK;
+}
+
+bool Database::RegisterFTS5Tokenizer(sqlite3* handle) {
+  // FTS5 tokenizers are registered through the fts5_api, which SQLite only
+  // hands out through a pointer bound to this query.
+  fts5_api* api = nullptr;
+  sqlite3_stmt* stmt = nullptr;
+  if (sqlite3_prepare_v2(handle, "SELECT fts5(?1)", -1, &stmt, nullptr) !=
+      SQLITE_OK) {
+    return false;
+  }
+  sqlite3_bind_pointer(stmt, 1, &api, "fts5_api_ptr", nullptr);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  if (!api) return false;
+
+  fts5_tokenizer tokenizer;
+  tokenizer.xCreate = &Database::FTS5Create;
+  tokenizer.xDelete = &Database::FTS5Delete;
+  tokenizer.xTokenize = &Database::FTS5Tokenize;
+  return api->xCreateTokenizer(api, "unicode", nullptr, &tokenizer,
+                               nullptr) == SQLITE_OK;
+}
+
 void Database::StaticInit() {
   sFTSTokenizer = new sqlite3_tokenizer_module;
   sFTSTokenizer->iVersion = 0;
@@ -211,11 +294,22 @@ Database::Database(Application* app, QObject* parent,
                    const QString& database_name)
     : QObject(parent),
       app_(app),
+      main_(nullptr),
       mutex_(QMutex::Recursive),
       injected_database_name_(database_name),
-      query_hash_(0),
-      startup_schema_version_(-1) {
+      startup_schema_version_(-1),
+      read_connections_enabled_(false),
+      backup_source_(nullptr),
+      backup_dest_(nullptr),
+      backup_(nullptr),
+      backup_task_id_(-1) {
   setObjectName("Database");
+  LoadTuningProfile();
+
+  // Readers only get out of the writer's way in WAL mode, and every
+  // connection to an injected database like :memory: is a different database.
+  read_connections_enabled_ = injected_database_name_.isNull() &&
+                              tuning_profile_.journal_mode == "WAL";
   {
     QMutexLocker l(&sNextConnectionIdMutex);
     connection_id_ = sNextConnectionId++;
@@ -231,6 +325,41 @@ Database::Database(Application* app, QObject* parent,
   Connect();
 }
 
+Database::Database(Application* app, Database* main,
+                   const QString& attached_name)
+    : QObject(nullptr),
+      app_(app),
+      main_(main),
+      mutex_(QMutex::Recursive),
+      injected_database_name_(main->injected_database_name_),
+      startup_schema_version_(-1),
+      read_connections_enabled_(false),
+      backup_source_(nullptr),
+      backup_dest_(nullptr),
+      backup_(nullptr),
+      backup_task_id_(-1) {
+  setObjectName(attached_name + " database");
+  tuning_profile_ = main->tuning_profile_;
+  {
+    QMutexLocker l(&sNextConnectionIdMutex);
+    connection_id_ = sNextConnectionId++;
+  }
+
+  directory_ = main->directory_;
+  attached_databases_[attached_name] = main->attached_databases_[attached_name];
+
+  QMutexLocker l(&mutex_);
+  Connect();
+}
+
+Database::~Database() {
+  // Abandon any backup that's still running.  The half-written copy is left
+  // in the temporary file so the last complete backup is kept.
+  if (backup_) sqlite3_backup_finish(backup_);
+  sqlite3_close(backup_source_);
+  sqlite3_close(backup_dest_);
+}
+
 QSqlDatabase Database::Connect() {
   QMutexLocker l(&connect_mutex_);
 
@@ -254,6 +383,8 @@ QSqlDatabase Database::Connect() {
 
   if (!injected_database_name_.isNull())
     db.setDatabaseName(injected_database_name_);
+  else if (main_)
+    db.setDatabaseName(":memory:");
   else
     db.setDatabaseName(directory_ + "/" + kDatabaseFilename);
 
@@ -262,40 +393,11 @@ QSqlDatabase Database::Connect() {
     return db;
   }
 
-  // Find Sqlite3 functions in the Qt plugin.
-  if (!sFTSTokenizer) StaticInit();
+  RegisterTokenizers(db);
 
-  {
+  ApplyTuningProfile(db, "main", false);
 
-#ifdef SQLITE_DBCONFIG_ENABLE_FTS3_TOKENIZER
-    // In case sqlite>=3.12 is compiled without -DSQLITE_ENABLE_FTS3_TOKENIZER (generally a good idea 
-    // due to security reasons) the fts3 support should be enabled explicitly.
-    // see https://github.com/clementine-player/Clementine/issues/5297
-    //
-    // See https://www.sqlite.org/fts3.html#custom_application_defined_tokenizers
-    QVariant v = db.driver()->handle();
-    if (v.isValid() && qstrcmp(v.typeName(), "sqlite3*") == 0) {
-      sqlite3* handle = *static_cast<sqlite3**>(v.data());
-      if (!handle || sqlite3_db_config(handle, SQLITE_DBCONFIG_ENABLE_FTS3_TOKENIZER, 1, nullptr) != SQLITE_OK) {
-        qLog(Fatal) << "Failed to enable FTS3 tokenizer";
-      }
-    }
-#endif
-
-    QSqlQuery set_fts_tokenizer(db);
-    set_fts_tokenizer.prepare("SELECT fts3_tokenizer(:name, :pointer)");
-    set_fts_tokenizer.bindValue(":name", "unicode");
-    set_fts_tokenizer.bindValue(
-        ":pointer", QByteArray(reinterpret_cast<const char*>(&sFTSTokenizer),
-                               sizeof(&sFTSTokenizer)));
-    if (!set_fts_tokenizer.exec()) {
-      qLog(Warning) << "Couldn't register FTS3 tokenizer : " << set_fts_tokenizer.lastError();
-    }
-    // Implicit invocation of ~QSqlQuery() when leaving the scope
-    // to release any remaining database locks!
-  }
-
-  if (db.tables().count() == 0) {
+  if (!main_ && db.tables().count() == 0) {
     // Set up initial schema
     qLog(Info) << "Creating initial database schema";
     UpdateDatabaseSchema(0, db);
@@ -316,9 +418,11 @@ QSqlDatabase Database::Connect() {
       qFatal("Couldn't attach external database '%s'",
              key.toLatin1().constData());
     }
+
+    ApplyTuningProfile(db, key, attached_databases_[key].is_temporary_);
   }
 
-  if (startup_schema_version_ == -1) {
+  if (!main_ && startup_schema_version_ == -1) {
     UpdateMainSchema(&db);
   }
 
@@ -342,6 +446,106 @@ QSqlDatabase Database::Connect() {
   return db;
 }
 
+void Database::RegisterTokenizers(QSqlDatabase& db) {
+  // Find Sqlite3 functions in the Qt plugin.
+  if (!sFTSTokenizer) StaticInit();
+
+  sqlite3* handle = nullptr;
+  QVariant v = db.driver()->handle();
+  const bool is_sqlite_handle =
+      v.isValid() && qstrcmp(v.typeName(), "sqlite3*") == 0;
+  if (is_sqlite_handle) {
+    handle = *static_cast<sqlite3**>(v.data());
+  }
+
+#ifdef SQLITE_DBCONFIG_ENABLE_FTS3_TOKENIZER
+  // In case sqlite>=3.12 is compiled without -DSQLITE_ENABLE_FTS3_TOKENIZER (generally a good idea 
+  // due to security reasons) the fts3 support should be enabled explicitly.
+  // see https://github.com/clementine-player/Clementine/issues/5297
+  //
+  // See https://www.sqlite.org/fts3.html#custom_application_defined_tokenizers
+  if (is_sqlite_handle) {
+    if (!handle || sqlite3_db_config(handle, SQLITE_DBCONFIG_ENABLE_FTS3_TOKENIZER, 1, nullptr) != SQLITE_OK) {
+      qLog(Fatal) << "Failed to enable FTS3 tokenizer";
+    }
+  }
+#endif
+
+  QSqlQuery set_fts_tokenizer(db);
+  set_fts_tokenizer.prepare("SELECT fts3_tokenizer(:name, :pointer)");
+  set_fts_tokenizer.bindValue(":name", "unicode");
+  set_fts_tokenizer.bindValue(
+      ":pointer", QByteArray(reinterpret_cast<const char*>(&sFTSTokenizer),
+                             sizeof(&sFTSTokenizer)));
+  if (!set_fts_tokenizer.exec()) {
+    qLog(Warning) << "Couldn't register FTS3 tokenizer : " << set_fts_tokenizer.lastError();
+  }
+
+  // The library's own tables use FTS5 now, but device tables made before
+  // the switch still use FTS3, so both tokenizers are registered.
+  if (!handle || !RegisterFTS5Tokenizer(handle)) {
+    qLog(Warning) << "Couldn't register FTS5 tokenizer";
+  }
+}
+
+QSqlDatabase Database::ConnectForReading() {
+  if (!read_connections_enabled_) return Connect();
+
+  // The writer's connection makes sure the schema is up to date first.
+  if (startup_schema_version_ == -1) {
+    QMutexLocker l(&mutex_);
+    Connect();
+  }
+
+  QMutexLocker l(&connect_mutex_);
+
+  const QString connection_id = ReadConnectionName();
+
+  QSqlDatabase db = QSqlDatabase::database(connection_id);
+  if (db.isOpen()) {
+    return db;
+  }
+
+  db = QSqlDatabase::addDatabase("QSQLITE", connection_id);
+  db.setDatabaseName(directory_ + "/" + kDatabaseFilename);
+  db.setConnectOptions("QSQLITE_OPEN_READONLY");
+
+  if (!db.open()) {
+    qLog(Warning) << "Couldn't open a read-only database connection"
+                  << db.lastError();
+    QSqlDatabase::removeDatabase(connection_id);
+    return Connect();
+  }
+
+  RegisterTokenizers(db);
+  ApplyTuningProfile(db, "main", false, true);
+
+  for (const QString& key : attached_databases_.keys()) {
+    QSqlQuery q(db);
+    q.prepare("ATTACH DATABASE :filename AS :alias");
+    q.bindValue(":filename", attached_databases_[key].filename_);
+    q.bindValue(":alias", key);
+    if (!q.exec()) {
+      qLog(Warning) << "Couldn't attach" << key << "for reading"
+                    << q.lastError();
+      continue;
+    }
+
+    ApplyTuningProfile(db, key, attached_databases_[key].is_temporary_, true);
+  }
+
+  return db;
+}
+
+QString Database::ReadConnectionName() const {
+  return QString("%1_thread_%2_read").arg(connection_id_).arg(
+      reinterpret_cast<quint64>(QThread::currentThread()));
+}
+
+QMutex* Database::ReadMutex() {
+  return read_connections_enabled_ ? nullptr : &mutex_;
+}
+
 void Database::UpdateMainSchema(QSqlDatabase* db) {
   // Get the database's schema version
   int schema_version = 0;
@@ -352,6 +556,8 @@ void Database::UpdateMainSchema(QSqlDatabase* db) {
     // to release any remaining database locks!
   }
 
+  ApplyTuningProfile(db, "main", false);
+
   startup_schema_version_ = schema_version;
 
   if (schema_version > kSchemaVersion) {
@@ -362,7 +568,11 @@ void Database::UpdateMainSchema(QSqlDatabase* db) {
   if (schema_version < kSchemaVersion) {
     // Update the schema
     for (int v = schema_version + 1; v <= kSchemaVersion; ++v) {
+      QElapsedTimer timer;
+      timer.start();
       UpdateDatabaseSchema(v, *db);
+      qLog(Debug) << "Database schema update" << v << "took"
+                  << timer.elapsed() << "ms";
     }
   }
 }
@@ -376,6 +586,14 @@ void Database::RecreateAttachedDb(const QString& database_name) {
   const QString filename = attached_databases_[database_name].filename_;
 
   QMutexLocker l(&mutex_);
+  ClearPreparedQueries();
+
+  // main has the file attached too.  It removes it and closes every thread's
+  // connections, ours included.
+  if (main_) {
+    main_->RecreateAttachedDb(database_name);
+    return;
+  }
   {
     QSqlDatabase db(Connect());
 
@@ -398,6 +616,10 @@ void Database::RecreateAttachedDb(const QString& database_name) {
   for (const QString& name : QSqlDatabase::connectionNames()) {
     QSqlDatabase::removeDatabase(name);
   }
+
+  // Don't let a stale write-ahead log be replayed into the new database.
+  QFile::remove(filename + "-wal");
+  QFile::remove(filename + "-shm");
 }
 
 void Database::AttachDatabase(const QString& database_name,
@@ -419,10 +641,120 @@ void Database::AttachDatabaseOnDbConnection(const QString& database_name,
     qFatal("Couldn't attach external database '%s'",
            database_name.toLatin1().constData());
   }
+
+  ApplyTuningProfile(db, database_name, database.is_temporary_);
+
+  // Readers on other threads pick it up when they next connect, but this
+  // thread's might be open already.
+  QSqlDatabase read_db = QSqlDatabase::database(ReadConnectionName(), false);
+  if (read_db.isOpen()) {
+    QSqlQuery read_q(read_db);
+    read_q.prepare("ATTACH DATABASE :filename AS :alias");
+    read_q.bindValue(":filename", database.filename_);
+    read_q.bindValue(":alias", database_name);
+    if (!read_q.exec()) {
+      qLog(Warning) << "Couldn't attach" << database_name << "for reading"
+                    << read_q.lastError();
+    }
+  }
+}
+
+void Database::LoadTuningProfile() {
+  const TuningProfile defaults;
+
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+
+  tuning_profile_.journal_mode = PragmaKeyword(
+      s.value("journal_mode", defaults.journal_mode).toString(),
+      QStringList() << "DELETE"
+                    << "TRUNCATE"
+                    << "PERSIST"
+                    << "MEMORY"
+                    << "WAL",
+      defaults.journal_mode);
+  tuning_profile_.mmap_size =
+      qMax(qint64(0), s.value("mmap_size", defaults.mmap_size).toLongLong());
+  tuning_profile_.cache_size =
+      s.value("cache_size", defaults.cache_size).toInt();
+  tuning_profile_.synchronous = PragmaKeyword(
+      s.value("synchronous", defaults.synchronous).toString(),
+      QStringList() << "OFF"
+                    << "NORMAL"
+                    << "FULL"
+                    << "EXTRA",
+      defaults.synchronous);
+  tuning_profile_.temp_store = PragmaKeyword(
+      s.value("temp_store", defaults.temp_store).toString(),
+      QStringList() << "DEFAULT"
+                    << "FILE"
+                    << "MEMORY",
+      defaults.temp_store);
+  tuning_profile_.explain_queries =
+      s.value("explain_queries", defaults.explain_queries).toBool();
+}
+
+void Database::ApplyTuningProfile(QSqlDatabase& db, const QString& schema,
+                                  bool is_temporary, bool read_only) {
+  QStringList pragmas;
+
+  // Temporary databases are read back as plain files as soon as they're
+  // detached, so leave them in the default rollback journal mode.  Only the
+  // writer can change the journal mode.
+  if (!is_temporary && !read_only) {
+    pragmas << QString("PRAGMA %1.journal_mode = %2")
+                   .arg(schema, tuning_profile_.journal_mode);
+  }
+  pragmas << QString("PRAGMA %1.mmap_size = %2")
+                 .arg(schema).arg(tuning_profile_.mmap_size)
+          << QString("PRAGMA %1.cache_size = %2")
+                 .arg(schema).arg(tuning_profile_.cache_size)
+          << QString("PRAGMA %1.synchronous = %2")
+                 .arg(schema, tuning_profile_.synchronous);
+  if (schema == "main") {
+    // This one applies to the whole connection
+    pragmas << QString("PRAGMA temp_store = %1")
+                   .arg(tuning_profile_.temp_store);
+  }
+
+  for (const QString& pragma : pragmas) {
+    QSqlQuery q(db);
+    if (!q.exec(pragma)) {
+      qLog(Warning) << "Couldn't apply" << pragma << ":" << q.lastError();
+    }
+  }
+}
+
+QStringList Database::TuningStatus() {
+  QMutexLocker l(&mutex_);
+  QSqlDatabase db(Connect());
+
+  QStringList ret;
+  for (const QString& schema :
+       QStringList() << "main" << attached_databases_.keys()) {
+    QStringList values;
+    for (const QString& pragma : QStringList() << "journal_mode"
+                                               << "mmap_size"
+                                               << "cache_size"
+                                               << "synchronous") {
+      QSqlQuery q(db);
+      if (q.exec(QString("PRAGMA %1.%2").arg(schema, pragma)) && q.next()) {
+        values << pragma + "=" + q.value(0).toString();
+      }
+    }
+    ret << schema + ": " + values.join(", ");
+  }
+
+  QSqlQuery q(db);
+  if (q.exec("PRAGMA temp_store") && q.next()) {
+    ret << "temp_store=" + q.value(0).toString();
+  }
+  return ret;
 }
 
 void Database::DetachDatabase(const QString& database_name) {
   QMutexLocker l(&mutex_);
+  ClearPreparedQueries();
   {
     QSqlDatabase db(Connect());
 
@@ -433,6 +765,14 @@ void Database::DetachDatabase(const QString& database_name) {
       qLog(Warning) << "Failed to detach database" << database_name;
       return;
     }
+
+    QSqlDatabase read_db = QSqlDatabase::database(ReadConnectionName(), false);
+    if (read_db.isOpen()) {
+      QSqlQuery read_q(read_db);
+      read_q.prepare("DETACH DATABASE :alias");
+      read_q.bindValue(":alias", database_name);
+      read_q.exec();
+    }
   }
 
   attached_databases_.remove(database_name);
@@ -470,8 +810,12 @@ void Database::UpdateDatabaseSchema(int version, QSqlDatabase& db) {
 }
 
 void Database::UrlEncodeFilenameColumn(const QString& table, QSqlDatabase& db) {
+  // Only read the rows that still need converting rather than every row.
   QSqlQuery select(db);
-  select.prepare(QString("SELECT ROWID, filename FROM %1").arg(table));
+  select.setForwardOnly(true);
+  select.prepare(QString("SELECT ROWID, filename FROM %1"
+                         " WHERE filename != '' AND filename NOT LIKE '%://%'")
+                     .arg(table));
   QSqlQuery update(db);
   update.prepare(QString("UPDATE %1 SET filename=:filename WHERE ROWID=:id").arg(table));
   select.exec();
@@ -601,14 +945,78 @@ bool Database::CheckErrors(const QSqlQuery& query) {
   return false;
 }
 
+void Database::SetInterruptFlag(const QSqlDatabase& db,
+                                const QAtomicInt* flag) {
+  QVariant v = db.driver()->handle();
+  if (!v.isValid() || qstrcmp(v.typeName(), "sqlite3*") != 0) return;
+
+  sqlite3* handle = *static_cast<sqlite3**>(v.data());
+  if (!handle) return;
+
+  if (flag) {
+    // This is called every kInterruptCheckInstructions virtual machine
+    // instructions.
+    sqlite3_progress_handler(handle, kInterruptCheckInstructions,
+                             &Database::InterruptCallback,
+                             const_cast<QAtomicInt*>(flag));
+  } else {
+    sqlite3_progress_handler(handle, 0, nullptr, nullptr);
+  }
+}
+
+int Database::InterruptCallback(void* flag) {
+  return static_cast<QAtomicInt*>(flag)->load();
+}
+
+QSqlQuery Database::PreparedQuery(const QSqlDatabase& db, const QString& sql) {
+  QMutexLocker l(&prepared_queries_mutex_);
+
+  QHash<QString, QSqlQuery>& queries = prepared_queries_[db.connectionName()];
+  QHash<QString, QSqlQuery>::iterator it = queries.find(sql);
+  if (it != queries.end()) {
+    // Reset the statement in case the last user didn't read all its rows.
+    it->finish();
+    return *it;
+  }
+
+  QSqlQuery query(db);
+  if (!query.prepare(sql)) {
+    // Don't cache failures - the caller will see the error when it runs the
+    // query.
+    return query;
+  }
+  queries.insert(sql, query);
+  return query;
+}
+
+void Database::ClearPreparedQueries() {
+  QMutexLocker l(&prepared_queries_mutex_);
+  prepared_queries_.clear();
+}
+
 bool Database::IntegrityCheck(QSqlDatabase db) {
-  qLog(Debug) << "Starting database integrity check";
+  // quick_check finds most corruption without cross-checking every index
+  // against its table, which is what makes integrity_check slow on a big
+  // library.  The full check is only done every kIntegrityCheckIntervalDays.
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  const QDateTime now = QDateTime::currentDateTime();
+  const QDateTime last_full_check =
+      s.value("last_integrity_check").toDateTime();
+  const bool full_check =
+      !last_full_check.isValid() ||
+      last_full_check.daysTo(now) >= kIntegrityCheckIntervalDays;
+
+  qLog(Debug) << "Starting database" << (full_check ? "integrity" : "quick")
+              << "check";
   int task_id = app_->task_manager()->StartTask(tr("Integrity check"));
 
   bool ok = false;
   bool error_reported = false;
   // Ask for 10 error messages at most.
-  QSqlQuery q("PRAGMA integrity_check(10)", db);
+  QSqlQuery q(full_check ? "PRAGMA integrity_check(10)"
+                         : "PRAGMA quick_check(10)",
+              db);
   while (q.next()) {
     QString message = q.value(0).toString();
 
@@ -631,19 +1039,44 @@ bool Database::IntegrityCheck(QSqlDatabase db) {
 
   app_->task_manager()->SetTaskFinished(task_id);
 
+  if (ok && full_check) s.setValue("last_integrity_check", now);
   return ok;
 }
 
 void Database::DoBackup() {
-  QSqlDatabase db(this->Connect());
+  if (backup_) return;
 
-  // Before we overwrite anything, make sure the database is not corrupt
-  QMutexLocker l(&mutex_);
-  const bool ok = IntegrityCheck(db);
+  QSqlDatabase db(this->Connect());
+  const QString filename = db.databaseName();
+  if (BackupIsCurrent(filename)) {
+    qLog(Debug) << "Database backup is up to date";
+    return;
+  }
 
-  if (ok) {
-    BackupFile(db.databaseName());
+  // Before we overwrite anything, make sure the database is not corrupt.  In
+  // WAL mode this reads a snapshot, so writers aren't held up meanwhile.
+  {
+    QMutexLocker l(ReadMutex());
+    if (!IntegrityCheck(ConnectForReading())) return;
   }
+
+  BackupFile(filename);
+}
+
+QString Database::BackupFilename(const QString& filename) {
+  return QString("%1.bak").arg(filename);
+}
+
+bool Database::BackupIsCurrent(const QString& filename) {
+  const QFileInfo backup(BackupFilename(filename));
+  if (!backup.exists()) return false;
+
+  // In WAL mode changes stay in the -wal file until they're checkpointed.
+  QDateTime modified = QFileInfo(filename).lastModified();
+  const QFileInfo wal(filename + "-wal");
+  if (wal.exists()) modified = qMax(modified, wal.lastModified());
+
+  return backup.lastModified() > modified;
 }
 
 bool Database::OpenDatabase(const QString& filename,
@@ -664,50 +1097,82 @@ bool Database::OpenDatabase(const QString& filename,
 
 void Database::BackupFile(const QString& filename) {
   qLog(Debug) << "Starting database backup";
-  QString dest_filename = QString("%1.bak").arg(filename);
-  const int task_id =
-      app_->task_manager()->StartTask(tr("Backing up database"));
+  backup_filename_ = filename;
+  backup_task_id_ = app_->task_manager()->StartTask(tr("Backing up database"));
 
-  sqlite3* source_connection = nullptr;
-  sqlite3* dest_connection = nullptr;
-
-  BOOST_SCOPE_EXIT((&source_connection)(&dest_connection)(task_id)(app_)) {
-    // Harmless to call sqlite3_close() with a nullptr pointer.
-    sqlite3_close(source_connection);
-    sqlite3_close(dest_connection);
-    app_->task_manager()->SetTaskFinished(task_id);
-  }
-  BOOST_SCOPE_EXIT_END
-
-  bool success = OpenDatabase(filename, &source_connection);
-  if (!success) {
+  // Copy into a temporary file so the last backup survives if this one fails.
+  if (!OpenDatabase(filename, &backup_source_) ||
+      !OpenDatabase(BackupFilename(filename) + ".tmp", &backup_dest_)) {
+    FinishBackup(false);
     return;
   }
 
-  success = OpenDatabase(dest_filename, &dest_connection);
-  if (!success) {
+  backup_ = sqlite3_backup_init(backup_dest_, "main", backup_source_, "main");
+  if (!backup_) {
+    const char* error_message = sqlite3_errmsg(backup_dest_);
+    qLog(Error) << "Failed to start database backup:" << error_message;
+    FinishBackup(false);
     return;
   }
 
-  sqlite3_backup* backup =
-      sqlite3_backup_init(dest_connection, "main", source_connection, "main");
-  if (!backup) {
-    const char* error_message = sqlite3_errmsg(dest_connection);
-    qLog(Error) << "Failed to start database backup:" << error_message;
-    return;
+  BackupStep();
+}
+
+void Database::BackupStep() {
+  if (!backup_) return;
+
+  // Each step only locks the source database while it copies a few pages, and
+  // returning to the event loop in between lets this thread get on with other
+  // work.  If another connection writes to the database the backup picks up
+  // the changes in later steps.
+  const int ret = sqlite3_backup_step(backup_, kBackupPagesPerStep);
+  const int page_count = sqlite3_backup_pagecount(backup_);
+  app_->task_manager()->SetTaskProgress(
+      backup_task_id_, page_count - sqlite3_backup_remaining(backup_),
+      page_count);
+
+  switch (ret) {
+    case SQLITE_OK:
+    case SQLITE_BUSY:
+    case SQLITE_LOCKED:
+      QTimer::singleShot(kBackupStepIntervalMsec, this, SLOT(BackupStep()));
+      return;
+
+    case SQLITE_DONE:
+      FinishBackup(true);
+      return;
+
+    default:
+      qLog(Error) << "Database backup failed:" << sqlite3_errstr(ret);
+      FinishBackup(false);
+      return;
   }
+}
 
-  int ret = SQLITE_OK;
-  do {
-    ret = sqlite3_backup_step(backup, 16);
-    const int page_count = sqlite3_backup_pagecount(backup);
-    app_->task_manager()->SetTaskProgress(
-        task_id, page_count - sqlite3_backup_remaining(backup), page_count);
-  } while (ret == SQLITE_OK);
+void Database::FinishBackup(bool success) {
+  if (backup_) {
+    sqlite3_backup_finish(backup_);
+    backup_ = nullptr;
+  }
 
-  if (ret != SQLITE_DONE) {
-    qLog(Error) << "Database backup failed";
+  // Harmless to call sqlite3_close() with a nullptr pointer.
+  sqlite3_close(backup_source_);
+  sqlite3_close(backup_dest_);
+  backup_source_ = nullptr;
+  backup_dest_ = nullptr;
+
+  const QString dest_filename = BackupFilename(backup_filename_);
+  if (success) {
+    QFile::remove(dest_filename);
+    if (QFile::rename(dest_filename + ".tmp", dest_filename)) {
+      qLog(Debug) << "Finished database backup";
+    } else {
+      qLog(Error) << "Failed to replace database backup:" << dest_filename;
+    }
+  } else {
+    QFile::remove(dest_filename + ".tmp");
   }
 
-  sqlite3_backup_finish(backup);
+  app_->task_manager()->SetTaskFinished(backup_task_id_);
+  backup_task_id_ = -1;
 }
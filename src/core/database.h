@@ -24,11 +24,14 @@
 #ifndef CORE_DATABASE_H_
 #define CORE_DATABASE_H_
 
+#include <QAtomicInt>
+#include <QHash>
 #include <QMap>
 #include <QMutex>
 #include <QObject>
 #include <QSqlDatabase>
 #include <QSqlError>
+#include <QSqlQuery>
 #include <QStringList>
 
 #include <sqlite3.h>
@@ -49,6 +52,13 @@ class Database : public QObject {
  public:
   Database(Application* app, QObject* parent = nullptr,
            const QString& database_name = QString());
+  // A database of its own for the tables in one of main's attached databases,
+  // so a service importing its catalogue doesn't hold up the library.  Its
+  // connections attach that file under the same name, over an empty main, so
+  // queries don't change.  It has its own mutex, and should be moved to a
+  // thread of its own.  main keeps the file attached for playlists and
+  // searches across libraries, and for upgrading its schema.
+  Database(Application* app, Database* main, const QString& attached_name);
 
   struct AttachedDatabase {
     AttachedDatabase() {}
@@ -61,18 +71,70 @@ class Database : public QObject {
     bool is_temporary_;
   };
 
+  // SQLite settings applied to every connection and attached database.  These
+  // are read from kSettingsGroup when the Database is created.
+  struct TuningProfile {
+    TuningProfile();
+
+    QString journal_mode;
+    qint64 mmap_size;
+    int cache_size;
+    QString synchronous;
+    QString temp_store;
+
+    // Log the query plan of library queries that scan a whole table.
+    bool explain_queries;
+  };
+
   static const int kSchemaVersion;
   static const char* kDatabaseFilename;
   static const char* kMagicAllSongsTables;
+  static const char* kSettingsGroup;
+  static const int kInterruptCheckInstructions;
+
+  // Backups copy this many pages at a time, waiting kBackupStepIntervalMsec
+  // between steps so other connections can get at the database.
+  static const int kBackupPagesPerStep;
+  static const int kBackupStepIntervalMsec;
+
+  // How often IntegrityCheck() does a full integrity_check rather than the
+  // quicker quick_check.
+  static const int kIntegrityCheckIntervalDays;
+
+  ~Database();
 
   QSqlDatabase Connect();
+  // Returns a connection for queries that only read.  In WAL mode this is a
+  // separate read-only connection for this thread, which sees a consistent
+  // snapshot while the writer carries on, so hold ReadMutex() rather than
+  // Mutex() while using it.  Otherwise it's the same as Connect().
+  QSqlDatabase ConnectForReading();
+  // nullptr when ConnectForReading() gives separate connections.  QMutexLocker
+  // does nothing with a null mutex.
+  QMutex* ReadMutex();
   bool CheckErrors(const QSqlQuery& query);
   QMutex* Mutex() { return &mutex_; }
 
+  // Returns a query on db that has already been prepared with sql.  Prepared
+  // statements are cached per connection and shared between callers, so the
+  // caller must hold Mutex() for as long as it uses the query.
+  QSqlQuery PreparedQuery(const QSqlDatabase& db, const QString& sql);
+
+  // Makes SQLite abandon whatever db is running, with SQLITE_INTERRUPT, as soon
+  // as *flag becomes non-zero.  Pass nullptr to remove the flag again.  The
+  // flag must outlive the call that removes it.
+  static void SetInterruptFlag(const QSqlDatabase& db, const QAtomicInt* flag);
+
   void RecreateAttachedDb(const QString& database_name);
   void ExecSchemaCommands(QSqlDatabase& db, const QString& schema,
                           int schema_version, bool in_transaction = false);
 
+  const TuningProfile& tuning_profile() const { return tuning_profile_; }
+
+  // Returns the settings actually in effect on this thread's connection, one
+  // line per database.  Shown in the debug console.
+  QStringList TuningStatus();
+
   int startup_schema_version() const { return startup_schema_version_; }
   int current_schema_version() const { return kSchemaVersion; }
 
@@ -89,6 +151,14 @@ class Database : public QObject {
  public slots:
   void DoBackup();
 
+ private slots:
+  void BackupStep();
+
+ protected:
+  // Drops every cached prepared statement.  This must be done before a
+  // connection is removed or a database is detached.
+  void ClearPreparedQueries();
+
  private:
   void UpdateMainSchema(QSqlDatabase* db);
 
@@ -103,9 +173,19 @@ class Database : public QObject {
   QStringList SongsTables(QSqlDatabase& db, int schema_version) const;
   bool IntegrityCheck(QSqlDatabase db);
   void BackupFile(const QString& filename);
+  void FinishBackup(bool success);
+  static QString BackupFilename(const QString& filename);
+  static bool BackupIsCurrent(const QString& filename);
   bool OpenDatabase(const QString& filename, sqlite3** connection) const;
+  void LoadTuningProfile();
+  void ApplyTuningProfile(QSqlDatabase& db, const QString& schema,
+                          bool is_temporary, bool read_only = false);
+  void RegisterTokenizers(QSqlDatabase& db);
+  QString ReadConnectionName() const;
 
   Application* app_;
+  // Set for a service's database.
+  Database* main_;
 
   // Alias -> filename
   QMap<QString, AttachedDatabase> attached_databases_;
@@ -124,12 +204,25 @@ class Database : public QObject {
   // Used by tests
   QString injected_database_name_;
 
-  uint query_hash_;
-  QStringList query_cache_;
+  TuningProfile tuning_profile_;
+
+  // Connection name -> SQL -> prepared query
+  QMutex prepared_queries_mutex_;
+  QMap<QString, QHash<QString, QSqlQuery>> prepared_queries_;
 
   // This is the schema version of Clementine's DB from the app's last run.
   int startup_schema_version_;
 
+  // See ConnectForReading()
+  bool read_connections_enabled_;
+
+  // The backup in progress, if any.  See BackupFile().
+  QString backup_filename_;
+  sqlite3* backup_source_;
+  sqlite3* backup_dest_;
+  sqlite3_backup* backup_;
+  int backup_task_id_;
+
   FRIEND_TEST(DatabaseTest, FTSOpenParsesSimpleInput);
   FRIEND_TEST(DatabaseTest, FTSOpenParsesUTF8Input);
   FRIEND_TEST(DatabaseTest, FTSOpenParsesMultipleTokens);
@@ -157,6 +250,20 @@ class Database : public QObject {
   static int FTSNext(sqlite3_tokenizer_cursor* cursor, const char** token,
                      int* bytes, int* start_offset, int* end_offset,
                      int* position);
+
+  // The same tokenizer for FTS5 tables.
+  typedef int (*FTS5TokenCallback)(void* context, int flags, const char* token,
+                                   int bytes, int start_offset, int end_offset);
+  static bool RegisterFTS5Tokenizer(sqlite3* handle);
+  static int FTS5Create(void*, const char** argv, int argc,
+                        Fts5Tokenizer** tokenizer);
+  static void FTS5Delete(Fts5Tokenizer* tokenizer);
+  static int InterruptCallback(void* flag);
+
+  static int FTS5Tokenize(Fts5Tokenizer* tokenizer, void* context, int flags,
+                          const char* text, int bytes,
+                          FTS5TokenCallback callback);
+
   struct Token {
     Token(const QString& token, int start, int end);
     QString token;
@@ -164,6 +271,9 @@ class Database : public QObject {
     int end_offset;
   };
 
+  // Splits input into lower case, undecorated words.  Offsets are in bytes.
+  static QList<Token> Tokenize(const char* input, int bytes);
+
   // Based on sqlite3_tokenizer.
   struct UnicodeTokenizer {
     const sqlite3_tokenizer_module* pModule;
@@ -184,6 +294,7 @@ class MemoryDatabase : public Database {
       : Database(app, parent, ":memory:") {}
   ~MemoryDatabase() {
     // Make sure Qt doesn't reuse the same database
+    ClearPreparedQueries();
     QSqlDatabase::removeDatabase(Connect().connectionName());
   }
 };
@@ -0,0 +1,110 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/fileexistencecache.h"
+
+#include <QFile>
+#include <QFuture>
+#include <QMutexLocker>
+#include <QtConcurrentRun>
+
+namespace {
+// Expired entries are only dropped when the cache has grown this much.
+const int kMinSweepSize = 10000;
+}  // namespace
+
+const int FileExistenceCache::kDefaultTtlMsec = 5 * 60 * 1000;  // 5 minutes
+const int FileExistenceCache::kMaxParallelChecks = 8;
+
+FileExistenceCache::FileExistenceCache(int ttl_msec)
+    : ttl_msec_(ttl_msec), next_sweep_size_(kMinSweepSize) {
+  clock_.start();
+  // The threads spend their time waiting on the filesystem, not the CPU.
+  pool_.setMaxThreadCount(kMaxParallelChecks);
+}
+
+FileExistenceCache* FileExistenceCache::Instance() {
+  static FileExistenceCache instance;
+  return &instance;
+}
+
+void FileExistenceCache::Record(const QString& path, bool exists) {
+  QMutexLocker l(&mutex_);
+  RecordLocked(path, exists, clock_.elapsed());
+}
+
+void FileExistenceCache::Record(const QStringList& paths, bool exists) {
+  QMutexLocker l(&mutex_);
+  const qint64 now = clock_.elapsed();
+  for (const QString& path : paths) RecordLocked(path, exists, now);
+}
+
+void FileExistenceCache::RecordLocked(const QString& path, bool exists,
+                                      qint64 now) {
+  Entry& entry = entries_[path];
+  entry.exists_ = exists;
+  entry.checked_msec_ = now;
+
+  if (entries_.count() < next_sweep_size_) return;
+
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (now - it->checked_msec_ > ttl_msec_) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  next_sweep_size_ = qMax(kMinSweepSize, entries_.count() * 2);
+}
+
+QVector<bool> FileExistenceCache::Exists(const QStringList& paths) {
+  QVector<bool> ret(paths.count());
+  QVector<int> unknown;
+
+  {
+    QMutexLocker l(&mutex_);
+    const qint64 now = clock_.elapsed();
+    for (int i = 0; i < paths.count(); ++i) {
+      auto it = entries_.constFind(paths[i]);
+      if (it != entries_.constEnd() && now - it->checked_msec_ <= ttl_msec_) {
+        ret[i] = it->exists_;
+      } else {
+        unknown << i;
+      }
+    }
+  }
+
+  if (unknown.isEmpty()) return ret;
+
+  // Each task takes every Nth unknown path, and writes only its own results.
+  const int tasks = qMin(kMaxParallelChecks, unknown.count());
+  bool* results = ret.data();
+  QList<QFuture<void>> futures;
+  for (int task = 0; task < tasks; ++task) {
+    futures << QtConcurrent::run(&pool_, [&, task]() {
+      for (int i = task; i < unknown.count(); i += tasks) {
+        results[unknown[i]] = QFile::exists(paths[unknown[i]]);
+      }
+    });
+  }
+  for (QFuture<void>& future : futures) future.waitForFinished();
+
+  QMutexLocker l(&mutex_);
+  const qint64 now = clock_.elapsed();
+  for (int index : unknown) RecordLocked(paths[index], ret[index], now);
+
+  return ret;
+}
@@ -0,0 +1,67 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CORE_FILEEXISTENCECACHE_H
+#define CORE_FILEEXISTENCECACHE_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+// Remembers for a while whether local files exist, so the playlists don't all
+// stat the same files again straight after the library watcher has seen them.
+// Paths that aren't known are statted in parallel, since on network
+// filesystems each one is a round trip.  Thread-safe.
+class FileExistenceCache {
+ public:
+  explicit FileExistenceCache(int ttl_msec = kDefaultTtlMsec);
+
+  static const int kDefaultTtlMsec;
+  static const int kMaxParallelChecks;
+
+  // The cache shared by the library watcher and the playlists.
+  static FileExistenceCache* Instance();
+
+  // Tells the cache about files somebody else has just looked at.
+  void Record(const QString& path, bool exists);
+  void Record(const QStringList& paths, bool exists);
+
+  // Returns whether each of the paths exists, in the same order.  Only the
+  // paths that aren't cached are checked on disk.  Blocks until done.
+  QVector<bool> Exists(const QStringList& paths);
+
+ private:
+  struct Entry {
+    bool exists_;
+    qint64 checked_msec_;
+  };
+
+  void RecordLocked(const QString& path, bool exists, qint64 now);
+
+  const int ttl_msec_;
+  QElapsedTimer clock_;
+  QThreadPool pool_;
+
+  QMutex mutex_;
+  QHash<QString, Entry> entries_;
+  int next_sweep_size_;
+};
+
+#endif  // CORE_FILEEXISTENCECACHE_H
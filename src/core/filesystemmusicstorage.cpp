@@ -28,6 +28,20 @@
 #include <QFile>
 #include <QUrl>
 
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const int FilesystemMusicStorage::kMaxParallelCopies = 3;
+const qint64 FilesystemMusicStorage::kCopyChunkSize = 8 * 1024 * 1024;
+
 FilesystemMusicStorage::FilesystemMusicStorage(const QString& root)
     : root_(root) {}
 
@@ -48,12 +62,96 @@ bool FilesystemMusicStorage::CopyToStorage(const CopyJob& job) {
   // Remove the destination file if it exists and we want to overwrite
   if (job.overwrite_ && dest.exists()) QFile::remove(dest.absoluteFilePath());
 
-  // Copy or move
+  // Copy or move.  A move within the same filesystem is just a rename.
   if (job.remove_original_)
     return QFile::rename(src.absoluteFilePath(), dest.absoluteFilePath());
   else
-    return QFile::copy(src.absoluteFilePath(), dest.absoluteFilePath());
+    return CopyFile(src.absoluteFilePath(), dest.absoluteFilePath(),
+                    job.progress_);
+}
+
+bool FilesystemMusicStorage::CopyFile(const QString& source,
+                                      const QString& destination,
+                                      const ProgressFunction& progress) {
+#ifdef Q_OS_LINUX
+  switch (FastCopyFile(source, destination, progress)) {
+    case FastCopy_Done:
+      QFile::setPermissions(destination, QFile::permissions(source));
+      return true;
+    case FastCopy_Failed:
+      return false;
+    case FastCopy_Unsupported:
+      break;
+  }
+#endif
+
+  return QFile::copy(source, destination);
+}
+
+#ifdef Q_OS_LINUX
+FilesystemMusicStorage::FastCopyResult FilesystemMusicStorage::FastCopyFile(
+    const QString& source, const QString& destination,
+    const ProgressFunction& progress) {
+  const int src_fd = open(QFile::encodeName(source).constData(), O_RDONLY);
+  if (src_fd == -1) return FastCopy_Unsupported;
+
+  struct stat src_stat;
+  if (fstat(src_fd, &src_stat) != 0) {
+    close(src_fd);
+    return FastCopy_Unsupported;
+  }
+
+  // Like QFile::copy, never overwrite an existing file.
+  const int dest_fd = open(QFile::encodeName(destination).constData(),
+                           O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (dest_fd == -1) {
+    close(src_fd);
+    return FastCopy_Unsupported;
+  }
+
+  FastCopyResult ret = FastCopy_Done;
+
+  // Btrfs and XFS can share the file's extents instead of copying them.
+  if (ioctl(dest_fd, FICLONE, src_fd) != 0) {
+#ifdef SYS_copy_file_range
+    // Otherwise the kernel can still copy the data without going through
+    // userspace, and NFS and CIFS can do it on the server.
+    const qint64 size = src_stat.st_size;
+    qint64 copied = 0;
+    while (copied < size) {
+      const ssize_t count =
+          syscall(SYS_copy_file_range, src_fd, nullptr, dest_fd, nullptr,
+                  size_t(qMin(kCopyChunkSize, size - copied)), 0u);
+      if (count == -1) {
+        // Old kernels can't copy between filesystems, and some filesystems
+        // don't support it at all.  Let QFile start again from scratch.
+        if (copied == 0 && (errno == ENOSYS || errno == EXDEV ||
+                            errno == EINVAL || errno == EOPNOTSUPP)) {
+          ret = FastCopy_Unsupported;
+        } else {
+          qLog(Warning) << "Failed to copy" << source << "to" << destination
+                        << ":" << strerror(errno);
+          ret = FastCopy_Failed;
+        }
+        break;
+      }
+      if (count == 0) break;
+
+      copied += count;
+      if (progress) progress(float(copied) / size);
+    }
+#else
+    ret = FastCopy_Unsupported;
+#endif
+  }
+
+  close(src_fd);
+  close(dest_fd);
+
+  if (ret != FastCopy_Done) QFile::remove(destination);
+  return ret;
 }
+#endif
 
 bool FilesystemMusicStorage::DeleteFromStorage(const DeleteJob& job) {
   QString path = job.metadata_.url().toLocalFile();
@@ -27,11 +27,27 @@ class FilesystemMusicStorage : public virtual MusicStorage {
   explicit FilesystemMusicStorage(const QString& root);
   ~FilesystemMusicStorage() {}
 
+  static const int kMaxParallelCopies;
+  static const qint64 kCopyChunkSize;
+
   QString LocalPath() const { return root_; }
 
+  int MaxParallelCopies() const { return kMaxParallelCopies; }
   bool CopyToStorage(const CopyJob& job);
   bool DeleteFromStorage(const DeleteJob& job);
 
+ private:
+  // Lets the filesystem share or copy the data itself where it can, so it
+  // doesn't pass through userspace.  Falls back to QFile::copy.
+  static bool CopyFile(const QString& source, const QString& destination,
+                       const ProgressFunction& progress);
+#ifdef Q_OS_LINUX
+  enum FastCopyResult { FastCopy_Done, FastCopy_Failed, FastCopy_Unsupported };
+  static FastCopyResult FastCopyFile(const QString& source,
+                                     const QString& destination,
+                                     const ProgressFunction& progress);
+#endif
+
  private:
   QString root_;
 };
@@ -21,6 +21,7 @@
 #define CORE_FILESYSTEMWATCHERINTERFACE_H_
 
 #include <QObject>
+#include <QStringList>
 
 class FileSystemWatcherInterface : public QObject {
   Q_OBJECT
@@ -34,7 +35,21 @@ class FileSystemWatcherInterface : public QObject {
   static FileSystemWatcherInterface* Create(QObject* parent = nullptr);
 
  signals:
+  // Emitted when the contents of a watched directory changed and the whole
+  // directory should be rescanned.
   void PathChanged(const QString& path);
+
+  // Emitted by listeners that know which files in a watched directory
+  // changed, instead of PathChanged.  files contains absolute paths of files
+  // that were created, modified or deleted.
+  void FilesChanged(const QString& path, const QStringList& files);
+
+  // Emitted when the operating system won't let us watch any more paths.
+  void WatchLimitReached();
+
+  // Emitted when the listener lost track of some changes, for example because
+  // the operating system's event queue overflowed.
+  void EventsLost();
 };
 
 #endif  // CORE_FILESYSTEMWATCHERINTERFACE_H_
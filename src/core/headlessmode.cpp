@@ -0,0 +1,120 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "headlessmode.h"
+
+#include <QModelIndex>
+
+#include "core/application.h"
+#include "core/commandlineoptions.h"
+#include "core/logging.h"
+#include "core/mimedata.h"
+#include "core/player.h"
+#include "core/timeconstants.h"
+#include "engines/enginebase.h"
+#include "playlist/playlist.h"
+#include "playlist/playlistmanager.h"
+#include "playlist/playlistsequence.h"
+
+HeadlessMode::HeadlessMode(Application* app, QObject* parent)
+    : QObject(parent), app_(app), sequence_(new PlaylistSequence) {
+  qLog(Info) << "Running headless";
+
+  app_->player()->Init();
+  app_->playlist_manager()->Init(app_->library_backend(),
+                                 app_->playlist_backend(), sequence_.get(),
+                                 nullptr);
+}
+
+HeadlessMode::~HeadlessMode() {}
+
+void HeadlessMode::CommandlineOptionsReceived(const QString& string_options) {
+  CommandlineOptions options;
+  options.Load(string_options.toLatin1());
+  CommandlineOptionsReceived(options);
+}
+
+void HeadlessMode::CommandlineOptionsReceived(
+    const CommandlineOptions& options) {
+  Player* player = app_->player();
+
+  switch (options.player_action()) {
+    case CommandlineOptions::Player_Play:
+      if (options.urls().empty()) player->Play();
+      break;
+    case CommandlineOptions::Player_PlayPause:
+      player->PlayPause();
+      break;
+    case CommandlineOptions::Player_Pause:
+      player->Pause();
+      break;
+    case CommandlineOptions::Player_Stop:
+      player->Stop();
+      break;
+    case CommandlineOptions::Player_StopAfterCurrent:
+      player->StopAfterCurrent();
+      break;
+    case CommandlineOptions::Player_Previous:
+      player->Previous();
+      break;
+    case CommandlineOptions::Player_Next:
+      player->Next();
+      break;
+    case CommandlineOptions::Player_RestartOrPrevious:
+      player->RestartOrPrevious();
+      break;
+    case CommandlineOptions::Player_None:
+      break;
+  }
+
+  if (!options.urls().empty()) {
+    MimeData* data = new MimeData;
+    data->setUrls(options.urls());
+    data->override_user_settings_ = true;
+    data->play_now_ =
+        options.player_action() == CommandlineOptions::Player_Play;
+
+    switch (options.url_list_action()) {
+      case CommandlineOptions::UrlList_Load:
+        data->clear_first_ = true;
+        break;
+      case CommandlineOptions::UrlList_CreateNew:
+        app_->playlist_manager()->New(options.playlist_name());
+        break;
+      case CommandlineOptions::UrlList_Append:
+      case CommandlineOptions::UrlList_None:
+        break;
+    }
+
+    app_->playlist_manager()->current()->dropMimeData(
+        data, Qt::CopyAction, -1, 0, QModelIndex());
+    delete data;
+  }
+
+  if (options.set_volume() != -1) player->SetVolume(options.set_volume());
+
+  if (options.volume_modifier() != 0)
+    player->SetVolume(player->GetVolume() + options.volume_modifier());
+
+  if (options.seek_to() != -1)
+    player->SeekTo(options.seek_to());
+  else if (options.seek_by() != 0)
+    player->SeekTo(player->engine()->position_nanosec() / kNsecPerSec +
+                   options.seek_by());
+
+  if (options.play_track_at() != -1)
+    player->PlayAt(options.play_track_at(), Engine::Manual, true);
+}
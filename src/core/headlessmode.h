@@ -0,0 +1,54 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_HEADLESSMODE_H_
+#define CORE_HEADLESSMODE_H_
+
+#include <memory>
+
+#include <QObject>
+
+class Application;
+class CommandlineOptions;
+class PlaylistSequence;
+
+// Used instead of MainWindow when Clementine is started with --headless.  It
+// starts the player and loads the playlists, but builds none of the views,
+// settings pages or the tray icon.  Clementine is then controlled through
+// the network remote, MPRIS and commandline options sent from another
+// instance.
+class HeadlessMode : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit HeadlessMode(Application* app, QObject* parent = nullptr);
+  ~HeadlessMode();
+
+ public slots:
+  void CommandlineOptionsReceived(const QString& string_options);
+
+ private:
+  void CommandlineOptionsReceived(const CommandlineOptions& options);
+
+ private:
+  Application* app_;
+
+  // PlaylistManager keeps the shuffle and repeat modes in this.  It's a
+  // widget, but it's never shown.
+  std::unique_ptr<PlaylistSequence> sequence_;
+};
+
+#endif  // CORE_HEADLESSMODE_H_
@@ -0,0 +1,169 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "inotifyfslistener.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <QFile>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include "core/logging.h"
+
+const int InotifyFSListener::kCoalesceMsec = 500;
+
+namespace {
+const uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                            IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB |
+                            IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+}
+
+InotifyFSListener::InotifyFSListener(QObject* parent)
+    : FileSystemWatcherInterface(parent),
+      fd_(-1),
+      notifier_(nullptr),
+      coalesce_timer_(new QTimer(this)) {
+  coalesce_timer_->setSingleShot(true);
+  coalesce_timer_->setInterval(kCoalesceMsec);
+  connect(coalesce_timer_, SIGNAL(timeout()), SLOT(EmitChanges()));
+}
+
+InotifyFSListener::~InotifyFSListener() {
+  if (fd_ != -1) close(fd_);
+}
+
+void InotifyFSListener::Init() {
+  fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd_ == -1) {
+    qLog(Warning) << "Failed to initialise inotify:" << strerror(errno);
+    return;
+  }
+
+  notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
+  connect(notifier_, SIGNAL(activated(int)), SLOT(ReadEvents()));
+}
+
+bool InotifyFSListener::AddPath(const QString& path) {
+  if (fd_ == -1) return false;
+  if (watches_by_path_.contains(path)) return true;
+
+  const int wd = inotify_add_watch(fd_, QFile::encodeName(path).constData(),
+                                   kWatchMask);
+  if (wd == -1) {
+    // ENOSPC means we ran out of max_user_watches.
+    qLog(Warning) << "Failed to watch" << path << strerror(errno);
+    if (errno == ENOSPC) emit WatchLimitReached();
+    return false;
+  }
+
+  paths_by_watch_[wd] = path;
+  watches_by_path_[path] = wd;
+  return true;
+}
+
+void InotifyFSListener::RemovePath(const QString& path) {
+  if (!watches_by_path_.contains(path)) return;
+
+  const int wd = watches_by_path_.take(path);
+  paths_by_watch_.remove(wd);
+  inotify_rm_watch(fd_, wd);
+
+  changed_dirs_.remove(path);
+  changed_files_.remove(path);
+}
+
+void InotifyFSListener::Clear() {
+  for (int wd : paths_by_watch_.keys()) {
+    inotify_rm_watch(fd_, wd);
+  }
+  paths_by_watch_.clear();
+  watches_by_path_.clear();
+  changed_dirs_.clear();
+  changed_files_.clear();
+}
+
+void InotifyFSListener::ReadEvents() {
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  forever {
+    const ssize_t len = read(fd_, buffer, sizeof(buffer));
+    if (len <= 0) break;
+
+    for (const char* p = buffer; p < buffer + len;) {
+      const struct inotify_event* event =
+          reinterpret_cast<const struct inotify_event*>(p);
+      p += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // The kernel dropped events, so we don't know what changed.
+        qLog(Warning) << "inotify event queue overflowed";
+        emit EventsLost();
+        continue;
+      }
+
+      const QString path = paths_by_watch_.value(event->wd);
+      if (path.isEmpty()) continue;
+
+      if (event->mask & IN_IGNORED) {
+        // The kernel removed the watch, probably because the directory was
+        // deleted.
+        paths_by_watch_.remove(event->wd);
+        watches_by_path_.remove(path);
+        changed_dirs_ << path;
+      } else if (event->mask & (IN_ISDIR | IN_DELETE_SELF | IN_MOVE_SELF) ||
+                 event->len == 0) {
+        // Subdirectories were added or removed, or the directory itself went
+        // away.
+        changed_dirs_ << path;
+      } else {
+        changed_files_[path] << path + "/" + QFile::decodeName(event->name);
+      }
+    }
+  }
+
+  // Don't restart the timer if it's already running, so a constant stream of
+  // changes can't delay the rescan forever.
+  if ((!changed_dirs_.isEmpty() || !changed_files_.isEmpty()) &&
+      !coalesce_timer_->isActive()) {
+    coalesce_timer_->start();
+  }
+}
+
+void InotifyFSListener::EmitChanges() {
+  const QSet<QString> changed_dirs = changed_dirs_;
+  const QHash<QString, QSet<QString>> changed_files = changed_files_;
+  changed_dirs_.clear();
+  changed_files_.clear();
+
+  for (const QString& path : changed_dirs) {
+    qLog(Debug) << "Directory changed:" << path;
+    emit PathChanged(path);
+  }
+
+  for (auto it = changed_files.constBegin(); it != changed_files.constEnd();
+       ++it) {
+    // A full rescan of the directory covers these files already.
+    if (changed_dirs.contains(it.key())) continue;
+
+    qLog(Debug) << it.value().count() << "files changed in" << it.key();
+    emit FilesChanged(it.key(), it.value().toList());
+  }
+}
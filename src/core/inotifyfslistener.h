@@ -0,0 +1,69 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_INOTIFYFSLISTENER_H_
+#define CORE_INOTIFYFSLISTENER_H_
+
+#include "filesystemwatcherinterface.h"
+
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+class QSocketNotifier;
+class QTimer;
+
+// Watches directories with inotify directly.  Unlike QFileSystemWatcher this
+// tells us which files in a directory changed, so the library only has to
+// rescan those.  Events are coalesced for a short while before they are
+// emitted.
+class InotifyFSListener : public FileSystemWatcherInterface {
+  Q_OBJECT
+
+ public:
+  explicit InotifyFSListener(QObject* parent = nullptr);
+  ~InotifyFSListener();
+
+  void Init();
+  bool AddPath(const QString& path);
+  void RemovePath(const QString& path);
+  void Clear();
+
+  // False if inotify couldn't be initialised, in which case another listener
+  // should be used instead.
+  bool is_valid() const { return fd_ != -1; }
+
+ private slots:
+  void ReadEvents();
+  void EmitChanges();
+
+ private:
+  static const int kCoalesceMsec;
+
+  int fd_;
+  QSocketNotifier* notifier_;
+  QTimer* coalesce_timer_;
+
+  QHash<int, QString> paths_by_watch_;
+  QHash<QString, int> watches_by_path_;
+
+  // Changes seen since they were last emitted.  Directories whose structure
+  // changed get a PathChanged, the others get a FilesChanged.
+  QSet<QString> changed_dirs_;
+  QHash<QString, QSet<QString>> changed_files_;
+};
+
+#endif  // CORE_INOTIFYFSLISTENER_H_
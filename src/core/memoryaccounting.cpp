@@ -0,0 +1,405 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/memoryaccounting.h"
+
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#ifdef Q_OS_DARWIN
+#include <dispatch/dispatch.h>
+#endif
+
+#include <algorithm>
+
+#include <QPair>
+#include <QPixmapCache>
+#include <QSettings>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include "core/logging.h"
+
+const char* MemoryAccounting::kSettingsGroup = "MemoryBudgets";
+const char* MemoryAccounting::kTotalBudgetKey = "total";
+const int MemoryAccounting::kEnforceIntervalMsec = 60 * 1000;
+const int MemoryAccounting::kPressureIntervalMsec = 10 * 1000;
+const int MemoryAccounting::kEstimatedSongBytes = 1024;
+
+namespace {
+
+#ifdef Q_OS_UNIX
+int sSignalFd[2] = {-1, -1};
+
+void HandleSigusr1(int) {
+  // Only async-signal-safe things are allowed here, so just wake up the
+  // notifier.
+  char c = 1;
+  ssize_t ignored = ::write(sSignalFd[0], &c, sizeof(c));
+  Q_UNUSED(ignored);
+}
+#endif
+
+QString FormatBytes(qint64 bytes) {
+  return QString::number(bytes / 1024.0 / 1024.0, 'f', 1) + " MB";
+}
+
+// Below this the views would be repainting everything from scratch.
+const int kMinPixmapCacheKb = 2 * 1024;
+
+#ifdef Q_OS_LINUX
+// Woken when tasks spend 150ms of any 2 second window waiting for memory.
+// Unprivileged processes can only use windows that are multiples of 2s.
+const char* kPressureTrigger = "some 150000 2000000";
+#endif
+
+#ifdef Q_OS_DARWIN
+void MemoryPressureEvent(void* context) {
+  QMetaObject::invokeMethod(reinterpret_cast<MemoryAccounting*>(context),
+                            "RelieveMemoryPressure", Qt::QueuedConnection);
+}
+#endif
+
+}  // namespace
+
+MemoryAccounting* MemoryAccounting::Instance() {
+  static MemoryAccounting* instance = new MemoryAccounting;
+  return instance;
+}
+
+MemoryAccounting::MemoryAccounting()
+    : total_budget_(0),
+      enforce_timer_(new QTimer(this)),
+      signal_notifier_(nullptr),
+      watching_pressure_(false) {
+  enforce_timer_->setInterval(kEnforceIntervalMsec);
+  connect(enforce_timer_, SIGNAL(timeout()), SLOT(EnforceBudgets()));
+
+  // QPixmapCache doesn't say how full it is, so its limit is the best we can
+  // report.  Lowering it evicts straight away.
+  Register(nullptr, "pixmap_cache", "QPixmapCache (limit)",
+           []() { return qint64(QPixmapCache::cacheLimit()) * 1024; },
+           [](qint64 bytes) {
+             QPixmapCache::setCacheLimit(
+                 qMax(int(bytes / 1024), kMinPixmapCacheKb));
+           },
+           Priority_Disposable);
+
+  ReloadSettings();
+}
+
+void MemoryAccounting::Register(QObject* owner, const QString& id,
+                                const QString& description,
+                                Estimator estimator, Evictor evictor,
+                                Priority priority) {
+  {
+    QMutexLocker l(&mutex_);
+    registrations_ << Registration{owner,     id,      description,
+                                   estimator, evictor, priority};
+  }
+
+  if (owner) {
+    // Direct, so the registration is gone before anything else can call the
+    // estimator.
+    connect(owner, SIGNAL(destroyed(QObject*)), SLOT(OwnerDestroyed(QObject*)),
+            Qt::ConnectionType(Qt::DirectConnection | Qt::UniqueConnection));
+  }
+}
+
+void MemoryAccounting::OwnerDestroyed(QObject* owner) {
+  QMutexLocker l(&mutex_);
+  for (int i = registrations_.count() - 1; i >= 0; --i) {
+    if (registrations_[i].owner_ == owner) registrations_.removeAt(i);
+  }
+}
+
+void MemoryAccounting::ReloadSettings() {
+  budgets_.clear();
+  total_budget_ = 0;
+
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  for (const QString& id : s.childKeys()) {
+    const qint64 megabytes = s.value(id).toLongLong();
+    if (megabytes <= 0) continue;
+    if (id == kTotalBudgetKey) {
+      total_budget_ = megabytes * 1024 * 1024;
+    } else {
+      budgets_[id] = megabytes * 1024 * 1024;
+    }
+  }
+
+  if (budgets_.isEmpty() && !total_budget_) {
+    enforce_timer_->stop();
+  } else {
+    enforce_timer_->start();
+  }
+}
+
+QList<MemoryAccounting::Usage> MemoryAccounting::GetUsage() {
+  QList<Usage> ret;
+  QMap<QString, int> index_by_id;
+
+  QMutexLocker l(&mutex_);
+  for (const Registration& registration : registrations_) {
+    const qint64 bytes = registration.estimator_();
+
+    auto it = index_by_id.find(registration.id_);
+    if (it == index_by_id.end()) {
+      index_by_id[registration.id_] = ret.count();
+      ret << Usage{registration.id_, registration.description_, bytes,
+                   budgets_.value(registration.id_),
+                   registration.priority_ == Priority_Disk};
+    } else {
+      ret[it.value()].bytes_ += bytes;
+    }
+  }
+
+  return ret;
+}
+
+QStringList MemoryAccounting::ReportLines() {
+  QStringList ret;
+  qint64 total = 0;
+  qint64 disk = 0;
+  for (const Usage& usage : GetUsage()) {
+    QString line = QString("%1 %2 %3")
+                       .arg(usage.id_, -24)
+                       .arg(FormatBytes(usage.bytes_), 10)
+                       .arg(usage.description_);
+    if (usage.budget_bytes_) {
+      line += QString(" (budget %1)").arg(FormatBytes(usage.budget_bytes_));
+    }
+    ret << line;
+    if (usage.on_disk_) {
+      disk += usage.bytes_;
+    } else {
+      total += usage.bytes_;
+    }
+  }
+  QString line = QString("%1 %2").arg("total", -24).arg(FormatBytes(total), 10);
+  if (total_budget_) {
+    line += QString(" (budget %1)").arg(FormatBytes(total_budget_));
+  }
+  ret << line;
+  ret << QString("%1 %2").arg("on disk", -24).arg(FormatBytes(disk), 10);
+  return ret;
+}
+
+void MemoryAccounting::LogReport() {
+  qLog(Info) << "Estimated memory usage:";
+  for (const QString& line : ReportLines()) {
+    qLog(Info) << line;
+  }
+}
+
+void MemoryAccounting::EnforceBudgets() {
+  // Evictors are called without the lock held, since they might destroy
+  // other owners.
+  QList<QPair<Evictor, qint64>> evictions;
+
+  {
+    QMutexLocker l(&mutex_);
+    const int count = registrations_.count();
+    QVector<qint64> bytes(count);
+    for (int i = 0; i < count; ++i) bytes[i] = registrations_[i].estimator_();
+    QVector<qint64> targets = bytes;
+
+    for (auto budget = budgets_.constBegin(); budget != budgets_.constEnd();
+         ++budget) {
+      qint64 total = 0;
+      for (int i = 0; i < count; ++i) {
+        if (registrations_[i].id_ == budget.key()) total += bytes[i];
+      }
+
+      if (total <= budget.value()) continue;
+
+      qLog(Info) << budget.key() << "is using" << FormatBytes(total)
+                 << "which is over its budget of"
+                 << FormatBytes(budget.value());
+
+      // Each owner gives up its share.
+      for (int i = 0; i < count; ++i) {
+        if (registrations_[i].id_ != budget.key()) continue;
+        targets[i] = budget.value() * bytes[i] / total;
+      }
+    }
+
+    if (total_budget_) {
+      qint64 total = 0;
+      for (int i = 0; i < count; ++i) {
+        if (registrations_[i].priority_ != Priority_Disk) total += targets[i];
+      }
+
+      if (total > total_budget_) {
+        qLog(Info) << "Caches are using" << FormatBytes(total)
+                   << "which is over the total budget of"
+                   << FormatBytes(total_budget_);
+        ShrinkInPriorityOrder(total - total_budget_, &targets);
+      }
+    }
+
+    for (int i = 0; i < count; ++i) {
+      if (registrations_[i].evictor_ && targets[i] < bytes[i]) {
+        evictions << qMakePair(registrations_[i].evictor_, targets[i]);
+      }
+    }
+  }
+
+  for (const auto& eviction : evictions) {
+    eviction.first(eviction.second);
+  }
+}
+
+void MemoryAccounting::ShrinkInPriorityOrder(qint64 excess,
+                                             QVector<qint64>* targets) const {
+  QList<int> order;
+  for (int i = 0; i < registrations_.count(); ++i) {
+    if (registrations_[i].evictor_ &&
+        registrations_[i].priority_ != Priority_Disk) {
+      order << i;
+    }
+  }
+  std::sort(order.begin(), order.end(), [this, targets](int a, int b) {
+    if (registrations_[a].priority_ != registrations_[b].priority_) {
+      return registrations_[a].priority_ < registrations_[b].priority_;
+    }
+    return (*targets)[a] > (*targets)[b];
+  });
+
+  for (int i : order) {
+    if (excess <= 0) break;
+    const qint64 give_up = qMin(excess, (*targets)[i]);
+    (*targets)[i] -= give_up;
+    excess -= give_up;
+  }
+}
+
+void MemoryAccounting::RelieveMemoryPressure() {
+  if (last_pressure_.isValid() &&
+      last_pressure_.elapsed() < kPressureIntervalMsec) {
+    return;
+  }
+  last_pressure_.start();
+
+  QList<QPair<Evictor, qint64>> evictions;
+  qint64 freed = 0;
+
+  {
+    QMutexLocker l(&mutex_);
+    for (const Registration& registration : registrations_) {
+      if (!registration.evictor_) continue;
+
+      // Disposable things can go almost entirely, the rest by half.
+      int keep_divisor;
+      switch (registration.priority_) {
+        case Priority_Disposable:
+          keep_divisor = 4;
+          break;
+        case Priority_Normal:
+          keep_divisor = 2;
+          break;
+        default:
+          continue;
+      }
+
+      const qint64 bytes = registration.estimator_();
+      evictions << qMakePair(registration.evictor_, bytes / keep_divisor);
+      freed += bytes - bytes / keep_divisor;
+    }
+  }
+
+  qLog(Info) << "The system is short of memory, shrinking caches by about"
+             << FormatBytes(freed);
+
+  for (const auto& eviction : evictions) {
+    eviction.first(eviction.second);
+  }
+}
+
+void MemoryAccounting::WatchMemoryPressure() {
+  if (watching_pressure_) return;
+  watching_pressure_ = true;
+
+#if defined(Q_OS_LINUX)
+  const int fd =
+      ::open("/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd == -1) {
+    qLog(Debug) << "No pressure stall information, not watching memory";
+    return;
+  }
+
+  // The kernel wants the terminating null too.
+  if (::write(fd, kPressureTrigger, strlen(kPressureTrigger) + 1) < 0) {
+    qLog(Warning) << "Couldn't set a memory pressure trigger:"
+                  << strerror(errno);
+    ::close(fd);
+    return;
+  }
+
+  // Triggers are reported as POLLPRI.
+  QSocketNotifier* notifier =
+      new QSocketNotifier(fd, QSocketNotifier::Exception, this);
+  connect(notifier, SIGNAL(activated(int)), SLOT(RelieveMemoryPressure()));
+#elif defined(Q_OS_DARWIN)
+  dispatch_source_t source = dispatch_source_create(
+      DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+      DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+      dispatch_get_main_queue());
+  dispatch_set_context(source, this);
+  dispatch_source_set_event_handler_f(source, &MemoryPressureEvent);
+  dispatch_resume(source);
+#endif
+}
+
+void MemoryAccounting::LogReportOnSignal() {
+#ifdef Q_OS_UNIX
+  if (signal_notifier_) return;
+
+  if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sSignalFd) != 0) {
+    qLog(Warning) << "Couldn't create a socket pair for SIGUSR1";
+    return;
+  }
+
+  signal_notifier_ =
+      new QSocketNotifier(sSignalFd[1], QSocketNotifier::Read, this);
+  connect(signal_notifier_, SIGNAL(activated(int)), SLOT(SignalReceived()));
+
+  struct sigaction action;
+  action.sa_handler = HandleSigusr1;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &action, nullptr);
+#endif
+}
+
+void MemoryAccounting::SignalReceived() {
+#ifdef Q_OS_UNIX
+  char c;
+  ssize_t ignored = ::read(sSignalFd[1], &c, sizeof(c));
+  Q_UNUSED(ignored);
+#endif
+  LogReport();
+}
@@ -0,0 +1,146 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_MEMORYACCOUNTING_H_
+#define CORE_MEMORYACCOUNTING_H_
+
+#include <functional>
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+class QSocketNotifier;
+class QTimer;
+
+// Keeps track of roughly how much memory the big caches and containers are
+// using, so growth can be pinned on a subsystem.  Each one registers a
+// function that estimates its size, and optionally one that shrinks it.
+//
+// Budgets are read from the "MemoryBudgets" settings group: each key is a
+// subsystem's id and the value is its budget in megabytes.  Subsystems over
+// their budget are asked to shrink every minute.  The "total" key is a budget
+// for everything in memory together - when it's exceeded, owners are asked to
+// shrink in priority order until it isn't.  When the system is short of
+// memory, disposable and normal owners are shrunk whatever their budgets.
+//
+// Owners can register from any thread, but estimators are called on the GUI
+// thread and must be safe to call from there.  Evictors are only called for
+// owners that live in the GUI thread.
+class MemoryAccounting : public QObject {
+  Q_OBJECT
+
+ public:
+  static const char* kSettingsGroup;
+  static const char* kTotalBudgetKey;
+  static const int kEnforceIntervalMsec;
+  // Memory pressure can be reported many times a second, but evicting again
+  // straight away wouldn't help.
+  static const int kPressureIntervalMsec;
+
+  // A guess at the size of a song with typical metadata, including its
+  // strings.
+  static const int kEstimatedSongBytes;
+
+  typedef std::function<qint64()> Estimator;
+  // Given the number of bytes this owner should shrink to.
+  typedef std::function<void(qint64)> Evictor;
+
+  // Owners are shrunk lowest priority first.
+  enum Priority {
+    // Quick to fill again, like rendered pixmaps.
+    Priority_Disposable,
+    Priority_Normal,
+    // Slow or impossible to get back.  Only shrunk to meet a budget.
+    Priority_Precious,
+    // On disk, so not counted towards the total or shrunk for memory
+    // pressure.
+    Priority_Disk,
+  };
+
+  struct Usage {
+    QString id_;
+    QString description_;
+    qint64 bytes_;
+    // 0 if there isn't one.
+    qint64 budget_bytes_;
+    bool on_disk_;
+  };
+
+  static MemoryAccounting* Instance();
+
+  // Several owners can register under the same id, like one for each
+  // playlist - their estimates are added up.  The registration goes away when
+  // owner is destroyed.  Pass a null owner for things that live forever.
+  void Register(QObject* owner, const QString& id, const QString& description,
+                Estimator estimator, Evictor evictor = Evictor(),
+                Priority priority = Priority_Normal);
+
+  QList<Usage> GetUsage();
+  QStringList ReportLines();
+
+  // Writes the report to the log when the process gets SIGUSR1.  Does
+  // nothing where there aren't signals.
+  void LogReportOnSignal();
+
+  // Shrinks caches when the system says it's short of memory: from pressure
+  // stall information on Linux, or memory pressure events on Mac.
+  void WatchMemoryPressure();
+
+ public slots:
+  void ReloadSettings();
+  void EnforceBudgets();
+  void RelieveMemoryPressure();
+  void LogReport();
+
+ private slots:
+  void OwnerDestroyed(QObject* owner);
+  void SignalReceived();
+
+ private:
+  MemoryAccounting();
+
+  struct Registration {
+    QObject* owner_;
+    QString id_;
+    QString description_;
+    Estimator estimator_;
+    Evictor evictor_;
+    Priority priority_;
+  };
+
+  // Lowers targets, lowest priority and biggest first, until excess bytes
+  // have been found.  Call with mutex_ held.
+  void ShrinkInPriorityOrder(qint64 excess, QVector<qint64>* targets) const;
+
+  // Guards registrations_, which can change when an owner in another thread
+  // is destroyed.
+  QMutex mutex_;
+  QList<Registration> registrations_;
+  QMap<QString, qint64> budgets_;
+  // 0 if there isn't one.
+  qint64 total_budget_;
+  QTimer* enforce_timer_;
+  QSocketNotifier* signal_notifier_;
+  bool watching_pressure_;
+  QElapsedTimer last_pressure_;
+};
+
+#endif  // CORE_MEMORYACCOUNTING_H_
@@ -21,6 +21,7 @@
 #include "mergedproxymodel.h"
 #include "core/logging.h"
 
+#include <QHash>
 #include <QStringList>
 
 #include <functional>
@@ -35,6 +36,7 @@ using std::placeholders::_2;
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 
+using boost::multi_index::hashed_non_unique;
 using boost::multi_index::hashed_unique;
 using boost::multi_index::identity;
 using boost::multi_index::indexed_by;
@@ -49,13 +51,15 @@ namespace {
 
 struct Mapping {
   explicit Mapping(const QModelIndex& _source_index) :
-    source_index(_source_index) {}
+    source_index(_source_index), model(_source_index.model()) {}
 
   QModelIndex source_index;
+  const QAbstractItemModel* model;
 };
 
 struct tag_by_source {};
 struct tag_by_pointer {};
+struct tag_by_model {};
 
 }  // namespace
 
@@ -66,11 +70,21 @@ class MergedProxyModelPrivate {
       indexed_by<
           hashed_unique<tag<tag_by_source>,
                         member<Mapping, QModelIndex, &Mapping::source_index> >,
-          ordered_unique<tag<tag_by_pointer>, identity<Mapping*> > > >
+          ordered_unique<tag<tag_by_pointer>, identity<Mapping*> >,
+          // So a submodel's mappings can be dropped without looking at
+          // everyone else's.
+          hashed_non_unique<tag<tag_by_model>,
+                            member<Mapping, const QAbstractItemModel*,
+                                   &Mapping::model> > > >
       MappingContainer;
 
  public:
   MappingContainer mappings_;
+
+  // The reverse of merge_points_.  A QPersistentModelIndex hashes by its
+  // shared data, which every persistent index to the same item uses, so
+  // this keeps working as rows move around.
+  QHash<QPersistentModelIndex, QAbstractItemModel*> submodels_;
 };
 
 MergedProxyModel::MergedProxyModel(QObject* parent)
@@ -86,6 +100,21 @@ void MergedProxyModel::DeleteAllMappings() {
   qDeleteAll(begin, end);
 }
 
+void MergedProxyModel::DeleteMappings(const QAbstractItemModel* model) {
+  auto& by_model = p_->mappings_.get<tag_by_model>();
+  const auto range = by_model.equal_range(model);
+  qDeleteAll(range.first, range.second);
+  by_model.erase(range.first, range.second);
+}
+
+QAbstractItemModel* MergedProxyModel::SubModelAt(
+    const QModelIndex& source_parent) const {
+  if (p_->submodels_.isEmpty() || source_parent.model() != sourceModel()) {
+    return nullptr;
+  }
+  return p_->submodels_.value(QPersistentModelIndex(source_parent));
+}
+
 void MergedProxyModel::AddSubModel(const QModelIndex& source_parent,
                                    QAbstractItemModel* submodel) {
   connect(submodel, SIGNAL(modelReset()), this, SLOT(SubModelReset()));
@@ -106,14 +135,16 @@ void MergedProxyModel::AddSubModel(const QModelIndex& source_parent,
   if (rows) beginInsertRows(proxy_parent, 0, rows - 1);
 
   merge_points_.insert(submodel, source_parent);
+  p_->submodels_.insert(source_parent, submodel);
 
   if (rows) endInsertRows();
 }
 
 void MergedProxyModel::RemoveSubModel(const QModelIndex& source_parent) {
   // Find the submodel that the parent corresponded to
-  QAbstractItemModel* submodel = merge_points_.key(source_parent);
+  QAbstractItemModel* submodel = SubModelAt(source_parent);
   merge_points_.remove(submodel);
+  p_->submodels_.remove(source_parent);
 
   // The submodel might have been deleted already so we must be careful not
   // to dereference it.
@@ -128,16 +159,7 @@ void MergedProxyModel::RemoveSubModel(const QModelIndex& source_parent) {
   resetting_model_ = nullptr;
 
   // Delete all the mappings that reference the submodel
-  auto it = p_->mappings_.get<tag_by_pointer>().begin();
-  auto end = p_->mappings_.get<tag_by_pointer>().end();
-  while (it != end) {
-    if ((*it)->source_index.model() == submodel) {
-      delete *it;
-      it = p_->mappings_.get<tag_by_pointer>().erase(it);
-    } else {
-      ++it;
-    }
-  }
+  DeleteMappings(submodel);
 }
 
 void MergedProxyModel::setSourceModel(QAbstractItemModel* source_model) {
@@ -189,6 +211,7 @@ void MergedProxyModel::SourceModelReset() {
 
   // Clear the containers
   p_->mappings_.clear();
+  p_->submodels_.clear();
   merge_points_.clear();
 
   endResetModel();
@@ -212,16 +235,7 @@ void MergedProxyModel::SubModelReset() {
   resetting_model_ = nullptr;
 
   // Delete all the mappings that reference the submodel
-  auto it = p_->mappings_.get<tag_by_pointer>().begin();
-  auto end = p_->mappings_.get<tag_by_pointer>().end();
-  while (it != end) {
-    if ((*it)->source_index.model() == submodel) {
-      delete *it;
-      it = p_->mappings_.get<tag_by_pointer>().erase(it);
-    } else {
-      ++it;
-    }
-  }
+  DeleteMappings(submodel);
 
   // "Insert" items from the newly reset submodel
   int count = submodel->rowCount();
@@ -303,7 +317,7 @@ QModelIndex MergedProxyModel::index(int row, int column,
     source_index = sourceModel()->index(row, column, QModelIndex());
   } else {
     QModelIndex source_parent = mapToSource(parent);
-    const QAbstractItemModel* child_model = merge_points_.key(source_parent);
+    const QAbstractItemModel* child_model = SubModelAt(source_parent);
 
     if (child_model)
       source_index = child_model->index(row, column, QModelIndex());
@@ -332,7 +346,7 @@ int MergedProxyModel::rowCount(const QModelIndex& parent) const {
   QModelIndex source_parent = mapToSource(parent);
   if (!IsKnownModel(source_parent.model())) return 0;
 
-  const QAbstractItemModel* child_model = merge_points_.key(source_parent);
+  const QAbstractItemModel* child_model = SubModelAt(source_parent);
   if (child_model) {
     // Query the source model but disregard what it says, so it gets a chance
     // to lazy load
@@ -350,7 +364,7 @@ int MergedProxyModel::columnCount(const QModelIndex& parent) const {
   QModelIndex source_parent = mapToSource(parent);
   if (!IsKnownModel(source_parent.model())) return 0;
 
-  const QAbstractItemModel* child_model = merge_points_.key(source_parent);
+  const QAbstractItemModel* child_model = SubModelAt(source_parent);
   if (child_model) return child_model->columnCount(QModelIndex());
   return source_parent.model()->columnCount(source_parent);
 }
@@ -361,7 +375,7 @@ bool MergedProxyModel::hasChildren(const QModelIndex& parent) const {
   QModelIndex source_parent = mapToSource(parent);
   if (!IsKnownModel(source_parent.model())) return false;
 
-  const QAbstractItemModel* child_model = merge_points_.key(source_parent);
+  const QAbstractItemModel* child_model = SubModelAt(source_parent);
 
   if (child_model)
     return child_model->hasChildren(QModelIndex()) ||
@@ -474,9 +488,8 @@ QAbstractItemModel* MergedProxyModel::GetModel(const QModelIndex& source_index)
   // but without the const_cast
   const QAbstractItemModel* const_model = source_index.model();
   if (const_model == sourceModel()) return sourceModel();
-  for (QAbstractItemModel* submodel : merge_points_.keys()) {
-    if (submodel == const_model) return submodel;
-  }
+  auto it = merge_points_.find(const_cast<QAbstractItemModel*>(const_model));
+  if (it != merge_points_.end()) return it.key();
   return nullptr;
 }
 
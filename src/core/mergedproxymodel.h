@@ -99,6 +99,9 @@ class MergedProxyModel : public QAbstractProxyModel {
                                     QAbstractItemModel* model) const;
   QAbstractItemModel* GetModel(const QModelIndex& source_index) const;
   void DeleteAllMappings();
+  void DeleteMappings(const QAbstractItemModel* model);
+  // Returns the submodel merged in at source_parent, if there is one.
+  QAbstractItemModel* SubModelAt(const QModelIndex& source_parent) const;
   bool IsKnownModel(const QAbstractItemModel* model) const;
 
   QMap<QAbstractItemModel*, QPersistentModelIndex> merge_points_;
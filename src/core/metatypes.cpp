@@ -39,6 +39,7 @@
 #include "internet/podcasts/podcastepisode.h"
 #include "internet/somafm/somafmservice.h"
 #include "library/directory.h"
+#include "library/librarychanges.h"
 #include "playlist/playlist.h"
 #include "songinfo/collapsibleinfopane.h"
 #include "ui/equalizer.h"
@@ -70,6 +71,7 @@ void RegisterMetaTypes() {
   qRegisterMetaType<GstElement*>("GstElement*");
   qRegisterMetaType<GstEngine::OutputDetails>("GstEngine::OutputDetails");
   qRegisterMetaType<GstEnginePipeline*>("GstEnginePipeline*");
+  qRegisterMetaType<LibraryChanges>("LibraryChanges");
   qRegisterMetaType<PlaylistItemList>("PlaylistItemList");
   qRegisterMetaType<PlaylistItemPtr>("PlaylistItemPtr");
   qRegisterMetaType<PodcastEpisodeList>("PodcastEpisodeList");
@@ -0,0 +1,32 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/metriccounter.h"
+
+MetricCounter::MetricCounter(const char* name, const char* help, double scale)
+    : name_(name), help_(help), scale_(scale), value_(0) {
+  // Counters are static objects, so this all happens before main().
+  Registry()->append(this);
+}
+
+QList<const MetricCounter*>* MetricCounter::Registry() {
+  // Created on first use so it doesn't matter which counter is constructed
+  // first.
+  static QList<const MetricCounter*> registry;
+  return &registry;
+}
+
+QList<const MetricCounter*> MetricCounter::All() { return *Registry(); }
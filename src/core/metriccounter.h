@@ -0,0 +1,57 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_METRICCOUNTER_H_
+#define CORE_METRICCOUNTER_H_
+
+#include <atomic>
+
+#include <boost/noncopyable.hpp>
+
+#include <QList>
+#include <QtGlobal>
+
+// A counter that only ever goes up, published by the metrics endpoint.
+// Define them as static objects next to the code that bumps them - they
+// register themselves.  Adding to one is a single relaxed atomic add, so they
+// can be used on any thread, however hot.
+class MetricCounter : boost::noncopyable {
+ public:
+  // name and help must be string literals.  The value is multiplied by scale
+  // when it's published, so a counter of nanoseconds can be published in
+  // seconds.
+  MetricCounter(const char* name, const char* help, double scale = 1.0);
+
+  void Add(qint64 n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+
+  const char* name() const { return name_; }
+  const char* help() const { return help_; }
+  double value() const {
+    return value_.load(std::memory_order_relaxed) * scale_;
+  }
+
+  static QList<const MetricCounter*> All();
+
+ private:
+  static QList<const MetricCounter*>* Registry();
+
+  const char* name_;
+  const char* help_;
+  const double scale_;
+  std::atomic<qint64> value_;
+};
+
+#endif  // CORE_METRICCOUNTER_H_
@@ -27,6 +27,7 @@
 
 #include <QApplication>
 #include <QDBusConnection>
+#include <QTimer>
 #include <QtConcurrentRun>
 
 #include "config.h"
@@ -83,7 +84,20 @@ const char* Mpris2::kMprisObjectPath = "/org/mpris/MediaPlayer2";
 const char* Mpris2::kServiceName = "org.mpris.MediaPlayer2.clementine";
 const char* Mpris2::kFreedesktopPath = "org.freedesktop.DBus.Properties";
 
-Mpris2::Mpris2(Application* app, QObject* parent) : QObject(parent), app_(app) {
+// The TrackList interface only shows this many tracks around the current one,
+// so clients don't fetch metadata for a whole 50,000 track playlist.
+const int Mpris2::kMaxTrackListSize = 500;
+
+Mpris2::Mpris2(Application* app, QObject* parent)
+    : QObject(parent),
+      notification_timer_(new QTimer(this)),
+      track_list_replaced_(false),
+      track_ids_valid_(false),
+      app_(app) {
+  notification_timer_->setSingleShot(true);
+  notification_timer_->setInterval(0);
+  connect(notification_timer_, SIGNAL(timeout()), SLOT(FlushNotifications()));
+
   new Mpris2Root(this);
   new Mpris2TrackList(this);
   new Mpris2Player(this);
@@ -113,6 +127,8 @@ Mpris2::Mpris2(Application* app, QObject* parent) : QObject(parent), app_(app) {
           SLOT(PlaylistChanged(Playlist*)));
   connect(app_->playlist_manager(), SIGNAL(CurrentChanged(Playlist*)),
           SLOT(PlaylistCollectionChanged(Playlist*)));
+  connect(app_->playlist_manager(), SIGNAL(ActiveChanged(Playlist*)),
+          SLOT(ActivePlaylistChanged()));
 }
 
 // when PlaylistManager gets it ready, we connect PlaylistSequence with this
@@ -154,13 +170,28 @@ void Mpris2::EmitNotification(const QString& name, const QVariant& val) {
 
 void Mpris2::EmitNotification(const QString& name, const QVariant& val,
                               const QString& mprisEntity) {
-  QDBusMessage msg = QDBusMessage::createSignal(
-      kMprisObjectPath, kFreedesktopPath, "PropertiesChanged");
-  QVariantMap map;
-  map.insert(name, val);
-  QVariantList args = QVariantList() << mprisEntity << map << QStringList();
-  msg.setArguments(args);
-  QDBusConnection::sessionBus().send(msg);
+  // A later change to the same property replaces an earlier one that hasn't
+  // been sent yet.
+  pending_changes_[mprisEntity].insert(name, val);
+  notification_timer_->start();
+}
+
+void Mpris2::FlushNotifications() {
+  for (auto it = pending_changes_.constBegin();
+       it != pending_changes_.constEnd(); ++it) {
+    QDBusMessage msg = QDBusMessage::createSignal(
+        kMprisObjectPath, kFreedesktopPath, "PropertiesChanged");
+    QVariantList args = QVariantList() << it.key() << it.value()
+                                       << QStringList();
+    msg.setArguments(args);
+    QDBusConnection::sessionBus().send(msg);
+  }
+  pending_changes_.clear();
+
+  if (track_list_replaced_) {
+    track_list_replaced_ = false;
+    emit TrackListReplaced(Tracks(), QDBusObjectPath(current_track_id()));
+  }
 }
 
 void Mpris2::EmitNotification(const QString& name) {
@@ -327,13 +358,35 @@ void Mpris2::SetShuffle(bool enable) {
 QVariantMap Mpris2::Metadata() const { return last_metadata_; }
 
 QString Mpris2::current_track_id() const {
+  return track_id(app_->playlist_manager()->active()->current_row());
+}
+
+QString Mpris2::track_id(int row) const {
   return QString("/org/clementineplayer/Clementine/Track/%1")
-      .arg(QString::number(app_->playlist_manager()->active()->current_row()));
+      .arg(QString::number(row));
+}
+
+int Mpris2::RowFromTrackId(const QDBusObjectPath& track_id) const {
+  const QString path = track_id.path();
+  const int slash = path.lastIndexOf('/');
+  if (slash == -1) return -1;
+
+  bool ok = false;
+  const int row = path.mid(slash + 1).toInt(&ok);
+  if (!ok || row < 0 || row >= app_->playlist_manager()->active()->rowCount())
+    return -1;
+  return row;
 }
 
 // We send Metadata change notification as soon as the process of
 // changing song starts...
 void Mpris2::CurrentSongChanged(const Song& song) {
+  // Move the TrackList window along once playback leaves it.
+  if (track_ids_valid_ &&
+      !track_ids_.contains(QDBusObjectPath(current_track_id()))) {
+    InvalidateTrackList();
+  }
+
   ArtLoaded(song, "");
   EmitNotification("CanPlay");
   EmitNotification("CanPause");
@@ -344,23 +397,28 @@ void Mpris2::CurrentSongChanged(const Song& song) {
 
 // ... and we add the cover information later, when it's available.
 void Mpris2::ArtLoaded(const Song& song, const QString& art_uri) {
-  last_metadata_ = QVariantMap();
-  song.ToXesam(&last_metadata_);
+  last_metadata_ = MetadataForSong(song, current_track_id(), art_uri);
+  EmitNotification("Metadata", last_metadata_);
+}
+
+QVariantMap Mpris2::MetadataForSong(const Song& song, const QString& track_id,
+                                    const QString& art_uri) const {
+  QVariantMap ret;
+  song.ToXesam(&ret);
 
   using mpris::AddMetadata;
-  AddMetadata("mpris:trackid", current_track_id(), &last_metadata_);
+  AddMetadata("mpris:trackid", track_id, &ret);
 
   if (song.rating() != -1.0) {
-    AddMetadata("rating", song.rating() * 5, &last_metadata_);
+    AddMetadata("rating", song.rating() * 5, &ret);
   }
   if (!art_uri.isEmpty()) {
-    AddMetadata("mpris:artUrl", art_uri, &last_metadata_);
+    AddMetadata("mpris:artUrl", art_uri, &ret);
   }
 
-  AddMetadata("year", song.year(), &last_metadata_);
-  AddMetadata("bitrate", song.bitrate(), &last_metadata_);
-
-  EmitNotification("Metadata", last_metadata_);
+  AddMetadata("year", song.year(), &ret);
+  AddMetadata("bitrate", song.bitrate(), &ret);
+  return ret;
 }
 
 double Mpris2::Volume() const { return app_->player()->GetVolume() / 100.0; }
@@ -368,7 +426,9 @@ double Mpris2::Volume() const { return app_->player()->GetVolume() / 100.0; }
 void Mpris2::SetVolume(double value) { app_->player()->SetVolume(value * 100); }
 
 qlonglong Mpris2::Position() const {
-  return app_->player()->engine()->position_nanosec() / kNsecPerUsec;
+  // Clients poll this, so don't ask the pipeline every time.
+  return app_->player()->engine()->position_clock()->position_nanosec() /
+         kNsecPerUsec;
 }
 
 double Mpris2::MaximumRate() const { return 1.0; }
@@ -470,15 +530,52 @@ void Mpris2::OpenUri(const QString& uri) {
 }
 
 TrackIds Mpris2::Tracks() const {
-  // TODO(John Maguire): ?
-  return TrackIds();
+  if (track_ids_valid_) return track_ids_;
+
+  const Playlist* playlist = app_->playlist_manager()->active();
+  const int count = playlist->rowCount();
+
+  // Show the tracks around the current one.
+  int first = qMax(0, playlist->current_row() - kMaxTrackListSize / 2);
+  first = qMax(0, qMin(first, count - kMaxTrackListSize));
+  const int last = qMin(count, first + kMaxTrackListSize);
+
+  track_ids_.clear();
+  track_ids_.reserve(last - first);
+  for (int row = first; row < last; ++row) {
+    track_ids_ << QDBusObjectPath(track_id(row));
+  }
+  track_ids_valid_ = true;
+  return track_ids_;
 }
 
 bool Mpris2::CanEditTracks() const { return false; }
 
 TrackMetadata Mpris2::GetTracksMetadata(const TrackIds& tracks) const {
-  // TODO(John Maguire): ?
-  return TrackMetadata();
+  const Playlist* playlist = app_->playlist_manager()->active();
+  const int current_row = playlist->current_row();
+
+  TrackMetadata ret;
+  ret.reserve(tracks.count());
+  for (const QDBusObjectPath& id : tracks) {
+    const int row = RowFromTrackId(id);
+    if (row == -1) continue;
+
+    // This one has the album art.
+    if (row == current_row && !last_metadata_.isEmpty()) {
+      ret << last_metadata_;
+      continue;
+    }
+
+    auto it = track_metadata_.find(row);
+    if (it == track_metadata_.end()) {
+      it = track_metadata_.insert(
+          row, MetadataForSong(playlist->item_at(row)->Metadata(),
+                               id.path(), QString()));
+    }
+    ret << it.value();
+  }
+  return ret;
 }
 
 void Mpris2::AddTrack(const QString& uri, const QDBusObjectPath& afterTrack,
@@ -561,6 +658,10 @@ MprisPlaylistList Mpris2::GetPlaylists(quint32 index, quint32 max_count,
 }
 
 void Mpris2::PlaylistChanged(Playlist* playlist) {
+  if (playlist == app_->playlist_manager()->active()) {
+    InvalidateTrackList();
+  }
+
   MprisPlaylist mpris_playlist;
   mpris_playlist.id = MakePlaylistPath(playlist->id());
   mpris_playlist.name =
@@ -572,4 +673,16 @@ void Mpris2::PlaylistCollectionChanged(Playlist* playlist) {
   EmitNotification("PlaylistCount", "", "org.mpris.MediaPlayer2.Playlists");
 }
 
+void Mpris2::ActivePlaylistChanged() { InvalidateTrackList(); }
+
+void Mpris2::InvalidateTrackList() {
+  track_ids_valid_ = false;
+  track_ids_.clear();
+  track_metadata_.clear();
+
+  // Clients are told once, however many edits were made.
+  track_list_replaced_ = true;
+  notification_timer_->start();
+}
+
 }  // namespace mpris
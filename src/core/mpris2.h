@@ -22,6 +22,8 @@
 #ifndef CORE_MPRIS2_H_
 #define CORE_MPRIS2_H_
 
+#include <QHash>
+#include <QMap>
 #include <QMetaObject>
 #include <QObject>
 #include <QtDBus>
@@ -31,6 +33,7 @@
 class Application;
 class MainWindow;
 class Playlist;
+class QTimer;
 
 typedef QList<QVariantMap> TrackMetadata;
 typedef QList<QDBusObjectPath> TrackIds;
@@ -204,6 +207,9 @@ signals:
   void RepeatModeChanged();
   void PlaylistChanged(Playlist* playlist);
   void PlaylistCollectionChanged(Playlist* playlist);
+  void ActivePlaylistChanged();
+
+  void FlushNotifications();
 
  private:
   void EmitNotification(const QString& name);
@@ -214,6 +220,13 @@ signals:
   QString PlaybackStatus(Engine::State state) const;
 
   QString current_track_id() const;
+  QString track_id(int row) const;
+  // Returns -1 if the ID doesn't refer to a row in the active playlist.
+  int RowFromTrackId(const QDBusObjectPath& track_id) const;
+
+  QVariantMap MetadataForSong(const Song& song, const QString& track_id,
+                              const QString& art_uri) const;
+  void InvalidateTrackList();
 
   bool CanSeek(Engine::State state) const;
 
@@ -223,9 +236,21 @@ signals:
   static const char* kMprisObjectPath;
   static const char* kServiceName;
   static const char* kFreedesktopPath;
+  static const int kMaxTrackListSize;
 
   QVariantMap last_metadata_;
 
+  // Property changes are collected here and sent as one PropertiesChanged
+  // signal per interface when control gets back to the event loop.
+  QTimer* notification_timer_;
+  QMap<QString, QVariantMap> pending_changes_;
+  bool track_list_replaced_;
+
+  // Both are cleared whenever the active playlist changes.
+  mutable TrackIds track_ids_;
+  mutable bool track_ids_valid_;
+  mutable QHash<int, QVariantMap> track_metadata_;
+
   Application* app_;
 };
 
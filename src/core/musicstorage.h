@@ -75,6 +75,8 @@ class MusicStorage {
   virtual bool StartCopy(QList<Song::FileType>* supported_types) {
     return true;
   }
+  // How many CopyToStorage calls may run at once, from different threads.
+  virtual int MaxParallelCopies() const { return 1; }
   virtual bool CopyToStorage(const CopyJob& job) = 0;
   virtual void FinishCopy(bool success) {}
 
@@ -25,10 +25,17 @@
 #include <QNetworkAccessManager>
 #include <QNetworkDiskCache>
 #include <QNetworkReply>
+#include <QThreadStorage>
+#include <QTimer>
+#include <QtMath>
 
 #include "core/closure.h"
+#include "core/memoryaccounting.h"
+#include "core/timeconstants.h"
 #include "utilities.h"
 
+const qint64 ThreadSafeNetworkDiskCache::kMaxCacheSize = 100 * 1024 * 1024;
+
 QMutex ThreadSafeNetworkDiskCache::sMutex;
 QNetworkDiskCache* ThreadSafeNetworkDiskCache::sCache = nullptr;
 
@@ -39,6 +46,19 @@ ThreadSafeNetworkDiskCache::ThreadSafeNetworkDiskCache(QObject* parent)
     sCache = new QNetworkDiskCache;
     sCache->setCacheDirectory(
         Utilities::GetConfigPath(Utilities::Path_NetworkCache));
+    sCache->setMaximumCacheSize(kMaxCacheSize);
+
+    MemoryAccounting::Instance()->Register(
+        nullptr, "network_cache", "Network cache (on disk)",
+        []() {
+          QMutexLocker l(&sMutex);
+          return sCache->cacheSize();
+        },
+        [](qint64 bytes) {
+          QMutexLocker l(&sMutex);
+          sCache->setMaximumCacheSize(bytes);
+        },
+        MemoryAccounting::Priority_Disk);
   }
 }
 
@@ -84,11 +104,26 @@ void ThreadSafeNetworkDiskCache::clear() {
   sCache->clear();
 }
 
+const QNetworkRequest::Priority NetworkAccessManager::kPlaybackPriority =
+    QNetworkRequest::HighPriority;
+const QNetworkRequest::Priority NetworkAccessManager::kInteractivePriority =
+    QNetworkRequest::NormalPriority;
+const QNetworkRequest::Priority NetworkAccessManager::kBackgroundPriority =
+    QNetworkRequest::LowPriority;
+
 NetworkAccessManager::NetworkAccessManager(QObject* parent)
     : QNetworkAccessManager(parent), timeout_msec_(0) {
   setCache(new ThreadSafeNetworkDiskCache(this));
 }
 
+NetworkAccessManager* NetworkAccessManager::Shared() {
+  static QThreadStorage<NetworkAccessManager*> network;
+  if (!network.hasLocalData()) {
+    network.setLocalData(new NetworkAccessManager);
+  }
+  return network.localData();
+}
+
 NetworkAccessManager::NetworkAccessManager(int timeout, QObject* parent)
     : QNetworkAccessManager(parent), timeout_msec_(timeout) {
   setCache(new ThreadSafeNetworkDiskCache(this));
@@ -124,6 +159,13 @@ QNetworkReply* NetworkAccessManager::createRequest(
                              QNetworkRequest::PreferCache);
   }
 
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+  // Use HTTP/2 with servers that support it unless the caller said otherwise
+  if (!request.attribute(QNetworkRequest::HTTP2AllowedAttribute).isValid()) {
+    new_request.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, true);
+  }
+#endif
+
   QNetworkReply* reply =
       QNetworkAccessManager::createRequest(op, new_request, outgoingData);
   if (timeout_msec_ > 0) {
@@ -183,6 +225,54 @@ void NetworkTimeouts::timerEvent(QTimerEvent* e) {
   }
 }
 
+NetworkRateLimiter::NetworkRateLimiter(double requests_per_sec, int burst,
+                                       QObject* parent)
+    : QObject(parent),
+      requests_per_sec_(requests_per_sec),
+      burst_(burst),
+      tokens_(burst),
+      timer_(new QTimer(this)) {
+  timer_->setSingleShot(true);
+  connect(timer_, SIGNAL(timeout()), SLOT(RunQueued()));
+  last_refill_.start();
+}
+
+void NetworkRateLimiter::Refill() {
+  tokens_ = qMin<double>(burst_, tokens_ + last_refill_.restart() *
+                                               requests_per_sec_ / kMsecPerSec);
+}
+
+void NetworkRateLimiter::Schedule(std::function<void()> task) {
+  queue_.enqueue(task);
+  RunQueued();
+}
+
+void NetworkRateLimiter::Clear() {
+  queue_.clear();
+  timer_->stop();
+}
+
+void NetworkRateLimiter::Backoff(int msec) {
+  Refill();
+  // A negative balance has to be paid back before the next request.
+  tokens_ = qMin(tokens_, 1.0 - msec * requests_per_sec_ / kMsecPerSec);
+  timer_->stop();
+  RunQueued();
+}
+
+void NetworkRateLimiter::RunQueued() {
+  Refill();
+  while (!queue_.isEmpty() && tokens_ >= 1.0) {
+    tokens_ -= 1.0;
+    queue_.dequeue()();
+  }
+
+  if (!queue_.isEmpty() && !timer_->isActive()) {
+    timer_->start(
+        qCeil((1.0 - tokens_) * kMsecPerSec / requests_per_sec_));
+  }
+}
+
 RedirectFollower::RedirectFollower(QNetworkReply* first_reply,
                                    int max_redirects)
     : QObject(nullptr),
@@ -20,10 +20,14 @@
 #ifndef CORE_NETWORK_H_
 #define CORE_NETWORK_H_
 
+#include <functional>
+
 #include <QAbstractNetworkCache>
+#include <QElapsedTimer>
 #include <QMutex>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QQueue>
 
 class QNetworkDiskCache;
 
@@ -31,6 +35,9 @@ class ThreadSafeNetworkDiskCache : public QAbstractNetworkCache {
  public:
   explicit ThreadSafeNetworkDiskCache(QObject* parent);
 
+  // All instances share one cache on disk, which is kept below this size.
+  static const qint64 kMaxCacheSize;
+
   qint64 cacheSize() const;
   QIODevice* data(const QUrl& url);
   void insert(QIODevice* device);
@@ -53,6 +60,19 @@ class NetworkAccessManager : public QNetworkAccessManager {
   explicit NetworkAccessManager(QObject* parent = nullptr);
   explicit NetworkAccessManager(int timeout, QObject* parent = nullptr);
 
+  // Priority classes for requests.  Qt sends the requests queued for a host in
+  // priority order, so a stream that's about to play isn't stuck behind cover
+  // art, which in turn goes before background catalogue and feed updates.
+  static const QNetworkRequest::Priority kPlaybackPriority;
+  static const QNetworkRequest::Priority kInteractivePriority;
+  static const QNetworkRequest::Priority kBackgroundPriority;
+
+  // Returns a manager shared by everything on the calling thread.  Requests
+  // made through it share one pool of connections to each host, which Qt
+  // limits to six, so the priorities above apply across services.  It must
+  // only be used from the thread that called this, and must not be deleted.
+  static NetworkAccessManager* Shared();
+
  protected:
   QNetworkReply* createRequest(Operation op, const QNetworkRequest& request,
                                QIODevice* outgoingData);
@@ -128,4 +148,37 @@ class NetworkTimeouts : public QObject {
   QMap<RedirectFollower*, int> redirect_timers_;
 };
 
+// Keeps requests to a web service under its documented rate limit with a
+// token bucket.  Up to burst requests go out straight away, after that they
+// are spaced out to requests_per_sec.  Tasks are run in the order they were
+// scheduled, on the thread that owns the limiter.
+class NetworkRateLimiter : public QObject {
+  Q_OBJECT
+
+ public:
+  NetworkRateLimiter(double requests_per_sec, int burst,
+                     QObject* parent = nullptr);
+
+  // Runs task now if a token is available, otherwise once one is.
+  void Schedule(std::function<void()> task);
+  // Drops the tasks that haven't run yet.
+  void Clear();
+  // Call when the service says we're going too fast.  Nothing else is sent
+  // for at least msec.
+  void Backoff(int msec);
+
+ private slots:
+  void RunQueued();
+
+ private:
+  void Refill();
+
+  double requests_per_sec_;
+  int burst_;
+  double tokens_;
+  QElapsedTimer last_refill_;
+  QQueue<std::function<void()>> queue_;
+  QTimer* timer_;
+};
+
 #endif  // CORE_NETWORK_H_
@@ -31,14 +31,15 @@
 
 #include "musicstorage.h"
 #include "taskmanager.h"
+#include "core/closure.h"
+#include "core/concurrentrun.h"
 #include "core/logging.h"
 #include "core/tagreaderclient.h"
 #include "core/utilities.h"
 
 using std::placeholders::_1;
 
-const int Organise::kBatchSize = 10;
-const int Organise::kTranscodeProgressInterval = 500;
+const int Organise::kMaxTranscodesAhead = 8;
 
 Organise::Organise(TaskManager* task_manager,
                    std::shared_ptr<MusicStorage> destination,
@@ -57,10 +58,11 @@ Organise::Organise(TaskManager* task_manager,
       task_count_(songs_info.count()),
       transcode_suffix_(1),
       tasks_complete_(0),
+      next_copy_id_(0),
       started_(false),
-      task_id_(0),
-      current_copy_progress_(0) {
+      task_id_(0) {
   original_thread_ = thread();
+  transcoder_->set_priority(TranscodeScheduler::Priority_Background);
 
   for (const NewSongInfo& song_info : songs_info) {
     tasks_pending_ << Task(song_info);
@@ -77,6 +79,8 @@ void Organise::Start() {
   connect(thread_, SIGNAL(started()), SLOT(ProcessSomeFiles()));
   connect(transcoder_, SIGNAL(JobComplete(QString, QString, bool)),
           SLOT(FileTranscoded(QString, QString, bool)));
+  connect(transcoder_, SIGNAL(JobProgress(QString, float)),
+          SLOT(TranscodeProgress(QString, float)));
 
   moveToThread(thread_);
   thread_->start();
@@ -93,17 +97,32 @@ void Organise::ProcessSomeFiles() {
       tasks_pending_.clear();
     }
     started_ = true;
-  }
 
-  // None left?
-  if (tasks_pending_.isEmpty()) {
-    if (!tasks_transcoding_.isEmpty()) {
-      // Just wait - FileTranscoded will start us off again in a little while
-      qLog(Debug) << "Waiting for transcoding jobs";
-      transcode_progress_timer_.start(kTranscodeProgressInterval, this);
-      return;
+    // Sort out which files need transcoding - the rest can start copying
+    // straight away.
+    QList<Task> tasks = tasks_pending_;
+    tasks_pending_.clear();
+    for (Task& task : tasks) {
+      if (!task.song_info_.song_.is_valid()) continue;
+
+      task.new_filetype_ = CheckTranscode(task.song_info_.song_.filetype());
+      if (task.new_filetype_ == Song::Type_Unknown) {
+        tasks_ready_ << task;
+      } else {
+        tasks_pending_ << task;
+      }
     }
 
+    copy_pool_.setMaxThreadCount(qMax(1, destination_->MaxParallelCopies()));
+  }
+
+  StartTranscodes();
+  StartCopies();
+
+  // None left?
+  if (tasks_pending_.isEmpty() && tasks_transcoding_.isEmpty() &&
+      tasks_transcoded_.isEmpty() && tasks_ready_.isEmpty() &&
+      copies_.isEmpty()) {
     UpdateProgress();
 
     destination_->FinishCopy(files_with_errors_.isEmpty());
@@ -120,107 +139,147 @@ void Organise::ProcessSomeFiles() {
 
     // Stop this thread
     thread_->quit();
-    return;
   }
+}
 
-  // We process files in batches so we can be cancelled part-way through.
-  for (int i = 0; i < kBatchSize; ++i) {
-    SetSongProgress(0);
-
-    if (tasks_pending_.isEmpty()) break;
+void Organise::StartTranscodes() {
+  bool started = false;
 
+  // Don't get too far ahead of the copies, or the transcoded files will
+  // fill up the temporary directory.
+  while (!tasks_pending_.isEmpty() &&
+         tasks_transcoding_.count() + tasks_transcoded_.count() <
+             kMaxTranscodesAhead) {
     Task task = tasks_pending_.takeFirst();
+
+    // Get the preset
+    TranscoderPreset preset = Transcoder::PresetForFileType(task.new_filetype_);
+    qLog(Debug) << "Transcoding with" << preset.name_;
+
+    // Get a temporary name for the transcoded file
+    task.transcoded_filename_ = transcode_temp_name_.fileName() + "-" +
+                                QString::number(transcode_suffix_++);
+    task.new_extension_ = preset.extension_;
+    tasks_transcoding_[task.song_info_.song_.url().toLocalFile()] = task;
+
+    qLog(Debug) << "Transcoding to" << task.transcoded_filename_;
+
+    // Start the transcoding - this will happen in the background and
+    // FileTranscoded() will get called when it's done.  At that point the
+    // task will be queued for copying with the new filename.
+    transcoder_->AddJob(task.song_info_.song_.url().toLocalFile(), preset,
+                        task.transcoded_filename_, task.song_info_.song_);
+    started = true;
+  }
+
+  if (started) transcoder_->Start();
+}
+
+void Organise::StartCopies() {
+  while (copies_.count() < copy_pool_.maxThreadCount() &&
+         (!tasks_transcoded_.isEmpty() || !tasks_ready_.isEmpty())) {
+    // Transcoded files go first so their temporary files get cleaned up and
+    // the transcoder can carry on.
+    const Task task = tasks_transcoded_.isEmpty()
+                          ? tasks_ready_.takeFirst()
+                          : tasks_transcoded_.takeFirst();
     qLog(Info) << "Processing" << task.song_info_.song_.url().toLocalFile();
 
-    // Use a Song instead of a tag reader
-    Song song = task.song_info_.song_;
-    if (!song.is_valid()) continue;
-
-    // Maybe this file is one that's been transcoded already?
-    if (!task.transcoded_filename_.isEmpty()) {
-      qLog(Debug) << "This file has already been transcoded";
-
-      // Set the new filetype on the song so the formatter gets it right
-      song.set_filetype(task.new_filetype_);
-
-      // Fiddle the filename extension as well to match the new type
-      song.set_url(QUrl::fromLocalFile(Utilities::FiddleFileExtension(
-          song.basefilename(), task.new_extension_)));
-      song.set_basefilename(Utilities::FiddleFileExtension(
-          song.basefilename(), task.new_extension_));
-
-      // Adjust the destination filename. Don't use the OrganiseFormat object
-      // for this since that will remove any duplicate filename adjustments
-      // made by OrganiseDialog.
-      task.song_info_.new_filename_ = Utilities::FiddleFileExtension(
-          task.song_info_.new_filename_, task.new_extension_);
-
-      // Have to set this to the size of the new file or else funny stuff
-      // happens
-      song.set_filesize(QFileInfo(task.transcoded_filename_).size());
-    } else {
-      // Figure out if we need to transcode it
-      Song::FileType dest_type = CheckTranscode(song.filetype());
-      if (dest_type != Song::Type_Unknown) {
-        // Get the preset
-        TranscoderPreset preset = Transcoder::PresetForFileType(dest_type);
-        qLog(Debug) << "Transcoding with" << preset.name_;
-
-        // Get a temporary name for the transcoded file
-        task.transcoded_filename_ = transcode_temp_name_.fileName() + "-" +
-                                    QString::number(transcode_suffix_++);
-        task.new_extension_ = preset.extension_;
-        task.new_filetype_ = dest_type;
-        tasks_transcoding_[task.song_info_.song_.url().toLocalFile()] = task;
-
-        qLog(Debug) << "Transcoding to" << task.transcoded_filename_;
-
-        // Start the transcoding - this will happen in the background and
-        // FileTranscoded() will get called when it's done.  At that point the
-        // task will get re-added to the pending queue with the new filename.
-        transcoder_->AddJob(task.song_info_.song_.url().toLocalFile(), preset,
-                            task.transcoded_filename_);
-        transcoder_->Start();
-        continue;
-      }
-    }
+    const int copy_id = next_copy_id_++;
+    Copy& copy = copies_[copy_id];
+    copy.task_ = task;
+    copy.job_ = CopyJobForTask(task);
+    copy.job_.progress_ =
+        std::bind(&Organise::ReportCopyProgress, this, copy_id, _1);
+
+    QFuture<bool> future = ConcurrentRun::Run<bool>(
+        &copy_pool_, std::bind(&MusicStorage::CopyToStorage,
+                               destination_.get(), copy.job_));
+    NewClosure(future, this,
+               SLOT(FileCopiedToDestination(QFuture<bool>, int)), future,
+               copy_id);
+  }
 
-    MusicStorage::CopyJob job;
-    job.source_ = task.transcoded_filename_.isEmpty()
-                      ? task.song_info_.song_.url().toLocalFile()
-                      : task.transcoded_filename_;
-    job.destination_ = task.song_info_.new_filename_;
-    job.metadata_ = song;
-    job.overwrite_ = overwrite_;
-    job.mark_as_listened_ = mark_as_listened_;
-    job.remove_original_ = !copy_;
-    job.progress_ = std::bind(&Organise::SetSongProgress, this, _1,
-                              !task.transcoded_filename_.isEmpty());
-
-    if (!destination_->CopyToStorage(job)) {
-      files_with_errors_ << task.song_info_.song_.basefilename();
-    } else {
-      if (job.remove_original_) {
-        // Notify other aspects of system that song has been invalidated
-        QString root = destination_->LocalPath();
-        QFileInfo new_file = QFileInfo(
-             root + "/" + task.song_info_.new_filename_);
-        emit SongPathChanged(song, new_file);
-      }
-      if (job.mark_as_listened_) {
-        emit FileCopied(job.metadata_.id());
-      }
-    }
+  UpdateProgress();
+}
+
+MusicStorage::CopyJob Organise::CopyJobForTask(const Task& task) const {
+  // Use a Song instead of a tag reader
+  Song song = task.song_info_.song_;
+  QString new_filename = task.song_info_.new_filename_;
+
+  // Maybe this file is one that's been transcoded already?
+  if (!task.transcoded_filename_.isEmpty()) {
+    qLog(Debug) << "This file has already been transcoded";
+
+    // Set the new filetype on the song so the formatter gets it right
+    song.set_filetype(task.new_filetype_);
+
+    // Fiddle the filename extension as well to match the new type
+    song.set_url(QUrl::fromLocalFile(Utilities::FiddleFileExtension(
+        song.basefilename(), task.new_extension_)));
+    song.set_basefilename(Utilities::FiddleFileExtension(
+        song.basefilename(), task.new_extension_));
+
+    // Adjust the destination filename. Don't use the OrganiseFormat object
+    // for this since that will remove any duplicate filename adjustments
+    // made by OrganiseDialog.
+    new_filename =
+        Utilities::FiddleFileExtension(new_filename, task.new_extension_);
+
+    // Have to set this to the size of the new file or else funny stuff
+    // happens
+    song.set_filesize(QFileInfo(task.transcoded_filename_).size());
+  }
+
+  MusicStorage::CopyJob job;
+  job.source_ = task.transcoded_filename_.isEmpty()
+                    ? task.song_info_.song_.url().toLocalFile()
+                    : task.transcoded_filename_;
+  job.destination_ = new_filename;
+  job.metadata_ = song;
+  job.overwrite_ = overwrite_;
+  job.mark_as_listened_ = mark_as_listened_;
+  job.remove_original_ = !copy_;
+  return job;
+}
 
-    // Clean up the temporary transcoded file
-    if (!task.transcoded_filename_.isEmpty())
-      QFile::remove(task.transcoded_filename_);
+void Organise::FileCopiedToDestination(QFuture<bool> future, int copy_id) {
+  const Copy copy = copies_.take(copy_id);
+  const Task& task = copy.task_;
 
-    tasks_complete_++;
+  if (!future.result()) {
+    files_with_errors_ << task.song_info_.song_.basefilename();
+  } else {
+    if (copy.job_.remove_original_) {
+      // Notify other aspects of system that song has been invalidated
+      QString root = destination_->LocalPath();
+      QFileInfo new_file = QFileInfo(root + "/" + copy.job_.destination_);
+      emit SongPathChanged(copy.job_.metadata_, new_file);
+    }
+    if (copy.job_.mark_as_listened_) {
+      emit FileCopied(copy.job_.metadata_.id());
+    }
   }
-  SetSongProgress(0);
 
-  QTimer::singleShot(0, this, SLOT(ProcessSomeFiles()));
+  // Clean up the temporary transcoded file
+  if (!task.transcoded_filename_.isEmpty())
+    QFile::remove(task.transcoded_filename_);
+
+  tasks_complete_++;
+  ProcessSomeFiles();
+}
+
+void Organise::ReportCopyProgress(int copy_id, float progress) {
+  QMetaObject::invokeMethod(this, "CopyProgress", Qt::QueuedConnection,
+                            Q_ARG(int, copy_id), Q_ARG(float, progress));
+}
+
+void Organise::CopyProgress(int copy_id, float progress) {
+  if (!copies_.contains(copy_id)) return;
+
+  copies_[copy_id].progress_ = progress;
+  UpdateProgress();
 }
 
 Song::FileType Organise::CheckTranscode(Song::FileType original_type) const {
@@ -252,59 +311,45 @@ Song::FileType Organise::CheckTranscode(Song::FileType original_type) const {
   return Song::Type_Unknown;
 }
 
-void Organise::SetSongProgress(float progress, bool transcoded) {
-  const int max = transcoded ? 50 : 100;
-  current_copy_progress_ = (transcoded ? 50 : 0) +
-                           qBound(0, static_cast<int>(progress * max), max - 1);
-  UpdateProgress();
-}
-
 void Organise::UpdateProgress() {
   const int total = task_count_ * 100;
 
-  // Update transcoding progress
-  QMap<QString, float> transcode_progress = transcoder_->GetProgress();
-  for (const QString& filename : transcode_progress.keys()) {
-    if (!tasks_transcoding_.contains(filename)) continue;
-    tasks_transcoding_[filename].transcode_progress_ =
-        transcode_progress[filename];
-  }
-
   // Count the progress of all tasks that are in the queue.  Files that need
   // transcoding total 50 for the transcode and 50 for the copy, files that
   // only need to be copied total 100.
   int progress = tasks_complete_ * 100;
 
-  for (const Task& task : tasks_pending_) {
-    progress += qBound(0, static_cast<int>(task.transcode_progress_ * 50), 50);
-  }
   for (const Task& task : tasks_transcoding_.values()) {
     progress += qBound(0, static_cast<int>(task.transcode_progress_ * 50), 50);
   }
-
-  // Add the progress of the track that's currently copying
-  progress += current_copy_progress_;
+  progress += tasks_transcoded_.count() * 50;
+
+  // Add the progress of the tracks that are currently copying
+  for (const Copy& copy : copies_.values()) {
+    const bool transcoded = !copy.task_.transcoded_filename_.isEmpty();
+    const int max = transcoded ? 50 : 100;
+    progress += (transcoded ? 50 : 0) +
+                qBound(0, static_cast<int>(copy.progress_ * max), max - 1);
+  }
 
   task_manager_->SetTaskProgress(task_id_, progress, total);
 }
 
 void Organise::FileTranscoded(const QString& input, const QString& output, bool success) {
   qLog(Info) << "File finished" << input << success;
-  transcode_progress_timer_.stop();
 
   Task task = tasks_transcoding_.take(input);
   if (!success) {
     files_with_errors_ << input;
   } else {
-    tasks_pending_ << task;
+    tasks_transcoded_ << task;
   }
   QTimer::singleShot(0, this, SLOT(ProcessSomeFiles()));
 }
 
-void Organise::timerEvent(QTimerEvent* e) {
-  QObject::timerEvent(e);
+void Organise::TranscodeProgress(const QString& input, float progress) {
+  if (!tasks_transcoding_.contains(input)) return;
 
-  if (e->timerId() == transcode_progress_timer_.timerId()) {
-    UpdateProgress();
-  }
+  tasks_transcoding_[input].transcode_progress_ = progress;
+  UpdateProgress();
 }
@@ -25,14 +25,15 @@
 #include <memory>
 
 #include <QFileInfo>
-#include <QBasicTimer>
+#include <QFuture>
 #include <QObject>
 #include <QTemporaryFile>
+#include <QThreadPool>
 
+#include "musicstorage.h"
 #include "organiseformat.h"
 #include "transcoder/transcoder.h"
 
-class MusicStorage;
 class TaskManager;
 
 class Organise : public QObject {
@@ -53,8 +54,7 @@ class Organise : public QObject {
            bool mark_as_listened, const NewSongInfoList& songs,
            bool eject_after);
 
-  static const int kBatchSize;
-  static const int kTranscodeProgressInterval;
+  static const int kMaxTranscodesAhead;
 
   void Start();
 
@@ -63,15 +63,24 @@ class Organise : public QObject {
   void FileCopied(int database_id);
   void SongPathChanged(const Song& song, const QFileInfo& new_file);
 
- protected:
-  void timerEvent(QTimerEvent* e);
-
  private slots:
   void ProcessSomeFiles();
   void FileTranscoded(const QString& input, const QString& output, bool success);
+  void TranscodeProgress(const QString& input, float progress);
+  void FileCopiedToDestination(QFuture<bool> future, int copy_id);
+  void CopyProgress(int copy_id, float progress);
 
  private:
-  void SetSongProgress(float progress, bool transcoded = false);
+  struct Task;
+
+  // Both stages run at the same time: files are transcoded in the
+  // background while earlier ones are being copied to the destination.
+  void StartTranscodes();
+  void StartCopies();
+  MusicStorage::CopyJob CopyJobForTask(const Task& task) const;
+  // Called from the copying threads.
+  void ReportCopyProgress(int copy_id, float progress);
+
   void UpdateProgress();
   Song::FileType CheckTranscode(Song::FileType original_type) const;
 
@@ -88,6 +97,14 @@ class Organise : public QObject {
     Song::FileType new_filetype_;
   };
 
+  struct Copy {
+    Copy() : progress_(0.0) {}
+
+    Task task_;
+    MusicStorage::CopyJob job_;
+    float progress_;
+  };
+
   QThread* thread_;
   QThread* original_thread_;
   TaskManager* task_manager_;
@@ -102,18 +119,25 @@ class Organise : public QObject {
   const bool eject_after_;
   int task_count_;
 
-  QBasicTimer transcode_progress_timer_;
   QTemporaryFile transcode_temp_name_;
   int transcode_suffix_;
 
+  // Tasks move from pending (needing a transcode) or ready (only needing a
+  // copy) through to copies_.  Transcoded files wait for their copy in
+  // tasks_transcoded_, which is kept short so they don't fill up the disk.
   QList<Task> tasks_pending_;
   QMap<QString, Task> tasks_transcoding_;
+  QList<Task> tasks_transcoded_;
+  QList<Task> tasks_ready_;
   int tasks_complete_;
 
+  QThreadPool copy_pool_;
+  QMap<int, Copy> copies_;
+  int next_copy_id_;
+
   bool started_;
 
   int task_id_;
-  int current_copy_progress_;
 
   QStringList files_with_errors_;
 };
@@ -81,11 +81,14 @@ OrganiseFormat::OrganiseFormat(const QString& format)
     : format_(format),
       replace_non_ascii_(false),
       replace_spaces_(false),
-      replace_the_(false) {}
+      replace_the_(false) {
+  Compile();
+}
 
 void OrganiseFormat::set_format(const QString& v) {
   format_ = v;
   format_.replace('\\', '/');
+  Compile();
 }
 
 bool OrganiseFormat::IsValid() const {
@@ -97,7 +100,7 @@ bool OrganiseFormat::IsValid() const {
 }
 
 QString OrganiseFormat::GetFilenameForSong(const Song& song) const {
-  QString filename = ParseBlock(format_, song);
+  QString filename = Evaluate(song);
 
   if (QFileInfo(filename).completeBaseName().isEmpty()) {
     // Avoid having empty filenames, or filenames with extension only: in this
@@ -109,7 +112,11 @@ QString OrganiseFormat::GetFilenameForSong(const Song& song) const {
         Utilities::PathWithoutFilenameExtension(filename) + song.basefilename();
   }
 
-  if (replace_spaces_) filename.replace(QRegExp("\\s"), "_");
+  if (replace_spaces_) {
+    for (int i = 0; i < filename.length(); ++i) {
+      if (filename[i].isSpace()) filename[i] = '_';
+    }
+  }
 
   if (replace_non_ascii_) {
     QString stripped;
@@ -143,37 +150,80 @@ QString OrganiseFormat::GetFilenameForSong(const Song& song) const {
   return parts.join("/");
 }
 
-QString OrganiseFormat::ParseBlock(QString block, const Song& song,
-                                   bool* any_empty) const {
-  QRegExp tag_regexp(kTagPattern);
+void OrganiseFormat::Compile() {
+  tokens_.clear();
+
   QRegExp block_regexp(kBlockPattern);
 
-  // Find any blocks first
   int pos = 0;
-  while ((pos = block_regexp.indexIn(block, pos)) != -1) {
-    // Recursively parse the block
-    bool empty = false;
-    QString value = ParseBlock(block_regexp.cap(1), song, &empty);
-    if (empty) value = "";
-
-    // Replace the block's value
-    block.replace(pos, block_regexp.matchedLength(), value);
-    pos += value.length();
+  int last = 0;
+  while ((pos = block_regexp.indexIn(format_, pos)) != -1) {
+    CompileTags(format_.mid(last, pos - last));
+    tokens_ << Token(Token::Type_BlockStart);
+    CompileTags(block_regexp.cap(1));
+    tokens_ << Token(Token::Type_BlockEnd);
+
+    pos += block_regexp.matchedLength();
+    last = pos;
   }
+  CompileTags(format_.mid(last));
+}
 
-  // Now look for tags
-  bool empty = false;
-  pos = 0;
-  while ((pos = tag_regexp.indexIn(block, pos)) != -1) {
-    QString value = TagValue(tag_regexp.cap(1), song);
-    if (value.isEmpty()) empty = true;
+void OrganiseFormat::CompileTags(const QString& text) {
+  QRegExp tag_regexp(kTagPattern);
+
+  int pos = 0;
+  int last = 0;
+  while ((pos = tag_regexp.indexIn(text, pos)) != -1) {
+    if (pos > last) {
+      tokens_ << Token(Token::Type_Literal, text.mid(last, pos - last));
+    }
+    tokens_ << Token(Token::Type_Tag, tag_regexp.cap(1));
 
-    block.replace(pos, tag_regexp.matchedLength(), value);
-    pos += value.length();
+    pos += tag_regexp.matchedLength();
+    last = pos;
+  }
+  if (last < text.length()) {
+    tokens_ << Token(Token::Type_Literal, text.mid(last));
+  }
+}
+
+QString OrganiseFormat::Evaluate(const Song& song) const {
+  QString ret;
+  QString block;
+  bool in_block = false;
+  bool block_empty = false;
+
+  for (const Token& token : tokens_) {
+    QString* out = in_block ? &block : &ret;
+
+    switch (token.type_) {
+      case Token::Type_Literal:
+        out->append(token.value_);
+        break;
+
+      case Token::Type_Tag: {
+        const QString value = TagValue(token.value_, song);
+        // A block is left out altogether if any of its tags are empty
+        if (value.isEmpty()) block_empty = true;
+        out->append(value);
+        break;
+      }
+
+      case Token::Type_BlockStart:
+        in_block = true;
+        block_empty = false;
+        block.clear();
+        break;
+
+      case Token::Type_BlockEnd:
+        in_block = false;
+        if (!block_empty) ret.append(block);
+        break;
+    }
   }
 
-  if (any_empty) *any_empty = empty;
-  return block;
+  return ret;
 }
 
 QString OrganiseFormat::TagValue(const QString& tag, const Song& song) const {
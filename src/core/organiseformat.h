@@ -78,13 +78,28 @@ class OrganiseFormat {
   };
 
  private:
-  QString ParseBlock(QString block, const Song& song,
-                     bool* any_empty = nullptr) const;
+  // The format is split into tokens once when it's set, so it doesn't have
+  // to be parsed again for every song.
+  struct Token {
+    enum Type { Type_Literal, Type_Tag, Type_BlockStart, Type_BlockEnd };
+
+    Token(Type type, const QString& value = QString())
+        : type_(type), value_(value) {}
+
+    Type type_;
+    // The text of a literal or the name of a tag.
+    QString value_;
+  };
+
+  void Compile();
+  void CompileTags(const QString& text);
+  QString Evaluate(const Song& song) const;
   QString TagValue(const QString& tag, const Song& song) const;
 
   QMap<QString, QString> tag_overrides_;
 
   QString format_;
+  QList<Token> tokens_;
   bool replace_non_ascii_;
   bool replace_spaces_;
   bool replace_the_;
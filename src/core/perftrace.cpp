@@ -0,0 +1,176 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/perftrace.h"
+
+#include <algorithm>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThread>
+#include <QVector>
+
+#include "core/logging.h"
+
+namespace {
+
+// Durations kept per scope for the percentile.
+const int kSampleCount = 1024;
+// Calls kept for the Chrome trace.  Older ones are dropped.
+const int kMaxEvents = 200000;
+
+struct ScopeData {
+  ScopeData() : count_(0), total_nsec_(0), max_nsec_(0), next_sample_(0) {}
+
+  qint64 count_;
+  qint64 total_nsec_;
+  qint64 max_nsec_;
+  QVector<qint64> samples_;
+  int next_sample_;
+};
+
+struct Event {
+  const char* name_;
+  int thread_;
+  qint64 start_nsec_;
+  qint64 duration_nsec_;
+};
+
+QMutex sMutex;
+QElapsedTimer sTimer;
+QHash<const char*, ScopeData> sScopes;
+QVector<Event> sEvents;
+int sNextEvent = 0;
+QHash<Qt::HANDLE, int> sThreads;
+
+}  // namespace
+
+std::atomic<bool> PerfTrace::sEnabled(false);
+
+void PerfTrace::SetEnabled(bool enabled) {
+  QMutexLocker l(&sMutex);
+  if (!sTimer.isValid()) sTimer.start();
+  sEnabled.store(enabled);
+}
+
+void PerfTrace::Reset() {
+  QMutexLocker l(&sMutex);
+  sScopes.clear();
+  sEvents.clear();
+  sNextEvent = 0;
+  sThreads.clear();
+}
+
+qint64 PerfTrace::Now() { return sTimer.nsecsElapsed(); }
+
+void PerfTrace::Record(const char* name, qint64 start_nsec,
+                       qint64 duration_nsec) {
+  QMutexLocker l(&sMutex);
+
+  ScopeData& scope = sScopes[name];
+  scope.count_++;
+  scope.total_nsec_ += duration_nsec;
+  scope.max_nsec_ = qMax(scope.max_nsec_, duration_nsec);
+  if (scope.samples_.count() < kSampleCount) {
+    scope.samples_ << duration_nsec;
+  } else {
+    scope.samples_[scope.next_sample_] = duration_nsec;
+    scope.next_sample_ = (scope.next_sample_ + 1) % kSampleCount;
+  }
+
+  const Qt::HANDLE thread_id = QThread::currentThreadId();
+  auto thread = sThreads.find(thread_id);
+  if (thread == sThreads.end()) {
+    thread = sThreads.insert(thread_id, sThreads.count() + 1);
+  }
+
+  const Event event{name, thread.value(), start_nsec, duration_nsec};
+  if (sEvents.count() < kMaxEvents) {
+    sEvents << event;
+  } else {
+    sEvents[sNextEvent] = event;
+    sNextEvent = (sNextEvent + 1) % kMaxEvents;
+  }
+}
+
+QList<PerfTrace::Stats> PerfTrace::GetStats() {
+  QList<Stats> ret;
+  {
+    QMutexLocker l(&sMutex);
+    for (auto it = sScopes.constBegin(); it != sScopes.constEnd(); ++it) {
+      const ScopeData& scope = it.value();
+
+      QVector<qint64> samples = scope.samples_;
+      const int p99_index =
+          qMin(samples.count() - 1, samples.count() * 99 / 100);
+      std::nth_element(samples.begin(), samples.begin() + p99_index,
+                       samples.end());
+
+      Stats stats;
+      stats.name_ = QString::fromLatin1(it.key());
+      stats.count_ = scope.count_;
+      stats.mean_nsec_ = scope.total_nsec_ / scope.count_;
+      stats.p99_nsec_ = samples[p99_index];
+      stats.max_nsec_ = scope.max_nsec_;
+      ret << stats;
+    }
+  }
+
+  std::sort(ret.begin(), ret.end(), [](const Stats& a, const Stats& b) {
+    return a.count_ * a.mean_nsec_ > b.count_ * b.mean_nsec_;
+  });
+  return ret;
+}
+
+bool PerfTrace::WriteChromeTrace(const QString& filename) {
+  const qint64 pid = QCoreApplication::applicationPid();
+
+  QJsonArray events;
+  {
+    QMutexLocker l(&sMutex);
+    // Oldest first, once the buffer has wrapped around.
+    for (int i = 0; i < sEvents.count(); ++i) {
+      const Event& event = sEvents[(sNextEvent + i) % sEvents.count()];
+
+      QJsonObject object;
+      object["name"] = QString::fromLatin1(event.name_);
+      object["ph"] = "X";
+      object["pid"] = pid;
+      object["tid"] = event.thread_;
+      object["ts"] = double(event.start_nsec_) / 1000;
+      object["dur"] = double(event.duration_nsec_) / 1000;
+      events << object;
+    }
+  }
+
+  QJsonObject trace;
+  trace["traceEvents"] = events;
+  trace["displayTimeUnit"] = "ms";
+
+  QSaveFile file(filename);
+  if (!file.open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Couldn't open" << filename << "for writing";
+    return false;
+  }
+  file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+  return file.commit();
+}
@@ -0,0 +1,79 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_PERFTRACE_H
+#define CORE_PERFTRACE_H
+
+#include <atomic>
+
+#include <boost/noncopyable.hpp>
+
+#include <QList>
+#include <QString>
+#include <QtGlobal>
+
+// Times scopes around hot paths while recording is switched on from the
+// Console.  When it's off a Scope costs one atomic load, so they can stay in
+// code that runs for every row painted or every buffer played.
+class PerfTrace {
+ public:
+  struct Stats {
+    QString name_;
+    qint64 count_;
+    qint64 mean_nsec_;
+    // Taken from the most recent calls only.
+    qint64 p99_nsec_;
+    qint64 max_nsec_;
+  };
+
+  static bool IsEnabled() { return sEnabled.load(std::memory_order_acquire); }
+  static void SetEnabled(bool enabled);
+
+  // Forgets everything recorded so far.
+  static void Reset();
+
+  // One entry for each scope name, busiest first.
+  static QList<Stats> GetStats();
+
+  // Writes the recorded calls in the Chrome trace event format, for
+  // chrome://tracing or Perfetto.  Returns false if the file couldn't be
+  // written.
+  static bool WriteChromeTrace(const QString& filename);
+
+  // Times the enclosing block.  The name must be a string literal.
+  class Scope : boost::noncopyable {
+   public:
+    explicit Scope(const char* name)
+        : name_(IsEnabled() ? name : nullptr),
+          start_nsec_(name_ ? Now() : 0) {}
+    ~Scope() {
+      if (name_) Record(name_, start_nsec_, Now() - start_nsec_);
+    }
+
+   private:
+    const char* name_;
+    qint64 start_nsec_;
+  };
+
+ private:
+  static qint64 Now();
+  static void Record(const char* name, qint64 start_nsec,
+                     qint64 duration_nsec);
+
+  static std::atomic<bool> sEnabled;
+};
+
+#endif  // CORE_PERFTRACE_H
@@ -31,13 +31,17 @@
 
 #include <QSettings>
 #include <QSortFilterProxyModel>
+#include <QTimer>
 #include <QtDebug>
 #include <QtConcurrentRun>
 
 #include "config.h"
 #include "core/application.h"
 #include "core/logging.h"
+#include "core/streamcache.h"
+#include "core/tagreaderclient.h"
 #include "core/urlhandler.h"
+#include "covers/currentartloader.h"
 #include "engines/enginebase.h"
 #include "engines/gstengine.h"
 #include "library/librarybackend.h"
@@ -53,6 +57,9 @@ using std::shared_ptr;
 
 const char* Player::kSettingsGroup = "Player";
 
+const int Player::kPrefetchLeadMsec = 20000;
+const int Player::kPrefetchMaxAgeMsec = 5 * 60 * 1000;
+
 Player::Player(Application* app, QObject* parent)
     : PlayerInterface(parent),
       app_(app),
@@ -64,9 +71,15 @@ Player::Player(Application* app, QObject* parent)
       volume_before_mute_(50),
       last_pressed_previous_(QDateTime::currentDateTime()),
       menu_previousmode_(PreviousBehaviour_DontRestart),
+      prefetch_timer_(new QTimer(this)),
+      prefetched_result_(QUrl()),
+      stream_cache_(new StreamCache(this)),
       seek_step_sec_(10) {
   settings_.beginGroup("Player");
 
+  prefetch_timer_->setSingleShot(true);
+  connect(prefetch_timer_, SIGNAL(timeout()), SLOT(PrefetchNext()));
+
   SetVolume(settings_.value("volume", 50).toInt());
 
   connect(engine_.get(), SIGNAL(Error(QString)), SIGNAL(Error(QString)));
@@ -88,6 +101,8 @@ void Player::Init() {
   connect(engine_.get(), SIGNAL(TrackEnded()), SLOT(TrackEnded()));
   connect(engine_.get(), SIGNAL(MetaData(Engine::SimpleMetaBundle)),
           SLOT(EngineMetadataReceived(Engine::SimpleMetaBundle)));
+  connect(app_->playlist_manager(), SIGNAL(CurrentSongChanged(Song)),
+          SLOT(SchedulePrefetch()));
 
   engine_->SetVolume(settings_.value("volume", 50).toInt());
 
@@ -113,6 +128,21 @@ void Player::ReloadSettings() {
 }
 
 void Player::HandleLoadResult(const UrlHandler::LoadResult& result) {
+  if (!prefetching_url_.isEmpty() &&
+      result.original_url_ == prefetching_url_) {
+    prefetching_url_ = QUrl();
+
+    // Keep it for later unless the track has already been started.
+    if (result.original_url_ != loading_async_) {
+      if (result.type_ == UrlHandler::LoadResult::TrackAvailable) {
+        prefetched_result_ = result;
+        prefetched_age_.start();
+        stream_cache_->Fetch(result);
+      }
+      return;
+    }
+  }
+
   // Might've been an async load, so check we're still on the same item
   shared_ptr<PlaylistItem> item = app_->playlist_manager()->active()->current_item();
   if (!item) {
@@ -146,6 +176,9 @@ void Player::HandleLoadResult(const UrlHandler::LoadResult& result) {
         item->SetTemporaryMetadata(song);
         app_->playlist_manager()->active()->InformOfCurrentSongChange();
       }
+      // Keep a copy so it isn't downloaded again next time.
+      if (IsCacheable(result.original_url_)) stream_cache_->Fetch(result);
+
       MediaPlaybackRequest req(result.media_url_);
       if (!result.auth_header_.isEmpty())
         req.headers_["Authorization"] = result.auth_header_;
@@ -176,12 +209,13 @@ void Player::NextInternal(Engine::TrackChangeFlags change) {
   if (app_->playlist_manager()->active()->current_item()) {
     const QUrl url = app_->playlist_manager()->active()->current_item()->Url();
 
-    if (url_handlers_.contains(url.scheme())) {
+    UrlHandler* handler = UrlHandlerForScheme(url.scheme());
+    if (handler) {
       // The next track is already being loaded
       if (url == loading_async_) return;
 
       stream_change_type_ = change;
-      HandleLoadResult(url_handlers_[url.scheme()]->LoadNext(url));
+      HandleLoadResult(handler->LoadNext(url));
       return;
     }
   }
@@ -371,6 +405,8 @@ void Player::EngineStateChanged(Engine::State state) {
       break;
   }
   last_state_ = state;
+
+  SchedulePrefetch();
 }
 
 void Player::SetVolume(int value) {
@@ -393,9 +429,8 @@ void Player::PlayAt(int index, Engine::TrackChangeFlags change,
       engine_->position_nanosec() != engine_->length_nanosec()) {
     emit TrackSkipped(current_item_);
     const QUrl& url = current_item_->Url();
-    if (url_handlers_.contains(url.scheme())) {
-      url_handlers_[url.scheme()]->TrackSkipped();
-    }
+    UrlHandler* handler = url_handlers_.value(url.scheme());
+    if (handler) handler->TrackSkipped();
   }
 
   if (current_item_ && app_->playlist_manager()->active()->has_item_at(index) &&
@@ -415,12 +450,25 @@ void Player::PlayAt(int index, Engine::TrackChangeFlags change,
   current_item_ = app_->playlist_manager()->active()->current_item();
   const QUrl url = current_item_->Url();
 
-  if (url_handlers_.contains(url.scheme())) {
+  UrlHandler* handler = UrlHandlerForScheme(url.scheme());
+  if (handler) {
     // It's already loading
     if (url == loading_async_) return;
 
     stream_change_type_ = change;
-    HandleLoadResult(url_handlers_[url.scheme()]->StartLoading(url));
+
+    // PrefetchNext() might have already started on it.
+    if (url == prefetching_url_) {
+      loading_async_ = url;
+      return;
+    }
+
+    UrlHandler::LoadResult result = EarlyResult(url);
+    if (result.type_ == UrlHandler::LoadResult::TrackAvailable) {
+      HandleLoadResult(result);
+    } else {
+      HandleLoadResult(handler->StartLoading(url));
+    }
   } else {
     loading_async_ = QUrl();
     MediaPlaybackRequest req(current_item_->Url());
@@ -464,6 +512,8 @@ void Player::SeekTo(int seconds) {
   app_->playlist_manager()->active()->UpdateScrobblePoint(nanosec);
 
   emit Seeked(nanosec / 1000);
+
+  SchedulePrefetch();
 }
 
 void Player::SeekForward() {
@@ -552,8 +602,9 @@ void Player::TrackAboutToEnd() {
   // again immediately after.
   if (app_->playlist_manager()->active()->current_item()) {
     const QUrl url = app_->playlist_manager()->active()->current_item()->Url();
-    if (url_handlers_.contains(url.scheme())) {
-      url_handlers_[url.scheme()]->TrackAboutToEnd();
+    UrlHandler* handler = UrlHandlerForScheme(url.scheme());
+    if (handler) {
+      handler->TrackAboutToEnd();
       return;
     }
   }
@@ -592,8 +643,12 @@ void Player::TrackAboutToEnd() {
   QUrl url = next_item->Url();
 
   // Get the actual track URL rather than the stream URL.
-  if (url_handlers_.contains(url.scheme())) {
-    UrlHandler::LoadResult result = url_handlers_[url.scheme()]->LoadNext(url);
+  UrlHandler* handler = UrlHandlerForScheme(url.scheme());
+  if (handler) {
+    UrlHandler::LoadResult result = EarlyResult(url);
+    if (result.type_ != UrlHandler::LoadResult::TrackAvailable) {
+      result = handler->LoadNext(url);
+    }
     switch (result.type_) {
       case UrlHandler::LoadResult::NoMoreTracks:
         return;
@@ -615,11 +670,98 @@ void Player::TrackAboutToEnd() {
 
 void Player::IntroPointReached() { NextInternal(Engine::Intro); }
 
+void Player::SchedulePrefetch() {
+  prefetch_timer_->stop();
+  if (last_state_ != Engine::Playing || !current_item_) return;
+
+  qint64 length_nanosec = engine_->length_nanosec();
+  if (length_nanosec <= 0) {
+    length_nanosec = current_item_->Metadata().length_nanosec();
+  }
+  // Streams don't end, or at least not when we expect them to.
+  if (length_nanosec <= 0) return;
+
+  const qint64 remaining_msec =
+      (length_nanosec - engine_->position_nanosec()) / kNsecPerMsec;
+  prefetch_timer_->start(qMax(0ll, remaining_msec - kPrefetchLeadMsec));
+}
+
+void Player::PrefetchNext() {
+  Playlist* active = app_->playlist_manager()->active();
+  const int next_row = active->next_row();
+  if (next_row == -1) return;
+
+  PlaylistItemPtr item = active->item_at(next_row);
+  if (!item) return;
+  const Song song = item->Metadata();
+  const QUrl url = item->Url();
+
+  qLog(Debug) << "Prefetching" << url.toString(QUrl::RemoveQuery);
+
+  app_->current_art_loader()->Prefetch(song);
+
+  if (url.isLocalFile()) {
+    // Brings the start of the file into the OS cache too, which is what
+    // the engine reads first.
+    TagReaderReply* reply = app_->tag_reader_client()->ReadFile(
+        url.toLocalFile(), pb::tagreader::READ_FAST);
+    connect(reply, SIGNAL(Finished(bool)), reply, SLOT(deleteLater()));
+    return;
+  }
+
+  UrlHandler* handler = UrlHandlerForScheme(url.scheme());
+  if (!handler || !handler->CanResolveEarly()) return;
+  if (url == prefetching_url_ ||
+      EarlyResult(url).type_ == UrlHandler::LoadResult::TrackAvailable) {
+    return;
+  }
+
+  prefetching_url_ = url;
+  const UrlHandler::LoadResult result = handler->StartLoading(url);
+  if (result.type_ != UrlHandler::LoadResult::WillLoadAsynchronously) {
+    HandleLoadResult(result);
+  }
+}
+
+UrlHandler::LoadResult Player::PrefetchedResult(const QUrl& url) {
+  if (prefetched_result_.original_url_ != url ||
+      !prefetched_age_.isValid() ||
+      prefetched_age_.elapsed() > kPrefetchMaxAgeMsec) {
+    return UrlHandler::LoadResult(url);
+  }
+  return prefetched_result_;
+}
+
+UrlHandler::LoadResult Player::EarlyResult(const QUrl& url) {
+  if (IsCacheable(url)) {
+    const QUrl cached_url = stream_cache_->CachedUrl(url);
+    if (!cached_url.isEmpty()) {
+      return UrlHandler::LoadResult(
+          url, UrlHandler::LoadResult::TrackAvailable, cached_url);
+    }
+  }
+  return PrefetchedResult(url);
+}
+
+bool Player::IsCacheable(const QUrl& url) const {
+  // Only handlers that map a url to the same file every time.  Radio
+  // streams and the like never end up in the cache.
+  UrlHandler* handler = UrlHandlerForScheme(url.scheme());
+  return handler && handler->CanResolveEarly();
+}
+
 void Player::ValidSongRequested(const QUrl& url) {
   emit SongChangeRequestProcessed(url, true);
 }
 
 void Player::InvalidSongRequested(const QUrl& url) {
+  // The url handler's link might have stopped working early.
+  if (current_item_) {
+    const QUrl item_url = current_item_->Url();
+    UrlHandler* handler = url_handlers_.value(item_url.scheme());
+    if (handler) handler->ForgetMediaUrl(item_url);
+  }
+
   // first send the notification to others...
   emit SongChangeRequestProcessed(url, false);
   // ... and now when our listeners have completed their processing of the
@@ -649,6 +791,7 @@ void Player::RegisterUrlHandler(UrlHandler* handler) {
 
   qLog(Info) << "Registered URL handler for" << scheme;
   url_handlers_.insert(scheme, handler);
+  url_handler_loaders_.remove(scheme);
   connect(handler, SIGNAL(destroyed(QObject*)),
           SLOT(UrlHandlerDestroyed(QObject*)));
   connect(handler, SIGNAL(AsyncLoadComplete(UrlHandler::LoadResult)),
@@ -671,13 +814,23 @@ void Player::UnregisterUrlHandler(UrlHandler* handler) {
              SLOT(HandleLoadResult(UrlHandler::LoadResult)));
 }
 
-const UrlHandler* Player::HandlerForUrl(const QUrl& url) const {
-  QMap<QString, UrlHandler*>::const_iterator it =
-      url_handlers_.constFind(url.scheme());
-  if (it == url_handlers_.constEnd()) {
-    return nullptr;
+void Player::RegisterUrlHandlerLoader(const QString& scheme,
+                                      std::function<void()> loader) {
+  if (url_handlers_.contains(scheme)) return;
+  url_handler_loaders_[scheme] = loader;
+}
+
+UrlHandler* Player::UrlHandlerForScheme(const QString& scheme) const {
+  if (!url_handlers_.contains(scheme) &&
+      url_handler_loaders_.contains(scheme)) {
+    // The loader registers the real handler.
+    url_handler_loaders_.take(scheme)();
   }
-  return *it;
+  return url_handlers_.value(scheme);
+}
+
+const UrlHandler* Player::HandlerForUrl(const QUrl& url) const {
+  return UrlHandlerForScheme(url.scheme());
 }
 
 void Player::UrlHandlerDestroyed(QObject* object) {
@@ -27,9 +27,11 @@
 #ifndef CORE_PLAYER_H_
 #define CORE_PLAYER_H_
 
+#include <functional>
 #include <memory>
 
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QSettings>
 
@@ -42,6 +44,9 @@
 
 class Application;
 class Scrobbler;
+class StreamCache;
+
+class QTimer;
 
 class PlayerInterface : public QObject {
   Q_OBJECT
@@ -140,6 +145,11 @@ class Player : public PlayerInterface {
   void RegisterUrlHandler(UrlHandler* handler);
   void UnregisterUrlHandler(UrlHandler* handler);
 
+  // Calls loader the first time a URL with this scheme needs a handler.  It
+  // must register one with RegisterUrlHandler.
+  void RegisterUrlHandlerLoader(const QString& scheme,
+                                std::function<void()> loader);
+
   const UrlHandler* HandlerForUrl(const QUrl& url) const;
 
   bool PreviousWouldRestartTrack() const;
@@ -188,10 +198,32 @@ class Player : public PlayerInterface {
   void UrlHandlerDestroyed(QObject* object);
   void HandleLoadResult(const UrlHandler::LoadResult& result);
 
+  // Arranges for PrefetchNext() to run shortly before the current track ends.
+  void SchedulePrefetch();
+  // Gets the next track in the playlist ready: resolves its media url, loads
+  // its art and reads its tags.
+  void PrefetchNext();
+
  private:
+  static const int kPrefetchLeadMsec;
+  static const int kPrefetchMaxAgeMsec;
+
   // Returns true if we were supposed to stop after this track.
   bool HandleStopAfter();
 
+  // Returns the result PrefetchNext() got for url, or a NoMoreTracks result
+  // if there isn't a recent one.
+  UrlHandler::LoadResult PrefetchedResult(const QUrl& url);
+  // Like PrefetchedResult(), but prefers a copy of the track in the stream
+  // cache.
+  UrlHandler::LoadResult EarlyResult(const QUrl& url);
+  // True if tracks from this url's handler may be kept in the stream cache.
+  bool IsCacheable(const QUrl& url) const;
+
+  // Returns the handler for the scheme, running its loader first if it hasn't
+  // been registered yet.
+  UrlHandler* UrlHandlerForScheme(const QString& scheme) const;
+
  private:
   Application* app_;
   Scrobbler* lastfm_;
@@ -205,9 +237,17 @@ class Player : public PlayerInterface {
   int nb_errors_received_;
 
   QMap<QString, UrlHandler*> url_handlers_;
+  mutable QMap<QString, std::function<void()>> url_handler_loaders_;
 
   QUrl loading_async_;
 
+  QTimer* prefetch_timer_;
+  // A url handler is resolving this url for PrefetchNext().
+  QUrl prefetching_url_;
+  UrlHandler::LoadResult prefetched_result_;
+  QElapsedTimer prefetched_age_;
+  StreamCache* stream_cache_;
+
   int volume_before_mute_;
 
   QDateTime last_pressed_previous_;
@@ -0,0 +1,136 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/remotetypecache.h"
+
+#include <algorithm>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QPair>
+#include <QVector>
+
+#include "core/logging.h"
+#include "core/utilities.h"
+
+namespace {
+
+const quint32 kFileMagic = 0x52545943;  // "RTYC"
+const quint32 kFileVersion = 1;
+
+qint64 Now() { return QDateTime::currentMSecsSinceEpoch() / 1000; }
+
+}  // namespace
+
+const int RemoteTypeCache::kMaxEntries = 2000;
+const int RemoteTypeCache::kMaxAgeDays = 30;
+
+RemoteTypeCache::RemoteTypeCache(const QString& filename)
+    : filename_(filename), loaded_(false), dirty_(false) {}
+
+RemoteTypeCache::~RemoteTypeCache() { Save(); }
+
+RemoteTypeCache* RemoteTypeCache::Instance() {
+  static RemoteTypeCache instance(
+      Utilities::GetConfigPath(Utilities::Path_CacheRoot) + "/remotetypes");
+  return &instance;
+}
+
+QString RemoteTypeCache::MimeType(const QUrl& url) {
+  QMutexLocker l(&mutex_);
+  LoadLocked();
+
+  auto it = entries_.constFind(url.toEncoded());
+  if (it == entries_.constEnd() ||
+      Now() - it->recorded_ > qint64(kMaxAgeDays) * 24 * 60 * 60) {
+    return QString();
+  }
+  return it->mime_type_;
+}
+
+void RemoteTypeCache::Record(const QUrl& url, const QString& mime_type) {
+  QMutexLocker l(&mutex_);
+  LoadLocked();
+
+  Entry& entry = entries_[url.toEncoded()];
+  entry.mime_type_ = mime_type;
+  entry.recorded_ = Now();
+  dirty_ = true;
+
+  if (entries_.count() <= kMaxEntries) return;
+
+  // Drop the oldest quarter at once, so this doesn't happen on every Record.
+  QVector<QPair<qint64, QByteArray>> ages;
+  ages.reserve(entries_.count());
+  for (auto it = entries_.constBegin(); it != entries_.constEnd(); ++it) {
+    ages << qMakePair(it->recorded_, it.key());
+  }
+  auto cutoff = ages.begin() + kMaxEntries / 4;
+  std::nth_element(ages.begin(), cutoff, ages.end());
+
+  for (auto it = ages.begin(); it != cutoff; ++it) entries_.remove(it->second);
+}
+
+void RemoteTypeCache::LoadLocked() {
+  if (loaded_) return;
+  loaded_ = true;
+  if (filename_.isEmpty()) return;
+
+  QFile file(filename_);
+  if (!file.open(QIODevice::ReadOnly)) return;
+
+  QDataStream s(&file);
+  quint32 magic = 0;
+  quint32 version = 0;
+  qint32 count = 0;
+  s >> magic >> version >> count;
+  if (magic != kFileMagic || version != kFileVersion || count < 0) return;
+
+  for (int i = 0; i < count && s.status() == QDataStream::Ok; ++i) {
+    QByteArray url;
+    Entry entry;
+    s >> url >> entry.mime_type_ >> entry.recorded_;
+    entries_[url] = entry;
+  }
+  if (s.status() != QDataStream::Ok) {
+    qLog(Warning) << "Ignoring corrupt remote type cache" << filename_;
+    entries_.clear();
+  }
+}
+
+void RemoteTypeCache::Save() {
+  QMutexLocker l(&mutex_);
+  if (!dirty_ || filename_.isEmpty()) return;
+  dirty_ = false;
+
+  QDir().mkpath(QFileInfo(filename_).path());
+
+  QFile file(filename_);
+  if (!file.open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Couldn't save remote type cache to" << filename_;
+    return;
+  }
+
+  QDataStream s(&file);
+  s << kFileMagic << kFileVersion << qint32(entries_.count());
+  for (auto it = entries_.constBegin(); it != entries_.constEnd(); ++it) {
+    s << it.key() << it->mime_type_ << it->recorded_;
+  }
+}
@@ -0,0 +1,67 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_REMOTETYPECACHE_H_
+#define CORE_REMOTETYPECACHE_H_
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QUrl>
+
+// Remembers the MIME type SongLoader found for each remote url, so adding the
+// same streams again doesn't have to ask the server or start a typefind
+// pipeline for every one.  Entries are forgotten after a while in case the
+// url starts serving something else.  Thread-safe.
+class RemoteTypeCache {
+ public:
+  // The cache is only kept in memory if filename is empty.
+  explicit RemoteTypeCache(const QString& filename = QString());
+  ~RemoteTypeCache();
+
+  static const int kMaxEntries;
+  static const int kMaxAgeDays;
+
+  // The cache SongLoader uses, kept in the cache directory.
+  static RemoteTypeCache* Instance();
+
+  // Returns the MIME type last recorded for url, or an empty string.
+  QString MimeType(const QUrl& url);
+  void Record(const QUrl& url, const QString& mime_type);
+
+  // Writes the cache to disk if anything was recorded since it was last
+  // written.  Blocks, so call it from a worker thread.
+  void Save();
+
+ private:
+  struct Entry {
+    QString mime_type_;
+    // Seconds since the epoch.
+    qint64 recorded_;
+  };
+
+  void LoadLocked();
+
+  const QString filename_;
+
+  QMutex mutex_;
+  bool loaded_;
+  bool dirty_;
+  QHash<QByteArray, Entry> entries_;  // encoded url -> entry
+};
+
+#endif  // CORE_REMOTETYPECACHE_H_
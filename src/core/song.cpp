@@ -34,6 +34,8 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QRegExp>
 #include <QLatin1Literal>
 #include <QSharedData>
 #include <QSqlQuery>
@@ -66,11 +68,13 @@
 #include "core/logging.h"
 #include "core/messagehandler.h"
 #include "core/mpris_common.h"
+#include "core/stringpool.h"
 #include "core/timeconstants.h"
 #include "core/utilities.h"
 #include "covers/albumcoverloader.h"
 #include "engines/enginebase.h"
 #include "gmereader.h"
+#include "library/libraryquery.h"
 #include "library/sqlrow.h"
 #include "tagreadermessages.pb.h"
 #include "widgets/trackslider.h"
@@ -116,7 +120,15 @@ const QStringList Song::kColumns = QStringList() << "title"
                                                  << "grouping"
                                                  << "lyrics"
                                                  << "originalyear"
-                                                 << "effective_originalyear";
+                                                 << "effective_originalyear"
+                                                 << "duplicate_key"
+                                                 << "track_gain"
+                                                 << "track_peak"
+                                                 << "album_gain"
+                                                 << "album_peak"
+                                                 << "artist_sort_key"
+                                                 << "albumartist_sort_key"
+                                                 << "album_sort_key";
 
 const QStringList Song::kIntColumns = QStringList() << "track"
                                                     << "disc"
@@ -158,13 +170,29 @@ const QString Song::kFtsBindSpec =
 const QString Song::kFtsUpdateSpec =
     Utilities::Updateify(Song::kFtsColumns).join(", ");
 
+QString Song::BindSpec(const QString& suffix) {
+  QStringList ret = Utilities::Prepend(":", kColumns);
+  for (QString& column : ret) column.append(suffix);
+  return ret.join(", ");
+}
+
+QString Song::FtsBindSpec(const QString& suffix) {
+  QStringList ret = Utilities::Prepend(":", kFtsColumns);
+  for (QString& column : ret) column.append(suffix);
+  return ret.join(", ");
+}
+
 const QString Song::kManuallyUnsetCover = "(unset)";
 const QString Song::kEmbeddedCover = "(embedded)";
 
+// Members are grouped by size so the struct has no padding on 64-bit
+// builds: QSharedData's reference count is followed by id_, then come the
+// pointer-sized members, the 64-bit ones, the 32-bit ones, and finally the
+// flags.  Keep it that way when adding fields - there is one of these for
+// every song in the library and in every playlist.
 struct Song::Private : public QSharedData {
   Private();
 
-  bool valid_;
   int id_;
 
   QString title_;
@@ -175,17 +203,46 @@ struct Song::Private : public QSharedData {
   QString performer_;
   QString grouping_;
   QString lyrics_;
+  QString genre_;
+  QString comment_;
+
+  QUrl url_;
+  QString basefilename_;
+
+  // If the song has a CUE, this contains it's path.
+  QString cue_path_;
+
+  // Filenames to album art for this song.
+  QString art_automatic_;  // Guessed by LibraryWatcher
+  QString art_manual_;     // Set by the user - should take priority
+
+  QImage image_;
+
+  QString etag_;
+
+  // The beginning of the song in seconds. In case of single-part media
+  // streams, this will equal to 0. In case of multi-part streams on the
+  // other hand, this will mark the beginning of a section represented by
+  // this Song object. This is always greater than 0.
+  qint64 beginning_;
+  // The end of the song in seconds. In case of single-part media
+  // streams, this will equal to the song's length. In case of multi-part
+  // streams on the other hand, this will mark the end of a section
+  // represented by this Song object.
+  // This may be negative indicating that the length of this song is
+  // unknown.
+  qint64 end_;
+
   int track_;
   int disc_;
   float bpm_;
   int year_;
   int originalyear_;
-  QString genre_;
-  QString comment_;
-  bool compilation_;             // From the file tag
-  bool sampler_;                 // From the library scanner
-  bool forced_compilation_on_;   // Set by the user
-  bool forced_compilation_off_;  // Set by the user
+
+  float track_gain_;
+  float track_peak_;
+  float album_gain_;
+  float album_peak_;
 
   // A unique album ID
   // Used to distinguish between albums from providers that have multiple
@@ -200,38 +257,20 @@ struct Song::Private : public QSharedData {
   int lastplayed_;
   int score_;
 
-  // The beginning of the song in seconds. In case of single-part media
-  // streams, this will equal to 0. In case of multi-part streams on the
-  // other hand, this will mark the beginning of a section represented by
-  // this Song object. This is always greater than 0.
-  qint64 beginning_;
-  // The end of the song in seconds. In case of single-part media
-  // streams, this will equal to the song's length. In case of multi-part
-  // streams on the other hand, this will mark the end of a section
-  // represented by this Song object.
-  // This may be negative indicating that the length of this song is
-  // unknown.
-  qint64 end_;
-
   int bitrate_;
   int samplerate_;
 
   int directory_id_;
-  QUrl url_;
-  QString basefilename_;
   int mtime_;
   int ctime_;
   int filesize_;
   FileType filetype_;
 
-  // If the song has a CUE, this contains it's path.
-  QString cue_path_;
-
-  // Filenames to album art for this song.
-  QString art_automatic_;  // Guessed by LibraryWatcher
-  QString art_manual_;     // Set by the user - should take priority
-
-  QImage image_;
+  bool valid_;
+  bool compilation_;             // From the file tag
+  bool sampler_;                 // From the library scanner
+  bool forced_compilation_on_;   // Set by the user
+  bool forced_compilation_off_;  // Set by the user
 
   // Whether this song was loaded from a file using taglib.
   bool init_from_file_;
@@ -242,30 +281,27 @@ struct Song::Private : public QSharedData {
   // Whether the song does not exist on the file system anymore, but is still
   // stored in the database so as to remember the user's metadata.
   bool unavailable_;
-
-  QString etag_;
 };
 
 Song::Private::Private()
-    : valid_(false),
-      id_(-1),
+    : id_(-1),
+      beginning_(0),
+      end_(-1),
       track_(-1),
       disc_(-1),
       bpm_(-1),
       year_(-1),
       originalyear_(-1),
-      compilation_(false),
-      sampler_(false),
-      forced_compilation_on_(false),
-      forced_compilation_off_(false),
+      track_gain_(0),
+      track_peak_(-1),
+      album_gain_(0),
+      album_peak_(-1),
       album_id_(-1),
       rating_(-1.0),
       playcount_(0),
       skipcount_(0),
       lastplayed_(-1),
       score_(0),
-      beginning_(0),
-      end_(-1),
       bitrate_(-1),
       samplerate_(-1),
       directory_id_(-1),
@@ -273,6 +309,11 @@ Song::Private::Private()
       ctime_(-1),
       filesize_(-1),
       filetype_(Type_Unknown),
+      valid_(false),
+      compilation_(false),
+      sampler_(false),
+      forced_compilation_on_(false),
+      forced_compilation_off_(false),
       init_from_file_(false),
       suspicious_tags_(false),
       unavailable_(false) {}
@@ -317,6 +358,12 @@ int Song::originalyear() const { return d->originalyear_; }
 int Song::effective_originalyear() const {
   return d->originalyear_ < 0 ? d->year_ : d->originalyear_;
 }
+float Song::track_gain() const { return d->track_gain_; }
+float Song::track_peak() const { return d->track_peak_; }
+float Song::album_gain() const { return d->album_gain_; }
+float Song::album_peak() const { return d->album_peak_; }
+bool Song::has_track_gain() const { return d->track_peak_ >= 0; }
+bool Song::has_album_gain() const { return d->album_peak_ >= 0; }
 const QString& Song::genre() const { return d->genre_; }
 const QString& Song::comment() const { return d->comment_; }
 bool Song::is_compilation() const {
@@ -375,6 +422,14 @@ void Song::set_disc(int v) { d->disc_ = v; }
 void Song::set_bpm(float v) { d->bpm_ = v; }
 void Song::set_year(int v) { d->year_ = v; }
 void Song::set_originalyear(int v) { d->originalyear_ = v; }
+void Song::set_track_gain(float gain, float peak) {
+  d->track_gain_ = gain;
+  d->track_peak_ = peak;
+}
+void Song::set_album_gain(float gain, float peak) {
+  d->album_gain_ = gain;
+  d->album_peak_ = peak;
+}
 void Song::set_genre(const QString& v) { d->genre_ = v; }
 void Song::set_comment(const QString& v) { d->comment_ = v; }
 void Song::set_compilation(bool v) { d->compilation_ = v; }
@@ -492,6 +547,31 @@ void Song::SortSongsListAlphabetically(SongList* songs) {
   std::sort(songs->begin(), songs->end(), CompareSongsName);
 }
 
+QString Song::SortText(QString text) {
+  if (text.isEmpty()) {
+    text = " unknown";
+  } else {
+    text = text.toLower();
+  }
+  text = text.remove(QRegExp("[^\\w ]"));
+
+  return text;
+}
+
+QString Song::SortTextForArtist(QString artist) {
+  artist = SortText(artist);
+
+  if (artist.startsWith("the ")) {
+    artist = artist.right(artist.length() - 4) + ", the";
+  } else if (artist.startsWith("a ")) {
+    artist = artist.right(artist.length() - 2) + ", a";
+  } else if (artist.startsWith("an ")) {
+    artist = artist.right(artist.length() - 3) + ", an";
+  }
+
+  return artist;
+}
+
 void Song::Init(const QString& title, const QString& artist,
                 const QString& album, qint64 length_nanosec) {
   d->valid_ = true;
@@ -543,6 +623,8 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata& pb) {
   d->bpm_ = pb.bpm();
   d->year_ = pb.year();
   d->originalyear_ = pb.originalyear();
+  if (pb.has_track_peak()) set_track_gain(pb.track_gain(), pb.track_peak());
+  if (pb.has_album_peak()) set_album_gain(pb.album_gain(), pb.album_peak());
   d->genre_ = QStringFromStdString(pb.genre());
   d->comment_ = QStringFromStdString(pb.comment());
   d->compilation_ = pb.compilation();
@@ -573,6 +655,7 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata& pb) {
     d->playcount_ = pb.playcount();
   }
 
+  InternFields();
   InitArtManual();
 }
 
@@ -593,6 +676,14 @@ void Song::ToProtobuf(pb::tagreader::SongMetadata* pb) const {
   pb->set_bpm(d->bpm_);
   pb->set_year(d->year_);
   pb->set_originalyear(d->originalyear_);
+  if (has_track_gain()) {
+    pb->set_track_gain(d->track_gain_);
+    pb->set_track_peak(d->track_peak_);
+  }
+  if (has_album_gain()) {
+    pb->set_album_gain(d->album_gain_);
+    pb->set_album_peak(d->album_peak_);
+  }
   pb->set_genre(DataCommaSizeFromQString(d->genre_));
   pb->set_comment(DataCommaSizeFromQString(d->comment_));
   pb->set_compilation(d->compilation_);
@@ -611,17 +702,44 @@ void Song::ToProtobuf(pb::tagreader::SongMetadata* pb) const {
   pb->set_filesize(d->filesize_);
   pb->set_suspicious_tags(d->suspicious_tags_);
   pb->set_art_automatic(DataCommaSizeFromQString(d->art_automatic_));
+  pb->set_etag(DataCommaSizeFromQString(d->etag_));
   pb->set_type(static_cast<pb::tagreader::SongMetadata_Type>(d->filetype_));
 }
 
+void Song::InternFields() {
+  StringPool::Instance()->Intern(
+      {&d->album_, &d->artist_, &d->albumartist_, &d->composer_,
+       &d->performer_, &d->grouping_, &d->genre_, &d->art_automatic_});
+}
+
+namespace {
+
+// Reads a column once, rather than once to check it and again to convert it.
+template <typename T>
+T ValueOr(const QVariant& value, const T& null_value) {
+  return value.isNull() ? null_value : value.value<T>();
+}
+
+}  // namespace
+
+void Song::InitFromQuery(const QSqlQuery& query, bool reliable_metadata,
+                         int col) {
+  InitFromQuery(SqlRow::Current(query), reliable_metadata, col);
+}
+
+void Song::InitFromQuery(const LibraryQuery& query, bool reliable_metadata,
+                         int col) {
+  InitFromQuery(SqlRow::Current(query), reliable_metadata, col);
+}
+
 void Song::InitFromQuery(const SqlRow& q, bool reliable_metadata, int col) {
   d->valid_ = true;
   d->init_from_file_ = reliable_metadata;
 
-#define tostr(n) (q.value(n).isNull() ? QString() : q.value(n).toString())
-#define toint(n) (q.value(n).isNull() ? -1 : q.value(n).toInt())
-#define tolonglong(n) (q.value(n).isNull() ? -1 : q.value(n).toLongLong())
-#define tofloat(n) (q.value(n).isNull() ? -1 : q.value(n).toDouble())
+#define tostr(n) ValueOr<QString>(q.value(n), QString())
+#define toint(n) ValueOr<int>(q.value(n), -1)
+#define tolonglong(n) ValueOr<qint64>(q.value(n), -1)
+#define tofloat(n) ValueOr<double>(q.value(n), -1)
 
   d->id_ = toint(col + 0);
   d->title_ = tostr(col + 1);
@@ -654,7 +772,7 @@ void Song::InitFromQuery(const SqlRow& q, bool reliable_metadata, int col) {
   d->art_manual_ = q.value(col + 22).toString();
 
   d->filetype_ = FileType(q.value(col + 23).toInt());
-  d->playcount_ = q.value(col + 24).isNull() ? 0 : q.value(col + 24).toInt();
+  d->playcount_ = ValueOr<int>(q.value(col + 24), 0);
   d->lastplayed_ = toint(col + 25);
   d->rating_ = tofloat(col + 26);
 
@@ -663,13 +781,12 @@ void Song::InitFromQuery(const SqlRow& q, bool reliable_metadata, int col) {
 
   // effective_compilation = 29
 
-  d->skipcount_ = q.value(col + 30).isNull() ? 0 : q.value(col + 30).toInt();
-  d->score_ = q.value(col + 31).isNull() ? 0 : q.value(col + 31).toInt();
+  d->skipcount_ = ValueOr<int>(q.value(col + 30), 0);
+  d->score_ = ValueOr<int>(q.value(col + 31), 0);
 
   // do not move those statements - beginning must be initialized before
   // length is!
-  d->beginning_ =
-      q.value(col + 32).isNull() ? 0 : q.value(col + 32).toLongLong();
+  d->beginning_ = ValueOr<qint64>(q.value(col + 32), 0);
   set_length_nanosec(tolonglong(col + 33));
 
   d->cue_path_ = tostr(col + 34);
@@ -682,6 +799,19 @@ void Song::InitFromQuery(const SqlRow& q, bool reliable_metadata, int col) {
   d->grouping_ = tostr(col + 39);
   d->lyrics_ = tostr(col + 40);
 
+  // duplicate_key = 42
+
+  d->track_gain_ = ValueOr<double>(q.value(col + 43), 0);
+  d->track_peak_ = tofloat(col + 44);
+  d->album_gain_ = ValueOr<double>(q.value(col + 45), 0);
+  d->album_peak_ = tofloat(col + 46);
+
+  // artist_sort_key = 47
+  // albumartist_sort_key = 48
+  // album_sort_key = 49
+
+  InternFields();
+
   InitArtManual();
 
 #undef tostr
@@ -690,6 +820,190 @@ void Song::InitFromQuery(const SqlRow& q, bool reliable_metadata, int col) {
 #undef tofloat
 }
 
+void Song::InitFromQueryColumns(const QSqlQuery& query,
+                                const QStringList& columns,
+                                bool reliable_metadata, int col) {
+  InitFromQueryColumns(SqlRow::Current(query), columns, reliable_metadata, col);
+}
+
+void Song::InitFromQueryColumns(const LibraryQuery& query,
+                                const QStringList& columns,
+                                bool reliable_metadata, int col) {
+  InitFromQueryColumns(SqlRow::Current(query), columns, reliable_metadata, col);
+}
+
+void Song::InitFromQueryColumns(const SqlRow& q, const QStringList& columns,
+                                bool reliable_metadata, int col) {
+  static const QHash<QString, int> sColumnIndexes = []() {
+    QHash<QString, int> ret;
+    for (int i = 0; i < kColumns.count(); ++i) ret[kColumns[i]] = i;
+    return ret;
+  }();
+
+  d->valid_ = true;
+  d->init_from_file_ = reliable_metadata;
+
+#define tostr(n) ValueOr<QString>(q.value(n), QString())
+#define toint(n) ValueOr<int>(q.value(n), -1)
+#define tolonglong(n) ValueOr<qint64>(q.value(n), -1)
+#define tofloat(n) ValueOr<double>(q.value(n), -1)
+
+  d->id_ = toint(col);
+
+  // Same as InitFromQuery, but looked up by the position of each column in
+  // kColumns.  The length depends on the beginning, so it's done last.
+  int length_col = -1;
+  bool has_art = false;
+  for (int i = 0; i < columns.count(); ++i) {
+    const int n = col + 1 + i;
+    switch (sColumnIndexes.value(columns[i], -1)) {
+      case 0:
+        d->title_ = tostr(n);
+        break;
+      case 1:
+        d->album_ = tostr(n);
+        break;
+      case 2:
+        d->artist_ = tostr(n);
+        break;
+      case 3:
+        d->albumartist_ = tostr(n);
+        break;
+      case 4:
+        d->composer_ = tostr(n);
+        break;
+      case 5:
+        d->track_ = toint(n);
+        break;
+      case 6:
+        d->disc_ = toint(n);
+        break;
+      case 7:
+        d->bpm_ = tofloat(n);
+        break;
+      case 8:
+        d->year_ = toint(n);
+        break;
+      case 9:
+        d->genre_ = tostr(n);
+        break;
+      case 10:
+        d->comment_ = tostr(n);
+        break;
+      case 11:
+        d->compilation_ = q.value(n).toBool();
+        break;
+      case 12:
+        d->bitrate_ = toint(n);
+        break;
+      case 13:
+        d->samplerate_ = toint(n);
+        break;
+      case 14:
+        d->directory_id_ = toint(n);
+        break;
+      case 15:
+        set_url(QUrl::fromEncoded(tostr(n).toUtf8()));
+        d->basefilename_ = QFileInfo(d->url_.toLocalFile()).fileName();
+        break;
+      case 16:
+        d->mtime_ = toint(n);
+        break;
+      case 17:
+        d->ctime_ = toint(n);
+        break;
+      case 18:
+        d->filesize_ = toint(n);
+        break;
+      case 19:
+        d->sampler_ = q.value(n).toBool();
+        break;
+      case 20:
+        d->art_automatic_ = q.value(n).toString();
+        has_art = true;
+        break;
+      case 21:
+        d->art_manual_ = q.value(n).toString();
+        has_art = true;
+        break;
+      case 22:
+        d->filetype_ = FileType(q.value(n).toInt());
+        break;
+      case 23:
+        d->playcount_ = ValueOr<int>(q.value(n), 0);
+        break;
+      case 24:
+        d->lastplayed_ = toint(n);
+        break;
+      case 25:
+        d->rating_ = tofloat(n);
+        break;
+      case 26:
+        d->forced_compilation_on_ = q.value(n).toBool();
+        break;
+      case 27:
+        d->forced_compilation_off_ = q.value(n).toBool();
+        break;
+      case 29:
+        d->skipcount_ = ValueOr<int>(q.value(n), 0);
+        break;
+      case 30:
+        d->score_ = ValueOr<int>(q.value(n), 0);
+        break;
+      case 31:
+        d->beginning_ = ValueOr<qint64>(q.value(n), 0);
+        break;
+      case 32:
+        length_col = n;
+        break;
+      case 33:
+        d->cue_path_ = tostr(n);
+        break;
+      case 34:
+        d->unavailable_ = q.value(n).toBool();
+        break;
+      case 37:
+        d->performer_ = tostr(n);
+        break;
+      case 38:
+        d->grouping_ = tostr(n);
+        break;
+      case 39:
+        d->lyrics_ = tostr(n);
+        break;
+      case 40:
+        d->originalyear_ = toint(n);
+        break;
+      case 43:
+        d->track_gain_ = ValueOr<double>(q.value(n), 0);
+        break;
+      case 44:
+        d->track_peak_ = tofloat(n);
+        break;
+      case 45:
+        d->album_gain_ = ValueOr<double>(q.value(n), 0);
+        break;
+      case 46:
+        d->album_peak_ = tofloat(n);
+        break;
+      default:
+        // Computed columns like effective_compilation aren't stored.
+        break;
+    }
+  }
+  if (length_col != -1) set_length_nanosec(tolonglong(length_col));
+
+  InternFields();
+
+  // This looks for a file on disk, so only do it if the art was asked for.
+  if (has_art) InitArtManual();
+
+#undef tostr
+#undef toint
+#undef tolonglong
+#undef tofloat
+}
+
 void Song::InitFromFilePartial(const QString& filename) {
   set_url(QUrl::fromLocalFile(filename));
   QFileInfo info(filename);
@@ -936,94 +1250,109 @@ void Song::MergeFromSimpleMetaBundle(const Engine::SimpleMetaBundle& bundle) {
   if (!bundle.tracknr.isEmpty()) d->track_ = bundle.tracknr.toInt();
 }
 
-void Song::BindToQuery(QSqlQuery* query) const {
+void Song::BindToQuery(QSqlQuery* query, const QString& suffix) const {
 #define strval(x) (x.isNull() ? "" : x)
 #define intval(x) (x <= 0 ? -1 : x)
 #define notnullintval(x) (x == -1 ? QVariant() : x)
 
   // Remember to bind these in the same order as kBindSpec
 
-  query->bindValue(":title", strval(d->title_));
-  query->bindValue(":album", strval(d->album_));
-  query->bindValue(":artist", strval(d->artist_));
-  query->bindValue(":albumartist", strval(d->albumartist_));
-  query->bindValue(":composer", strval(d->composer_));
-  query->bindValue(":track", intval(d->track_));
-  query->bindValue(":disc", intval(d->disc_));
-  query->bindValue(":bpm", intval(d->bpm_));
-  query->bindValue(":year", intval(d->year_));
-  query->bindValue(":genre", strval(d->genre_));
-  query->bindValue(":comment", strval(d->comment_));
-  query->bindValue(":compilation", d->compilation_ ? 1 : 0);
+  query->bindValue(":title" + suffix, strval(d->title_));
+  query->bindValue(":album" + suffix, strval(d->album_));
+  query->bindValue(":artist" + suffix, strval(d->artist_));
+  query->bindValue(":albumartist" + suffix, strval(d->albumartist_));
+  query->bindValue(":composer" + suffix, strval(d->composer_));
+  query->bindValue(":track" + suffix, intval(d->track_));
+  query->bindValue(":disc" + suffix, intval(d->disc_));
+  query->bindValue(":bpm" + suffix, intval(d->bpm_));
+  query->bindValue(":year" + suffix, intval(d->year_));
+  query->bindValue(":genre" + suffix, strval(d->genre_));
+  query->bindValue(":comment" + suffix, strval(d->comment_));
+  query->bindValue(":compilation" + suffix, d->compilation_ ? 1 : 0);
 
-  query->bindValue(":bitrate", intval(d->bitrate_));
-  query->bindValue(":samplerate", intval(d->samplerate_));
+  query->bindValue(":bitrate" + suffix, intval(d->bitrate_));
+  query->bindValue(":samplerate" + suffix, intval(d->samplerate_));
 
-  query->bindValue(":directory", notnullintval(d->directory_id_));
+  query->bindValue(":directory" + suffix, notnullintval(d->directory_id_));
 
   if (Application::kIsPortable &&
       Utilities::UrlOnSameDriveAsClementine(d->url_)) {
     query->bindValue(
-        ":filename",
+        ":filename" + suffix,
         Utilities::GetRelativePathToClementineBin(d->url_).toEncoded());
   } else {
-    query->bindValue(":filename", d->url_.toEncoded());
+    query->bindValue(":filename" + suffix, d->url_.toEncoded());
   }
 
-  query->bindValue(":mtime", notnullintval(d->mtime_));
-  query->bindValue(":ctime", notnullintval(d->ctime_));
-  query->bindValue(":filesize", notnullintval(d->filesize_));
+  query->bindValue(":mtime" + suffix, notnullintval(d->mtime_));
+  query->bindValue(":ctime" + suffix, notnullintval(d->ctime_));
+  query->bindValue(":filesize" + suffix, notnullintval(d->filesize_));
 
-  query->bindValue(":sampler", d->sampler_ ? 1 : 0);
-  query->bindValue(":art_automatic", d->art_automatic_);
-  query->bindValue(":art_manual", d->art_manual_);
+  query->bindValue(":sampler" + suffix, d->sampler_ ? 1 : 0);
+  query->bindValue(":art_automatic" + suffix, d->art_automatic_);
+  query->bindValue(":art_manual" + suffix, d->art_manual_);
 
-  query->bindValue(":filetype", d->filetype_);
-  query->bindValue(":playcount", d->playcount_);
-  query->bindValue(":lastplayed", intval(d->lastplayed_));
-  query->bindValue(":rating", intval(d->rating_));
+  query->bindValue(":filetype" + suffix, d->filetype_);
+  query->bindValue(":playcount" + suffix, d->playcount_);
+  query->bindValue(":lastplayed" + suffix, intval(d->lastplayed_));
+  query->bindValue(":rating" + suffix, intval(d->rating_));
 
-  query->bindValue(":forced_compilation_on", d->forced_compilation_on_ ? 1 : 0);
-  query->bindValue(":forced_compilation_off",
+  query->bindValue(":forced_compilation_on" + suffix,
+                   d->forced_compilation_on_ ? 1 : 0);
+  query->bindValue(":forced_compilation_off" + suffix,
                    d->forced_compilation_off_ ? 1 : 0);
 
-  query->bindValue(":effective_compilation", is_compilation() ? 1 : 0);
+  query->bindValue(":effective_compilation" + suffix, is_compilation() ? 1 : 0);
 
-  query->bindValue(":skipcount", d->skipcount_);
-  query->bindValue(":score", d->score_);
+  query->bindValue(":skipcount" + suffix, d->skipcount_);
+  query->bindValue(":score" + suffix, d->score_);
 
-  query->bindValue(":beginning", d->beginning_);
-  query->bindValue(":length", intval(length_nanosec()));
+  query->bindValue(":beginning" + suffix, d->beginning_);
+  query->bindValue(":length" + suffix, intval(length_nanosec()));
 
-  query->bindValue(":cue_path", d->cue_path_);
-  query->bindValue(":unavailable", d->unavailable_ ? 1 : 0);
-  query->bindValue(":effective_albumartist", this->effective_albumartist());
+  query->bindValue(":cue_path" + suffix, d->cue_path_);
+  query->bindValue(":unavailable" + suffix, d->unavailable_ ? 1 : 0);
+  query->bindValue(":effective_albumartist" + suffix,
+                   this->effective_albumartist());
 
-  query->bindValue(":etag", strval(d->etag_));
+  query->bindValue(":etag" + suffix, strval(d->etag_));
 
-  query->bindValue(":performer", strval(d->performer_));
-  query->bindValue(":grouping", strval(d->grouping_));
-  query->bindValue(":lyrics", strval(d->lyrics_));
-  query->bindValue(":originalyear", intval(d->originalyear_));
-  query->bindValue(":effective_originalyear",
+  query->bindValue(":performer" + suffix, strval(d->performer_));
+  query->bindValue(":grouping" + suffix, strval(d->grouping_));
+  query->bindValue(":lyrics" + suffix, strval(d->lyrics_));
+  query->bindValue(":originalyear" + suffix, intval(d->originalyear_));
+  query->bindValue(":effective_originalyear" + suffix,
                    intval(this->effective_originalyear()));
+  query->bindValue(":duplicate_key" + suffix, DuplicateKey());
+  query->bindValue(":track_gain" + suffix,
+                   has_track_gain() ? QVariant(d->track_gain_) : QVariant());
+  query->bindValue(":track_peak" + suffix,
+                   has_track_gain() ? QVariant(d->track_peak_) : QVariant());
+  query->bindValue(":album_gain" + suffix,
+                   has_album_gain() ? QVariant(d->album_gain_) : QVariant());
+  query->bindValue(":album_peak" + suffix,
+                   has_album_gain() ? QVariant(d->album_peak_) : QVariant());
+  query->bindValue(":artist_sort_key" + suffix, SortTextForArtist(d->artist_));
+  query->bindValue(":albumartist_sort_key" + suffix,
+                   SortTextForArtist(this->effective_albumartist()));
+  query->bindValue(":album_sort_key" + suffix, SortTextForArtist(d->album_));
 
 #undef intval
 #undef notnullintval
 #undef strval
 }
 
-void Song::BindToFtsQuery(QSqlQuery* query) const {
-  query->bindValue(":ftstitle", d->title_);
-  query->bindValue(":ftsalbum", d->album_);
-  query->bindValue(":ftsartist", d->artist_);
-  query->bindValue(":ftsalbumartist", d->albumartist_);
-  query->bindValue(":ftscomposer", d->composer_);
-  query->bindValue(":ftsperformer", d->performer_);
-  query->bindValue(":ftsgrouping", d->grouping_);
-  query->bindValue(":ftsgenre", d->genre_);
-  query->bindValue(":ftscomment", d->comment_);
-  query->bindValue(":ftsyear", d->year_);
+void Song::BindToFtsQuery(QSqlQuery* query, const QString& suffix) const {
+  query->bindValue(":ftstitle" + suffix, d->title_);
+  query->bindValue(":ftsalbum" + suffix, d->album_);
+  query->bindValue(":ftsartist" + suffix, d->artist_);
+  query->bindValue(":ftsalbumartist" + suffix, d->albumartist_);
+  query->bindValue(":ftscomposer" + suffix, d->composer_);
+  query->bindValue(":ftsperformer" + suffix, d->performer_);
+  query->bindValue(":ftsgrouping" + suffix, d->grouping_);
+  query->bindValue(":ftsgenre" + suffix, d->genre_);
+  query->bindValue(":ftscomment" + suffix, d->comment_);
+  query->bindValue(":ftsyear" + suffix, d->year_);
 }
 
 #ifdef HAVE_LIBLASTFM
@@ -1119,7 +1448,11 @@ bool Song::IsMetadataEqual(const Song& other) const {
          d->art_automatic_ == other.d->art_automatic_ &&
          d->art_manual_ == other.d->art_manual_ &&
          d->rating_ == other.d->rating_ && d->cue_path_ == other.d->cue_path_ &&
-         d->lyrics_ == other.d->lyrics_;
+         d->lyrics_ == other.d->lyrics_ &&
+         d->track_gain_ == other.d->track_gain_ &&
+         d->track_peak_ == other.d->track_peak_ &&
+         d->album_gain_ == other.d->album_gain_ &&
+         d->album_peak_ == other.d->album_peak_;
 }
 
 bool Song::IsEditable() const {
@@ -1148,6 +1481,47 @@ uint HashSimilar(const Song& song) {
   return qHash(song.title().toLower()) ^ qHash(song.artist().toLower());
 }
 
+namespace {
+
+// 64-bit FNV-1a, which is plenty for telling a few hundred thousand songs
+// apart and much cheaper than a cryptographic hash.
+const quint64 kFnvOffsetBasis = Q_UINT64_C(14695981039346656037);
+const quint64 kFnvPrime = Q_UINT64_C(1099511628211);
+
+void HashDuplicateField(const QString& field, quint64* hash) {
+  const QString normalised = field.toCaseFolded().simplified();
+  for (const QChar& c : normalised) {
+    *hash = (*hash ^ c.unicode()) * kFnvPrime;
+  }
+  // Separate the fields so "ab" + "c" doesn't hash like "a" + "bc".
+  *hash = (*hash ^ 0xffff) * kFnvPrime;
+}
+
+}  // namespace
+
+qint64 Song::DuplicateKey() const {
+  if (d->title_.trimmed().isEmpty() || d->artist_.trimmed().isEmpty()) {
+    return 0;
+  }
+
+  quint64 hash = kFnvOffsetBasis;
+  HashDuplicateField(d->artist_, &hash);
+  HashDuplicateField(d->album_, &hash);
+  HashDuplicateField(d->title_, &hash);
+
+  const qint64 length = length_nanosec();
+  const quint64 seconds =
+      length > 0 ? (length + kNsecPerSec / 2) / kNsecPerSec : 0;
+  for (int i = 0; i < 8; ++i) {
+    hash = (hash ^ ((seconds >> (i * 8)) & 0xff)) * kFnvPrime;
+  }
+
+  // 0 is reserved for songs without a key.
+  return hash ? qint64(hash) : 1;
+}
+
+bool Song::is_shared() const { return d->ref.load() > 1; }
+
 bool Song::IsOnSameAlbum(const Song& other) const {
   if (is_compilation() != other.is_compilation()) return false;
 
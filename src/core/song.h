@@ -60,6 +60,8 @@ class Track;
 }
 #endif
 
+class LibraryQuery;
+class QSqlQuery;
 class SqlRow;
 
 class Song {
@@ -87,6 +89,11 @@ class Song {
 
   static QString JoinSpec(const QString& table);
 
+  // Like kBindSpec and kFtsBindSpec, but with suffix appended to every
+  // placeholder.  Used to bind several songs to one multi-row statement.
+  static QString BindSpec(const QString& suffix);
+  static QString FtsBindSpec(const QString& suffix);
+
   // Don't change these values - they're stored in the database, and defined
   // in the tag reader protobuf.
   // If a new lossless file is added, also add it to IsFileLossless().
@@ -118,6 +125,14 @@ class Song {
   // Sort songs alphabetically using their pretty title
   static void SortSongsListAlphabetically(QList<Song>* songs);
 
+  // Text that sorts the way the library shows it: lower case, without
+  // punctuation, and with empty text first.  SortTextForArtist also moves a
+  // leading "the", "a" or "an" to the end.  The artist, album artist and
+  // album versions are stored in the songs tables so the library can sort
+  // with an index.
+  static QString SortText(QString text);
+  static QString SortTextForArtist(QString artist);
+
   // Constructors
   void Init(const QString& title, const QString& artist, const QString& album,
             qint64 length_nanosec);
@@ -125,6 +140,22 @@ class Song {
             qint64 beginning, qint64 end);
   void InitFromProtobuf(const pb::tagreader::SongMetadata& pb);
   void InitFromQuery(const SqlRow& query, bool reliable_metadata, int col = 0);
+  // Read the query's current row in place, without copying it into a SqlRow
+  // first.  Prefer these when stepping through a large result.
+  void InitFromQuery(const QSqlQuery& query, bool reliable_metadata,
+                     int col = 0);
+  void InitFromQuery(const LibraryQuery& query, bool reliable_metadata,
+                     int col = 0);
+  // For queries that select ROWID followed by only some of kColumns, in any
+  // order.  The fields for the other columns are left unset, so don't save
+  // songs read this way or put them in a playlist.
+  void InitFromQueryColumns(const SqlRow& query, const QStringList& columns,
+                            bool reliable_metadata, int col = 0);
+  void InitFromQueryColumns(const QSqlQuery& query, const QStringList& columns,
+                            bool reliable_metadata, int col = 0);
+  void InitFromQueryColumns(const LibraryQuery& query,
+                            const QStringList& columns, bool reliable_metadata,
+                            int col = 0);
   void InitFromFilePartial(
       const QString& filename);  // Just store the filename: incomplete but fast
   void InitArtManual();  // Check if there is already a art in the cache and
@@ -153,8 +184,10 @@ class Song {
   static QString Decode(const QString& tag, const QTextCodec* codec = nullptr);
 
   // Save
-  void BindToQuery(QSqlQuery* query) const;
-  void BindToFtsQuery(QSqlQuery* query) const;
+  void BindToQuery(QSqlQuery* query,
+                   const QString& suffix = QString()) const;
+  void BindToFtsQuery(QSqlQuery* query,
+                      const QString& suffix = QString()) const;
 #ifdef HAVE_LIBLASTFM
   void ToLastFM(lastfm::Track* track, bool prefer_album_artist) const;
 #endif
@@ -186,6 +219,14 @@ class Song {
   int year() const;
   int originalyear() const;
   int effective_originalyear() const;
+  // ReplayGain adjustments in dB, with the peak sample amplitude they were
+  // calculated with.  A negative peak means there's no gain.
+  float track_gain() const;
+  float track_peak() const;
+  float album_gain() const;
+  float album_peak() const;
+  bool has_track_gain() const;
+  bool has_album_gain() const;
   const QString& genre() const;
   const QString& comment() const;
   bool is_compilation() const;
@@ -266,6 +307,8 @@ class Song {
   void set_bpm(float v);
   void set_year(int v);
   void set_originalyear(int v);
+  void set_track_gain(float gain, float peak);
+  void set_album_gain(float gain, float peak);
   void set_genre(const QString& v);
   void set_genre_id3(int id);
   void set_comment(const QString& v);
@@ -312,9 +355,23 @@ class Song {
   // you need to hash the key to do fast lookups.
   QString AlbumKey() const;
 
+  // Songs that are probably the same recording - the same artist, album and
+  // title ignoring case and spacing, and the same length to the second - have
+  // the same DuplicateKey.  Songs without a title or an artist can't be told
+  // apart from each other, so theirs is 0.  This is stored in the songs
+  // tables so the library can find duplicates with an index.
+  qint64 DuplicateKey() const;
+
+  // True if another copy of this Song shares its data.
+  bool is_shared() const;
+
   Song& operator=(const Song& other);
 
  private:
+  // Shares the data of fields that repeat across many songs (artist, album,
+  // genre...) with every other song loaded from the library or a tagreader.
+  void InternFields();
+
   struct Private;
   QSharedDataPointer<Private> d;
 };
@@ -28,6 +28,7 @@
 #include <QBuffer>
 #include <QDirIterator>
 #include <QFileInfo>
+#include <QHash>
 #include <QTimer>
 #include <QUrl>
 #include <QtDebug>
@@ -35,6 +36,7 @@
 #include "config.h"
 #include "core/logging.h"
 #include "core/player.h"
+#include "core/remotetypecache.h"
 #include "core/utilities.h"
 #include "core/signalchecker.h"
 #include "core/song.h"
@@ -60,6 +62,25 @@
 
 using std::placeholders::_1;
 
+namespace {
+
+// Remote urls ending in one of these are taken to be audio without asking the
+// server.  None of them are playlist extensions.
+const char* kAudioExtensions[] = {"aac", "aif",  "aiff", "ape", "flac",
+                                  "m4a", "mp3",  "mpc",  "oga", "ogg",
+                                  "opus", "wav", "wma",  "wv",  nullptr};
+
+bool HasAudioExtension(const QUrl& url) {
+  const QString suffix = QFileInfo(url.path()).suffix().toLower();
+  if (suffix.isEmpty()) return false;
+  for (const char** ext = kAudioExtensions; *ext; ++ext) {
+    if (suffix == QLatin1String(*ext)) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
 QSet<QString> SongLoader::sRawUriSchemes;
 const int SongLoader::kDefaultTimeout = 5000;
 
@@ -119,8 +140,11 @@ SongLoader::Result SongLoader::Load(const QUrl& url) {
     return Success;
   }
 
-  // It could be a playlist, we give it a shot.
-  if (LoadRemotePlaylist(url_)) {
+  // Adding lots of streams at once shouldn't mean asking the server about
+  // every one of them if we can already tell they're audio.
+  if (HasAudioExtension(url_) ||
+      IsAudioType(RemoteTypeCache::Instance()->MimeType(url_))) {
+    AddAsRawStream();
     return Success;
   }
 
@@ -130,6 +154,15 @@ SongLoader::Result SongLoader::Load(const QUrl& url) {
   return BlockingLoadRequired;
 }
 
+SongLoader::Result SongLoader::LoadNotInLibrary(const QUrl& url) {
+  if (url.scheme() != "file") return Load(url);
+
+  url_ = url;
+  preload_func_ =
+      std::bind(&SongLoader::LoadLocalAsync, this, url_.toLocalFile());
+  return BlockingLoadRequired;
+}
+
 SongLoader::Result SongLoader::LoadFilenamesBlocking() {
   if (preload_func_) {
     return preload_func_();
@@ -270,8 +303,48 @@ SongLoader::Result SongLoader::LoadLocalAsync(const QString& filename) {
 }
 
 void SongLoader::LoadMetadataBlocking() {
+  // Songs that are in the library are loaded from there, the rest are read
+  // from disk in batches afterwards.
+  QList<int> to_load;
+  QList<QUrl> urls;
   for (int i = 0; i < songs_.size(); i++) {
-    EffectiveSongLoad(&songs_[i]);
+    // Maybe we loaded the metadata already, for example from a cuesheet.
+    if (songs_[i].filetype() != Song::Type_Unknown) continue;
+
+    to_load << i;
+    urls << songs_[i].url();
+  }
+
+  if (to_load.isEmpty()) return;
+
+  QHash<QByteArray, Song> library_songs;  // encoded filename -> song
+  for (const Song& song : library_->GetSongsByUrls(urls)) {
+    if (song.beginning_nanosec() == 0) {
+      library_songs.insert(song.url().toEncoded(), song);
+    }
+  }
+
+  QList<int> to_read;
+  QStringList filenames;
+  for (int i : to_load) {
+    Song* song = &songs_[i];
+
+    const Song library_song = library_songs.value(song->url().toEncoded());
+    if (library_song.is_valid()) {
+      *song = library_song;
+    } else {
+      to_read << i;
+      filenames << song->url().toLocalFile();
+    }
+  }
+
+  if (filenames.isEmpty()) return;
+
+  SongList songs_on_disk =
+      TagReaderClient::Instance()->ReadFilesBlocking(filenames);
+  for (int i = 0; i < to_read.count(); ++i) {
+    // Keep the partially loaded song if the tag reader couldn't read it.
+    if (songs_on_disk[i].is_valid()) songs_[to_read[i]] = songs_on_disk[i];
   }
 }
 
@@ -297,7 +370,14 @@ void SongLoader::EffectiveSongLoad(Song* song) {
 void SongLoader::LoadPlaylist(ParserBase* parser, const QString& filename) {
   QFile file(filename);
   file.open(QIODevice::ReadOnly);
-  songs_ = parser->Load(&file, filename, QFileInfo(filename).path());
+
+  songs_.clear();
+  parser->LoadChunked(&file,
+                      [this](const SongList& songs) {
+                        songs_ << songs;
+                        emit PlaylistChunkLoaded(songs);
+                      },
+                      filename, QFileInfo(filename).path());
 }
 
 static bool CompareSongs(const Song& left, const Song& right) {
@@ -339,6 +419,15 @@ void SongLoader::AddAsRawStream() {
   songs_ << song;
 }
 
+bool SongLoader::IsAudioType(const QString& mime_type) const {
+  if (mime_type.isEmpty() || playlist_parser_->ParserForMimeType(mime_type)) {
+    // Some playlist types are audio/something too.
+    return false;
+  }
+  return mime_type.startsWith("audio/") || mime_type.startsWith("video/") ||
+         mime_type == "application/ogg";
+}
+
 void SongLoader::Timeout() {
   state_ = Finished;
   success_ = false;
@@ -378,6 +467,9 @@ void SongLoader::StopTypefind() {
 
     // It wasn't a playlist - just put the URL in as a stream
     AddAsRawStream();
+    if (IsAudioType(mime_type_)) {
+      RemoteTypeCache::Instance()->Record(url_, mime_type_);
+    }
   }
 
   emit LoadRemoteFinished();
@@ -386,9 +478,15 @@ void SongLoader::StopTypefind() {
 SongLoader::Result SongLoader::LoadRemote() {
   qLog(Debug) << "Loading remote file" << url_;
 
-  // It's not a local file so we have to fetch it to see what it is.  We use
-  // gstreamer to do this since it handles funky URLs for us (http://, ssh://,
-  // etc) and also has typefinder plugins.
+  // Most servers say what they're serving, which is much cheaper to find out
+  // than starting a pipeline.
+  if (LoadRemoteByMimeType()) {
+    return Success;
+  }
+
+  // The server didn't tell us, so we have to fetch it to see what it is.  We
+  // use gstreamer to do this since it handles funky URLs for us (http://,
+  // ssh://, etc) and also has typefinder plugins.
   // First we wait for typefinder to tell us what it is.  If it's not text/plain
   // or text/uri-list assume it's a song and return success.
   // Otherwise wait to get 512 bytes of data and do magic on it - if the magic
@@ -635,32 +733,41 @@ void SongLoader::StopTypefindAsync(bool success) {
   metaObject()->invokeMethod(this, "StopTypefind", Qt::QueuedConnection);
 }
 
-bool SongLoader::LoadRemotePlaylist(const QUrl& url) {
-  // This function makes a remote request for the given URL and, if its MIME
-  // type corresponds to a known playlist type, saves the content to a
-  // temporary file, loads it, and returns true.
-  // If the URL does not point to a playlist file we could handle,
-  // it returns false.
-
+bool SongLoader::LoadRemoteByMimeType() {
   NetworkAccessManager manager;
-  QNetworkRequest req = QNetworkRequest(url);
+  QNetworkRequest req = QNetworkRequest(url_);
 
-  // Getting headers:
-  QNetworkReply* const headers_reply = manager.head(req);
-  WaitForSignal(headers_reply, SIGNAL(finished()));
+  QString mime_type = RemoteTypeCache::Instance()->MimeType(url_);
+  if (mime_type.isEmpty()) {
+    // Getting headers:
+    QNetworkReply* const headers_reply = manager.head(req);
+    WaitForSignal(headers_reply, SIGNAL(finished()));
 
-  if (headers_reply->error() != QNetworkReply::NoError) {
-    qLog(Error) << url.toString() << headers_reply->errorString();
-    return false;
+    if (headers_reply->error() != QNetworkReply::NoError) {
+      qLog(Error) << url_.toString() << headers_reply->errorString();
+      return false;
+    }
+
+    // Leave out any parameters, like the charset.
+    mime_type = headers_reply->header(QNetworkRequest::ContentTypeHeader)
+                    .toString()
+                    .section(';', 0, 0)
+                    .trimmed()
+                    .toLower();
   }
 
-  // Now we check if there is a parser that can handle that MIME type.
-  QString mime_type =
-      headers_reply->header(QNetworkRequest::ContentTypeHeader).toString();
+  if (IsAudioType(mime_type)) {
+    qLog(Debug) << url_.toString() << "with MIME" << mime_type
+                << "is a raw stream";
+    RemoteTypeCache::Instance()->Record(url_, mime_type);
+    AddAsRawStream();
+    return true;
+  }
 
+  // Now we check if there is a parser that can handle that MIME type.
   ParserBase* const parser = playlist_parser_->ParserForMimeType(mime_type);
   if (parser == nullptr) {
-    qLog(Debug) << url.toString() << "seems to not be a playlist";
+    qLog(Debug) << url_.toString() << "seems to not be a playlist";
     return false;
   }
 
@@ -670,20 +777,21 @@ bool SongLoader::LoadRemotePlaylist(const QUrl& url) {
   WaitForSignal(data_reply, SIGNAL(finished()));
 
   if (data_reply->error() != QNetworkReply::NoError) {
-    qLog(Error) << url.toString() << data_reply->errorString();
+    qLog(Error) << url_.toString() << data_reply->errorString();
     return false;
   }
+  RemoteTypeCache::Instance()->Record(url_, mime_type);
 
   // Save them to a temporary file...
   QString playlist_filename =
       Utilities::SaveToTemporaryFile(data_reply->readAll());
   if (playlist_filename.isEmpty()) {
-    qLog(Error) << url.toString()
+    qLog(Error) << url_.toString()
                 << "could not write contents to temporary file";
     return false;
   }
 
-  qLog(Debug) << url.toString() << "with MIME" << mime_type << "loading from"
+  qLog(Debug) << url_.toString() << "with MIME" << mime_type << "loading from"
               << playlist_filename;
 
   // ...and load it.
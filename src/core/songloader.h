@@ -69,6 +69,9 @@ class SongLoader : public QObject {
   // If Success is returned the songs are fully loaded. If BlockingLoadRequired
   // is returned LoadFilenamesBlocking() needs to be called next.
   Result Load(const QUrl& url);
+  // Like Load(), but for a URL the caller has already looked up in the
+  // library without finding it.
+  Result LoadNotInLibrary(const QUrl& url);
   // Loads the files with only filenames. When finished, songs() contains a
   // complete list of all Song objects, but without metadata. This method is
   // blocking, do not call it from the UI thread.
@@ -83,6 +86,9 @@ signals:
   void AudioCDTracksLoaded();
   void LoadAudioCDFinished(bool success);
   void LoadRemoteFinished();
+  // Emitted while a playlist is loaded with each chunk of songs from it, in
+  // order.  The songs are also added to songs() as usual.
+  void PlaylistChunkLoaded(const SongList& songs);
 
  private slots:
   void Timeout();
@@ -108,9 +114,14 @@ signals:
   void LoadPlaylist(ParserBase* parser, const QString& filename);
 
   void AddAsRawStream();
+  // True for MIME types that are played directly rather than parsed.
+  bool IsAudioType(const QString& mime_type) const;
 
   Result LoadRemote();
-  bool LoadRemotePlaylist(const QUrl& url);
+  // Asks the server what url_ is with a HEAD request, unless the answer is
+  // already in the RemoteTypeCache, and loads it if it's a playlist or audio.
+  // Returns false if the typefind pipeline needs to find out instead.
+  bool LoadRemoteByMimeType();
 
   // GStreamer callbacks
   static void TypeFound(GstElement* typefind, uint probability, GstCaps* caps,
@@ -0,0 +1,120 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/startuptrace.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+#include "core/logging.h"
+
+namespace {
+
+struct Entry {
+  const char* name;
+  int depth;
+  qint64 start_msec;
+  qint64 duration_msec;  // -1 for marks, and scopes that haven't finished.
+};
+
+// Subsystems are sometimes created on first use from other threads, so this
+// is all guarded by sMutex.
+QMutex sMutex;
+QElapsedTimer sTimer;
+bool sFinished = false;
+int sDepth = 0;
+QList<Entry> sEntries;
+
+bool IsMainThread() {
+  return QCoreApplication::instance() &&
+         QThread::currentThread() == QCoreApplication::instance()->thread();
+}
+
+}  // namespace
+
+void StartupTrace::Start() {
+  QMutexLocker l(&sMutex);
+  sTimer.start();
+}
+
+void StartupTrace::Mark(const char* name) {
+  QMutexLocker l(&sMutex);
+  if (sFinished || !sTimer.isValid()) return;
+
+  sEntries << Entry{name, sDepth, sTimer.elapsed(), -1};
+}
+
+void StartupTrace::Finish() {
+  QList<Entry> entries;
+  qint64 total_msec;
+  {
+    QMutexLocker l(&sMutex);
+    if (sFinished || !sTimer.isValid()) return;
+    sFinished = true;
+    entries.swap(sEntries);
+    total_msec = sTimer.elapsed();
+  }
+
+  QStringList lines;
+  lines << QString("Startup took %1 ms").arg(total_msec);
+  for (const Entry& entry : entries) {
+    const QString indent(entry.depth * 2, ' ');
+    if (entry.duration_msec < 0) {
+      lines << QString("%1 ms  %2-- %3")
+                   .arg(entry.start_msec, 6)
+                   .arg(indent)
+                   .arg(entry.name);
+    } else {
+      lines << QString("%1 ms  %2%3: %4 ms")
+                   .arg(entry.start_msec, 6)
+                   .arg(indent)
+                   .arg(entry.name)
+                   .arg(entry.duration_msec);
+    }
+  }
+
+  // The log goes to stderr too, so this also ends up on the console.
+  for (const QString& line : lines) {
+    qLog(Info) << line;
+  }
+}
+
+StartupTrace::Scope::Scope(const char* name) : index_(-1) {
+  QMutexLocker l(&sMutex);
+  if (sFinished || !sTimer.isValid()) return;
+
+  // Only the main thread's scopes nest.
+  const bool main_thread = IsMainThread();
+  index_ = sEntries.count();
+  sEntries << Entry{name, main_thread ? sDepth : 0, sTimer.elapsed(), -1};
+  if (main_thread) ++sDepth;
+}
+
+StartupTrace::Scope::~Scope() {
+  if (index_ == -1) return;
+
+  QMutexLocker l(&sMutex);
+  if (IsMainThread()) --sDepth;
+  if (sFinished || index_ >= sEntries.count()) return;
+
+  Entry& entry = sEntries[index_];
+  entry.duration_msec = sTimer.elapsed() - entry.start_msec;
+}
@@ -0,0 +1,47 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CORE_STARTUPTRACE_H
+#define CORE_STARTUPTRACE_H
+
+#include <boost/noncopyable.hpp>
+
+#include <QtGlobal>
+
+// Records how long each part of startup takes, and writes the whole trace to
+// the log and the console when Finish() is called.  Everything after that is a
+// no-op, so it's cheap to leave scopes around code that also runs later.
+class StartupTrace {
+ public:
+  // Call as early as possible in main().  Times are relative to this.
+  static void Start();
+  // Records a point in time, like the main window being shown.
+  static void Mark(const char* name);
+  static void Finish();
+
+  // Times the enclosing block.  Nested scopes are indented in the trace.
+  class Scope : boost::noncopyable {
+   public:
+    explicit Scope(const char* name);
+    ~Scope();
+
+   private:
+    int index_;
+  };
+};
+
+#endif  // CORE_STARTUPTRACE_H
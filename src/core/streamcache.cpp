@@ -0,0 +1,165 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "streamcache.h"
+
+#include <utime.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+
+#include "core/logging.h"
+#include "core/network.h"
+#include "core/taskexecutor.h"
+#include "core/utilities.h"
+
+const qint64 StreamCache::kMaxCacheBytes = 1024 * 1024 * 1024;
+const int StreamCache::kMaxDownloads = 2;
+
+StreamCache::StreamCache(QObject* parent)
+    : QObject(parent), network_(new NetworkAccessManager(this)) {}
+
+StreamCache::~StreamCache() {
+  while (!downloads_.isEmpty()) AbortDownload(0);
+}
+
+QString StreamCache::CachePath(const QUrl& original_url) {
+  return Utilities::GetConfigPath(Utilities::Path_StreamCache) + "/" +
+         QCryptographicHash::hash(original_url.toEncoded(),
+                                  QCryptographicHash::Sha1)
+             .toHex();
+}
+
+QUrl StreamCache::CachedUrl(const QUrl& original_url) {
+  const QString path = CachePath(original_url);
+  if (!QFile::exists(path)) return QUrl();
+
+  // The modification time is when it was last played, so Prune() keeps the
+  // most recently played tracks.
+  utime(QFile::encodeName(path).constData(), nullptr);
+  return QUrl::fromLocalFile(path);
+}
+
+void StreamCache::Fetch(const UrlHandler::LoadResult& result) {
+  if (result.type_ != UrlHandler::LoadResult::TrackAvailable ||
+      result.media_url_.isLocalFile()) {
+    return;
+  }
+  for (const Download& download : downloads_) {
+    if (download.original_url_ == result.original_url_) return;
+  }
+  const QString path = CachePath(result.original_url_);
+  if (QFile::exists(path)) return;
+
+  while (downloads_.count() >= kMaxDownloads) AbortDownload(0);
+
+  QDir().mkpath(Utilities::GetConfigPath(Utilities::Path_StreamCache));
+
+  Download download;
+  download.original_url_ = result.original_url_;
+  download.file_ = new QFile(path + ".part", this);
+  if (!download.file_->open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Couldn't create" << download.file_->fileName();
+    delete download.file_;
+    return;
+  }
+
+  QNetworkRequest req(result.media_url_);
+  if (!result.auth_header_.isEmpty()) {
+    req.setRawHeader("Authorization", result.auth_header_);
+  }
+  // Whole tracks would push everything else out of the network cache.
+  req.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+  req.setPriority(NetworkAccessManager::kBackgroundPriority);
+  download.reply_ = network_->get(req);
+  connect(download.reply_, SIGNAL(readyRead()), SLOT(DownloadReadyRead()));
+  connect(download.reply_, SIGNAL(finished()), SLOT(DownloadFinished()));
+  downloads_ << download;
+
+  qLog(Debug) << "Caching" << result.original_url_;
+}
+
+int StreamCache::IndexOfDownload(QObject* reply) const {
+  for (int i = 0; i < downloads_.count(); ++i) {
+    if (downloads_[i].reply_ == reply) return i;
+  }
+  return -1;
+}
+
+void StreamCache::AbortDownload(int index) {
+  Download download = downloads_.takeAt(index);
+  download.reply_->disconnect(this);
+  download.reply_->abort();
+  download.reply_->deleteLater();
+  download.file_->remove();
+  delete download.file_;
+}
+
+void StreamCache::DownloadReadyRead() {
+  const int index = IndexOfDownload(sender());
+  if (index == -1) return;
+
+  // Write as it arrives so a whole track is never held in memory.
+  const Download& download = downloads_[index];
+  if (download.file_->write(download.reply_->readAll()) == -1) {
+    qLog(Warning) << "Couldn't write" << download.file_->fileName();
+    AbortDownload(index);
+  }
+}
+
+void StreamCache::DownloadFinished() {
+  const int index = IndexOfDownload(sender());
+  if (index == -1) return;
+
+  Download download = downloads_.takeAt(index);
+  download.reply_->deleteLater();
+
+  const bool ok = download.reply_->error() == QNetworkReply::NoError &&
+                  download.file_->write(download.reply_->readAll()) != -1;
+  download.file_->close();
+
+  const QString path = CachePath(download.original_url_);
+  if (!ok || !download.file_->rename(path)) {
+    qLog(Warning) << "Couldn't cache" << download.original_url_
+                  << download.reply_->errorString();
+    download.file_->remove();
+  }
+  delete download.file_;
+
+  if (ok) {
+    TaskExecutor::Instance()->Run<void>(TaskExecutor::Lane_Background,
+                                        &StreamCache::Prune);
+  }
+}
+
+void StreamCache::Prune() {
+  QDir dir(Utilities::GetConfigPath(Utilities::Path_StreamCache));
+
+  // Keep the most recently played files
+  qint64 total = 0;
+  for (const QFileInfo& info : dir.entryInfoList(QDir::Files, QDir::Time)) {
+    if (info.suffix() == "part") continue;
+
+    total += info.size();
+    if (total > kMaxCacheBytes) {
+      QFile::remove(info.absoluteFilePath());
+    }
+  }
+}
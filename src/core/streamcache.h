@@ -0,0 +1,77 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_STREAMCACHE_H_
+#define CORE_STREAMCACHE_H_
+
+#include <QList>
+#include <QObject>
+#include <QUrl>
+
+#include "core/urlhandler.h"
+
+class QFile;
+class QNetworkAccessManager;
+class QNetworkReply;
+
+// Keeps local copies of tracks played from cloud storage and Subsonic, so
+// playing or seeking in one of them again doesn't go over the network.
+// Tracks are keyed by the url the playlist item has, since the media url
+// usually contains a token that changes.  The least recently played tracks
+// are removed once the cache gets too big.
+class StreamCache : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit StreamCache(QObject* parent = nullptr);
+  ~StreamCache();
+
+  static const qint64 kMaxCacheBytes;
+  // Enough for the track that's playing and the next one.
+  static const int kMaxDownloads;
+
+  // Returns a file url for the cached copy of original_url, or an empty url
+  // if there isn't one.
+  QUrl CachedUrl(const QUrl& original_url);
+
+  // Starts downloading result's media url into the cache, unless it's
+  // already there or on its way.  Older downloads are abandoned if there are
+  // too many.
+  void Fetch(const UrlHandler::LoadResult& result);
+
+ private slots:
+  void DownloadReadyRead();
+  void DownloadFinished();
+
+ private:
+  struct Download {
+    QUrl original_url_;
+    QNetworkReply* reply_;
+    QFile* file_;
+  };
+
+  static QString CachePath(const QUrl& original_url);
+  // Removes the least recently played tracks until the cache is small enough.
+  static void Prune();
+
+  int IndexOfDownload(QObject* reply) const;
+  void AbortDownload(int index);
+
+  QNetworkAccessManager* network_;
+  QList<Download> downloads_;
+};
+
+#endif  // CORE_STREAMCACHE_H_
@@ -0,0 +1,54 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/stringpool.h"
+
+#include <QMutexLocker>
+
+StringPool* StringPool::Instance() {
+  static StringPool instance;
+  return &instance;
+}
+
+QString StringPool::Intern(const QString& str) {
+  if (str.isEmpty()) return str;
+
+  QMutexLocker l(&mutex_);
+  return InternLocked(str);
+}
+
+void StringPool::Intern(std::initializer_list<QString*> strings) {
+  QMutexLocker l(&mutex_);
+  for (QString* str : strings) {
+    if (!str->isEmpty()) *str = InternLocked(*str);
+  }
+}
+
+int StringPool::count() const {
+  QMutexLocker l(&mutex_);
+  return strings_.count();
+}
+
+QString StringPool::InternLocked(const QString& str) {
+  QSet<QString>::const_iterator it = strings_.constFind(str);
+  if (it != strings_.constEnd()) return *it;
+
+  // Don't keep a reference to a larger buffer the string might be sharing.
+  QString copy = str;
+  copy.squeeze();
+  strings_.insert(copy);
+  return copy;
+}
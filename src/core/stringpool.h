@@ -0,0 +1,53 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CORE_STRINGPOOL_H
+#define CORE_STRINGPOOL_H
+
+#include <initializer_list>
+
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+// Keeps one copy of each distinct string it is given, so values that repeat
+// across many objects (artist, album and genre names in a large library) can
+// all share the same implicitly shared data.  Interned strings are never
+// freed - only use this for low-cardinality fields.  Thread-safe.
+class StringPool {
+ public:
+  static StringPool* Instance();
+
+  // Returns a copy of str that shares its data with every other string of
+  // the same value returned by the pool.
+  QString Intern(const QString& str);
+
+  // Replaces each of the strings with its pooled copy, taking the lock once.
+  void Intern(std::initializer_list<QString*> strings);
+
+  int count() const;
+
+ private:
+  StringPool() {}
+
+  QString InternLocked(const QString& str);
+
+  mutable QMutex mutex_;
+  QSet<QString> strings_;
+};
+
+#endif  // CORE_STRINGPOOL_H
@@ -23,6 +23,39 @@
 #include <QFile>
 #include <QEvent>
 
+namespace {
+
+struct PaletteRole {
+  const char* name_;
+  QPalette::ColorRole role_;
+};
+
+const PaletteRole kPaletteRoles[] = {
+    {"Window", QPalette::Window},
+    {"Background", QPalette::Background},
+    {"WindowText", QPalette::WindowText},
+    {"Foreground", QPalette::Foreground},
+    {"Base", QPalette::Base},
+    {"AlternateBase", QPalette::AlternateBase},
+    {"ToolTipBase", QPalette::ToolTipBase},
+    {"ToolTipText", QPalette::ToolTipText},
+    {"Text", QPalette::Text},
+    {"Button", QPalette::Button},
+    {"ButtonText", QPalette::ButtonText},
+    {"BrightText", QPalette::BrightText},
+    {"Light", QPalette::Light},
+    {"Midlight", QPalette::Midlight},
+    {"Dark", QPalette::Dark},
+    {"Mid", QPalette::Mid},
+    {"Shadow", QPalette::Shadow},
+    {"Highlight", QPalette::Highlight},
+    {"HighlightedText", QPalette::HighlightedText},
+    {"Link", QPalette::Link},
+    {"LinkVisited", QPalette::LinkVisited},
+};
+
+}  // namespace
+
 StyleSheetLoader::StyleSheetLoader(QObject* parent) : QObject(parent) {}
 
 void StyleSheetLoader::SetStyleSheet(QWidget* widget, const QString& filename) {
@@ -32,65 +65,137 @@ void StyleSheetLoader::SetStyleSheet(QWidget* widget, const QString& filename) {
 }
 
 void StyleSheetLoader::UpdateStyleSheet(QWidget* widget) {
-  QString filename(filenames_[widget]);
+  const QString contents =
+      Expand(LoadTemplate(filenames_[widget]), widget->palette());
+
+  // Setting a stylesheet restyles the widget and all its children, so don't
+  // when the palette change didn't change it.
+  if (contents != widget->styleSheet()) {
+    widget->setStyleSheet(contents);
+  }
+}
+
+const StyleSheetLoader::Template& StyleSheetLoader::LoadTemplate(
+    const QString& filename) {
+  QHash<QString, Template>::const_iterator it = templates_.constFind(filename);
+  if (it != templates_.constEnd()) return it.value();
 
   // Load the file
   QFile file(filename);
   if (!file.open(QIODevice::ReadOnly)) {
     qLog(Warning) << "error opening" << filename;
-    return;
+    return templates_[filename];
   }
-  QString contents(file.readAll());
-
-  // Replace %palette-role with actual colours
-  QPalette p(widget->palette());
-
-  QColor alt = p.color(QPalette::AlternateBase);
-  alt.setAlpha(50);
-  contents.replace("%palette-alternate-base", QString("rgba(%1,%2,%3,%4%)")
-                                                  .arg(alt.red())
-                                                  .arg(alt.green())
-                                                  .arg(alt.blue())
-                                                  .arg(alt.alpha()));
-
-  ReplaceColor(&contents, "Window", p, QPalette::Window);
-  ReplaceColor(&contents, "Background", p, QPalette::Background);
-  ReplaceColor(&contents, "WindowText", p, QPalette::WindowText);
-  ReplaceColor(&contents, "Foreground", p, QPalette::Foreground);
-  ReplaceColor(&contents, "Base", p, QPalette::Base);
-  ReplaceColor(&contents, "AlternateBase", p, QPalette::AlternateBase);
-  ReplaceColor(&contents, "ToolTipBase", p, QPalette::ToolTipBase);
-  ReplaceColor(&contents, "ToolTipText", p, QPalette::ToolTipText);
-  ReplaceColor(&contents, "Text", p, QPalette::Text);
-  ReplaceColor(&contents, "Button", p, QPalette::Button);
-  ReplaceColor(&contents, "ButtonText", p, QPalette::ButtonText);
-  ReplaceColor(&contents, "BrightText", p, QPalette::BrightText);
-  ReplaceColor(&contents, "Light", p, QPalette::Light);
-  ReplaceColor(&contents, "Midlight", p, QPalette::Midlight);
-  ReplaceColor(&contents, "Dark", p, QPalette::Dark);
-  ReplaceColor(&contents, "Mid", p, QPalette::Mid);
-  ReplaceColor(&contents, "Shadow", p, QPalette::Shadow);
-  ReplaceColor(&contents, "Highlight", p, QPalette::Highlight);
-  ReplaceColor(&contents, "HighlightedText", p, QPalette::HighlightedText);
-  ReplaceColor(&contents, "Link", p, QPalette::Link);
-  ReplaceColor(&contents, "LinkVisited", p, QPalette::LinkVisited);
+  QString contents(QString::fromUtf8(file.readAll()));
 
 #ifdef Q_OS_DARWIN
   contents.replace("darwin", "*");
 #endif
 
-  widget->setStyleSheet(contents);
+  return templates_[filename] = ParseTemplate(contents);
 }
 
-void StyleSheetLoader::ReplaceColor(QString* css, const QString& name,
-                                    const QPalette& palette,
-                                    QPalette::ColorRole role) const {
-  css->replace("%palette-" + name + "-lighter",
-               palette.color(role).lighter().name(), Qt::CaseInsensitive);
-  css->replace("%palette-" + name + "-darker",
-               palette.color(role).darker().name(), Qt::CaseInsensitive);
-  css->replace("%palette-" + name, palette.color(role).name(),
-               Qt::CaseInsensitive);
+StyleSheetLoader::Template StyleSheetLoader::ParseTemplate(
+    const QString& contents) {
+  const QString prefix("%palette-");
+  const QLatin1String alternate_base("alternate-base");
+  const QLatin1String lighter("-lighter");
+  const QLatin1String darker("-darker");
+
+  Template parts;
+  Part text;
+  int pos = 0;
+  forever {
+    const int start = contents.indexOf(prefix, pos, Qt::CaseInsensitive);
+    if (start == -1) break;
+
+    text.text_ += contents.midRef(pos, start - pos);
+    int end = start + prefix.length();
+
+    Part placeholder;
+    if (contents.midRef(end).startsWith(alternate_base, Qt::CaseInsensitive)) {
+      placeholder.role_ = QPalette::AlternateBase;
+      placeholder.shade_ = Part::Shade_AlternateBase;
+      end += alternate_base.size();
+    } else {
+      // Some names start with others, like WindowText, so take the longest.
+      int length = 0;
+      for (const PaletteRole& role : kPaletteRoles) {
+        const QLatin1String name(role.name_);
+        if (name.size() > length &&
+            contents.midRef(end).startsWith(name, Qt::CaseInsensitive)) {
+          placeholder.role_ = role.role_;
+          length = name.size();
+        }
+      }
+
+      if (placeholder.role_ == -1) {
+        // Not a colour we know, so leave it alone
+        text.text_ += contents.midRef(start, prefix.length());
+        pos = end;
+        continue;
+      }
+      end += length;
+
+      if (contents.midRef(end).startsWith(lighter, Qt::CaseInsensitive)) {
+        placeholder.shade_ = Part::Shade_Lighter;
+        end += lighter.size();
+      } else if (contents.midRef(end).startsWith(darker, Qt::CaseInsensitive)) {
+        placeholder.shade_ = Part::Shade_Darker;
+        end += darker.size();
+      }
+    }
+
+    if (!text.text_.isEmpty()) {
+      parts << text;
+      text = Part();
+    }
+    parts << placeholder;
+    pos = end;
+  }
+
+  text.text_ += contents.midRef(pos);
+  if (!text.text_.isEmpty()) parts << text;
+  return parts;
+}
+
+QString StyleSheetLoader::Expand(const Template& parts,
+                                 const QPalette& palette) {
+  QString ret;
+  for (const Part& part : parts) {
+    if (part.role_ == -1) {
+      ret += part.text_;
+      continue;
+    }
+
+    const QColor color =
+        palette.color(static_cast<QPalette::ColorRole>(part.role_));
+    switch (part.shade_) {
+      case Part::Shade_None:
+        ret += color.name();
+        break;
+
+      case Part::Shade_Lighter:
+        ret += color.lighter().name();
+        break;
+
+      case Part::Shade_Darker:
+        ret += color.darker().name();
+        break;
+
+      case Part::Shade_AlternateBase: {
+        QColor alt = color;
+        alt.setAlpha(50);
+        ret += QString("rgba(%1,%2,%3,%4%)")
+                   .arg(alt.red())
+                   .arg(alt.green())
+                   .arg(alt.blue())
+                   .arg(alt.alpha());
+        break;
+      }
+    }
+  }
+  return ret;
 }
 
 bool StyleSheetLoader::eventFilter(QObject* obj, QEvent* event) {
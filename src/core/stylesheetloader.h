@@ -19,6 +19,8 @@
 #ifndef CORE_STYLESHEETLOADER_H_
 #define CORE_STYLESHEETLOADER_H_
 
+#include <QHash>
+#include <QList>
 #include <QString>
 #include <QPalette>
 #include <QWidget>
@@ -38,12 +40,28 @@ class StyleSheetLoader : public QObject {
   bool eventFilter(QObject* obj, QEvent* event);
 
  private:
+  // A stylesheet file cut up at its %palette- placeholders, so it's only read
+  // and searched once however often the palette changes.
+  struct Part {
+    enum Shade { Shade_None, Shade_Lighter, Shade_Darker, Shade_AlternateBase };
+
+    Part() : role_(-1), shade_(Shade_None) {}
+
+    QString text_;
+    // -1 for plain text.
+    int role_;
+    Shade shade_;
+  };
+  typedef QList<Part> Template;
+
   void UpdateStyleSheet(QWidget* widget);
-  void ReplaceColor(QString* css, const QString& name, const QPalette& palette,
-                    QPalette::ColorRole role) const;
+  const Template& LoadTemplate(const QString& filename);
+  static Template ParseTemplate(const QString& contents);
+  static QString Expand(const Template& parts, const QPalette& palette);
 
  private:
   QMap<QWidget*, QString> filenames_;
+  QHash<QString, Template> templates_;
 };
 
 #endif  // CORE_STYLESHEETLOADER_H_
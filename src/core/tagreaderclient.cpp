@@ -23,19 +23,31 @@
 
 #include <QCoreApplication>
 #include <QFile>
+#include <QFileInfo>
 #include <QProcess>
+#include <QStorageInfo>
 #include <QTcpServer>
 #include <QThread>
+#include <QTimer>
 #include <QUrl>
 
 const char* TagReaderClient::kWorkerExecutableName = "clementine-tagreader";
+const int TagReaderClient::kReadFilesBatchSize = 25;
+const int TagReaderClient::kWriteDelayMsec = 2000;
+const int TagReaderClient::kMaxWritesPerDevice = 2;
 TagReaderClient* TagReaderClient::sInstance = nullptr;
 
 TagReaderClient::TagReaderClient(QObject* parent)
-    : QObject(parent), worker_pool_(new WorkerPool<HandlerType>(this)) {
+    : QObject(parent),
+      worker_pool_(new WorkerPool<HandlerType>(this)),
+      write_timer_(new QTimer(this)) {
   sInstance = this;
   setObjectName("Tag reader client");
 
+  write_timer_->setSingleShot(true);
+  write_timer_->setInterval(kWriteDelayMsec);
+  connect(write_timer_, SIGNAL(timeout()), SLOT(WritePendingTags()));
+
   QSettings s;
   s.beginGroup(Player::kSettingsGroup);
 
@@ -56,11 +68,26 @@ void TagReaderClient::WorkerFailedToStart() {
               << "not be able to read music file tags without it.";
 }
 
-TagReaderReply* TagReaderClient::ReadFile(const QString& filename) {
+TagReaderReply* TagReaderClient::ReadFile(const QString& filename,
+                                          pb::tagreader::ReadMode mode) {
   pb::tagreader::Message message;
   pb::tagreader::ReadFileRequest* req = message.mutable_read_file_request();
 
   req->set_filename(DataCommaSizeFromQString(filename));
+  req->set_mode(mode);
+
+  return worker_pool_->SendMessageWithReply(&message);
+}
+
+TagReaderReply* TagReaderClient::ReadFiles(const QStringList& filenames,
+                                           pb::tagreader::ReadMode mode) {
+  pb::tagreader::Message message;
+  pb::tagreader::ReadFilesRequest* req = message.mutable_read_files_request();
+
+  for (const QString& filename : filenames) {
+    req->add_filenames(DataCommaSizeFromQString(filename));
+  }
+  req->set_mode(mode);
 
   return worker_pool_->SendMessageWithReply(&message);
 }
@@ -88,10 +115,7 @@ TagReaderReply* TagReaderClient::UpdateSongStatistics(const Song& metadata) {
 }
 
 void TagReaderClient::UpdateSongsStatistics(const SongList& songs) {
-  for (const Song& song : songs) {
-    TagReaderReply* reply = UpdateSongStatistics(song);
-    connect(reply, SIGNAL(Finished(bool)), reply, SLOT(deleteLater()));
-  }
+  QueueTagWrites(songs, true, false);
 }
 
 TagReaderReply* TagReaderClient::UpdateSongRating(const Song& metadata) {
@@ -106,18 +130,156 @@ TagReaderReply* TagReaderClient::UpdateSongRating(const Song& metadata) {
 }
 
 void TagReaderClient::UpdateSongsRating(const SongList& songs) {
-  for (const Song& song : songs) {
-    TagReaderReply* reply = UpdateSongRating(song);
-    connect(reply, SIGNAL(Finished(bool)), reply, SLOT(deleteLater()));
+  QueueTagWrites(songs, false, true);
+}
+
+void TagReaderClient::QueueTagWrites(const SongList& songs, bool statistics,
+                                     bool rating) {
+  {
+    QMutexLocker l(&pending_writes_mutex_);
+    for (const Song& song : songs) {
+      const QString filename = song.url().toLocalFile();
+      if (filename.isEmpty()) continue;
+
+      // The newest song has the newest statistics and rating, so it replaces
+      // whatever was queued for the file.
+      PendingWrite& write = pending_writes_[filename];
+      write.song_ = song;
+      write.statistics_ |= statistics;
+      write.rating_ |= rating;
+    }
+  }
+
+  // The timer lives on my thread.
+  QMetaObject::invokeMethod(this, "StartWriteTimer", Qt::AutoConnection);
+}
+
+void TagReaderClient::StartWriteTimer() {
+  // Not restarted, so a steady stream of changes still gets written.
+  if (!write_timer_->isActive()) {
+    write_timer_->start();
   }
 }
 
-TagReaderReply* TagReaderClient::IsMediaFile(const QString& filename) {
+QString TagReaderClient::DeviceForFile(const QString& filename) {
+  const QString dir = QFileInfo(filename).absolutePath();
+  auto it = device_for_dir_.find(dir);
+  if (it == device_for_dir_.end()) {
+    it = device_for_dir_.insert(
+        dir, QString::fromLocal8Bit(QStorageInfo(dir).device()));
+  }
+  return it.value();
+}
+
+void TagReaderClient::WritePendingTags() {
+  QList<QPair<PendingWrite, QString>> to_write;
+  {
+    QMutexLocker l(&pending_writes_mutex_);
+    for (auto it = pending_writes_.begin(); it != pending_writes_.end();) {
+      const QString device = DeviceForFile(it.key());
+      int& in_flight = writes_in_flight_[device];
+      if (in_flight >= kMaxWritesPerDevice ||
+          files_in_flight_.contains(it.key())) {
+        ++it;
+        continue;
+      }
+
+      in_flight++;
+      files_in_flight_.insert(it.key());
+      to_write << qMakePair(it.value(), device);
+      it = pending_writes_.erase(it);
+    }
+  }
+
+  for (const auto& write : to_write) {
+    ContinueTagWrite(write.first, write.second);
+  }
+}
+
+void TagReaderClient::ContinueTagWrite(const PendingWrite& write,
+                                       const QString& device) {
+  // Statistics and rating are written one after the other so that two
+  // workers never rewrite the same file at once.
+  PendingWrite rest(write);
+  TagReaderReply* reply = nullptr;
+  if (rest.statistics_) {
+    reply = UpdateSongStatistics(rest.song_);
+    rest.statistics_ = false;
+  } else if (rest.rating_) {
+    reply = UpdateSongRating(rest.song_);
+    rest.rating_ = false;
+  }
+
+  if (reply) {
+    connect(reply, &_MessageReplyBase::Finished, this, [=]() {
+      reply->deleteLater();
+      ContinueTagWrite(rest, device);
+    });
+    return;
+  }
+
+  // This file is finished, make room for the next one on the device.
+  bool more = false;
+  {
+    QMutexLocker l(&pending_writes_mutex_);
+    writes_in_flight_[device]--;
+    files_in_flight_.remove(write.song_.url().toLocalFile());
+    more = !pending_writes_.isEmpty();
+  }
+  if (more && !write_timer_->isActive()) {
+    WritePendingTags();
+  }
+}
+
+void TagReaderClient::FlushPendingWrites() {
+  Q_ASSERT(QThread::currentThread() != thread());
+
+  QMap<QString, PendingWrite> writes;
+  {
+    QMutexLocker l(&pending_writes_mutex_);
+    writes.swap(pending_writes_);
+  }
+  if (writes.isEmpty()) return;
+
+  qLog(Debug) << "Writing" << writes.count() << "queued tag changes";
+
+  // Statistics first, then ratings, so each file still only has one write
+  // at a time.
+  for (int pass = 0; pass < 2; ++pass) {
+    QList<TagReaderReply*> replies;
+    for (const PendingWrite& write : writes) {
+      if (pass == 0 && write.statistics_) {
+        replies << UpdateSongStatistics(write.song_);
+      } else if (pass == 1 && write.rating_) {
+        replies << UpdateSongRating(write.song_);
+      }
+    }
+    for (TagReaderReply* reply : replies) {
+      reply->WaitForFinished();
+      reply->deleteLater();
+    }
+  }
+}
+
+TagReaderReply* TagReaderClient::UpdateSongReplayGain(const Song& metadata) {
+  pb::tagreader::Message message;
+  pb::tagreader::SaveSongReplayGainToFileRequest* req =
+      message.mutable_save_song_replaygain_to_file_request();
+
+  req->set_filename(DataCommaSizeFromQString(metadata.url().toLocalFile()));
+  metadata.ToProtobuf(req->mutable_metadata());
+
+  return worker_pool_->SendMessageWithReply(&message);
+}
+
+TagReaderReply* TagReaderClient::IsMediaFile(const QString& filename,
+                                             pb::tagreader::ReadMode mode) {
   pb::tagreader::Message message;
   pb::tagreader::IsMediaFileRequest* req =
       message.mutable_is_media_file_request();
 
   req->set_filename(DataCommaSizeFromQString(filename));
+  req->set_mode(mode);
 
   return worker_pool_->SendMessageWithReply(&message);
 }
@@ -128,6 +290,8 @@ TagReaderReply* TagReaderClient::LoadEmbeddedArt(const QString& filename) {
       message.mutable_load_embedded_art_request();
 
   req->set_filename(DataCommaSizeFromQString(filename));
+  const QString shared_dir = worker_pool_->shared_payload_dir();
+  req->set_shared_payload_dir(DataCommaSizeFromQString(shared_dir));
 
   return worker_pool_->SendMessageWithReply(&message);
 }
@@ -159,6 +323,47 @@ void TagReaderClient::ReadFileBlocking(const QString& filename, Song* song) {
   reply->deleteLater();
 }
 
+SongList TagReaderClient::ReadFilesBlocking(const QStringList& filenames) {
+  SongList ret;
+  ret.reserve(filenames.count());
+  for (int i = 0; i < filenames.count(); ++i) {
+    ret << Song();
+  }
+
+  ReadFilesBlocking(filenames, &ret);
+  return ret;
+}
+
+void TagReaderClient::ReadFilesBlocking(const QStringList& filenames,
+                                        SongList* songs) {
+  Q_ASSERT(QThread::currentThread() != thread());
+  Q_ASSERT(songs->count() == filenames.count());
+
+  QList<TagReaderReply*> replies;
+  for (int i = 0; i < filenames.count(); i += kReadFilesBatchSize) {
+    replies << ReadFiles(filenames.mid(i, kReadFilesBatchSize));
+  }
+
+  int offset = 0;
+  for (TagReaderReply* reply : replies) {
+    const int batch_size = reply->request_message().read_files_request()
+                               .filenames_size();
+
+    if (reply->WaitForFinished()) {
+      const pb::tagreader::ReadFilesResponse& response =
+          reply->message().read_files_response();
+      // The worker may have died part way through
+      const int received = qMin(response.metadata_size(), batch_size);
+      for (int i = 0; i < received; ++i) {
+        (*songs)[offset + i].InitFromProtobuf(response.metadata(i));
+      }
+    }
+
+    offset += batch_size;
+    reply->deleteLater();
+  }
+}
+
 bool TagReaderClient::SaveFileBlocking(const QString& filename,
                                        const Song& metadata) {
   Q_ASSERT(QThread::currentThread() != thread());
@@ -174,6 +379,27 @@ bool TagReaderClient::SaveFileBlocking(const QString& filename,
   return ret;
 }
 
+QList<bool> TagReaderClient::SaveFilesBlocking(const QStringList& filenames,
+                                               const SongList& metadata) {
+  Q_ASSERT(QThread::currentThread() != thread());
+  Q_ASSERT(metadata.count() == filenames.count());
+
+  QList<TagReaderReply*> replies;
+  for (int i = 0; i < filenames.count(); ++i) {
+    replies << SaveFile(filenames[i], metadata[i]);
+  }
+
+  QList<bool> ret;
+  ret.reserve(replies.count());
+  for (TagReaderReply* reply : replies) {
+    ret << (reply->WaitForFinished() &&
+            reply->message().save_file_response().success());
+    reply->deleteLater();
+  }
+
+  return ret;
+}
+
 bool TagReaderClient::UpdateSongStatisticsBlocking(const Song& metadata) {
   Q_ASSERT(QThread::currentThread() != thread());
 
@@ -202,12 +428,13 @@ bool TagReaderClient::UpdateSongRatingBlocking(const Song& metadata) {
   return ret;
 }
 
-bool TagReaderClient::IsMediaFileBlocking(const QString& filename) {
+bool TagReaderClient::IsMediaFileBlocking(const QString& filename,
+                                          pb::tagreader::ReadMode mode) {
   Q_ASSERT(QThread::currentThread() != thread());
 
   bool ret = false;
 
-  TagReaderReply* reply = IsMediaFile(filename);
+  TagReaderReply* reply = IsMediaFile(filename, mode);
   if (reply->WaitForFinished()) {
     ret = reply->message().is_media_file_response().success();
   }
@@ -223,9 +450,44 @@ QImage TagReaderClient::LoadEmbeddedArtBlocking(const QString& filename) {
 
   TagReaderReply* reply = LoadEmbeddedArt(filename);
   if (reply->WaitForFinished()) {
-    const std::string& data_str =
-        reply->message().load_embedded_art_response().data();
-    ret.loadFromData(QByteArray(data_str.data(), data_str.size()));
+    const pb::tagreader::LoadEmbeddedArtResponse& response =
+        reply->message().load_embedded_art_response();
+    if (response.has_shared_payload_file()) {
+      // Decode straight from the worker's file without copying it.
+      MappedPayload payload(
+          worker_pool_->shared_payload_dir(),
+          QStringFromStdString(response.shared_payload_file()));
+      if (payload.is_valid()) {
+        ret.loadFromData(payload.data(), payload.size());
+      }
+    } else {
+      ret.loadFromData(
+          reinterpret_cast<const uchar*>(response.data().data()),
+          response.data().size());
+    }
+  }
+  reply->deleteLater();
+
+  return ret;
+}
+
+QByteArray TagReaderClient::LoadEmbeddedArtDataBlocking(
+    const QString& filename) {
+  Q_ASSERT(QThread::currentThread() != thread());
+
+  QByteArray ret;
+
+  TagReaderReply* reply = LoadEmbeddedArt(filename);
+  if (reply->WaitForFinished()) {
+    const pb::tagreader::LoadEmbeddedArtResponse& response =
+        reply->message().load_embedded_art_response();
+    if (response.has_shared_payload_file()) {
+      ret = MappedPayload(worker_pool_->shared_payload_dir(),
+                          QStringFromStdString(response.shared_payload_file()))
+                .ToByteArray();
+    } else {
+      ret = QByteArray(response.data().data(), response.data().size());
+    }
   }
   reply->deleteLater();
 
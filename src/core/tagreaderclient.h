@@ -26,10 +26,15 @@
 #include "core/messagehandler.h"
 #include "core/workerpool.h"
 
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QSet>
 #include <QStringList>
 
 class QLocalServer;
 class QProcess;
+class QTimer;
 
 class TagReaderClient : public QObject {
   Q_OBJECT
@@ -42,13 +47,27 @@ class TagReaderClient : public QObject {
 
   static const char* kWorkerExecutableName;
 
+  // The maximum number of files sent to a worker in one ReadFiles request.
+  static const int kReadFilesBatchSize;
+
   void Start();
 
-  ReplyType* ReadFile(const QString& filename);
+  ReplyType* ReadFile(const QString& filename,
+                      pb::tagreader::ReadMode mode = pb::tagreader::READ_FULL);
+  // Reads several files in one request.  The response contains the metadata
+  // of each file in the same order as filenames.
+  ReplyType* ReadFiles(
+      const QStringList& filenames,
+      pb::tagreader::ReadMode mode = pb::tagreader::READ_FULL);
   ReplyType* SaveFile(const QString& filename, const Song& metadata);
   ReplyType* UpdateSongStatistics(const Song& metadata);
   ReplyType* UpdateSongRating(const Song& metadata);
-  ReplyType* IsMediaFile(const QString& filename);
+  ReplyType* UpdateSongReplayGain(const Song& metadata);
+  ReplyType* IsMediaFile(
+      const QString& filename,
+      pb::tagreader::ReadMode mode = pb::tagreader::READ_FULL);
+  // Large pictures come back in a shared_payload_file, which the caller must
+  // open with a MappedPayload so that it gets removed.
   ReplyType* LoadEmbeddedArt(const QString& filename);
   ReplyType* ReadCloudFile(const QUrl& download_url, const QString& title,
                            int size, const QString& mime_type,
@@ -58,27 +77,85 @@ class TagReaderClient : public QObject {
   // response.  These block the calling thread with a semaphore, and must NOT
   // be called from the TagReaderClient's thread.
   void ReadFileBlocking(const QString& filename, Song* song);
+  // Splits filenames into batches of at most kReadFilesBatchSize and sends
+  // them all at once so they are spread over the workers.  Returns one Song
+  // per filename, in the same order.  Files that could not be read give an
+  // invalid Song.
+  SongList ReadFilesBlocking(const QStringList& filenames);
+  // As above, but reads the tags of each file into the song at the same
+  // position in songs like ReadFileBlocking does, keeping any fields that
+  // don't come from the file.  Songs whose file could not be read are left
+  // untouched.
+  void ReadFilesBlocking(const QStringList& filenames, SongList* songs);
   bool SaveFileBlocking(const QString& filename, const Song& metadata);
+  // Sends every save at once so they are spread over the workers, then waits
+  // for them all.  Returns whether each file was saved, in the same order as
+  // filenames.
+  QList<bool> SaveFilesBlocking(const QStringList& filenames,
+                                const SongList& metadata);
   bool UpdateSongStatisticsBlocking(const Song& metadata);
   bool UpdateSongRatingBlocking(const Song& metadata);
-  bool IsMediaFileBlocking(const QString& filename);
+  bool IsMediaFileBlocking(
+      const QString& filename,
+      pb::tagreader::ReadMode mode = pb::tagreader::READ_FULL);
   QImage LoadEmbeddedArtBlocking(const QString& filename);
+  // As above, but returns the picture as it's stored in the file.
+  QByteArray LoadEmbeddedArtDataBlocking(const QString& filename);
 
   // TODO(David Sansome): Make this not a singleton
   static TagReaderClient* Instance() { return sInstance; }
 
+  // Writes every statistics and rating change that's still waiting in the
+  // queue now, and waits for them.  Must NOT be called from the
+  // TagReaderClient's thread.
+  void FlushPendingWrites();
+
  public slots:
+  // These don't touch the files straight away.  Changes are held back for a
+  // moment so that repeated changes to the same file are written once, and
+  // only a few files on each device are written at a time.  Can be called
+  // from any thread.
   void UpdateSongsStatistics(const SongList& songs);
   void UpdateSongsRating(const SongList& songs);
 
  private slots:
   void WorkerFailedToStart();
+  void StartWriteTimer();
+  void WritePendingTags();
 
  private:
+  struct PendingWrite {
+    PendingWrite() : statistics_(false), rating_(false) {}
+
+    Song song_;
+    bool statistics_;
+    bool rating_;
+  };
+
+  static const int kWriteDelayMsec;
+  static const int kMaxWritesPerDevice;
+
+  void QueueTagWrites(const SongList& songs, bool statistics, bool rating);
+  // Sends the next part of write, and calls itself again when that's done.
+  // Must be called on my thread.
+  void ContinueTagWrite(const PendingWrite& write, const QString& device);
+  // Must be called with pending_writes_mutex_ held.
+  QString DeviceForFile(const QString& filename);
+
   static TagReaderClient* sInstance;
 
   WorkerPool<HandlerType>* worker_pool_;
   QList<pb::tagreader::Message> message_queue_;
+
+  // Keyed by filename.
+  QMutex pending_writes_mutex_;
+  QMap<QString, PendingWrite> pending_writes_;
+  QTimer* write_timer_;
+  // Files being written, the number of them on each device, and the device
+  // each directory is on.
+  QSet<QString> files_in_flight_;
+  QHash<QString, int> writes_in_flight_;
+  QHash<QString, QString> device_for_dir_;
 };
 
 typedef TagReaderClient::ReplyType TagReaderReply;
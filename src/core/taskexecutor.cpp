@@ -0,0 +1,43 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "taskexecutor.h"
+
+#include <QThread>
+#include <QtGlobal>
+
+TaskExecutor::TaskExecutor() {
+  const int cores = qMax(1, QThread::idealThreadCount());
+
+  // Interactive work gets at least two threads so one slow job doesn't make
+  // everything else wait, even on a single core.  Bulk work leaves at least
+  // half the machine alone.
+  pools_[Lane_Interactive].setMaxThreadCount(qMax(2, cores));
+  pools_[Lane_Background].setMaxThreadCount(qMax(1, cores - 1));
+  pools_[Lane_Bulk].setMaxThreadCount(qMax(1, cores / 2));
+}
+
+TaskExecutor::~TaskExecutor() { WaitForDone(); }
+
+void TaskExecutor::SetMaxThreadCount(Lane lane, int count) {
+  pools_[lane].setMaxThreadCount(qMax(1, count));
+}
+
+void TaskExecutor::WaitForDone() {
+  for (QThreadPool& pool : pools_) {
+    pool.waitForDone();
+  }
+}
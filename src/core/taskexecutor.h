@@ -0,0 +1,94 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_TASKEXECUTOR_H_
+#define CORE_TASKEXECUTOR_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include <QFuture>
+#include <QThreadPool>
+
+#include "core/concurrentrun.h"
+
+// Shared by whoever started a piece of work and the work itself.  Cancelling
+// it stops the work from starting if it's still queued, and long running
+// work can check is_cancelled() to give up early.
+class CancellationToken {
+ public:
+  CancellationToken() : cancelled_(new std::atomic<bool>(false)) {}
+
+  void Cancel() { cancelled_->store(true); }
+  bool is_cancelled() const { return cancelled_->load(); }
+
+ private:
+  std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+// Runs background work for the whole application.  Work goes into one of
+// three lanes, each with its own threads, so a library's worth of bulk work
+// can never hold up something the user is waiting to see.  Use this instead
+// of QtConcurrent::run, which puts everything on the one global pool.
+class TaskExecutor {
+ public:
+  enum Lane {
+    // The user is waiting for the result: loading a playlist, filling in a
+    // dialog, drawing something.
+    Lane_Interactive = 0,
+    // Should happen soon, but nobody is watching it.
+    Lane_Background,
+    // Big jobs that can take as long as they like, like parsing a whole
+    // catalogue or analysing the library.
+    Lane_Bulk,
+  };
+
+  static TaskExecutor* Instance() {
+    static TaskExecutor instance;
+    return &instance;
+  }
+
+  // Changes the number of jobs that can run at once in a lane.
+  void SetMaxThreadCount(Lane lane, int count);
+
+  // Blocks until every lane is empty.
+  void WaitForDone();
+
+  template <typename ReturnType>
+  QFuture<ReturnType> Run(Lane lane, std::function<ReturnType()> function) {
+    return (new ThreadFunctor<ReturnType>(function))->Start(&pools_[lane]);
+  }
+
+  // The work isn't run at all if the token is cancelled before it starts.
+  // Cancelling the returned QFuture does the same.
+  template <typename ReturnType>
+  QFuture<ReturnType> Run(Lane lane, const CancellationToken& token,
+                          std::function<ReturnType()> function) {
+    return Run<ReturnType>(lane, [token, function]() {
+      if (token.is_cancelled()) return ReturnType();
+      return function();
+    });
+  }
+
+ private:
+  TaskExecutor();
+  ~TaskExecutor();
+
+  QThreadPool pools_[Lane_Bulk + 1];
+};
+
+#endif  // CORE_TASKEXECUTOR_H_
@@ -20,7 +20,49 @@
 
 #include "taskmanager.h"
 
-TaskManager::TaskManager(QObject* parent) : QObject(parent), next_task_id_(1) {}
+#include <QCoreApplication>
+#include <QTimer>
+
+#include "core/logging.h"
+
+const int TaskManager::kMaxHistory = 100;
+const int TaskManager::kStallCheckIntervalMsec = 10000;
+const int TaskManager::kStallTimeoutMsec = 60000;
+
+// Log lines are key=value pairs so they can be pulled out of logs from
+// different versions and compared.
+static QString Quote(const QString& value) {
+  return "\"" + QString(value).replace('"', "'") + "\"";
+}
+
+double TaskManager::TaskStats::items_per_sec() const {
+  if (duration_msec <= 0) return 0;
+  return double(items) * 1000 / duration_msec;
+}
+
+QString TaskManager::TaskStats::ToString() const {
+  QString ret = QString("%1  %2: %3 ms")
+                    .arg(started.toString("hh:mm:ss"), name,
+                         QString::number(duration_msec));
+  if (items > 0) {
+    ret += QString(", %1 items (%2/s)")
+               .arg(items)
+               .arg(items_per_sec(), 0, 'f', 1);
+  }
+  if (stall_count > 0) {
+    ret += QString(", stalled %1 times").arg(stall_count);
+  }
+  return ret;
+}
+
+TaskManager::TaskManager(QObject* parent)
+    : QObject(parent), next_task_id_(1), stall_timer_(new QTimer(this)) {
+  clock_.start();
+
+  stall_timer_->setInterval(kStallCheckIntervalMsec);
+  connect(stall_timer_, SIGNAL(timeout()), SLOT(CheckForStalls()));
+  stall_timer_->start();
+}
 
 int TaskManager::StartTask(const QString& name) {
   Task t;
@@ -28,10 +70,15 @@ int TaskManager::StartTask(const QString& name) {
   t.progress = 0;
   t.progress_max = 0;
   t.blocks_library_scans = false;
+  t.started = QDateTime::currentDateTime();
+  t.stalled = false;
+  t.stall_count = 0;
 
   {
     QMutexLocker l(&mutex_);
     t.id = next_task_id_++;
+    t.start_msec = clock_.elapsed();
+    t.last_progress_msec = t.start_msec;
     tasks_[t.id] = t;
   }
 
@@ -50,6 +97,46 @@ QList<TaskManager::Task> TaskManager::GetTasks() {
   return ret;
 }
 
+QList<TaskManager::TaskStats> TaskManager::GetHistory() {
+  QMutexLocker l(&mutex_);
+  return history_;
+}
+
+void TaskManager::ProgressChanged(Task* task) {
+  task->last_progress_msec = clock_.elapsed();
+
+  if (task->stalled) {
+    task->stalled = false;
+    qLog(Info) << QString("event=task_resumed id=%1 name=%2")
+                      .arg(QString::number(task->id), Quote(task->name))
+                      .toUtf8()
+                      .constData();
+  }
+}
+
+void TaskManager::CheckForStalls() {
+  QMutexLocker l(&mutex_);
+  const qint64 now = clock_.elapsed();
+
+  for (Task& task : tasks_) {
+    if (task.stalled || now - task.last_progress_msec < kStallTimeoutMsec) {
+      continue;
+    }
+
+    task.stalled = true;
+    task.stall_count++;
+    qLog(Warning) << QString(
+                         "event=task_stalled id=%1 name=%2 progress=%3 max=%4 "
+                         "idle_ms=%5")
+                         .arg(QString::number(task.id), Quote(task.name),
+                              QString::number(task.progress),
+                              QString::number(task.progress_max),
+                              QString::number(now - task.last_progress_msec))
+                         .toUtf8()
+                         .constData();
+  }
+}
+
 void TaskManager::SetTaskBlocksLibraryScans(int id) {
   {
     QMutexLocker l(&mutex_);
@@ -71,6 +158,7 @@ void TaskManager::SetTaskProgress(int id, int progress, int max) {
     Task& t = tasks_[id];
     t.progress = progress;
     if (max) t.progress_max = max;
+    ProgressChanged(&t);
   }
 
   emit TasksChanged();
@@ -84,6 +172,7 @@ void TaskManager::IncreaseTaskProgress(int id, int progress, int max) {
     Task& t = tasks_[id];
     t.progress += progress;
     if (max) t.progress_max = max;
+    ProgressChanged(&t);
   }
 
   emit TasksChanged();
@@ -106,7 +195,31 @@ void TaskManager::SetTaskFinished(int id) {
       }
     }
 
-    tasks_.remove(id);
+    const Task task = tasks_.take(id);
+
+    TaskStats stats;
+    stats.name = task.name;
+    stats.started = task.started;
+    stats.duration_msec = clock_.elapsed() - task.start_msec;
+    stats.items = task.progress;
+    stats.stall_count = task.stall_count;
+
+    history_ << stats;
+    while (history_.count() > kMaxHistory) {
+      history_.removeFirst();
+    }
+
+    qLog(Info) << QString(
+                      "event=task_finished name=%1 duration_ms=%2 items=%3 "
+                      "items_per_sec=%4 stalls=%5 version=%6")
+                      .arg(Quote(stats.name),
+                           QString::number(stats.duration_msec),
+                           QString::number(stats.items),
+                           QString::number(stats.items_per_sec(), 'f', 1),
+                           QString::number(stats.stall_count),
+                           QCoreApplication::applicationVersion())
+                      .toUtf8()
+                      .constData();
   }
 
   emit TasksChanged();
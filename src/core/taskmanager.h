@@ -21,9 +21,15 @@
 #ifndef CORE_TASKMANAGER_H_
 #define CORE_TASKMANAGER_H_
 
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QList>
 #include <QMap>
 #include <QMutex>
 #include <QObject>
+#include <QStringList>
+
+class QTimer;
 
 class TaskManager : public QObject {
   Q_OBJECT
@@ -37,6 +43,25 @@ class TaskManager : public QObject {
     int progress;
     int progress_max;
     bool blocks_library_scans;
+
+    QDateTime started;
+    // Relative to the TaskManager's clock.
+    qint64 start_msec;
+    qint64 last_progress_msec;
+    bool stalled;
+    int stall_count;
+  };
+
+  // What a task did, kept after it finishes.
+  struct TaskStats {
+    QString name;
+    QDateTime started;
+    qint64 duration_msec;
+    int items;
+    int stall_count;
+
+    double items_per_sec() const;
+    QString ToString() const;
   };
 
   class ScopedTask {
@@ -55,6 +80,8 @@ class TaskManager : public QObject {
 
   // Everything here is thread safe
   QList<Task> GetTasks();
+  // The most recently finished tasks, oldest first.
+  QList<TaskStats> GetHistory();
 
   int StartTask(const QString& name);
   void SetTaskBlocksLibraryScans(int id);
@@ -69,11 +96,25 @@ class TaskManager : public QObject {
   void PauseLibraryWatchers();
   void ResumeLibraryWatchers();
 
+ private slots:
+  void CheckForStalls();
+
  private:
+  static const int kMaxHistory;
+  static const int kStallCheckIntervalMsec;
+  static const int kStallTimeoutMsec;
+
+  // Must be called with mutex_ held.
+  void ProgressChanged(Task* task);
+
   QMutex mutex_;
   QMap<int, Task> tasks_;
   int next_task_id_;
 
+  QElapsedTimer clock_;
+  QTimer* stall_timer_;
+  QList<TaskStats> history_;
+
   Q_DISABLE_COPY(TaskManager)
 };
 
@@ -19,6 +19,10 @@
 
 #include "urlhandler.h"
 
+#include <QDateTime>
+
+const int UrlHandler::kMaxCachedMediaUrls = 1000;
+
 UrlHandler::LoadResult::LoadResult(const QUrl& original_url, Type type,
                                    const QUrl& media_url, qint64 length_nanosec)
     : original_url_(original_url),
@@ -29,3 +33,39 @@ UrlHandler::LoadResult::LoadResult(const QUrl& original_url, Type type,
 UrlHandler::UrlHandler(QObject* parent) : QObject(parent) {}
 
 QIcon UrlHandler::icon() const { return QIcon(); }
+
+void UrlHandler::CacheMediaUrl(const QUrl& url, const QUrl& media_url,
+                               qint64 max_age_msec) {
+  if (media_url.isEmpty()) return;
+
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+  if (media_urls_.count() >= kMaxCachedMediaUrls) {
+    for (auto it = media_urls_.begin(); it != media_urls_.end();) {
+      if (it->expiry_msec_ <= now) {
+        it = media_urls_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    // Everything is still fresh, so start again.
+    if (media_urls_.count() >= kMaxCachedMediaUrls) media_urls_.clear();
+  }
+
+  CachedMediaUrlEntry entry;
+  entry.media_url_ = media_url;
+  entry.expiry_msec_ = now + max_age_msec;
+  media_urls_[url] = entry;
+}
+
+QUrl UrlHandler::CachedMediaUrl(const QUrl& url) {
+  auto it = media_urls_.find(url);
+  if (it == media_urls_.end()) return QUrl();
+
+  if (it->expiry_msec_ <= QDateTime::currentMSecsSinceEpoch()) {
+    media_urls_.erase(it);
+    return QUrl();
+  }
+  return it->media_url_;
+}
+
+void UrlHandler::ForgetMediaUrl(const QUrl& url) { media_urls_.remove(url); }
@@ -21,6 +21,7 @@
 #ifndef CORE_URLHANDLER_H_
 #define CORE_URLHANDLER_H_
 
+#include <QHash>
 #include <QIcon>
 #include <QObject>
 #include <QUrl>
@@ -75,6 +76,10 @@ class UrlHandler : public QObject {
   // a chance to do something clever to get a playable track.
   virtual LoadResult StartLoading(const QUrl& url) { return LoadResult(url); }
 
+  // True if StartLoading() does nothing but work out the media url, so the
+  // player may call it for the next track before that track is played.
+  virtual bool CanResolveEarly() const { return false; }
+
   // Called by the player when a song finishes - gives the handler a chance to
   // get another track to play.
   virtual LoadResult LoadNext(const QUrl& url) { return LoadResult(url); }
@@ -84,8 +89,31 @@ class UrlHandler : public QObject {
   virtual void TrackAboutToEnd() {}
   virtual void TrackSkipped() {}
 
+  // Forgets the media url remembered for url, eg. because it didn't play.
+  void ForgetMediaUrl(const QUrl& url);
+
  signals:
   void AsyncLoadComplete(const UrlHandler::LoadResult& result);
+
+ protected:
+  // Remembers what url resolved to, so StartLoading() doesn't have to ask the
+  // service again until max_age_msec has passed.  Services that hand out
+  // expiring links should pass a bit less than the link's lifetime.
+  void CacheMediaUrl(const QUrl& url, const QUrl& media_url,
+                     qint64 max_age_msec);
+  // Returns the media url remembered for url, or an empty url if there isn't
+  // one or it has expired.
+  QUrl CachedMediaUrl(const QUrl& url);
+
+ private:
+  static const int kMaxCachedMediaUrls;
+
+  struct CachedMediaUrlEntry {
+    QUrl media_url_;
+    qint64 expiry_msec_;
+  };
+
+  QHash<QUrl, CachedMediaUrlEntry> media_urls_;
 };
 
 #endif  // CORE_URLHANDLER_H_
@@ -61,6 +61,7 @@
 
 #ifdef Q_OS_LINUX
 #include <unistd.h>
+#include <sys/resource.h>
 #include <sys/syscall.h>
 #endif
 #ifdef Q_OS_DARWIN
@@ -384,6 +385,24 @@ QString GetConfigPath(ConfigPath config) {
     case Path_PixmapCache:
       return GetConfigPath(Path_CacheRoot) + "/pixmapcache";
 
+    case Path_SongInfoCache:
+      return GetConfigPath(Path_CacheRoot) + "/songinfocache";
+
+    case Path_CddaCache:
+      return GetConfigPath(Path_CacheRoot) + "/cddacache";
+
+    case Path_TranscodeCache:
+      return GetConfigPath(Path_CacheRoot) + "/transcodecache";
+
+    case Path_StreamCache:
+      return GetConfigPath(Path_CacheRoot) + "/streamcache";
+
+    case Path_SeekIndexCache:
+      return GetConfigPath(Path_CacheRoot) + "/seekindex";
+
+    case Path_EmbeddedArtCache:
+      return GetConfigPath(Path_CacheRoot) + "/embeddedart";
+
     case Path_GstreamerRegistry:
       return GetConfigPath(Path_Root) +
              QString("/gst-registry-%1-bin")
@@ -661,6 +680,17 @@ int SetThreadIOPriority(IoPriority priority) {
 #endif
 }
 
+int SetThreadIdlePriority() {
+#ifdef Q_OS_LINUX
+  // Linux applies nice values to single threads.
+  return setpriority(PRIO_PROCESS, GetThreadId(), 19);
+#elif defined(Q_OS_WIN32)
+  return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE) ? 0 : -1;
+#else
+  return 0;
+#endif
+}
+
 int GetThreadId() {
 #ifdef Q_OS_LINUX
   return syscall(SYS_gettid);
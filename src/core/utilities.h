@@ -139,6 +139,12 @@ enum ConfigPath {
   Path_LocalSpotifyBlob,
   Path_MoodbarCache,
   Path_PixmapCache,
+  Path_SongInfoCache,
+  Path_CddaCache,
+  Path_TranscodeCache,
+  Path_StreamCache,
+  Path_SeekIndexCache,
+  Path_EmbeddedArtCache,
   Path_CacheRoot,
 };
 QString GetConfigPath(ConfigPath config);
@@ -158,6 +164,9 @@ enum {
 static const int IOPRIO_CLASS_SHIFT = 13;
 
 int SetThreadIOPriority(IoPriority priority);
+// Lowers the CPU priority of the calling thread, including threads that
+// weren't started by Qt.
+int SetThreadIdlePriority();
 int GetThreadId();
 
 // Returns true if this machine has a battery.
@@ -20,12 +20,16 @@
 #include "albumcoverexporter.h"
 
 #include <QFile>
+#include <QThread>
 #include <QThreadPool>
+#include <QUrl>
+
+#include <algorithm>
 
 #include "coverexportrunnable.h"
 #include "core/song.h"
 
-const int AlbumCoverExporter::kMaxConcurrentRequests = 3;
+const int AlbumCoverExporter::kMaxConcurrentCopies = 2;
 
 AlbumCoverExporter::AlbumCoverExporter(QObject* parent)
     : QObject(parent),
@@ -33,24 +37,50 @@ AlbumCoverExporter::AlbumCoverExporter(QObject* parent)
       exported_(0),
       skipped_(0),
       all_(0) {
-  thread_pool_->setMaxThreadCount(kMaxConcurrentRequests);
+  thread_pool_->setMaxThreadCount(kMaxConcurrentCopies);
 }
 
 void AlbumCoverExporter::SetDialogResult(
     const AlbumCoverExport::DialogResult& dialog_result) {
   dialog_result_ = dialog_result;
+
+  if (dialog_result_.RequiresCoverProcessing()) {
+    thread_pool_->setMaxThreadCount(
+        std::max(kMaxConcurrentCopies, QThread::idealThreadCount()));
+  } else {
+    thread_pool_->setMaxThreadCount(kMaxConcurrentCopies);
+  }
 }
 
 void AlbumCoverExporter::AddExportRequest(Song song) {
-  requests_.append(new CoverExportRunnable(dialog_result_, song));
+  // Albums that share a directory would all write the same cover file, so
+  // they're handled by one request that exports the first cover it can.
+  const QString dir = song.url().toLocalFile().section('/', 0, -2);
+
+  CoverExportRunnable* runnable = requests_by_dir_.value(dir);
+  if (runnable) {
+    runnable->AddSong(song);
+    return;
+  }
+
+  runnable = new CoverExportRunnable(dialog_result_, song);
+  requests_.append(runnable);
+  requests_by_dir_[dir] = runnable;
   all_ = requests_.count();
 }
 
-void AlbumCoverExporter::Cancel() { requests_.clear(); }
+void AlbumCoverExporter::Cancel() {
+  qDeleteAll(requests_);
+  requests_.clear();
+  requests_by_dir_.clear();
+}
 
 void AlbumCoverExporter::StartExporting() {
   exported_ = 0;
   skipped_ = 0;
+
+  // The pool deletes the runnables once they've run.
+  requests_by_dir_.clear();
   AddJobsToPool();
 }
 
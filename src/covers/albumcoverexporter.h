@@ -23,6 +23,7 @@
 #include "core/song.h"
 #include "ui/albumcoverexport.h"
 
+#include <QMap>
 #include <QObject>
 #include <QQueue>
 #include <QTimer>
@@ -36,7 +37,9 @@ class AlbumCoverExporter : public QObject {
   explicit AlbumCoverExporter(QObject* parent = nullptr);
   virtual ~AlbumCoverExporter() {}
 
-  static const int kMaxConcurrentRequests;
+  // Copying cover files is bound by disk I/O so only a few run at once;
+  // exports that decode and scale images use a thread per core instead.
+  static const int kMaxConcurrentCopies;
 
   void SetDialogResult(const AlbumCoverExport::DialogResult& dialog_result);
   void AddExportRequest(Song song);
@@ -57,6 +60,8 @@ class AlbumCoverExporter : public QObject {
   AlbumCoverExport::DialogResult dialog_result_;
 
   QQueue<CoverExportRunnable*> requests_;
+  // Queued requests by album directory, which all export to the same file.
+  QMap<QString, CoverExportRunnable*> requests_by_dir_;
   QThreadPool* thread_pool_;
 
   int exported_;
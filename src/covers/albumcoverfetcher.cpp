@@ -32,7 +32,7 @@ AlbumCoverFetcher::AlbumCoverFetcher(CoverProviders* cover_providers,
                                      QNetworkAccessManager* network)
     : QObject(parent),
       cover_providers_(cover_providers),
-      network_(network ? network : new NetworkAccessManager(this)),
+      network_(network ? network : NetworkAccessManager::Shared()),
       next_id_(0),
       request_starter_(new QTimer(this)) {
   request_starter_->setInterval(1000);
@@ -115,6 +115,7 @@ void AlbumCoverFetcher::SingleSearchFinished(quint64 request_id,
   if (!search) return;
 
   search->deleteLater();
+  cover_providers_->AddStatistics(search->statistics());
   emit SearchFinished(request_id, results, search->statistics());
 }
 
@@ -124,5 +125,6 @@ void AlbumCoverFetcher::SingleCoverFetched(quint64 request_id,
   if (!search) return;
 
   search->deleteLater();
+  cover_providers_->AddStatistics(search->statistics());
   emit AlbumCoverFetched(request_id, image, search->statistics());
 }
@@ -36,6 +36,7 @@
 #include "core/network.h"
 
 const int AlbumCoverFetcherSearch::kSearchTimeoutMs = 10000;
+const int AlbumCoverFetcherSearch::kMinRaceTimeoutMs = 3000;
 const int AlbumCoverFetcherSearch::kImageLoadTimeoutMs = 2500;
 const int AlbumCoverFetcherSearch::kTargetSize = 500;
 const float AlbumCoverFetcherSearch::kGoodScore = 1.85;
@@ -45,45 +46,112 @@ AlbumCoverFetcherSearch::AlbumCoverFetcherSearch(
     QObject* parent)
     : QObject(parent),
       request_(request),
+      search_timeout_ms_(kSearchTimeoutMs),
       image_load_timeout_(new NetworkTimeouts(kImageLoadTimeoutMs, this)),
       network_(network),
-      cancel_requested_(false) {
-  // we will terminate the search after kSearchTimeoutMs milliseconds if we are
-  // not
-  // able to find all of the results before that point in time
-  QTimer::singleShot(kSearchTimeoutMs, this, SLOT(TerminateSearch()));
-}
+      racing_(request.fetchall && !request.search),
+      finished_(false),
+      cancel_requested_(false) {}
 
 void AlbumCoverFetcherSearch::TerminateSearch() {
   for (int id : pending_requests_.keys()) {
-    pending_requests_.take(id)->CancelSearch(id);
+    CoverProvider* provider = pending_requests_.take(id);
+    provider->CancelSearch(id);
+    ProviderSearchDone(id, provider, false);
   }
 
   AllProvidersFinished();
 }
 
 void AlbumCoverFetcherSearch::Start(CoverProviders* cover_providers) {
+  elapsed_.start();
+
+  // When racing, don't wait much longer for the providers than they usually
+  // take.
+  const CoverSearchStatistics learned = cover_providers->statistics();
+  if (racing_) {
+    quint64 slowest_msec = 0;
+    for (CoverProvider* provider : cover_providers->List()) {
+      if (provider->fetchall()) {
+        slowest_msec =
+            qMax(slowest_msec, learned.AverageSearchMsec(provider->name()));
+      }
+    }
+    if (slowest_msec > 0) {
+      search_timeout_ms_ = qBound(kMinRaceTimeoutMs, int(slowest_msec * 2),
+                                  kSearchTimeoutMs);
+    }
+  }
+
   for (CoverProvider* provider : cover_providers->List()) {
     // Skip provider if it does not have fetchall set, and we are doing fetchall
     // - "Fetch Missing Covers".
     if (!provider->fetchall() && request_.fetchall) {
       continue;
     }
+
+    // Respect the provider's rate limit.  If it's so busy that the search
+    // couldn't start before the timeout, leave it out this time.
+    const int delay = provider->ReserveSearchSlot(search_timeout_ms_ / 2);
+    if (delay < 0) {
+      qLog(Debug) << "Skipping" << provider->name() << "until it's less busy";
+      continue;
+    }
+
     connect(provider, SIGNAL(SearchFinished(int, QList<CoverSearchResult>)),
             SLOT(ProviderSearchFinished(int, QList<CoverSearchResult>)));
     const int id = cover_providers->NextId();
-    const bool success =
-        provider->StartSearch(request_.artist, request_.album, id);
+    pending_requests_[id] = provider;
 
-    if (success) {
-      pending_requests_[id] = provider;
-      statistics_.network_requests_made_++;
+    if (delay == 0) {
+      StartProviderSearch(provider, id);
+    } else {
+      QTimer::singleShot(delay, this, [this, provider, id]() {
+        StartProviderSearch(provider, id);
+      });
     }
   }
 
   // end this search before it even began if there are no providers...
   if (pending_requests_.isEmpty()) {
     TerminateSearch();
+    return;
+  }
+
+  // we will terminate the search after search_timeout_ms_ milliseconds if we
+  // are not able to find all of the results before that point in time
+  QTimer::singleShot(search_timeout_ms_, this, SLOT(TerminateSearch()));
+}
+
+void AlbumCoverFetcherSearch::StartProviderSearch(CoverProvider* provider,
+                                                  int id) {
+  // The search might have been terminated while we were waiting.
+  if (!pending_requests_.contains(id)) return;
+
+  request_start_msec_[id] = elapsed_.elapsed();
+  if (provider->StartSearch(request_.artist, request_.album, id)) {
+    statistics_.network_requests_made_++;
+    return;
+  }
+
+  pending_requests_.remove(id);
+  request_start_msec_.remove(id);
+  if (pending_requests_.isEmpty()) {
+    AllProvidersFinished();
+  }
+}
+
+void AlbumCoverFetcherSearch::ProviderSearchDone(int id,
+                                                 CoverProvider* provider,
+                                                 bool success) {
+  if (!request_start_msec_.contains(id)) return;
+
+  const QString& name = provider->name();
+  statistics_.searches_by_provider_[name]++;
+  statistics_.search_msec_by_provider_[name] +=
+      elapsed_.elapsed() - request_start_msec_.take(id);
+  if (success) {
+    statistics_.successful_searches_by_provider_[name]++;
   }
 }
 
@@ -97,6 +165,7 @@ void AlbumCoverFetcherSearch::ProviderSearchFinished(
   if (!pending_requests_.contains(id)) return;
 
   CoverProvider* provider = pending_requests_.take(id);
+  ProviderSearchDone(id, provider, !results.isEmpty());
 
   CoverSearchResults results_copy(results);
   // Set categories on the results
@@ -108,6 +177,14 @@ void AlbumCoverFetcherSearch::ProviderSearchFinished(
   results_.append(results_copy);
   statistics_.total_images_by_provider_[provider->name()]++;
 
+  if (racing_ && !finished_ && !cancel_requested_) {
+    // Try this provider's first image straight away instead of waiting for
+    // the others.
+    FetchNextImage(provider->name());
+    MaybeFinishRace();
+    return;
+  }
+
   // do we have more providers left?
   if (!pending_requests_.isEmpty()) {
     return;
@@ -117,18 +194,26 @@ void AlbumCoverFetcherSearch::ProviderSearchFinished(
 }
 
 void AlbumCoverFetcherSearch::AllProvidersFinished() {
-  if (cancel_requested_) {
+  if (cancel_requested_ || finished_) {
     return;
   }
 
   // if we only wanted to do the search then we're done
   if (request_.search) {
+    finished_ = true;
     emit SearchFinished(request_.id, results_);
     return;
   }
 
+  if (racing_) {
+    // Every provider's images have been loaded as their results arrived.
+    MaybeFinishRace();
+    return;
+  }
+
   // no results?
   if (results_.isEmpty()) {
+    finished_ = true;
     statistics_.missing_images_++;
     emit AlbumCoverFetched(request_.id, QImage());
     return;
@@ -153,18 +238,7 @@ void AlbumCoverFetcherSearch::FetchMoreImages() {
 
     CoverSearchResult result = results_.takeAt(i--);
     last_provider = result.provider;
-
-    qLog(Debug) << "Loading" << result.image_url << "from" << result.provider;
-
-    RedirectFollower* image_reply =
-        new RedirectFollower(network_->get(QNetworkRequest(result.image_url)));
-    NewClosure(image_reply, SIGNAL(finished()), this,
-               SLOT(ProviderCoverFetchFinished(RedirectFollower*)),
-               image_reply);
-    pending_image_loads_[image_reply] = result.provider;
-    image_load_timeout_->AddReply(image_reply);
-
-    statistics_.network_requests_made_++;
+    LoadImage(result);
   }
 
   if (pending_image_loads_.isEmpty()) {
@@ -173,6 +247,52 @@ void AlbumCoverFetcherSearch::FetchMoreImages() {
   }
 }
 
+bool AlbumCoverFetcherSearch::FetchNextImage(const QString& provider) {
+  for (int i = 0; i < results_.count(); ++i) {
+    if (results_[i].provider == provider) {
+      LoadImage(results_.takeAt(i));
+      return true;
+    }
+  }
+  return false;
+}
+
+void AlbumCoverFetcherSearch::LoadImage(const CoverSearchResult& result) {
+  qLog(Debug) << "Loading" << result.image_url << "from" << result.provider;
+
+  RedirectFollower* image_reply =
+      new RedirectFollower(network_->get(QNetworkRequest(result.image_url)));
+  NewClosure(image_reply, SIGNAL(finished()), this,
+             SLOT(ProviderCoverFetchFinished(RedirectFollower*)),
+             image_reply);
+  pending_image_loads_[image_reply] = result.provider;
+  image_load_timeout_->AddReply(image_reply);
+
+  statistics_.network_requests_made_++;
+}
+
+void AlbumCoverFetcherSearch::MaybeFinishRace() {
+  // Give up once there's nothing left to wait for.
+  if (pending_requests_.isEmpty() && pending_image_loads_.isEmpty()) {
+    SendBestImage();
+  }
+}
+
+void AlbumCoverFetcherSearch::FinishRace() {
+  SendBestImage();
+
+  // Cancel everything that's still running - we don't need it any more.
+  for (int id : pending_requests_.keys()) {
+    CoverProvider* provider = pending_requests_.take(id);
+    provider->CancelSearch(id);
+    request_start_msec_.remove(id);
+  }
+  for (RedirectFollower* reply : pending_image_loads_.keys()) {
+    reply->abort();
+  }
+  pending_image_loads_.clear();
+}
+
 void AlbumCoverFetcherSearch::ProviderCoverFetchFinished(
     RedirectFollower* reply) {
   reply->deleteLater();
@@ -180,10 +300,11 @@ void AlbumCoverFetcherSearch::ProviderCoverFetchFinished(
 
   statistics_.bytes_transferred_ += reply->bytesAvailable();
 
-  if (cancel_requested_) {
+  if (cancel_requested_ || finished_) {
     return;
   }
 
+  float score = 0.0;
   if (reply->error() != QNetworkReply::NoError) {
     qLog(Info) << "Error requesting" << reply->url() << reply->errorString();
   } else {
@@ -191,13 +312,24 @@ void AlbumCoverFetcherSearch::ProviderCoverFetchFinished(
     if (!image.loadFromData(reply->readAll())) {
       qLog(Info) << "Error decoding image data from" << reply->url();
     } else {
-      const float score = ScoreImage(image);
+      score = ScoreImage(image);
       candidate_images_.insertMulti(score, CandidateImage(provider, image));
 
       qLog(Debug) << reply->url() << "scored" << score;
     }
   }
 
+  if (racing_) {
+    if (score >= kGoodScore) {
+      FinishRace();
+    } else {
+      // Not good enough - try this provider's next result.
+      FetchNextImage(provider);
+      MaybeFinishRace();
+    }
+    return;
+  }
+
   if (pending_image_loads_.isEmpty()) {
     // We've fetched everything we wanted to fetch for now, check if we have an
     // image that's good enough.
@@ -234,6 +366,8 @@ float AlbumCoverFetcherSearch::ScoreImage(const QImage& image) const {
 }
 
 void AlbumCoverFetcherSearch::SendBestImage() {
+  finished_ = true;
+
   QImage image;
 
   if (!candidate_images_.isEmpty()) {
@@ -256,7 +390,10 @@ void AlbumCoverFetcherSearch::Cancel() {
 
   if (!pending_requests_.isEmpty()) {
     TerminateSearch();
-  } else if (!pending_image_loads_.isEmpty()) {
+  }
+
+  // When racing there can be image loads pending alongside provider searches.
+  if (!pending_image_loads_.isEmpty()) {
     for (RedirectFollower* reply : pending_image_loads_.keys()) {
       reply->abort();
     }
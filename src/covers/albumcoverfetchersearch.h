@@ -23,6 +23,7 @@
 
 #include "albumcoverfetcher.h"
 
+#include <QElapsedTimer>
 #include <QMap>
 #include <QObject>
 
@@ -36,6 +37,10 @@ class RedirectFollower;
 // AlbumCoverFetcher. The search engages all of the known cover providers.
 // AlbumCoverFetcherSearch signals search results to an interested
 // AlbumCoverFetcher when all of the providers have done their part.
+//
+// Searches that are part of fetching all missing covers race the providers
+// instead: each provider's images are loaded as soon as its results arrive,
+// and the first one that scores well enough wins and cancels the rest.
 class AlbumCoverFetcherSearch : public QObject {
   Q_OBJECT
 
@@ -64,14 +69,21 @@ class AlbumCoverFetcherSearch : public QObject {
   void TerminateSearch();
 
  private:
+  void StartProviderSearch(CoverProvider* provider, int id);
+  void ProviderSearchDone(int id, CoverProvider* provider, bool success);
   void AllProvidersFinished();
 
   void FetchMoreImages();
+  bool FetchNextImage(const QString& provider);
+  void LoadImage(const CoverSearchResult& result);
+  void FinishRace();
+  void MaybeFinishRace();
   float ScoreImage(const QImage& image) const;
   void SendBestImage();
 
  private:
   static const int kSearchTimeoutMs;
+  static const int kMinRaceTimeoutMs;
   static const int kImageLoadTimeoutMs;
   static const int kTargetSize;
   static const float kGoodScore;
@@ -85,6 +97,9 @@ class AlbumCoverFetcherSearch : public QObject {
   CoverSearchResults results_;
 
   QMap<int, CoverProvider*> pending_requests_;
+  QMap<int, qint64> request_start_msec_;
+  QElapsedTimer elapsed_;
+  int search_timeout_ms_;
   QMap<RedirectFollower*, QString> pending_image_loads_;
   NetworkTimeouts* image_load_timeout_;
 
@@ -94,6 +109,8 @@ class AlbumCoverFetcherSearch : public QObject {
 
   QNetworkAccessManager* network_;
 
+  bool racing_;
+  bool finished_;
   bool cancel_requested_;
 };
 
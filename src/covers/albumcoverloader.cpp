@@ -24,27 +24,77 @@
 #include <QPainter>
 #include <QDir>
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QRunnable>
 #include <QUrl>
 #include <QNetworkReply>
 
 #include "config.h"
+#include "embeddedartcache.h"
 #include "core/closure.h"
 #include "core/logging.h"
+#include "core/memoryaccounting.h"
+#include "core/metriccounter.h"
 #include "core/network.h"
-#include "core/tagreaderclient.h"
+#include "core/perftrace.h"
 #include "core/utilities.h"
 #include "internet/core/internetmodel.h"
 #ifdef HAVE_SPOTIFY
 #include "internet/spotify/spotifyservice.h"
 #endif
 
+namespace {
+MetricCounter sThumbnailHits("clementine_cover_thumbnail_hits_total",
+                             "Album covers found in the thumbnail cache.");
+MetricCounter sThumbnailMisses(
+    "clementine_cover_thumbnail_misses_total",
+    "Album covers that had to be loaded and scaled.");
+}  // namespace
+
+class AlbumCoverLoader::LocalTask : public QRunnable {
+ public:
+  LocalTask(AlbumCoverLoader* loader, const Task& task)
+      : loader_(loader), task_(task) {}
+
+  void run() {
+    {
+      QMutexLocker l(&loader_->mutex_);
+      if (!loader_->local_task_ids_.remove(task_.id)) return;  // Cancelled
+    }
+    if (loader_->stop_requested_) return;
+
+    loader_->ProcessTask(&task_);
+  }
+
+ private:
+  AlbumCoverLoader* loader_;
+  Task task_;
+};
+
 AlbumCoverLoader::AlbumCoverLoader(QObject* parent)
     : QObject(parent),
       stop_requested_(false),
       next_id_(1),
       network_(new NetworkAccessManager(this)),
-      connected_spotify_(false) {
+      connected_spotify_(false),
+      thumbnails_(Utilities::GetConfigPath(Utilities::Path_PixmapCache) +
+                  "/thumbnails.pack") {
   setObjectName("Album cover loader");
+
+  MemoryAccounting::Instance()->Register(
+      this, "album_cover_loader", "Album cover loader queues", [this]() {
+        QMutexLocker l(&mutex_);
+        qint64 ret = (tasks_.count() + remote_tasks_.count() +
+                      remote_spotify_tasks_.count()) *
+                     sizeof(Task);
+        for (const Task& task : tasks_) {
+          ret += task.embedded_image.byteCount();
+        }
+        return ret;
+      });
 }
 
 QString AlbumCoverLoader::ImageCacheDir() {
@@ -53,6 +103,7 @@ QString AlbumCoverLoader::ImageCacheDir() {
 
 void AlbumCoverLoader::CancelTask(quint64 id) {
   QMutexLocker l(&mutex_);
+  if (local_task_ids_.remove(id)) return;
   for (QQueue<Task>::iterator it = tasks_.begin(); it != tasks_.end(); ++it) {
     if (it->id == id) {
       tasks_.erase(it);
@@ -63,6 +114,7 @@ void AlbumCoverLoader::CancelTask(quint64 id) {
 
 void AlbumCoverLoader::CancelTasks(const QSet<quint64>& ids) {
   QMutexLocker l(&mutex_);
+  local_task_ids_.subtract(ids);
   for (QQueue<Task>::iterator it = tasks_.begin(); it != tasks_.end();) {
     if (ids.contains(it->id)) {
       it = tasks_.erase(it);
@@ -104,13 +156,48 @@ void AlbumCoverLoader::ProcessTasks() {
       QMutexLocker l(&mutex_);
       if (tasks_.isEmpty()) return;
       task = tasks_.dequeue();
+
+      if (IsLocalTask(task)) {
+        // Task IDs only ever go up, so newer tasks get a higher priority.
+        local_task_ids_.insert(task.id);
+        local_pool_.start(new LocalTask(this, task),
+                          static_cast<int>(task.id & 0x7fffffff));
+        continue;
+      }
     }
 
     ProcessTask(&task);
   }
 }
 
+bool AlbumCoverLoader::IsLocalTask(const Task& task) {
+  for (const QString& filename : {task.art_manual, task.art_automatic}) {
+    const QString lower = filename.toLower();
+    if (lower.startsWith("http://") || lower.startsWith("https://") ||
+        lower.startsWith("spotify://")) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void AlbumCoverLoader::ProcessTask(Task* task) {
+  PerfTrace::Scope trace("AlbumCoverLoader::ProcessTask");
+  if (task->state == State_TryingManual) {
+    task->thumbnail_key = ThumbnailKey(*task);
+    if (!task->thumbnail_key.isEmpty()) {
+      const QImage thumbnail = thumbnails_.Find(task->thumbnail_key);
+      if (thumbnail.isNull()) {
+        sThumbnailMisses.Add();
+      } else {
+        sThumbnailHits.Add();
+        emit ImageLoaded(task->id, thumbnail);
+        emit ImageLoaded(task->id, thumbnail, thumbnail);
+        return;
+      }
+    }
+  }
+
   TryLoadResult result = TryLoadImage(*task);
   if (result.started_async) {
     // The image is being loaded from a remote URL, we'll carry on later
@@ -120,6 +207,9 @@ void AlbumCoverLoader::ProcessTask(Task* task) {
 
   if (result.loaded_success) {
     QImage scaled = ScaleAndPad(task->options, result.image);
+    if (!task->thumbnail_key.isEmpty()) {
+      thumbnails_.Insert(task->thumbnail_key, scaled);
+    }
     emit ImageLoaded(task->id, scaled);
     emit ImageLoaded(task->id, scaled, result.image);
     return;
@@ -141,6 +231,34 @@ void AlbumCoverLoader::NextState(Task* task) {
   }
 }
 
+QByteArray AlbumCoverLoader::ThumbnailKey(const Task& task) {
+  // Only images that are scaled anyway, and whose original the caller doesn't
+  // want, can come from the thumbnail cache.
+  if (!task.options.scaled_decode_ || !task.options.scale_output_image_ ||
+      !task.embedded_image.isNull() || !IsLocalTask(task) ||
+      task.art_manual == Song::kManuallyUnsetCover) {
+    return QByteArray();
+  }
+
+  // The key changes whenever any of the files the image might come from do.
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(QByteArray::number(task.options.desired_height_));
+  hash.addData(task.options.pad_output_image_ ? "p" : "s");
+  for (const QString& filename : {task.art_manual, task.art_automatic}) {
+    hash.addData(filename.toUtf8());
+    hash.addData("", 1);
+
+    const QString source =
+        filename == Song::kEmbeddedCover ? task.song_filename : filename;
+    if (source.isEmpty()) continue;
+
+    const QFileInfo info(source);
+    hash.addData(QByteArray::number(info.size()));
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+  }
+  return hash.result();
+}
+
 AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
     const Task& task) {
   // An image embedded in the song itself takes priority
@@ -162,9 +280,7 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
     return TryLoadResult(false, true, task.options.default_output_image_);
 
   if (filename == Song::kEmbeddedCover && !task.song_filename.isEmpty()) {
-    const QImage taglib_image =
-        TagReaderClient::Instance()->LoadEmbeddedArtBlocking(
-            task.song_filename);
+    const QImage taglib_image = EmbeddedArtCache::Load(task.song_filename);
 
     if (!taglib_image.isNull())
       return TryLoadResult(false, true,
@@ -209,7 +325,7 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
     return TryLoadResult(false, false, task.options.default_output_image_);
   }
 
-  QImage image(filename);
+  QImage image = LoadLocalImage(task.options, filename);
   return TryLoadResult(
       false, !image.isNull(),
       image.isNull() ? task.options.default_output_image_ : image);
@@ -263,24 +379,42 @@ void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply* reply) {
   NextState(&task);
 }
 
+QImage AlbumCoverLoader::LoadLocalImage(const AlbumCoverLoaderOptions& options,
+                                        const QString& filename) {
+  QImageReader reader(filename);
+  if (options.scaled_decode_ && options.scale_output_image_ &&
+      reader.supportsOption(QImageIOHandler::ScaledSize)) {
+    const QSize desired(options.desired_height_, options.desired_height_);
+    QSize size = reader.size();
+    if (size.isValid() && (size.width() > desired.width() ||
+                           size.height() > desired.height())) {
+      size.scale(desired, Qt::KeepAspectRatio);
+      reader.setScaledSize(size);
+    }
+  }
+  return reader.read();
+}
+
 QImage AlbumCoverLoader::ScaleAndPad(const AlbumCoverLoaderOptions& options,
-                                     const QImage& image) {
+                                     const QImage& image,
+                                     Qt::TransformationMode mode) {
   if (image.isNull()) return image;
 
   // Scale the image down
   QImage copy;
   if (options.scale_output_image_) {
     copy = image.scaled(QSize(options.desired_height_, options.desired_height_),
-                        Qt::KeepAspectRatio, Qt::SmoothTransformation);
+                        Qt::KeepAspectRatio, mode);
   } else {
     copy = image;
   }
 
   if (!options.pad_output_image_) return copy;
 
-  // Pad the image to height_ x height_
+  // Pad the image to height_ x height_.  This is the format QPixmap uses for
+  // images with alpha, so turning it into one later doesn't need a conversion.
   QImage padded_image(options.desired_height_, options.desired_height_,
-                      QImage::Format_ARGB32);
+                      QImage::Format_ARGB32_Premultiplied);
   padded_image.fill(0);
 
   QPainter p(&padded_image);
@@ -299,8 +433,7 @@ QPixmap AlbumCoverLoader::TryLoadPixmap(const QString& automatic,
   if (!manual.isEmpty()) ret.load(manual);
   if (ret.isNull()) {
     if (automatic == Song::kEmbeddedCover && !filename.isNull())
-      ret = QPixmap::fromImage(
-          TagReaderClient::Instance()->LoadEmbeddedArtBlocking(filename));
+      ret = QPixmap::fromImage(EmbeddedArtCache::Load(filename));
     else if (!automatic.isEmpty())
       ret.load(automatic);
   }
@@ -312,3 +445,19 @@ quint64 AlbumCoverLoader::LoadImageAsync(const AlbumCoverLoaderOptions& options,
   return LoadImageAsync(options, song.art_automatic(), song.art_manual(),
                         song.url().toLocalFile(), song.image());
 }
+
+QString AlbumCoverLoader::PixmapCacheKey(
+    const AlbumCoverLoaderOptions& options, const Song& song) {
+  if (song.art_automatic().isEmpty() && song.art_manual().isEmpty()) {
+    return QString();
+  }
+
+  // Embedded covers are different in every file.
+  const QString automatic = song.art_automatic() == Song::kEmbeddedCover
+                                ? song.url().toString()
+                                : song.art_automatic();
+  return QString("albumcover:%1:%2:%3|%4")
+      .arg(options.desired_height_)
+      .arg(options.pad_output_image_ ? "pad" : "")
+      .arg(song.art_manual(), automatic);
+}
@@ -23,12 +23,15 @@
 
 #include "albumcoverloaderoptions.h"
 #include "config.h"
+#include "thumbnailcache.h"
 #include "core/song.h"
 
 #include <QImage>
 #include <QMutex>
 #include <QObject>
 #include <QQueue>
+#include <QSet>
+#include <QThreadPool>
 #include <QUrl>
 
 class NetworkAccessManager;
@@ -55,10 +58,17 @@ class AlbumCoverLoader : public QObject {
   void CancelTask(quint64 id);
   void CancelTasks(const QSet<quint64>& ids);
 
+  // Returns a QPixmapCache key for song's cover loaded with options, so views
+  // that show the same covers at the same size can share them.  Empty if the
+  // song has no cover.
+  static QString PixmapCacheKey(const AlbumCoverLoaderOptions& options,
+                                const Song& song);
+
   static QPixmap TryLoadPixmap(const QString& automatic, const QString& manual,
                                const QString& filename = QString());
-  static QImage ScaleAndPad(const AlbumCoverLoaderOptions& options,
-                            const QImage& image);
+  static QImage ScaleAndPad(
+      const AlbumCoverLoaderOptions& options, const QImage& image,
+      Qt::TransformationMode mode = Qt::SmoothTransformation);
 
  signals:
   void ImageLoaded(quint64 id, const QImage& image);
@@ -86,8 +96,14 @@ class AlbumCoverLoader : public QObject {
     QImage embedded_image;
     State state;
     int redirects;
+
+    // Empty if the result can't be kept in thumbnails_.
+    QByteArray thumbnail_key;
   };
 
+  // Runs a task that only needs local files on local_pool_.
+  class LocalTask;
+
   struct TryLoadResult {
     TryLoadResult(bool async, bool success, const QImage& i)
         : started_async(async), loaded_success(success), image(i) {}
@@ -100,6 +116,10 @@ class AlbumCoverLoader : public QObject {
   void ProcessTask(Task* task);
   void NextState(Task* task);
   TryLoadResult TryLoadImage(const Task& task);
+  static bool IsLocalTask(const Task& task);
+  static QByteArray ThumbnailKey(const Task& task);
+  static QImage LoadLocalImage(const AlbumCoverLoaderOptions& options,
+                               const QString& filename);
 
   bool stop_requested_;
 
@@ -113,6 +133,17 @@ class AlbumCoverLoader : public QObject {
 
   bool connected_spotify_;
 
+  // Local files and embedded art are decoded and scaled on several threads at
+  // once.  The newest tasks are started first, since they're usually for the
+  // items that are on screen now.  local_task_ids_ holds the tasks that have
+  // been handed to the pool but haven't started, so they can be cancelled.
+  QSet<quint64> local_task_ids_;
+  QThreadPool local_pool_;
+
+  // Scaled images loaded from local files, so they don't have to be decoded
+  // again next time.
+  ThumbnailCache thumbnails_;
+
   static const int kMaxRedirects = 3;
 };
 
@@ -26,11 +26,18 @@ struct AlbumCoverLoaderOptions {
   AlbumCoverLoaderOptions()
       : desired_height_(120),
         scale_output_image_(true),
-        pad_output_image_(true) {}
+        pad_output_image_(true),
+        scaled_decode_(false) {}
 
   int desired_height_;
   bool scale_output_image_;
   bool pad_output_image_;
+
+  // Decode image files straight to the output size where the format supports
+  // it (JPEG does, and it's much faster), and keep the result in the thumbnail
+  // cache.  The original image passed to ImageLoaded is then no bigger than the
+  // scaled one.
+  bool scaled_decode_;
   QImage default_output_image_;
 };
 
@@ -19,30 +19,53 @@
 
 #include "coverexportrunnable.h"
 
+#include <QBuffer>
 #include <QFile>
+#include <QImageReader>
 #include <QUrl>
 
 #include "albumcoverexporter.h"
+#include "embeddedartcache.h"
 #include "core/song.h"
-#include "core/tagreaderclient.h"
+
+namespace {
+
+// Reads just the image header where the format allows it, and only decodes
+// the whole image when it doesn't.
+QSize ReadImageSize(QIODevice* device) {
+  QImageReader reader(device);
+  QSize size = reader.size();
+  if (!size.isValid()) size = reader.read().size();
+  return size;
+}
+
+}  // namespace
 
 CoverExportRunnable::CoverExportRunnable(
     const AlbumCoverExport::DialogResult& dialog_result, const Song& song)
-    : dialog_result_(dialog_result), song_(song) {}
+    : dialog_result_(dialog_result), songs_(SongList() << song) {}
 
-void CoverExportRunnable::run() {
-  QString cover_path = GetCoverPath();
+void CoverExportRunnable::AddSong(const Song& song) { songs_ << song; }
 
-  // manually unset?
-  if (cover_path.isEmpty()) {
-    EmitCoverSkipped();
-  } else {
-    if (dialog_result_.RequiresCoverProcessing()) {
-      ProcessAndExportCover();
-    } else {
-      ExportCover();
+void CoverExportRunnable::run() {
+  // All the songs are albums in the same directory, which only gets one
+  // cover file, so stop at the first one that exports successfully.
+  for (const Song& song : songs_) {
+    song_ = song;
+
+    // manually unset?
+    if (GetCoverPath().isEmpty()) continue;
+
+    const bool exported = dialog_result_.RequiresCoverProcessing()
+                              ? ProcessAndExportCover()
+                              : ExportCover();
+    if (exported) {
+      EmitCoverExported();
+      return;
     }
   }
+
+  EmitCoverSkipped();
 }
 
 QString CoverExportRunnable::GetCoverPath() {
@@ -62,135 +85,132 @@ QString CoverExportRunnable::GetCoverPath() {
   }
 }
 
-// Exports a single album cover using a "save QImage to file" approach.
-// For performance reasons this method will be invoked only if loading
-// and in memory processing of images is necessary for current settings
-// which means that:
-// - either the force size flag is being used
-// - or the "overwrite smaller" mode is used
-// In all other cases, the faster ExportCover() method will be used.
-void CoverExportRunnable::ProcessAndExportCover() {
-  QString cover_path = GetCoverPath();
+QString CoverExportRunnable::GetNewFileName(const QString& cover_path) const {
+  QString dir = song_.url().toLocalFile().section('/', 0, -2);
+  QString extension = cover_path.section('.', -1);
 
-  // either embedded or disk - the one we'll export for the current album
-  QImage cover;
+  return dir + '/' + dialog_result_.fileName_ + '.' +
+         (cover_path == Song::kEmbeddedCover ? "jpg" : extension);
+}
 
-  QImage embedded_cover;
-  QImage disk_cover;
+QByteArray CoverExportRunnable::LoadEmbeddedCover() const {
+  return EmbeddedArtCache::LoadData(song_.url().toLocalFile());
+}
 
-  // load embedded cover if any
-  if (song_.has_embedded_cover()) {
-    embedded_cover = TagReaderClient::Instance()->LoadEmbeddedArtBlocking(
-        song_.url().toLocalFile());
+// Writes the cover to new_file without decoding it if possible.  Cover files
+// are copied, and so are embedded pictures that are already JPEGs - the
+// exported file always gets a ".jpg" extension, so anything else embedded
+// has to be converted.
+bool CoverExportRunnable::WriteCover(const QString& cover_path,
+                                     const QByteArray& embedded_data,
+                                     const QString& new_file) {
+  if (cover_path != Song::kEmbeddedCover) {
+    return QFile::copy(cover_path, new_file);
+  }
 
-    if (embedded_cover.isNull()) {
-      EmitCoverSkipped();
-      return;
-    }
-    cover = embedded_cover;
+  if (embedded_data.startsWith("\xFF\xD8\xFF")) {
+    QFile file(new_file);
+    return file.open(QIODevice::WriteOnly) &&
+           file.write(embedded_data) == embedded_data.size();
   }
 
-  // load a file cover which iss mandatory if there's no embedded cover
-  disk_cover.load(cover_path);
+  QImage image;
+  return image.loadFromData(embedded_data) && image.save(new_file);
+}
 
-  if (embedded_cover.isNull()) {
-    if (disk_cover.isNull()) {
-      EmitCoverSkipped();
-      return;
-    }
-    cover = disk_cover;
-  }
+// Exports a single album cover when the dialog's settings need to know
+// the size of the image, which means that:
+// - either the force size flag is being used
+// - or the "overwrite smaller" mode is used
+// Only the first case needs the image decoded and saved again, otherwise
+// the cover is written the same way as ExportCover() does.
+bool CoverExportRunnable::ProcessAndExportCover() {
+  const QString cover_path = GetCoverPath();
+  const QString new_file = GetNewFileName(cover_path);
 
-  // rescale if necessary
-  if (dialog_result_.IsSizeForced()) {
-    cover = cover.scaled(QSize(dialog_result_.width_, dialog_result_.height_),
-                         Qt::IgnoreAspectRatio);
+  // If the file exists, do not override!
+  if (dialog_result_.overwrite_ == AlbumCoverExport::OverwriteMode_None &&
+      QFile::exists(new_file)) {
+    return false;
   }
 
-  QString dir = song_.url().toLocalFile().section('/', 0, -2);
-  QString extension = cover_path.section('.', -1);
+  QByteArray embedded_data;
+  QSize cover_size;
+  if (cover_path == Song::kEmbeddedCover) {
+    embedded_data = LoadEmbeddedCover();
+    QBuffer buffer(&embedded_data);
+    cover_size = ReadImageSize(&buffer);
+  } else {
+    QFile file(cover_path);
+    cover_size = ReadImageSize(&file);
+  }
 
-  QString new_file = dir + '/' + dialog_result_.fileName_ + '.' +
-                     (cover_path == Song::kEmbeddedCover ? "jpg" : extension);
+  if (!cover_size.isValid()) return false;
 
-  // If the file exists, do not override!
-  if (dialog_result_.overwrite_ == AlbumCoverExport::OverwriteMode_None && QFile::exists(new_file)) {
-    EmitCoverSkipped();
-    return;
+  if (dialog_result_.IsSizeForced()) {
+    cover_size = QSize(dialog_result_.width_, dialog_result_.height_);
   }
 
   // we're handling overwrite as remove + copy so we need to delete the old file
   // first
-  if (QFile::exists(new_file) && dialog_result_.overwrite_ != AlbumCoverExport::OverwriteMode_None) {
+  if (QFile::exists(new_file)) {
     // if the mode is "overwrite smaller" then skip the cover if a bigger one
     // is already available in the folder
     if (dialog_result_.overwrite_ == AlbumCoverExport::OverwriteMode_Smaller) {
-      QImage existing;
-      existing.load(new_file);
+      QFile existing_file(new_file);
+      const QSize existing = ReadImageSize(&existing_file);
 
-      if (existing.isNull() || existing.size().height() >= cover.size().height() ||
-          existing.size().width() >= cover.size().width()) {
-        EmitCoverSkipped();
-        return;
+      if (!existing.isValid() || existing.height() >= cover_size.height() ||
+          existing.width() >= cover_size.width()) {
+        return false;
       }
     }
 
-    if (!QFile::remove(new_file)) {
-      EmitCoverSkipped();
-      return;
-    }
+    if (!QFile::remove(new_file)) return false;
   }
 
-  if (cover.save(new_file)) {
-    EmitCoverExported();
+  if (!dialog_result_.IsSizeForced()) {
+    return WriteCover(cover_path, embedded_data, new_file);
+  }
+
+  QImage cover;
+  if (cover_path == Song::kEmbeddedCover) {
+    cover.loadFromData(embedded_data);
   } else {
-    EmitCoverSkipped();
+    cover.load(cover_path);
   }
+  if (cover.isNull()) return false;
+
+  cover = cover.scaled(cover_size, Qt::IgnoreAspectRatio);
+  return cover.save(new_file);
 }
 
 // Exports a single album cover using a "copy file" approach.
-void CoverExportRunnable::ExportCover() {
-  QString cover_path = GetCoverPath();
-
-  QString dir = song_.url().toLocalFile().section('/', 0, -2);
-  QString extension = cover_path.section('.', -1);
-
-  QString new_file = dir + '/' + dialog_result_.fileName_ + '.' +
-                     (cover_path == Song::kEmbeddedCover ? "jpg" : extension);
+bool CoverExportRunnable::ExportCover() {
+  const QString cover_path = GetCoverPath();
+  const QString new_file = GetNewFileName(cover_path);
 
   // If the file exists, do not override!
   if (dialog_result_.overwrite_ == AlbumCoverExport::OverwriteMode_None &&
       QFile::exists(new_file)) {
-    EmitCoverSkipped();
-    return;
+    return false;
+  }
+
+  // Read the embedded cover before touching the existing file so a song
+  // without one doesn't leave the directory with no cover at all.
+  QByteArray embedded_data;
+  if (cover_path == Song::kEmbeddedCover) {
+    embedded_data = LoadEmbeddedCover();
+    if (embedded_data.isEmpty()) return false;
   }
 
   // we're handling overwrite as remove + copy so we need to delete the old file
   // first
-  if (dialog_result_.overwrite_ != AlbumCoverExport::OverwriteMode_None &&
-      QFile::exists(new_file)) {
-    if (!QFile::remove(new_file)) {
-      EmitCoverSkipped();
-      return;
-    }
+  if (QFile::exists(new_file) && !QFile::remove(new_file)) {
+    return false;
   }
 
-  if (cover_path == Song::kEmbeddedCover) {
-    // an embedded cover
-    QImage embedded = TagReaderClient::Instance()->LoadEmbeddedArtBlocking(
-        song_.url().toLocalFile());
-    if (!embedded.save(new_file)) {
-      EmitCoverSkipped();
-      return;
-    }
-  } else {
-    // automatic or manual cover, available in an image file
-    if (!QFile::copy(cover_path, new_file)) {
-      EmitCoverSkipped();
-      return;
-    }
-  }
-  EmitCoverExported();
+  return WriteCover(cover_path, embedded_data, new_file);
 }
 
 void CoverExportRunnable::EmitCoverExported() { emit CoverExported(); }
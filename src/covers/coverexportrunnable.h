@@ -36,6 +36,10 @@ class CoverExportRunnable : public QObject, public QRunnable {
                       const Song& song);
   virtual ~CoverExportRunnable() {}
 
+  // Adds another album in the same directory.  It's only exported if the
+  // ones before it have no cover to export.
+  void AddSong(const Song& song);
+
   void run();
 
  signals:
@@ -46,11 +50,16 @@ class CoverExportRunnable : public QObject, public QRunnable {
   void EmitCoverExported();
   void EmitCoverSkipped();
 
-  void ProcessAndExportCover();
-  void ExportCover();
+  bool ProcessAndExportCover();
+  bool ExportCover();
   QString GetCoverPath();
+  QString GetNewFileName(const QString& cover_path) const;
+  QByteArray LoadEmbeddedCover() const;
+  bool WriteCover(const QString& cover_path, const QByteArray& embedded_data,
+                  const QString& new_file);
 
   AlbumCoverExport::DialogResult dialog_result_;
+  SongList songs_;
   Song song_;
   AlbumCoverExporter* album_cover_exporter_;
 };
@@ -19,6 +19,23 @@
 
 #include "coverprovider.h"
 
+#include <QDateTime>
+
 CoverProvider::CoverProvider(const QString& name, const bool& fetchall,
                              QObject* parent)
-    : QObject(parent), name_(name), fetchall_(fetchall) {}
+    : QObject(parent),
+      name_(name),
+      fetchall_(fetchall),
+      min_search_interval_msec_(0),
+      next_search_msec_(0) {}
+
+int CoverProvider::ReserveSearchSlot(int max_delay_msec) {
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+  const qint64 start = qMax(now, next_search_msec_);
+  if (start - now > max_delay_msec) {
+    return -1;
+  }
+
+  next_search_msec_ = start + min_search_interval_msec_;
+  return start - now;
+}
@@ -50,12 +50,26 @@ class CoverProvider : public QObject {
 
   virtual void CancelSearch(int id) {}
 
+  // Books the next time this provider's API rate limit allows a search to
+  // start.  Returns how many milliseconds to wait before calling StartSearch,
+  // or -1 without booking anything if that would be more than max_delay_msec.
+  int ReserveSearchSlot(int max_delay_msec);
+
  signals:
   void SearchFinished(int id, const QList<CoverSearchResult>& results);
 
+ protected:
+  // Providers with rate limited APIs set the minimum time between searches.
+  void set_min_search_interval_msec(int msec) {
+    min_search_interval_msec_ = msec;
+  }
+
  private:
   QString name_;
   bool fetchall_;
+
+  int min_search_interval_msec_;
+  qint64 next_search_msec_;
 };
 
 #endif  // COVERS_COVERPROVIDER_H_
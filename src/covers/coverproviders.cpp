@@ -61,3 +61,13 @@ void CoverProviders::ProviderDestroyed() {
 }
 
 int CoverProviders::NextId() { return next_id_.fetchAndAddRelaxed(1); }
+
+void CoverProviders::AddStatistics(const CoverSearchStatistics& statistics) {
+  QMutexLocker locker(&mutex_);
+  statistics_ += statistics;
+}
+
+CoverSearchStatistics CoverProviders::statistics() const {
+  QMutexLocker locker(&mutex_);
+  return statistics_;
+}
@@ -25,6 +25,8 @@
 #include <QMutex>
 #include <QObject>
 
+#include "coversearchstatistics.h"
+
 class AlbumCoverFetcherSearch;
 class CoverProvider;
 
@@ -49,6 +51,11 @@ class CoverProviders : public QObject {
 
   int NextId();
 
+  // Statistics from every search made with these providers, which searches
+  // use to judge how long each provider is worth waiting for.
+  void AddStatistics(const CoverSearchStatistics& statistics);
+  CoverSearchStatistics statistics() const;
+
  private slots:
   void ProviderDestroyed();
 
@@ -56,7 +63,9 @@ class CoverProviders : public QObject {
   Q_DISABLE_COPY(CoverProviders)
 
   QMap<CoverProvider*, QString> cover_providers_;
-  QMutex mutex_;
+  mutable QMutex mutex_;
+
+  CoverSearchStatistics statistics_;
 
   QAtomicInt next_id_;
 };
@@ -45,6 +45,17 @@ CoverSearchStatistics& CoverSearchStatistics::operator+=(
   chosen_width_ += other.chosen_width_;
   chosen_height_ += other.chosen_height_;
 
+  for (const QString& key : other.searches_by_provider_.keys()) {
+    searches_by_provider_[key] += other.searches_by_provider_[key];
+  }
+  for (const QString& key : other.successful_searches_by_provider_.keys()) {
+    successful_searches_by_provider_[key] +=
+        other.successful_searches_by_provider_[key];
+  }
+  for (const QString& key : other.search_msec_by_provider_.keys()) {
+    search_msec_by_provider_[key] += other.search_msec_by_provider_[key];
+  }
+
   return *this;
 }
 
@@ -56,3 +67,24 @@ QString CoverSearchStatistics::AverageDimensions() const {
   return QString::number(chosen_width_ / chosen_images_) + "x" +
          QString::number(chosen_height_ / chosen_images_);
 }
+
+quint64 CoverSearchStatistics::AverageSearchMsec(
+    const QString& provider) const {
+  const quint64 searches = searches_by_provider_.value(provider);
+  if (searches == 0) {
+    return 0;
+  }
+
+  return search_msec_by_provider_.value(provider) / searches;
+}
+
+float CoverSearchStatistics::SuccessRate(const QString& provider) const {
+  const quint64 searches = searches_by_provider_.value(provider);
+  if (searches == 0) {
+    return 0.0;
+  }
+
+  return static_cast<float>(
+             successful_searches_by_provider_.value(provider)) /
+         searches;
+}
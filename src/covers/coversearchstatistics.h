@@ -39,7 +39,18 @@ struct CoverSearchStatistics {
   quint64 chosen_width_;
   quint64 chosen_height_;
 
+  // How many searches each provider was asked to do, how many of those came
+  // back with at least one result, and how long they took in total.  Searches
+  // that timed out count as unsuccessful and as taking the whole timeout.
+  QMap<QString, quint64> searches_by_provider_;
+  QMap<QString, quint64> successful_searches_by_provider_;
+  QMap<QString, quint64> search_msec_by_provider_;
+
   QString AverageDimensions() const;
+
+  // Returns 0 for providers that haven't done any searches yet.
+  quint64 AverageSearchMsec(const QString& provider) const;
+  float SuccessRate(const QString& provider) const;
 };
 
 #endif  // COVERS_COVERSEARCHSTATISTICS_H_
@@ -66,6 +66,20 @@ void CoverSearchStatisticsDialog::Show(
     AddSpacer();
   }
 
+  for (const QString& provider : providers) {
+    if (!statistics.searches_by_provider_.contains(provider)) continue;
+
+    AddLine(tr("Average search time for %1").arg(provider),
+            tr("%1 ms").arg(statistics.AverageSearchMsec(provider)));
+    AddLine(tr("Searches answered by %1").arg(provider),
+            QString("%1%").arg(
+                qRound(statistics.SuccessRate(provider) * 100)));
+  }
+
+  if (!statistics.searches_by_provider_.isEmpty()) {
+    AddSpacer();
+  }
+
   AddLine(tr("Total network requests made"),
           QString::number(statistics.network_requests_made_));
   AddLine(tr("Average image size"), statistics.AverageDimensions());
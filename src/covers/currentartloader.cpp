@@ -19,7 +19,9 @@
 
 #include "currentartloader.h"
 
+#include <QCryptographicHash>
 #include <QDir>
+#include <QFileInfo>
 #include <QTemporaryFile>
 #include <QUrl>
 
@@ -28,11 +30,15 @@
 #include "playlist/playlistmanager.h"
 #include "ui/iconloader.h"
 
+const int CurrentArtLoader::kMaxEncodedArt = 3;
+
 CurrentArtLoader::CurrentArtLoader(Application* app, QObject* parent)
     : QObject(parent),
       app_(app),
       temp_file_pattern_(QDir::tempPath() + "/clementine-art-XXXXXX.jpg"),
-      id_(0) {
+      id_(0),
+      prefetch_id_(0),
+      prefetched_(false) {
   options_.scale_output_image_ = false;
   options_.pad_output_image_ = false;
   QIcon nocover = IconLoader::Load("nocover", IconLoader::Other);
@@ -48,35 +54,148 @@ CurrentArtLoader::CurrentArtLoader(Application* app, QObject* parent)
 
 CurrentArtLoader::~CurrentArtLoader() {}
 
+bool CurrentArtLoader::HasSameArt(const Song& a, const Song& b) {
+  return a.url() == b.url() && a.art_automatic() == b.art_automatic() &&
+         a.art_manual() == b.art_manual();
+}
+
 void CurrentArtLoader::LoadArt(const Song& song) {
   last_song_ = song;
+
+  if (HasSameArt(song, prefetch_song_)) {
+    if (prefetched_) {
+      prefetched_ = false;
+      id_ = 0;
+      ArtReady(prefetched_image_, prefetched_thumbnail_);
+      return;
+    }
+    if (prefetch_id_) {
+      // Still loading - wait for that instead of starting again.
+      id_ = prefetch_id_;
+      prefetch_id_ = 0;
+      return;
+    }
+  }
+
   id_ = app_->album_cover_loader()->LoadImageAsync(options_, last_song_);
 }
 
+void CurrentArtLoader::Prefetch(const Song& song) {
+  if (HasSameArt(song, prefetch_song_) && (prefetched_ || prefetch_id_)) {
+    return;
+  }
+
+  prefetch_song_ = song;
+  prefetched_ = false;
+  prefetched_image_ = QImage();
+  prefetched_thumbnail_ = QImage();
+  prefetch_id_ = app_->album_cover_loader()->LoadImageAsync(options_, song);
+}
+
 void CurrentArtLoader::TempArtLoaded(quint64 id, const QImage& image) {
+  if (id && id == prefetch_id_) {
+    prefetch_id_ = 0;
+    prefetched_ = true;
+    prefetched_image_ = image;
+    if (image != options_.default_output_image_) {
+      prefetched_thumbnail_ =
+          image.scaledToHeight(120, Qt::SmoothTransformation);
+    }
+    return;
+  }
+
   if (id != id_) return;
   id_ = 0;
 
+  ArtReady(image, QImage());
+}
+
+QString CurrentArtLoader::LocalArtFile(const Song& song) {
+  // Follow the order AlbumCoverLoader tries things in.
+  if (!song.image().isNull()) return QString();
+
+  for (const QString& filename : {song.art_manual(), song.art_automatic()}) {
+    if (filename.isEmpty()) continue;
+    if (filename == Song::kManuallyUnsetCover ||
+        filename == Song::kEmbeddedCover || !QFileInfo(filename).isAbsolute()) {
+      return QString();
+    }
+    if (QFileInfo(filename).isFile()) return filename;
+  }
+  return QString();
+}
+
+QString CurrentArtLoader::EncodedArtKey(const Song& song,
+                                        const QImage& image) {
+  // Tracks on the same album usually share a cover file, but each has its
+  // own embedded picture, so those are told apart by their pixels.
+  if (!song.image().isNull() ||
+      song.art_automatic() == Song::kEmbeddedCover ||
+      song.art_manual() == Song::kEmbeddedCover) {
+    return QCryptographicHash::hash(
+               QByteArray::fromRawData(
+                   reinterpret_cast<const char*>(image.constBits()),
+                   image.byteCount()),
+               QCryptographicHash::Md5)
+        .toHex();
+  }
+  return song.art_manual() + "\n" + song.art_automatic();
+}
+
+std::shared_ptr<QTemporaryFile> CurrentArtLoader::Encode(const QImage& image) {
+  std::shared_ptr<QTemporaryFile> file(
+      new QTemporaryFile(temp_file_pattern_));
+  file->setAutoRemove(true);
+  file->open();
+  image.save(file->fileName(), "JPEG");
+  return file;
+}
+
+void CurrentArtLoader::ArtReady(const QImage& image, QImage thumbnail) {
   QString uri;
   QString thumbnail_uri;
-  QImage thumbnail;
 
   if (image != options_.default_output_image_) {
-    temp_art_.reset(new QTemporaryFile(temp_file_pattern_));
-    temp_art_->setAutoRemove(true);
-    temp_art_->open();
-    image.save(temp_art_->fileName(), "JPEG");
-
-    // Scale the image down to make a thumbnail.  It's a bit crap doing it here
-    // since it's the GUI thread, but the alternative is hard.
-    temp_art_thumbnail_.reset(new QTemporaryFile(temp_file_pattern_));
-    temp_art_thumbnail_->open();
-    temp_art_thumbnail_->setAutoRemove(true);
-    thumbnail = image.scaledToHeight(120, Qt::SmoothTransformation);
-    thumbnail.save(temp_art_thumbnail_->fileName(), "JPEG");
-
-    uri = "file://" + temp_art_->fileName();
-    thumbnail_uri = "file://" + temp_art_thumbnail_->fileName();
+    if (thumbnail.isNull()) {
+      thumbnail = image.scaledToHeight(120, Qt::SmoothTransformation);
+    }
+
+    const QString local_file = LocalArtFile(last_song_);
+    if (!local_file.isEmpty()) {
+      // Nothing needs encoding if the cover is a file already.
+      uri = QUrl::fromLocalFile(local_file).toString();
+      thumbnail_uri = uri;
+    } else {
+      const QString key = EncodedArtKey(last_song_, image);
+      EncodedArt encoded;
+      for (int i = 0; i < encoded_art_.count(); ++i) {
+        if (encoded_art_[i].key_ == key) {
+          encoded = encoded_art_.takeAt(i);
+          break;
+        }
+      }
+
+      if (!encoded.art_) {
+        // It's a bit crap doing this here since it's the GUI thread, but the
+        // alternative is hard.
+        encoded.key_ = key;
+        encoded.art_ = Encode(image);
+      }
+      // Only the OSD wants the thumbnail's file.
+      if (!encoded.thumbnail_ &&
+          receivers(SIGNAL(ThumbnailLoaded(Song, QString, QImage))) > 0) {
+        encoded.thumbnail_ = Encode(thumbnail);
+      }
+
+      encoded_art_.prepend(encoded);
+      while (encoded_art_.count() > kMaxEncodedArt) encoded_art_.removeLast();
+
+      uri = QUrl::fromLocalFile(encoded.art_->fileName()).toString();
+      if (encoded.thumbnail_) {
+        thumbnail_uri =
+            QUrl::fromLocalFile(encoded.thumbnail_->fileName()).toString();
+      }
+    }
   }
 
   emit ArtLoaded(last_song_, uri, image);
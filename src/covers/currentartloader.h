@@ -22,6 +22,8 @@
 
 #include <memory>
 
+#include <QImage>
+#include <QList>
 #include <QObject>
 
 #include "core/song.h"
@@ -29,7 +31,6 @@
 
 class Application;
 
-class QImage;
 class QTemporaryFile;
 
 class CurrentArtLoader : public QObject {
@@ -39,11 +40,18 @@ class CurrentArtLoader : public QObject {
   explicit CurrentArtLoader(Application* app, QObject* parent = nullptr);
   ~CurrentArtLoader();
 
+  // How many albums' encoded covers are kept, so playing the next track from
+  // the same album doesn't encode them again.
+  static const int kMaxEncodedArt;
+
   const AlbumCoverLoaderOptions& options() const { return options_; }
   const Song& last_song() const { return last_song_; }
 
  public slots:
   void LoadArt(const Song& song);
+  // Loads the art for a song that's about to be played, so LoadArt() can use
+  // it straight away.
+  void Prefetch(const Song& song);
 
  signals:
   void ArtLoaded(const Song& song, const QString& uri, const QImage& image);
@@ -54,16 +62,38 @@ class CurrentArtLoader : public QObject {
   void TempArtLoaded(quint64 id, const QImage& image);
 
  private:
+  // Temporary files holding a cover that wasn't already a file on disk.
+  struct EncodedArt {
+    QString key_;
+    std::shared_ptr<QTemporaryFile> art_;
+    std::shared_ptr<QTemporaryFile> thumbnail_;
+  };
+
+  static bool HasSameArt(const Song& a, const Song& b);
+  // Returns the cover file the loader will have read song's art from, or an
+  // empty string if the art didn't come straight from a file.
+  static QString LocalArtFile(const Song& song);
+  static QString EncodedArtKey(const Song& song, const QImage& image);
+  // A null thumbnail is made from image.
+  void ArtReady(const QImage& image, QImage thumbnail);
+  std::shared_ptr<QTemporaryFile> Encode(const QImage& image);
+
   Application* app_;
   AlbumCoverLoaderOptions options_;
 
   QString temp_file_pattern_;
 
-  std::unique_ptr<QTemporaryFile> temp_art_;
-  std::unique_ptr<QTemporaryFile> temp_art_thumbnail_;
+  // Most recently used first.
+  QList<EncodedArt> encoded_art_;
   quint64 id_;
 
   Song last_song_;
+
+  quint64 prefetch_id_;
+  Song prefetch_song_;
+  bool prefetched_;
+  QImage prefetched_image_;
+  QImage prefetched_thumbnail_;
 };
 
 #endif  // COVERS_CURRENTARTLOADER_H_
@@ -47,7 +47,11 @@ const char* DiscogsCoverProvider::kSecretKeyB64 =
 
 DiscogsCoverProvider::DiscogsCoverProvider(QObject* parent)
     : CoverProvider("Discogs", false, parent),
-      network_(new NetworkAccessManager(this)) {}
+      network_(NetworkAccessManager::Shared()) {
+  // Discogs allows 60 authenticated requests a minute, and each search makes
+  // at least two.
+  set_min_search_interval_msec(2000);
+}
 
 bool DiscogsCoverProvider::StartSearch(const QString& artist,
                                        const QString& album, int s_id) {
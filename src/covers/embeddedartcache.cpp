@@ -0,0 +1,109 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "embeddedartcache.h"
+
+#include <utime.h>
+
+#include <QAtomicInt>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+
+#include "core/logging.h"
+#include "core/tagreaderclient.h"
+#include "core/taskexecutor.h"
+#include "core/utilities.h"
+
+namespace {
+QAtomicInt sInsertsSincePrune;
+}  // namespace
+
+const qint64 EmbeddedArtCache::kMaxCacheBytes = 256 * 1024 * 1024;
+const int EmbeddedArtCache::kPruneInterval = 100;
+
+QString EmbeddedArtCache::CachePath(const QString& filename) {
+  const QFileInfo info(filename);
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(filename.toUtf8());
+  hash.addData("", 1);
+  hash.addData(QByteArray::number(info.size()));
+  hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+
+  return Utilities::GetConfigPath(Utilities::Path_EmbeddedArtCache) + "/" +
+         hash.result().toHex();
+}
+
+QByteArray EmbeddedArtCache::LoadData(const QString& filename) {
+  const QString path = CachePath(filename);
+
+  QFile cached(path);
+  if (cached.open(QIODevice::ReadOnly)) {
+    // The modification time is when it was last used, so Prune() keeps the
+    // most recently used pictures.
+    utime(QFile::encodeName(path).constData(), nullptr);
+    return cached.readAll();
+  }
+
+  const QByteArray data =
+      TagReaderClient::Instance()->LoadEmbeddedArtDataBlocking(filename);
+  // Nothing is kept for files without a picture, since the tag reader might
+  // just have failed.
+  if (data.isEmpty()) return data;
+
+  // Another thread might be writing the same picture.
+  QDir().mkpath(Utilities::GetConfigPath(Utilities::Path_EmbeddedArtCache));
+  QFile part(path + QString(".%1.part")
+                        .arg(quintptr(QThread::currentThreadId())));
+  if (!part.open(QIODevice::WriteOnly) || part.write(data) != data.size()) {
+    qLog(Warning) << "Couldn't cache embedded art in" << part.fileName();
+    part.remove();
+    return data;
+  }
+  part.close();
+  if (!part.rename(path)) part.remove();
+
+  if (sInsertsSincePrune.fetchAndAddRelaxed(1) + 1 >= kPruneInterval) {
+    sInsertsSincePrune.store(0);
+    TaskExecutor::Instance()->Run<void>(TaskExecutor::Lane_Background,
+                                        &EmbeddedArtCache::Prune);
+  }
+
+  return data;
+}
+
+QImage EmbeddedArtCache::Load(const QString& filename) {
+  return QImage::fromData(LoadData(filename));
+}
+
+void EmbeddedArtCache::Prune() {
+  QDir dir(Utilities::GetConfigPath(Utilities::Path_EmbeddedArtCache));
+
+  // Keep the most recently used pictures
+  qint64 total = 0;
+  for (const QFileInfo& info : dir.entryInfoList(QDir::Files, QDir::Time)) {
+    if (info.suffix() == "part") continue;
+
+    total += info.size();
+    if (total > kMaxCacheBytes) {
+      QFile::remove(info.absoluteFilePath());
+    }
+  }
+}
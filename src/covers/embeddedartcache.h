@@ -0,0 +1,46 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COVERS_EMBEDDEDARTCACHE_H_
+#define COVERS_EMBEDDEDARTCACHE_H_
+
+#include <QByteArray>
+#include <QImage>
+#include <QString>
+
+// Keeps copies of the pictures embedded in songs' tags, so showing or
+// exporting a song's cover again doesn't need the tag reader to parse the
+// file.  Pictures are kept as they were in the file, keyed on its path, size
+// and modification time, so they're extracted again once it changes.  The
+// least recently used pictures are removed when the cache gets too big.
+class EmbeddedArtCache {
+ public:
+  static const qint64 kMaxCacheBytes;
+  // The cache is only pruned after this many pictures have been added.
+  static const int kPruneInterval;
+
+  // Returns the encoded picture embedded in filename, or an empty array if
+  // there isn't one.  Blocks, and can't be called from the UI thread.
+  static QByteArray LoadData(const QString& filename);
+  // Like LoadData, but decodes the picture.
+  static QImage Load(const QString& filename);
+
+ private:
+  static QString CachePath(const QString& filename);
+  static void Prune();
+};
+
+#endif  // COVERS_EMBEDDEDARTCACHE_H_
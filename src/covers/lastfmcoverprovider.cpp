@@ -29,7 +29,10 @@
 #include "internet/lastfm/lastfmcompat.h"
 
 LastFmCoverProvider::LastFmCoverProvider(QObject* parent)
-    : CoverProvider("last.fm", true, parent) {}
+    : CoverProvider("last.fm", true, parent) {
+  // Last.fm allows an average of five requests a second.
+  set_min_search_interval_msec(200);
+}
 
 bool LastFmCoverProvider::StartSearch(const QString& artist,
                                       const QString& album, int id) {
@@ -38,7 +38,10 @@ static const char* kAlbumCoverUrl =
 
 MusicbrainzCoverProvider::MusicbrainzCoverProvider(QObject* parent)
     : CoverProvider("MusicBrainz", true, parent),
-      network_(new NetworkAccessManager(this)) {}
+      network_(NetworkAccessManager::Shared()) {
+  // MusicBrainz allows one request a second.
+  set_min_search_interval_msec(1000);
+}
 
 bool MusicbrainzCoverProvider::StartSearch(const QString& artist,
                                            const QString& album, int id) {
@@ -0,0 +1,195 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "thumbnailcache.h"
+
+#include <cstring>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#include "core/logging.h"
+
+namespace {
+
+const char kMagic[] = "CLTHUMB1";
+const int kMagicSize = sizeof(kMagic) - 1;
+
+// Each record is the key, the width and height as quint16s, then the pixels.
+const int kRecordHeaderSize = 20 + 2 * sizeof(quint16);
+
+qint64 PixelBytes(int width, int height) { return qint64(width) * height * 4; }
+
+}  // namespace
+
+const qint64 ThumbnailCache::kDefaultMaxSize = 64 * 1024 * 1024;  // 64MB
+const int ThumbnailCache::kKeySize = 20;
+
+ThumbnailCache::ThumbnailCache(const QString& filename, qint64 max_size)
+    : file_(filename),
+      max_size_(max_size),
+      opened_(false),
+      map_(nullptr),
+      mapped_size_(0) {}
+
+ThumbnailCache::~ThumbnailCache() { Unmap(); }
+
+bool ThumbnailCache::EnsureOpen() {
+  if (opened_) return file_.isOpen();
+  opened_ = true;
+
+  QDir().mkpath(QFileInfo(file_.fileName()).path());
+  if (!file_.open(QIODevice::ReadWrite)) {
+    qLog(Warning) << "Couldn't open thumbnail cache" << file_.fileName()
+                  << file_.errorString();
+    return false;
+  }
+
+  Map();
+  if (mapped_size_ < kMagicSize ||
+      memcmp(map_, kMagic, kMagicSize) != 0) {
+    Reset();
+    return true;
+  }
+
+  // Build the index.  A record that runs off the end of the file was being
+  // written when we last exited, so it's thrown away.
+  qint64 offset = kMagicSize;
+  while (offset + kRecordHeaderSize <= mapped_size_) {
+    const uchar* header = map_ + offset;
+    quint16 width, height;
+    memcpy(&width, header + kKeySize, sizeof(width));
+    memcpy(&height, header + kKeySize + sizeof(width), sizeof(height));
+
+    const qint64 end = offset + kRecordHeaderSize + PixelBytes(width, height);
+    if (end > mapped_size_) break;
+
+    Entry entry;
+    entry.offset = offset + kRecordHeaderSize;
+    entry.width = width;
+    entry.height = height;
+    index_[QByteArray(reinterpret_cast<const char*>(header), kKeySize)] =
+        entry;
+    offset = end;
+  }
+
+  if (offset != mapped_size_) {
+    Unmap();
+    file_.resize(offset);
+    Map();
+  }
+
+  qLog(Debug) << "Loaded" << index_.count() << "thumbnails from"
+              << file_.fileName();
+  return true;
+}
+
+void ThumbnailCache::Reset() {
+  Unmap();
+  index_.clear();
+  file_.resize(0);
+  file_.seek(0);
+  file_.write(kMagic, kMagicSize);
+  file_.flush();
+  Map();
+}
+
+void ThumbnailCache::Map() {
+  mapped_size_ = file_.size();
+  map_ = mapped_size_ ? file_.map(0, mapped_size_) : nullptr;
+  if (!map_) mapped_size_ = 0;
+}
+
+void ThumbnailCache::Unmap() {
+  if (map_) file_.unmap(map_);
+  map_ = nullptr;
+  mapped_size_ = 0;
+}
+
+void ThumbnailCache::Clear() {
+  QMutexLocker l(&mutex_);
+  if (!EnsureOpen()) return;
+  Reset();
+}
+
+QImage ThumbnailCache::Find(const QByteArray& key) {
+  QMutexLocker l(&mutex_);
+  if (!EnsureOpen()) return QImage();
+
+  QHash<QByteArray, Entry>::const_iterator it = index_.constFind(key);
+  if (it == index_.constEnd()) return QImage();
+
+  // Records added since the file was mapped aren't in the mapping yet.
+  const qint64 end = it->offset + PixelBytes(it->width, it->height);
+  if (end > mapped_size_) {
+    Unmap();
+    Map();
+    if (end > mapped_size_) return QImage();
+  }
+
+  return QImage(map_ + it->offset, it->width, it->height, it->width * 4,
+                QImage::Format_ARGB32_Premultiplied).copy();
+}
+
+void ThumbnailCache::Insert(const QByteArray& key, const QImage& image) {
+  if (key.size() != kKeySize || image.isNull() || image.width() > 0xffff ||
+      image.height() > 0xffff) {
+    return;
+  }
+
+  QMutexLocker l(&mutex_);
+  if (!EnsureOpen() || index_.contains(key)) return;
+
+  const QImage pixels =
+      image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+  const qint64 size = kRecordHeaderSize + PixelBytes(pixels.width(),
+                                                     pixels.height());
+  if (kMagicSize + size > max_size_) return;
+  if (file_.size() + size > max_size_) {
+    qLog(Debug) << "Thumbnail cache" << file_.fileName()
+                << "is full, emptying it";
+    Reset();
+  }
+
+  const quint16 width = pixels.width();
+  const quint16 height = pixels.height();
+
+  file_.seek(file_.size());
+  const qint64 offset = file_.pos();
+  file_.write(key);
+  file_.write(reinterpret_cast<const char*>(&width), sizeof(width));
+  file_.write(reinterpret_cast<const char*>(&height), sizeof(height));
+  for (int y = 0; y < pixels.height(); ++y) {
+    file_.write(reinterpret_cast<const char*>(pixels.constScanLine(y)),
+                pixels.width() * 4);
+  }
+  if (!file_.flush() || file_.size() != offset + size) {
+    qLog(Warning) << "Couldn't write to thumbnail cache" << file_.fileName()
+                  << file_.errorString();
+    Unmap();
+    file_.resize(offset);
+    Map();
+    return;
+  }
+
+  Entry entry;
+  entry.offset = offset + kRecordHeaderSize;
+  entry.width = width;
+  entry.height = height;
+  index_[key] = entry;
+}
@@ -0,0 +1,77 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef COVERS_THUMBNAILCACHE_H_
+#define COVERS_THUMBNAILCACHE_H_
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+
+// Keeps scaled album covers in a single pack file that's memory-mapped, so
+// they can be shown again without decoding and scaling the original image.
+// Each thumbnail is stored as raw premultiplied ARGB pixels in native byte
+// order under a key chosen by the caller, typically a hash of where the image
+// came from and the size it was scaled to.  The pack is only ever appended to,
+// and is emptied when it would grow bigger than max_size.
+//
+// All methods are thread-safe.
+class ThumbnailCache {
+ public:
+  explicit ThumbnailCache(const QString& filename,
+                          qint64 max_size = kDefaultMaxSize);
+  ~ThumbnailCache();
+
+  static const qint64 kDefaultMaxSize;
+  static const int kKeySize;
+
+  QString filename() const { return file_.fileName(); }
+
+  // Returns a null image if there's no thumbnail for key.
+  QImage Find(const QByteArray& key);
+  void Insert(const QByteArray& key, const QImage& image);
+
+  void Clear();
+
+ private:
+  struct Entry {
+    qint64 offset;
+    int width;
+    int height;
+  };
+
+  bool EnsureOpen();
+  void Reset();
+  void Map();
+  void Unmap();
+
+  QMutex mutex_;
+  QFile file_;
+  qint64 max_size_;
+  bool opened_;
+
+  uchar* map_;
+  qint64 mapped_size_;
+
+  // Offset of each record's pixels in the file, keyed on its key.
+  QHash<QByteArray, Entry> index_;
+};
+
+#endif  // COVERS_THUMBNAILCACHE_H_
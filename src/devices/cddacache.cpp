@@ -0,0 +1,123 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cddacache.h"
+
+#include <memory>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QNetworkDiskCache>
+
+#include "core/utilities.h"
+
+namespace {
+
+// Bump this when the format of the stored data changes.
+const quint32 kFormatVersion = 1;
+
+}  // namespace
+
+const qint64 CddaCache::kMaxCacheSize = 1024 * 1024;  // 1MB
+const int CddaCache::kLifetimeDays = 365;
+
+QMutex CddaCache::sMutex;
+QNetworkDiskCache* CddaCache::sCache = nullptr;
+
+bool CddaCache::Track::operator==(const Track& other) const {
+  return title_ == other.title_ && length_nanosec_ == other.length_nanosec_ &&
+         year_ == other.year_;
+}
+
+bool CddaCache::Entry::operator==(const Entry& other) const {
+  return musicbrainz_discid_ == other.musicbrainz_discid_ &&
+         artist_ == other.artist_ && album_ == other.album_ &&
+         tracks_ == other.tracks_;
+}
+
+CddaCache::CddaCache() {}
+
+QNetworkDiskCache* CddaCache::cache() {
+  if (!sCache) {
+    sCache = new QNetworkDiskCache;
+    sCache->setCacheDirectory(
+        Utilities::GetConfigPath(Utilities::Path_CddaCache));
+    sCache->setMaximumCacheSize(kMaxCacheSize);
+  }
+  return sCache;
+}
+
+QUrl CddaCache::CacheUrl(const QString& toc) {
+  QUrl url;
+  url.setScheme("cdda");
+  url.setPath(toc);
+  return url;
+}
+
+bool CddaCache::Find(const QString& toc, Entry* entry) {
+  const QUrl url = CacheUrl(toc);
+
+  QMutexLocker l(&sMutex);
+  const QNetworkCacheMetaData cache_metadata = cache()->metaData(url);
+  if (!cache_metadata.isValid()) return false;
+
+  if (cache_metadata.expirationDate() < QDateTime::currentDateTime()) {
+    cache()->remove(url);
+    return false;
+  }
+
+  std::unique_ptr<QIODevice> device(cache()->data(url));
+  if (!device) return false;
+
+  QDataStream s(device.get());
+  quint32 version = 0;
+  s >> version;
+  if (version != kFormatVersion) return false;
+
+  qint32 track_count = 0;
+  s >> entry->musicbrainz_discid_ >> entry->artist_ >> entry->album_ >>
+      track_count;
+  for (int i = 0; i < track_count && s.status() == QDataStream::Ok; ++i) {
+    Track track;
+    qint32 year = 0;
+    s >> track.title_ >> track.length_nanosec_ >> year;
+    track.year_ = year;
+    entry->tracks_ << track;
+  }
+
+  return s.status() == QDataStream::Ok;
+}
+
+void CddaCache::Insert(const QString& toc, const Entry& entry) {
+  QNetworkCacheMetaData cache_metadata;
+  cache_metadata.setUrl(CacheUrl(toc));
+  cache_metadata.setExpirationDate(
+      QDateTime::currentDateTime().addDays(kLifetimeDays));
+
+  QMutexLocker l(&sMutex);
+  QIODevice* device = cache()->prepare(cache_metadata);
+  if (!device) return;
+
+  QDataStream s(device);
+  s << kFormatVersion << entry.musicbrainz_discid_ << entry.artist_
+    << entry.album_ << qint32(entry.tracks_.count());
+  for (const Track& track : entry.tracks_) {
+    s << track.title_ << track.length_nanosec_ << qint32(track.year_);
+  }
+
+  cache()->insert(device);
+}
@@ -0,0 +1,71 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DEVICES_CDDACACHE_H_
+#define DEVICES_CDDACACHE_H_
+
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QUrl>
+
+class QNetworkDiskCache;
+
+// Remembers what was found out about audio CDs, so a disc that's been seen
+// before can be listed without reading it with GStreamer or asking
+// MusicBrainz.  Entries are keyed on the disc's table of contents.
+//
+// All instances share one cache on disk and all methods are thread-safe.
+class CddaCache {
+ public:
+  CddaCache();
+
+  static const qint64 kMaxCacheSize;
+  static const int kLifetimeDays;
+
+  struct Track {
+    Track() : length_nanosec_(0), year_(0) {}
+    bool operator==(const Track& other) const;
+
+    QString title_;
+    qint64 length_nanosec_;
+    int year_;
+  };
+
+  // The titles are empty until MusicBrainz has been asked about the disc.
+  struct Entry {
+    bool operator==(const Entry& other) const;
+    bool operator!=(const Entry& other) const { return !(*this == other); }
+
+    QString musicbrainz_discid_;
+    QString artist_;
+    QString album_;
+    QList<Track> tracks_;
+  };
+
+  // Returns false if there's no entry or it has expired.
+  bool Find(const QString& toc, Entry* entry);
+  void Insert(const QString& toc, const Entry& entry);
+
+ private:
+  static QUrl CacheUrl(const QString& toc);
+  static QNetworkDiskCache* cache();
+
+  static QMutex sMutex;
+  static QNetworkDiskCache* sCache;
+};
+
+#endif  // DEVICES_CDDACACHE_H_
@@ -34,8 +34,6 @@ CddaDevice::CddaDevice(const QUrl& url, DeviceLister* lister,
       this, SLOT(SongsLoaded(SongList)));
   connect(&cdda_song_loader_, SIGNAL(SongsMetadataLoaded(SongList)),
       this, SLOT(SongsLoaded(SongList)));
-  connect(this, SIGNAL(SongsDiscovered(SongList)),
-      model_, SLOT(SongsDiscovered(SongList)));
 }
 
 CddaDevice::~CddaDevice() {}
@@ -52,8 +50,15 @@ void CddaDevice::Refresh() {
   Init();
 }
 
+void CddaDevice::InitModel() {
+  connect(this, SIGNAL(SongsDiscovered(SongList)),
+      model_, SLOT(SongsDiscovered(SongList)));
+  if (!songs_.isEmpty()) emit SongsDiscovered(songs_);
+}
+
 void CddaDevice::SongsLoaded(const SongList& songs) {
-  model_->Reset();
+  songs_ = songs;
+  if (model_) model_->Reset();
   emit SongsDiscovered(songs);
   song_count_ = songs.size();
 }
@@ -59,11 +59,17 @@ class CddaDevice : public ConnectedDevice {
 signals:
   void SongsDiscovered(const SongList& songs);
 
+ protected:
+  void InitModel();
+
  private slots:
   void SongsLoaded(const SongList& songs);
 
  private:
   CddaSongLoader cdda_song_loader_;
+  // The disc's songs aren't in the database, so they're kept here for when
+  // the model is created.
+  SongList songs_;
 };
 
 #endif
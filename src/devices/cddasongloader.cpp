@@ -15,12 +15,13 @@
    along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <QtConcurrentRun>
+#include <QStringList>
 
 #include <gst/gst.h>
 #include <gst/tag/tag.h>
 
 #include "core/logging.h"
+#include "core/taskexecutor.h"
 #include "core/timeconstants.h"
 
 #include "cddadevice.h"
@@ -47,14 +48,75 @@ QUrl CddaSongLoader::GetUrlFromTrack(int track_number) const {
 }
 
 void CddaSongLoader::LoadSongs() {
-  QtConcurrent::run(this, &CddaSongLoader::LoadSongsFromCdda);
+  TaskExecutor::Instance()->Run<void>(
+      TaskExecutor::Lane_Interactive,
+      std::bind(&CddaSongLoader::LoadSongsFromCdda, this));
 }
+
+QString CddaSongLoader::TocKey(CdIo_t* cdio) {
+  const track_t first_track = cdio_get_first_track_num(cdio);
+  const track_t num_tracks = cdio_get_num_tracks(cdio);
+  if (first_track == CDIO_INVALID_TRACK || num_tracks == CDIO_INVALID_TRACK) {
+    return QString();
+  }
+
+  QStringList ret;
+  ret << QString::number(first_track) << QString::number(num_tracks);
+  for (track_t track = first_track; track < first_track + num_tracks;
+       ++track) {
+    ret << QString::number(cdio_get_track_lsn(cdio, track));
+  }
+  ret << QString::number(cdio_get_track_lsn(cdio, CDIO_CDROM_LEADOUT_TRACK));
+  return ret.join("-");
+}
+
+void CddaSongLoader::EmitCachedSongs(const CddaCache::Entry& entry) {
+  SongList songs;
+  int track_number = 1;
+  for (const CddaCache::Track& track : entry.tracks_) {
+    Song song;
+    song.set_id(track_number);
+    song.set_valid(true);
+    song.set_filetype(Song::Type_Cdda);
+    song.set_url(GetUrlFromTrack(track_number));
+    song.set_title(track.title_.isEmpty()
+                       ? QString("Track %1").arg(track_number)
+                       : track.title_);
+    song.set_artist(entry.artist_);
+    song.set_album(entry.album_);
+    song.set_year(track.year_);
+    song.set_track(track_number);
+    song.set_length_nanosec(track.length_nanosec_);
+    songs << song;
+    track_number++;
+  }
+
+  emit SongsLoaded(songs);
+  emit SongsDurationLoaded(songs);
+  if (!entry.artist_.isEmpty() || !entry.album_.isEmpty()) {
+    emit SongsMetadataLoaded(songs);
+  }
+}
+
 void CddaSongLoader::LoadSongsFromCdda() {
   QMutexLocker locker(&mutex_load_);
   cdio_ = cdio_open(url_.path().toLocal8Bit().constData(), DRIVER_DEVICE);
   if (cdio_ == nullptr) {
     return;
   }
+
+  // A disc that's been seen before doesn't need reading with GStreamer, which
+  // takes a few seconds.  MusicBrainz is still asked in the background in
+  // case its data has changed.
+  toc_key_ = TocKey(cdio_);
+  entry_ = CddaCache::Entry();
+  if (!toc_key_.isEmpty() && cache_.Find(toc_key_, &entry_) &&
+      !entry_.musicbrainz_discid_.isEmpty()) {
+    qLog(Info) << "Using cached details for disc" << entry_.musicbrainz_discid_;
+    EmitCachedSongs(entry_);
+    emit MusicBrainzDiscIdLoaded(entry_.musicbrainz_discid_);
+    return;
+  }
   // Create gstreamer cdda element
   GError* error = nullptr;
   cdda_ = gst_element_make_from_uri(GST_URI_SRC, "cdda://", nullptr, &error);
@@ -165,6 +227,18 @@ void CddaSongLoader::LoadSongsFromCdda() {
                                 &string_mb)) {
       QString musicbrainz_discid(string_mb);
       qLog(Info) << "MusicBrainz discid: " << musicbrainz_discid;
+
+      // Remember the track lengths now, MusicBrainz might not know the disc.
+      if (!toc_key_.isEmpty()) {
+        entry_.musicbrainz_discid_ = musicbrainz_discid;
+        for (const Song& song : songs) {
+          CddaCache::Track track;
+          track.length_nanosec_ = song.length_nanosec();
+          entry_.tracks_ << track;
+        }
+        cache_.Insert(toc_key_, entry_);
+      }
+
       emit MusicBrainzDiscIdLoaded(musicbrainz_discid);
 
       g_free(string_mb);
@@ -197,6 +271,25 @@ void CddaSongLoader::AudioCDTagsLoaded(
   musicbrainz_client->deleteLater();
   SongList songs;
   if (results.empty()) return;
+
+  CddaCache::Entry entry = entry_;
+  entry.artist_ = artist;
+  entry.album_ = album;
+  entry.tracks_.clear();
+  for (const MusicBrainzClient::Result& ret : results) {
+    CddaCache::Track track;
+    track.title_ = ret.title_;
+    track.length_nanosec_ = ret.duration_msec_ * kNsecPerMsec;
+    track.year_ = ret.year_;
+    entry.tracks_ << track;
+  }
+  if (entry == entry_) {
+    // The cached details that were shown already are still right.
+    return;
+  }
+  if (!toc_key_.isEmpty()) cache_.Insert(toc_key_, entry);
+  entry_ = entry;
+
   int track_number = 1;
   for (const MusicBrainzClient::Result& ret : results) {
     Song song;
@@ -218,7 +311,9 @@ void CddaSongLoader::AudioCDTagsLoaded(
 }
 
 bool CddaSongLoader::HasChanged() {
-  if ((cdio_ && cdda_) && cdio_get_media_changed(cdio_) != 1) {
+  // A disc that was listed from the cache never had a cdda_ element.
+  if ((cdio_ && (cdda_ || !entry_.musicbrainz_discid_.isEmpty())) &&
+      cdio_get_media_changed(cdio_) != 1) {
     return false;
   }
   // Check if mutex is already token (i.e. init is already taking place)
@@ -26,6 +26,7 @@
 #include <cdio/cdio.h>
 #include <gst/audio/gstaudiocdsrc.h>
 
+#include "cddacache.h"
 #include "core/song.h"
 #include "musicbrainz/musicbrainzclient.h"
 
@@ -60,8 +61,18 @@ class CddaSongLoader : public QObject {
  private:
   QUrl GetUrlFromTrack(int track_number) const;
   void LoadSongsFromCdda();
+  // Identifies the disc from its table of contents, which libcdio reads
+  // without spinning up GStreamer.  Empty if it couldn't be read.
+  static QString TocKey(CdIo_t* cdio);
+  // Emits everything known about the disc from the cache.
+  void EmitCachedSongs(const CddaCache::Entry& entry);
 
   QUrl url_;
+  CddaCache cache_;
+  // The disc being loaded, and what's known about it.  Set in the loading
+  // thread before MusicBrainzDiscIdLoaded is emitted.
+  QString toc_key_;
+  CddaCache::Entry entry_;
   GstElement* cdda_;
   CdIo_t* cdio_;
   QMutex mutex_load_;
@@ -56,12 +56,22 @@ ConnectedDevice::ConnectedDevice(const QUrl& url, DeviceLister* lister,
                  QString("device_%1_subdirectories").arg(database_id),
                  QString("device_%1_fts").arg(database_id));
 
-  // Create the model
-  model_ = new LibraryModel(backend_, app_, this);
+  // The model would ask for this, but it isn't created until it's needed.
+  backend_->UpdateTotalSongCountAsync();
 }
 
 ConnectedDevice::~ConnectedDevice() {}
 
+LibraryModel* ConnectedDevice::model() {
+  if (!model_) {
+    model_ = new LibraryModel(backend_, app_, this);
+    InitModel();
+  }
+  return model_;
+}
+
+void ConnectedDevice::InitModel() { model_->Init(); }
+
 void ConnectedDevice::InitBackendDirectory(const QString& mount_point,
                                            bool first_time, bool rewrite_path) {
   if (first_time || backend_->GetAllDirectories().isEmpty()) {
@@ -56,7 +56,9 @@ class ConnectedDevice : public QObject,
 
   DeviceLister* lister() const { return lister_; }
   QString unique_id() const { return unique_id_; }
-  LibraryModel* model() const { return model_; }
+  // The model is only created the first time it's needed, since most devices
+  // are never browsed.
+  LibraryModel* model();
   QUrl url() const { return url_; }
   int song_count() const { return song_count_; }
 
@@ -73,6 +75,8 @@ signals:
  protected:
   void InitBackendDirectory(const QString& mount_point, bool first_time,
                             bool rewrite_path = true);
+  // Fills the model once it's been created.
+  virtual void InitModel();
 
  protected:
   Application* app_;
@@ -139,3 +139,28 @@ void DeviceDatabaseBackend::SetDeviceOptions(int id,
   q.exec();
   db_->CheckErrors(q);
 }
+
+QString DeviceDatabaseBackend::GetListingKey(int id) {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(db);
+  q.prepare("SELECT listing_key FROM devices WHERE ROWID=:id");
+  q.bindValue(":id", id);
+  q.exec();
+  if (db_->CheckErrors(q) || !q.next()) return QString();
+
+  return q.value(0).toString();
+}
+
+void DeviceDatabaseBackend::SetListingKey(int id, const QString& key) {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(db);
+  q.prepare("UPDATE devices SET listing_key=:listing_key WHERE ROWID=:id");
+  q.bindValue(":listing_key", key.isEmpty() ? QVariant() : key);
+  q.bindValue(":id", id);
+  q.exec();
+  db_->CheckErrors(q);
+}
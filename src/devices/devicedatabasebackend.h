@@ -59,6 +59,12 @@ class DeviceDatabaseBackend : public QObject {
                         MusicStorage::TranscodeMode mode,
                         Song::FileType format);
 
+  // An opaque value describing the state of the device's library when it was
+  // last loaded.  A loader that sees the same value again can skip listing
+  // the device's songs.  Empty if the device has never been loaded.
+  QString GetListingKey(int id);
+  void SetListingKey(int id, const QString& key);
+
  private:
   Database* db_;
 };
@@ -55,6 +55,7 @@ class DeviceInfo : public SimpleTreeItem<DeviceInfo> {
       : SimpleTreeItem<DeviceInfo>(Type_Root, model),
         database_id_(-1),
         size_(0),
+        free_space_(0),
         transcode_mode_(MusicStorage::Transcode_Unsupported),
         transcode_format_(Song::Type_Unknown),
         task_percentage_(-1) {}
@@ -63,6 +64,7 @@ class DeviceInfo : public SimpleTreeItem<DeviceInfo> {
       : SimpleTreeItem<DeviceInfo>(type, parent),
         database_id_(-1),
         size_(0),
+        free_space_(0),
         transcode_mode_(MusicStorage::Transcode_Unsupported),
         transcode_format_(Song::Type_Unknown),
         task_percentage_(-1) {}
@@ -95,6 +97,8 @@ class DeviceInfo : public SimpleTreeItem<DeviceInfo> {
 
   QString friendly_name_;
   quint64 size_;
+  // As last reported by the best backend's lister.
+  quint64 free_space_;
 
   QString icon_name_;
   QIcon icon_;
@@ -30,6 +30,7 @@
 
 #include "config.h"
 #include "core/application.h"
+#include "core/closure.h"
 #include "core/concurrentrun.h"
 #include "core/database.h"
 #include "core/logging.h"
@@ -127,6 +128,8 @@ DeviceManager::DeviceManager(Application* app, QObject* parent)
 }
 
 DeviceManager::~DeviceManager() {
+  probe_pool_.waitForDone();
+
   for (DeviceLister* lister : listers_) {
     lister->ShutDown();
     delete lister;
@@ -180,6 +183,14 @@ void DeviceManager::AddDeviceFromDb(DeviceInfo* info) {
   }
 }
 
+bool DeviceManager::hasChildren(const QModelIndex& parent) const {
+  // Views only load a connected device's library when it's expanded, so it
+  // has to look expandable before it has any rows.
+  DeviceInfo* info = IndexToItem(parent);
+  if (info && info->device_) return true;
+  return SimpleTreeModel<DeviceInfo>::hasChildren(parent);
+}
+
 QVariant DeviceManager::data(const QModelIndex& idx, int role) const {
   if (!idx.isValid() || idx.column() != 0) return QVariant();
 
@@ -231,8 +242,7 @@ QVariant DeviceManager::data(const QModelIndex& idx, int role) const {
     case Role_FreeSpace:
     case MusicStorage::Role_FreeSpace:
       return info->BestBackend() && info->BestBackend()->lister_
-                 ? info->BestBackend()->lister_->DeviceFreeSpace(
-                       info->BestBackend()->unique_id_)
+                 ? QVariant(info->free_space_)
                  : QVariant();
 
     case Role_State:
@@ -370,35 +380,116 @@ void DeviceManager::PhysicalDeviceAdded(const QString& id) {
     }
     QModelIndex idx = ItemToIndex(info);
     if (idx.isValid()) emit dataChanged(idx, idx);
+  } else {
+    // It's added to the model once we know what it is
+    unprobed_devices_ << qMakePair(lister, id);
+  }
+
+  StartProbe(lister, id);
+}
+
+DeviceManager::ListerInfo DeviceManager::ProbeDevice(DeviceLister* lister,
+                                                     const QString& id) {
+  ListerInfo ret;
+  ret.friendly_name_ = lister->MakeFriendlyName(id);
+  ret.capacity_ = lister->DeviceCapacity(id);
+  ret.free_space_ = lister->DeviceFreeSpace(id);
+  ret.icons_ = lister->DeviceIcons(id);
+  ret.urls_ = lister->MakeDeviceUrls(id);
+  return ret;
+}
+
+void DeviceManager::StartProbe(DeviceLister* lister, const QString& id) {
+  QFuture<ListerInfo> future = ConcurrentRun::Run<ListerInfo>(
+      &probe_pool_, bind(&DeviceManager::ProbeDevice, lister, id));
+  NewClosure(future, this,
+             SLOT(DeviceProbed(QFuture<DeviceManager::ListerInfo>,
+                               DeviceLister*, QString)),
+             future, lister, id);
+}
+
+void DeviceManager::DeviceProbed(QFuture<ListerInfo> future,
+                                 DeviceLister* lister, const QString& id) {
+  const ListerInfo probe = future.result();
+
+  if (unprobed_devices_.removeOne(qMakePair(lister, id))) {
+    AddProbedDevice(lister, id, probe);
+    return;
+  }
+
+  DeviceInfo* info = FindDeviceById(id);
+  if (!info) {
+    // It went away while we were probing it
+    return;
+  }
+
+  const DeviceInfo::Backend* backend = info->BestBackend();
+  if (!backend || backend->lister_ != lister || backend->unique_id_ != id) {
+    return;
+  }
+
+  info->free_space_ = probe.free_space_;
+
+  // If the user hasn't saved the device in the DB yet then overwrite the
+  // device's name and icon etc.
+  if (info->database_id_ == -1) {
+    info->friendly_name_ = probe.friendly_name_;
+    info->size_ = probe.capacity_;
+    info->LoadIcon(probe.icons_, info->friendly_name_);
+  }
+
+  QModelIndex idx = ItemToIndex(info);
+  if (idx.isValid()) emit dataChanged(idx, idx);
+}
+
+void DeviceManager::AddProbedDevice(DeviceLister* lister, const QString& id,
+                                    const ListerInfo& probe) {
+  // The device might have been loaded from the database in the meantime
+  DeviceInfo* info = FindDeviceById(id);
+  if (info) {
+    for (int backend_index = 0; backend_index < info->backends_.count();
+         ++backend_index) {
+      if (info->backends_[backend_index].unique_id_ == id) {
+        info->backends_[backend_index].lister_ = lister;
+        break;
+      }
+    }
   } else {
     // Check if we have another device with the same URL
-    info = FindDeviceByUrl(lister->MakeDeviceUrls(id));
+    info = FindDeviceByUrl(probe.urls_);
     if (info) {
       // Add this device's lister to the existing device
       info->backends_ << DeviceInfo::Backend(lister, id);
+    }
+  }
+
+  if (info) {
+    if (info->BestBackend()->lister_ == lister) {
+      info->free_space_ = probe.free_space_;
 
       // If the user hasn't saved the device in the DB yet then overwrite the
       // device's name and icon etc.
-      if (info->database_id_ == -1 && info->BestBackend()->lister_ == lister) {
-        info->friendly_name_ = lister->MakeFriendlyName(id);
-        info->size_ = lister->DeviceCapacity(id);
-        info->LoadIcon(lister->DeviceIcons(id), info->friendly_name_);
+      if (info->database_id_ == -1) {
+        info->friendly_name_ = probe.friendly_name_;
+        info->size_ = probe.capacity_;
+        info->LoadIcon(probe.icons_, info->friendly_name_);
       }
+    }
 
-      QModelIndex idx = ItemToIndex(info);
-      if (idx.isValid()) emit dataChanged(idx, idx);
-    } else {
-      // It's a completely new device
-      DeviceInfo* info = new DeviceInfo(DeviceInfo::Type_Device, root_);
-      info->backends_ << DeviceInfo::Backend(lister, id);
-      info->friendly_name_ = lister->MakeFriendlyName(id);
-      info->size_ = lister->DeviceCapacity(id);
-      info->LoadIcon(lister->DeviceIcons(id), info->friendly_name_);
+    QModelIndex idx = ItemToIndex(info);
+    if (idx.isValid()) emit dataChanged(idx, idx);
+  } else {
+    // It's a completely new device
+    info = new DeviceInfo(DeviceInfo::Type_Device, root_);
+    info->backends_ << DeviceInfo::Backend(lister, id);
+    info->friendly_name_ = probe.friendly_name_;
+    info->size_ = probe.capacity_;
+    info->free_space_ = probe.free_space_;
+    info->LoadIcon(probe.icons_, info->friendly_name_);
 
-      beginInsertRows(ItemToIndex(root_), devices_.count(), devices_.count());
-      devices_ << info;
-      endInsertRows();
-    }
+    beginInsertRows(ItemToIndex(root_), devices_.count(), devices_.count());
+    devices_ << info;
+    endInsertRows();
   }
 }
 
@@ -407,6 +498,9 @@ void DeviceManager::PhysicalDeviceRemoved(const QString& id) {
 
   qLog(Info) << "Device removed:" << id;
 
+  // Nothing to do if it never made it into the model
+  if (unprobed_devices_.removeOne(qMakePair(lister, id))) return;
+
   DeviceInfo* info = FindDeviceById(id);
   if (!info) {
     // Shouldn't happen
@@ -453,7 +547,6 @@ void DeviceManager::PhysicalDeviceRemoved(const QString& id) {
 
 void DeviceManager::PhysicalDeviceChanged(const QString& id) {
   DeviceLister* lister = qobject_cast<DeviceLister*>(sender());
-  Q_UNUSED(lister);
 
   DeviceInfo* info = FindDeviceById(id);
   if (!info) {
@@ -461,7 +554,8 @@ void DeviceManager::PhysicalDeviceChanged(const QString& id) {
     return;
   }
 
-  // TODO
+  // Its free space, at least, will have changed
+  StartProbe(lister, id);
 }
 
 std::shared_ptr<ConnectedDevice> DeviceManager::Connect(QModelIndex idx) {
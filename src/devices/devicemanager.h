@@ -23,8 +23,11 @@
 #include <memory>
 
 #include <QAbstractItemModel>
+#include <QFuture>
 #include <QIcon>
+#include <QPair>
 #include <QThreadPool>
+#include <QUrl>
 
 #include "core/simpletreemodel.h"
 #include "deviceinfo.h"
@@ -67,9 +70,23 @@ class DeviceManager : public SimpleTreeModel<DeviceInfo> {
   static const int kDeviceIconSize;
   static const int kDeviceIconOverlaySize;
 
+  // What a lister knows about one of its devices.  Some listers talk to the
+  // hardware or wait on their own thread to answer, so this is collected in
+  // the background and cached in the DeviceInfo.
+  struct ListerInfo {
+    ListerInfo() : capacity_(0), free_space_(0) {}
+
+    QString friendly_name_;
+    quint64 capacity_;
+    quint64 free_space_;
+    QVariantList icons_;
+    QList<QUrl> urls_;
+  };
+
   DeviceStateFilterModel* connected_devices_model() const {
     return connected_devices_model_;
   }
+  DeviceDatabaseBackend* database_backend() const { return backend_; }
 
   // Get info about devices
   int GetDatabaseId(const QModelIndex& idx) const;
@@ -98,6 +115,7 @@ class DeviceManager : public SimpleTreeModel<DeviceInfo> {
 
   // QAbstractItemModel
   QVariant data(const QModelIndex& idx, int role = Qt::DisplayRole) const;
+  bool hasChildren(const QModelIndex& parent) const;
 
  public slots:
   void Unmount(QModelIndex idx);
@@ -117,6 +135,8 @@ class DeviceManager : public SimpleTreeModel<DeviceInfo> {
   void LoadAllDevices();
   void DeviceConnectFinished(const QString& id, bool success);
   void AddDeviceFromDb(DeviceInfo* info);
+  void DeviceProbed(QFuture<DeviceManager::ListerInfo> future,
+                    DeviceLister* lister, const QString& id);
 
  protected:
   void LazyPopulate(DeviceInfo* item) { LazyPopulate(item, true); }
@@ -125,6 +145,12 @@ class DeviceManager : public SimpleTreeModel<DeviceInfo> {
  private:
 
   void AddLister(DeviceLister* lister);
+  // Runs in a background thread.
+  static ListerInfo ProbeDevice(DeviceLister* lister, const QString& id);
+  void StartProbe(DeviceLister* lister, const QString& id);
+  void AddProbedDevice(DeviceLister* lister, const QString& id,
+                       const ListerInfo& probe);
+
   template <typename T>
   void AddDeviceClass();
 
@@ -148,6 +174,11 @@ class DeviceManager : public SimpleTreeModel<DeviceInfo> {
   QMap<int, QPersistentModelIndex> active_tasks_;
 
   QThreadPool thread_pool_;
+  QThreadPool probe_pool_;
+
+  // Devices a lister has told us about that haven't been probed yet, so
+  // aren't in the model.
+  QList<QPair<DeviceLister*, QString>> unprobed_devices_;
 };
 
 template <typename T>
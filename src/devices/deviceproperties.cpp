@@ -21,12 +21,12 @@
 #include <memory>
 
 #include <QScrollBar>
-#include <QtConcurrentRun>
 
 #include "connecteddevice.h"
 #include "devicelister.h"
 #include "devicemanager.h"
 #include "ui_deviceproperties.h"
+#include "core/taskexecutor.h"
 #include "core/utilities.h"
 #include "transcoder/transcoder.h"
 #include "ui/iconloader.h"
@@ -222,8 +222,10 @@ void DeviceProperties::UpdateFormats() {
     // blocks, so do it in the background.
     supported_formats_.clear();
 
-    QFuture<bool> future = QtConcurrent::run(std::bind(
-        &ConnectedDevice::GetSupportedFiletypes, device, &supported_formats_));
+    QFuture<bool> future = TaskExecutor::Instance()->Run<bool>(
+        TaskExecutor::Lane_Interactive,
+        std::bind(&ConnectedDevice::GetSupportedFiletypes, device,
+                  &supported_formats_));
     NewClosure(future, this, SLOT(UpdateFormatsFinished(QFuture<bool>)),
                future);
 
@@ -182,6 +182,8 @@ void DeviceView::SetApplication(Application* app) {
   connect(merged_model_,
           SIGNAL(SubModelReset(QModelIndex, QAbstractItemModel*)),
           SLOT(RecursivelyExpand(QModelIndex)));
+  connect(this, SIGNAL(expanded(QModelIndex)),
+          SLOT(DeviceExpanded(QModelIndex)));
 
   setModel(merged_model_);
   properties_dialog_->SetDeviceManager(app_->device_manager());
@@ -295,10 +297,37 @@ void DeviceView::Connect() {
 }
 
 void DeviceView::DeviceConnected(QModelIndex idx) {
+  if (!app_->device_manager()->GetConnectedDevice(idx)) return;
+
+  // The device's library is loaded when it's expanded, unless it already is.
+  QModelIndex sort_idx = sort_model_->mapFromSource(idx);
+  if (isExpanded(merged_model_->mapFromSource(sort_idx))) AddDeviceModel(idx);
+
+  expand(menu_index_);
+}
+
+void DeviceView::DeviceDisconnected(QModelIndex idx) {
+  if (!device_models_.remove(
+          idx.data(DeviceManager::Role_UniqueId).toString())) {
+    return;
+  }
+  merged_model_->RemoveSubModel(sort_model_->mapFromSource(idx));
+}
+
+void DeviceView::DeviceExpanded(const QModelIndex& index) {
+  QModelIndex device_idx = MapToDevice(index);
+  if (device_idx.isValid()) AddDeviceModel(device_idx);
+}
+
+void DeviceView::AddDeviceModel(const QModelIndex& idx) {
   std::shared_ptr<ConnectedDevice> device =
       app_->device_manager()->GetConnectedDevice(idx);
   if (!device) return;
 
+  const QString unique_id = idx.data(DeviceManager::Role_UniqueId).toString();
+  if (device_models_.contains(unique_id)) return;
+  device_models_ << unique_id;
+
   QModelIndex sort_idx = sort_model_->mapFromSource(idx);
 
   QSortFilterProxyModel* sort_model =
@@ -308,12 +337,6 @@ void DeviceView::DeviceConnected(QModelIndex idx) {
   sort_model->setDynamicSortFilter(true);
   sort_model->sort(0);
   merged_model_->AddSubModel(sort_idx, sort_model);
-
-  expand(menu_index_);
-}
-
-void DeviceView::DeviceDisconnected(QModelIndex idx) {
-  merged_model_->RemoveSubModel(sort_model_->mapFromSource(idx));
 }
 
 void DeviceView::Forget() {
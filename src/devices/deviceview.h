@@ -20,6 +20,8 @@
 
 #include <memory>
 
+#include <QSet>
+
 #include "core/song.h"
 #include "library/libraryview.h"
 #include "widgets/autoexpandingtreeview.h"
@@ -73,6 +75,7 @@ class DeviceView : public AutoExpandingTreeView {
 
   void DeviceConnected(QModelIndex idx);
   void DeviceDisconnected(QModelIndex idx);
+  void DeviceExpanded(const QModelIndex& index);
 
   void DeleteFinished(const SongList& songs_with_errors);
 
@@ -84,11 +87,14 @@ class DeviceView : public AutoExpandingTreeView {
   QModelIndex MapToLibrary(const QModelIndex& merged_model_index) const;
   QModelIndex FindParentDevice(const QModelIndex& merged_model_index) const;
   SongList GetSelectedSongs() const;
+  void AddDeviceModel(const QModelIndex& idx);
 
  private:
   Application* app_;
   MergedProxyModel* merged_model_;
   QSortFilterProxyModel* sort_model_;
+  // Unique IDs of the devices whose library models have been merged in.
+  QSet<QString> device_models_;
 
   std::unique_ptr<DeviceProperties> properties_dialog_;
   std::unique_ptr<OrganiseDialog> organise_dialog_;
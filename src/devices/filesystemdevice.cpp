@@ -70,7 +70,6 @@ FilesystemDevice::FilesystemDevice(const QUrl& url, DeviceLister* lister,
 
 void FilesystemDevice::Init() {
   InitBackendDirectory(url_.toLocalFile(), first_time_);
-  model_->Init();
 }
 
 FilesystemDevice::~FilesystemDevice() {
@@ -30,6 +30,9 @@
 
 #include <gpod/itdb.h>
 
+const int GPodDevice::kWriteBatchTracks = 50;
+const int GPodDevice::kWriteIntervalMsec = 60000;
+
 GPodDevice::GPodDevice(const QUrl& url, DeviceLister* lister,
                        const QString& unique_id, DeviceManager* manager,
                        Application* app, int database_id, bool first_time)
@@ -37,11 +40,11 @@ GPodDevice::GPodDevice(const QUrl& url, DeviceLister* lister,
                       first_time),
       loader_thread_(new QThread(this)),
       loader_(nullptr),
-      db_(nullptr) {}
+      db_(nullptr),
+      changes_since_write_(0) {}
 
 void GPodDevice::Init() {
   InitBackendDirectory(url_.path(), first_time_);
-  model_->Init();
 
   loader_ = new GPodLoader(url_.path(), app_->task_manager(), backend_,
                            shared_from_this());
@@ -55,7 +58,13 @@ void GPodDevice::Init() {
   loader_thread_->start();
 }
 
-GPodDevice::~GPodDevice() {}
+GPodDevice::~GPodDevice() {
+  // Keep the parsed database around in case the device is connected again,
+  // unless it has changes that never made it to the device.
+  if (db_ && changes_since_write_ == 0) {
+    GPodLoader::CacheDatabase(url_.path(), db_);
+  }
+}
 
 void GPodDevice::LoadFinished(Itdb_iTunesDB* db) {
   QMutexLocker l(&db_mutex_);
@@ -80,6 +89,8 @@ bool GPodDevice::StartCopy(QList<Song::FileType>* supported_filetypes) {
 
   // Ensure only one "organise files" can be active at any one time
   db_busy_.lock();
+  changes_since_write_ = 0;
+  last_write_timer_.start();
 
   if (supported_filetypes) GetSupportedFiletypes(supported_filetypes);
   return true;
@@ -134,26 +145,58 @@ bool GPodDevice::CopyToStorage(const CopyJob& job) {
     QFile::remove(job.source_);
   }
 
+  MaybeCheckpointDatabase();
+  return true;
+}
+
+void GPodDevice::MaybeCheckpointDatabase() {
+  changes_since_write_++;
+  if (changes_since_write_ >= kWriteBatchTracks ||
+      last_write_timer_.elapsed() >= kWriteIntervalMsec) {
+    CheckpointDatabase();
+  }
+}
+
+bool GPodDevice::CheckpointDatabase() {
+  changes_since_write_ = 0;
+  last_write_timer_.restart();
+
+  // Write the itunes database
+  GError* error = nullptr;
+  itdb_write(db_, &error);
+  if (error) {
+    qLog(Error) << "writing database failed:"
+                << QString::fromUtf8(error->message);
+    app_->AddError(QString::fromUtf8(error->message));
+    g_error_free(error);
+    return false;
+  }
+
+  FinaliseDatabase();
+
+  // Update the library model in the database thread, so the next file can
+  // start copying straight away.
+  if (!songs_to_add_.isEmpty()) {
+    QMetaObject::invokeMethod(backend_.get(), "AddOrUpdateSongs",
+                              Qt::QueuedConnection,
+                              Q_ARG(SongList, songs_to_add_));
+  }
+  if (!songs_to_remove_.isEmpty()) {
+    QMetaObject::invokeMethod(backend_.get(), "DeleteSongs",
+                              Qt::QueuedConnection,
+                              Q_ARG(SongList, songs_to_remove_));
+  }
+
+  songs_to_add_.clear();
+  songs_to_remove_.clear();
   return true;
 }
 
 void GPodDevice::WriteDatabase(bool success) {
-  if (success) {
-    // Write the itunes database
-    GError* error = nullptr;
-    itdb_write(db_, &error);
-    if (error) {
-      qLog(Error) << "writing database failed:"
-                  << QString::fromUtf8(error->message);
-      app_->AddError(QString::fromUtf8(error->message));
-      g_error_free(error);
-    } else {
-      FinaliseDatabase();
-
-      // Update the library model
-      if (!songs_to_add_.isEmpty()) backend_->AddOrUpdateSongs(songs_to_add_);
-      if (!songs_to_remove_.isEmpty()) backend_->DeleteSongs(songs_to_remove_);
-    }
+  // Even if some files failed, the ones that made it are on the device and
+  // need to be in the database.  Failed copies were never added to it.
+  if (success || changes_since_write_ > 0) {
+    CheckpointDatabase();
   }
 
   songs_to_add_.clear();
@@ -221,6 +264,7 @@ bool GPodDevice::DeleteFromStorage(const DeleteJob& job) {
   // Remove it from our library model
   songs_to_remove_ << job.metadata_;
 
+  MaybeCheckpointDatabase();
   return true;
 }
 
@@ -21,6 +21,7 @@
 #include "connecteddevice.h"
 #include "core/musicstorage.h"
 
+#include <QElapsedTimer>
 #include <QMutex>
 #include <QWaitCondition>
 
@@ -41,6 +42,12 @@ class GPodDevice : public ConnectedDevice, public virtual MusicStorage {
 
   static QStringList url_schemes() { return QStringList() << "ipod"; }
 
+  // The iTunesDB is written after this many tracks or this long, whichever
+  // comes first, so a copy that's aborted half way through keeps most of
+  // what it copied.
+  static const int kWriteBatchTracks;
+  static const int kWriteIntervalMsec;
+
   bool GetSupportedFiletypes(QList<Song::FileType>* ret);
 
   bool StartCopy(QList<Song::FileType>* supported_types);
@@ -64,6 +71,9 @@ class GPodDevice : public ConnectedDevice, public virtual MusicStorage {
 
  private:
   void WriteDatabase(bool success);
+  // Writes the changes made so far, and leaves the database locked.
+  bool CheckpointDatabase();
+  void MaybeCheckpointDatabase();
 
  protected:
   QThread* loader_thread_;
@@ -76,6 +86,8 @@ class GPodDevice : public ConnectedDevice, public virtual MusicStorage {
   QMutex db_busy_;
   SongList songs_to_add_;
   SongList songs_to_remove_;
+  int changes_since_write_;
+  QElapsedTimer last_write_timer_;
 };
 
 #endif  // GPODDEVICE_H
@@ -25,8 +25,12 @@
 #include <gpod/itdb.h>
 
 #include <QDir>
+#include <QFileInfo>
 #include <QtDebug>
 
+QMutex GPodLoader::sCacheMutex;
+QMap<QString, GPodLoader::CachedDatabase> GPodLoader::sCache;
+
 GPodLoader::GPodLoader(const QString& mount_point, TaskManager* task_manager,
                        std::shared_ptr<LibraryBackend> backend,
                        std::shared_ptr<ConnectedDevice> device)
@@ -47,8 +51,13 @@ void GPodLoader::LoadDatabase() {
 
   // Load the iTunes database
   GError* error = nullptr;
-  Itdb_iTunesDB* db =
-      itdb_parse(QDir::toNativeSeparators(mount_point_).toLocal8Bit(), &error);
+  Itdb_iTunesDB* db = TakeCachedDatabase(mount_point_);
+  if (db) {
+    qLog(Debug) << "Reusing the iPod database parsed last time";
+  } else {
+    db = itdb_parse(QDir::toNativeSeparators(mount_point_).toLocal8Bit(),
+                    &error);
+  }
 
   // Check for errors
   if (!db) {
@@ -93,3 +102,44 @@ void GPodLoader::LoadDatabase() {
   task_manager_->SetTaskFinished(task_id);
   emit LoadFinished(db);
 }
+
+QDateTime GPodLoader::DatabaseModified(const QString& mount_point) {
+  gchar* path = itdb_get_itunesdb_path(
+      QDir::toNativeSeparators(mount_point).toLocal8Bit().constData());
+  if (!path) return QDateTime();
+
+  const QDateTime ret = QFileInfo(QString::fromLocal8Bit(path)).lastModified();
+  g_free(path);
+  return ret;
+}
+
+void GPodLoader::CacheDatabase(const QString& mount_point, Itdb_iTunesDB* db) {
+  CachedDatabase cached;
+  cached.modified_ = DatabaseModified(mount_point);
+  cached.db_ = db;
+
+  if (!cached.modified_.isValid()) {
+    itdb_free(db);
+    return;
+  }
+
+  QMutexLocker l(&sCacheMutex);
+  if (sCache.contains(mount_point)) itdb_free(sCache[mount_point].db_);
+  sCache[mount_point] = cached;
+}
+
+Itdb_iTunesDB* GPodLoader::TakeCachedDatabase(const QString& mount_point) {
+  CachedDatabase cached;
+  {
+    QMutexLocker l(&sCacheMutex);
+    if (!sCache.contains(mount_point)) return nullptr;
+    cached = sCache.take(mount_point);
+  }
+
+  // Something else might have written to the device while it was away.
+  if (cached.modified_ != DatabaseModified(mount_point)) {
+    itdb_free(cached.db_);
+    return nullptr;
+  }
+  return cached.db_;
+}
@@ -20,6 +20,9 @@
 
 #include <memory>
 
+#include <QDateTime>
+#include <QMap>
+#include <QMutex>
 #include <QObject>
 
 #include <gpod/itdb.h>
@@ -42,6 +45,11 @@ class GPodLoader : public QObject {
   void set_music_path_prefix(const QString& prefix) { path_prefix_ = prefix; }
   void set_song_type(Song::FileType type) { type_ = type; }
 
+  // Takes ownership of db.  The next LoadDatabase() for the same mount point
+  // uses it instead of parsing the iTunesDB again, as long as the file hasn't
+  // been modified since.
+  static void CacheDatabase(const QString& mount_point, Itdb_iTunesDB* db);
+
  public slots:
   void LoadDatabase();
 
@@ -51,6 +59,17 @@ signals:
   void LoadFinished(Itdb_iTunesDB* db);
 
  private:
+  struct CachedDatabase {
+    QDateTime modified_;
+    Itdb_iTunesDB* db_;
+  };
+
+  static QDateTime DatabaseModified(const QString& mount_point);
+  static Itdb_iTunesDB* TakeCachedDatabase(const QString& mount_point);
+
+  static QMutex sCacheMutex;
+  static QMap<QString, CachedDatabase> sCache;
+
   std::shared_ptr<ConnectedDevice> device_;
   QThread* original_thread_;
 
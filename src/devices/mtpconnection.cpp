@@ -97,3 +97,26 @@ MtpConnection::MtpConnection(const QUrl& url) : device_(nullptr) {
 MtpConnection::~MtpConnection() {
   if (device_) LIBMTP_Release_Device(device_);
 }
+
+QString MtpConnection::ListingKey() const {
+  if (!device_) return QString();
+
+  char* serial = LIBMTP_Get_Serialnumber(device_);
+  if (!serial) return QString();
+  QString ret = QString::fromUtf8(serial);
+  free(serial);
+  if (ret.isEmpty()) return QString();
+
+  if (LIBMTP_Get_Storage(device_, LIBMTP_STORAGE_SORTBY_NOTSORTED) != 0) {
+    return QString();
+  }
+
+  for (LIBMTP_devicestorage_t* storage = device_->storage; storage;
+       storage = storage->next) {
+    ret += QString(":%1-%2-%3")
+               .arg(storage->id)
+               .arg(storage->FreeSpaceInBytes)
+               .arg(storage->FreeSpaceInObjects);
+  }
+  return ret;
+}
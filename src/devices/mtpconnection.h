@@ -30,6 +30,12 @@ class MtpConnection {
   bool is_valid() const { return device_; }
   LIBMTP_mtpdevice_t* device() const { return device_; }
 
+  // Identifies the device and roughly what's on it.  MTP has no change
+  // counter, so this is made from the serial number and the free space and
+  // object counts of each storage - anything added to or removed from the
+  // device changes at least one of those.  Empty if it couldn't be read.
+  QString ListingKey() const;
+
  private:
   Q_DISABLE_COPY(MtpConnection)
 
@@ -48,10 +48,10 @@ MtpDevice::~MtpDevice() {}
 
 void MtpDevice::Init() {
   InitBackendDirectory("/", first_time_, false);
-  model_->Init();
 
-  loader_ =
-      new MtpLoader(url_, app_->task_manager(), backend_, shared_from_this());
+  loader_ = new MtpLoader(url_, app_->task_manager(), backend_,
+                          shared_from_this(), manager_->database_backend(),
+                          database_id_);
   loader_->moveToThread(loader_thread_);
 
   connect(loader_, SIGNAL(Error(QString)), SLOT(LoaderError(QString)));
@@ -135,6 +135,15 @@ void MtpDevice::FinishCopy(bool success) {
     if (!songs_to_remove_.isEmpty()) backend_->DeleteSongs(songs_to_remove_);
   }
 
+  // Our library now matches what's on the device, so remember its new state
+  // and the next connect doesn't have to list everything again.  If
+  // something failed part way through we can't be sure of that, so make the
+  // next connect start from scratch.
+  if (connection_ && connection_->is_valid()) {
+    manager_->database_backend()->SetListingKey(
+        database_id_, success ? connection_->ListingKey() : QString());
+  }
+
   songs_to_add_.clear();
   songs_to_remove_.clear();
 
@@ -20,19 +20,24 @@
 #include <libmtp.h>
 
 #include "connecteddevice.h"
+#include "devicedatabasebackend.h"
 #include "mtpconnection.h"
+#include "core/logging.h"
 #include "core/song.h"
 #include "core/taskmanager.h"
 #include "library/librarybackend.h"
 
 MtpLoader::MtpLoader(const QUrl& url, TaskManager* task_manager,
                      std::shared_ptr<LibraryBackend> backend,
-                     std::shared_ptr<ConnectedDevice> device)
+                     std::shared_ptr<ConnectedDevice> device,
+                     DeviceDatabaseBackend* device_db, int database_id)
     : QObject(nullptr),
       device_(device),
       url_(url),
       task_manager_(task_manager),
-      backend_(backend) {
+      backend_(backend),
+      device_db_(device_db),
+      database_id_(database_id) {
   original_thread_ = thread();
 }
 
@@ -57,6 +62,15 @@ bool MtpLoader::TryLoad() {
     return false;
   }
 
+  // Listing every track is very slow on devices with a lot of them, so don't
+  // bother if nothing has changed since we last did it.
+  const QString listing_key = dev.ListingKey();
+  if (!listing_key.isEmpty() &&
+      listing_key == device_db_->GetListingKey(database_id_)) {
+    qLog(Debug) << "MTP device hasn't changed, using the cached song list";
+    return true;
+  }
+
   // Load the list of songs on the device
   SongList songs;
   LIBMTP_track_t* tracks =
@@ -79,5 +93,7 @@ bool MtpLoader::TryLoad() {
   // Add the songs we've just loaded
   backend_->AddOrUpdateSongs(songs);
 
+  device_db_->SetListingKey(database_id_, listing_key);
+
   return true;
 }
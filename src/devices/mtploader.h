@@ -24,6 +24,7 @@
 #include <QUrl>
 
 class ConnectedDevice;
+class DeviceDatabaseBackend;
 class LibraryBackend;
 class TaskManager;
 
@@ -33,7 +34,8 @@ class MtpLoader : public QObject {
  public:
   MtpLoader(const QUrl& url, TaskManager* task_manager,
             std::shared_ptr<LibraryBackend> backend,
-            std::shared_ptr<ConnectedDevice> device);
+            std::shared_ptr<ConnectedDevice> device,
+            DeviceDatabaseBackend* device_db, int database_id);
   ~MtpLoader();
 
  public slots:
@@ -54,6 +56,8 @@ signals:
   QUrl url_;
   TaskManager* task_manager_;
   std::shared_ptr<LibraryBackend> backend_;
+  DeviceDatabaseBackend* device_db_;
+  int database_id_;
 };
 
 #endif  // MTPLOADER_H
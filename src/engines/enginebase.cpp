@@ -20,6 +20,7 @@
 // License:   See COPYING
 
 #include "enginebase.h"
+#include "positionclock.h"
 #include "core/timeconstants.h"
 
 #include <cmath>
@@ -39,6 +40,7 @@ Engine::Base::Base()
       autocrossfade_enabled_(false),
       crossfade_same_album_(false),
       next_background_stream_id_(0),
+      position_clock_(new PositionClock(this)),
       about_to_end_emitted_(false) {}
 
 Engine::Base::~Base() {}
@@ -53,9 +55,17 @@ bool Engine::Base::Load(const MediaPlaybackRequest& req, TrackChangeFlags,
   end_nanosec_ = end_nanosec;
 
   about_to_end_emitted_ = false;
+  position_clock_->Resync();
   return true;
 }
 
+void Engine::Base::RefreshMarkers(quint64 beginning_nanosec,
+                                  qint64 end_nanosec) {
+  beginning_nanosec_ = beginning_nanosec;
+  end_nanosec_ = end_nanosec;
+  position_clock_->Resync();
+}
+
 void Engine::Base::SetVolume(uint value) {
   volume_ = value;
 
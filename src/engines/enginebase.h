@@ -34,6 +34,8 @@
 #include "engine_fwd.h"
 #include "playbackrequest.h"
 
+class PositionClock;
+
 namespace Engine {
 
 typedef std::vector<int16_t> Scope;
@@ -70,10 +72,7 @@ class Base : public QObject {
   // Sets new values for the beginning and end markers of the currently playing
   // song.
   // This doesn't change the state of engine or the stream's current position.
-  virtual void RefreshMarkers(quint64 beginning_nanosec, qint64 end_nanosec) {
-    beginning_nanosec_ = beginning_nanosec;
-    end_nanosec_ = end_nanosec;
-  }
+  virtual void RefreshMarkers(quint64 beginning_nanosec, qint64 end_nanosec);
 
   // Plays a media stream represented with the URL 'u' from the given
   // 'beginning'
@@ -93,6 +92,8 @@ class Base : public QObject {
   bool is_crossfade_enabled() const { return crossfade_enabled_; }
   bool is_autocrossfade_enabled() const { return autocrossfade_enabled_; }
   bool crossfade_same_album() const { return crossfade_same_album_; }
+  // Use this rather than polling position_nanosec() on a timer.
+  PositionClock* position_clock() const { return position_clock_; }
 
   static const char* kSettingsGroup;
   static const int kScopeSize = 1024;
@@ -154,6 +155,8 @@ signals:
   bool fadeout_pause_enabled_;
   qint64 fadeout_pause_duration_nanosec_;
 
+  PositionClock* position_clock_;
+
  private:
   bool about_to_end_emitted_;
   Q_DISABLE_COPY(Base)
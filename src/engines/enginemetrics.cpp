@@ -0,0 +1,76 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "enginemetrics.h"
+
+#include "core/timeconstants.h"
+#include "core/utilities.h"
+
+EngineMetrics::EngineMetrics()
+    : pipeline_id_(-1),
+      queue_size_nanosec_(-1),
+      queue_fill_percent_(-1),
+      min_queue_fill_percent_(-1),
+      underruns_(0),
+      stalled_nanosec_(0),
+      time_to_first_audio_nanosec_(-1),
+      pipeline_latency_nanosec_(-1),
+      sink_buffer_nanosec_(-1),
+      network_bytes_(0),
+      network_nanosec_(0) {}
+
+qint64 EngineMetrics::network_bytes_per_sec() const {
+  if (network_nanosec_ <= 0) return -1;
+  return network_bytes_ * kNsecPerSec / network_nanosec_;
+}
+
+QStringList EngineMetrics::ToStrings() const {
+  auto msec = [](qint64 nanosec) {
+    return nanosec < 0 ? QString("?") : QString("%1 ms").arg(nanosec /
+                                                             kNsecPerMsec);
+  };
+  auto percent = [](int value) {
+    return value < 0 ? QString("?") : QString("%1%").arg(value);
+  };
+
+  QStringList ret;
+  ret << QString("Pipeline %1: %2")
+             .arg(pipeline_id_)
+             .arg(Utilities::ScrubUrlQueries(url_.toString()));
+  ret << QString("  Time to first audio: %1")
+             .arg(msec(time_to_first_audio_nanosec_));
+  ret << QString("  Queue fill: %1 of %2 (lowest %3)")
+             .arg(percent(queue_fill_percent_), msec(queue_size_nanosec_),
+                  percent(min_queue_fill_percent_));
+  ret << QString("  Underruns: %1 (stalled for %2)")
+             .arg(underruns_)
+             .arg(msec(stalled_nanosec_));
+  ret << QString("  Latency: %1 pipeline, %2 sink buffer")
+             .arg(msec(pipeline_latency_nanosec_),
+                  msec(sink_buffer_nanosec_));
+  if (network_bytes_ > 0) {
+    ret << QString("  Network: %1 over %2 (%3/s)")
+               .arg(Utilities::PrettySize(quint64(network_bytes_)),
+                    msec(network_nanosec_),
+                    Utilities::PrettySize(
+                        quint64(qMax(0ll, network_bytes_per_sec()))));
+  }
+  for (const QPair<QString, qint64>& element : element_cpu_nanosec_) {
+    ret << QString("  CPU time in %1: %2")
+               .arg(element.first, msec(element.second));
+  }
+  return ret;
+}
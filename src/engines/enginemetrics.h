@@ -0,0 +1,64 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINES_ENGINEMETRICS_H_
+#define ENGINES_ENGINEMETRICS_H_
+
+#include <QList>
+#include <QPair>
+#include <QStringList>
+#include <QUrl>
+
+// A snapshot of how well a pipeline is coping with the track it's playing,
+// for looking into reports of stuttering.  Values that aren't known are -1.
+struct EngineMetrics {
+  EngineMetrics();
+
+  int pipeline_id_;
+  QUrl url_;
+
+  // The buffering queue's size, how full it is now, and how full it was at
+  // its emptiest.
+  qint64 queue_size_nanosec_;
+  int queue_fill_percent_;
+  int min_queue_fill_percent_;
+
+  // How many times playback stopped to rebuffer, and for how long in total.
+  int underruns_;
+  qint64 stalled_nanosec_;
+
+  // From the play request to the first buffer reaching the output.
+  qint64 time_to_first_audio_nanosec_;
+
+  // Latency reported by the pipeline, and the size of the sink's own buffer.
+  qint64 pipeline_latency_nanosec_;
+  qint64 sink_buffer_nanosec_;
+
+  // Bytes read by network sources, and over how long.
+  qint64 network_bytes_;
+  qint64 network_nanosec_;
+
+  // CPU time used by each streaming thread, named after the element that
+  // drives it.  Only measured on Linux.
+  QList<QPair<QString, qint64>> element_cpu_nanosec_;
+
+  qint64 network_bytes_per_sec() const;
+
+  // One line per metric, for logs and the console.
+  QStringList ToStrings() const;
+};
+
+#endif  // ENGINES_ENGINEMETRICS_H_
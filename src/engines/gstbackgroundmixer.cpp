@@ -0,0 +1,449 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gstbackgroundmixer.h"
+
+#include <cstring>
+
+#include <QElapsedTimer>
+
+#include <gst/app/gstappsink.h>
+
+#include "core/closure.h"
+#include "core/logging.h"
+#include "core/taskexecutor.h"
+#include "core/utilities.h"
+
+// Everything is mixed as 16-bit stereo, which keeps a decoded clip to about
+// 10MB a minute.
+const int GstBackgroundMixer::kRate = 44100;
+const int GstBackgroundMixer::kChannels = 2;
+const int GstBackgroundMixer::kBytesPerFrame = 2 * kChannels;
+const int GstBackgroundMixer::kChunkFrames = kRate / 10;
+// Anything longer than this is probably a live stream rather than a clip, so
+// only this much of it gets looped.
+const int GstBackgroundMixer::kMaxClipSecs = 5 * 60;
+const int GstBackgroundMixer::kDecodeTimeoutSecs = 60;
+
+GstBackgroundMixer::Stream::Stream()
+    : id_(-1),
+      volume_percent_(30),
+      bin_(nullptr),
+      volume_(nullptr),
+      mixer_pad_(nullptr),
+      clip_position_bytes_(0),
+      frames_pushed_(0) {}
+
+GstBackgroundMixer::GstBackgroundMixer(QObject* parent)
+    : QObject(parent), pipeline_(nullptr), mixer_(nullptr), bus_cb_id_(0) {}
+
+GstBackgroundMixer::~GstBackgroundMixer() {
+  for (int id : streams_.keys()) {
+    Remove(id);
+  }
+  StopPipeline();
+
+  for (QFuture<QByteArray>& future : decoding_) {
+    future.waitForFinished();
+  }
+}
+
+void GstBackgroundMixer::set_output_device(const QString& sink,
+                                           const QVariant& device) {
+  sink_ = sink;
+  device_ = device;
+}
+
+GstCaps* GstBackgroundMixer::MixCaps() {
+  return gst_caps_new_simple("audio/x-raw", "format", G_TYPE_STRING, "S16LE",
+                             "layout", G_TYPE_STRING, "interleaved", "rate",
+                             G_TYPE_INT, kRate, "channels", G_TYPE_INT,
+                             kChannels, nullptr);
+}
+
+GstElement* GstBackgroundMixer::CreateElement(const char* factory_name,
+                                              GstElement* bin) {
+  GstElement* ret = gst_element_factory_make(factory_name, nullptr);
+  if (!ret) {
+    qLog(Warning) << "Couldn't create the gstreamer element" << factory_name;
+    return nullptr;
+  }
+  gst_bin_add(GST_BIN(bin), ret);
+  return ret;
+}
+
+void GstBackgroundMixer::AddClip(int id, const QUrl& url) {
+  Stream* stream = new Stream;
+  stream->id_ = id;
+  stream->url_ = url;
+  streams_[id] = stream;
+
+  if (clips_.contains(url)) {
+    stream->clip_ = clips_[url];
+    GstElement* src = gst_element_factory_make("appsrc", nullptr);
+    if (!src || !Connect(stream, src)) Remove(id);
+    return;
+  }
+
+  if (decoding_.contains(url)) return;
+
+  QFuture<QByteArray> future = TaskExecutor::Instance()->Run<QByteArray>(
+      TaskExecutor::Lane_Background,
+      std::bind(&GstBackgroundMixer::DecodeClip, url));
+  decoding_[url] = future;
+  NewClosure(future, this,
+             SLOT(ClipDecoded(QFuture<QByteArray>, QUrl)), future, url);
+}
+
+void GstBackgroundMixer::ClipDecoded(QFuture<QByteArray> future,
+                                     const QUrl& url) {
+  decoding_.remove(url);
+
+  const QByteArray clip = future.result();
+  if (clip.isEmpty()) {
+    qLog(Warning) << "Couldn't decode background stream"
+                  << Utilities::ScrubUrlQueries(url.toString());
+  } else {
+    clips_[url] = clip;
+  }
+
+  // Start every stream that was waiting for this clip.
+  for (Stream* stream : streams_.values()) {
+    if (stream->url_ != url || stream->bin_) continue;
+
+    GstElement* src = clip.isEmpty()
+                          ? nullptr
+                          : gst_element_factory_make("appsrc", nullptr);
+    stream->clip_ = clip;
+    if (!src || !Connect(stream, src)) Remove(stream->id_);
+  }
+}
+
+void GstBackgroundMixer::AddGenerator(int id, const QString& description) {
+  Stream* stream = new Stream;
+  stream->id_ = id;
+  streams_[id] = stream;
+
+  GError* error = nullptr;
+  GstElement* src = gst_parse_bin_from_description(
+      description.toUtf8().constData(), TRUE, &error);
+  if (error) {
+    qLog(Warning) << "Couldn't create background stream:" << error->message;
+    g_error_free(error);
+    if (src) gst_object_unref(src);
+    src = nullptr;
+  }
+
+  if (!src || !Connect(stream, src)) Remove(id);
+}
+
+bool GstBackgroundMixer::Connect(Stream* stream, GstElement* source) {
+  if (!pipeline_ && !StartPipeline()) {
+    gst_object_unref(source);
+    return false;
+  }
+
+  GstElement* bin = gst_bin_new(nullptr);
+  gst_bin_add(GST_BIN(bin), source);
+
+  GstElement* last = source;
+  if (GST_IS_APP_SRC(source)) {
+    // The clip is already in the mixer's format.
+    GstCaps* caps = MixCaps();
+    g_object_set(source, "caps", caps, "format", GST_FORMAT_TIME, nullptr);
+    gst_caps_unref(caps);
+
+    GstAppSrcCallbacks callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.need_data = NeedDataCallback;
+    gst_app_src_set_callbacks(GST_APP_SRC(source), &callbacks, stream,
+                              nullptr);
+  } else {
+    GstElement* convert = CreateElement("audioconvert", bin);
+    GstElement* resample = CreateElement("audioresample", bin);
+    GstElement* capsfilter = CreateElement("capsfilter", bin);
+    if (!convert || !resample || !capsfilter) {
+      gst_object_unref(bin);
+      return false;
+    }
+    GstCaps* caps = MixCaps();
+    g_object_set(capsfilter, "caps", caps, nullptr);
+    gst_caps_unref(caps);
+
+    gst_element_link_many(source, convert, resample, capsfilter, nullptr);
+    last = capsfilter;
+  }
+
+  GstElement* volume = CreateElement("volume", bin);
+  if (!volume) {
+    gst_object_unref(bin);
+    return false;
+  }
+  g_object_set(volume, "volume", stream->volume_percent_ * 0.01, nullptr);
+  gst_element_link(last, volume);
+
+  GstPad* pad = gst_element_get_static_pad(volume, "src");
+  GstPad* ghost_pad = gst_ghost_pad_new("src", pad);
+  gst_element_add_pad(bin, ghost_pad);
+  gst_object_unref(pad);
+
+  // Every stream's timestamps start from zero, so shift them to now or the
+  // mixer would think they're late.
+  GstClock* clock = gst_element_get_clock(pipeline_);
+  if (clock) {
+    const GstClockTime now = gst_clock_get_time(clock);
+    const GstClockTime base_time = gst_element_get_base_time(pipeline_);
+    if (now > base_time) gst_pad_set_offset(ghost_pad, now - base_time);
+    gst_object_unref(clock);
+  }
+
+  gst_bin_add(GST_BIN(pipeline_), bin);
+  stream->mixer_pad_ = gst_element_get_request_pad(mixer_, "sink_%u");
+  gst_pad_link(ghost_pad, stream->mixer_pad_);
+
+  stream->bin_ = bin;
+  stream->volume_ = volume;
+  gst_element_sync_state_with_parent(bin);
+
+  return true;
+}
+
+void GstBackgroundMixer::SetVolume(int id, int percent) {
+  Stream* stream = streams_.value(id);
+  if (!stream) return;
+
+  stream->volume_percent_ = percent;
+  if (stream->volume_) {
+    g_object_set(stream->volume_, "volume", percent * 0.01, nullptr);
+  }
+}
+
+void GstBackgroundMixer::Remove(int id) {
+  Stream* stream = streams_.take(id);
+  if (!stream) return;
+
+  if (stream->bin_) {
+    // This waits for the stream's thread, so it's safe to delete the stream
+    // afterwards.
+    gst_element_set_state(stream->bin_, GST_STATE_NULL);
+
+    GstPad* ghost_pad = gst_element_get_static_pad(stream->bin_, "src");
+    gst_pad_unlink(ghost_pad, stream->mixer_pad_);
+    gst_object_unref(ghost_pad);
+    gst_element_release_request_pad(mixer_, stream->mixer_pad_);
+    gst_object_unref(stream->mixer_pad_);
+
+    gst_bin_remove(GST_BIN(pipeline_), stream->bin_);
+  }
+  delete stream;
+
+  // Let go of the sink while nothing's playing.
+  bool any_connected = false;
+  for (Stream* other : streams_) {
+    if (other->bin_) any_connected = true;
+  }
+  if (!any_connected) StopPipeline();
+}
+
+bool GstBackgroundMixer::StartPipeline() {
+  pipeline_ = gst_pipeline_new("backgroundmixer");
+  mixer_ = CreateElement("audiomixer", pipeline_);
+  GstElement* convert = CreateElement("audioconvert", pipeline_);
+  GstElement* resample = CreateElement("audioresample", pipeline_);
+  GstElement* sink = CreateElement(sink_.toLatin1().constData(), pipeline_);
+
+  if (!mixer_ || !convert || !resample || !sink) {
+    gst_object_unref(pipeline_);
+    pipeline_ = nullptr;
+    mixer_ = nullptr;
+    return false;
+  }
+
+  if (g_object_class_find_property(G_OBJECT_GET_CLASS(sink), "device") &&
+      !device_.toString().isEmpty()) {
+    switch (device_.type()) {
+      case QVariant::Int:
+        g_object_set(sink, "device", device_.toInt(), nullptr);
+        break;
+      case QVariant::LongLong:
+        g_object_set(sink, "device", device_.toLongLong(), nullptr);
+        break;
+      case QVariant::ByteArray:
+        g_object_set(sink, "device", device_.toByteArray().constData(),
+                     nullptr);
+        break;
+      default:
+        g_object_set(sink, "device", device_.toString().toUtf8().constData(),
+                     nullptr);
+        break;
+    }
+  }
+
+  gst_element_link_many(mixer_, convert, resample, sink, nullptr);
+
+  GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+  bus_cb_id_ = gst_bus_add_watch(bus, BusCallback, this);
+  gst_object_unref(bus);
+
+  if (gst_element_set_state(pipeline_, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE) {
+    qLog(Warning) << "Couldn't start the background stream mixer";
+    StopPipeline();
+    return false;
+  }
+  return true;
+}
+
+void GstBackgroundMixer::StopPipeline() {
+  if (!pipeline_) return;
+
+  g_source_remove(bus_cb_id_);
+  gst_element_set_state(pipeline_, GST_STATE_NULL);
+  gst_object_unref(pipeline_);
+  pipeline_ = nullptr;
+  mixer_ = nullptr;
+  bus_cb_id_ = 0;
+}
+
+gboolean GstBackgroundMixer::BusCallback(GstBus*, GstMessage* msg, gpointer) {
+  if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+    GError* error = nullptr;
+    gchar* debugs = nullptr;
+    gst_message_parse_error(msg, &error, &debugs);
+    qLog(Warning) << "Background stream error:" << error->message;
+    g_error_free(error);
+    g_free(debugs);
+  }
+  return TRUE;
+}
+
+void GstBackgroundMixer::NeedDataCallback(GstAppSrc* src, guint,
+                                          gpointer self) {
+  Stream* stream = reinterpret_cast<Stream*>(self);
+  const QByteArray& clip = stream->clip_;
+
+  // Wrap around to the start of the clip as many times as it takes.
+  const qint64 size = qint64(kChunkFrames) * kBytesPerFrame;
+  GstBuffer* buffer = gst_buffer_new_allocate(nullptr, size, nullptr);
+  GstMapInfo map;
+  gst_buffer_map(buffer, &map, GST_MAP_WRITE);
+  qint64 written = 0;
+  while (written < size) {
+    const qint64 count =
+        qMin(size - written, clip.size() - stream->clip_position_bytes_);
+    memcpy(map.data + written, clip.constData() + stream->clip_position_bytes_,
+           count);
+    written += count;
+    stream->clip_position_bytes_ =
+        (stream->clip_position_bytes_ + count) % clip.size();
+  }
+  gst_buffer_unmap(buffer, &map);
+
+  GST_BUFFER_PTS(buffer) =
+      gst_util_uint64_scale(stream->frames_pushed_, GST_SECOND, kRate);
+  GST_BUFFER_DURATION(buffer) =
+      gst_util_uint64_scale(kChunkFrames, GST_SECOND, kRate);
+  stream->frames_pushed_ += kChunkFrames;
+
+  gst_app_src_push_buffer(src, buffer);
+}
+
+void GstBackgroundMixer::NewPadCallback(GstElement*, GstPad* pad,
+                                        gpointer convert) {
+  GstPad* sink_pad =
+      gst_element_get_static_pad(reinterpret_cast<GstElement*>(convert),
+                                 "sink");
+  if (!GST_PAD_IS_LINKED(sink_pad)) gst_pad_link(pad, sink_pad);
+  gst_object_unref(sink_pad);
+}
+
+QByteArray GstBackgroundMixer::DecodeClip(const QUrl& url) {
+  GstElement* pipeline = gst_pipeline_new("backgroundclip");
+  GstElement* decode = CreateElement("uridecodebin", pipeline);
+  GstElement* convert = CreateElement("audioconvert", pipeline);
+  GstElement* resample = CreateElement("audioresample", pipeline);
+  GstElement* sink = CreateElement("appsink", pipeline);
+  if (!decode || !convert || !resample || !sink) {
+    gst_object_unref(pipeline);
+    return QByteArray();
+  }
+
+  g_object_set(decode, "uri", url.toEncoded().constData(), nullptr);
+  g_object_set(sink, "sync", FALSE, nullptr);
+  gst_element_link(convert, resample);
+  GstCaps* caps = MixCaps();
+  gst_element_link_filtered(resample, sink, caps);
+  gst_caps_unref(caps);
+
+  // uridecodebin's pad only turns up once it knows what it's decoding.
+  g_signal_connect(decode, "pad-added", G_CALLBACK(NewPadCallback), convert);
+
+  GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+  gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+  const qint64 max_bytes = qint64(kMaxClipSecs) * kRate * kBytesPerFrame;
+  QByteArray ret;
+  QElapsedTimer since_last_data;
+  since_last_data.start();
+  bool failed = false;
+
+  while (ret.size() < max_bytes) {
+    GstSample* sample = gst_app_sink_try_pull_sample(GST_APP_SINK(sink),
+                                                     100 * GST_MSECOND);
+    if (sample) {
+      GstBuffer* buffer = gst_sample_get_buffer(sample);
+      GstMapInfo map;
+      if (buffer && gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+        ret.append(reinterpret_cast<const char*>(map.data), map.size);
+        gst_buffer_unmap(buffer, &map);
+      }
+      gst_sample_unref(sample);
+      since_last_data.restart();
+      continue;
+    }
+
+    if (gst_app_sink_is_eos(GST_APP_SINK(sink))) break;
+
+    GstMessage* msg = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR);
+    if (msg) {
+      GError* error = nullptr;
+      gchar* debugs = nullptr;
+      gst_message_parse_error(msg, &error, &debugs);
+      qLog(Warning) << "Error decoding background stream:" << error->message;
+      g_error_free(error);
+      g_free(debugs);
+      gst_message_unref(msg);
+      failed = true;
+      break;
+    }
+
+    if (since_last_data.elapsed() > kDecodeTimeoutSecs * 1000) {
+      qLog(Warning) << "Timed out decoding background stream";
+      failed = true;
+      break;
+    }
+  }
+
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(bus);
+  gst_object_unref(pipeline);
+
+  if (failed) return QByteArray();
+
+  // Whole frames only, so the loop doesn't swap the channels.
+  ret.truncate(ret.size() - ret.size() % kBytesPerFrame);
+  return ret;
+}
@@ -0,0 +1,111 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINES_GSTBACKGROUNDMIXER_H_
+#define ENGINES_GSTBACKGROUNDMIXER_H_
+
+#include <QFuture>
+#include <QHash>
+#include <QMap>
+#include <QObject>
+#include <QUrl>
+#include <QVariant>
+
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+
+// Plays the background streams (rain, hypnotoad and so on) through a single
+// audiomixer and sink, however many of them are enabled.  Streams from URLs
+// are decoded into memory once, in the background, and looped from there.
+class GstBackgroundMixer : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit GstBackgroundMixer(QObject* parent = nullptr);
+  ~GstBackgroundMixer();
+
+  // Used the next time the sink is opened.
+  void set_output_device(const QString& sink, const QVariant& device);
+
+  // The stream starts playing once url has been decoded.
+  void AddClip(int id, const QUrl& url);
+  // The stream's audio comes from a gst-launch style description instead.
+  void AddGenerator(int id, const QString& description);
+
+  void SetVolume(int id, int percent);
+  void Remove(int id);
+
+ private slots:
+  void ClipDecoded(QFuture<QByteArray> future, const QUrl& url);
+
+ private:
+  struct Stream {
+    Stream();
+
+    int id_;
+    QUrl url_;
+    int volume_percent_;
+
+    // Only set while the stream is in the mixer.
+    GstElement* bin_;
+    GstElement* volume_;
+    GstPad* mixer_pad_;
+
+    // For clips.  The position is only touched by the streaming thread.
+    QByteArray clip_;
+    qint64 clip_position_bytes_;
+    quint64 frames_pushed_;
+  };
+
+  static const int kRate;
+  static const int kChannels;
+  static const int kBytesPerFrame;
+  static const int kChunkFrames;
+  static const int kMaxClipSecs;
+  static const int kDecodeTimeoutSecs;
+
+  // Runs in a background thread.  Returns an empty array on failure.
+  static QByteArray DecodeClip(const QUrl& url);
+
+  static void NewPadCallback(GstElement*, GstPad* pad, gpointer convert);
+  static void NeedDataCallback(GstAppSrc* src, guint length, gpointer self);
+  static gboolean BusCallback(GstBus*, GstMessage* msg, gpointer self);
+
+  static GstCaps* MixCaps();
+  static GstElement* CreateElement(const char* factory_name, GstElement* bin);
+
+  bool StartPipeline();
+  void StopPipeline();
+  // Builds the stream's bin around source and connects it to the mixer.
+  bool Connect(Stream* stream, GstElement* source);
+
+ private:
+  QString sink_;
+  QVariant device_;
+
+  GstElement* pipeline_;
+  GstElement* mixer_;
+  guint bus_cb_id_;
+
+  QMap<int, Stream*> streams_;
+
+  // Clips that have already been decoded, so enabling a stream again is
+  // instant.
+  QHash<QUrl, QByteArray> clips_;
+  QHash<QUrl, QFuture<QByteArray>> decoding_;
+};
+
+#endif  // ENGINES_GSTBACKGROUNDMIXER_H_
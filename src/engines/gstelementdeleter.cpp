@@ -17,15 +17,53 @@
 
 #include "gstelementdeleter.h"
 
-#include <QtDebug>
+#include <QElapsedTimer>
 
-GstElementDeleter::GstElementDeleter(QObject* parent) : QObject(parent) {}
+#include "core/concurrentrun.h"
+#include "core/logging.h"
+#include "core/metriccounter.h"
+
+namespace {
+MetricCounter sTeardownsStarted("clementine_gst_teardowns_started_total",
+                                "GStreamer elements queued to be stopped.");
+MetricCounter sTeardownsFinished("clementine_gst_teardowns_finished_total",
+                                 "GStreamer elements stopped and freed.");
+MetricCounter sTeardownSeconds("clementine_gst_teardown_seconds_total",
+                               "Time spent stopping GStreamer elements.",
+                               1e-9);
+}  // namespace
+
+// Enough that a source stuck closing its connection doesn't hold up the next
+// teardown, without starting a thread for every one.
+const int GstElementDeleter::kMaxThreads = 2;
+
+GstElementDeleter::GstElementDeleter(QObject* parent) : QObject(parent) {
+  pool_.setMaxThreadCount(kMaxThreads);
+}
+
+GstElementDeleter::~GstElementDeleter() { pool_.waitForDone(); }
 
 void GstElementDeleter::DeleteElementLater(GstElement* element) {
-  metaObject()->invokeMethod(this, "DeleteElement", Qt::QueuedConnection,
-                             Q_ARG(GstElement*, element));
+  if (!element) return;
+
+  sTeardownsStarted.Add();
+  const int pending = pending_.fetchAndAddRelaxed(1) + 1;
+  if (pending > kMaxThreads) {
+    qLog(Debug) << pending << "GStreamer elements waiting to be stopped";
+  }
+
+  ConcurrentRun::Run<void>(&pool_,
+                           [this, element]() { DeleteElement(element); });
 }
 
 void GstElementDeleter::DeleteElement(GstElement* element) {
+  QElapsedTimer timer;
+  timer.start();
+
   gst_element_set_state(element, GST_STATE_NULL);
+  gst_object_unref(element);
+
+  sTeardownSeconds.Add(timer.nsecsElapsed());
+  sTeardownsFinished.Add();
+  pending_.fetchAndAddRelaxed(-1);
 }
@@ -18,26 +18,42 @@
 #ifndef GSTBINDELETER_H
 #define GSTBINDELETER_H
 
+#include <QAtomicInt>
 #include <QObject>
+#include <QThreadPool>
 
 #include <gst/gst.h>
 
+// Stops and frees elements on a small pool of threads of its own.  Setting a
+// decode bin to NULL can block for a long time - closing network connections
+// and waiting for its streaming threads - so it shouldn't hold up the thread
+// that's done with it, and one slow teardown shouldn't hold up the others.
 class GstElementDeleter : public QObject {
   Q_OBJECT
 
  public:
   GstElementDeleter(QObject* parent = nullptr);
+  ~GstElementDeleter();
 
-  // If you call this function with any gstreamer element, the element will get
-  // deleted in the main thread.  This is useful if you need to delete an
-  // element from its own callback.
+  static const int kMaxThreads;
+
+  // Takes over one reference to element, which must already have been removed
+  // from its bin, and sets it to NULL and unrefs it in the background.  This
+  // is useful if you need to delete an element from its own callback.
   // It's in a separate object so *your* object (GstEnginePipeline) can be
   // destroyed, and the element that you scheduled for deletion is still
-  // deleted later regardless.
+  // deleted later regardless - but nothing in the element may call back into
+  // your object by then.
   void DeleteElementLater(GstElement* element);
 
- private slots:
+  // Elements that haven't finished being deleted yet.
+  int pending() const { return pending_.load(); }
+
+ private:
   void DeleteElement(GstElement* element);
+
+  QThreadPool pool_;
+  QAtomicInt pending_;
 };
 
 #endif  // GSTBINDELETER_H
@@ -36,16 +36,19 @@
 #include <QCoreApplication>
 #include <QTimeLine>
 #include <QDir>
-#include <QtConcurrentRun>
 
 #include <gst/gst.h>
 #include <gst/pbutils/pbutils.h>
 
 #include "config.h"
 #include "devicefinder.h"
+#include "gstbackgroundmixer.h"
 #include "gstenginepipeline.h"
+#include "positionclock.h"
 #include "core/closure.h"
 #include "core/logging.h"
+#include "core/perftrace.h"
+#include "core/taskexecutor.h"
 #include "core/taskmanager.h"
 #include "core/timeconstants.h"
 #include "core/utilities.h"
@@ -85,6 +88,8 @@ using std::vector;
 
 const char* GstEngine::kSettingsGroup = "GstEngine";
 const char* GstEngine::kAutoSink = "autoaudiosink";
+const int GstEngine::kSparePipelineDelayMsec = 1000;
+const int GstEngine::kOutputsRefreshDelayMsec = 500;
 const char* GstEngine::kHypnotoadPipeline =
     "audiotestsrc wave=6 ! "
     "audioecho intensity=1 delay=50000000 ! "
@@ -100,7 +105,9 @@ GstEngine::GstEngine(TaskManager* task_manager)
     : Engine::Base(),
       task_manager_(task_manager),
       buffering_task_id_(-1),
-      latest_buffer_(nullptr),
+      preroll_end_nanosec_(0),
+      preroll_offset_nanosec_(0),
+      prerolled_pipeline_id_(-1),
       equalizer_enabled_(false),
       stereo_balance_(0.0f),
       rg_enabled_(false),
@@ -109,19 +116,31 @@ GstEngine::GstEngine(TaskManager* task_manager)
       rg_compression_(true),
       buffer_duration_nanosec_(1 * kNsecPerSec),  // 1s
       buffer_min_fill_(33),
+      adaptive_buffering_(false),
+      prebuffer_lookahead_nanosec_(10 * kNsecPerSec),  // 10s
       mono_playback_(false),
       sample_rate_(kAutoSampleRate),
       seek_timer_(new QTimer(this)),
       timer_id_(-1),
+      length_check_interval_nanosec_(kTimerIntervalNanosec),
       next_element_id_(0),
       is_fading_out_to_pause_(false),
       has_faded_out_(false),
-      scope_chunk_(0),
-      have_new_buffer_(false) {
+      next_scope_(kScopeSize),
+      background_mixer_(new GstBackgroundMixer(this)),
+      outputs_refresh_timer_(new QTimer(this)),
+      device_monitor_(nullptr),
+      device_monitor_watch_id_(0) {
   seek_timer_->setSingleShot(true);
   seek_timer_->setInterval(kSeekDelayNanosec / kNsecPerMsec);
   connect(seek_timer_, SIGNAL(timeout()), SLOT(SeekNow()));
 
+  // Devices tend to appear and disappear in bursts.
+  outputs_refresh_timer_->setSingleShot(true);
+  outputs_refresh_timer_->setInterval(kOutputsRefreshDelayMsec);
+  connect(outputs_refresh_timer_, SIGNAL(timeout()),
+          SLOT(RefreshOutputsLater()));
+
   ReloadSettings();
 
 #ifdef Q_OS_DARWIN
@@ -136,7 +155,17 @@ GstEngine::~GstEngine() {
   EnsureInitialised();
 
   current_pipeline_.reset();
+  spare_pipeline_.reset();
+  preroll_pipeline_.reset();
+  retired_pipelines_.clear();
+
+  if (device_monitor_) {
+    g_source_remove(device_monitor_watch_id_);
+    gst_device_monitor_stop(device_monitor_);
+    gst_object_unref(device_monitor_);
+  }
 
+  refreshing_outputs_.waitForFinished();
   qDeleteAll(device_finders_);
 
 #ifdef Q_OS_DARWIN
@@ -145,7 +174,9 @@ GstEngine::~GstEngine() {
 }
 
 bool GstEngine::Init() {
-  initialising_ = QtConcurrent::run(this, &GstEngine::InitialiseGstreamer);
+  initialising_ = TaskExecutor::Instance()->Run<void>(
+      TaskExecutor::Lane_Interactive,
+      std::bind(&GstEngine::InitialiseGstreamer, this));
   return true;
 }
 
@@ -203,6 +234,97 @@ void GstEngine::InitialiseGstreamer() {
 
     device_finders_.append(finder);
   }
+
+  RefreshOutputs();
+  StartDeviceMonitor();
+}
+
+void GstEngine::RefreshOutputs() {
+  OutputDetailsList outputs;
+
+  OutputDetails default_output;
+  default_output.description = tr("Choose automatically");
+  default_output.gstreamer_plugin_name = kAutoSink;
+  default_output.device_property_value = QString("");
+  outputs.append(default_output);
+
+  for (DeviceFinder* finder : device_finders_) {
+    for (const DeviceFinder::Device& device : finder->ListDevices()) {
+      OutputDetails output;
+      output.description = device.description;
+      output.icon_name = device.icon_name;
+      output.gstreamer_plugin_name = finder->gstreamer_sink();
+      output.device_property_value = device.device_property_value;
+      outputs.append(output);
+    }
+  }
+
+  PluginDetailsList plugins = GetPluginList("Sink/Audio");
+  // If there are only 2 plugins (autoaudiosink and the OS' default), don't add
+  // any, since the OS' default would be redundant.
+  if (plugins.count() > 2) {
+    for (const PluginDetails& plugin : plugins) {
+      if (plugin.name == kAutoSink) {
+        continue;
+      }
+
+      OutputDetails output;
+      output.description = tr("Default device on %1").arg(plugin.description);
+      output.gstreamer_plugin_name = plugin.name;
+      output.device_property_value = QString("");
+      outputs.append(output);
+    }
+  }
+
+  {
+    QMutexLocker l(&outputs_mutex_);
+    outputs_ = outputs;
+  }
+  emit OutputsChanged();
+}
+
+void GstEngine::StartDeviceMonitor() {
+  GstDeviceMonitor* monitor = gst_device_monitor_new();
+  gst_device_monitor_add_filter(monitor, "Audio/Sink", nullptr);
+  if (!gst_device_monitor_start(monitor)) {
+    qLog(Info) << "Audio devices won't be noticed when they're plugged in";
+    gst_object_unref(monitor);
+    return;
+  }
+
+  // The watch is dispatched by the main thread's event loop.
+  GstBus* bus = gst_device_monitor_get_bus(monitor);
+  device_monitor_watch_id_ =
+      gst_bus_add_watch(bus, DeviceMonitorBusCallback, this);
+  gst_object_unref(bus);
+  device_monitor_ = monitor;
+}
+
+gboolean GstEngine::DeviceMonitorBusCallback(GstBus*, GstMessage* msg,
+                                             gpointer self) {
+  GstEngine* instance = reinterpret_cast<GstEngine*>(self);
+
+  switch (GST_MESSAGE_TYPE(msg)) {
+    case GST_MESSAGE_DEVICE_ADDED:
+    case GST_MESSAGE_DEVICE_REMOVED:
+      instance->outputs_refresh_timer_->start();
+      break;
+    default:
+      break;
+  }
+
+  return TRUE;
+}
+
+void GstEngine::RefreshOutputsLater() {
+  if (refreshing_outputs_.isRunning()) {
+    // Try again once it's done, it might have missed this change.
+    outputs_refresh_timer_->start();
+    return;
+  }
+  refreshing_outputs_ = TaskExecutor::Instance()->Run<void>(
+      TaskExecutor::Lane_Background,
+      std::bind(&GstEngine::RefreshOutputs, this));
 }
 
 void GstEngine::ReloadSettings() {
@@ -225,9 +347,17 @@ void GstEngine::ReloadSettings() {
       s.value("bufferduration", 4000).toLongLong() * kNsecPerMsec;
 
   buffer_min_fill_ = s.value("bufferminfill", 33).toInt();
+  adaptive_buffering_ = s.value("adaptivebuffering", false).toBool();
+
+  prebuffer_lookahead_nanosec_ =
+      s.value("prebufferlookahead", 10000).toLongLong() * kNsecPerMsec;
 
   mono_playback_ = s.value("monoplayback", false).toBool();
   sample_rate_ = s.value("samplerate", kAutoSampleRate).toInt();
+
+  // Pooled pipelines were built with the old settings.
+  spare_pipeline_.reset();
+  retired_pipelines_.clear();
 }
 
 qint64 GstEngine::position_nanosec() const {
@@ -237,6 +367,11 @@ qint64 GstEngine::position_nanosec() const {
   return qint64(qMax(0ll, result));
 }
 
+EngineMetrics GstEngine::current_metrics() const {
+  if (!current_pipeline_) return EngineMetrics();
+  return current_pipeline_->metrics();
+}
+
 qint64 GstEngine::length_nanosec() const {
   if (!current_pipeline_) return 0;
 
@@ -269,108 +404,37 @@ Engine::State GstEngine::state() const {
 }
 
 void GstEngine::ConsumeBuffer(GstBuffer* buffer, int pipeline_id) {
-  // Schedule this to run in the GUI thread.  The buffer gets added to the
-  // queue and unreffed by UpdateScope.
-  if (!QMetaObject::invokeMethod(this, "AddBufferToScope",
-                                 Q_ARG(GstBuffer*, buffer),
-                                 Q_ARG(int, pipeline_id))) {
-    qLog(Warning) << "Failed to invoke AddBufferToScope on GstEngine";
-    gst_buffer_unref(buffer);
+  PerfTrace::Scope trace("GstEngine::ConsumeBuffer");
+  // This is called in the streaming thread.  The samples are copied into
+  // scope_buffer_, which the GUI thread reads from in scope().
+  GstMapInfo map;
+  if (gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+    const quint64 duration = GST_BUFFER_DURATION_IS_VALID(buffer)
+                                 ? GST_BUFFER_DURATION(buffer)
+                                 : 0;
+    scope_buffer_.Write(reinterpret_cast<const int16_t*>(map.data),
+                        map.size / sizeof(int16_t), duration, pipeline_id);
+    gst_buffer_unmap(buffer, &map);
   }
+  gst_buffer_unref(buffer);
 }
 
 bool GstEngine::IsCurrentPipeline(int id) {
   return current_pipeline_.get() && current_pipeline_->id() == id;
 }
 
-void GstEngine::AddBufferToScope(GstBuffer* buf, int pipeline_id) {
-  if (!IsCurrentPipeline(pipeline_id)) {
-    gst_buffer_unref(buf);
-    return;
-  }
-
-  if (latest_buffer_ != nullptr) {
-    gst_buffer_unref(latest_buffer_);
-  }
-
-  latest_buffer_ = buf;
-  have_new_buffer_ = true;
-}
-
-const Engine::Scope& GstEngine::scope(int chunk_length) {
-  // the new buffer could have a different size
-  if (have_new_buffer_) {
-    if (latest_buffer_ != nullptr) {
-      scope_chunks_ = ceil(((double)GST_BUFFER_DURATION(latest_buffer_) /
-                            (double)(chunk_length * kNsecPerMsec)));
-    }
-
-    // if the buffer is shorter than the chunk length
-    if (scope_chunks_ <= 0) {
-      scope_chunks_ = 1;
-    }
-
-    scope_chunk_ = 0;
-    have_new_buffer_ = false;
-  }
-
-  if (latest_buffer_ != nullptr) {
-    UpdateScope(chunk_length);
+const Engine::Scope& GstEngine::scope(int) {
+  // Keep showing the last samples if there's nothing newer from this pipeline.
+  int pipeline_id = -1;
+  if (scope_buffer_.ReadLatest(next_scope_.data(), next_scope_.size(),
+                               &pipeline_id) &&
+      IsCurrentPipeline(pipeline_id)) {
+    scope_.swap(next_scope_);
   }
 
   return scope_;
 }
 
-void GstEngine::UpdateScope(int chunk_length) {
-  typedef Engine::Scope::value_type sample_type;
-
-  // prevent dbz or invalid chunk size
-  if (!GST_CLOCK_TIME_IS_VALID(GST_BUFFER_DURATION(latest_buffer_))) return;
-  if (GST_BUFFER_DURATION(latest_buffer_) == 0) return;
-
-  GstMapInfo map;
-  gst_buffer_map(latest_buffer_, &map, GST_MAP_READ);
-
-  // determine where to split the buffer
-  int chunk_density =
-      (map.size * kNsecPerMsec) / GST_BUFFER_DURATION(latest_buffer_);
-
-  int chunk_size = chunk_length * chunk_density;
-
-  // in case a buffer doesn't arrive in time
-  if (scope_chunk_ >= scope_chunks_) {
-    scope_chunk_ = 0;
-    gst_buffer_unmap(latest_buffer_, &map);
-    return;
-  }
-
-  const sample_type* source = reinterpret_cast<sample_type*>(map.data);
-  sample_type* dest = scope_.data();
-  source += (chunk_size / sizeof(sample_type)) * scope_chunk_;
-
-  int bytes = 0;
-
-  // make sure we don't go beyond the end of the buffer
-  if (scope_chunk_ == scope_chunks_ - 1) {
-    bytes = qMin(static_cast<Engine::Scope::size_type>(
-                     map.size - (chunk_size * scope_chunk_)),
-                 scope_.size() * sizeof(sample_type));
-  } else {
-    bytes = qMin(static_cast<Engine::Scope::size_type>(chunk_size),
-                 scope_.size() * sizeof(sample_type));
-  }
-
-  scope_chunk_++;
-  memcpy(dest, source, bytes);
-
-  gst_buffer_unmap(latest_buffer_, &map);
-
-  if (scope_chunk_ == scope_chunks_) {
-    gst_buffer_unref(latest_buffer_);
-    latest_buffer_ = nullptr;
-  }
-}
-
 void GstEngine::StartPreloading(const MediaPlaybackRequest& req,
                                 bool force_stop_at_end,
                                 qint64 beginning_nanosec, qint64 end_nanosec) {
@@ -391,6 +455,10 @@ bool GstEngine::Load(const MediaPlaybackRequest& req,
   Engine::Base::Load(req, change, force_stop_at_end, beginning_nanosec,
                      end_nanosec);
 
+  // A gapless track change doesn't go through Play, so look for the end of
+  // the new track here.
+  if (timer_id_ != -1) StartTimers();
+
   bool crossfade =
       current_pipeline_ && ((crossfade_enabled_ && change & Engine::Manual) ||
                             (autocrossfade_enabled_ && change & Engine::Auto) ||
@@ -408,11 +476,24 @@ bool GstEngine::Load(const MediaPlaybackRequest& req,
     return true;
   }
 
-  shared_ptr<GstEnginePipeline> pipeline =
-      CreatePipeline(req, force_stop_at_end ? end_nanosec : 0);
+  const qint64 pipeline_end_nanosec = force_stop_at_end ? end_nanosec : 0;
+  shared_ptr<GstEnginePipeline> pipeline;
+  if (preroll_pipeline_ && preroll_req_.url_ == req.url_ &&
+      preroll_end_nanosec_ == pipeline_end_nanosec) {
+    pipeline.swap(preroll_pipeline_);
+    prerolled_pipeline_id_ = pipeline->id();
+  } else {
+    pipeline = CreatePipeline(req, pipeline_end_nanosec);
+  }
+  // Whatever happened, it's too late to preroll now.
+  preroll_pipeline_.reset();
+  preroll_req_ = MediaPlaybackRequest();
   if (!pipeline) return false;
 
-  if (crossfade) StartFadeout();
+  if (crossfade)
+    StartFadeout();
+  else if (current_pipeline_ && !is_fading_out_to_pause_)
+    RetirePipeline(current_pipeline_);
 
   BufferingFinished();
   current_pipeline_ = pipeline;
@@ -427,9 +508,76 @@ bool GstEngine::Load(const MediaPlaybackRequest& req,
     current_pipeline_->StartFader(fadeout_duration_nanosec_,
                                   QTimeLine::Forward);
 
+  // Build the next track's output bin once this one has got going.
+  if (CanPoolPipelines())
+    QTimer::singleShot(kSparePipelineDelayMsec, this,
+                       SLOT(PrepareSparePipeline()));
+
   return true;
 }
 
+void GstEngine::RetirePipeline(shared_ptr<GstEnginePipeline> pipeline) {
+  if (!CanPoolPipelines()) return;
+
+  // Stop it making any noise or sending any signals, but leave the sink open.
+  disconnect(pipeline.get(), 0, this, 0);
+  pipeline->RemoveAllBufferConsumers();
+  pipeline->ReleaseDecodeBin();
+  pipeline->SetState(GST_STATE_PAUSED);
+
+  retired_pipelines_ << pipeline;
+}
+
+void GstEngine::PrepareSparePipeline() {
+  QList<shared_ptr<GstEnginePipeline>> retired;
+  retired.swap(retired_pipelines_);
+
+  if (spare_pipeline_ || !current_pipeline_ || !CanPoolPipelines()) return;
+
+  for (shared_ptr<GstEnginePipeline> pipeline : retired) {
+    if (pipeline->Recycle()) {
+      ConnectPipeline(pipeline.get());
+      spare_pipeline_ = pipeline;
+      return;
+    }
+  }
+
+  shared_ptr<GstEnginePipeline> pipeline = CreatePipeline();
+  if (pipeline->InitOutput()) {
+    spare_pipeline_ = pipeline;
+  } else {
+    qLog(Debug) << "Couldn't open a spare audio sink, not pooling pipelines";
+  }
+}
+
+void GstEngine::Preroll(const MediaPlaybackRequest& req, qint64 end_nanosec,
+                        qint64 offset_nanosec) {
+  preroll_req_ = req;
+  preroll_end_nanosec_ = end_nanosec;
+  preroll_offset_nanosec_ = offset_nanosec;
+  NewClosure(initialising_, this, SLOT(PrerollNow()));
+}
+
+void GstEngine::PrerollNow() {
+  // A paused pipeline keeps the sink open, which would stop exclusive sinks
+  // from playing anything else.
+  if (!preroll_req_.url_.isValid() || current_pipeline_ ||
+      !CanPoolPipelines()) {
+    return;
+  }
+
+  preroll_pipeline_ = CreatePipeline(preroll_req_, preroll_end_nanosec_);
+  if (!preroll_pipeline_) return;
+
+  // The seek waits until the pipeline has got to PAUSED.
+  preroll_pipeline_->Seek(preroll_offset_nanosec_);
+  preroll_pipeline_->SetState(GST_STATE_PAUSED);
+}
+
+bool GstEngine::CanPoolPipelines() const {
+  return sink_ != "alsasink" && sink_ != "osssink" && sink_ != "oss4sink";
+}
+
 void GstEngine::StartFadeout() {
   if (is_fading_out_to_pause_) return;
 
@@ -506,7 +654,9 @@ void GstEngine::PlayDone(QFuture<GstStateChangeReturn> future,
   StartTimers();
 
   // initial offset
-  if (offset_nanosec != 0 || beginning_nanosec_ != 0) {
+  const bool prerolled = pipeline_id == prerolled_pipeline_id_;
+  prerolled_pipeline_id_ = -1;
+  if (offset_nanosec != 0 || (beginning_nanosec_ != 0 && !prerolled)) {
     Seek(offset_nanosec);
   }
 
@@ -630,6 +780,9 @@ void GstEngine::SeekNow() {
   if (!current_pipeline_->Seek(seek_pos_)) {
     qLog(Warning) << "Seek failed";
   }
+
+  position_clock_->Resync();
+  if (timer_id_ != -1) StartTimers();
 }
 
 void GstEngine::SetEqualizerEnabled(bool enabled) {
@@ -658,9 +811,8 @@ void GstEngine::SetVolumeSW(uint percent) {
 }
 
 void GstEngine::StartTimers() {
-  StopTimers();
-
-  timer_id_ = startTimer(kTimerIntervalNanosec / kNsecPerMsec);
+  length_check_interval_nanosec_ = kTimerIntervalNanosec;
+  ScheduleAboutToEndCheck(kTimerIntervalNanosec);
 }
 
 void GstEngine::StopTimers() {
@@ -670,28 +822,52 @@ void GstEngine::StopTimers() {
   }
 }
 
+void GstEngine::ScheduleAboutToEndCheck(qint64 delay_nanosec) {
+  StopTimers();
+
+  delay_nanosec = qBound(0ll, delay_nanosec, qint64(kMaxCheckIntervalNanosec));
+  timer_id_ = startTimer(delay_nanosec / kNsecPerMsec, Qt::PreciseTimer);
+}
+
 void GstEngine::timerEvent(QTimerEvent* e) {
   if (e->timerId() != timer_id_) return;
 
-  if (current_pipeline_) {
-    const qint64 current_position = position_nanosec();
-    const qint64 current_length = length_nanosec();
-
-    const qint64 remaining = current_length - current_position;
+  // This only wakes up when the end of the track is due, rather than polling
+  // the position.  Anything that wants the position should use
+  // position_clock().
+  if (!current_pipeline_) {
+    StopTimers();
+    return;
+  }
 
-    const qint64 fudge =
-        kTimerIntervalNanosec + 100 * kNsecPerMsec;  // Mmm fudge
-    const qint64 gap = buffer_duration_nanosec_ +
-                       (autocrossfade_enabled_ ? fadeout_duration_nanosec_
-                                               : kPreloadGapNanosec);
+  const qint64 current_length = length_nanosec();
+  if (current_length <= 0) {
+    // We don't know the length yet, or it's a stream that doesn't have one.
+    // Look less and less often.
+    ScheduleAboutToEndCheck(length_check_interval_nanosec_);
+    length_check_interval_nanosec_ =
+        qMin(length_check_interval_nanosec_ * 2, qint64(kMaxCheckIntervalNanosec));
+    return;
+  }
 
-    // only if we know the length of the current stream...
-    if (current_length > 0) {
-      // emit TrackAboutToEnd when we're a few seconds away from finishing
-      if (remaining < gap + fudge) {
-        EmitAboutToEnd();
-      }
-    }
+  const qint64 remaining = current_length - position_nanosec();
+
+  const qint64 fudge = 100 * kNsecPerMsec;  // Mmm fudge
+  // Ask for the next track early enough for it to be prebuffered, too.
+  const qint64 gap = qMax(
+      prebuffer_lookahead_nanosec_,
+      buffer_duration_nanosec_ + (autocrossfade_enabled_
+                                      ? fadeout_duration_nanosec_
+                                      : kPreloadGapNanosec));
+
+  // emit TrackAboutToEnd when we're a few seconds away from finishing
+  if (remaining < gap + fudge) {
+    EmitAboutToEnd();
+    // Nothing more to do until the next track is loaded, but keep the timer
+    // alive so Load knows we're playing.
+    ScheduleAboutToEndCheck(kMaxCheckIntervalNanosec);
+  } else {
+    ScheduleAboutToEndCheck(remaining - gap - fudge);
   }
 }
 
@@ -807,42 +983,53 @@ shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline() {
   ret->set_replaygain(rg_enabled_, rg_mode_, rg_preamp_, rg_compression_);
   ret->set_buffer_duration_nanosec(buffer_duration_nanosec_);
   ret->set_buffer_min_fill(buffer_min_fill_);
+  ret->set_adaptive_buffering(adaptive_buffering_);
   ret->set_mono_playback(mono_playback_);
   ret->set_sample_rate(sample_rate_);
+  ret->set_prebuffering(prebuffer_lookahead_nanosec_ > 0);
+
+  ConnectPipeline(ret.get());
 
-  ret->AddBufferConsumer(this);
+  return ret;
+}
+
+void GstEngine::ConnectPipeline(GstEnginePipeline* pipeline) {
+  pipeline->AddBufferConsumer(this);
   for (BufferConsumer* consumer : buffer_consumers_) {
-    ret->AddBufferConsumer(consumer);
+    pipeline->AddBufferConsumer(consumer);
   }
 
-  connect(ret.get(), SIGNAL(EndOfStreamReached(int, bool)),
+  connect(pipeline, SIGNAL(EndOfStreamReached(int, bool)),
           SLOT(EndOfStreamReached(int, bool)));
-  connect(ret.get(), SIGNAL(Error(int, QString, int, int)),
+  connect(pipeline, SIGNAL(Error(int, QString, int, int)),
           SLOT(HandlePipelineError(int, QString, int, int)));
-  connect(ret.get(), SIGNAL(MetadataFound(int, Engine::SimpleMetaBundle)),
+  connect(pipeline, SIGNAL(MetadataFound(int, Engine::SimpleMetaBundle)),
           SLOT(NewMetaData(int, Engine::SimpleMetaBundle)));
-  connect(ret.get(), SIGNAL(BufferingStarted()), SLOT(BufferingStarted()));
-  connect(ret.get(), SIGNAL(BufferingProgress(int)),
+  connect(pipeline, SIGNAL(BufferingStarted()), SLOT(BufferingStarted()));
+  connect(pipeline, SIGNAL(BufferingProgress(int)),
           SLOT(BufferingProgress(int)));
-  connect(ret.get(), SIGNAL(BufferingFinished()), SLOT(BufferingFinished()));
-
-  return ret;
+  connect(pipeline, SIGNAL(BufferingFinished()), SLOT(BufferingFinished()));
 }
 
 shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline(
     const MediaPlaybackRequest& req, qint64 end_nanosec) {
-  shared_ptr<GstEnginePipeline> ret = CreatePipeline();
-
   if (req.url_.scheme() == "hypnotoad") {
+    shared_ptr<GstEnginePipeline> ret = CreatePipeline();
     ret->InitFromString(kHypnotoadPipeline);
     return ret;
   }
 
   if (req.url_.scheme() == "enterprise") {
+    shared_ptr<GstEnginePipeline> ret = CreatePipeline();
     ret->InitFromString(kEnterprisePipeline);
     return ret;
   }
 
+  // Only the decode bin needs creating if there's a spare output bin.
+  shared_ptr<GstEnginePipeline> ret;
+  ret.swap(spare_pipeline_);
+  if (!ret) ret = CreatePipeline();
+
   if (!ret->InitFromReq(req, end_nanosec)) ret.reset();
 
   return ret;
@@ -851,64 +1038,34 @@ shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline(
 void GstEngine::AddBufferConsumer(BufferConsumer* consumer) {
   buffer_consumers_ << consumer;
   if (current_pipeline_) current_pipeline_->AddBufferConsumer(consumer);
+  if (spare_pipeline_) spare_pipeline_->AddBufferConsumer(consumer);
 }
 
 void GstEngine::RemoveBufferConsumer(BufferConsumer* consumer) {
   buffer_consumers_.removeAll(consumer);
   if (current_pipeline_) current_pipeline_->RemoveBufferConsumer(consumer);
+  if (spare_pipeline_) spare_pipeline_->RemoveBufferConsumer(consumer);
 }
 
-int GstEngine::AddBackgroundStream(shared_ptr<GstEnginePipeline> pipeline) {
-  // We don't want to get metadata messages or end notifications.
-  disconnect(pipeline.get(),
-             SIGNAL(MetadataFound(int, Engine::SimpleMetaBundle)), this, 0);
-  disconnect(pipeline.get(), SIGNAL(EndOfStreamReached(int, bool)), this, 0);
-  connect(pipeline.get(), SIGNAL(EndOfStreamReached(int, bool)),
-          SLOT(BackgroundStreamFinished()));
+int GstEngine::AddBackgroundStream(const QUrl& url) {
+  EnsureInitialised();
 
   const int stream_id = next_background_stream_id_++;
-  background_streams_[stream_id] = pipeline;
-
-  QFuture<GstStateChangeReturn> future = pipeline->SetState(GST_STATE_PLAYING);
-  NewClosure(future, this,
-             SLOT(BackgroundStreamPlayDone(QFuture<GstStateChangeReturn>, int)),
-             future, stream_id);
-  return stream_id;
-}
-
-void GstEngine::BackgroundStreamPlayDone(QFuture<GstStateChangeReturn> future,
-                                         int stream_id) {
-  GstStateChangeReturn ret = future.result();
-
-  if (ret == GST_STATE_CHANGE_FAILURE) {
-    qLog(Warning) << "Could not set thread to PLAYING.";
-    background_streams_.remove(stream_id);
-  }
-}
-
-int GstEngine::AddBackgroundStream(const QUrl& url) {
-  shared_ptr<GstEnginePipeline> pipeline = CreatePipeline(url, 0);
-  if (!pipeline) {
-    return -1;
+  background_mixer_->set_output_device(sink_, device_);
+  if (url.scheme() == "hypnotoad") {
+    background_mixer_->AddGenerator(stream_id, kHypnotoadPipeline);
+  } else if (url.scheme() == "enterprise") {
+    background_mixer_->AddGenerator(stream_id, kEnterprisePipeline);
+  } else {
+    background_mixer_->AddClip(stream_id, url);
   }
-  pipeline->SetVolume(30);
-  pipeline->SetNextReq(url, 0, 0);
-  return AddBackgroundStream(pipeline);
-}
-
-void GstEngine::StopBackgroundStream(int id) {
-  background_streams_.remove(id);  // Removes last shared_ptr reference.
+  return stream_id;
 }
 
-void GstEngine::BackgroundStreamFinished() {
-  GstEnginePipeline* pipeline = qobject_cast<GstEnginePipeline*>(sender());
-  pipeline->SetNextReq(pipeline->url(), 0, 0);
-}
+void GstEngine::StopBackgroundStream(int id) { background_mixer_->Remove(id); }
 
 void GstEngine::SetBackgroundStreamVolume(int id, int volume) {
-  shared_ptr<GstEnginePipeline> pipeline = background_streams_[id];
-  Q_ASSERT(pipeline);
-  pipeline->SetVolume(volume);
+  background_mixer_->SetVolume(id, volume);
 }
 
 void GstEngine::BufferingStarted() {
@@ -934,41 +1091,6 @@ void GstEngine::BufferingFinished() {
 GstEngine::OutputDetailsList GstEngine::GetOutputsList() const {
   const_cast<GstEngine*>(this)->EnsureInitialised();
 
-  OutputDetailsList ret;
-
-  OutputDetails default_output;
-  default_output.description = tr("Choose automatically");
-  default_output.gstreamer_plugin_name = kAutoSink;
-  default_output.device_property_value = QString("");
-  ret.append(default_output);
-
-  for (DeviceFinder* finder : device_finders_) {
-    for (const DeviceFinder::Device& device : finder->ListDevices()) {
-      OutputDetails output;
-      output.description = device.description;
-      output.icon_name = device.icon_name;
-      output.gstreamer_plugin_name = finder->gstreamer_sink();
-      output.device_property_value = device.device_property_value;
-      ret.append(output);
-    }
-  }
-
-  PluginDetailsList plugins = GetPluginList("Sink/Audio");
-  // If there are only 2 plugins (autoaudiosink and the OS' default), don't add
-  // any, since the OS' default would be redundant.
-  if (plugins.count() > 2) {
-    for (const PluginDetails& plugin : plugins) {
-      if (plugin.name == kAutoSink) {
-        continue;
-      }
-
-      OutputDetails output;
-      output.description = tr("Default device on %1").arg(plugin.description);
-      output.gstreamer_plugin_name = plugin.name;
-      output.device_property_value = QString("");
-      ret.append(output);
-    }
-  }
-
-  return ret;
+  QMutexLocker l(&outputs_mutex_);
+  return outputs_;
 }
@@ -29,18 +29,22 @@
 #include <QFuture>
 #include <QHash>
 #include <QList>
+#include <QMutex>
 #include <QString>
 #include <QStringList>
 #include <QTimerEvent>
 
 #include "bufferconsumer.h"
 #include "enginebase.h"
+#include "enginemetrics.h"
+#include "scoperingbuffer.h"
 #include "core/timeconstants.h"
 
 class QTimer;
 class QTimerEvent;
 
 class DeviceFinder;
+class GstBackgroundMixer;
 class GstEnginePipeline;
 class TaskManager;
 
@@ -78,6 +82,13 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   void EnsureInitialised() { initialising_.waitForFinished(); }
   void InitialiseGstreamer();
 
+  // Builds a pipeline for req and pauses it at offset_nanosec as soon as
+  // GStreamer has been initialised, without waiting for it.  If the next
+  // Load is for the same track it uses this pipeline, so playback starts
+  // straight away.  Used to resume playback after a restart.
+  void Preroll(const MediaPlaybackRequest& req, qint64 end_nanosec,
+               qint64 offset_nanosec);
+
   int AddBackgroundStream(const QUrl& url);
   void StopBackgroundStream(int id);
   void SetBackgroundStreamVolume(int id, int volume);
@@ -87,8 +98,13 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   Engine::State state() const;
   const Engine::Scope& scope(int chunk_length);
 
+  // Returns the devices found when the engine started, kept up to date as
+  // devices come and go.  Doesn't block on the audio server.
   OutputDetailsList GetOutputsList() const;
 
+  // Statistics about the current track, for the debug console.
+  EngineMetrics current_metrics() const;
+
   GstElement* CreateElement(const QString& factoryName, GstElement* bin = 0);
 
   // BufferConsumer
@@ -124,6 +140,10 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   GTlsDatabase* tls_database() const { return tls_database_; }
 #endif
 
+signals:
+  // The list returned by GetOutputsList has changed.
+  void OutputsChanged();
+
  protected:
   void SetVolumeSW(uint percent);
   void timerEvent(QTimerEvent*);
@@ -133,18 +153,20 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   void HandlePipelineError(int pipeline_id, const QString& message, int domain,
                            int error_code);
   void NewMetaData(int pipeline_id, const Engine::SimpleMetaBundle& bundle);
-  void AddBufferToScope(GstBuffer* buf, int pipeline_id);
   void FadeoutFinished();
   void FadeoutPauseFinished();
   void SeekNow();
-  void BackgroundStreamFinished();
-  void BackgroundStreamPlayDone(QFuture<GstStateChangeReturn>, int);
   void PlayDone(QFuture<GstStateChangeReturn> future, const quint64, const int);
 
   void BufferingStarted();
   void BufferingProgress(int percent);
   void BufferingFinished();
 
+  void PrepareSparePipeline();
+  void PrerollNow();
+
+  void RefreshOutputsLater();
+
  private:
   struct PluginDetails {
     QString name;
@@ -155,26 +177,44 @@ class GstEngine : public Engine::Base, public BufferConsumer {
 
   PluginDetailsList GetPluginList(const QString& classname) const;
 
+  // Asks every DeviceFinder for its devices, which can take a while, and
+  // replaces outputs_ with the result.  Runs in a background thread.
+  void RefreshOutputs();
+  // Watches for audio devices being plugged in or removed, on platforms
+  // where GStreamer can tell us.
+  void StartDeviceMonitor();
+  static gboolean DeviceMonitorBusCallback(GstBus*, GstMessage*, gpointer);
+
   void StartFadeout();
   void StartFadeoutPause();
 
   void StartTimers();
   void StopTimers();
+  void ScheduleAboutToEndCheck(qint64 delay_nanosec);
 
   std::shared_ptr<GstEnginePipeline> CreatePipeline();
+  void ConnectPipeline(GstEnginePipeline* pipeline);
   std::shared_ptr<GstEnginePipeline> CreatePipeline(
       const MediaPlaybackRequest& req, qint64 end_nanosec);
 
-  void UpdateScope(int chunk_length);
-
-  int AddBackgroundStream(std::shared_ptr<GstEnginePipeline> pipeline);
-
   bool IsCurrentPipeline(int id);
 
+  // Pipelines whose sink holds the device exclusively can't be kept open
+  // alongside the playing one.
+  bool CanPoolPipelines() const;
+  // Keeps a pipeline that was replaced by Load so its output bin can be
+  // reused by PrepareSparePipeline.
+  void RetirePipeline(std::shared_ptr<GstEnginePipeline> pipeline);
+
  private:
   static const qint64 kTimerIntervalNanosec = 1000 * kNsecPerMsec;  // 1s
+  // Checks for the end of the track are at least this often, in case
+  // playback stalls or the length changes.
+  static const qint64 kMaxCheckIntervalNanosec = 30000 * kNsecPerMsec;  // 30s
   static const qint64 kPreloadGapNanosec = 2000 * kNsecPerMsec;     // 2s
   static const qint64 kSeekDelayNanosec = 100 * kNsecPerMsec;       // 100msec
+  static const int kSparePipelineDelayMsec;
+  static const int kOutputsRefreshDelayMsec;
 
   static const char* kHypnotoadPipeline;
   static const char* kEnterprisePipeline;
@@ -192,9 +232,22 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   std::shared_ptr<GstEnginePipeline> fadeout_pause_pipeline_;
   QUrl preloaded_url_;
 
-  QList<BufferConsumer*> buffer_consumers_;
+  // An output bin that's already been built and opened, waiting for the next
+  // call to Load.  Pipelines replaced without a crossfade are recycled into
+  // it rather than torn down.
+  std::shared_ptr<GstEnginePipeline> spare_pipeline_;
+  QList<std::shared_ptr<GstEnginePipeline>> retired_pipelines_;
+
+  // The track given to Preroll, and its pipeline once it's been built.  The
+  // initial seek is skipped when a prerolled pipeline starts playing, since
+  // it's already in the right place.
+  MediaPlaybackRequest preroll_req_;
+  qint64 preroll_end_nanosec_;
+  qint64 preroll_offset_nanosec_;
+  std::shared_ptr<GstEnginePipeline> preroll_pipeline_;
+  int prerolled_pipeline_id_;
 
-  GstBuffer* latest_buffer_;
+  QList<BufferConsumer*> buffer_consumers_;
 
   bool equalizer_enabled_;
   int equalizer_preamp_;
@@ -210,6 +263,14 @@ class GstEngine : public Engine::Base, public BufferConsumer {
 
   int buffer_min_fill_;
 
+  // Size the buffer for each stream rather than always using the duration
+  // above, which becomes the starting point for unfamiliar hosts.
+  bool adaptive_buffering_;
+
+  // How long before the end of a track to start buffering the next one, if
+  // it's a network stream.  0 disables prebuffering.
+  qint64 prebuffer_lookahead_nanosec_;
+
   bool mono_playback_;
   int sample_rate_;
 
@@ -222,18 +283,29 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   quint64 seek_pos_;
 
   int timer_id_;
+  // Doubles while we don't know the length of the track.
+  qint64 length_check_interval_nanosec_;
   int next_element_id_;
 
-  QHash<int, std::shared_ptr<GstEnginePipeline>> background_streams_;
-
   bool is_fading_out_to_pause_;
   bool has_faded_out_;
 
-  int scope_chunk_;
-  bool have_new_buffer_;
-  int scope_chunks_;
+  // Written to by ConsumeBuffer in the streaming threads, read into
+  // next_scope_ by scope() in the GUI thread.
+  ScopeRingBuffer scope_buffer_;
+  Engine::Scope next_scope_;
+
+  GstBackgroundMixer* background_mixer_;
 
   QList<DeviceFinder*> device_finders_;
+  // Only one refresh runs at a time, since the device finders aren't
+  // thread-safe.
+  mutable QMutex outputs_mutex_;
+  OutputDetailsList outputs_;
+  QFuture<void> refreshing_outputs_;
+  QTimer* outputs_refresh_timer_;
+  GstDeviceMonitor* device_monitor_;
+  guint device_monitor_watch_id_;
 
 #ifdef Q_OS_DARWIN
   GTlsDatabase* tls_database_;
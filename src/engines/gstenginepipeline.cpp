@@ -17,8 +17,15 @@
 
 #include "config.h"
 
+#include <gst/controller/gstdirectcontrolbinding.h>
+#include <gst/controller/gstinterpolationcontrolsource.h>
+#include <cmath>
 #include <limits>
 
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#endif
+
 #include <QCoreApplication>
 #include <QDir>
 #include <QPair>
@@ -33,6 +40,7 @@
 #include "core/logging.h"
 #include "core/mac_startup.h"
 #include "core/signalchecker.h"
+#include "core/taskexecutor.h"
 #include "core/utilities.h"
 #ifdef HAVE_AUDIOCD
 #include "devices/cddadevice.h"
@@ -45,13 +53,24 @@
 
 const int GstEnginePipeline::kGstStateTimeoutNanosecs = 10000000;
 const int GstEnginePipeline::kFaderFudgeMsec = 2000;
+const int GstEnginePipeline::kFaderCurveStepMsec = 20;
 
 const int GstEnginePipeline::kEqBandCount = 10;
 const int GstEnginePipeline::kEqBandFrequencies[] = {
     60, 170, 310, 600, 1000, 3000, 6000, 12000, 14000, 16000};
 
+const qint64 GstEnginePipeline::kLocalBufferNanosec = 200 * kNsecPerMsec;
+const qint64 GstEnginePipeline::kMinNetworkBufferNanosec = 1 * kNsecPerSec;
+const qint64 GstEnginePipeline::kMaxNetworkBufferNanosec = 30 * kNsecPerSec;
+const qint64 GstEnginePipeline::kThroughputSampleNanosec = 1 * kNsecPerSec;
+const int GstEnginePipeline::kMinThroughputSamples = 5;
+
 int GstEnginePipeline::sId = 1;
 GstElementDeleter* GstEnginePipeline::sElementDeleter = nullptr;
+QAtomicInt GstEnginePipeline::sPrebufferReady;
+QAtomicInt GstEnginePipeline::sPrebufferLate;
+QMutex GstEnginePipeline::sHostBufferMutex;
+QHash<QString, qint64> GstEnginePipeline::sHostBufferNanosec;
 
 GstEnginePipeline::GstEnginePipeline(GstEngine* engine)
     : QObject(nullptr),
@@ -74,8 +93,27 @@ GstEnginePipeline::GstEnginePipeline(GstEngine* engine)
       buffer_duration_nanosec_(1 * kNsecPerSec),
       buffer_min_fill_(33),
       buffering_(false),
+      adaptive_buffering_(false),
       mono_playback_(false),
       sample_rate_(GstEngine::kAutoSampleRate),
+      prebuffering_(false),
+      prebuffer_bin_(nullptr),
+      prebuffer_bus_(nullptr),
+      prebuffer_pad_(nullptr),
+      prebuffer_probe_id_(0),
+      prebuffer_blocked_(false),
+      prebuffer_percent_(-1),
+      prebuffer_failed_(false),
+      network_probe_pad_(nullptr),
+      network_probe_id_(0),
+      queue_duration_nanosec_(0),
+      stream_bytes_per_sec_(-1),
+      throughput_sample_bytes_(0),
+      throughput_samples_(0),
+      throughput_mean_(0),
+      throughput_m2_(0),
+      deficit_nanosec_(0),
+      max_deficit_nanosec_(0),
       end_offset_nanosec_(-1),
       next_beginning_offset_nanosec_(-1),
       next_end_offset_nanosec_(-1),
@@ -85,8 +123,23 @@ GstEnginePipeline::GstEnginePipeline(GstEngine* engine)
       pipeline_is_connected_(false),
       pending_seek_nanosec_(-1),
       last_known_position_ns_(0),
+      seek_index_parser_(nullptr),
+      seek_index_probe_id_(0),
+      seek_index_recording_(false),
+      seek_index_seek_pending_(false),
+      seek_index_entry_nanosec_(-1),
+      seek_index_target_nanosec_(-1),
+      seek_index_rebase_nanosec_(0),
       volume_percent_(100),
       volume_modifier_(1.0),
+      fader_curve_(nullptr),
+      fader_running_(false),
+      fader_duration_msec_(0),
+      fader_start_time_msec_(0),
+      fader_start_nanosec_(0),
+      fader_direction_(QTimeLine::Forward),
+      fader_shape_(QTimeLine::LinearCurve),
+      use_fudge_timer_(false),
       pipeline_(nullptr),
       uridecodebin_(nullptr),
       audiobin_(nullptr),
@@ -98,6 +151,7 @@ GstEnginePipeline::GstEnginePipeline(GstEngine* engine)
       equalizer_(nullptr),
       stereo_panorama_(nullptr),
       volume_(nullptr),
+      fader_volume_(nullptr),
       audioscale_(nullptr),
       audiosink_(nullptr),
       tee_(nullptr),
@@ -133,21 +187,25 @@ void GstEnginePipeline::set_buffer_min_fill(int percent) {
   buffer_min_fill_ = percent;
 }
 
+void GstEnginePipeline::set_adaptive_buffering(bool enabled) {
+  adaptive_buffering_ = enabled;
+}
+
 void GstEnginePipeline::set_mono_playback(bool enabled) {
   mono_playback_ = enabled;
 }
 
 void GstEnginePipeline::set_sample_rate(int rate) { sample_rate_ = rate; }
 
+void GstEnginePipeline::set_prebuffering(bool enabled) {
+  prebuffering_ = enabled;
+}
+
 bool GstEnginePipeline::ReplaceDecodeBin(GstElement* new_bin) {
   if (!new_bin) return false;
 
-  // Destroy the old elements if they are set
-  // Note that the caller to this function MUST schedule the old uridecodebin_
-  // for deletion in the main thread.
-  if (uridecodebin_) {
-    gst_bin_remove(GST_BIN(pipeline_), uridecodebin_);
-  }
+  // Callers should have detached the old bin already, but don't leak it.
+  if (uridecodebin_) sElementDeleter->DeleteElementLater(DetachDecodeBin());
 
   uridecodebin_ = new_bin;
   segment_start_ = 0;
@@ -160,7 +218,42 @@ bool GstEnginePipeline::ReplaceDecodeBin(GstElement* new_bin) {
 
 bool GstEnginePipeline::ReplaceDecodeBin(const QUrl& url) {
   GstElement* new_bin = CreateDecodeBinFromUrl(url);
-  return ReplaceDecodeBin(new_bin);
+  if (!ReplaceDecodeBin(new_bin)) return false;
+  StartSeekIndex(url, new_bin);
+  return true;
+}
+
+GstElement* GstEnginePipeline::DetachDecodeBin() {
+  if (!uridecodebin_) return nullptr;
+  GstElement* bin = uridecodebin_;
+  uridecodebin_ = nullptr;
+
+  // The bin is stopped in the background and can outlive this pipeline.
+  g_signal_handlers_disconnect_matched(G_OBJECT(bin), G_SIGNAL_MATCH_DATA, 0,
+                                       0, nullptr, nullptr, this);
+  {
+    QMutexLocker l(&metrics_mutex_);
+    RemoveNetworkProbe();
+  }
+  FinishSeekIndex();
+
+  // The pipeline's reference is dropped when it's removed.
+  gst_object_ref(bin);
+  gst_bin_remove(GST_BIN(pipeline_), bin);
+  return bin;
+}
+
+void GstEnginePipeline::RemoveNetworkProbe() {
+  if (!network_probe_pad_) return;
+  gst_pad_remove_probe(network_probe_pad_, network_probe_id_);
+  gst_object_unref(network_probe_pad_);
+  network_probe_pad_ = nullptr;
+  network_probe_id_ = 0;
+}
+
+void GstEnginePipeline::ReleaseDecodeBin() {
+  ClearPrebuffer();
+  sElementDeleter->DeleteElementLater(DetachDecodeBin());
 }
 
 QByteArray GstEnginePipeline::GstUriFromUrl(const QUrl& url) {
@@ -262,8 +355,10 @@ bool GstEnginePipeline::Init() {
   // samples for the scope, the other is kept as float32 and sent to the
   // speaker.
   //   tee1 ! probe_queue ! probe_converter ! <caps16> ! probe_sink
-  //   tee2 ! audio_queue ! equalizer_preamp ! equalizer ! volume ! audioscale
-  //        ! convert ! audiosink
+  //   tee2 ! audio_queue ! equalizer ! audiopanorama ! volume ! fader_volume
+  //        ! audioscale ! convert ! audiosink
+  // The equalizer's preamp is applied by volume, rather than by a volume
+  // element of its own, so that's one less pass over every buffer.
 
   gst_segment_init(&last_decodebin_segment_, GST_FORMAT_TIME);
 
@@ -316,16 +411,16 @@ bool GstEnginePipeline::Init() {
   probe_sink = engine_->CreateElement("fakesink", audiobin_);
 
   audio_queue = engine_->CreateElement("queue", audiobin_);
-  equalizer_preamp_ = engine_->CreateElement("volume", audiobin_);
   equalizer_ = engine_->CreateElement("equalizer-nbands", audiobin_);
   stereo_panorama_ = engine_->CreateElement("audiopanorama", audiobin_);
   volume_ = engine_->CreateElement("volume", audiobin_);
+  fader_volume_ = engine_->CreateElement("volume", audiobin_);
   audioscale_ = engine_->CreateElement("audioresample", audiobin_);
   convert = engine_->CreateElement("audioconvert", audiobin_);
 
   if (!queue_ || !audioconvert_ || !tee_ || !probe_queue || !probe_converter ||
-      !probe_sink || !audio_queue || !equalizer_preamp_ || !equalizer_ ||
-      !stereo_panorama_ || !volume_ || !audioscale_ || !convert) {
+      !probe_sink || !audio_queue || !equalizer_ || !stereo_panorama_ ||
+      !volume_ || !fader_volume_ || !audioscale_ || !convert) {
     qLog(Error) << "Failed to create elements";
     return false;
   }
@@ -411,6 +506,7 @@ bool GstEnginePipeline::Init() {
                  "gain", 0.0f, nullptr);
     g_object_unref(G_OBJECT(band));
   }
+  applied_eq_gains_.fill(0.0f, kEqBandCount);
 
   // Set the stereo balance.
   g_object_set(G_OBJECT(stereo_panorama_), "panorama", stereo_balance_,
@@ -426,6 +522,7 @@ bool GstEnginePipeline::Init() {
   g_object_set(G_OBJECT(queue_), "max-size-time", buffer_duration_nanosec_,
                nullptr);
   g_object_set(G_OBJECT(queue_), "low-percent", buffer_min_fill_, nullptr);
+  queue_duration_nanosec_ = buffer_duration_nanosec_;
 
   if (buffer_duration_nanosec_ > 0) {
     g_object_set(G_OBJECT(queue_), "use-buffering", true, nullptr);
@@ -460,9 +557,20 @@ bool GstEnginePipeline::Init() {
   gst_element_link_filtered(probe_queue, probe_converter, caps16);
   gst_caps_unref(caps16);
 
-  gst_element_link_many(audio_queue, equalizer_preamp_, equalizer_,
-                        stereo_panorama_, volume_, audioscale_, convert,
-                        nullptr);
+  gst_element_link_many(audio_queue, equalizer_, stereo_panorama_, volume_,
+                        fader_volume_, audioscale_, convert, nullptr);
+
+  // Fades are a curve on fader_volume_'s volume, which the element follows
+  // sample by sample as the audio passes through it.
+  fader_curve_ = gst_interpolation_control_source_new();
+  g_object_set(G_OBJECT(fader_curve_), "mode",
+               GST_INTERPOLATION_MODE_LINEAR, nullptr);
+  gst_object_add_control_binding(
+      GST_OBJECT(fader_volume_),
+      gst_direct_control_binding_new_absolute(GST_OBJECT(fader_volume_),
+                                              "volume", fader_curve_));
+  gst_object_set_control_binding_disabled(GST_OBJECT(fader_volume_), "volume",
+                                          TRUE);
 
   // We only limit the media type to raw audio.
   // Let the audio output of the tee autonegotiate the bit depth and format.
@@ -523,9 +631,76 @@ bool GstEnginePipeline::InitFromString(const QString& pipeline) {
   return gst_element_link(new_bin, audiobin_);
 }
 
+bool GstEnginePipeline::InitOutput() {
+  pipeline_ = gst_pipeline_new("pipeline");
+  if (!Init()) return false;
+
+  return gst_element_set_state(pipeline_, GST_STATE_READY) !=
+         GST_STATE_CHANGE_FAILURE;
+}
+
+bool GstEnginePipeline::Recycle() {
+  if (!pipeline_ || !audiobin_) return false;
+
+  ClearPrebuffer();
+  FinishSeekIndex();
+  StopFader();
+  fader_fudge_timer_.stop();
+  ResetMetrics();
+
+  // The decode bin is stopped in the background, so only the output bin has
+  // to change state here.
+  sElementDeleter->DeleteElementLater(DetachDecodeBin());
+
+  // READY keeps the sink open, which is the expensive part to set up again.
+  if (gst_element_set_state(pipeline_, GST_STATE_READY) ==
+      GST_STATE_CHANGE_FAILURE) {
+    return false;
+  }
+
+  // Anything still on the bus belongs to the last track.
+  GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+  gst_bus_set_flushing(bus, TRUE);
+  gst_bus_set_flushing(bus, FALSE);
+  gst_object_unref(bus);
+
+  // Signals queued for the old track carry the old id, so a new one is enough
+  // to make the engine ignore them.
+  id_ = sId++;
+
+  current_ = MediaPlaybackRequest();
+  next_ = MediaPlaybackRequest();
+  end_offset_nanosec_ = -1;
+  next_beginning_offset_nanosec_ = -1;
+  next_end_offset_nanosec_ = -1;
+  segment_start_ = 0;
+  segment_start_received_ = false;
+  emit_track_ended_on_stream_start_ = false;
+  emit_track_ended_on_time_discontinuity_ = false;
+  last_buffer_offset_ = 0;
+  ignore_next_seek_ = false;
+  ignore_tags_ = false;
+  redirect_url_ = QUrl();
+  source_device_.clear();
+  buffering_ = false;
+  pipeline_is_initialised_ = false;
+  pipeline_is_connected_ = false;
+  pending_seek_nanosec_ = -1;
+  last_known_position_ns_ = 0;
+  gst_segment_init(&last_decodebin_segment_, GST_FORMAT_TIME);
+
+  volume_modifier_ = 1.0;
+  UpdateVolume();
+
+  return true;
+}
+
 bool GstEnginePipeline::InitFromReq(const MediaPlaybackRequest& req,
                                     qint64 end_nanosec) {
-  pipeline_ = gst_pipeline_new("pipeline");
+  // Pipelines from InitOutput or Recycle already have everything but the
+  // decode bin.
+  const bool has_output = audiobin_ != nullptr;
+  if (!has_output) pipeline_ = gst_pipeline_new("pipeline");
 
   current_ = req;
   QUrl url = current_.url_;
@@ -545,17 +720,42 @@ bool GstEnginePipeline::InitFromReq(const MediaPlaybackRequest& req,
 
   // Decode bin
   if (!ReplaceDecodeBin(url)) return false;
+  if (!has_output && !Init()) return false;
 
-  return Init();
+  // Time to first audio is measured from here to the sink.
+  ResetMetrics();
+  {
+    QMutexLocker l(&metrics_mutex_);
+    request_timer_.start();
+  }
+  if (adaptive_buffering_) {
+    SetQueueDuration(InitialBufferNanosec(current_.url_),
+                     !IsLocalUrl(current_.url_));
+  }
+  GstPad* pad = gst_element_get_static_pad(audiosink_, "sink");
+  if (pad) {
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, &FirstAudioProbe, this,
+                      nullptr);
+    gst_object_unref(pad);
+  }
+
+  return true;
 }
 
 GstEnginePipeline::~GstEnginePipeline() {
+  ClearPrebuffer();
+  FinishSeekIndex();
+  ResetMetrics();
+
   if (pipeline_) {
     GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
     gst_bus_set_sync_handler(bus, nullptr, nullptr, nullptr);
     gst_object_unref(bus);
 
     g_source_remove(bus_cb_id_);
+    // Stopping the decode bin can wait on the network, so leave it to the
+    // deleter and only stop the output bin here.
+    sElementDeleter->DeleteElementLater(DetachDecodeBin());
     gst_element_set_state(pipeline_, GST_STATE_NULL);
 
     if (tee_) {
@@ -573,6 +773,8 @@ GstEnginePipeline::~GstEnginePipeline() {
 
     gst_object_unref(GST_OBJECT(pipeline_));
   }
+
+  if (fader_curve_) gst_object_unref(fader_curve_);
 }
 
 gboolean GstEnginePipeline::BusCallback(GstBus*, GstMessage* msg,
@@ -666,6 +868,39 @@ void GstEnginePipeline::StreamStatusMessageReceived(GstMessage* msg) {
       gst_task_set_enter_callback(task, &TaskEnterCallback, this, NULL);
     }
   }
+
+#ifdef Q_OS_LINUX
+  // ENTER and LEAVE are posted from the streaming thread itself, so we can
+  // measure its CPU time.  Threads come from a pool and get reused, so only
+  // the time since ENTER counts.
+  if (type != GST_STREAM_STATUS_TYPE_ENTER &&
+      type != GST_STREAM_STATUS_TYPE_LEAVE) {
+    return;
+  }
+
+  clockid_t clock;
+  if (pthread_getcpuclockid(pthread_self(), &clock) != 0) return;
+  const qint64 cpu_nanosec = ThreadCpuNanosec(clock);
+
+  QMutexLocker l(&metrics_mutex_);
+  if (type == GST_STREAM_STATUS_TYPE_ENTER) {
+    StreamThread thread;
+    thread.element_ = QString::fromUtf8(GST_ELEMENT_NAME(owner));
+    thread.clock_ = clock;
+    thread.cpu_at_enter_nanosec_ = cpu_nanosec;
+    stream_threads_ << thread;
+  } else {
+    for (int i = 0; i < stream_threads_.count(); ++i) {
+      const StreamThread& thread = stream_threads_[i];
+      if (thread.clock_ == clock) {
+        finished_thread_cpu_nanosec_[thread.element_] +=
+            cpu_nanosec - thread.cpu_at_enter_nanosec_;
+        stream_threads_.removeAt(i);
+        break;
+      }
+    }
+  }
+#endif
 }
 
 void GstEnginePipeline::TaskEnterCallback(GstTask*, GThread*, gpointer) {
@@ -761,6 +996,13 @@ void GstEnginePipeline::TagMessageReceived(GstMessage* msg) {
     bundle.album = ParseTag(taglist, GST_TAG_ALBUM);
   }
 
+  guint bitrate = 0;
+  if (gst_tag_list_get_uint(taglist, GST_TAG_BITRATE, &bitrate) ||
+      gst_tag_list_get_uint(taglist, GST_TAG_NOMINAL_BITRATE, &bitrate)) {
+    QMutexLocker l(&metrics_mutex_);
+    if (bitrate > 0) stream_bytes_per_sec_ = bitrate / 8;
+  }
+
   gst_tag_list_free(taglist);
 
   if (ignore_tags_) return;
@@ -825,24 +1067,70 @@ void GstEnginePipeline::BufferingMessageReceived(GstMessage* msg) {
 
   const GstState current_state = state();
 
+  if (current_state == GST_STATE_PLAYING && !buffering_) {
+    // The queue filling up before playback starts doesn't count.
+    QMutexLocker l(&metrics_mutex_);
+    if (metrics_.min_queue_fill_percent_ == -1 ||
+        percent < metrics_.min_queue_fill_percent_) {
+      metrics_.min_queue_fill_percent_ = percent;
+    }
+  }
+
   if (percent == 0 && current_state == GST_STATE_PLAYING && !buffering_) {
     buffering_ = true;
     emit BufferingStarted();
 
+    qint64 grow_to_nanosec = -1;
+    {
+      QMutexLocker l(&metrics_mutex_);
+      metrics_.underruns_++;
+      stall_timer_.start();
+      const qint64 wanted_nanosec = AdaptiveBufferNanosec();
+      if (adaptive_buffering_ && wanted_nanosec > queue_duration_nanosec_) {
+        grow_to_nanosec = wanted_nanosec;
+      }
+    }
+    if (grow_to_nanosec != -1) SetQueueDuration(grow_to_nanosec, true);
+    qLog(Info) << id() << "buffer underrun playing"
+               << Utilities::ScrubUrlQueries(current_.url_.toString());
+
     SetState(GST_STATE_PAUSED);
   } else if (percent == 100 && buffering_) {
     buffering_ = false;
     emit BufferingFinished();
 
+    {
+      QMutexLocker l(&metrics_mutex_);
+      if (stall_timer_.isValid()) {
+        metrics_.stalled_nanosec_ += stall_timer_.nsecsElapsed();
+        stall_timer_.invalidate();
+      }
+    }
+
     SetState(GST_STATE_PLAYING);
   } else if (buffering_) {
     emit BufferingProgress(percent);
   }
 }
 
-void GstEnginePipeline::NewPadCallback(GstElement*, GstPad* pad,
+void GstEnginePipeline::NewPadCallback(GstElement* bin, GstPad* pad,
                                        gpointer self) {
   GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
+
+  {
+    // Hold the next track's data back until it's added to the pipeline.
+    QMutexLocker l(&instance->prebuffer_mutex_);
+    if (bin == instance->prebuffer_bin_) {
+      if (!instance->prebuffer_pad_) {
+        instance->prebuffer_pad_ = GST_PAD(gst_object_ref(pad));
+        instance->prebuffer_probe_id_ = gst_pad_add_probe(
+            pad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM, PrebufferBlockProbe,
+            instance, nullptr);
+      }
+      return;
+    }
+  }
+
   GstPad* const audiopad =
       gst_element_get_static_pad(instance->audiobin_, "sink");
 
@@ -1050,7 +1338,27 @@ void GstEnginePipeline::SourceSetupCallback(GstURIDecodeBin* bin,
                  instance->source_device().toLocal8Bit().constData(), nullptr);
   }
 
+  bool is_prebuffer;
+  {
+    QMutexLocker l(&instance->prebuffer_mutex_);
+    is_prebuffer = GST_ELEMENT(bin) == instance->prebuffer_bin_;
+  }
+
   if (g_object_class_find_property(G_OBJECT_GET_CLASS(element), "user-agent")) {
+    // This is a network source, so count what it downloads.  Prebuffered
+    // data isn't counted.
+    GstPad* pad = gst_element_get_static_pad(element, "src");
+    if (pad && !is_prebuffer) {
+      const gulong probe_id =
+          gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, &NetworkBytesProbe,
+                            instance, nullptr);
+      QMutexLocker l(&instance->metrics_mutex_);
+      instance->RemoveNetworkProbe();
+      instance->network_probe_pad_ = GST_PAD(gst_object_ref(pad));
+      instance->network_probe_id_ = probe_id;
+    }
+    if (pad) gst_object_unref(pad);
+
     QString user_agent =
         QString("%1 %2").arg(QCoreApplication::applicationName(),
                              QCoreApplication::applicationVersion());
@@ -1067,9 +1375,12 @@ void GstEnginePipeline::SourceSetupCallback(GstURIDecodeBin* bin,
 
   if (g_object_class_find_property(G_OBJECT_GET_CLASS(element),
                                    "extra-headers")) {
-    if (!instance->current_.headers_.empty()) {
+    const MediaPlaybackRequest::HeaderList& headers =
+        is_prebuffer ? instance->next_.headers_ : instance->current_.headers_;
+
+    if (!headers.empty()) {
       GstStructure* gheaders = gst_structure_new_empty("headers");
-      QMapIterator<QByteArray, QByteArray> i(instance->current_.headers_);
+      QMapIterator<QByteArray, QByteArray> i(headers);
       while (i.hasNext()) {
         i.next();
         qLog(Debug) << "Adding header" << i.key();
@@ -1084,17 +1395,278 @@ void GstEnginePipeline::SourceSetupCallback(GstURIDecodeBin* bin,
   g_object_unref(element);
 }
 
+GstPadProbeReturn GstEnginePipeline::FirstAudioProbe(GstPad*, GstPadProbeInfo*,
+                                                     gpointer self) {
+  GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
+
+  QMutexLocker l(&instance->metrics_mutex_);
+  if (instance->request_timer_.isValid() &&
+      instance->metrics_.time_to_first_audio_nanosec_ == -1) {
+    instance->metrics_.time_to_first_audio_nanosec_ =
+        instance->request_timer_.nsecsElapsed();
+  }
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+GstPadProbeReturn GstEnginePipeline::NetworkBytesProbe(GstPad*,
+                                                       GstPadProbeInfo* info,
+                                                       gpointer self) {
+  GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
+  GstBuffer* buf = gst_pad_probe_info_get_buffer(info);
+
+  const qint64 bytes = gst_buffer_get_size(buf);
+  qint64 grow_to_nanosec = -1;
+  {
+    QMutexLocker l(&instance->metrics_mutex_);
+    if (!instance->network_timer_.isValid()) instance->network_timer_.start();
+    instance->metrics_.network_bytes_ += bytes;
+
+    if (!instance->throughput_timer_.isValid()) {
+      instance->throughput_timer_.start();
+    }
+    instance->throughput_sample_bytes_ += bytes;
+
+    const qint64 elapsed_nanosec = instance->throughput_timer_.nsecsElapsed();
+    if (elapsed_nanosec >= kThroughputSampleNanosec) {
+      instance->AddThroughputSample(elapsed_nanosec);
+      const qint64 wanted_nanosec = instance->AdaptiveBufferNanosec();
+      if (instance->adaptive_buffering_ &&
+          wanted_nanosec > instance->queue_duration_nanosec_) {
+        grow_to_nanosec = wanted_nanosec;
+      }
+    }
+  }
+
+  // Only ever grow the queue mid-stream, shrinking it would throw away audio
+  // that's already been downloaded.  The next stream from this host starts
+  // with a smaller one if it turns out this one didn't need it.
+  if (grow_to_nanosec != -1) {
+    qLog(Debug) << instance->id() << "growing buffer to"
+                << grow_to_nanosec / kNsecPerMsec << "ms";
+    instance->SetQueueDuration(grow_to_nanosec, true);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+void GstEnginePipeline::AddThroughputSample(qint64 elapsed_nanosec) {
+  const qint64 bytes = throughput_sample_bytes_;
+  throughput_sample_bytes_ = 0;
+  throughput_timer_.start();
+
+  // The first second includes the connection's initial burst, which says
+  // nothing about how steady the stream is.
+  if (metrics_.network_bytes_ == bytes) return;
+
+  const double bytes_per_sec = double(bytes) * kNsecPerSec / elapsed_nanosec;
+  throughput_samples_++;
+  const double delta = bytes_per_sec - throughput_mean_;
+  throughput_mean_ += delta / throughput_samples_;
+  throughput_m2_ += delta * (bytes_per_sec - throughput_mean_);
+
+  if (stream_bytes_per_sec_ > 0) {
+    const qint64 audio_nanosec = bytes * kNsecPerSec / stream_bytes_per_sec_;
+    deficit_nanosec_ =
+        qMax(qint64(0), deficit_nanosec_ + elapsed_nanosec - audio_nanosec);
+    max_deficit_nanosec_ = qMax(max_deficit_nanosec_, deficit_nanosec_);
+  }
+}
+
+qint64 GstEnginePipeline::AdaptiveBufferNanosec() const {
+  if (throughput_samples_ < kMinThroughputSamples) return -1;
+
+  const double bytes_per_sec = stream_bytes_per_sec_ > 0
+                                   ? double(stream_bytes_per_sec_)
+                                   : throughput_mean_;
+  if (bytes_per_sec <= 0) return -1;
+
+  // Enough to ride out twice the longest the stream has fallen behind for,
+  // plus a few seconds' worth of its typical wobble in throughput relative to
+  // its bitrate, plus another buffer's worth for each underrun.
+  const double stddev =
+      std::sqrt(throughput_m2_ / qMax(1, throughput_samples_ - 1));
+  const qint64 jitter_nanosec =
+      qint64(4 * stddev / bytes_per_sec * kNsecPerSec);
+
+  const qint64 ret = kMinNetworkBufferNanosec + 2 * max_deficit_nanosec_ +
+                     jitter_nanosec +
+                     metrics_.underruns_ * qint64(buffer_duration_nanosec_);
+  return qBound(qint64(kMinNetworkBufferNanosec), ret,
+                qint64(kMaxNetworkBufferNanosec));
+}
+
+bool GstEnginePipeline::IsLocalUrl(const QUrl& url) {
+  return url.scheme() == "file" || url.scheme() == "cdda";
+}
+
+qint64 GstEnginePipeline::InitialBufferNanosec(const QUrl& url) const {
+  if (IsLocalUrl(url)) return kLocalBufferNanosec;
+
+  QMutexLocker l(&sHostBufferMutex);
+  return sHostBufferNanosec.value(
+      url.host(), qMax(qint64(buffer_duration_nanosec_),
+                       qint64(kMinNetworkBufferNanosec)));
+}
+
+void GstEnginePipeline::SetQueueDuration(qint64 nanosec, bool use_buffering) {
+  if (!queue_) return;
+
+  {
+    QMutexLocker l(&metrics_mutex_);
+    queue_duration_nanosec_ = nanosec;
+  }
+  g_object_set(G_OBJECT(queue_), "max-size-time", guint64(nanosec),
+               "use-buffering", gboolean(use_buffering), nullptr);
+}
+
+#ifdef Q_OS_LINUX
+qint64 GstEnginePipeline::ThreadCpuNanosec(clockid_t clock) {
+  timespec time;
+  if (clock_gettime(clock, &time) != 0) return 0;
+  return qint64(time.tv_sec) * kNsecPerSec + time.tv_nsec;
+}
+#endif
+
+EngineMetrics GstEnginePipeline::metrics() const {
+  EngineMetrics ret;
+  {
+    QMutexLocker l(&metrics_mutex_);
+    ret = metrics_;
+    ret.queue_size_nanosec_ = queue_duration_nanosec_;
+    if (stall_timer_.isValid()) {
+      ret.stalled_nanosec_ += stall_timer_.nsecsElapsed();
+    }
+    if (network_timer_.isValid()) {
+      ret.network_nanosec_ = network_timer_.nsecsElapsed();
+    }
+
+#ifdef Q_OS_LINUX
+    QMap<QString, qint64> cpu_nanosec = finished_thread_cpu_nanosec_;
+    for (const StreamThread& thread : stream_threads_) {
+      cpu_nanosec[thread.element_] +=
+          ThreadCpuNanosec(thread.clock_) - thread.cpu_at_enter_nanosec_;
+    }
+    for (auto it = cpu_nanosec.constBegin(); it != cpu_nanosec.constEnd();
+         ++it) {
+      ret.element_cpu_nanosec_ << qMakePair(it.key(), it.value());
+    }
+#endif
+  }
+
+  ret.pipeline_id_ = id();
+  ret.url_ = current_.url_;
+
+  if (queue_ && ret.queue_size_nanosec_ > 0) {
+    guint64 level_nanosec = 0;
+    g_object_get(queue_, "current-level-time", &level_nanosec, nullptr);
+    ret.queue_fill_percent_ =
+        qMin(quint64(100),
+             quint64(level_nanosec) * 100 / quint64(ret.queue_size_nanosec_));
+  }
+
+  if (pipeline_) {
+    GstQuery* query = gst_query_new_latency();
+    if (gst_element_query(pipeline_, query)) {
+      gboolean live = false;
+      GstClockTime min_latency = 0;
+      GstClockTime max_latency = 0;
+      gst_query_parse_latency(query, &live, &min_latency, &max_latency);
+      ret.pipeline_latency_nanosec_ = min_latency;
+    }
+    gst_query_unref(query);
+  }
+
+  // autoaudiosink is a bin around the real sink.
+  GstElement* sink = audiosink_ ? GST_ELEMENT(gst_object_ref(audiosink_))
+                                : nullptr;
+  if (sink && GST_IS_BIN(sink)) {
+    GstIterator* it = gst_bin_iterate_sinks(GST_BIN(sink));
+    GValue item = G_VALUE_INIT;
+    gst_object_unref(sink);
+    sink = nullptr;
+    if (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+      sink = GST_ELEMENT(g_value_dup_object(&item));
+      g_value_unset(&item);
+    }
+    gst_iterator_free(it);
+  }
+  if (sink) {
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(sink),
+                                     "buffer-time")) {
+      gint64 buffer_usec = 0;
+      g_object_get(sink, "buffer-time", &buffer_usec, nullptr);
+      ret.sink_buffer_nanosec_ = buffer_usec * kNsecPerUsec;
+    }
+    gst_object_unref(sink);
+  }
+
+  return ret;
+}
+
+void GstEnginePipeline::ResetMetrics() {
+  if (request_timer_.isValid() && current_.url_.isValid()) {
+    for (const QString& line : metrics().ToStrings()) {
+      qLog(Info) << line;
+    }
+  }
+
+  QMutexLocker l(&metrics_mutex_);
+  if (adaptive_buffering_ && !current_.url_.host().isEmpty()) {
+    const qint64 learned_nanosec = AdaptiveBufferNanosec();
+    if (learned_nanosec != -1) {
+      QMutexLocker host_l(&sHostBufferMutex);
+      sHostBufferNanosec[current_.url_.host()] = learned_nanosec;
+    }
+  }
+
+  metrics_ = EngineMetrics();
+  request_timer_.invalidate();
+  stall_timer_.invalidate();
+  network_timer_.invalidate();
+  stream_bytes_per_sec_ = -1;
+  throughput_timer_.invalidate();
+  throughput_sample_bytes_ = 0;
+  throughput_samples_ = 0;
+  throughput_mean_ = 0;
+  throughput_m2_ = 0;
+  deficit_nanosec_ = 0;
+  max_deficit_nanosec_ = 0;
+
+#ifdef Q_OS_LINUX
+  finished_thread_cpu_nanosec_.clear();
+  for (StreamThread& thread : stream_threads_) {
+    thread.cpu_at_enter_nanosec_ = ThreadCpuNanosec(thread.clock_);
+  }
+#endif
+}
+
 void GstEnginePipeline::TransitionToNext() {
-  GstElement* old_decode_bin = uridecodebin_;
+  GstElement* old_decode_bin = DetachDecodeBin();
 
   ignore_tags_ = true;
 
-  if (!ReplaceDecodeBin(next_.url_)) {
-    qLog(Error) << "ReplaceDecodeBin failed with " << next_.url_;
-    return;
+  if (!TakePrebuffer(next_.url_)) {
+    if (!ReplaceDecodeBin(next_.url_)) {
+      qLog(Error) << "ReplaceDecodeBin failed with " << next_.url_;
+      sElementDeleter->DeleteElementLater(old_decode_bin);
+      ignore_tags_ = false;
+      return;
+    }
+    gst_element_set_state(uridecodebin_, GST_STATE_PLAYING);
+    MaybeLinkDecodeToAudio();
+  }
+
+  // The next track's data is already queued up, so there's no time to first
+  // audio to measure for it.
+  ResetMetrics();
+  {
+    QMutexLocker l(&metrics_mutex_);
+    request_timer_.start();
+  }
+  if (adaptive_buffering_) {
+    SetQueueDuration(InitialBufferNanosec(next_.url_), !IsLocalUrl(next_.url_));
   }
-  gst_element_set_state(uridecodebin_, GST_STATE_PLAYING);
-  MaybeLinkDecodeToAudio();
 
   current_ = next_;
   end_offset_nanosec_ = next_end_offset_nanosec_;
@@ -1114,6 +1686,324 @@ void GstEnginePipeline::TransitionToNext() {
   ignore_tags_ = false;
 }
 
+void GstEnginePipeline::StartSeekIndex(const QUrl& url, GstElement* bin) {
+  FinishSeekIndex();
+
+  const QString scheme = url.scheme();
+  if (scheme == "cdda" || scheme == "spotify") return;
+
+  const SeekIndex index = SeekIndex::Load(url);
+
+  QMutexLocker l(&seek_index_mutex_);
+  seek_index_url_ = url;
+  seek_index_ = index;
+  seek_index_recording_ = true;
+  CHECKED_GCONNECT(G_OBJECT(bin), "deep-element-added",
+                   &SeekIndexElementAdded, this);
+}
+
+void GstEnginePipeline::FinishSeekIndex() {
+  QMutexLocker l(&seek_index_mutex_);
+  if (seek_index_.is_dirty()) {
+    const QUrl url = seek_index_url_;
+    const SeekIndex index = seek_index_;
+    TaskExecutor::Instance()->Run<void>(
+        TaskExecutor::Lane_Background,
+        [url, index]() { SeekIndex::Save(url, index); });
+  }
+
+  if (seek_index_parser_) {
+    GstPad* pad = gst_element_get_static_pad(seek_index_parser_, "src");
+    if (pad) {
+      gst_pad_remove_probe(pad, seek_index_probe_id_);
+      gst_object_unref(pad);
+    }
+    gst_object_unref(seek_index_parser_);
+  }
+  seek_index_parser_ = nullptr;
+  seek_index_probe_id_ = 0;
+  seek_index_url_ = QUrl();
+  seek_index_ = SeekIndex();
+  seek_index_recording_ = false;
+  seek_index_seek_pending_ = false;
+  seek_index_entry_nanosec_ = -1;
+  seek_index_target_nanosec_ = -1;
+  seek_index_rebase_nanosec_ = 0;
+}
+
+void GstEnginePipeline::SeekIndexElementAdded(GstBin*, GstBin*,
+                                              GstElement* element,
+                                              gpointer self) {
+  GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
+
+  GstElementFactory* factory = gst_element_get_factory(element);
+  if (!factory) return;
+  const QString klass = gst_element_factory_get_klass(factory);
+
+  // Tag demuxers like id3demux pass the rest of the file through, and
+  // adjust byte seeks for the tags they take off.
+  const bool parser = klass.contains("Parser");
+  if (klass.contains("Metadata") || (!parser && !klass.contains("Demuxer"))) {
+    return;
+  }
+
+  QMutexLocker l(&instance->seek_index_mutex_);
+  if (instance->seek_index_parser_ || !instance->seek_index_url_.isValid()) {
+    return;
+  }
+
+  // Offsets only mean something to the element reading the file.  Container
+  // formats have their own index anyway.
+  if (!parser || !klass.contains("Audio")) {
+    instance->seek_index_url_ = QUrl();
+    instance->seek_index_ = SeekIndex();
+    return;
+  }
+
+  GstPad* pad = gst_element_get_static_pad(element, "src");
+  if (!pad) return;
+  instance->seek_index_parser_ = GST_ELEMENT(gst_object_ref(element));
+  instance->seek_index_probe_id_ =
+      gst_pad_add_probe(pad,
+                        GstPadProbeType(GST_PAD_PROBE_TYPE_BUFFER |
+                                        GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+                        &SeekIndexProbe, instance, nullptr);
+  gst_object_unref(pad);
+}
+
+GstPadProbeReturn GstEnginePipeline::SeekIndexProbe(GstPad* pad,
+                                                    GstPadProbeInfo* info,
+                                                    gpointer self) {
+  GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
+
+  QMutexLocker l(&instance->seek_index_mutex_);
+  // The last track's parser can still be running after a gapless change.
+  if (GST_PAD_PARENT(pad) != instance->seek_index_parser_) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent* event = GST_PAD_PROBE_INFO_EVENT(info);
+    if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP &&
+        instance->seek_index_seek_pending_) {
+      instance->seek_index_seek_pending_ = false;
+      instance->seek_index_rebase_nanosec_ = 0;
+      if (instance->seek_index_entry_nanosec_ == -1) {
+        instance->seek_index_recording_ = false;
+      }
+    } else if (GST_EVENT_TYPE(event) == GST_EVENT_SEGMENT &&
+               !instance->seek_index_seek_pending_ &&
+               instance->seek_index_entry_nanosec_ != -1) {
+      const GstSegment* segment = nullptr;
+      gst_event_parse_segment(event, &segment);
+
+      if (segment->format == GST_FORMAT_TIME) {
+        // Start from the entry's time, and let the decoder clip everything
+        // before the time that was asked for.
+        instance->seek_index_rebase_nanosec_ =
+            instance->seek_index_entry_nanosec_ - qint64(segment->start);
+
+        GstSegment rebased;
+        gst_segment_copy_into(segment, &rebased);
+        rebased.start = instance->seek_index_target_nanosec_;
+        rebased.time = instance->seek_index_target_nanosec_;
+        rebased.position = instance->seek_index_target_nanosec_;
+
+        GstEvent* new_event = gst_event_new_segment(&rebased);
+        gst_event_set_seqnum(new_event, gst_event_get_seqnum(event));
+        gst_event_unref(event);
+        GST_PAD_PROBE_INFO_DATA(info) = new_event;
+      } else {
+        instance->seek_index_recording_ = false;
+      }
+      instance->seek_index_entry_nanosec_ = -1;
+    }
+    return GST_PAD_PROBE_OK;
+  }
+
+  GstBuffer* buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  const qint64 rebase = instance->seek_index_rebase_nanosec_;
+  if (rebase != 0) {
+    buf = gst_buffer_make_writable(buf);
+    if (GST_BUFFER_PTS_IS_VALID(buf)) GST_BUFFER_PTS(buf) += rebase;
+    if (GST_BUFFER_DTS_IS_VALID(buf)) GST_BUFFER_DTS(buf) += rebase;
+    GST_PAD_PROBE_INFO_DATA(info) = buf;
+  }
+
+  if (instance->seek_index_recording_ && GST_BUFFER_PTS_IS_VALID(buf) &&
+      GST_BUFFER_OFFSET_IS_VALID(buf)) {
+    instance->seek_index_.Add(GST_BUFFER_PTS(buf), GST_BUFFER_OFFSET(buf));
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+void GstEnginePipeline::StartPrebuffering() {
+  ClearPrebuffer();
+
+  // Local files open quickly enough not to need this, and Spotify streams are
+  // started by the Spotify server rather than by the decode bin.
+  const QString scheme = next_.url_.scheme();
+  if (!prebuffering_ || !next_.url_.isValid() || next_.url_ == current_.url_ ||
+      scheme == "file" || scheme == "cdda" || scheme == "spotify") {
+    return;
+  }
+
+  GstElement* bin = CreateDecodeBinFromUrl(next_.url_);
+  if (!bin) return;
+  gst_object_ref_sink(bin);
+
+  // The bin isn't in the pipeline yet so it needs a bus of its own, both to
+  // find out how full it is and so its errors don't stop this track.
+  const qint64 duration_nanosec = adaptive_buffering_
+                                      ? InitialBufferNanosec(next_.url_)
+                                      : buffer_duration_nanosec_;
+  g_object_set(G_OBJECT(bin), "use-buffering", true, "buffer-duration",
+               gint64(duration_nanosec), nullptr);
+  GstBus* bus = gst_bus_new();
+  gst_bus_set_sync_handler(bus, PrebufferBusCallbackSync, this, nullptr);
+  gst_element_set_bus(bin, bus);
+
+  {
+    QMutexLocker l(&prebuffer_mutex_);
+    prebuffer_bin_ = bin;
+    prebuffer_bus_ = bus;
+    prebuffer_url_ = next_.url_;
+    prebuffer_blocked_ = false;
+    prebuffer_percent_ = -1;
+    prebuffer_failed_ = false;
+  }
+
+  qLog(Debug) << id() << "prebuffering" << next_.url_;
+  gst_element_set_state(bin, GST_STATE_PAUSED);
+}
+
+bool GstEnginePipeline::TakePrebuffer(const QUrl& url) {
+  QMutexLocker l(&prebuffer_mutex_);
+  if (!prebuffer_bin_) return false;
+
+  if (prebuffer_failed_ || prebuffer_url_ != url) {
+    // Tear it down in the main thread, not in this streaming thread.
+    QMetaObject::invokeMethod(this, "ClearPrebuffer", Qt::QueuedConnection);
+    return false;
+  }
+
+  const bool ready = prebuffer_blocked_ &&
+                     (prebuffer_percent_ == -1 || prebuffer_percent_ >= 100);
+  const int count_ready = ready ? sPrebufferReady.fetchAndAddRelaxed(1) + 1
+                                : sPrebufferReady.load();
+  const int count_late = ready ? sPrebufferLate.load()
+                               : sPrebufferLate.fetchAndAddRelaxed(1) + 1;
+  if (ready) {
+    qLog(Debug) << id() << "prebuffered" << url << "in time";
+  } else {
+    qLog(Info) << id() << "prebuffering" << url << "was too late ("
+               << (prebuffer_percent_ == -1 ? 0 : prebuffer_percent_)
+               << "% full)," << count_late << "of" << count_ready + count_late
+               << "transitions so far";
+  }
+
+  // Adding the bin to the pipeline gives it the pipeline's bus.  This is done
+  // with the lock held so NewPadCallback can't try to link a pad before the
+  // bin is in the pipeline.
+  gst_bus_set_sync_handler(prebuffer_bus_, nullptr, nullptr, nullptr);
+  ReplaceDecodeBin(prebuffer_bin_);
+
+  GstElement* bin = prebuffer_bin_;
+  GstBus* bus = prebuffer_bus_;
+  GstPad* pad = prebuffer_pad_;
+  const gulong probe_id = prebuffer_probe_id_;
+  prebuffer_bin_ = nullptr;
+  prebuffer_bus_ = nullptr;
+  prebuffer_pad_ = nullptr;
+  prebuffer_probe_id_ = 0;
+  prebuffer_url_ = QUrl();
+  l.unlock();
+
+  gst_object_unref(bin);
+  gst_object_unref(bus);
+  gst_element_set_state(uridecodebin_, GST_STATE_PLAYING);
+
+  // If the pad appeared already it won't be added again, so link it now.
+  // Otherwise NewPadCallback will do it as usual when it does.
+  if (pad) {
+    NewPadCallback(uridecodebin_, pad, this);
+    gst_pad_remove_probe(pad, probe_id);
+    gst_object_unref(pad);
+  }
+  return true;
+}
+
+void GstEnginePipeline::ClearPrebuffer() {
+  GstElement* bin;
+  GstBus* bus;
+  GstPad* pad;
+  gulong probe_id;
+  {
+    QMutexLocker l(&prebuffer_mutex_);
+    bin = prebuffer_bin_;
+    bus = prebuffer_bus_;
+    pad = prebuffer_pad_;
+    probe_id = prebuffer_probe_id_;
+    prebuffer_bin_ = nullptr;
+    prebuffer_bus_ = nullptr;
+    prebuffer_pad_ = nullptr;
+    prebuffer_probe_id_ = 0;
+    prebuffer_url_ = QUrl();
+  }
+  if (!bin) return;
+
+  gst_bus_set_sync_handler(bus, nullptr, nullptr, nullptr);
+  gst_bus_set_flushing(bus, true);
+  if (pad) {
+    gst_pad_remove_probe(pad, probe_id);
+    gst_object_unref(pad);
+  }
+  g_signal_handlers_disconnect_matched(G_OBJECT(bin), G_SIGNAL_MATCH_DATA, 0,
+                                       0, nullptr, nullptr, this);
+  sElementDeleter->DeleteElementLater(bin);
+  gst_object_unref(bus);
+}
+
+GstBusSyncReply GstEnginePipeline::PrebufferBusCallbackSync(GstBus*,
+                                                            GstMessage* msg,
+                                                            gpointer self) {
+  GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
+  QMutexLocker l(&instance->prebuffer_mutex_);
+
+  switch (GST_MESSAGE_TYPE(msg)) {
+    case GST_MESSAGE_ERROR: {
+      // Don't bother reporting it, the error will happen again when the track
+      // is loaded normally.
+      qLog(Debug) << instance->id() << "prebuffering"
+                  << instance->prebuffer_url_ << "failed";
+      instance->prebuffer_failed_ = true;
+      break;
+    }
+
+    case GST_MESSAGE_BUFFERING: {
+      gint percent;
+      gst_message_parse_buffering(msg, &percent);
+      instance->prebuffer_percent_ = percent;
+      break;
+    }
+
+    default:
+      break;
+  }
+  return GST_BUS_DROP;
+}
+
+GstPadProbeReturn GstEnginePipeline::PrebufferBlockProbe(GstPad*,
+                                                         GstPadProbeInfo*,
+                                                         gpointer self) {
+  GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
+  QMutexLocker l(&instance->prebuffer_mutex_);
+  instance->prebuffer_blocked_ = true;
+
+  // Returning OK from a blocking probe keeps the pad blocked.
+  return GST_PAD_PROBE_OK;
+}
+
 qint64 GstEnginePipeline::position() const {
   if (pipeline_is_initialised_)
     gst_element_query_position(pipeline_, GST_FORMAT_TIME,
@@ -1176,10 +2066,59 @@ bool GstEnginePipeline::Seek(qint64 nanosec) {
 
   pending_seek_nanosec_ = -1;
   last_known_position_ns_ = nanosec;
+
+  // The fade curve is laid out in stream time, so move what's left of it to
+  // the new position.
+  if (fader_running_) {
+    fader_start_time_msec_ = FaderCurrentTime();
+    fader_start_nanosec_ = nanosec;
+    ScheduleFader();
+  }
+
+  if (SeekWithIndex(nanosec)) return true;
+
+  {
+    QMutexLocker l(&seek_index_mutex_);
+    seek_index_seek_pending_ = true;
+    seek_index_entry_nanosec_ = -1;
+  }
   return gst_element_seek_simple(pipeline_, GST_FORMAT_TIME,
                                  GST_SEEK_FLAG_FLUSH, nanosec);
 }
 
+bool GstEnginePipeline::SeekWithIndex(qint64 nanosec) {
+  QMutexLocker l(&seek_index_mutex_);
+
+  SeekIndex::Entry entry;
+  if (!seek_index_parser_ || !seek_index_.Find(nanosec, &entry)) return false;
+
+  // A byte seek has to be done by the source.  Parsers that pull data from
+  // the source themselves, like they usually do with local files, refuse it.
+  GstPad* pad = gst_element_get_static_pad(seek_index_parser_, "sink");
+  const bool push = pad && GST_PAD_MODE(pad) == GST_PAD_MODE_PUSH;
+  if (pad) gst_object_unref(pad);
+  if (!push) return false;
+
+  GstElement* parser = GST_ELEMENT(gst_object_ref(seek_index_parser_));
+  seek_index_seek_pending_ = true;
+  seek_index_entry_nanosec_ = entry.nanosec_;
+  seek_index_target_nanosec_ = nanosec;
+
+  // The seek flushes the parser's output, and the probe needs the lock.
+  l.unlock();
+  const bool ret = gst_element_seek_simple(parser, GST_FORMAT_BYTES,
+                                           GST_SEEK_FLAG_FLUSH,
+                                           entry.byte_offset_);
+  gst_object_unref(parser);
+
+  if (!ret) {
+    l.relock();
+    seek_index_seek_pending_ = false;
+    seek_index_entry_nanosec_ = -1;
+  }
+  return ret;
+}
+
 void GstEnginePipeline::SetEqualizerEnabled(bool enabled) {
   eq_enabled_ = enabled;
   UpdateEqualizer();
@@ -1206,6 +2145,10 @@ void GstEnginePipeline::UpdateEqualizer() {
     else
       gain *= 0.12;
 
+    // Setting any band makes the element recompute all of them.
+    if (gain == applied_eq_gains_[i]) continue;
+    applied_eq_gains_[i] = gain;
+
     const int index_in_eq = i + 1;
     // Offset because of the first dummy band we created.
     GstObject* band = GST_OBJECT(gst_child_proxy_get_child_by_index(
@@ -1215,11 +2158,7 @@ void GstEnginePipeline::UpdateEqualizer() {
   }
 
   // Update preamp
-  float preamp = 1.0;
-  if (eq_enabled_)
-    preamp = float(eq_preamp_ + 100) * 0.01;  // To scale from 0.0 to 2.0
-
-  g_object_set(G_OBJECT(equalizer_preamp_), "volume", preamp, nullptr);
+  g_object_set(G_OBJECT(volume_), "volume", double(OutputVolume()), nullptr);
 }
 
 void GstEnginePipeline::UpdateStereoBalance() {
@@ -1235,13 +2174,26 @@ void GstEnginePipeline::SetVolume(int percent) {
 }
 
 void GstEnginePipeline::SetVolumeModifier(qreal mod) {
+  StopFader();
   volume_modifier_ = mod;
   UpdateVolume();
 }
 
+float GstEnginePipeline::OutputVolume() const {
+  float preamp = 1.0;
+  if (eq_enabled_)
+    preamp = float(eq_preamp_ + 100) * 0.01;  // To scale from 0.0 to 2.0
+
+  return double(volume_percent_) * 0.01 * preamp;
+}
+
 void GstEnginePipeline::UpdateVolume() {
-  float vol = double(volume_percent_) * 0.01 * volume_modifier_;
-  g_object_set(G_OBJECT(volume_), "volume", vol, nullptr);
+  g_object_set(G_OBJECT(volume_), "volume", double(OutputVolume()), nullptr);
+
+  if (!fader_running_) {
+    g_object_set(G_OBJECT(fader_volume_), "volume", double(volume_modifier_),
+                 nullptr);
+  }
 }
 
 void GstEnginePipeline::StartFader(qint64 duration_nanosec,
@@ -1253,35 +2205,99 @@ void GstEnginePipeline::StartFader(qint64 duration_nanosec,
   // If there's already another fader running then start from the same time
   // that one was already at.
   int start_time = direction == QTimeLine::Forward ? 0 : duration_msec;
-  if (fader_ && fader_->state() == QTimeLine::Running) {
-    if (duration_msec == fader_->duration()) {
-      start_time = fader_->currentTime();
-    } else {
+  if (fader_running_) {
+    if (duration_msec == fader_duration_msec_) {
+      start_time = FaderCurrentTime();
+    } else if (fader_duration_msec_ > 0) {
       // Calculate the position in the new fader with the same value from
       // the old fader, so no volume jumps appear
-      qreal time = qreal(duration_msec) *
-                   (qreal(fader_->currentTime()) / qreal(fader_->duration()));
+      qreal time = qreal(duration_msec) * (qreal(FaderCurrentTime()) /
+                                           qreal(fader_duration_msec_));
       start_time = qRound(time);
     }
   }
 
-  fader_.reset(new QTimeLine(duration_msec, this));
-  connect(fader_.get(), SIGNAL(valueChanged(qreal)),
-          SLOT(SetVolumeModifier(qreal)));
-  connect(fader_.get(), SIGNAL(finished()), SLOT(FaderTimelineFinished()));
-  fader_->setDirection(direction);
-  fader_->setCurveShape(shape);
-  fader_->setCurrentTime(start_time);
-  fader_->resume();
+  fader_duration_msec_ = duration_msec;
+  fader_direction_ = direction;
+  fader_shape_ = shape;
+  fader_start_time_msec_ = start_time;
+  // A seek that hasn't happened yet is where the audio will start from.
+  fader_start_nanosec_ =
+      pending_seek_nanosec_ >= 0 ? pending_seek_nanosec_ : position();
 
   fader_fudge_timer_.stop();
   use_fudge_timer_ = use_fudge_timer;
 
-  SetVolumeModifier(fader_->currentValue());
+  ScheduleFader();
+}
+
+void GstEnginePipeline::ScheduleFader() {
+  QTimeLine curve(qMax(1, fader_duration_msec_));
+  curve.setCurveShape(fader_shape_);
+
+  const bool forward = fader_direction_ == QTimeLine::Forward;
+  const int remaining_msec = forward
+                                 ? fader_duration_msec_ - fader_start_time_msec_
+                                 : fader_start_time_msec_;
+
+  // Lay the rest of the curve out in stream time, in short straight
+  // segments.  The volume element interpolates between them for every
+  // sample, so nothing here depends on when our event loop gets to run.
+  GstTimedValueControlSource* source =
+      GST_TIMED_VALUE_CONTROL_SOURCE(fader_curve_);
+  gst_timed_value_control_source_unset_all(source);
+
+  const int steps = qMax(1, remaining_msec / kFaderCurveStepMsec);
+  for (int i = 0; i <= steps; ++i) {
+    const qint64 offset_msec = qint64(remaining_msec) * i / steps;
+    const int time = forward ? fader_start_time_msec_ + offset_msec
+                             : fader_start_time_msec_ - offset_msec;
+    gst_timed_value_control_source_set(
+        source, fader_start_nanosec_ + offset_msec * kNsecPerMsec,
+        curve.valueForTime(time));
+  }
+
+  gst_object_set_control_binding_disabled(GST_OBJECT(fader_volume_), "volume",
+                                          FALSE);
+  fader_running_ = true;
+
+  // This only decides when to tell the engine the fade is over.
+  fader_timer_.start(qMax(0, remaining_msec), this);
+}
+
+int GstEnginePipeline::FaderCurrentTime() const {
+  const qint64 elapsed_msec = qMax(
+      qint64(0), (position() - fader_start_nanosec_) / kNsecPerMsec);
+
+  if (fader_direction_ == QTimeLine::Forward) {
+    return qMin(qint64(fader_duration_msec_),
+                fader_start_time_msec_ + elapsed_msec);
+  }
+  return qMax(qint64(0), fader_start_time_msec_ - elapsed_msec);
 }
 
-void GstEnginePipeline::FaderTimelineFinished() {
-  fader_.reset();
+void GstEnginePipeline::StopFader() {
+  fader_timer_.stop();
+  if (!fader_running_) return;
+
+  fader_running_ = false;
+  gst_object_set_control_binding_disabled(GST_OBJECT(fader_volume_), "volume",
+                                          TRUE);
+  gst_timed_value_control_source_unset_all(
+      GST_TIMED_VALUE_CONTROL_SOURCE(fader_curve_));
+}
+
+void GstEnginePipeline::FinishFader() {
+  QTimeLine curve(qMax(1, fader_duration_msec_));
+  curve.setCurveShape(fader_shape_);
+  const qreal end_value = curve.valueForTime(
+      fader_direction_ == QTimeLine::Forward ? fader_duration_msec_ : 0);
+
+  // Leave the volume where the curve ended, without the curve, so later
+  // seeks don't land on it.
+  StopFader();
+  volume_modifier_ = end_value;
+  UpdateVolume();
 
   // Wait a little while longer before emitting the finished signal (and
   // probably destroying the pipeline) to account for delays in the audio
@@ -1298,6 +2314,11 @@ void GstEnginePipeline::FaderTimelineFinished() {
 }
 
 void GstEnginePipeline::timerEvent(QTimerEvent* e) {
+  if (e->timerId() == fader_timer_.timerId()) {
+    FinishFader();
+    return;
+  }
+
   if (e->timerId() == fader_fudge_timer_.timerId()) {
     fader_fudge_timer_.stop();
     emit FaderFinished();
@@ -1328,4 +2349,6 @@ void GstEnginePipeline::SetNextReq(const MediaPlaybackRequest& req,
   next_ = req;
   next_beginning_offset_nanosec_ = beginning_nanosec;
   next_end_offset_nanosec_ = end_nanosec;
+
+  StartPrebuffering();
 }
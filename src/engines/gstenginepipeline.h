@@ -20,18 +20,29 @@
 
 #include <memory>
 
+#include <QAtomicInt>
 #include <QBasicTimer>
+#include <QElapsedTimer>
 #include <QFuture>
+#include <QHash>
+#include <QMap>
 #include <QMutex>
 #include <QObject>
 #include <QThreadPool>
 #include <QTimeLine>
 #include <QUrl>
+#include <QVector>
 
 #include <gst/gst.h>
 
+#ifdef Q_OS_LINUX
+#include <time.h>
+#endif
+
 #include "engine_fwd.h"
+#include "enginemetrics.h"
 #include "playbackrequest.h"
+#include "seekindex.h"
 
 class GstElementDeleter;
 class GstEngine;
@@ -55,13 +66,30 @@ class GstEnginePipeline : public QObject {
   void set_replaygain(bool enabled, int mode, float preamp, bool compression);
   void set_buffer_duration_nanosec(qint64 duration_nanosec);
   void set_buffer_min_fill(int percent);
+  // Picks the queue size for each stream instead of using the buffer duration
+  // for all of them.  See AdaptiveBufferNanosec.
+  void set_adaptive_buffering(bool enabled);
   void set_mono_playback(bool enabled);
   void set_sample_rate(int rate);
+  // Network streams set with SetNextReq are opened straight away and buffered
+  // up to the buffer duration, rather than when this track is drained.
+  void set_prebuffering(bool enabled);
 
   // Creates the pipeline, returns false on error
   bool InitFromReq(const MediaPlaybackRequest& req, qint64 end_nanosec);
   bool InitFromString(const QString& pipeline);
 
+  // Creates only the output side of the pipeline and opens the audio sink, so
+  // a later InitFromReq just has to add a decode bin.  Returns false if the
+  // sink couldn't be opened.
+  bool InitOutput();
+  // Drops the decode bin and all per-track state, leaving the output bin
+  // ready for another InitFromReq.  The pipeline gets a new id.
+  bool Recycle();
+  // Lets go of the decode bin and any prebuffered one now, so a retired
+  // pipeline doesn't keep a stream's connection open until it's recycled.
+  void ReleaseDecodeBin();
+
   // BufferConsumers get fed audio data.  Thread-safe.
   void AddBufferConsumer(BufferConsumer* consumer);
   void RemoveBufferConsumer(BufferConsumer* consumer);
@@ -107,6 +135,10 @@ class GstEnginePipeline : public QObject {
 
   QString source_device() const { return source_device_; }
 
+  // Buffering, latency and CPU statistics for the current track.
+  // Thread-safe.
+  EngineMetrics metrics() const;
+
  public slots:
   void SetVolumeModifier(qreal mod);
 
@@ -140,6 +172,17 @@ signals:
   static void SourceSetupCallback(GstURIDecodeBin*, GParamSpec* pspec,
                                   gpointer);
   static void TaskEnterCallback(GstTask*, GThread*, gpointer);
+  static GstBusSyncReply PrebufferBusCallbackSync(GstBus*, GstMessage*,
+                                                  gpointer);
+  static GstPadProbeReturn PrebufferBlockProbe(GstPad*, GstPadProbeInfo*,
+                                               gpointer);
+  static GstPadProbeReturn FirstAudioProbe(GstPad*, GstPadProbeInfo*,
+                                           gpointer);
+  static GstPadProbeReturn NetworkBytesProbe(GstPad*, GstPadProbeInfo*,
+                                             gpointer);
+  static void SeekIndexElementAdded(GstBin*, GstBin*, GstElement*, gpointer);
+  static GstPadProbeReturn SeekIndexProbe(GstPad*, GstPadProbeInfo*,
+                                          gpointer);
 
   static QByteArray GstUriFromUrl(const QUrl& url);
 
@@ -157,25 +200,80 @@ signals:
   GstElement* CreateDecodeBinFromUrl(const QUrl& url);
 
   void UpdateVolume();
+  // The user's volume with the equalizer's preamp applied on top.
+  float OutputVolume() const;
+  void ScheduleFader();
+  int FaderCurrentTime() const;
+  void StopFader();
+  void FinishFader();
   void UpdateEqualizer();
   void UpdateStereoBalance();
   bool ReplaceDecodeBin(GstElement* new_bin);
   bool ReplaceDecodeBin(const QUrl& url);
+  // Takes the decode bin out of the pipeline and stops anything in it calling
+  // back into this one.  Returns a reference for sElementDeleter, or nullptr
+  // if there's no decode bin.
+  GstElement* DetachDecodeBin();
+  // Call with metrics_mutex_ held.
+  void RemoveNetworkProbe();
 
   void TransitionToNext();
 
+  static bool IsLocalUrl(const QUrl& url);
+  // Adds the bytes counted over the last elapsed_nanosec to the throughput
+  // statistics.  Call with metrics_mutex_ held.
+  void AddThroughputSample(qint64 elapsed_nanosec);
+  // The queue size a stream from url starts with: small for local files, and
+  // for network streams whatever the last stream from the same host needed.
+  qint64 InitialBufferNanosec(const QUrl& url) const;
+  // How big the queue should be for the current stream given the throughput
+  // seen so far, or -1 if there haven't been enough samples to tell.  Call
+  // with metrics_mutex_ held.
+  qint64 AdaptiveBufferNanosec() const;
+  // Resizes the queue.  Safe to call from streaming threads, but not with
+  // metrics_mutex_ held, because the queue may post a buffering message.
+  void SetQueueDuration(qint64 nanosec, bool use_buffering);
+
+  // Starts counting afresh for a new track, after logging the last one's
+  // metrics if it played.
+  void ResetMetrics();
+#ifdef Q_OS_LINUX
+  static qint64 ThreadCpuNanosec(clockid_t clock);
+#endif
+
+  // Loads the seek index for url, and watches for the parser in its decode
+  // bin.
+  void StartSeekIndex(const QUrl& url, GstElement* bin);
+  // Saves the current seek index in the background if it's grown.
+  void FinishSeekIndex();
+  // Seeks to the byte offset the seek index has for nanosec.  Returns false
+  // if it can't, and a normal seek should be done instead.
+  bool SeekWithIndex(qint64 nanosec);
+
+  void StartPrebuffering();
+  // Adds the prebuffered decode bin to the pipeline in place of the current
+  // one, if it's for url and hasn't failed.  Returns false if there wasn't a
+  // usable one.
+  bool TakePrebuffer(const QUrl& url);
+
   // If the decodebin is special (ie. not really a uridecodebin) then it'll have
   // a src pad immediately and we can link it after everything's created.
   void MaybeLinkDecodeToAudio();
 
  private slots:
-  void FaderTimelineFinished();
+  void ClearPrebuffer();
 
  private:
   static const int kGstStateTimeoutNanosecs;
   static const int kFaderFudgeMsec;
+  static const int kFaderCurveStepMsec;
   static const int kEqBandCount;
   static const int kEqBandFrequencies[];
+  static const qint64 kLocalBufferNanosec;
+  static const qint64 kMinNetworkBufferNanosec;
+  static const qint64 kMaxNetworkBufferNanosec;
+  static const qint64 kThroughputSampleNanosec;
+  static const int kMinThroughputSamples;
 
   static GstElementDeleter* sElementDeleter;
 
@@ -207,6 +305,9 @@ signals:
   bool eq_enabled_;
   int eq_preamp_;
   QList<int> eq_band_gains_;
+  // The gains the equalizer element has now, so moving one slider doesn't
+  // make it recompute every band.
+  QVector<float> applied_eq_gains_;
 
   // Stereo balance.
   // From -1.0 - 1.0
@@ -224,9 +325,70 @@ signals:
   int buffer_min_fill_;
   bool buffering_;
 
+  // With adaptive buffering the queue's size changes from stream to stream,
+  // and grows while a stream is playing if its throughput is unsteady.  What
+  // each host needed is remembered for its next stream, across all
+  // pipelines.
+  bool adaptive_buffering_;
+  static QMutex sHostBufferMutex;
+  static QHash<QString, qint64> sHostBufferNanosec;
+
   bool mono_playback_;
   int sample_rate_;
 
+  // The next track's decode bin while it's being prebuffered, outside the
+  // pipeline and with its own bus.  Its first pad is blocked until it's added
+  // to the pipeline in TransitionToNext.  Touched by streaming threads, so
+  // guarded by prebuffer_mutex_.
+  bool prebuffering_;
+  QMutex prebuffer_mutex_;
+  GstElement* prebuffer_bin_;
+  GstBus* prebuffer_bus_;
+  QUrl prebuffer_url_;
+  GstPad* prebuffer_pad_;
+  gulong prebuffer_probe_id_;
+  bool prebuffer_blocked_;
+  int prebuffer_percent_;
+  bool prebuffer_failed_;
+
+  // How often the next track was ready in time, across all pipelines.
+  static QAtomicInt sPrebufferReady;
+  static QAtomicInt sPrebufferLate;
+
+  // Counters for metrics(), mostly updated from streaming threads.  The
+  // request timer is only valid once a track has been requested.
+  mutable QMutex metrics_mutex_;
+  EngineMetrics metrics_;
+  QElapsedTimer request_timer_;
+  QElapsedTimer stall_timer_;
+  QElapsedTimer network_timer_;
+  // The probe counting what the decode bin's source downloads.
+  GstPad* network_probe_pad_;
+  gulong network_probe_id_;
+
+  // Network throughput measured once a second, for adaptive buffering, in
+  // bytes per second.  The mean and variance are kept with Welford's method.
+  // The deficit is how much audio the stream has fallen behind by since it
+  // last kept up, which needs the bitrate from its tags.
+  qint64 queue_duration_nanosec_;
+  qint64 stream_bytes_per_sec_;
+  QElapsedTimer throughput_timer_;
+  qint64 throughput_sample_bytes_;
+  int throughput_samples_;
+  double throughput_mean_;
+  double throughput_m2_;
+  qint64 deficit_nanosec_;
+  qint64 max_deficit_nanosec_;
+#ifdef Q_OS_LINUX
+  struct StreamThread {
+    QString element_;
+    clockid_t clock_;
+    qint64 cpu_at_enter_nanosec_;
+  };
+  QList<StreamThread> stream_threads_;
+  QMap<QString, qint64> finished_thread_cpu_nanosec_;
+#endif
+
   // The URL that is currently playing, and the URL that is to be preloaded
   // when the current track is close to finishing.
   MediaPlaybackRequest current_;
@@ -271,10 +433,40 @@ signals:
   // not possible.
   mutable gint64 last_known_position_ns_;
 
+  // The seek index for the track that's playing, and the parser it's
+  // recorded from.  The parser's output is watched on its streaming thread,
+  // so these are guarded by seek_index_mutex_.  After a seek with the index
+  // the parser only has its own guess at the time, so its output is moved by
+  // seek_index_rebase_nanosec_ to the time the index has for the offset.
+  // Its times are a guess after a normal seek too, so nothing more is
+  // recorded then.
+  QMutex seek_index_mutex_;
+  QUrl seek_index_url_;
+  SeekIndex seek_index_;
+  GstElement* seek_index_parser_;
+  gulong seek_index_probe_id_;
+  bool seek_index_recording_;
+  // Set by a seek until its flush reaches the parser's output.
+  bool seek_index_seek_pending_;
+  // The entry a seek with the index went to, and the exact time it was for.
+  // The entry is -1 for a normal seek, or once the new segment is seen.
+  qint64 seek_index_entry_nanosec_;
+  qint64 seek_index_target_nanosec_;
+  qint64 seek_index_rebase_nanosec_;
+
   int volume_percent_;
   qreal volume_modifier_;
 
-  std::unique_ptr<QTimeLine> fader_;
+  // The running fade, as a curve in stream time.  fader_start_time_msec_ is
+  // the point on the curve that fader_start_nanosec_ in the stream maps to.
+  GstControlSource* fader_curve_;
+  bool fader_running_;
+  int fader_duration_msec_;
+  int fader_start_time_msec_;
+  qint64 fader_start_nanosec_;
+  QTimeLine::Direction fader_direction_;
+  QTimeLine::CurveShape fader_shape_;
+  QBasicTimer fader_timer_;
   QBasicTimer fader_fudge_timer_;
   bool use_fudge_timer_;
 
@@ -291,10 +483,10 @@ signals:
   GstElement* rgvolume_;
   GstElement* rglimiter_;
   GstElement* audioconvert2_;
-  GstElement* equalizer_preamp_;
   GstElement* equalizer_;
   GstElement* stereo_panorama_;
   GstElement* volume_;
+  GstElement* fader_volume_;
   GstElement* audioscale_;
   GstElement* audiosink_;
 
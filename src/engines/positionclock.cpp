@@ -0,0 +1,174 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "positionclock.h"
+
+#include <QTimerEvent>
+
+#include "enginebase.h"
+#include "core/timeconstants.h"
+
+const int PositionClock::kResyncIntervalMsec = 5000;
+const int PositionClock::kCoalesceMsec = 50;
+
+PositionClock::PositionClock(EngineBase* engine)
+    : QObject(engine),
+      engine_(engine),
+      playing_(false),
+      resync_pending_(false),
+      anchored_(false),
+      anchor_position_nanosec_(0),
+      anchor_msec_(0) {
+  clock_.start();
+
+  connect(engine_, SIGNAL(StateChanged(Engine::State)),
+          SLOT(EngineStateChanged(Engine::State)));
+}
+
+int PositionClock::IndexOf(QObject* receiver, const char* method) const {
+  for (int i = 0; i < subscribers_.count(); ++i) {
+    if (subscribers_[i].receiver_ == receiver &&
+        subscribers_[i].method_ == method) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void PositionClock::Subscribe(QObject* receiver, const char* method,
+                              int interval_msec) {
+  const int index = IndexOf(receiver, method);
+  if (index != -1) {
+    subscribers_[index].interval_msec_ = interval_msec;
+    subscribers_[index].next_msec_ =
+        qMin(subscribers_[index].next_msec_, clock_.elapsed() + interval_msec);
+  } else {
+    Subscriber subscriber;
+    subscriber.receiver_ = receiver;
+    subscriber.method_ = method;
+    subscriber.interval_msec_ = interval_msec;
+    // Tell new subscribers where we are straight away.
+    subscriber.next_msec_ = clock_.elapsed();
+    subscribers_ << subscriber;
+
+    connect(receiver, SIGNAL(destroyed(QObject*)),
+            SLOT(ReceiverDestroyed(QObject*)), Qt::UniqueConnection);
+  }
+
+  Reschedule();
+}
+
+void PositionClock::Unsubscribe(QObject* receiver, const char* method) {
+  const int index = IndexOf(receiver, method);
+  if (index == -1) return;
+
+  subscribers_.removeAt(index);
+  Reschedule();
+}
+
+bool PositionClock::IsSubscribed(QObject* receiver, const char* method) const {
+  return IndexOf(receiver, method) != -1;
+}
+
+void PositionClock::ReceiverDestroyed(QObject* receiver) {
+  for (int i = subscribers_.count() - 1; i >= 0; --i) {
+    if (subscribers_[i].receiver_ == receiver) subscribers_.removeAt(i);
+  }
+  Reschedule();
+}
+
+qint64 PositionClock::position_nanosec() {
+  if (!playing_) return engine_->position_nanosec();
+
+  const qint64 now = clock_.elapsed();
+  if (!anchored_ || now - anchor_msec_ >= kResyncIntervalMsec) {
+    anchor_position_nanosec_ = engine_->position_nanosec();
+    anchor_msec_ = now;
+    anchored_ = true;
+    return anchor_position_nanosec_;
+  }
+
+  return anchor_position_nanosec_ + (now - anchor_msec_) * kNsecPerMsec;
+}
+
+void PositionClock::Resync() {
+  anchored_ = false;
+  resync_pending_ = true;
+  MakeAllDue();
+}
+
+void PositionClock::EngineStateChanged(Engine::State state) {
+  const bool was_playing = playing_;
+  playing_ = state == Engine::Playing;
+  anchored_ = false;
+
+  if (playing_ && !was_playing) {
+    MakeAllDue();
+  } else {
+    Reschedule();
+  }
+}
+
+void PositionClock::MakeAllDue() {
+  const qint64 now = clock_.elapsed();
+  for (Subscriber& subscriber : subscribers_) subscriber.next_msec_ = now;
+  Reschedule();
+}
+
+void PositionClock::Reschedule() {
+  if (subscribers_.isEmpty() || (!playing_ && !resync_pending_)) {
+    timer_.stop();
+    return;
+  }
+
+  qint64 next_msec = subscribers_[0].next_msec_;
+  for (const Subscriber& subscriber : subscribers_) {
+    next_msec = qMin(next_msec, subscriber.next_msec_);
+  }
+
+  const qint64 delay_msec = qMax(0ll, next_msec - clock_.elapsed());
+  timer_.start(int(delay_msec), this);
+}
+
+void PositionClock::timerEvent(QTimerEvent* e) {
+  if (e->timerId() != timer_.timerId()) {
+    QObject::timerEvent(e);
+    return;
+  }
+
+  const qint64 now = clock_.elapsed();
+  const qint64 position = position_nanosec();
+
+  // Receivers might unsubscribe while we're telling them, so work on a copy.
+  QList<QPair<QObject*, QByteArray>> due;
+  for (Subscriber& subscriber : subscribers_) {
+    if (resync_pending_ || subscriber.next_msec_ <= now + kCoalesceMsec) {
+      due << qMakePair(subscriber.receiver_, subscriber.method_);
+      subscriber.next_msec_ = now + subscriber.interval_msec_;
+    }
+  }
+  resync_pending_ = false;
+
+  for (const QPair<QObject*, QByteArray>& subscriber : due) {
+    if (IndexOf(subscriber.first, subscriber.second.constData()) == -1) {
+      continue;
+    }
+    QMetaObject::invokeMethod(subscriber.first, subscriber.second.constData(),
+                              Q_ARG(qint64, position));
+  }
+
+  Reschedule();
+}
@@ -0,0 +1,96 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINES_POSITIONCLOCK_H_
+#define ENGINES_POSITIONCLOCK_H_
+
+#include <QBasicTimer>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QPair>
+
+#include "engine_fwd.h"
+
+// Tells interested objects the position in the current track, each at the
+// rate it asks for.  Between queries to the engine the position is
+// extrapolated from a monotonic clock, and the clock doesn't wake up at all
+// while nothing is playing or nobody is subscribed.
+class PositionClock : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit PositionClock(EngineBase* engine);
+
+  // How long an extrapolated position is trusted before asking the engine
+  // again.
+  static const int kResyncIntervalMsec;
+  // Subscribers due this soon are told along with the one that's due now.
+  static const int kCoalesceMsec;
+
+  // Calls method on receiver with the position in nanoseconds as a qint64,
+  // about every interval_msec while playing, and straight away when playback
+  // starts or the position jumps.  Subscribing again changes the interval.
+  // Subscriptions go away when the receiver is destroyed.
+  void Subscribe(QObject* receiver, const char* method, int interval_msec);
+  void Unsubscribe(QObject* receiver, const char* method);
+  bool IsSubscribed(QObject* receiver, const char* method) const;
+
+  qint64 position_nanosec();
+
+ public slots:
+  // Forgets the extrapolated position and tells every subscriber the new one.
+  // The engine calls this after seeking or changing tracks.
+  void Resync();
+
+ protected:
+  void timerEvent(QTimerEvent* e);
+
+ private slots:
+  void EngineStateChanged(Engine::State state);
+  void ReceiverDestroyed(QObject* receiver);
+
+ private:
+  struct Subscriber {
+    QObject* receiver_;
+    QByteArray method_;
+    int interval_msec_;
+    qint64 next_msec_;
+  };
+
+  int IndexOf(QObject* receiver, const char* method) const;
+  void MakeAllDue();
+  void Reschedule();
+
+ private:
+  EngineBase* engine_;
+  QList<Subscriber> subscribers_;
+
+  QBasicTimer timer_;
+  QElapsedTimer clock_;
+
+  bool playing_;
+  // Set when subscribers should hear about a new position even though
+  // nothing is playing.
+  bool resync_pending_;
+
+  bool anchored_;
+  qint64 anchor_position_nanosec_;
+  qint64 anchor_msec_;
+};
+
+#endif  // ENGINES_POSITIONCLOCK_H_
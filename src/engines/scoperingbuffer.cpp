@@ -0,0 +1,122 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "scoperingbuffer.h"
+
+#include <algorithm>
+#include <chrono>
+
+const int ScopeRingBuffer::kDefaultCapacity = 1 << 16;
+
+namespace {
+
+quint64 NextPowerOfTwo(int n) {
+  quint64 ret = 1;
+  while (ret < quint64(n)) ret <<= 1;
+  return ret;
+}
+
+}  // namespace
+
+ScopeRingBuffer::ScopeRingBuffer(int capacity)
+    : ring_(NextPowerOfTwo(capacity)),
+      mask_(ring_.size() - 1),
+      reserved_end_(0),
+      seq_(0),
+      block_start_(0),
+      block_end_(0),
+      block_duration_nsec_(0),
+      block_time_nsec_(0),
+      block_pipeline_id_(-1) {
+  writing_.clear();
+}
+
+qint64 ScopeRingBuffer::NowNsec() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void ScopeRingBuffer::Write(const int16_t* samples, int count,
+                            quint64 duration_nsec, int pipeline_id) {
+  if (count <= 0 || writing_.test_and_set(std::memory_order_acquire)) return;
+
+  // Only keep as much of a huge buffer as fits.
+  if (quint64(count) > ring_.size()) {
+    samples += count - ring_.size();
+    count = ring_.size();
+  }
+
+  const quint64 start = reserved_end_.load(std::memory_order_relaxed);
+  const quint64 end = start + count;
+  reserved_end_.store(end, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  const quint64 offset = start & mask_;
+  const int first = std::min<quint64>(count, ring_.size() - offset);
+  std::copy(samples, samples + first, ring_.begin() + offset);
+  std::copy(samples + first, samples + count, ring_.begin());
+
+  const quint32 seq = seq_.load(std::memory_order_relaxed);
+  seq_.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  block_start_.store(start, std::memory_order_relaxed);
+  block_end_.store(end, std::memory_order_relaxed);
+  block_duration_nsec_.store(duration_nsec, std::memory_order_relaxed);
+  block_time_nsec_.store(NowNsec(), std::memory_order_relaxed);
+  block_pipeline_id_.store(pipeline_id, std::memory_order_relaxed);
+  seq_.store(seq + 2, std::memory_order_release);
+
+  writing_.clear(std::memory_order_release);
+}
+
+bool ScopeRingBuffer::ReadLatest(int16_t* dest, int count,
+                                 int* pipeline_id) const {
+  quint64 start, end, duration_nsec;
+  qint64 time_nsec;
+  quint32 seq;
+  do {
+    seq = seq_.load(std::memory_order_acquire);
+    start = block_start_.load(std::memory_order_relaxed);
+    end = block_end_.load(std::memory_order_relaxed);
+    duration_nsec = block_duration_nsec_.load(std::memory_order_relaxed);
+    time_nsec = block_time_nsec_.load(std::memory_order_relaxed);
+    *pipeline_id = block_pipeline_id_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((seq & 1) || seq != seq_.load(std::memory_order_relaxed));
+
+  if (end == 0 || count <= 0 || quint64(count) > ring_.size()) return false;
+
+  // Find how far through the latest buffer playback has got.
+  quint64 window_start = start;
+  if (duration_nsec > 0) {
+    const qint64 elapsed = std::max<qint64>(NowNsec() - time_nsec, 0);
+    const double played = std::min(double(elapsed) / duration_nsec, 1.0);
+    window_start += quint64(played * (end - start));
+  }
+  window_start = std::min(window_start, end - std::min<quint64>(count, end));
+
+  const quint64 offset = window_start & mask_;
+  const int first = std::min<quint64>(count, ring_.size() - offset);
+  std::copy(ring_.begin() + offset, ring_.begin() + offset + first, dest);
+  std::copy(ring_.begin(), ring_.begin() + (count - first), dest + first);
+
+  // Check the writer didn't start overwriting the window while we copied it.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return reserved_end_.load(std::memory_order_relaxed) - window_start <=
+         ring_.size();
+}
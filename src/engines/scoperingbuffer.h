@@ -0,0 +1,77 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ENGINES_SCOPERINGBUFFER_H_
+#define ENGINES_SCOPERINGBUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <QtGlobal>
+
+// Passes PCM samples from a GStreamer streaming thread to the GUI thread
+// without either of them waiting for the other.  The streaming thread copies
+// each buffer into a ring and publishes where it went, and the GUI reads the
+// window of samples that's playing now.  Nothing is allocated after the
+// buffer is constructed.
+//
+// Only one thread writes at a time: while it's busy any other writer's buffer
+// is dropped, which only happens when two pipelines overlap during a
+// crossfade.
+class ScopeRingBuffer {
+ public:
+  // capacity is rounded up to a power of two.
+  explicit ScopeRingBuffer(int capacity = kDefaultCapacity);
+
+  static const int kDefaultCapacity;
+
+  // Called from the streaming thread.  duration_nsec is how long the samples
+  // take to play.
+  void Write(const int16_t* samples, int count, quint64 duration_nsec,
+             int pipeline_id);
+
+  // Copies count samples into dest and sets pipeline_id to the pipeline they
+  // came from.  The window moves through the latest buffer as it plays, so a
+  // buffer that's longer than the analyzer's frame isn't shown all at once.
+  // Returns false if nothing has been written, or the samples were
+  // overwritten while they were being copied.
+  bool ReadLatest(int16_t* dest, int count, int* pipeline_id) const;
+
+ private:
+  static qint64 NowNsec();
+
+  std::vector<int16_t> ring_;
+  const quint64 mask_;
+
+  std::atomic_flag writing_;
+
+  // Samples are numbered from the first one ever written.  The ring slots up to
+  // reserved_end_ might be being written over.
+  std::atomic<quint64> reserved_end_;
+
+  // The latest buffer, published with a sequence lock: seq_ is odd while
+  // the writer is changing them.
+  std::atomic<quint32> seq_;
+  std::atomic<quint64> block_start_;
+  std::atomic<quint64> block_end_;
+  std::atomic<quint64> block_duration_nsec_;
+  std::atomic<qint64> block_time_nsec_;
+  std::atomic<int> block_pipeline_id_;
+};
+
+#endif  // ENGINES_SCOPERINGBUFFER_H_
@@ -0,0 +1,160 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "seekindex.h"
+
+#include <algorithm>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include "core/logging.h"
+#include "core/timeconstants.h"
+#include "core/utilities.h"
+
+namespace {
+
+const quint32 kFileMagic = 0x53454b49;  // "SEKI"
+const quint32 kFileVersion = 1;
+
+bool EntryBefore(const SeekIndex::Entry& entry, qint64 nanosec) {
+  return entry.nanosec_ < nanosec;
+}
+
+}  // namespace
+
+const qint64 SeekIndex::kIntervalNanosec = 1 * kNsecPerSec;
+const int SeekIndex::kMaxFiles = 5000;
+
+SeekIndex::SeekIndex() : dirty_(false) {}
+
+QString SeekIndex::CachePath(const QUrl& url) {
+  return Utilities::GetConfigPath(Utilities::Path_SeekIndexCache) + "/" +
+         QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1)
+             .toHex();
+}
+
+void SeekIndex::FileVersion(const QUrl& url, qint64* size, qint64* mtime) {
+  *size = -1;
+  *mtime = -1;
+  if (!url.isLocalFile()) return;
+
+  const QFileInfo info(url.toLocalFile());
+  *size = info.size();
+  *mtime = info.lastModified().toMSecsSinceEpoch();
+}
+
+SeekIndex SeekIndex::Load(const QUrl& url) {
+  SeekIndex ret;
+
+  QFile file(CachePath(url));
+  if (!file.open(QIODevice::ReadOnly)) return ret;
+
+  QDataStream s(&file);
+  quint32 magic = 0;
+  quint32 version = 0;
+  qint64 size = 0;
+  qint64 mtime = 0;
+  qint32 count = 0;
+  s >> magic >> version >> size >> mtime >> count;
+
+  // Offsets are no good once the file has been rewritten, by a tag editor
+  // for example.
+  qint64 file_size = 0;
+  qint64 file_mtime = 0;
+  FileVersion(url, &file_size, &file_mtime);
+  if (magic != kFileMagic || version != kFileVersion || count < 0 ||
+      size != file_size || mtime != file_mtime) {
+    return ret;
+  }
+
+  ret.entries_.resize(count);
+  for (Entry& entry : ret.entries_) {
+    s >> entry.nanosec_ >> entry.byte_offset_;
+  }
+  if (s.status() != QDataStream::Ok) ret.entries_.clear();
+
+  return ret;
+}
+
+void SeekIndex::Save(const QUrl& url, const SeekIndex& index) {
+  QDir().mkpath(Utilities::GetConfigPath(Utilities::Path_SeekIndexCache));
+
+  QFile file(CachePath(url));
+  if (!file.open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Couldn't save seek index to" << file.fileName();
+    return;
+  }
+
+  qint64 size = 0;
+  qint64 mtime = 0;
+  FileVersion(url, &size, &mtime);
+
+  QDataStream s(&file);
+  s << kFileMagic << kFileVersion << size << mtime
+    << qint32(index.entries_.count());
+  for (const Entry& entry : index.entries_) {
+    s << entry.nanosec_ << entry.byte_offset_;
+  }
+  file.close();
+
+  Prune();
+}
+
+void SeekIndex::Prune() {
+  QDir dir(Utilities::GetConfigPath(Utilities::Path_SeekIndexCache));
+  const QFileInfoList files = dir.entryInfoList(QDir::Files, QDir::Time);
+  for (int i = kMaxFiles; i < files.count(); ++i) {
+    QFile::remove(files[i].absoluteFilePath());
+  }
+}
+
+void SeekIndex::Add(qint64 nanosec, qint64 byte_offset) {
+  // Parsers output frames far more often than entries are needed, so leave
+  // out any that are too close to one we already have.
+  auto it = std::lower_bound(entries_.begin(), entries_.end(), nanosec,
+                             EntryBefore);
+  if (it != entries_.end() && it->nanosec_ - nanosec < kIntervalNanosec) {
+    return;
+  }
+  if (it != entries_.begin() &&
+      nanosec - (it - 1)->nanosec_ < kIntervalNanosec) {
+    return;
+  }
+
+  Entry entry;
+  entry.nanosec_ = nanosec;
+  entry.byte_offset_ = byte_offset;
+  entries_.insert(it, entry);
+  dirty_ = true;
+}
+
+bool SeekIndex::Find(qint64 nanosec, Entry* entry) const {
+  auto it = std::lower_bound(entries_.begin(), entries_.end(), nanosec + 1,
+                             EntryBefore);
+  if (it == entries_.begin()) return false;
+  --it;
+
+  // Entries are only ever this far apart in parts that have been played.
+  if (nanosec - it->nanosec_ >= 2 * kIntervalNanosec) return false;
+
+  *entry = *it;
+  return true;
+}
@@ -0,0 +1,70 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINES_SEEKINDEX_H_
+#define ENGINES_SEEKINDEX_H_
+
+#include <QUrl>
+#include <QVector>
+
+// Where each part of a file starts, in bytes, at regular times through it.
+// Files without a seek table of their own, like VBR MP3s without a Xing
+// header, can only be seeked into by guessing from their average bitrate,
+// which is slow to correct and often wrong.  The index is recorded from the
+// parser's output while a file plays, and saved so that later seeks into the
+// parts that have been played before go straight to the right place.
+class SeekIndex {
+ public:
+  SeekIndex();
+
+  struct Entry {
+    qint64 nanosec_;
+    qint64 byte_offset_;
+  };
+
+  // Entries are kept about this far apart.
+  static const qint64 kIntervalNanosec;
+  // How many files to keep indexes for.
+  static const int kMaxFiles;
+
+  // Returns the index saved for url, or an empty one if there isn't one or
+  // it's a local file that has changed since.
+  static SeekIndex Load(const QUrl& url);
+  // Saves index for url.  Does file I/O, so call it in the background.
+  static void Save(const QUrl& url, const SeekIndex& index);
+
+  bool is_empty() const { return entries_.isEmpty(); }
+  // True if entries were added since the index was loaded.
+  bool is_dirty() const { return dirty_; }
+
+  void Add(qint64 nanosec, qint64 byte_offset);
+
+  // Finds the last entry before nanosec.  Returns false unless it's close
+  // enough to be sure that part of the file has been indexed.
+  bool Find(qint64 nanosec, Entry* entry) const;
+
+ private:
+  static QString CachePath(const QUrl& url);
+  // The size and modification time of a local file, or -1 for other urls.
+  static void FileVersion(const QUrl& url, qint64* size, qint64* mtime);
+  // Removes the least recently saved indexes if there are too many.
+  static void Prune();
+
+  QVector<Entry> entries_;
+  bool dirty_;
+};
+
+#endif  // ENGINES_SEEKINDEX_H_
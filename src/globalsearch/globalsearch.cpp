@@ -32,6 +32,9 @@
 const int GlobalSearch::kDelayedSearchTimeoutMs = 200;
 const char* GlobalSearch::kSettingsGroup = "GlobalSearch";
 const int GlobalSearch::kMaxResultsPerEmission = 500;
+const int GlobalSearch::kMaxCachedQueriesPerProvider = 20;
+const int GlobalSearch::kLocalResultCacheTtlSecs = 60;
+const int GlobalSearch::kRemoteResultCacheTtlSecs = 300;
 
 GlobalSearch::GlobalSearch(Application* app, QObject* parent)
     : QObject(parent),
@@ -41,6 +44,7 @@ GlobalSearch::GlobalSearch(Application* app, QObject* parent)
   cover_loader_options_.desired_height_ = SearchProvider::kArtHeight;
   cover_loader_options_.pad_output_image_ = true;
   cover_loader_options_.scale_output_image_ = true;
+  cover_loader_options_.scaled_decode_ = true;
 
   connect(app_->album_cover_loader(), SIGNAL(ImageLoaded(quint64, QImage)),
           SLOT(AlbumArtLoaded(quint64, QImage)));
@@ -54,6 +58,8 @@ void GlobalSearch::ConnectProvider(SearchProvider* provider) {
   connect(provider, SIGNAL(ResultsAvailable(int, SearchProvider::ResultList)),
           SLOT(ResultsAvailableSlot(int, SearchProvider::ResultList)));
   connect(provider, SIGNAL(SearchFinished(int)), SLOT(SearchFinishedSlot(int)));
+  connect(provider, SIGNAL(ResultsInvalidated()),
+          SLOT(ProviderResultsInvalidated()));
   connect(provider, SIGNAL(ArtLoaded(int, QImage)),
           SLOT(ArtLoadedSlot(int, QImage)));
   connect(provider, SIGNAL(destroyed(QObject*)),
@@ -98,11 +104,25 @@ void GlobalSearch::DoSearchAsync(int id, const QString& query) {
   if (url_provider_->LooksLikeUrl(query)) {
     url_provider_->SearchAsync(id, query);
   } else {
+    running_searches_[id].query_ = query;
+
     for (SearchProvider* provider : providers_.keys()) {
       if (!is_provider_usable(provider)) continue;
 
       pending_search_providers_[id]++;
 
+      // Providers we can answer from the cache don't get asked at all.  The
+      // results are emitted later so the caller has the ID by then.
+      SearchProvider::ResultList cached;
+      if (FindCachedResults(provider, query, &cached)) {
+        if (!pending_cached_hits_.contains(id)) {
+          metaObject()->invokeMethod(this, "EmitCachedResults",
+                                     Qt::QueuedConnection, Q_ARG(int, id));
+        }
+        pending_cached_hits_[id] << CachedHit(provider, cached);
+        continue;
+      }
+
       if (provider->wants_delayed_queries()) {
         if (timer_id == -1) {
           timer_id = startTimer(kDelayedSearchTimeoutMs);
@@ -117,7 +137,93 @@ void GlobalSearch::DoSearchAsync(int id, const QString& query) {
   }
 }
 
+int GlobalSearch::FetchMoreAsync(const QString& query,
+                                 SearchProvider* provider, int offset) {
+  const int id = next_id_++;
+
+  pending_search_providers_[id] = 1;
+  provider->FetchMoreAsync(id, query, offset);
+
+  return id;
+}
+
+void GlobalSearch::EmitCachedResults(int id) {
+  for (const CachedHit& hit : pending_cached_hits_.take(id)) {
+    if (!pending_search_providers_.contains(id)) return;
+
+    EmitResults(id, hit.second);
+    ProviderFinished(id, hit.first);
+  }
+}
+
+bool GlobalSearch::FindCachedResults(SearchProvider* provider,
+                                     const QString& query,
+                                     SearchProvider::ResultList* results) {
+  QList<CachedResults>* cache = &providers_[provider].cached_results_;
+  const QDateTime now = QDateTime::currentDateTime();
+
+  int best = -1;
+  for (int i = 0; i < cache->count();) {
+    const CachedResults& entry = cache->at(i);
+    if (entry.expires_ <= now) {
+      cache->removeAt(i);
+      continue;
+    }
+
+    if (entry.query_.compare(query, Qt::CaseInsensitive) == 0) {
+      *results = entry.results_;
+      cache->move(i, 0);
+      return true;
+    }
+
+    // Prefer the longest earlier query, it has the fewest results to refine.
+    if (query.startsWith(entry.query_, Qt::CaseInsensitive) &&
+        (best == -1 ||
+         entry.query_.length() > cache->at(best).query_.length())) {
+      best = i;
+    }
+    ++i;
+  }
+
+  if (best == -1) return false;
+
+  SearchProvider::ResultList refined = cache->at(best).results_;
+  if (!provider->RefineResults(query, &refined)) return false;
+
+  // The refined results are only as fresh as the ones they came from.
+  CachedResults entry;
+  entry.query_ = query;
+  entry.results_ = refined;
+  entry.expires_ = cache->at(best).expires_;
+  cache->prepend(entry);
+  while (cache->count() > kMaxCachedQueriesPerProvider) {
+    cache->removeLast();
+  }
+
+  *results = refined;
+  return true;
+}
+
+void GlobalSearch::ProviderResultsInvalidated() {
+  SearchProvider* provider = static_cast<SearchProvider*>(sender());
+  if (!providers_.contains(provider)) return;
+
+  providers_[provider].cached_results_.clear();
+
+  // Searches that are still running might have seen the old data too.
+  for (RunningSearch& search : running_searches_) {
+    search.results_.remove(provider);
+  }
+}
+
 void GlobalSearch::CancelSearch(int id) {
+  // Cancelled searches might not return everything, so don't cache them.
+  running_searches_.remove(id);
+
+  for (SearchProvider* provider : providers_.keys()) {
+    provider->CancelSearch(id);
+  }
+
   QMap<int, DelayedSearch>::iterator it;
   for (it = delayed_searches_.begin(); it != delayed_searches_.end(); ++it) {
     if (it.value().id_ == id) {
@@ -143,6 +249,13 @@ void GlobalSearch::timerEvent(QTimerEvent* e) {
 
 QString GlobalSearch::PixmapCacheKey(const SearchProvider::Result& result)
     const {
+  // Share covers with the library view where we can.
+  if (result.provider_->art_is_in_song_metadata()) {
+    const QString key = AlbumCoverLoader::PixmapCacheKey(cover_loader_options_,
+                                                         result.metadata_);
+    if (!key.isEmpty()) return key;
+  }
+
   return "globalsearch:" % QString::number(qulonglong(result.provider_)) % "," %
          result.metadata_.url().toString();
 }
@@ -151,6 +264,23 @@ void GlobalSearch::ResultsAvailableSlot(int id,
                                         SearchProvider::ResultList results) {
   if (results.isEmpty()) return;
 
+  // Load cached pixmaps into the results
+  for (SearchProvider::ResultList::iterator it = results.begin();
+       it != results.end(); ++it) {
+    it->pixmap_cache_key_ = PixmapCacheKey(*it);
+  }
+
+  SearchProvider* provider = static_cast<SearchProvider*>(sender());
+  if (running_searches_.contains(id) && providers_.contains(provider)) {
+    running_searches_[id].results_[provider].append(results);
+  }
+
+  EmitResults(id, results);
+}
+
+void GlobalSearch::EmitResults(int id, SearchProvider::ResultList results) {
+  if (results.isEmpty()) return;
+
   // Limit the number of results that are used from each emission.
   // Just a sanity check to stop some providers (Jamendo) returning thousands
   // of results.
@@ -160,25 +290,49 @@ void GlobalSearch::ResultsAvailableSlot(int id,
     results.erase(begin, results.end());
   }
 
-  // Load cached pixmaps into the results
-  for (SearchProvider::ResultList::iterator it = results.begin();
-       it != results.end(); ++it) {
-    it->pixmap_cache_key_ = PixmapCacheKey(*it);
-  }
-
   emit ResultsAvailable(id, results);
 }
 
 void GlobalSearch::SearchFinishedSlot(int id) {
+  SearchProvider* provider = static_cast<SearchProvider*>(sender());
+
+  if (running_searches_.contains(id) && providers_.contains(provider)) {
+    RunningSearch* search = &running_searches_[id];
+
+    CachedResults entry;
+    entry.query_ = search->query_;
+    entry.results_ = search->results_.take(provider);
+    entry.expires_ = QDateTime::currentDateTime().addSecs(
+        provider->wants_delayed_queries() ? kRemoteResultCacheTtlSecs
+                                          : kLocalResultCacheTtlSecs);
+
+    QList<CachedResults>* cache = &providers_[provider].cached_results_;
+    for (int i = 0; i < cache->count(); ++i) {
+      if (cache->at(i).query_.compare(entry.query_, Qt::CaseInsensitive) ==
+          0) {
+        cache->removeAt(i);
+        break;
+      }
+    }
+    cache->prepend(entry);
+    while (cache->count() > kMaxCachedQueriesPerProvider) {
+      cache->removeLast();
+    }
+  }
+
+  ProviderFinished(id, provider);
+}
+
+void GlobalSearch::ProviderFinished(int id, SearchProvider* provider) {
   if (!pending_search_providers_.contains(id)) return;
 
-  SearchProvider* provider = static_cast<SearchProvider*>(sender());
   const int remaining = --pending_search_providers_[id];
 
   emit ProviderSearchFinished(id, provider);
   if (remaining == 0) {
     emit SearchFinished(id);
     pending_search_providers_.remove(id);
+    running_searches_.remove(id);
   }
 }
 
@@ -195,6 +349,8 @@ void GlobalSearch::ProviderDestroyedSlot(QObject* object) {
     emit SearchFinished(id);
   }
   pending_search_providers_.clear();
+  running_searches_.clear();
+  pending_cached_hits_.clear();
 }
 
 QList<SearchProvider*> GlobalSearch::providers() const {
@@ -224,10 +380,11 @@ int GlobalSearch::LoadArtAsync(const SearchProvider::Result& result) {
 
     QList<QueuedArt>* queued_art = &providers_[result.provider_].queued_art_;
 
-    queued_art->append(request);
-
-    if (queued_art->count() == 1) {
+    if (queued_art->isEmpty()) {
+      queued_art->append(request);
       TakeNextQueuedArt(result.provider_);
+    } else {
+      queued_art->insert(1, request);
     }
   } else {
     result.provider_->LoadArtAsync(id, result);
@@ -236,6 +393,31 @@ int GlobalSearch::LoadArtAsync(const SearchProvider::Result& result) {
   return id;
 }
 
+bool GlobalSearch::CancelArt(int id) {
+  for (auto it = cover_loader_tasks_.begin(); it != cover_loader_tasks_.end();
+       ++it) {
+    if (it.value() == id) {
+      app_->album_cover_loader()->CancelTask(it.key());
+      cover_loader_tasks_.erase(it);
+      pending_art_searches_.remove(id);
+      return true;
+    }
+  }
+
+  for (ProviderData& data : providers_) {
+    // Skip the first request, the provider already has it.
+    for (int i = 1; i < data.queued_art_.count(); ++i) {
+      if (data.queued_art_[i].id_ == id) {
+        data.queued_art_.removeAt(i);
+        pending_art_searches_.remove(id);
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
 void GlobalSearch::TakeNextQueuedArt(SearchProvider* provider) {
   if (!providers_.contains(provider) ||
       providers_[provider].queued_art_.isEmpty())
@@ -18,6 +18,7 @@
 #ifndef GLOBALSEARCH_H
 #define GLOBALSEARCH_H
 
+#include <QDateTime>
 #include <QObject>
 #include <QPixmapCache>
 
@@ -37,6 +38,9 @@ class GlobalSearch : public QObject {
   static const int kDelayedSearchTimeoutMs;
   static const char* kSettingsGroup;
   static const int kMaxResultsPerEmission;
+  static const int kMaxCachedQueriesPerProvider;
+  static const int kLocalResultCacheTtlSecs;
+  static const int kRemoteResultCacheTtlSecs;
 
   Application* application() const { return app_; }
 
@@ -46,12 +50,19 @@ class GlobalSearch : public QObject {
   bool SetProviderEnabled(const SearchProvider* provider, bool enabled);
 
   int SearchAsync(const QString& query);
+  // Asks a provider with the CanFetchMoreResults hint for the results after
+  // the first offset ones.  They're emitted with ResultsAvailable as usual.
+  int FetchMoreAsync(const QString& query, SearchProvider* provider,
+                     int offset);
   int LoadArtAsync(const SearchProvider::Result& result);
   MimeData* LoadTracks(const SearchProvider::ResultList& results);
   QStringList GetSuggestions(int count);
 
   void CancelSearch(int id);
-  void CancelArt(int id);
+  // Forgets an art request that's no longer needed.  Returns false if it had
+  // already been sent to the provider, in which case ArtLoaded is still
+  // emitted for it.
+  bool CancelArt(int id);
 
   bool FindCachedPixmap(const SearchProvider::Result& result,
                         QPixmap* pixmap) const;
@@ -84,6 +95,8 @@ signals:
   void DoSearchAsync(int id, const QString& query);
   void ResultsAvailableSlot(int id, SearchProvider::ResultList results);
   void SearchFinishedSlot(int id);
+  void EmitCachedResults(int id);
+  void ProviderResultsInvalidated();
 
   void ArtLoadedSlot(int id, const QImage& image);
   void AlbumArtLoaded(quint64 id, const QImage& image);
@@ -96,6 +109,14 @@ signals:
   void TakeNextQueuedArt(SearchProvider* provider);
   QString PixmapCacheKey(const SearchProvider::Result& result) const;
 
+  void EmitResults(int id, SearchProvider::ResultList results);
+  void ProviderFinished(int id, SearchProvider* provider);
+
+  // Looks for results for this query in the provider's cache, either for the
+  // same query or by refining the results of a shorter one.
+  bool FindCachedResults(SearchProvider* provider, const QString& query,
+                         SearchProvider::ResultList* results);
+
   void SaveProvidersSettings();
 
  private:
@@ -110,11 +131,32 @@ signals:
     SearchProvider::Result result_;
   };
 
+  struct CachedResults {
+    QString query_;
+    SearchProvider::ResultList results_;
+    QDateTime expires_;
+  };
+
   struct ProviderData {
+    // The first request is the one the provider is working on.  Newer
+    // requests go before older ones, since they're for the rows that were
+    // painted last, so are most likely still visible.
     QList<QueuedArt> queued_art_;
     bool enabled_;
+
+    // Most recently used first.
+    QList<CachedResults> cached_results_;
   };
 
+  // Results collected so far for a search that hasn't been cancelled, so
+  // they can be cached once each provider finishes.
+  struct RunningSearch {
+    QString query_;
+    QMap<SearchProvider*, SearchProvider::ResultList> results_;
+  };
+
+  typedef QPair<SearchProvider*, SearchProvider::ResultList> CachedHit;
+
   Application* app_;
 
   QMap<SearchProvider*, ProviderData> providers_;
@@ -123,6 +165,8 @@ signals:
 
   int next_id_;
   QMap<int, int> pending_search_providers_;
+  QMap<int, RunningSearch> running_searches_;
+  QMap<int, QList<CachedHit>> pending_cached_hits_;
 
   QPixmapCache pixmap_cache_;
   QMap<int, QString> pending_art_searches_;
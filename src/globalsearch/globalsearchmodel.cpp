@@ -17,15 +17,20 @@
 
 #include "globalsearch.h"
 #include "globalsearchmodel.h"
+#include "core/memoryaccounting.h"
 #include "core/mimedata.h"
 #include "ui/iconloader.h"
 
 #include <QSortFilterProxyModel>
+#include <QTimer>
+
+const int GlobalSearchModel::kAddResultsIntervalMsec = 16;
 
 GlobalSearchModel::GlobalSearchModel(GlobalSearch* engine, QObject* parent)
     : QStandardItemModel(parent),
       engine_(engine),
       proxy_(nullptr),
+      add_results_timer_(new QTimer(this)),
       use_pretty_covers_(true),
       artist_icon_(IconLoader::Load("x-clementine-artist", IconLoader::Base)),
       album_icon_(IconLoader::Load("x-clementine-album", IconLoader::Base)) {
@@ -38,9 +43,56 @@ GlobalSearchModel::GlobalSearchModel(GlobalSearch* engine, QObject* parent)
       LibraryModel::kPrettyCoverSize, 
       LibraryModel::kPrettyCoverSize,
       Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+  add_results_timer_->setSingleShot(true);
+  add_results_timer_->setInterval(kAddResultsIntervalMsec);
+  connect(add_results_timer_, SIGNAL(timeout()), SLOT(AddPendingResults()));
+
+  MemoryAccounting::Instance()->Register(
+      this, "global_search_results", "Global search results", [this]() {
+        qint64 results = CountItems(invisibleRootItem());
+        for (const SearchProvider::ResultList& list : pending_results_) {
+          results += list.count();
+        }
+        return results * MemoryAccounting::kEstimatedSongBytes;
+      });
+}
+
+int GlobalSearchModel::CountItems(const QStandardItem* item) {
+  int ret = item->rowCount();
+  for (int i = 0; i < item->rowCount(); ++i) {
+    ret += CountItems(item->child(i));
+  }
+  return ret;
 }
 
 void GlobalSearchModel::AddResults(const SearchProvider::ResultList& results) {
+  if (results.isEmpty()) return;
+
+  pending_results_ << results;
+  if (!add_results_timer_->isActive()) {
+    add_results_timer_->start();
+  }
+}
+
+void GlobalSearchModel::AddPendingResults() {
+  // Merge the batches from each provider so each gets inserted in one go.
+  QList<SearchProvider*> providers;
+  QMap<SearchProvider*, SearchProvider::ResultList> results;
+  for (const SearchProvider::ResultList& batch : pending_results_) {
+    SearchProvider* provider = batch.first().provider_;
+    if (!results.contains(provider)) providers << provider;
+    results[provider].append(batch);
+  }
+  pending_results_.clear();
+
+  for (SearchProvider* provider : providers) {
+    InsertResults(results[provider]);
+  }
+}
+
+void GlobalSearchModel::InsertResults(
+    const SearchProvider::ResultList& results) {
   int sort_index = 0;
 
   // Create a divider for this provider if we haven't seen it before.
@@ -67,6 +119,10 @@ void GlobalSearchModel::AddResults(const SearchProvider::ResultList& results) {
     sort_index = provider_sort_indices_[provider];
   }
 
+  // Collect the new items under each parent and append them together.
+  QList<QStandardItem*> parents;
+  QMap<QStandardItem*, QList<QStandardItem*>> new_items;
+
   for (const SearchProvider::Result& result : results) {
     QStandardItem* parent = invisibleRootItem();
 
@@ -84,7 +140,12 @@ void GlobalSearchModel::AddResults(const SearchProvider::ResultList& results) {
     item->setData(QVariant::fromValue(result), Role_Result);
     item->setData(sort_index, Role_ProviderIndex);
 
-    parent->appendRow(item);
+    if (!new_items.contains(parent)) parents << parent;
+    new_items[parent] << item;
+  }
+
+  for (QStandardItem* parent : parents) {
+    parent->appendRows(new_items[parent]);
   }
 }
 
@@ -213,6 +274,8 @@ QStandardItem* GlobalSearchModel::BuildContainers(const Song& s,
 }
 
 void GlobalSearchModel::Clear() {
+  add_results_timer_->stop();
+  pending_results_.clear();
   provider_sort_indices_.clear();
   containers_.clear();
   next_provider_sort_index_ = 1000;
@@ -321,7 +384,7 @@ void GlobalSearchModel::SetGroupBy(const LibraryModel::Grouping& grouping,
     Clear();
 
     for (const SearchProvider::ResultList& result_list : results) {
-      AddResults(result_list);
+      InsertResults(result_list);
     }
   }
 }
@@ -26,6 +26,7 @@
 class GlobalSearch;
 
 class QSortFilterProxyModel;
+class QTimer;
 
 class GlobalSearchModel : public QStandardItemModel {
   Q_OBJECT
@@ -33,6 +34,8 @@ class GlobalSearchModel : public QStandardItemModel {
  public:
   GlobalSearchModel(GlobalSearch* engine, QObject* parent = nullptr);
 
+  static const int kAddResultsIntervalMsec;
+
   enum Role {
     Role_Result = LibraryModel::LastRole,
     Role_LazyLoadingArt,
@@ -63,14 +66,21 @@ class GlobalSearchModel : public QStandardItemModel {
   QMimeData* mimeData(const QModelIndexList& indexes) const;
 
  public slots:
+  // Results are queued and added to the model together every
+  // kAddResultsIntervalMsec, so the view is only re-sorted once per batch.
   void AddResults(const SearchProvider::ResultList& results);
 
+ private slots:
+  void AddPendingResults();
+
  private:
+  void InsertResults(const SearchProvider::ResultList& results);
   QStandardItem* BuildContainers(const Song& metadata, QStandardItem* parent,
                                  ContainerKey* key, int level = 0);
   void GetChildResults(const QStandardItem* item,
                        SearchProvider::ResultList* results,
                        QSet<const QStandardItem*>* visited) const;
+  static int CountItems(const QStandardItem* item);
 
  private:
   GlobalSearch* engine_;
@@ -82,6 +92,9 @@ class GlobalSearchModel : public QStandardItemModel {
   int next_provider_sort_index_;
   QMap<ContainerKey, QStandardItem*> containers_;
 
+  QTimer* add_results_timer_;
+  QList<SearchProvider::ResultList> pending_results_;
+
   QStringList provider_order_;
   bool use_pretty_covers_;
   QIcon artist_icon_;
@@ -18,6 +18,7 @@
 #include "globalsearchview.h"
 
 #include <QMenu>
+#include <QScrollBar>
 #include <QSortFilterProxyModel>
 #include <QStandardItem>
 #include <QTimer>
@@ -88,6 +89,8 @@ GlobalSearchView::GlobalSearchView(Application* app, QWidget* parent)
           SIGNAL(AddToPlaylist(QMimeData*)));
   connect(ui_->results, SIGNAL(FocusOnFilterSignal(QKeyEvent*)),
           SLOT(FocusOnFilter(QKeyEvent*)));
+  connect(ui_->results->verticalScrollBar(), SIGNAL(valueChanged(int)),
+          SLOT(ResultsScrolled(int)));
 
   // Set the appearance of the results list
   ui_->results->setItemDelegate(new GlobalSearchItemDelegate(this));
@@ -161,6 +164,8 @@ GlobalSearchView::GlobalSearchView(Application* app, QWidget* parent)
   connect(engine_, SIGNAL(ResultsAvailable(int, SearchProvider::ResultList)),
           SLOT(AddResults(int, SearchProvider::ResultList)),
           Qt::QueuedConnection);
+  connect(engine_, SIGNAL(SearchFinished(int)), SLOT(SearchFinished(int)),
+          Qt::QueuedConnection);
   connect(engine_, SIGNAL(ArtLoaded(int, QPixmap)),
           SLOT(ArtLoaded(int, QPixmap)), Qt::QueuedConnection);
 }
@@ -290,6 +295,14 @@ void GlobalSearchView::TextEdited(const QString& text) {
 
   // Cancel the last search (if any) and start the new one.
   engine_->CancelSearch(last_search_id_);
+  for (int id : fetch_more_requests_.keys()) {
+    engine_->CancelSearch(id);
+  }
+  fetch_more_requests_.clear();
+  result_counts_.clear();
+  exhausted_providers_.clear();
+  last_query_ = trimmed;
+
   // If text query is empty, don't start a new search
   if (trimmed.isEmpty()) {
     last_search_id_ = -1;
@@ -300,11 +313,72 @@ void GlobalSearchView::TextEdited(const QString& text) {
 
 void GlobalSearchView::AddResults(int id,
                                   const SearchProvider::ResultList& results) {
-  if (id != last_search_id_ || results.isEmpty()) return;
+  if (results.isEmpty()) return;
+  if (id != last_search_id_ && !fetch_more_requests_.contains(id)) return;
 
+  result_counts_[results.first().provider_] += results.count();
   current_model_->AddResults(results);
 }
 
+void GlobalSearchView::SearchFinished(int id) {
+  if (!fetch_more_requests_.contains(id)) return;
+
+  // Stop asking a provider for more once it returns nothing new.
+  const FetchMoreRequest request = fetch_more_requests_.take(id);
+  if (result_counts_.value(request.provider_) == request.offset_) {
+    exhausted_providers_.insert(request.provider_);
+  }
+}
+
+void GlobalSearchView::ResultsScrolled(int value) {
+  const QScrollBar* scroll_bar = ui_->results->verticalScrollBar();
+  if (value >= scroll_bar->maximum() - scroll_bar->pageStep()) {
+    FetchMoreResults();
+  }
+  CancelOffscreenArt();
+}
+
+void GlobalSearchView::CancelOffscreenArt() {
+  const QRect viewport = ui_->results->viewport()->rect();
+
+  for (auto it = art_requests_.begin(); it != art_requests_.end();) {
+    const QModelIndex proxy_index = front_proxy_->mapFromSource(it.value());
+    if (ui_->results->visualRect(proxy_index).intersects(viewport) ||
+        !engine_->CancelArt(it.key())) {
+      ++it;
+      continue;
+    }
+
+    front_model_->itemFromIndex(it.value())
+        ->setData(QVariant(), GlobalSearchModel::Role_LazyLoadingArt);
+    it = art_requests_.erase(it);
+  }
+}
+
+void GlobalSearchView::FetchMoreResults() {
+  for (SearchProvider* provider : result_counts_.keys()) {
+    if (!provider->can_fetch_more_results() ||
+        exhausted_providers_.contains(provider)) {
+      continue;
+    }
+
+    // Wait for the last page from this provider to arrive first.
+    bool pending = false;
+    for (const FetchMoreRequest& request : fetch_more_requests_) {
+      if (request.provider_ == provider) pending = true;
+    }
+    if (pending) continue;
+
+    FetchMoreRequest request;
+    request.provider_ = provider;
+    request.offset_ = result_counts_[provider];
+
+    const int id =
+        engine_->FetchMoreAsync(last_query_, provider, request.offset_);
+    fetch_more_requests_[id] = request;
+  }
+}
+
 void GlobalSearchView::SwapModels() {
   art_requests_.clear();
 
@@ -360,6 +434,14 @@ void GlobalSearchView::LazyLoadArt(const QModelIndex& proxy_index) {
       item->data(GlobalSearchModel::Role_Result)
           .value<SearchProvider::Result>();
 
+  // The library view might have loaded it already.
+  QPixmap pixmap;
+  if (engine_->FindCachedPixmap(result, &pixmap) && !pixmap.isNull()) {
+    front_model_->itemFromIndex(source_index)
+        ->setData(pixmap, Qt::DecorationRole);
+    return;
+  }
+
   // Load the art.
   int id = engine_->LoadArtAsync(result);
   art_requests_[id] = source_index;
@@ -23,6 +23,7 @@
 #include "ui/settingsdialog.h"
 #include "playlist/playlistmanager.h"
 
+#include <QSet>
 #include <QWidget>
 
 class Application;
@@ -74,6 +75,8 @@ signals:
   void SwapModels();
   void TextEdited(const QString& text);
   void AddResults(int id, const SearchProvider::ResultList& results);
+  void SearchFinished(int id);
+  void ResultsScrolled(int value);
   void ArtLoaded(int id, const QPixmap& pixmap);
 
   void FocusOnFilter(QKeyEvent* event);
@@ -89,7 +92,17 @@ signals:
   void SetGroupBy(const LibraryModel::Grouping& grouping);
 
  private:
+  struct FetchMoreRequest {
+    SearchProvider* provider_;
+    int offset_;
+  };
+
   MimeData* SelectedMimeData();
+  void FetchMoreResults();
+  // Cancels the art requests for rows that have been scrolled out of view, so
+  // the ones on screen get their art sooner.  The cancelled rows ask again if
+  // they're painted later.
+  void CancelOffscreenArt();
 
   bool SearchKeyEvent(QKeyEvent* event);
   bool ResultsContextMenuEvent(QContextMenuEvent* event);
@@ -105,6 +118,13 @@ signals:
   QActionGroup* group_by_actions_;
 
   int last_search_id_;
+  QString last_query_;
+
+  // Providers with the CanFetchMoreResults hint are asked for another page
+  // when the user scrolls to the bottom of the results.
+  QMap<SearchProvider*, int> result_counts_;
+  QMap<int, FetchMoreRequest> fetch_more_requests_;
+  QSet<SearchProvider*> exhausted_providers_;
 
   // Like graphics APIs have a front buffer and a back buffer, there's a front
   // model and a back model - the front model is the one that's shown in the
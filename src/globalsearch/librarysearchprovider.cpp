@@ -23,8 +23,25 @@
 #include "library/sqlrow.h"
 #include "playlist/songmimedata.h"
 
+#include <QRegExp>
 #include <QStack>
 
+namespace {
+
+// sqlite's FTS tokenizer ignores case and diacritics, so do the same when
+// matching results ourselves.
+QString FoldForMatching(const QString& text) {
+  QString ret = text.normalized(QString::NormalizationForm_D);
+  for (int i = ret.length() - 1; i >= 0; --i) {
+    if (ret[i].category() == QChar::Mark_NonSpacing) ret.remove(i, 1);
+  }
+  return ret;
+}
+
+}  // namespace
+
+const int LibrarySearchProvider::kResultsPerPage = 250;
+
 LibrarySearchProvider::LibrarySearchProvider(LibraryBackendInterface* backend,
                                              const QString& name,
                                              const QString& id,
@@ -32,23 +49,52 @@ LibrarySearchProvider::LibrarySearchProvider(LibraryBackendInterface* backend,
                                              bool enabled_by_default,
                                              Application* app, QObject* parent)
     : BlockingSearchProvider(app, parent), backend_(backend) {
-  Hints hints =
-      WantsSerialisedArtQueries | ArtIsInSongMetadata | CanGiveSuggestions;
+  Hints hints = WantsSerialisedArtQueries | ArtIsInSongMetadata |
+                CanGiveSuggestions | CanFetchMoreResults;
 
   if (!enabled_by_default) {
     hints |= DisabledByDefault;
   }
 
   Init(name, id, icon, hints);
+
+  connect(backend_, SIGNAL(SongsChanged(LibraryChanges)),
+          SLOT(SongsChanged(LibraryChanges)));
+}
+
+void LibrarySearchProvider::SongsChanged(const LibraryChanges& changes) {
+  // Play counts and ratings aren't searched.
+  if (changes.contains(LibraryChanges::Change_Discovered |
+                       LibraryChanges::Change_Deleted)) {
+    emit ResultsInvalidated();
+  }
 }
 
 SearchProvider::ResultList LibrarySearchProvider::Search(int id,
                                                          const QString& query) {
+  return RunQuery(id, query, 0);
+}
+
+SearchProvider::ResultList LibrarySearchProvider::SearchMore(
+    int id, const QString& query, int offset) {
+  return RunQuery(id, query, offset);
+}
+
+SearchProvider::ResultList LibrarySearchProvider::RunQuery(
+    int id, const QString& query, int offset) {
   QueryOptions options;
   options.set_filter(query);
 
+  // Let sqlite rank the matches and only fetch one page of the best ones,
+  // broad queries can match most of the library.  Queries without a full text
+  // part can't be ranked, but still need a stable order to page through.
   LibraryQuery q(options);
   q.SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
+  q.SetOrderByRelevance();
+  q.SetOrderBy("%songs_table.ROWID");
+  q.SetLimit(kResultsPerPage);
+  q.SetOffset(offset);
+  q.SetCancelFlag(cancel_flag(id));
 
   if (!backend_->ExecQuery(&q)) {
     return ResultList();
@@ -65,6 +111,35 @@ SearchProvider::ResultList LibrarySearchProvider::Search(int id,
   return ret;
 }
 
+bool LibrarySearchProvider::RefineResults(const QString& query,
+                                          ResultList* results) const {
+  // Column filters, phrases and punctuation are handled by LibraryQuery in
+  // ways a substring match can't reproduce, so only refine plain words.
+  if (query.contains(QRegExp("[^\\w\\s]"))) return false;
+
+  // A full page might not contain all the matches for the longer query.
+  if (results->count() >= kResultsPerPage) return false;
+
+  const QStringList tokens = TokenizeQuery(FoldForMatching(query));
+
+  for (ResultList::iterator it = results->begin(); it != results->end();) {
+    const Song& s = it->metadata_;
+    const QString text = FoldForMatching(
+        QStringList({s.title(), s.album(), s.artist(), s.albumartist(),
+                     s.composer(), s.performer(), s.grouping(), s.genre(),
+                     s.comment(), QString::number(s.year())})
+            .join(' '));
+
+    if (Matches(tokens, text)) {
+      ++it;
+    } else {
+      it = results->erase(it);
+    }
+  }
+
+  return true;
+}
+
 MimeData* LibrarySearchProvider::LoadTracks(const ResultList& results) {
   MimeData* ret = SearchProvider::LoadTracks(results);
   static_cast<SongMimeData*>(ret)->backend = backend_;
@@ -19,20 +19,33 @@
 #define LIBRARYSEARCHPROVIDER_H
 
 #include "searchprovider.h"
+#include "library/librarychanges.h"
 
 class LibraryBackendInterface;
 
 class LibrarySearchProvider : public BlockingSearchProvider {
+  Q_OBJECT
+
  public:
   LibrarySearchProvider(LibraryBackendInterface* backend, const QString& name,
                         const QString& id, const QIcon& icon,
                         bool enabled_by_default, Application* app,
                         QObject* parent = nullptr);
 
+  static const int kResultsPerPage;
+
   ResultList Search(int id, const QString& query);
+  ResultList SearchMore(int id, const QString& query, int offset);
+  bool RefineResults(const QString& query, ResultList* results) const;
   MimeData* LoadTracks(const ResultList& results);
   QStringList GetSuggestions(int count);
 
+ private slots:
+  void SongsChanged(const LibraryChanges& changes);
+
+ private:
+  ResultList RunQuery(int id, const QString& query, int offset);
+
  private:
   LibraryBackendInterface* backend_;
 };
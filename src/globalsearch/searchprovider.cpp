@@ -19,9 +19,9 @@
 
 #include <QPainter>
 #include <QUrl>
-#include <QtConcurrentRun>
 
 #include "core/closure.h"
+#include "core/taskexecutor.h"
 #include "internet/core/internetsongmimedata.h"
 #include "playlist/songmimedata.h"
 
@@ -79,16 +79,56 @@ BlockingSearchProvider::BlockingSearchProvider(Application* app,
     : SearchProvider(app, parent) {}
 
 void BlockingSearchProvider::SearchAsync(int id, const QString& query) {
-  QFuture<ResultList> future =
-      QtConcurrent::run(this, &BlockingSearchProvider::Search, id, query);
+  CreateCancelFlag(id);
+  WatchBlockingSearch(
+      id, TaskExecutor::Instance()->Run<ResultList>(
+              TaskExecutor::Lane_Interactive,
+              std::bind(&BlockingSearchProvider::Search, this, id, query)));
+}
+
+void BlockingSearchProvider::FetchMoreAsync(int id, const QString& query,
+                                            int offset) {
+  CreateCancelFlag(id);
+  WatchBlockingSearch(
+      id, TaskExecutor::Instance()->Run<ResultList>(
+              TaskExecutor::Lane_Interactive,
+              std::bind(&BlockingSearchProvider::SearchMore, this, id, query,
+                        offset)));
+}
+
+void BlockingSearchProvider::CreateCancelFlag(int id) {
+  QMutexLocker l(&cancel_flags_mutex_);
+  cancel_flags_[id] = std::make_shared<QAtomicInt>(0);
+}
+
+void BlockingSearchProvider::WatchBlockingSearch(int id,
+                                                 QFuture<ResultList> future) {
   NewClosure(future, this,
              SLOT(BlockingSearchFinished(QFuture<ResultList>, int)), future,
              id);
 }
 
+void BlockingSearchProvider::CancelSearch(int id) {
+  QMutexLocker l(&cancel_flags_mutex_);
+  if (cancel_flags_.contains(id)) cancel_flags_[id]->store(1);
+}
+
+std::shared_ptr<QAtomicInt> BlockingSearchProvider::cancel_flag(int id) {
+  QMutexLocker l(&cancel_flags_mutex_);
+  return cancel_flags_.value(id);
+}
+
 void BlockingSearchProvider::BlockingSearchFinished(QFuture<ResultList> future,
                                                     const int id) {
-  emit ResultsAvailable(id, future.result());
+  std::shared_ptr<QAtomicInt> flag;
+  {
+    QMutexLocker l(&cancel_flags_mutex_);
+    flag = cancel_flags_.take(id);
+  }
+
+  if (!flag || !flag->load()) {
+    emit ResultsAvailable(id, future.result());
+  }
   emit SearchFinished(id);
 }
 
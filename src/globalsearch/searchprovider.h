@@ -18,9 +18,14 @@
 #ifndef SEARCHPROVIDER_H
 #define SEARCHPROVIDER_H
 
+#include <memory>
+
+#include <QAtomicInt>
 #include <QFuture>
 #include <QIcon>
+#include <QMap>
 #include <QMetaType>
+#include <QMutex>
 #include <QObject>
 
 #include "core/song.h"
@@ -98,7 +103,11 @@ class SearchProvider : public QObject {
     // SongMimeData containing the entire metadata for each result being loaded.
     // Setting this flag will cause a plain MimeData to be created containing
     // only the URLs of the results.
-    MimeDataContainsUrlsOnly = 0x80
+    MimeDataContainsUrlsOnly = 0x80,
+
+    // Indicates that this provider returns a limited number of results for
+    // each search, best first, and can return more with FetchMoreAsync.
+    CanFetchMoreResults = 0x100
   };
   Q_DECLARE_FLAGS(Hints, Hint)
 
@@ -121,10 +130,28 @@ class SearchProvider : public QObject {
   bool mime_data_contains_urls_only() const {
     return hints() & MimeDataContainsUrlsOnly;
   }
+  bool can_fetch_more_results() const { return hints() & CanFetchMoreResults; }
 
   // Starts a search.  Must emit ResultsAvailable zero or more times and then
   // SearchFinished exactly once, using this ID.
   virtual void SearchAsync(int id, const QString& query) = 0;
+  // Stops a search started by SearchAsync if the provider is able to.  The
+  // provider still emits SearchFinished for it.
+  virtual void CancelSearch(int id) {}
+  // Continues a search, skipping the first offset results.  Must emit
+  // ResultsAvailable and SearchFinished like SearchAsync.  Remember to set the
+  // CanFetchMoreResults hint.
+  virtual void FetchMoreAsync(int id, const QString& query, int offset) {
+    emit SearchFinished(id);
+  }
+
+  // Given all the results this provider returned for a query, removes the
+  // ones that don't match a longer query starting with the same text.  Lets
+  // GlobalSearch answer as-you-type queries without searching again.
+  // Returns false if the provider can't tell, which is the default.
+  virtual bool RefineResults(const QString& query, ResultList* results) const {
+    return false;
+  }
 
   // Starts loading an icon for a result that was previously emitted by
   // ResultsAvailable.  Must emit ArtLoaded exactly once with this ID.
@@ -154,6 +181,10 @@ signals:
   void ResultsAvailable(int id, const SearchProvider::ResultList& results);
   void SearchFinished(int id);
 
+  // Emitted when results returned earlier might have changed, so GlobalSearch
+  // shouldn't reuse them.
+  void ResultsInvalidated();
+
   void ArtLoaded(int id, const QImage& image);
 
  protected:
@@ -206,10 +237,28 @@ class BlockingSearchProvider : public SearchProvider {
   BlockingSearchProvider(Application* app, QObject* parent = nullptr);
 
   void SearchAsync(int id, const QString& query);
+  void CancelSearch(int id);
+  void FetchMoreAsync(int id, const QString& query, int offset);
   virtual ResultList Search(int id, const QString& query) = 0;
+  virtual ResultList SearchMore(int id, const QString& query, int offset) {
+    return ResultList();
+  }
+
+ protected:
+  // Becomes non-zero when the search is cancelled.  Search() can pass it on
+  // to whatever does the work (see LibraryQuery::SetCancelFlag) or poll it.
+  std::shared_ptr<QAtomicInt> cancel_flag(int id);
 
  private slots:
   void BlockingSearchFinished(QFuture<ResultList> future, const int id);
+
+ private:
+  void CreateCancelFlag(int id);
+  void WatchBlockingSearch(int id, QFuture<ResultList> future);
+
+ private:
+  QMutex cancel_flags_mutex_;
+  QMap<int, std::shared_ptr<QAtomicInt>> cancel_flags_;
 };
 
 Q_DECLARE_METATYPE(SearchProvider*)
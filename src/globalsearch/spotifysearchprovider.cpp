@@ -29,6 +29,7 @@
 namespace {
 const int kSearchSongLimit = 5;
 const int kSearchAlbumLimit = 20;
+const int kMaxCompleteQueries = 100;
 }
 
 SpotifySearchProvider::SpotifySearchProvider(Application* app, QObject* parent)
@@ -90,6 +91,13 @@ void SpotifySearchProvider::SearchFinishedSlot(
   PendingState state = it.value();
   queries_.erase(it);
 
+  if (complete_queries_.count() >= kMaxCompleteQueries) {
+    complete_queries_.clear();
+  }
+  complete_queries_[query_string.toLower()] =
+      response.result_size() < kSearchSongLimit &&
+      response.album_size() < kSearchAlbumLimit;
+
   /* Here we clean up Spotify's results for our purposes
    *
    * Since Spotify doesn't give us an album artist,
@@ -172,6 +180,40 @@ void SpotifySearchProvider::SearchFinishedSlot(
   emit SearchFinished(state.orig_id_);
 }
 
+bool SpotifySearchProvider::RefineResults(const QString& query,
+                                          ResultList* results) const {
+  const QStringList tokens = TokenizeQuery(query);
+
+  // GlobalSearch refines the results of the longest earlier query that this
+  // one starts with.  If Spotify cut that one off at the limits, a longer
+  // query could match tracks that weren't returned.
+  const QString query_string = tokens.join(" ").toLower();
+  QString base;
+  for (auto it = complete_queries_.begin(); it != complete_queries_.end();
+       ++it) {
+    if (it.key() != query_string && query_string.startsWith(it.key()) &&
+        it.key().length() > base.length()) {
+      base = it.key();
+    }
+  }
+  if (base.isEmpty() || !complete_queries_[base]) return false;
+
+  for (ResultList::iterator it = results->begin(); it != results->end();) {
+    const Song& s = it->metadata_;
+    const QString text =
+        QStringList({s.title(), s.album(), s.artist(), s.albumartist()})
+            .join(' ');
+
+    if (Matches(tokens, text)) {
+      ++it;
+    } else {
+      it = results->erase(it);
+    }
+  }
+
+  return true;
+}
+
 void SpotifySearchProvider::LoadArtAsync(int id, const Result& result) {
   SpotifyServer* s = server();
   if (!s) {
@@ -31,6 +31,7 @@ class SpotifySearchProvider : public SearchProvider {
   SpotifySearchProvider(Application* app, QObject* parent = nullptr);
 
   void SearchAsync(int id, const QString& query) override;
+  bool RefineResults(const QString& query, ResultList* results) const override;
   void LoadArtAsync(int id, const Result& result) override;
   QStringList GetSuggestions(int count) override;
 
@@ -58,6 +59,9 @@ class SpotifySearchProvider : public SearchProvider {
   SpotifyService* service_;
 
   QMap<QString, PendingState> queries_;
+  // Whether Spotify returned everything that matched each recent query, or
+  // stopped at the result limits.  Only complete results can be refined.
+  QMap<QString, bool> complete_queries_;
   QMap<QString, int> pending_art_;
   QMap<QString, int> pending_tracks_;
 
@@ -28,6 +28,7 @@
 #include "core/waitforsignal.h"
 #include "internet/box/boxurlhandler.h"
 #include "internet/core/oauthenticator.h"
+#include "internet/core/oauthtokenrefresher.h"
 #include "library/librarybackend.h"
 #include "ui/iconloader.h"
 
@@ -54,7 +55,11 @@ static const char* kEvents = "https://api.box.com/2.0/events";
 BoxService::BoxService(Application* app, InternetModel* parent)
     : CloudFileService(app, parent, kServiceName, kSettingsGroup,
                        IconLoader::Load("box", IconLoader::Provider), 
-                       SettingsDialog::Page_Box) {
+                       SettingsDialog::Page_Box),
+      token_refresher_(new OAuthTokenRefresher(kClientId, kClientSecret,
+                                               kOAuthTokenEndpoint, this)) {
+  connect(token_refresher_, SIGNAL(Refreshed(QString, QDateTime, QString)),
+          SLOT(TokenRefreshed(QString, QDateTime, QString)));
   app->player()->RegisterUrlHandler(new BoxUrlHandler(this, this));
 }
 
@@ -103,6 +108,7 @@ void BoxService::ConnectFinished(OAuthenticator* oauth) {
 
   access_token_ = oauth->access_token();
   expiry_time_ = oauth->expiry_time();
+  token_refresher_->Watch(oauth->refresh_token(), expiry_time_);
 
   if (s.value("name").toString().isEmpty()) {
     QUrl url(kUserInfo);
@@ -118,6 +124,18 @@ void BoxService::ConnectFinished(OAuthenticator* oauth) {
   UpdateFiles();
 }
 
+void BoxService::TokenRefreshed(const QString& access_token,
+                                const QDateTime& expiry_time,
+                                const QString& refresh_token) {
+  // Box hands out a new refresh token every time.
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  s.setValue("refresh_token", refresh_token);
+
+  access_token_ = access_token;
+  expiry_time_ = expiry_time;
+}
+
 void BoxService::AddAuthorizationHeader(QNetworkRequest* request) const {
   request->setRawHeader("Authorization",
                         QString("Bearer %1").arg(access_token_).toUtf8());
@@ -139,6 +157,8 @@ void BoxService::FetchUserInfoFinished(QNetworkReply* reply) {
 }
 
 void BoxService::ForgetCredentials() {
+  token_refresher_->Stop();
+
   QSettings s;
   s.beginGroup(kSettingsGroup);
 
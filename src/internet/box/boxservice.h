@@ -24,6 +24,7 @@
 #include <QDateTime>
 
 class OAuthenticator;
+class OAuthTokenRefresher;
 class QNetworkReply;
 class QNetworkRequest;
 
@@ -48,6 +49,9 @@ class BoxService : public CloudFileService {
 
  private slots:
   void ConnectFinished(OAuthenticator* oauth);
+  void TokenRefreshed(const QString& access_token,
+                      const QDateTime& expiry_time,
+                      const QString& refresh_token);
   void FetchUserInfoFinished(QNetworkReply* reply);
   void FetchFolderItemsFinished(QNetworkReply* reply, const int folder_id);
   void RedirectFollowed(QNetworkReply* reply, const Song& song,
@@ -67,6 +71,8 @@ class BoxService : public CloudFileService {
   void MaybeAddFileEntry(const QJsonObject& entry);
   void EnsureConnected();
 
+  OAuthTokenRefresher* token_refresher_;
+
   QString access_token_;
   QDateTime expiry_time_;
 };
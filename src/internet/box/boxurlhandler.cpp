@@ -20,11 +20,17 @@
 
 #include "boxservice.h"
 
+const qint64 BoxUrlHandler::kMediaUrlMaxAgeMsec = 10 * 60 * 1000;
+
 BoxUrlHandler::BoxUrlHandler(BoxService* service, QObject* parent)
     : UrlHandler(parent), service_(service) {}
 
 UrlHandler::LoadResult BoxUrlHandler::StartLoading(const QUrl& url) {
-  QString file_id = url.path();
-  QUrl real_url = service_->GetStreamingUrlFromSongId(file_id);
+  QUrl real_url = CachedMediaUrl(url);
+  if (real_url.isEmpty()) {
+    QString file_id = url.path();
+    real_url = service_->GetStreamingUrlFromSongId(file_id);
+    CacheMediaUrl(url, real_url, kMediaUrlMaxAgeMsec);
+  }
   return LoadResult(url, LoadResult::TrackAvailable, real_url);
 }
@@ -33,8 +33,12 @@ class BoxUrlHandler : public UrlHandler {
   QString scheme() const { return "box"; }
   QIcon icon() const { return IconLoader::Load("box", IconLoader::Provider); }
   LoadResult StartLoading(const QUrl& url);
+  bool CanResolveEarly() const { return true; }
 
  private:
+  // Box's download links only last about 15 minutes.
+  static const qint64 kMediaUrlMaxAgeMsec;
+
   BoxService* service_;
 };
 
@@ -37,6 +37,9 @@
 #include "playlist/playlist.h"
 #include "ui/iconloader.h"
 
+const int CloudFileService::kMaxConcurrentTagReads = 8;
+const int CloudFileService::kIndexBatchSize = 50;
+
 CloudFileService::CloudFileService(Application* app, InternetModel* parent,
                                    const QString& service_name,
                                    const QString& service_id, const QIcon& icon,
@@ -129,13 +132,23 @@ void CloudFileService::ShowSettingsDialog() {
   app_->OpenSettingsDialogAtPage(settings_page_);
 }
 
+bool CloudFileService::FileChanged(const Song& library_song,
+                                   const Song& metadata) {
+  if (!metadata.etag().isEmpty()) {
+    return metadata.etag() != library_song.etag();
+  }
+  return metadata.mtime() != library_song.mtime();
+}
+
 bool CloudFileService::ShouldIndexFile(const QUrl& url,
-                                       const QString& mime_type) const {
+                                       const QString& mime_type,
+                                       const QString& etag) const {
   if (!IsSupportedMimeType(mime_type)) {
     return false;
   }
   Song library_song = library_backend_->GetSongByUrl(url);
-  if (library_song.is_valid()) {
+  if (library_song.is_valid() &&
+      (etag.isEmpty() || etag == library_song.etag())) {
     qLog(Debug) << "Already have:" << url;
     return false;
   }
@@ -146,10 +159,26 @@ void CloudFileService::MaybeAddFileToDatabase(const Song& metadata,
                                               const QString& mime_type,
                                               const QUrl& download_url,
                                               const QString& authorisation) {
-  if (!ShouldIndexFile(metadata.url(), mime_type)) {
+  if (!IsSupportedMimeType(mime_type)) {
     return;
   }
 
+  IndexRequest request;
+  request.metadata = metadata;
+  request.mime_type = mime_type;
+  request.download_url = download_url;
+  request.authorisation = authorisation;
+
+  const Song library_song = library_backend_->GetSongByUrl(metadata.url());
+  if (library_song.is_valid()) {
+    if (!FileChanged(library_song, metadata)) {
+      qLog(Debug) << "Already have:" << metadata.url();
+      return;
+    }
+    // Replace the old version rather than adding another song.
+    request.metadata.set_id(library_song.id());
+  }
+
   if (indexing_task_id_ == -1) {
     indexing_task_id_ = task_manager_->StartTask(tr("Indexing %1").arg(name()));
     indexing_task_progress_ = 0;
@@ -159,14 +188,28 @@ void CloudFileService::MaybeAddFileToDatabase(const Song& metadata,
   task_manager_->SetTaskProgress(indexing_task_id_, indexing_task_progress_,
                                  indexing_task_max_);
 
-  TagReaderClient::ReplyType* reply = app_->tag_reader_client()->ReadCloudFile(
-      download_url, metadata.title(), metadata.filesize(), mime_type,
-      authorisation);
-  pending_tagreader_replies_.append(reply);
+  queued_files_.enqueue(request);
+  StartTagReads();
+}
 
-  NewClosure(reply, SIGNAL(Finished(bool)), this,
-             SLOT(ReadTagsFinished(TagReaderClient::ReplyType*, Song)), reply,
-             metadata);
+void CloudFileService::StartTagReads() {
+  // Reading tags is mostly waiting for the network, so keep a few going, but
+  // don't flood the tag reader with a whole library's worth at once.
+  while (pending_tagreader_replies_.count() < kMaxConcurrentTagReads &&
+         !queued_files_.isEmpty()) {
+    const IndexRequest request = queued_files_.dequeue();
+
+    TagReaderClient::ReplyType* reply =
+        app_->tag_reader_client()->ReadCloudFile(
+            request.download_url, request.metadata.title(),
+            request.metadata.filesize(), request.mime_type,
+            request.authorisation);
+    pending_tagreader_replies_.append(reply);
+
+    NewClosure(reply, SIGNAL(Finished(bool)), this,
+               SLOT(ReadTagsFinished(TagReaderClient::ReplyType*, Song)),
+               reply, request.metadata);
+  }
 }
 
 void CloudFileService::ReadTagsFinished(TagReaderClient::ReplyType* reply,
@@ -182,33 +225,45 @@ void CloudFileService::ReadTagsFinished(TagReaderClient::ReplyType* reply,
 
   pending_tagreader_replies_.removeAt(index_reply);
 
+  const pb::tagreader::ReadCloudFileResponse& message =
+      reply->message().read_cloud_file_response();
+  if (!message.has_metadata() || !message.metadata().filesize()) {
+    qLog(Debug) << "Failed to tag:" << metadata.url();
+  } else {
+    pb::tagreader::SongMetadata metadata_pb;
+    metadata.ToProtobuf(&metadata_pb);
+    metadata_pb.MergeFrom(message.metadata());
+
+    Song song;
+    song.InitFromProtobuf(metadata_pb);
+    song.set_id(metadata.id());
+    song.set_directory_id(0);
+
+    qLog(Debug) << "Adding song to db:" << song.title();
+    indexed_songs_ << song;
+  }
+
   indexing_task_progress_++;
   if (indexing_task_progress_ == indexing_task_max_) {
+    FlushIndexedSongs();
     task_manager_->SetTaskFinished(indexing_task_id_);
     indexing_task_id_ = -1;
     emit AllIndexingTasksFinished();
   } else {
+    if (indexed_songs_.count() >= kIndexBatchSize) {
+      FlushIndexedSongs();
+    }
     task_manager_->SetTaskProgress(indexing_task_id_, indexing_task_progress_,
                                    indexing_task_max_);
+    StartTagReads();
   }
+}
 
-  const pb::tagreader::ReadCloudFileResponse& message =
-      reply->message().read_cloud_file_response();
-  if (!message.has_metadata() || !message.metadata().filesize()) {
-    qLog(Debug) << "Failed to tag:" << metadata.url();
-    return;
-  }
-
-  pb::tagreader::SongMetadata metadata_pb;
-  metadata.ToProtobuf(&metadata_pb);
-  metadata_pb.MergeFrom(message.metadata());
-
-  Song song;
-  song.InitFromProtobuf(metadata_pb);
-  song.set_directory_id(0);
+void CloudFileService::FlushIndexedSongs() {
+  if (indexed_songs_.isEmpty()) return;
 
-  qLog(Debug) << "Adding song to db:" << song.title();
-  library_backend_->AddOrUpdateSongs(SongList() << song);
+  library_backend_->AddOrUpdateSongs(indexed_songs_);
+  indexed_songs_.clear();
 }
 
 bool CloudFileService::IsSupportedMimeType(const QString& mime_type) const {
@@ -238,6 +293,8 @@ QString CloudFileService::GuessMimeTypeForFile(const QString& filename) const {
 void CloudFileService::AbortReadTagsReplies() {
   qLog(Debug) << "Aborting the read tags replies";
   pending_tagreader_replies_.clear();
+  queued_files_.clear();
+  FlushIndexedSongs();
 
   task_manager_->SetTaskFinished(indexing_task_id_);
   indexing_task_id_ = -1;
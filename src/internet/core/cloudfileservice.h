@@ -25,6 +25,7 @@
 #include <memory>
 
 #include <QMenu>
+#include <QQueue>
 
 #include "core/tagreaderclient.h"
 #include "ui/albumcovermanager.h"
@@ -60,7 +61,12 @@ signals:
 
  protected:
   virtual void Connect() = 0;
-  virtual bool ShouldIndexFile(const QUrl& url, const QString& mime_type) const;
+  // etag is the service's version of the file, if it's known.  Files that are
+  // already in the library are only indexed again if it's changed.
+  virtual bool ShouldIndexFile(const QUrl& url, const QString& mime_type,
+                               const QString& etag = QString()) const;
+  // Queues the file to have its tags read, unless the library already has
+  // this version of it.
   virtual void MaybeAddFileToDatabase(const Song& metadata,
                                       const QString& mime_type,
                                       const QUrl& download_url,
@@ -90,9 +96,28 @@ signals:
   QList<TagReaderClient::ReplyType*> pending_tagreader_replies_;
 
  private:
+  struct IndexRequest {
+    Song metadata;
+    QString mime_type;
+    QUrl download_url;
+    QString authorisation;
+  };
+
+  // Files have their tags read this many at a time, and the songs are written
+  // to the library in batches of kIndexBatchSize.
+  static const int kMaxConcurrentTagReads;
+  static const int kIndexBatchSize;
+
+  static bool FileChanged(const Song& library_song, const Song& metadata);
+  void StartTagReads();
+  void FlushIndexedSongs();
+
   QIcon icon_;
   SettingsDialog::Page settings_page_;
 
+  QQueue<IndexRequest> queued_files_;
+  SongList indexed_songs_;
+
   int indexing_task_id_;
   int indexing_task_progress_;
   int indexing_task_max_;
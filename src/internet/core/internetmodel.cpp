@@ -26,11 +26,14 @@
 #include "internet/core/internetmodel.h"
 
 #include <QMimeData>
+#include <QSettings>
 #include <QtDebug>
 
+#include "core/application.h"
 #include "core/closure.h"
 #include "core/logging.h"
 #include "core/mergedproxymodel.h"
+#include "core/player.h"
 #include "internet/core/internetmimedata.h"
 #include "internet/core/internetservice.h"
 #include "internet/digitally/digitallyimportedservicebase.h"
@@ -68,6 +71,8 @@ using smart_playlists::GeneratorMimeData;
 using smart_playlists::GeneratorPtr;
 
 QMap<QString, InternetService*>* InternetModel::sServices = nullptr;
+QMap<QString, InternetModel::ServiceFactory>* InternetModel::sFactories =
+    nullptr;
 
 const char* InternetModel::kSettingsGroup = "InternetModel";
 
@@ -78,44 +83,91 @@ InternetModel::InternetModel(Application* app, QObject* parent)
   if (!sServices) {
     sServices = new QMap<QString, InternetService*>;
   }
+  if (!sFactories) {
+    sFactories = new QMap<QString, ServiceFactory>;
+  }
   Q_ASSERT(sServices->isEmpty());
 
   merged_model_->setSourceModel(this);
 
-  AddService(new ClassicalRadioService(app, this));
-  AddService(new DigitallyImportedService(app, this));
-  AddService(new IcecastService(app, this));
-  AddService(new JamendoService(app, this));
-  AddService(new JazzRadioService(app, this));
-  AddService(new MagnatuneService(app, this));
-  AddService(new PodcastService(app, this));
-  AddService(new RockRadioService(app, this));
-  AddService(new SavedRadio(app, this));
-  AddService(new RadioTunesService(app, this));
-  AddService(new SomaFMService(app, this));
-  AddService(new IntergalacticFMService(app, this));
+  RegisterService<ClassicalRadioService>("ClassicalRadio",
+                                         QStringList() << "classicalradio");
+  RegisterService<DigitallyImportedService>("DigitallyImported",
+                                            QStringList() << "di");
+  RegisterService<IcecastService>(IcecastService::kServiceName);
+  RegisterService<JamendoService>(JamendoService::kServiceName);
+  RegisterService<JazzRadioService>("JazzRadio",
+                                    QStringList() << "jazzradio");
+  RegisterService<MagnatuneService>(MagnatuneService::kServiceName,
+                                    QStringList() << "magnatune");
+  RegisterService<PodcastService>(PodcastService::kServiceName);
+  RegisterService<RockRadioService>("RockRadio",
+                                    QStringList() << "rockradio");
+  RegisterService<SavedRadio>(SavedRadio::kServiceName);
+  RegisterService<RadioTunesService>("RadioTunes",
+                                     QStringList() << "radiotunes");
+  RegisterService<SomaFMService>("SomaFM", QStringList() << "somafm");
+  RegisterService<IntergalacticFMService>(
+      "Intergalactic FM", QStringList() << "intergalacticfm");
 #ifdef HAVE_SPOTIFY
-  AddService(new SpotifyService(app, this));
+  RegisterService<SpotifyService>(SpotifyService::kServiceName);
 #endif
-  AddService(new SubsonicService(app, this));
+  RegisterService<SubsonicService>(SubsonicService::kServiceName,
+                                   QStringList() << "subsonic");
 #ifdef HAVE_BOX
-  AddService(new BoxService(app, this));
+  RegisterService<BoxService>(BoxService::kServiceName,
+                              QStringList() << "box");
 #endif
 #ifdef HAVE_DROPBOX
-  AddService(new DropboxService(app, this));
+  RegisterService<DropboxService>(DropboxService::kServiceName,
+                                  QStringList() << "dropbox");
 #endif
 #ifdef HAVE_GOOGLE_DRIVE
-  AddService(new GoogleDriveService(app, this));
+  RegisterService<GoogleDriveService>(GoogleDriveService::kServiceName,
+                                      QStringList() << "googledrive");
 #endif
 #ifdef HAVE_SEAFILE
-  AddService(new SeafileService(app, this));
+  RegisterService<SeafileService>(SeafileService::kServiceName,
+                                  QStringList() << "seafile");
 #endif
 #ifdef HAVE_SKYDRIVE
-  AddService(new SkydriveService(app, this));
+  RegisterService<SkydriveService>(SkydriveService::kServiceName,
+                                   QStringList() << "skydrive");
 #endif
 
-  invisibleRootItem()->sortChildren(0, Qt::AscendingOrder);
-  UpdateServices();
+  for (const QString& name : sFactories->keys()) {
+    if (IsShownInSettings(name)) ServiceByName(name);
+  }
+}
+
+template <typename T>
+void InternetModel::RegisterService(const QString& name,
+                                    const QStringList& url_schemes) {
+  sFactories->insert(name,
+                     [this]() { return CreateService(new T(app_, this)); });
+
+  for (const QString& scheme : url_schemes) {
+    app_->player()->RegisterUrlHandlerLoader(
+        scheme, [name]() { ServiceByName(name); });
+  }
+}
+
+InternetService* InternetModel::CreateService(InternetService* service) {
+  AddService(service);
+  if (!IsShownInSettings(service->name())) HideService(service);
+  return service;
+}
+
+bool InternetModel::IsShownInSettings(const QString& name) {
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  return s.value(name, true).toBool();
+}
+
+void InternetModel::CreateAllServices() {
+  for (const QString& name : sFactories->keys()) {
+    ServiceByName(name);
+  }
 }
 
 void InternetModel::AddService(InternetService* service) {
@@ -129,7 +181,7 @@ void InternetModel::AddService(InternetService* service) {
   root->setData(Type_Service, Role_Type);
   root->setData(QVariant::fromValue(service), Role_Service);
 
-  invisibleRootItem()->appendRow(root);
+  invisibleRootItem()->insertRow(FindItemPosition(root->text()), root);
   qLog(Debug) << "Adding internet service:" << service->name();
   sServices->insert(service->name(), service);
 
@@ -185,6 +237,9 @@ void InternetModel::ServiceDeleted() {
 
 InternetService* InternetModel::ServiceByName(const QString& name) {
   if (sServices->contains(name)) return sServices->value(name);
+
+  // Taken out first so the factory only ever runs once.
+  if (sFactories->contains(name)) return sFactories->take(name)();
   return nullptr;
 }
 
@@ -345,11 +400,15 @@ void InternetModel::UpdateServices() {
   QStringList keys = s.childKeys();
 
   for (const QString& service_name : keys) {
-    InternetService* internet_service = ServiceByName(service_name);
+    bool setting_val = s.value(service_name).toBool();
+
+    // Hidden services that were never created can stay that way.
+    InternetService* internet_service =
+        setting_val ? ServiceByName(service_name)
+                    : sServices->value(service_name);
     if (internet_service == nullptr) {
       continue;
     }
-    bool setting_val = s.value(service_name).toBool();
 
     // Only update if values are different
     if (setting_val && !shown_services_[internet_service].shown) {
@@ -23,6 +23,8 @@
 #ifndef INTERNET_CORE_INTERNETMODEL_H_
 #define INTERNET_CORE_INTERNETMODEL_H_
 
+#include <functional>
+
 #include "core/song.h"
 #include "library/librarymodel.h"
 #include "playlist/playlistitem.h"
@@ -124,7 +126,8 @@ class InternetModel : public QStandardItemModel {
     bool shown;
   };
 
-  // Needs to be static for InternetPlaylistItem::restore
+  // Needs to be static for InternetPlaylistItem::restore.  Creates the
+  // service if it hasn't been created yet.
   static InternetService* ServiceByName(const QString& name);
   static const char* kSettingsGroup;
 
@@ -142,6 +145,9 @@ class InternetModel : public QStandardItemModel {
   void ShowService(InternetService* service);
   // Add or remove the services according to the setting file
   void UpdateServices();
+  // Creates the services the user has hidden, which otherwise aren't created
+  // until something asks for them.
+  void CreateAllServices();
   // Find the position where to insert this item. The list of services is
   // supposed to be alphabetically sorted.
   int FindItemPosition(const QString& text);
@@ -188,9 +194,21 @@ class InternetModel : public QStandardItemModel {
   void ServiceDeleted();
 
  private:
+  typedef std::function<InternetService*()> ServiceFactory;
+
+  // Remembers how to create the service.  It's created straight away unless
+  // the user has hidden it, otherwise the first time it's asked for by name
+  // or a URL with one of these schemes is played.
+  template <typename T>
+  void RegisterService(const QString& name,
+                       const QStringList& url_schemes = QStringList());
+  InternetService* CreateService(InternetService* service);
+  static bool IsShownInSettings(const QString& name);
+
   QMap<InternetService*, ServiceItem> shown_services_;
 
   static QMap<QString, InternetService*>* sServices;
+  static QMap<QString, ServiceFactory>* sFactories;
 
   Application* app_;
   MergedProxyModel* merged_model_;
@@ -36,6 +36,9 @@ InternetShowSettingsPage::InternetShowSettingsPage(SettingsDialog* parent)
 }
 
 void InternetShowSettingsPage::Load() {
+  // Hidden services need to exist to be listed here.
+  dialog()->app()->internet_model()->CreateAllServices();
+
   QMap<InternetService*, InternetModel::ServiceItem> shown_services =
       dialog()->app()->internet_model()->shown_services();
 
@@ -0,0 +1,84 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "internet/core/oauthtokenrefresher.h"
+
+#include <QTimer>
+
+#include "core/closure.h"
+#include "core/logging.h"
+#include "internet/core/oauthenticator.h"
+
+const int OAuthTokenRefresher::kRefreshLeadSecs = 5 * 60;
+
+OAuthTokenRefresher::OAuthTokenRefresher(const QString& client_id,
+                                         const QString& client_secret,
+                                         const QString& token_endpoint,
+                                         QObject* parent)
+    : QObject(parent),
+      client_id_(client_id),
+      client_secret_(client_secret),
+      token_endpoint_(token_endpoint),
+      timer_(new QTimer(this)) {
+  timer_->setSingleShot(true);
+  connect(timer_, SIGNAL(timeout()), SLOT(Refresh()));
+}
+
+void OAuthTokenRefresher::Watch(const QString& refresh_token,
+                                const QDateTime& expiry_time) {
+  timer_->stop();
+  refresh_token_ = refresh_token;
+  if (refresh_token_.isEmpty() || !expiry_time.isValid()) return;
+
+  const qint64 secs = qMax(
+      0ll, QDateTime::currentDateTime().secsTo(expiry_time) - kRefreshLeadSecs);
+  timer_->start(secs * 1000);
+}
+
+void OAuthTokenRefresher::Stop() {
+  timer_->stop();
+  refresh_token_ = QString();
+}
+
+void OAuthTokenRefresher::Refresh() {
+  if (refresh_token_.isEmpty()) return;
+
+  qLog(Debug) << "Refreshing OAuth token for" << token_endpoint_;
+
+  OAuthenticator* oauth =
+      new OAuthenticator(client_id_, client_secret_,
+                         OAuthenticator::RedirectStyle::LOCALHOST, this);
+  oauth->RefreshAuthorisation(token_endpoint_, refresh_token_);
+  NewClosure(oauth, SIGNAL(Finished()), this,
+             SLOT(RefreshFinished(OAuthenticator*)), oauth);
+}
+
+void OAuthTokenRefresher::RefreshFinished(OAuthenticator* oauth) {
+  oauth->deleteLater();
+
+  // Stopped while the refresh was running.
+  if (refresh_token_.isEmpty()) return;
+
+  if (oauth->access_token().isEmpty()) {
+    // Leave it to the service to reconnect when it next needs the token.
+    qLog(Warning) << "Failed to refresh OAuth token for" << token_endpoint_;
+    return;
+  }
+
+  emit Refreshed(oauth->access_token(), oauth->expiry_time(),
+                 oauth->refresh_token());
+  Watch(oauth->refresh_token(), oauth->expiry_time());
+}
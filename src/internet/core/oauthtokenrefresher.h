@@ -0,0 +1,63 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INTERNET_CORE_OAUTHTOKENREFRESHER_H_
+#define INTERNET_CORE_OAUTHTOKENREFRESHER_H_
+
+#include <QDateTime>
+#include <QObject>
+#include <QString>
+
+class OAuthenticator;
+class QTimer;
+
+// Refreshes a service's OAuth access token in the background a few minutes
+// before it expires, so the first request after a quiet spell doesn't have
+// to wait for a new token.  It keeps going for as long as refreshes succeed.
+class OAuthTokenRefresher : public QObject {
+  Q_OBJECT
+
+ public:
+  OAuthTokenRefresher(const QString& client_id, const QString& client_secret,
+                      const QString& token_endpoint, QObject* parent = nullptr);
+
+  // Schedules a refresh for shortly before expiry_time.  Replaces any refresh
+  // that was already scheduled.
+  void Watch(const QString& refresh_token, const QDateTime& expiry_time);
+  void Stop();
+
+ signals:
+  // refresh_token is the one to save, since some services hand out a new one
+  // each time.
+  void Refreshed(const QString& access_token, const QDateTime& expiry_time,
+                 const QString& refresh_token);
+
+ private slots:
+  void Refresh();
+  void RefreshFinished(OAuthenticator* oauth);
+
+ private:
+  static const int kRefreshLeadSecs;
+
+  const QString client_id_;
+  const QString client_secret_;
+  const QString token_endpoint_;
+
+  QTimer* timer_;
+  QString refresh_token_;
+};
+
+#endif  // INTERNET_CORE_OAUTHTOKENREFRESHER_H_
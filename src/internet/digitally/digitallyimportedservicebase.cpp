@@ -53,7 +53,7 @@ DigitallyImportedServiceBase::DigitallyImportedServiceBase(
       icon_(icon),
       service_description_(description),
       api_service_name_(api_service_name),
-      network_(new NetworkAccessManager(this)),
+      network_(NetworkAccessManager::Shared()),
       url_handler_(new DigitallyImportedUrlHandler(app, this)),
       premium_audio_type_(2),
       has_premium_(has_premium),
@@ -229,7 +229,9 @@ void DigitallyImportedServiceBase::LoadStation(const QString& key) {
 
   qLog(Debug) << "Getting playlist URL" << playlist_url;
 
-  QNetworkReply* reply = network_->get(QNetworkRequest(playlist_url));
+  QNetworkRequest request(playlist_url);
+  request.setPriority(NetworkAccessManager::kPlaybackPriority);
+  QNetworkReply* reply = network_->get(request);
   NewClosure(reply, SIGNAL(finished()), this,
              SLOT(LoadPlaylistFinished(QNetworkReply*)), reply);
 }
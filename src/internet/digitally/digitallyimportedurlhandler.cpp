@@ -28,6 +28,9 @@
 #include "playlistparsers/playlistparser.h"
 #include "ui/iconloader.h"
 
+const qint64 DigitallyImportedUrlHandler::kMediaUrlMaxAgeMsec =
+    60 * 60 * 1000;
+
 DigitallyImportedUrlHandler::DigitallyImportedUrlHandler(
     Application* app, DigitallyImportedServiceBase* service)
     : UrlHandler(service), app_(app), service_(service), task_id_(-1) {}
@@ -62,6 +65,12 @@ UrlHandler::LoadResult DigitallyImportedUrlHandler::StartLoading(
     return ret;
   }
 
+  ret.media_url_ = CachedMediaUrl(url);
+  if (!ret.media_url_.isEmpty()) {
+    ret.type_ = LoadResult::TrackAvailable;
+    return ret;
+  }
+
   // Start loading the station
   const QString key = url.host();
   qLog(Info) << "Loading station" << key;
@@ -98,6 +107,7 @@ void DigitallyImportedUrlHandler::LoadPlaylistFinished(QIODevice* device) {
     return;
   }
 
+  CacheMediaUrl(last_original_url_, songs[0].url(), kMediaUrlMaxAgeMsec);
   emit AsyncLoadComplete(LoadResult(
       last_original_url_, LoadResult::TrackAvailable, songs[0].url()));
 }
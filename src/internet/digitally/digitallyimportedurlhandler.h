@@ -38,6 +38,9 @@ class DigitallyImportedUrlHandler : public UrlHandler {
   void LoadPlaylistFinished(QIODevice* device);
 
  private:
+  // Stream urls only change if the listen key does.
+  static const qint64 kMediaUrlMaxAgeMsec;
+
   Application* app_;
   DigitallyImportedServiceBase* service_;
   int task_id_;
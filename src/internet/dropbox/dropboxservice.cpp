@@ -174,7 +174,8 @@ void DropboxService::RequestFileListFinished(QNetworkReply* reply) {
       continue;
     }
 
-    if (ShouldIndexFile(url, GuessMimeTypeForFile(url.toString()))) {
+    if (ShouldIndexFile(url, GuessMimeTypeForFile(url.toString()),
+                        item["rev"].toString())) {
       QNetworkReply* reply = FetchContentUrl(url);
       connect(reply, &QNetworkReply::finished, [=] {
         this->FetchContentUrlFinished(reply, item.toVariantMap());
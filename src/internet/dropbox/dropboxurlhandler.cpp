@@ -20,10 +20,16 @@
 
 #include "internet/dropbox/dropboxservice.h"
 
+const qint64 DropboxUrlHandler::kMediaUrlMaxAgeMsec = 3 * 60 * 60 * 1000;
+
 DropboxUrlHandler::DropboxUrlHandler(DropboxService* service, QObject* parent)
     : UrlHandler(parent), service_(service) {}
 
 UrlHandler::LoadResult DropboxUrlHandler::StartLoading(const QUrl& url) {
-  return LoadResult(url, LoadResult::TrackAvailable,
-                    service_->GetStreamingUrlFromSongId(url));
+  QUrl real_url = CachedMediaUrl(url);
+  if (real_url.isEmpty()) {
+    real_url = service_->GetStreamingUrlFromSongId(url);
+    CacheMediaUrl(url, real_url, kMediaUrlMaxAgeMsec);
+  }
+  return LoadResult(url, LoadResult::TrackAvailable, real_url);
 }
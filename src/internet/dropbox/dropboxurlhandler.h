@@ -32,8 +32,12 @@ class DropboxUrlHandler : public UrlHandler {
   QString scheme() const { return "dropbox"; }
   QIcon icon() const { return IconLoader::Load("dropbox", IconLoader::Provider); }
   LoadResult StartLoading(const QUrl& url);
+  bool CanResolveEarly() const { return true; }
 
  private:
+  // Dropbox's temporary links last four hours.
+  static const qint64 kMediaUrlMaxAgeMsec;
+
   DropboxService* service_;
 };
 
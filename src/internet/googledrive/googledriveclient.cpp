@@ -27,6 +27,7 @@
 #include <QJsonValue>
 
 #include "internet/core/oauthenticator.h"
+#include "internet/core/oauthtokenrefresher.h"
 #include "core/closure.h"
 #include "core/logging.h"
 #include "core/network.h"
@@ -78,7 +79,14 @@ ListChangesResponse::ListChangesResponse(const QString& cursor, QObject* parent)
     : QObject(parent), cursor_(cursor) {}
 
 Client::Client(QObject* parent)
-    : QObject(parent), network_(new NetworkAccessManager(this)) {}
+    : QObject(parent),
+      network_(new NetworkAccessManager(this)),
+      token_refresher_(new OAuthTokenRefresher(kClientId, kClientSecret,
+                                               kOAuthTokenEndpoint, this)) {
+  // Google keeps the same refresh token, so only the access token changes.
+  connect(token_refresher_, SIGNAL(Refreshed(QString, QDateTime, QString)),
+          SLOT(TokenRefreshed(QString, QDateTime)));
+}
 
 ConnectResponse* Client::Connect(const QString& refresh_token) {
   ConnectResponse* ret = new ConnectResponse(this);
@@ -102,6 +110,7 @@ void Client::ConnectFinished(ConnectResponse* response, OAuthenticator* oauth) {
   access_token_ = oauth->access_token();
   expiry_time_ = oauth->expiry_time();
   response->refresh_token_ = oauth->refresh_token();
+  token_refresher_->Watch(oauth->refresh_token(), expiry_time_);
 
   // Fetch user email.
   QUrl url(kGoogleOAuthUserInfoEndpoint);
@@ -255,7 +264,14 @@ bool Client::is_authenticated() const {
          QDateTime::currentDateTime().secsTo(expiry_time_) > 0;
 }
 
+void Client::TokenRefreshed(const QString& access_token,
+                            const QDateTime& expiry_time) {
+  access_token_ = access_token;
+  expiry_time_ = expiry_time;
+}
+
 void Client::ForgetCredentials() {
+  token_refresher_->Stop();
   access_token_ = QString();
   expiry_time_ = QDateTime();
 }
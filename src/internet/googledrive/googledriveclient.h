@@ -28,6 +28,7 @@
 #include <QVariantMap>
 
 class OAuthenticator;
+class OAuthTokenRefresher;
 class QNetworkAccessManager;
 class QNetworkReply;
 class QNetworkRequest;
@@ -156,6 +157,8 @@ class Client : public QObject {
 
  private slots:
   void ConnectFinished(ConnectResponse* response, OAuthenticator* oauth);
+  void TokenRefreshed(const QString& access_token,
+                      const QDateTime& expiry_time);
   void FetchUserInfoFinished(ConnectResponse* response, QNetworkReply* reply);
   void GetFileFinished(GetFileResponse* response, QNetworkReply* reply);
   void ListChangesFinished(ListChangesResponse* response, QNetworkReply* reply);
@@ -167,6 +170,7 @@ class Client : public QObject {
 
  private:
   QNetworkAccessManager* network_;
+  OAuthTokenRefresher* token_refresher_;
 
   QString access_token_;
   QDateTime expiry_time_;
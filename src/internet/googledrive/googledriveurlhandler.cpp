@@ -21,16 +21,23 @@
 #include "googledriveclient.h"
 #include "googledriveservice.h"
 
+const qint64 GoogleDriveUrlHandler::kMediaUrlMaxAgeMsec = 60 * 60 * 1000;
+
 GoogleDriveUrlHandler::GoogleDriveUrlHandler(GoogleDriveService* service,
                                              QObject* parent)
     : UrlHandler(parent), service_(service) {}
 
 UrlHandler::LoadResult GoogleDriveUrlHandler::StartLoading(const QUrl& url) {
-  QString file_id = url.path().remove(QChar('/'));
-  QUrl real_url = service_->GetStreamingUrlFromSongId(file_id);
+  QUrl real_url = CachedMediaUrl(url);
+  if (real_url.isEmpty()) {
+    QString file_id = url.path().remove(QChar('/'));
+    real_url = service_->GetStreamingUrlFromSongId(file_id);
+    CacheMediaUrl(url, real_url, kMediaUrlMaxAgeMsec);
+  }
   LoadResult::Type type = real_url.isValid() ? LoadResult::TrackAvailable
                                              : LoadResult::NoMoreTracks;
   LoadResult res(url, type, real_url);
+  // The access token expires long before the url does, so always ask for it.
   res.auth_header_ = service_->client()->GetAuthHeader();
   return res;
 }
@@ -33,8 +33,12 @@ class GoogleDriveUrlHandler : public UrlHandler {
   QString scheme() const { return "googledrive"; }
   QIcon icon() const { return IconLoader::Load("googledrive", IconLoader::Provider); }
   LoadResult StartLoading(const QUrl& url);
+  bool CanResolveEarly() const { return true; }
 
  private:
+  // Download urls don't expire, but the file might change.
+  static const qint64 kMediaUrlMaxAgeMsec;
+
   GoogleDriveService* service_;
 };
 
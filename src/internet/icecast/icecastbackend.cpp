@@ -21,148 +21,238 @@
 
 #include "icecastbackend.h"
 
+#include <algorithm>
+
+#include <QSet>
 #include <QSqlQuery>
 #include <QVariant>
 
 #include "core/database.h"
+#include "core/logging.h"
 #include "core/scopedtransaction.h"
 
 const char* IcecastBackend::kTableName = "icecast_stations";
 
-IcecastBackend::IcecastBackend(QObject* parent) : QObject(parent) {}
+IcecastBackend::IcecastBackend(QObject* parent)
+    : QObject(parent), db_(nullptr), index_loaded_(false) {}
 
 void IcecastBackend::Init(Database* db) { db_ = db; }
 
-QStringList IcecastBackend::GetGenresAlphabetical(const QString& filter) {
-  QStringList ret;
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db = db_->Connect();
+void IcecastBackend::EnsureIndexLoaded() {
+  if (index_loaded_) return;
+  index_loaded_ = true;
 
-  QString where = filter.isEmpty() ? "" : "WHERE name LIKE :filter";
+  {
+    QMutexLocker l(db_->Mutex());
+    QSqlDatabase db = db_->Connect();
 
-  QString sql = QString("SELECT DISTINCT genre FROM %1 %2 ORDER BY genre")
-                    .arg(kTableName, where);
+    QSqlQuery q(db);
+    q.prepare(QString(
+                  "SELECT name, url, mime_type, bitrate, channels,"
+                  "       samplerate, genre"
+                  " FROM %1").arg(kTableName));
+    q.exec();
+    if (db_->CheckErrors(q)) return;
 
-  QSqlQuery q(db);
-  q.prepare(sql);
-  if (!filter.isEmpty()) {
-    q.bindValue(":filter", QString("%" + filter + "%"));
+    while (q.next()) {
+      Station station;
+      station.name = q.value(0).toString();
+      station.url = QUrl(q.value(1).toString());
+      station.mime_type = q.value(2).toString();
+      station.bitrate = q.value(3).toInt();
+      station.channels = q.value(4).toInt();
+      station.samplerate = q.value(5).toInt();
+      station.genre = q.value(6).toString();
+      stations_ << station;
+    }
   }
 
-  q.exec();
-  if (db_->CheckErrors(q)) return ret;
+  BuildIndex();
+}
+
+void IcecastBackend::BuildIndex() {
+  std::stable_sort(stations_.begin(), stations_.end(),
+                   [](const Station& a, const Station& b) {
+                     return a.name.compare(b.name, Qt::CaseInsensitive) < 0;
+                   });
+
+  folded_names_.clear();
+  folded_names_.reserve(stations_.count());
+  genre_stations_.clear();
 
-  while (q.next()) {
-    ret << q.value(0).toString();
+  for (int i = 0; i < stations_.count(); ++i) {
+    folded_names_ << stations_[i].name.toLower();
+    genre_stations_[stations_[i].genre] << i;
+  }
+
+  genres_alphabetical_ = genre_stations_.keys();
+  std::sort(genres_alphabetical_.begin(), genres_alphabetical_.end());
+
+  genres_by_popularity_ = genres_alphabetical_;
+  std::stable_sort(genres_by_popularity_.begin(), genres_by_popularity_.end(),
+                   [this](const QString& a, const QString& b) {
+                     return genre_stations_[a].count() >
+                            genre_stations_[b].count();
+                   });
+}
+
+bool IcecastBackend::Matches(int i, const QString& filter) const {
+  return filter.isEmpty() || folded_names_[i].contains(filter);
+}
+
+QHash<QString, int> IcecastBackend::CountGenres(const QString& filter) const {
+  QHash<QString, int> ret;
+  for (int i = 0; i < stations_.count(); ++i) {
+    if (Matches(i, filter)) {
+      ret[stations_[i].genre]++;
+    }
   }
   return ret;
 }
 
-QStringList IcecastBackend::GetGenresByPopularity(const QString& filter) {
+QStringList IcecastBackend::GetGenresAlphabetical(const QString& filter) {
+  QMutexLocker l(&index_mutex_);
+  EnsureIndexLoaded();
+
+  if (filter.isEmpty()) return genres_alphabetical_;
+
+  const QHash<QString, int> counts = CountGenres(filter.toLower());
   QStringList ret;
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db = db_->Connect();
-
-  QString where = filter.isEmpty() ? "" : "WHERE name LIKE :filter";
-
-  QString sql = QString(
-                    "SELECT genre, COUNT(*) AS count FROM %1 "
-                    " %2"
-                    " GROUP BY genre"
-                    " ORDER BY count DESC").arg(kTableName, where);
-  QSqlQuery q(db);
-  q.prepare(sql);
-  if (!filter.isEmpty()) {
-    q.bindValue(":filter", QString("%" + filter + "%"));
+  for (const QString& genre : genres_alphabetical_) {
+    if (counts.contains(genre)) ret << genre;
   }
+  return ret;
+}
+
+QStringList IcecastBackend::GetGenresByPopularity(const QString& filter) {
+  QMutexLocker l(&index_mutex_);
+  EnsureIndexLoaded();
 
-  q.exec();
-  if (db_->CheckErrors(q)) return ret;
+  if (filter.isEmpty()) return genres_by_popularity_;
 
-  while (q.next()) {
-    ret << q.value(0).toString();
+  const QHash<QString, int> counts = CountGenres(filter.toLower());
+  QStringList ret;
+  for (const QString& genre : genres_alphabetical_) {
+    if (counts.contains(genre)) ret << genre;
   }
+  std::stable_sort(ret.begin(), ret.end(),
+                   [&counts](const QString& a, const QString& b) {
+                     return counts[a] > counts[b];
+                   });
   return ret;
 }
 
 IcecastBackend::StationList IcecastBackend::GetStations(const QString& filter,
                                                         const QString& genre) {
+  QMutexLocker l(&index_mutex_);
+  EnsureIndexLoaded();
+
+  const QString folded_filter = filter.toLower();
   StationList ret;
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db = db_->Connect();
 
-  QStringList where_clauses;
-  QStringList bound_items;
+  if (genre.isEmpty()) {
+    if (filter.isEmpty()) return stations_;
 
-  if (!genre.isEmpty()) {
-    where_clauses << "genre = :genre";
-    bound_items << genre;
+    for (int i = 0; i < stations_.count(); ++i) {
+      if (Matches(i, folded_filter)) ret << stations_[i];
+    }
+    return ret;
   }
-  if (!filter.isEmpty()) {
-    where_clauses << "name LIKE :filter";
-    bound_items << "%" + filter + "%";
+
+  for (int i : genre_stations_.value(genre)) {
+    if (Matches(i, folded_filter)) ret << stations_[i];
   }
+  return ret;
+}
 
-  QString sql = QString(
-                    "SELECT name, url, mime_type, bitrate, channels,"
-                    "       samplerate, genre"
-                    " FROM %1").arg(kTableName);
+bool IcecastBackend::IsEmpty() {
+  QMutexLocker l(&index_mutex_);
+  EnsureIndexLoaded();
+  return stations_.isEmpty();
+}
 
-  if (!where_clauses.isEmpty()) {
-    sql += " WHERE " + where_clauses.join(" AND ");
+void IcecastBackend::UpdateStations(const StationList& stations) {
+  QMutexLocker index_lock(&index_mutex_);
+  EnsureIndexLoaded();
+
+  // Directory entries are matched up by their URL.  The first one wins if a
+  // URL appears more than once.
+  QHash<QString, int> old_by_url;
+  QSet<QString> duplicated_urls;
+  for (int i = 0; i < stations_.count(); ++i) {
+    const QString url = stations_[i].url.toString();
+    if (old_by_url.contains(url)) {
+      duplicated_urls << url;
+    } else {
+      old_by_url[url] = i;
+    }
   }
-  QSqlQuery q(db);
-  q.prepare(sql);
-  for (const QString& value : bound_items) {
-    q.addBindValue(value);
+
+  StationList new_stations;
+  QHash<QString, int> new_by_url;
+  for (const Station& station : stations) {
+    const QString url = station.url.toString();
+    if (new_by_url.contains(url)) continue;
+    new_by_url[url] = new_stations.count();
+    new_stations << station;
   }
 
-  q.exec();
-  if (db_->CheckErrors(q)) return ret;
-
-  while (q.next()) {
-    Station station;
-    station.name = q.value(0).toString();
-    station.url = QUrl(q.value(1).toString());
-    station.mime_type = q.value(2).toString();
-    station.bitrate = q.value(3).toInt();
-    station.channels = q.value(4).toInt();
-    station.samplerate = q.value(5).toInt();
-    station.genre = q.value(6).toString();
-    ret << station;
+  QStringList removed;
+  for (auto it = old_by_url.constBegin(); it != old_by_url.constEnd(); ++it) {
+    if (!new_by_url.contains(it.key()) || duplicated_urls.contains(it.key())) {
+      removed << it.key();
+    }
   }
-  return ret;
-}
 
-bool IcecastBackend::IsEmpty() {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db = db_->Connect();
-  QSqlQuery q(db);
-  q.prepare(QString("SELECT ROWID FROM %1 LIMIT 1").arg(kTableName));
-  q.exec();
-  return !q.next();
-}
+  StationList added;
+  StationList changed;
+  for (const Station& station : new_stations) {
+    const QString url = station.url.toString();
+    if (!old_by_url.contains(url) || duplicated_urls.contains(url)) {
+      added << station;
+    } else if (stations_[old_by_url[url]] != station) {
+      changed << station;
+    }
+  }
+
+  if (removed.isEmpty() && added.isEmpty() && changed.isEmpty()) return;
 
-void IcecastBackend::ClearAndAddStations(const StationList& stations) {
   {
     QMutexLocker l(db_->Mutex());
     QSqlDatabase db = db_->Connect();
     ScopedTransaction t(&db);
 
-    // Remove all existing items
     QSqlQuery q(db);
-    q.prepare(QString("DELETE FROM %1").arg(kTableName));
-    q.exec();
-    if (db_->CheckErrors(q)) return;
+    q.prepare(QString("DELETE FROM %1 WHERE url = :url").arg(kTableName));
+    for (const QString& url : removed) {
+      q.bindValue(":url", url);
+      q.exec();
+      if (db_->CheckErrors(q)) return;
+    }
+
+    q.prepare(QString(
+            "UPDATE %1 SET name = :name, mime_type = :mime_type,"
+            "              bitrate = :bitrate, channels = :channels,"
+            "              samplerate = :samplerate, genre = :genre"
+            " WHERE url = :url").arg(kTableName));
+    for (const Station& station : changed) {
+      q.bindValue(":name", station.name);
+      q.bindValue(":mime_type", station.mime_type);
+      q.bindValue(":bitrate", station.bitrate);
+      q.bindValue(":channels", station.channels);
+      q.bindValue(":samplerate", station.samplerate);
+      q.bindValue(":genre", station.genre);
+      q.bindValue(":url", station.url);
+      q.exec();
+      if (db_->CheckErrors(q)) return;
+    }
 
     q.prepare(QString(
             "INSERT INTO %1 (name, url, mime_type, bitrate,"
             "                channels, samplerate, genre)"
             " VALUES (:name, :url, :mime_type, :bitrate,"
             "         :channels, :samplerate, :genre)").arg(kTableName));
-
-    // Add these ones
-    for (const Station& station : stations) {
+    for (const Station& station : added) {
       q.bindValue(":name", station.name);
       q.bindValue(":url", station.url);
       q.bindValue(":mime_type", station.mime_type);
@@ -177,9 +267,23 @@ void IcecastBackend::ClearAndAddStations(const StationList& stations) {
     t.Commit();
   }
 
+  qLog(Debug) << "Icecast directory updated:" << added.count() << "added,"
+              << changed.count() << "changed," << removed.count() << "removed";
+
+  stations_ = new_stations;
+  BuildIndex();
+  index_lock.unlock();
+
   emit DatabaseReset();
 }
 
+bool IcecastBackend::Station::operator==(const Station& other) const {
+  return name == other.name && url == other.url &&
+         mime_type == other.mime_type && bitrate == other.bitrate &&
+         channels == other.channels && samplerate == other.samplerate &&
+         genre == other.genre;
+}
+
 Song IcecastBackend::Station::ToSong() const {
   Song ret;
   ret.set_valid(true);
@@ -22,11 +22,16 @@
 
 #include "core/song.h"
 
+#include <QHash>
+#include <QMutex>
 #include <QObject>
 #include <QUrl>
+#include <QVector>
 
 class Database;
 
+// The stations are kept in the database between sessions, but queries are
+// answered from an index in memory that's loaded the first time it's needed.
 class IcecastBackend : public QObject {
   Q_OBJECT
 
@@ -48,6 +53,9 @@ class IcecastBackend : public QObject {
     QString genre;
 
     Song ToSong() const;
+
+    bool operator==(const Station& other) const;
+    bool operator!=(const Station& other) const { return !(*this == other); }
   };
   typedef QList<Station> StationList;
 
@@ -56,7 +64,9 @@ class IcecastBackend : public QObject {
   StationList GetStations(const QString& filter = QString(),
                           const QString& genre = QString());
 
-  void ClearAndAddStations(const StationList& stations);
+  // Replaces the directory with these stations.  Only the stations that were added, removed or changed, matched by
+  // URL, are written to the database.
+  void UpdateStations(const StationList& stations);
 
   bool IsEmpty();
 
@@ -64,7 +74,23 @@ class IcecastBackend : public QObject {
   void DatabaseReset();
 
  private:
+  // Must be called with index_mutex_ held.
+  void EnsureIndexLoaded();
+  void BuildIndex();
+  bool Matches(int i, const QString& filter) const;
+  QHash<QString, int> CountGenres(const QString& filter) const;
+
   Database* db_;
+
+  QMutex index_mutex_;
+  bool index_loaded_;
+  StationList stations_;
+  // Lower case station names, for filtering.
+  QVector<QString> folded_names_;
+  // Indexes into stations_ of the stations in each genre, in name order.
+  QHash<QString, QVector<int>> genre_stations_;
+  QStringList genres_alphabetical_;
+  QStringList genres_by_popularity_;
 };
 
 #endif  // INTERNET_ICECAST_ICECASTBACKEND_H_
@@ -28,13 +28,13 @@
 #include <QMultiHash>
 #include <QNetworkReply>
 #include <QRegExp>
-#include <QtConcurrentRun>
 
 #include "core/application.h"
 #include "core/closure.h"
 #include "core/database.h"
 #include "core/mergedproxymodel.h"
 #include "core/network.h"
+#include "core/taskexecutor.h"
 #include "core/taskmanager.h"
 #include "globalsearch/globalsearch.h"
 #include "globalsearch/icecastsearchprovider.h"
@@ -55,7 +55,7 @@ const char* IcecastService::kHomepage = "http://dir.xiph.org/";
 
 IcecastService::IcecastService(Application* app, InternetModel* parent)
     : InternetService(kServiceName, app, parent, parent),
-      network_(new NetworkAccessManager(this)),
+      network_(NetworkAccessManager::Shared()),
       context_menu_(nullptr),
       backend_(new IcecastBackend),
       model_(nullptr),
@@ -106,6 +106,7 @@ void IcecastService::RequestDirectory(const QUrl& url, int task_id) {
   QNetworkRequest req = QNetworkRequest(url);
   req.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
                    QNetworkRequest::AlwaysNetwork);
+  req.setPriority(NetworkAccessManager::kBackgroundPriority);
 
   QNetworkReply* reply = network_->get(req);
   NewClosure(reply, SIGNAL(finished()), this,
@@ -133,7 +134,9 @@ void IcecastService::DownloadDirectoryFinished(QNetworkReply* reply,
   }
 
   QFuture<IcecastBackend::StationList> future =
-      QtConcurrent::run(this, &IcecastService::ParseDirectory, reply);
+      TaskExecutor::Instance()->Run<IcecastBackend::StationList>(
+          TaskExecutor::Lane_Bulk,
+          std::bind(&IcecastService::ParseDirectory, this, reply));
   NewClosure(future, this, SLOT(ParseDirectoryFinished(
                                QFuture<IcecastBackend::StationList>, int)),
              future, task_id);
@@ -228,7 +231,7 @@ void IcecastService::ParseDirectoryFinished(
     }
   }
 
-  backend_->ClearAndAddStations(all_stations);
+  backend_->UpdateStations(all_stations);
 
   app_->task_manager()->SetTaskFinished(task_id);
 }
@@ -59,7 +59,7 @@ IntergalacticFMServiceBase::IntergalacticFMServiceBase(
       url_handler_(new IntergalacticFMUrlHandler(app, this, this)),
       root_(nullptr),
       context_menu_(nullptr),
-      network_(new NetworkAccessManager(this)),
+      network_(NetworkAccessManager::Shared()),
       streams_(name, "streams", kStreamsCacheDurationSecs),
       name_(name),
       channel_list_url_(channel_list_url),
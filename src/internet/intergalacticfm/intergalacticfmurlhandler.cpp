@@ -29,6 +29,7 @@
 #include "intergalacticfmservice.h"
 #include "core/application.h"
 #include "core/logging.h"
+#include "core/network.h"
 #include "core/taskmanager.h"
 #include "playlistparsers/playlistparser.h"
 
@@ -48,8 +49,9 @@ UrlHandler::LoadResult IntergalacticFMUrlHandler::StartLoading(
   playlist_url.setScheme("https");
 
   // Load the playlist
-  QNetworkReply* reply =
-      service_->network()->get(QNetworkRequest(playlist_url));
+  QNetworkRequest request(playlist_url);
+  request.setPriority(NetworkAccessManager::kPlaybackPriority);
+  QNetworkReply* reply = service_->network()->get(request);
   connect(reply, SIGNAL(finished()), SLOT(LoadPlaylistFinished()));
 
   if (!task_id_)
@@ -37,15 +37,13 @@ const char* JamendoDynamicPlaylist::kUrl =
 JamendoDynamicPlaylist::JamendoDynamicPlaylist()
     : order_by_(OrderBy_Rating),
       order_direction_(Order_Descending),
-      current_page_(0),
-      current_index_(0) {}
+      current_page_(0) {}
 
 JamendoDynamicPlaylist::JamendoDynamicPlaylist(const QString& name,
                                                OrderBy order_by)
     : order_by_(order_by),
       order_direction_(Order_Descending),
-      current_page_(0),
-      current_index_(0) {
+      current_page_(0) {
   set_name(name);
 }
 
@@ -70,25 +68,6 @@ QByteArray JamendoDynamicPlaylist::Save() const {
 
 PlaylistItemList JamendoDynamicPlaylist::Generate() { return GenerateMore(20); }
 
-PlaylistItemList JamendoDynamicPlaylist::GenerateMore(int count) {
-  int tries = 0;
-
-  PlaylistItemList items;
-  while (items.size() < count && tries++ < kApiRetryLimit) {
-    // Add items from current list.
-    if (current_index_ < current_items_.size()) {
-      PlaylistItemList more_items = current_items_.mid(current_index_, count);
-      items << more_items;
-      current_index_ += more_items.size();
-    } else {
-      // We need more songs!
-      Fetch();
-    }
-  }
-
-  return items;
-}
-
 QString JamendoDynamicPlaylist::OrderSpec(OrderBy by, OrderDirection dir) {
   QString ret;
   switch (by) {
@@ -116,7 +95,7 @@ QString JamendoDynamicPlaylist::OrderSpec(OrderBy by, OrderDirection dir) {
   return ret;
 }
 
-void JamendoDynamicPlaylist::Fetch() {
+PlaylistItemList JamendoDynamicPlaylist::Fetch() {
   QUrl url(kUrl);
   QUrlQuery url_query;
   url_query.addQueryItem("pn", QString::number(current_page_++));
@@ -127,7 +106,7 @@ void JamendoDynamicPlaylist::Fetch() {
   // TODO
   // We have to use QHttp here because there's no way to disable Keep-Alive
   // with QNetworkManager.
-  QNetworkAccessManager network(this);
+  QNetworkAccessManager network;
   QNetworkRequest req(url);
   QNetworkReply *reply = network.get(req);
 
@@ -143,7 +122,7 @@ void JamendoDynamicPlaylist::Fetch() {
   if (reply->error() != QNetworkReply::NoError) {
     qLog(Warning) << "HTTP error returned from Jamendo:" << reply->errorString()
                   << ", url:" << url.toString();
-    return;
+    return PlaylistItemList();
   }
 
   // The reply will contain one track ID per line
@@ -155,15 +134,16 @@ void JamendoDynamicPlaylist::Fetch() {
 
   if (songs.empty()) {
     qLog(Warning) << "No songs returned from Jamendo:" << url.toString();
-    return;
+    return PlaylistItemList();
   }
 
-  current_items_.clear();
+  PlaylistItemList items;
   for (const Song& song : songs) {
-    if (song.is_valid())
-      current_items_ << PlaylistItemPtr(new JamendoPlaylistItem(song));
+    if (song.is_valid()) {
+      items << PlaylistItemPtr(new JamendoPlaylistItem(song));
+    }
   }
-  current_index_ = 0;
+  return items;
 }
 
 QDataStream& operator<<(QDataStream& s, const JamendoDynamicPlaylist& p) {
@@ -21,9 +21,9 @@
 #ifndef INTERNET_JAMENDO_JAMENDODYNAMICPLAYLIST_H_
 #define INTERNET_JAMENDO_JAMENDODYNAMICPLAYLIST_H_
 
-#include "smartplaylists/generator.h"
+#include "smartplaylists/bufferedgenerator.h"
 
-class JamendoDynamicPlaylist : public smart_playlists::Generator {
+class JamendoDynamicPlaylist : public smart_playlists::BufferedGenerator {
   Q_OBJECT
   friend QDataStream& operator<<(QDataStream& s,
                                  const JamendoDynamicPlaylist& p);
@@ -56,11 +56,11 @@ class JamendoDynamicPlaylist : public smart_playlists::Generator {
 
   PlaylistItemList Generate();
 
-  bool is_dynamic() const { return true; }
-  PlaylistItemList GenerateMore(int count);
+ protected:
+  // Fetches the next page of tracks.
+  PlaylistItemList Fetch();
 
  private:
-  void Fetch();
   static QString OrderSpec(OrderBy by, OrderDirection dir);
 
  private:
@@ -68,11 +68,8 @@ class JamendoDynamicPlaylist : public smart_playlists::Generator {
   OrderDirection order_direction_;
 
   int current_page_;
-  PlaylistItemList current_items_;
-  int current_index_;
 
   static const int kPageSize = 100;
-  static const int kApiRetryLimit = 5;
   static const char* kUrl;
 };
 
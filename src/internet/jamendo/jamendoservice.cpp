@@ -27,8 +27,8 @@
 #include <QMenu>
 #include <QMessageBox>
 #include <QNetworkReply>
+#include <QSettings>
 #include <QSortFilterProxyModel>
-#include <QtConcurrentRun>
 #include <QXmlStreamReader>
 #include "qtiocompressor.h"
 
@@ -41,6 +41,7 @@
 #include "core/mergedproxymodel.h"
 #include "core/network.h"
 #include "core/scopedtransaction.h"
+#include "core/taskexecutor.h"
 #include "core/taskmanager.h"
 #include "core/timeconstants.h"
 #include "globalsearch/globalsearch.h"
@@ -75,13 +76,15 @@ const char* JamendoService::kTrackIdsColumn = "track_id";
 
 const char* JamendoService::kSettingsGroup = "Jamendo";
 
-const int JamendoService::kBatchSize = 10000;
+const int JamendoService::kBatchSize = 2000;
 const int JamendoService::kApproxDatabaseSize = 450000;
 
 JamendoService::JamendoService(Application* app, InternetModel* parent)
     : InternetService(kServiceName, app, parent, parent),
-      network_(new NetworkAccessManager(this)),
+      network_(NetworkAccessManager::Shared()),
       context_menu_(nullptr),
+      database_(new Database(app, app->database(), "jamendo"),
+                [](QObject* obj) { obj->deleteLater(); }),
       library_backend_(nullptr),
       library_filter_(nullptr),
       library_model_(nullptr),
@@ -90,10 +93,12 @@ JamendoService::JamendoService(Application* app, InternetModel* parent)
       load_database_task_id_(0),
       total_song_count_(0),
       accepted_download_(false) {
+  app_->MoveToNewThread(database_.get());
+
   library_backend_.reset(new LibraryBackend,
                          [](QObject* obj) { obj->deleteLater(); });
-  library_backend_->moveToThread(app_->database()->thread());
-  library_backend_->Init(app_->database(), kSongsTable, kFtsTable);
+  library_backend_->moveToThread(database_->thread());
+  library_backend_->Init(database_.get(), kSongsTable, kFtsTable);
   connect(library_backend_.get(), SIGNAL(TotalSongCountUpdated(int)),
           SLOT(UpdateTotalSongCount(int)));
 
@@ -188,6 +193,19 @@ void JamendoService::DownloadDirectory() {
   QNetworkRequest req = QNetworkRequest(QUrl(kDirectoryUrl));
   req.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
                    QNetworkRequest::AlwaysNetwork);
+  req.setPriority(NetworkAccessManager::kBackgroundPriority);
+
+  // Only download the directory again if it changed since we last parsed it.
+  if (total_song_count_ > 0) {
+    QSettings s;
+    s.beginGroup(kSettingsGroup);
+    const QByteArray etag = s.value("directory_etag").toByteArray();
+    const QByteArray last_modified =
+        s.value("directory_last_modified").toByteArray();
+    if (!etag.isEmpty()) req.setRawHeader("If-None-Match", etag);
+    if (!last_modified.isEmpty())
+      req.setRawHeader("If-Modified-Since", last_modified);
+  }
 
   QNetworkReply* reply = network_->get(req);
   connect(reply, SIGNAL(finished()), SLOT(DownloadDirectoryFinished()));
@@ -213,7 +231,21 @@ void JamendoService::DownloadDirectoryFinished() {
   app_->task_manager()->SetTaskFinished(load_database_task_id_);
   load_database_task_id_ = 0;
 
-  // TODO(John Maguire): Not leak reply.
+  if (reply->error() != QNetworkReply::NoError) {
+    qLog(Error) << "Failed to download the Jamendo directory"
+                << reply->errorString();
+    reply->deleteLater();
+    return;
+  }
+
+  if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() ==
+      304) {
+    qLog(Info) << "Jamendo directory has not changed";
+    reply->deleteLater();
+    return;
+  }
+
+  // TODO(John Maguire): Not leak gzip.
   QtIOCompressor* gzip = new QtIOCompressor(reply);
   gzip->setStreamFormat(QtIOCompressor::GzipFormat);
   if (!gzip->open(QIODevice::ReadOnly)) {
@@ -225,9 +257,11 @@ void JamendoService::DownloadDirectoryFinished() {
   load_database_task_id_ =
       app_->task_manager()->StartTask(tr("Parsing Jamendo catalogue"));
 
-  QFuture<void> future =
-      QtConcurrent::run(this, &JamendoService::ParseDirectory, gzip);
-  NewClosure(future, this, SLOT(ParseDirectoryFinished()));
+  QFuture<void> future = TaskExecutor::Instance()->Run<void>(
+      TaskExecutor::Lane_Bulk,
+      std::bind(&JamendoService::ParseDirectory, this, gzip));
+  NewClosure(future, this, SLOT(ParseDirectoryFinished(QNetworkReply*)),
+             reply);
 }
 
 void JamendoService::ParseDirectory(QIODevice* device) const {
@@ -280,17 +314,26 @@ void JamendoService::ParseDirectory(QIODevice* device) const {
 }
 
 void JamendoService::InsertTrackIds(const TrackIdList& ids) const {
+  // SQLite limits a multi-row VALUES clause to 500 rows.
+  const int kIdsPerInsert = 500;
+
   QMutexLocker l(library_backend_->db()->Mutex());
   QSqlDatabase db(library_backend_->db()->Connect());
 
   ScopedTransaction t(&db);
 
-  QSqlQuery insert(db);
-  insert.prepare(QString("INSERT INTO %1 (%2) VALUES (:id)")
-                       .arg(kTrackIdsTable, kTrackIdsColumn));
+  for (int offset = 0; offset < ids.count(); offset += kIdsPerInsert) {
+    const TrackIdList chunk = ids.mid(offset, kIdsPerInsert);
+
+    QStringList placeholders;
+    for (int i = 0; i < chunk.count(); ++i) placeholders << "(?)";
+
+    QSqlQuery insert(db);
+    insert.prepare(QString("INSERT INTO %1 (%2) VALUES %3")
+                       .arg(kTrackIdsTable, kTrackIdsColumn,
+                            placeholders.join(",")));
+    for (int id : chunk) insert.addBindValue(id);
 
-  for (int id : ids) {
-    insert.bindValue(":id", id);
     if (!insert.exec()) {
       qLog(Warning) << "Query failed" << insert.lastQuery();
     }
@@ -402,13 +445,22 @@ Song JamendoService::ReadTrack(const QString& artist, const QString& album,
   return song;
 }
 
-void JamendoService::ParseDirectoryFinished() {
+void JamendoService::ParseDirectoryFinished(QNetworkReply* reply) {
+  reply->deleteLater();
+
   // show smart playlists
   library_model_->set_show_smart_playlists(true);
   library_model_->Reset();
 
   app_->task_manager()->SetTaskFinished(load_database_task_id_);
   load_database_task_id_ = 0;
+
+  // Remember which version of the directory we have so the next refresh can be
+  // skipped if it hasn't changed.
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  s.setValue("directory_etag", reply->rawHeader("ETag"));
+  s.setValue("directory_last_modified", reply->rawHeader("Last-Modified"));
 }
 
 void JamendoService::EnsureMenuCreated() {
@@ -28,6 +28,7 @@
 
 #include "core/song.h"
 
+class Database;
 class LibraryBackend;
 class LibraryFilterWidget;
 class LibraryModel;
@@ -93,7 +94,7 @@ class JamendoService : public InternetService {
   void DownloadDirectory();
   void DownloadDirectoryProgress(qint64 received, qint64 total);
   void DownloadDirectoryFinished();
-  void ParseDirectoryFinished();
+  void ParseDirectoryFinished(QNetworkReply* reply);
   void UpdateTotalSongCount(int count);
 
   void AlbumInfo();
@@ -110,6 +111,9 @@ class JamendoService : public InternetService {
   QAction* album_info_;
   QAction* download_album_;
 
+  // The catalogue is written through a database of its own, so a reload
+  // doesn't make the library wait.
+  std::shared_ptr<Database> database_;
   std::shared_ptr<LibraryBackend> library_backend_;
   LibraryFilterWidget* library_filter_;
   LibraryModel* library_model_;
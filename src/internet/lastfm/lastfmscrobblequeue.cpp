@@ -0,0 +1,128 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "lastfmscrobblequeue.h"
+
+#include <QMutexLocker>
+#include <QSqlQuery>
+#include <QVariant>
+
+#include "core/database.h"
+#include "core/scopedtransaction.h"
+
+LastFMScrobbleQueue::LastFMScrobbleQueue(Database* db) : db_(db) {}
+
+void LastFMScrobbleQueue::Add(const QString& username, const Entry& entry) {
+  Add(username, EntryList() << entry);
+}
+
+void LastFMScrobbleQueue::Add(const QString& username,
+                              const EntryList& entries) {
+  if (entries.isEmpty()) return;
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+  ScopedTransaction t(&db);
+
+  QSqlQuery q(db);
+  q.prepare(
+      "INSERT INTO lastfm_scrobble_queue"
+      " (username, artist, album_artist, album, title, track, length,"
+      "  timestamp)"
+      " VALUES (:username, :artist, :album_artist, :album, :title, :track,"
+      "  :length, :timestamp)");
+
+  for (const Entry& entry : entries) {
+    q.bindValue(":username", username);
+    q.bindValue(":artist", entry.artist);
+    q.bindValue(":album_artist", entry.album_artist);
+    q.bindValue(":album", entry.album);
+    q.bindValue(":title", entry.title);
+    q.bindValue(":track", entry.track);
+    q.bindValue(":length", entry.length);
+    q.bindValue(":timestamp", entry.timestamp);
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+  }
+
+  t.Commit();
+}
+
+LastFMScrobbleQueue::EntryList LastFMScrobbleQueue::Peek(
+    const QString& username, int max_count) const {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(db);
+  q.prepare(
+      "SELECT ROWID, artist, album_artist, album, title, track, length,"
+      "  timestamp"
+      " FROM lastfm_scrobble_queue"
+      " WHERE username = :username"
+      " ORDER BY timestamp, ROWID"
+      " LIMIT :limit");
+  q.bindValue(":username", username);
+  q.bindValue(":limit", max_count);
+  q.exec();
+
+  EntryList ret;
+  if (db_->CheckErrors(q)) return ret;
+
+  while (q.next()) {
+    Entry entry;
+    entry.id = q.value(0).toLongLong();
+    entry.artist = q.value(1).toString();
+    entry.album_artist = q.value(2).toString();
+    entry.album = q.value(3).toString();
+    entry.title = q.value(4).toString();
+    entry.track = q.value(5).toInt();
+    entry.length = q.value(6).toInt();
+    entry.timestamp = q.value(7).toLongLong();
+    ret << entry;
+  }
+  return ret;
+}
+
+void LastFMScrobbleQueue::Remove(const EntryList& entries) {
+  if (entries.isEmpty()) return;
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+  ScopedTransaction t(&db);
+
+  QSqlQuery q(db);
+  q.prepare("DELETE FROM lastfm_scrobble_queue WHERE ROWID = :id");
+  for (const Entry& entry : entries) {
+    q.bindValue(":id", entry.id);
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+  }
+
+  t.Commit();
+}
+
+int LastFMScrobbleQueue::Count(const QString& username) const {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(db);
+  q.prepare(
+      "SELECT COUNT(*) FROM lastfm_scrobble_queue WHERE username = :username");
+  q.bindValue(":username", username);
+  q.exec();
+  if (db_->CheckErrors(q) || !q.next()) return 0;
+  return q.value(0).toInt();
+}
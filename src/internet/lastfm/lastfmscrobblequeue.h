@@ -0,0 +1,60 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INTERNET_LASTFM_LASTFMSCROBBLEQUEUE_H_
+#define INTERNET_LASTFM_LASTFMSCROBBLEQUEUE_H_
+
+#include <QList>
+#include <QString>
+
+class Database;
+
+// Scrobbles that haven't been accepted by Last.fm yet.  They're kept in the
+// database so they survive being offline, Last.fm outages and restarts.
+class LastFMScrobbleQueue {
+ public:
+  explicit LastFMScrobbleQueue(Database* db);
+
+  struct Entry {
+    Entry() : id(-1), track(0), length(0), timestamp(0) {}
+
+    qint64 id;
+    QString artist;
+    QString album_artist;
+    QString album;
+    QString title;
+    int track;
+    // In seconds.
+    int length;
+    // Seconds since the epoch when the track started playing.
+    qint64 timestamp;
+  };
+  typedef QList<Entry> EntryList;
+
+  void Add(const QString& username, const Entry& entry);
+  void Add(const QString& username, const EntryList& entries);
+
+  // Returns the oldest scrobbles for this user, without removing them.
+  EntryList Peek(const QString& username, int max_count) const;
+  void Remove(const EntryList& entries);
+
+  int Count(const QString& username) const;
+
+ private:
+  Database* db_;
+};
+
+#endif  // INTERNET_LASTFM_LASTFMSCROBBLEQUEUE_H_
@@ -39,6 +39,7 @@
 #include <QMenu>
 #include <QMessageBox>
 #include <QSettings>
+#include <QTimer>
 #include <QUrlQuery>
 
 #ifdef HAVE_LIBLASTFM1
@@ -50,6 +51,7 @@
 #include "lastfmcompat.h"
 #include "core/application.h"
 #include "core/closure.h"
+#include "core/database.h"
 #include "core/logging.h"
 #include "core/network.h"
 #include "core/player.h"
@@ -78,8 +80,19 @@ const char* LastFMService::kSecret = "d3072b60ae626be12be69448f5c46e70";
 const char* LastFMService::kAuthLoginUrl =
     "https://www.last.fm/api/auth/?api_key=%1&token=%2";
 
+// The most track.scrobble accepts in one request.
+const int LastFMService::kMaxScrobblesPerRequest = 50;
+const int LastFMService::kNowPlayingDelayMsec = 2000;
+const int LastFMService::kRetryMinMsec = 30 * 1000;
+const int LastFMService::kRetryMaxMsec = 30 * 60 * 1000;
+
 LastFMService::LastFMService(Application* app, QObject* parent)
     : Scrobbler(parent),
+      now_playing_timer_(new QTimer(this)),
+      queue_(new LastFMScrobbleQueue(app->database())),
+      submitting_(false),
+      submit_failures_(0),
+      retry_timer_(new QTimer(this)),
       scrobbling_enabled_(false),
       connection_problems_(false),
       app_(app),
@@ -88,6 +101,13 @@ LastFMService::LastFMService(Application* app, QObject* parent)
   lastfm::ws::setScheme(lastfm::ws::Https);
 #endif
 
+  now_playing_timer_->setSingleShot(true);
+  now_playing_timer_->setInterval(kNowPlayingDelayMsec);
+  connect(now_playing_timer_, SIGNAL(timeout()), SLOT(SendNowPlaying()));
+
+  retry_timer_->setSingleShot(true);
+  connect(retry_timer_, SIGNAL(timeout()), SLOT(SubmitQueue()));
+
   ReloadSettings();
 
   // we emit the signal the first time to be sure the buttons are in the right
@@ -306,13 +326,13 @@ QString LastFMService::ErrorString(lastfm::ws::Error error) const {
 bool LastFMService::InitScrobbler() {
   if (!IsAuthenticated() || !IsScrobblingEnabled()) return false;
 
-  if (!scrobbler_)
+  if (!scrobbler_) {
+    MigrateScrobbleCache();
     scrobbler_.reset(new lastfm::Audioscrobbler(kAudioscrobblerClientId));
+  }
 
 // reemit the signal since the sender is private
 #ifdef HAVE_LIBLASTFM1
-  connect(scrobbler_.get(), SIGNAL(scrobblesSubmitted(QList<lastfm::Track>)),
-          SIGNAL(ScrobbleSubmitted()));
   connect(scrobbler_.get(), SIGNAL(nowPlayingError(int, QString)),
           SIGNAL(ScrobbleError(int)));
 #else
@@ -363,8 +383,8 @@ void LastFMService::NowPlaying(const Song& song) {
 
       qLog(Info) << "Scrobbling stream track" << mtrack.title() << "length"
                  << duration_secs;
-      scrobbler_->cache(mtrack);
-      scrobbler_->submit();
+      EnqueueScrobble(mtrack);
+      if (!retry_timer_->isActive()) SubmitQueue();
 
       emit ScrobbledRadioStream();
     }
@@ -389,7 +409,15 @@ void LastFMService::NowPlaying(const Song& song) {
 // no impact as we get a different error when actually trying to scrobble.
 #endif
 
-  scrobbler_->nowPlaying(mtrack);
+  now_playing_track_ = mtrack;
+  now_playing_timer_->start();
+}
+
+void LastFMService::SendNowPlaying() {
+  if (!scrobbler_ || now_playing_track_.isNull()) return;
+
+  scrobbler_->nowPlaying(now_playing_track_);
+  now_playing_track_ = lastfm::Track();
 }
 
 void LastFMService::CacheSong(int scrobble_point) {
@@ -397,7 +425,7 @@ void LastFMService::CacheSong(int scrobble_point) {
 
   if (!already_cached_to_scrobble_ && scrobble_point) {
     qLog(Info) << "Caching song to scrobble at" << scrobble_point;
-    scrobbler_->cache(last_track_);
+    EnqueueScrobble(last_track_);
     already_cached_to_scrobble_ = true;
   }
   emit CachedToScrobble();
@@ -406,13 +434,111 @@ void LastFMService::CacheSong(int scrobble_point) {
 void LastFMService::Scrobble() {
   if (!InitScrobbler()) return;
 
-  lastfm::compat::ScrobbleCache cache(lastfm::ws::Username);
-  qLog(Debug) << "There are" << cache.tracks().count()
-              << "tracks in the last.fm cache before submit request.";
+  qLog(Debug) << "There are" << queue_->Count(lastfm::ws::Username)
+              << "tracks in the last.fm queue before submit request.";
 
   // Let's mark a track as cached, useful when the connection is down
   emit ScrobbleError(30);
-  if (!cache.tracks().isEmpty()) scrobbler_->submit();
+
+  // If an earlier request failed, wait for the retry instead of hammering
+  // Last.fm on every track change.
+  if (!retry_timer_->isActive()) SubmitQueue();
+}
+
+void LastFMService::EnqueueScrobble(const lastfm::Track& track) {
+  if (track.artist().name().isEmpty() || track.title().isEmpty()) {
+    qLog(Debug) << "Not scrobbling a track without an artist or title";
+    return;
+  }
+
+  LastFMScrobbleQueue::Entry entry;
+  entry.artist = track.artist().name();
+#if LASTFM_MAJOR_VERSION >= 1
+  entry.album_artist = track.albumArtist().name();
+#endif
+  entry.album = track.album().title();
+  entry.title = track.title();
+  entry.track = track.trackNumber();
+  entry.length = track.duration();
+  entry.timestamp = track.timestamp().toTime_t();
+
+  queue_->Add(lastfm::ws::Username, entry);
+}
+
+void LastFMService::MigrateScrobbleCache() {
+  lastfm::compat::ScrobbleCache cache(lastfm::ws::Username);
+  const QList<lastfm::Track> tracks = cache.tracks();
+  if (tracks.isEmpty()) return;
+
+  qLog(Info) << "Moving" << tracks.count()
+             << "tracks from the liblastfm cache to the scrobble queue";
+  for (const lastfm::Track& track : tracks) {
+    EnqueueScrobble(track);
+  }
+  cache.remove(tracks);
+}
+
+void LastFMService::SubmitQueue() {
+  if (!IsAuthenticated() || submitting_) return;
+
+  const LastFMScrobbleQueue::EntryList entries =
+      queue_->Peek(lastfm::ws::Username, kMaxScrobblesPerRequest);
+  if (entries.isEmpty()) return;
+
+  QMap<QString, QString> params;
+  params["method"] = "track.scrobble";
+  for (int i = 0; i < entries.count(); ++i) {
+    const LastFMScrobbleQueue::Entry& entry = entries[i];
+    const QString index = QString("[%1]").arg(i);
+
+    params["artist" + index] = entry.artist;
+    params["track" + index] = entry.title;
+    params["timestamp" + index] = QString::number(entry.timestamp);
+    if (!entry.album.isEmpty()) params["album" + index] = entry.album;
+    if (!entry.album_artist.isEmpty())
+      params["albumArtist" + index] = entry.album_artist;
+    if (entry.track > 0)
+      params["trackNumber" + index] = QString::number(entry.track);
+    if (entry.length > 0)
+      params["duration" + index] = QString::number(entry.length);
+  }
+
+  submitting_ = true;
+  QNetworkReply* reply = lastfm::ws::post(params);
+  NewClosure(reply, SIGNAL(finished()), [this, reply, entries]() {
+    SubmitQueueFinished(reply, entries);
+  });
+}
+
+void LastFMService::SubmitQueueFinished(
+    QNetworkReply* reply, const LastFMScrobbleQueue::EntryList& entries) {
+  reply->deleteLater();
+  submitting_ = false;
+
+  lastfm::XmlQuery lfm(lastfm::compat::EmptyXmlQuery());
+  if (!lastfm::compat::ParseQuery(reply->readAll(), &lfm,
+                                  &connection_problems_)) {
+    // Leave everything in the queue and try again later, waiting twice as
+    // long each time it fails.
+    const int delay = qMin<qint64>(
+        kRetryMaxMsec, qint64(kRetryMinMsec) << qMin(submit_failures_, 10));
+    submit_failures_++;
+
+    qLog(Warning) << "Failed to submit" << entries.count()
+                  << "scrobbles to Last.fm, retrying in" << delay / 1000
+                  << "seconds";
+    retry_timer_->start(delay);
+    return;
+  }
+
+  qLog(Info) << "Submitted" << entries.count() << "scrobbles to Last.fm";
+  submit_failures_ = 0;
+  retry_timer_->stop();
+  queue_->Remove(entries);
+  emit ScrobbleSubmitted();
+
+  // Keep going until the queue is empty.
+  SubmitQueue();
 }
 
 void LastFMService::Love() {
@@ -33,6 +33,7 @@ class Track;
 uint qHash(const lastfm::Track& track);
 
 #include "lastfmcompat.h"
+#include "lastfmscrobblequeue.h"
 
 #include "internet/core/scrobbler.h"
 
@@ -40,6 +41,7 @@ class Application;
 class LastFMUrlHandler;
 class NetworkAccessManager;
 class QAction;
+class QTimer;
 class Song;
 
 class LastFMService : public Scrobbler {
@@ -56,6 +58,11 @@ class LastFMService : public Scrobbler {
   static const char* kSecret;
   static const char* kAuthLoginUrl;
 
+  static const int kMaxScrobblesPerRequest;
+  static const int kNowPlayingDelayMsec;
+  static const int kRetryMinMsec;
+  static const int kRetryMaxMsec;
+
   void ReloadSettings();
 
   virtual QString Icon() { return ":last.fm/lastfm.png"; }
@@ -101,11 +108,20 @@ signals:
 
   void ScrobblerStatus(int value);
 
+  void SendNowPlaying();
+  void SubmitQueue();
+
  private:
   QString ErrorString(lastfm::ws::Error error) const;
   bool InitScrobbler();
   lastfm::Track TrackFromSong(const Song& song) const;
 
+  void EnqueueScrobble(const lastfm::Track& track);
+  // Moves anything liblastfm still has in its own cache into our queue.
+  void MigrateScrobbleCache();
+  void SubmitQueueFinished(QNetworkReply* reply,
+                           const LastFMScrobbleQueue::EntryList& entries);
+
   static QUrl FixupUrl(const QUrl& url);
 
  private:
@@ -114,6 +130,15 @@ signals:
   lastfm::Track next_metadata_;
   bool already_cached_to_scrobble_{false};
 
+  // Only the latest of several quick track changes is sent as now playing.
+  lastfm::Track now_playing_track_;
+  QTimer* now_playing_timer_;
+
+  std::unique_ptr<LastFMScrobbleQueue> queue_;
+  bool submitting_;
+  int submit_failures_;
+  QTimer* retry_timer_;
+
   QUrl last_url_;
 
   bool scrobbling_enabled_;
@@ -43,12 +43,14 @@
 #include "magnatuneurlhandler.h"
 #include "internet/core/internetmodel.h"
 #include "core/application.h"
+#include "core/closure.h"
 #include "core/database.h"
 #include "core/logging.h"
 #include "core/mergedproxymodel.h"
 #include "core/network.h"
 #include "core/player.h"
 #include "core/song.h"
+#include "core/taskexecutor.h"
 #include "core/taskmanager.h"
 #include "core/timeconstants.h"
 #include "globalsearch/globalsearch.h"
@@ -74,6 +76,8 @@ const char* MagnatuneService::kPartnerId = "clementine";
 const char* MagnatuneService::kDownloadUrl =
     "http://download.magnatune.com/buy/membership_free_dl_xml";
 
+const int MagnatuneService::kBatchSize = 2000;
+
 MagnatuneService::MagnatuneService(Application* app, InternetModel* parent)
     : InternetService(kServiceName, app, parent, parent),
       url_handler_(new MagnatuneUrlHandler(this, this)),
@@ -87,7 +91,7 @@ MagnatuneService::MagnatuneService(Application* app, InternetModel* parent)
       membership_(Membership_None),
       format_(Format_Ogg),
       total_song_count_(0),
-      network_(new NetworkAccessManager(this)) {
+      network_(NetworkAccessManager::Shared()) {
   // Create the library backend in the database thread
   library_backend_.reset(new LibraryBackend,
                          [](QObject* obj) { obj->deleteLater(); });
@@ -152,6 +156,19 @@ void MagnatuneService::ReloadDatabase() {
   QNetworkRequest request = QNetworkRequest(QUrl(kDatabaseUrl));
   request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
                        QNetworkRequest::AlwaysNetwork);
+  request.setPriority(NetworkAccessManager::kBackgroundPriority);
+
+  // Only download the catalogue again if it changed since we last parsed it.
+  if (total_song_count_ > 0) {
+    QSettings s;
+    s.beginGroup(kSettingsGroup);
+    const QByteArray etag = s.value("catalogue_etag").toByteArray();
+    const QByteArray last_modified =
+        s.value("catalogue_last_modified").toByteArray();
+    if (!etag.isEmpty()) request.setRawHeader("If-None-Match", etag);
+    if (!last_modified.isEmpty())
+      request.setRawHeader("If-Modified-Since", last_modified);
+  }
 
   QNetworkReply* reply = network_->get(request);
   connect(reply, SIGNAL(finished()), SLOT(ReloadDatabaseFinished()));
@@ -170,11 +187,30 @@ void MagnatuneService::ReloadDatabaseFinished() {
   if (reply->error() != QNetworkReply::NoError) {
     // TODO(David Sansome): Error handling
     qLog(Error) << reply->errorString();
+    reply->deleteLater();
+    return;
+  }
+
+  if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() ==
+      304) {
+    qLog(Info) << "Magnatune catalogue has not changed";
+    reply->deleteLater();
     return;
   }
 
   if (root_->hasChildren()) root_->removeRows(0, root_->rowCount());
 
+  load_database_task_id_ =
+      app_->task_manager()->StartTask(tr("Parsing Magnatune catalogue"));
+
+  QFuture<void> future = TaskExecutor::Instance()->Run<void>(
+      TaskExecutor::Lane_Bulk,
+      std::bind(&MagnatuneService::ParseCatalogue, this, reply));
+  NewClosure(future, this, SLOT(ParseCatalogueFinished(QNetworkReply*)),
+             reply);
+}
+
+void MagnatuneService::ParseCatalogue(QNetworkReply* reply) {
   // The XML file is compressed
   QtIOCompressor gzip(reply);
   gzip.setStreamFormat(QtIOCompressor::GzipFormat);
@@ -186,7 +222,8 @@ void MagnatuneService::ReloadDatabaseFinished() {
   // Remove all existing songs in the database
   library_backend_->DeleteAll();
 
-  // Parse the XML we got from Magnatune
+  // Parse the XML we got from Magnatune, adding the songs to the database in
+  // batches so the whole catalogue is never held in memory at once.
   QXmlStreamReader reader(&gzip);
   SongList songs;
   while (!reader.atEnd()) {
@@ -195,12 +232,31 @@ void MagnatuneService::ReloadDatabaseFinished() {
     if (reader.tokenType() == QXmlStreamReader::StartElement &&
         reader.name() == "Track") {
       songs << ReadTrack(reader);
+
+      if (songs.count() >= kBatchSize) {
+        library_backend_->AddOrUpdateSongs(songs);
+        songs.clear();
+      }
     }
   }
 
-  // Add the songs to the database
   library_backend_->AddOrUpdateSongs(songs);
+}
+
+void MagnatuneService::ParseCatalogueFinished(QNetworkReply* reply) {
+  reply->deleteLater();
+
+  app_->task_manager()->SetTaskFinished(load_database_task_id_);
+  load_database_task_id_ = 0;
+
   library_model_->Reset();
+
+  // Remember which version of the catalogue we have so the next reload can be
+  // skipped if it hasn't changed.
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  s.setValue("catalogue_etag", reply->rawHeader("ETag"));
+  s.setValue("catalogue_last_modified", reply->rawHeader("Last-Modified"));
 }
 
 Song MagnatuneService::ReadTrack(QXmlStreamReader& reader) {
@@ -27,6 +27,7 @@
 #include "internet/core/internetservice.h"
 
 class QNetworkAccessManager;
+class QNetworkReply;
 class QSortFilterProxyModel;
 class QMenu;
 
@@ -70,6 +71,8 @@ class MagnatuneService : public InternetService {
   static const char* kPartnerId;
   static const char* kDownloadUrl;
 
+  static const int kBatchSize;
+
   static QString ReadElementText(QXmlStreamReader& reader);
 
   QStandardItem* CreateRootItem();
@@ -97,6 +100,7 @@ class MagnatuneService : public InternetService {
   void UpdateTotalSongCount(int count);
   void ReloadDatabase();
   void ReloadDatabaseFinished();
+  void ParseCatalogueFinished(QNetworkReply* reply);
 
   void Download();
   void Homepage();
@@ -105,6 +109,7 @@ class MagnatuneService : public InternetService {
  private:
   void EnsureMenuCreated();
 
+  void ParseCatalogue(QNetworkReply* reply);
   Song ReadTrack(QXmlStreamReader& reader);
 
  private:
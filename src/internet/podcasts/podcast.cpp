@@ -37,7 +37,9 @@ const QStringList Podcast::kColumns = QStringList() << "url"
                                                     << "owner_email"
                                                     << "last_updated"
                                                     << "last_update_error"
-                                                    << "extra";
+                                                    << "extra"
+                                                    << "etag"
+                                                    << "last_modified";
 
 const QString Podcast::kColumnSpec = Podcast::kColumns.join(", ");
 const QString Podcast::kJoinSpec =
@@ -70,6 +72,10 @@ struct Podcast::Private : public QSharedData {
 
   QVariantMap extra_;
 
+  // Cache validators from the last time the feed was fetched
+  QString etag_;
+  QString last_modified_;
+
   // These are stored in a different table
   PodcastEpisodeList episodes_;
 };
@@ -104,6 +110,8 @@ const QString& Podcast::last_update_error() const {
 }
 const QVariantMap& Podcast::extra() const { return d->extra_; }
 QVariant Podcast::extra(const QString& key) const { return d->extra_[key]; }
+const QString& Podcast::etag() const { return d->etag_; }
+const QString& Podcast::last_modified() const { return d->last_modified_; }
 
 void Podcast::set_database_id(int v) { d->database_id_ = v; }
 void Podcast::set_url(const QUrl& v) { d->url_ = v; }
@@ -124,6 +132,8 @@ void Podcast::set_extra(const QVariantMap& v) { d->extra_ = v; }
 void Podcast::set_extra(const QString& key, const QVariant& value) {
   d->extra_[key] = value;
 }
+void Podcast::set_etag(const QString& v) { d->etag_ = v; }
+void Podcast::set_last_modified(const QString& v) { d->last_modified_ = v; }
 
 const PodcastEpisodeList& Podcast::episodes() const { return d->episodes_; }
 PodcastEpisodeList* Podcast::mutable_episodes() { return &d->episodes_; }
@@ -149,6 +159,9 @@ void Podcast::InitFromQuery(const QSqlQuery& query) {
 
   QDataStream extra_stream(query.value(13).toByteArray());
   extra_stream >> d->extra_;
+
+  d->etag_ = query.value(14).toString();
+  d->last_modified_ = query.value(15).toString();
 }
 
 void Podcast::BindToQuery(QSqlQuery* query) const {
@@ -170,6 +183,8 @@ void Podcast::BindToQuery(QSqlQuery* query) const {
   extra_stream << d->extra_;
 
   query->bindValue(":extra", extra);
+  query->bindValue(":etag", d->etag_);
+  query->bindValue(":last_modified", d->last_modified_);
 }
 
 void Podcast::InitFromGpo(const mygpo::Podcast* podcast) {
@@ -65,6 +65,8 @@ class Podcast {
   const QString& last_update_error() const;
   const QVariantMap& extra() const;
   QVariant extra(const QString& key) const;
+  const QString& etag() const;
+  const QString& last_modified() const;
 
   void set_database_id(int v);
   void set_url(const QUrl& v);
@@ -81,6 +83,8 @@ class Podcast {
   void set_last_update_error(const QString& v);
   void set_extra(const QVariantMap& v);
   void set_extra(const QString& key, const QVariant& value);
+  void set_etag(const QString& v);
+  void set_last_modified(const QString& v);
 
   // Small images are suitable for 16x16 icons in lists.  Large images are
   // used in detailed information displays.
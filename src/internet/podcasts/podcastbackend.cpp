@@ -20,6 +20,7 @@
 #include "podcastbackend.h"
 
 #include <QMutexLocker>
+#include <QSet>
 
 #include "core/application.h"
 #include "core/database.h"
@@ -132,6 +133,63 @@ void PodcastBackend::AddEpisodes(PodcastEpisodeList* episodes) {
   emit EpisodesAdded(*episodes);
 }
 
+PodcastEpisodeList PodcastBackend::AddNewEpisodes(
+    int podcast_id, const PodcastEpisodeList& episodes) {
+  PodcastEpisodeList new_episodes;
+
+  {
+    QMutexLocker l(db_->Mutex());
+    QSqlDatabase db(db_->Connect());
+    ScopedTransaction t(&db);
+
+    // Get the episode URLs we had for this podcast already.
+    QSet<QUrl> existing_urls;
+    QSqlQuery q(db);
+    q.prepare("SELECT url FROM podcast_episodes WHERE podcast_id = :id");
+    q.bindValue(":id", podcast_id);
+    q.exec();
+    if (db_->CheckErrors(q)) return new_episodes;
+    while (q.next()) {
+      existing_urls.insert(QUrl::fromEncoded(q.value(0).toByteArray()));
+    }
+
+    for (const PodcastEpisode& episode : episodes) {
+      if (existing_urls.contains(episode.url())) continue;
+
+      PodcastEpisode episode_copy(episode);
+      episode_copy.set_podcast_database_id(podcast_id);
+      new_episodes << episode_copy;
+      existing_urls.insert(episode.url());
+    }
+
+    if (new_episodes.isEmpty()) return new_episodes;
+
+    AddEpisodes(&new_episodes, &db);
+    t.Commit();
+  }
+
+  emit EpisodesAdded(new_episodes);
+  return new_episodes;
+}
+
+void PodcastBackend::UpdateSubscriptionFetchState(const Podcast& podcast) {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(db);
+  q.prepare("UPDATE podcasts"
+      " SET last_updated = :last_updated,"
+      "     etag = :etag,"
+      "     last_modified = :last_modified"
+      " WHERE ROWID = :id");
+  q.bindValue(":last_updated", podcast.last_updated().toTime_t());
+  q.bindValue(":etag", podcast.etag());
+  q.bindValue(":last_modified", podcast.last_modified());
+  q.bindValue(":id", podcast.database_id());
+  q.exec();
+  db_->CheckErrors(q);
+}
+
 void PodcastBackend::UpdateEpisodes(const PodcastEpisodeList& episodes) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
@@ -69,6 +69,16 @@ class PodcastBackend : public QObject {
   // podcast_database_id set already.
   void AddEpisodes(PodcastEpisodeList* episodes);
 
+  // Adds only those episodes whose URL isn't already in the given podcast,
+  // setting podcast_database_id on each one.  Returns the episodes that were
+  // added, and only emits EpisodesAdded for them.
+  PodcastEpisodeList AddNewEpisodes(int podcast_id,
+                                    const PodcastEpisodeList& episodes);
+
+  // Saves the time the podcast was last fetched and the ETag and
+  // Last-Modified headers that came with it.
+  void UpdateSubscriptionFetchState(const Podcast& podcast);
+
   // Updates the editable fields (listened, listened_date, downloaded, and
   // local_url) on episodes that must already exist in the database.
   void UpdateEpisodes(const PodcastEpisodeList& episodes);
@@ -19,6 +19,8 @@
 
 #include "podcastdownloader.h"
 
+#include <limits>
+
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
@@ -37,59 +39,167 @@
 #include "podcastbackend.h"
 
 const char* PodcastDownloader::kSettingsGroup = "Podcasts";
-
-Task::Task(PodcastEpisode episode, QFile* file, PodcastBackend* backend)
-    : file_(file),
+const int PodcastDownloader::kDefaultDownloadsPerHost = 2;
+const int PodcastDownloader::kThrottleIntervalMsec = 100;
+
+const char* Task::kPartialSuffix = ".part";
+const int Task::kMaxRetries = 3;
+const int Task::kRetryDelayMsec = 5000;
+const int Task::kThrottledBufferSize = 64 * 1024;
+
+Task::Task(PodcastEpisode episode, const QString& filename, bool manual,
+           PodcastBackend* backend, QNetworkAccessManager* network)
+    : filename_(filename),
+      file_(new QFile(QString("%1/.%2%3").arg(
+          QFileInfo(filename).path(), QString::number(episode.database_id()),
+          kPartialSuffix))),
       episode_(episode),
-      req_(QNetworkRequest(episode.url())),
+      manual_(manual),
       backend_(backend),
-      network_(new NetworkAccessManager(this)),
-      repl(new RedirectFollower(network_->get(req_))) {
-  connect(repl.get(), SIGNAL(readyRead()), SLOT(reading()));
-  connect(repl.get(), SIGNAL(finished()), SLOT(finishedInternal()));
-  connect(repl.get(), SIGNAL(downloadProgress(qint64, qint64)),
+      network_(network),
+      reply_(nullptr),
+      started_(false),
+      throttled_(false),
+      retries_(0),
+      resume_offset_(0) {}
+
+PodcastEpisode Task::episode() const { return episode_; }
+
+bool Task::Start() {
+  if (!file_->isOpen() &&
+      !file_->open(QIODevice::ReadWrite | QIODevice::Append)) {
+    return false;
+  }
+
+  started_ = true;
+  resume_offset_ = file_->size();
+
+  QNetworkRequest req(episode_.url());
+  req.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+  req.setPriority(manual_ ? NetworkAccessManager::kInteractivePriority
+                          : NetworkAccessManager::kBackgroundPriority);
+  if (resume_offset_ > 0) {
+    qLog(Info) << "Resuming download of" << episode_.url() << "from byte"
+               << resume_offset_;
+    req.setRawHeader("Range",
+                     QString("bytes=%1-").arg(resume_offset_).toLatin1());
+  }
+
+  reply_ = network_->get(req);
+  if (throttled_) reply_->setReadBufferSize(kThrottledBufferSize);
+
+  connect(reply_, SIGNAL(readyRead()), SLOT(reading()));
+  connect(reply_, SIGNAL(metaDataChanged()), SLOT(metaDataChangedInternal()));
+  connect(reply_, SIGNAL(finished()), SLOT(finishedInternal()));
+  connect(reply_, SIGNAL(downloadProgress(qint64, qint64)),
           SLOT(downloadProgressInternal(qint64, qint64)));
-  emit ProgressChanged(episode_, PodcastDownload::Queued, 0);
+  emit ProgressChanged(episode_, PodcastDownload::Downloading, 0);
+  return true;
 }
 
-PodcastEpisode Task::episode() const { return episode_; }
+void Task::SetThrottled(bool throttled) {
+  throttled_ = throttled;
+  if (reply_) {
+    reply_->setReadBufferSize(throttled_ ? kThrottledBufferSize : 0);
+    reading();
+  }
+}
+
+qint64 Task::Read(qint64 max_bytes) {
+  if (!reply_) return 0;
+
+  const QByteArray data =
+      reply_->read(qMin(max_bytes, reply_->bytesAvailable()));
+  file_->write(data);
+  return data.size();
+}
 
 void Task::reading() {
-  qint64 bytes = 0;
-  forever {
-    bytes = repl->bytesAvailable();
-    if (bytes <= 0) break;
+  if (throttled_) return;
+
+  file_->write(reply_->readAll());
+}
 
-    file_->write(repl->reply()->read(bytes));
+void Task::metaDataChangedInternal() {
+  const int status =
+      reply_->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if (resume_offset_ > 0 && status == 200) {
+    // The server ignored our Range header and is sending the whole file.
+    qLog(Info) << "Server doesn't support resuming" << episode_.url();
+    file_->resize(0);
+    resume_offset_ = 0;
   }
 }
+
+void Task::Abort() {
+  if (!reply_) return;
+
+  disconnect(reply_, 0, this, 0);
+  reply_->abort();
+  reply_->deleteLater();
+  reply_ = nullptr;
+}
+
 void Task::finishedPublic() {
-  disconnect(repl.get(), SIGNAL(readyRead()), 0, 0);
-  disconnect(repl.get(), SIGNAL(downloadProgress(qint64, qint64)), 0, 0);
-  disconnect(repl.get(), SIGNAL(finished()), 0, 0);
+  Abort();
   emit ProgressChanged(episode_, PodcastDownload::NotDownloading, 0);
   // Delete the file
   file_->remove();
   emit finished(this);
 }
 
+void Task::Retry() {
+  // The partial file is still open, so this can't fail.
+  Start();
+}
+
 void Task::finishedInternal() {
-  if (repl->error() != QNetworkReply::NoError) {
-    qLog(Warning) << "Error downloading episode:" << repl->errorString();
+  QNetworkReply* reply = reply_;
+  reply_ = nullptr;
+  reply->deleteLater();
+
+  if (reply->error() != QNetworkReply::NoError) {
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() ==
+        416) {
+      // The partial file doesn't match what's on the server any more.
+      file_->resize(0);
+    }
+
+    if (retries_ < kMaxRetries) {
+      retries_++;
+      qLog(Warning) << "Error downloading episode:" << reply->errorString()
+                    << "- retrying";
+      emit ProgressChanged(episode_, PodcastDownload::Queued, 0);
+      QTimer::singleShot(kRetryDelayMsec * retries_, this, SLOT(Retry()));
+      return;
+    }
+
+    // Keep the partial file so the download can be resumed later.
+    qLog(Warning) << "Error downloading episode:" << reply->errorString();
+    emit ProgressChanged(episode_, PodcastDownload::NotDownloading, 0);
+    emit finished(this);
+    return;
+  }
+
+  // Write anything the throttle hadn't got round to yet.
+  file_->write(reply->readAll());
+  file_->close();
+
+  if (!QFile::rename(file_->fileName(), filename_)) {
+    qLog(Warning) << "Could not rename" << file_->fileName() << "to"
+                  << filename_;
     emit ProgressChanged(episode_, PodcastDownload::NotDownloading, 0);
-    // Delete the file
-    file_->remove();
     emit finished(this);
     return;
   }
 
-  qLog(Info) << "Download of" << file_->fileName() << "finished";
+  qLog(Info) << "Download of" << filename_ << "finished";
 
   // Tell the database the episode has been updated.  Get it from the DB again
   // in case the listened field changed in the mean time.
   PodcastEpisode episode = episode_;
   episode.set_downloaded(true);
-  episode.set_local_url(QUrl::fromLocalFile(file_->fileName()));
+  episode.set_local_url(QUrl::fromLocalFile(filename_));
   backend_->UpdateEpisodes(PodcastEpisodeList() << episode);
   Podcast podcast =
       backend_->GetSubscriptionById(episode.podcast_database_id());
@@ -98,7 +208,7 @@ void Task::finishedInternal() {
   emit ProgressChanged(episode_, PodcastDownload::Finished, 0);
 
   // I didn't ecountered even a single podcast with a correct metadata
-  TagReaderClient::Instance()->SaveFileBlocking(file_->fileName(), song);
+  TagReaderClient::Instance()->SaveFileBlocking(filename_, song);
   emit finished(this);
 }
 
@@ -107,7 +217,8 @@ void Task::downloadProgressInternal(qint64 received, qint64 total) {
     emit ProgressChanged(episode_, PodcastDownload::Downloading, 0);
   } else {
     emit ProgressChanged(episode_, PodcastDownload::Downloading,
-                         static_cast<float>(received) / total * 100);
+                         static_cast<float>(resume_offset_ + received) /
+                             (resume_offset_ + total) * 100);
   }
 }
 
@@ -115,9 +226,16 @@ PodcastDownloader::PodcastDownloader(Application* app, QObject* parent)
     : QObject(parent),
       app_(app),
       backend_(app_->podcast_backend()),
-      network_(new NetworkAccessManager(this)),
+      network_(NetworkAccessManager::Shared()),
       disallowed_filename_characters_("[^a-zA-Z0-9_~ -]"),
-      auto_download_(false) {
+      auto_download_(false),
+      downloads_per_host_(kDefaultDownloadsPerHost),
+      max_download_rate_(0),
+      max_episode_download_rate_(0),
+      throttle_timer_(new QTimer(this)) {
+  throttle_timer_->setInterval(kThrottleIntervalMsec);
+  connect(throttle_timer_, SIGNAL(timeout()), SLOT(Throttle()));
+
   connect(backend_, SIGNAL(EpisodesAdded(PodcastEpisodeList)),
           SLOT(EpisodesAdded(PodcastEpisodeList)));
   connect(backend_, SIGNAL(SubscriptionAdded(Podcast)),
@@ -125,6 +243,14 @@ PodcastDownloader::PodcastDownloader(Application* app, QObject* parent)
   connect(app_, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
 
   ReloadSettings();
+
+  // Pick up any downloads that were interrupted when we last quit.
+  QTimer::singleShot(0, this, SLOT(ResumePendingDownloads()));
+}
+
+PodcastDownloader::~PodcastDownloader() {
+  // Partial files are left behind so the downloads can be resumed next time.
+  qDeleteAll(list_tasks_);
 }
 
 QString PodcastDownloader::DefaultDownloadDir() const {
@@ -145,6 +271,34 @@ void PodcastDownloader::ReloadSettings() {
 
   auto_download_ = s.value("auto_download", false).toBool();
   download_dir_ = s.value("download_dir", DefaultDownloadDir()).toString();
+  downloads_per_host_ = qMax(
+      1, s.value("downloads_per_host", kDefaultDownloadsPerHost).toInt());
+  max_download_rate_ = s.value("max_download_rate", 0).toInt();
+  max_episode_download_rate_ = s.value("max_episode_download_rate", 0).toInt();
+
+  for (Task* task : list_tasks_) {
+    task->SetThrottled(is_throttled());
+  }
+  StartQueuedTasks();
+}
+
+void PodcastDownloader::ResumePendingDownloads() {
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  const QVariantList pending = s.value("pending_downloads").toList();
+  const QVariantList manual = s.value("pending_manual_downloads").toList();
+  s.endGroup();
+
+  for (const QVariant& id : pending) {
+    const PodcastEpisode episode = backend_->GetEpisodeById(id.toInt());
+    if (episode.is_valid() && !episode.downloaded()) {
+      QueueEpisode(episode, manual.contains(id));
+    }
+  }
+}
+
+bool PodcastDownloader::is_throttled() const {
+  return max_download_rate_ > 0 || max_episode_download_rate_ > 0;
 }
 
 QString PodcastDownloader::FilenameForEpisode(const QString& directory,
@@ -170,7 +324,11 @@ QString PodcastDownloader::FilenameForEpisode(const QString& directory,
           directory, base_filename, QString::number(count), file_extension);
     }
 
-    if (!QFile::exists(filename)) {
+    bool in_use = QFile::exists(filename);
+    for (Task* task : list_tasks_) {
+      if (task->filename() == filename) in_use = true;
+    }
+    if (!in_use) {
       return filename;
     }
 
@@ -179,10 +337,32 @@ QString PodcastDownloader::FilenameForEpisode(const QString& directory,
 }
 
 void PodcastDownloader::DownloadEpisode(const PodcastEpisode& episode) {
-  for (Task* tas : list_tasks_) {
-    if (tas->episode().database_id() == episode.database_id()) {
-      return;
+  QueueEpisode(episode, true);
+}
+
+void PodcastDownloader::QueueEpisode(const PodcastEpisode& episode,
+                                     bool manual) {
+  Task* existing = nullptr;
+  for (Task* task : list_tasks_) {
+    if (task->episode().database_id() == episode.database_id()) {
+      existing = task;
+      break;
+    }
+  }
+
+  if (existing) {
+    // Asking for an episode that was queued automatically moves it up the
+    // queue.
+    if (manual && !existing->manual()) {
+      existing->set_manual(true);
+      if (!existing->is_started()) {
+        list_tasks_.removeAll(existing);
+        EnqueueTask(existing);
+        StartQueuedTasks();
+      }
+      SavePendingDownloads();
     }
+    return;
   }
 
   Podcast podcast =
@@ -195,29 +375,114 @@ void PodcastDownloader::DownloadEpisode(const PodcastEpisode& episode) {
   const QString directory =
       download_dir_ + "/" + SanitiseFilenameComponent(podcast.title());
   const QString filepath = FilenameForEpisode(directory, episode);
-
-  // Open the output file
   QDir().mkpath(directory);
-  QFile* file = new QFile(filepath);
-  if (!file->open(QIODevice::WriteOnly)) {
-    qLog(Warning) << "Could not open the file" << filepath << "for writing";
-    return;
-  }
 
-  Task* task = new Task(episode, file, backend_);
-
-  list_tasks_ << task;
-  qLog(Info) << "Downloading" << task->episode().url() << "to" << filepath;
+  Task* task = new Task(episode, filepath, manual, backend_, network_);
   connect(task, SIGNAL(finished(Task*)), SLOT(ReplyFinished(Task*)));
   connect(task, SIGNAL(ProgressChanged(const PodcastEpisode&,
                                        PodcastDownload::State, int)),
           SIGNAL(ProgressChanged(const PodcastEpisode&,
                                  PodcastDownload::State, int)));
+
+  EnqueueTask(task);
+  emit ProgressChanged(episode, PodcastDownload::Queued, 0);
+
+  SavePendingDownloads();
+  StartQueuedTasks();
+}
+
+void PodcastDownloader::EnqueueTask(Task* task) {
+  int index = list_tasks_.count();
+  if (task->manual()) {
+    for (int i = 0; i < list_tasks_.count(); ++i) {
+      if (!list_tasks_[i]->is_started() && !list_tasks_[i]->manual()) {
+        index = i;
+        break;
+      }
+    }
+  }
+  list_tasks_.insert(index, task);
+}
+
+void PodcastDownloader::StartQueuedTasks() {
+  QMap<QString, int> started_per_host;
+  for (Task* task : list_tasks_) {
+    if (task->is_started()) started_per_host[task->host()]++;
+  }
+
+  for (Task* task : QList<Task*>(list_tasks_)) {
+    if (task->is_started() ||
+        started_per_host[task->host()] >= downloads_per_host_) {
+      continue;
+    }
+
+    task->SetThrottled(is_throttled());
+    if (!task->Start()) {
+      qLog(Warning) << "Could not open the file" << task->partial_filename()
+                    << "for writing";
+      emit ProgressChanged(task->episode(), PodcastDownload::NotDownloading, 0);
+      list_tasks_.removeAll(task);
+      task->deleteLater();
+      continue;
+    }
+
+    started_per_host[task->host()]++;
+    qLog(Info) << "Downloading" << task->episode().url() << "to"
+               << task->filename();
+  }
+
+  if (is_throttled() && !started_per_host.isEmpty()) {
+    if (!throttle_timer_->isActive()) throttle_timer_->start();
+  } else {
+    throttle_timer_->stop();
+  }
+}
+
+void PodcastDownloader::Throttle() {
+  QList<Task*> started;
+  for (Task* task : list_tasks_) {
+    if (task->is_started()) started << task;
+  }
+
+  const qint64 kUnlimited = std::numeric_limits<qint64>::max();
+  const qint64 episode_budget =
+      max_episode_download_rate_ > 0
+          ? qint64(max_episode_download_rate_) * 1024 * kThrottleIntervalMsec /
+                1000
+          : kUnlimited;
+  qint64 total_budget =
+      max_download_rate_ > 0
+          ? qint64(max_download_rate_) * 1024 * kThrottleIntervalMsec / 1000
+          : kUnlimited;
+
+  // Share the total equally, letting later downloads use whatever the earlier
+  // ones didn't need.
+  for (int i = 0; i < started.count(); ++i) {
+    const qint64 share = total_budget / (started.count() - i);
+    total_budget -= started[i]->Read(qMin(share, episode_budget));
+  }
+}
+
+void PodcastDownloader::SavePendingDownloads() const {
+  QVariantList pending;
+  QVariantList manual;
+  for (Task* task : list_tasks_) {
+    pending << task->episode().database_id();
+    if (task->manual()) manual << task->episode().database_id();
+  }
+
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  s.setValue("pending_downloads", pending);
+  s.setValue("pending_manual_downloads", manual);
 }
 
 void PodcastDownloader::ReplyFinished(Task* task) {
   list_tasks_.removeAll(task);
-  delete task;
+  task->deleteLater();
+
+  SavePendingDownloads();
+  StartQueuedTasks();
 }
 
 QString PodcastDownloader::SanitiseFilenameComponent(const QString& text)
@@ -234,7 +499,7 @@ void PodcastDownloader::SubscriptionAdded(const Podcast& podcast) {
 void PodcastDownloader::EpisodesAdded(const PodcastEpisodeList& episodes) {
   if (auto_download_) {
     for (const PodcastEpisode& episode : episodes) {
-      DownloadEpisode(episode);
+      QueueEpisode(episode, false);
     }
   }
 }
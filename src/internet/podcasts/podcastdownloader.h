@@ -42,6 +42,8 @@ class Application;
 class PodcastBackend;
 
 class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
 
 namespace PodcastDownload {
   enum State { NotDownloading, Queued, Downloading, Finished };
@@ -51,8 +53,39 @@ class Task : public QObject {
   Q_OBJECT
 
  public:
-  Task(PodcastEpisode episode, QFile* file, PodcastBackend* backend);
+  // The episode is downloaded to a partial file in the same directory as
+  // filename, which is renamed once the download completes.  If a partial file
+  // is already there from an earlier attempt the download resumes from the end
+  // of it.
+  Task(PodcastEpisode episode, const QString& filename, bool manual,
+       PodcastBackend* backend, QNetworkAccessManager* network);
+
+  static const char* kPartialSuffix;
+  static const int kMaxRetries;
+  static const int kRetryDelayMsec;
+  static const int kThrottledBufferSize;
+
   PodcastEpisode episode() const;
+  QString filename() const { return filename_; }
+  QString partial_filename() const { return file_->fileName(); }
+  QString host() const { return episode_.url().host(); }
+
+  // Manually requested downloads are started before automatic ones.
+  bool manual() const { return manual_; }
+  void set_manual(bool manual) { manual_ = manual; }
+
+  // True from Start() until the task finishes, including while it is waiting
+  // to retry after an error.
+  bool is_started() const { return started_; }
+
+  // Returns false if the partial file couldn't be opened.
+  bool Start();
+
+  // When throttled the task only writes data when Read() is called, and the
+  // reply's buffer is kept small so the connection stalls rather than
+  // buffering the whole file in memory.
+  void SetThrottled(bool throttled);
+  qint64 Read(qint64 max_bytes);
 
  signals:
   void ProgressChanged(const PodcastEpisode& episode,
@@ -64,16 +97,30 @@ class Task : public QObject {
 
  private slots:
   void reading();
+  void metaDataChangedInternal();
   void downloadProgressInternal(qint64 received, qint64 total);
   void finishedInternal();
+  void Retry();
+
+ private:
+  void Abort();
 
  private:
+  QString filename_;
   std::unique_ptr<QFile> file_;
   PodcastEpisode episode_;
-  QNetworkRequest req_;
+  bool manual_;
   PodcastBackend* backend_;
-  std::unique_ptr<NetworkAccessManager> network_;
-  std::unique_ptr<RedirectFollower> repl;
+  QNetworkAccessManager* network_;
+  QNetworkReply* reply_;
+
+  bool started_;
+  bool throttled_;
+  int retries_;
+
+  // The number of bytes that were already in the partial file when the
+  // current request was made.
+  qint64 resume_offset_;
 };
 
 class PodcastDownloader : public QObject {
@@ -81,13 +128,17 @@ class PodcastDownloader : public QObject {
 
  public:
   explicit PodcastDownloader(Application* app, QObject* parent = nullptr);
+  ~PodcastDownloader();
 
   static const char* kSettingsGroup;
+  static const int kDefaultDownloadsPerHost;
+  static const int kThrottleIntervalMsec;
+
   PodcastEpisodeList EpisodesDownloading(const PodcastEpisodeList& episodes);
   QString DefaultDownloadDir() const;
 
  public slots:
-  // Adds the episode to the download queue
+  // Adds the episode to the download queue, ahead of any automatic downloads
   void DownloadEpisode(const PodcastEpisode& episode);
   void cancelDownload(const PodcastEpisodeList& episodes);
 
@@ -97,13 +148,21 @@ class PodcastDownloader : public QObject {
 
  private slots:
   void ReloadSettings();
+  void ResumePendingDownloads();
 
   void SubscriptionAdded(const Podcast& podcast);
   void EpisodesAdded(const PodcastEpisodeList& episodes);
 
   void ReplyFinished(Task* task);
+  void Throttle();
 
  private:
+  void QueueEpisode(const PodcastEpisode& episode, bool manual);
+  void EnqueueTask(Task* task);
+  void StartQueuedTasks();
+  void SavePendingDownloads() const;
+  bool is_throttled() const;
+
   QString FilenameForEpisode(const QString& directory,
                              const PodcastEpisode& episode) const;
   QString SanitiseFilenameComponent(const QString& text) const;
@@ -117,7 +176,15 @@ class PodcastDownloader : public QObject {
 
   bool auto_download_;
   QString download_dir_;
+  int downloads_per_host_;
+
+  // Bandwidth limits in KB/s, or 0 for unlimited.
+  int max_download_rate_;
+  int max_episode_download_rate_;
+  QTimer* throttle_timer_;
 
+  // Manually requested episodes are kept ahead of automatic ones that haven't
+  // started yet.
   QList<Task*> list_tasks_;
 };
 
@@ -23,13 +23,13 @@
 #include <QMap>
 #include <QMenu>
 #include <QSortFilterProxyModel>
-#include <QtConcurrentRun>
 
 #include "addpodcastdialog.h"
 #include "podcastinfodialog.h"
 #include "core/application.h"
 #include "core/logging.h"
 #include "core/mergedproxymodel.h"
+#include "core/taskexecutor.h"
 #include "devices/devicemanager.h"
 #include "devices/devicestatefiltermodel.h"
 #include "devices/deviceview.h"
@@ -748,8 +748,10 @@ void PodcastService::ShowConfig() {
 void PodcastService::CurrentSongChanged(const Song& metadata) {
   // This does two db queries, and we are called on every song change, so run
   // this off the main thread.
-  QtConcurrent::run(this, &PodcastService::UpdatePodcastListenedStateAsync,
-                    metadata);
+  TaskExecutor::Instance()->Run<void>(
+      TaskExecutor::Lane_Background,
+      std::bind(&PodcastService::UpdatePodcastListenedStateAsync, this,
+                metadata));
 }
 
 void PodcastService::UpdatePodcastListenedStateAsync(const Song& metadata) {
@@ -81,6 +81,12 @@ void PodcastSettingsPage::Load() {
       s.value("download_dir", default_download_dir).toString()));
 
   ui_->auto_download->setChecked(s.value("auto_download", false).toBool());
+  ui_->downloads_per_host->setValue(
+      s.value("downloads_per_host", PodcastDownloader::kDefaultDownloadsPerHost)
+          .toInt());
+  ui_->max_download_rate->setValue(s.value("max_download_rate", 0).toInt());
+  ui_->max_episode_download_rate->setValue(
+      s.value("max_episode_download_rate", 0).toInt());
   ui_->hide_listened->setChecked(s.value("hide_listened", false).toBool());
   ui_->delete_after->setValue(s.value("delete_after", 0).toInt() / kSecsPerDay);
   ui_->show_episodes->setValue(s.value("show_episodes", 0).toInt());
@@ -106,6 +112,10 @@ void PodcastSettingsPage::Save() {
   s.setValue("download_dir",
              QDir::fromNativeSeparators(ui_->download_dir->text()));
   s.setValue("auto_download", ui_->auto_download->isChecked());
+  s.setValue("downloads_per_host", ui_->downloads_per_host->value());
+  s.setValue("max_download_rate", ui_->max_download_rate->value());
+  s.setValue("max_episode_download_rate",
+             ui_->max_episode_download_rate->value());
   s.setValue("hide_listened", ui_->hide_listened->isChecked());
   s.setValue("delete_after", ui_->delete_after->value() * kSecsPerDay);
   s.setValue("show_episodes", ui_->show_episodes->value());
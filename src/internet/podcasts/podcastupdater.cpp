@@ -30,6 +30,7 @@
 #include "podcasturlloader.h"
 
 const char* PodcastUpdater::kSettingsGroup = "Podcasts";
+const int PodcastUpdater::kMaxConcurrentUpdates = 4;
 
 PodcastUpdater::PodcastUpdater(Application* app, QObject* parent)
     : QObject(parent),
@@ -37,6 +38,7 @@ PodcastUpdater::PodcastUpdater(Application* app, QObject* parent)
       update_interval_secs_(0),
       update_timer_(new QTimer(this)),
       loader_(new PodcastUrlLoader(this)),
+      active_updates_(0),
       pending_replies_(0) {
   connect(app_, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
   connect(update_timer_, SIGNAL(timeout()), SLOT(UpdateAllPodcastsNow()));
@@ -107,7 +109,7 @@ void PodcastUpdater::SubscriptionAdded(const Podcast& podcast) {
 }
 
 void PodcastUpdater::UpdatePodcastNow(const Podcast& podcast) {
-  PodcastUrlLoaderReply* reply = loader_->Load(podcast.url());
+  PodcastUrlLoaderReply* reply = loader_->LoadIfModified(podcast);
   NewClosure(reply, SIGNAL(Finished(bool)), this,
              SLOT(PodcastLoaded(PodcastUrlLoaderReply*, Podcast, bool)), reply,
              podcast, false);
@@ -116,12 +118,24 @@ void PodcastUpdater::UpdatePodcastNow(const Podcast& podcast) {
 void PodcastUpdater::UpdateAllPodcastsNow() {
   for (const Podcast& podcast :
        app_->podcast_backend()->GetAllSubscriptions()) {
-    PodcastUrlLoaderReply* reply = loader_->Load(podcast.url());
+    queued_updates_.enqueue(podcast);
+    pending_replies_++;
+  }
+
+  StartQueuedUpdates();
+}
+
+void PodcastUpdater::StartQueuedUpdates() {
+  while (active_updates_ < kMaxConcurrentUpdates &&
+         !queued_updates_.isEmpty()) {
+    const Podcast podcast = queued_updates_.dequeue();
+
+    PodcastUrlLoaderReply* reply = loader_->LoadIfModified(podcast);
     NewClosure(reply, SIGNAL(Finished(bool)), this,
                SLOT(PodcastLoaded(PodcastUrlLoaderReply*, Podcast, bool)),
                reply, podcast, true);
 
-    pending_replies_++;
+    active_updates_++;
   }
 }
 
@@ -130,6 +144,9 @@ void PodcastUpdater::PodcastLoaded(PodcastUrlLoaderReply* reply,
   reply->deleteLater();
 
   if (one_of_many) {
+    active_updates_--;
+    StartQueuedUpdates();
+
     if (--pending_replies_ == 0) {
       // This was the last reply we were waiting for.  Save this time as being
       // the last successful update and restart the timer.
@@ -145,32 +162,32 @@ void PodcastUpdater::PodcastLoaded(PodcastUrlLoaderReply* reply,
     return;
   }
 
+  if (reply->result_type() == PodcastUrlLoaderReply::Type_NotModified) {
+    qLog(Debug) << "Podcast" << podcast.url() << "hasn't changed";
+    return;
+  }
+
   if (reply->result_type() != PodcastUrlLoaderReply::Type_Podcast) {
     qLog(Warning) << "The URL" << podcast.url()
                   << "no longer contains a podcast";
     return;
   }
 
-  // Get the episode URLs we had for this podcast already.
-  QSet<QUrl> existing_urls;
-  for (const PodcastEpisode& episode :
-       app_->podcast_backend()->GetEpisodes(podcast.database_id())) {
-    existing_urls.insert(episode.url());
-  }
-
   // Add any new episodes
-  PodcastEpisodeList new_episodes;
+  PodcastEpisodeList episodes;
   for (const Podcast& reply_podcast : reply->podcast_results()) {
-    for (const PodcastEpisode& episode : reply_podcast.episodes()) {
-      if (!existing_urls.contains(episode.url())) {
-        PodcastEpisode episode_copy(episode);
-        episode_copy.set_podcast_database_id(podcast.database_id());
-        new_episodes.append(episode_copy);
-      }
-    }
+    episodes << reply_podcast.episodes();
   }
 
-  app_->podcast_backend()->AddEpisodes(&new_episodes);
+  const PodcastEpisodeList new_episodes =
+      app_->podcast_backend()->AddNewEpisodes(podcast.database_id(), episodes);
   qLog(Info) << "Added" << new_episodes.count() << "new episodes for"
              << podcast.url();
+
+  // Remember the validators so the next update can be a conditional request.
+  Podcast fetched(podcast);
+  fetched.set_last_updated(QDateTime::currentDateTime());
+  fetched.set_etag(reply->etag());
+  fetched.set_last_modified(reply->last_modified());
+  app_->podcast_backend()->UpdateSubscriptionFetchState(fetched);
 }
@@ -22,9 +22,11 @@
 
 #include <QDateTime>
 #include <QObject>
+#include <QQueue>
+
+#include "podcast.h"
 
 class Application;
-class Podcast;
 class PodcastUrlLoader;
 class PodcastUrlLoaderReply;
 
@@ -39,6 +41,7 @@ class PodcastUpdater : public QObject {
   explicit PodcastUpdater(Application* app, QObject* parent = nullptr);
 
   static const char* kSettingsGroup;
+  static const int kMaxConcurrentUpdates;
 
  public slots:
   void UpdateAllPodcastsNow();
@@ -54,6 +57,7 @@ class PodcastUpdater : public QObject {
  private:
   void RestartTimer();
   void SaveSettings();
+  void StartQueuedUpdates();
 
  private:
   Application* app_;
@@ -63,6 +67,11 @@ class PodcastUpdater : public QObject {
 
   QTimer* update_timer_;
   PodcastUrlLoader* loader_;
+
+  // Podcasts from UpdateAllPodcastsNow that are waiting for a free slot, and
+  // the number of those requests still outstanding including the queued ones.
+  QQueue<Podcast> queued_updates_;
+  int active_updates_;
   int pending_replies_;
 };
 
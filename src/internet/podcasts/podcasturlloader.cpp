@@ -32,7 +32,7 @@ const int PodcastUrlLoader::kMaxRedirects = 5;
 
 PodcastUrlLoader::PodcastUrlLoader(QObject* parent)
     : QObject(parent),
-      network_(new NetworkAccessManager(this)),
+      network_(NetworkAccessManager::Shared()),
       parser_(new PodcastParser),
       html_link_re_("<link (.*)>"),
       html_link_rel_re_("rel\\s*=\\s*['\"]?\\s*alternate"),
@@ -93,11 +93,26 @@ PodcastUrlLoaderReply* PodcastUrlLoader::Load(const QString& url_text) {
 }
 
 PodcastUrlLoaderReply* PodcastUrlLoader::Load(const QUrl& url) {
+  RequestState* state = new RequestState;
+  state->priority_ = NetworkAccessManager::kInteractivePriority;
+  return Load(url, state);
+}
+
+PodcastUrlLoaderReply* PodcastUrlLoader::LoadIfModified(
+    const Podcast& podcast) {
+  RequestState* state = new RequestState;
+  state->etag_ = podcast.etag();
+  state->last_modified_ = podcast.last_modified();
+  state->priority_ = NetworkAccessManager::kBackgroundPriority;
+  return Load(podcast.url(), state);
+}
+
+PodcastUrlLoaderReply* PodcastUrlLoader::Load(const QUrl& url,
+                                              RequestState* state) {
   // Create a reply
   PodcastUrlLoaderReply* reply = new PodcastUrlLoaderReply(url, this);
 
-  // Create a state object to track this request
-  RequestState* state = new RequestState;
+  // Set up the state object to track this request
   state->redirects_remaining_ = kMaxRedirects + 1;
   state->reply_ = reply;
 
@@ -125,6 +140,13 @@ void PodcastUrlLoader::NextRequest(const QUrl& url, RequestState* state) {
   QNetworkRequest req(url);
   req.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
                    QNetworkRequest::AlwaysNetwork);
+  req.setPriority(state->priority_);
+  if (!state->etag_.isEmpty()) {
+    req.setRawHeader("If-None-Match", state->etag_.toLatin1());
+  }
+  if (!state->last_modified_.isEmpty()) {
+    req.setRawHeader("If-Modified-Since", state->last_modified_.toLatin1());
+  }
   QNetworkReply* network_reply = network_->get(req);
 
   NewClosure(network_reply, SIGNAL(finished()), this,
@@ -152,6 +174,11 @@ void PodcastUrlLoader::RequestFinished(RequestState* state,
 
   const QVariant http_status =
       reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+  if (http_status.isValid() && http_status.toInt() == 304) {
+    state->reply_->SetNotModified();
+    delete state;
+    return;
+  }
   if (http_status.isValid() && http_status.toInt() != 200) {
     SendErrorAndDelete(
         QString("HTTP %1: %2")
@@ -169,6 +196,10 @@ void PodcastUrlLoader::RequestFinished(RequestState* state,
   if (parser_->SupportsContentType(content_type)) {
     const QVariant ret = parser_->Load(reply, reply->url());
 
+    state->reply_->SetCacheHeaders(
+        QString::fromLatin1(reply->rawHeader("ETag")),
+        QString::fromLatin1(reply->rawHeader("Last-Modified")));
+
     if (ret.canConvert<Podcast>()) {
       state->reply_->SetFinished(PodcastList() << ret.value<Podcast>());
     } else if (ret.canConvert<OpmlContainer>()) {
@@ -228,6 +259,18 @@ void PodcastUrlLoaderReply::SetFinished(const OpmlContainer& results) {
   emit Finished(true);
 }
 
+void PodcastUrlLoaderReply::SetNotModified() {
+  result_type_ = Type_NotModified;
+  finished_ = true;
+  emit Finished(true);
+}
+
+void PodcastUrlLoaderReply::SetCacheHeaders(const QString& etag,
+                                            const QString& last_modified) {
+  etag_ = etag;
+  last_modified_ = last_modified;
+}
+
 void PodcastUrlLoaderReply::SetFinished(const QString& error_text) {
   error_text_ = error_text;
   finished_ = true;
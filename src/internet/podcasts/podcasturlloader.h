@@ -20,6 +20,7 @@
 #ifndef INTERNET_PODCASTS_PODCASTURLLOADER_H_
 #define INTERNET_PODCASTS_PODCASTURLLOADER_H_
 
+#include <QNetworkRequest>
 #include <QObject>
 #include <QRegExp>
 
@@ -37,7 +38,9 @@ class PodcastUrlLoaderReply : public QObject {
  public:
   PodcastUrlLoaderReply(const QUrl& url, QObject* parent);
 
-  enum ResultType { Type_Podcast, Type_Opml };
+  // Type_NotModified is only returned by LoadIfModified, when the server says
+  // the feed hasn't changed.
+  enum ResultType { Type_Podcast, Type_Opml, Type_NotModified };
 
   const QUrl& url() const { return url_; }
   bool is_finished() const { return finished_; }
@@ -48,9 +51,15 @@ class PodcastUrlLoaderReply : public QObject {
   const PodcastList& podcast_results() const { return podcast_results_; }
   const OpmlContainer& opml_results() const { return opml_results_; }
 
+  // The ETag and Last-Modified headers of the response, if it had any.
+  const QString& etag() const { return etag_; }
+  const QString& last_modified() const { return last_modified_; }
+  void SetCacheHeaders(const QString& etag, const QString& last_modified);
+
   void SetFinished(const QString& error_text);
   void SetFinished(const PodcastList& results);
   void SetFinished(const OpmlContainer& results);
+  void SetNotModified();
 
  signals:
   void Finished(bool success);
@@ -63,6 +72,9 @@ class PodcastUrlLoaderReply : public QObject {
   ResultType result_type_;
   PodcastList podcast_results_;
   OpmlContainer opml_results_;
+
+  QString etag_;
+  QString last_modified_;
 };
 
 class PodcastUrlLoader : public QObject {
@@ -77,6 +89,10 @@ class PodcastUrlLoader : public QObject {
   PodcastUrlLoaderReply* Load(const QString& url_text);
   PodcastUrlLoaderReply* Load(const QUrl& url);
 
+  // Loads the podcast's feed in the background with a conditional request
+  // using the ETag and Last-Modified values stored from the last fetch.
+  PodcastUrlLoaderReply* LoadIfModified(const Podcast& podcast);
+
   // Both the FixPodcastUrl functions replace common podcatcher URL schemes
   // like itpc:// or zune:// with their http:// equivalents.  The QString
   // overload also cleans up user-entered text a bit - stripping whitespace and
@@ -88,6 +104,9 @@ class PodcastUrlLoader : public QObject {
   struct RequestState {
     int redirects_remaining_;
     PodcastUrlLoaderReply* reply_;
+    QString etag_;
+    QString last_modified_;
+    QNetworkRequest::Priority priority_;
   };
 
   typedef QPair<QString, QString> QuickPrefix;
@@ -99,6 +118,7 @@ class PodcastUrlLoader : public QObject {
  private:
   void SendErrorAndDelete(const QString& error_text, RequestState* state);
   void NextRequest(const QUrl& url, RequestState* state);
+  PodcastUrlLoaderReply* Load(const QUrl& url, RequestState* state);
 
  private:
   QNetworkAccessManager* network_;
@@ -30,6 +30,7 @@
 #include "core/player.h"
 #include "core/waitforsignal.h"
 #include "internet/core/oauthenticator.h"
+#include "internet/core/oauthtokenrefresher.h"
 #include "internet/skydrive/skydriveurlhandler.h"
 #include "ui/iconloader.h"
 
@@ -57,7 +58,11 @@ const char* SkydriveService::kSettingsGroup = "Skydrive";
 SkydriveService::SkydriveService(Application* app, InternetModel* parent)
     : CloudFileService(app, parent, kServiceName, kServiceId,
                        IconLoader::Load("skydrive", IconLoader::Provider),
-                       SettingsDialog::Page_Skydrive) {
+                       SettingsDialog::Page_Skydrive),
+      token_refresher_(new OAuthTokenRefresher(kClientId, kClientSecret,
+                                               kOAuthTokenEndpoint, this)) {
+  connect(token_refresher_, SIGNAL(Refreshed(QString, QDateTime, QString)),
+          SLOT(TokenRefreshed(QString, QDateTime, QString)));
   app->player()->RegisterUrlHandler(new SkydriveUrlHandler(this, this));
 }
 
@@ -94,6 +99,7 @@ void SkydriveService::ConnectFinished(OAuthenticator* oauth) {
 
   access_token_ = oauth->access_token();
   expiry_time_ = oauth->expiry_time();
+  token_refresher_->Watch(oauth->refresh_token(), expiry_time_);
 
   QUrl url(kLiveUserInfo);
   QNetworkRequest request(url);
@@ -104,6 +110,17 @@ void SkydriveService::ConnectFinished(OAuthenticator* oauth) {
              SLOT(FetchUserInfoFinished(QNetworkReply*)), reply);
 }
 
+void SkydriveService::TokenRefreshed(const QString& access_token,
+                                     const QDateTime& expiry_time,
+                                     const QString& refresh_token) {
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  s.setValue("refresh_token", refresh_token);
+
+  access_token_ = access_token;
+  expiry_time_ = expiry_time;
+}
+
 void SkydriveService::AddAuthorizationHeader(QNetworkRequest* request) {
   request->setRawHeader("Authorization",
                         QString("Bearer %1").arg(access_token_).toUtf8());
@@ -190,6 +207,8 @@ void SkydriveService::EnsureConnected() {
 }
 
 void SkydriveService::ForgetCredentials() {
+  token_refresher_->Stop();
+
   QSettings s;
   s.beginGroup(kSettingsGroup);
 
@@ -25,6 +25,7 @@
 #include <QDateTime>
 
 class OAuthenticator;
+class OAuthTokenRefresher;
 class QNetworkRequest;
 class QNetworkReply;
 
@@ -46,6 +47,9 @@ class SkydriveService : public CloudFileService {
 
  private slots:
   void ConnectFinished(OAuthenticator* oauth);
+  void TokenRefreshed(const QString& access_token,
+                      const QDateTime& expiry_time,
+                      const QString& refresh_token);
   void FetchUserInfoFinished(QNetworkReply* reply);
   void ListFilesFinished(QNetworkReply* reply);
 
@@ -58,6 +62,8 @@ class SkydriveService : public CloudFileService {
   void ListFiles(const QString& folder);
   void EnsureConnected();
 
+  OAuthTokenRefresher* token_refresher_;
+
   QString access_token_;
   QDateTime expiry_time_;
 };
@@ -20,12 +20,18 @@
 
 #include "skydriveservice.h"
 
+const qint64 SkydriveUrlHandler::kMediaUrlMaxAgeMsec = 45 * 60 * 1000;
+
 SkydriveUrlHandler::SkydriveUrlHandler(SkydriveService* service,
                                        QObject* parent)
     : UrlHandler(parent), service_(service) {}
 
 UrlHandler::LoadResult SkydriveUrlHandler::StartLoading(const QUrl& url) {
-  QString file_id(url.path());
-  QUrl real_url = service_->GetStreamingUrlFromSongId(file_id);
+  QUrl real_url = CachedMediaUrl(url);
+  if (real_url.isEmpty()) {
+    QString file_id(url.path());
+    real_url = service_->GetStreamingUrlFromSongId(file_id);
+    CacheMediaUrl(url, real_url, kMediaUrlMaxAgeMsec);
+  }
   return LoadResult(url, LoadResult::TrackAvailable, real_url);
 }
@@ -33,8 +33,12 @@ class SkydriveUrlHandler : public UrlHandler {
   QString scheme() const { return "skydrive"; }
   QIcon icon() const { return IconLoader::Load("skydrive", IconLoader::Provider); }
   LoadResult StartLoading(const QUrl& url);
+  bool CanResolveEarly() const { return true; }
 
  private:
+  // OneDrive's download urls last about an hour.
+  static const qint64 kMediaUrlMaxAgeMsec;
+
   SkydriveService* service_;
 };
 
@@ -29,6 +29,7 @@
 #include "somafmservice.h"
 #include "core/application.h"
 #include "core/logging.h"
+#include "core/network.h"
 #include "core/taskmanager.h"
 #include "playlistparsers/playlistparser.h"
 
@@ -45,8 +46,9 @@ UrlHandler::LoadResult SomaFMUrlHandler::StartLoading(const QUrl& url) {
   playlist_url.setScheme("http");
 
   // Load the playlist
-  QNetworkReply* reply =
-      service_->network()->get(QNetworkRequest(playlist_url));
+  QNetworkRequest request(playlist_url);
+  request.setPriority(NetworkAccessManager::kPlaybackPriority);
+  QNetworkReply* reply = service_->network()->get(request);
   connect(reply, SIGNAL(finished()), SLOT(LoadPlaylistFinished()));
 
   if (!task_id_)
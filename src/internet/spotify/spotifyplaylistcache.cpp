@@ -0,0 +1,118 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spotifyplaylistcache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+#include "core/logging.h"
+#include "core/utilities.h"
+
+const quint32 SpotifyPlaylistCache::kMagic = 0x53504c43;  // "SPLC"
+const quint32 SpotifyPlaylistCache::kVersion = 1;
+
+namespace {
+
+QString HashKey(const QString& key) {
+  return QString::fromLatin1(
+      QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1)
+          .toHex());
+}
+
+}  // namespace
+
+SpotifyPlaylistCache::SpotifyPlaylistCache() {}
+
+void SpotifyPlaylistCache::SetUsername(const QString& username) {
+  if (username.isEmpty()) {
+    dir_.clear();
+    return;
+  }
+
+  dir_ = Utilities::GetConfigPath(Utilities::Path_CacheRoot) +
+         "/spotifyplaylists/" + HashKey(username);
+}
+
+QString SpotifyPlaylistCache::Filename(const QString& key) const {
+  return dir_ + "/" + HashKey(key) + ".dat";
+}
+
+bool SpotifyPlaylistCache::Read(const QString& key, QString* revision,
+                                QByteArray* data) const {
+  if (dir_.isEmpty()) return false;
+
+  QFile file(Filename(key));
+  if (!file.open(QIODevice::ReadOnly)) return false;
+
+  QDataStream s(&file);
+  s.setVersion(QDataStream::Qt_5_0);
+
+  quint32 magic = 0;
+  quint32 version = 0;
+  s >> magic >> version;
+  if (magic != kMagic || version != kVersion) return false;
+
+  s >> *revision >> *data;
+  return s.status() == QDataStream::Ok;
+}
+
+bool SpotifyPlaylistCache::Load(
+    const QString& key, const QString& revision,
+    pb::spotify::LoadPlaylistResponse* response) const {
+  QString cached_revision;
+  QByteArray data;
+  if (!Read(key, &cached_revision, &data)) return false;
+  if (cached_revision != revision) return false;
+
+  return response->ParseFromArray(data.constData(), data.size());
+}
+
+bool SpotifyPlaylistCache::Save(
+    const QString& key, const QString& revision,
+    const pb::spotify::LoadPlaylistResponse& response) {
+  if (dir_.isEmpty()) return true;
+
+  std::string serialised;
+  response.SerializeToString(&serialised);
+  const QByteArray data(serialised.data(), serialised.size());
+
+  QString cached_revision;
+  QByteArray cached_data;
+  if (Read(key, &cached_revision, &cached_data) &&
+      cached_revision == revision && cached_data == data) {
+    return false;
+  }
+
+  QDir().mkpath(dir_);
+  QSaveFile file(Filename(key));
+  if (!file.open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Couldn't write Spotify playlist cache"
+                  << file.fileName();
+    return true;
+  }
+
+  QDataStream s(&file);
+  s.setVersion(QDataStream::Qt_5_0);
+  s << kMagic << kVersion << revision << data;
+  if (s.status() == QDataStream::Ok) {
+    file.commit();
+  }
+  return true;
+}
@@ -0,0 +1,54 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INTERNET_SPOTIFY_SPOTIFYPLAYLISTCACHE_H_
+#define INTERNET_SPOTIFY_SPOTIFYPLAYLISTCACHE_H_
+
+#include <QString>
+
+#include "spotifymessages.pb.h"
+
+// Keeps a copy of each Spotify playlist on disk, so the internet tree can be
+// filled straight away after logging in while the blob loads the real thing.
+// Each playlist is stored with a revision string, and a cached copy is only
+// used if the blob still reports the same revision.
+class SpotifyPlaylistCache {
+ public:
+  SpotifyPlaylistCache();
+
+  // Playlists are kept separately for each account.
+  void SetUsername(const QString& username);
+
+  // Returns false if the playlist isn't cached or if it was cached under a
+  // different revision.
+  bool Load(const QString& key, const QString& revision,
+            pb::spotify::LoadPlaylistResponse* response) const;
+
+  // Returns false if the cached copy was already the same.
+  bool Save(const QString& key, const QString& revision,
+            const pb::spotify::LoadPlaylistResponse& response);
+
+ private:
+  static const quint32 kMagic;
+  static const quint32 kVersion;
+
+  QString Filename(const QString& key) const;
+  bool Read(const QString& key, QString* revision, QByteArray* data) const;
+
+  QString dir_;
+};
+
+#endif  // INTERNET_SPOTIFY_SPOTIFYPLAYLISTCACHE_H_
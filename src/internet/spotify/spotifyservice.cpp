@@ -142,16 +142,19 @@ void SpotifyService::LazyPopulate(QStandardItem* item) {
 
     case Type_InboxPlaylist:
       EnsureServerCreated();
+      FillPlaylistFromCache(item);
       server_->LoadInbox();
       break;
 
     case Type_StarredPlaylist:
       EnsureServerCreated();
+      FillPlaylistFromCache(item);
       server_->LoadStarred();
       break;
 
     case InternetModel::Type_UserPlaylist:
       EnsureServerCreated();
+      FillPlaylistFromCache(item);
       server_->LoadUserPlaylist(item->data(Role_UserPlaylistIndex).toInt());
       break;
 
@@ -306,6 +309,8 @@ void SpotifyService::EnsureServerCreated(const QString& username,
     login_password = QString();
   }
 
+  playlist_cache_.SetUsername(login_username);
+
   server_->Login(login_username, login_password, bitrate_,
                  volume_normalisation_);
 
@@ -442,10 +447,8 @@ void SpotifyService::PlaylistsUpdated(const pb::spotify::Playlists& response) {
   if (!search_) {
     InitSearch();
   } else {
-    // Always reset starred playlist
-    // TODO: might be improved by including starred playlist in the response,
-    // and reloading it only when needed, like other playlists.
-    starred_->removeRows(0, starred_->rowCount());
+    // Always reload the starred playlist.  The old tracks stay visible until
+    // it's loaded, and aren't touched at all if it hasn't changed.
     LazyPopulate(starred_);
   }
 
@@ -480,6 +483,8 @@ void SpotifyService::PlaylistsUpdated(const pb::spotify::Playlists& response) {
                   InternetModel::Role_PlayBehaviour);
     item->setData(QUrl(QStringFromStdString(msg.uri())),
                   InternetModel::Role_Url);
+    item->setData(PlaylistRevision(msg.nb_tracks(), playlist_title),
+                  Role_PlaylistRevision);
 
     root_->appendRow(item);
     playlists_ << item;
@@ -572,10 +577,54 @@ void SpotifyService::FillPlaylist(
 
 void SpotifyService::FillPlaylist(
     QStandardItem* item, const pb::spotify::LoadPlaylistResponse& response) {
+  QString revision;
+  if (item->data(InternetModel::Role_Type).toInt() ==
+      InternetModel::Type_UserPlaylist) {
+    revision = PlaylistRevision(response.track_size(), item->text());
+  }
+
+  // Don't rebuild the tree if the playlist is the same as the cached copy
+  // that's already being shown.
+  if (!playlist_cache_.Save(PlaylistCacheKey(item), revision, response) &&
+      item->rowCount() == response.track_size()) {
+    qLog(Debug) << "Playlist unchanged:" << item->text();
+    return;
+  }
+
   qLog(Debug) << "Filling playlist:" << item->text();
   FillPlaylist(item, response.track());
 }
 
+void SpotifyService::FillPlaylistFromCache(QStandardItem* item) {
+  if (item->hasChildren()) return;
+
+  pb::spotify::LoadPlaylistResponse response;
+  if (playlist_cache_.Load(PlaylistCacheKey(item),
+                           item->data(Role_PlaylistRevision).toString(),
+                           &response)) {
+    qLog(Debug) << "Filling playlist from cache:" << item->text();
+    FillPlaylist(item, response.track());
+  }
+}
+
+QString SpotifyService::PlaylistCacheKey(const QStandardItem* item) {
+  switch (item->data(InternetModel::Role_Type).toInt()) {
+    case Type_InboxPlaylist:
+      return "inbox";
+    case Type_StarredPlaylist:
+      return "starred";
+    default:
+      return item->data(InternetModel::Role_Url).toUrl().toString();
+  }
+}
+
+QString SpotifyService::PlaylistRevision(int track_count,
+                                         const QString& title) {
+  // libspotify doesn't tell us about playlist revisions, so the best we can
+  // do is the name and the number of tracks the blob reports.
+  return QString::number(track_count) + ":" + title;
+}
+
 void SpotifyService::SongFromProtobuf(const pb::spotify::Track& track,
                                       Song* song) {
   song->set_rating(track.starred() ? 1.0 : 0.0);
@@ -24,6 +24,7 @@
 
 #include "internet/core/internetmodel.h"
 #include "internet/core/internetservice.h"
+#include "internet/spotify/spotifyplaylistcache.h"
 #include "spotifymessages.pb.h"
 
 #include <QProcess>
@@ -51,6 +52,8 @@ class SpotifyService : public InternetService {
 
   enum Role {
     Role_UserPlaylistIndex = InternetModel::RoleCount,
+    // Identifies the contents of the playlist in the playlist cache.
+    Role_PlaylistRevision,
   };
 
   // Values are persisted - don't change.
@@ -112,6 +115,10 @@ class SpotifyService : public InternetService {
       const google::protobuf::RepeatedPtrField<pb::spotify::Track>& tracks);
   void FillPlaylist(QStandardItem* item,
                     const pb::spotify::LoadPlaylistResponse& response);
+  // Shows the cached copy of a playlist until the blob has loaded it.
+  void FillPlaylistFromCache(QStandardItem* item);
+  static QString PlaylistCacheKey(const QStandardItem* item);
+  static QString PlaylistRevision(int track_count, const QString& title);
   void AddSongsToUserPlaylist(int playlist_index,
                               const QList<QUrl>& songs_urls);
   void AddSongsToStarred(const QList<QUrl>& songs_urls);
@@ -166,6 +173,8 @@ class SpotifyService : public InternetService {
   QStandardItem* toplist_;
   QList<QStandardItem*> playlists_;
 
+  SpotifyPlaylistCache playlist_cache_;
+
   int login_task_id_;
   QString pending_search_;
 
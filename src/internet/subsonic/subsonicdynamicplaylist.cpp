@@ -95,6 +95,8 @@ PlaylistItemList SubsonicDynamicPlaylist::Generate() {
   }
 }
 
+PlaylistItemList SubsonicDynamicPlaylist::Fetch() { return Generate(); }
+
 PlaylistItemList SubsonicDynamicPlaylist::GenerateMoreSongs(int count) {
   const int task_id =
       service_->app_->task_manager()->StartTask(tr("Fetching playlist items"));
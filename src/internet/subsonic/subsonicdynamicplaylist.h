@@ -18,14 +18,14 @@
 #ifndef INTERNET_SUBSONIC_SUBSONICDYNAMICPLAYLIST_H_
 #define INTERNET_SUBSONIC_SUBSONICDYNAMICPLAYLIST_H_
 
-#include "smartplaylists/generator.h"
+#include "smartplaylists/bufferedgenerator.h"
 
 #include <QNetworkAccessManager>
 #include <QXmlStreamReader>
 
 class SubsonicService;
 
-class SubsonicDynamicPlaylist : public smart_playlists::Generator {
+class SubsonicDynamicPlaylist : public smart_playlists::BufferedGenerator {
   Q_OBJECT
   friend QDataStream& operator<<(QDataStream& s,
                                  const SubsonicDynamicPlaylist& p);
@@ -58,7 +58,6 @@ class SubsonicDynamicPlaylist : public smart_playlists::Generator {
 
   PlaylistItemList Generate();
 
-  bool is_dynamic() const { return true; }
   PlaylistItemList GenerateMoreAlbums(int count);
   PlaylistItemList GenerateMoreSongs(int count);
 
@@ -67,6 +66,10 @@ class SubsonicDynamicPlaylist : public smart_playlists::Generator {
   static const int kDefaultSongCount;
   static const int kDefaultOffset;
 
+ protected:
+  // Fetches the next albums or the next random songs.
+  PlaylistItemList Fetch();
+
  private:
   void GetAlbum(PlaylistItemList& list, QString id, QNetworkAccessManager& network,
                 const bool usesslv3);
@@ -298,16 +298,61 @@ void SubsonicService::ReloadDatabase() {
     load_database_task_id_ =
         app_->task_manager()->StartTask(tr("Fetching Subsonic library"));
   }
-  scanner_->Scan();
+
+  // Albums that haven't changed since the last scan don't need fetching again.
+  SubsonicLibraryScanner::AlbumSignatures known_albums;
+  for (const Song& song : library_backend_->GetAllSongs()) {
+    if (song.etag().isEmpty()) continue;
+    known_albums[SubsonicLibraryScanner::AlbumIdFromSignature(song.etag())] =
+        song.etag();
+  }
+  scanner_->Scan(known_albums);
 }
 
 void SubsonicService::ReloadDatabaseFinished() {
   app_->task_manager()->SetTaskFinished(load_database_task_id_);
   load_database_task_id_ = 0;
 
-  library_backend_->DeleteAll();
-  library_backend_->AddOrUpdateSongs(scanner_->GetSongs());
-  library_model_->Reset();
+  if (!scanner_->succeeded()) {
+    // Keep what we had rather than delete everything the scan didn't reach.
+    qLog(Warning) << "Subsonic scan failed, not updating the library";
+    return;
+  }
+
+  // Work out which songs were added, changed or removed, and only touch
+  // those.
+  QMap<QUrl, Song> existing;
+  for (const Song& song : library_backend_->GetAllSongs()) {
+    existing[song.url()] = song;
+  }
+
+  SongList added_or_changed;
+  QSet<QUrl> fetched_urls;
+  for (Song song : scanner_->GetSongs()) {
+    fetched_urls.insert(song.url());
+    if (existing.contains(song.url())) {
+      song.set_id(existing[song.url()].id());
+    }
+    added_or_changed << song;
+  }
+
+  SongList deleted;
+  for (const Song& song : existing) {
+    if (fetched_urls.contains(song.url())) continue;
+    if (!song.etag().isEmpty() &&
+        scanner_->unchanged_albums().contains(
+            SubsonicLibraryScanner::AlbumIdFromSignature(song.etag()))) {
+      continue;
+    }
+    deleted << song;
+  }
+
+  qLog(Debug) << "Subsonic scan:" << added_or_changed.count()
+              << "songs added or changed," << deleted.count() << "deleted";
+  if (!deleted.isEmpty()) library_backend_->DeleteSongs(deleted);
+  if (!added_or_changed.isEmpty()) {
+    library_backend_->AddOrUpdateSongs(added_or_changed);
+  }
 }
 
 void SubsonicService::OnLoginStateChanged(
@@ -419,30 +464,71 @@ void SubsonicService::UpdateServer(const QString& server) {
 }
 
 const int SubsonicLibraryScanner::kAlbumChunkSize = 500;
+const int SubsonicLibraryScanner::kConcurrentListRequests = 4;
 const int SubsonicLibraryScanner::kConcurrentRequests = 8;
 const int SubsonicLibraryScanner::kCoverArtSize = 1024;
 
 SubsonicLibraryScanner::SubsonicLibraryScanner(SubsonicService* service,
                                                QObject* parent)
-    : QObject(parent), service_(service), scanning_(false) {}
+    : QObject(parent),
+      service_(service),
+      scanning_(false),
+      succeeded_(false),
+      next_album_list_offset_(0),
+      pending_album_lists_(0),
+      album_list_finished_(false) {}
 
 SubsonicLibraryScanner::~SubsonicLibraryScanner() {}
 
-void SubsonicLibraryScanner::Scan() {
+QString SubsonicLibraryScanner::AlbumSignature(
+    const QXmlStreamAttributes& attributes) {
+  // Not every server sends "changed", but adding or removing songs shows up
+  // in the count and duration anyway.
+  return QStringList({attributes.value("id").toString(),
+                      attributes.value("changed").toString(),
+                      attributes.value("created").toString(),
+                      attributes.value("songCount").toString(),
+                      attributes.value("duration").toString()})
+      .join(' ');
+}
+
+QString SubsonicLibraryScanner::AlbumIdFromSignature(
+    const QString& signature) {
+  return signature.section(' ', 0, 0);
+}
+
+void SubsonicLibraryScanner::Scan(const AlbumSignatures& known_albums) {
   if (scanning_) {
     return;
   }
 
+  known_albums_ = known_albums;
+  album_signatures_.clear();
+  unchanged_albums_.clear();
   album_queue_.clear();
   pending_requests_.clear();
   songs_.clear();
   scanning_ = true;
-  GetAlbumList(0);
+  succeeded_ = false;
+
+  next_album_list_offset_ = 0;
+  pending_album_lists_ = 0;
+  album_list_finished_ = false;
+  for (int i = 0; i < kConcurrentListRequests; ++i) {
+    GetNextAlbumList();
+  }
+}
+
+void SubsonicLibraryScanner::GetNextAlbumList() {
+  GetAlbumList(next_album_list_offset_);
+  next_album_list_offset_ += kAlbumChunkSize;
 }
 
 void SubsonicLibraryScanner::OnGetAlbumListFinished(QNetworkReply* reply,
                                                     int offset) {
   reply->deleteLater();
+  pending_album_lists_--;
+  if (!scanning_) return;
 
   bool skip_read_albums = false;
 
@@ -485,7 +571,14 @@ void SubsonicLibraryScanner::OnGetAlbumListFinished(QNetworkReply* reply,
         return;
       }
 
-      album_queue_ << reader.attributes().value("id").toString();
+      const QString id = reader.attributes().value("id").toString();
+      const QString signature = AlbumSignature(reader.attributes());
+      if (known_albums_.value(id) == signature) {
+        unchanged_albums_.insert(id);
+      } else {
+        album_signatures_[id] = signature;
+        album_queue_ << id;
+      }
       albums_added++;
       reader.skipCurrentElement();
     }
@@ -493,24 +586,39 @@ void SubsonicLibraryScanner::OnGetAlbumListFinished(QNetworkReply* reply,
 
   if (albums_added > 0) {
     // Non-empty reply means potentially more albums to fetch
-    GetAlbumList(offset + kAlbumChunkSize);
-  } else if (album_queue_.empty()) {
-    // Empty reply and no albums means an empty Subsonic server
+    if (!album_list_finished_) GetNextAlbumList();
+  } else {
+    // Later pages might still be in flight, but they'll be empty too.
+    album_list_finished_ = true;
+  }
+
+  // Fetch the songs of the albums found so far while the list carries on.
+  StartAlbumRequests();
+  MaybeFinishScan();
+}
+
+void SubsonicLibraryScanner::StartAlbumRequests() {
+  // Start up the maximum number of concurrent requests, finished requests get
+  // replaced with new ones
+  while (pending_requests_.count() < kConcurrentRequests &&
+         !album_queue_.empty()) {
+    GetAlbum(album_queue_.dequeue());
+  }
+}
+
+void SubsonicLibraryScanner::MaybeFinishScan() {
+  // If this was the last response, we're done!
+  if (album_list_finished_ && pending_album_lists_ == 0 &&
+      album_queue_.empty() && pending_requests_.empty()) {
     scanning_ = false;
+    succeeded_ = true;
     emit ScanFinished();
-  } else {
-    // Empty reply but we have some albums, time to start fetching songs
-    // Start up the maximum number of concurrent requests, finished requests get
-    // replaced with new ones
-    for (int i = 0; i < kConcurrentRequests && !album_queue_.empty(); ++i) {
-      GetAlbum(album_queue_.dequeue());
-    }
   }
 }
 
 void SubsonicLibraryScanner::OnGetAlbumFinished(QNetworkReply* reply) {
   reply->deleteLater();
-  pending_requests_.remove(reply);
+  if (!pending_requests_.remove(reply)) return;
 
   QXmlStreamReader reader(reply);
   reader.readNextStartElement();
@@ -522,6 +630,8 @@ void SubsonicLibraryScanner::OnGetAlbumFinished(QNetworkReply* reply) {
 
   if (reader.attributes().value("status") != "ok") {
     // TODO(Alan Briolat): error handling
+    StartAlbumRequests();
+    MaybeFinishScan();
     return;
   }
 
@@ -533,6 +643,8 @@ void SubsonicLibraryScanner::OnGetAlbumFinished(QNetworkReply* reply) {
   }
 
   QString album_artist = reader.attributes().value("artist").toString();
+  const QString signature =
+      album_signatures_.value(reader.attributes().value("id").toString());
 
   // Read song information
   while (reader.readNextStartElement()) {
@@ -543,21 +655,14 @@ void SubsonicLibraryScanner::OnGetAlbumFinished(QNetworkReply* reply) {
 
     Song song = service_->ReadSong(reader);
     song.set_albumartist(album_artist);
+    song.set_etag(signature);
 
     songs_ << song;
     reader.skipCurrentElement();
   }
 
-  // Start the next request if albums remain
-  if (!album_queue_.empty()) {
-    GetAlbum(album_queue_.dequeue());
-  }
-
-  // If this was the last response, we're done!
-  if (album_queue_.empty() && pending_requests_.empty()) {
-    scanning_ = false;
-    emit ScanFinished();
-  }
+  StartAlbumRequests();
+  MaybeFinishScan();
 }
 
 void SubsonicLibraryScanner::GetAlbumList(int offset) {
@@ -570,6 +675,7 @@ void SubsonicLibraryScanner::GetAlbumList(int offset) {
   QNetworkReply* reply = service_->Send(url);
   NewClosure(reply, SIGNAL(finished()), this,
              SLOT(OnGetAlbumListFinished(QNetworkReply*, int)), reply, offset);
+  pending_album_lists_++;
 }
 
 void SubsonicLibraryScanner::GetAlbum(const QString& id) {
@@ -589,6 +695,8 @@ void SubsonicLibraryScanner::GetAlbum(const QString& id) {
 void SubsonicLibraryScanner::ParsingError(const QString& message) {
   qLog(Warning) << "Subsonic parsing error: " << message;
   scanning_ = false;
+  succeeded_ = false;
+  pending_requests_.clear();
   emit ScanFinished();
 }
 
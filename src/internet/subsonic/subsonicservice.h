@@ -33,6 +33,7 @@
 class QNetworkAccessManager;
 class QNetworkReply;
 class QSortFilterProxyModel;
+class QXmlStreamAttributes;
 class QXmlStreamReader;
 
 class SubsonicUrlHandler;
@@ -185,10 +186,28 @@ class SubsonicLibraryScanner : public QObject {
                                   QObject* parent = nullptr);
   ~SubsonicLibraryScanner();
 
-  void Scan();
+  // Album ID -> AlbumSignature() of the albums already in the library.
+  typedef QMap<QString, QString> AlbumSignatures;
+
+  // Only fetches the songs of albums that are new or whose signature has
+  // changed since known_albums.
+  void Scan(const AlbumSignatures& known_albums = AlbumSignatures());
+  // The songs of the albums that were fetched.  Their etag is their album's
+  // signature.
   const SongList& GetSongs() const { return songs_; }
+  // The albums in known_albums that are still on the server unchanged, whose
+  // songs weren't fetched.
+  const QSet<QString>& unchanged_albums() const { return unchanged_albums_; }
+  // False if the last scan stopped early.
+  bool succeeded() const { return succeeded_; }
+
+  // Identifies one version of an album, from a getAlbumList2 album element.
+  // The album ID comes first.
+  static QString AlbumSignature(const QXmlStreamAttributes& attributes);
+  static QString AlbumIdFromSignature(const QString& signature);
 
   static const int kAlbumChunkSize;
+  static const int kConcurrentListRequests;
   static const int kConcurrentRequests;
   static const int kCoverArtSize;
 
@@ -202,12 +221,27 @@ signals:
   void OnGetAlbumFinished(QNetworkReply* reply);
 
  private:
+  void GetNextAlbumList();
   void GetAlbumList(int offset);
+  void StartAlbumRequests();
   void GetAlbum(const QString& id);
+  void MaybeFinishScan();
   void ParsingError(const QString& message);
 
   SubsonicService* service_;
   bool scanning_;
+  bool succeeded_;
+
+  // Album list pages are requested a few at a time until one comes back
+  // empty.
+  int next_album_list_offset_;
+  int pending_album_lists_;
+  bool album_list_finished_;
+
+  AlbumSignatures known_albums_;
+  AlbumSignatures album_signatures_;
+  QSet<QString> unchanged_albums_;
+
   QQueue<QString> album_queue_;
   QSet<QNetworkReply*> pending_requests_;
   SongList songs_;
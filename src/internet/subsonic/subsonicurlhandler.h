@@ -34,6 +34,7 @@ class SubsonicUrlHandler : public UrlHandler {
   QString scheme() const { return "subsonic"; }
   QIcon icon() const { return IconLoader::Load("subsonic", IconLoader::Provider); }
   LoadResult StartLoading(const QUrl& url);
+  bool CanResolveEarly() const { return true; }
   // LoadResult LoadNext(const QUrl& url);
 
  private:
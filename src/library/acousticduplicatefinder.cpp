@@ -0,0 +1,443 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "acousticduplicatefinder.h"
+
+#include <algorithm>
+
+#include <QHash>
+#include <QSet>
+#include <QSettings>
+#include <QSqlQuery>
+#include <QTimer>
+#include <QUrl>
+#include <QtAlgorithms>
+#include <QtEndian>
+
+#include "librarybackend.h"
+#include "core/application.h"
+#include "core/closure.h"
+#include "core/database.h"
+#include "core/logging.h"
+#include "core/scopedtransaction.h"
+#include "core/taskexecutor.h"
+#include "core/taskmanager.h"
+#include "musicbrainz/chromaprinter.h"
+
+const char* AcousticDuplicateFinder::kTable = "acoustic_fingerprints";
+const int AcousticDuplicateFinder::kSongsPerPage = 20;
+const int AcousticDuplicateFinder::kAnalyseDelayMsec = 10000;
+const int AcousticDuplicateFinder::kFingerprintFrames = 120;
+const int AcousticDuplicateFinder::kSampleRate = 8;
+const int AcousticDuplicateFinder::kMaxBucketSize = 50;
+const int AcousticDuplicateFinder::kMaxOffsetFrames = 8;
+const double AcousticDuplicateFinder::kMaxBitErrorRate = 0.15;
+
+namespace {
+
+// Whether frame goes in the index.  The frame is hashed first since the bits
+// of Chromaprint frames aren't equally likely to be set.
+bool IsSampled(quint32 frame) {
+  return (frame * 2654435761u) % AcousticDuplicateFinder::kSampleRate == 0;
+}
+
+// Songs that can be fingerprinted but haven't been since they last changed.
+QString UnprintedSongsSql(const QString& songs_table,
+                          const QString& columns) {
+  return QString(
+             "SELECT %1 FROM %2 AS s"
+             " LEFT JOIN %3 AS f ON f.song_id = s.ROWID"
+             " WHERE s.unavailable = 0 AND s.filename LIKE 'file:%'"
+             "   AND (s.cue_path IS NULL OR s.cue_path = '')"
+             "   AND (f.song_id IS NULL OR f.mtime != s.mtime)")
+      .arg(columns, songs_table, AcousticDuplicateFinder::kTable);
+}
+
+int FindRoot(QHash<int, int>* parents, int id) {
+  while (parents->value(id, id) != id) id = parents->value(id);
+  return id;
+}
+
+}  // namespace
+
+AcousticDuplicateFinder::AcousticDuplicateFinder(Application* app,
+                                                 LibraryBackend* backend,
+                                                 QObject* parent)
+    : QObject(parent),
+      app_(app),
+      backend_(backend),
+      analyse_timer_(new QTimer(this)),
+      enabled_(false),
+      task_id_(-1),
+      analyse_again_(false),
+      last_id_(-1),
+      total_(0),
+      done_(0) {
+  analyse_timer_->setSingleShot(true);
+  analyse_timer_->setInterval(kAnalyseDelayMsec);
+  connect(analyse_timer_, SIGNAL(timeout()), SLOT(Analyse()));
+
+  ReloadSettings();
+}
+
+AcousticDuplicateFinder::~AcousticDuplicateFinder() {}
+
+void AcousticDuplicateFinder::ReloadSettings() {
+  QSettings s;
+  s.beginGroup(LibraryBackend::kSettingsGroup);
+  const bool was_enabled = enabled_;
+  enabled_ = s.value("find_acoustic_duplicates", false).toBool();
+
+  if (enabled_ && !was_enabled) {
+    AnalyseLater();
+  } else if (!enabled_) {
+    // The page that's being fingerprinted is still saved.
+    analyse_again_ = false;
+    last_id_ = -1;
+  }
+}
+
+void AcousticDuplicateFinder::AnalyseLater() {
+  if (enabled_) analyse_timer_->start();
+}
+
+void AcousticDuplicateFinder::Analyse() {
+  if (!enabled_) return;
+
+  if (task_id_ != -1) {
+    // Look again for the new songs once this run is over.
+    analyse_again_ = true;
+    return;
+  }
+
+  task_id_ = app_->task_manager()->StartTask(tr("Fingerprinting songs"));
+  last_id_ = 0;
+  total_ = -1;
+  done_ = 0;
+
+  FingerprintMore();
+}
+
+void AcousticDuplicateFinder::FingerprintMore() {
+  QFuture<Page> future = TaskExecutor::Instance()->Run<Page>(
+      TaskExecutor::Lane_Bulk,
+      std::bind(&AcousticDuplicateFinder::FingerprintPage, backend_, last_id_,
+                total_ == -1));
+  NewClosure(future, this,
+             SLOT(PageDone(QFuture<AcousticDuplicateFinder::Page>)), future);
+}
+
+AcousticDuplicateFinder::Page AcousticDuplicateFinder::FingerprintPage(
+    LibraryBackend* backend, int after_id, bool count) {
+  Page ret;
+  Database* db = backend->db();
+
+  struct Job {
+    int id_;
+    int mtime_;
+    QString filename_;
+    QByteArray fingerprint_;
+  };
+  QList<Job> jobs;
+
+  {
+    QMutexLocker l(db->ReadMutex());
+    QSqlDatabase read_db(db->ConnectForReading());
+
+    QSqlQuery q(read_db);
+    q.prepare(UnprintedSongsSql(backend->songs_table(),
+                                "s.ROWID, s.filename, s.mtime") +
+              " AND s.ROWID > :after_id ORDER BY s.ROWID LIMIT :limit");
+    q.bindValue(":after_id", after_id);
+    q.bindValue(":limit", kSongsPerPage);
+    q.exec();
+    if (db->CheckErrors(q)) return ret;
+
+    while (q.next()) {
+      Job job;
+      job.id_ = q.value(0).toInt();
+      job.filename_ =
+          QUrl::fromEncoded(q.value(1).toByteArray()).toLocalFile();
+      job.mtime_ = q.value(2).toInt();
+      jobs << job;
+    }
+
+    if (count) {
+      QSqlQuery count_query(read_db);
+      count_query.prepare(
+          UnprintedSongsSql(backend->songs_table(), "COUNT(*)"));
+      count_query.exec();
+      if (!db->CheckErrors(count_query) && count_query.next()) {
+        ret.remaining_ = count_query.value(0).toInt();
+      }
+    }
+  }
+
+  if (jobs.count() == kSongsPerPage) ret.last_id_ = jobs.last().id_;
+
+  // Songs that can't be fingerprinted get an empty one, so they aren't tried
+  // again until they change.
+  for (Job& job : jobs) {
+    Chromaprinter chromaprinter(job.filename_);
+    chromaprinter.CreateFingerprint();
+    job.fingerprint_ =
+        Pack(chromaprinter.raw_fingerprint().mid(0, kFingerprintFrames));
+  }
+
+  QMutexLocker l(db->Mutex());
+  QSqlDatabase write_db(db->Connect());
+  ScopedTransaction transaction(&write_db);
+
+  // Forget songs that have gone from the library at the start of each run.
+  if (after_id == 0) {
+    QSqlQuery clean(write_db);
+    clean.prepare(QString("DELETE FROM %1 WHERE song_id NOT IN"
+                          " (SELECT ROWID FROM %2)")
+                      .arg(kTable, backend->songs_table()));
+    clean.exec();
+    if (db->CheckErrors(clean)) return ret;
+  }
+
+  QSqlQuery insert(write_db);
+  insert.prepare(QString("INSERT OR REPLACE INTO %1"
+                         " (song_id, mtime, fingerprint)"
+                         " VALUES (:song_id, :mtime, :fingerprint)")
+                     .arg(kTable));
+  for (const Job& job : jobs) {
+    insert.bindValue(":song_id", job.id_);
+    insert.bindValue(":mtime", job.mtime_);
+    insert.bindValue(":fingerprint", job.fingerprint_);
+    insert.exec();
+    if (db->CheckErrors(insert)) return ret;
+  }
+  transaction.Commit();
+
+  ret.done_ = jobs.count();
+  return ret;
+}
+
+void AcousticDuplicateFinder::PageDone(QFuture<Page> future) {
+  const Page page = future.result();
+  done_ += page.done_;
+  if (total_ == -1) {
+    total_ = page.remaining_;
+    qLog(Info) << "Fingerprinting" << total_ << "songs";
+  }
+  if (total_ > 0) {
+    app_->task_manager()->SetTaskProgress(task_id_, qMin(done_, total_),
+                                          total_);
+  }
+
+  // last_id_ is -1 if we were disabled while that page was going.
+  if (last_id_ != -1 && page.last_id_ != -1) {
+    last_id_ = page.last_id_;
+    FingerprintMore();
+    return;
+  }
+
+  qLog(Info) << "Fingerprinted" << done_ << "songs";
+  app_->task_manager()->SetTaskFinished(task_id_);
+  task_id_ = -1;
+  last_id_ = -1;
+
+  if (analyse_again_) {
+    analyse_again_ = false;
+    AnalyseLater();
+  }
+
+  RebuildIndex();
+}
+
+void AcousticDuplicateFinder::RebuildIndex() {
+  QFuture<IndexPtr> future = TaskExecutor::Instance()->Run<IndexPtr>(
+      TaskExecutor::Lane_Background,
+      std::bind(&AcousticDuplicateFinder::BuildIndex, backend_));
+  NewClosure(future, this,
+             SLOT(IndexBuilt(QFuture<AcousticDuplicateFinder::IndexPtr>)),
+             future);
+}
+
+void AcousticDuplicateFinder::IndexBuilt(QFuture<IndexPtr> future) {
+  index_ = future.result();
+}
+
+AcousticDuplicateFinder::IndexPtr AcousticDuplicateFinder::BuildIndex(
+    LibraryBackend* backend) {
+  std::shared_ptr<Index> index(new Index);
+  Database* db = backend->db();
+
+  {
+    QMutexLocker l(db->ReadMutex());
+    QSqlDatabase read_db(db->ConnectForReading());
+
+    QSqlQuery q(read_db);
+    q.setForwardOnly(true);
+    q.prepare(QString("SELECT f.song_id, f.fingerprint FROM %1 AS f"
+                      " INNER JOIN %2 AS s ON s.ROWID = f.song_id"
+                      " WHERE s.unavailable = 0")
+                  .arg(kTable, backend->songs_table()));
+    q.exec();
+    if (db->CheckErrors(q)) return index;
+
+    QSet<quint32> sampled;
+    while (q.next()) {
+      const quint64 id = q.value(0).toUInt();
+
+      sampled.clear();
+      for (quint32 frame : Unpack(q.value(1).toByteArray())) {
+        if (IsSampled(frame)) sampled << frame;
+      }
+      for (quint32 frame : sampled) {
+        *index << (quint64(frame) << 32 | id);
+      }
+    }
+  }
+
+  std::sort(index->begin(), index->end());
+  qLog(Debug) << "Acoustic duplicate index has" << index->count() << "frames";
+  return index;
+}
+
+QFuture<QList<SongList>> AcousticDuplicateFinder::FindDuplicates() {
+  return TaskExecutor::Instance()->Run<QList<SongList>>(
+      TaskExecutor::Lane_Interactive,
+      std::bind(&AcousticDuplicateFinder::DoFindDuplicates, backend_,
+                index_));
+}
+
+QList<SongList> AcousticDuplicateFinder::DoFindDuplicates(
+    LibraryBackend* backend, IndexPtr index) {
+  if (!index) index = BuildIndex(backend);
+
+  // Songs that share a sampled frame might be the same.
+  QSet<quint64> candidates;
+  for (int start = 0; start < index->count();) {
+    const quint32 frame = index->at(start) >> 32;
+    int end = start + 1;
+    while (end < index->count() && quint32(index->at(end) >> 32) == frame) {
+      ++end;
+    }
+
+    if (end - start <= kMaxBucketSize) {
+      for (int i = start; i < end; ++i) {
+        for (int j = i + 1; j < end; ++j) {
+          const quint32 a = quint32(index->at(i));
+          const quint32 b = quint32(index->at(j));
+          candidates << (quint64(qMin(a, b)) << 32 | qMax(a, b));
+        }
+      }
+    }
+    start = end;
+  }
+  if (candidates.isEmpty()) return QList<SongList>();
+
+  // Only the candidates' fingerprints are read.
+  QSet<int> ids;
+  for (quint64 pair : candidates) {
+    ids << int(pair >> 32) << int(quint32(pair));
+  }
+
+  QHash<int, Fingerprint> fingerprints;
+  {
+    Database* db = backend->db();
+    QMutexLocker l(db->ReadMutex());
+    QSqlDatabase read_db(db->ConnectForReading());
+
+    const QList<int> id_list = ids.toList();
+    for (int i = 0; i < id_list.count(); i += LibraryBackend::kSongBatchSize) {
+      QStringList batch;
+      for (int id : id_list.mid(i, LibraryBackend::kSongBatchSize)) {
+        batch << QString::number(id);
+      }
+
+      QSqlQuery q(read_db);
+      q.prepare(QString("SELECT song_id, fingerprint FROM %1"
+                        " WHERE song_id IN (%2)")
+                    .arg(kTable, batch.join(",")));
+      q.exec();
+      if (db->CheckErrors(q)) return QList<SongList>();
+
+      while (q.next()) {
+        fingerprints[q.value(0).toInt()] = Unpack(q.value(1).toByteArray());
+      }
+    }
+  }
+
+  // Join the songs that match into groups.
+  QHash<int, int> parents;
+  for (quint64 pair : candidates) {
+    const int a = pair >> 32;
+    const int b = quint32(pair);
+    if (!Matches(fingerprints[a], fingerprints[b])) continue;
+
+    if (!parents.contains(a)) parents[a] = a;
+    if (!parents.contains(b)) parents[b] = b;
+    const int root_a = FindRoot(&parents, a);
+    const int root_b = FindRoot(&parents, b);
+    if (root_a != root_b) parents[root_b] = root_a;
+  }
+
+  QHash<int, QList<int>> groups;
+  for (int id : parents.keys()) {
+    groups[FindRoot(&parents, id)] << id;
+  }
+
+  QList<SongList> ret;
+  for (const QList<int>& group : groups) {
+    const SongList songs = backend->GetSongsById(group);
+    if (songs.count() > 1) ret << songs;
+  }
+  return ret;
+}
+
+bool AcousticDuplicateFinder::Matches(const Fingerprint& a,
+                                      const Fingerprint& b) {
+  const int min_overlap = kFingerprintFrames / 2;
+
+  for (int offset = -kMaxOffsetFrames; offset <= kMaxOffsetFrames; ++offset) {
+    const int start_a = qMax(0, offset);
+    const int start_b = qMax(0, -offset);
+    const int overlap = qMin(a.count() - start_a, b.count() - start_b);
+    if (overlap < min_overlap) continue;
+
+    const int max_errors = int(kMaxBitErrorRate * 32 * overlap);
+    int errors = 0;
+    for (int i = 0; i < overlap && errors <= max_errors; ++i) {
+      errors += qPopulationCount(a[start_a + i] ^ b[start_b + i]);
+    }
+    if (errors <= max_errors) return true;
+  }
+  return false;
+}
+
+QByteArray AcousticDuplicateFinder::Pack(const Fingerprint& fingerprint) {
+  QByteArray ret(fingerprint.count() * 4, Qt::Uninitialized);
+  for (int i = 0; i < fingerprint.count(); ++i) {
+    qToLittleEndian(fingerprint[i],
+                    reinterpret_cast<uchar*>(ret.data()) + i * 4);
+  }
+  return ret;
+}
+
+AcousticDuplicateFinder::Fingerprint AcousticDuplicateFinder::Unpack(
+    const QByteArray& data) {
+  Fingerprint ret(data.size() / 4);
+  for (int i = 0; i < ret.count(); ++i) {
+    ret[i] = qFromLittleEndian<quint32>(
+        reinterpret_cast<const uchar*>(data.constData()) + i * 4);
+  }
+  return ret;
+}
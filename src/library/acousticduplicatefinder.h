@@ -0,0 +1,130 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARY_ACOUSTICDUPLICATEFINDER_H_
+#define LIBRARY_ACOUSTICDUPLICATEFINDER_H_
+
+#include <memory>
+
+#include <QFuture>
+#include <QList>
+#include <QObject>
+#include <QVector>
+
+#include "core/song.h"
+
+class Application;
+class LibraryBackend;
+class QTimer;
+
+// Finds library songs that are the same recording, even when they're
+// different encodes with different tags, which the title based duplicate
+// search can't.  When it's enabled, the Chromaprint fingerprint of the start
+// of each local song is worked out in the background, as a task on the
+// TaskManager, and kept in the database.
+//
+// Comparing every pair of fingerprints would take far too long on a big
+// library, so a sample of each fingerprint's 32-bit frames is kept in memory
+// in one sorted index.  Different encodes of a song share plenty of frames
+// exactly, so only songs that share a sampled frame need comparing properly.
+class AcousticDuplicateFinder : public QObject {
+  Q_OBJECT
+
+ public:
+  AcousticDuplicateFinder(Application* app, LibraryBackend* backend,
+                          QObject* parent = nullptr);
+  ~AcousticDuplicateFinder();
+
+  static const char* kTable;
+  static const int kSongsPerPage;
+  static const int kAnalyseDelayMsec;
+  // Only this many frames of each fingerprint are kept, about 15 seconds.
+  static const int kFingerprintFrames;
+  // Frames are sampled for the index by their value, so the same frames are
+  // picked from every song whatever their position.  One in this many is.
+  static const int kSampleRate;
+  // A frame shared by more songs than this is something like silence, and
+  // says nothing about whether they're the same.
+  static const int kMaxBucketSize;
+  // How far apart the starts of two encodes of a song can be.
+  static const int kMaxOffsetFrames;
+  // Fingerprints match if no more than this fraction of their bits differ.
+  static const double kMaxBitErrorRate;
+
+  typedef QVector<quint32> Fingerprint;
+
+  // Returns true if a and b look like the same recording.
+  static bool Matches(const Fingerprint& a, const Fingerprint& b);
+
+  // Finds groups of songs that sound the same, in the background.  Songs that
+  // haven't been fingerprinted yet are left out.
+  QFuture<QList<SongList>> FindDuplicates();
+
+ public slots:
+  void ReloadSettings();
+  // Starts fingerprinting soon, so songs discovered in a library scan are
+  // taken all at once.
+  void AnalyseLater();
+
+ private:
+  struct Page {
+    Page() : last_id_(-1), done_(0), remaining_(0) {}
+
+    // -1 once there are no more songs.
+    int last_id_;
+    int done_;
+    int remaining_;
+  };
+
+  // Sampled frames in the high 32 bits and song IDs in the low 32, sorted.
+  typedef QVector<quint64> Index;
+  typedef std::shared_ptr<const Index> IndexPtr;
+
+ private slots:
+  void Analyse();
+  void PageDone(QFuture<AcousticDuplicateFinder::Page> future);
+  void IndexBuilt(QFuture<AcousticDuplicateFinder::IndexPtr> future);
+
+ private:
+  static Page FingerprintPage(LibraryBackend* backend, int after_id,
+                              bool count);
+  static IndexPtr BuildIndex(LibraryBackend* backend);
+  static QList<SongList> DoFindDuplicates(LibraryBackend* backend,
+                                          IndexPtr index);
+
+  static QByteArray Pack(const Fingerprint& fingerprint);
+  static Fingerprint Unpack(const QByteArray& data);
+
+  void FingerprintMore();
+  void RebuildIndex();
+
+ private:
+  Application* app_;
+  LibraryBackend* backend_;
+  QTimer* analyse_timer_;
+
+  bool enabled_;
+  int task_id_;
+  bool analyse_again_;
+  // -1 when not fingerprinting.
+  int last_id_;
+  int total_;
+  int done_;
+
+  IndexPtr index_;
+};
+
+#endif  // LIBRARY_ACOUSTICDUPLICATEFINDER_H_
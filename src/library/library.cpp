@@ -17,15 +17,20 @@
 
 #include "library.h"
 
+#include "acousticduplicatefinder.h"
 #include "core/application.h"
 #include "core/database.h"
 #include "core/player.h"
 #include "core/tagreaderclient.h"
 #include "core/taskmanager.h"
 #include "core/thread.h"
+#include "core/utilities.h"
 #include "librarybackend.h"
 #include "librarydirectorymodel.h"
 #include "librarymodel.h"
+#include "replaygainanalyzer.h"
+#include "networkremote/libraryreplica.h"
+#include "scanthrottle.h"
 #include "smartplaylists/generator.h"
 #include "smartplaylists/querygenerator.h"
 #include "smartplaylists/search.h"
@@ -42,6 +47,10 @@ Library::Library(Application* app, QObject* parent)
       model_(nullptr),
       watcher_(nullptr),
       watcher_thread_(nullptr),
+      scan_throttle_(nullptr),
+      replaygain_analyzer_(nullptr),
+      acoustic_duplicate_finder_(nullptr),
+      replica_(nullptr),
       save_statistics_in_files_(false),
       save_ratings_in_files_(false) {
   backend_.reset(new LibraryBackend);
@@ -59,6 +68,8 @@ Library::Library(Application* app, QObject* parent)
   model_ = new LibraryModel(backend_, app_, this);
   dir_model_ = new LibraryDirectoryModel(backend_, this);
   model_->set_show_smart_playlists(true);
+  model_->set_snapshot_filename(
+      Utilities::GetConfigPath(Utilities::Path_CacheRoot) + "/librarytree.dat");
   model_->set_default_smart_playlists(
       LibraryModel::DefaultGenerators()
       << (LibraryModel::GeneratorList()
@@ -140,6 +151,9 @@ void Library::Init() {
   watcher_->set_backend(backend_.get());
   watcher_->set_task_manager(app_->task_manager());
 
+  scan_throttle_ = new ScanThrottle(app_, this);
+  watcher_->set_scan_throttle(scan_throttle_);
+
   connect(backend_.get(),
           SIGNAL(DirectoryDiscovered(Directory, SubdirectoryList)), watcher_,
           SLOT(AddDirectory(Directory, SubdirectoryList)));
@@ -169,8 +183,24 @@ void Library::Init() {
           SLOT(CurrentSongChanged(Song)));
   connect(app_->player(), SIGNAL(Stopped()), SLOT(Stopped()));
 
-  // This will start the watcher checking for updates
-  backend_->LoadDirectoriesAsync();
+  replaygain_analyzer_ = new ReplayGainAnalyzer(app_, backend_.get(), this);
+  connect(backend_.get(), SIGNAL(SongsDiscovered(SongList)),
+          replaygain_analyzer_, SLOT(AnalyseLater()));
+  acoustic_duplicate_finder_ =
+      new AcousticDuplicateFinder(app_, backend_.get(), this);
+  connect(backend_.get(), SIGNAL(SongsDiscovered(SongList)),
+          acoustic_duplicate_finder_, SLOT(AnalyseLater()));
+
+  if (LibraryReplica::IsEnabled()) {
+    // The watcher never hears about any directories, so nothing is scanned.
+    replica_ = new LibraryReplica(backend_.get(), this);
+    replica_->Start();
+  } else {
+    // This will start the watcher checking for updates
+    backend_->LoadDirectoriesAsync();
+  }
+  backend_->UpdateDuplicateKeysAsync();
+  backend_->UpdateSortKeysAsync();
 }
 
 void Library::IncrementalScan() { watcher_->IncrementalScanAsync(); }
@@ -183,6 +213,8 @@ void Library::ResumeWatcher() { watcher_->SetRescanPausedAsync(false); }
 
 void Library::ReloadSettings() {
   watcher_->ReloadSettingsAsync();
+  if (replaygain_analyzer_) replaygain_analyzer_->ReloadSettings();
+  if (acoustic_duplicate_finder_) acoustic_duplicate_finder_->ReloadSettings();
 
   // These don't belong in LibraryBackend's group but it's too late to change
   // now.
@@ -194,19 +226,22 @@ void Library::ReloadSettings() {
 }
 
 void Library::WriteAllSongsStatisticsToFiles() {
-  const SongList all_songs = backend_->GetAllSongs();
-
   const int task_id = app_->task_manager()->StartTask(
       tr("Saving songs statistics into songs files"));
   app_->task_manager()->SetTaskBlocksLibraryScans(task_id);
 
-  const int nb_songs = all_songs.size();
+  // Read the library a batch at a time rather than loading every song first.
+  const int nb_songs = backend_->GetStatistics().songs;
   int i = 0;
-  for (const Song& song : all_songs) {
-    TagReaderClient::Instance()->UpdateSongStatisticsBlocking(song);
-    TagReaderClient::Instance()->UpdateSongRatingBlocking(song);
-    app_->task_manager()->SetTaskProgress(task_id, ++i, nb_songs);
-  }
+  backend_->GetAllSongs([&](const SongList& songs) {
+    for (const Song& song : songs) {
+      TagReaderClient::Instance()->UpdateSongStatisticsBlocking(song);
+      TagReaderClient::Instance()->UpdateSongRatingBlocking(song);
+      app_->task_manager()->SetTaskProgress(task_id, ++i,
+                                            qMax(i, nb_songs));
+    }
+    return true;
+  });
   app_->task_manager()->SetTaskFinished(task_id);
 }
 
@@ -26,12 +26,16 @@
 
 #include "core/song.h"
 
+class AcousticDuplicateFinder;
 class Application;
 class Database;
 class LibraryBackend;
 class LibraryModel;
+class LibraryReplica;
 class LibraryDirectoryModel;
 class LibraryWatcher;
+class ReplayGainAnalyzer;
+class ScanThrottle;
 class TaskManager;
 class Thread;
 
@@ -52,6 +56,9 @@ class Library : public QObject {
   LibraryBackend* backend() const { return backend_.get(); }
   LibraryModel* model() const { return model_; }
   LibraryDirectoryModel* directory_model() const { return dir_model_; }
+  AcousticDuplicateFinder* acoustic_duplicate_finder() const {
+    return acoustic_duplicate_finder_;
+  }
 
   QString full_rescan_reason(int schema_version) const {
     return full_rescan_revisions_.value(schema_version, QString());
@@ -86,6 +93,12 @@ class Library : public QObject {
 
   LibraryWatcher* watcher_;
   Thread* watcher_thread_;
+  ScanThrottle* scan_throttle_;
+
+  ReplayGainAnalyzer* replaygain_analyzer_;
+  AcousticDuplicateFinder* acoustic_duplicate_finder_;
+  // Only when the library is copied from another Clementine.
+  LibraryReplica* replica_;
 
   bool save_statistics_in_files_;
   bool save_ratings_in_files_;
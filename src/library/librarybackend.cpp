@@ -20,6 +20,9 @@
 #include "sqlrow.h"
 #include "core/application.h"
 #include "core/database.h"
+#include "core/logging.h"
+#include "core/metriccounter.h"
+#include "core/perftrace.h"
 #include "core/scopedtransaction.h"
 #include "core/tagreaderclient.h"
 #include "core/utilities.h"
@@ -28,13 +31,23 @@
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
+#include <QPair>
+#include <QSet>
 #include <QSettings>
+#include <QTimer>
 #include <QVariant>
 #include <QtDebug>
 
 const char* LibraryBackend::kSettingsGroup = "LibraryBackend";
 
+const int LibraryBackend::kMaxBoundValues = 999;
+const int LibraryBackend::kLogThroughputRows = 100;
+const int LibraryBackend::kDuplicateKeyBatchSize = 1000;
+const int LibraryBackend::kSongBatchSize = 500;
+const int LibraryBackend::kStatisticsFlushDelayMsec = 500;
+
 const char* LibraryBackend::kNewScoreSql =
     "case when playcount <= 0 then (%1 * 100 + score) / 2"
     "     else (score * (playcount + skipcount) + %1 * 100) / (playcount + "
@@ -44,7 +57,93 @@ const char* LibraryBackend::kNewScoreSql =
 LibraryBackend::LibraryBackend(QObject* parent)
     : LibraryBackendInterface(parent),
       save_statistics_in_file_(false),
-      save_ratings_in_file_(false) {}
+      save_ratings_in_file_(false),
+      statistics_loaded_(false),
+      statistics_songs_(0),
+      statistics_length_nanosec_(0),
+      tag_completion_cache_(
+          [this](const QString& column) { return GetAll(column); }),
+      changes_sequence_(0),
+      statistics_flush_scheduled_(false),
+      statistics_flush_timer_(new QTimer(this)) {
+  statistics_flush_timer_->setSingleShot(true);
+  statistics_flush_timer_->setInterval(kStatisticsFlushDelayMsec);
+  connect(statistics_flush_timer_, SIGNAL(timeout()),
+          SLOT(FlushStatistics()));
+
+  // Update the cache before anyone else hears about the change.  Changed
+  // songs are sent as deleted and then discovered again, so deleted songs are
+  // left for the cache to drop once they aren't used.
+  connect(this, SIGNAL(SongsDiscovered(SongList)),
+          SLOT(UpdateSongCache(SongList)), Qt::DirectConnection);
+  connect(this, SIGNAL(SongsStatisticsChanged(SongList)),
+          SLOT(UpdateSongCache(SongList)), Qt::DirectConnection);
+  connect(this, SIGNAL(SongsRatingChanged(SongList)),
+          SLOT(UpdateSongCache(SongList)), Qt::DirectConnection);
+  connect(this, SIGNAL(DatabaseReset()), SLOT(ClearSongCache()),
+          Qt::DirectConnection);
+
+  connect(this, SIGNAL(SongsDiscovered(SongList)),
+          SLOT(AddTagCompletions(SongList)), Qt::DirectConnection);
+  connect(this, SIGNAL(SongsDeleted(SongList)),
+          SLOT(RemoveTagCompletions(SongList)), Qt::DirectConnection);
+  connect(this, SIGNAL(DatabaseReset()), SLOT(ClearTagCompletions()),
+          Qt::DirectConnection);
+
+  connect(this, SIGNAL(SongsDiscovered(SongList)),
+          SLOT(PublishDiscovered(SongList)), Qt::DirectConnection);
+  connect(this, SIGNAL(SongsDeleted(SongList)), SLOT(PublishDeleted(SongList)),
+          Qt::DirectConnection);
+  connect(this, SIGNAL(SongsStatisticsChanged(SongList)),
+          SLOT(PublishStatistics(SongList)), Qt::DirectConnection);
+  connect(this, SIGNAL(SongsRatingChanged(SongList)),
+          SLOT(PublishRating(SongList)), Qt::DirectConnection);
+}
+
+void LibraryBackend::UpdateSongCache(const SongList& songs) {
+  song_cache_.Update(songs);
+}
+
+void LibraryBackend::ClearSongCache() { song_cache_.Clear(); }
+
+void LibraryBackend::AddTagCompletions(const SongList& songs) {
+  tag_completion_cache_.SongsDiscovered(songs);
+}
+
+void LibraryBackend::RemoveTagCompletions(const SongList& songs) {
+  tag_completion_cache_.SongsDeleted(songs);
+}
+
+void LibraryBackend::ClearTagCompletions() { tag_completion_cache_.Clear(); }
+
+void LibraryBackend::PublishDiscovered(const SongList& songs) {
+  PublishChanges(songs, LibraryChanges::Change_Discovered);
+}
+
+void LibraryBackend::PublishDeleted(const SongList& songs) {
+  PublishChanges(songs, LibraryChanges::Change_Deleted);
+}
+
+void LibraryBackend::PublishStatistics(const SongList& songs) {
+  PublishChanges(songs, LibraryChanges::Change_Statistics);
+}
+
+void LibraryBackend::PublishRating(const SongList& songs) {
+  PublishChanges(songs, LibraryChanges::Change_Rating);
+}
+
+void LibraryBackend::PublishChanges(const SongList& songs,
+                                    LibraryChanges::Change change) {
+  if (songs.isEmpty()) return;
+
+  LibraryChanges changes;
+  changes.sequence = ++changes_sequence_;
+  changes.songs.reserve(songs.count());
+  for (const Song& song : songs) {
+    changes.songs[song.id()] |= change;
+  }
+  emit SongsChanged(changes);
+}
 
 void LibraryBackend::Init(Database* db, const QString& songs_table,
                           const QString& fts_table) {
@@ -71,31 +170,74 @@ void LibraryBackend::UpdateTotalSongCountAsync() {
                              Qt::QueuedConnection);
 }
 
+void LibraryBackend::UpdateDuplicateKeysAsync() {
+  metaObject()->invokeMethod(this, "UpdateDuplicateKeys",
+                             Qt::QueuedConnection);
+}
+
+void LibraryBackend::UpdateSortKeysAsync() {
+  metaObject()->invokeMethod(this, "UpdateSortKeys", Qt::QueuedConnection);
+}
+
 void LibraryBackend::IncrementPlayCountAsync(int id) {
-  metaObject()->invokeMethod(this, "IncrementPlayCount", Qt::QueuedConnection,
-                             Q_ARG(int, id));
+  QueueStatistics(QList<int>() << id, [](PendingStatistics* pending) {
+    pending->events_ << StatisticsEvent{true, 1.0f};
+  });
 }
 
 void LibraryBackend::IncrementSkipCountAsync(int id, float progress) {
-  metaObject()->invokeMethod(this, "IncrementSkipCount", Qt::QueuedConnection,
-                             Q_ARG(int, id), Q_ARG(float, progress));
+  progress = qBound(0.0f, progress, 1.0f);
+  QueueStatistics(QList<int>() << id, [progress](PendingStatistics* pending) {
+    pending->events_ << StatisticsEvent{false, progress};
+  });
 }
 
 void LibraryBackend::ResetStatisticsAsync(int id) {
-  metaObject()->invokeMethod(this, "ResetStatistics", Qt::QueuedConnection,
-                             Q_ARG(int, id));
+  QueueStatistics(QList<int>() << id, [](PendingStatistics* pending) {
+    pending->reset_ = true;
+    pending->events_.clear();
+  });
 }
 
 void LibraryBackend::UpdateSongRatingAsync(int id, float rating) {
-  metaObject()->invokeMethod(this, "UpdateSongRating", Qt::QueuedConnection,
-                             Q_ARG(int, id), Q_ARG(float, rating));
+  UpdateSongsRatingAsync(QList<int>() << id, rating);
 }
 
 void LibraryBackend::UpdateSongsRatingAsync(const QList<int>& ids,
                                             float rating) {
-  metaObject()->invokeMethod(this, "UpdateSongsRating", Qt::QueuedConnection,
-                             Q_ARG(const QList<int>&, ids),
-                             Q_ARG(float, rating));
+  QueueStatistics(ids, [rating](PendingStatistics* pending) {
+    pending->has_rating_ = true;
+    pending->rating_ = rating;
+  });
+}
+
+void LibraryBackend::QueueStatistics(
+    const QList<int>& ids,
+    const std::function<void(PendingStatistics*)>& change) {
+  {
+    QMutexLocker l(&pending_statistics_mutex_);
+    for (int id : ids) {
+      if (id != -1) change(&pending_statistics_[id]);
+    }
+
+    if (statistics_flush_scheduled_) return;
+    statistics_flush_scheduled_ = true;
+  }
+
+  // The timer lives in the database thread.
+  metaObject()->invokeMethod(statistics_flush_timer_, "start",
+                             Qt::QueuedConnection);
+}
+
+void LibraryBackend::FlushStatistics() {
+  PendingStatisticsMap pending;
+  {
+    QMutexLocker l(&pending_statistics_mutex_);
+    pending.swap(pending_statistics_);
+    statistics_flush_scheduled_ = false;
+  }
+
+  WriteStatistics(pending);
 }
 
 void LibraryBackend::LoadDirectories() {
@@ -207,14 +349,182 @@ void LibraryBackend::UpdateTotalSongCount() {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
+  if (!LoadStatistics(db)) return;
+
+  emit TotalSongCountUpdated(statistics_songs_);
+}
+
+LibraryBackend::Statistics LibraryBackend::GetStatistics() {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  Statistics ret;
+  if (!LoadStatistics(db)) return ret;
+
+  ret.songs = statistics_songs_;
+  ret.artists = statistics_artists_.count();
+  ret.albums = statistics_albums_.count();
+  ret.length_nanosec = statistics_length_nanosec_;
+  return ret;
+}
+
+bool LibraryBackend::LoadStatistics(QSqlDatabase& db) {
+  if (statistics_loaded_) return true;
+
+  // One pass over the table, then the counters are kept up to date as songs
+  // are written.
   QSqlQuery q(db);
-  q.prepare(QString("SELECT COUNT(*) FROM %1 WHERE unavailable = 0")
-                  .arg(songs_table_));
+  q.prepare(
+      QString(
+          "SELECT artist, CASE WHEN effective_compilation THEN '' ELSE "
+          "effective_albumartist END, album, COUNT(*), SUM(length) "
+          "FROM %1 WHERE unavailable = 0 GROUP BY 1, 2, 3").arg(songs_table_));
   q.exec();
-  if (db_->CheckErrors(q)) return;
-  if (!q.next()) return;
+  if (db_->CheckErrors(q)) return false;
+
+  statistics_songs_ = 0;
+  statistics_length_nanosec_ = 0;
+  statistics_artists_.clear();
+  statistics_albums_.clear();
+
+  while (q.next()) {
+    const QString artist = q.value(0).toString();
+    const QString album_artist = q.value(1).toString();
+    const QString album = q.value(2).toString();
+    const int songs = q.value(3).toInt();
+
+    statistics_songs_ += songs;
+    statistics_length_nanosec_ += q.value(4).toLongLong();
+    statistics_artists_[artist] += songs;
+    if (!album.isEmpty()) {
+      statistics_albums_[StatisticsAlbumKey(album_artist, album)] += songs;
+    }
+  }
+
+  statistics_loaded_ = true;
+  return true;
+}
+
+QString LibraryBackend::StatisticsAlbumKey(const QString& album_artist,
+                                           const QString& album) {
+  return album_artist + QChar(0) + album;
+}
+
+void LibraryBackend::UpdateStatistics(const SongList& songs, int delta) {
+  if (!statistics_loaded_) return;
+
+  for (const Song& song : songs) {
+    if (song.is_unavailable()) continue;
+
+    statistics_songs_ += delta;
+    statistics_length_nanosec_ += delta * song.length_nanosec();
+
+    if ((statistics_artists_[song.artist()] += delta) <= 0) {
+      statistics_artists_.remove(song.artist());
+    }
+
+    if (song.album().isEmpty()) continue;
+
+    const QString key = StatisticsAlbumKey(
+        song.is_compilation() ? QString() : song.effective_albumartist(),
+        song.album());
+    if ((statistics_albums_[key] += delta) <= 0) {
+      statistics_albums_.remove(key);
+    }
+  }
+}
 
-  emit TotalSongCountUpdated(q.value(0).toInt());
+void LibraryBackend::UpdateDuplicateKeys() {
+  forever {
+    QMutexLocker l(db_->Mutex());
+    QSqlDatabase db(db_->Connect());
+
+    QSqlQuery q(db);
+    q.prepare(QString(
+                  "SELECT ROWID, title, artist, album, length FROM %1"
+                  " WHERE duplicate_key IS NULL LIMIT %2")
+                  .arg(songs_table_)
+                  .arg(kDuplicateKeyBatchSize));
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+
+    QList<QPair<int, qint64>> keys;
+    while (q.next()) {
+      Song song;
+      song.Init(q.value(1).toString(), q.value(2).toString(),
+                q.value(3).toString(), q.value(4).toLongLong());
+      keys << qMakePair(q.value(0).toInt(), song.DuplicateKey());
+    }
+    if (keys.isEmpty()) return;
+
+    QSqlQuery update(db_->PreparedQuery(
+        db, QString("UPDATE %1 SET duplicate_key = :key WHERE ROWID = :id")
+                .arg(songs_table_)));
+
+    ScopedTransaction transaction(&db);
+    for (const QPair<int, qint64>& key : keys) {
+      update.bindValue(":key", key.second);
+      update.bindValue(":id", key.first);
+      update.exec();
+      if (db_->CheckErrors(update)) return;
+    }
+    transaction.Commit();
+  }
+}
+
+qint64 LibraryBackend::ChangeVersion() {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(db);
+  q.prepare("SELECT version FROM library_export_version");
+  q.exec();
+  if (db_->CheckErrors(q) || !q.next()) return -1;
+  return q.value(0).toLongLong();
+}
+
+void LibraryBackend::UpdateSortKeys() {
+  forever {
+    QMutexLocker l(db_->Mutex());
+    QSqlDatabase db(db_->Connect());
+
+    QSqlQuery q(db);
+    q.prepare(QString(
+                  "SELECT ROWID, artist, effective_albumartist, album FROM %1"
+                  " WHERE artist_sort_key IS NULL LIMIT %2")
+                  .arg(songs_table_)
+                  .arg(kDuplicateKeyBatchSize));
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+
+    QList<int> ids;
+    QList<QStringList> keys;
+    while (q.next()) {
+      ids << q.value(0).toInt();
+      keys << (QStringList()
+               << Song::SortTextForArtist(q.value(1).toString())
+               << Song::SortTextForArtist(q.value(2).toString())
+               << Song::SortTextForArtist(q.value(3).toString()));
+    }
+    if (ids.isEmpty()) return;
+
+    QSqlQuery update(db_->PreparedQuery(
+        db, QString("UPDATE %1 SET artist_sort_key = :artist,"
+                    " albumartist_sort_key = :albumartist,"
+                    " album_sort_key = :album WHERE ROWID = :id")
+                .arg(songs_table_)));
+
+    ScopedTransaction transaction(&db);
+    for (int i = 0; i < ids.count(); ++i) {
+      update.bindValue(":artist", keys[i][0]);
+      update.bindValue(":albumartist", keys[i][1]);
+      update.bindValue(":album", keys[i][2]);
+      update.bindValue(":id", ids[i]);
+      update.exec();
+      if (db_->CheckErrors(update)) return;
+    }
+    transaction.Commit();
+  }
 }
 
 void LibraryBackend::AddDirectory(const QString& path) {
@@ -294,6 +604,49 @@ SongList LibraryBackend::FindSongsInDirectory(int id) {
   return ret;
 }
 
+SongList LibraryBackend::FindSongsInSubdirectory(int id, const QString& path) {
+  // Portable installations may store filenames relative to the executable,
+  // so the prefix search below won't find them.
+  if (Application::kIsPortable) {
+    SongList ret;
+    for (const Song& song : FindSongsInDirectory(id)) {
+      if (song.url().toLocalFile().section('/', 0, -2) == path) ret << song;
+    }
+    return ret;
+  }
+
+  // Filenames are stored as encoded URLs, so everything under path sorts
+  // between "path/" and "path0" ('0' comes right after '/').
+  QByteArray prefix = QUrl::fromLocalFile(path).toEncoded();
+  if (!prefix.endsWith('/')) prefix.append('/');
+  QByteArray prefix_end = prefix;
+  prefix_end[prefix_end.size() - 1] = '0';
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(db);
+  q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec +
+                    " FROM %1"
+                    " WHERE filename >= :prefix AND filename < :prefix_end"
+                    " AND directory = :directory").arg(songs_table_));
+  q.bindValue(":prefix", prefix);
+  q.bindValue(":prefix_end", prefix_end);
+  q.bindValue(":directory", id);
+  q.exec();
+  if (db_->CheckErrors(q)) return SongList();
+
+  SongList ret;
+  while (q.next()) {
+    Song song;
+    song.InitFromQuery(q, true);
+
+    // Skip songs in subdirectories of path
+    if (song.url().toLocalFile().section('/', 0, -2) == path) ret << song;
+  }
+  return ret;
+}
+
 void LibraryBackend::SongPathChanged(const Song& song,
                                      const QFileInfo& new_file) {
   // Take a song and update its path
@@ -307,22 +660,21 @@ void LibraryBackend::SongPathChanged(const Song& song,
 void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
-  QSqlQuery find_query(db);
-  find_query.prepare(QString(
-          "SELECT ROWID FROM %1"
-          " WHERE directory = :id AND path = :path").arg(subdirs_table_));
-  QSqlQuery add_query(db);
-  add_query.prepare(QString(
-                          "INSERT INTO %1 (directory, path, mtime)"
-                          " VALUES (:id, :path, :mtime)").arg(subdirs_table_));
-  QSqlQuery update_query(db);
-  update_query.prepare(QString(
-          "UPDATE %1 SET mtime = :mtime"
-          " WHERE directory = :id AND path = :path").arg(subdirs_table_));
-  QSqlQuery delete_query(db);
-  delete_query.prepare(QString(
-          "DELETE FROM %1"
-          " WHERE directory = :id AND path = :path").arg(subdirs_table_));
+  QSqlQuery find_query(db_->PreparedQuery(
+      db, QString("SELECT ROWID FROM %1"
+                  " WHERE directory = :id AND path = :path")
+              .arg(subdirs_table_)));
+  QSqlQuery add_query(db_->PreparedQuery(
+      db, QString("INSERT INTO %1 (directory, path, mtime)"
+                  " VALUES (:id, :path, :mtime)").arg(subdirs_table_)));
+  QSqlQuery update_query(db_->PreparedQuery(
+      db, QString("UPDATE %1 SET mtime = :mtime"
+                  " WHERE directory = :id AND path = :path")
+              .arg(subdirs_table_)));
+  QSqlQuery delete_query(db_->PreparedQuery(
+      db, QString("DELETE FROM %1"
+                  " WHERE directory = :id AND path = :path")
+              .arg(subdirs_table_)));
 
   ScopedTransaction transaction(&db);
   for (const Subdirectory& subdir : subdirs) {
@@ -339,7 +691,10 @@ void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
       find_query.exec();
       if (db_->CheckErrors(find_query)) continue;
 
-      if (find_query.next()) {
+      const bool exists = find_query.next();
+      find_query.finish();
+
+      if (exists) {
         update_query.bindValue(":mtime", subdir.mtime);
         update_query.bindValue(":id", subdir.directory_id);
         update_query.bindValue(":path", subdir.path);
@@ -361,85 +716,164 @@ void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery check_dir(db);
-  check_dir.prepare(QString("SELECT ROWID FROM %1 WHERE ROWID = :id").arg(dirs_table_));
-  QSqlQuery add_song(db);
-  add_song.prepare(QString("INSERT INTO %1 (" + Song::kColumnSpec +
-                             ")"
-                             " VALUES (" +
-                             Song::kBindSpec + ")").arg(songs_table_));
-  QSqlQuery update_song(db);
-  update_song.prepare(QString("UPDATE %1 SET " + Song::kUpdateSpec +
-                                " WHERE ROWID = :id").arg(songs_table_));
-  QSqlQuery add_song_fts(db);
-  add_song_fts.prepare(QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec +
-              ")"
-              " VALUES (:id, " +
-              Song::kFtsBindSpec + ")").arg(fts_table_));
-  QSqlQuery update_song_fts(db);
-  update_song_fts.prepare(QString("UPDATE %1 SET " + Song::kFtsUpdateSpec +
-                                    " WHERE ROWID = :id").arg(fts_table_));
+  QElapsedTimer timer;
+  timer.start();
 
   ScopedTransaction transaction(&db);
 
-  SongList added_songs;
-  SongList deleted_songs;
+  // Do a sanity check first - make sure the songs' directories still exist.
+  // This is to fix a possible race condition when a directory is removed
+  // while LibraryWatcher is scanning it.
+  QSet<int> directory_ids;
+  if (!dirs_table_.isEmpty()) {
+    QSqlQuery check_dirs(db_->PreparedQuery(
+        db, QString("SELECT ROWID FROM %1").arg(dirs_table_)));
+    check_dirs.exec();
+    if (db_->CheckErrors(check_dirs)) return;
+
+    while (check_dirs.next()) directory_ids << check_dirs.value(0).toInt();
+    check_dirs.finish();
+  }
 
+  SongList new_songs;
+  SongList changed_songs;
+  QStringList changed_ids;
   for (const Song& song : songs) {
-    // Do a sanity check first - make sure the song's directory still exists
-    // This is to fix a possible race condition when a directory is removed
-    // while LibraryWatcher is scanning it.
-    if (!dirs_table_.isEmpty()) {
-      check_dir.bindValue(":id", song.directory_id());
-      check_dir.exec();
-      if (db_->CheckErrors(check_dir)) continue;
-
-      if (!check_dir.next()) continue;  // Directory didn't exist
+    if (!dirs_table_.isEmpty() && !directory_ids.contains(song.directory_id())) {
+      continue;  // Directory didn't exist
     }
 
     if (song.id() == -1) {
-      // Create
+      new_songs << song;
+    } else {
+      changed_songs << song;
+      changed_ids << QString::number(song.id());
+    }
+  }
 
-      // Insert the row and create a new ID
-      song.BindToQuery(&add_song);
-      add_song.exec();
-      if (db_->CheckErrors(add_song)) continue;
+  SongList added_songs;
+  SongList deleted_songs;
 
-      // Get the new ID
-      const int id = add_song.lastInsertId().toInt();
+  // The FTS index is updated after all the songs rows have been written.
+  SongList fts_inserts;
+  SongList fts_updates;
+
+  if (!new_songs.isEmpty()) {
+    // Allocate IDs ourselves so several songs can be inserted by each
+    // statement.  We hold the database mutex and are inside a transaction, so
+    // nothing else can take these IDs in the meantime.
+    QSqlQuery max_id(db_->PreparedQuery(
+        db, QString("SELECT MAX(ROWID) FROM %1").arg(songs_table_)));
+    max_id.exec();
+    if (db_->CheckErrors(max_id)) return;
+
+    int next_id = max_id.next() ? max_id.value(0).toInt() + 1 : 1;
+    max_id.finish();
+
+    const int songs_per_insert =
+        qMax(1, kMaxBoundValues / (Song::kColumns.count() + 1));
+
+    for (int i = 0; i < new_songs.count(); i += songs_per_insert) {
+      const int count = qMin(songs_per_insert, new_songs.count() - i);
+      QSqlQuery add_songs(db_->PreparedQuery(
+          db, MultiRowInsertSql(songs_table_, Song::kColumnSpec,
+                                &Song::BindSpec, count)));
+
+      SongList chunk;
+      for (int j = 0; j < count; ++j) {
+        Song copy(new_songs[i + j]);
+        copy.set_id(next_id + j);
+
+        const QString suffix = QString("_%1").arg(j);
+        add_songs.bindValue(":id" + suffix, copy.id());
+        copy.BindToQuery(&add_songs, suffix);
+        chunk << copy;
+      }
 
-      // Add to the FTS index
-      add_song_fts.bindValue(":id", id);
-      song.BindToFtsQuery(&add_song_fts);
-      add_song_fts.exec();
-      if (db_->CheckErrors(add_song_fts)) continue;
+      add_songs.exec();
+      if (db_->CheckErrors(add_songs)) continue;
 
-      Song copy(song);
-      copy.set_id(id);
-      added_songs << copy;
-    } else {
-      // Get the previous song data first
-      Song old_song(GetSongById(song.id()));
+      next_id += count;
+      fts_inserts << chunk;
+      added_songs << chunk;
+    }
+  }
+
+  if (!changed_songs.isEmpty()) {
+    // Get the previous song data first
+    QMap<int, Song> old_songs;
+    for (const Song& old_song : GetSongsById(changed_ids, db)) {
+      old_songs[old_song.id()] = old_song;
+    }
+
+    QSqlQuery update_song(db_->PreparedQuery(
+        db, QString("UPDATE %1 SET " + Song::kUpdateSpec +
+                    " WHERE ROWID = :id").arg(songs_table_)));
+
+    for (const Song& song : changed_songs) {
+      const Song old_song = old_songs.value(song.id());
       if (!old_song.is_valid()) continue;
 
-      // Update
       song.BindToQuery(&update_song);
       update_song.bindValue(":id", song.id());
       update_song.exec();
       if (db_->CheckErrors(update_song)) continue;
 
+      fts_updates << song;
+      deleted_songs << old_song;
+      added_songs << song;
+    }
+  }
+
+  if (!fts_inserts.isEmpty()) {
+    const int songs_per_insert =
+        qMax(1, kMaxBoundValues / (Song::kFtsColumns.count() + 1));
+
+    for (int i = 0; i < fts_inserts.count(); i += songs_per_insert) {
+      const int count = qMin(songs_per_insert, fts_inserts.count() - i);
+      QSqlQuery add_songs_fts(db_->PreparedQuery(
+          db, MultiRowInsertSql(fts_table_, Song::kFtsColumnSpec,
+                                &Song::FtsBindSpec, count)));
+
+      for (int j = 0; j < count; ++j) {
+        const Song& song = fts_inserts[i + j];
+        const QString suffix = QString("_%1").arg(j);
+        add_songs_fts.bindValue(":id" + suffix, song.id());
+        song.BindToFtsQuery(&add_songs_fts, suffix);
+      }
+
+      add_songs_fts.exec();
+      db_->CheckErrors(add_songs_fts);
+    }
+  }
+
+  if (!fts_updates.isEmpty()) {
+    QSqlQuery update_song_fts(db_->PreparedQuery(
+        db, QString("UPDATE %1 SET " + Song::kFtsUpdateSpec +
+                    " WHERE ROWID = :id").arg(fts_table_)));
+
+    for (const Song& song : fts_updates) {
       song.BindToFtsQuery(&update_song_fts);
       update_song_fts.bindValue(":id", song.id());
       update_song_fts.exec();
-      if (db_->CheckErrors(update_song_fts)) continue;
-
-      deleted_songs << old_song;
-      added_songs << song;
+      db_->CheckErrors(update_song_fts);
     }
   }
 
   transaction.Commit();
 
+  MarkCompilationsDirty(deleted_songs);
+  MarkCompilationsDirty(added_songs);
+  UpdateStatistics(deleted_songs, -1);
+  UpdateStatistics(added_songs, 1);
+
+  if (added_songs.count() >= kLogThroughputRows) {
+    const qint64 msec = qMax(qint64(1), timer.elapsed());
+    qLog(Debug) << "Wrote" << added_songs.count() << "songs to" << songs_table_
+                << "in" << msec << "ms -"
+                << added_songs.count() * 1000 / msec << "rows/s";
+  }
+
   if (!deleted_songs.isEmpty()) emit SongsDeleted(deleted_songs);
 
   if (!added_songs.isEmpty()) emit SongsDiscovered(added_songs);
@@ -447,13 +881,26 @@ void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
   UpdateTotalSongCountAsync();
 }
 
+QString LibraryBackend::MultiRowInsertSql(
+    const QString& table, const QString& column_spec,
+    QString (*bind_spec)(const QString& suffix), int rows) {
+  QStringList values;
+  for (int i = 0; i < rows; ++i) {
+    const QString suffix = QString("_%1").arg(i);
+    values << "(:id" + suffix + ", " + bind_spec(suffix) + ")";
+  }
+
+  return QString("INSERT INTO %1 (ROWID, %2) VALUES %3")
+      .arg(table, column_spec, values.join(", "));
+}
+
 void LibraryBackend::UpdateMTimesOnly(const SongList& songs) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery q(db);
-  q.prepare(QString("UPDATE %1 SET mtime = :mtime WHERE ROWID = :id")
-                  .arg(songs_table_));
+  QSqlQuery q(db_->PreparedQuery(
+      db, QString("UPDATE %1 SET mtime = :mtime WHERE ROWID = :id")
+              .arg(songs_table_)));
 
   ScopedTransaction transaction(&db);
   for (const Song& song : songs) {
@@ -469,10 +916,10 @@ void LibraryBackend::DeleteSongs(const SongList& songs) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery remove(db);
-  remove.prepare(QString("DELETE FROM %1 WHERE ROWID = :id").arg(songs_table_));
-  QSqlQuery remove_fts(db);
-  remove_fts.prepare(QString("DELETE FROM %1 WHERE ROWID = :id").arg(fts_table_));
+  QSqlQuery remove(db_->PreparedQuery(
+      db, QString("DELETE FROM %1 WHERE ROWID = :id").arg(songs_table_)));
+  QSqlQuery remove_fts(db_->PreparedQuery(
+      db, QString("DELETE FROM %1 WHERE ROWID = :id").arg(fts_table_)));
 
   ScopedTransaction transaction(&db);
   for (const Song& song : songs) {
@@ -486,11 +933,79 @@ void LibraryBackend::DeleteSongs(const SongList& songs) {
   }
   transaction.Commit();
 
+  MarkCompilationsDirty(songs);
+  UpdateStatistics(songs, -1);
+
   emit SongsDeleted(songs);
 
   UpdateTotalSongCountAsync();
 }
 
+void LibraryBackend::ReplicateSongs(const SongList& songs,
+                                    const QList<int>& deleted_ids) {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QStringList ids;
+  for (const Song& song : songs) ids << QString::number(song.id());
+  for (int id : deleted_ids) ids << QString::number(id);
+
+  ScopedTransaction transaction(&db);
+
+  // The old versions of the songs are deleted first, and reported deleted.
+  const SongList old_songs = GetSongsById(ids, db);
+
+  QSqlQuery remove(db_->PreparedQuery(
+      db, QString("DELETE FROM %1 WHERE ROWID = :id").arg(songs_table_)));
+  QSqlQuery remove_fts(db_->PreparedQuery(
+      db, QString("DELETE FROM %1 WHERE ROWID = :id").arg(fts_table_)));
+  for (const Song& song : old_songs) {
+    remove.bindValue(":id", song.id());
+    remove.exec();
+    db_->CheckErrors(remove);
+
+    remove_fts.bindValue(":id", song.id());
+    remove_fts.exec();
+    db_->CheckErrors(remove_fts);
+  }
+
+  QSqlQuery add(db_->PreparedQuery(
+      db, QString("INSERT INTO %1 (ROWID, " + Song::kColumnSpec +
+                  ") VALUES (:id, " + Song::kBindSpec + ")")
+              .arg(songs_table_)));
+  QSqlQuery add_fts(db_->PreparedQuery(
+      db, QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec +
+                  ") VALUES (:id, " + Song::kFtsBindSpec + ")")
+              .arg(fts_table_)));
+
+  SongList added_songs;
+  for (const Song& song : songs) {
+    song.BindToQuery(&add);
+    add.bindValue(":id", song.id());
+    add.exec();
+    if (db_->CheckErrors(add)) continue;
+
+    song.BindToFtsQuery(&add_fts);
+    add_fts.bindValue(":id", song.id());
+    add_fts.exec();
+    db_->CheckErrors(add_fts);
+
+    added_songs << song;
+  }
+
+  transaction.Commit();
+
+  MarkCompilationsDirty(old_songs);
+  MarkCompilationsDirty(added_songs);
+  UpdateStatistics(old_songs, -1);
+  UpdateStatistics(added_songs, 1);
+
+  if (!old_songs.isEmpty()) emit SongsDeleted(old_songs);
+  if (!added_songs.isEmpty()) emit SongsDiscovered(added_songs);
+
+  UpdateTotalSongCountAsync();
+}
+
 void LibraryBackend::MarkSongsUnavailable(const SongList& songs,
                                           bool unavailable) {
   QMutexLocker l(db_->Mutex());
@@ -509,6 +1024,16 @@ void LibraryBackend::MarkSongsUnavailable(const SongList& songs,
   }
   transaction.Commit();
 
+  MarkCompilationsDirty(songs);
+
+  // The songs passed in might still have their old flag set.
+  SongList counted_songs;
+  for (Song song : songs) {
+    song.set_unavailable(false);
+    counted_songs << song;
+  }
+  UpdateStatistics(counted_songs, unavailable ? -1 : 1);
+
   emit SongsDeleted(songs);
   UpdateTotalSongCountAsync();
 }
@@ -519,7 +1044,7 @@ QStringList LibraryBackend::GetAll(const QString& column,
   query.SetColumnSpec("DISTINCT " + column);
   query.AddCompilationRequirement(false);
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(db_->ReadMutex());
   if (!ExecQuery(&query)) return QStringList();
 
   QStringList ret;
@@ -548,7 +1073,7 @@ QStringList LibraryBackend::GetAllArtistsWithAlbums(const QueryOptions& opt) {
   query2.AddWhere("albumartist", "", "=");
 
   {
-    QMutexLocker l(db_->Mutex());
+    QMutexLocker l(db_->ReadMutex());
     if (!ExecQuery(&query) || !ExecQuery(&query2)) {
       return QStringList();
     }
@@ -597,29 +1122,64 @@ SongList LibraryBackend::GetSongs(const QString& artist, const QString& album,
   return ExecLibraryQuery(&query);
 }
 
-SongList LibraryBackend::ExecLibraryQuery(LibraryQuery* query) {
-  query->SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
-  QMutexLocker l(db_->Mutex());
-  if (!ExecQuery(query)) return SongList();
+namespace {
 
-  SongList ret;
-  while (query->Next()) {
+// Reads "ROWID, Song::kColumnSpec" rows from row, calling next to advance it,
+// and hands them to callback in batches.
+void ReadSongBatches(const QSqlQuery& row, std::function<bool()> next,
+                    const LibraryBackend::SongBatchCallback& callback) {
+  SongList batch;
+  batch.reserve(LibraryBackend::kSongBatchSize);
+
+  while (next()) {
     Song song;
-    song.InitFromQuery(*query, true);
-    ret << song;
+    song.InitFromQuery(row, true);
+    batch << song;
+
+    if (batch.count() >= LibraryBackend::kSongBatchSize) {
+      if (!callback(batch)) return;
+      batch.clear();
+    }
   }
+
+  if (!batch.isEmpty()) callback(batch);
+}
+
+// Adds each batch to songs.
+LibraryBackend::SongBatchCallback AppendTo(SongList* songs) {
+  return [songs](const SongList& batch) {
+    songs->append(batch);
+    return true;
+  };
+}
+
+}  // namespace
+
+SongList LibraryBackend::ExecLibraryQuery(LibraryQuery* query) {
+  SongList ret;
+  ExecLibraryQuery(query, AppendTo(&ret));
   return ret;
 }
 
+bool LibraryBackend::ExecLibraryQuery(LibraryQuery* query,
+                                      const SongBatchCallback& callback) {
+  query->SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
+  QMutexLocker l(db_->ReadMutex());
+  if (!ExecQuery(query)) return false;
+
+  ReadSongBatches(*query, [query]() { return query->Next(); }, callback);
+  return true;
+}
+
 Song LibraryBackend::GetSongById(int id) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectForReading());
   return GetSongById(id, db);
 }
 
 SongList LibraryBackend::GetSongsById(const QList<int>& ids) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectForReading());
 
   QStringList str_ids;
   for (int id : ids) {
@@ -630,8 +1190,8 @@ SongList LibraryBackend::GetSongsById(const QList<int>& ids) {
 }
 
 SongList LibraryBackend::GetSongsById(const QStringList& ids) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectForReading());
 
   return GetSongsById(ids, db);
 }
@@ -639,8 +1199,8 @@ SongList LibraryBackend::GetSongsById(const QStringList& ids) {
 SongList LibraryBackend::GetSongsByForeignId(const QStringList& ids,
                                              const QString& table,
                                              const QString& column) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectForReading());
 
   QString in = ids.join(",");
 
@@ -722,6 +1282,52 @@ SongList LibraryBackend::GetSongsByUrl(const QUrl& url) {
   return songlist;
 }
 
+SongList LibraryBackend::GetSongsByUrls(const QList<QUrl>& urls) {
+  // Each filename is only looked up once, however many times it's listed
+  QList<QByteArray> filenames;
+  QSet<QByteArray> seen;
+  for (const QUrl& url : urls) {
+    const QByteArray filename = url.toEncoded();
+    if (!seen.contains(filename)) {
+      seen.insert(filename);
+      filenames << filename;
+    }
+  }
+
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectForReading());
+
+  // The IN lists are matched with idx_filename, as many at a time as SQLite
+  // lets us bind.
+  SongList ret;
+  for (int i = 0; i < filenames.count(); i += kMaxBoundValues) {
+    const QList<QByteArray> batch = filenames.mid(i, kMaxBoundValues);
+
+    QStringList placeholders;
+    for (int j = 0; j < batch.count(); ++j) {
+      placeholders << "?";
+    }
+
+    QSqlQuery q(db);
+    q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec +
+                      " FROM %1"
+                      " WHERE filename IN (%2) AND unavailable = 0")
+                  .arg(songs_table_, placeholders.join(",")));
+    for (const QByteArray& filename : batch) {
+      q.addBindValue(filename);
+    }
+    q.exec();
+    if (db_->CheckErrors(q)) break;
+
+    while (q.next()) {
+      Song song;
+      song.InitFromQuery(q, true);
+      ret << song;
+    }
+  }
+  return ret;
+}
+
 LibraryBackend::AlbumList LibraryBackend::GetCompilationAlbums(
     const QueryOptions& opt) {
   return GetAlbums(QString(), QString(), true, opt);
@@ -734,7 +1340,7 @@ SongList LibraryBackend::GetCompilationSongs(const QString& album,
   query.AddCompilationRequirement(true);
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(db_->ReadMutex());
   if (!ExecQuery(&query)) return SongList();
 
   SongList ret;
@@ -750,41 +1356,61 @@ void LibraryBackend::UpdateCompilations() {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  // Look for albums that have songs by more than one 'effective album artist'
-  // in the same
-  // directory
+  // Only the directories whose songs changed since last time need looking
+  // at - compilation flags elsewhere are already up to date.
+  if (dirty_compilation_dirs_.isEmpty()) return;
+  const QSet<QByteArray> directories = dirty_compilation_dirs_;
+  dirty_compilation_dirs_.clear();
 
-  QSqlQuery q(db);
-  q.prepare(
-      QString(
-          "SELECT effective_albumartist, album, filename, sampler "
-          "FROM %1 WHERE unavailable = 0 ORDER BY album").arg(songs_table_));
-  q.exec();
-  if (db_->CheckErrors(q)) return;
+  // Look for albums that have songs by more than one 'effective album artist'
+  // in the same directory.  Filenames are encoded URLs, so the songs in a
+  // directory sort between its URL and the same URL with the trailing slash
+  // incremented, which lets the query use idx_filename.
+  QSqlQuery q(db_->PreparedQuery(
+      db, QString("SELECT effective_albumartist, album, filename, sampler "
+                  "FROM %1 "
+                  "WHERE filename >= :first AND filename < :last "
+                  "AND unavailable = 0").arg(songs_table_)));
 
   QMap<QString, CompilationInfo> compilation_info;
-  while (q.next()) {
-    QString artist = q.value(0).toString();
-    QString album = q.value(1).toString();
-    QString filename = q.value(2).toString();
-    bool sampler = q.value(3).toBool();
+  for (const QByteArray& directory : directories) {
+    if (directory.isEmpty()) continue;
 
-    // Ignore songs that don't have an album field set
-    if (album.isEmpty()) continue;
+    QByteArray last(directory);
+    last[last.size() - 1] = last[last.size() - 1] + 1;
 
-    // Find the directory the song is in
-    QUrl url = QUrl::fromEncoded(filename.toUtf8());
-    QString directory =
-        url.toString(QUrl::PreferLocalFile | QUrl::RemoveFilename);
+    q.bindValue(":first", directory);
+    q.bindValue(":last", last);
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+
+    while (q.next()) {
+      QString artist = q.value(0).toString();
+      QString album = q.value(1).toString();
+      QByteArray filename = q.value(2).toByteArray();
+      bool sampler = q.value(3).toBool();
+
+      // Ignore songs that don't have an album field set
+      if (album.isEmpty()) continue;
 
-    CompilationInfo& info = compilation_info[directory + album];
-    info.urls << url;
-    if (!info.artists.contains(artist)) info.artists << artist;
-    if (sampler)
-      ++info.has_samplers;
-    else
-      ++info.has_not_samplers;
+      // Songs in subdirectories are in the range too, but they're only
+      // affected if their own directory changed.
+      QUrl url = QUrl::fromEncoded(filename);
+      if (url.adjusted(QUrl::RemoveFilename).toEncoded() != directory) {
+        continue;
+      }
+
+      CompilationInfo& info =
+          compilation_info[QString::fromUtf8(directory) + album];
+      info.urls << url;
+      if (!info.artists.contains(artist)) info.artists << artist;
+      if (sampler)
+        ++info.has_samplers;
+      else
+        ++info.has_not_samplers;
+    }
   }
+  q.finish();
 
   // Now mark the songs that we think are in compilations
 
@@ -814,12 +1440,22 @@ void LibraryBackend::UpdateCompilations() {
 
   transaction.Commit();
 
+  UpdateStatistics(deleted_songs, -1);
+  UpdateStatistics(added_songs, 1);
+
   if (!deleted_songs.isEmpty()) {
     emit SongsDeleted(deleted_songs);
     emit SongsDiscovered(added_songs);
   }
 }
 
+void LibraryBackend::MarkCompilationsDirty(const SongList& songs) {
+  for (const Song& song : songs) {
+    dirty_compilation_dirs_
+        << song.url().adjusted(QUrl::RemoveFilename).toEncoded();
+  }
+}
+
 void LibraryBackend::UpdateCompilations(const QSqlDatabase& db,
                                         SongList& deleted_songs,
                                         SongList& added_songs, const QUrl& url,
@@ -880,7 +1516,7 @@ LibraryBackend::AlbumList LibraryBackend::GetAlbums(const QString& artist,
   }
 
   {
-    QMutexLocker l(db_->Mutex());
+    QMutexLocker l(db_->ReadMutex());
     if (!ExecQuery(&query)) return ret;
   }
 
@@ -930,7 +1566,7 @@ LibraryBackend::Album LibraryBackend::GetAlbumArt(const QString& artist,
   }
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(db_->ReadMutex());
   if (!ExecQuery(&query)) return ret;
 
   if (query.Next()) {
@@ -1070,35 +1706,114 @@ void LibraryBackend::ForceCompilation(const QString& album,
     }
   }
 
+  UpdateStatistics(deleted_songs, -1);
+  UpdateStatistics(added_songs, 1);
+
   if (!added_songs.isEmpty() || !deleted_songs.isEmpty()) {
     emit SongsDeleted(deleted_songs);
     emit SongsDiscovered(added_songs);
   }
 }
 
+namespace {
+MetricCounter sQueries("clementine_library_queries_total",
+                       "Library queries run.");
+MetricCounter sQuerySeconds("clementine_library_query_seconds_total",
+                            "Time spent running library queries.", 1e-9);
+}  // namespace
+
 bool LibraryBackend::ExecQuery(LibraryQuery* q) {
-  return !db_->CheckErrors(q->Exec(db_->Connect(), songs_table_, fts_table_));
+  PerfTrace::Scope trace("LibraryBackend::ExecQuery");
+  q->SetExplainQueryPlan(db_->tuning_profile().explain_queries);
+
+  QElapsedTimer timer;
+  timer.start();
+  const QSqlQuery& query =
+      q->Exec(db_->ConnectForReading(), songs_table_, fts_table_);
+  sQueries.Add();
+  sQuerySeconds.Add(timer.nsecsElapsed());
+
+  // A cancelled query fails with SQLITE_INTERRUPT, which isn't worth logging.
+  if (q->is_cancelled()) return false;
+  return !db_->CheckErrors(query);
 }
 
 SongList LibraryBackend::FindSongs(const smart_playlists::Search& search) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  SongList ret;
+  FindSongs(search, AppendTo(&ret));
+  return ret;
+}
+
+namespace {
+// Lets cancel interrupt whatever db is running until this goes out of scope.
+class ScopedInterruptFlag {
+ public:
+  ScopedInterruptFlag(const QSqlDatabase& db,
+                      const LibraryQuery::CancelFlag& cancel)
+      : db_(db), set_(cancel != nullptr) {
+    if (set_) Database::SetInterruptFlag(db_, cancel.get());
+  }
+  ~ScopedInterruptFlag() {
+    if (set_) Database::SetInterruptFlag(db_, nullptr);
+  }
+
+ private:
+  QSqlDatabase db_;
+  bool set_;
+};
+}  // namespace
+
+bool LibraryBackend::FindSongs(const smart_playlists::Search& search,
+                               const SongBatchCallback& callback,
+                               const LibraryQuery::CancelFlag& cancel) {
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectForReading());
+  ScopedInterruptFlag interrupt(db, cancel);
 
   // Build the query
   QString sql = search.ToSql(songs_table());
 
   // Run the query
-  SongList ret;
   QSqlQuery query(db);
+  query.setForwardOnly(true);
   query.prepare(sql);
   query.exec();
-  if (db_->CheckErrors(query)) return ret;
+  // A cancelled query fails with SQLITE_INTERRUPT, which isn't worth logging.
+  if (cancel && cancel->load()) return false;
+  if (db_->CheckErrors(query)) return false;
 
   // Read the results
+  ReadSongBatches(query, [&query]() { return query.next(); }, callback);
+  return !(cancel && cancel->load());
+}
+
+int LibraryBackend::CountSongs(const smart_playlists::Search& search,
+                               const LibraryQuery::CancelFlag& cancel) {
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectForReading());
+  ScopedInterruptFlag interrupt(db, cancel);
+
+  QSqlQuery query(db);
+  query.prepare(search.ToCountSql(songs_table()));
+  query.exec();
+  if (cancel && cancel->load()) return -1;
+  if (db_->CheckErrors(query) || !query.next()) return -1;
+  return query.value(0).toInt();
+}
+
+QList<int> LibraryBackend::FindSongIds(
+    const smart_playlists::Search& search) {
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectForReading());
+
+  QList<int> ret;
+  QSqlQuery query(db);
+  query.prepare(search.ToIdSql(songs_table()));
+  query.exec();
+  if (db_->CheckErrors(query)) return ret;
+
   while (query.next()) {
-    Song song;
-    song.InitFromQuery(query, true);
-    ret << song;
+    ret << query.value(0).toInt();
   }
   return ret;
 }
@@ -1111,66 +1826,262 @@ SongList LibraryBackend::GetAllSongs() {
       smart_playlists::SearchTerm::Field_Artist, -1));
 }
 
-void LibraryBackend::IncrementPlayCount(int id) {
-  if (id == -1) return;
+QList<int> LibraryBackend::GetAllSongIds() {
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectForReading());
+
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  q.prepare(QString("SELECT ROWID FROM %1").arg(songs_table_));
+  q.exec();
+  if (db_->CheckErrors(q)) return QList<int>();
+
+  QList<int> ret;
+  while (q.next()) ret << q.value(0).toInt();
+  return ret;
+}
 
+bool LibraryBackend::GetAllSongs(const SongBatchCallback& callback) {
+  // Each batch is a separate query that carries on from the last ID seen, so
+  // no cursor or lock is held while callback runs.
+  int last_id = -1;
+  forever {
+    SongList batch;
+    {
+      QMutexLocker l(db_->ReadMutex());
+      QSqlDatabase db(db_->ConnectForReading());
+
+      QSqlQuery q(db);
+      q.setForwardOnly(true);
+      q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec +
+                        " FROM %1"
+                        " WHERE ROWID > :last_id AND unavailable = 0"
+                        " ORDER BY ROWID LIMIT %2")
+                    .arg(songs_table_)
+                    .arg(kSongBatchSize));
+      q.bindValue(":last_id", last_id);
+      q.exec();
+      if (db_->CheckErrors(q)) return false;
+
+      ReadSongBatches(q, [&q]() { return q.next(); }, AppendTo(&batch));
+    }
+
+    if (batch.isEmpty()) break;
+    last_id = batch.last().id();
+    if (!callback(batch) || batch.count() < kSongBatchSize) break;
+  }
+  return true;
+}
+
+QList<SongList> LibraryBackend::GetDuplicateSongs() {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
+  // Both halves of this walk the duplicate_key index instead of comparing
+  // every song with every other one.
   QSqlQuery q(db);
   q.prepare(QString(
-                  "UPDATE %1 SET playcount = playcount + 1,"
-                  "              lastplayed = :now,"
-                  "              score = " +
-                  QString(kNewScoreSql).arg("1.0") +
-                  " WHERE ROWID = :id").arg(songs_table_));
-  q.bindValue(":now", QDateTime::currentDateTime().toTime_t());
-  q.bindValue(":id", id);
+                "SELECT ROWID, " + Song::kColumnSpec + " FROM %1"
+                " WHERE unavailable = 0 AND duplicate_key IN ("
+                "   SELECT duplicate_key FROM %1"
+                "    WHERE duplicate_key != 0 AND unavailable = 0"
+                "    GROUP BY duplicate_key HAVING COUNT(*) > 1)"
+                " ORDER BY duplicate_key, ROWID")
+                .arg(songs_table_));
   q.exec();
-  if (db_->CheckErrors(q)) return;
+  if (db_->CheckErrors(q)) return QList<SongList>();
+
+  const int key_column = Song::kColumns.indexOf("duplicate_key") + 1;
+
+  QList<SongList> ret;
+  qint64 last_key = 0;
+  while (q.next()) {
+    const qint64 key = q.value(key_column).toLongLong();
+    if (ret.isEmpty() || key != last_key) ret << SongList();
+    last_key = key;
 
-  Song new_song = GetSongById(id, db);
-  emit SongsStatisticsChanged(SongList() << new_song);
+    Song song;
+    song.InitFromQuery(q, true);
+    ret.last() << song;
+  }
+  return ret;
 }
 
-void LibraryBackend::IncrementSkipCount(int id, float progress) {
-  if (id == -1) return;
-  progress = qBound(0.0f, progress, 1.0f);
+namespace {
 
+const char* kWithoutReplayGainWhere =
+    "track_peak IS NULL AND unavailable = 0 AND"
+    " (cue_path IS NULL OR cue_path = '')";
+
+}  // namespace
+
+SongList LibraryBackend::GetSongsWithoutReplayGain(int after_id, int limit) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(db);
-  q.prepare(QString(
-                  "UPDATE %1 SET skipcount = skipcount + 1,"
-                  "              score = " +
-                  QString(kNewScoreSql).arg(progress) +
-                  " WHERE ROWID = :id").arg(songs_table_));
-  q.bindValue(":id", id);
+  q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec +
+                    " FROM %1 WHERE ROWID > :id AND %2"
+                    " ORDER BY ROWID LIMIT %3")
+                .arg(songs_table_, kWithoutReplayGainWhere)
+                .arg(limit));
+  q.bindValue(":id", after_id);
   q.exec();
-  if (db_->CheckErrors(q)) return;
+  if (db_->CheckErrors(q)) return SongList();
+
+  SongList ret;
+  while (q.next()) {
+    Song song;
+    song.InitFromQuery(q, true);
+    ret << song;
+  }
+  return ret;
+}
+
+int LibraryBackend::CountSongsWithoutReplayGain() {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(db);
+  q.prepare(QString("SELECT COUNT(*) FROM %1 WHERE %2")
+                .arg(songs_table_, kWithoutReplayGainWhere));
+  q.exec();
+  if (db_->CheckErrors(q) || !q.next()) return 0;
+
+  return q.value(0).toInt();
+}
+
+void LibraryBackend::UpdateReplayGain(const SongList& songs) {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(db_->PreparedQuery(
+      db, QString("UPDATE %1 SET track_gain = :track_gain,"
+                  " track_peak = :track_peak, album_gain = :album_gain,"
+                  " album_peak = :album_peak WHERE ROWID = :id")
+              .arg(songs_table_)));
+
+  ScopedTransaction transaction(&db);
+  for (const Song& song : songs) {
+    q.bindValue(":track_gain", song.has_track_gain()
+                                   ? QVariant(song.track_gain())
+                                   : QVariant());
+    q.bindValue(":track_peak", song.has_track_gain()
+                                   ? QVariant(song.track_peak())
+                                   : QVariant());
+    q.bindValue(":album_gain", song.has_album_gain()
+                                   ? QVariant(song.album_gain())
+                                   : QVariant());
+    q.bindValue(":album_peak", song.has_album_gain()
+                                   ? QVariant(song.album_peak())
+                                   : QVariant());
+    q.bindValue(":id", song.id());
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+  }
+  transaction.Commit();
+}
+
+void LibraryBackend::IncrementPlayCount(int id) {
+  if (id == -1) return;
+
+  PendingStatisticsMap pending;
+  pending[id].events_ << StatisticsEvent{true, 1.0f};
+  WriteStatistics(pending);
+}
+
+void LibraryBackend::IncrementSkipCount(int id, float progress) {
+  if (id == -1) return;
 
-  Song new_song = GetSongById(id, db);
-  emit SongsStatisticsChanged(SongList() << new_song);
+  PendingStatisticsMap pending;
+  pending[id].events_ << StatisticsEvent{false, qBound(0.0f, progress, 1.0f)};
+  WriteStatistics(pending);
 }
 
 void LibraryBackend::ResetStatistics(int id) {
   if (id == -1) return;
 
+  PendingStatisticsMap pending;
+  pending[id].reset_ = true;
+  WriteStatistics(pending);
+}
+
+void LibraryBackend::WriteStatistics(const PendingStatisticsMap& pending) {
+  if (pending.isEmpty()) return;
+
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
+  ScopedTransaction transaction(&db);
 
-  QSqlQuery q(db);
-  q.prepare(QString(
-                  "UPDATE %1 SET playcount = 0, skipcount = 0,"
-                  "              lastplayed = -1, score = 0"
-                  " WHERE ROWID = :id").arg(songs_table_));
-  q.bindValue(":id", id);
-  q.exec();
-  if (db_->CheckErrors(q)) return;
+  QSqlQuery reset(db);
+  reset.prepare(QString(
+                    "UPDATE %1 SET playcount = 0, skipcount = 0,"
+                    "              lastplayed = -1, score = 0"
+                    " WHERE ROWID = :id").arg(songs_table_));
+  QSqlQuery play(db);
+  play.prepare(QString(
+                   "UPDATE %1 SET playcount = playcount + 1,"
+                   "              lastplayed = :now,"
+                   "              score = " +
+                   QString(kNewScoreSql).arg("1.0") +
+                   " WHERE ROWID = :id").arg(songs_table_));
+  QSqlQuery rate(db);
+  rate.prepare(QString("UPDATE %1 SET rating = :rating WHERE ROWID = :id")
+                   .arg(songs_table_));
+
+  const uint now = QDateTime::currentDateTime().toTime_t();
+  QStringList statistics_ids;
+  QStringList rating_ids;
+
+  for (auto it = pending.begin(); it != pending.end(); ++it) {
+    const int id = it.key();
+
+    if (it->reset_) {
+      reset.bindValue(":id", id);
+      reset.exec();
+      if (db_->CheckErrors(reset)) return;
+    }
 
-  Song new_song = GetSongById(id, db);
-  emit SongsStatisticsChanged(SongList() << new_song);
+    for (const StatisticsEvent& event : it->events_) {
+      if (event.played_) {
+        play.bindValue(":now", now);
+        play.bindValue(":id", id);
+        play.exec();
+        if (db_->CheckErrors(play)) return;
+      } else {
+        QSqlQuery skip(db);
+        skip.prepare(QString(
+                         "UPDATE %1 SET skipcount = skipcount + 1,"
+                         "              score = " +
+                         QString(kNewScoreSql).arg(event.progress_) +
+                         " WHERE ROWID = :id").arg(songs_table_));
+        skip.bindValue(":id", id);
+        skip.exec();
+        if (db_->CheckErrors(skip)) return;
+      }
+    }
+
+    if (it->has_rating_) {
+      rate.bindValue(":rating", it->rating_);
+      rate.bindValue(":id", id);
+      rate.exec();
+      if (db_->CheckErrors(rate)) return;
+      rating_ids << QString::number(id);
+    }
+
+    if (it->reset_ || !it->events_.isEmpty()) {
+      statistics_ids << QString::number(id);
+    }
+  }
+
+  transaction.Commit();
+
+  if (!statistics_ids.isEmpty()) {
+    emit SongsStatisticsChanged(GetSongsById(statistics_ids, db));
+  }
+  if (!rating_ids.isEmpty()) {
+    emit SongsRatingChanged(GetSongsById(rating_ids, db));
+  }
 }
 
 void LibraryBackend::UpdateSongRating(int id, float rating) {
@@ -1219,6 +2130,7 @@ void LibraryBackend::DeleteAll() {
     if (db_->CheckErrors(q)) return;
 
     t.Commit();
+    statistics_loaded_ = false;
   }
 
   emit DatabaseReset();
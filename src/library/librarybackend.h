@@ -18,16 +18,26 @@
 #ifndef LIBRARYBACKEND_H
 #define LIBRARYBACKEND_H
 
+#include <QHash>
+#include <QMap>
+#include <QMutex>
 #include <QObject>
 #include <QSet>
 #include <QUrl>
 #include <QFileInfo>
 
+#include <atomic>
+#include <functional>
+
 #include "directory.h"
+#include "librarychanges.h"
 #include "libraryquery.h"
+#include "songcache.h"
+#include "tagcompletioncache.h"
 #include "core/song.h"
 
 class Database;
+class QTimer;
 
 namespace smart_playlists {
 class Search;
@@ -117,10 +127,14 @@ class LibraryBackendInterface : public QObject {
   // Using default beginning value is suitable when searching for single-section
   // songs.
   virtual Song GetSongByUrl(const QUrl& url, qint64 beginning = 0) = 0;
+  // Returns all sections of all the songs with any of the given filenames,
+  // using as few queries as possible.
+  virtual SongList GetSongsByUrls(const QList<QUrl>& urls) = 0;
 
   virtual void AddDirectory(const QString& path) = 0;
   virtual void RemoveDirectory(int dir_id) = 0;
 
+  // Returns false if the query failed, or was stopped by its cancel flag.
   virtual bool ExecQuery(LibraryQuery* q) = 0;
 };
 
@@ -147,7 +161,38 @@ class LibraryBackend : public LibraryBackendInterface {
   // Counts the songs in the library.  Emits TotalSongCountUpdated
   void UpdateTotalSongCountAsync();
 
+  // Counts of the available songs in the library.  These are kept up to date
+  // as songs are written, so only the first call reads the songs table.
+  struct Statistics {
+    Statistics() : songs(0), artists(0), albums(0), length_nanosec(0) {}
+
+    int songs;
+    int artists;
+    int albums;
+    qint64 length_nanosec;
+  };
+  Statistics GetStatistics();
+
+  // Library songs loaded by the library view and playlists go through here so
+  // they share one copy each.
+  SongCache* song_cache() { return &song_cache_; }
+  // Values for the playlist's tag editors to complete from.
+  TagCompletionCache* tag_completion_cache() { return &tag_completion_cache_; }
+
+  // A number that goes up whenever the main library's songs table changes,
+  // or -1 if it can't be read.
+  qint64 ChangeVersion();
+
+  // Fills in the duplicate keys of songs saved before they were stored.
+  void UpdateDuplicateKeysAsync();
+  // Fills in the sort keys of songs saved before they were stored.
+  void UpdateSortKeysAsync();
+
   SongList FindSongsInDirectory(int id);
+  // Returns the songs in the directory whose files are directly inside path,
+  // not in any of its subdirectories.  Uses the filename index, so it's much
+  // cheaper than FindSongsInDirectory when only a few paths are needed.
+  SongList FindSongsInSubdirectory(int id, const QString& path);
   SubdirectoryList SubdirsInDirectory(int id);
   DirectoryList GetAllDirectories();
   void ChangeDirPath(int id, const QString& old_path, const QString& new_path);
@@ -185,15 +230,56 @@ class LibraryBackend : public LibraryBackendInterface {
 
   SongList GetSongsByUrl(const QUrl& url);
   Song GetSongByUrl(const QUrl& url, qint64 beginning = 0);
+  SongList GetSongsByUrls(const QList<QUrl>& urls);
 
   void AddDirectory(const QString& path);
   void RemoveDirectory(int dir_id);
 
+  // Receives the results of a query kSongBatchSize songs at a time.  Return
+  // false to stop reading early.
+  typedef std::function<bool(const SongList&)> SongBatchCallback;
+  static const int kSongBatchSize;
+
   bool ExecQuery(LibraryQuery* q);
   SongList ExecLibraryQuery(LibraryQuery* query);
   SongList FindSongs(const smart_playlists::Search& search);
+  // Like FindSongs but only returns the IDs, unsorted.
+  QList<int> FindSongIds(const smart_playlists::Search& search);
   SongList GetAllSongs();
-
+  // Every song's ID, available or not.
+  QList<int> GetAllSongIds();
+
+  // Streaming versions of the above that read from an open cursor instead of
+  // building one big list.  ExecLibraryQuery and FindSongs hold the read lock
+  // while callback runs, so keep it quick.  GetAllSongs releases the database
+  // between batches and returns the songs ordered by ID, so its callback can
+  // take as long as it likes.  Each returns false if the query failed.
+  bool ExecLibraryQuery(LibraryQuery* query, const SongBatchCallback& callback);
+  // Setting cancel makes FindSongs stop and return false.
+  bool FindSongs(const smart_playlists::Search& search,
+                 const SongBatchCallback& callback,
+                 const LibraryQuery::CancelFlag& cancel =
+                     LibraryQuery::CancelFlag());
+  // Returns the number of songs matching search, ignoring its limit, or -1 if
+  // the query failed or was cancelled.
+  int CountSongs(const smart_playlists::Search& search,
+                 const LibraryQuery::CancelFlag& cancel =
+                     LibraryQuery::CancelFlag());
+  bool GetAllSongs(const SongBatchCallback& callback);
+  // Returns each set of available songs that share a Song::DuplicateKey.
+  QList<SongList> GetDuplicateSongs();
+
+  // Returns up to limit available songs with IDs above after_id that don't
+  // have a track gain yet, ordered by ID.  Songs from cue sheets share a file
+  // with others and are left out.
+  SongList GetSongsWithoutReplayGain(int after_id, int limit);
+  int CountSongsWithoutReplayGain();
+  // Saves only the ReplayGain values of the songs.
+  void UpdateReplayGain(const SongList& songs);
+
+  // These are held for kStatisticsFlushDelayMsec and then written together in
+  // one transaction, so a burst of them doesn't mean a burst of commits.
+  static const int kStatisticsFlushDelayMsec;
   void IncrementPlayCountAsync(int id);
   void IncrementSkipCountAsync(int id, float progress);
   void ResetStatisticsAsync(int id);
@@ -205,11 +291,19 @@ class LibraryBackend : public LibraryBackendInterface {
  public slots:
   void LoadDirectories();
   void UpdateTotalSongCount();
+  void UpdateDuplicateKeys();
+  void UpdateSortKeys();
   void AddOrUpdateSongs(const SongList& songs);
   void UpdateMTimesOnly(const SongList& songs);
   void DeleteSongs(const SongList& songs);
+  // Writes songs copied from another Clementine's library with the IDs they
+  // had there, replacing any songs with the same IDs, and deletes
+  // deleted_ids.  Only for libraries that are nothing but the copy.
+  void ReplicateSongs(const SongList& songs, const QList<int>& deleted_ids);
   void MarkSongsUnavailable(const SongList& songs, bool unavailable = true);
   void AddOrUpdateSubdirs(const SubdirectoryList& subdirs);
+  // Recomputes the sampler flags of albums in directories whose songs were
+  // added, changed or removed since the last call.
   void UpdateCompilations();
   void UpdateManualAlbumArt(const QString& artist, const QString& albumartist,
                             const QString& album, const QString& art);
@@ -220,9 +314,22 @@ class LibraryBackend : public LibraryBackendInterface {
   void ResetStatistics(int id);
   void UpdateSongRating(int id, float rating);
   void UpdateSongsRating(const QList<int>& id_list, float rating);
+  // Writes the statistics and ratings changes that are being held back.
+  void FlushStatistics();
   // Tells the library model that a song path has changed
   void SongPathChanged(const Song& song, const QFileInfo& new_file);
 
+ private slots:
+  void UpdateSongCache(const SongList& songs);
+  void ClearSongCache();
+  void AddTagCompletions(const SongList& songs);
+  void RemoveTagCompletions(const SongList& songs);
+  void ClearTagCompletions();
+  void PublishDiscovered(const SongList& songs);
+  void PublishDeleted(const SongList& songs);
+  void PublishStatistics(const SongList& songs);
+  void PublishRating(const SongList& songs);
+
 signals:
   void DirectoryDiscovered(const Directory& dir,
                            const SubdirectoryList& subdirs);
@@ -232,6 +339,9 @@ signals:
   void SongsDeleted(const SongList& songs);
   void SongsStatisticsChanged(const SongList& songs);
   void SongsRatingChanged(const SongList& songs);
+  // Sent along with each of the four signals above.  Connect to this instead
+  // when only the IDs are needed, or only some of the songs.
+  void SongsChanged(const LibraryChanges& changes);
   void DatabaseReset();
 
   void TotalSongCountUpdated(int total);
@@ -247,8 +357,56 @@ signals:
     int has_not_samplers;
   };
 
+  // A play, or a skip and how far through the song it got.
+  struct StatisticsEvent {
+    bool played_;
+    float progress_;
+  };
+
+  // Changes to one song that haven't been written yet.
+  struct PendingStatistics {
+    PendingStatistics() : reset_(false), has_rating_(false), rating_(0) {}
+
+    // Whether the statistics are reset before events_ are counted.
+    bool reset_;
+    QList<StatisticsEvent> events_;
+    bool has_rating_;
+    float rating_;
+  };
+  typedef QMap<int, PendingStatistics> PendingStatisticsMap;
+
   static const char* kNewScoreSql;
 
+  // SQLite's default limit on the number of values bound to one statement.
+  static const int kMaxBoundValues;
+
+  void PublishChanges(const SongList& songs, LibraryChanges::Change change);
+
+  // Calls that write at least this many songs log their throughput.
+  static const int kLogThroughputRows;
+
+  // UpdateDuplicateKeys and UpdateSortKeys release the database between
+  // batches of this many.
+  static const int kDuplicateKeyBatchSize;
+
+  // Builds a statement that inserts rows into table in one go.  Each row's
+  // placeholders are given the suffix "_<row>" - bind them with
+  // Song::BindToQuery(query, suffix) and ":id_<row>".
+  static QString MultiRowInsertSql(const QString& table,
+                                   const QString& column_spec,
+                                   QString (*bind_spec)(const QString& suffix),
+                                   int rows);
+
+  // Remembers the directories of these songs for the next
+  // UpdateCompilations().  Call with the database mutex held.
+  void MarkCompilationsDirty(const SongList& songs);
+  // Reads the statistics from the songs table if they haven't been already.
+  // Call with the database mutex held.
+  bool LoadStatistics(QSqlDatabase& db);
+  // Adds (delta = 1) or removes (delta = -1) these songs from the statistics.
+  void UpdateStatistics(const SongList& songs, int delta);
+  static QString StatisticsAlbumKey(const QString& album_artist,
+                                    const QString& album);
   void UpdateCompilations(const QSqlDatabase& db, SongList& deleted_songs,
                           SongList& added_songs, const QUrl& url,
                           const bool sampler);
@@ -258,6 +416,13 @@ signals:
   SubdirectoryList SubdirsInDirectory(int id, QSqlDatabase& db);
 
   Song GetSongById(int id, QSqlDatabase& db);
+  // Applies change to the pending statistics of each song and makes sure
+  // they'll be written soon.
+  void QueueStatistics(const QList<int>& ids,
+                       const std::function<void(PendingStatistics*)>& change);
+  // Writes the changes in one transaction, then emits SongsStatisticsChanged
+  // and SongsRatingChanged once each.
+  void WriteStatistics(const PendingStatisticsMap& pending);
   SongList GetSongsById(const QStringList& ids, QSqlDatabase& db);
 
  private:
@@ -268,6 +433,25 @@ signals:
   QString fts_table_;
   bool save_statistics_in_file_;
   bool save_ratings_in_file_;
+
+  // Encoded URLs of directories, with a trailing slash.
+  QSet<QByteArray> dirty_compilation_dirs_;
+
+  bool statistics_loaded_;
+  int statistics_songs_;
+  qint64 statistics_length_nanosec_;
+  // Artist, or album artist and album -> number of songs
+  QHash<QString, int> statistics_artists_;
+  QHash<QString, int> statistics_albums_;
+
+  SongCache song_cache_;
+  TagCompletionCache tag_completion_cache_;
+  std::atomic<quint64> changes_sequence_;
+
+  QMutex pending_statistics_mutex_;
+  PendingStatisticsMap pending_statistics_;
+  bool statistics_flush_scheduled_;
+  QTimer* statistics_flush_timer_;
 };
 
 #endif  // LIBRARYBACKEND_H
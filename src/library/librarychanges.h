@@ -0,0 +1,62 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARYCHANGES_H
+#define LIBRARYCHANGES_H
+
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+
+// Which songs in the library changed and how, without the songs themselves.
+// It's much cheaper to send to lots of subscribers than a SongList, and each
+// one can fetch just the songs it cares about from the backend.
+struct LibraryChanges {
+  enum Change {
+    // Added, or changed and written again.
+    Change_Discovered = 0x01,
+    Change_Deleted = 0x02,
+    Change_Statistics = 0x04,
+    Change_Rating = 0x08,
+  };
+
+  LibraryChanges() : sequence(0) {}
+
+  // Whether any song had any of the changes in mask.
+  bool contains(int mask) const {
+    for (int changes : songs) {
+      if (changes & mask) return true;
+    }
+    return false;
+  }
+
+  // The songs that had any of the changes in mask.
+  QList<int> ids(int mask) const {
+    QList<int> ret;
+    for (auto it = songs.begin(); it != songs.end(); ++it) {
+      if (it.value() & mask) ret << it.key();
+    }
+    return ret;
+  }
+
+  // Goes up by one with each set a backend publishes.
+  quint64 sequence;
+  // Song ID -> Change flags.
+  QHash<int, int> songs;
+};
+Q_DECLARE_METATYPE(LibraryChanges)
+
+#endif  // LIBRARYCHANGES_H
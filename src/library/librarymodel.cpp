@@ -19,15 +19,19 @@
 
 #include <algorithm>
 #include <functional>
+#include <memory>
 
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QFuture>
-#include <QIODevice>
 #include <QMetaEnum>
-#include <QNetworkCacheMetaData>
-#include <QNetworkDiskCache>
 #include <QPixmapCache>
 #include <QSettings>
 #include <QStringList>
+#include <QTimer>
 #include <QUrl>
 #include <QtConcurrentRun>
 
@@ -38,6 +42,8 @@
 #include "core/application.h"
 #include "core/database.h"
 #include "core/logging.h"
+#include "core/memoryaccounting.h"
+#include "core/perftrace.h"
 #include "core/taskmanager.h"
 #include "core/utilities.h"
 #include "covers/albumcoverloader.h"
@@ -62,7 +68,18 @@ const char* LibraryModel::kSmartPlaylistsSettingsGroup =
 const char* LibraryModel::kSavedGroupingsSettingsGroup = "SavedGroupings";
 const int LibraryModel::kSmartPlaylistsVersion = 4;
 const int LibraryModel::kPrettyCoverSize = 32;
-const qint64 LibraryModel::kIconCacheSize = 100000000;  //~100MB
+const int LibraryModel::kPageSize = 1000;
+const int LibraryModel::kBatchChangesThreshold = 50;
+const int LibraryModel::kBatchChangesMsec = 250;
+const int LibraryModel::kMaxPendingArt = 100;
+const QStringList LibraryModel::kAlbumIconColumns = QStringList()
+    << "artist"
+    << "album"
+    << "filename"
+    << "art_automatic"
+    << "art_manual";
+const quint32 LibraryModel::kSnapshotMagic = 0x4c4d534e;  // "LMSN"
+const quint32 LibraryModel::kSnapshotVersion = 1;
 
 static bool IsArtistGroupBy(const LibraryModel::GroupBy by) {
   return by == LibraryModel::GroupBy_Artist ||
@@ -81,17 +98,24 @@ LibraryModel::LibraryModel(std::shared_ptr<LibraryBackend> backend,
       show_smart_playlists_(false),
       show_various_artists_(true),
       total_song_count_(0),
+      pending_changes_timer_(new QTimer(this)),
       artist_icon_(IconLoader::Load("x-clementine-artist", IconLoader::Base)),
       album_icon_(IconLoader::Load("x-clementine-album", IconLoader::Base)),
       playlists_dir_icon_(IconLoader::Load("folder-sound", IconLoader::Base)),
       playlist_icon_(IconLoader::Load("x-clementine-albums", IconLoader::Base)),
-      icon_cache_(new QNetworkDiskCache(this)),
       thread_pool_(this),
       init_task_id_(-1),
+      snapshot_tried_(false),
+      snapshot_version_(-1),
       use_pretty_covers_(false),
       show_dividers_(true) {
   root_->lazy_loaded = true;
 
+  pending_changes_timer_->setSingleShot(true);
+  pending_changes_timer_->setInterval(kBatchChangesMsec);
+  connect(pending_changes_timer_, SIGNAL(timeout()),
+          SLOT(ApplyPendingChanges()));
+
   group_by_[0] = GroupBy_AlbumArtist;
   group_by_[1] = GroupBy_Album;
   group_by_[2] = GroupBy_None;
@@ -99,14 +123,11 @@ LibraryModel::LibraryModel(std::shared_ptr<LibraryBackend> backend,
   cover_loader_options_.desired_height_ = kPrettyCoverSize;
   cover_loader_options_.pad_output_image_ = true;
   cover_loader_options_.scale_output_image_ = true;
+  cover_loader_options_.scaled_decode_ = true;
 
   connect(app_->album_cover_loader(), SIGNAL(ImageLoaded(quint64, QImage)),
           SLOT(AlbumArtLoaded(quint64, QImage)));
 
-  icon_cache_->setCacheDirectory(
-      Utilities::GetConfigPath(Utilities::Path_PixmapCache));
-  icon_cache_->setMaximumCacheSize(LibraryModel::kIconCacheSize);
-
   QIcon nocover = IconLoader::Load("nocover", IconLoader::Other);
   no_cover_icon_ = nocover.pixmap(nocover.availableSizes().last()).scaled(
                            kPrettyCoverSize, kPrettyCoverSize,
@@ -126,6 +147,30 @@ LibraryModel::LibraryModel(std::shared_ptr<LibraryBackend> backend,
           SLOT(TotalSongCountUpdatedSlot(int)));
 
   backend_->UpdateTotalSongCountAsync();
+
+  MemoryAccounting::Instance()->Register(
+      this, "library_model", "Library tree items",
+      [this]() { return EstimateMemoryUsage(); });
+}
+
+qint64 LibraryModel::EstimateMemoryUsage() const {
+  qint64 items = 0;
+  QList<const LibraryItem*> stack;
+  stack << root_;
+  while (!stack.isEmpty()) {
+    const LibraryItem* item = stack.takeLast();
+    items++;
+    for (const LibraryItem* child : item->children) stack << child;
+  }
+
+  qint64 rows = 0;
+  for (const PendingChildren& pending : pending_children_) {
+    rows += pending.rows.count() - pending.next_row;
+  }
+
+  // Every item carries a Song, even containers.
+  return (items + rows) *
+         (sizeof(LibraryItem) + MemoryAccounting::kEstimatedSongBytes);
 }
 
 LibraryModel::~LibraryModel() {
@@ -147,6 +192,14 @@ void LibraryModel::set_show_dividers(bool show_dividers) {
   }
 }
 
+void LibraryModel::set_snapshot_filename(const QString& filename) {
+  if (snapshot_filename_.isEmpty()) {
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()),
+            SLOT(SaveSnapshot()));
+  }
+  snapshot_filename_ = filename;
+}
+
 void LibraryModel::SaveGrouping(QString name) {
   qLog(Debug) << "Model, save to: " << name;
 
@@ -179,6 +232,153 @@ void LibraryModel::Init(bool async) {
 }
 
 void LibraryModel::SongsDiscovered(const SongList& songs) {
+  for (const Song& song : songs) {
+    pending_discovered_[song.id()] = song;
+  }
+  ScheduleChanges(songs.count());
+}
+
+void LibraryModel::ScheduleChanges(int count) {
+  // A small change on its own is applied straight away.  Anything bigger, or
+  // anything that arrives while a batch is waiting, is merged into that batch.
+  if (pending_changes_timer_->isActive()) return;
+
+  if (count < kBatchChangesThreshold) {
+    ApplyPendingChanges();
+  } else {
+    pending_changes_timer_->start();
+  }
+}
+
+void LibraryModel::ApplyPendingChanges() {
+  pending_changes_timer_->stop();
+
+  SongList added;
+  for (const Song& song : pending_discovered_) {
+    // A song that was deleted and discovered again (i.e. updated) and still
+    // belongs in the same container can be changed in place.
+    LibraryItem* node = song_nodes_.value(song.id());
+    if (node && query_options_.Matches(song) &&
+        FindSongContainer(song) == node->parent) {
+      node->metadata = song;
+      node->key = song.title();
+      node->display_text = song.TitleWithCompilationArtist();
+      node->sort_text = SortTextForSong(song);
+      EmitDataChanged(node);
+
+      pending_deleted_.remove(song.id());
+      continue;
+    }
+    added << song;
+  }
+
+  const SongList deleted = pending_deleted_.values();
+  pending_discovered_.clear();
+  pending_deleted_.clear();
+
+  if (!deleted.isEmpty()) RemoveSongs(deleted);
+  if (!added.isEmpty()) AddSongs(added);
+}
+
+QString LibraryModel::ContainerKey(GroupBy type, const Song& song) {
+  switch (type) {
+    case GroupBy_Album:
+      return song.album();
+    case GroupBy_Artist:
+      return song.artist();
+    case GroupBy_Composer:
+      return song.composer();
+    case GroupBy_Performer:
+      return song.performer();
+    case GroupBy_Disc:
+      return QString::number(song.disc());
+    case GroupBy_Grouping:
+      return song.grouping();
+    case GroupBy_Genre:
+      return song.genre();
+    case GroupBy_AlbumArtist:
+      return song.effective_albumartist();
+    case GroupBy_Year:
+      return QString::number(qMax(0, song.year()));
+    case GroupBy_OriginalYear:
+      return QString::number(qMax(0, song.effective_originalyear()));
+    case GroupBy_YearAlbum:
+      return PrettyYearAlbum(qMax(0, song.year()), song.album());
+    case GroupBy_OriginalYearAlbum:
+      return PrettyYearAlbum(qMax(0, song.effective_originalyear()),
+                             song.album());
+    case GroupBy_FileType:
+      return song.TextForFiletype();
+    case GroupBy_Bitrate:
+      return QString::number(qMax(0, song.bitrate()));
+    case GroupBy_None:
+      qLog(Error) << "GroupBy_None";
+      break;
+  }
+  return QString();
+}
+
+QString LibraryModel::ContainerSortText(GroupBy type, const Song& song,
+                                        bool show_various_artists) {
+  // These match the sort text ItemFromSong gives each container.
+  switch (type) {
+    case GroupBy_Artist:
+    case GroupBy_AlbumArtist:
+      if (show_various_artists && song.is_compilation()) return " various";
+      return SortTextForArtist(ContainerKey(type, song));
+    case GroupBy_Album:
+    case GroupBy_Composer:
+    case GroupBy_Performer:
+    case GroupBy_Grouping:
+    case GroupBy_Genre:
+      return SortTextForArtist(ContainerKey(type, song));
+    case GroupBy_YearAlbum:
+      return SortTextForNumber(qMax(0, song.year())) + song.grouping() +
+             song.album();
+    case GroupBy_OriginalYearAlbum:
+      return SortTextForNumber(qMax(0, song.effective_originalyear())) +
+             song.grouping() + song.album();
+    case GroupBy_Year:
+    case GroupBy_OriginalYear:
+    case GroupBy_Bitrate:
+      return SortTextForNumber(ContainerKey(type, song).toInt()) + " ";
+    case GroupBy_Disc:
+      return SortTextForNumber(song.disc());
+    case GroupBy_FileType:
+      return ContainerKey(type, song);
+    case GroupBy_None:
+      return SortTextForSong(song);
+  }
+  return QString();
+}
+
+LibraryItem* LibraryModel::FindSongContainer(const Song& song,
+                                             LibraryItem** deepest) const {
+  LibraryItem* container = root_;
+  for (int i = 0; i < 3; ++i) {
+    GroupBy type = group_by_[i];
+    if (type == GroupBy_None) break;
+
+    LibraryItem* next = nullptr;
+    if (IsArtistGroupBy(type) && song.is_compilation()) {
+      next = container->compilation_artist_node_;
+    } else {
+      next = container_nodes_[i].value(ContainerKey(type, song));
+      if (next && next->parent != container) next = nullptr;
+    }
+
+    if (!next) {
+      if (deepest) *deepest = container;
+      return nullptr;
+    }
+    container = next;
+  }
+
+  if (deepest) *deepest = container;
+  return container;
+}
+
+void LibraryModel::AddSongs(const SongList& songs) {
   for (const Song& song : songs) {
     // Sanity check to make sure we don't add songs that are outside the user's
     // filter
@@ -208,55 +408,7 @@ void LibraryModel::SongsDiscovered(const SongList& songs) {
       } else {
         // Otherwise find the proper container at this level based on the
         // item's key
-        QString key;
-        switch (type) {
-          case GroupBy_Album:
-            key = song.album();
-            break;
-          case GroupBy_Artist:
-            key = song.artist();
-            break;
-          case GroupBy_Composer:
-            key = song.composer();
-            break;
-          case GroupBy_Performer:
-            key = song.performer();
-            break;
-          case GroupBy_Disc:
-            key = QString::number(song.disc());
-            break;
-          case GroupBy_Grouping:
-            key = song.grouping();
-            break;
-          case GroupBy_Genre:
-            key = song.genre();
-            break;
-          case GroupBy_AlbumArtist:
-            key = song.effective_albumartist();
-            break;
-          case GroupBy_Year:
-            key = QString::number(qMax(0, song.year()));
-            break;
-          case GroupBy_OriginalYear:
-            key = QString::number(qMax(0, song.effective_originalyear()));
-            break;
-          case GroupBy_YearAlbum:
-            key = PrettyYearAlbum(qMax(0, song.year()), song.album());
-            break;
-          case GroupBy_OriginalYearAlbum:
-            key = PrettyYearAlbum(qMax(0, song.effective_originalyear()),
-                                  song.album());
-            break;
-          case GroupBy_FileType:
-            key = song.filetype();
-            break;
-          case GroupBy_Bitrate:
-            key = song.bitrate();
-            break;
-          case GroupBy_None:
-            qLog(Error) << "GroupBy_None";
-            break;
-        }
+        const QString key = ContainerKey(type, song);
 
         // Does it exist already?
         if (!container_nodes_[i].contains(key)) {
@@ -396,6 +548,41 @@ QString LibraryModel::DividerDisplayText(GroupBy type,
 }
 
 void LibraryModel::SongsDeleted(const SongList& songs) {
+  for (const Song& song : songs) {
+    // It doesn't need adding any more if it was only just discovered, but it
+    // might still be in the model from before.
+    pending_discovered_.remove(song.id());
+    if (!pending_deleted_.contains(song.id())) {
+      pending_deleted_[song.id()] = song;
+    }
+  }
+  ScheduleChanges(songs.count());
+}
+
+bool LibraryModel::HasSongs(LibraryItem* container) {
+  LibraryQuery q(query_options_);
+  q.SetColumnSpec("%songs_table.ROWID");
+  q.SetLimit(1);
+
+  for (LibraryItem* p = container; p && p->type == LibraryItem::Type_Container;
+       p = p->parent) {
+    FilterQuery(group_by_[p->container_level], p, &q);
+  }
+
+  QMutexLocker l(backend_->db()->ReadMutex());
+  if (!backend_->ExecQuery(&q)) return true;
+  return q.Next();
+}
+
+bool LibraryModel::IsEmptyContainer(LibraryItem* node) {
+  // We can only find out whether a node that hasn't been populated yet is
+  // empty by asking the database.
+  if (!node->lazy_loaded) return !HasSongs(node);
+
+  return node->children.isEmpty() && !pending_children_.contains(node);
+}
+
+void LibraryModel::RemoveSongs(const SongList& songs) {
   // Delete the actual song nodes first, keeping track of each parent so we
   // might check to see if they're empty later.
   QSet<LibraryItem*> parents;
@@ -409,14 +596,14 @@ void LibraryModel::SongsDeleted(const SongList& songs) {
       node->parent->Delete(node->row);
       song_nodes_.remove(song.id());
       endRemoveRows();
+    } else if (pending_song_ids_.remove(song.id())) {
+      // It was never created, so there's nothing to remove.
     } else {
-      // If we get here it means some of the songs we want to delete haven't
-      // been lazy-loaded yet.  This is bad, because it would mean that to
-      // clean up empty parents we would need to lazy-load them all
-      // individually to see if they're empty.  This can take a very long time,
-      // so better to just reset the model and be done with it.
-      Reset();
-      return;
+      // The song hasn't been lazy-loaded, but the deepest of its containers
+      // that has been created might be empty now.
+      LibraryItem* container = root_;
+      FindSongContainer(song, &container);
+      if (container != root_) parents << container;
     }
   }
 
@@ -429,7 +616,7 @@ void LibraryModel::SongsDeleted(const SongList& songs) {
     QSet<LibraryItem*> parents_copy = parents;
     for (LibraryItem* node : parents_copy) {
       parents.remove(node);
-      if (node->children.count() != 0) continue;
+      if (!IsEmptyContainer(node)) continue;
 
       // Consider its parent for the next round
       if (node->parent != root_) parents << node->parent;
@@ -447,15 +634,13 @@ void LibraryModel::SongsDeleted(const SongList& songs) {
       // Remove from pixmap cache
       const QString cache_key = AlbumIconPixmapCacheKey(ItemToIndex(node));
       QPixmapCache::remove(cache_key);
-      icon_cache_->remove(QUrl(cache_key));
-      if (pending_cache_keys_.contains(cache_key)) {
-        pending_cache_keys_.remove(cache_key);
-      }
+      pending_cache_keys_.remove(cache_key);
+      pending_icon_lookups_.remove(cache_key);
 
       // Remove from pending art loading
-      QMap<quint64, ItemAndCacheKey>::iterator i = pending_art_.begin();
+      QMap<quint64, PendingArt>::iterator i = pending_art_.begin();
       while (i != pending_art_.end()) {
-        if (i.value().first == node) {
+        if (i.value().item_ == node) {
           i = pending_art_.erase(i);
         } else {
           ++i;
@@ -515,40 +700,117 @@ QVariant LibraryModel::AlbumIcon(const QModelIndex& index) {
     return cached_pixmap;
   }
 
-  // Try to load it from the disk cache
-  std::unique_ptr<QIODevice> cache(icon_cache_->data(QUrl(cache_key)));
-  if (cache) {
-    QImage cached_pixmap;
-    if (cached_pixmap.load(cache.get(), "XPM")) {
-      QPixmapCache::insert(cache_key, QPixmap::fromImage(cached_pixmap));
-      return QPixmap::fromImage(cached_pixmap);
-    }
-  }
-
   // Maybe we're loading a pixmap already?
   if (pending_cache_keys_.contains(cache_key)) {
     return no_cover_icon_;
   }
 
-  // No art is cached and we're not loading it already.  Load art for the first
-  // Song in the album.
-  SongList songs = GetChildSongs(index);
-  if (!songs.isEmpty()) {
-    const quint64 id = app_->album_cover_loader()->LoadImageAsync(
-        cover_loader_options_, songs.first());
-    pending_art_[id] = ItemAndCacheKey(item, cache_key);
-    pending_cache_keys_.insert(cache_key);
+  // Load art for the first song in the album.  If it hasn't been loaded yet
+  // it's found in a background thread so scrolling through the library
+  // doesn't wait for the database.
+  pending_cache_keys_.insert(cache_key);
+
+  if (item->lazy_loaded) {
+    for (LibraryItem* child : item->children) {
+      if (child->type == LibraryItem::Type_Song) {
+        LoadAlbumArt(item, cache_key, child->metadata);
+        return no_cover_icon_;
+      }
+    }
   }
 
+  LibraryQuery q(query_options_);
+  q.SetColumnSpec("%songs_table.ROWID, " +
+                  Utilities::Prepend("%songs_table.", kAlbumIconColumns)
+                      .join(", "));
+  q.SetLimit(1);
+  for (LibraryItem* p = item; p && p->type == LibraryItem::Type_Container;
+       p = p->parent) {
+    FilterQuery(group_by_[p->container_level], p, &q);
+  }
+
+  pending_icon_lookups_[cache_key] = item;
+
+  QFuture<AlbumIconLookup> future = QtConcurrent::run(
+      &thread_pool_, this, &LibraryModel::LookUpAlbumIcon, cache_key, q);
+  NewClosure(future, this, SLOT(AlbumIconLookupFinished(
+                               QFuture<LibraryModel::AlbumIconLookup>)),
+             future);
+
   return no_cover_icon_;
 }
 
-void LibraryModel::AlbumArtLoaded(quint64 id, const QImage& image) {
-  ItemAndCacheKey item_and_cache_key = pending_art_.take(id);
-  LibraryItem* item = item_and_cache_key.first;
-  const QString& cache_key = item_and_cache_key.second;
+LibraryModel::AlbumIconLookup LibraryModel::LookUpAlbumIcon(
+    const QString& cache_key, LibraryQuery query) {
+  AlbumIconLookup result;
+  result.cache_key = cache_key;
+
+  QMutexLocker l(backend_->db()->ReadMutex());
+  if (backend_->ExecQuery(&query) && query.Next()) {
+    result.song.InitFromQueryColumns(query, kAlbumIconColumns, true);
+  }
+  return result;
+}
+
+void LibraryModel::AlbumIconLookupFinished(
+    QFuture<LibraryModel::AlbumIconLookup> future) {
+  const AlbumIconLookup result = future.result();
+
+  // The item might have been deleted while we were looking.
+  LibraryItem* item = pending_icon_lookups_.take(result.cache_key);
   if (!item) return;
 
+  if (!result.song.is_valid()) {
+    pending_cache_keys_.remove(result.cache_key);
+    QPixmapCache::insert(result.cache_key, no_cover_icon_);
+    return;
+  }
+
+  LoadAlbumArt(item, result.cache_key, result.song);
+}
+
+void LibraryModel::LoadAlbumArt(LibraryItem* item, const QString& cache_key,
+                                const Song& song) {
+  PendingArt pending;
+  pending.item_ = item;
+  pending.cache_key_ = cache_key;
+  pending.shared_cache_key_ =
+      AlbumCoverLoader::PixmapCacheKey(cover_loader_options_, song);
+
+  // The global search might have loaded this cover already.
+  QPixmap shared_pixmap;
+  if (!pending.shared_cache_key_.isEmpty() &&
+      QPixmapCache::find(pending.shared_cache_key_, &shared_pixmap) &&
+      !shared_pixmap.isNull()) {
+    pending_cache_keys_.remove(cache_key);
+    QPixmapCache::insert(cache_key, shared_pixmap);
+    const QModelIndex index = ItemToIndex(item);
+    emit dataChanged(index, index);
+    return;
+  }
+
+  const quint64 id =
+      app_->album_cover_loader()->LoadImageAsync(cover_loader_options_, song);
+  pending_art_[id] = pending;
+
+  if (pending_art_.count() > kMaxPendingArt) CancelOldestAlbumArt();
+}
+
+void LibraryModel::CancelOldestAlbumArt() {
+  // IDs only go up, so the first one is the oldest.  Forgetting its cache key
+  // means it'll be asked for again if the item is painted later.
+  QMap<quint64, PendingArt>::iterator it = pending_art_.begin();
+  app_->album_cover_loader()->CancelTask(it.key());
+  pending_cache_keys_.remove(it.value().cache_key_);
+  pending_art_.erase(it);
+}
+
+void LibraryModel::AlbumArtLoaded(quint64 id, const QImage& image) {
+  if (!pending_art_.contains(id)) return;
+  const PendingArt pending = pending_art_.take(id);
+  LibraryItem* item = pending.item_;
+  const QString& cache_key = pending.cache_key_;
+
   pending_cache_keys_.remove(cache_key);
 
   // Insert this image in the cache.
@@ -556,19 +818,10 @@ void LibraryModel::AlbumArtLoaded(quint64 id, const QImage& image) {
     // Set the no_cover image so we don't continually try to load art.
     QPixmapCache::insert(cache_key, no_cover_icon_);
   } else {
-    QPixmapCache::insert(cache_key, QPixmap::fromImage(image));
-  }
-
-  // If we have a valid cover not already in the disk cache
-  std::unique_ptr<QIODevice> cached_img(icon_cache_->data(QUrl(cache_key)));
-  if (!cached_img && !image.isNull()) {
-    QNetworkCacheMetaData item_metadata;
-    item_metadata.setSaveToDisk(true);
-    item_metadata.setUrl(QUrl(cache_key));
-    QIODevice* cache = icon_cache_->prepare(item_metadata);
-    if (cache) {
-      image.save(cache, "XPM");
-      icon_cache_->insert(cache);
+    const QPixmap pixmap = QPixmap::fromImage(image);
+    QPixmapCache::insert(cache_key, pixmap);
+    if (!pending.shared_cache_key_.isEmpty()) {
+      QPixmapCache::insert(pending.shared_cache_key_, pixmap);
     }
   }
 
@@ -688,15 +941,18 @@ QVariant LibraryModel::data(const LibraryItem* item, int role) const {
 bool LibraryModel::HasCompilations(const LibraryQuery& query) {
   LibraryQuery q = query;
   q.AddCompilationRequirement(true);
+  q.SetOrderBy(QString());
   q.SetLimit(1);
 
-  QMutexLocker l(backend_->db()->Mutex());
+  QMutexLocker l(backend_->db()->ReadMutex());
   if (!backend_->ExecQuery(&q)) return false;
 
   return q.Next();
 }
 
-LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
+LibraryModel::QueryResult LibraryModel::RunQuery(
+    LibraryItem* parent, LibraryQuery::CancelFlag cancel) {
+  PerfTrace::Scope trace("LibraryModel::RunQuery");
   QueryResult result;
 
   // Information about what we want the children to be
@@ -706,6 +962,7 @@ LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
   // Initialise the query.  child_type says what type of thing we want (artists,
   // songs, etc.)
   LibraryQuery q(query_options_);
+  q.SetCancelFlag(cancel);
   InitQuery(child_type, &q);
 
   // Walk up through the item's parents adding filters as necessary
@@ -726,38 +983,146 @@ LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
     q.AddCompilationRequirement(false);
   }
 
+  // Songs are expensive to load, so only get the first page of them.  The rest
+  // are created later from their IDs.
+  LibraryQuery id_query(q);
+  if (child_type == GroupBy_None) {
+    q.SetLimit(kPageSize + 1);
+    id_query.SetColumnSpec("%songs_table.ROWID");
+  }
+
   // Execute the query
-  QMutexLocker l(backend_->db()->Mutex());
-  if (!backend_->ExecQuery(&q)) return result;
+  QMutexLocker l(backend_->db()->ReadMutex());
+  if (!backend_->ExecQuery(&q)) {
+    result.cancelled = q.is_cancelled();
+    return result;
+  }
 
+  // Songs that UpdateSortKeys hasn't got to yet come back a second time with
+  // no sort key.
+  const bool sort_keyed = HasStoredSortKey(child_type);
+  QSet<QString> keys;
   while (q.Next()) {
+    if (sort_keyed) {
+      const QString key = q.Value(0).toString();
+      if (keys.contains(key)) continue;
+      keys << key;
+    }
     result.rows << SqlRow(q);
   }
+
+  if (q.is_cancelled()) {
+    result.cancelled = true;
+    return result;
+  }
+
+  if (child_type == GroupBy_None && result.rows.count() > kPageSize) {
+    result.rows.removeLast();
+
+    QSet<int> loaded_ids;
+    for (const SqlRow& row : result.rows) loaded_ids << row.value(0).toInt();
+
+    if (!backend_->ExecQuery(&id_query)) {
+      result.cancelled = id_query.is_cancelled();
+      return result;
+    }
+    while (id_query.Next()) {
+      const int id = id_query.Value(0).toInt();
+      if (!loaded_ids.contains(id)) result.remaining_song_ids << id;
+    }
+    result.cancelled = id_query.is_cancelled();
+  }
   return result;
 }
 
 void LibraryModel::PostQuery(LibraryItem* parent,
                              const LibraryModel::QueryResult& result,
                              bool signal) {
+  if (result.create_va) {
+    CreateCompilationArtistNode(signal, parent);
+  }
+
+  // Step through the first page of results
+  const int count = qMin(result.rows.count(), kPageSize);
+  for (int i = 0; i < count; ++i) {
+    ChildFromQuery(parent, result.rows[i], signal);
+  }
+
+  // Keep the rest for when the view scrolls down to them
+  if (count < result.rows.count() || !result.remaining_song_ids.isEmpty()) {
+    PendingChildren& pending = pending_children_[parent];
+    pending.rows = result.rows.mid(count);
+    pending.song_ids = result.remaining_song_ids;
+    for (int id : result.remaining_song_ids) pending_song_ids_ << id;
+  }
+}
+
+LibraryItem* LibraryModel::ChildFromQuery(LibraryItem* parent,
+                                          const SqlRow& row, bool signal) {
   // Information about what we want the children to be
   int child_level = parent == root_ ? 0 : parent->container_level + 1;
   GroupBy child_type = child_level >= 3 ? GroupBy_None : group_by_[child_level];
 
-  if (result.create_va) {
-    CreateCompilationArtistNode(signal, parent);
+  // Create the item - it will get inserted into the model here
+  LibraryItem* item = ItemFromQuery(child_type, signal, child_level == 0,
+                                    parent, row, child_level);
+
+  // Save a pointer to it for later
+  if (child_type == GroupBy_None)
+    song_nodes_[item->metadata.id()] = item;
+  else
+    container_nodes_[child_level][item->key] = item;
+  return item;
+}
+
+void LibraryModel::FetchMoreChildren(LibraryItem* parent, bool signal) {
+  QMap<LibraryItem*, PendingChildren>::iterator it =
+      pending_children_.find(parent);
+  if (it == pending_children_.end()) return;
+
+  const int child_level = parent == root_ ? 0 : parent->container_level + 1;
+
+  // Take the next page out of the pending lists first
+  const SqlRowList rows = it->rows.mid(it->next_row, kPageSize);
+  it->next_row += rows.count();
+  const QList<int> song_ids = it->song_ids.mid(it->next_song_id, kPageSize);
+  it->next_song_id += song_ids.count();
+
+  if (it->next_row >= it->rows.count() &&
+      it->next_song_id >= it->song_ids.count()) {
+    pending_children_.erase(it);
   }
 
-  // Step through the results
-  for (const SqlRow& row : result.rows) {
-    // Create the item - it will get inserted into the model here
+  // Pending rows are always containers - songs are kept as IDs.
+  GroupBy child_type = child_level >= 3 ? GroupBy_None : group_by_[child_level];
+  for (const SqlRow& row : rows) {
     LibraryItem* item = ItemFromQuery(child_type, signal, child_level == 0,
                                       parent, row, child_level);
 
-    // Save a pointer to it for later
-    if (child_type == GroupBy_None)
-      song_nodes_[item->metadata.id()] = item;
-    else
-      container_nodes_[child_level][item->key] = item;
+    // SongsDiscovered might have created this container since the query ran.
+    LibraryItem* existing = container_nodes_[child_level].value(item->key);
+    if (existing && existing->parent == parent) {
+      if (signal)
+        parent->DeleteNotify(item->row);
+      else
+        parent->Delete(item->row);
+      continue;
+    }
+
+    container_nodes_[child_level][item->key] = item;
+  }
+
+  if (!song_ids.isEmpty()) {
+    for (const Song& song : backend_->GetSongsById(song_ids)) {
+      // Skip songs that were deleted, or added by SongsDiscovered, since the
+      // query ran.
+      if (!pending_song_ids_.remove(song.id())) continue;
+      if (song_nodes_.contains(song.id())) continue;
+
+      song_nodes_[song.id()] =
+          ItemFromSong(GroupBy_None, signal, child_level == 0, parent, song,
+                       -1);
+    }
   }
 }
 
@@ -770,8 +1135,20 @@ void LibraryModel::LazyPopulate(LibraryItem* parent, bool signal) {
 }
 
 void LibraryModel::ResetAsync() {
+  // Only the first reset can come from the snapshot - anything later is the
+  // user changing the grouping or the filter.
+  if (!snapshot_filename_.isEmpty() && !snapshot_tried_) {
+    snapshot_tried_ = true;
+    if (RestoreSnapshot()) return;
+  }
+
+  // Stop the previous reset's query, its results would be thrown away anyway.
+  if (reset_cancel_flag_) reset_cancel_flag_->store(1);
+  reset_cancel_flag_ = std::make_shared<QAtomicInt>(0);
+
   QFuture<LibraryModel::QueryResult> future =
-      QtConcurrent::run(&thread_pool_, this, &LibraryModel::RunQuery, root_);
+      QtConcurrent::run(&thread_pool_, this, &LibraryModel::RunQuery, root_,
+                        reset_cancel_flag_);
   NewClosure(future, this,
              SLOT(ResetAsyncQueryFinished(QFuture<LibraryModel::QueryResult>)),
              future);
@@ -781,6 +1158,10 @@ void LibraryModel::ResetAsyncQueryFinished(
     QFuture<LibraryModel::QueryResult> future) {
   const struct QueryResult result = future.result();
 
+  // A newer reset is on its way
+  if (result.cancelled) return;
+  reset_cancel_flag_.reset();
+
   BeginReset();
   root_->lazy_loaded = true;
 
@@ -802,9 +1183,17 @@ void LibraryModel::BeginReset() {
   container_nodes_[1].clear();
   container_nodes_[2].clear();
   divider_nodes_.clear();
+  pending_children_.clear();
+  pending_song_ids_.clear();
+  // The new query will see these changes anyway
+  pending_discovered_.clear();
+  pending_deleted_.clear();
+  pending_changes_timer_->stop();
+  pending_icon_lookups_.clear();
   pending_art_.clear();
   pending_cache_keys_.clear();
   smart_playlist_node_ = nullptr;
+  snapshot_version_ = -1;
 
   root_ = new LibraryItem(this);
   root_->compilation_artist_node_ = nullptr;
@@ -815,6 +1204,155 @@ void LibraryModel::BeginReset() {
     CreateSmartPlaylists();
 }
 
+bool LibraryModel::RestoreSnapshot() {
+  if (group_by_[0] == GroupBy_None || !query_options_.filter().isEmpty() ||
+      query_options_.max_age() != -1 ||
+      query_options_.query_mode() != QueryOptions::QueryMode_All) {
+    return false;
+  }
+
+  QFile file(snapshot_filename_);
+  if (!file.open(QIODevice::ReadOnly)) return false;
+
+  QDataStream s(&file);
+  s.setVersion(QDataStream::Qt_5_0);
+
+  quint32 magic = 0;
+  quint32 version = 0;
+  s >> magic >> version;
+  if (magic != kSnapshotMagic || version != kSnapshotVersion) return false;
+
+  qint64 library_version = -1;
+  Grouping grouping;
+  bool show_various_artists = false;
+  QueryResult result;
+  QList<QVector<QVariant>> rows;
+  s >> library_version >> grouping >> show_various_artists >>
+      result.create_va >> rows;
+  if (s.status() != QDataStream::Ok || library_version == -1 ||
+      grouping != group_by_ || show_various_artists != show_various_artists_) {
+    return false;
+  }
+
+  for (const QVector<QVariant>& row : rows) result.rows << SqlRow(row);
+
+  BeginReset();
+  root_->lazy_loaded = true;
+  PostQuery(root_, result, false);
+  endResetModel();
+
+  if (init_task_id_ != -1) {
+    app_->task_manager()->SetTaskFinished(init_task_id_);
+    init_task_id_ = -1;
+  }
+
+  // Anything that changed while we weren't running means starting again.
+  snapshot_version_ = library_version;
+  QFuture<qint64> future = QtConcurrent::run(
+      &thread_pool_, backend_.get(), &LibraryBackend::ChangeVersion);
+  NewClosure(future, this, SLOT(SnapshotVersionChecked(QFuture<qint64>)),
+             future);
+  return true;
+}
+
+void LibraryModel::SnapshotVersionChecked(QFuture<qint64> future) {
+  // The tree has been reset since it was restored
+  if (snapshot_version_ == -1) return;
+
+  const qint64 version = future.result();
+  if (version != snapshot_version_) {
+    qLog(Debug) << "Library changed since the snapshot was saved, reloading";
+    ResetAsync();
+  }
+  snapshot_version_ = -1;
+}
+
+void LibraryModel::SaveSnapshot() {
+  // Don't save a tree that's about to be replaced, or one that was made with
+  // a filter.
+  if (snapshot_filename_.isEmpty() || reset_cancel_flag_ ||
+      snapshot_version_ != -1 || !root_->lazy_loaded ||
+      group_by_[0] == GroupBy_None || !query_options_.filter().isEmpty() ||
+      query_options_.max_age() != -1 ||
+      query_options_.query_mode() != QueryOptions::QueryMode_All) {
+    return;
+  }
+
+  // The backend sends its changes while it holds the database, so once we
+  // have it every change up to this version has reached us.
+  QMutexLocker l(backend_->db()->Mutex());
+  QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+  ApplyPendingChanges();
+
+  const qint64 library_version = backend_->ChangeVersion();
+  if (library_version == -1) return;
+
+  QList<QVector<QVariant>> rows;
+  for (const LibraryItem* item : root_->children) {
+    if (item->type != LibraryItem::Type_Container ||
+        item == root_->compilation_artist_node_) {
+      continue;
+    }
+    rows << SnapshotRow(item);
+  }
+  auto pending = pending_children_.constFind(root_);
+  if (pending != pending_children_.constEnd()) {
+    for (int i = pending->next_row; i < pending->rows.count(); ++i) {
+      rows << pending->rows[i].columns();
+    }
+  }
+
+  QDir().mkpath(QFileInfo(snapshot_filename_).path());
+  QFile file(snapshot_filename_);
+  if (!file.open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Couldn't save the library snapshot to"
+                  << snapshot_filename_;
+    return;
+  }
+
+  QDataStream s(&file);
+  s.setVersion(QDataStream::Qt_5_0);
+  s << kSnapshotMagic << kSnapshotVersion << library_version << group_by_
+    << show_various_artists_ << (root_->compilation_artist_node_ != nullptr)
+    << rows;
+}
+
+QVector<QVariant> LibraryModel::SnapshotRow(const LibraryItem* item) const {
+  QVector<QVariant> ret;
+  switch (group_by_[0]) {
+    case GroupBy_Artist:
+    case GroupBy_Album:
+    case GroupBy_AlbumArtist:
+      ret << item->key << SortTextForArtist(item->key);
+      break;
+    case GroupBy_YearAlbum:
+      ret << item->metadata.year() << item->metadata.album()
+          << item->metadata.grouping();
+      break;
+    case GroupBy_OriginalYearAlbum:
+      ret << item->metadata.year() << item->metadata.originalyear()
+          << item->metadata.album() << item->metadata.grouping();
+      break;
+    case GroupBy_Year:
+    case GroupBy_OriginalYear:
+    case GroupBy_Disc:
+    case GroupBy_Bitrate:
+      ret << item->key.toInt();
+      break;
+    case GroupBy_FileType:
+      ret << int(item->metadata.filetype());
+      break;
+    case GroupBy_Composer:
+    case GroupBy_Performer:
+    case GroupBy_Grouping:
+    case GroupBy_Genre:
+    case GroupBy_None:
+      ret << item->key;
+      break;
+  }
+  return ret;
+}
+
 void LibraryModel::Reset() {
   BeginReset();
 
@@ -828,10 +1366,12 @@ void LibraryModel::InitQuery(GroupBy type, LibraryQuery* q) {
   // Say what type of thing we want to get back from the database.
   switch (type) {
     case GroupBy_Artist:
-      q->SetColumnSpec("DISTINCT artist");
+      q->SetColumnSpec("DISTINCT artist, artist_sort_key");
+      q->SetOrderBy("artist_sort_key");
       break;
     case GroupBy_Album:
-      q->SetColumnSpec("DISTINCT album");
+      q->SetColumnSpec("DISTINCT album, album_sort_key");
+      q->SetOrderBy("album_sort_key");
       break;
     case GroupBy_Composer:
       q->SetColumnSpec("DISTINCT composer");
@@ -861,7 +1401,8 @@ void LibraryModel::InitQuery(GroupBy type, LibraryQuery* q) {
       q->SetColumnSpec("DISTINCT genre");
       break;
     case GroupBy_AlbumArtist:
-      q->SetColumnSpec("DISTINCT effective_albumartist");
+      q->SetColumnSpec("DISTINCT effective_albumartist, albumartist_sort_key");
+      q->SetOrderBy("albumartist_sort_key");
       break;
     case GroupBy_Bitrate:
       q->SetColumnSpec("DISTINCT bitrate");
@@ -976,9 +1517,11 @@ LibraryItem* LibraryModel::ItemFromQuery(GroupBy type, bool signal,
 
   switch (type) {
     case GroupBy_Artist:
+    case GroupBy_Album:
+    case GroupBy_AlbumArtist:
       item->key = row.value(0).toString();
       item->display_text = TextOrUnknown(item->key);
-      item->sort_text = SortTextForArtist(item->key);
+      item->sort_text = StoredSortText(row, item->key);
       break;
 
     case GroupBy_YearAlbum:
@@ -1019,8 +1562,6 @@ LibraryItem* LibraryModel::ItemFromQuery(GroupBy type, bool signal,
     case GroupBy_Performer:
     case GroupBy_Grouping:
     case GroupBy_Genre:
-    case GroupBy_Album:
-    case GroupBy_AlbumArtist:
       item->key = row.value(0).toString();
       item->display_text = TextOrUnknown(item->key);
       item->sort_text = SortTextForArtist(item->key);
@@ -1045,6 +1586,7 @@ LibraryItem* LibraryModel::ItemFromQuery(GroupBy type, bool signal,
 
     case GroupBy_None:
       item->metadata.InitFromQuery(row, true);
+      item->metadata = backend_->song_cache()->Intern(item->metadata);
       item->key = item->metadata.title();
       item->display_text = item->metadata.TitleWithCompilationArtist();
       item->sort_text = SortTextForSong(item->metadata);
@@ -1142,7 +1684,7 @@ LibraryItem* LibraryModel::ItemFromSong(GroupBy type, bool signal,
       break;
 
     case GroupBy_None:
-      item->metadata = s;
+      item->metadata = backend_->song_cache()->Intern(s);
       item->key = s.title();
       item->display_text = s.TitleWithCompilationArtist();
       item->sort_text = SortTextForSong(s);
@@ -1194,29 +1736,22 @@ QString LibraryModel::PrettyYearAlbum(int year, const QString& album) {
   return QString::number(year) + " - " + TextOrUnknown(album);
 }
 
-QString LibraryModel::SortText(QString text) {
-  if (text.isEmpty()) {
-    text = " unknown";
-  } else {
-    text = text.toLower();
-  }
-  text = text.remove(QRegExp("[^\\w ]"));
-
-  return text;
+bool LibraryModel::HasStoredSortKey(GroupBy type) {
+  return type == GroupBy_Artist || type == GroupBy_Album ||
+         type == GroupBy_AlbumArtist;
 }
 
-QString LibraryModel::SortTextForArtist(QString artist) {
-  artist = SortText(artist);
+QString LibraryModel::StoredSortText(const SqlRow& row, const QString& key) {
+  // Songs saved before the keys were stored don't have one until
+  // LibraryBackend::UpdateSortKeys gets to them.
+  const QVariant stored = row.value(1);
+  return stored.isNull() ? SortTextForArtist(key) : stored.toString();
+}
 
-  if (artist.startsWith("the ")) {
-    artist = artist.right(artist.length() - 4) + ", the";
-  } else if (artist.startsWith("a ")) {
-    artist = artist.right(artist.length() - 2) + ", a";
-  } else if (artist.startsWith("an ")) {
-    artist = artist.right(artist.length() - 3) + ", an";
-  }
+QString LibraryModel::SortText(QString text) { return Song::SortText(text); }
 
-  return artist;
+QString LibraryModel::SortTextForArtist(QString artist) {
+  return Song::SortTextForArtist(artist);
 }
 
 QString LibraryModel::SortTextForNumber(int number) {
@@ -1269,6 +1804,18 @@ QMimeData* LibraryModel::mimeData(const QModelIndexList& indexes) const {
 
   data->backend = backend_.get();
 
+  // Loading everything under a container can take a long time, so leave it
+  // to whoever the data is dropped on.
+  for (const QModelIndex& index : indexes) {
+    if (IndexToItem(index)->type != LibraryItem::Type_Container) continue;
+
+    data->SetSongLoader(ChildSongsLoader(indexes));
+    if (indexes.count() == 1) {
+      data->name_for_new_playlist_ = this->data(index).toString();
+    }
+    return data;
+  }
+
   for (const QModelIndex& index : indexes) {
     GetChildSongs(IndexToItem(index), &urls, &data->songs, &song_ids);
   }
@@ -1293,7 +1840,11 @@ void LibraryModel::GetChildSongs(LibraryItem* item, QList<QUrl>* urls,
                                  SongList* songs, QSet<int>* song_ids) const {
   switch (item->type) {
     case LibraryItem::Type_Container: {
-      const_cast<LibraryModel*>(this)->LazyPopulate(item);
+      LibraryModel* model = const_cast<LibraryModel*>(this);
+      model->LazyPopulate(item);
+      while (pending_children_.contains(item)) {
+        model->FetchMoreChildren(item, true);
+      }
 
       QList<LibraryItem*> children = item->children;
       std::sort(children.begin(), children.end(),
@@ -1332,6 +1883,100 @@ SongList LibraryModel::GetChildSongs(const QModelIndex& index) const {
   return GetChildSongs(QModelIndexList() << index);
 }
 
+std::function<SongList()> LibraryModel::ChildSongsLoader(
+    const QModelIndexList& indexes) const {
+  LibraryModel* model = const_cast<LibraryModel*>(this);
+  QList<ChildSongsQuery> queries;
+
+  for (const QModelIndex& index : indexes) {
+    LibraryItem* item = IndexToItem(index);
+    ChildSongsQuery query;
+
+    if (item->type == LibraryItem::Type_Song) {
+      query.song_ = item->metadata;
+    } else if (item->type == LibraryItem::Type_Container) {
+      // The same filters RunQuery would use for each level down to the songs
+      query.query_ = LibraryQuery(query_options_);
+      for (LibraryItem* p = item; p && p->type == LibraryItem::Type_Container;
+           p = p->parent) {
+        model->FilterQuery(group_by_[p->container_level], p, &query.query_);
+      }
+
+      for (int level = item->container_level + 1; level < 3; ++level) {
+        const GroupBy type = group_by_[level];
+        if (type == GroupBy_None) break;
+
+        // Without the Various artists node compilations aren't shown at all
+        if (IsArtistGroupBy(type) && !show_various_artists_) {
+          query.query_.AddCompilationRequirement(false);
+        }
+        query.group_by_ << type;
+      }
+    } else {
+      continue;
+    }
+
+    queries << query;
+  }
+
+  return std::bind(&LibraryModel::LoadChildSongs, backend_.get(), queries,
+                   show_various_artists_);
+}
+
+SongList LibraryModel::LoadChildSongs(LibraryBackend* backend,
+                                      QList<ChildSongsQuery> queries,
+                                      bool show_various_artists) {
+  SongList ret;
+  QSet<int> song_ids;
+
+  for (ChildSongsQuery& query : queries) {
+    SongList songs;
+    if (query.song_.is_valid()) {
+      songs << query.song_;
+    } else {
+      songs = backend->ExecLibraryQuery(&query.query_);
+      SortChildSongs(query.group_by_, show_various_artists, &songs);
+    }
+
+    for (const Song& song : songs) {
+      if (song_ids.contains(song.id())) continue;
+      song_ids.insert(song.id());
+      ret << backend->song_cache()->Intern(song);
+    }
+  }
+
+  return ret;
+}
+
+void LibraryModel::SortChildSongs(const QList<GroupBy>& group_by,
+                                  bool show_various_artists, SongList* songs) {
+  typedef QPair<QStringList, int> SortKey;
+
+  QVector<SortKey> keys;
+  keys.reserve(songs->count());
+  for (int i = 0; i < songs->count(); ++i) {
+    const Song& song = songs->at(i);
+    QStringList key;
+    for (GroupBy type : group_by) {
+      key << ContainerSortText(type, song, show_various_artists);
+    }
+    key << SortTextForSong(song);
+    keys << SortKey(key, i);
+  }
+
+  std::stable_sort(keys.begin(), keys.end(),
+                   [](const SortKey& a, const SortKey& b) {
+                     return std::lexicographical_compare(
+                         a.first.begin(), a.first.end(), b.first.begin(),
+                         b.first.end());
+                   });
+
+  SongList sorted;
+  sorted.reserve(keys.count());
+  for (const SortKey& key : keys) sorted << songs->at(key.second);
+  *songs = sorted;
+}
+
 void LibraryModel::SetFilterAge(int age) {
   query_options_.set_max_age(age);
   ResetAsync();
@@ -1348,10 +1993,19 @@ void LibraryModel::SetFilterQueryMode(QueryOptions::QueryMode query_mode) {
 }
 
 bool LibraryModel::canFetchMore(const QModelIndex& parent) const {
-  if (!parent.isValid()) return false;
+  if (!parent.isValid()) return pending_children_.contains(root_);
 
   LibraryItem* item = IndexToItem(parent);
-  return !item->lazy_loaded;
+  return !item->lazy_loaded || pending_children_.contains(item);
+}
+
+void LibraryModel::fetchMore(const QModelIndex& parent) {
+  LibraryItem* item = IndexToItem(parent);
+  if (!item->lazy_loaded) {
+    LazyPopulate(item);
+  } else {
+    FetchMoreChildren(item, true);
+  }
 }
 
 void LibraryModel::SetGroupBy(const Grouping& g) {
@@ -18,11 +18,11 @@
 #ifndef LIBRARYMODEL_H
 #define LIBRARYMODEL_H
 
+#include <functional>
 #include <memory>
 
 #include <QAbstractItemModel>
 #include <QIcon>
-#include <QNetworkDiskCache>
 #include <QThreadPool>
 
 #include "libraryitem.h"
@@ -44,6 +44,7 @@ class Search;
 }
 
 class QSettings;
+class QTimer;
 
 class LibraryModel : public SimpleTreeModel<LibraryItem> {
   Q_OBJECT
@@ -60,7 +61,21 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   static const char* kSavedGroupingsSettingsGroup;
   static const int kSmartPlaylistsVersion;
   static const int kPrettyCoverSize;
-  static const qint64 kIconCacheSize;
+
+  // Nodes with more children than this are filled in a page at a time.
+  static const int kPageSize;
+
+  // Changes from the backend to at least this many songs are batched together
+  // with any others that arrive in the next kBatchChangesMsec.
+  static const int kBatchChangesThreshold;
+  static const int kBatchChangesMsec;
+
+  static const int kMaxPendingArt;
+  // All an album's icon needs from one of its songs.
+  static const QStringList kAlbumIconColumns;
+
+  static const quint32 kSnapshotMagic;
+  static const quint32 kSnapshotVersion;
 
   enum Role {
     Role_Type = Qt::UserRole + 1,
@@ -112,10 +127,23 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   };
 
   struct QueryResult {
-    QueryResult() : create_va(false) {}
+    QueryResult() : create_va(false), cancelled(false) {}
 
     SqlRowList rows;
     bool create_va;
+    // A newer query replaced this one before it finished
+    bool cancelled;
+
+    // If the children are songs only the first page of rows is loaded - these
+    // are the IDs of the rest.
+    QList<int> remaining_song_ids;
+  };
+
+  // The result of finding the song to load an album's icon for in a
+  // background thread.
+  struct AlbumIconLookup {
+    QString cache_key;
+    Song song;
   };
 
   LibraryBackend* backend() const { return backend_.get(); }
@@ -139,6 +167,11 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
                      QSet<int>* song_ids) const;
   SongList GetChildSongs(const QModelIndex& index) const;
   SongList GetChildSongs(const QModelIndexList& indexes) const;
+  // Finds the same songs as GetChildSongs, but with one query per node
+  // instead of loading the tree under it.  The function that's returned can
+  // be run in any thread.
+  std::function<SongList()> ChildSongsLoader(
+      const QModelIndexList& indexes) const;
 
   // Might be accurate
   int total_song_count() const { return total_song_count_; }
@@ -156,6 +189,7 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   QStringList mimeTypes() const;
   QMimeData* mimeData(const QModelIndexList& indexes) const;
   bool canFetchMore(const QModelIndex& parent) const;
+  void fetchMore(const QModelIndex& parent);
 
   // Whether or not to use album cover art, if it exists, in the library view
   void set_pretty_covers(bool use_pretty_covers);
@@ -167,6 +201,11 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   // Save the current grouping
   void SaveGrouping(QString name);
 
+  // Saves the top level of the tree to filename when the application quits.
+  // The next time the model is reset with the same grouping it's shown from
+  // there straight away, and only reloaded if the library changed since.
+  void set_snapshot_filename(const QString& filename);
+
   // Utility functions for manipulating text
   static QString TextOrUnknown(const QString& text);
   static QString PrettyYearAlbum(int year, const QString& album);
@@ -203,18 +242,73 @@ signals:
 
   // Called after ResetAsync
   void ResetAsyncQueryFinished(QFuture<LibraryModel::QueryResult> future);
+  void SnapshotVersionChecked(QFuture<qint64> future);
+  void SaveSnapshot();
+
+  void ApplyPendingChanges();
 
+  void AlbumIconLookupFinished(QFuture<LibraryModel::AlbumIconLookup> future);
   void AlbumArtLoaded(quint64 id, const QImage& image);
 
  private:
   // Provides some optimisations for loading the list of items in the root.
   // This gets called a lot when filtering the playlist, so it's nice to be
   // able to do it in a background thread.
-  QueryResult RunQuery(LibraryItem* parent);
+  QueryResult RunQuery(LibraryItem* parent,
+                       LibraryQuery::CancelFlag cancel =
+                           LibraryQuery::CancelFlag());
   void PostQuery(LibraryItem* parent, const QueryResult& result, bool signal);
 
+  // Creates the next page of children that were queried for parent but not
+  // created yet.
+  void FetchMoreChildren(LibraryItem* parent, bool signal);
+  LibraryItem* ChildFromQuery(LibraryItem* parent, const SqlRow& row,
+                              bool signal);
+
   bool HasCompilations(const LibraryQuery& query);
 
+  // Fills the top level from the snapshot file if it matches the current
+  // grouping.  Returns false if the model still needs to be queried.
+  bool RestoreSnapshot();
+  // The row that ItemFromQuery would have made a top-level item from.
+  QVector<QVariant> SnapshotRow(const LibraryItem* item) const;
+
+  // A rough guess at the memory used by the items in the tree, and the rows
+  // waiting to become items.
+  qint64 EstimateMemoryUsage() const;
+
+  // Changes from the backend are collected in pending_discovered_ and
+  // pending_deleted_, then turned into the smallest set of row insertions,
+  // removals and changes.
+  void ScheduleChanges(int count);
+  void AddSongs(const SongList& songs);
+  void RemoveSongs(const SongList& songs);
+  bool HasSongs(LibraryItem* container);
+  bool IsEmptyContainer(LibraryItem* node);
+
+  static QString ContainerKey(GroupBy type, const Song& song);
+  // The sort text the container a song belongs in would have.
+  static QString ContainerSortText(GroupBy type, const Song& song,
+                                   bool show_various_artists);
+
+  // A node whose songs are found by ChildSongsLoader.
+  struct ChildSongsQuery {
+    // Set for a song node, instead of query_.
+    Song song_;
+    LibraryQuery query_;
+    // The groupings below the node, to sort the songs the way the tree does.
+    QList<GroupBy> group_by_;
+  };
+  static SongList LoadChildSongs(LibraryBackend* backend,
+                                 QList<ChildSongsQuery> queries,
+                                 bool show_various_artists);
+  static void SortChildSongs(const QList<GroupBy>& group_by,
+                             bool show_various_artists, SongList* songs);
+  // Returns the container a song belongs in, or nullptr if it hasn't been
+  // created.  deepest is set to the deepest of its containers that has been.
+  LibraryItem* FindSongContainer(const Song& song,
+                                 LibraryItem** deepest = nullptr) const;
+
   void BeginReset();
 
   // Functions for working with queries and creating items.
@@ -248,6 +342,10 @@ signals:
                         int container_level);
   void FinishItem(GroupBy type, bool signal, bool create_divider,
                   LibraryItem* parent, LibraryItem* item);
+  // Artists, album artists and albums are read with the sort key stored next
+  // to them in the songs table.
+  static bool HasStoredSortKey(GroupBy type);
+  static QString StoredSortText(const SqlRow& row, const QString& key);
 
   QString DividerKey(GroupBy type, LibraryItem* item) const;
   QString DividerDisplayText(GroupBy type, const QString& key) const;
@@ -255,6 +353,11 @@ signals:
   // Helpers
   QString AlbumIconPixmapCacheKey(const QModelIndex& index) const;
   QVariant AlbumIcon(const QModelIndex& index);
+  void LoadAlbumArt(LibraryItem* item, const QString& cache_key,
+                    const Song& song);
+  void CancelOldestAlbumArt();
+  // Run in thread_pool_.
+  AlbumIconLookup LookUpAlbumIcon(const QString& cache_key, LibraryQuery query);
   QVariant data(const LibraryItem* item, int role) const;
   bool CompareItems(const LibraryItem* a, const LibraryItem* b) const;
 
@@ -279,6 +382,28 @@ signals:
   // Keyed on a letter, a year, a century, etc.
   QMap<QString, LibraryItem*> divider_nodes_;
 
+  // Children that have been queried for a node but not created yet.  These
+  // are created kPageSize at a time as the view scrolls towards the end of the
+  // node, so a huge grouping only costs as many items as have been looked at.
+  struct PendingChildren {
+    PendingChildren() : next_row(0), next_song_id(0) {}
+
+    SqlRowList rows;
+    int next_row;
+    QList<int> song_ids;
+    int next_song_id;
+  };
+  QMap<LibraryItem*, PendingChildren> pending_children_;
+
+  // Every song in pending_children_ that hasn't been created or deleted yet.
+  QSet<int> pending_song_ids_;
+
+  // Changes from the backend that haven't been applied yet, keyed on song ID.
+  // pending_deleted_ keeps the song as it was before it was deleted.
+  QMap<int, Song> pending_discovered_;
+  QMap<int, Song> pending_deleted_;
+  QTimer* pending_changes_timer_;
+
   // Only applies if smart playlists are set to on
   LibraryItem* smart_playlist_node_;
 
@@ -290,19 +415,36 @@ signals:
   QIcon playlists_dir_icon_;
   QIcon playlist_icon_;
 
-  QNetworkDiskCache* icon_cache_;
-
   QThreadPool thread_pool_;
+  // Set when the filter changes again before the last reset's query finished
+  LibraryQuery::CancelFlag reset_cancel_flag_;
 
   int init_task_id_;
 
+  QString snapshot_filename_;
+  bool snapshot_tried_;
+  // The library version the tree was restored at, until it's been checked
+  // against the database.
+  qint64 snapshot_version_;
+
   bool use_pretty_covers_;
   bool show_dividers_;
 
   AlbumCoverLoaderOptions cover_loader_options_;
 
-  typedef QPair<LibraryItem*, QString> ItemAndCacheKey;
-  QMap<quint64, ItemAndCacheKey> pending_art_;
+  // Album icons are loaded by the AlbumCoverLoader, which keeps scaled covers
+  // in its thumbnail cache.  pending_icon_lookups_ are albums we're still
+  // finding a song for.  At most kMaxPendingArt are loaded at a time - the oldest
+  // requests are usually for items that have been scrolled out of view.
+  // Covers are also kept under AlbumCoverLoader::PixmapCacheKey, which the
+  // global search uses for library results too.
+  struct PendingArt {
+    LibraryItem* item_;
+    QString cache_key_;
+    QString shared_cache_key_;
+  };
+  QMap<QString, LibraryItem*> pending_icon_lookups_;
+  QMap<quint64, PendingArt> pending_art_;
   QSet<QString> pending_cache_keys_;
 };
 
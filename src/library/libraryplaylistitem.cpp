@@ -35,6 +35,13 @@ void LibraryPlaylistItem::Reload() {
                                                 &song_);
 }
 
+bool LibraryPlaylistItem::GetReloadableSong(Song* song) const {
+  *song = song_;
+  return true;
+}
+
+void LibraryPlaylistItem::SetReloadedSong(const Song& song) { song_ = song; }
+
 bool LibraryPlaylistItem::InitFromQuery(const SqlRow& query) {
   // Rows from the songs tables come first
   song_.InitFromQuery(query, true);
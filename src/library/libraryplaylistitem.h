@@ -30,6 +30,8 @@ class LibraryPlaylistItem : public DbPlaylistItem {
   
   bool InitFromQuery(const SqlRow& query);
   void Reload();
+  bool GetReloadableSong(Song* song) const;
+  void SetReloadedSong(const Song& song);
 
   bool IsLocalLibraryItem() const { return true; }
 };
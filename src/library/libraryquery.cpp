@@ -16,12 +16,28 @@
 */
 
 #include "libraryquery.h"
+#include "core/database.h"
+#include "core/logging.h"
 #include "core/song.h"
 
 #include <QtDebug>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QSqlError>
 
+// FTS5 doesn't allow punctuation in unquoted terms, so the text is split the
+// same way the unicode tokenizer splits it.
+QString LibraryQuery::FtsPrefixTerms(const QString& text,
+                                     const QString& column) {
+  QString ret;
+  for (const QString& part : text.toLower().split(QRegExp("[\\W_]+"),
+                                                  QString::SkipEmptyParts)) {
+    if (!column.isEmpty()) ret += column + ":";
+    ret += part + "* ";
+  }
+  return ret;
+}
+
 QueryOptions::QueryOptions() : max_age_(-1), query_mode_(QueryMode_All) {}
 
 const QStringList LibraryQuery::kNumericCompOperators = QStringList() << "<="
@@ -29,6 +45,11 @@ const QStringList LibraryQuery::kNumericCompOperators = QStringList() << "<="
                                                                       << "<"
                                                                       << ">"
                                                                       << "=";
+// Weights for the fts columns, in the same order as Song::kFtsColumns.
+const char* LibraryQuery::kRelevanceOrder =
+    "bm25(fts.%fts_table_noprefix, 10.0, 5.0, 8.0, 5.0, 2.0, 2.0, 1.0, 1.0, "
+    "1.0, 1.0)";
+
 const QMap<QString, Song::FileType> kFiletypeId = QMap<QString, Song::FileType>(
     std::map<QString, Song::FileType>{{"asf", Song::Type_Asf},
                                       {"flac", Song::Type_Flac},
@@ -51,11 +72,16 @@ const QMap<QString, Song::FileType> kFiletypeId = QMap<QString, Song::FileType>(
                                       {"unknown", Song::Type_Unknown}});
 
 LibraryQuery::LibraryQuery(const QueryOptions& options)
-    : include_unavailable_(false), join_with_fts_(false), limit_(-1) {
+    : include_unavailable_(false),
+      join_with_fts_(false),
+      order_by_relevance_(false),
+      explain_query_plan_(false),
+      limit_(-1),
+      offset_(0) {
   if (!options.filter().isEmpty()) {
     // We need to munge the filter text a little bit to get it to work as
-    // expected with sqlite's FTS3:
-    //  1) Append * to all tokens.
+    // expected with sqlite's FTS5 (and the FTS3 tables older devices use):
+    //  1) Split tokens into words and append * to each.
     //  2) Prefix "fts" to column names.
     //  3) Remove colons which don't correspond to column names.
     //
@@ -81,7 +107,7 @@ LibraryQuery::LibraryQuery(const QueryOptions& options)
         if (Song::kFtsColumns.contains(
                 "fts" + columntoken,
                 Qt::CaseInsensitive)) {  // Is it a FTS column?
-          query += "fts" + columntoken + ":" + subtoken + "* ";
+          query += FtsPrefixTerms(subtoken, "fts" + columntoken.toLower());
         } else if (Song::kColumns.contains(columntoken, Qt::CaseInsensitive)) {
           // We need to extract the operator and the value from the subtoken
           QRegExp operatorRe("^(" + kNumericCompOperators.join("|") + ")(.*)");
@@ -139,12 +165,10 @@ LibraryQuery::LibraryQuery(const QueryOptions& options)
             AddWhere(columntoken, val, op);
           }
         } else {  // We did't recognize this as a column
-          token.replace(":", " ");
-          token = token.trimmed();
-          query += token + "* ";
+          query += FtsPrefixTerms(token);
         }
       } else {
-        query += token + "* ";
+        query += FtsPrefixTerms(token);
       }
     }
 
@@ -183,10 +207,8 @@ LibraryQuery::LibraryQuery(const QueryOptions& options)
 QString LibraryQuery::GetInnerQuery() {
   return duplicates_only_
              ? QString(
-                   " INNER JOIN (select * from duplicated_songs) dsongs        "
-                   "ON (%songs_table.artist = dsongs.dup_artist       "
-                   "AND %songs_table.album = dsongs.dup_album     "
-                   "AND %songs_table.title = dsongs.dup_title)    ")
+                   " INNER JOIN (select * from duplicated_songs) dsongs "
+                   "ON (%songs_table.duplicate_key = dsongs.dup_key) ")
              : QString();
 }
 
@@ -224,8 +246,16 @@ void LibraryQuery::AddCompilationRequirement(bool compilation) {
                         .arg(compilation ? 1 : 0);
 }
 
+LibraryQuery::~LibraryQuery() {
+  if (interrupted_db_.isValid()) {
+    Database::SetInterruptFlag(interrupted_db_, nullptr);
+  }
+}
+
 QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
                              const QString& fts_table) {
+  if (is_cancelled()) return query_;
+
   QString sql;
 
   if (join_with_fts_) {
@@ -244,9 +274,16 @@ QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
 
   if (!where_clauses.isEmpty()) sql += " WHERE " + where_clauses.join(" AND ");
 
-  if (!order_by_.isEmpty()) sql += " ORDER BY " + order_by_;
+  if (order_by_relevance_ && join_with_fts_) {
+    sql += QString(" ORDER BY ") + kRelevanceOrder;
+  } else if (!order_by_.isEmpty()) {
+    sql += " ORDER BY " + order_by_;
+  }
 
-  if (limit_ != -1) sql += " LIMIT " + QString::number(limit_);
+  if (limit_ != -1) {
+    sql += " LIMIT " + QString::number(limit_);
+    if (offset_ > 0) sql += " OFFSET " + QString::number(offset_);
+  }
 
   sql.replace("%songs_table", songs_table);
   sql.replace("%fts_table_noprefix", fts_table.section('.', -1, -1));
@@ -260,11 +297,57 @@ QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
     query_.addBindValue(value);
   }
 
+  // The flag stays on the connection until this query is destroyed, so rows
+  // are interrupted in Next() too.
+  if (cancel_flag_) {
+    Database::SetInterruptFlag(db, cancel_flag_.get());
+    interrupted_db_ = db;
+  }
+
+  if (!explain_query_plan_) {
+    query_.exec();
+    return query_;
+  }
+
+  const QStringList full_scans = FullTableScans(db, sql);
+  QElapsedTimer timer;
+  timer.start();
   query_.exec();
+  const qint64 elapsed = timer.elapsed();
+
+  if (!full_scans.isEmpty()) {
+    qLog(Warning) << "Full table scan in library query taking" << elapsed
+                  << "ms:" << sql << full_scans;
+  } else {
+    qLog(Debug) << "Library query took" << elapsed << "ms:" << sql;
+  }
   return query_;
 }
 
-bool LibraryQuery::Next() { return query_.next(); }
+QStringList LibraryQuery::FullTableScans(QSqlDatabase db,
+                                         const QString& sql) const {
+  QSqlQuery plan(db);
+  plan.prepare("EXPLAIN QUERY PLAN " + sql);
+  for (const QVariant& value : bound_values_) {
+    plan.addBindValue(value);
+  }
+
+  QStringList ret;
+  if (!plan.exec()) return ret;
+
+  // The last column is a description like "SCAN TABLE songs" or
+  // "SEARCH TABLE songs USING COVERING INDEX idx_comp_artist_album (...)".
+  // Index and virtual table scans mention the index they use.
+  while (plan.next()) {
+    const QString detail = plan.value(3).toString();
+    if (detail.startsWith("SCAN") && !detail.contains("INDEX")) {
+      ret << detail;
+    }
+  }
+  return ret;
+}
+
+bool LibraryQuery::Next() { return !is_cancelled() && query_.next(); }
 
 QVariant LibraryQuery::Value(int column) const { return query_.value(column); }
 
@@ -18,8 +18,12 @@
 #ifndef LIBRARYQUERY_H
 #define LIBRARYQUERY_H
 
+#include <memory>
+
+#include <QAtomicInt>
 #include <QString>
 #include <QVariant>
+#include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QStringList>
 #include <QVariantList>
@@ -68,11 +72,23 @@ struct QueryOptions {
 class LibraryQuery {
  public:
   LibraryQuery(const QueryOptions& options = QueryOptions());
+  ~LibraryQuery();
+
+  // Turns free text into prefix terms that both FTS3 and FTS5 will parse, for
+  // a MATCH on one column or, if column is empty, on all of them.
+  static QString FtsPrefixTerms(const QString& text,
+                                const QString& column = QString());
+
+  // Set to non-zero by another thread to stop the query.
+  typedef std::shared_ptr<QAtomicInt> CancelFlag;
 
   // Sets contents of SELECT clause on the query (list of columns to get).
   void SetColumnSpec(const QString& spec) { column_spec_ = spec; }
   // Sets an ORDER BY clause on the query.
   void SetOrderBy(const QString& order_by) { order_by_ = order_by; }
+  // Orders the results by how well they match the filter, best first.  Has no
+  // effect if the query has no full text filter.  Only works on FTS5 tables.
+  void SetOrderByRelevance() { order_by_relevance_ = true; }
 
   // Adds a fragment of WHERE clause. When executed, this Query will connect all
   // the fragments with AND operator.
@@ -82,9 +98,18 @@ class LibraryQuery {
 
   void AddCompilationRequirement(bool compilation);
   void SetLimit(int limit) { limit_ = limit; }
+  // Skips this many rows of the result.  Only used if a limit is set too.
+  void SetOffset(int offset) { offset_ = offset; }
   void SetIncludeUnavailable(bool include_unavailable) {
     include_unavailable_ = include_unavailable;
   }
+  // Runs EXPLAIN QUERY PLAN before executing the query, and logs the time it
+  // took if SQLite had to scan a whole table to answer it.
+  void SetExplainQueryPlan(bool explain) { explain_query_plan_ = explain; }
+  // When the flag is set SQLite abandons the query, even in the middle of
+  // Exec(), and Next() returns false.
+  void SetCancelFlag(const CancelFlag& flag) { cancel_flag_ = flag; }
+  bool is_cancelled() const { return cancel_flag_ && cancel_flag_->load(); }
 
   QSqlQuery Exec(QSqlDatabase db, const QString& songs_table,
                  const QString& fts_table);
@@ -94,19 +119,28 @@ class LibraryQuery {
   operator const QSqlQuery&() const { return query_; }
 
   static const QStringList kNumericCompOperators;
+  static const char* kRelevanceOrder;
 
  private:
   QString GetInnerQuery();
+  QStringList FullTableScans(QSqlDatabase db, const QString& sql) const;
 
   bool include_unavailable_;
   bool join_with_fts_;
+  bool order_by_relevance_;
+  bool explain_query_plan_;
   QString column_spec_;
   QString order_by_;
   QStringList where_clauses_;
   QVariantList bound_values_;
   int limit_;
+  int offset_;
   bool duplicates_only_;
 
+  CancelFlag cancel_flag_;
+  // The connection the cancel flag was given to, so it can be taken away.
+  QSqlDatabase interrupted_db_;
+
   QSqlQuery query_;
 };
 
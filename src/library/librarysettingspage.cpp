@@ -24,6 +24,7 @@
 #include "librarywatcher.h"
 #include "ui_librarysettingspage.h"
 #include "core/application.h"
+#include "core/taskexecutor.h"
 #include "core/utilities.h"
 #include "playlist/playlistdelegates.h"
 #include "ui/iconloader.h"
@@ -33,7 +34,7 @@
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QSettings>
-#include <QtConcurrentRun>
+#include <QThread>
 
 const char* LibrarySettingsPage::kSettingsGroup = "LibraryConfig";
 
@@ -52,6 +53,8 @@ LibrarySettingsPage::LibrarySettingsPage(SettingsDialog* dialog)
   connect(ui_->remove, SIGNAL(clicked()), SLOT(Remove()));
   connect(ui_->sync_stats_button, SIGNAL(clicked()),
           SLOT(WriteAllSongsStatisticsToFiles()));
+  connect(ui_->analyse_replaygain, SIGNAL(toggled(bool)),
+          ui_->save_replaygain_in_file, SLOT(setEnabled(bool)));
 }
 
 LibrarySettingsPage::~LibrarySettingsPage() { delete ui_; }
@@ -93,6 +96,7 @@ void LibrarySettingsPage::Save() {
   s.beginGroup(LibraryWatcher::kSettingsGroup);
   s.setValue("startup_scan", ui_->startup_scan->isChecked());
   s.setValue("monitor", ui_->monitor->isChecked());
+  s.setValue("scan_parallelism", ui_->scan_parallelism->value());
 
   QString filter_text = ui_->cover_art_patterns->text();
   QStringList filters = filter_text.split(',', QString::SkipEmptyParts);
@@ -104,6 +108,11 @@ void LibrarySettingsPage::Save() {
   s.setValue("save_ratings_in_file", ui_->save_ratings_in_file->isChecked());
   s.setValue("save_statistics_in_file",
              ui_->save_statistics_in_file->isChecked());
+  s.setValue("analyse_replaygain", ui_->analyse_replaygain->isChecked());
+  s.setValue("save_replaygain_in_file",
+             ui_->save_replaygain_in_file->isChecked());
+  s.setValue("find_acoustic_duplicates",
+             ui_->find_acoustic_duplicates->isChecked());
   s.endGroup();
 }
 
@@ -133,6 +142,8 @@ void LibrarySettingsPage::Load() {
   s.beginGroup(LibraryWatcher::kSettingsGroup);
   ui_->startup_scan->setChecked(s.value("startup_scan", true).toBool());
   ui_->monitor->setChecked(s.value("monitor", true).toBool());
+  ui_->scan_parallelism->setValue(
+      s.value("scan_parallelism", QThread::idealThreadCount() * 2).toInt());
 
   QStringList filters =
       s.value("cover_art_patterns", QStringList() << "front"
@@ -146,6 +157,14 @@ void LibrarySettingsPage::Load() {
       s.value("save_ratings_in_file", false).toBool());
   ui_->save_statistics_in_file->setChecked(
       s.value("save_statistics_in_file", false).toBool());
+  ui_->analyse_replaygain->setChecked(
+      s.value("analyse_replaygain", false).toBool());
+  ui_->save_replaygain_in_file->setChecked(
+      s.value("save_replaygain_in_file", false).toBool());
+  ui_->save_replaygain_in_file->setEnabled(
+      ui_->analyse_replaygain->isChecked());
+  ui_->find_acoustic_duplicates->setChecked(
+      s.value("find_acoustic_duplicates", false).toBool());
   s.endGroup();
 }
 
@@ -158,6 +177,8 @@ void LibrarySettingsPage::WriteAllSongsStatisticsToFiles() {
   if (confirmation_dialog.exec() != QMessageBox::Yes) {
     return;
   }
-  QtConcurrent::run(dialog()->app()->library(),
-                    &Library::WriteAllSongsStatisticsToFiles);
+  TaskExecutor::Instance()->Run<void>(
+      TaskExecutor::Lane_Bulk,
+      std::bind(&Library::WriteAllSongsStatisticsToFiles,
+                dialog()->app()->library()));
 }
@@ -19,6 +19,7 @@
 
 #include <QPainter>
 #include <QContextMenuEvent>
+#include <QScrollBar>
 #include <QHelpEvent>
 #include <QMenu>
 #include <QMessageBox>
@@ -49,6 +50,7 @@
 using smart_playlists::Wizard;
 
 const char* LibraryView::kSettingsGroup = "LibraryView";
+const int LibraryView::kFetchMoreMargin = 50;
 
 LibraryItemDelegate::LibraryItemDelegate(QObject* parent)
     : QStyledItemDelegate(parent) {}
@@ -186,10 +188,27 @@ LibraryView::LibraryView(QWidget* parent)
   setSelectionMode(QAbstractItemView::ExtendedSelection);
 
   setStyleSheet("QTreeView::item{padding-top:1px;}");
+
+  connect(verticalScrollBar(), SIGNAL(valueChanged(int)),
+          SLOT(FetchMoreForVisibleItems()));
 }
 
 LibraryView::~LibraryView() {}
 
+void LibraryView::FetchMoreForVisibleItems() {
+  // QAbstractItemView only asks for more top-level rows.  Expanded nodes that
+  // are filled a page at a time need asking too when the user scrolls towards
+  // the end of them.
+  for (QModelIndex index = indexAt(QPoint(0, viewport()->height() - 1));
+       index.isValid(); index = index.parent()) {
+    const QModelIndex parent = index.parent();
+    if (index.row() >= model()->rowCount(parent) - kFetchMoreMargin &&
+        model()->canFetchMore(parent)) {
+      model()->fetchMore(parent);
+    }
+  }
+}
+
 void LibraryView::SaveFocus() {
   QModelIndex current = currentIndex();
   QVariant type = model()->data(current, LibraryModel::Role_Type);
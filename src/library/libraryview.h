@@ -58,6 +58,9 @@ class LibraryView : public AutoExpandingTreeView {
 
   static const char* kSettingsGroup;
 
+  // Load more children when the last visible row is this close to the end.
+  static const int kFetchMoreMargin;
+
   // Returns Songs currently selected in the library view. Please note that the
   // selection is recursive meaning that if for example an album is selected
   // this will return all of it's songs.
@@ -113,6 +116,8 @@ signals:
 
   void DeleteFinished(const SongList& songs_with_errors);
 
+  void FetchMoreForVisibleItems();
+
  private:
   void RecheckIsEmpty();
   void ShowInVarious(bool on);
@@ -18,6 +18,8 @@
 #include "librarywatcher.h"
 
 #include "librarybackend.h"
+#include "scanthrottle.h"
+#include "core/fileexistencecache.h"
 #include "core/filesystemwatcherinterface.h"
 #include "core/logging.h"
 #include "core/tagreaderclient.h"
@@ -29,6 +31,8 @@
 #include <QDirIterator>
 #include <QHash>
 #include <QMutexLocker>
+#include <QPair>
+#include <QQueue>
 #include <QSet>
 #include <QSettings>
 #include <QThread>
@@ -50,6 +54,21 @@ static const char *kNoMusicFile   = ".nomusic";
 
 static const int kUnfilteredImageLimit = 10;
 
+// How often to look for changes when the filesystem watcher can't watch all
+// the library's directories.
+static const int kPeriodicScanIntervalMinutes = 30;
+
+// Number of subdirectories a scan transaction looks up in the database one at
+// a time before it loads the songs of the whole directory instead.
+static const int kMaxSubdirQueries = 50;
+
+// Number of songs a scan transaction collects before handing them to the
+// backend, so that the database commits overlap with the rest of the scan.
+static const int kScanCommitBatchSize = 1000;
+
+// Number of parsed cue sheets to keep between scans.
+static const int kCueCacheSize = 100;
+
 QStringList LibraryWatcher::sValidImages;
 
 const char* LibraryWatcher::kSettingsGroup = "LibraryWatcher";
@@ -58,13 +77,17 @@ LibraryWatcher::LibraryWatcher(QObject* parent)
     : QObject(parent),
       backend_(nullptr),
       task_manager_(nullptr),
+      scan_throttle_(nullptr),
       fs_watcher_(FileSystemWatcherInterface::Create(this)),
       scan_on_startup_(true),
       monitor_(true),
+      scan_parallelism_(1),
       rescan_timer_(new QTimer(this)),
+      periodic_scan_timer_(new QTimer(this)),
       rescan_paused_(false),
       total_watches_(0),
-      cue_parser_(new CueParser(backend_, this)) {
+      cue_parser_(new CueParser(backend_, this)),
+      cue_cache_(kCueCacheSize) {
   rescan_timer_->setInterval(1000);
   rescan_timer_->setSingleShot(true);
 
@@ -78,6 +101,14 @@ LibraryWatcher::LibraryWatcher(QObject* parent)
   ReloadSettings();
 
   connect(rescan_timer_, SIGNAL(timeout()), SLOT(RescanPathsNow()));
+  connect(periodic_scan_timer_, SIGNAL(timeout()),
+          SLOT(IncrementalScanNow()));
+
+  connect(fs_watcher_, SIGNAL(FilesChanged(QString, QStringList)),
+          SLOT(FilesChanged(QString, QStringList)));
+  connect(fs_watcher_, SIGNAL(WatchLimitReached()),
+          SLOT(StartPeriodicScans()));
+  connect(fs_watcher_, SIGNAL(EventsLost()), SLOT(IncrementalScanNow()));
 }
 
 // Holding a reference to a directory is safe because a ScanTransaction object
@@ -94,6 +125,7 @@ LibraryWatcher::ScanTransaction::ScanTransaction(
       ignores_mtime_(ignores_mtime),
       watcher_(watcher),
       cached_songs_dirty_(true),
+      subdir_queries_(0),
       known_subdirs_dirty_(true) {
   QString description;
   if (watcher_->device_name_.isEmpty())
@@ -112,13 +144,7 @@ LibraryWatcher::ScanTransaction::~ScanTransaction() {
     return;
   }
 
-  if (!new_songs.isEmpty()) emit watcher_->NewOrUpdatedSongs(new_songs);
-
-  if (!touched_songs.isEmpty()) emit watcher_->SongsMTimeUpdated(touched_songs);
-
-  if (!deleted_songs.isEmpty()) emit watcher_->SongsDeleted(deleted_songs);
-
-  if (!readded_songs.isEmpty()) emit watcher_->SongsReadded(readded_songs);
+  CommitSongs();
 
   if (!new_subdirs.isEmpty()) emit watcher_->SubdirsDiscovered(new_subdirs);
 
@@ -139,6 +165,29 @@ LibraryWatcher::ScanTransaction::~ScanTransaction() {
   }
 }
 
+void LibraryWatcher::ScanTransaction::CommitSongs() {
+  if (!new_songs.isEmpty()) emit watcher_->NewOrUpdatedSongs(new_songs);
+
+  if (!touched_songs.isEmpty()) emit watcher_->SongsMTimeUpdated(touched_songs);
+
+  if (!deleted_songs.isEmpty()) emit watcher_->SongsDeleted(deleted_songs);
+
+  if (!readded_songs.isEmpty()) emit watcher_->SongsReadded(readded_songs);
+
+  new_songs.clear();
+  touched_songs.clear();
+  deleted_songs.clear();
+  readded_songs.clear();
+}
+
+void LibraryWatcher::ScanTransaction::CommitSongsIfNeeded() {
+  if (aborted()) return;
+
+  const int pending = new_songs.count() + touched_songs.count() +
+                      deleted_songs.count() + readded_songs.count();
+  if (pending >= kScanCommitBatchSize) CommitSongs();
+}
+
 void LibraryWatcher::ScanTransaction::AddToProgress(int n) {
   progress_ += n;
   watcher_->task_manager_->SetTaskProgress(task_id_, progress_, progress_max_);
@@ -151,33 +200,46 @@ void LibraryWatcher::ScanTransaction::AddToProgressMax(int n) {
 
 SongList LibraryWatcher::ScanTransaction::FindSongsInSubdirectory(
     const QString& path) {
+  if (cached_songs_dirty_ && subdir_queries_ < kMaxSubdirQueries) {
+    // Only a few subdirectories have changed so far.  Loading just their songs
+    // is much cheaper than loading every song in the directory.
+    subdir_queries_++;
+    return watcher_->backend_->FindSongsInSubdirectory(dir_id(), path);
+  }
+
   if (cached_songs_dirty_) {
-    cached_songs_ = watcher_->backend_->FindSongsInDirectory(dir_id());
+    cached_songs_.clear();
+    for (const Song& song :
+         watcher_->backend_->FindSongsInDirectory(dir_id())) {
+      cached_songs_[DirectoryPart(song.url().toLocalFile())] << song;
+    }
     cached_songs_dirty_ = false;
   }
 
-  // TODO: Make this faster
-  SongList ret;
-  for (const Song& song : cached_songs_) {
-    if (song.url().toLocalFile().section('/', 0, -2) == path) ret << song;
-  }
-  return ret;
+  return cached_songs_.value(path);
 }
 
 void LibraryWatcher::ScanTransaction::SetKnownSubdirs(
     const SubdirectoryList& subdirs) {
   known_subdirs_ = subdirs;
   known_subdirs_dirty_ = false;
+
+  seen_subdirs_.clear();
+  known_subdirs_by_parent_.clear();
+  for (const Subdirectory& subdir : known_subdirs_) {
+    if (subdir.mtime == 0) continue;
+
+    seen_subdirs_.insert(subdir.path);
+    known_subdirs_by_parent_[subdir.path.left(
+        subdir.path.lastIndexOf(QDir::separator()))] << subdir;
+  }
 }
 
 bool LibraryWatcher::ScanTransaction::HasSeenSubdir(const QString& path) {
   if (known_subdirs_dirty_)
     SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_id()));
 
-  for (const Subdirectory& subdir : known_subdirs_) {
-    if (subdir.path == path && subdir.mtime != 0) return true;
-  }
-  return false;
+  return seen_subdirs_.contains(path);
 }
 
 SubdirectoryList LibraryWatcher::ScanTransaction::GetImmediateSubdirs(
@@ -185,15 +247,7 @@ SubdirectoryList LibraryWatcher::ScanTransaction::GetImmediateSubdirs(
   if (known_subdirs_dirty_)
     SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_id()));
 
-  SubdirectoryList ret;
-  for (const Subdirectory& subdir : known_subdirs_) {
-    if (subdir.path.left(subdir.path.lastIndexOf(QDir::separator())) == path &&
-        subdir.mtime != 0) {
-      ret << subdir;
-    }
-  }
-
-  return ret;
+  return known_subdirs_by_parent_.value(path);
 }
 
 SubdirectoryList LibraryWatcher::ScanTransaction::GetAllSubdirs() {
@@ -262,6 +316,8 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
                                       const Subdirectory& subdir,
                                       ScanTransaction* t,
                                       bool force_noincremental) {
+  Throttle(t);
+
   QFileInfo path_info(path);
   QDir      path_dir(path);
 
@@ -343,18 +399,84 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
   // Ask the database for a list of files in this directory
   SongList songs_in_db = t->FindSongsInSubdirectory(path);
 
+  ScanFiles(path, &files_on_disk, songs_in_db, &album_art, t);
+  if (t->aborted()) return;
+
+  // Look for deleted songs
+  const QSet<QString> files_on_disk_set = files_on_disk.toSet();
+  QStringList deleted_files;
+  for (const Song& song : songs_in_db) {
+    if (!song.is_unavailable() &&
+        !files_on_disk_set.contains(song.url().toLocalFile())) {
+      qLog(Debug) << "Song deleted from disk:" << song.url().toLocalFile();
+      t->deleted_songs << song;
+      deleted_files << song.url().toLocalFile();
+    }
+  }
+
+  // Save the playlists statting these files again.
+  FileExistenceCache::Instance()->Record(files_on_disk, true);
+  FileExistenceCache::Instance()->Record(deleted_files, false);
+
+  // Add this subdir to the new or touched list
+  Subdirectory updated_subdir;
+  updated_subdir.directory_id = t->dir_id();
+  updated_subdir.mtime =
+      path_info.exists() ? path_info.lastModified().toTime_t() : 0;
+  updated_subdir.path = path;
+
+  if (subdir.directory_id == -1)
+    t->new_subdirs << updated_subdir;
+  else
+    t->touched_subdirs << updated_subdir;
+
+  if (updated_subdir.mtime ==
+      0) {  // Subdirectory deleted, mark it for removal from the watcher.
+    t->deleted_subdirs << updated_subdir;
+  }
+
+  t->AddToProgress(1);
+  t->CommitSongsIfNeeded();
+
+  // Recurse into the new subdirs that we found
+  t->AddToProgressMax(my_new_subdirs.count());
+  for (const Subdirectory& my_new_subdir : my_new_subdirs) {
+    if (t->aborted()) return;
+    ScanSubdirectory(my_new_subdir.path, my_new_subdir, t, true);
+  }
+}
+
+void LibraryWatcher::ScanFiles(const QString& path, QStringList* files_on_disk,
+                               const SongList& songs_in_db,
+                               QMap<QString, QStringList>* album_art,
+                               ScanTransaction* t) {
   QSet<QString> cues_processed;
 
-  // Now compare the list from the database with the list of files on disk
-  for (const QString& file : files_on_disk) {
+  // Files that need their tags read are collected here and read together
+  // once we know about all of them.
+  QList<PendingTagRead> pending_reads;
+  QStringList files_to_read;
+
+  // Index the songs by filename.  A file with many cue sections appears more
+  // than once, the first one is used as the file's song.
+  QHash<QString, SongList> songs_by_path;
+  for (const Song& song : songs_in_db) {
+    songs_by_path[song.url().toLocalFile()] << song;
+  }
+
+  // Now compare the list from the database with the list of files on disk.
+  // Iterate over a copy since files that disappear are removed from the list.
+  const QStringList files = *files_on_disk;
+  for (const QString& file : files) {
     if (t->aborted()) return;
 
     // associated cue
     QString matching_cue = NoExtensionPart(file) + ".cue";
+    const uint matching_cue_mtime = GetMtimeForCue(matching_cue);
 
-    Song matching_song;
-    if (FindSongByPath(songs_in_db, file, &matching_song)) {
-      uint matching_cue_mtime = GetMtimeForCue(matching_cue);
+    const SongList file_songs_in_db = songs_by_path.value(file);
+    Song matching_song = file_songs_in_db.value(0);
+    if (matching_song.is_valid()) {
 
       // The song is in the database and still on disk.
       // Check the mtime to see if it's been changed since it was added.
@@ -363,13 +485,15 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
       if (!file_info.exists()) {
         // Partially fixes race condition - if file was removed between being
         // added to the list and now.
-        files_on_disk.removeAll(file);
+        files_on_disk->removeAll(file);
         continue;
       }
 
       // cue sheet's path from library (if any)
       QString song_cue = matching_song.cue_path();
-      uint song_cue_mtime = GetMtimeForCue(song_cue);
+      uint song_cue_mtime = song_cue == matching_cue
+                                ? matching_cue_mtime
+                                : GetMtimeForCue(song_cue);
 
       bool cue_deleted = song_cue_mtime == 0 && matching_song.has_cue();
       bool cue_added = matching_cue_mtime != 0 && !matching_song.has_cue();
@@ -382,7 +506,7 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
           cue_deleted || cue_added;
 
       // Also want to look to see whether the album art has changed
-      QString image = ImageForSong(file, &album_art, t);
+      QString image = ImageForSong(file, album_art, t);
       if ((matching_song.art_automatic().isEmpty() && !image.isEmpty()) ||
           (!matching_song.art_automatic().isEmpty() &&
            !matching_song.has_embedded_cover() &&
@@ -396,21 +520,36 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
 
         // if cue associated...
         if (!cue_deleted && (matching_song.has_cue() || cue_added)) {
-          UpdateCueAssociatedSongs(file, path, matching_cue, image, t);
+          UpdateCueAssociatedSongs(file, path, matching_cue,
+                                   matching_cue_mtime, file_songs_in_db, image,
+                                   t);
           // if no cue or it's about to lose it...
         } else {
-          UpdateNonCueAssociatedSong(file, matching_song, image, cue_deleted,
-                                     t);
+          PendingTagRead pending;
+          pending.file = file;
+          pending.matching_song = matching_song;
+          pending.songs_in_db = file_songs_in_db;
+          pending.image = image;
+          pending.cue_deleted = cue_deleted;
+          pending_reads << pending;
+          files_to_read << file;
         }
       }
 
       // nothing has changed - mark the song available without re-scanning
       if (matching_song.is_unavailable()) t->readded_songs << matching_song;
 
-    } else {
+    } else if (!matching_cue_mtime) {
       // The song is on disk but not in the DB
+      PendingTagRead pending;
+      pending.file = file;
+      pending_reads << pending;
+      files_to_read << file;
+    } else {
+      // The song is on disk but not in the DB, and it has a cue sheet
       SongList song_list =
-          ScanNewFile(file, path, matching_cue, &cues_processed);
+          ScanNewCueFile(file, path, matching_cue, matching_cue_mtime,
+                         &cues_processed);
 
       if (song_list.isEmpty()) {
         continue;
@@ -418,7 +557,7 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
 
       qLog(Debug) << file << "created";
       // choose an image for the song(s)
-      QString image = ImageForSong(file, &album_art, t);
+      QString image = ImageForSong(file, album_art, t);
 
       for (Song song : song_list) {
         song.set_directory_id(t->dir_id());
@@ -429,52 +568,105 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
     }
   }
 
-  // Look for deleted songs
-  for (const Song& song : songs_in_db) {
-    if (!song.is_unavailable() &&
-        !files_on_disk.contains(song.url().toLocalFile())) {
-      qLog(Debug) << "Song deleted from disk:" << song.url().toLocalFile();
-      t->deleted_songs << song;
+  if (t->aborted()) return;
+
+  // Read the tags of all the new and changed files
+  const QHash<QString, Song> songs_on_disk =
+      ReadFilesInParallel(files_to_read, t);
+
+  for (const PendingTagRead& pending : pending_reads) {
+    if (t->aborted()) return;
+
+    Song song_on_disk = songs_on_disk.value(pending.file);
+
+    if (pending.matching_song.is_valid()) {
+      UpdateNonCueAssociatedSong(pending.file, pending.matching_song,
+                                 pending.songs_in_db, pending.image,
+                                 pending.cue_deleted, song_on_disk, t);
+    } else if (song_on_disk.is_valid()) {
+      qLog(Debug) << pending.file << "created";
+
+      song_on_disk.set_directory_id(t->dir_id());
+      if (song_on_disk.art_automatic().isEmpty()) {
+        song_on_disk.set_art_automatic(
+            ImageForSong(pending.file, album_art, t));
+      }
+
+      t->new_songs << song_on_disk;
     }
   }
+}
 
-  // Add this subdir to the new or touched list
-  Subdirectory updated_subdir;
-  updated_subdir.directory_id = t->dir_id();
-  updated_subdir.mtime =
-      path_info.exists() ? path_info.lastModified().toTime_t() : 0;
-  updated_subdir.path = path;
+void LibraryWatcher::ScanChangedFiles(const QString& path,
+                                      const QStringList& files,
+                                      ScanTransaction* t) {
+  Subdirectory subdir;
+  subdir.directory_id = t->dir_id();
+  subdir.mtime = 0;
+  subdir.path = path;
+
+  // Album art, cue sheets and .nomedia files affect the other files in the
+  // directory as well, so changes to those need a full rescan.
+  for (const QString& file : files) {
+    const QString ext_part(ExtensionPart(file));
+    const QString filename(file.section('/', -1));
+    if (sValidImages.contains(ext_part) || ext_part == "cue" ||
+        filename == kNoMediaFile || filename == kNoMusicFile) {
+      ScanSubdirectory(path, subdir, t, true);
+      return;
+    }
+  }
 
-  if (subdir.directory_id == -1)
-    t->new_subdirs << updated_subdir;
-  else
-    t->touched_subdirs << updated_subdir;
+  QDir path_dir(path);
+  if (path_dir.exists(kNoMediaFile) || path_dir.exists(kNoMusicFile)) {
+    t->AddToProgress(1);
+    return;
+  }
 
-  if (updated_subdir.mtime ==
-      0) {  // Subdirectory deleted, mark it for removal from the watcher.
-    t->deleted_subdirs << updated_subdir;
+  // We still need to know which images are in the directory to pick album
+  // art for new songs, but there's no need to stat anything.
+  QMap<QString, QStringList> album_art;
+  QDirIterator it(path, QDir::Files | QDir::NoDotAndDotDot);
+  while (it.hasNext()) {
+    const QString child(it.next());
+    if (sValidImages.contains(ExtensionPart(child))) {
+      album_art[DirectoryPart(child)] << child;
+    }
   }
 
-  t->AddToProgress(1);
+  SongList songs_in_db = t->FindSongsInSubdirectory(path);
 
-  // Recurse into the new subdirs that we found
-  t->AddToProgressMax(my_new_subdirs.count());
-  for (const Subdirectory& my_new_subdir : my_new_subdirs) {
-    if (t->aborted()) return;
-    ScanSubdirectory(my_new_subdir.path, my_new_subdir, t, true);
+  QStringList files_on_disk;
+  for (const QString& file : files) {
+    if (file.section('/', -1).startsWith('.')) continue;
+
+    const bool exists = QFile::exists(file);
+    FileExistenceCache::Instance()->Record(file, exists);
+    if (exists) {
+      files_on_disk << file;
+    } else {
+      for (const Song& song : songs_in_db) {
+        if (!song.is_unavailable() && song.url().toLocalFile() == file) {
+          qLog(Debug) << "Song deleted from disk:" << file;
+          t->deleted_songs << song;
+        }
+      }
+    }
   }
+
+  ScanFiles(path, &files_on_disk, songs_in_db, &album_art, t);
+
+  t->AddToProgress(1);
+  t->CommitSongsIfNeeded();
 }
 
 void LibraryWatcher::UpdateCueAssociatedSongs(const QString& file,
                                               const QString& path,
                                               const QString& matching_cue,
+                                              uint matching_cue_mtime,
+                                              const SongList& old_sections,
                                               const QString& image,
                                               ScanTransaction* t) {
-  QFile cue(matching_cue);
-  cue.open(QIODevice::ReadOnly);
-
-  SongList old_sections = backend_->GetSongsByUrl(QUrl::fromLocalFile(file));
-
   QHash<quint64, Song> sections_map;
   for (const Song& song : old_sections) {
     sections_map[song.beginning_nanosec()] = song;
@@ -483,7 +675,7 @@ void LibraryWatcher::UpdateCueAssociatedSongs(const QString& file,
   QSet<int> used_ids;
 
   // update every song that's in the cue and library
-  for (Song cue_song : cue_parser_->Load(&cue, matching_cue, path)) {
+  for (Song cue_song : LoadCue(matching_cue, path, matching_cue_mtime)) {
     cue_song.set_directory_id(t->dir_id());
 
     Song matching = sections_map[cue_song.beginning_nanosec()];
@@ -507,71 +699,112 @@ void LibraryWatcher::UpdateCueAssociatedSongs(const QString& file,
 
 void LibraryWatcher::UpdateNonCueAssociatedSong(const QString& file,
                                                 const Song& matching_song,
+                                                const SongList& old_sections,
                                                 const QString& image,
                                                 bool cue_deleted,
+                                                Song song_on_disk,
                                                 ScanTransaction* t) {
   // if a cue got deleted, we turn it's first section into the new
   // 'raw' (cueless) song and we just remove the rest of the sections
   // from the library
   if (cue_deleted) {
-    for (const Song& song :
-         backend_->GetSongsByUrl(QUrl::fromLocalFile(file))) {
+    for (const Song& song : old_sections) {
       if (!song.IsMetadataEqual(matching_song)) {
         t->deleted_songs << song;
       }
     }
   }
 
-  Song song_on_disk;
   song_on_disk.set_directory_id(t->dir_id());
-  TagReaderClient::Instance()->ReadFileBlocking(file, &song_on_disk);
 
   if (song_on_disk.is_valid()) {
     PreserveUserSetData(file, image, matching_song, &song_on_disk, t);
   }
 }
 
-SongList LibraryWatcher::ScanNewFile(const QString& file, const QString& path,
-                                     const QString& matching_cue,
-                                     QSet<QString>* cues_processed) {
+SongList LibraryWatcher::ScanNewCueFile(const QString& file,
+                                        const QString& path,
+                                        const QString& matching_cue,
+                                        uint matching_cue_mtime,
+                                        QSet<QString>* cues_processed) {
   SongList song_list;
 
-  uint matching_cue_mtime = GetMtimeForCue(matching_cue);
-  // if it's a cue - create virtual tracks
-  if (matching_cue_mtime) {
-    // don't process the same cue many times
-    if (cues_processed->contains(matching_cue)) return song_list;
-
-    QFile cue(matching_cue);
-    cue.open(QIODevice::ReadOnly);
-
-    // Ignore FILEs pointing to other media files. Also, watch out for incorrect
-    // media files. Playlist parser for CUEs considers every entry in sheet
-    // valid and we don't want invalid media getting into library!
-    QString file_nfd = file.normalized(QString::NormalizationForm_D);
-    for (const Song& cue_song : cue_parser_->Load(&cue, matching_cue, path)) {
-      if (cue_song.url().toLocalFile().normalized(QString::NormalizationForm_D) == file_nfd) {
-        if (TagReaderClient::Instance()->IsMediaFileBlocking(file)) {
-          song_list << cue_song;
-        }
+  // don't process the same cue many times
+  if (cues_processed->contains(matching_cue)) return song_list;
+
+  // Ignore FILEs pointing to other media files. Also, watch out for incorrect
+  // media files. Playlist parser for CUEs considers every entry in sheet
+  // valid and we don't want invalid media getting into library!
+  QString file_nfd = file.normalized(QString::NormalizationForm_D);
+  for (const Song& cue_song :
+       LoadCue(matching_cue, path, matching_cue_mtime)) {
+    if (cue_song.url().toLocalFile().normalized(QString::NormalizationForm_D) == file_nfd) {
+      if (TagReaderClient::Instance()->IsMediaFileBlocking(
+              file, pb::tagreader::READ_FAST)) {
+        song_list << cue_song;
       }
     }
+  }
 
-    if (!song_list.isEmpty()) {
-      *cues_processed << matching_cue;
-    }
+  if (!song_list.isEmpty()) {
+    *cues_processed << matching_cue;
+  }
 
-    // it's a normal media file
-  } else {
-    Song song;
-    TagReaderClient::Instance()->ReadFileBlocking(file, &song);
+  return song_list;
+}
+
+QHash<QString, Song> LibraryWatcher::ReadFilesInParallel(
+    const QStringList& files, ScanTransaction* t) {
+  QHash<QString, Song> ret;
+  if (files.isEmpty()) return ret;
+
+  // Small directories are spread over as many requests as we're allowed to
+  // have in flight, big ones are sent in batches of the maximum size.
+  const int batch_size =
+      qBound(1, (files.count() + scan_parallelism_ - 1) / scan_parallelism_,
+             TagReaderClient::kReadFilesBatchSize);
+
+  QQueue<QPair<QStringList, TagReaderReply*>> in_flight;
+  int next = 0;
+
+  forever {
+    // Keep the tag reader workers fed
+    while (next < files.count() && !t->aborted() &&
+           in_flight.count() < scan_parallelism_) {
+      Throttle(t);
+      const QStringList batch = files.mid(next, batch_size);
+      // A scan only needs the tags and the duration.
+      in_flight.enqueue(qMakePair(
+          batch, TagReaderClient::Instance()->ReadFiles(
+                     batch, pb::tagreader::READ_FAST)));
+      next += batch.count();
+    }
 
-    if (song.is_valid()) {
-      song_list << song;
+    if (in_flight.isEmpty()) break;
+
+    // Replies are collected in request order.  The other requests carry on
+    // in the background while we wait for this one.
+    QPair<QStringList, TagReaderReply*> pending = in_flight.dequeue();
+    if (pending.second->WaitForFinished()) {
+      const pb::tagreader::ReadFilesResponse& response =
+          pending.second->message().read_files_response();
+      for (int i = 0; i < pending.first.count() && i < response.metadata_size();
+           ++i) {
+        Song song;
+        song.InitFromProtobuf(response.metadata(i));
+        ret[pending.first[i]] = song;
+      }
     }
+    pending.second->deleteLater();
   }
 
-  return song_list;
+  return ret;
+}
+
+void LibraryWatcher::Throttle(ScanTransaction* t) {
+  if (scan_throttle_) {
+    scan_throttle_->Wait([t]() { return t->aborted(); });
+  }
 }
 
 void LibraryWatcher::PreserveUserSetData(const QString& file,
@@ -604,6 +837,22 @@ void LibraryWatcher::PreserveUserSetData(const QString& file,
   }
 }
 
+SongList LibraryWatcher::LoadCue(const QString& cue_path, const QString& path,
+                                 uint mtime) {
+  const CachedCue* cached = cue_cache_.object(cue_path);
+  if (cached && cached->mtime_ == mtime) return cached->songs_;
+
+  QFile cue(cue_path);
+  cue.open(QIODevice::ReadOnly);
+
+  CachedCue* entry = new CachedCue;
+  entry->mtime_ = mtime;
+  entry->songs_ = cue_parser_->Load(&cue, cue_path, path);
+  const SongList ret = entry->songs_;
+  cue_cache_.insert(cue_path, entry);
+  return ret;
+}
+
 uint LibraryWatcher::GetMtimeForCue(const QString& cue_path) {
   // slight optimisation
   if (cue_path.isEmpty()) {
@@ -627,6 +876,10 @@ void LibraryWatcher::AddWatch(const Directory& dir, const QString& path) {
   connect(fs_watcher_, SIGNAL(PathChanged(const QString&)), this,
           SLOT(DirectoryChanged(const QString&)), Qt::UniqueConnection);
   if (!fs_watcher_->AddPath(path)) {
+    // We won't hear about changes to this directory, so look for them every
+    // now and then instead.
+    StartPeriodicScans();
+
     // Since this may be a system error, don't spam the user.
     static int errCount = 0;
     if (errCount++ == 0) {
@@ -670,6 +923,7 @@ void LibraryWatcher::RemoveDirectory(int dir_id) {
 
 void LibraryWatcher::DoRemoveDirectory(int dir_id) {
   rescan_queue_.remove(dir_id);
+  changed_files_queue_.remove(dir_id);
 
   const WatchedDir& dir = watched_dirs_.list_[dir_id];
   // Stop watching the directory's subdirectories
@@ -680,18 +934,6 @@ void LibraryWatcher::DoRemoveDirectory(int dir_id) {
   watched_dirs_.Remove(dir_id);
 }
 
-bool LibraryWatcher::FindSongByPath(const SongList& list, const QString& path,
-                                    Song* out) {
-  // TODO: Make this faster
-  for (const Song& song : list) {
-    if (song.url().toLocalFile() == path) {
-      *out = song;
-      return true;
-    }
-  }
-  return false;
-}
-
 void LibraryWatcher::DirectoryChanged(const QString& subdir) {
   // Find what dir it was in
   QHash<QString, Directory>::const_iterator it =
@@ -710,8 +952,40 @@ void LibraryWatcher::DirectoryChanged(const QString& subdir) {
   if (!rescan_paused_) rescan_timer_->start();
 }
 
+void LibraryWatcher::FilesChanged(const QString& subdir,
+                                  const QStringList& files) {
+  // Find what dir it was in
+  QHash<QString, Directory>::const_iterator it =
+      subdir_mapping_.constFind(subdir);
+  if (it == subdir_mapping_.constEnd()) {
+    return;
+  }
+  Directory dir = *it;
+
+  qLog(Debug) << files.count() << "files changed in" << subdir
+              << "under directory" << dir.path << "id" << dir.id;
+
+  // Queue the files for rescanning
+  for (const QString& file : files) {
+    changed_files_queue_[dir.id][subdir].insert(file);
+  }
+
+  if (!rescan_paused_) rescan_timer_->start();
+}
+
+void LibraryWatcher::StartPeriodicScans() {
+  if (periodic_scan_timer_->isActive()) return;
+
+  qLog(Info) << "Can't watch every library directory, looking for changes"
+             << "every" << kPeriodicScanIntervalMinutes << "minutes instead";
+  periodic_scan_timer_->start(kPeriodicScanIntervalMinutes * 60 * 1000);
+}
+
 void LibraryWatcher::RescanPathsNow() {
-  for (int id : rescan_queue_.keys()) {
+  QSet<int> ids = rescan_queue_.keys().toSet();
+  ids.unite(changed_files_queue_.keys().toSet());
+
+  for (int id : ids) {
     if (!watched_dirs_.list_.contains(id)) {
       qLog(Warning) << "Rescan id" << id << "not in watch list.";
       continue;
@@ -720,10 +994,14 @@ void LibraryWatcher::RescanPathsNow() {
 
     if (!dir.active_) continue;
 
+    const QStringList paths = rescan_queue_.value(id);
+    const QHash<QString, QSet<QString>> changed_files =
+        changed_files_queue_.value(id);
+
     ScanTransaction transaction(this, dir, false);
-    transaction.AddToProgressMax(rescan_queue_[id].count());
+    transaction.AddToProgressMax(paths.count() + changed_files.count());
 
-    for (const QString& path : rescan_queue_[id]) {
+    for (const QString& path : paths) {
       if (transaction.aborted()) return;
       Subdirectory subdir;
       subdir.directory_id = id;
@@ -731,9 +1009,22 @@ void LibraryWatcher::RescanPathsNow() {
       subdir.path = path;
       ScanSubdirectory(path, subdir, &transaction);
     }
+
+    // Directories that were rescanned completely already picked up these
+    // files.
+    for (auto it = changed_files.constBegin(); it != changed_files.constEnd();
+         ++it) {
+      if (transaction.aborted()) return;
+      if (paths.contains(it.key())) {
+        transaction.AddToProgress(1);
+        continue;
+      }
+      ScanChangedFiles(it.key(), it.value().toList(), &transaction);
+    }
   }
 
   rescan_queue_.clear();
+  changed_files_queue_.clear();
 
   emit CompilationsNeedUpdating();
 }
@@ -822,6 +1113,9 @@ void LibraryWatcher::ReloadSettings() {
   s.beginGroup(kSettingsGroup);
   scan_on_startup_ = s.value("startup_scan", true).toBool();
   monitor_ = s.value("monitor", true).toBool();
+  scan_parallelism_ =
+      qMax(1, s.value("scan_parallelism", QThread::idealThreadCount() * 2)
+                  .toInt());
 
   best_image_filters_.clear();
   QStringList filters =
@@ -852,7 +1146,10 @@ void LibraryWatcher::SetRescanPausedAsync(bool pause) {
 
 void LibraryWatcher::SetRescanPaused(bool pause) {
   rescan_paused_ = pause;
-  if (!rescan_paused_ && !rescan_queue_.isEmpty()) RescanPathsNow();
+  if (!rescan_paused_ &&
+      (!rescan_queue_.isEmpty() || !changed_files_queue_.isEmpty())) {
+    RescanPathsNow();
+  }
 }
 
 void LibraryWatcher::IncrementalScanAsync() {
@@ -21,10 +21,12 @@
 #include "directory.h"
 #include "core/song.h"
 
+#include <QCache>
 #include <QHash>
 #include <QMap>
 #include <QMutex>
 #include <QObject>
+#include <QSet>
 #include <QStringList>
 
 class QFileSystemWatcher;
@@ -33,6 +35,7 @@ class QTimer;
 class CueParser;
 class FileSystemWatcherInterface;
 class LibraryBackend;
+class ScanThrottle;
 class TaskManager;
 
 class LibraryWatcher : public QObject {
@@ -50,6 +53,9 @@ class LibraryWatcher : public QObject {
   void set_device_name(const QString& device_name) {
     device_name_ = device_name;
   }
+  void set_scan_throttle(ScanThrottle* scan_throttle) {
+    scan_throttle_ = scan_throttle;
+  }
 
   void IncrementalScanAsync();
   void FullScanAsync();
@@ -95,9 +101,9 @@ class LibraryWatcher : public QObject {
   // adds its results to the members of this transaction class, and they are
   // "committed" through calls to the LibraryBackend in the transaction's dtor.
   // The transaction also caches the list of songs in this directory according
-  // to the library.  Multiple calls to FindSongsInSubdirectory during one
-  // transaction will only result in one call to
-  // LibraryBackend::FindSongsInDirectory.
+  // to the library.  The first few calls to FindSongsInSubdirectory query the
+  // database for just that subdirectory, after that the songs of the whole
+  // directory are loaded once with LibraryBackend::FindSongsInDirectory.
   class ScanTransaction {
    public:
     ScanTransaction(LibraryWatcher* watcher,
@@ -114,6 +120,11 @@ class LibraryWatcher : public QObject {
     void AddToProgress(int n = 1);
     void AddToProgressMax(int n);
 
+    // Sends the songs found so far to the backend if there are enough of
+    // them, so the database can commit them while the scan carries on.
+    // Subdirectories are still only committed when the transaction ends.
+    void CommitSongsIfNeeded();
+
     int dir_id() const { return dir_.id; }
     bool is_incremental() const { return incremental_; }
     bool ignores_mtime() const { return ignores_mtime_; }
@@ -131,6 +142,8 @@ class LibraryWatcher : public QObject {
    private:
     ScanTransaction& operator=(const ScanTransaction&) { return *this; }
 
+    void CommitSongs();
+
     int task_id_;
     int progress_;
     int progress_max_;
@@ -147,15 +160,23 @@ class LibraryWatcher : public QObject {
 
     LibraryWatcher* watcher_;
 
-    SongList cached_songs_;
+    // Subdirectory path -> songs directly inside it
+    QHash<QString, SongList> cached_songs_;
     bool cached_songs_dirty_;
+    int subdir_queries_;
 
     SubdirectoryList known_subdirs_;
+    // Paths of the known subdirectories that have been scanned before
+    QSet<QString> seen_subdirs_;
+    // Parent path -> known subdirectories inside it
+    QHash<QString, SubdirectoryList> known_subdirs_by_parent_;
     bool known_subdirs_dirty_;
   };
 
  private slots:
   void DirectoryChanged(const QString& path);
+  void FilesChanged(const QString& path, const QStringList& files);
+  void StartPeriodicScans();
   void IncrementalScanNow();
   void FullScanNow();
   void RescanPathsNow();
@@ -164,8 +185,17 @@ class LibraryWatcher : public QObject {
   void DoRemoveDirectory(int dir_id);
 
  private:
-  static bool FindSongByPath(const SongList& list, const QString& path,
-                             Song* out);
+  // Compares the given files on disk with the songs the library knows about
+  // in the same directory, and adds new or changed songs to the transaction.
+  // Files that turn out to have disappeared are removed from files_on_disk.
+  void ScanFiles(const QString& path, QStringList* files_on_disk,
+                 const SongList& songs_in_db,
+                 QMap<QString, QStringList>* album_art, ScanTransaction* t);
+  // Rescans only the given files in a directory, for filesystem watchers that
+  // tell us which files changed.
+  void ScanChangedFiles(const QString& path, const QStringList& files,
+                        ScanTransaction* t);
+
   inline static QString NoExtensionPart(const QString& fileName);
   inline static QString ExtensionPart(const QString& fileName);
   inline static QString DirectoryPart(const QString& fileName);
@@ -178,34 +208,67 @@ class LibraryWatcher : public QObject {
   uint GetMtimeForCue(const QString& cue_path);
   void PerformScan(bool incremental, bool ignore_mtimes);
 
+  // A media file whose tags have to be read from disk before it can be added
+  // to or updated in the library.
+  struct PendingTagRead {
+    PendingTagRead() : cue_deleted(false) {}
+
+    QString file;
+    // Invalid if the file isn't in the library yet.
+    Song matching_song;
+    // Every song in the library with this file, more than one if it had a
+    // cue sheet.
+    SongList songs_in_db;
+    QString image;
+    bool cue_deleted;
+  };
+
+  // Reads the tags of all the given files using batched ReadFiles requests,
+  // keeping up to scan_parallelism_ requests in flight at once so that every
+  // tag reader worker is kept busy.  Files missing from the result could not
+  // be read.
+  QHash<QString, Song> ReadFilesInParallel(const QStringList& files,
+                                           ScanTransaction* t);
+  // Gives way to playback, if there's a scan throttle.
+  void Throttle(ScanTransaction* t);
+
   // Updates the sections of a cue associated and altered (according to mtime)
   // media file during a scan.
   void UpdateCueAssociatedSongs(const QString& file, const QString& path,
                                 const QString& matching_cue,
+                                uint matching_cue_mtime,
+                                const SongList& old_sections,
                                 const QString& image, ScanTransaction* t);
   // Updates a single non-cue associated and altered (according to mtime) song
-  // during a scan.
+  // during a scan.  song_on_disk contains the tags that were just read from
+  // the file.
   void UpdateNonCueAssociatedSong(const QString& file,
                                   const Song& matching_song,
+                                  const SongList& old_sections,
                                   const QString& image, bool cue_deleted,
-                                  ScanTransaction* t);
+                                  Song song_on_disk, ScanTransaction* t);
   // Updates a new song with some metadata taken from it's equivalent old
   // song (for example rating and score).
   void PreserveUserSetData(const QString& file, const QString& image,
                            const Song& matching_song, Song* out,
                            ScanTransaction* t);
-  // Scans a single media file that's present on the disk but not yet in the
-  // library.
+  // Scans a single cue associated media file that's present on the disk but
+  // not yet in the library.
   // It may result in a multiple files added to the library when the media file
-  // has many sections (like a CUE related media file).
-  SongList ScanNewFile(const QString& file, const QString& path,
-                       const QString& matching_cue,
-                       QSet<QString>* cues_processed);
+  // has many sections.  Media files without a cue sheet are read in bulk by
+  // ReadFilesInParallel instead.
+  SongList ScanNewCueFile(const QString& file, const QString& path,
+                          const QString& matching_cue, uint matching_cue_mtime,
+                          QSet<QString>* cues_processed);
+  // Returns every section of a cue sheet, parsing it only if it's not in
+  // cue_cache_ or has been modified since it was cached.
+  SongList LoadCue(const QString& cue_path, const QString& path, uint mtime);
 
  private:
   LibraryBackend* backend_;
   TaskManager* task_manager_;
   QString device_name_;
+  ScanThrottle* scan_throttle_;
 
   FileSystemWatcherInterface* fs_watcher_;
   QHash<QString, Directory> subdir_mapping_;
@@ -219,6 +282,8 @@ class LibraryWatcher : public QObject {
 
   bool scan_on_startup_;
   bool monitor_;
+  // Maximum number of tag reader requests in flight at once during a scan.
+  int scan_parallelism_;
 
   // All methods of QMap are reentrant We should only need to worry about
   // syncronizing methods that remove directories on the watcher thread and
@@ -244,12 +309,25 @@ class LibraryWatcher : public QObject {
   QTimer* rescan_timer_;
   QMap<int, QStringList>
       rescan_queue_;  // dir id -> list of subdirs to be scanned
+  // dir id -> subdir -> files in that subdir to be scanned
+  QMap<int, QHash<QString, QSet<QString>>> changed_files_queue_;
   bool rescan_paused_;
 
+  // Started when some directories can't be watched.
+  QTimer* periodic_scan_timer_;
+
   int total_watches_;
 
   CueParser* cue_parser_;
 
+  // Cue sheets are parsed again for each of their media files that changed,
+  // and a sheet with many FILEs can have lots of them.
+  struct CachedCue {
+    uint mtime_;
+    SongList songs_;
+  };
+  QCache<QString, CachedCue> cue_cache_;
+
   static QStringList sValidImages;
 };
 
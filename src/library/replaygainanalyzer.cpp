@@ -0,0 +1,303 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "replaygainanalyzer.h"
+
+#include <QSettings>
+#include <QThread>
+
+#include "librarybackend.h"
+#include "replaygainpipeline.h"
+#include "core/application.h"
+#include "core/closure.h"
+#include "core/logging.h"
+#include "core/tagreaderclient.h"
+#include "core/taskexecutor.h"
+#include "core/taskmanager.h"
+#include "core/thread.h"
+
+const int ReplayGainAnalyzer::kSongsPerPage = 100;
+const int ReplayGainAnalyzer::kMaxAlbumTracks = 40;
+const int ReplayGainAnalyzer::kAnalyseDelayMsec = 10000;
+
+ReplayGainAnalyzer::ReplayGainAnalyzer(Application* app,
+                                       LibraryBackend* backend,
+                                       QObject* parent)
+    : QObject(parent),
+      app_(app),
+      backend_(backend),
+      thread_(new Thread(this)),
+      analyse_timer_(new QTimer(this)),
+      kMaxActiveJobs(qMax(1, QThread::idealThreadCount() / 2)),
+      enabled_(false),
+      save_in_files_(false),
+      task_id_(-1),
+      finding_(false),
+      analyse_again_(false),
+      last_id_(-1),
+      total_(0),
+      done_(0) {
+  thread_->SetIoPriority(Utilities::IOPRIO_CLASS_IDLE);
+
+  analyse_timer_->setSingleShot(true);
+  analyse_timer_->setInterval(kAnalyseDelayMsec);
+  connect(analyse_timer_, SIGNAL(timeout()), SLOT(Analyse()));
+
+  ReloadSettings();
+}
+
+ReplayGainAnalyzer::~ReplayGainAnalyzer() {
+  for (ReplayGainPipeline* pipeline : active_jobs_.keys()) {
+    pipeline->deleteLater();
+  }
+  thread_->quit();
+  thread_->wait(1000);
+}
+
+void ReplayGainAnalyzer::ReloadSettings() {
+  QSettings s;
+  s.beginGroup(LibraryBackend::kSettingsGroup);
+  const bool was_enabled = enabled_;
+  enabled_ = s.value("analyse_replaygain", false).toBool();
+  save_in_files_ = s.value("save_replaygain_in_file", false).toBool();
+
+  if (enabled_ && !was_enabled) {
+    AnalyseLater();
+  } else if (!enabled_ && task_id_ != -1) {
+    // Pipelines that are already running will still save their results.
+    queue_.clear();
+    last_id_ = -1;
+    analyse_again_ = false;
+    MaybeFinish();
+  }
+}
+
+void ReplayGainAnalyzer::AnalyseLater() {
+  if (enabled_) analyse_timer_->start();
+}
+
+void ReplayGainAnalyzer::Analyse() {
+  if (!enabled_) return;
+
+  if (task_id_ != -1) {
+    // Look again for the new songs once this run is over.
+    analyse_again_ = true;
+    return;
+  }
+
+  if (!ReplayGainPipeline::IsAvailable()) {
+    qLog(Warning) << "Not calculating ReplayGain, the GStreamer rganalysis or"
+                     " concat element is missing";
+    return;
+  }
+
+  task_id_ = app_->task_manager()->StartTask(tr("Calculating ReplayGain"));
+  last_id_ = 0;
+  total_ = -1;
+  done_ = 0;
+  seen_dirs_.clear();
+
+  FindMoreJobs();
+}
+
+void ReplayGainAnalyzer::FindMoreJobs() {
+  finding_ = true;
+
+  QFuture<Page> future = TaskExecutor::Instance()->Run<Page>(
+      TaskExecutor::Lane_Bulk,
+      std::bind(&ReplayGainAnalyzer::FindJobs, backend_, last_id_,
+                total_ == -1, seen_dirs_, failed_ids_));
+  NewClosure(future, this,
+             SLOT(PageFound(QFuture<ReplayGainAnalyzer::Page>)), future);
+}
+
+ReplayGainAnalyzer::Page ReplayGainAnalyzer::FindJobs(
+    LibraryBackend* backend, int after_id, bool count, QSet<QString> seen_dirs,
+    QSet<int> failed_ids) {
+  Page ret;
+
+  const SongList songs =
+      backend->GetSongsWithoutReplayGain(after_id, kSongsPerPage);
+  if (count) ret.remaining_ = backend->CountSongsWithoutReplayGain();
+  if (songs.count() == kSongsPerPage) ret.last_id_ = songs.last().id();
+
+  for (const Song& song : songs) {
+    if (failed_ids.contains(song.id()) || song.url().scheme() != "file") {
+      continue;
+    }
+
+    const QString dir = song.url().toLocalFile().section('/', 0, -2);
+    if (seen_dirs.contains(dir)) continue;
+
+    // Analyse the whole directory together if it looks like an album.
+    SongList album;
+    for (const Song& other :
+         backend->FindSongsInSubdirectory(song.directory_id(), dir)) {
+      if (!other.is_unavailable() && !other.has_cue() &&
+          !failed_ids.contains(other.id())) {
+        album << other;
+      }
+    }
+
+    Job job;
+    if (album.count() >= 2 && album.count() <= kMaxAlbumTracks) {
+      seen_dirs << dir;
+      ret.dirs_ << dir;
+      job.songs_ = album;
+      job.album_ = true;
+    } else {
+      job.songs_ << song;
+    }
+    ret.jobs_ << job;
+  }
+
+  return ret;
+}
+
+void ReplayGainAnalyzer::PageFound(QFuture<Page> future) {
+  finding_ = false;
+  if (task_id_ == -1 || last_id_ == -1) {
+    // We were disabled while looking.
+    MaybeFinish();
+    return;
+  }
+
+  const Page page = future.result();
+  queue_.append(page.jobs_);
+  seen_dirs_.unite(page.dirs_);
+  last_id_ = page.last_id_;
+  if (total_ == -1) {
+    total_ = page.remaining_;
+    qLog(Info) << "Calculating ReplayGain for" << total_ << "songs";
+  }
+
+  UpdateProgress();
+  MaybeStartJobs();
+  MaybeFinish();
+}
+
+void ReplayGainAnalyzer::MaybeStartJobs() {
+  while (active_jobs_.count() < kMaxActiveJobs && !queue_.isEmpty()) {
+    StartJob(queue_.takeFirst());
+  }
+
+  // Keep the queue topped up so the pipelines never wait for the database.
+  if (!finding_ && last_id_ != -1 && queue_.count() < kMaxActiveJobs) {
+    FindMoreJobs();
+  }
+}
+
+void ReplayGainAnalyzer::StartJob(const Job& job) {
+  if (!thread_->isRunning()) thread_->start(QThread::IdlePriority);
+
+  QList<QUrl> urls;
+  for (const Song& song : job.songs_) urls << song.url();
+
+  ReplayGainPipeline* pipeline = new ReplayGainPipeline(urls, job.album_);
+  pipeline->moveToThread(thread_);
+  NewClosure(pipeline, SIGNAL(Finished(bool)), this,
+             SLOT(PipelineFinished(ReplayGainPipeline*)), pipeline);
+  active_jobs_[pipeline] = job;
+
+  qLog(Debug) << "Calculating ReplayGain for" << urls;
+  QMetaObject::invokeMethod(pipeline, "Start", Qt::QueuedConnection);
+}
+
+void ReplayGainAnalyzer::PipelineFinished(ReplayGainPipeline* pipeline) {
+  const Job job = active_jobs_.take(pipeline);
+  const QList<ReplayGainPipeline::Gain> track_gains = pipeline->track_gains();
+  const ReplayGainPipeline::Gain album_gain = pipeline->album_gain();
+  const bool success = pipeline->success();
+  pipeline->deleteLater();
+
+  SongList results;
+  for (int i = 0; i < job.songs_.count(); ++i) {
+    Song song = job.songs_[i];
+    if (!song.has_track_gain()) done_++;
+
+    const ReplayGainPipeline::Gain& track = track_gains[i];
+    if (!success || !track.is_valid()) {
+      if (job.album_) {
+        // One bad file spoils the album gain, so try the others on their own.
+        if (!song.has_track_gain()) {
+          Job retry;
+          retry.songs_ << song;
+          queue_ << retry;
+          done_--;
+        }
+      } else {
+        qLog(Warning) << "Couldn't calculate ReplayGain for"
+                      << song.url().toLocalFile();
+        failed_ids_ << song.id();
+      }
+      continue;
+    }
+
+    song.set_track_gain(track.gain_, track.peak_);
+    if (job.album_ && success && album_gain.is_valid()) {
+      song.set_album_gain(album_gain.gain_, album_gain.peak_);
+    }
+    results << song;
+  }
+
+  // An album with a missing track gain has an incomplete album gain too.
+  if (job.album_ && results.count() != job.songs_.count()) {
+    for (Song& song : results) song.set_album_gain(0, -1);
+  }
+
+  SaveResults(results);
+  UpdateProgress();
+  MaybeStartJobs();
+  MaybeFinish();
+}
+
+void ReplayGainAnalyzer::SaveResults(const SongList& songs) {
+  if (songs.isEmpty()) return;
+
+  TaskExecutor::Instance()->Run<void>(
+      TaskExecutor::Lane_Background,
+      std::bind(&LibraryBackend::UpdateReplayGain, backend_, songs));
+
+  if (save_in_files_) {
+    for (const Song& song : songs) {
+      TagReaderReply* reply =
+          TagReaderClient::Instance()->UpdateSongReplayGain(song);
+      connect(reply, SIGNAL(Finished(bool)), reply, SLOT(deleteLater()));
+    }
+  }
+}
+
+void ReplayGainAnalyzer::UpdateProgress() {
+  if (task_id_ == -1 || total_ <= 0) return;
+
+  app_->task_manager()->SetTaskProgress(task_id_, qMin(done_, total_), total_);
+}
+
+void ReplayGainAnalyzer::MaybeFinish() {
+  if (task_id_ == -1 || finding_ || last_id_ != -1 || !queue_.isEmpty() ||
+      !active_jobs_.isEmpty()) {
+    return;
+  }
+
+  qLog(Info) << "Calculated ReplayGain for" << done_ << "songs";
+  app_->task_manager()->SetTaskFinished(task_id_);
+  task_id_ = -1;
+
+  if (analyse_again_) {
+    analyse_again_ = false;
+    AnalyseLater();
+  }
+}
@@ -0,0 +1,117 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARY_REPLAYGAINANALYZER_H_
+#define LIBRARY_REPLAYGAINANALYZER_H_
+
+#include <QFuture>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+
+#include "core/song.h"
+
+class Application;
+class LibraryBackend;
+class ReplayGainPipeline;
+class Thread;
+
+// Calculates ReplayGain values for library songs that don't have any, as a
+// task on the TaskManager.  The songs are analysed a few at a time at idle
+// priority, and the songs in each album directory are analysed together so
+// they get an album gain as well.
+class ReplayGainAnalyzer : public QObject {
+  Q_OBJECT
+
+ public:
+  ReplayGainAnalyzer(Application* app, LibraryBackend* backend,
+                     QObject* parent = nullptr);
+  ~ReplayGainAnalyzer();
+
+  static const int kSongsPerPage;
+  // Directories with more songs than this probably aren't albums.
+  static const int kMaxAlbumTracks;
+  static const int kAnalyseDelayMsec;
+
+  struct Job {
+    Job() : album_(false) {}
+
+    SongList songs_;
+    bool album_;
+  };
+
+  struct Page {
+    Page() : last_id_(-1), remaining_(0) {}
+
+    QList<Job> jobs_;
+    // Directories that were taken as albums.
+    QSet<QString> dirs_;
+    // -1 once there are no more songs.
+    int last_id_;
+    int remaining_;
+  };
+
+ public slots:
+  void ReloadSettings();
+  // Starts analysing soon, so songs discovered in a library scan are taken
+  // all at once.
+  void AnalyseLater();
+
+ private slots:
+  void Analyse();
+  void PageFound(QFuture<ReplayGainAnalyzer::Page> future);
+  void PipelineFinished(ReplayGainPipeline* pipeline);
+
+ private:
+  static Page FindJobs(LibraryBackend* backend, int after_id, bool count,
+                       QSet<QString> seen_dirs, QSet<int> failed_ids);
+
+  void FindMoreJobs();
+  void MaybeStartJobs();
+  void StartJob(const Job& job);
+  void SaveResults(const SongList& songs);
+  void UpdateProgress();
+  void MaybeFinish();
+
+ private:
+  Application* app_;
+  LibraryBackend* backend_;
+  Thread* thread_;
+  QTimer* analyse_timer_;
+
+  const int kMaxActiveJobs;
+
+  bool enabled_;
+  bool save_in_files_;
+
+  int task_id_;
+  bool finding_;
+  bool analyse_again_;
+  // -1 once every song has been found.
+  int last_id_;
+  QList<Job> queue_;
+  QMap<ReplayGainPipeline*, Job> active_jobs_;
+  int total_;
+  int done_;
+
+  QSet<QString> seen_dirs_;
+  // Songs that couldn't be analysed aren't tried again until the next run.
+  QSet<int> failed_ids_;
+};
+
+#endif  // LIBRARY_REPLAYGAINANALYZER_H_
@@ -0,0 +1,289 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "replaygainpipeline.h"
+
+#include <QCoreApplication>
+#include <QThread>
+
+#include "core/logging.h"
+#include "core/signalchecker.h"
+#include "core/utilities.h"
+
+bool ReplayGainPipeline::sIsAvailable = false;
+
+ReplayGainPipeline::ReplayGainPipeline(const QList<QUrl>& urls, bool album)
+    : QObject(nullptr),
+      urls_(urls),
+      album_(album),
+      pipeline_(nullptr),
+      success_(false),
+      running_(false),
+      finished_(false) {
+  for (int i = 0; i < urls_.count(); ++i) track_gains_ << Gain();
+}
+
+ReplayGainPipeline::~ReplayGainPipeline() {
+  Cleanup();
+  qDeleteAll(analyses_);
+}
+
+bool ReplayGainPipeline::IsAvailable() {
+  if (!sIsAvailable) {
+    for (const char* name : {"rganalysis", "concat"}) {
+      GstElementFactory* factory = gst_element_factory_find(name);
+      if (!factory) {
+        return false;
+      }
+      gst_object_unref(factory);
+    }
+
+    sIsAvailable = true;
+  }
+
+  return sIsAvailable;
+}
+
+QList<ReplayGainPipeline::Gain> ReplayGainPipeline::track_gains() const {
+  QMutexLocker l(&mutex_);
+  return track_gains_;
+}
+
+ReplayGainPipeline::Gain ReplayGainPipeline::album_gain() const {
+  QMutexLocker l(&mutex_);
+  return album_gain_;
+}
+
+GstElement* ReplayGainPipeline::CreateElement(const QString& factory_name) {
+  GstElement* ret =
+      gst_element_factory_make(factory_name.toLatin1().constData(), nullptr);
+
+  if (ret) {
+    gst_bin_add(GST_BIN(pipeline_), ret);
+  } else {
+    qLog(Warning) << "Unable to create gstreamer element" << factory_name;
+  }
+
+  return ret;
+}
+
+GstElement* ReplayGainPipeline::CreateAnalysisChain(int index,
+                                                    GstElement** analysis) {
+  GstElement* convert = CreateElement("audioconvert");
+  GstElement* resample = CreateElement("audioresample");
+  *analysis = CreateElement("rganalysis");
+
+  if (!convert || !resample || !*analysis ||
+      !gst_element_link_many(convert, resample, *analysis, nullptr)) {
+    return nullptr;
+  }
+
+  Analysis* data = new Analysis;
+  data->pipeline_ = this;
+  data->index_ = index;
+  analyses_ << data;
+
+  GstPad* pad = gst_element_get_static_pad(*analysis, "src");
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                    &EventProbeCallback, data, nullptr);
+  gst_object_unref(pad);
+
+  return convert;
+}
+
+void ReplayGainPipeline::Start() {
+  Q_ASSERT(QThread::currentThread() != qApp->thread());
+
+  Utilities::SetThreadIOPriority(Utilities::IOPRIO_CLASS_IDLE);
+
+  if (pipeline_) {
+    return;
+  }
+
+  pipeline_ = gst_pipeline_new("replaygain-pipeline");
+
+  GstElement* concat = CreateElement("concat");
+  GstElement* sink = CreateElement("fakesink");
+  if (!concat || !sink) {
+    Stop(false);
+    return;
+  }
+
+  // The concat's request pads play in the order they were linked.
+  for (int i = 0; i < urls_.count(); ++i) {
+    GstElement* decodebin = CreateElement("uridecodebin");
+    GstElement* analysis = nullptr;
+    GstElement* convert = CreateAnalysisChain(i, &analysis);
+
+    if (!decodebin || !convert || !gst_element_link(analysis, concat)) {
+      qLog(Error) << "Failed to link elements";
+      Stop(false);
+      return;
+    }
+
+    QByteArray uri = Utilities::GetUriForGstreamer(urls_[i]);
+    g_object_set(decodebin, "uri", uri.constData(), nullptr);
+    CHECKED_GCONNECT(decodebin, "pad-added", &NewPadCallback, convert);
+  }
+
+  if (album_) {
+    GstElement* analysis = nullptr;
+    GstElement* convert = CreateAnalysisChain(-1, &analysis);
+
+    if (!convert || !gst_element_link(concat, convert) ||
+        !gst_element_link(analysis, sink)) {
+      qLog(Error) << "Failed to link elements";
+      Stop(false);
+      return;
+    }
+  } else if (!gst_element_link(concat, sink)) {
+    qLog(Error) << "Failed to link elements";
+    Stop(false);
+    return;
+  }
+
+  GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+  gst_bus_set_sync_handler(bus, BusCallbackSync, this, nullptr);
+  gst_object_unref(bus);
+
+  running_ = true;
+  gst_element_set_state(pipeline_, GST_STATE_PLAYING);
+}
+
+void ReplayGainPipeline::ReportError(GstMessage* msg) {
+  GError* error;
+  gchar* debugs;
+
+  gst_message_parse_error(msg, &error, &debugs);
+  QString message = QString::fromLocal8Bit(error->message);
+
+  g_error_free(error);
+  free(debugs);
+
+  qLog(Error) << "Error calculating ReplayGain of" << urls_ << ":" << message;
+}
+
+void ReplayGainPipeline::NewPadCallback(GstElement*, GstPad* pad,
+                                        gpointer data) {
+  GstElement* convert = reinterpret_cast<GstElement*>(data);
+
+  GstPad* const audiopad = gst_element_get_static_pad(convert, "sink");
+  if (!GST_PAD_IS_LINKED(audiopad)) {
+    gst_pad_link(pad, audiopad);
+  }
+  gst_object_unref(audiopad);
+}
+
+GstPadProbeReturn ReplayGainPipeline::EventProbeCallback(GstPad*,
+                                                         GstPadProbeInfo* info,
+                                                         gpointer data) {
+  Analysis* analysis = reinterpret_cast<Analysis*>(data);
+  GstEvent* event = gst_pad_probe_info_get_event(info);
+
+  switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_TAG: {
+      // Tags already in the file pass through here too, but rganalysis sends
+      // its own right before the end of the stream, so the last ones win.
+      GstTagList* tags = nullptr;
+      gst_event_parse_tag(event, &tags);
+
+      gdouble value = 0;
+      if (gst_tag_list_get_double(tags, GST_TAG_TRACK_GAIN, &value)) {
+        analysis->last_tags_.gain_ = value;
+      }
+      if (gst_tag_list_get_double(tags, GST_TAG_TRACK_PEAK, &value)) {
+        analysis->last_tags_.peak_ = value;
+      }
+      break;
+    }
+
+    case GST_EVENT_EOS: {
+      ReplayGainPipeline* self = analysis->pipeline_;
+      QMutexLocker l(&self->mutex_);
+      if (analysis->index_ == -1) {
+        self->album_gain_ = analysis->last_tags_;
+      } else {
+        self->track_gains_[analysis->index_] = analysis->last_tags_;
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+GstBusSyncReply ReplayGainPipeline::BusCallbackSync(GstBus*, GstMessage* msg,
+                                                    gpointer data) {
+  ReplayGainPipeline* self = reinterpret_cast<ReplayGainPipeline*>(data);
+
+  switch (GST_MESSAGE_TYPE(msg)) {
+    case GST_MESSAGE_EOS:
+      self->Stop(true);
+      break;
+
+    case GST_MESSAGE_ERROR:
+      self->ReportError(msg);
+      self->Stop(false);
+      break;
+
+    case GST_MESSAGE_STREAM_STATUS: {
+      // This is posted from the new streaming thread itself, which is the
+      // one doing the decoding and the analysis.
+      GstStreamStatusType type;
+      gst_message_parse_stream_status(msg, &type, nullptr);
+      if (type == GST_STREAM_STATUS_TYPE_ENTER) {
+        Utilities::SetThreadIOPriority(Utilities::IOPRIO_CLASS_IDLE);
+        Utilities::SetThreadIdlePriority();
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+  return GST_BUS_PASS;
+}
+
+void ReplayGainPipeline::Stop(bool success) {
+  // An error can follow the end of the stream, or come from several elements.
+  if (finished_) return;
+
+  finished_ = true;
+  success_ = success;
+  running_ = false;
+
+  emit Finished(success);
+}
+
+void ReplayGainPipeline::Cleanup() {
+  Q_ASSERT(QThread::currentThread() == thread());
+  Q_ASSERT(QThread::currentThread() != qApp->thread());
+
+  running_ = false;
+  if (pipeline_) {
+    GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+    gst_bus_set_sync_handler(bus, nullptr, nullptr, nullptr);
+    gst_object_unref(bus);
+
+    gst_element_set_state(pipeline_, GST_STATE_NULL);
+    gst_object_unref(pipeline_);
+    pipeline_ = nullptr;
+  }
+}
@@ -0,0 +1,105 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LIBRARY_REPLAYGAINPIPELINE_H_
+#define LIBRARY_REPLAYGAINPIPELINE_H_
+
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QUrl>
+
+#include <gst/gst.h>
+
+// Calculates the ReplayGain of some local music files with rganalysis.  The
+// files are decoded one after another through a concat element, and when
+// they're an album a second rganalysis after the concat measures them all
+// together for the album gain.
+class ReplayGainPipeline : public QObject {
+  Q_OBJECT
+
+ public:
+  ReplayGainPipeline(const QList<QUrl>& urls, bool album);
+  ~ReplayGainPipeline();
+
+  struct Gain {
+    Gain() : gain_(0), peak_(-1) {}
+
+    bool is_valid() const { return peak_ >= 0; }
+
+    double gain_;
+    double peak_;
+  };
+
+  static bool IsAvailable();
+
+  bool success() const { return success_; }
+  // One for each url, in the same order.  Files that couldn't be measured
+  // have invalid gains.
+  QList<Gain> track_gains() const;
+  Gain album_gain() const;
+
+ public slots:
+  void Start();
+
+ signals:
+  void Finished(bool success);
+
+ private:
+  // What the event probe on each rganalysis element needs to know.
+  struct Analysis {
+    ReplayGainPipeline* pipeline_;
+    // Index into track_gains_, or -1 for the album.
+    int index_;
+    Gain last_tags_;
+  };
+
+  GstElement* CreateElement(const QString& factory_name);
+  // Creates audioconvert ! audioresample ! rganalysis and returns the
+  // audioconvert.
+  GstElement* CreateAnalysisChain(int index, GstElement** analysis);
+
+  void ReportError(GstMessage* message);
+  void Stop(bool success);
+  void Cleanup();
+
+  static void NewPadCallback(GstElement*, GstPad* pad, gpointer data);
+  static GstPadProbeReturn EventProbeCallback(GstPad*, GstPadProbeInfo* info,
+                                              gpointer data);
+  static GstBusSyncReply BusCallbackSync(GstBus*, GstMessage* msg,
+                                         gpointer data);
+
+ private:
+  static bool sIsAvailable;
+
+  QList<QUrl> urls_;
+  bool album_;
+
+  GstElement* pipeline_;
+  QList<Analysis*> analyses_;
+
+  // Written from the streaming threads.
+  mutable QMutex mutex_;
+  QList<Gain> track_gains_;
+  Gain album_gain_;
+
+  bool success_;
+  bool running_;
+  bool finished_;
+};
+
+#endif  // LIBRARY_REPLAYGAINPIPELINE_H_
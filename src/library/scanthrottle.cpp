@@ -0,0 +1,120 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scanthrottle.h"
+
+#include <QMutexLocker>
+#include <QThread>
+#include <QTimer>
+
+#include "core/application.h"
+#include "core/logging.h"
+#include "core/player.h"
+#include "engines/gstengine.h"
+
+const int ScanThrottle::kPollIntervalMsec = 500;
+const int ScanThrottle::kLowFillPercent = 30;
+const int ScanThrottle::kHealthyFillPercent = 80;
+const int ScanThrottle::kMaxDelayMsec = 250;
+const int ScanThrottle::kUnderrunPauseMsec = 15000;
+
+ScanThrottle::ScanThrottle(Application* app, QObject* parent)
+    : QObject(parent),
+      app_(app),
+      engine_(nullptr),
+      poll_timer_(new QTimer(this)),
+      last_pipeline_id_(-1),
+      last_underruns_(0),
+      paused_(false),
+      delay_msec_(0) {
+  poll_timer_->setInterval(kPollIntervalMsec);
+  connect(poll_timer_, SIGNAL(timeout()), SLOT(Poll()));
+
+  // The library is created before the player.
+  QTimer::singleShot(0, this, SLOT(ConnectEngine()));
+}
+
+void ScanThrottle::ConnectEngine() {
+  engine_ = qobject_cast<GstEngine*>(app_->player()->engine());
+  if (!engine_) return;
+
+  connect(engine_, SIGNAL(StateChanged(Engine::State)),
+          SLOT(EngineStateChanged(Engine::State)));
+}
+
+void ScanThrottle::EngineStateChanged(Engine::State state) {
+  if (state == Engine::Playing) {
+    Poll();
+    poll_timer_->start();
+  } else {
+    poll_timer_->stop();
+    SetThrottle(false, 0);
+  }
+}
+
+void ScanThrottle::Poll() {
+  const EngineMetrics metrics = engine_->current_metrics();
+
+  if (metrics.pipeline_id_ != last_pipeline_id_) {
+    last_pipeline_id_ = metrics.pipeline_id_;
+    last_underruns_ = metrics.underruns_;
+  } else if (metrics.underruns_ > last_underruns_) {
+    last_underruns_ = metrics.underruns_;
+    last_underrun_.start();
+  }
+
+  bool paused = false;
+  int delay_msec = 0;
+  const int fill = metrics.queue_fill_percent_;
+
+  if (last_underrun_.isValid() &&
+      last_underrun_.elapsed() < kUnderrunPauseMsec) {
+    paused = true;
+  } else if (fill == -1) {
+    // Nothing to go on, so let the scan run.
+  } else if (fill < kLowFillPercent) {
+    paused = true;
+  } else if (fill < kHealthyFillPercent) {
+    delay_msec = kMaxDelayMsec * (kHealthyFillPercent - fill) /
+                 (kHealthyFillPercent - kLowFillPercent);
+  }
+
+  SetThrottle(paused, delay_msec);
+}
+
+void ScanThrottle::SetThrottle(bool paused, int delay_msec) {
+  QMutexLocker l(&mutex_);
+  if (paused != paused_) {
+    qLog(Debug) << (paused ? "Pausing" : "Resuming")
+                << "library scans for playback";
+  }
+
+  paused_ = paused;
+  delay_msec_ = delay_msec;
+  if (!paused_) resumed_.wakeAll();
+}
+
+void ScanThrottle::Wait(const std::function<bool()>& aborted) {
+  QMutexLocker l(&mutex_);
+  // Wake up now and then to see whether the scan has been stopped.
+  while (paused_ && !aborted()) {
+    resumed_.wait(&mutex_, kPollIntervalMsec);
+  }
+  const int delay_msec = delay_msec_;
+  l.unlock();
+
+  if (delay_msec > 0 && !aborted()) QThread::msleep(delay_msec);
+}
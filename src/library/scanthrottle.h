@@ -0,0 +1,83 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARY_SCANTHROTTLE_H_
+#define LIBRARY_SCANTHROTTLE_H_
+
+#include <functional>
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QWaitCondition>
+
+#include "engines/engine_fwd.h"
+
+class Application;
+class GstEngine;
+class QTimer;
+
+// Slows library scans down while music is playing, so that a scan of the
+// disk or network share that the music comes from doesn't starve playback.
+// The scan already reads at idle I/O priority, but that doesn't help when the
+// contention is somewhere else, like on a NAS.
+//
+// While the engine is playing its buffer is checked regularly.  The scan
+// waits a little between steps when the buffer is getting low, and stops
+// altogether when it's nearly empty or playback has just had to rebuffer.
+class ScanThrottle : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit ScanThrottle(Application* app, QObject* parent = nullptr);
+
+  static const int kPollIntervalMsec;
+  // Below this the scan is paused, above kHealthyFillPercent it runs at full
+  // speed, and in between it's slowed down by up to kMaxDelayMsec a step.
+  static const int kLowFillPercent;
+  static const int kHealthyFillPercent;
+  static const int kMaxDelayMsec;
+  // How long the scan stays paused after playback rebuffers.
+  static const int kUnderrunPauseMsec;
+
+  // Called by the scan between steps, on its own thread.  Blocks while the
+  // scan should be paused, or until aborted returns true.
+  void Wait(const std::function<bool()>& aborted);
+
+ private slots:
+  void ConnectEngine();
+  void EngineStateChanged(Engine::State state);
+  void Poll();
+
+ private:
+  void SetThrottle(bool paused, int delay_msec);
+
+ private:
+  Application* app_;
+  GstEngine* engine_;
+  QTimer* poll_timer_;
+
+  int last_pipeline_id_;
+  int last_underruns_;
+  QElapsedTimer last_underrun_;
+
+  QMutex mutex_;
+  QWaitCondition resumed_;
+  bool paused_;
+  int delay_msec_;
+};
+
+#endif  // LIBRARY_SCANTHROTTLE_H_
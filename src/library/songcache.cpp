@@ -0,0 +1,83 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "songcache.h"
+
+#include <QMutexLocker>
+
+const int SongCache::kMinPruneCount = 1000;
+
+SongCache::SongCache() : prune_count_(kMinPruneCount) {}
+
+Song SongCache::Intern(const Song& song) {
+  if (!song.is_valid() || song.id() == -1) return song;
+
+  QMutexLocker l(&mutex_);
+  QHash<int, Song>::iterator it = songs_.find(song.id());
+  if (it != songs_.end()) {
+    if (IsSameSong(*it, song)) return *it;
+    *it = song;
+    return song;
+  }
+
+  songs_.insert(song.id(), song);
+  if (songs_.count() >= prune_count_) PruneLocked();
+  return song;
+}
+
+void SongCache::Update(const SongList& songs) {
+  QMutexLocker l(&mutex_);
+  for (const Song& song : songs) {
+    QHash<int, Song>::iterator it = songs_.find(song.id());
+    if (it != songs_.end()) *it = song;
+  }
+}
+
+void SongCache::Clear() {
+  QMutexLocker l(&mutex_);
+  songs_.clear();
+  prune_count_ = kMinPruneCount;
+}
+
+int SongCache::count() const {
+  QMutexLocker l(&mutex_);
+  return songs_.count();
+}
+
+bool SongCache::IsSameSong(const Song& a, const Song& b) {
+  // Everything a playlist or the library view shows, so handing out the
+  // cached copy never loses anything that was just read from the database.
+  return a == b && a.IsMetadataEqual(b) &&
+         a.directory_id() == b.directory_id() && a.mtime() == b.mtime() &&
+         a.filesize() == b.filesize() && a.playcount() == b.playcount() &&
+         a.skipcount() == b.skipcount() &&
+         a.lastplayed() == b.lastplayed() && a.score() == b.score() &&
+         a.is_unavailable() == b.is_unavailable();
+}
+
+void SongCache::PruneLocked() {
+  for (QHash<int, Song>::iterator it = songs_.begin(); it != songs_.end();) {
+    if (it->is_shared()) {
+      ++it;
+    } else {
+      it = songs_.erase(it);
+    }
+  }
+
+  // Wait until the cache has doubled again before the next look, so pruning
+  // costs O(1) per song on average.
+  prune_count_ = qMax(kMinPruneCount, songs_.count() * 2);
+}
@@ -0,0 +1,58 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARY_SONGCACHE_H_
+#define LIBRARY_SONGCACHE_H_
+
+#include <QHash>
+#include <QMutex>
+
+#include "core/song.h"
+
+// Keeps one copy of each library song that's in use, keyed on its ID, so the
+// library view and every playlist that has the song share the same
+// implicitly shared data instead of each loading their own.  Songs nobody
+// else holds any more are dropped now and again.  Thread-safe.
+class SongCache {
+ public:
+  SongCache();
+
+  // The number of songs the cache can hold before it first looks for ones
+  // that aren't used any more.
+  static const int kMinPruneCount;
+
+  // Returns a copy of song that shares its data with every other copy the
+  // cache has handed out for it.  If the cached copy is out of date song
+  // replaces it.
+  Song Intern(const Song& song);
+
+  // Replaces the cached copies of songs that changed in the library.  Songs
+  // that aren't cached yet are left alone.
+  void Update(const SongList& songs);
+  void Clear();
+
+  int count() const;
+
+ private:
+  static bool IsSameSong(const Song& a, const Song& b);
+  void PruneLocked();
+
+  mutable QMutex mutex_;
+  QHash<int, Song> songs_;
+  int prune_count_;
+};
+
+#endif  // LIBRARY_SONGCACHE_H_
@@ -21,13 +21,30 @@
 #include <QSqlQuery>
 #include <QSqlRecord>
 
-SqlRow::SqlRow(const QSqlQuery& query) { Init(query); }
+SqlRow::SqlRow() : query_(nullptr) {}
 
-SqlRow::SqlRow(const LibraryQuery& query) { Init(query); }
+SqlRow::SqlRow(const QSqlQuery& query) : query_(nullptr) { Init(query); }
+
+SqlRow::SqlRow(const LibraryQuery& query) : query_(nullptr) { Init(query); }
+
+SqlRow::SqlRow(const QVector<QVariant>& columns)
+    : query_(nullptr), columns_(columns) {}
+
+SqlRow SqlRow::Current(const QSqlQuery& query) {
+  SqlRow ret;
+  ret.query_ = &query;
+  return ret;
+}
 
 void SqlRow::Init(const QSqlQuery& query) {
-  int rows = query.record().count();
-  for (int i = 0; i < rows; ++i) {
+  const int columns = query.record().count();
+  columns_.reserve(columns);
+  for (int i = 0; i < columns; ++i) {
     columns_ << query.value(i);
   }
 }
+
+QVariant SqlRow::value(int i) const {
+  if (query_) return query_->value(i);
+  return columns_[i];
+}
@@ -20,6 +20,7 @@
 
 #include <QList>
 #include <QVariant>
+#include <QVector>
 
 class QSqlQuery;
 
@@ -31,14 +32,26 @@ class SqlRow {
   SqlRow(const QSqlQuery& query);
   SqlRow(const LibraryQuery& query);
 
-  const QVariant& value(int i) const { return columns_[i]; }
+  // Reads the query's current row directly instead of copying every column.
+  // The returned SqlRow is only valid until the query moves to another row,
+  // so use it for rows that are read once while stepping through a result,
+  // never for rows that are kept in a list.
+  static SqlRow Current(const QSqlQuery& query);
+
+  // A row that was saved somewhere else, like a snapshot on disk.
+  explicit SqlRow(const QVector<QVariant>& columns);
+
+  QVariant value(int i) const;
+  // Empty for rows made by Current().
+  const QVector<QVariant>& columns() const { return columns_; }
 
  private:
   SqlRow();
 
   void Init(const QSqlQuery& query);
 
-  QList<QVariant> columns_;
+  const QSqlQuery* query_;
+  QVector<QVariant> columns_;
 };
 
 typedef QList<SqlRow> SqlRowList;
@@ -0,0 +1,110 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "library/tagcompletioncache.h"
+
+#include <algorithm>
+
+#include <QMutexLocker>
+
+namespace {
+
+bool CaseInsensitiveLessThan(const QString& a, const QString& b) {
+  return QString::compare(a, b, Qt::CaseInsensitive) < 0;
+}
+
+}  // namespace
+
+const int TagCompletionCache::kMaxDeletedSongs = 1000;
+
+TagCompletionCache::TagCompletionCache(Loader loader)
+    : loader_(loader), deleted_songs_(0) {}
+
+QString TagCompletionCache::ColumnValue(const Song& song,
+                                        const QString& column) {
+  if (column == "artist") return song.artist();
+  if (column == "album") return song.album();
+  if (column == "albumartist") return song.albumartist();
+  if (column == "composer") return song.composer();
+  if (column == "performer") return song.performer();
+  if (column == "grouping") return song.grouping();
+  if (column == "genre") return song.genre();
+  return QString();
+}
+
+QStringList TagCompletionCache::Values(const QString& column) {
+  {
+    QMutexLocker l(&mutex_);
+    auto it = columns_.constFind(column);
+    if (it != columns_.constEnd()) return it->sorted_;
+  }
+
+  // Read the column without holding the lock, so songs coming in don't wait
+  // for the database.
+  Column loaded;
+  loaded.sorted_ = loader_(column);
+  loaded.sorted_.removeAll(QString());
+  std::sort(loaded.sorted_.begin(), loaded.sorted_.end(),
+            CaseInsensitiveLessThan);
+  loaded.values_ = loaded.sorted_.toSet();
+
+  QMutexLocker l(&mutex_);
+  auto it = columns_.constFind(column);
+  if (it != columns_.constEnd()) return it->sorted_;
+  columns_[column] = loaded;
+  return loaded.sorted_;
+}
+
+bool TagCompletionCache::is_loaded(const QString& column) const {
+  QMutexLocker l(&mutex_);
+  return columns_.contains(column);
+}
+
+void TagCompletionCache::Insert(Column* column, const QString& value) {
+  if (value.isEmpty() || column->values_.contains(value)) return;
+
+  column->values_.insert(value);
+  column->sorted_.insert(
+      std::upper_bound(column->sorted_.begin(), column->sorted_.end(), value,
+                       CaseInsensitiveLessThan),
+      value);
+}
+
+void TagCompletionCache::SongsDiscovered(const SongList& songs) {
+  QMutexLocker l(&mutex_);
+  for (auto it = columns_.begin(); it != columns_.end(); ++it) {
+    for (const Song& song : songs) {
+      // The loader leaves out compilations too.
+      if (song.is_compilation()) continue;
+      Insert(&it.value(), ColumnValue(song, it.key()));
+    }
+  }
+}
+
+void TagCompletionCache::SongsDeleted(const SongList& songs) {
+  QMutexLocker l(&mutex_);
+  deleted_songs_ += songs.count();
+  if (deleted_songs_ > kMaxDeletedSongs) {
+    columns_.clear();
+    deleted_songs_ = 0;
+  }
+}
+
+void TagCompletionCache::Clear() {
+  QMutexLocker l(&mutex_);
+  columns_.clear();
+  deleted_songs_ = 0;
+}
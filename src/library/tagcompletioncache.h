@@ -0,0 +1,72 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARY_TAGCOMPLETIONCACHE_H_
+#define LIBRARY_TAGCOMPLETIONCACHE_H_
+
+#include <functional>
+
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+
+#include "core/song.h"
+
+// Keeps the distinct values of the library columns that tag editors complete
+// from, so opening an editor doesn't read the whole songs table each time.
+// Each column is read once, when it's first wanted, and kept sorted case
+// insensitively - the order QCompleter's CaseInsensitivelySortedModel
+// expects, so it can find prefixes with a binary search.  Values of new and
+// changed songs are added as they come in.  Thread-safe.
+class TagCompletionCache {
+ public:
+  // Reads the distinct values of a column from the database.
+  typedef std::function<QStringList(const QString& column)> Loader;
+
+  explicit TagCompletionCache(Loader loader);
+
+  // Values of deleted songs aren't removed one by one, since another song
+  // might still have them.  Instead the columns are read again once this
+  // many songs have been deleted.
+  static const int kMaxDeletedSongs;
+
+  // Returns the values of column, sorted.  Blocks the first time a column is
+  // asked for, so call it from a worker thread unless is_loaded().
+  QStringList Values(const QString& column);
+  bool is_loaded(const QString& column) const;
+
+  void SongsDiscovered(const SongList& songs);
+  void SongsDeleted(const SongList& songs);
+  void Clear();
+
+ private:
+  struct Column {
+    QStringList sorted_;
+    QSet<QString> values_;
+  };
+
+  static QString ColumnValue(const Song& song, const QString& column);
+  static void Insert(Column* column, const QString& value);
+
+  Loader loader_;
+
+  mutable QMutex mutex_;
+  QHash<QString, Column> columns_;
+  int deleted_songs_;
+};
+
+#endif  // LIBRARY_TAGCOMPLETIONCACHE_H_
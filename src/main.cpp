@@ -39,9 +39,9 @@
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSysInfo>
+#include <QTimer>
 #include <QTextCodec>
 #include <QTranslator>
-#include <QtConcurrentRun>
 #include <QtDebug>
 
 #include "config.h"
@@ -49,13 +49,17 @@
 #include "core/commandlineoptions.h"
 #include "core/crashreporting.h"
 #include "core/database.h"
+#include "core/headlessmode.h"
 #include "core/logging.h"
 #include "core/mac_startup.h"
+#include "core/memoryaccounting.h"
 #include "core/metatypes.h"
 #include "core/network.h"
 #include "core/networkproxyfactory.h"
 #include "core/potranslator.h"
 #include "core/song.h"
+#include "core/startuptrace.h"
+#include "core/taskexecutor.h"
 #include "core/ubuntuunityhack.h"
 #include "core/utilities.h"
 #include "engines/enginebase.h"
@@ -252,6 +256,8 @@ void ScanGIOModulePath() {
 #endif  // HAVE_GIO
 
 int main(int argc, char* argv[]) {
+  StartupTrace::Start();
+
   if (CrashReporting::SendCrashReport(argc, argv)) {
     return 0;
   }
@@ -301,6 +307,12 @@ int main(int argc, char* argv[]) {
     if (!options.Parse()) return 1;
     logging::SetLevels(options.log_levels());
 
+    // A headless instance still needs a QApplication for the bits of Qt the
+    // core uses, but shouldn't need a display.
+    if (options.headless() && qgetenv("QT_QPA_PLATFORM").isEmpty()) {
+      qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     if (a.isRunning()) {
       if (options.is_empty()) {
         qLog(Info)
@@ -418,10 +430,18 @@ int main(int argc, char* argv[]) {
   // initialised in the main thread.  It fixes issue 3265 but nobody knows why.
   // Don't remove this unless you can reproduce the error that it fixes.
   ParseAProto();
-  QtConcurrent::run(&ParseAProto);
+  TaskExecutor::Instance()->Run<void>(TaskExecutor::Lane_Background,
+                                      &ParseAProto);
 
+  // Created here so it lives in the main thread, whoever registers first.
+  MemoryAccounting::Instance()->LogReportOnSignal();
+  MemoryAccounting::Instance()->WatchMemoryPressure();
+
+  StartupTrace::Mark("Creating application");
   Application app;
   QObject::connect(&a, SIGNAL(aboutToQuit()), &app, SLOT(SaveSettings_()));
+  QObject::connect(&app, SIGNAL(SettingsChanged()),
+                   MemoryAccounting::Instance(), SLOT(ReloadSettings()));
   app.set_language_name(language);
 
   // Network proxy
@@ -435,28 +455,49 @@ int main(int argc, char* argv[]) {
   UbuntuUnityHack hack;
 #endif  // Q_OS_LINUX
 
-  // Create the tray icon and OSD
-  std::unique_ptr<SystemTrayIcon> tray_icon(
-      SystemTrayIcon::CreateSystemTrayIcon());
-  OSD osd(tray_icon.get(), &app);
-
 #ifdef HAVE_DBUS
   mpris::Mpris mpris(&app);
 #endif
 
-  // Window
-  MainWindow w(&app, tray_icon.get(), &osd, options);
+  // Headless instances skip the tray icon, OSD and every widget in the main
+  // window.
+  std::unique_ptr<HeadlessMode> headless;
+  std::unique_ptr<SystemTrayIcon> tray_icon;
+  std::unique_ptr<OSD> osd;
+  std::unique_ptr<MainWindow> w;
+
+  if (options.headless()) {
+    StartupTrace::Mark("Starting headless");
+    headless.reset(new HeadlessMode(&app));
+#ifdef HAVE_GIO
+    ScanGIOModulePath();
+#endif
+    QObject::connect(&a, SIGNAL(messageReceived(QString)), headless.get(),
+                     SLOT(CommandlineOptionsReceived(QString)));
+  } else {
+    // Create the tray icon and OSD
+    tray_icon.reset(SystemTrayIcon::CreateSystemTrayIcon());
+    osd.reset(new OSD(tray_icon.get(), &app));
+
+    // Window
+    StartupTrace::Mark("Creating main window");
+    w.reset(new MainWindow(&app, tray_icon.get(), osd.get(), options));
 #ifdef Q_OS_DARWIN
-  mac::EnableFullScreen(w);
+    mac::EnableFullScreen(*w);
 #endif  // Q_OS_DARWIN
 #ifdef HAVE_GIO
-  ScanGIOModulePath();
+    ScanGIOModulePath();
 #endif
 #ifdef HAVE_DBUS
-  QObject::connect(&mpris, SIGNAL(RaiseMainWindow()), &w, SLOT(Raise()));
+    QObject::connect(&mpris, SIGNAL(RaiseMainWindow()), w.get(),
+                     SLOT(Raise()));
 #endif
-  QObject::connect(&a, SIGNAL(messageReceived(QString)), &w,
-                   SLOT(CommandlineOptionsReceived(QString)));
+    QObject::connect(&a, SIGNAL(messageReceived(QString)), w.get(),
+                     SLOT(CommandlineOptionsReceived(QString)));
+  }
+
+  // Runs after anything the main window deferred until the event loop started.
+  QTimer::singleShot(0, &StartupTrace::Finish);
 
   int ret = a.exec();
 
@@ -16,8 +16,10 @@
 */
 
 #include "moodbarbuilder.h"
+#include "analyzers/fht.h"
 #include "core/arraysize.h"
 
+#include <algorithm>
 #include <cmath>
 
 namespace {
@@ -28,9 +30,22 @@ static const int sBarkBands[] = {
 
 static const int sBarkBandCount = arraysize(sBarkBands);
 
+// Same as the fastspectrum element's default interval.
+static const int kIntervalsPerSecond = 10;
+
 }  // namespace
 
-MoodbarBuilder::MoodbarBuilder() : bands_(0), rate_hz_(0) {}
+const int MoodbarBuilder::kFhtSizeExp = 8;
+
+MoodbarBuilder::MoodbarBuilder()
+    : bands_(0),
+      rate_hz_(0),
+      window_pos_(0),
+      interval_size_(0),
+      interval_pos_(0),
+      transform_count_(0) {}
+
+MoodbarBuilder::~MoodbarBuilder() {}
 
 int MoodbarBuilder::BandFrequency(int band) const {
   return ((rate_hz_ / 2) * band + rate_hz_ / 4) / bands_;
@@ -54,7 +69,70 @@ void MoodbarBuilder::Init(int bands, int rate_hz) {
   }
 }
 
+void MoodbarBuilder::InitSamples(int rate_hz) {
+  fht_.reset(new FHT(kFhtSizeExp));
+  Init(fht_->size() / 2, rate_hz);
+
+  window_.fill(0, fht_->size());
+  scratch_.fill(0, fht_->size());
+  magnitudes_.fill(0, bands_);
+  window_pos_ = 0;
+  interval_size_ = qMax(1, rate_hz / kIntervalsPerSecond);
+  interval_pos_ = 0;
+  transform_count_ = 0;
+}
+
+void MoodbarBuilder::AddSamples(const float* samples, int count) {
+  if (!fht_) return;
+
+  while (count > 0) {
+    const int n = std::min({count, window_.count() - window_pos_,
+                            interval_size_ - interval_pos_});
+    std::copy(samples, samples + n, window_.data() + window_pos_);
+    samples += n;
+    count -= n;
+    window_pos_ += n;
+    interval_pos_ += n;
+
+    if (window_pos_ == window_.count()) {
+      TransformWindow();
+      window_pos_ = 0;
+    }
+
+    if (interval_pos_ == interval_size_) {
+      // Very low sample rates might not fill a whole window in an interval.
+      if (transform_count_ == 0) TransformWindow();
+
+      for (float& magnitude : magnitudes_) {
+        magnitude /= transform_count_;
+      }
+      AddMagnitudes(magnitudes_.constData(), magnitudes_.count());
+
+      magnitudes_.fill(0);
+      transform_count_ = 0;
+      window_pos_ = 0;
+      interval_pos_ = 0;
+    }
+  }
+}
+
+void MoodbarBuilder::TransformWindow() {
+  // power2 works in place, and the window might not be full yet.
+  std::copy(window_.constBegin(), window_.constEnd(), scratch_.begin());
+  fht_->power2(scratch_.data());
+
+  for (int i = 0; i < magnitudes_.count(); ++i) {
+    magnitudes_[i] += scratch_[i];
+  }
+  transform_count_++;
+}
+
 void MoodbarBuilder::AddFrame(const double* magnitudes, int size) {
+  AddMagnitudes(magnitudes, size);
+}
+
+template <typename T>
+void MoodbarBuilder::AddMagnitudes(const T* magnitudes, int size) {
   if (size > barkband_table_.length()) {
     return;
   }
@@ -18,15 +18,31 @@
 #ifndef MOODBARBUILDER_H
 #define MOODBARBUILDER_H
 
+#include <memory>
+
 #include <QColor>
 #include <QList>
+#include <QVector>
+
+class FHT;
 
 class MoodbarBuilder {
  public:
   MoodbarBuilder();
+  ~MoodbarBuilder();
+
+  // Number of samples in each transform done by AddSamples.
+  static const int kFhtSizeExp;
 
+  // Either give it the spectrum of each frame with Init and AddFrame...
   void Init(int bands, int rate_hz);
   void AddFrame(const double* magnitudes, int size);
+
+  // ...or give it mono samples with InitSamples and AddSamples, and it works
+  // out the spectrum itself.
+  void InitSamples(int rate_hz);
+  void AddSamples(const float* samples, int count);
+
   QByteArray Finish(int width);
 
  private:
@@ -38,12 +54,26 @@ class MoodbarBuilder {
   };
 
   int BandFrequency(int band) const;
+  template <typename T>
+  void AddMagnitudes(const T* magnitudes, int size);
+  void TransformWindow();
   static void Normalize(QList<Rgb>* vals, double Rgb::*member);
 
   QList<uint> barkband_table_;
   int bands_;
   int rate_hz_;
 
+  // Used by AddSamples.  The spectrum of each interval is the average of
+  // the transforms of the whole windows in it.
+  std::unique_ptr<FHT> fht_;
+  QVector<float> window_;
+  QVector<float> scratch_;
+  QVector<float> magnitudes_;
+  int window_pos_;
+  int interval_size_;
+  int interval_pos_;
+  int transform_count_;
+
   QList<Rgb> frames_;
 };
 
@@ -34,8 +34,8 @@ MoodbarController::MoodbarController(Application* app, QObject* parent)
 void MoodbarController::CurrentSongChanged(const Song& song) {
   QByteArray data;
   MoodbarPipeline* pipeline = nullptr;
-  const MoodbarLoader::Result result =
-      app_->moodbar_loader()->Load(song.url(), &data, &pipeline);
+  const MoodbarLoader::Result result = app_->moodbar_loader()->Load(
+      song.url(), song.mtime(), &data, &pipeline);
 
   switch (result) {
     case MoodbarLoader::CannotLoad:
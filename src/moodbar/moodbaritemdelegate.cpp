@@ -18,6 +18,7 @@
 #include "moodbaritemdelegate.h"
 #include "moodbarloader.h"
 #include "moodbarpipeline.h"
+#include "moodbarrendercache.h"
 #include "moodbarrenderer.h"
 #include "core/application.h"
 #include "core/closure.h"
@@ -28,9 +29,8 @@
 #include <QPainter>
 #include <QSettings>
 #include <QSortFilterProxyModel>
-#include <QtConcurrentRun>
 
-MoodbarItemDelegate::Data::Data() : state_(State_None) {}
+MoodbarItemDelegate::Data::Data() : state_(State_None), mtime_(0) {}
 
 MoodbarItemDelegate::MoodbarItemDelegate(Application* app, PlaylistView* view,
                                          QObject* parent)
@@ -38,6 +38,8 @@ MoodbarItemDelegate::MoodbarItemDelegate(Application* app, PlaylistView* view,
       app_(app),
       view_(view),
       style_(MoodbarRenderer::Style_Normal) {
+  connect(app_->moodbar_render_cache(), SIGNAL(Rendered(QByteArray)),
+          SLOT(MoodbarRendered(QByteArray)));
   connect(app_, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
   ReloadSettings();
 }
@@ -50,22 +52,24 @@ void MoodbarItemDelegate::ReloadSettings() {
           s.value("style", MoodbarRenderer::Style_Normal).toInt());
 
   if (new_style != style_) {
+    // Moodbars are cached for each style, so we only need to repaint.
     style_ = new_style;
-    ReloadAllColors();
+    view_->viewport()->update();
   }
 }
 
 void MoodbarItemDelegate::paint(QPainter* painter,
                                 const QStyleOptionViewItem& option,
                                 const QModelIndex& index) const {
+  // Make a little border for the moodbar
+  const QRect moodbar_rect(option.rect.adjusted(1, 1, -1, -1));
   QPixmap pixmap = const_cast<MoodbarItemDelegate*>(this)
-                       ->PixmapForIndex(index, option.rect.size());
+                       ->PixmapForIndex(index, moodbar_rect.size());
 
   drawBackground(painter, option, index);
 
   if (!pixmap.isNull()) {
-    // Make a little border for the moodbar
-    const QRect moodbar_rect(option.rect.adjusted(1, 1, -1, -1));
+    // The pixmap might be a little wider, or be from before a resize.
     painter->drawPixmap(moodbar_rect, pixmap);
   }
 }
@@ -79,26 +83,31 @@ QPixmap MoodbarItemDelegate::PixmapForIndex(const QModelIndex& index,
   Data* data = data_[url];
   if (!data) {
     data = new Data;
+    data->mtime_ = index.sibling(index.row(), Playlist::Column_DateModified)
+                       .data()
+                       .toUInt();
     data_.insert(url, data);
   }
 
   data->indexes_.insert(index);
-  data->desired_size_ = size;
 
   switch (data->state_) {
     case Data::State_CannotLoad:
     case Data::State_LoadingData:
-    case Data::State_LoadingColors:
-    case Data::State_LoadingImage:
-      return data->pixmap_;
-
-    case Data::State_Loaded:
-      // Is the pixmap the right size?
-      if (data->pixmap_.size() != size) {
-        StartLoadingImage(url, data);
-      }
+      return QPixmap();
 
-      return data->pixmap_;
+    case Data::State_Loaded: {
+      MoodbarRenderCache* cache = app_->moodbar_render_cache();
+
+      // Is there a pixmap of the right size?  If not, draw the one we've got
+      // until it's rendered.
+      bool exact = false;
+      QPixmap pixmap = cache->Find(data->id_, style_, size, &exact);
+      if (!exact) {
+        cache->Render(data->id_, data->bytes_, style_, qApp->palette(), size);
+      }
+      return pixmap;
+    }
 
     case Data::State_None:
       break;
@@ -113,17 +122,18 @@ QPixmap MoodbarItemDelegate::PixmapForIndex(const QModelIndex& index,
 void MoodbarItemDelegate::StartLoadingData(const QUrl& url, Data* data) {
   data->state_ = Data::State_LoadingData;
 
-  // Load a mood file for this song and generate some colors from it
+  // Load a mood file for this song
   QByteArray bytes;
   MoodbarPipeline* pipeline = nullptr;
-  switch (app_->moodbar_loader()->Load(url, &bytes, &pipeline)) {
+  switch (
+      app_->moodbar_loader()->Load(url, data->mtime_, &bytes, &pipeline)) {
     case MoodbarLoader::CannotLoad:
       data->state_ = Data::State_CannotLoad;
       break;
 
     case MoodbarLoader::Loaded:
       // We got the data immediately.
-      StartLoadingColors(url, bytes, data);
+      DataReady(url, bytes, data);
       break;
 
     case MoodbarLoader::WillLoadAsync:
@@ -146,16 +156,6 @@ bool MoodbarItemDelegate::RemoveFromCacheIfIndexesInvalid(const QUrl& url,
   return true;
 }
 
-void MoodbarItemDelegate::ReloadAllColors() {
-  for (const QUrl& url : data_.keys()) {
-    Data* data = data_[url];
-
-    if (data->state_ == Data::State_Loaded) {
-      StartLoadingData(url, data);
-    }
-  }
-}
-
 void MoodbarItemDelegate::DataLoaded(const QUrl& url,
                                      MoodbarPipeline* pipeline) {
   Data* data = data_[url];
@@ -172,69 +172,33 @@ void MoodbarItemDelegate::DataLoaded(const QUrl& url,
     return;
   }
 
-  // Load the colors next.
-  StartLoadingColors(url, pipeline->data(), data);
+  DataReady(url, pipeline->data(), data);
 }
 
-void MoodbarItemDelegate::StartLoadingColors(const QUrl& url,
-                                             const QByteArray& bytes,
-                                             Data* data) {
-  data->state_ = Data::State_LoadingColors;
+void MoodbarItemDelegate::DataReady(const QUrl& url, const QByteArray& bytes,
+                                    Data* data) {
+  data->bytes_ = bytes;
+  data->id_ = MoodbarRenderCache::Id(bytes);
+  data->state_ = Data::State_Loaded;
 
-  QFuture<ColorVector> future = QtConcurrent::run(
-      MoodbarRenderer::Colors, bytes, style_, qApp->palette());
-  NewClosure(future, this, SLOT(ColorsLoaded(QUrl, QFuture<ColorVector>)), url,
-             future);
+  // The next paint will find it in the cache, or start rendering it.
+  UpdateIndexes(url, data);
 }
 
-void MoodbarItemDelegate::ColorsLoaded(const QUrl& url,
-                                       QFuture<ColorVector> future) {
-  Data* data = data_[url];
-  if (!data) {
-    return;
-  }
+void MoodbarItemDelegate::MoodbarRendered(const QByteArray& id) {
+  for (const QUrl& url : data_.keys()) {
+    Data* data = data_.object(url);
+    if (data->state_ != Data::State_Loaded || data->id_ != id) {
+      continue;
+    }
 
-  if (RemoveFromCacheIfIndexesInvalid(url, data)) {
-    return;
+    if (!RemoveFromCacheIfIndexesInvalid(url, data)) {
+      UpdateIndexes(url, data);
+    }
   }
-
-  data->colors_ = future.result();
-
-  // Load the image next.
-  StartLoadingImage(url, data);
-}
-
-void MoodbarItemDelegate::StartLoadingImage(const QUrl& url, Data* data) {
-  data->state_ = Data::State_LoadingImage;
-
-  QFuture<QImage> future = QtConcurrent::run(
-      MoodbarRenderer::RenderToImage, data->colors_, data->desired_size_);
-  NewClosure(future, this, SLOT(ImageLoaded(QUrl, QFuture<QImage>)), url,
-             future);
 }
 
-void MoodbarItemDelegate::ImageLoaded(const QUrl& url, QFuture<QImage> future) {
-  Data* data = data_[url];
-  if (!data) {
-    return;
-  }
-
-  if (RemoveFromCacheIfIndexesInvalid(url, data)) {
-    return;
-  }
-
-  QImage image(future.result());
-
-  // If the desired size changed then don't even bother converting the image
-  // to a pixmap, just reload it at the new size.
-  if (!image.isNull() && data->desired_size_ != image.size()) {
-    StartLoadingImage(url, data);
-    return;
-  }
-
-  data->pixmap_ = QPixmap::fromImage(image);
-  data->state_ = Data::State_Loaded;
-
+void MoodbarItemDelegate::UpdateIndexes(const QUrl& url, Data* data) {
   Playlist* playlist = view_->playlist();
   const QSortFilterProxyModel* filter = playlist->proxy();
 
@@ -21,7 +21,6 @@
 #include "moodbarrenderer.h"
 
 #include <QCache>
-#include <QFuture>
 #include <QItemDelegate>
 #include <QUrl>
 
@@ -45,8 +44,7 @@ class MoodbarItemDelegate : public QItemDelegate {
   void ReloadSettings();
 
   void DataLoaded(const QUrl& url, MoodbarPipeline* pipeline);
-  void ColorsLoaded(const QUrl& url, QFuture<ColorVector> future);
-  void ImageLoaded(const QUrl& url, QFuture<QImage> future);
+  void MoodbarRendered(const QByteArray& id);
 
  private:
   struct Data {
@@ -56,29 +54,27 @@ class MoodbarItemDelegate : public QItemDelegate {
       State_None,
       State_CannotLoad,
       State_LoadingData,
-      State_LoadingColors,
-      State_LoadingImage,
       State_Loaded
     };
 
     QSet<QPersistentModelIndex> indexes_;
 
     State state_;
-    ColorVector colors_;
-    QSize desired_size_;
-    QPixmap pixmap_;
+    uint mtime_;
+
+    // The moodbar data and its MoodbarRenderCache id.
+    QByteArray bytes_;
+    QByteArray id_;
   };
 
  private:
   QPixmap PixmapForIndex(const QModelIndex& index, const QSize& size);
   void StartLoadingData(const QUrl& url, Data* data);
-  void StartLoadingColors(const QUrl& url, const QByteArray& bytes, Data* data);
-  void StartLoadingImage(const QUrl& url, Data* data);
+  void DataReady(const QUrl& url, const QByteArray& bytes, Data* data);
+  void UpdateIndexes(const QUrl& url, Data* data);
 
   bool RemoveFromCacheIfIndexesInvalid(const QUrl& url, Data* data);
 
-  void ReloadAllColors();
-
  private:
   Application* app_;
   PlaylistView* view_;
@@ -22,7 +22,9 @@
 #include <QCoreApplication>
 #include <QDir>
 #include <QFileInfo>
+#include <QMutexLocker>
 #include <QNetworkDiskCache>
+#include <QSqlQuery>
 #include <QTimer>
 #include <QThread>
 #include <QUrl>
@@ -30,18 +32,41 @@
 #include "moodbarpipeline.h"
 #include "core/application.h"
 #include "core/closure.h"
+#include "core/database.h"
 #include "core/logging.h"
+#include "core/memoryaccounting.h"
+#include "core/metriccounter.h"
+#include "core/song.h"
+#include "core/taskexecutor.h"
+#include "core/taskmanager.h"
 #include "core/utilities.h"
+#include "library/librarybackend.h"
 
 #ifdef Q_OS_WIN32
 #include <windows.h>
 #endif
 
+namespace {
+MetricCounter sStoreHits("clementine_moodbar_store_hits_total",
+                         "Moodbars found in the moodbar store.");
+MetricCounter sStoreMisses("clementine_moodbar_store_misses_total",
+                           "Moodbars that weren't in the moodbar store.");
+}  // namespace
+
 MoodbarLoader::MoodbarLoader(Application* app, QObject* parent)
     : QObject(parent),
+      app_(app),
       cache_(new QNetworkDiskCache(this)),
+      store_(Utilities::GetConfigPath(Utilities::Path_MoodbarCache) +
+             "/moodbars.pack"),
       thread_(new QThread(this)),
       kMaxActiveRequests(qMax(1, QThread::idealThreadCount() / 2)),
+      batch_task_id_(-1),
+      batch_paused_(false),
+      batch_total_(0),
+      batch_done_(0),
+      batch_generated_(0),
+      batch_elapsed_msec_(0),
       save_alongside_originals_(false),
       disable_moodbar_calculation_(false) {
   cache_->setCacheDirectory(
@@ -51,6 +76,10 @@ MoodbarLoader::MoodbarLoader(Application* app, QObject* parent)
 
   connect(app, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
   ReloadSettings();
+
+  MemoryAccounting::Instance()->Register(
+      this, "moodbar_store", "Moodbar store index and mapping",
+      [this]() { return store_.MemoryUsage(); });
 }
 
 MoodbarLoader::~MoodbarLoader() {
@@ -68,6 +97,10 @@ void MoodbarLoader::ReloadSettings() {
   MaybeTakeNextRequest();
 }
 
+uint MoodbarLoader::FileMtime(const QString& filename) {
+  return QFileInfo(filename).lastModified().toTime_t();
+}
+
 QStringList MoodbarLoader::MoodFilenames(const QString& song_filename) {
   const QFileInfo file_info(song_filename);
   const QString dir_path(file_info.dir().path());
@@ -81,7 +114,8 @@ QStringList MoodbarLoader::MoodFilenames(const QString& song_filename) {
                        << dir_path + "/" + mood_filename;
 }
 
-MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, QByteArray* data,
+MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, uint mtime,
+                                          QByteArray* data,
                                           MoodbarPipeline** async_pipeline) {
   if (url.scheme() != "file") {
     return CannotLoad;
@@ -93,58 +127,270 @@ MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, QByteArray* data,
     return WillLoadAsync;
   }
 
-  // Check if a mood file exists for this file already
   const QString filename(url.toLocalFile());
+  if (mtime == 0) mtime = FileMtime(filename);
+
+  // The store is checked first so we don't touch any small files at all for
+  // songs we've seen before.
+  *data = store_.Find(url, mtime);
+  if (!data->isEmpty()) {
+    sStoreHits.Add();
+    return Loaded;
+  }
+  sStoreMisses.Add();
 
+  // Check if a mood file exists for this file already
   for (const QString& possible_mood_file : MoodFilenames(filename)) {
     QFile f(possible_mood_file);
     if (f.open(QIODevice::ReadOnly)) {
       qLog(Info) << "Loading moodbar data from" << possible_mood_file;
       *data = f.readAll();
+      store_.Insert(url, mtime, *data);
       return Loaded;
     }
   }
 
-  // Maybe it exists in the cache?
+  // Maybe it exists in the cache older versions used?  Move it to the store.
   std::unique_ptr<QIODevice> cache_device(cache_->data(url));
   if (cache_device) {
     qLog(Info) << "Loading cached moodbar data for" << filename;
     *data = cache_device->readAll();
+    cache_device.reset();
+    cache_->remove(url);
     if (!data->isEmpty()) {
+      store_.Insert(url, mtime, *data);
       return Loaded;
     }
   }
 
+  // There was no existing file, analyze the audio file and create one.
+  MoodbarPipeline* pipeline = CreatePipeline(url);
+  queued_requests_ << url;
+
+  MaybeTakeNextRequest();
+
+  *async_pipeline = pipeline;
+  return WillLoadAsync;
+}
+
+MoodbarPipeline* MoodbarLoader::CreatePipeline(const QUrl& url) {
   if (!thread_->isRunning()) thread_->start(QThread::IdlePriority);
 
-  // There was no existing file, analyze the audio file and create one.
   MoodbarPipeline* pipeline = new MoodbarPipeline(url);
   pipeline->moveToThread(thread_);
   NewClosure(pipeline, SIGNAL(Finished(bool)), this,
              SLOT(RequestFinished(MoodbarPipeline*, QUrl)), pipeline, url);
 
   requests_[url] = pipeline;
-  queued_requests_ << url;
+  return pipeline;
+}
+
+void MoodbarLoader::MaybeTakeNextRequest() {
+  Q_ASSERT(QThread::currentThread() == qApp->thread());
 
+  if (disable_moodbar_calculation_) {
+    return;
+  }
+
+  while (active_requests_.count() < kMaxActiveRequests) {
+    if (queued_requests_.isEmpty()) {
+      if (!MaybeTakeNextBatchRequest()) return;
+      continue;
+    }
+
+    const QUrl url = queued_requests_.takeFirst();
+    active_requests_ << url;
+
+    qLog(Info) << "Creating moodbar data for" << url.toLocalFile();
+    QMetaObject::invokeMethod(requests_[url], "Start", Qt::QueuedConnection);
+  }
+}
+
+bool MoodbarLoader::MaybeTakeNextBatchRequest() {
+  if (batch_task_id_ == -1 || batch_paused_) {
+    return false;
+  }
+
+  while (!batch_queue_.isEmpty()) {
+    const QUrl url = batch_queue_.takeFirst();
+
+    // Skip songs that are being loaded on demand already, or that got a
+    // moodbar since the library was scanned.
+    if (requests_.contains(url) ||
+        store_.Contains(url, FileMtime(url.toLocalFile()))) {
+      batch_done_++;
+      continue;
+    }
+
+    CreatePipeline(url);
+    active_requests_ << url;
+    batch_active_ << url;
+
+    qLog(Debug) << "Creating moodbar data for" << url.toLocalFile();
+    QMetaObject::invokeMethod(requests_[url], "Start", Qt::QueuedConnection);
+    UpdateLibraryBatchProgress();
+    return true;
+  }
+
+  // A total of -1 means we're still looking for songs.
+  if (batch_total_ != -1 && batch_active_.isEmpty()) {
+    FinishLibraryBatch();
+  }
+  return false;
+}
+
+void MoodbarLoader::StartLibraryBatch() {
+  if (batch_task_id_ != -1) {
+    return;
+  }
+
+  if (disable_moodbar_calculation_) {
+    qLog(Warning) << "Not generating moodbars, moodbar calculation is disabled";
+    return;
+  }
+
+  batch_task_id_ = app_->task_manager()->StartTask(tr("Generating moodbars"));
+  batch_paused_ = false;
+  batch_total_ = -1;
+  batch_done_ = 0;
+  batch_generated_ = 0;
+  batch_elapsed_msec_ = 0;
+  batch_timer_.start();
+  emit LibraryBatchRunningChanged(true);
+
+  QFuture<QList<QUrl>> future = TaskExecutor::Instance()->Run<QList<QUrl>>(
+      TaskExecutor::Lane_Bulk,
+      std::bind(&MoodbarLoader::FindSongsWithoutMoodFiles,
+                app_->library_backend(), &store_));
+  NewClosure(future, this,
+             SLOT(LibraryBatchSongsFound(QFuture<QList<QUrl>>)), future);
+}
+
+QList<QUrl> MoodbarLoader::FindSongsWithoutMoodFiles(LibraryBackend* backend,
+                                                     MoodbarStore* store) {
+  QList<QUrl> ret;
+  {
+    QMutexLocker l(backend->db()->Mutex());
+    QSqlDatabase db(backend->db()->Connect());
+
+    QSqlQuery q(db);
+    q.prepare(
+        QString("SELECT DISTINCT filename, mtime FROM %1 WHERE unavailable = 0")
+            .arg(backend->songs_table()));
+    q.exec();
+    if (backend->db()->CheckErrors(q)) return ret;
+
+    while (q.next()) {
+      // Go through Song so relative URLs in portable mode get resolved.
+      Song song;
+      song.set_url(QUrl::fromEncoded(q.value(0).toByteArray()));
+      if (song.url().scheme() == "file" &&
+          !store->Contains(song.url(), q.value(1).toUInt())) {
+        ret << song.url();
+      }
+    }
+  }
+
+  // Stat the files without holding the database lock.
+  QList<QUrl>::iterator it = ret.begin();
+  while (it != ret.end()) {
+    bool has_mood_file = false;
+    for (const QString& mood_file : MoodFilenames(it->toLocalFile())) {
+      if (QFile::exists(mood_file)) {
+        has_mood_file = true;
+        break;
+      }
+    }
+    if (has_mood_file) {
+      it = ret.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return ret;
+}
+
+void MoodbarLoader::LibraryBatchSongsFound(QFuture<QList<QUrl>> future) {
+  if (batch_task_id_ == -1 || batch_total_ != -1) {
+    // The batch was stopped while we were looking.
+    return;
+  }
+
+  batch_queue_ = future.result();
+  batch_total_ = batch_queue_.count();
+  qLog(Info) << "Generating moodbars for up to" << batch_total_ << "songs";
+
+  UpdateLibraryBatchProgress();
   MaybeTakeNextRequest();
 
-  *async_pipeline = pipeline;
-  return WillLoadAsync;
+  // MaybeTakeNextRequest won't get to the batch if it has no free pipelines,
+  // but an empty batch can be finished straight away.
+  if (batch_task_id_ != -1 && batch_queue_.isEmpty() &&
+      batch_active_.isEmpty()) {
+    FinishLibraryBatch();
+  }
 }
 
-void MoodbarLoader::MaybeTakeNextRequest() {
-  Q_ASSERT(QThread::currentThread() == qApp->thread());
+void MoodbarLoader::SetLibraryBatchPaused(bool paused) {
+  if (batch_task_id_ == -1 || batch_paused_ == paused) {
+    return;
+  }
 
-  if (active_requests_.count() >= kMaxActiveRequests ||
-      queued_requests_.isEmpty() || disable_moodbar_calculation_) {
+  batch_paused_ = paused;
+  if (paused) {
+    // Pipelines that are already running are left to finish.
+    batch_elapsed_msec_ += batch_timer_.elapsed();
+    batch_timer_.invalidate();
+    qLog(Info) << "Moodbar generation paused";
+  } else {
+    batch_timer_.start();
+    qLog(Info) << "Moodbar generation resumed";
+    MaybeTakeNextRequest();
+  }
+}
+
+void MoodbarLoader::StopLibraryBatch() {
+  if (batch_task_id_ == -1) {
     return;
   }
 
-  const QUrl url = queued_requests_.takeFirst();
-  active_requests_ << url;
+  // Pipelines that are already running will still save their results.
+  batch_queue_.clear();
+  batch_active_.clear();
+  FinishLibraryBatch();
+}
 
-  qLog(Info) << "Creating moodbar data for" << url.toLocalFile();
-  QMetaObject::invokeMethod(requests_[url], "Start", Qt::QueuedConnection);
+void MoodbarLoader::UpdateLibraryBatchProgress() {
+  if (batch_total_ <= 0) {
+    return;
+  }
+
+  // Count the songs in flight as half done, so the progress bar moves as
+  // soon as the first pipelines start.
+  app_->task_manager()->SetTaskProgress(
+      batch_task_id_, batch_done_ * 2 + batch_active_.count(),
+      batch_total_ * 2);
+}
+
+qint64 MoodbarLoader::LibraryBatchElapsedMsec() const {
+  return batch_elapsed_msec_ +
+         (batch_timer_.isValid() ? batch_timer_.elapsed() : 0);
+}
+
+void MoodbarLoader::FinishLibraryBatch() {
+  const qint64 elapsed_msec = LibraryBatchElapsedMsec();
+  qLog(Info) << "Generated" << batch_generated_ << "moodbars in"
+             << elapsed_msec / 1000 << "seconds ("
+             << batch_generated_ * 60000.0 / qMax(elapsed_msec, qint64(1))
+             << "per minute)";
+
+  app_->task_manager()->SetTaskFinished(batch_task_id_);
+  batch_task_id_ = -1;
+  batch_paused_ = false;
+  batch_queue_.clear();
+  batch_active_.clear();
+  batch_timer_.invalidate();
+  emit LibraryBatchRunningChanged(false);
 }
 
 void MoodbarLoader::RequestFinished(MoodbarPipeline* request, const QUrl& url) {
@@ -154,15 +400,7 @@ void MoodbarLoader::RequestFinished(MoodbarPipeline* request, const QUrl& url) {
     qLog(Info) << "Moodbar data generated successfully for"
                << url.toLocalFile();
 
-    // Save the data in the cache
-    QNetworkCacheMetaData metadata;
-    metadata.setUrl(url);
-
-    QIODevice* cache_file = cache_->prepare(metadata);
-    if (cache_file) {
-      cache_file->write(request->data());
-      cache_->insert(cache_file);
-    }
+    store_.Insert(url, FileMtime(url.toLocalFile()), request->data());
 
     // Save the data alongside the original as well if we're configured to.
     if (save_alongside_originals_) {
@@ -189,6 +427,21 @@ void MoodbarLoader::RequestFinished(MoodbarPipeline* request, const QUrl& url) {
   requests_.remove(url);
   active_requests_.remove(url);
 
+  if (batch_active_.remove(url)) {
+    batch_done_++;
+    if (request->success()) batch_generated_++;
+
+    // Log the throughput every so often for long batches.
+    if (request->success() && batch_generated_ % 100 == 0) {
+      const qint64 elapsed_msec = LibraryBatchElapsedMsec();
+      qLog(Info) << "Moodbar generation:" << batch_done_ << "of"
+                 << batch_total_ << "songs,"
+                 << batch_generated_ * 60000.0 / qMax(elapsed_msec, qint64(1))
+                 << "per minute";
+    }
+    UpdateLibraryBatchProgress();
+  }
+
   QTimer::singleShot(1000, request, SLOT(deleteLater()));
 
   MaybeTakeNextRequest();
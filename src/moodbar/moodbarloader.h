@@ -18,14 +18,20 @@
 #ifndef MOODBARLOADER_H
 #define MOODBARLOADER_H
 
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QList>
 #include <QMap>
 #include <QObject>
 #include <QSet>
+#include <QUrl>
+
+#include "moodbarstore.h"
 
 class QNetworkDiskCache;
-class QUrl;
 
 class Application;
+class LibraryBackend;
 class MoodbarPipeline;
 
 class MoodbarLoader : public QObject {
@@ -48,20 +54,49 @@ class MoodbarLoader : public QObject {
     WillLoadAsync
   };
 
-  Result Load(const QUrl& url, QByteArray* data,
+  // mtime is the song file's modification time, it's looked up from the file
+  // if it's 0.
+  Result Load(const QUrl& url, uint mtime, QByteArray* data,
               MoodbarPipeline** async_pipeline);
 
+  bool is_library_batch_running() const { return batch_task_id_ != -1; }
+  bool is_library_batch_paused() const { return batch_paused_; }
+
+ public slots:
+  // Generates moodbars for every library song that doesn't have one yet,
+  // as a task on the TaskManager.  Requests from Load() always take priority
+  // over the batch.
+  void StartLibraryBatch();
+  void SetLibraryBatchPaused(bool paused);
+  void StopLibraryBatch();
+
+ signals:
+  void LibraryBatchRunningChanged(bool running);
+
  private slots:
   void ReloadSettings();
+  void LibraryBatchSongsFound(QFuture<QList<QUrl>> future);
 
   void RequestFinished(MoodbarPipeline* request, const QUrl& filename);
   void MaybeTakeNextRequest();
 
  private:
   static QStringList MoodFilenames(const QString& song_filename);
+  static uint FileMtime(const QString& filename);
+  static QList<QUrl> FindSongsWithoutMoodFiles(LibraryBackend* backend,
+                                               MoodbarStore* store);
+
+  MoodbarPipeline* CreatePipeline(const QUrl& url);
+  bool MaybeTakeNextBatchRequest();
+  void UpdateLibraryBatchProgress();
+  qint64 LibraryBatchElapsedMsec() const;
+  void FinishLibraryBatch();
 
  private:
+  Application* app_;
+  // Only read from, to move moodbars saved by older versions into store_.
   QNetworkDiskCache* cache_;
+  MoodbarStore store_;
   QThread* thread_;
 
   const int kMaxActiveRequests;
@@ -70,6 +105,16 @@ class MoodbarLoader : public QObject {
   QList<QUrl> queued_requests_;
   QSet<QUrl> active_requests_;
 
+  int batch_task_id_;
+  bool batch_paused_;
+  QList<QUrl> batch_queue_;
+  QSet<QUrl> batch_active_;
+  int batch_total_;
+  int batch_done_;
+  int batch_generated_;
+  qint64 batch_elapsed_msec_;
+  QElapsedTimer batch_timer_;
+
   bool save_alongside_originals_;
   bool disable_moodbar_calculation_;
 };
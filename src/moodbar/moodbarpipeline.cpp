@@ -17,6 +17,8 @@
 
 #include "moodbarpipeline.h"
 
+#include <cstring>
+
 #include <QCoreApplication>
 #include <QThread>
 #include <QUrl>
@@ -31,10 +33,18 @@
 
 bool MoodbarPipeline::sIsAvailable = false;
 const int MoodbarPipeline::kBands = 128;
+const int MoodbarPipeline::kFastRate = 32000;
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+static const char* kFastFormat = "F32LE";
+#else
+static const char* kFastFormat = "F32BE";
+#endif
 
-MoodbarPipeline::MoodbarPipeline(const QUrl& local_filename)
+MoodbarPipeline::MoodbarPipeline(const QUrl& local_filename, bool fast)
     : QObject(nullptr),
       local_filename_(local_filename),
+      fast_(fast),
       pipeline_(nullptr),
       convert_element_(nullptr),
       success_(false),
@@ -82,18 +92,34 @@ void MoodbarPipeline::Start() {
 
   GstElement* decodebin = CreateElement("uridecodebin");
   convert_element_ = CreateElement("audioconvert");
-  GstElement* spectrum = CreateElement("fastspectrum");
-  GstElement* fakesink = CreateElement("fakesink");
+  GstElement* analyser = nullptr;
+  GstElement* sink = nullptr;
+  if (fast_) {
+    analyser = CreateElement("audioresample");
+    sink = CreateElement("appsink");
+  } else {
+    analyser = CreateElement("fastspectrum");
+    sink = CreateElement("fakesink");
+  }
 
-  if (!decodebin || !convert_element_ || !spectrum || !fakesink) {
+  if (!decodebin || !convert_element_ || !analyser || !sink) {
     pipeline_ = nullptr;
     emit Finished(false);
     return;
   }
 
   // Join them together
-  if (!gst_element_link(convert_element_, spectrum) ||
-      !gst_element_link(spectrum, fakesink)) {
+  bool linked = gst_element_link(convert_element_, analyser);
+  if (fast_) {
+    GstCaps* caps = gst_caps_new_simple(
+        "audio/x-raw", "format", G_TYPE_STRING, kFastFormat, "channels",
+        G_TYPE_INT, 1, "rate", G_TYPE_INT, kFastRate, nullptr);
+    linked = linked && gst_element_link_filtered(analyser, sink, caps);
+    gst_caps_unref(caps);
+  } else {
+    linked = linked && gst_element_link(analyser, sink);
+  }
+  if (!linked) {
     qLog(Error) << "Failed to link elements";
     pipeline_ = nullptr;
     emit Finished(false);
@@ -105,11 +131,24 @@ void MoodbarPipeline::Start() {
   // Set properties
   QByteArray uri = Utilities::GetUriForGstreamer(local_filename_);
   g_object_set(decodebin, "uri", uri.constData(), nullptr);
-  g_object_set(spectrum, "bands", kBands, nullptr);
 
-  GstFastSpectrum* fast_spectrum = GST_FASTSPECTRUM(spectrum);
-  fast_spectrum->output_callback = [this](
-      double* magnitudes, int size) { builder_->AddFrame(magnitudes, size); };
+  if (fast_) {
+    builder_->InitSamples(kFastRate);
+
+    GstAppSinkCallbacks callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.new_sample = NewBufferCallback;
+    gst_app_sink_set_callbacks(reinterpret_cast<GstAppSink*>(sink),
+                               &callbacks, this, nullptr);
+    g_object_set(G_OBJECT(sink), "sync", FALSE, nullptr);
+  } else {
+    g_object_set(analyser, "bands", kBands, nullptr);
+
+    GstFastSpectrum* fast_spectrum = GST_FASTSPECTRUM(analyser);
+    fast_spectrum->output_callback = [this](double* magnitudes, int size) {
+      builder_->AddFrame(magnitudes, size);
+    };
+  }
 
   // Connect signals
   CHECKED_GCONNECT(decodebin, "pad-added", &NewPadCallback, this);
@@ -154,6 +193,9 @@ void MoodbarPipeline::NewPadCallback(GstElement*, GstPad* pad, gpointer data) {
   gst_pad_link(pad, audiopad);
   gst_object_unref(audiopad);
 
+  // The fast pipeline always resamples to the same rate.
+  if (self->fast_) return;
+
   int rate = 0;
   GstCaps* caps = gst_pad_get_current_caps(pad);
   GstStructure* structure = gst_caps_get_structure(caps, 0);
@@ -166,6 +208,26 @@ void MoodbarPipeline::NewPadCallback(GstElement*, GstPad* pad, gpointer data) {
     qLog(Error) << "Builder does not exist";
 }
 
+GstFlowReturn MoodbarPipeline::NewBufferCallback(GstAppSink* app_sink,
+                                                 gpointer data) {
+  MoodbarPipeline* self = reinterpret_cast<MoodbarPipeline*>(data);
+
+  GstSample* sample = gst_app_sink_pull_sample(app_sink);
+  if (!sample) return GST_FLOW_ERROR;
+  GstBuffer* buffer = gst_sample_get_buffer(sample);
+  if (buffer && self->builder_) {
+    GstMapInfo map;
+    if (gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+      self->builder_->AddSamples(reinterpret_cast<const float*>(map.data),
+                                 map.size / sizeof(float));
+      gst_buffer_unmap(buffer, &map);
+    }
+  }
+  gst_sample_unref(sample);
+
+  return GST_FLOW_OK;
+}
+
 GstBusSyncReply MoodbarPipeline::BusCallbackSync(GstBus*, GstMessage* msg,
                                                  gpointer data) {
   MoodbarPipeline* self = reinterpret_cast<MoodbarPipeline*>(data);
@@ -180,6 +242,17 @@ GstBusSyncReply MoodbarPipeline::BusCallbackSync(GstBus*, GstMessage* msg,
       self->Stop(false);
       break;
 
+    case GST_MESSAGE_STREAM_STATUS: {
+      // This is posted from the new streaming thread itself, which is the
+      // one actually reading the file.
+      GstStreamStatusType type;
+      gst_message_parse_stream_status(msg, &type, nullptr);
+      if (type == GST_STREAM_STATUS_TYPE_ENTER) {
+        Utilities::SetThreadIOPriority(Utilities::IOPRIO_CLASS_IDLE);
+      }
+      break;
+    }
+
     default:
       break;
   }
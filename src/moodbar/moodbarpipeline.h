@@ -33,9 +33,15 @@ class MoodbarPipeline : public QObject {
   Q_OBJECT
 
  public:
-  MoodbarPipeline(const QUrl& local_filename);
+  // A fast pipeline downmixes and resamples the audio to kFastRate and lets
+  // MoodbarBuilder transform it.  Otherwise the whole track is analysed at
+  // its own rate by the fastspectrum element.
+  MoodbarPipeline(const QUrl& local_filename, bool fast = true);
   ~MoodbarPipeline();
 
+  // Still high enough for the top Bark band.
+  static const int kFastRate;
+
   static bool IsAvailable();
 
   bool success() const { return success_; }
@@ -65,6 +71,7 @@ class MoodbarPipeline : public QObject {
   static const int kBands;
 
   QUrl local_filename_;
+  bool fast_;
   GstElement* pipeline_;
   GstElement* convert_element_;
 
@@ -16,6 +16,7 @@
 */
 
 #include "moodbarproxystyle.h"
+#include "moodbarrendercache.h"
 #include "core/application.h"
 #include "core/logging.h"
 
@@ -42,7 +43,6 @@ MoodbarProxyStyle::MoodbarProxyStyle(Application* app, QSlider* slider)
       moodbar_style_(MoodbarRenderer::Style_Normal),
       state_(MoodbarOff),
       fade_timeline_(new QTimeLine(1000, this)),
-      moodbar_colors_dirty_(true),
       moodbar_pixmap_dirty_(true),
       context_menu_(nullptr),
       show_moodbar_action_(nullptr),
@@ -73,14 +73,15 @@ void MoodbarProxyStyle::ReloadSettings() {
 
   if (new_style != moodbar_style_) {
     moodbar_style_ = new_style;
-    moodbar_colors_dirty_ = true;
+    moodbar_pixmap_dirty_ = true;
     slider_->update();
   }
 }
 
 void MoodbarProxyStyle::SetMoodbarData(const QByteArray& data) {
   data_ = data;
-  moodbar_colors_dirty_ = true;  // Redraw next time
+  data_id_ = MoodbarRenderCache::Id(data);
+  moodbar_pixmap_dirty_ = true;  // Redraw next time
   NextState();
 }
 
@@ -233,16 +234,8 @@ void MoodbarProxyStyle::Render(ComplexControl control,
 }
 
 void MoodbarProxyStyle::EnsureMoodbarRendered(const QStyleOptionSlider* opt) {
-  if (moodbar_colors_dirty_) {
-    moodbar_colors_ =
-        MoodbarRenderer::Colors(data_, moodbar_style_, slider_->palette());
-    moodbar_colors_dirty_ = false;
-    moodbar_pixmap_dirty_ = true;
-  }
-
   if (moodbar_pixmap_dirty_) {
-    moodbar_pixmap_ = MoodbarPixmap(moodbar_colors_, slider_->size(),
-                                    slider_->palette(), opt);
+    moodbar_pixmap_ = MoodbarPixmap(slider_->size(), slider_->palette(), opt);
     moodbar_pixmap_dirty_ = false;
   }
 }
@@ -316,8 +309,7 @@ void MoodbarProxyStyle::DrawArrow(const QStyleOptionSlider* option,
   painter->restore();
 }
 
-QPixmap MoodbarProxyStyle::MoodbarPixmap(const ColorVector& colors,
-                                         const QSize& size,
+QPixmap MoodbarProxyStyle::MoodbarPixmap(const QSize& size,
                                          const QPalette& palette,
                                          const QStyleOptionSlider* opt) {
   QRect rect(QPoint(0, 0), size);
@@ -330,8 +322,11 @@ QPixmap MoodbarProxyStyle::MoodbarPixmap(const ColorVector& colors,
   QPixmap ret(size);
   QPainter p(&ret);
 
-  // Draw the moodbar
-  MoodbarRenderer::Render(colors, &p, inner_rect);
+  // Draw the moodbar.  It shares the cache with the playlist, so a song
+  // that's been shown there already only has to be rendered at this size.
+  const QPixmap moodbar = app_->moodbar_render_cache()->RenderNow(
+      data_id_, data_, moodbar_style_, palette, inner_rect.size());
+  p.drawPixmap(inner_rect, moodbar);
 
   // Draw the border
   p.setPen(
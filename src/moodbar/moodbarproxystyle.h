@@ -70,8 +70,8 @@ class MoodbarProxyStyle : public QProxyStyle {
   void DrawArrow(const QStyleOptionSlider* option, QPainter* painter) const;
   void ShowContextMenu(const QPoint& pos);
 
-  QPixmap MoodbarPixmap(const ColorVector& colors, const QSize& size,
-                        const QPalette& palette, const QStyleOptionSlider* opt);
+  QPixmap MoodbarPixmap(const QSize& size, const QPalette& palette,
+                        const QStyleOptionSlider* opt);
 
  private slots:
   void ReloadSettings();
@@ -84,6 +84,7 @@ class MoodbarProxyStyle : public QProxyStyle {
 
   bool enabled_;
   QByteArray data_;
+  QByteArray data_id_;
   MoodbarRenderer::MoodbarStyle moodbar_style_;
 
   State state_;
@@ -92,9 +93,7 @@ class MoodbarProxyStyle : public QProxyStyle {
   QPixmap fade_source_;
   QPixmap fade_target_;
 
-  bool moodbar_colors_dirty_;
   bool moodbar_pixmap_dirty_;
-  ColorVector moodbar_colors_;
   QPixmap moodbar_pixmap_;
 
   QMenu* context_menu_;
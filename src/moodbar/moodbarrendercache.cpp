@@ -0,0 +1,186 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "moodbarrendercache.h"
+
+#include <QCryptographicHash>
+
+#include "core/closure.h"
+#include "core/memoryaccounting.h"
+#include "core/taskexecutor.h"
+
+const int MoodbarRenderCache::kWidthBucket = 32;
+const int MoodbarRenderCache::kMaxCost = 32 * 1024 * 1024;  // 32MB of pixels
+const int MoodbarRenderCache::kResizeDelayMsec = 150;
+
+uint qHash(const MoodbarRenderCache::Key& key) {
+  return qHash(key.id) ^ qHash(int(key.style)) ^
+         qHash((key.size.width() << 16) | key.size.height());
+}
+
+MoodbarRenderCache::MoodbarRenderCache(QObject* parent)
+    : QObject(parent), pixmaps_(kMaxCost), colors_(500) {
+  pending_timer_.setSingleShot(true);
+  connect(&pending_timer_, SIGNAL(timeout()), SLOT(StartPendingRequests()));
+
+  MemoryAccounting::Instance()->Register(
+      this, "moodbar_render_cache", "Rendered moodbars",
+      [this]() { return qint64(pixmaps_.totalCost()); },
+      [this](qint64 bytes) { pixmaps_.setMaxCost(int(bytes)); },
+      MemoryAccounting::Priority_Disposable);
+}
+
+QByteArray MoodbarRenderCache::Id(const QByteArray& data) {
+  return QCryptographicHash::hash(data, QCryptographicHash::Md5);
+}
+
+QSize MoodbarRenderCache::BucketSize(const QSize& size) {
+  const int width =
+      (qMax(1, size.width()) + kWidthBucket - 1) / kWidthBucket * kWidthBucket;
+  return QSize(width, qMax(1, size.height()));
+}
+
+MoodbarRenderCache::Key MoodbarRenderCache::ColorsKey(
+    const QByteArray& id, MoodbarRenderer::MoodbarStyle style) {
+  return Key(id, style, QSize());
+}
+
+QPixmap MoodbarRenderCache::Find(const QByteArray& id,
+                                 MoodbarRenderer::MoodbarStyle style,
+                                 const QSize& size, bool* exact) {
+  QPixmap* pixmap = pixmaps_.object(Key(id, style, BucketSize(size)));
+  *exact = pixmap != nullptr;
+  if (pixmap) return *pixmap;
+
+  QHash<Key, QSize>::const_iterator last =
+      last_sizes_.constFind(ColorsKey(id, style));
+  if (last != last_sizes_.constEnd()) {
+    pixmap = pixmaps_.object(Key(id, style, *last));
+    if (pixmap) return *pixmap;
+  }
+  return QPixmap();
+}
+
+void MoodbarRenderCache::Render(const QByteArray& id, const QByteArray& data,
+                                MoodbarRenderer::MoodbarStyle style,
+                                const QPalette& palette, const QSize& size) {
+  Request request;
+  request.key = Key(id, style, BucketSize(size));
+  request.data = data;
+  request.palette = palette;
+
+  if (pixmaps_.contains(request.key) || running_.contains(request.key)) {
+    return;
+  }
+
+  // If there's something to show already then the moodbar is being resized,
+  // so wait until it stops.  Otherwise render it as soon as possible.
+  const Key colors_key = ColorsKey(id, style);
+  pending_[colors_key] = request;
+  if (last_sizes_.contains(colors_key)) {
+    pending_timer_.start(kResizeDelayMsec);
+  } else if (!pending_timer_.isActive()) {
+    pending_timer_.start(0);
+  }
+}
+
+void MoodbarRenderCache::StartPendingRequests() {
+  for (const Request& request : pending_) {
+    if (running_.contains(request.key)) continue;
+
+    ColorVector colors;
+    if (ColorVector* cached = colors_.object(
+            ColorsKey(request.key.id, request.key.style))) {
+      colors = *cached;
+    }
+
+    running_ << request.key;
+    QFuture<Result> future = TaskExecutor::Instance()->Run<Result>(
+        TaskExecutor::Lane_Interactive,
+        std::bind(&MoodbarRenderCache::RenderRequest, request, colors));
+    NewClosure(future, this,
+               SLOT(RequestFinished(QFuture<MoodbarRenderCache::Result>)),
+               future);
+  }
+  pending_.clear();
+}
+
+MoodbarRenderCache::Result MoodbarRenderCache::RenderRequest(
+    const Request& request, const ColorVector& colors) {
+  Result ret;
+  ret.key = request.key;
+  ret.colors = colors;
+  if (ret.colors.isEmpty()) {
+    ret.colors = MoodbarRenderer::Colors(request.data, request.key.style,
+                                         request.palette);
+  }
+  ret.image = MoodbarRenderer::RenderToImage(ret.colors, request.key.size);
+  return ret;
+}
+
+void MoodbarRenderCache::RequestFinished(
+    QFuture<MoodbarRenderCache::Result> future) {
+  const Result result = future.result();
+  running_.remove(result.key);
+  Insert(result);
+
+  emit Rendered(result.key.id);
+}
+
+QPixmap MoodbarRenderCache::RenderNow(const QByteArray& id,
+                                      const QByteArray& data,
+                                      MoodbarRenderer::MoodbarStyle style,
+                                      const QPalette& palette,
+                                      const QSize& size) {
+  const Key key(id, style, BucketSize(size));
+  if (QPixmap* pixmap = pixmaps_.object(key)) {
+    return *pixmap;
+  }
+
+  Request request;
+  request.key = key;
+  request.data = data;
+  request.palette = palette;
+
+  ColorVector colors;
+  if (ColorVector* cached = colors_.object(ColorsKey(id, style))) {
+    colors = *cached;
+  }
+
+  const Result result = RenderRequest(request, colors);
+  Insert(result);
+  return QPixmap::fromImage(result.image);
+}
+
+void MoodbarRenderCache::Insert(const Result& result) {
+  const Key colors_key = ColorsKey(result.key.id, result.key.style);
+  if (!colors_.contains(colors_key)) {
+    colors_.insert(colors_key, new ColorVector(result.colors));
+  }
+
+  const QSize& size = result.key.size;
+  pixmaps_.insert(result.key, new QPixmap(QPixmap::fromImage(result.image)),
+                  size.width() * size.height() * 4);
+  last_sizes_[colors_key] = size;
+}
+
+void MoodbarRenderCache::Clear() {
+  pixmaps_.clear();
+  colors_.clear();
+  last_sizes_.clear();
+  pending_.clear();
+}
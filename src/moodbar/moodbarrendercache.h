@@ -0,0 +1,130 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MOODBAR_MOODBARRENDERCACHE_H_
+#define MOODBAR_MOODBARRENDERCACHE_H_
+
+#include <QCache>
+#include <QFuture>
+#include <QHash>
+#include <QObject>
+#include <QPalette>
+#include <QPixmap>
+#include <QSet>
+#include <QTimer>
+
+#include "moodbarrenderer.h"
+
+// Rendered moodbars shared by every playlist view and the seek slider.
+// Moodbars are identified by a hash of their data, so the same song looks the
+// same everywhere without being parsed and rendered twice.  Widths are rounded
+// up into buckets so a column that's resized a little still uses the image it
+// already has, and the cache is bounded by the total size of its images.
+//
+// While moodbars are being resized, renders are held back until the size has
+// stopped changing, and the old image is stretched to fit meanwhile.
+class MoodbarRenderCache : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit MoodbarRenderCache(QObject* parent = nullptr);
+
+  static const int kWidthBucket;
+  static const int kMaxCost;
+  static const int kResizeDelayMsec;
+
+  static QByteArray Id(const QByteArray& data);
+
+  // Returns the image for this moodbar at the bucketed size, without
+  // rendering it.  If there isn't one, an image rendered at an earlier size is
+  // returned and exact is set to false.
+  QPixmap Find(const QByteArray& id, MoodbarRenderer::MoodbarStyle style,
+               const QSize& size, bool* exact);
+
+  // Renders the moodbar in the background, Rendered() is emitted when it's
+  // done.  Does nothing if the moodbar is being rendered at this size already.
+  void Render(const QByteArray& id, const QByteArray& data,
+              MoodbarRenderer::MoodbarStyle style, const QPalette& palette,
+              const QSize& size);
+
+  // Renders the moodbar straight away if it's not in the cache.
+  QPixmap RenderNow(const QByteArray& id, const QByteArray& data,
+                    MoodbarRenderer::MoodbarStyle style,
+                    const QPalette& palette, const QSize& size);
+
+  void Clear();
+
+ signals:
+  void Rendered(const QByteArray& id);
+
+ private:
+  struct Key {
+    Key() : style(MoodbarRenderer::Style_Normal) {}
+    Key(const QByteArray& id, MoodbarRenderer::MoodbarStyle style,
+        const QSize& size)
+        : id(id), style(style), size(size) {}
+
+    bool operator==(const Key& other) const {
+      return id == other.id && style == other.style && size == other.size;
+    }
+
+    QByteArray id;
+    MoodbarRenderer::MoodbarStyle style;
+    QSize size;
+  };
+  friend uint qHash(const Key& key);
+
+  struct Request {
+    Key key;
+    QByteArray data;
+    QPalette palette;
+  };
+
+  struct Result {
+    Key key;
+    ColorVector colors;
+    QImage image;
+  };
+
+  static QSize BucketSize(const QSize& size);
+  static Key ColorsKey(const QByteArray& id,
+                       MoodbarRenderer::MoodbarStyle style);
+  static Result RenderRequest(const Request& request,
+                              const ColorVector& colors);
+
+  void Insert(const Result& result);
+
+ private slots:
+  void StartPendingRequests();
+  void RequestFinished(QFuture<MoodbarRenderCache::Result> future);
+
+ private:
+  QCache<Key, QPixmap> pixmaps_;
+  QCache<Key, ColorVector> colors_;
+
+  // The size each moodbar was last rendered at, for drawing while another
+  // size is being rendered.
+  QHash<Key, QSize> last_sizes_;
+
+  // Requests waiting for the size to settle, keyed on their colors key so
+  // only the latest size for each moodbar is rendered.
+  QHash<Key, Request> pending_;
+  QSet<Key> running_;
+  QTimer pending_timer_;
+};
+
+#endif  // MOODBAR_MOODBARRENDERCACHE_H_
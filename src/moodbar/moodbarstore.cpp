@@ -0,0 +1,297 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "moodbarstore.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QList>
+#include <QMutexLocker>
+#include <QUrl>
+
+#include "core/logging.h"
+
+namespace {
+
+const char kMagic[] = "CLMOOD01";
+const int kMagicSize = sizeof(kMagic) - 1;
+const int kKeySize = 20;
+
+// Each record is the key, the song's mtime and the data size as quint32s,
+// then the data.
+const int kRecordHeaderSize = kKeySize + 2 * sizeof(quint32);
+
+}  // namespace
+
+const qint64 MoodbarStore::kDefaultMaxSize =
+    128 * 1024 * 1024;  // 128MB - around 40,000 moodbars
+
+qint64 MoodbarStore::Entry::record_size() const {
+  return kRecordHeaderSize + size;
+}
+
+MoodbarStore::MoodbarStore(const QString& filename, qint64 max_size)
+    : file_(filename),
+      max_size_(max_size),
+      opened_(false),
+      map_(nullptr),
+      mapped_size_(0),
+      dead_size_(0) {}
+
+MoodbarStore::~MoodbarStore() { Unmap(); }
+
+qint64 MoodbarStore::MemoryUsage() {
+  QMutexLocker l(&mutex_);
+  // A SHA1 key and an Entry, plus QHash's own node.
+  const qint64 entry_bytes = 20 + sizeof(Entry) + 4 * sizeof(void*);
+  return index_.count() * entry_bytes + mapped_size_;
+}
+
+QByteArray MoodbarStore::Key(const QUrl& url) {
+  return QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1);
+}
+
+bool MoodbarStore::EnsureOpen() {
+  if (opened_) return file_.isOpen();
+  opened_ = true;
+
+  QDir().mkpath(QFileInfo(file_.fileName()).path());
+  if (!file_.open(QIODevice::ReadWrite)) {
+    qLog(Warning) << "Couldn't open moodbar store" << file_.fileName()
+                  << file_.errorString();
+    return false;
+  }
+
+  Map();
+  if (!ReadIndex()) {
+    Reset();
+    return true;
+  }
+
+  qLog(Debug) << "Loaded" << index_.count() << "moodbars from"
+              << file_.fileName();
+  return true;
+}
+
+bool MoodbarStore::ReadIndex() {
+  if (mapped_size_ < kMagicSize || memcmp(map_, kMagic, kMagicSize) != 0) {
+    return false;
+  }
+
+  // A record that runs off the end of the file was being written when we last
+  // exited, so it's thrown away.
+  qint64 offset = kMagicSize;
+  while (offset + kRecordHeaderSize <= mapped_size_) {
+    const uchar* header = map_ + offset;
+    quint32 mtime, size;
+    memcpy(&mtime, header + kKeySize, sizeof(mtime));
+    memcpy(&size, header + kKeySize + sizeof(mtime), sizeof(size));
+
+    const qint64 end = offset + kRecordHeaderSize + size;
+    if (end > mapped_size_) break;
+
+    Entry entry;
+    entry.offset = offset + kRecordHeaderSize;
+    entry.size = size;
+    entry.mtime = mtime;
+
+    // Later records for the same song replace earlier ones.
+    const QByteArray key(reinterpret_cast<const char*>(header), kKeySize);
+    QHash<QByteArray, Entry>::const_iterator it = index_.constFind(key);
+    if (it != index_.constEnd()) dead_size_ += it->record_size();
+    index_[key] = entry;
+    offset = end;
+  }
+
+  if (offset != mapped_size_) {
+    Unmap();
+    file_.resize(offset);
+    Map();
+  }
+  return true;
+}
+
+bool MoodbarStore::Compact() {
+  QFile out(file_.fileName() + ".new");
+  if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    return false;
+  }
+
+  // Make sure records added since the file was mapped are in the mapping.
+  Unmap();
+  Map();
+
+  // Copy the live records over in the order they were written.
+  QList<QPair<qint64, QByteArray>> records;
+  for (QHash<QByteArray, Entry>::const_iterator it = index_.constBegin();
+       it != index_.constEnd(); ++it) {
+    records << qMakePair(it->offset, it.key());
+  }
+  std::sort(records.begin(), records.end());
+
+  QHash<QByteArray, Entry> index;
+  bool ok = out.write(kMagic, kMagicSize) == kMagicSize;
+  for (const QPair<qint64, QByteArray>& record : records) {
+    if (!ok) break;
+
+    Entry entry = index_[record.second];
+    const qint64 start = entry.offset - kRecordHeaderSize;
+    if (start + entry.record_size() > mapped_size_) continue;
+
+    entry.offset = out.pos() + kRecordHeaderSize;
+    ok = out.write(reinterpret_cast<const char*>(map_ + start),
+                   entry.record_size()) == entry.record_size();
+    index[record.second] = entry;
+  }
+
+  if (!ok || !out.flush()) {
+    qLog(Warning) << "Couldn't compact moodbar store" << out.fileName()
+                  << out.errorString();
+    out.remove();
+    return false;
+  }
+  out.close();
+
+  Unmap();
+  file_.close();
+  QFile::remove(file_.fileName());
+  if (!out.rename(file_.fileName()) || !file_.open(QIODevice::ReadWrite)) {
+    qLog(Warning) << "Couldn't replace moodbar store" << file_.fileName();
+    index_.clear();
+    return false;
+  }
+
+  Map();
+  index_ = index;
+  dead_size_ = 0;
+  return true;
+}
+
+void MoodbarStore::Reset() {
+  Unmap();
+  index_.clear();
+  dead_size_ = 0;
+  file_.resize(0);
+  file_.seek(0);
+  file_.write(kMagic, kMagicSize);
+  file_.flush();
+  Map();
+}
+
+void MoodbarStore::Map() {
+  mapped_size_ = file_.size();
+  map_ = mapped_size_ ? file_.map(0, mapped_size_) : nullptr;
+  if (!map_) mapped_size_ = 0;
+}
+
+void MoodbarStore::Unmap() {
+  if (map_) file_.unmap(map_);
+  map_ = nullptr;
+  mapped_size_ = 0;
+}
+
+void MoodbarStore::Clear() {
+  QMutexLocker l(&mutex_);
+  if (!EnsureOpen()) return;
+  Reset();
+}
+
+bool MoodbarStore::Contains(const QUrl& url, uint mtime) {
+  QMutexLocker l(&mutex_);
+  if (!EnsureOpen()) return false;
+
+  QHash<QByteArray, Entry>::const_iterator it = index_.constFind(Key(url));
+  return it != index_.constEnd() && it->mtime == mtime;
+}
+
+QByteArray MoodbarStore::Find(const QUrl& url, uint mtime) {
+  QMutexLocker l(&mutex_);
+  if (!EnsureOpen()) return QByteArray();
+
+  QHash<QByteArray, Entry>::const_iterator it = index_.constFind(Key(url));
+  if (it == index_.constEnd() || it->mtime != mtime) return QByteArray();
+
+  // Records added since the file was mapped aren't in the mapping yet.
+  const qint64 end = it->offset + it->size;
+  if (end > mapped_size_) {
+    Unmap();
+    Map();
+    if (end > mapped_size_) return QByteArray();
+  }
+
+  return QByteArray(reinterpret_cast<const char*>(map_ + it->offset),
+                    it->size);
+}
+
+void MoodbarStore::Insert(const QUrl& url, uint mtime,
+                          const QByteArray& data) {
+  if (data.isEmpty()) return;
+
+  QMutexLocker l(&mutex_);
+  if (!EnsureOpen()) return;
+
+  const QByteArray key = Key(url);
+  QHash<QByteArray, Entry>::const_iterator existing = index_.constFind(key);
+  if (existing != index_.constEnd() && existing->mtime == mtime) return;
+
+  const qint64 size = kRecordHeaderSize + data.size();
+  if (kMagicSize + size > max_size_) return;
+  if (file_.size() + size > max_size_) {
+    // Throwing away the replaced records is much cheaper than regenerating
+    // every moodbar, so try that first.
+    if (dead_size_ == 0 || !Compact() || !file_.isOpen() ||
+        file_.size() + size > max_size_) {
+      if (!file_.isOpen()) return;
+      qLog(Debug) << "Moodbar store" << file_.fileName()
+                  << "is full, emptying it";
+      Reset();
+    }
+    existing = index_.constFind(key);
+  }
+
+  const quint32 record_mtime = mtime;
+  const quint32 record_size = data.size();
+
+  file_.seek(file_.size());
+  const qint64 offset = file_.pos();
+  file_.write(key);
+  file_.write(reinterpret_cast<const char*>(&record_mtime),
+              sizeof(record_mtime));
+  file_.write(reinterpret_cast<const char*>(&record_size),
+              sizeof(record_size));
+  file_.write(data);
+  if (!file_.flush() || file_.size() != offset + size) {
+    qLog(Warning) << "Couldn't write to moodbar store" << file_.fileName()
+                  << file_.errorString();
+    Unmap();
+    file_.resize(offset);
+    Map();
+    return;
+  }
+
+  if (existing != index_.constEnd()) dead_size_ += existing->record_size();
+
+  Entry entry;
+  entry.offset = offset + kRecordHeaderSize;
+  entry.size = data.size();
+  entry.mtime = mtime;
+  index_[key] = entry;
+}
@@ -0,0 +1,89 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MOODBAR_MOODBARSTORE_H_
+#define MOODBAR_MOODBARSTORE_H_
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+class QUrl;
+
+// Keeps the moodbar data for every song in a single memory-mapped file, so
+// showing moodbars for a big playlist doesn't mean opening a .mood file for
+// each row.  Records are keyed on a hash of the song's URL and are only valid
+// for the song file's modification time they were stored with.  New records
+// are appended; when the file would grow bigger than max_size the records that
+// were superseded are compacted away, and if that's not enough the whole store
+// is emptied.
+//
+// All methods are thread-safe.
+class MoodbarStore {
+ public:
+  explicit MoodbarStore(const QString& filename,
+                        qint64 max_size = kDefaultMaxSize);
+  ~MoodbarStore();
+
+  static const qint64 kDefaultMaxSize;
+
+  QString filename() const { return file_.fileName(); }
+
+  // Returns an empty array if there's no data for this version of the file.
+  QByteArray Find(const QUrl& url, uint mtime);
+  bool Contains(const QUrl& url, uint mtime);
+  void Insert(const QUrl& url, uint mtime, const QByteArray& data);
+
+  void Clear();
+
+  // The index plus the mapped file, which is only resident once it's read.
+  qint64 MemoryUsage();
+
+ private:
+  struct Entry {
+    qint64 offset;
+    int size;
+    uint mtime;
+    qint64 record_size() const;
+  };
+
+  static QByteArray Key(const QUrl& url);
+
+  bool EnsureOpen();
+  bool ReadIndex();
+  bool Compact();
+  void Reset();
+  void Map();
+  void Unmap();
+
+  QMutex mutex_;
+  QFile file_;
+  qint64 max_size_;
+  bool opened_;
+
+  uchar* map_;
+  qint64 mapped_size_;
+
+  // Bytes used by records that have been replaced by newer ones.
+  qint64 dead_size_;
+
+  QHash<QByteArray, Entry> index_;
+};
+
+#endif  // MOODBAR_MOODBARSTORE_H_
@@ -18,10 +18,12 @@
 #include "acoustidclient.h"
 
 #include <algorithm>
+#include <functional>
 
 #include <QCoreApplication>
 #include <QNetworkReply>
 #include <QStringList>
+#include <QTimer>
 #include <QUrlQuery>
 #include <QJsonParseError>
 #include <QJsonDocument>
@@ -36,42 +38,119 @@
 const char* AcoustidClient::kClientId = "qsZGpeLx";
 const char* AcoustidClient::kUrl = "https://api.acoustid.org/v2/lookup";
 const int AcoustidClient::kDefaultTimeout = 5000;  // msec
+// AcoustID allows three requests a second from each client.
+const double AcoustidClient::kRequestsPerSec = 3.0;
+const int AcoustidClient::kRequestBurst = 3;
+const int AcoustidClient::kMaxFingerprintsPerRequest = 10;
+const int AcoustidClient::kBatchDelayMsec = 250;
+const int AcoustidClient::kThrottledBackoffMsec = 2000;
+const int AcoustidClient::kMaxRetries = 3;
 
 AcoustidClient::AcoustidClient(QObject* parent)
     : QObject(parent),
-      network_(new NetworkAccessManager(this)),
-      timeouts_(new NetworkTimeouts(kDefaultTimeout, this)) {}
+      network_(NetworkAccessManager::Shared()),
+      timeouts_(new NetworkTimeouts(kDefaultTimeout, this)),
+      rate_limiter_(
+          new NetworkRateLimiter(kRequestsPerSec, kRequestBurst, this)),
+      batch_timer_(new QTimer(this)),
+      scheduled_batches_(0) {
+  batch_timer_->setSingleShot(true);
+  batch_timer_->setInterval(kBatchDelayMsec);
+  connect(batch_timer_, SIGNAL(timeout()), SLOT(ScheduleBatches()));
+}
 
 void AcoustidClient::SetTimeout(int msec) { timeouts_->SetTimeout(msec); }
 
 void AcoustidClient::Start(int id, const QString& fingerprint,
                            int duration_msec) {
-  typedef QPair<QString, QString> Param;
+  Fingerprint f;
+  f.id_ = id;
+  f.fingerprint_ = fingerprint;
+  f.duration_msec_ = duration_msec;
+  f.retries_ = 0;
+  queue_ << f;
+
+  // Fingerprints usually arrive one after another while a batch of songs is
+  // being tagged, so wait a moment for the next few before sending.
+  if (!batch_timer_->isActive()) {
+    batch_timer_->start();
+  }
+}
+
+void AcoustidClient::ScheduleBatches() {
+  // Each batch takes whatever is queued when the rate limiter lets it go, so
+  // more fingerprints can join the ones that are waiting.
+  const int needed = (queue_.count() + kMaxFingerprintsPerRequest - 1) /
+                     kMaxFingerprintsPerRequest;
+  while (scheduled_batches_ < needed) {
+    scheduled_batches_++;
+    rate_limiter_->Schedule(std::bind(&AcoustidClient::SendBatch, this));
+  }
+}
 
-  QList<Param> parameters;
-  parameters << Param("format", "json") << Param("client", kClientId)
-             << Param("duration", QString::number(duration_msec / kMsecPerSec))
-             << Param("meta", "recordingids+sources")
-             << Param("fingerprint", fingerprint);
+void AcoustidClient::SendBatch() {
+  scheduled_batches_--;
+  if (queue_.isEmpty()) {
+    return;
+  }
+
+  const QList<Fingerprint> batch = queue_.mid(0, kMaxFingerprintsPerRequest);
+  queue_.erase(queue_.begin(), queue_.begin() + batch.count());
+
+  // The multi-fingerprint form of the lookup: fingerprint.N and duration.N
+  // for each one, with the results tagged by N.
+  QUrlQuery query;
+  query.addQueryItem("format", "json");
+  query.addQueryItem("client", kClientId);
+  query.addQueryItem("meta", "recordingids+sources");
+  for (int i = 0; i < batch.count(); ++i) {
+    query.addQueryItem(
+        QString("duration.%1").arg(i),
+        QString::number(batch[i].duration_msec_ / kMsecPerSec));
+    query.addQueryItem(QString("fingerprint.%1").arg(i),
+                       batch[i].fingerprint_);
+  }
 
-  QUrl url(kUrl);
-  QUrlQuery url_query;
-  url_query.setQueryItems(parameters);
-  url.setQuery(url_query);
-  QNetworkRequest req(url);
+  QNetworkRequest req((QUrl(kUrl)));
+  req.setHeader(QNetworkRequest::ContentTypeHeader,
+                "application/x-www-form-urlencoded");
 
-  QNetworkReply* reply = network_->get(req);
+  QNetworkReply* reply =
+      network_->post(req, query.toString(QUrl::FullyEncoded).toLatin1());
   NewClosure(reply, SIGNAL(finished()), this,
-             SLOT(RequestFinished(QNetworkReply*, int)), reply, id);
-  requests_[id] = reply;
+             SLOT(RequestFinished(QNetworkReply*)), reply);
+  batches_[reply] = batch;
+  for (const Fingerprint& f : batch) {
+    requests_[f.id_] = reply;
+  }
 
   timeouts_->AddReply(reply);
 }
 
-void AcoustidClient::Cancel(int id) { delete requests_.take(id); }
+void AcoustidClient::Cancel(int id) {
+  for (int i = 0; i < queue_.count(); ++i) {
+    if (queue_[i].id_ == id) {
+      queue_.removeAt(i);
+      return;
+    }
+  }
+
+  QNetworkReply* reply = requests_.take(id);
+  if (reply && !requests_.values().contains(reply)) {
+    // Nobody else is waiting for this batch.
+    batches_.remove(reply);
+    delete reply;
+  }
+}
 
 void AcoustidClient::CancelAll() {
-  qDeleteAll(requests_.values());
+  batch_timer_->stop();
+  rate_limiter_->Clear();
+  scheduled_batches_ = 0;
+  queue_.clear();
+
+  qDeleteAll(batches_.keys());
+  batches_.clear();
   requests_.clear();
 }
 
@@ -89,41 +168,13 @@ struct IdSource {
   QString id_;
   int nb_sources_;
 };
-}
-
-void AcoustidClient::RequestFinished(QNetworkReply* reply, int request_id) {
-  reply->deleteLater();
-  requests_.remove(request_id);
-
-  if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() !=
-      200) {
-    emit Finished(request_id, QStringList());
-    return;
-  }
-
-  QJsonParseError error;
-  QJsonDocument json_document = QJsonDocument::fromJson(reply->readAll(), &error);
-
-  if (error.error != QJsonParseError::NoError) {
-    emit Finished(request_id, QStringList());
-    return;
-  }
-
-  QJsonObject json_object = json_document.object();
-
-  QString status = json_object["status"].toString();
-  if (status != "ok") {
-    emit Finished(request_id, QStringList());
-    return;
-  }
-
-  // Get the results:
-  // -in a first step, gather ids and their corresponding number of sources
-  // -then sort results by number of sources (the results are originally
-  //  unsorted but results with more sources are likely to be more accurate)
-  // -keep only the ids, as sources where useful only to sort the results
-  QJsonArray json_results = json_object["results"].toArray();
 
+// Get the results for one fingerprint:
+// -in a first step, gather ids and their corresponding number of sources
+// -then sort results by number of sources (the results are originally
+//  unsorted but results with more sources are likely to be more accurate)
+// -keep only the ids, as sources where useful only to sort the results
+QStringList ParseResults(const QJsonArray& json_results) {
   // List of <id, nb of sources> pairs
   QList<IdSource> id_source_list;
 
@@ -142,10 +193,70 @@ void AcoustidClient::RequestFinished(QNetworkReply* reply, int request_id) {
 
   std::stable_sort(id_source_list.begin(), id_source_list.end());
 
-  QList<QString> id_list;
+  QStringList id_list;
   for (const IdSource& is : id_source_list) {
     id_list << is.id_;
   }
+  return id_list;
+}
+}  // namespace
 
-  emit Finished(request_id, id_list);
+void AcoustidClient::RequestFinished(QNetworkReply* reply) {
+  reply->deleteLater();
+  const QList<Fingerprint> batch = batches_.take(reply);
+
+  // Only the fingerprints that haven't been cancelled get results.
+  QList<int> waiting;
+  for (int i = 0; i < batch.count(); ++i) {
+    if (requests_.value(batch[i].id_) == reply) {
+      requests_.remove(batch[i].id_);
+      waiting << i;
+    }
+  }
+
+  QMap<int, QStringList> results;
+
+  const int status =
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if (status == 429 || status == 503) {
+    // We were throttled anyway, maybe by another client on the same
+    // address.  Slow down and send these again.
+    qLog(Warning) << "AcoustID throttled our request, retrying later";
+    rate_limiter_->Backoff(kThrottledBackoffMsec);
+
+    QList<Fingerprint> retry;
+    for (int i : waiting) {
+      Fingerprint f = batch[i];
+      if (++f.retries_ <= kMaxRetries) {
+        retry << f;
+      } else {
+        emit Finished(f.id_, QStringList());
+      }
+    }
+    queue_ = retry + queue_;
+    ScheduleBatches();
+    return;
+  } else if (status == 200) {
+    QJsonParseError error;
+    QJsonDocument json_document =
+        QJsonDocument::fromJson(reply->readAll(), &error);
+    QJsonObject json_object = json_document.object();
+
+    if (error.error == QJsonParseError::NoError &&
+        json_object["status"].toString() == "ok") {
+      if (json_object.contains("fingerprints")) {
+        for (const QJsonValue& v : json_object["fingerprints"].toArray()) {
+          QJsonObject o = v.toObject();
+          results[o["index"].toVariant().toInt()] =
+              ParseResults(o["results"].toArray());
+        }
+      } else {
+        results[0] = ParseResults(json_object["results"].toArray());
+      }
+    }
+  }
+
+  for (int i : waiting) {
+    emit Finished(batch[i].id_, results.value(i));
+  }
 }
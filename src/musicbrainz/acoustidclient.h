@@ -18,13 +18,17 @@
 #ifndef ACOUSTIDCLIENT_H
 #define ACOUSTIDCLIENT_H
 
+#include <QHash>
+#include <QList>
 #include <QMap>
 #include <QObject>
 
+class NetworkRateLimiter;
 class NetworkTimeouts;
 
 class QNetworkAccessManager;
 class QNetworkReply;
+class QTimer;
 
 class AcoustidClient : public QObject {
   Q_OBJECT
@@ -36,6 +40,8 @@ class AcoustidClient : public QObject {
   // You can create one AcoustidClient and make multiple requests using it.
   // IDs are provided by the caller when a request is started and included in
   // the Finished signal - they have no meaning to AcoustidClient.
+  // Fingerprints that are started close together are looked up in one
+  // request, and requests are kept under the service's rate limit.
 
  public:
   AcoustidClient(QObject* parent = nullptr);
@@ -43,7 +49,7 @@ class AcoustidClient : public QObject {
   // Network requests will be aborted after this interval.
   void SetTimeout(int msec);
 
-  // Starts a request and returns immediately.  Finished() will be emitted
+  // Queues a request and returns immediately.  Finished() will be emitted
   // later with the same ID.
   void Start(int id, const QString& fingerprint, int duration_msec);
 
@@ -59,16 +65,41 @@ signals:
   void Finished(int id, const QStringList& mbid_list);
 
  private slots:
-  void RequestFinished(QNetworkReply* reply, int id);
+  void ScheduleBatches();
+  void RequestFinished(QNetworkReply* reply);
 
  private:
+  struct Fingerprint {
+    int id_;
+    QString fingerprint_;
+    int duration_msec_;
+    int retries_;
+  };
+
   static const char* kClientId;
   static const char* kUrl;
   static const int kDefaultTimeout;
+  static const double kRequestsPerSec;
+  static const int kRequestBurst;
+  static const int kMaxFingerprintsPerRequest;
+  static const int kBatchDelayMsec;
+  static const int kThrottledBackoffMsec;
+  static const int kMaxRetries;
+
+  void SendBatch();
 
   QNetworkAccessManager* network_;
   NetworkTimeouts* timeouts_;
+  NetworkRateLimiter* rate_limiter_;
+  QTimer* batch_timer_;
+
+  // Fingerprints that haven't been sent yet, and the number of batches
+  // waiting for the rate limiter to send them.
+  QList<Fingerprint> queue_;
+  int scheduled_batches_;
+
   QMap<int, QNetworkReply*> requests_;
+  QHash<QNetworkReply*, QList<Fingerprint>> batches_;
 };
 
 #endif  // ACOUSTIDCLIENT_H
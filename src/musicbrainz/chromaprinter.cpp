@@ -164,7 +164,11 @@ QString Chromaprinter::CreateFingerprint() {
   int ret = chromaprint_get_raw_fingerprint(chromaprint, &fprint, &size);
 
   QByteArray fingerprint;
+  raw_fingerprint_.clear();
   if (ret == 1) {
+    raw_fingerprint_.resize(size);
+    memcpy(raw_fingerprint_.data(), fprint, size * sizeof(quint32));
+
     int encoded_size = 0;
     chromaprint_encode_fingerprint(fprint, size, CHROMAPRINT_ALGORITHM_DEFAULT,
                                    &encoded, &encoded_size, 1);
@@ -207,6 +211,16 @@ GstFlowReturn Chromaprinter::NewBufferCallback(GstAppSink* app_sink,
                                                gpointer self) {
   Chromaprinter* me = reinterpret_cast<Chromaprinter*>(self);
 
+  // The seek should stop the decoder after kPlayLengthSecs, but not every
+  // format can seek.  Don't decode the rest of the file when it can't.
+  static const qint64 kMaxBytes =
+      qint64(kPlayLengthSecs) * kDecodeRate * kDecodeChannels * 2;
+  if (me->buffer_.size() >= kMaxBytes) {
+    gst_element_post_message(GST_ELEMENT(app_sink),
+                             gst_message_new_eos(GST_OBJECT(app_sink)));
+    return GST_FLOW_EOS;
+  }
+
   GstSample* sample = gst_app_sink_pull_sample(app_sink);
   if (!sample) return GST_FLOW_ERROR;
   GstBuffer* buffer = gst_sample_get_buffer(sample);
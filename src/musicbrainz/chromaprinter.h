@@ -23,6 +23,7 @@
 
 #include <QBuffer>
 #include <QString>
+#include <QVector>
 
 class Chromaprinter {
   // Creates a Chromaprint fingerprint from a song.
@@ -40,6 +41,9 @@ class Chromaprinter {
   // to call it in another thread.  Returns an empty string if no fingerprint
   // could be created.
   QString CreateFingerprint();
+  // The fingerprint from CreateFingerprint() before it was compressed and
+  // encoded for Acoustid, one 32-bit frame for about every eighth of a second.
+  const QVector<quint32>& raw_fingerprint() const { return raw_fingerprint_; }
 
  private:
   GstElement* CreateElement(const QString& factory_name,
@@ -54,6 +58,7 @@ class Chromaprinter {
   GstElement* convert_element_;
 
   QBuffer buffer_;
+  QVector<quint32> raw_fingerprint_;
 };
 
 #endif  // CHROMAPRINTER_H
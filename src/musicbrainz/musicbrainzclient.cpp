@@ -18,8 +18,10 @@
 #include "musicbrainzclient.h"
 
 #include <algorithm>
+#include <functional>
 
 #include <QCoreApplication>
+#include <QMetaObject>
 #include <QNetworkReply>
 #include <QSet>
 #include <QXmlStreamReader>
@@ -37,48 +39,67 @@ const char* MusicBrainzClient::kDiscUrl =
 const char* MusicBrainzClient::kDateRegex = "^[12]\\d{3}";
 const int MusicBrainzClient::kDefaultTimeout = 5000;  // msec
 const int MusicBrainzClient::kMaxRequestPerTrack = 3;
+// MusicBrainz allows an average of one request a second from each address.
+const double MusicBrainzClient::kRequestsPerSec = 1.0;
+const int MusicBrainzClient::kThrottledBackoffMsec = 2000;
+const int MusicBrainzClient::kMaxRetries = 3;
+const int MusicBrainzClient::kMaxCachedRecordings = 1000;
 
 MusicBrainzClient::MusicBrainzClient(QObject* parent,
                                      QNetworkAccessManager* network)
     : QObject(parent),
-      network_(network ? network : new NetworkAccessManager(this)),
-      timeouts_(new NetworkTimeouts(kDefaultTimeout, this)) {}
+      network_(network ? network : NetworkAccessManager::Shared()),
+      timeouts_(new NetworkTimeouts(kDefaultTimeout, this)),
+      rate_limiter_(new NetworkRateLimiter(kRequestsPerSec, 1, this)),
+      cache_(kMaxCachedRecordings) {}
 
 void MusicBrainzClient::Start(int id, const QStringList& mbid_list) {
-  typedef QPair<QString, QString> Param;
+  // Make sure there's an entry even if every recording is cached.
+  pending_results_[id];
 
   int request_number = 0;
   for (const QString& mbid : mbid_list) {
-    QList<Param> parameters;
-    parameters << Param("inc", "artists+releases+media");
-
-    QUrl url(kTrackUrl + mbid);
-    QUrlQuery url_query;
-    url_query.setQueryItems(parameters);
-    url.setQuery(url_query);
-    QNetworkRequest req(url);
-
-    QNetworkReply* reply = network_->get(req);
-    NewClosure(reply, SIGNAL(finished()), this,
-               SLOT(RequestFinished(QNetworkReply*, int, int)), reply, id,
-               request_number++);
-    requests_.insert(id, reply);
-
-    timeouts_->AddReply(reply);
+    Waiter waiter;
+    waiter.id_ = id;
+    waiter.request_number_ = request_number++;
+
+    if (ResultList* cached = cache_.object(mbid)) {
+      AddResults(waiter, *cached);
+    } else {
+      waiters_.insert(mbid, waiter);
+      if (!queued_.contains(mbid) && !requests_.contains(mbid)) {
+        // The MusicBrainz web service has no way to look up several
+        // recordings by MBID in one request, so they go one at a time.
+        queued_.insert(mbid);
+        rate_limiter_->Schedule(
+            std::bind(&MusicBrainzClient::SendRequest, this, mbid));
+      }
+    }
 
     if (request_number >= kMaxRequestPerTrack) {
       break;
     }
   }
+
+  if (!IsWaiting(id)) {
+    // Everything came from the cache.  Don't emit from inside Start().
+    QMetaObject::invokeMethod(this, "EmitResults", Qt::QueuedConnection,
+                              Q_ARG(int, id));
+  }
 }
 
-void MusicBrainzClient::StartDiscIdRequest(const QString& discid) {
+void MusicBrainzClient::SendRequest(const QString& mbid) {
+  // It might have been cancelled while it was waiting.
+  if (!queued_.remove(mbid) || !waiters_.contains(mbid)) {
+    return;
+  }
+
   typedef QPair<QString, QString> Param;
 
   QList<Param> parameters;
-  parameters << Param("inc", "artists+recordings");
+  parameters << Param("inc", "artists+releases+media");
 
-  QUrl url(kDiscUrl + discid);
+  QUrl url(kTrackUrl + mbid);
   QUrlQuery url_query;
   url_query.setQueryItems(parameters);
   url.setQuery(url_query);
@@ -86,17 +107,65 @@ void MusicBrainzClient::StartDiscIdRequest(const QString& discid) {
 
   QNetworkReply* reply = network_->get(req);
   NewClosure(reply, SIGNAL(finished()), this,
-             SLOT(DiscIdRequestFinished(const QString&, QNetworkReply*)),
-             discid, reply);
+             SLOT(RequestFinished(QNetworkReply*, const QString&)), reply, mbid);
+  requests_[mbid] = reply;
 
   timeouts_->AddReply(reply);
 }
 
-void MusicBrainzClient::Cancel(int id) { delete requests_.take(id); }
+void MusicBrainzClient::StartDiscIdRequest(const QString& discid) {
+  typedef QPair<QString, QString> Param;
+
+  QList<Param> parameters;
+  parameters << Param("inc", "artists+recordings");
+
+  QUrl url(kDiscUrl + discid);
+  QUrlQuery url_query;
+  url_query.setQueryItems(parameters);
+  url.setQuery(url_query);
+  QNetworkRequest req(url);
+
+  rate_limiter_->Schedule([this, req, discid]() {
+    QNetworkReply* reply = network_->get(req);
+    NewClosure(reply, SIGNAL(finished()), this,
+               SLOT(DiscIdRequestFinished(const QString&, QNetworkReply*)),
+               discid, reply);
+
+    timeouts_->AddReply(reply);
+  });
+}
+
+void MusicBrainzClient::Cancel(int id) {
+  pending_results_.remove(id);
+
+  for (auto it = waiters_.begin(); it != waiters_.end();) {
+    if (it->id_ == id) {
+      it = waiters_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Stop looking up recordings nobody wants any more.
+  for (auto it = requests_.begin(); it != requests_.end();) {
+    if (!waiters_.contains(it.key())) {
+      delete it.value();
+      retries_.remove(it.key());
+      it = requests_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
 
 void MusicBrainzClient::CancelAll() {
+  rate_limiter_->Clear();
   qDeleteAll(requests_.values());
   requests_.clear();
+  queued_.clear();
+  waiters_.clear();
+  retries_.clear();
+  pending_results_.clear();
 }
 
 void MusicBrainzClient::DiscIdRequestFinished(const QString& discid,
@@ -175,21 +244,21 @@ void MusicBrainzClient::DiscIdRequestFinished(const QString& discid,
   emit Finished(artist, album, UniqueResults(ret, SortResults));
 }
 
-void MusicBrainzClient::RequestFinished(QNetworkReply* reply, int id,
-                                        int request_number) {
+void MusicBrainzClient::RequestFinished(QNetworkReply* reply,
+                                        const QString& mbid) {
   reply->deleteLater();
 
-  const int nb_removed = requests_.remove(id, reply);
-  if (nb_removed != 1) {
-    qLog(Error)
-        << "Error: unknown reply received:" << nb_removed
-        << "requests removed, while only one was supposed to be removed";
+  if (requests_.value(mbid) != reply) {
+    qLog(Error) << "Error: unknown reply received for" << mbid;
+    return;
   }
+  requests_.remove(mbid);
 
-  if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() ==
-      200) {
+  ResultList res;
+  const int status =
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if (status == 200) {
     QXmlStreamReader reader(reply);
-    ResultList res;
     while (!reader.atEnd()) {
       if (reader.readNext() == QXmlStreamReader::StartElement &&
           reader.name() == "recording") {
@@ -201,27 +270,62 @@ void MusicBrainzClient::RequestFinished(QNetworkReply* reply, int id,
         }
       }
     }
-    pending_results_[id] << PendingResults(request_number, res);
+    cache_.insert(mbid, new ResultList(res));
+  } else if (status == 503 && retries_[mbid]++ < kMaxRetries) {
+    // We were throttled anyway, maybe by another client on the same
+    // address.  Slow down and try this one again.
+    qLog(Warning) << "MusicBrainz throttled our request, retrying later";
+    rate_limiter_->Backoff(kThrottledBackoffMsec);
+    queued_.insert(mbid);
+    rate_limiter_->Schedule(
+        std::bind(&MusicBrainzClient::SendRequest, this, mbid));
+    return;
   } else {
-    qLog(Error) << "Error:"
-                << reply->attribute(QNetworkRequest::HttpStatusCodeAttribute)
-                       .toInt() << "http status code received";
+    qLog(Error) << "Error:" << status << "http status code received";
     qLog(Error) << reply->readAll();
   }
-
-  // No more pending requests for this id: emit the results we have.
-  if (!requests_.contains(id)) {
-    // Merge the results we have
-    ResultList ret;
-    QList<PendingResults> result_list_list = pending_results_.take(id);
-    std::sort(result_list_list.begin(), result_list_list.end());
-    for (const PendingResults& result_list : result_list_list) {
-      ret << result_list.results_;
+  retries_.remove(mbid);
+
+  const QList<Waiter> waiters = waiters_.values(mbid);
+  waiters_.remove(mbid);
+  for (const Waiter& waiter : waiters) {
+    AddResults(waiter, res);
+    // No more pending requests for this id: emit the results we have.
+    if (!IsWaiting(waiter.id_)) {
+      EmitResults(waiter.id_);
     }
-    emit Finished(id, UniqueResults(ret, KeepOriginalOrder));
   }
 }
 
+void MusicBrainzClient::AddResults(const Waiter& waiter,
+                                   const ResultList& results) {
+  pending_results_[waiter.id_]
+      << PendingResults(waiter.request_number_, results);
+}
+
+bool MusicBrainzClient::IsWaiting(int id) const {
+  for (const Waiter& waiter : waiters_) {
+    if (waiter.id_ == id) return true;
+  }
+  return false;
+}
+
+void MusicBrainzClient::EmitResults(int id) {
+  if (!pending_results_.contains(id)) {
+    // Cancelled.
+    return;
+  }
+
+  // Merge the results we have
+  ResultList ret;
+  QList<PendingResults> result_list_list = pending_results_.take(id);
+  std::sort(result_list_list.begin(), result_list_list.end());
+  for (const PendingResults& result_list : result_list_list) {
+    ret << result_list.results_;
+  }
+  emit Finished(id, UniqueResults(ret, KeepOriginalOrder));
+}
+
 bool MusicBrainzClient::MediumHasDiscid(const QString& discid,
                                         QXmlStreamReader* reader) {
   while (!reader->atEnd()) {
@@ -18,11 +18,14 @@
 #ifndef MUSICBRAINZCLIENT_H
 #define MUSICBRAINZCLIENT_H
 
+#include <QCache>
 #include <QHash>
 #include <QMultiMap>
 #include <QObject>
+#include <QSet>
 #include <QXmlStreamReader>
 
+class NetworkRateLimiter;
 class NetworkTimeouts;
 
 class QNetworkAccessManager;
@@ -99,8 +102,9 @@ signals:
  private slots:
   // id identifies the track, and request_number means it's the
   // 'request_number'th request for this track
-  void RequestFinished(QNetworkReply* reply, int id, int request_number);
+  void RequestFinished(QNetworkReply* reply, const QString& mbid);
   void DiscIdRequestFinished(const QString& discid, QNetworkReply* reply);
+  void EmitResults(int id);
 
  private:
   // Used as parameter for UniqueResults
@@ -155,6 +159,12 @@ signals:
     Status status_;
   };
 
+  // Someone waiting for a recording to be looked up.
+  struct Waiter {
+    int id_;
+    int request_number_;
+  };
+
   struct PendingResults {
     PendingResults(int sort_id, const ResultList& results)
       : sort_id_(sort_id), results_(results) {}
@@ -176,6 +186,10 @@ signals:
   static ResultList UniqueResults(const ResultList& results,
       UniqueResultsSortOption opt = SortResults);
 
+  void SendRequest(const QString& mbid);
+  void AddResults(const Waiter& waiter, const ResultList& results);
+  bool IsWaiting(int id) const;
+
 
  private:
   static const char* kTrackUrl;
@@ -183,10 +197,23 @@ signals:
   static const char* kDateRegex;
   static const int kDefaultTimeout;
   static const int kMaxRequestPerTrack;
+  static const double kRequestsPerSec;
+  static const int kThrottledBackoffMsec;
+  static const int kMaxRetries;
+  static const int kMaxCachedRecordings;
 
   QNetworkAccessManager* network_;
   NetworkTimeouts* timeouts_;
-  QMultiMap<int, QNetworkReply*> requests_;
+  NetworkRateLimiter* rate_limiter_;
+
+  // Recordings are looked up once however many IDs want them.  These are
+  // keyed by MBID.
+  QMultiHash<QString, Waiter> waiters_;
+  QSet<QString> queued_;
+  QHash<QString, QNetworkReply*> requests_;
+  QHash<QString, int> retries_;
+  QCache<QString, ResultList> cache_;
+
   // Results we received so far, kept here until all the replies are finished
   QMap<int, QList<PendingResults>> pending_results_;
 };
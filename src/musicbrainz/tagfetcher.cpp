@@ -20,16 +20,24 @@
 #include "acoustidclient.h"
 #include "chromaprinter.h"
 #include "musicbrainzclient.h"
+#include "core/application.h"
+#include "core/closure.h"
+#include "core/concurrentrun.h"
+#include "core/database.h"
 #include "core/timeconstants.h"
 
-#include <QFuture>
-#include <QFutureWatcher>
+#include <functional>
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSqlQuery>
 #include <QUrl>
-#include <QtConcurrentMap>
+#include <QVariant>
 
-TagFetcher::TagFetcher(QObject* parent)
+TagFetcher::TagFetcher(Application* app, QObject* parent)
     : QObject(parent),
-      fingerprint_watcher_(nullptr),
+      app_(app),
+      fetch_id_(0),
       acoustid_client_(new AcoustidClient(this)),
       musicbrainz_client_(new MusicBrainzClient(this)) {
   connect(acoustid_client_, SIGNAL(Finished(int, QStringList)),
@@ -39,8 +47,41 @@ TagFetcher::TagFetcher(QObject* parent)
           SLOT(TagsFetched(int, MusicBrainzClient::ResultList)));
 }
 
-QString TagFetcher::GetFingerprint(const Song& song) {
-  return Chromaprinter(song.url().toLocalFile()).CreateFingerprint();
+QString TagFetcher::GetFingerprint(Database* db, const Song& song) {
+  const QString filename = song.url().toLocalFile();
+  const uint mtime = QFileInfo(filename).lastModified().toTime_t();
+
+  {
+    QMutexLocker l(db->Mutex());
+    QSqlDatabase sql(db->Connect());
+
+    QSqlQuery q(sql);
+    q.prepare(
+        "SELECT fingerprint FROM fingerprints"
+        " WHERE filename = :filename AND mtime = :mtime");
+    q.bindValue(":filename", filename);
+    q.bindValue(":mtime", mtime);
+    q.exec();
+    if (!db->CheckErrors(q) && q.next()) return q.value(0).toString();
+  }
+
+  const QString fingerprint = Chromaprinter(filename).CreateFingerprint();
+  if (fingerprint.isEmpty()) return fingerprint;
+
+  QMutexLocker l(db->Mutex());
+  QSqlDatabase sql(db->Connect());
+
+  QSqlQuery q(sql);
+  q.prepare(
+      "INSERT OR REPLACE INTO fingerprints (filename, mtime, fingerprint)"
+      " VALUES (:filename, :mtime, :fingerprint)");
+  q.bindValue(":filename", filename);
+  q.bindValue(":mtime", mtime);
+  q.bindValue(":fingerprint", fingerprint);
+  q.exec();
+  db->CheckErrors(q);
+
+  return fingerprint;
 }
 
 void TagFetcher::StartFetch(const SongList& songs) {
@@ -48,38 +89,36 @@ void TagFetcher::StartFetch(const SongList& songs) {
 
   songs_ = songs;
 
-  QFuture<QString> future = QtConcurrent::mapped(songs_, GetFingerprint);
-  fingerprint_watcher_ = new QFutureWatcher<QString>(this);
-  fingerprint_watcher_->setFuture(future);
-  connect(fingerprint_watcher_, SIGNAL(resultReadyAt(int)),
-          SLOT(FingerprintFound(int)));
+  for (int i = 0; i < songs_.count(); ++i) {
+    QFuture<QString> future = ConcurrentRun::Run<QString>(
+        &fingerprint_pool_,
+        std::bind(&TagFetcher::GetFingerprint, app_->database(), songs_[i]));
+    NewClosure(future, this,
+               SLOT(FingerprintFound(QFuture<QString>, int, int)), future, i,
+               fetch_id_);
 
-  for (const Song& song : songs) {
-    emit Progress(song, tr("Fingerprinting song"));
+    emit Progress(songs_[i], tr("Fingerprinting song"));
   }
 }
 
 void TagFetcher::Cancel() {
-  if (fingerprint_watcher_) {
-    fingerprint_watcher_->cancel();
-
-    delete fingerprint_watcher_;
-    fingerprint_watcher_ = nullptr;
-  }
+  // Drop the songs that haven't started fingerprinting yet, and ignore the
+  // ones that have.
+  fingerprint_pool_.clear();
+  fetch_id_++;
 
   acoustid_client_->CancelAll();
   musicbrainz_client_->CancelAll();
   songs_.clear();
 }
 
-void TagFetcher::FingerprintFound(int index) {
-  QFutureWatcher<QString>* watcher =
-      reinterpret_cast<QFutureWatcher<QString>*>(sender());
-  if (!watcher || index >= songs_.count()) {
+void TagFetcher::FingerprintFound(QFuture<QString> future, int index,
+                                  int fetch_id) {
+  if (fetch_id != fetch_id_ || index >= songs_.count()) {
     return;
   }
 
-  const QString fingerprint = watcher->resultAt(index);
+  const QString fingerprint = future.result();
   const Song& song = songs_[index];
 
   if (fingerprint.isEmpty()) {
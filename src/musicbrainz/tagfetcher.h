@@ -21,10 +21,13 @@
 #include "musicbrainzclient.h"
 #include "core/song.h"
 
-#include <QFutureWatcher>
+#include <QFuture>
 #include <QObject>
+#include <QThreadPool>
 
 class AcoustidClient;
+class Application;
+class Database;
 
 class TagFetcher : public QObject {
   Q_OBJECT
@@ -33,7 +36,7 @@ class TagFetcher : public QObject {
   // MusicBrainzClient.
 
  public:
-  TagFetcher(QObject* parent = nullptr);
+  TagFetcher(Application* app, QObject* parent = nullptr);
 
   void StartFetch(const SongList& songs);
 
@@ -46,14 +49,23 @@ signals:
                        const SongList& songs_guessed);
 
  private slots:
-  void FingerprintFound(int index);
+  void FingerprintFound(QFuture<QString> future, int index, int fetch_id);
   void PuidsFound(int index, const QStringList& puid_list);
   void TagsFetched(int index, const MusicBrainzClient::ResultList& result);
 
  private:
-  static QString GetFingerprint(const Song& song);
+  // Runs in a background thread.  Fingerprints are cached in the database
+  // until the file changes.
+  static QString GetFingerprint(Database* db, const Song& song);
+
+  Application* app_;
+
+  // Fingerprinting decodes audio, so only run as many at once as we have
+  // cores.
+  QThreadPool fingerprint_pool_;
+  // Results from an earlier StartFetch are ignored.
+  int fetch_id_;
 
-  QFutureWatcher<QString>* fingerprint_watcher_;
   AcoustidClient* acoustid_client_;
   MusicBrainzClient* musicbrainz_client_;
 
@@ -180,10 +180,17 @@ void IncomingDataParser::Parse(const pb::remote::Message& msg) {
       client->song_sender()->SendSongs(msg.request_download_songs());
       break;
     case pb::remote::SONG_OFFER_RESPONSE:
-      client->song_sender()->ResponseSongOffer(msg.response_song_offer().accepted());
+      client->song_sender()->ResponseSongOffer(
+          msg.response_song_offer().accepted(),
+          msg.response_song_offer().offset());
       break;
     case pb::remote::GET_LIBRARY:
-      emit SendLibrary(client);
+      if (msg.has_request_library()) {
+        emit SendLibraryDelta(client, msg.request_library().version(),
+                              msg.request_library().replicate());
+      } else {
+        emit SendLibrary(client);
+      }
       break;
     case pb::remote::RATE_SONG:
       RateSong(msg);
@@ -52,6 +52,7 @@ class IncomingDataParser : public QObject {
   void RemoveSongs(int id, const QList<int>& indices);
   void SeekTo(int seconds);
   void SendLibrary(RemoteClient* client);
+  void SendLibraryDelta(RemoteClient* client, int version, bool replicate);
   void RateCurrentSong(double);
 
   void DoGlobalSearch(QString, RemoteClient*);
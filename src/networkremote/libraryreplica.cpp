@@ -0,0 +1,270 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "libraryreplica.h"
+
+#include <QDataStream>
+#include <QSettings>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "networkremote.h"
+#include "core/closure.h"
+#include "core/concurrentrun.h"
+#include "core/logging.h"
+#include "core/song.h"
+#include "library/librarybackend.h"
+#include "library/sqlrow.h"
+
+const char* LibraryReplica::kSettingsGroup = "LibraryReplica";
+const int LibraryReplica::kPollIntervalMsec = 5 * 60 * 1000;
+const int LibraryReplica::kMaxMessageBytes = 128 * 1024 * 1024;
+
+LibraryReplica::LibraryReplica(LibraryBackend* backend, QObject* parent)
+    : QObject(parent),
+      backend_(backend),
+      poll_timer_(new QTimer(this)),
+      socket_(new QTcpSocket(this)),
+      port_(NetworkRemote::kDefaultServerPort),
+      auth_code_(0),
+      version_(0),
+      busy_(false),
+      finishing_(false),
+      expected_length_(-1) {
+  // Rows have to be written in the order they were sent.
+  pool_.setMaxThreadCount(1);
+
+  poll_timer_->setInterval(kPollIntervalMsec);
+  connect(poll_timer_, SIGNAL(timeout()), SLOT(Poll()));
+
+  connect(socket_, SIGNAL(connected()), SLOT(Connected()));
+  connect(socket_, SIGNAL(disconnected()), SLOT(Disconnected()));
+  connect(socket_, SIGNAL(error(QAbstractSocket::SocketError)),
+          SLOT(Disconnected()));
+  connect(socket_, SIGNAL(readyRead()), SLOT(ReadyRead()));
+}
+
+LibraryReplica::~LibraryReplica() { pool_.waitForDone(); }
+
+bool LibraryReplica::IsEnabled() {
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  return !s.value("host").toString().isEmpty();
+}
+
+void LibraryReplica::Start() {
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  host_ = s.value("host").toString();
+  port_ = s.value("port", NetworkRemote::kDefaultServerPort).toInt();
+  auth_code_ = s.value("auth_code", 0).toInt();
+
+  // A version from another Clementine means nothing to this one.
+  const QString source = QString("%1:%2").arg(host_).arg(port_);
+  version_ = s.value("source").toString() == source
+                 ? s.value("version", 0).toInt()
+                 : 0;
+
+  qLog(Info) << "Copying the library from" << source << "from version"
+             << version_;
+  poll_timer_->start();
+  Poll();
+}
+
+void LibraryReplica::Poll() {
+  if (busy_) return;
+  busy_ = true;
+
+  expected_length_ = -1;
+  buffer_.clear();
+  sync_.reset();
+  socket_->connectToHost(host_, port_);
+}
+
+void LibraryReplica::Connected() {
+  pb::remote::Message msg;
+  msg.set_type(pb::remote::CONNECT);
+  msg.mutable_request_connect()->set_auth_code(auth_code_);
+  Send(&msg);
+
+  msg.Clear();
+  msg.set_type(pb::remote::GET_LIBRARY);
+  pb::remote::RequestLibrary* request = msg.mutable_request_library();
+  request->set_version(version_);
+  request->set_replicate(true);
+  Send(&msg);
+}
+
+void LibraryReplica::Disconnected() {
+  if (sync_) {
+    qLog(Warning) << "Lost the connection to" << host_
+                  << "while copying the library:" << socket_->errorString();
+    sync_.reset();
+  }
+
+  // Once the last message has arrived SyncFinished lets the next poll start.
+  if (!finishing_) busy_ = false;
+}
+
+void LibraryReplica::Send(pb::remote::Message* msg) {
+  msg->set_version(msg->default_instance().version());
+  const std::string data = msg->SerializeAsString();
+
+  QDataStream s(socket_);
+  s << qint32(data.length());
+  s.writeRawData(data.data(), data.length());
+}
+
+void LibraryReplica::ReadyRead() {
+  forever {
+    if (expected_length_ == -1) {
+      if (socket_->bytesAvailable() < 4) return;
+
+      QDataStream s(socket_);
+      s >> expected_length_;
+      if (expected_length_ < 0 || expected_length_ > kMaxMessageBytes) {
+        qLog(Warning) << "Received invalid data from" << host_;
+        sync_.reset();
+        socket_->abort();
+        return;
+      }
+    }
+
+    buffer_ += socket_->read(expected_length_ - buffer_.size());
+    if (buffer_.size() < expected_length_) return;
+
+    pb::remote::Message msg;
+    const bool parsed = msg.ParseFromArray(buffer_.constData(), buffer_.size());
+    expected_length_ = -1;
+    buffer_.clear();
+
+    if (parsed) HandleMessage(msg);
+    if (socket_->state() != QAbstractSocket::ConnectedState) return;
+  }
+}
+
+void LibraryReplica::HandleMessage(const pb::remote::Message& msg) {
+  switch (msg.type()) {
+    case pb::remote::DISCONNECT:
+      qLog(Warning) << host_ << "won't send its library, reason"
+                    << msg.response_disconnect().reason_disconnect();
+      sync_.reset();
+      socket_->abort();
+      break;
+
+    case pb::remote::LIBRARY_DELTA: {
+      const pb::remote::ResponseLibraryDelta& delta =
+          msg.response_library_delta();
+      if (!sync_) {
+        sync_.reset(new Sync);
+        sync_->backend_ = backend_;
+        sync_->full_ = delta.base_version() == 0;
+      }
+
+      SyncPtr sync = sync_;
+      const QByteArray rows(delta.rows().data(), delta.rows().size());
+      ConcurrentRun::Run<void>(&pool_,
+                               [sync, rows]() { ApplyRows(sync, rows); });
+
+      if (delta.last()) {
+        QFuture<bool> future = ConcurrentRun::Run<bool>(
+            &pool_, [sync]() { return FinishSync(sync); });
+        NewClosure(future, this, SLOT(SyncFinished(QFuture<bool>, int)),
+                   future, int(delta.version()));
+        sync_.reset();
+        finishing_ = true;
+
+        // Everything else it sends is for remote controls.
+        pb::remote::Message disconnect;
+        disconnect.set_type(pb::remote::DISCONNECT);
+        Send(&disconnect);
+        socket_->disconnectFromHost();
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+void LibraryReplica::ApplyRows(SyncPtr sync, const QByteArray& compressed) {
+  if (!sync->ok_) return;
+
+  const QByteArray data = qUncompress(compressed);
+  pb::remote::LibraryRows rows;
+  if (!rows.ParseFromArray(data.constData(), data.size()) ||
+      rows.songs_size() > 0) {
+    qLog(Warning) << "The other Clementine can't send whole songs";
+    sync->ok_ = false;
+    return;
+  }
+
+  SongList songs;
+  for (const std::string& row_data : rows.song_rows()) {
+    QDataStream s(QByteArray::fromRawData(row_data.data(), row_data.size()));
+    s.setVersion(QDataStream::Qt_5_0);
+    QVector<QVariant> columns;
+    s >> columns;
+
+    if (s.status() != QDataStream::Ok ||
+        columns.count() != Song::kColumns.count() + 1) {
+      qLog(Warning) << "The other Clementine's songs have different columns";
+      sync->ok_ = false;
+      return;
+    }
+
+    Song song;
+    song.InitFromQuery(SqlRow(columns), true);
+    songs << song;
+    if (sync->full_) sync->ids_ << song.id();
+  }
+
+  QList<int> deleted_ids;
+  for (int id : rows.deleted_ids()) deleted_ids << id;
+
+  sync->backend_->ReplicateSongs(songs, deleted_ids);
+}
+
+bool LibraryReplica::FinishSync(SyncPtr sync) {
+  if (!sync->ok_) return false;
+  if (!sync->full_) return true;
+
+  QList<int> stale_ids;
+  for (int id : sync->backend_->GetAllSongIds()) {
+    if (!sync->ids_.contains(id)) stale_ids << id;
+  }
+  if (!stale_ids.isEmpty()) {
+    sync->backend_->ReplicateSongs(SongList(), stale_ids);
+  }
+  return true;
+}
+
+void LibraryReplica::SyncFinished(QFuture<bool> future, int version) {
+  busy_ = false;
+  finishing_ = false;
+  if (!future.result()) return;
+
+  if (version != version_) {
+    qLog(Debug) << "Copied the library up to version" << version;
+  }
+  version_ = version;
+
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  s.setValue("source", QString("%1:%2").arg(host_).arg(port_));
+  s.setValue("version", version_);
+}
@@ -0,0 +1,108 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NETWORKREMOTE_LIBRARYREPLICA_H_
+#define NETWORKREMOTE_LIBRARYREPLICA_H_
+
+#include <memory>
+
+#include <QByteArray>
+#include <QFuture>
+#include <QObject>
+#include <QSet>
+#include <QThreadPool>
+
+#include "remotecontrolmessages.pb.h"
+
+class LibraryBackend;
+class QTcpSocket;
+class QTimer;
+
+// Keeps the library a copy of another Clementine's, so a group of them
+// watching the same files only needs one to scan and read tags.  The other
+// Clementine's network remote sends the changes since the version we have,
+// as the same library deltas remotes get but with whole rows, and we ask
+// again every few minutes.  Song IDs are the same as in the original, so
+// nothing else may write songs to a replicated library.
+//
+// Enabled by setting "host" in the "LibraryReplica" settings group, along
+// with "port" and "auth_code" if the other Clementine needs them.  It's read
+// at startup, since the library isn't scanned at all while it's on.
+class LibraryReplica : public QObject {
+  Q_OBJECT
+
+ public:
+  LibraryReplica(LibraryBackend* backend, QObject* parent = nullptr);
+  ~LibraryReplica();
+
+  static const char* kSettingsGroup;
+  static const int kPollIntervalMsec;
+  // Bigger messages than this mean the stream is garbage.
+  static const int kMaxMessageBytes;
+
+  static bool IsEnabled();
+
+  void Start();
+
+ private slots:
+  void Poll();
+  void Connected();
+  void Disconnected();
+  void ReadyRead();
+  void SyncFinished(QFuture<bool> future, int version);
+
+ private:
+  // One response from the other Clementine, which might take many messages.
+  // The rows are written on pool_'s only thread, in the order they arrive.
+  struct Sync {
+    Sync() : backend_(nullptr), full_(false), ok_(true) {}
+
+    LibraryBackend* backend_;
+    // A full copy replaces the whole library, so songs that weren't in it
+    // are deleted at the end.
+    bool full_;
+    bool ok_;
+    QSet<int> ids_;
+  };
+  typedef std::shared_ptr<Sync> SyncPtr;
+
+  static void ApplyRows(SyncPtr sync, const QByteArray& compressed);
+  static bool FinishSync(SyncPtr sync);
+
+  void Send(pb::remote::Message* msg);
+  void HandleMessage(const pb::remote::Message& msg);
+
+  LibraryBackend* backend_;
+  QTimer* poll_timer_;
+  QTcpSocket* socket_;
+  QThreadPool pool_;
+
+  QString host_;
+  quint16 port_;
+  int auth_code_;
+  // The version of the other library we have.
+  int version_;
+
+  // Set from connecting until the rows have been written.
+  bool busy_;
+  // Set once the last message has arrived.
+  bool finishing_;
+  qint32 expected_length_;
+  QByteArray buffer_;
+  SyncPtr sync_;
+};
+
+#endif  // NETWORKREMOTE_LIBRARYREPLICA_H_
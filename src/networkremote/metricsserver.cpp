@@ -0,0 +1,225 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "metricsserver.h"
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+#include <QFile>
+#include <QHostAddress>
+#include <QNetworkProxy>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTextStream>
+
+#include "core/application.h"
+#include "core/logging.h"
+#include "core/metriccounter.h"
+#include "core/perftrace.h"
+#include "core/player.h"
+#include "core/taskmanager.h"
+#include "engines/gstengine.h"
+#include "networkremote/networkremote.h"
+
+const quint16 MetricsServer::kDefaultPort = 5501;
+
+namespace {
+
+// Requests bigger than this are dropped rather than buffered.
+const int kMaxRequestBytes = 8192;
+
+void Write(QTextStream* s, const char* name, const char* type,
+           const char* help, double value) {
+  *s << "# HELP " << name << " " << help << "\n"
+     << "# TYPE " << name << " " << type << "\n"
+     << name << " " << value << "\n";
+}
+
+// The process's resident set size, or -1 where that isn't available.
+qint64 ResidentBytes() {
+#ifdef Q_OS_LINUX
+  QFile statm("/proc/self/statm");
+  if (statm.open(QIODevice::ReadOnly)) {
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.count() > 1) {
+      return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+    }
+  }
+#endif
+  return -1;
+}
+
+}  // namespace
+
+MetricsServer::MetricsServer(Application* app, QObject* parent)
+    : QObject(parent), app_(app), only_non_public_ip_(true) {}
+
+MetricsServer::~MetricsServer() { Stop(); }
+
+void MetricsServer::Start(quint16 port, bool only_non_public_ip) {
+  Stop();
+  only_non_public_ip_ = only_non_public_ip;
+
+  server_.reset(new QTcpServer);
+  server_ipv6_.reset(new QTcpServer);
+  connect(server_.get(), SIGNAL(newConnection()), SLOT(AcceptConnection()));
+  connect(server_ipv6_.get(), SIGNAL(newConnection()),
+          SLOT(AcceptConnection()));
+
+  server_->setProxy(QNetworkProxy::NoProxy);
+  server_ipv6_->setProxy(QNetworkProxy::NoProxy);
+  server_->listen(QHostAddress::Any, port);
+  server_ipv6_->listen(QHostAddress::AnyIPv6, port);
+
+  qLog(Info) << "Serving metrics on port" << port;
+}
+
+void MetricsServer::Stop() {
+  server_.reset();
+  server_ipv6_.reset();
+}
+
+void MetricsServer::AcceptConnection() {
+  QTcpServer* server = qobject_cast<QTcpServer*>(sender());
+  QTcpSocket* socket = server->nextPendingConnection();
+  if (!socket) return;
+
+  connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+
+  if (only_non_public_ip_ &&
+      !NetworkRemote::IpIsPrivate(socket->peerAddress())) {
+    qLog(Info) << "Refused a metrics request from public ip"
+               << socket->peerAddress().toString();
+    socket->abort();
+    socket->deleteLater();
+    return;
+  }
+
+  connect(socket, SIGNAL(readyRead()), SLOT(ReadRequest()));
+}
+
+void MetricsServer::ReadRequest() {
+  QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+  if (!socket) return;
+
+  if (!socket->canReadLine()) {
+    if (socket->bytesAvailable() > kMaxRequestBytes) socket->abort();
+    return;
+  }
+
+  // Only the request line matters - the headers are ignored.
+  disconnect(socket, SIGNAL(readyRead()), this, SLOT(ReadRequest()));
+  const QList<QByteArray> request = socket->readLine().trimmed().split(' ');
+
+  QByteArray status;
+  QByteArray body;
+  if (request.count() >= 2 && request[0] == "GET" &&
+      (request[1] == "/metrics" || request[1] == "/")) {
+    status = "200 OK";
+    body = Metrics();
+  } else {
+    status = "404 Not Found";
+  }
+
+  socket->write("HTTP/1.0 " + status + "\r\n");
+  socket->write("Content-Type: text/plain; version=0.0.4\r\n");
+  socket->write("Content-Length: " + QByteArray::number(body.size()) +
+                "\r\n");
+  socket->write("Connection: close\r\n\r\n");
+  socket->write(body);
+  socket->disconnectFromHost();
+}
+
+QByteArray MetricsServer::Metrics() const {
+  QByteArray ret;
+  QTextStream s(&ret);
+  // Counters get big, and the default precision would round them.
+  s.setRealNumberPrecision(15);
+
+  Player* player = app_->player();
+  const Engine::State state = player->GetState();
+  Write(&s, "clementine_playing", "gauge", "1 if a track is playing.",
+        state == Engine::Playing);
+  Write(&s, "clementine_paused", "gauge", "1 if playback is paused.",
+        state == Engine::Paused);
+  Write(&s, "clementine_volume_percent", "gauge", "The player's volume.",
+        player->GetVolume());
+
+  GstEngine* engine = qobject_cast<GstEngine*>(player->engine());
+  if (engine) {
+    // These are all for the current track.
+    const EngineMetrics metrics = engine->current_metrics();
+    if (metrics.pipeline_id_ != -1) {
+      Write(&s, "clementine_engine_queue_fill_percent", "gauge",
+            "How full the buffering queue is.", metrics.queue_fill_percent_);
+      Write(&s, "clementine_engine_min_queue_fill_percent", "gauge",
+            "How full the buffering queue was at its emptiest.",
+            metrics.min_queue_fill_percent_);
+      Write(&s, "clementine_engine_underruns", "gauge",
+            "Times the current track stopped to rebuffer.",
+            metrics.underruns_);
+      Write(&s, "clementine_engine_stalled_seconds", "gauge",
+            "Time the current track has spent rebuffering.",
+            metrics.stalled_nanosec_ / 1e9);
+      Write(&s, "clementine_engine_network_bytes_per_second", "gauge",
+            "Network throughput of the current track.",
+            metrics.network_bytes_per_sec());
+    }
+  }
+
+  Write(&s, "clementine_tasks_running", "gauge",
+        "Background tasks in the task manager.",
+        app_->task_manager()->GetTasks().count());
+
+  for (const MetricCounter* counter : MetricCounter::All()) {
+    Write(&s, counter->name(), "counter", counter->help(), counter->value());
+  }
+
+  // The profiler's scopes are only there while it's recording.
+  const QList<PerfTrace::Stats> scopes = PerfTrace::GetStats();
+  if (!scopes.isEmpty()) {
+    s << "# HELP clementine_scope_calls Calls recorded by the profiler.\n"
+      << "# TYPE clementine_scope_calls gauge\n";
+    for (const PerfTrace::Stats& scope : scopes) {
+      s << "clementine_scope_calls{scope=\"" << scope.name_ << "\"} "
+        << scope.count_ << "\n";
+    }
+    s << "# HELP clementine_scope_mean_seconds Mean duration of each scope.\n"
+      << "# TYPE clementine_scope_mean_seconds gauge\n";
+    for (const PerfTrace::Stats& scope : scopes) {
+      s << "clementine_scope_mean_seconds{scope=\"" << scope.name_ << "\"} "
+        << scope.mean_nsec_ / 1e9 << "\n";
+    }
+    s << "# HELP clementine_scope_p99_seconds 99th percentile duration of "
+         "each scope.\n"
+      << "# TYPE clementine_scope_p99_seconds gauge\n";
+    for (const PerfTrace::Stats& scope : scopes) {
+      s << "clementine_scope_p99_seconds{scope=\"" << scope.name_ << "\"} "
+        << scope.p99_nsec_ / 1e9 << "\n";
+    }
+  }
+
+  const qint64 resident_bytes = ResidentBytes();
+  if (resident_bytes >= 0) {
+    Write(&s, "clementine_resident_memory_bytes", "gauge",
+          "Resident memory used by the whole process.", resident_bytes);
+  }
+
+  s.flush();
+  return ret;
+}
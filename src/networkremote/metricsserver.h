@@ -0,0 +1,56 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <memory>
+
+#include <QByteArray>
+#include <QObject>
+
+class Application;
+class QTcpServer;
+
+// Answers "GET /metrics" over HTTP with the Prometheus text format, so
+// monitoring can scrape playback, engine, task and cache statistics.  Off
+// unless it's switched on in the network remote settings.
+class MetricsServer : public QObject {
+  Q_OBJECT
+
+ public:
+  static const quint16 kDefaultPort;
+
+  explicit MetricsServer(Application* app, QObject* parent = nullptr);
+  ~MetricsServer();
+
+  void Start(quint16 port, bool only_non_public_ip);
+  void Stop();
+
+ private slots:
+  void AcceptConnection();
+  void ReadRequest();
+
+ private:
+  QByteArray Metrics() const;
+
+  Application* app_;
+  std::unique_ptr<QTcpServer> server_;
+  std::unique_ptr<QTcpServer> server_ipv6_;
+  bool only_non_public_ip_;
+};
+
+#endif  // METRICSSERVER_H
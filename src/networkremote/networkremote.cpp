@@ -26,6 +26,7 @@
 #include "core/logging.h"
 #include "covers/currentartloader.h"
 #include "networkremote/incomingdataparser.h"
+#include "networkremote/metricsserver.h"
 #include "networkremote/outgoingdatacreator.h"
 #include "networkremote/zeroconf.h"
 #include "playlist/playlistmanager.h"
@@ -51,6 +52,9 @@ void NetworkRemote::ReadSettings() {
   // Use only non public ips must be true be default
   only_non_public_ip_ = s.value("only_non_public_ip", true).toBool();
 
+  use_metrics_ = s.value("use_metrics", false).toBool();
+  metrics_port_ = s.value("metrics_port", MetricsServer::kDefaultPort).toInt();
+
   s.endGroup();
 }
 
@@ -59,6 +63,7 @@ void NetworkRemote::SetupServer() {
   server_ipv6_.reset(new QTcpServer());
   incoming_data_parser_.reset(new IncomingDataParser(app_));
   outgoing_data_creator_.reset(new OutgoingDataCreator(app_));
+  metrics_server_.reset(new MetricsServer(app_));
 
   outgoing_data_creator_->SetClients(&clients_);
 
@@ -81,6 +86,12 @@ void NetworkRemote::StartServer() {
   }
   // Check if user desires to start a network remote server
   ReadSettings();
+
+  // The metrics endpoint doesn't need the remote itself.
+  if (use_metrics_) {
+    metrics_server_->Start(metrics_port_, only_non_public_ip_);
+  }
+
   if (!use_remote_) {
     qLog(Info) << "Network Remote deactivated";
     return;
@@ -103,6 +114,8 @@ void NetworkRemote::StartServer() {
 }
 
 void NetworkRemote::StopServer() {
+  if (metrics_server_) metrics_server_->Stop();
+
   if (server_->isListening()) {
     outgoing_data_creator_.get()->DisconnectAllClients();
     server_->close();
@@ -166,6 +179,10 @@ void NetworkRemote::AcceptConnection() {
 
     connect(incoming_data_parser_.get(), SIGNAL(SendLibrary(RemoteClient*)),
             outgoing_data_creator_.get(), SLOT(SendLibrary(RemoteClient*)));
+    connect(incoming_data_parser_.get(),
+            SIGNAL(SendLibraryDelta(RemoteClient*, int, bool)),
+            outgoing_data_creator_.get(),
+            SLOT(SendLibraryDelta(RemoteClient*, int, bool)));
 
     connect(incoming_data_parser_.get(),
             SIGNAL(DoGlobalSearch(QString, RemoteClient*)),
@@ -8,6 +8,7 @@
 
 class Application;
 class IncomingDataParser;
+class MetricsServer;
 class OutgoingDataCreator;
 class QHostAddress;
 class QImage;
@@ -25,6 +26,8 @@ class NetworkRemote : public QObject {
   explicit NetworkRemote(Application* app, QObject* parent = nullptr);
   ~NetworkRemote();
 
+  static bool IpIsPrivate(const QHostAddress& address);
+
  public slots:
   void SetupServer();
   void StartServer();
@@ -38,10 +41,13 @@ class NetworkRemote : public QObject {
   std::unique_ptr<QTcpServer> server_ipv6_;
   std::unique_ptr<IncomingDataParser> incoming_data_parser_;
   std::unique_ptr<OutgoingDataCreator> outgoing_data_creator_;
+  std::unique_ptr<MetricsServer> metrics_server_;
 
   quint16 port_;
   bool use_remote_;
   bool only_non_public_ip_;
+  bool use_metrics_;
+  quint16 metrics_port_;
   bool signals_connected_;
   Application* app_;
 
@@ -50,7 +56,6 @@ class NetworkRemote : public QObject {
   void StopServer();
   void ReadSettings();
   void CreateRemoteClient(QTcpSocket* client_socket);
-  bool IpIsPrivate(const QHostAddress& address);
 };
 
 #endif  // NETWORKREMOTE_H
@@ -17,6 +17,8 @@
 
 #include "networkremote/networkremotehelper.h"
 
+#include <QSettings>
+
 #include "core/application.h"
 #include "core/logging.h"
 #include "networkremote/networkremote.h"
@@ -24,15 +26,8 @@
 
 NetworkRemoteHelper* NetworkRemoteHelper::sInstance = nullptr;
 
-NetworkRemoteHelper::NetworkRemoteHelper(Application* app) : app_(app) {
-  app_ = app;
-  connect(this, SIGNAL(ReloadSettingsSig()), app_->network_remote(),
-          SLOT(ReloadSettings()));
-  connect(this, SIGNAL(StartServerSig()), app_->network_remote(),
-          SLOT(StartServer()));
-  connect(this, SIGNAL(SetupServerSig()), app_->network_remote(),
-          SLOT(SetupServer()));
-
+NetworkRemoteHelper::NetworkRemoteHelper(Application* app)
+    : app_(app), remote_created_(false) {
   // Start the server once the playlistmanager is initialized
   connect(app_->playlist_manager(), SIGNAL(PlaylistManagerInitialized()), this,
           SLOT(StartServer()));
@@ -42,12 +37,45 @@ NetworkRemoteHelper::NetworkRemoteHelper(Application* app) : app_(app) {
 
 NetworkRemoteHelper::~NetworkRemoteHelper() {}
 
-void NetworkRemoteHelper::StartServer() {
+void NetworkRemoteHelper::CreateRemote() {
+  if (remote_created_) return;
+  remote_created_ = true;
+
+  connect(this, SIGNAL(ReloadSettingsSig()), app_->network_remote(),
+          SLOT(ReloadSettings()));
+  connect(this, SIGNAL(StartServerSig()), app_->network_remote(),
+          SLOT(StartServer()));
+  connect(this, SIGNAL(SetupServerSig()), app_->network_remote(),
+          SLOT(SetupServer()));
+  connect(this, SIGNAL(EnableKittensSig(bool)), app_->network_remote(),
+          SLOT(EnableKittens(bool)));
+
   emit SetupServerSig();
+}
+
+void NetworkRemoteHelper::StartServer() {
+  QSettings s;
+  s.beginGroup(NetworkRemote::kSettingsGroup);
+  if (!s.value("use_remote", false).toBool()) {
+    qLog(Info) << "Network Remote deactivated";
+    return;
+  }
+
+  CreateRemote();
   emit StartServerSig();
 }
 
-void NetworkRemoteHelper::ReloadSettings() { emit ReloadSettingsSig(); }
+void NetworkRemoteHelper::ReloadSettings() {
+  if (!remote_created_) {
+    StartServer();
+    return;
+  }
+  emit ReloadSettingsSig();
+}
+
+void NetworkRemoteHelper::EnableKittens(bool aww) {
+  if (remote_created_) emit EnableKittensSig(aww);
+}
 
 // For using in Settingsdialog, we haven't the application there
 NetworkRemoteHelper* NetworkRemoteHelper::Instance() {
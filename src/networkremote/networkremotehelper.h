@@ -15,6 +15,10 @@ class NetworkRemoteHelper : public QObject {
 
   void ReloadSettings();
 
+ public slots:
+  // Forwarded to the remote only if it's been created.
+  void EnableKittens(bool aww);
+
  private slots:
   void StartServer();
 
@@ -22,10 +26,16 @@ signals:
   void SetupServerSig();
   void StartServerSig();
   void ReloadSettingsSig();
+  void EnableKittensSig(bool aww);
 
  private:
+  // The remote, and everything its server hooks into, is only created the
+  // first time it's enabled.
+  void CreateRemote();
+
   static NetworkRemoteHelper* sInstance;
   Application* app_;
+  bool remote_created_;
 };
 
 #endif  // NETWORKREMOTEHELPER_H
@@ -23,18 +23,41 @@
 #include "core/logging.h"
 #include "core/timeconstants.h"
 #include "core/utilities.h"
+#include "engines/positionclock.h"
 #include "globalsearch/librarysearchprovider.h"
 #include "library/librarybackend.h"
 #include "ui/iconloader.h"
 
+#include <QDataStream>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include "core/database.h"
 
 const quint32 OutgoingDataCreator::kFileChunkSize = 100000;  // in Bytes
+const int OutgoingDataCreator::kTrackPositionUpdateMsec = 1000;
+const int OutgoingDataCreator::kLibraryRowsPerMessage = 1000;
+const QStringList OutgoingDataCreator::kLibraryColumns = QStringList()
+    << "title"
+    << "album"
+    << "artist"
+    << "albumartist"
+    << "track"
+    << "disc"
+    << "year"
+    << "genre"
+    << "filename"
+    << "filesize"
+    << "filetype"
+    << "playcount"
+    << "rating"
+    << "art_automatic"
+    << "art_manual"
+    << "beginning"
+    << "length";
 
 OutgoingDataCreator::OutgoingDataCreator(Application* app)
     : app_(app),
+      current_metadata_row_(-1),
       aww_(false),
       ultimate_reader_(new UltimateLyricsReader(this)),
       fetcher_(new SongInfoFetcher(this)) {
@@ -52,17 +75,13 @@ void OutgoingDataCreator::SetClients(QList<RemoteClient*>* clients) {
   // Default: every 10 seconds
   keep_alive_timer_->start(keep_alive_timeout_);
 
-  // Create the song position timer
-  track_position_timer_ = new QTimer(this);
-  connect(track_position_timer_, SIGNAL(timeout()), this,
-          SLOT(UpdateTrackPosition()));
-
   // Parse the ultimate lyrics xml file
   ultimate_reader_->SetThread(this->thread());
   ProviderList provider_list =
     ultimate_reader_->Parse(":lyrics/ultimate_providers.xml");
 
   // Set up the lyrics parser
+  fetcher_->set_race_lyrics(true);
   connect(fetcher_, SIGNAL(ResultReady(int, SongInfoFetcher::Result)),
           SLOT(SendLyrics(int, SongInfoFetcher::Result)));
 
@@ -151,6 +170,11 @@ void OutgoingDataCreator::SendDataToClients(pb::remote::Message* msg) {
     return;
   }
 
+  SendSerializedDataToClients(msg->type(), RemoteClient::Serialize(msg));
+}
+
+void OutgoingDataCreator::SendSerializedDataToClients(
+    pb::remote::MsgType type, const QByteArray& data) {
   for (RemoteClient* client : *clients_) {
     // Do not send data to downloaders
     if (client->isDownloader()) {
@@ -163,7 +187,7 @@ void OutgoingDataCreator::SendDataToClients(pb::remote::Message* msg) {
 
     // Check if the client is still active
     if (client->State() == QTcpSocket::ConnectedState) {
-      client->SendData(msg);
+      client->SendSerializedData(type, data);
     } else {
       clients_->removeAt(clients_->indexOf(client));
       delete client;
@@ -222,7 +246,7 @@ void OutgoingDataCreator::SendAllPlaylists() {
   for (const PlaylistBackend::Playlist& p :
        app_->playlist_backend()->GetAllPlaylists()) {
     bool playlist_open = app_->playlist_manager()->IsPlaylistOpen(p.id);
-    int item_count = playlist_open ? app_playlists.at(p.id)->rowCount() : 0;
+    int item_count = playlist_open ? app_playlists.at(p.id)->item_count() : 0;
 
     // Create a new playlist
     pb::remote::Playlist* playlist = playlists->add_playlist();
@@ -258,7 +282,7 @@ void OutgoingDataCreator::SendAllActivePlaylists() {
     playlist->set_name(DataCommaSizeFromQString(playlist_name));
     playlist->set_id(p->id());
     playlist->set_active((p->id() == active_playlist));
-    playlist->set_item_count(p->rowCount());
+    playlist->set_item_count(p->item_count());
     playlist->set_closed(false);
   }
 
@@ -281,9 +305,15 @@ void OutgoingDataCreator::PlaylistAdded(int id, const QString& name,
   SendAllActivePlaylists();
 }
 
-void OutgoingDataCreator::PlaylistDeleted(int id) { SendAllActivePlaylists(); }
+void OutgoingDataCreator::PlaylistDeleted(int id) {
+  sent_playlists_.remove(id);
+  SendAllActivePlaylists();
+}
 
-void OutgoingDataCreator::PlaylistClosed(int id) { SendAllActivePlaylists(); }
+void OutgoingDataCreator::PlaylistClosed(int id) {
+  sent_playlists_.remove(id);
+  SendAllActivePlaylists();
+}
 
 void OutgoingDataCreator::PlaylistRenamed(int id, const QString& new_name) {
   SendAllActivePlaylists();
@@ -296,19 +326,15 @@ void OutgoingDataCreator::SendFirstData(bool send_playlist_songs) {
     qLog(Info) << "No current item found!";
   }
 
-  CurrentSongChanged(current_song_, current_uri_, current_image_);
+  SendSongMetadata();
 
   // then the current volume
   VolumeChanged(app_->player()->GetVolume());
 
-  // Check if we need to start the track position timer
-  if (!track_position_timer_->isActive() &&
-      app_->player()->engine()->state() == Engine::Playing) {
-    track_position_timer_->start(1000);
-  }
-
-  // And the current track position
-  UpdateTrackPosition();
+  // And the current track position, and then every second while playing.
+  PositionClock* clock = app_->player()->engine()->position_clock();
+  clock->Subscribe(this, "UpdateTrackPosition", kTrackPositionUpdateMsec);
+  UpdateTrackPosition(clock->position_nanosec());
 
   // And the current playlists
   SendAllActivePlaylists();
@@ -337,21 +363,31 @@ void OutgoingDataCreator::CurrentSongChanged(const Song& song,
   if (!aww_) {
     current_image_ = img;
   }
+  current_metadata_data_.clear();
 
   SendSongMetadata();
 }
 
 void OutgoingDataCreator::SendSongMetadata() {
-  // Create the message
-  pb::remote::Message msg;
-  msg.set_type(pb::remote::CURRENT_METAINFO);
+  if (clients_->empty()) return;
 
-  // If there is no song, create an empty node, otherwise fill it with data
-  int i = app_->playlist_manager()->active()->current_row();
-  CreateSong(current_song_, current_image_, i,
-             msg.mutable_response_current_metadata()->mutable_song_metadata());
+  const int i = app_->playlist_manager()->active()->current_row();
+  if (current_metadata_data_.isEmpty() || current_metadata_row_ != i) {
+    // Create the message
+    pb::remote::Message msg;
+    msg.set_type(pb::remote::CURRENT_METAINFO);
 
-  SendDataToClients(&msg);
+    // If there is no song, create an empty node, otherwise fill it with data
+    CreateSong(
+        current_song_, current_image_, i,
+        msg.mutable_response_current_metadata()->mutable_song_metadata());
+
+    current_metadata_data_ = RemoteClient::Serialize(&msg);
+    current_metadata_row_ = i;
+  }
+
+  SendSerializedDataToClients(pb::remote::CURRENT_METAINFO,
+                              current_metadata_data_);
 }
 
 void OutgoingDataCreator::CreateSong(const Song& song, const QImage& art,
@@ -422,13 +458,27 @@ void OutgoingDataCreator::SendPlaylistSongs(int id) {
     return;
   }
 
-  // Create the message and the playlist
+  // Everyone gets the whole playlist, so start a new version of it
+  SentPlaylist& sent = sent_playlists_[id];
+  sent.version_++;
+  sent.items_ = playlist->GetAllItems();
+
   pb::remote::Message msg;
-  msg.set_type(pb::remote::PLAYLIST_SONGS);
+  CreatePlaylistSongs(id, sent.items_, sent.version_, &msg);
+  SendDataToClients(&msg);
+}
+
+void OutgoingDataCreator::CreatePlaylistSongs(int id,
+                                              const PlaylistItemList& items,
+                                              int version,
+                                              pb::remote::Message* msg) {
+  // Create the message and the playlist
+  msg->set_type(pb::remote::PLAYLIST_SONGS);
 
   // Create the Response message
   pb::remote::ResponsePlaylistSongs* pb_response_playlist_songs =
-      msg.mutable_response_playlist_songs();
+      msg->mutable_response_playlist_songs();
+  pb_response_playlist_songs->set_version(version);
 
   // Create a new playlist
   pb::remote::Playlist* pb_playlist =
@@ -436,22 +486,143 @@ void OutgoingDataCreator::SendPlaylistSongs(int id) {
   pb_playlist->set_id(id);
 
   // Send all songs
+  pb_response_playlist_songs->mutable_songs()->Reserve(items.count());
   int index = 0;
-  SongList song_list = playlist->GetAllSongs();
-  QListIterator<Song> it(song_list);
   QImage null_img;
-  while (it.hasNext()) {
-    Song song = it.next();
+  for (PlaylistItemPtr item : items) {
     pb::remote::SongMetadata* pb_song = pb_response_playlist_songs->add_songs();
-    CreateSong(song, null_img, index, pb_song);
+    CreateSong(item->Metadata(), null_img, index, pb_song);
     ++index;
   }
-  SendDataToClients(&msg);
 }
 
 void OutgoingDataCreator::PlaylistChanged(Playlist* playlist) {
-  // If a playlist changed, then send the new songs to the client
-  SendPlaylistSongs(playlist->id());
+  // If the clients haven't seen this playlist yet they need all of it
+  const int id = playlist->id();
+  if (!sent_playlists_.contains(id)) {
+    SendPlaylistSongs(id);
+    return;
+  }
+
+  SentPlaylist& sent = sent_playlists_[id];
+  const PlaylistItemList items = playlist->GetAllItems();
+
+  pb::remote::Message delta_msg;
+  delta_msg.set_type(pb::remote::PLAYLIST_SONGS_DELTA);
+  pb::remote::ResponsePlaylistSongsDelta* delta =
+      delta_msg.mutable_response_playlist_songs_delta();
+  if (!CreatePlaylistDelta(sent.items_, items, delta)) {
+    SendPlaylistSongs(id);
+    return;
+  }
+  if (delta->changes_size() == 0) return;
+
+  delta->set_playlist_id(id);
+  delta->set_base_version(sent.version_);
+  sent.version_++;
+  sent.items_ = items;
+  delta->set_version(sent.version_);
+
+  // Older clients only understand whole playlists.  Only build one of those
+  // if someone needs it.  Each message is serialized once for everyone.
+  QByteArray delta_data;
+  QByteArray full_data;
+  for (RemoteClient* client : *clients_) {
+    if (client->isDownloader() ||
+        client->State() != QTcpSocket::ConnectedState) {
+      continue;
+    }
+
+    if (client->wantsPlaylistDeltas()) {
+      if (delta_data.isEmpty()) {
+        delta_data = RemoteClient::Serialize(&delta_msg);
+      }
+      client->SendSerializedData(pb::remote::PLAYLIST_SONGS_DELTA,
+                                 delta_data);
+    } else {
+      if (full_data.isEmpty()) {
+        pb::remote::Message full_msg;
+        CreatePlaylistSongs(id, items, sent.version_, &full_msg);
+        full_data = RemoteClient::Serialize(&full_msg);
+      }
+      client->SendSerializedData(pb::remote::PLAYLIST_SONGS, full_data);
+    }
+  }
+}
+
+bool OutgoingDataCreator::CreatePlaylistDelta(
+    const PlaylistItemList& old_items, const PlaylistItemList& new_items,
+    pb::remote::ResponsePlaylistSongsDelta* delta) {
+  // Find the part in the middle that changed
+  const int old_count = old_items.count();
+  const int new_count = new_items.count();
+
+  int prefix = 0;
+  while (prefix < old_count && prefix < new_count &&
+         old_items[prefix] == new_items[prefix]) {
+    ++prefix;
+  }
+
+  int suffix = 0;
+  while (suffix < old_count - prefix && suffix < new_count - prefix &&
+         old_items[old_count - 1 - suffix] == new_items[new_count - 1 - suffix]) {
+    ++suffix;
+  }
+
+  const int removed = old_count - prefix - suffix;
+  const int inserted = new_count - prefix - suffix;
+  if (removed == 0 && inserted == 0) return true;
+
+  // A block of songs dragged somewhere else leaves the same songs rotated
+  if (removed == inserted && removed > 1) {
+    const int rotation =
+        old_items.mid(prefix, removed).indexOf(new_items[prefix]);
+    bool is_rotation = rotation > 0;
+    for (int i = 0; is_rotation && i < removed; ++i) {
+      is_rotation = new_items[prefix + i] ==
+                    old_items[prefix + (rotation + i) % removed];
+    }
+
+    if (is_rotation) {
+      // Describe whichever of the two blocks is smaller as the one that moved
+      pb::remote::PlaylistChange* change = delta->add_changes();
+      change->set_type(pb::remote::PlaylistChange::MOVE);
+      if (rotation <= removed - rotation) {
+        change->set_position(prefix);
+        change->set_count(rotation);
+        change->set_destination(prefix + removed - rotation);
+      } else {
+        change->set_position(prefix + rotation);
+        change->set_count(removed - rotation);
+        change->set_destination(prefix);
+      }
+      return true;
+    }
+  }
+
+  // Past this point the delta is most of the playlist anyway
+  if (inserted > new_count / 2) return false;
+
+  if (removed > 0) {
+    pb::remote::PlaylistChange* change = delta->add_changes();
+    change->set_type(pb::remote::PlaylistChange::REMOVE);
+    change->set_position(prefix);
+    change->set_count(removed);
+  }
+
+  if (inserted > 0) {
+    pb::remote::PlaylistChange* change = delta->add_changes();
+    change->set_type(pb::remote::PlaylistChange::INSERT);
+    change->set_position(prefix);
+
+    QImage null_img;
+    for (int i = 0; i < inserted; ++i) {
+      CreateSong(new_items[prefix + i]->Metadata(), null_img, prefix + i,
+                 change->add_songs());
+    }
+  }
+
+  return true;
 }
 
 void OutgoingDataCreator::StateChanged(Engine::State state) {
@@ -468,19 +639,15 @@ void OutgoingDataCreator::StateChanged(Engine::State state) {
   switch (state) {
     case Engine::Playing:
       msg.set_type(pb::remote::PLAY);
-      track_position_timer_->start(1000);
       break;
     case Engine::Paused:
       msg.set_type(pb::remote::PAUSE);
-      track_position_timer_->stop();
       break;
     case Engine::Empty:
       msg.set_type(pb::remote::STOP);  // Empty is called when player stopped
-      track_position_timer_->stop();
       break;
     default:
       msg.set_type(pb::remote::STOP);
-      track_position_timer_->stop();
       break;
   };
 
@@ -543,15 +710,20 @@ void OutgoingDataCreator::SendKeepAlive() {
   SendDataToClients(&msg);
 }
 
-void OutgoingDataCreator::UpdateTrackPosition() {
+void OutgoingDataCreator::UpdateTrackPosition(qint64 position_nanosec) {
+  if (clients_->isEmpty()) {
+    // Nobody's listening, so stop waking up until the next one connects.
+    app_->player()->engine()->position_clock()->Unsubscribe(
+        this, "UpdateTrackPosition");
+    return;
+  }
+
   pb::remote::Message msg;
   msg.set_type(pb::remote::UPDATE_TRACK_POSITION);
 
-  int position = std::floor(
-      float(app_->player()->engine()->position_nanosec()) / kNsecPerSec + 0.5);
+  int position = std::floor(float(position_nanosec) / kNsecPerSec + 0.5);
 
-  if (app_->player()->engine()->position_nanosec() >
-      current_song_.length_nanosec())
+  if (position_nanosec > current_song_.length_nanosec())
     position = last_track_position_;
 
   msg.mutable_response_update_track_position()->set_position(position);
@@ -659,11 +831,118 @@ void OutgoingDataCreator::SendLibrary(RemoteClient* client) {
   file.remove();
 }
 
+void OutgoingDataCreator::SendLibraryDelta(RemoteClient* client, int version,
+                                           bool replicate) {
+  QSqlDatabase db(app_->database()->Connect());
+
+  // Read the version before the songs.  Anything that changes while we're
+  // reading them is sent again next time, which is harmless.
+  QSqlQuery version_query("SELECT version FROM library_export_version", db);
+  if (app_->database()->CheckErrors(version_query) || !version_query.next()) {
+    return;
+  }
+  const int current_version = version_query.value(0).toInt();
+
+  // The client's copy came from a different database
+  if (version > current_version) version = 0;
+
+  pb::remote::Message msg;
+  msg.set_type(pb::remote::LIBRARY_DELTA);
+  pb::remote::ResponseLibraryDelta* delta = msg.mutable_response_library_delta();
+  delta->set_base_version(version);
+  delta->set_version(current_version);
+
+  pb::remote::LibraryRows rows;
+  QImage null_img;
+
+  // The songs are sent straight from the query as they're read
+  const QStringList columns = replicate ? Song::kColumns : kLibraryColumns;
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  if (version == 0) {
+    q.prepare("SELECT ROWID, " + columns.join(", ") +
+              " FROM songs WHERE unavailable = 0");
+  } else {
+    q.prepare("SELECT songs.ROWID, " +
+              Utilities::Prepend("songs.", columns).join(", ") +
+              " FROM songs"
+              " JOIN songs_export_log ON songs.ROWID = songs_export_log.song_id"
+              " WHERE songs_export_log.version > :version"
+              "   AND songs.unavailable = 0");
+    q.bindValue(":version", version);
+  }
+  q.exec();
+  if (app_->database()->CheckErrors(q)) return;
+
+  while (q.next()) {
+    if (replicate) {
+      QVector<QVariant> row(columns.count() + 1);
+      for (int i = 0; i < row.count(); ++i) row[i] = q.value(i);
+
+      QByteArray data;
+      QDataStream s(&data, QIODevice::WriteOnly);
+      s.setVersion(QDataStream::Qt_5_0);
+      s << row;
+      rows.add_song_rows(data.constData(), data.size());
+    } else {
+      Song song;
+      song.InitFromQueryColumns(q, kLibraryColumns, true);
+      CreateSong(song, null_img, 0, rows.add_songs());
+    }
+
+    if (rows.songs_size() + rows.song_rows_size() >= kLibraryRowsPerMessage) {
+      SendLibraryRows(client, &msg, &rows, false);
+    }
+  }
+
+  if (version != 0) {
+    // Songs that were deleted, or that went missing from disk
+    QSqlQuery deleted(db);
+    deleted.setForwardOnly(true);
+    deleted.prepare(
+        "SELECT songs_export_log.song_id FROM songs_export_log"
+        " LEFT JOIN songs ON songs.ROWID = songs_export_log.song_id"
+        " WHERE songs_export_log.version > :version"
+        "   AND (songs_export_log.deleted = 1 OR songs.unavailable = 1)");
+    deleted.bindValue(":version", version);
+    deleted.exec();
+    if (app_->database()->CheckErrors(deleted)) return;
+
+    while (deleted.next()) {
+      rows.add_deleted_ids(deleted.value(0).toInt());
+
+      if (rows.deleted_ids_size() >= kLibraryRowsPerMessage) {
+        SendLibraryRows(client, &msg, &rows, false);
+      }
+    }
+  }
+
+  SendLibraryRows(client, &msg, &rows, true);
+}
+
+void OutgoingDataCreator::SendLibraryRows(RemoteClient* client,
+                                          pb::remote::Message* msg,
+                                          pb::remote::LibraryRows* rows,
+                                          bool last) {
+  const std::string data = rows->SerializeAsString();
+  const QByteArray compressed =
+      qCompress(QByteArray::fromRawData(data.data(), data.size()));
+
+  pb::remote::ResponseLibraryDelta* delta =
+      msg->mutable_response_library_delta();
+  delta->set_rows(compressed.constData(), compressed.size());
+  delta->set_last(last);
+  client->SendData(msg);
+
+  rows->Clear();
+}
+
 void OutgoingDataCreator::EnableKittens(bool aww) { aww_ = aww; }
 
 void OutgoingDataCreator::SendKitten(const QImage& kitten) {
   if (aww_) {
     current_image_ = kitten;
+    current_metadata_data_.clear();
     SendSongMetadata();
   }
 }
@@ -47,12 +47,23 @@ class OutgoingDataCreator : public QObject {
   ~OutgoingDataCreator();
 
   static const quint32 kFileChunkSize;
+  static const int kTrackPositionUpdateMsec;
+  static const int kLibraryRowsPerMessage;
+  // The song fields CreateSong sends, so the library sync doesn't read
+  // lyrics, comments and the rest for every song.
+  static const QStringList kLibraryColumns;
 
   void SetClients(QList<RemoteClient*>* clients);
 
   static void CreateSong(const Song& song, const QImage& art, const int index,
                   pb::remote::SongMetadata* song_metadata);
 
+  // Fills delta with the changes that turn old_items into new_items.  Returns
+  // false if it would be cheaper to send the whole playlist again.
+  static bool CreatePlaylistDelta(const PlaylistItemList& old_items,
+                                  const PlaylistItemList& new_items,
+                                  pb::remote::ResponsePlaylistSongsDelta* delta);
+
  public slots:
   void SendClementineInfo();
   void SendAllPlaylists();
@@ -73,11 +84,13 @@ class OutgoingDataCreator : public QObject {
   void SendKeepAlive();
   void SendRepeatMode(PlaylistSequence::RepeatMode mode);
   void SendShuffleMode(PlaylistSequence::ShuffleMode mode);
-  void UpdateTrackPosition();
+  void UpdateTrackPosition(qint64 position_nanosec);
   void DisconnectAllClients();
   void GetLyrics();
   void SendLyrics(int id, const SongInfoFetcher::Result& result);
   void SendLibrary(RemoteClient* client);
+  // With replicate the rows carry every column, for LibraryReplica.
+  void SendLibraryDelta(RemoteClient* client, int version, bool replicate);
   void EnableKittens(bool aww);
   void SendKitten(const QImage& kitten);
 
@@ -91,9 +104,12 @@ class OutgoingDataCreator : public QObject {
   Song current_song_;
   QString current_uri_;
   QImage current_image_;
+  // The last CURRENT_METAINFO message, serialized, and the row it was for, so
+  // the cover isn't encoded again every time a client connects.
+  QByteArray current_metadata_data_;
+  int current_metadata_row_;
   Engine::State last_state_;
   QTimer* keep_alive_timer_;
-  QTimer* track_position_timer_;
   int keep_alive_timeout_;
   int last_track_position_;
   bool aww_;
@@ -104,7 +120,25 @@ class OutgoingDataCreator : public QObject {
 
   QMap<int, GlobalSearchRequest> global_search_result_map_;
 
+  // The songs the clients were last sent for each playlist, so changes to it
+  // can be sent as deltas.
+  struct SentPlaylist {
+    SentPlaylist() : version_(0) {}
+
+    int version_;
+    PlaylistItemList items_;
+  };
+  QMap<int, SentPlaylist> sent_playlists_;
+
+  // Serializes msg once and sends it to every client that isn't downloading.
   void SendDataToClients(pb::remote::Message* msg);
+  void SendSerializedDataToClients(pb::remote::MsgType type,
+                                   const QByteArray& data);
+  // Compresses rows into msg, sends it to the client and clears rows.
+  void SendLibraryRows(RemoteClient* client, pb::remote::Message* msg,
+                       pb::remote::LibraryRows* rows, bool last);
+  void CreatePlaylistSongs(int id, const PlaylistItemList& items, int version,
+                           pb::remote::Message* msg);
   void SetEngineState(pb::remote::ResponseClementineInfo* msg);
   void CheckEnabledProviders();
   SongInfoProvider* ProviderByName(const QString& name) const;
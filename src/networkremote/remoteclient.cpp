@@ -23,11 +23,16 @@
 #include <QDataStream>
 #include <QSettings>
 
+const qint64 RemoteClient::kMaxBytesPending = 256 * 1024;
+const qint64 RemoteClient::kMaxBulkBytesQueued = 1024 * 1024;
+
 RemoteClient::RemoteClient(Application* app, QTcpSocket* client)
     : app_(app),
       downloader_(false),
+      playlist_deltas_(false),
       client_(client),
-      song_sender_(new SongSender(app, this)) {
+      song_sender_(new SongSender(app, this)),
+      bulk_bytes_queued_(0) {
   // Open the buffer
   buffer_.setData(QByteArray());
   buffer_.open(QIODevice::ReadWrite);
@@ -35,6 +40,9 @@ RemoteClient::RemoteClient(Application* app, QTcpSocket* client)
 
   // Connect to the slot IncomingData when receiving data
   connect(client, SIGNAL(readyRead()), this, SLOT(IncomingData()));
+  connect(client, SIGNAL(bytesWritten(qint64)), SLOT(SocketBytesWritten()));
+  connect(this, SIGNAL(ReadyForBulkData()), song_sender_,
+          SLOT(SendFileChunks()));
 
   // Check if we use auth code
   QSettings s;
@@ -61,6 +69,10 @@ RemoteClient::~RemoteClient() {
 
 void RemoteClient::setDownloader(bool downloader) { downloader_ = downloader; }
 
+void RemoteClient::setPlaylistDeltas(bool playlist_deltas) {
+  playlist_deltas_ = playlist_deltas;
+}
+
 void RemoteClient::IncomingData() {
   while (client_->bytesAvailable()) {
     if (!reading_protobuf_) {
@@ -119,6 +131,7 @@ void RemoteClient::ParseMessage(const QByteArray& data) {
 
   if (msg.type() == pb::remote::CONNECT) {
     setDownloader(msg.request_connect().downloader());
+    setPlaylistDeltas(msg.request_connect().playlist_deltas());
     qDebug() << "Downloader" << downloader_;
   }
 
@@ -149,7 +162,14 @@ void RemoteClient::DisconnectClient(pb::remote::ReasonDisconnect reason) {
   msg.set_type(pb::remote::DISCONNECT);
 
   msg.mutable_response_disconnect()->set_reason_disconnect(reason);
-  SendDataToClient(&msg);
+
+  // Nothing else is going to be sent, so skip the queue
+  queue_.clear();
+  bulk_queue_.clear();
+  bulk_bytes_queued_ = 0;
+  if (client_->state() == QTcpSocket::ConnectedState) {
+    client_->write(Serialize(&msg));
+  }
 
   // Just close the connection. The next time the outgoing data creator
   // sends a keep alive, the client will be deleted
@@ -157,38 +177,143 @@ void RemoteClient::DisconnectClient(pb::remote::ReasonDisconnect reason) {
 }
 
 // Sends data to client without check if authenticated
-void RemoteClient::SendDataToClient(pb::remote::Message* msg) {
+void RemoteClient::SendDataToClient(pb::remote::MsgType type,
+                                    const QByteArray& data) {
+  // Check if we are still connected
+  if (client_->state() != QTcpSocket::ConnectedState) {
+    qDebug() << "Closed";
+    client_->close();
+    return;
+  }
+
+  if (IsBulkMessage(type)) {
+    bulk_queue_.enqueue(data);
+    bulk_bytes_queued_ += data.size();
+  } else {
+    bool replaced = false;
+    if (IsStateMessage(type)) {
+      for (QueuedMessage& queued : queue_) {
+        if (queued.type_ == type) {
+          queued.data_ = data;
+          replaced = true;
+          break;
+        }
+      }
+    }
+
+    if (!replaced) {
+      QueuedMessage queued;
+      queued.type_ = type;
+      queued.data_ = data;
+      queue_ << queued;
+    }
+  }
+
+  WriteQueuedData();
+}
+
+QByteArray RemoteClient::Serialize(pb::remote::Message* msg) {
   // Set the default version
   msg->set_version(msg->default_instance().version());
 
-  // Check if we are still connected
-  if (client_->state() == QTcpSocket::ConnectedState) {
-    // Serialize the message
-    std::string data = msg->SerializeAsString();
-
-    // write the length of the data first
-    QDataStream s(client_);
-    s << qint32(data.length());
-    if (downloader_) {
-      // Don't use QDataSteam for large files
-      client_->write(data.data(), data.length());
+  // Serialize the message
+  std::string data = msg->SerializeAsString();
+
+  // The length of the data goes first
+  QByteArray ret;
+  ret.reserve(data.length() + sizeof(qint32));
+  QDataStream s(&ret, QIODevice::WriteOnly);
+  s << qint32(data.length());
+  s.writeRawData(data.data(), data.length());
+  return ret;
+}
+
+void RemoteClient::WriteQueuedData() {
+  while (client_->state() == QTcpSocket::ConnectedState &&
+         client_->bytesToWrite() < kMaxBytesPending) {
+    if (!queue_.isEmpty()) {
+      client_->write(queue_.takeFirst().data_);
+    } else if (!bulk_queue_.isEmpty()) {
+      const QByteArray data = bulk_queue_.dequeue();
+      bulk_bytes_queued_ -= data.size();
+      client_->write(data);
     } else {
-      s.writeRawData(data.data(), data.length());
+      break;
     }
 
     // Do NOT flush data here! If the client is already disconnected, it
     // causes a SIGPIPE termination!!!
-  } else {
-    qDebug() << "Closed";
-    client_->close();
+  }
+}
+
+void RemoteClient::SocketBytesWritten() {
+  WriteQueuedData();
+
+  // Only signal from here, never from inside SendData, so producers aren't
+  // re-entered while they're sending.
+  if (CanSendBulkData()) emit ReadyForBulkData();
+}
+
+bool RemoteClient::IsStateMessage(pb::remote::MsgType type) {
+  switch (type) {
+    case pb::remote::UPDATE_TRACK_POSITION:
+    case pb::remote::SET_VOLUME:
+    case pb::remote::CURRENT_METAINFO:
+    case pb::remote::ENGINE_STATE_CHANGED:
+    case pb::remote::REPEAT:
+    case pb::remote::SHUFFLE:
+    case pb::remote::KEEP_ALIVE:
+    case pb::remote::TRANSCODING_FILES:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool RemoteClient::IsBulkMessage(pb::remote::MsgType type) {
+  switch (type) {
+    // The download messages have to stay in order with the file chunks
+    case pb::remote::SONG_FILE_CHUNK:
+    case pb::remote::DOWNLOAD_TOTAL_SIZE:
+    case pb::remote::DOWNLOAD_QUEUE_EMPTY:
+    case pb::remote::LIBRARY_CHUNK:
+    case pb::remote::LIBRARY_DELTA:
+      return true;
+    default:
+      return false;
   }
 }
 
 void RemoteClient::SendData(pb::remote::Message* msg) {
   // Check if client is authenticated before sending the data
   if (authenticated_) {
-    SendDataToClient(msg);
+    SendDataToClient(msg->type(), Serialize(msg));
   }
 }
 
+void RemoteClient::SendSerializedData(pb::remote::MsgType type,
+                                      const QByteArray& data) {
+  if (authenticated_) {
+    SendDataToClient(type, data);
+  }
+}
+
+void RemoteClient::SendDataWithPayload(pb::remote::Message* msg,
+                                       const QByteArray& payload) {
+  if (!authenticated_) return;
+
+  if (client_->state() != QTcpSocket::ConnectedState) {
+    client_->close();
+    return;
+  }
+
+  // The payload is shared, not copied, until it's written to the socket
+  const QByteArray header = Serialize(msg);
+  bulk_queue_.enqueue(header);
+  bulk_queue_.enqueue(payload);
+  bulk_bytes_queued_ += header.size() + payload.size();
+
+  WriteQueuedData();
+}
+
 QAbstractSocket::SocketState RemoteClient::State() { return client_->state(); }
@@ -4,6 +4,8 @@
 #include <QAbstractSocket>
 #include <QTcpSocket>
 #include <QBuffer>
+#include <QList>
+#include <QQueue>
 
 #include "songsender.h"
 
@@ -16,26 +18,65 @@ class RemoteClient : public QObject {
   RemoteClient(Application* app, QTcpSocket* client);
   ~RemoteClient();
 
+  // Stop writing to the socket once this much is waiting in its buffer, so
+  // that newer state messages can replace older ones still in our queue.
+  static const qint64 kMaxBytesPending;
+  // Producers of bulk data should wait for ReadyForBulkData once this much
+  // is queued.
+  static const qint64 kMaxBulkBytesQueued;
+
+  // Messages are queued and written as the socket drains.  Messages that
+  // describe the current state (track position, volume, metadata and so on)
+  // replace any older message of the same type still in the queue.  File
+  // and library chunks are only written when nothing else is waiting.
+
   // This method checks if client is authenticated before sending the data
   void SendData(pb::remote::Message* msg);
+  // The same for a message already serialized with Serialize(), so one copy
+  // of a broadcast can be shared by every client.
+  void SendSerializedData(pb::remote::MsgType type, const QByteArray& data);
+  // Sends msg followed by payload as raw bytes, with no length in front.  Both
+  // go in the bulk queue.
+  void SendDataWithPayload(pb::remote::Message* msg, const QByteArray& payload);
   QAbstractSocket::SocketState State();
   void setDownloader(bool downloader);
   bool isDownloader() { return downloader_; }
+  void setPlaylistDeltas(bool playlist_deltas);
+  bool wantsPlaylistDeltas() { return playlist_deltas_; }
   void DisconnectClient(pb::remote::ReasonDisconnect reason);
 
   SongSender* song_sender() { return song_sender_; }
 
+  bool CanSendBulkData() const {
+    return bulk_bytes_queued_ < kMaxBulkBytesQueued;
+  }
+
+  // Returns msg with its length in front, as it's written to the socket.
+  static QByteArray Serialize(pb::remote::Message* msg);
+
  private slots:
   void IncomingData();
+  void SocketBytesWritten();
 
 signals:
   void Parse(const pb::remote::Message& msg);
+  // The bulk queue has room again.
+  void ReadyForBulkData();
 
  private:
   void ParseMessage(const QByteArray& data);
 
+  struct QueuedMessage {
+    pb::remote::MsgType type_;
+    QByteArray data_;
+  };
+
+  static bool IsStateMessage(pb::remote::MsgType type);
+  static bool IsBulkMessage(pb::remote::MsgType type);
+
   // Sends data to client without check if authenticated
-  void SendDataToClient(pb::remote::Message* msg);
+  void SendDataToClient(pb::remote::MsgType type, const QByteArray& data);
+  void WriteQueuedData();
 
   Application* app_;
 
@@ -44,12 +85,17 @@ signals:
   bool authenticated_;
   bool allow_downloads_;
   bool downloader_;
+  bool playlist_deltas_;
 
   QTcpSocket* client_;
   bool reading_protobuf_;
   quint32 expected_length_;
   QBuffer buffer_;
   SongSender* song_sender_;
+
+  QList<QueuedMessage> queue_;
+  QQueue<QByteArray> bulk_queue_;
+  qint64 bulk_bytes_queued_;
 };
 
 #endif  // REMOTECLIENT_H
@@ -17,7 +17,11 @@
 
 #include "songsender.h"
 
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
 #include <QFileInfo>
+#include <QHash>
 
 #include "core/application.h"
 #include "core/logging.h"
@@ -29,12 +33,20 @@
 #include "playlist/playlistitem.h"
 
 const quint32 SongSender::kFileChunkSize = 100000;  // in Bytes
+const int SongSender::kMinRawChunkSize = 64 * 1024;
+const int SongSender::kMaxRawChunkSize = 4 * 1024 * 1024;
+const int SongSender::kRawChunkTargetMsec = 250;
+const qint64 SongSender::kMaxTranscodeCacheBytes = 1024 * 1024 * 1024;
 
 SongSender::SongSender(Application* app, RemoteClient* client)
     : app_(app),
       client_(client),
       transcoder_(
-          new Transcoder(this, NetworkRemote::kTranscoderSettingPostfix)) {
+          new Transcoder(this, NetworkRemote::kTranscoderSettingPostfix)),
+      raw_chunks_(false),
+      waiting_for_transcode_(false) {
+  transcoder_->set_priority(TranscodeScheduler::Priority_Interactive);
+
   QSettings s;
   s.beginGroup(NetworkRemote::kSettingsGroup);
 
@@ -54,7 +66,6 @@ SongSender::SongSender(Application* app, RemoteClient* client)
 
   connect(transcoder_, SIGNAL(JobComplete(QString, QString, bool)),
           SLOT(TranscodeJobComplete(QString, QString, bool)));
-  connect(transcoder_, SIGNAL(AllJobsComplete()), SLOT(StartTransfer()));
 
   total_transcode_ = 0;
 }
@@ -62,12 +73,17 @@ SongSender::SongSender(Application* app, RemoteClient* client)
 SongSender::~SongSender() {
   disconnect(transcoder_, SIGNAL(JobComplete(QString, QString, bool)), this,
              SLOT(TranscodeJobComplete(QString, QString, bool)));
-  disconnect(transcoder_, SIGNAL(AllJobsComplete()), this,
-             SLOT(StartTransfer()));
   transcoder_->Cancel();
+
+  // Don't leave half-written files in the cache
+  for (const QString& output : pending_transcodes_) {
+    QFile::remove(output + ".part");
+  }
 }
 
 void SongSender::SendSongs(const pb::remote::RequestDownloadSongs& request) {
+  raw_chunks_ = request.raw_chunks();
+
   Song current_song;
   if (app_->player()->GetCurrentItem()) {
     current_song = app_->player()->GetCurrentItem()->Metadata();
@@ -104,37 +120,70 @@ void SongSender::SendSongs(const pb::remote::RequestDownloadSongs& request) {
 }
 
 void SongSender::TranscodeLosslessFiles() {
+  QDir().mkpath(Utilities::GetConfigPath(Utilities::Path_TranscodeCache));
+  const QByteArray settings_hash = EncoderSettingsHash();
+
   for (DownloadItem item : download_queue_) {
     // Check only lossless files
     if (!item.song_.IsFileLossless()) continue;
 
-    // Add the file to the transcoder
     QString local_file = item.song_.url().toLocalFile();
+    if (transcoder_map_.contains(local_file) ||
+        pending_transcodes_.contains(local_file)) {
+      continue;
+    }
 
-    transcoder_->AddTemporaryJob(local_file, transcoder_preset_);
+    // Maybe it was transcoded for an earlier download
+    const QString output = TranscodeCachePath(local_file, settings_hash);
+    if (QFile::exists(output)) {
+      qLog(Debug) << "using cached transcode of" << local_file;
+      transcoder_map_.insert(local_file, output);
+      continue;
+    }
+
+    // Add the file to the transcoder.  It's written next to its final name
+    // and only moved there once it's complete.
+    transcoder_->AddJob(local_file, transcoder_preset_, output + ".part",
+                        item.song_);
+    pending_transcodes_.insert(local_file, output);
 
     qLog(Debug) << "transcoding" << local_file;
     total_transcode_++;
   }
 
-  if (total_transcode_ > 0) {
+  if (!pending_transcodes_.isEmpty()) {
     transcoder_->Start();
     SendTranscoderStatus();
-  } else {
-    StartTransfer();
   }
+
+  // Songs are offered as soon as their own transcode is done, not once all
+  // of them are
+  StartTransfer();
 }
 
 void SongSender::TranscodeJobComplete(const QString& input,
                                       const QString& output, bool success) {
   qLog(Debug) << input << "transcoded to" << output << success;
 
+  const QString cache_path = pending_transcodes_.take(input);
+
   // If it wasn't successful send original file
-  if (success) {
-    transcoder_map_.insert(input, output);
+  if (success && !cache_path.isEmpty()) {
+    QFile::remove(cache_path);
+    if (QFile::rename(output, cache_path)) {
+      transcoder_map_.insert(input, cache_path);
+    }
   }
+  QFile::remove(output);
 
   SendTranscoderStatus();
+
+  if (pending_transcodes_.isEmpty()) {
+    total_transcode_ = 0;
+    PruneTranscodeCache();
+  }
+
+  if (waiting_for_transcode_) OfferNextSong();
 }
 
 void SongSender::SendTranscoderStatus() {
@@ -144,15 +193,65 @@ void SongSender::SendTranscoderStatus() {
 
   pb::remote::ResponseTranscoderStatus* status =
       msg.mutable_response_transcoder_status();
-  status->set_processed(transcoder_map_.count());
+  status->set_processed(total_transcode_ - pending_transcodes_.count());
   status->set_total(total_transcode_);
 
   client_->SendData(&msg);
 }
 
-void SongSender::StartTransfer() {
-  total_transcode_ = 0;
+QByteArray SongSender::EncoderSettingsHash() const {
+  // The encoder settings the transcoder will use for remote downloads
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  QSettings s;
+  s.beginGroup("Transcoder");
+  for (const QString& group : s.childGroups()) {
+    if (!group.endsWith(NetworkRemote::kTranscoderSettingPostfix)) continue;
+
+    s.beginGroup(group);
+    for (const QString& key : s.childKeys()) {
+      hash.addData(
+          QString("%1/%2=%3;").arg(group, key, s.value(key).toString())
+              .toUtf8());
+    }
+    s.endGroup();
+  }
+
+  return hash.result();
+}
+
+QString SongSender::TranscodeCachePath(const QString& file,
+                                       const QByteArray& settings_hash) const {
+  const QFileInfo info(file);
 
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(info.absoluteFilePath().toUtf8());
+  hash.addData(QByteArray::number(info.size()));
+  hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+  hash.addData(transcoder_preset_.codec_mimetype_.toUtf8());
+  hash.addData(settings_hash);
+
+  return Utilities::GetConfigPath(Utilities::Path_TranscodeCache) + "/" +
+         hash.result().toHex() + "." + transcoder_preset_.extension_;
+}
+
+void SongSender::PruneTranscodeCache() {
+  QDir dir(Utilities::GetConfigPath(Utilities::Path_TranscodeCache));
+
+  // Keep the newest files
+  qint64 total = 0;
+  for (const QFileInfo& info :
+       dir.entryInfoList(QDir::Files, QDir::Time)) {
+    if (info.suffix() == "part") continue;
+
+    total += info.size();
+    if (total > kMaxTranscodeCacheBytes) {
+      QFile::remove(info.absoluteFilePath());
+    }
+  }
+}
+
+void SongSender::StartTransfer() {
   // Send total file size & file count
   SendTotalFileSize();
 
@@ -174,6 +273,7 @@ void SongSender::SendTotalFileSize() {
     QString local_file = item.song_.url().toLocalFile();
     bool is_transcoded = transcoder_map_.contains(local_file);
 
+    // Files still being transcoded are counted at their original size
     if (is_transcoded) {
       local_file = transcoder_map_.value(local_file);
     }
@@ -187,19 +287,27 @@ void SongSender::SendTotalFileSize() {
 
 void SongSender::OfferNextSong() {
   pb::remote::Message msg;
+  waiting_for_transcode_ = false;
 
   if (download_queue_.isEmpty()) {
     msg.set_type(pb::remote::DOWNLOAD_QUEUE_EMPTY);
   } else {
     // Get the item and send the single song
     DownloadItem item = download_queue_.head();
+    QString local_file = item.song_.url().toLocalFile();
+
+    // Wait for it if it's still being transcoded
+    if (pending_transcodes_.contains(local_file)) {
+      waiting_for_transcode_ = true;
+      return;
+    }
 
     msg.set_type(pb::remote::SONG_FILE_CHUNK);
     pb::remote::ResponseSongFileChunk* chunk =
         msg.mutable_response_song_file_chunk();
 
     // Open the file
-    QFile file(item.song_.url().toLocalFile());
+    QFile file(transcoder_map_.value(local_file, local_file));
 
     // Song offer is chunk no 0
     chunk->set_chunk_count(0);
@@ -215,37 +323,67 @@ void SongSender::OfferNextSong() {
   client_->SendData(&msg);
 }
 
-void SongSender::ResponseSongOffer(bool accepted) {
-  if (download_queue_.isEmpty()) return;
+void SongSender::ResponseSongOffer(bool accepted, qint64 offset) {
+  if (download_queue_.isEmpty() || transfer_) return;
 
-  // Get the item and send the single song
+  // Get the item and send the single song.  The next song is offered once
+  // it's all been sent.
   DownloadItem item = download_queue_.dequeue();
-  if (accepted) SendSingleSong(item);
-
-  // And offer the next song
-  OfferNextSong();
+  if (!accepted || !SendSingleSong(item, offset)) OfferNextSong();
 }
 
-void SongSender::SendSingleSong(DownloadItem download_item) {
+bool SongSender::SendSingleSong(DownloadItem download_item, qint64 offset) {
   // Only local files!!!
-  if (!(download_item.song_.url().scheme() == "file")) return;
+  if (!(download_item.song_.url().scheme() == "file")) return false;
+
+  transfer_.reset(new FileTransfer(download_item));
 
   QString local_file = download_item.song_.url().toLocalFile();
-  bool is_transcoded = transcoder_map_.contains(local_file);
+  transfer_->is_transcoded_ = transcoder_map_.contains(local_file);
 
-  if (is_transcoded) {
+  if (transfer_->is_transcoded_) {
     local_file = transcoder_map_.take(local_file);
   }
 
   // Open the file
-  QFile file(local_file);
+  QFile& file = transfer_->file_;
+  file.setFileName(local_file);
 
   // Get sha1 for file
-  QByteArray sha1 = Utilities::Sha1File(file).toHex();
-  qLog(Debug) << "sha1 for file" << local_file << "=" << sha1;
+  transfer_->sha1_ = Utilities::Sha1File(file).toHex();
+  qLog(Debug) << "sha1 for file" << local_file << "=" << transfer_->sha1_;
 
   file.open(QIODevice::ReadOnly);
 
+  // Calculate the number of chunks
+  transfer_->chunk_count_ = qRound((file.size() / kFileChunkSize) + 0.5);
+
+  // Carry on from where an interrupted transfer got to.  Fixed size chunks
+  // have to start on a chunk boundary.
+  if (offset > 0 && offset < file.size()) {
+    if (!raw_chunks_) {
+      transfer_->chunk_number_ += offset / kFileChunkSize;
+      offset = (transfer_->chunk_number_ - 1) * qint64(kFileChunkSize);
+    }
+    file.seek(offset);
+    qLog(Debug) << "Resuming" << local_file << "at" << offset;
+  }
+
+  SendFileChunks();
+  return true;
+}
+
+void SongSender::SendFileChunks() {
+  if (!transfer_) return;
+
+  if (raw_chunks_) {
+    SendRawFileChunks();
+    return;
+  }
+
+  QFile& file = transfer_->file_;
+  const DownloadItem& download_item = transfer_->item_;
+
   QByteArray data;
   pb::remote::Message msg;
   pb::remote::ResponseSongFileChunk* chunk =
@@ -254,26 +392,25 @@ void SongSender::SendSingleSong(DownloadItem download_item) {
 
   QImage null_image;
 
-  // Calculate the number of chunks
-  int chunk_count = qRound((file.size() / kFileChunkSize) + 0.5);
-  int chunk_number = 1;
-
-  while (!file.atEnd()) {
+  // Don't read the whole file into memory if the client is slow to take it.
+  // The client tells us when it's ready for more.
+  while (!file.atEnd() && client_->CanSendBulkData()) {
     // Read file chunk
     data = file.read(kFileChunkSize);
 
     // Set chunk data
-    chunk->set_chunk_count(chunk_count);
-    chunk->set_chunk_number(chunk_number);
+    chunk->set_chunk_count(transfer_->chunk_count_);
+    chunk->set_chunk_number(transfer_->chunk_number_);
     chunk->set_file_count(download_item.song_count_);
     chunk->set_file_number(download_item.song_no_);
     chunk->set_size(file.size());
     chunk->set_data(data.data(), data.size());
-    chunk->set_file_hash(sha1.data(), sha1.size());
+    chunk->set_file_hash(transfer_->sha1_.data(), transfer_->sha1_.size());
+    chunk->set_offset(file.pos() - data.size());
 
     // On the first chunk send the metadata, so the client knows
     // what file it receives.
-    if (chunk_number == 1) {
+    if (transfer_->chunk_number_ == 1) {
       int i = app_->playlist_manager()->active()->current_row();
       pb::remote::SongMetadata* song_metadata =
           msg.mutable_response_song_file_chunk()->mutable_song_metadata();
@@ -281,7 +418,7 @@ void SongSender::SendSingleSong(DownloadItem download_item) {
                                       song_metadata);
 
       // if the file was transcoded, we have to change the filename and filesize
-      if (is_transcoded) {
+      if (transfer_->is_transcoded_) {
         song_metadata->set_file_size(file.size());
         QString basefilename = download_item.song_.basefilename();
         QFileInfo info(basefilename);
@@ -298,15 +435,89 @@ void SongSender::SendSingleSong(DownloadItem download_item) {
     chunk->Clear();
     data.clear();
 
-    chunk_number++;
+    transfer_->chunk_number_++;
   }
 
-  // If the file was transcoded, delete the temporary one
-  if (is_transcoded) {
-    file.remove();
-  } else {
-    file.close();
+  if (file.atEnd()) FinishTransfer();
+}
+
+void SongSender::SendRawFileChunks() {
+  QFile& file = transfer_->file_;
+  const DownloadItem& download_item = transfer_->item_;
+
+  pb::remote::Message msg;
+  msg.set_type(pb::remote::SONG_FILE_CHUNK);
+  pb::remote::ResponseSongFileChunk* chunk =
+      msg.mutable_response_song_file_chunk();
+
+  if (!transfer_->timer_.isValid()) transfer_->timer_.start();
+
+  while (!file.atEnd() && client_->CanSendBulkData()) {
+    // Size the chunk by how quickly the client has been taking them
+    const qint64 elapsed = transfer_->timer_.elapsed();
+    if (elapsed > 0) {
+      const qint64 bytes_per_target =
+          transfer_->bytes_sent_ * kRawChunkTargetMsec / elapsed;
+      transfer_->chunk_size_ = int(qBound(qint64(kMinRawChunkSize),
+                                          bytes_per_target,
+                                          qint64(kMaxRawChunkSize)));
+    }
+
+    const qint64 offset = file.pos();
+    const QByteArray data = file.read(transfer_->chunk_size_);
+    if (data.isEmpty()) {
+      qLog(Warning) << "Error reading" << file.fileName();
+      FinishTransfer();
+      return;
+    }
+
+    chunk->set_chunk_number(transfer_->chunk_number_);
+    chunk->set_file_count(download_item.song_count_);
+    chunk->set_file_number(download_item.song_no_);
+    chunk->set_size(file.size());
+    chunk->set_file_hash(transfer_->sha1_.data(), transfer_->sha1_.size());
+    chunk->set_offset(offset);
+    chunk->set_raw_size(data.size());
+
+    // On the first chunk send the metadata, so the client knows
+    // what file it receives.
+    if (transfer_->chunk_number_ == 1) {
+      pb::remote::SongMetadata* song_metadata = chunk->mutable_song_metadata();
+      OutgoingDataCreator::CreateSong(
+          download_item.song_, QImage(),
+          app_->playlist_manager()->active()->current_row(), song_metadata);
+
+      // if the file was transcoded, we have to change the filename and filesize
+      if (transfer_->is_transcoded_) {
+        song_metadata->set_file_size(file.size());
+        QString basefilename = download_item.song_.basefilename();
+        QFileInfo info(basefilename);
+        basefilename.replace("." + info.suffix(),
+                             "." + transcoder_preset_.extension_);
+        song_metadata->set_filename(DataCommaSizeFromQString(basefilename));
+      }
+    }
+
+    // The file data goes straight to the socket, not through the protobuf
+    client_->SendDataWithPayload(&msg, data);
+
+    chunk->Clear();
+    transfer_->bytes_sent_ += data.size();
+    transfer_->chunk_number_++;
   }
+
+  if (file.atEnd()) FinishTransfer();
+}
+
+void SongSender::FinishTransfer() {
+  QFile& file = transfer_->file_;
+
+  // Transcoded files stay in the cache for next time
+  file.close();
+  transfer_.reset();
+
+  // And offer the next song
+  OfferNextSong();
 }
 
 void SongSender::SendAlbum(const Song& song) {
@@ -350,11 +561,22 @@ void SongSender::SendUrls(const pb::remote::RequestDownloadSongs& request) {
   SongList song_list;
 
   // First gather all valid songs
+  QList<QUrl> urls;
   for (auto it = request.urls().begin(); it != request.urls().end(); ++it) {
     std::string s = *it;
-    QUrl url = QUrl(QStringFromStdString(s));
+    urls << QUrl(QStringFromStdString(s));
+  }
+
+  // Look them all up at once
+  QHash<QByteArray, Song> library_songs;  // encoded filename -> song
+  for (const Song& song : app_->library_backend()->GetSongsByUrls(urls)) {
+    if (song.beginning_nanosec() == 0) {
+      library_songs.insert(song.url().toEncoded(), song);
+    }
+  }
 
-    Song song = app_->library_backend()->GetSongByUrl(url);
+  for (const QUrl& url : urls) {
+    Song song = library_songs.value(url.toEncoded());
 
     if (song.is_valid() && song.url().scheme() == "file") {
       song_list.append(song);
@@ -1,6 +1,10 @@
 #ifndef SONGSENDER_H
 #define SONGSENDER_H
 
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QFile>
 #include <QMap>
 #include <QQueue>
 #include <QUrl>
@@ -29,14 +33,22 @@ class SongSender : public QObject {
   ~SongSender();
 
   static const quint32 kFileChunkSize;
+  // Raw chunks are sized to take about kRawChunkTargetMsec to send at the
+  // rate the client has been taking them.
+  static const int kMinRawChunkSize;
+  static const int kMaxRawChunkSize;
+  static const int kRawChunkTargetMsec;
+  static const qint64 kMaxTranscodeCacheBytes;
 
  public slots:
   void SendSongs(const pb::remote::RequestDownloadSongs& request);
-  void ResponseSongOffer(bool accepted);
+  void ResponseSongOffer(bool accepted, qint64 offset = 0);
 
  private slots:
   void TranscodeJobComplete(const QString& input, const QString& output, bool success);
   void StartTransfer();
+  // Sends chunks of the current file until the client's queue is full.
+  void SendFileChunks();
 
  private:
   Application* app_;
@@ -45,12 +57,41 @@ class SongSender : public QObject {
   TranscoderPreset transcoder_preset_;
   Transcoder* transcoder_;
   bool transcode_lossless_files_;
+  bool raw_chunks_;
+
+  // The file being sent to the client at the moment
+  struct FileTransfer {
+    FileTransfer(const DownloadItem& item)
+        : item_(item), is_transcoded_(false), chunk_count_(0),
+          chunk_number_(1), bytes_sent_(0), chunk_size_(kMinRawChunkSize) {}
+
+    DownloadItem item_;
+    QFile file_;
+    QByteArray sha1_;
+    bool is_transcoded_;
+    int chunk_count_;
+    int chunk_number_;
+
+    // For raw chunks
+    QElapsedTimer timer_;
+    qint64 bytes_sent_;
+    int chunk_size_;
+  };
 
   QQueue<DownloadItem> download_queue_;
+  std::unique_ptr<FileTransfer> transfer_;
+  // Source file to transcoded file, for the transcodes that have finished
   QMap<QString, QString> transcoder_map_;
+  // Source file to where its transcode will end up, for those still running
+  QMap<QString, QString> pending_transcodes_;
   int total_transcode_;
+  // The next song can't be offered until its transcode finishes
+  bool waiting_for_transcode_;
 
-  void SendSingleSong(DownloadItem download_item);
+  // Returns false if the song can't be sent.
+  bool SendSingleSong(DownloadItem download_item, qint64 offset);
+  void SendRawFileChunks();
+  void FinishTransfer();
   void SendAlbum(const Song& song);
   void SendPlaylist(int playlist_id);
   void SendUrls(const pb::remote::RequestDownloadSongs& request);
@@ -58,6 +99,13 @@ class SongSender : public QObject {
   void SendTotalFileSize();
   void TranscodeLosslessFiles();
   void SendTranscoderStatus();
+
+  // Transcoded files are kept in a cache, named after everything that affects
+  // their contents.
+  QByteArray EncoderSettingsHash() const;
+  QString TranscodeCachePath(const QString& file,
+                             const QByteArray& settings_hash) const;
+  static void PruneTranscodeCache();
 };
 
 #endif  // SONGSENDER_H
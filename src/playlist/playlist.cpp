@@ -18,28 +18,38 @@
 #include "playlist.h"
 
 #include <algorithm>
+#include <deque>
 #include <functional>
 #include <memory>
-#include <unordered_map>
+#include <numeric>
+#include <vector>
 
 #include <QApplication>
 #include <QBuffer>
+#include <QCollator>
 #include <QCoreApplication>
 #include <QDirIterator>
 #include <QFileInfo>
+#include <QHash>
 #include <QLinkedList>
 #include <QMimeData>
 #include <QMutableListIterator>
 #include <QSortFilterProxyModel>
+#include <QThread>
+#include <QTimer>
 #include <QUndoStack>
-#include <QtConcurrentRun>
 #include <QtDebug>
 
 #include "core/application.h"
 #include "core/closure.h"
+#include "core/fileexistencecache.h"
 #include "core/logging.h"
+#include "core/memoryaccounting.h"
+#include "core/perftrace.h"
 #include "core/player.h"
 #include "core/tagreaderclient.h"
+#include "core/taskexecutor.h"
+#include "core/taskmanager.h"
 #include "core/timeconstants.h"
 #include "internet/core/internetmimedata.h"
 #include "internet/core/internetmodel.h"
@@ -70,7 +80,6 @@
 using std::placeholders::_1;
 using std::placeholders::_2;
 using std::shared_ptr;
-using std::unordered_map;
 
 using smart_playlists::Generator;
 using smart_playlists::GeneratorInserter;
@@ -94,12 +103,21 @@ const char* Playlist::kSortIgnorePrefix = "sort_ignore_prefix";
 const char* Playlist::kSortIgnorePrefixList = "sort_ignore_prefix_list";
 
 const int Playlist::kUndoStackSize = 20;
-const int Playlist::kUndoItemLimit = 500;
+const int Playlist::kUndoItemLimit = 5000;
+const int Playlist::kItemPoolBlockSize = 1024;
+
+const int Playlist::kRestoreFirstPageSize = 200;
+const int Playlist::kRestorePageSize = 2000;
+const int Playlist::kBackgroundRestoreDelayMsec = 250;
+const int Playlist::kReloadBatchDelayMsec = 100;
 
 const qint64 Playlist::kMinScrobblePointNsecs = 31ll * kNsecPerSec;
 const qint64 Playlist::kMaxScrobblePointNsecs = 240ll * kNsecPerSec;
 
 namespace {
+// Sorts smaller than this aren't worth splitting across threads.
+const int kParallelSortMinItems = 10000;
+
 QString removePrefix(const QString& a, const QStringList& prefixes) {
   for (const QString& prefix : prefixes) {
     if (a.startsWith(prefix)) {
@@ -108,6 +126,240 @@ QString removePrefix(const QString& a, const QStringList& prefixes) {
   }
   return a;
 }
+
+// Compares two rows being sorted, returning <0, 0 or >0.
+typedef std::function<int(int, int)> RowComparator;
+
+template <typename T>
+int CompareKeys(const T& a, const T& b) {
+  return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+int CompareKeys(const QCollatorSortKey& a, const QCollatorSortKey& b) {
+  return a.compare(b);
+}
+
+// Gets one sort key from every item up front, rather than from both items on
+// every comparison.
+template <typename T>
+RowComparator CompareBy(const PlaylistItemList& items,
+                        std::function<T(const PlaylistItemPtr&)> key) {
+  std::shared_ptr<std::vector<T>> keys(new std::vector<T>);
+  keys->reserve(items.count());
+  for (const PlaylistItemPtr& item : items) {
+    keys->push_back(key(item));
+  }
+  return [keys](int a, int b) { return CompareKeys((*keys)[a], (*keys)[b]); };
+}
+
+// Strings are compared through collation keys, which are much cheaper to
+// compare than the strings themselves.
+RowComparator CompareStrings(const PlaylistItemList& items,
+                             const QStringList& prefixes,
+                             std::function<QString(const Song&)> field) {
+  QCollator collator;
+  return CompareBy<QCollatorSortKey>(
+      items, [&](const PlaylistItemPtr& item) {
+        return collator.sortKey(
+            removePrefix(field(item->Metadata()).toLower(), prefixes));
+      });
+}
+
+RowComparator CompareColumn(int column, const PlaylistItemList& items,
+                            const QStringList& prefixes) {
+#define cmp(type, field)                                         \
+  return CompareBy<type>(items, [](const PlaylistItemPtr& item) { \
+    return item->Metadata().field();                             \
+  })
+#define strcmp(field)                                          \
+  return CompareStrings(items, prefixes, [](const Song& song) { \
+    return song.field();                                       \
+  })
+
+  switch (column) {
+    case Playlist::Column_Title:
+      strcmp(title);
+    case Playlist::Column_Artist:
+      strcmp(artist);
+    case Playlist::Column_Album:
+      strcmp(album);
+    case Playlist::Column_Length:
+      cmp(qint64, length_nanosec);
+    case Playlist::Column_Track:
+      cmp(int, track);
+    case Playlist::Column_Disc:
+      cmp(int, disc);
+    case Playlist::Column_Year:
+      cmp(int, year);
+    case Playlist::Column_OriginalYear:
+      cmp(int, originalyear);
+    case Playlist::Column_Genre:
+      strcmp(genre);
+    case Playlist::Column_AlbumArtist:
+      strcmp(playlist_albumartist);
+    case Playlist::Column_Composer:
+      strcmp(composer);
+    case Playlist::Column_Performer:
+      strcmp(performer);
+    case Playlist::Column_Grouping:
+      strcmp(grouping);
+
+    case Playlist::Column_Rating:
+      cmp(float, rating);
+    case Playlist::Column_PlayCount:
+      cmp(int, playcount);
+    case Playlist::Column_SkipCount:
+      cmp(int, skipcount);
+    case Playlist::Column_LastPlayed:
+      cmp(int, lastplayed);
+    case Playlist::Column_Score:
+      cmp(int, score);
+
+    case Playlist::Column_BPM:
+      cmp(float, bpm);
+    case Playlist::Column_Bitrate:
+      cmp(int, bitrate);
+    case Playlist::Column_Samplerate:
+      cmp(int, samplerate);
+    case Playlist::Column_Filename: {
+      QCollator collator;
+      return CompareBy<QCollatorSortKey>(
+          items, [&](const PlaylistItemPtr& item) {
+            return collator.sortKey(item->Url().path().toLower());
+          });
+    }
+    case Playlist::Column_BaseFilename:
+      cmp(QString, basefilename);
+    case Playlist::Column_Filesize:
+      cmp(int, filesize);
+    case Playlist::Column_Filetype:
+      cmp(Song::FileType, filetype);
+    case Playlist::Column_DateModified:
+      cmp(uint, mtime);
+    case Playlist::Column_DateCreated:
+      cmp(uint, ctime);
+
+    case Playlist::Column_Comment:
+      strcmp(comment);
+    case Playlist::Column_Source:
+      cmp(QUrl, url);
+  }
+
+#undef cmp
+#undef strcmp
+
+  return [](int, int) { return 0; };
+}
+
+// Stable sorts rows, splitting big sorts across threads and merging the
+// sorted pieces afterwards.
+void SortRows(std::vector<int>::iterator begin, std::vector<int>::iterator end,
+              const RowComparator& compare) {
+  auto less = [&compare](int a, int b) { return compare(a, b) < 0; };
+
+  const int count = end - begin;
+  const int piece_count = qMin(QThread::idealThreadCount(),
+                               count / kParallelSortMinItems + 1);
+  if (piece_count < 2) {
+    std::stable_sort(begin, end, less);
+    return;
+  }
+
+  std::vector<std::vector<int>::iterator> bounds;
+  for (int i = 0; i < piece_count; ++i) {
+    bounds.push_back(begin + count * i / piece_count);
+  }
+  bounds.push_back(end);
+
+  QList<QFuture<void>> futures;
+  for (int i = 0; i < piece_count; ++i) {
+    auto piece_begin = bounds[i];
+    auto piece_end = bounds[i + 1];
+    futures << TaskExecutor::Instance()->Run<void>(
+        TaskExecutor::Lane_Interactive, [piece_begin, piece_end, &less]() {
+          std::stable_sort(piece_begin, piece_end, less);
+        });
+  }
+  for (QFuture<void>& future : futures) {
+    future.waitForFinished();
+  }
+
+  // Merge neighbouring pieces until there's just one left.
+  while (bounds.size() > 2) {
+    std::vector<std::vector<int>::iterator> merged;
+    for (size_t i = 0; i + 2 < bounds.size(); i += 2) {
+      std::inplace_merge(bounds[i], bounds[i + 1], bounds[i + 2], less);
+      merged.push_back(bounds[i]);
+    }
+    if (bounds.size() % 2 == 0) merged.push_back(bounds[bounds.size() - 2]);
+    merged.push_back(bounds.back());
+    bounds.swap(merged);
+  }
+}
+
+// The internet services are created after the first playlists are restored,
+// so the service might not exist yet.
+template <typename T>
+LibraryBackend* ServiceLibraryBackend() {
+  T* service = InternetModel::Service<T>();
+  if (!service) {
+    qLog(Warning) << T::kServiceName << "isn't loaded yet";
+    return nullptr;
+  }
+  return service->library_backend();
+}
+
+// Reloads all the items at once.  Items that reload from a local file have
+// their tags read in one tagreader batch, starting from the library's copy of
+// the song (fetched in one query) if they're in the library.  The new songs
+// are returned in the same order as items, for Playlist to store.  Any other
+// items are reloaded one by one, here, and get an invalid song.
+SongList ReloadItemSongs(LibraryBackend* library, PlaylistItemList items) {
+  SongList ret;
+  ret.reserve(items.count());
+
+  SongList songs;
+  QStringList filenames;
+  QList<int> positions;
+  QMultiHash<int, int> library_ids;  // library id -> index in songs
+
+  for (int i = 0; i < items.count(); ++i) {
+    ret << Song();
+
+    Song song;
+    if (!items[i]->GetReloadableSong(&song)) continue;
+
+    if (library && items[i]->IsLocalLibraryItem() && song.id() != -1) {
+      library_ids.insert(song.id(), songs.count());
+    }
+    songs << song;
+    filenames << song.url().toLocalFile();
+    positions << i;
+  }
+
+  if (!library_ids.isEmpty()) {
+    for (const Song& song : library->GetSongsById(library_ids.uniqueKeys())) {
+      for (int j : library_ids.values(song.id())) {
+        songs[j] = song;
+      }
+    }
+  }
+
+  if (!songs.isEmpty()) {
+    TagReaderClient::Instance()->ReadFilesBlocking(filenames, &songs);
+  }
+
+  for (int j = 0; j < songs.count(); ++j) {
+    ret[positions[j]] = songs[j];
+  }
+
+  for (int i = 0; i < items.count(); ++i) {
+    Song song;
+    if (!items[i]->GetReloadableSong(&song)) items[i]->Reload();
+  }
+
+  return ret;
+}
 }  // namespace
 
 Playlist::Playlist(PlaylistBackend* backend, TaskManager* task_manager,
@@ -122,6 +374,10 @@ Playlist::Playlist(PlaylistBackend* backend, TaskManager* task_manager,
       library_(library),
       id_(id),
       favorite_(favorite),
+      navigable_virtual_indices_dirty_(true),
+      total_length_nanosec_(0),
+      total_filesize_(0),
+      prefix_sums_dirty_(true),
       current_is_paused_(false),
       current_virtual_index_(-1),
       is_shuffled_(false),
@@ -132,19 +388,58 @@ Playlist::Playlist(PlaylistBackend* backend, TaskManager* task_manager,
       ignore_sorting_(false),
       undo_stack_(new QUndoStack(this)),
       special_type_(special_type),
-      cancel_restore_(false) {
+      cancel_restore_(false),
+      loaded_(false),
+      restoring_(false),
+      restore_row_(0),
+      restore_page_pending_(false),
+      restore_in_foreground_(false),
+      restore_after_position_(-1),
+      save_after_restore_(false) {
   undo_stack_->setUndoLimit(kUndoStackSize);
 
+  MemoryAccounting::Instance()->Register(
+      this, "playlists", "Playlist items and undo history",
+      [this]() {
+        // Most undo commands only hold a few items.
+        return qint64(items_.count() + undo_stack_->count()) *
+               MemoryAccounting::kEstimatedSongBytes;
+      },
+      [this](qint64) { undo_stack_->clear(); },
+      MemoryAccounting::Priority_Precious);
+
   connect(this, SIGNAL(rowsInserted(const QModelIndex&, int, int)),
           SIGNAL(PlaylistChanged()));
   connect(this, SIGNAL(rowsRemoved(const QModelIndex&, int, int)),
           SIGNAL(PlaylistChanged()));
 
-  Restore();
-
   proxy_->setSourceModel(this);
   queue_->setSourceModel(this);
 
+  // Anything that can change which rows are in the filter or the order they
+  // are played in invalidates the navigation index.
+  for (QAbstractItemModel* model :
+       QList<QAbstractItemModel*>() << this << proxy_) {
+    connect(model, SIGNAL(rowsInserted(QModelIndex, int, int)),
+            SLOT(InvalidateNavigableVirtualIndices()));
+    connect(model, SIGNAL(rowsRemoved(QModelIndex, int, int)),
+            SLOT(InvalidateNavigableVirtualIndices()));
+    connect(model, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)),
+            SLOT(InvalidateNavigableVirtualIndices()));
+    connect(model, SIGNAL(layoutChanged()),
+            SLOT(InvalidateNavigableVirtualIndices()));
+    connect(model, SIGNAL(modelReset()),
+            SLOT(InvalidateNavigableVirtualIndices()));
+  }
+  connect(this, SIGNAL(dataChanged(QModelIndex, QModelIndex)),
+          SLOT(InvalidateNavigableVirtualIndices()));
+
+  connect(this, SIGNAL(dataChanged(QModelIndex, QModelIndex)),
+          SLOT(UpdateAggregates(QModelIndex, QModelIndex)));
+  connect(this, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)),
+          SLOT(InvalidatePrefixSums()));
+  connect(this, SIGNAL(layoutChanged()), SLOT(InvalidatePrefixSums()));
+
   connect(queue_, SIGNAL(rowsAboutToBeRemoved(QModelIndex, int, int)),
           SLOT(TracksAboutToBeDequeued(QModelIndex, int, int)));
   connect(queue_, SIGNAL(rowsRemoved(QModelIndex, int, int)),
@@ -182,10 +477,20 @@ Playlist::~Playlist() {
 template <typename T>
 void Playlist::InsertSongItems(const SongList& songs, int pos, bool play_now,
                                bool enqueue, bool enqueue_next) {
+  // Items are allocated kItemPoolBlockSize at a time, each sharing its
+  // block's reference count, instead of once (twice with the control block)
+  // for every song.  A block is freed when the last of its items is gone.
+  // These items can't use shared_from_this().
   PlaylistItemList items;
+  items.reserve(songs.count());
 
+  std::shared_ptr<std::deque<T>> block;
   for (const Song& song : songs) {
-    items << PlaylistItemPtr(new T(song));
+    if (!block || int(block->size()) == kItemPoolBlockSize) {
+      block = std::make_shared<std::deque<T>>();
+    }
+    block->emplace_back(song);
+    items << PlaylistItemPtr(block, &block->back());
   }
 
   InsertItems(items, pos, play_now, enqueue, enqueue_next);
@@ -273,6 +578,7 @@ bool Playlist::set_column_value(Song& song, Playlist::Column column,
 }
 
 QVariant Playlist::data(const QModelIndex& index, int role) const {
+  PerfTrace::Scope trace("Playlist::data");
   switch (role) {
     case Role_IsCurrent:
       return current_item_index_.isValid() &&
@@ -446,9 +752,13 @@ void Playlist::SongSaveComplete(TagReaderReply* reply,
                                 const QPersistentModelIndex& index) {
   if (reply->is_successful() && index.isValid()) {
     if (reply->message().save_file_response().success()) {
-      QFuture<void> future = item_at(index.row())->BackgroundReload();
-      NewClosure(future, this, SLOT(ItemReloadComplete(QPersistentModelIndex)),
-                 index);
+      // Saving several songs finishes a reply at a time, so gather them up
+      // and reload them together.
+      if (pending_reloads_.isEmpty()) {
+        QTimer::singleShot(kReloadBatchDelayMsec, this,
+                           SLOT(ReloadPendingItems()));
+      }
+      pending_reloads_ << index;
     } else {
       emit Error(tr("An error occurred writing metadata to '%1'").arg(
           QString::fromStdString(
@@ -458,10 +768,75 @@ void Playlist::SongSaveComplete(TagReaderReply* reply,
   reply->deleteLater();
 }
 
-void Playlist::ItemReloadComplete(const QPersistentModelIndex& index) {
-  if (index.isValid()) {
-    emit dataChanged(index, index);
-    emit EditingFinished(index);
+void Playlist::ReloadPendingItems() {
+  QList<QPersistentModelIndex> indexes;
+  PlaylistItemList items;
+  for (const QPersistentModelIndex& index : pending_reloads_) {
+    if (index.isValid()) {
+      indexes << index;
+      items << item_at(index.row());
+    }
+  }
+  pending_reloads_.clear();
+
+  QFuture<SongList> future = TaskExecutor::Instance()->Run<SongList>(
+      TaskExecutor::Lane_Background,
+      std::bind(ReloadItemSongs, library_, items));
+  NewClosure(future, this,
+             SLOT(PendingItemsReloaded(QFuture<SongList>,
+                                       QList<QPersistentModelIndex>,
+                                       PlaylistItemList)),
+             future, indexes, items);
+}
+
+void Playlist::PendingItemsReloaded(QFuture<SongList> future,
+                                    const QList<QPersistentModelIndex>& indexes,
+                                    const PlaylistItemList& items) {
+  const SongList songs = future.result();
+
+  // Drop anything that was removed while it was being reloaded
+  QList<int> rows;
+  PlaylistItemList reloaded_items;
+  SongList reloaded_songs;
+  for (int i = 0; i < indexes.count(); ++i) {
+    if (indexes[i].isValid() && item_at(indexes[i].row()) == items[i]) {
+      rows << indexes[i].row();
+      reloaded_items << items[i];
+      reloaded_songs << songs[i];
+    }
+  }
+
+  ApplyReloadedSongs(rows, reloaded_items, reloaded_songs);
+
+  for (const QPersistentModelIndex& index : indexes) {
+    if (index.isValid()) emit EditingFinished(index);
+  }
+}
+
+void Playlist::ApplyReloadedSongs(const QList<int>& rows,
+                                  const PlaylistItemList& items,
+                                  const SongList& songs) {
+  int first_row = -1;
+  int last_row = -1;
+  bool current_changed = false;
+
+  for (int i = 0; i < rows.count(); ++i) {
+    Song song;
+    if (items[i]->GetReloadableSong(&song)) {
+      items[i]->SetReloadedSong(songs[i]);
+    }
+
+    const int row = rows[i];
+    if (row == current_row()) current_changed = true;
+    first_row = first_row == -1 ? row : qMin(first_row, row);
+    last_row = qMax(last_row, row);
+  }
+
+  if (first_row != -1) {
+    emit dataChanged(index(first_row, 0), index(last_row, ColumnCount - 1));
+  }
+  if (current_changed) {
+    InformOfCurrentSongChange();
   }
 }
 
@@ -488,6 +863,26 @@ bool Playlist::FilterContainsVirtualIndex(int i) const {
   return proxy_->filterAcceptsRow(virtual_items_[i], QModelIndex());
 }
 
+void Playlist::InvalidateNavigableVirtualIndices() {
+  navigable_virtual_indices_dirty_ = true;
+}
+
+const QVector<int>& Playlist::NavigableVirtualIndices() const {
+  if (navigable_virtual_indices_dirty_) {
+    navigable_virtual_indices_.clear();
+    for (int i = 0; i < virtual_items_.count(); ++i) {
+      const int row = virtual_items_[i];
+      if (!item_at(row)->GetShouldSkip() &&
+          proxy_->filterAcceptsRow(row, QModelIndex())) {
+        navigable_virtual_indices_ << i;
+      }
+    }
+    navigable_virtual_indices_.squeeze();
+    navigable_virtual_indices_dirty_ = false;
+  }
+  return navigable_virtual_indices_;
+}
+
 int Playlist::NextVirtualIndex(int i, bool ignore_repeat_track) const {
   PlaylistSequence::RepeatMode repeat_mode = playlist_sequence_->repeat_mode();
   PlaylistSequence::ShuffleMode shuffle_mode =
@@ -502,33 +897,26 @@ int Playlist::NextVirtualIndex(int i, bool ignore_repeat_track) const {
     return i;
   }
 
+  // Only tracks that are in the filter and not being skipped are candidates,
+  // so start from the first of those after i.
+  const QVector<int>& navigable = NavigableVirtualIndices();
+  QVector<int>::const_iterator it =
+      std::upper_bound(navigable.begin(), navigable.end(), i);
+
   // If we're not bothered about whether a song is on the same album then
   // return the next virtual index, whatever it is.
   if (!album_only) {
-    ++i;
-
-    // Advance i until we find any track that is in the filter, skipping
-    // the selected to be skipped
-    while (i < virtual_items_.count() &&
-           (!FilterContainsVirtualIndex(i) ||
-            item_at(virtual_items_[i])->GetShouldSkip())) {
-      ++i;
-    }
-    return i;
+    return it == navigable.end() ? virtual_items_.count() : *it;
   }
 
   // We need to advance i until we get something else on the same album
   Song last_song = current_item_metadata();
-  for (int j = i + 1; j < virtual_items_.count(); ++j) {
-    if (item_at(virtual_items_[j])->GetShouldSkip()) {
-      continue;
-    }
-    Song this_song = item_at(virtual_items_[j])->Metadata();
+  for (; it != navigable.end(); ++it) {
+    Song this_song = item_at(virtual_items_[*it])->Metadata();
     if (((last_song.is_compilation() && this_song.is_compilation()) ||
          last_song.effective_albumartist() == this_song.effective_albumartist()) &&
-        last_song.album() == this_song.album() &&
-        FilterContainsVirtualIndex(j)) {
-      return j;  // Found one
+        last_song.album() == this_song.album()) {
+      return *it;  // Found one
     }
   }
 
@@ -549,30 +937,26 @@ int Playlist::PreviousVirtualIndex(int i, bool ignore_repeat_track) const {
     return i;
   }
 
+  // Walk backwards from the last candidate before i.
+  const QVector<int>& navigable = NavigableVirtualIndices();
+  QVector<int>::const_iterator it =
+      std::lower_bound(navigable.begin(), navigable.end(), i);
+
   // If we're not bothered about whether a song is on the same album then
   // return the previous virtual index, whatever it is.
   if (!album_only) {
-    --i;
-
-    // Decrement i until we find any track that is in the filter
-    while (i >= 0 && (!FilterContainsVirtualIndex(i) ||
-                      item_at(virtual_items_[i])->GetShouldSkip()))
-      --i;
-    return i;
+    return it == navigable.begin() ? -1 : *(it - 1);
   }
 
   // We need to decrement i until we get something else on the same album
   Song last_song = current_item_metadata();
-  for (int j = i - 1; j >= 0; --j) {
-    if (item_at(virtual_items_[j])->GetShouldSkip()) {
-      continue;
-    }
-    Song this_song = item_at(virtual_items_[j])->Metadata();
+  while (it != navigable.begin()) {
+    --it;
+    Song this_song = item_at(virtual_items_[*it])->Metadata();
     if (((last_song.is_compilation() && this_song.is_compilation()) ||
          last_song.artist() == this_song.artist()) &&
-        last_song.album() == this_song.album() &&
-        FilterContainsVirtualIndex(j)) {
-      return j;  // Found one
+        last_song.album() == this_song.album()) {
+      return *it;  // Found one
     }
   }
 
@@ -674,6 +1058,7 @@ void Playlist::set_current_row(int i, bool is_stopping) {
     // Bring the one we've been asked to play to the start of the list
     virtual_items_.takeAt(virtual_items_.indexOf(i));
     virtual_items_.prepend(i);
+    InvalidateNavigableVirtualIndices();
     current_virtual_index_ = 0;
   } else if (is_shuffled_) {
     current_virtual_index_ = virtual_items_.indexOf(i);
@@ -774,23 +1159,13 @@ bool Playlist::dropMimeData(const QMimeData* data, Qt::DropAction action,
 
   if (const SongMimeData* song_data = qobject_cast<const SongMimeData*>(data)) {
     // Dragged from a library
-    // We want to check if these songs are from the actual local file backend,
-    // if they are we treat them differently.
-    if (song_data->backend &&
-        song_data->backend->songs_table() == Library::kSongsTable)
-      InsertSongItems<LibraryPlaylistItem>(song_data->songs, row, play_now,
-                                           enqueue_now, enqueue_next_now);
-    else if (song_data->backend &&
-             song_data->backend->songs_table() == MagnatuneService::kSongsTable)
-      InsertSongItems<MagnatunePlaylistItem>(song_data->songs, row, play_now,
-                                             enqueue_now, enqueue_next_now);
-    else if (song_data->backend &&
-             song_data->backend->songs_table() == JamendoService::kSongsTable)
-      InsertSongItems<JamendoPlaylistItem>(song_data->songs, row, play_now,
-                                           enqueue_now, enqueue_next_now);
-    else
-      InsertSongItems<SongPlaylistItem>(song_data->songs, row, play_now,
-                                        enqueue_now, enqueue_next_now);
+    if (song_data->song_loader()) {
+      InsertSongsAsync(song_data->backend, song_data->song_loader(), row,
+                       play_now, enqueue_now, enqueue_next_now);
+    } else {
+      InsertSongsFromBackend(song_data->backend, song_data->songs, row,
+                             play_now, enqueue_now, enqueue_next_now);
+    }
   } else if (const InternetMimeData* internet_data =
                  qobject_cast<const InternetMimeData*>(data)) {
     // Dragged from the Internet pane
@@ -880,6 +1255,60 @@ void Playlist::InsertUrls(const QList<QUrl>& urls, int pos, bool play_now,
   inserter->Load(this, pos, play_now, enqueue, enqueue_next, urls);
 }
 
+void Playlist::InsertSongsFromBackend(LibraryBackendInterface* backend,
+                                      const SongList& songs, int pos,
+                                      bool play_now, bool enqueue,
+                                      bool enqueue_next) {
+  // We want to check if these songs are from the actual local file backend,
+  // if they are we treat them differently.
+  if (backend && backend->songs_table() == Library::kSongsTable)
+    InsertSongItems<LibraryPlaylistItem>(songs, pos, play_now, enqueue,
+                                         enqueue_next);
+  else if (backend && backend->songs_table() == MagnatuneService::kSongsTable)
+    InsertSongItems<MagnatunePlaylistItem>(songs, pos, play_now, enqueue,
+                                           enqueue_next);
+  else if (backend && backend->songs_table() == JamendoService::kSongsTable)
+    InsertSongItems<JamendoPlaylistItem>(songs, pos, play_now, enqueue,
+                                         enqueue_next);
+  else
+    InsertSongItems<SongPlaylistItem>(songs, pos, play_now, enqueue,
+                                      enqueue_next);
+}
+
+void Playlist::InsertSongsAsync(LibraryBackendInterface* backend,
+                                std::function<SongList()> loader, int pos,
+                                bool play_now, bool enqueue,
+                                bool enqueue_next) {
+  const int task_id =
+      task_manager_ ? task_manager_->StartTask(tr("Loading songs")) : -1;
+
+  // Remember the row they were dropped above in case it moves before they
+  // arrive.
+  const QPersistentModelIndex before =
+      pos == -1 ? QPersistentModelIndex() : QPersistentModelIndex(index(pos));
+
+  QFuture<SongList> future = TaskExecutor::Instance()->Run<SongList>(
+      TaskExecutor::Lane_Interactive, loader);
+  NewClosure(future, this,
+             SLOT(AsyncSongsLoaded(QFuture<SongList>, LibraryBackendInterface*,
+                                   QPersistentModelIndex, bool, bool, bool,
+                                   int)),
+             future, backend, before, play_now, enqueue, enqueue_next,
+             task_id);
+}
+
+void Playlist::AsyncSongsLoaded(QFuture<SongList> future,
+                                LibraryBackendInterface* backend,
+                                const QPersistentModelIndex& before,
+                                bool play_now, bool enqueue, bool enqueue_next,
+                                int task_id) {
+  if (task_id != -1) task_manager_->SetTaskFinished(task_id);
+
+  const int pos = before.isValid() ? before.row() : -1;
+  InsertSongsFromBackend(backend, future.result(), pos, play_now, enqueue,
+                         enqueue_next);
+}
+
 void Playlist::InsertSmartPlaylist(GeneratorPtr generator, int pos,
                                    bool play_now, bool enqueue,
                                    bool enqueue_next) {
@@ -1017,24 +1446,26 @@ void Playlist::InsertItems(const PlaylistItemList& itemsIn, int pos,
   PlaylistItemList items = itemsIn;
 
   // exercise vetoes
-  SongList songs;
-
-  for (PlaylistItemPtr item : items) {
-    songs << item->Metadata();
-  }
-
-  const int song_count = songs.length();
   QSet<Song> vetoed;
-  for (SongInsertVetoListener* listener : veto_listeners_) {
-    for (const Song& song :
-         listener->AboutToInsertSongs(GetAllSongs(), songs)) {
-      // avoid veto-ing a song multiple times
-      vetoed.insert(song);
+  if (!veto_listeners_.isEmpty()) {
+    SongList songs;
+    songs.reserve(items.count());
+    for (PlaylistItemPtr item : items) {
+      songs << item->Metadata();
     }
-    if (vetoed.count() == song_count) {
-      // all songs were vetoed and there's nothing more to do (there's no need
-      // for an undo step)
-      return;
+
+    const SongList all_songs = GetAllSongs();
+    const int song_count = songs.length();
+    for (SongInsertVetoListener* listener : veto_listeners_) {
+      for (const Song& song : listener->AboutToInsertSongs(all_songs, songs)) {
+        // avoid veto-ing a song multiple times
+        vetoed.insert(song);
+      }
+      if (vetoed.count() == song_count) {
+        // all songs were vetoed and there's nothing more to do (there's no
+        // need for an undo step)
+        return;
+      }
     }
   }
 
@@ -1074,15 +1505,35 @@ void Playlist::InsertItems(const PlaylistItemList& itemsIn, int pos,
 void Playlist::InsertItemsWithoutUndo(const PlaylistItemList& items, int pos,
                                       bool enqueue, bool enqueue_next) {
   if (items.isEmpty()) return;
+  if (!loaded_) Restore();
 
   const int start = pos == -1 ? items_.count() : pos;
   const int end = start + items.count() - 1;
+  if (restoring_ && !is_loading_ && start < restore_row_) {
+    restore_row_ += items.count();
+  }
 
   beginInsertRows(QModelIndex(), start, end);
+
+  // Inserting one at a time into the middle of a big playlist moves the tail
+  // of the list along for every item, so splice the whole lot in at once.
+  if (start == items_.count()) {
+    items_.reserve(items_.count() + items.count());
+    items_.append(items);
+  } else {
+    PlaylistItemList new_items;
+    new_items.reserve(items_.count() + items.count());
+    new_items.append(items_.mid(0, start));
+    new_items.append(items);
+    new_items.append(items_.mid(start));
+    items_.swap(new_items);
+  }
+  virtual_items_.reserve(items_.count());
+
   for (int i = start; i <= end; ++i) {
-    PlaylistItemPtr item = items[i - start];
-    items_.insert(i, item);
+    const PlaylistItemPtr& item = items_[i];
     virtual_items_ << virtual_items_.count();
+    AddToAggregates(item);
 
     if (item->IsLocalLibraryItem()) {
       int id = item->Metadata().id();
@@ -1218,7 +1669,9 @@ void Playlist::UpdateItems(const SongList& songs) {
         } else {
           new_item = PlaylistItemPtr(new SongPlaylistItem(song));
         }
+        RemoveFromAggregates(item);
         items_[i] = new_item;
+        AddToAggregates(new_item);
         emit dataChanged(index(i, 0), index(i, ColumnCount - 1));
         // Also update undo actions
         for (int i = 0; i < undo_stack_->count(); i++) {
@@ -1459,10 +1912,9 @@ QString Playlist::abbreviated_column_name(Column column) {
 void Playlist::sort(int column, Qt::SortOrder order) {
   if (ignore_sorting_) return;
 
-  PlaylistItemList new_items(items_);
-  PlaylistItemList::iterator begin = new_items.begin();
+  int first_row = 0;
   if (dynamic_playlist_ && current_item_index_.isValid())
-    begin += current_item_index_.row() + 1;
+    first_row = current_item_index_.row() + 1;
 
   QSettings s;
   s.beginGroup(Playlist::kSettingsGroup);
@@ -1479,33 +1931,40 @@ void Playlist::sort(int column, Qt::SortOrder order) {
   }
   s.endGroup();
 
+  // Some columns are sorted by more than one key, most significant first.
+  QList<RowComparator> keys;
   if (column == Column_Album) {
     // When sorting by album, also take into account discs and tracks.
-    std::stable_sort(begin, new_items.end(),
-                     std::bind(&Playlist::CompareItems, Column_Track, order, _1,
-                               _2, prefixes));
-    std::stable_sort(begin, new_items.end(),
-                     std::bind(&Playlist::CompareItems, Column_Disc, order, _1,
-                               _2, prefixes));
-    std::stable_sort(begin, new_items.end(),
-                     std::bind(&Playlist::CompareItems, Column_Album, order, _1,
-                               _2, prefixes));
+    keys << CompareColumn(Column_Album, items_, prefixes)
+         << CompareColumn(Column_Disc, items_, prefixes)
+         << CompareColumn(Column_Track, items_, prefixes);
   } else if (column == Column_Filename) {
     // When sorting by full paths we also expect a hierarchical order. This
     // returns a breath-first ordering of paths.
-    std::stable_sort(begin, new_items.end(),
-                     std::bind(&Playlist::CompareItems, Column_Filename, order,
-                               _1, _2, prefixes));
-    std::stable_sort(begin, new_items.end(),
-                     std::bind(&Playlist::ComparePathDepths, order, _1, _2));
+    keys << CompareBy<int>(items_,
+                           [](const PlaylistItemPtr& item) {
+                             return item->Url().path().count('/');
+                           })
+         << CompareColumn(Column_Filename, items_, prefixes);
   } else {
-    std::stable_sort(
-        begin, new_items.end(),
-        std::bind(&Playlist::CompareItems, column, order, _1, _2, prefixes));
+    keys << CompareColumn(column, items_, prefixes);
   }
 
-  undo_stack_->push(
-      new PlaylistUndoCommands::SortItems(this, column, order, new_items));
+  const bool descending = order == Qt::DescendingOrder;
+  RowComparator compare = [&keys, descending](int a, int b) {
+    for (const RowComparator& key : keys) {
+      const int ret = descending ? key(b, a) : key(a, b);
+      if (ret != 0) return ret;
+    }
+    return 0;
+  };
+
+  std::vector<int> rows(items_.count());
+  std::iota(rows.begin(), rows.end(), 0);
+  SortRows(rows.begin() + first_row, rows.end(), compare);
+
+  undo_stack_->push(new PlaylistUndoCommands::SortItems(
+      this, column, order, QVector<int>::fromStdVector(rows)));
 
   ReshuffleIndices();
 }
@@ -1550,30 +2009,88 @@ void Playlist::SetCurrentIsPaused(bool paused) {
 }
 
 void Playlist::Save() const {
-  if (!backend_ || is_loading_) return;
+  if (!backend_ || is_loading_ || !loaded_) return;
+  if (restoring_) {
+    // Saving now would throw away the items we haven't loaded yet.
+    save_after_restore_ = true;
+    return;
+  }
 
   backend_->SavePlaylistAsync(id_, items_, last_played_row(),
                               dynamic_playlist_);
 }
 
 void Playlist::Restore() {
+  loaded_ = true;
   if (!backend_) return;
 
   items_.clear();
   virtual_items_.clear();
+  InvalidateNavigableVirtualIndices();
   library_items_by_id_.clear();
+  ClearAggregates();
 
   cancel_restore_ = false;
-  QFuture<QList<PlaylistItemPtr>> future =
-      QtConcurrent::run(backend_, &PlaylistBackend::GetPlaylistItems, id_);
-  NewClosure(future, this, SLOT(ItemsLoaded(QFuture<PlaylistItemList>)),
-             future);
+  restoring_ = true;
+  restore_row_ = 0;
+  restore_after_position_ = -1;
+  save_after_restore_ = false;
+
+  // Get the first few items on their own so there's something to look at
+  // quickly, then fetch the rest in bigger pages.
+  RestoreNextPage(kRestoreFirstPageSize);
 }
 
-void Playlist::ItemsLoaded(QFuture<PlaylistItemList> future) {
-  if (cancel_restore_) return;
+void Playlist::Unload() {
+  if (!loaded_ || restoring_ || !backend_) return;
+
+  saved_summary_.item_count = items_.count();
+  saved_summary_.length_nanosec = GetTotalLength();
 
-  PlaylistItemList items = future.result();
+  // Everything is already in the database, so don't save the empty playlist.
+  is_loading_ = true;
+  RemoveItemsWithoutUndo(0, items_.count());
+  is_loading_ = false;
+  undo_stack_->clear();
+
+  loaded_ = false;
+}
+
+int Playlist::item_count() const {
+  if (loaded_ && !restoring_) return items_.count();
+  return qMax(items_.count(), saved_summary_.item_count);
+}
+
+void Playlist::set_restore_in_foreground(bool foreground) {
+  restore_in_foreground_ = foreground;
+  if (foreground) ContinueRestore();
+}
+
+void Playlist::RestoreNextPage(int limit) {
+  restore_page_pending_ = true;
+  QFuture<PlaylistBackend::ItemPage> future =
+      TaskExecutor::Instance()->Run<PlaylistBackend::ItemPage>(
+          TaskExecutor::Lane_Interactive,
+          std::bind(&PlaylistBackend::GetPlaylistItemPage, backend_, id_,
+                    restore_after_position_, limit));
+  NewClosure(future, this,
+             SLOT(ItemPageLoaded(QFuture<PlaylistBackend::ItemPage>)), future);
+}
+
+void Playlist::ContinueRestore() {
+  if (!restoring_ || restore_page_pending_ || cancel_restore_) return;
+  RestoreNextPage(kRestorePageSize);
+}
+
+void Playlist::ItemPageLoaded(QFuture<PlaylistBackend::ItemPage> future) {
+  restore_page_pending_ = false;
+  if (cancel_restore_) {
+    restoring_ = false;
+    return;
+  }
+
+  PlaylistBackend::ItemPage page = future.result();
+  PlaylistItemList& items = page.items;
 
   // backend returns empty elements for library items which it couldn't
   // match (because they got deleted); we don't need those
@@ -1586,9 +2103,30 @@ void Playlist::ItemsLoaded(QFuture<PlaylistItemList> future) {
     }
   }
 
+  // These items were already in the playlist, so there's nothing to veto and
+  // nothing to undo.
+  const int row = qMin(restore_row_, items_.count());
   is_loading_ = true;
-  InsertItems(items, 0);
+  InsertItemsWithoutUndo(items, row);
   is_loading_ = false;
+  restore_row_ = row + items.count();
+
+  restore_after_position_ = page.last_position;
+  if (!page.finished) {
+    if (restore_in_foreground_) {
+      ContinueRestore();
+    } else {
+      QTimer::singleShot(kBackgroundRestoreDelayMsec, this,
+                         SLOT(ContinueRestore()));
+    }
+    return;
+  }
+
+  FinishRestore();
+}
+
+void Playlist::FinishRestore() {
+  restoring_ = false;
 
   PlaylistBackend::Playlist p = backend_->GetPlaylist(id_);
 
@@ -1606,9 +2144,9 @@ void Playlist::ItemsLoaded(QFuture<PlaylistItemList> future) {
       if (p.dynamic_backend == library_->songs_table())
         backend = library_;
       else if (p.dynamic_backend == MagnatuneService::kSongsTable)
-        backend = InternetModel::Service<MagnatuneService>()->library_backend();
+        backend = ServiceLibraryBackend<MagnatuneService>();
       else if (p.dynamic_backend == JamendoService::kSongsTable)
-        backend = InternetModel::Service<JamendoService>()->library_backend();
+        backend = ServiceLibraryBackend<JamendoService>();
 
       if (backend) {
         gen->set_library(backend);
@@ -1625,7 +2163,14 @@ void Playlist::ItemsLoaded(QFuture<PlaylistItemList> future) {
 
   // should we gray out deleted songs asynchronously on startup?
   if (s.value("greyoutdeleted", false).toBool()) {
-    QtConcurrent::run(this, &Playlist::InvalidateDeletedSongs);
+    TaskExecutor::Instance()->Run<void>(
+        TaskExecutor::Lane_Bulk,
+        std::bind(&Playlist::InvalidateDeletedSongs, this));
+  }
+
+  if (save_after_restore_) {
+    save_after_restore_ = false;
+    Save();
   }
 }
 
@@ -1704,6 +2249,9 @@ PlaylistItemList Playlist::RemoveItemsWithoutUndo(int row, int count) {
   if (row < 0 || row >= items_.size() || row + count > items_.size()) {
     return PlaylistItemList();
   }
+  if (restoring_ && row < restore_row_) {
+    restore_row_ -= qMin(count, restore_row_ - row);
+  }
   beginRemoveRows(QModelIndex(), row, row + count - 1);
 
   // Remove items
@@ -1711,6 +2259,7 @@ PlaylistItemList Playlist::RemoveItemsWithoutUndo(int row, int count) {
   for (int i = 0; i < count; ++i) {
     PlaylistItemPtr item(items_.takeAt(row));
     ret << item;
+    RemoveFromAggregates(item);
 
     if (item->IsLocalLibraryItem()) {
       int id = item->Metadata().id();
@@ -1731,6 +2280,7 @@ PlaylistItemList Playlist::RemoveItemsWithoutUndo(int row, int count) {
       ++it;
     ++i;
   }
+  InvalidateNavigableVirtualIndices();
 
   // Reset current_virtual_index_
   if (current_row() == -1)
@@ -1891,6 +2441,9 @@ void Playlist::UpdatePlayCountPoint(qint64 seek_point_nanosec) {
 void Playlist::Clear() {
   // If loading songs from session restore async, don't insert them
   cancel_restore_ = true;
+  restoring_ = false;
+  // Whatever was saved is about to be replaced anyway.
+  loaded_ = true;
 
   const int count = items_.count();
 
@@ -1964,18 +2517,13 @@ void Playlist::RemoveItemsNotInQueue() {
 }
 
 void Playlist::ReloadItems(const QList<int>& rows) {
+  PlaylistItemList items;
   for (int row : rows) {
-    PlaylistItemPtr item = item_at(row);
-
-    item->Reload();
-
-    if (row == current_row()) {
-      InformOfCurrentSongChange();
-    } else {
-      emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
-    }
+    items << item_at(row);
   }
 
+  ApplyReloadedSongs(rows, items, ReloadItemSongs(library_, items));
+
   Save();
 }
 
@@ -2022,7 +2570,8 @@ void Playlist::SongInsertVetoListenerDestroyed() {
 }
 
 void Playlist::Shuffle() {
-  PlaylistItemList new_items(items_);
+  QVector<int> permutation(items_.count());
+  std::iota(permutation.begin(), permutation.end(), 0);
 
   int begin = 0;
   if (dynamic_playlist_ && current_item_index_.isValid())
@@ -2032,10 +2581,10 @@ void Playlist::Shuffle() {
   for (int i = begin; i < count; ++i) {
     int new_pos = i + (rand() % (count - i));
 
-    std::swap(new_items[i], new_items[new_pos]);
+    std::swap(permutation[i], permutation[new_pos]);
   }
 
-  undo_stack_->push(new PlaylistUndoCommands::ShuffleItems(this, new_items));
+  undo_stack_->push(new PlaylistUndoCommands::ShuffleItems(this, permutation));
 }
 
 namespace {
@@ -2054,6 +2603,7 @@ void Playlist::ReshuffleIndices() {
   if (!playlist_sequence_) {
     return;
   }
+  InvalidateNavigableVirtualIndices();
 
   if (playlist_sequence_->shuffle_mode() == PlaylistSequence::Shuffle_Off) {
     // No shuffling - sort the virtual item list normally.
@@ -2145,12 +2695,103 @@ SongList Playlist::GetAllSongs() const {
 PlaylistItemList Playlist::GetAllItems() const { return items_; }
 
 quint64 Playlist::GetTotalLength() const {
-  quint64 ret = 0;
-  for (PlaylistItemPtr item : items_) {
-    quint64 length = item->Metadata().length_nanosec();
-    if (length > 0) ret += length;
+  if (!loaded_) return saved_summary_.length_nanosec;
+  return total_length_nanosec_;
+}
+
+qint64 Playlist::GetTotalFilesize() const { return total_filesize_; }
+
+quint64 Playlist::GetRangeLength(int first, int last) const {
+  first = qMax(0, first);
+  last = qMin(items_.count() - 1, last);
+  if (first > last) return 0;
+
+  UpdatePrefixSums();
+  return length_prefix_[last + 1] - length_prefix_[first];
+}
+
+qint64 Playlist::GetRangeFilesize(int first, int last) const {
+  first = qMax(0, first);
+  last = qMin(items_.count() - 1, last);
+  if (first > last) return 0;
+
+  UpdatePrefixSums();
+  return filesize_prefix_[last + 1] - filesize_prefix_[first];
+}
+
+void Playlist::AddToAggregates(const PlaylistItemPtr& item) {
+  Aggregate& aggregate = item_aggregates_[item.get()];
+  if (aggregate.count_ == 0) {
+    const Song& song = item->Metadata();
+    aggregate.length_nanosec_ = qMax(0ll, song.length_nanosec());
+    aggregate.filesize_ = qMax(0, song.filesize());
   }
-  return ret;
+  aggregate.count_++;
+
+  total_length_nanosec_ += aggregate.length_nanosec_;
+  total_filesize_ += aggregate.filesize_;
+  prefix_sums_dirty_ = true;
+}
+
+void Playlist::RemoveFromAggregates(const PlaylistItemPtr& item) {
+  auto it = item_aggregates_.find(item.get());
+  if (it == item_aggregates_.end()) return;
+
+  total_length_nanosec_ -= it->length_nanosec_;
+  total_filesize_ -= it->filesize_;
+  if (--it->count_ == 0) item_aggregates_.erase(it);
+  prefix_sums_dirty_ = true;
+}
+
+void Playlist::ClearAggregates() {
+  item_aggregates_.clear();
+  total_length_nanosec_ = 0;
+  total_filesize_ = 0;
+  prefix_sums_dirty_ = true;
+}
+
+void Playlist::UpdateAggregates(const QModelIndex& top_left,
+                                const QModelIndex& bottom_right) {
+  const int first = qMax(0, top_left.row());
+  const int last = qMin(items_.count() - 1, bottom_right.row());
+
+  for (int row = first; row <= last; ++row) {
+    const PlaylistItemPtr& item = items_[row];
+    auto it = item_aggregates_.find(item.get());
+
+    if (it == item_aggregates_.end()) continue;
+
+    const Song& song = item->Metadata();
+    const quint64 length = qMax(0ll, song.length_nanosec());
+    const qint64 filesize = qMax(0, song.filesize());
+    if (length == it->length_nanosec_ && filesize == it->filesize_) continue;
+
+    total_length_nanosec_ += (length - it->length_nanosec_) * it->count_;
+    total_filesize_ += (filesize - it->filesize_) * it->count_;
+    it->length_nanosec_ = length;
+    it->filesize_ = filesize;
+    prefix_sums_dirty_ = true;
+  }
+}
+
+void Playlist::InvalidatePrefixSums() { prefix_sums_dirty_ = true; }
+
+void Playlist::UpdatePrefixSums() const {
+  if (!prefix_sums_dirty_) return;
+
+  const int count = items_.count();
+  length_prefix_.resize(count + 1);
+  filesize_prefix_.resize(count + 1);
+  length_prefix_[0] = 0;
+  filesize_prefix_[0] = 0;
+
+  for (int i = 0; i < count; ++i) {
+    const Aggregate aggregate = item_aggregates_.value(items_[i].get());
+    length_prefix_[i + 1] = length_prefix_[i] + aggregate.length_nanosec_;
+    filesize_prefix_[i + 1] = filesize_prefix_[i] + aggregate.filesize_;
+  }
+
+  prefix_sums_dirty_ = false;
 }
 
 PlaylistItemList Playlist::library_items_by_id(int id) const {
@@ -2209,23 +2850,32 @@ void Playlist::InformOfCurrentSongChange() {
 }
 
 void Playlist::InvalidateDeletedSongs() {
-  QList<int> invalidated_rows;
-
-  for (int row = 0; row < items_.count(); ++row) {
-    PlaylistItemPtr item = items_[row];
-    Song song = item->Metadata();
+  const PlaylistItemList items = items_;
 
+  QList<int> local_rows;
+  QStringList paths;
+  for (int row = 0; row < items.count(); ++row) {
+    const Song song = items[row]->Metadata();
     if (!song.is_stream()) {
-      bool exists = QFile::exists(song.url().toLocalFile());
-
-      if (!exists && !item->HasForegroundColor(kInvalidSongPriority)) {
-        // gray out the song if it's not there
-        item->SetForegroundColor(kInvalidSongPriority, kInvalidSongColor);
-        invalidated_rows.append(row);
-      } else if (exists && item->HasForegroundColor(kInvalidSongPriority)) {
-        item->RemoveForegroundColor(kInvalidSongPriority);
-        invalidated_rows.append(row);
-      }
+      local_rows << row;
+      paths << song.url().toLocalFile();
+    }
+  }
+
+  const QVector<bool> exists = FileExistenceCache::Instance()->Exists(paths);
+
+  QList<int> invalidated_rows;
+  for (int i = 0; i < local_rows.count(); ++i) {
+    const int row = local_rows[i];
+    PlaylistItemPtr item = items[row];
+
+    if (!exists[i] && !item->HasForegroundColor(kInvalidSongPriority)) {
+      // gray out the song if it's not there
+      item->SetForegroundColor(kInvalidSongPriority, kInvalidSongColor);
+      invalidated_rows.append(row);
+    } else if (exists[i] && item->HasForegroundColor(kInvalidSongPriority)) {
+      item->RemoveForegroundColor(kInvalidSongPriority);
+      invalidated_rows.append(row);
     }
   }
 
@@ -2247,42 +2897,25 @@ void Playlist::RemoveDeletedSongs() {
   removeRows(rows_to_remove);
 }
 
-struct SongSimilarHash {
-  long operator()(const Song& song) const { return HashSimilar(song); }
-};
-
-struct SongSimilarEqual {
-  long operator()(const Song& song1, const Song& song2) const {
-    return song1.IsSimilar(song2);
-  }
-};
-
 void Playlist::RemoveDuplicateSongs() {
   QList<int> rows_to_remove;
-  unordered_map<Song, int, SongSimilarHash, SongSimilarEqual> unique_songs;
+  // Maps each DuplicateKey to the row of the copy that's being kept.
+  QHash<qint64, int> unique_rows;
 
   for (int row = 0; row < items_.count(); ++row) {
-    PlaylistItemPtr item = items_[row];
-    const Song& song = item->Metadata();
-
-    bool found_duplicate = false;
-
-    auto uniq_song_it = unique_songs.find(song);
-    if (uniq_song_it != unique_songs.end()) {
-      const Song& uniq_song = uniq_song_it->first;
-
-      if (song.bitrate() > uniq_song.bitrate()) {
-        rows_to_remove.append(unique_songs[uniq_song]);
-        unique_songs.erase(uniq_song);
-        unique_songs.insert(std::make_pair(song, row));
-      } else {
-        rows_to_remove.append(row);
-      }
-      found_duplicate = true;
-    }
-
-    if (!found_duplicate) {
-      unique_songs.insert(std::make_pair(song, row));
+    const Song& song = items_[row]->Metadata();
+    const qint64 key = song.DuplicateKey();
+    if (!key) continue;
+
+    auto it = unique_rows.find(key);
+    if (it == unique_rows.end()) {
+      unique_rows.insert(key, row);
+    } else if (song.bitrate() > items_[*it]->Metadata().bitrate()) {
+      // Keep the better quality copy
+      rows_to_remove.append(*it);
+      *it = row;
+    } else {
+      rows_to_remove.append(row);
     }
   }
 
@@ -18,9 +18,14 @@
 #ifndef PLAYLIST_H
 #define PLAYLIST_H
 
+#include <functional>
+
 #include <QAbstractItemModel>
+#include <QHash>
 #include <QList>
+#include <QVector>
 
+#include "playlistbackend.h"
 #include "playlistitem.h"
 #include "playlistsequence.h"
 #include "core/tagreaderclient.h"
@@ -28,7 +33,7 @@
 #include "smartplaylists/generator_fwd.h"
 
 class LibraryBackend;
-class PlaylistBackend;
+class LibraryBackendInterface;
 class PlaylistFilter;
 class Queue;
 class InternetModel;
@@ -163,6 +168,12 @@ class Playlist : public QAbstractListModel {
 
   static const int kUndoStackSize;
   static const int kUndoItemLimit;
+  static const int kItemPoolBlockSize;
+
+  static const int kRestoreFirstPageSize;
+  static const int kRestorePageSize;
+  static const int kBackgroundRestoreDelayMsec;
+  static const int kReloadBatchDelayMsec;
 
   static const qint64 kMinScrobblePointNsecs;
   static const qint64 kMaxScrobblePointNsecs;
@@ -179,7 +190,16 @@ class Playlist : public QAbstractListModel {
 
   // Persistence
   void Save() const;
+  // Playlists don't load their items until something asks for them.  Restore
+  // loads them (again) from the database, Unload throws them away after
+  // they've been saved.
   void Restore();
+  void Unload();
+  bool is_loaded() const { return loaded_; }
+  bool is_restoring() const { return restoring_; }
+  // Playlists that aren't visible or playing restore their remaining items
+  // slowly so they don't hold up the one the user is looking at.
+  void set_restore_in_foreground(bool foreground);
 
   // Accessors
   QSortFilterProxyModel* proxy() const;
@@ -220,6 +240,17 @@ class Playlist : public QAbstractListModel {
   SongList GetAllSongs() const;
   PlaylistItemList GetAllItems() const;
   quint64 GetTotalLength() const;  // in seconds
+  qint64 GetTotalFilesize() const;
+  // Totals for the rows first to last inclusive.  These take constant time
+  // unless the playlist has changed since the last call.
+  quint64 GetRangeLength(int first, int last) const;
+  qint64 GetRangeFilesize(int first, int last) const;
+
+  // Like rowCount(), but still right when the items haven't been loaded yet.
+  int item_count() const;
+  void set_saved_summary(const PlaylistBackend::Summary& summary) {
+    saved_summary_ = summary;
+  }
 
   void set_sequence(PlaylistSequence* v);
   PlaylistSequence* sequence() const { return playlist_sequence_; }
@@ -379,6 +410,10 @@ signals:
   int NextVirtualIndex(int i, bool ignore_repeat_track) const;
   int PreviousVirtualIndex(int i, bool ignore_repeat_track) const;
   bool FilterContainsVirtualIndex(int i) const;
+  // Sorted virtual indices of the items that are in the filter and not
+  // marked to be skipped.  Rebuilt lazily after anything that could change
+  // it, so stepping through the playlist is a binary search.
+  const QVector<int>& NavigableVirtualIndices() const;
   void TurnOnDynamicPlaylist(smart_playlists::GeneratorPtr gen);
 
   void InsertInternetItems(const InternetModel* model,
@@ -388,6 +423,14 @@ signals:
   template <typename T>
   void InsertSongItems(const SongList& songs, int pos, bool play_now,
                        bool enqueue, bool enqueue_next = false);
+  // Picks the kind of item to create from the table the songs came from.
+  void InsertSongsFromBackend(LibraryBackendInterface* backend,
+                              const SongList& songs, int pos, bool play_now,
+                              bool enqueue, bool enqueue_next);
+  // Runs the loader in the background and inserts the songs it finds.
+  void InsertSongsAsync(LibraryBackendInterface* backend,
+                        std::function<SongList()> loader, int pos,
+                        bool play_now, bool enqueue, bool enqueue_next);
 
   void InsertDynamicItems(int count);
 
@@ -403,6 +446,9 @@ signals:
 
   void RemoveItemsNotInQueue();
 
+  void RestoreNextPage(int limit);
+  void FinishRestore();
+
   // Removes rows with given indices from this playlist.
   bool removeRows(QList<int>& rows);
 
@@ -410,13 +456,46 @@ signals:
   void TracksAboutToBeDequeued(const QModelIndex&, int begin, int end);
   void TracksDequeued();
   void TracksEnqueued(const QModelIndex&, int begin, int end);
+  void InvalidateNavigableVirtualIndices();
+  void UpdateAggregates(const QModelIndex& top_left,
+                        const QModelIndex& bottom_right);
+  void InvalidatePrefixSums();
   void QueueLayoutChanged();
   void SongSaveComplete(TagReaderReply* reply,
                         const QPersistentModelIndex& index);
-  void ItemReloadComplete(const QPersistentModelIndex& index);
-  void ItemsLoaded(QFuture<PlaylistItemList> future);
+  void ReloadPendingItems();
+  void PendingItemsReloaded(QFuture<SongList> future,
+                            const QList<QPersistentModelIndex>& indexes,
+                            const PlaylistItemList& items);
+  void ItemPageLoaded(QFuture<PlaylistBackend::ItemPage> future);
+  void AsyncSongsLoaded(QFuture<SongList> future,
+                        LibraryBackendInterface* backend,
+                        const QPersistentModelIndex& before, bool play_now,
+                        bool enqueue, bool enqueue_next, int task_id);
+  void ContinueRestore();
   void SongInsertVetoListenerDestroyed();
 
+ private:
+  // Stores the songs read by a batched reload and tells the views, with a
+  // single dataChanged covering all the rows.
+  void ApplyReloadedSongs(const QList<int>& rows, const PlaylistItemList& items,
+                          const SongList& songs);
+
+  // What one item adds to the running totals.  The same item can be in the
+  // playlist more than once, so they're counted.
+  struct Aggregate {
+    Aggregate() : length_nanosec_(0), filesize_(0), count_(0) {}
+
+    quint64 length_nanosec_;
+    qint64 filesize_;
+    int count_;
+  };
+
+  void AddToAggregates(const PlaylistItemPtr& item);
+  void RemoveFromAggregates(const PlaylistItemPtr& item);
+  void ClearAggregates();
+  void UpdatePrefixSums() const;
+
  private:
   bool is_loading_;
   PlaylistFilter* proxy_;
@@ -434,10 +513,23 @@ signals:
   PlaylistItemList items_;
   QList<int> virtual_items_;  // Contains the indices into items_ in the order
                               // that they will be played.
+  mutable QVector<int> navigable_virtual_indices_;
+  mutable bool navigable_virtual_indices_dirty_;
   // A map of library ID to playlist item - for fast lookups when library
   // items change.
   QMultiMap<int, PlaylistItemPtr> library_items_by_id_;
 
+  // Running totals kept up to date as items are added, removed and changed,
+  // so the status bar doesn't have to walk the whole playlist.
+  QHash<const PlaylistItem*, Aggregate> item_aggregates_;
+  quint64 total_length_nanosec_;
+  qint64 total_filesize_;
+  // Built on demand for selection summaries.  Entry i is the total of the
+  // first i rows.
+  mutable QVector<quint64> length_prefix_;
+  mutable QVector<qint64> filesize_prefix_;
+  mutable bool prefix_sums_dirty_;
+
   QPersistentModelIndex current_item_index_;
   QPersistentModelIndex last_played_item_index_;
   QPersistentModelIndex stop_after_;
@@ -471,6 +563,21 @@ signals:
 
   // Cancel async restore if songs are already replaced
   bool cancel_restore_;
+
+  bool loaded_;
+  PlaylistBackend::Summary saved_summary_;
+  bool restoring_;
+  // Where the next restored page goes, so anything added in the meantime
+  // stays after the saved items.
+  int restore_row_;
+  bool restore_page_pending_;
+  bool restore_in_foreground_;
+  qint64 restore_after_position_;
+  // Set if something tried to save the playlist before it finished restoring
+  mutable bool save_after_restore_;
+
+  // Rows whose tags were just saved, waiting to be reloaded in one batch
+  QList<QPersistentModelIndex> pending_reloads_;
 };
 
 // QDataStream& operator <<(QDataStream&, const Playlist*);
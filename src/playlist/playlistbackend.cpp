@@ -17,6 +17,7 @@
 
 #include "playlistbackend.h"
 
+#include <algorithm>
 #include <memory>
 #include <functional>
 
@@ -24,6 +25,8 @@
 #include <QHash>
 #include <QMutexLocker>
 #include <QSqlQuery>
+#include <QTimer>
+#include <QVector>
 #include <QtDebug>
 
 #include "core/application.h"
@@ -32,6 +35,8 @@
 #include "core/scopedtransaction.h"
 #include "core/song.h"
 #include "library/librarybackend.h"
+#include "library/libraryplaylistitem.h"
+#include "library/libraryquery.h"
 #include "library/sqlrow.h"
 #include "playlist/songplaylistitem.h"
 #include "playlistparsers/cueparser.h"
@@ -43,9 +48,30 @@ using std::shared_ptr;
 using smart_playlists::GeneratorPtr;
 
 const int PlaylistBackend::kSongTableJoins = 4;
+const int PlaylistBackend::kSaveDelayMsec = 500;
+const qint64 PlaylistBackend::kPositionStep = 1024;
+
+namespace {
+QString InsertItemSql() {
+  return "INSERT INTO playlist_items"
+         " (playlist, position, type, library_id, radio_service, " +
+         Song::kColumnSpec +
+         ")"
+         " VALUES (:playlist, :position, :type, :library_id, :radio_service, " +
+         Song::kBindSpec + ")";
+}
+}  // namespace
 
 PlaylistBackend::PlaylistBackend(Application* app, QObject* parent)
-    : QObject(parent), app_(app), db_(app_->database()) {}
+    : QObject(parent),
+      app_(app),
+      db_(app_->database()),
+      save_scheduled_(false),
+      save_timer_(new QTimer(this)) {
+  save_timer_->setSingleShot(true);
+  save_timer_->setInterval(kSaveDelayMsec);
+  connect(save_timer_, SIGNAL(timeout()), SLOT(FlushPendingSaves()));
+}
 
 PlaylistBackend::PlaylistList PlaylistBackend::GetAllPlaylists() {
   return GetPlaylists(GetPlaylists_All);
@@ -135,7 +161,71 @@ PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(int id) {
   return p;
 }
 
-QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
+QHash<int, PlaylistBackend::Summary> PlaylistBackend::GetPlaylistSummaries() {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QHash<int, Summary> ret;
+
+  QSqlQuery q(db);
+  q.prepare("SELECT ROWID, item_count, length_nanosec FROM playlists");
+  q.exec();
+  if (db_->CheckErrors(q)) return ret;
+
+  while (q.next()) {
+    Summary& summary = ret[q.value(0).toInt()];
+    summary.item_count = q.value(1).toInt();
+    summary.length_nanosec = q.value(2).toLongLong();
+  }
+
+  return ret;
+}
+
+PlaylistBackend::Summary PlaylistBackend::GetPlaylistSummary(int id) {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(db_->PreparedQuery(
+      db,
+      "SELECT item_count, length_nanosec FROM playlists WHERE ROWID = :id"));
+  q.bindValue(":id", id);
+  q.exec();
+
+  Summary ret;
+  if (db_->CheckErrors(q) || !q.next()) return ret;
+
+  ret.item_count = q.value(0).toInt();
+  ret.length_nanosec = q.value(1).toLongLong();
+  return ret;
+}
+
+QSet<int> PlaylistBackend::FindPlaylistsWithSongs(const QString& query) {
+  QSet<int> ret;
+
+  const QString terms = LibraryQuery::FtsPrefixTerms(query);
+  if (terms.isEmpty()) return ret;
+
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectForReading());
+
+  QSqlQuery q(db);
+  q.prepare(
+      "SELECT DISTINCT p.playlist"
+      " FROM playlist_items_fts AS fts"
+      " JOIN playlist_items AS p ON p.ROWID = fts.ROWID"
+      " WHERE fts.playlist_items_fts MATCH :terms");
+  q.bindValue(":terms", terms);
+  q.exec();
+  if (db_->CheckErrors(q)) return ret;
+
+  while (q.next()) {
+    ret << q.value(0).toInt();
+  }
+  return ret;
+}
+
+QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist, qint64 after_position,
+                                           int limit) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
@@ -150,7 +240,7 @@ QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
                   "       p.ROWID, " +
                   Song::JoinSpec("p") +
                   ","
-                  "       p.type, p.radio_service"
+                  "       p.type, p.radio_service, p.position"
                   " FROM playlist_items AS p"
                   " LEFT JOIN songs"
                   "    ON p.library_id = songs.ROWID"
@@ -159,11 +249,22 @@ QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
                   " LEFT JOIN jamendo.songs AS jamendo_songs"
                   "    ON p.library_id = jamendo_songs.ROWID"
                   " WHERE p.playlist = :playlist";
+  if (limit != -1) {
+    query += " AND p.position > :after_position";
+  }
+  query += " ORDER BY p.position";
+  if (limit != -1) {
+    query += " LIMIT :limit";
+  }
   QSqlQuery q(db);
   // Forward iterations only may be faster
   q.setForwardOnly(true);
   q.prepare(query);
   q.bindValue(":playlist", playlist);
+  if (limit != -1) {
+    q.bindValue(":after_position", after_position);
+    q.bindValue(":limit", limit);
+  }
   q.exec();
 
   return q;
@@ -180,11 +281,67 @@ QList<PlaylistItemPtr> PlaylistBackend::GetPlaylistItems(int playlist) {
   std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
   QList<PlaylistItemPtr> playlistitems;
   while (q.next()) {
-    playlistitems << NewPlaylistItemFromQuery(SqlRow(q), state_ptr);
+    playlistitems << NewPlaylistItemFromQuery(SqlRow::Current(q), state_ptr);
   }
   return playlistitems;
 }
 
+PlaylistBackend::ItemPage PlaylistBackend::GetPlaylistItemPage(
+    int playlist, qint64 after_position, int limit) {
+  if (after_position == -1) {
+    // A playlist that's being loaded again might still have a save waiting.
+    PendingSave save;
+    bool has_save = false;
+    {
+      QMutexLocker l(&pending_saves_mutex_);
+      if (pending_saves_.contains(playlist)) {
+        save = pending_saves_.take(playlist);
+        has_save = true;
+      }
+    }
+    if (has_save) {
+      SavePlaylist(playlist, save.items_, save.last_played_, save.dynamic_);
+    }
+  }
+
+  ItemPage page;
+  page.last_position = after_position;
+  page.finished = true;
+
+  QSqlQuery q = GetPlaylistRows(playlist, after_position, limit);
+  if (db_->CheckErrors(q)) return page;
+
+  // p.ROWID comes straight after the song tables that are joined in, and
+  // p.position is the last column.
+  const int table_columns = Song::kColumns.count() + 1;
+  const int rowid_column = table_columns * (kSongTableJoins - 1);
+  const int position_column = table_columns * kSongTableJoins + 2;
+
+  QList<SavedRow> rows;
+  std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
+  while (q.next()) {
+    const int rowid = q.value(rowid_column).toInt();
+    page.last_position = q.value(position_column).toLongLong();
+
+    PlaylistItemPtr item =
+        NewPlaylistItemFromQuery(SqlRow::Current(q), state_ptr);
+    page.items << item;
+    rows << SavedRow(item, rowid, page.last_position);
+  }
+
+  page.finished = page.items.count() < limit;
+
+  // Remember what's in the database so the next save only writes the
+  // difference.
+  QMutexLocker l(&saved_playlists_mutex_);
+  SavedPlaylist& saved = saved_playlists_[playlist];
+  if (after_position == -1) saved = SavedPlaylist();
+  saved.rows_ << rows;
+  saved.complete_ = page.finished;
+
+  return page;
+}
+
 QList<Song> PlaylistBackend::GetPlaylistSongs(int playlist) {
   QSqlQuery q = GetPlaylistRows(playlist);
   // Note that as this only accesses the query, not the db, we don't need the
@@ -196,7 +353,25 @@ QList<Song> PlaylistBackend::GetPlaylistSongs(int playlist) {
   std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
   QList<Song> songs;
   while (q.next()) {
-    songs << NewSongFromQuery(SqlRow(q), state_ptr);
+    songs << NewSongFromQuery(SqlRow::Current(q), state_ptr);
+  }
+  return songs;
+}
+
+QList<Song> PlaylistBackend::GetPlaylistSongPage(int playlist,
+                                                 qint64* after_position,
+                                                 int limit) {
+  QSqlQuery q = GetPlaylistRows(playlist, *after_position, limit);
+  if (db_->CheckErrors(q)) return QList<Song>();
+
+  const int position_column =
+      (Song::kColumns.count() + 1) * kSongTableJoins + 2;
+
+  std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
+  QList<Song> songs;
+  while (q.next()) {
+    *after_position = q.value(position_column).toLongLong();
+    songs << NewSongFromQuery(SqlRow::Current(q), state_ptr);
   }
   return songs;
 }
@@ -210,6 +385,13 @@ PlaylistItemPtr PlaylistBackend::NewPlaylistItemFromQuery(
       PlaylistItem::NewFromType(row.value(playlist_row).toString()));
   if (item) {
     item->InitFromQuery(row);
+    if (item->IsLocalLibraryItem()) {
+      // Share the song with the library view and any other playlists
+      LibraryPlaylistItem* library_item =
+          static_cast<LibraryPlaylistItem*>(item.get());
+      library_item->SetMetadata(app_->library_backend()->song_cache()->Intern(
+          library_item->Metadata()));
+    }
     return RestoreCueData(item, state);
   } else {
     return item;
@@ -278,10 +460,32 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(
 void PlaylistBackend::SavePlaylistAsync(int playlist,
                                         const PlaylistItemList& items,
                                         int last_played, GeneratorPtr dynamic) {
-  metaObject()->invokeMethod(
-      this, "SavePlaylist", Qt::QueuedConnection, Q_ARG(int, playlist),
-      Q_ARG(PlaylistItemList, items), Q_ARG(int, last_played),
-      Q_ARG(smart_playlists::GeneratorPtr, dynamic));
+  {
+    QMutexLocker l(&pending_saves_mutex_);
+    PendingSave& save = pending_saves_[playlist];
+    save.items_ = items;
+    save.last_played_ = last_played;
+    save.dynamic_ = dynamic;
+
+    if (save_scheduled_) return;
+    save_scheduled_ = true;
+  }
+
+  // The timer lives in the database thread.
+  metaObject()->invokeMethod(save_timer_, "start", Qt::QueuedConnection);
+}
+
+void PlaylistBackend::FlushPendingSaves() {
+  QMap<int, PendingSave> saves;
+  {
+    QMutexLocker l(&pending_saves_mutex_);
+    saves.swap(pending_saves_);
+    save_scheduled_ = false;
+  }
+
+  for (auto it = saves.begin(); it != saves.end(); ++it) {
+    SavePlaylist(it.key(), it->items_, it->last_played_, it->dynamic_);
+  }
 }
 
 void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
@@ -291,15 +495,6 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
 
   qLog(Debug) << "Saving playlist" << playlist;
 
-  QSqlQuery clear(db);
-  clear.prepare("DELETE FROM playlist_items WHERE playlist = :playlist");
-  QSqlQuery insert(db);
-  insert.prepare("INSERT INTO playlist_items"
-      " (playlist, type, library_id, radio_service, " +
-          Song::kColumnSpec +
-          ")"
-          " VALUES (:playlist, :type, :library_id, :radio_service, " +
-          Song::kBindSpec + ")");
   QSqlQuery update(db);
   update.prepare("UPDATE playlists SET "
       "   last_played=:last_played,"
@@ -308,20 +503,18 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
       "   dynamic_playlist_backend=:dynamic_backend"
       " WHERE ROWID=:playlist");
 
-  ScopedTransaction transaction(&db);
-
-  // Clear the existing items in the playlist
-  clear.bindValue(":playlist", playlist);
-  clear.exec();
-  if (db_->CheckErrors(clear)) return;
+  // Work on a copy so a failed save doesn't leave us with the wrong idea of
+  // what's in the database.
+  SavedPlaylist saved;
+  {
+    QMutexLocker saved_lock(&saved_playlists_mutex_);
+    saved = saved_playlists_.value(playlist);
+  }
 
-  // Save the new ones
-  for (PlaylistItemPtr item : items) {
-    insert.bindValue(":playlist", playlist);
-    item->BindToQuery(&insert);
+  ScopedTransaction transaction(&db);
 
-    insert.exec();
-    db_->CheckErrors(insert);
+  if (!saved.complete_ || !UpdatePlaylistItems(db, playlist, items, &saved)) {
+    if (!RewritePlaylistItems(db, playlist, items, &saved)) return;
   }
 
   // Update the last played track number
@@ -340,6 +533,184 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
   if (db_->CheckErrors(update)) return;
 
   transaction.Commit();
+
+  QMutexLocker saved_lock(&saved_playlists_mutex_);
+  saved_playlists_[playlist] = saved;
+}
+
+bool PlaylistBackend::RewritePlaylistItems(QSqlDatabase& db, int playlist,
+                                           const PlaylistItemList& items,
+                                           SavedPlaylist* saved) {
+  QSqlQuery clear(db);
+  clear.prepare("DELETE FROM playlist_items WHERE playlist = :playlist");
+  QSqlQuery insert(db);
+  insert.prepare(InsertItemSql());
+
+  // Clear the existing items in the playlist
+  clear.bindValue(":playlist", playlist);
+  clear.exec();
+  if (db_->CheckErrors(clear)) return false;
+
+  *saved = SavedPlaylist();
+  saved->complete_ = true;
+
+  // Save the new ones
+  for (int i = 0; i < items.count(); ++i) {
+    const qint64 position = (i + 1) * kPositionStep;
+    insert.bindValue(":playlist", playlist);
+    insert.bindValue(":position", position);
+    items[i]->BindToQuery(&insert);
+
+    insert.exec();
+    if (db_->CheckErrors(insert)) {
+      // We don't know this row's ROWID, so the next save has to start over.
+      saved->complete_ = false;
+      continue;
+    }
+    saved->rows_ << SavedRow(items[i], insert.lastInsertId().toInt(), position);
+  }
+
+  return true;
+}
+
+bool PlaylistBackend::UpdatePlaylistItems(QSqlDatabase& db, int playlist,
+                                          const PlaylistItemList& items,
+                                          SavedPlaylist* saved) {
+  const QList<SavedRow>& old_rows = saved->rows_;
+  const int count = items.count();
+
+  // Find the row each item was in last time.
+  QHash<const PlaylistItem*, QList<int>> old_rows_by_item;
+  for (int i = 0; i < old_rows.count(); ++i) {
+    PlaylistItemPtr item = old_rows[i].item_.lock();
+    if (item) old_rows_by_item[item.get()] << i;
+  }
+  QVector<int> old_index(count, -1);
+  for (int i = 0; i < count; ++i) {
+    auto it = old_rows_by_item.find(items[i].get());
+    if (it != old_rows_by_item.end() && !it->isEmpty()) {
+      old_index[i] = it->takeFirst();
+    }
+  }
+
+  // The longest run of items that are still in the same order as before keep
+  // their positions.  Everything else has moved or is new.
+  QVector<bool> keep(count, false);
+  {
+    QVector<int> tails;
+    QVector<int> previous(count, -1);
+    for (int i = 0; i < count; ++i) {
+      if (old_index[i] == -1) continue;
+
+      auto it = std::lower_bound(
+          tails.begin(), tails.end(), old_index[i],
+          [&old_index](int a, int value) { return old_index[a] < value; });
+      if (it != tails.begin()) previous[i] = *(it - 1);
+      if (it == tails.end()) {
+        tails << i;
+      } else {
+        *it = i;
+      }
+    }
+    for (int i = tails.isEmpty() ? -1 : tails.last(); i != -1;
+         i = previous[i]) {
+      keep[i] = true;
+    }
+  }
+
+  // Give everything else a position between its neighbours.
+  QVector<qint64> positions(count);
+  for (int i = 0; i < count;) {
+    if (keep[i]) {
+      positions[i] = old_rows[old_index[i]].position_;
+      ++i;
+      continue;
+    }
+
+    int end = i;
+    while (end < count && !keep[end]) ++end;
+
+    const qint64 before = i == 0 ? 0 : positions[i - 1];
+    qint64 step = kPositionStep;
+    if (end < count) {
+      const qint64 after = old_rows[old_index[end]].position_;
+      step = qMin(step, (after - before) / (end - i + 1));
+      // Out of room, so they all need renumbering.
+      if (step < 1) return false;
+    }
+    for (int j = i; j < end; ++j) {
+      positions[j] = before + step * (j - i + 1);
+    }
+    i = end;
+  }
+
+  QSqlQuery insert(db);
+  insert.prepare(InsertItemSql());
+  QSqlQuery update(db);
+  update.prepare(
+      "UPDATE playlist_items SET position = :position, type = :type,"
+      " library_id = :library_id, radio_service = :radio_service, " +
+      Song::kUpdateSpec + " WHERE ROWID = :rowid");
+  QSqlQuery move(db);
+  move.prepare(
+      "UPDATE playlist_items SET position = :position WHERE ROWID = :rowid");
+  QSqlQuery remove(db);
+  remove.prepare("DELETE FROM playlist_items WHERE ROWID = :rowid");
+
+  QVector<bool> used(old_rows.count(), false);
+  QList<SavedRow> new_rows;
+  int written = 0;
+
+  for (int i = 0; i < count; ++i) {
+    const PlaylistItemPtr& item = items[i];
+
+    if (old_index[i] == -1) {
+      insert.bindValue(":playlist", playlist);
+      insert.bindValue(":position", positions[i]);
+      item->BindToQuery(&insert);
+      insert.exec();
+      if (db_->CheckErrors(insert)) return false;
+
+      new_rows << SavedRow(item, insert.lastInsertId().toInt(), positions[i]);
+      ++written;
+      continue;
+    }
+
+    const SavedRow& old_row = old_rows[old_index[i]];
+    used[old_index[i]] = true;
+
+    SavedRow row(item, old_row.rowid_, positions[i]);
+    if (row.values_ != old_row.values_) {
+      update.bindValue(":position", positions[i]);
+      item->BindToQuery(&update);
+      update.bindValue(":rowid", old_row.rowid_);
+      update.exec();
+      if (db_->CheckErrors(update)) return false;
+      ++written;
+    } else if (!keep[i]) {
+      move.bindValue(":position", positions[i]);
+      move.bindValue(":rowid", old_row.rowid_);
+      move.exec();
+      if (db_->CheckErrors(move)) return false;
+      ++written;
+    }
+    new_rows << row;
+  }
+
+  for (int i = 0; i < old_rows.count(); ++i) {
+    if (used[i]) continue;
+
+    remove.bindValue(":rowid", old_rows[i].rowid_);
+    remove.exec();
+    if (db_->CheckErrors(remove)) return false;
+    ++written;
+  }
+
+  qLog(Debug) << "Wrote" << written << "of" << count << "rows in playlist"
+              << playlist;
+
+  saved->rows_ = new_rows;
+  return true;
 }
 
 int PlaylistBackend::CreatePlaylist(const QString& name,
@@ -360,6 +731,15 @@ int PlaylistBackend::CreatePlaylist(const QString& name,
 }
 
 void PlaylistBackend::RemovePlaylist(int id) {
+  {
+    QMutexLocker pending_lock(&pending_saves_mutex_);
+    pending_saves_.remove(id);
+  }
+  {
+    QMutexLocker saved_lock(&saved_playlists_mutex_);
+    saved_playlists_.remove(id);
+  }
+
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
   QSqlQuery delete_playlist(db);
@@ -20,8 +20,10 @@
 
 #include <QHash>
 #include <QList>
+#include <QMap>
 #include <QMutex>
 #include <QObject>
+#include <QSet>
 
 #include "playlistitem.h"
 #include "smartplaylists/generator_fwd.h"
@@ -29,6 +31,8 @@
 class Application;
 class Database;
 
+class QTimer;
+
 class PlaylistBackend : public QObject {
   Q_OBJECT
 
@@ -53,20 +57,52 @@ class PlaylistBackend : public QObject {
   };
   typedef QList<Playlist> PlaylistList;
 
+  // Part of a playlist's items, so big playlists can be restored a bit at a
+  // time.  Pass last_position back in to get the next page.
+  struct ItemPage {
+    PlaylistItemList items;
+    qint64 last_position;
+    bool finished;
+  };
+
+  // What can be shown about a playlist without loading its items.  Kept up to
+  // date in the playlists table by triggers on playlist_items.
+  struct Summary {
+    Summary() : item_count(0), length_nanosec(0) {}
+
+    int item_count;
+    qint64 length_nanosec;
+  };
+
   static const int kSongTableJoins;
+  static const int kSaveDelayMsec;
+  static const qint64 kPositionStep;
 
   PlaylistList GetAllPlaylists();
   PlaylistList GetAllOpenPlaylists();
   PlaylistList GetAllFavoritePlaylists();
   PlaylistBackend::Playlist GetPlaylist(int id);
 
+  QHash<int, Summary> GetPlaylistSummaries();
+  Summary GetPlaylistSummary(int id);
+  // Returns the IDs of playlists with songs that match the free text query,
+  // looked up in playlist_items_fts.
+  QSet<int> FindPlaylistsWithSongs(const QString& query);
   QList<PlaylistItemPtr> GetPlaylistItems(int playlist);
+  // Gets up to limit items after the given position, or from the start if
+  // after_position is -1.
+  ItemPage GetPlaylistItemPage(int playlist, qint64 after_position, int limit);
   QList<Song> GetPlaylistSongs(int playlist);
+  // Gets up to limit songs after *after_position, or from the start if it's
+  // -1, and moves *after_position past them.
+  QList<Song> GetPlaylistSongPage(int playlist, qint64* after_position,
+                                  int limit);
 
   void SetPlaylistOrder(const QList<int>& ids);
   void SetPlaylistUiPath(int id, const QString& path);
 
   int CreatePlaylist(const QString& name, const QString& special_type);
+  // Saves are held for kSaveDelayMsec so a burst of edits is written once.
   void SavePlaylistAsync(int playlist, const PlaylistItemList& items,
                          int last_played,
                          smart_playlists::GeneratorPtr dynamic);
@@ -79,6 +115,8 @@ class PlaylistBackend : public QObject {
  public slots:
   void SavePlaylist(int playlist, const PlaylistItemList& items,
                     int last_played, smart_playlists::GeneratorPtr dynamic);
+  // Writes any saves that are still waiting for the timer.
+  void FlushPendingSaves();
 
  private:
   struct NewSongFromQueryState {
@@ -86,7 +124,49 @@ class PlaylistBackend : public QObject {
     QMutex mutex_;
   };
 
-  QSqlQuery GetPlaylistRows(int playlist);
+  // What we last wrote to (or read from) one row of playlist_items, so a save
+  // only has to touch the rows that changed.
+  struct SavedRow {
+    SavedRow(PlaylistItemPtr item = PlaylistItemPtr(), int rowid = -1,
+             qint64 position = 0)
+        : item_(item), rowid_(rowid), position_(position) {
+      if (item) values_ = item->GetDatabaseValues();
+    }
+
+    std::weak_ptr<PlaylistItem> item_;
+    int rowid_;
+    qint64 position_;
+    PlaylistItem::DatabaseValues values_;
+  };
+
+  struct SavedPlaylist {
+    SavedPlaylist() : complete_(false) {}
+
+    QList<SavedRow> rows_;
+    // False until every row has been seen, before then we can't tell which
+    // rows a save would have to delete.
+    bool complete_;
+  };
+
+  struct PendingSave {
+    PlaylistItemList items_;
+    int last_played_;
+    smart_playlists::GeneratorPtr dynamic_;
+  };
+
+  QSqlQuery GetPlaylistRows(int playlist, qint64 after_position = -1,
+                            int limit = -1);
+
+  // Replaces every row in the playlist.
+  bool RewritePlaylistItems(QSqlDatabase& db, int playlist,
+                            const PlaylistItemList& items,
+                            SavedPlaylist* saved);
+  // Writes only the rows that were added, moved, changed or removed since the
+  // last save.  Returns false if that can't be done and the playlist has to
+  // be rewritten instead.
+  bool UpdatePlaylistItems(QSqlDatabase& db, int playlist,
+                           const PlaylistItemList& items,
+                           SavedPlaylist* saved);
 
   Song NewSongFromQuery(const SqlRow& row,
                         std::shared_ptr<NewSongFromQueryState> state);
@@ -104,6 +184,14 @@ class PlaylistBackend : public QObject {
 
   Application* app_;
   Database* db_;
+
+  QMutex saved_playlists_mutex_;
+  QHash<int, SavedPlaylist> saved_playlists_;
+
+  QMutex pending_saves_mutex_;
+  QMap<int, PendingSave> pending_saves_;
+  bool save_scheduled_;
+  QTimer* save_timer_;
 };
 
 #endif  // PLAYLISTBACKEND_H
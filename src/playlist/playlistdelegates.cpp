@@ -17,6 +17,7 @@
 
 #include "playlistdelegates.h"
 
+#include <QApplication>
 #include <QDateTime>
 #include <QDir>
 #include <QFuture>
@@ -29,11 +30,11 @@
 #include <QTextDocument>
 #include <QToolTip>
 #include <QWhatsThis>
-#include <QtConcurrentRun>
 
 #include "queue.h"
 #include "core/logging.h"
 #include "core/player.h"
+#include "core/taskexecutor.h"
 #include "core/utilities.h"
 #include "library/librarybackend.h"
 #include "widgets/trackslider.h"
@@ -52,6 +53,7 @@ const int QueuedItemDelegate::kQueueOpacitySteps = 10;
 const float QueuedItemDelegate::kQueueOpacityLowerBound = 0.4;
 
 const int PlaylistDelegateBase::kMinHeight = 19;
+const int PlaylistDelegateBase::kMaxCachedCells = 20000;
 
 QueuedItemDelegate::QueuedItemDelegate(QObject* parent, int indicator_column)
     : QStyledItemDelegate(parent), indicator_column_(indicator_column) {}
@@ -60,7 +62,12 @@ void QueuedItemDelegate::paint(QPainter* painter,
                                const QStyleOptionViewItem& option,
                                const QModelIndex& index) const {
   QStyledItemDelegate::paint(painter, option, index);
+  DrawQueueIndicator(painter, option, index);
+}
 
+void QueuedItemDelegate::DrawQueueIndicator(QPainter* painter,
+                                            const QStyleOptionViewItem& option,
+                                            const QModelIndex& index) const {
   if (index.column() == indicator_column_) {
     bool ok = false;
     const int queue_pos = index.data(Playlist::Role_QueuePosition).toInt(&ok);
@@ -169,7 +176,30 @@ QSize PlaylistDelegateBase::sizeHint(const QStyleOptionViewItem& option,
 void PlaylistDelegateBase::paint(QPainter* painter,
                                  const QStyleOptionViewItem& option,
                                  const QModelIndex& index) const {
-  QueuedItemDelegate::paint(painter, Adjusted(option, index), index);
+  QStyleOptionViewItem opt = Adjusted(option, index);
+  initStyleOption(&opt, index);
+
+  const QWidget* widget = opt.widget;
+  QStyle* style = widget ? widget->style() : QApplication::style();
+
+  if (opt.features & QStyleOptionViewItem::HasDisplay) {
+    // Give the style text that already fits, so it doesn't elide it again.
+    CachedText& cached = CachedTextFor(index, opt.locale);
+    const int margin =
+        style->pixelMetric(QStyle::PM_FocusFrameHMargin, nullptr, widget) + 1;
+    const int width = opt.rect.width() - margin * 2;
+
+    if (cached.elided_width_ != width || cached.elided_font_ != opt.font) {
+      cached.elided_ = opt.fontMetrics.elidedText(cached.text_,
+                                                  opt.textElideMode, width);
+      cached.elided_width_ = width;
+      cached.elided_font_ = opt.font;
+    }
+    opt.text = cached.elided_;
+  }
+
+  style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, widget);
+  DrawQueueIndicator(painter, opt, index);
 
   // Stop after indicator
   if (index.column() == Playlist::Column_Title) {
@@ -182,6 +212,110 @@ void PlaylistDelegateBase::paint(QPainter* painter,
   }
 }
 
+void PlaylistDelegateBase::initStyleOption(QStyleOptionViewItem* option,
+                                           const QModelIndex& index) const {
+  QVariant value = index.data(Qt::FontRole);
+  if (value.isValid() && !value.isNull()) {
+    option->font = qvariant_cast<QFont>(value).resolve(option->font);
+    option->fontMetrics = QFontMetrics(option->font);
+  }
+
+  value = index.data(Qt::TextAlignmentRole);
+  if (value.isValid() && !value.isNull()) {
+    option->displayAlignment = Qt::Alignment(value.toInt());
+  }
+
+  value = index.data(Qt::ForegroundRole);
+  if (value.canConvert<QBrush>()) {
+    option->palette.setBrush(QPalette::Text, qvariant_cast<QBrush>(value));
+  }
+
+  option->index = index;
+
+  const CachedText& cached = CachedTextFor(index, option->locale);
+  if (cached.has_display_) {
+    option->features |= QStyleOptionViewItem::HasDisplay;
+    option->text = cached.text_;
+  }
+
+  option->backgroundBrush =
+      qvariant_cast<QBrush>(index.data(Qt::BackgroundRole));
+
+  // Like QStyledItemDelegate, don't let the style animate items.
+  option->styleObject = nullptr;
+}
+
+PlaylistDelegateBase::CachedText& PlaylistDelegateBase::CachedTextFor(
+    const QModelIndex& index, const QLocale& locale) const {
+  WatchModel(index.model());
+
+  const quint64 key = CacheKey(index.row(), index.column());
+  auto it = text_cache_.find(key);
+  if (it != text_cache_.end()) return *it;
+
+  if (text_cache_.count() >= kMaxCachedCells) text_cache_.clear();
+
+  CachedText cached;
+  const QVariant value = index.data(Qt::DisplayRole);
+  if (value.isValid() && !value.isNull()) {
+    cached.has_display_ = true;
+    cached.text_ = displayText(value, locale);
+  }
+  return *text_cache_.insert(key, cached);
+}
+
+void PlaylistDelegateBase::WatchModel(const QAbstractItemModel* model) const {
+  if (model == cached_model_) return;
+
+  PlaylistDelegateBase* self = const_cast<PlaylistDelegateBase*>(this);
+  if (cached_model_) cached_model_->disconnect(self);
+  text_cache_.clear();
+
+  cached_model_ = const_cast<QAbstractItemModel*>(model);
+  if (!cached_model_) return;
+
+  connect(cached_model_, SIGNAL(dataChanged(QModelIndex, QModelIndex)), self,
+          SLOT(ModelDataChanged(QModelIndex, QModelIndex)));
+  connect(cached_model_, SIGNAL(rowsInserted(QModelIndex, int, int)), self,
+          SLOT(ClearTextCache()));
+  connect(cached_model_, SIGNAL(rowsRemoved(QModelIndex, int, int)), self,
+          SLOT(ClearTextCache()));
+  connect(cached_model_,
+          SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)), self,
+          SLOT(ClearTextCache()));
+  connect(cached_model_, SIGNAL(layoutChanged()), self, SLOT(ClearTextCache()));
+  connect(cached_model_, SIGNAL(modelReset()), self, SLOT(ClearTextCache()));
+}
+
+void PlaylistDelegateBase::ModelDataChanged(const QModelIndex& top_left,
+                                            const QModelIndex& bottom_right) {
+  const int rows = bottom_right.row() - top_left.row() + 1;
+  const int columns = bottom_right.column() - top_left.column() + 1;
+
+  // Whichever is smaller: the changed cells, or the cells in the cache.
+  if (qint64(rows) * columns < text_cache_.count()) {
+    for (int row = top_left.row(); row <= bottom_right.row(); ++row) {
+      for (int column = top_left.column(); column <= bottom_right.column();
+           ++column) {
+        text_cache_.remove(CacheKey(row, column));
+      }
+    }
+  } else {
+    for (auto it = text_cache_.begin(); it != text_cache_.end();) {
+      const int row = int(it.key() >> 32);
+      const int column = int(it.key() & 0xffffffff);
+      if (row >= top_left.row() && row <= bottom_right.row() &&
+          column >= top_left.column() && column <= bottom_right.column()) {
+        it = text_cache_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+void PlaylistDelegateBase::ClearTextCache() { text_cache_.clear(); }
+
 QStyleOptionViewItem PlaylistDelegateBase::Adjusted(
     const QStyleOptionViewItem& option, const QModelIndex& index) const {
   if (!view_) return option;
@@ -361,7 +495,7 @@ TagCompletionModel::TagCompletionModel(LibraryBackend* backend,
     : QStringListModel() {
   QString col = database_column(column);
   if (!col.isEmpty()) {
-    setStringList(backend->GetAll(col));
+    setStringList(backend->tag_completion_cache()->Values(col));
   }
 }
 
@@ -395,8 +529,17 @@ static TagCompletionModel* InitCompletionModel(LibraryBackend* backend,
 TagCompleter::TagCompleter(LibraryBackend* backend, Playlist::Column column,
                            QLineEdit* editor)
     : QCompleter(editor), editor_(editor) {
+  // Columns that have been read once are kept up to date in memory.
+  if (backend->tag_completion_cache()->is_loaded(
+          TagCompletionModel::database_column(column))) {
+    SetModel(new TagCompletionModel(backend, column));
+    return;
+  }
+
   QFuture<TagCompletionModel*> future =
-      QtConcurrent::run(&InitCompletionModel, backend, column);
+      TaskExecutor::Instance()->Run<TagCompletionModel*>(
+          TaskExecutor::Lane_Interactive,
+          std::bind(&InitCompletionModel, backend, column));
   NewClosure(future, this, SLOT(ModelReady(QFuture<TagCompletionModel*>)),
              future);
 }
@@ -404,9 +547,14 @@ TagCompleter::TagCompleter(LibraryBackend* backend, Playlist::Column column,
 TagCompleter::~TagCompleter() { model()->deleteLater(); }
 
 void TagCompleter::ModelReady(QFuture<TagCompletionModel*> future) {
-  TagCompletionModel* model = future.result();
+  SetModel(future.result());
+}
+
+void TagCompleter::SetModel(TagCompletionModel* model) {
   setModel(model);
   setCaseSensitivity(Qt::CaseInsensitive);
+  // The values are sorted, so prefixes are found with a binary search.
+  setModelSorting(QCompleter::CaseInsensitivelySortedModel);
   editor_->setCompleter(this);
 }
 
@@ -23,7 +23,9 @@
 #include "widgets/ratingwidget.h"
 
 #include <QCompleter>
+#include <QHash>
 #include <QPixmapCache>
+#include <QPointer>
 #include <QStringListModel>
 #include <QStyledItemDelegate>
 #include <QTreeView>
@@ -41,6 +43,10 @@ class QueuedItemDelegate : public QStyledItemDelegate {
 
   int queue_indicator_size(const QModelIndex& index) const;
 
+ protected:
+  void DrawQueueIndicator(QPainter* painter, const QStyleOptionViewItem& option,
+                          const QModelIndex& index) const;
+
  private:
   static const int kQueueBoxBorder;
   static const int kQueueBoxCornerRadius;
@@ -73,8 +79,47 @@ class PlaylistDelegateBase : public QueuedItemDelegate {
                  const QStyleOptionViewItem& option, const QModelIndex& index);
 
  protected:
+  // Takes the cell's text from the cache instead of calling displayText().
+  // Only handles the roles the playlist models provide: there are no
+  // decorations or check boxes.
+  void initStyleOption(QStyleOptionViewItem* option,
+                       const QModelIndex& index) const;
+
   QTreeView* view_;
   QString suffix_;
+
+ private slots:
+  void ModelDataChanged(const QModelIndex& top_left,
+                        const QModelIndex& bottom_right);
+  void ClearTextCache();
+
+ private:
+  // Formatting and eliding each cell's text on every paint is most of the
+  // cost of scrolling a long playlist, so both are kept until the cell's data
+  // changes, or its width or font do.
+  struct CachedText {
+    CachedText() : has_display_(false), elided_width_(-1) {}
+
+    bool has_display_;
+    QString text_;
+
+    QString elided_;
+    int elided_width_;
+    QFont elided_font_;
+  };
+
+  static const int kMaxCachedCells;
+
+  static quint64 CacheKey(int row, int column) {
+    return (quint64(row) << 32) | quint32(column);
+  }
+
+  CachedText& CachedTextFor(const QModelIndex& index,
+                            const QLocale& locale) const;
+  void WatchModel(const QAbstractItemModel* model) const;
+
+  mutable QPointer<QAbstractItemModel> cached_model_;
+  mutable QHash<quint64, CachedText> text_cache_;
 };
 
 class LengthItemDelegate : public PlaylistDelegateBase {
@@ -147,7 +192,6 @@ class TagCompletionModel : public QStringListModel {
  public:
   TagCompletionModel(LibraryBackend* backend, Playlist::Column column);
 
- private:
   static QString database_column(Playlist::Column column);
 };
 
@@ -163,6 +207,8 @@ class TagCompleter : public QCompleter {
   void ModelReady(QFuture<TagCompletionModel*> future);
 
  private:
+  void SetModel(TagCompletionModel* model);
+
   QLineEdit* editor_;
 };
 
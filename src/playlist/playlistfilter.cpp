@@ -16,14 +16,16 @@
 */
 
 #include "playlistfilter.h"
-#include "playlistfilterparser.h"
 
 #include <QtDebug>
 
 PlaylistFilter::PlaylistFilter(QObject* parent)
     : QSortFilterProxyModel(parent),
+      playlist_(nullptr),
       filter_tree_(new NopFilter),
-      query_hash_(0) {
+      query_id_(0),
+      previous_query_id_(0),
+      refining_(false) {
   setDynamicSortFilter(true);
 
   column_names_["title"] = Playlist::Column_Title;
@@ -52,6 +54,8 @@ PlaylistFilter::PlaylistFilter(QObject* parent)
                      << Playlist::Column_OriginalYear << Playlist::Column_Score
                      << Playlist::Column_BPM << Playlist::Column_Bitrate
                      << Playlist::Column_Rating;
+
+  filter_columns_ = column_names_.values().toSet().toList();
 }
 
 PlaylistFilter::~PlaylistFilter() {}
@@ -61,19 +65,138 @@ void PlaylistFilter::sort(int column, Qt::SortOrder order) {
   sourceModel()->sort(column, order);
 }
 
+void PlaylistFilter::setSourceModel(QAbstractItemModel* source_model) {
+  if (sourceModel()) {
+    disconnect(sourceModel(), 0, this, 0);
+  }
+
+  rows_.clear();
+  playlist_ = qobject_cast<Playlist*>(source_model);
+
+  // These are connected before QSortFilterProxyModel's own handlers, so the
+  // cache is up to date by the time it filters the changed rows again.
+  if (source_model) {
+    connect(source_model, SIGNAL(dataChanged(QModelIndex, QModelIndex)),
+            SLOT(SourceDataChanged(QModelIndex, QModelIndex)));
+    connect(source_model, SIGNAL(rowsAboutToBeRemoved(QModelIndex, int, int)),
+            SLOT(SourceRowsAboutToBeRemoved(QModelIndex, int, int)));
+    connect(source_model, SIGNAL(modelReset()), SLOT(SourceModelReset()));
+  }
+
+  QSortFilterProxyModel::setSourceModel(source_model);
+}
+
+bool PlaylistFilter::IsRefinement(const QString& previous_query,
+                                  const QString& query) {
+  if (previous_query.isEmpty() || !query.startsWith(previous_query)) {
+    return false;
+  }
+
+  // Plain words are ANDed together and each one is a "contains" match, so
+  // typing more can only narrow the results.  Anything else - columns,
+  // operators, quotes, negation, OR and the AND keyword - can widen them.
+  static const QString kSpecialChars("-()\":=<>!");
+  for (const QChar& c : query) {
+    if (kSpecialChars.contains(c)) return false;
+  }
+  for (const QString& word : query.simplified().split(' ')) {
+    if (word == "OR" || word == "AND") return false;
+  }
+  for (const QString& word : previous_query.simplified().split(' ')) {
+    if (word == "OR" || word == "AND") return false;
+  }
+  return true;
+}
+
+PlaylistFilter::CachedRow* PlaylistFilter::Row(int source_row) const {
+  if (!playlist_ || !playlist_->has_item_at(source_row)) return nullptr;
+  const PlaylistItemPtr& item = playlist_->item_at(source_row);
+
+  // If the weak pointer has expired then a new item has been allocated at the
+  // same address.
+  auto it = rows_.find(item.get());
+  if (it != rows_.end() && !it->item_.expired()) return &it.value();
+
+  CachedRow row;
+  row.item_ = item;
+  row.text_.resize(Playlist::ColumnCount);
+  for (int column : filter_columns_) {
+    row.text_[column] =
+        playlist_->index(source_row, column).data().toString().toLower();
+  }
+  row.query_id_ = 0;
+  row.accepted_ = false;
+
+  return &rows_.insert(item.get(), row).value();
+}
+
 bool PlaylistFilter::filterAcceptsRow(int row,
                                       const QModelIndex& parent) const {
   QString filter = filterRegExp().pattern();
 
-  uint hash = qHash(filter);
-  if (hash != query_hash_) {
+  if (filter != query_) {
     // Parse the query
     FilterParser p(filter, column_names_, numerical_columns_);
     filter_tree_.reset(p.parse());
 
-    query_hash_ = hash;
+    refining_ = IsRefinement(query_, filter);
+    previous_query_id_ = query_id_;
+    ++query_id_;
+    query_ = filter;
+  }
+
+  if (filter_tree_->type() == FilterTree::Nop) return true;
+
+  CachedRow* cached = Row(row);
+  if (!cached) {
+    // Not a playlist, so there's nothing to cache against.
+    FilterRowText text(Playlist::ColumnCount);
+    for (int column : filter_columns_) {
+      text[column] = sourceModel()
+                         ->index(row, column, parent)
+                         .data()
+                         .toString()
+                         .toLower();
+    }
+    return filter_tree_->accept(text);
   }
 
   // Test the row
-  return filter_tree_->accept(row, parent, sourceModel());
+  if (cached->query_id_ != query_id_) {
+    if (!(refining_ && cached->query_id_ == previous_query_id_ &&
+          !cached->accepted_)) {
+      cached->accepted_ = filter_tree_->accept(cached->text_);
+    }
+    cached->query_id_ = query_id_;
+  }
+  return cached->accepted_;
+}
+
+void PlaylistFilter::SourceDataChanged(const QModelIndex& top_left,
+                                       const QModelIndex& bottom_right) {
+  if (!playlist_) return;
+
+  bool affects_filter = false;
+  for (int column : filter_columns_) {
+    if (column >= top_left.column() && column <= bottom_right.column()) {
+      affects_filter = true;
+      break;
+    }
+  }
+  if (!affects_filter) return;
+
+  for (int i = top_left.row(); i <= bottom_right.row(); ++i) {
+    if (playlist_->has_item_at(i)) rows_.remove(playlist_->item_at(i).get());
+  }
 }
+
+void PlaylistFilter::SourceRowsAboutToBeRemoved(const QModelIndex&, int start,
+                                                int end) {
+  if (!playlist_) return;
+
+  for (int i = start; i <= end; ++i) {
+    if (playlist_->has_item_at(i)) rows_.remove(playlist_->item_at(i).get());
+  }
+}
+
+void PlaylistFilter::SourceModelReset() { rows_.clear(); }
@@ -18,15 +18,17 @@
 #ifndef PLAYLISTFILTER_H
 #define PLAYLISTFILTER_H
 
+#include <memory>
+
+#include <QHash>
 #include <QScopedPointer>
 #include <QSortFilterProxyModel>
 
 #include "playlist.h"
+#include "playlistfilterparser.h"
 
 #include <QSet>
 
-class FilterTree;
-
 class PlaylistFilter : public QSortFilterProxyModel {
   Q_OBJECT
 
@@ -37,17 +39,52 @@ class PlaylistFilter : public QSortFilterProxyModel {
   // QAbstractItemModel
   void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
 
+  // QAbstractProxyModel
+  void setSourceModel(QAbstractItemModel* source_model);
+
   // QSortFilterProxyModel
   // public so Playlist::NextVirtualIndex and friends can get at it
   bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const;
 
+  // Returns true if every row matching query also matches previous_query, so
+  // rows the previous query rejected don't need testing again.
+  static bool IsRefinement(const QString& previous_query, const QString& query);
+
+ private slots:
+  void SourceDataChanged(const QModelIndex& top_left,
+                         const QModelIndex& bottom_right);
+  void SourceRowsAboutToBeRemoved(const QModelIndex& parent, int start,
+                                  int end);
+  void SourceModelReset();
+
  private:
+  // The text of a row is read from the model once and kept until the item
+  // changes.  Keyed on the item rather than the row so it survives rows
+  // being moved around.
+  struct CachedRow {
+    std::weak_ptr<PlaylistItem> item_;
+    FilterRowText text_;
+
+    // The last query this row was tested against, and the result.
+    uint query_id_;
+    bool accepted_;
+  };
+
+  CachedRow* Row(int source_row) const;
+
+  Playlist* playlist_;
+
   // Mutable because they're modified from filterAcceptsRow() const
   mutable QScopedPointer<FilterTree> filter_tree_;
-  mutable uint query_hash_;
+  mutable QString query_;
+  mutable uint query_id_;
+  mutable uint previous_query_id_;
+  mutable bool refining_;
+  mutable QHash<const PlaylistItem*, CachedRow> rows_;
 
   QMap<QString, int> column_names_;
   QSet<int> numerical_columns_;
+  QList<int> filter_columns_;
 };
 
 #endif  // PLAYLISTFILTER_H
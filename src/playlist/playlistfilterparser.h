@@ -19,18 +19,19 @@
 #define PLAYLISTFILTERPARSER_H
 
 #include <QMap>
-#include <QModelIndex>
 #include <QSet>
 #include <QString>
+#include <QVector>
 
-class QAbstractItemModel;
+// The lowercased text of one playlist row, indexed by column.  Columns that
+// can't be searched are left empty.
+typedef QVector<QString> FilterRowText;
 
 // structure for filter parse tree
 class FilterTree {
  public:
   virtual ~FilterTree() {}
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const = 0;
+  virtual bool accept(const FilterRowText& row) const = 0;
   enum FilterType { Nop = 0, Or, And, Not, Column, Term };
   virtual FilterType type() = 0;
 };
@@ -38,10 +39,7 @@ class FilterTree {
 // trivial filter that accepts *anything*
 class NopFilter : public FilterTree {
  public:
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
-    return true;
-  }
+  virtual bool accept(const FilterRowText& row) const { return true; }
   virtual FilterType type() { return Nop; }
 };
 
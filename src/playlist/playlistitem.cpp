@@ -28,7 +28,6 @@
 #include "library/libraryplaylistitem.h"
 
 #include <QSqlQuery>
-#include <QtConcurrentRun>
 #include <QtDebug>
 
 PlaylistItem::~PlaylistItem() {}
@@ -69,6 +68,31 @@ void PlaylistItem::BindToQuery(QSqlQuery* query) const {
   DatabaseSongMetadata().BindToQuery(query);
 }
 
+PlaylistItem::DatabaseValues PlaylistItem::GetDatabaseValues() const {
+  DatabaseValues ret;
+  ret.type_ = type();
+  ret.library_id_ = DatabaseValue(Column_LibraryId);
+  ret.radio_service_ = DatabaseValue(Column_InternetService);
+  ret.song_ = DatabaseSongMetadata();
+  return ret;
+}
+
+bool PlaylistItem::DatabaseValues::operator==(
+    const DatabaseValues& other) const {
+  if (type_ != other.type_ || library_id_ != other.library_id_ ||
+      radio_service_ != other.radio_service_) {
+    return false;
+  }
+
+  // The song columns that can change while an item is in a playlist.
+  const Song& a = song_;
+  const Song& b = other.song_;
+  return a.IsMetadataEqual(b) && a.url() == b.url() &&
+         a.filetype() == b.filetype() && a.playcount() == b.playcount() &&
+         a.skipcount() == b.skipcount() && a.lastplayed() == b.lastplayed() &&
+         a.filesize() == b.filesize() && a.mtime() == b.mtime();
+}
+
 void PlaylistItem::SetTemporaryMetadata(const Song& metadata) {
   temp_metadata_ = metadata;
   temp_metadata_.set_filetype(Song::Type_Stream);
@@ -76,12 +100,6 @@ void PlaylistItem::SetTemporaryMetadata(const Song& metadata) {
 
 void PlaylistItem::ClearTemporaryMetadata() { temp_metadata_ = Song(); }
 
-static void ReloadPlaylistItem(PlaylistItemPtr item) { item->Reload(); }
-
-QFuture<void> PlaylistItem::BackgroundReload() {
-  return QtConcurrent::run(ReloadPlaylistItem, shared_from_this());
-}
-
 void PlaylistItem::SetBackgroundColor(short priority, const QColor& color) {
   background_colors_[priority] = color;
 }
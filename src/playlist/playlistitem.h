@@ -54,6 +54,20 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
   };
   Q_DECLARE_FLAGS(Options, Option)
 
+  // A copy of the values BindToQuery writes, so a saved playlist can tell
+  // which of its rows need writing again.
+  struct DatabaseValues {
+    bool operator==(const DatabaseValues& other) const;
+    bool operator!=(const DatabaseValues& other) const {
+      return !(*this == other);
+    }
+
+    QString type_;
+    QVariant library_id_;
+    QVariant radio_service_;
+    Song song_;
+  };
+
   virtual QString type() const { return type_; }
 
   virtual Options options() const { return Default; }
@@ -62,8 +76,14 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
 
   virtual bool InitFromQuery(const SqlRow& query) = 0;
   void BindToQuery(QSqlQuery* query) const;
+  DatabaseValues GetDatabaseValues() const;
   virtual void Reload() {}
-  QFuture<void> BackgroundReload();
+
+  // Items whose Reload() only re-reads tags from a local file can be reloaded
+  // in batches.  GetReloadableSong() fills in the song to read the file's
+  // tags into and returns true, and SetReloadedSong() stores the result.
+  virtual bool GetReloadableSong(Song*) const { return false; }
+  virtual void SetReloadedSong(const Song&) {}
 
   virtual Song Metadata() const = 0;
   virtual QUrl Url() const = 0;
@@ -23,6 +23,7 @@
 #include "core/application.h"
 #include "core/logging.h"
 #include "core/player.h"
+#include "core/utilities.h"
 #include "ui/iconloader.h"
 
 #include <QContextMenuEvent>
@@ -60,6 +61,10 @@ class PlaylistListFilterProxyModel : public QSortFilterProxyModel {
 
   QList<QModelIndex> expandList;
 
+  // Playlists whose songs match the filter.  Their songs aren't in the model
+  // until they're expanded, so they're found in the database instead.
+  QSet<int> matchingPlaylists;
+
   void setFilterRegExp(const QRegExp & regExp) {
     expandList.clear();
     QSortFilterProxyModel::setFilterRegExp(regExp);
@@ -103,6 +108,14 @@ class PlaylistListFilterProxyModel : public QSortFilterProxyModel {
 
   bool filterAcceptsRowItself(int source_row, const QModelIndex &source_parent) const {
     bool rv = QSortFilterProxyModel::filterAcceptsRow(source_row, source_parent);
+    if (!rv && !matchingPlaylists.isEmpty()) {
+      const QModelIndex idx =
+          sourceModel()->index(source_row, 0, source_parent);
+      rv = idx.data(PlaylistListModel::Role_Type).toInt() ==
+               PlaylistListModel::Type_Playlist &&
+           matchingPlaylists.contains(
+               idx.data(PlaylistListModel::Role_PlaylistId).toInt());
+    }
     if(rv) {
       if(sourceModel()->hasIndex(source_row,0,source_parent)) {
         QModelIndex idx = sourceModel()->index(source_row,0,source_parent);
@@ -249,10 +262,16 @@ void PlaylistListContainer::SetApplication(Application* app) {
   connect(player, SIGNAL(Playing()), SLOT(ActivePlaying()));
   connect(player, SIGNAL(Stopped()), SLOT(ActiveStopped()));
 
-  // Get all playlists, even ones that are hidden in the UI.
+  // Get all playlists, even ones that are hidden in the UI.  Their songs are
+  // loaded when they're expanded.
+  PlaylistBackend* backend = app->playlist_backend();
+  model_->SetBackend(backend);
+  const QHash<int, PlaylistBackend::Summary> summaries =
+      backend->GetPlaylistSummaries();
   for (const PlaylistBackend::Playlist& p :
-       app->playlist_backend()->GetAllFavoritePlaylists()) {
-    AddPlaylist(p.id,p.name,true,&p.ui_path);
+       backend->GetAllFavoritePlaylists()) {
+    if (model_->PlaylistById(p.id)) continue;
+    AddPlaylistItem(p.id, p.name, p.ui_path, summaries.value(p.id));
   }
 }
 
@@ -269,7 +288,7 @@ void PlaylistListContainer::NewFolderClicked() {
 }
 
 void PlaylistListContainer::AddPlaylist(int id, const QString& name,
-                                        bool favorite, const QString *ui_path) {
+                                        bool favorite) {
   if (!favorite) {
     return;
   }
@@ -280,18 +299,21 @@ void PlaylistListContainer::AddPlaylist(int id, const QString& name,
     return;
   }
 
-  if(ui_path == nullptr)
-    ui_path = &app_->playlist_manager()->playlist(id)->ui_path();
+  AddPlaylistItem(id, name, app_->playlist_manager()->playlist(id)->ui_path(),
+                  app_->playlist_backend()->GetPlaylistSummary(id));
+}
 
+void PlaylistListContainer::AddPlaylistItem(
+    int id, const QString& name, const QString& ui_path,
+    const PlaylistBackend::Summary& summary) {
   QStandardItem* playlist_item = model_->NewPlaylist(name, id);
-  QStandardItem* parent_folder = model_->FolderByPath(*ui_path);
-  parent_folder->appendRow(playlist_item);
-  for (const Song& s : app_->playlist_backend()->GetPlaylistSongs(id)) {
-    QStandardItem* track_item = model_->NewTrack(s);
-    track_item->setDragEnabled(false);
-    playlist_item->appendRow(track_item);
-  }
+  playlist_item->setData(summary.item_count, PlaylistListModel::Role_ItemCount);
+  playlist_item->setToolTip(
+      tr("%n song(s)", "", summary.item_count) + ", " +
+      Utilities::PrettyTimeNanosec(summary.length_nanosec));
 
+  QStandardItem* parent_folder = model_->FolderByPath(ui_path);
+  parent_folder->appendRow(playlist_item);
 }
 
 void PlaylistListContainer::PlaylistRenamed(int id, const QString& new_name) {
@@ -370,6 +392,8 @@ void PlaylistListContainer::SearchTextEdited(const QString& text) {
     QRegExp regexp(text);
     regexp.setCaseSensitivity(Qt::CaseInsensitive);
 
+    proxy_->matchingPlaylists =
+        app_->playlist_backend()->FindPlaylistsWithSongs(text);
     proxy_->setFilterRegExp(regexp);
 
     if(regexp.isEmpty()) {
@@ -59,7 +59,7 @@ class PlaylistListContainer : public QWidget {
   // From the PlaylistManager
   void PlaylistRenamed(int id, const QString& new_name);
   // Add playlist if favorite == true
-  void AddPlaylist(int id, const QString& name, bool favorite, const QString *ui_path = nullptr);
+  void AddPlaylist(int id, const QString& name, bool favorite);
   void RemovePlaylist(int id);
   void SavePlaylist();
   void PlaylistFavoriteStateChanged(int id, bool favorite);
@@ -72,6 +72,8 @@ class PlaylistListContainer : public QWidget {
   void ActiveStopped();
 
  private:
+  void AddPlaylistItem(int id, const QString& name, const QString& ui_path,
+                       const PlaylistBackend::Summary& summary);
   QStandardItem* ItemForPlaylist(const QString& name, int id);
   QStandardItem* ItemForFolder(const QString& name) const;
   void RecursivelySetIcons(QStandardItem* parent) const;
@@ -1,10 +1,11 @@
 #include "playlistlistmodel.h"
+#include "playlistbackend.h"
 #include "core/logging.h"
 
 #include <QMimeData>
 
 PlaylistListModel::PlaylistListModel(QObject* parent)
-    : QStandardItemModel(parent), dropping_rows_(false) {
+    : QStandardItemModel(parent), dropping_rows_(false), backend_(nullptr) {
   connect(this, SIGNAL(dataChanged(QModelIndex, QModelIndex)),
           SLOT(RowsChanged(QModelIndex, QModelIndex)));
   connect(this, SIGNAL(rowsAboutToBeRemoved(QModelIndex, int, int)),
@@ -172,6 +173,7 @@ QStandardItem* PlaylistListModel::NewPlaylist(const QString& name,
   ret->setText(name);
   ret->setData(PlaylistListModel::Type_Playlist, PlaylistListModel::Role_Type);
   ret->setData(id, PlaylistListModel::Role_PlaylistId);
+  ret->setData(false, PlaylistListModel::Role_TracksLoaded);
   ret->setIcon(playlist_icon_);
   ret->setFlags(Qt::ItemIsDragEnabled | Qt::ItemIsEnabled |
                 Qt::ItemIsSelectable | Qt::ItemIsEditable);
@@ -209,6 +211,34 @@ bool PlaylistListModel::setData(const QModelIndex& index, const QVariant& value,
   return true;
 }
 
+bool PlaylistListModel::hasChildren(const QModelIndex& parent) const {
+  if (canFetchMore(parent)) {
+    return parent.data(Role_ItemCount).toInt() > 0;
+  }
+  return QStandardItemModel::hasChildren(parent);
+}
+
+bool PlaylistListModel::canFetchMore(const QModelIndex& parent) const {
+  return backend_ && parent.data(Role_Type).toInt() == Type_Playlist &&
+         !parent.data(Role_TracksLoaded).toBool();
+}
+
+void PlaylistListModel::fetchMore(const QModelIndex& parent) {
+  if (!canFetchMore(parent)) return;
+
+  QStandardItem* item = itemFromIndex(parent);
+  item->setData(true, Role_TracksLoaded);
+
+  QList<QStandardItem*> tracks;
+  for (const Song& song :
+       backend_->GetPlaylistSongs(parent.data(Role_PlaylistId).toInt())) {
+    QStandardItem* track_item = NewTrack(song);
+    track_item->setDragEnabled(false);
+    tracks << track_item;
+  }
+  if (!tracks.isEmpty()) item->appendRows(tracks);
+}
+
 void PlaylistListModel::UpdatePathsRecursive(const QModelIndex& parent) {
   switch (parent.data(Role_Type).toInt()) {
     case Type_Playlist:
@@ -3,6 +3,9 @@
 
 #include <QStandardItemModel>
 #include "core/song.h"
+
+class PlaylistBackend;
+
 class PlaylistListModel : public QStandardItemModel {
   Q_OBJECT
 
@@ -11,7 +14,18 @@ class PlaylistListModel : public QStandardItemModel {
 
   enum Types { Type_Folder, Type_Playlist, Type_Track };
 
-  enum Roles { Role_Type = Qt::UserRole, Role_PlaylistId, Role_TrackId };
+  enum Roles {
+    Role_Type = Qt::UserRole,
+    Role_PlaylistId,
+    Role_TrackId,
+    // How many songs a playlist has, before they've been loaded.
+    Role_ItemCount,
+    // Set once a playlist's songs have been added as children.
+    Role_TracksLoaded
+  };
+
+  // Playlists' songs are only loaded from the backend when they're expanded.
+  void SetBackend(PlaylistBackend* backend) { backend_ = backend; }
 
   bool dropMimeData(const QMimeData* data, Qt::DropAction action, int row,
                     int column, const QModelIndex& parent);
@@ -47,6 +61,9 @@ class PlaylistListModel : public QStandardItemModel {
 
   // QStandardItemModel
   bool setData(const QModelIndex& index, const QVariant& value, int role);
+  bool hasChildren(const QModelIndex& parent = QModelIndex()) const;
+  bool canFetchMore(const QModelIndex& parent) const;
+  void fetchMore(const QModelIndex& parent);
 
 signals:
   void PlaylistPathChanged(int id, const QString& new_path);
@@ -64,6 +81,7 @@ signals:
 
  private:
   bool dropping_rows_;
+  PlaylistBackend* backend_;
 
   QIcon track_icon_;
   QIcon playlist_icon_;
@@ -19,6 +19,7 @@
 #include "core/logging.h"
 #include "core/player.h"
 #include "core/songloader.h"
+#include "core/taskexecutor.h"
 #include "core/utilities.h"
 #include "library/librarybackend.h"
 #include "library/libraryplaylistitem.h"
@@ -35,11 +36,14 @@
 #include <QFileInfo>
 #include <QFuture>
 #include <QMessageBox>
-#include <QtConcurrentRun>
+#include <QSortFilterProxyModel>
+#include <QTimer>
 #include <QtDebug>
 
 using smart_playlists::GeneratorPtr;
 
+const int PlaylistManager::kUnloadCheckIntervalMsec = 60 * 1000;
+
 PlaylistManager::PlaylistManager(Application* app, QObject* parent)
     : PlaylistManagerInterface(app, parent),
       app_(app),
@@ -49,10 +53,14 @@ PlaylistManager::PlaylistManager(Application* app, QObject* parent)
       parser_(nullptr),
       playlist_container_(nullptr),
       current_(-1),
-      active_(-1) {
+      active_(-1),
+      unload_timer_(new QTimer(this)) {
   connect(app_->player(), SIGNAL(Paused()), SLOT(SetActivePaused()));
   connect(app_->player(), SIGNAL(Playing()), SLOT(SetActivePlaying()));
   connect(app_->player(), SIGNAL(Stopped()), SLOT(SetActiveStopped()));
+
+  unload_timer_->setInterval(kUnloadCheckIntervalMsec);
+  connect(unload_timer_, SIGNAL(timeout()), SLOT(UnloadIdlePlaylists()));
 }
 
 PlaylistManager::~PlaylistManager() {
@@ -71,18 +79,22 @@ void PlaylistManager::Init(LibraryBackend* library_backend,
   parser_ = new PlaylistParser(library_backend, this);
   playlist_container_ = playlist_container;
 
-  connect(library_backend_, SIGNAL(SongsDiscovered(SongList)),
-          SLOT(SongsDiscovered(SongList)));
-  connect(library_backend_, SIGNAL(SongsStatisticsChanged(SongList)),
-          SLOT(SongsDiscovered(SongList)));
-  connect(library_backend_, SIGNAL(SongsRatingChanged(SongList)),
-          SLOT(SongsDiscovered(SongList)));
+  connect(library_backend_, SIGNAL(SongsChanged(LibraryChanges)),
+          SLOT(LibraryChanged(LibraryChanges)));
 
+  // Only the playlists that get shown or played load their items; the rest
+  // just know how big they are.
+  const QHash<int, PlaylistBackend::Summary> summaries =
+      playlist_backend->GetPlaylistSummaries();
   for (const PlaylistBackend::Playlist& p :
        playlist_backend->GetAllOpenPlaylists()) {
-    AddPlaylist(p.id, p.name, p.special_type, p.ui_path, p.favorite);
+    Playlist* playlist =
+        AddPlaylist(p.id, p.name, p.special_type, p.ui_path, p.favorite);
+    playlist->set_saved_summary(summaries.value(p.id));
   }
 
+  unload_timer_->start();
+
   // If no playlist exists then make a new one
   if (playlists_.isEmpty()) New(tr("Playlist"));
 
@@ -121,11 +133,15 @@ Playlist* PlaylistManager::AddPlaylist(int id, const QString& name,
   connect(ret, SIGNAL(Error(QString)), SIGNAL(Error(QString)));
   connect(ret, SIGNAL(PlayRequested(QModelIndex)),
           SIGNAL(PlayRequested(QModelIndex)));
-  connect(playlist_container_->view(),
-          SIGNAL(ColumnAlignmentChanged(ColumnAlignmentMap)), ret,
-          SLOT(SetColumnAlignment(ColumnAlignmentMap)));
+  // There's no container when running headless.
+  if (playlist_container_) {
+    connect(playlist_container_->view(),
+            SIGNAL(ColumnAlignmentChanged(ColumnAlignmentMap)), ret,
+            SLOT(SetColumnAlignment(ColumnAlignmentMap)));
+  }
 
   playlists_[id] = Data(ret, name);
+  playlists_[id].last_used = QDateTime::currentDateTime();
 
   emit PlaylistAdded(id, name, favorite);
 
@@ -177,26 +193,41 @@ void PlaylistManager::Load(const QString& filename) {
 
 void PlaylistManager::Save(int id, const QString& filename,
                            Playlist::Path path_type) {
-  if (playlists_.contains(id)) {
-    parser_->Save(playlist(id)->GetAllSongs(), filename, path_type);
+  if (playlists_.contains(id) && playlist(id)->is_loaded() &&
+      !playlist(id)->is_restoring()) {
+    // Only one chunk of Songs is made at a time rather than a copy of the
+    // whole playlist.
+    const PlaylistItemList items = playlist(id)->GetAllItems();
+    int next = 0;
+    parser_->SaveChunked(items.count(), [items, next]() mutable {
+      SongList songs;
+      for (; next < items.count() && songs.count() < ParserBase::kSaveChunkSize;
+           ++next) {
+        songs << items[next]->Metadata();
+      }
+      return songs;
+    }, filename, path_type);
   } else {
-    // Playlist is not in the playlist manager: probably save action was
-    // triggered
-    // from the left side bar and the playlist isn't loaded.
-    QFuture<QList<Song>> future = QtConcurrent::run(
-        playlist_backend_, &PlaylistBackend::GetPlaylistSongs, id);
-    NewClosure(future, this, SLOT(ItemsLoadedForSavePlaylist(
-                                 QFuture<SongList>, QString, Playlist::Path)),
-               future, filename, path_type);
+    // Playlist is not in the playlist manager or hasn't been loaded yet:
+    // probably save action was triggered from the left side bar.  The songs
+    // are read from the database a page at a time as the file is written.
+    PlaylistBackend* backend = playlist_backend_;
+    PlaylistParser* parser = parser_;
+    TaskExecutor::Instance()->Run<void>(
+        TaskExecutor::Lane_Interactive,
+        [backend, parser, id, filename, path_type]() {
+          qint64 after_position = -1;
+          ParserBase::ChunkSource next_page = [=]() mutable {
+            return backend->GetPlaylistSongPage(id, &after_position,
+                                                ParserBase::kSaveChunkSize);
+          };
+          parser->SaveChunked(
+              backend->GetPlaylistSummaries().value(id).item_count, next_page,
+              filename, path_type);
+        });
   }
 }
 
-void PlaylistManager::ItemsLoadedForSavePlaylist(QFuture<SongList> future,
-                                                 const QString& filename,
-                                                 Playlist::Path path_type) {
-  parser_->Save(future.result(), filename, path_type);
-}
-
 void PlaylistManager::SaveWithUI(int id, const QString& playlist_name) {
   QSettings settings;
   settings.beginGroup(Playlist::kSettingsGroup);
@@ -330,14 +361,21 @@ void PlaylistManager::Delete(int id) {
 }
 
 void PlaylistManager::OneOfPlaylistsChanged() {
-  emit PlaylistChanged(qobject_cast<Playlist*>(sender()));
+  Playlist* playlist = qobject_cast<Playlist*>(sender());
+  if (playlist && playlists_.contains(playlist->id())) {
+    playlists_[playlist->id()].last_used = QDateTime::currentDateTime();
+  }
+  emit PlaylistChanged(playlist);
 }
 
 void PlaylistManager::SetCurrentPlaylist(int id) {
   Q_ASSERT(playlists_.contains(id));
+  if (current_ != -1 && playlists_.contains(current_)) UsePlaylist(current_);
   current_ = id;
+  UsePlaylist(id);
   emit CurrentChanged(current());
   UpdateSummaryText();
+  UpdateRestorePriorities();
 }
 
 void PlaylistManager::SetActivePlaylist(int id) {
@@ -345,12 +383,56 @@ void PlaylistManager::SetActivePlaylist(int id) {
 
   // Kinda a hack: unset the current item from the old active playlist before
   // setting the new one
-  if (active_ != -1 && active_ != id) active()->set_current_row(-1);
+  if (active_ != -1 && active_ != id) {
+    active()->set_current_row(-1);
+    UsePlaylist(active_);
+  }
 
   active_ = id;
+  UsePlaylist(id);
   emit ActiveChanged(active());
 
   sequence_->SetUsingDynamicPlaylist(active()->is_dynamic());
+  UpdateRestorePriorities();
+}
+
+void PlaylistManager::UpdateRestorePriorities() {
+  // Finish restoring the playlists the user can see or hear first; the others
+  // can take their time.
+  for (auto it = playlists_.begin(); it != playlists_.end(); ++it) {
+    it.value().p->set_restore_in_foreground(it.key() == current_ ||
+                                            it.key() == active_);
+  }
+}
+
+void PlaylistManager::UsePlaylist(int id) {
+  Data& data = playlists_[id];
+  data.last_used = QDateTime::currentDateTime();
+  if (!data.p->is_loaded()) data.p->Restore();
+}
+
+void PlaylistManager::UnloadIdlePlaylists() {
+  QSettings s;
+  s.beginGroup(Playlist::kSettingsGroup);
+  const int idle_minutes = s.value("unload_idle_minutes", 0).toInt();
+  if (idle_minutes <= 0) return;
+
+  const QDateTime cutoff =
+      QDateTime::currentDateTime().addSecs(-idle_minutes * 60);
+
+  for (auto it = playlists_.begin(); it != playlists_.end(); ++it) {
+    Playlist* playlist = it->p;
+    if (it.key() == current_ || it.key() == active_ ||
+        !playlist->is_loaded() || playlist->is_restoring() ||
+        playlist->is_dynamic() || !playlist->queue()->is_empty() ||
+        it->last_used > cutoff) {
+      continue;
+    }
+
+    qLog(Debug) << "Unloading idle playlist" << it.key();
+    playlist->Unload();
+    it->selection = QItemSelection();
+  }
 }
 
 void PlaylistManager::SetActiveToCurrent() {
@@ -408,7 +490,8 @@ void PlaylistManager::Enque(int id, int i) {
 }
 
 void PlaylistManager::UpdateSummaryText() {
-  int tracks = current()->rowCount();
+  Playlist* playlist = current();
+  int tracks = playlist->rowCount();
   quint64 nanoseconds = 0;
   int selected = 0;
 
@@ -417,10 +500,28 @@ void PlaylistManager::UpdateSummaryText() {
     if (!range.isValid()) continue;
 
     selected += range.bottom() - range.top() + 1;
+
+    if (range.model() == playlist) {
+      nanoseconds += playlist->GetRangeLength(range.top(), range.bottom());
+      continue;
+    }
+
+    // The view's selection is in terms of the filter, which keeps the
+    // playlist's order.  If nothing in the range is filtered out, it's one
+    // run of rows in the playlist too.
+    const QSortFilterProxyModel* proxy = playlist->proxy();
+    if (range.model() != proxy) continue;
+
+    const int first = proxy->mapToSource(proxy->index(range.top(), 0)).row();
+    const int last = proxy->mapToSource(proxy->index(range.bottom(), 0)).row();
+    if (last - first == range.bottom() - range.top()) {
+      nanoseconds += playlist->GetRangeLength(first, last);
+      continue;
+    }
+
     for (int i = range.top(); i <= range.bottom(); ++i) {
-      qint64 length =
-          range.model()->index(i, Playlist::Column_Length).data().toLongLong();
-      if (length > 0) nanoseconds += length;
+      const int row = proxy->mapToSource(proxy->index(i, 0)).row();
+      nanoseconds += playlist->GetRangeLength(row, row);
     }
   }
 
@@ -428,7 +529,7 @@ void PlaylistManager::UpdateSummaryText() {
   if (selected > 1) {
     summary += tr("%1 selected of").arg(selected) + " ";
   } else {
-    nanoseconds = current()->GetTotalLength();
+    nanoseconds = playlist->GetTotalLength();
   }
 
   // TODO: Make the plurals translatable
@@ -445,11 +546,34 @@ void PlaylistManager::SelectionChanged(const QItemSelection& selection) {
   UpdateSummaryText();
 }
 
-void PlaylistManager::SongsDiscovered(const SongList& songs) {
+void PlaylistManager::LibraryChanged(const LibraryChanges& changes) {
+  // Only fetch the songs that are in a playlist - most of a big rescan
+  // usually isn't.
+  QList<int> ids;
+  for (int id : changes.ids(LibraryChanges::Change_Discovered |
+                            LibraryChanges::Change_Statistics |
+                            LibraryChanges::Change_Rating)) {
+    for (const Data& data : playlists_) {
+      if (!data.p->library_items_by_id(id).isEmpty()) {
+        ids << id;
+        break;
+      }
+    }
+  }
+  if (ids.isEmpty()) return;
+
+  QFuture<SongList> future = TaskExecutor::Instance()->Run<SongList>(
+      TaskExecutor::Lane_Interactive,
+      [this, ids]() { return library_backend_->GetSongsById(ids); });
+  NewClosure(future, this, SLOT(ChangedSongsLoaded(QFuture<SongList>)),
+             future);
+}
+
+void PlaylistManager::ChangedSongsLoaded(QFuture<SongList> future) {
   // Some songs might've changed in the library, let's update any playlist
   // items we have that match those songs
 
-  for (const Song& song : songs) {
+  for (const Song& song : future.result()) {
     for (const Data& data : playlists_) {
       PlaylistItemList items = data.p->library_items_by_id(song.id());
       for (PlaylistItemPtr item : items) {
@@ -19,12 +19,15 @@
 #define PLAYLISTMANAGER_H
 
 #include <QColor>
+#include <QDateTime>
+#include <QFuture>
 #include <QItemSelection>
 #include <QMap>
 #include <QObject>
 #include <QSettings>
 
 #include "core/song.h"
+#include "library/librarychanges.h"
 #include "playlist.h"
 #include "smartplaylists/generator_fwd.h"
 
@@ -37,6 +40,7 @@ class PlaylistSequence;
 class TaskManager;
 
 class QModelIndex;
+class QTimer;
 class QUrl;
 
 class PlaylistManagerInterface : public QObject {
@@ -139,6 +143,8 @@ class PlaylistManager : public PlaylistManagerInterface {
   Q_OBJECT
 
  public:
+  static const int kUnloadCheckIntervalMsec;
+
   PlaylistManager(Application* app, QObject* parent = nullptr);
   ~PlaylistManager();
 
@@ -239,15 +245,17 @@ class PlaylistManager : public PlaylistManagerInterface {
 
   void OneOfPlaylistsChanged();
   void UpdateSummaryText();
-  void SongsDiscovered(const SongList& songs);
-  void ItemsLoadedForSavePlaylist(QFuture<SongList> future,
-                                  const QString& filename,
-                                  Playlist::Path path_type);
+  void LibraryChanged(const LibraryChanges& changes);
+  void ChangedSongsLoaded(QFuture<SongList> future);
+  void UnloadIdlePlaylists();
 
  private:
   Playlist* AddPlaylist(int id, const QString& name,
                         const QString& special_type, const QString& ui_path,
                         bool favorite);
+  void UpdateRestorePriorities();
+  // Loads the playlist if it isn't already and notes that it was just used.
+  void UsePlaylist(int id);
 
  private:
   struct Data {
@@ -256,6 +264,7 @@ class PlaylistManager : public PlaylistManagerInterface {
     Playlist* p;
     QString name;
     QItemSelection selection;
+    QDateTime last_used;
   };
 
   Application* app_;
@@ -270,6 +279,8 @@ class PlaylistManager : public PlaylistManagerInterface {
 
   int current_;
   int active_;
+
+  QTimer* unload_timer_;
 };
 
 #endif  // PLAYLISTMANAGER_H
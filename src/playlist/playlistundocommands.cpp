@@ -26,19 +26,21 @@ InsertItems::InsertItems(Playlist* playlist, const PlaylistItemList& items,
                          int pos, bool enqueue, bool enqueue_next)
     : Base(playlist),
       items_(items),
+      count_(items.count()),
       pos_(pos),
       enqueue_(enqueue),
       enqueue_next_(enqueue_next) {
-  setText(tr("add %n songs", "", items_.count()));
+  setText(tr("add %n songs", "", count_));
 }
 
 void InsertItems::redo() {
   playlist_->InsertItemsWithoutUndo(items_, pos_, enqueue_, enqueue_next_);
+  items_.clear();
 }
 
 void InsertItems::undo() {
-  const int start = pos_ == -1 ? playlist_->rowCount() - items_.count() : pos_;
-  playlist_->RemoveItemsWithoutUndo(start, items_.count());
+  const int start = pos_ == -1 ? playlist_->rowCount() - count_ : pos_;
+  items_ = playlist_->RemoveItemsWithoutUndo(start, count_);
 }
 
 bool InsertItems::UpdateItem(const PlaylistItemPtr& updated_item) {
@@ -66,8 +68,10 @@ void RemoveItems::redo() {
 }
 
 void RemoveItems::undo() {
-  for (int i = ranges_.count() - 1; i >= 0; --i)
+  for (int i = ranges_.count() - 1; i >= 0; --i) {
     playlist_->InsertItemsWithoutUndo(ranges_[i].items_, ranges_[i].pos_);
+    ranges_[i].items_.clear();
+  }
 }
 
 bool RemoveItems::mergeWith(const QUndoCommand* other) {
@@ -91,22 +95,42 @@ void MoveItems::redo() { playlist_->MoveItemsWithoutUndo(source_rows_, pos_); }
 void MoveItems::undo() { playlist_->MoveItemsWithoutUndo(pos_, source_rows_); }
 
 ReOrderItems::ReOrderItems(Playlist* playlist,
-                           const PlaylistItemList& new_items)
-    : Base(playlist), old_items_(playlist->items_), new_items_(new_items) {}
+                           const QVector<int>& permutation)
+    : Base(playlist), permutation_(permutation) {}
+
+void ReOrderItems::redo() {
+  const PlaylistItemList& items = playlist_->items_;
+  // Something changed the playlist without going through the undo stack.
+  if (items.count() != permutation_.count()) return;
+
+  PlaylistItemList new_items;
+  new_items.reserve(items.count());
+  for (int row : permutation_) {
+    new_items << items[row];
+  }
+  playlist_->ReOrderWithoutUndo(new_items);
+}
 
-void ReOrderItems::undo() { playlist_->ReOrderWithoutUndo(old_items_); }
+void ReOrderItems::undo() {
+  const PlaylistItemList& items = playlist_->items_;
+  if (items.count() != permutation_.count()) return;
 
-void ReOrderItems::redo() { playlist_->ReOrderWithoutUndo(new_items_); }
+  PlaylistItemList old_items(items);
+  for (int i = 0; i < permutation_.count(); ++i) {
+    old_items[permutation_[i]] = items[i];
+  }
+  playlist_->ReOrderWithoutUndo(old_items);
+}
 
 SortItems::SortItems(Playlist* playlist, int column, Qt::SortOrder order,
-                     const PlaylistItemList& new_items)
-    : ReOrderItems(playlist, new_items), column_(column), order_(order) {
+                     const QVector<int>& permutation)
+    : ReOrderItems(playlist, permutation), column_(column), order_(order) {
   setText(tr("sort songs"));
 }
 
 ShuffleItems::ShuffleItems(Playlist* playlist,
-                           const PlaylistItemList& new_items)
-    : ReOrderItems(playlist, new_items) {
+                           const QVector<int>& permutation)
+    : ReOrderItems(playlist, permutation) {
   setText(tr("shuffle songs"));
 }
 
@@ -20,6 +20,7 @@
 
 #include <QUndoCommand>
 #include <QCoreApplication>
+#include <QVector>
 
 #include "playlistitem.h"
 
@@ -48,12 +49,16 @@ class InsertItems : public Base {
   // When load is async, items have already been pushed, so we need to update
   // them.
   // This function try to find the equivalent item, and replace it with the
-  // new (completely loaded) one.
+  // new (completely loaded) one.  Items that are in the playlist are updated
+  // there instead.
   // return true if the was found (and updated), false otherwise
   bool UpdateItem(const PlaylistItemPtr& updated_item);
 
  private:
+  // Only holds the items while they're out of the playlist, the rest of the
+  // time the playlist has them.
   PlaylistItemList items_;
+  int count_;
   int pos_;
   bool enqueue_;
   bool enqueue_next_;
@@ -74,6 +79,7 @@ class RemoveItems : public Base {
     Range(int pos, int count) : pos_(pos), count_(count) {}
     int pos_;
     int count_;
+    // Only set while the items are removed.
     PlaylistItemList items_;
   };
 
@@ -92,22 +98,23 @@ class MoveItems : public Base {
   int pos_;
 };
 
+// Re-orderings only store which row went where, not the items themselves.
 class ReOrderItems : public Base {
  public:
-  ReOrderItems(Playlist* playlist, const PlaylistItemList& new_items);
+  // permutation[i] is the row that ends up at row i.
+  ReOrderItems(Playlist* playlist, const QVector<int>& permutation);
 
   void undo();
   void redo();
 
  private:
-  PlaylistItemList old_items_;
-  PlaylistItemList new_items_;
+  QVector<int> permutation_;
 };
 
 class SortItems : public ReOrderItems {
  public:
   SortItems(Playlist* playlist, int column, Qt::SortOrder order,
-            const PlaylistItemList& new_items);
+            const QVector<int>& permutation);
 
  private:
   int column_;
@@ -116,7 +123,7 @@ class SortItems : public ReOrderItems {
 
 class ShuffleItems : public ReOrderItems {
  public:
-  ShuffleItems(Playlist* playlist, const PlaylistItemList& new_items);
+  ShuffleItems(Playlist* playlist, const QVector<int>& permutation);
 };
 }  // namespace
 
@@ -23,6 +23,7 @@
 #include "playlistview.h"
 #include "core/application.h"
 #include "core/logging.h"
+#include "core/perftrace.h"
 #include "core/player.h"
 #include "covers/currentartloader.h"
 #include "ui/qt_blurimage.h"
@@ -286,7 +287,7 @@ void PlaylistView::SetPlaylist(Playlist* playlist) {
     disconnect(playlist_, SIGNAL(DynamicModeChanged(bool)), this,
                SLOT(DynamicModeChanged(bool)));
     disconnect(playlist_, SIGNAL(destroyed()), this, SLOT(PlaylistDestroyed()));
-    disconnect(playlist_, SIGNAL(QueueChanged()), this, SLOT(update()));
+    disconnect(playlist_, SIGNAL(QueueChanged()), this, SLOT(QueueChanged()));
 
     disconnect(dynamic_controls_, SIGNAL(Expand()), playlist_,
                SLOT(ExpandDynamicPlaylist()));
@@ -310,7 +311,7 @@ void PlaylistView::SetPlaylist(Playlist* playlist) {
   connect(playlist_, SIGNAL(DynamicModeChanged(bool)),
           SLOT(DynamicModeChanged(bool)));
   connect(playlist_, SIGNAL(destroyed()), SLOT(PlaylistDestroyed()));
-  connect(playlist_, SIGNAL(QueueChanged()), SLOT(update()));
+  connect(playlist_, SIGNAL(QueueChanged()), SLOT(QueueChanged()));
 
   connect(dynamic_controls_, SIGNAL(Expand()), playlist_,
           SLOT(ExpandDynamicPlaylist()));
@@ -323,7 +324,7 @@ void PlaylistView::SetPlaylist(Playlist* playlist) {
 void PlaylistView::setModel(QAbstractItemModel* m) {
   if (model()) {
     disconnect(model(), SIGNAL(dataChanged(QModelIndex, QModelIndex)), this,
-               SLOT(InvalidateCachedCurrentPixmap()));
+               SLOT(ModelDataChanged(QModelIndex, QModelIndex)));
     disconnect(model(), SIGNAL(layoutAboutToBeChanged()), this,
                SLOT(RatingHoverOut()));
     // When changing the model, always invalidate the current pixmap.
@@ -335,7 +336,7 @@ void PlaylistView::setModel(QAbstractItemModel* m) {
   QTreeView::setModel(m);
 
   connect(model(), SIGNAL(dataChanged(QModelIndex, QModelIndex)), this,
-          SLOT(InvalidateCachedCurrentPixmap()));
+          SLOT(ModelDataChanged(QModelIndex, QModelIndex)));
   connect(model(), SIGNAL(layoutAboutToBeChanged()), this,
           SLOT(RatingHoverOut()));
 }
@@ -583,6 +584,24 @@ void PlaylistView::InvalidateCachedCurrentPixmap() {
   cached_current_row_ = QPixmap();
 }
 
+void PlaylistView::ModelDataChanged(const QModelIndex& top_left,
+                                    const QModelIndex& bottom_right) {
+  // Re-rendering the current row is expensive, so only do it when the change
+  // actually touches that row.
+  if (cached_current_row_row_ >= top_left.row() &&
+      cached_current_row_row_ <= bottom_right.row()) {
+    InvalidateCachedCurrentPixmap();
+  }
+}
+
+void PlaylistView::QueueChanged() {
+  // Only the queue indicators, drawn in the title column, change.
+  InvalidateCachedCurrentPixmap();
+  viewport()->update(columnViewportPosition(Playlist::Column_Title), 0,
+                     columnWidth(Playlist::Column_Title),
+                     viewport()->height());
+}
+
 void PlaylistView::timerEvent(QTimerEvent* event) {
   QTreeView::timerEvent(event);
   if (event->timerId() == glow_timer_.timerId()) GlowIntensityChanged();
@@ -945,6 +964,7 @@ void PlaylistView::JumpToLastPlayedTrack() {
 }
 
 void PlaylistView::paintEvent(QPaintEvent* event) {
+  PerfTrace::Scope trace("PlaylistView::paintEvent");
   // Reimplemented to draw the background image.
   // Reimplemented also to draw the drop indicator
   // When the user is dragging some stuff over the playlist paintEvent gets
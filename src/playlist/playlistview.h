@@ -153,6 +153,9 @@ signals:
   void InhibitAutoscrollTimeout();
   void MaybeAutoscroll();
   void InvalidateCachedCurrentPixmap();
+  void ModelDataChanged(const QModelIndex& top_left,
+                        const QModelIndex& bottom_right);
+  void QueueChanged();
   void PlaylistDestroyed();
 
   void SaveSettings(QSettings* s);
@@ -21,6 +21,7 @@
 
 #include <QBuffer>
 #include <QMimeData>
+#include <QSet>
 #include <QtDebug>
 
 #include "core/utilities.h"
@@ -28,7 +29,10 @@
 const char* Queue::kRowsMimetype = "application/x-clementine-queue-rows";
 
 Queue::Queue(Playlist* parent)
-    : QAbstractProxyModel(parent), playlist_(parent), total_length_ns_(0) {
+    : QAbstractProxyModel(parent),
+      source_row_map_dirty_(true),
+      playlist_(parent),
+      total_length_ns_(0) {
   count_changed_ =
       connect(this, SIGNAL(ItemCountChanged(int)), SLOT(UpdateTotalLength()));
   connect(this, SIGNAL(TotalLengthChanged(quint64)), SLOT(UpdateSummaryText()));
@@ -36,22 +40,29 @@ Queue::Queue(Playlist* parent)
   UpdateSummaryText();
 }
 
+const QHash<int, int>& Queue::SourceRowMap() const {
+  if (source_row_map_dirty_) {
+    source_row_map_.clear();
+    source_row_map_.reserve(source_indexes_.count());
+    for (int i = 0; i < source_indexes_.count(); ++i) {
+      source_row_map_.insert(source_indexes_[i].row(), i);
+    }
+    source_row_map_dirty_ = false;
+  }
+  return source_row_map_;
+}
+
 QModelIndex Queue::mapFromSource(const QModelIndex& source_index) const {
   if (!source_index.isValid()) return QModelIndex();
 
-  const int source_row = source_index.row();
-  for (int i = 0; i < source_indexes_.count(); ++i) {
-    if (source_indexes_[i].row() == source_row)
-      return index(i, source_index.column());
-  }
-  return QModelIndex();
+  const QHash<int, int>& map = SourceRowMap();
+  auto it = map.constFind(source_index.row());
+  if (it == map.constEnd()) return QModelIndex();
+  return index(*it, source_index.column());
 }
 
 bool Queue::ContainsSourceRow(int source_row) const {
-  for (int i = 0; i < source_indexes_.count(); ++i) {
-    if (source_indexes_[i].row() == source_row) return true;
-  }
-  return false;
+  return SourceRowMap().contains(source_row);
 }
 
 QModelIndex Queue::mapToSource(const QModelIndex& proxy_index) const {
@@ -68,9 +79,17 @@ void Queue::setSourceModel(QAbstractItemModel* source_model) {
                SLOT(SourceLayoutChanged()));
     disconnect(sourceModel(), SIGNAL(layoutChanged()), this,
                SLOT(SourceLayoutChanged()));
+    disconnect(sourceModel(), SIGNAL(rowsInserted(QModelIndex, int, int)),
+               this, SLOT(InvalidateSourceRowMap()));
+    disconnect(sourceModel(),
+               SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)),
+               this, SLOT(InvalidateSourceRowMap()));
+    disconnect(sourceModel(), SIGNAL(modelReset()), this,
+               SLOT(InvalidateSourceRowMap()));
   }
 
   QAbstractProxyModel::setSourceModel(source_model);
+  InvalidateSourceRowMap();
 
   connect(sourceModel(), SIGNAL(dataChanged(QModelIndex, QModelIndex)), this,
           SLOT(SourceDataChanged(QModelIndex, QModelIndex)));
@@ -78,32 +97,55 @@ void Queue::setSourceModel(QAbstractItemModel* source_model) {
           SLOT(SourceLayoutChanged()));
   connect(sourceModel(), SIGNAL(layoutChanged()), this,
           SLOT(SourceLayoutChanged()));
+  // These keep every queued index valid, but change their rows.
+  connect(sourceModel(), SIGNAL(rowsInserted(QModelIndex, int, int)), this,
+          SLOT(InvalidateSourceRowMap()));
+  connect(sourceModel(),
+          SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)), this,
+          SLOT(InvalidateSourceRowMap()));
+  connect(sourceModel(), SIGNAL(modelReset()), this,
+          SLOT(InvalidateSourceRowMap()));
 }
 
 void Queue::SourceDataChanged(const QModelIndex& top_left,
                               const QModelIndex& bottom_right) {
-  for (int row = top_left.row(); row <= bottom_right.row(); ++row) {
-    QModelIndex proxy_index = mapFromSource(sourceModel()->index(row, 0));
-    if (!proxy_index.isValid()) continue;
+  const QHash<int, int>& map = SourceRowMap();
+
+  // Walk whichever is shorter: the changed rows or the queue.
+  QList<int> proxy_rows;
+  if (bottom_right.row() - top_left.row() + 1 > map.count()) {
+    for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
+      if (it.key() >= top_left.row() && it.key() <= bottom_right.row()) {
+        proxy_rows << it.value();
+      }
+    }
+  } else {
+    for (int row = top_left.row(); row <= bottom_right.row(); ++row) {
+      auto it = map.constFind(row);
+      if (it != map.constEnd()) proxy_rows << it.value();
+    }
+  }
+
+  // Changes to tracks that aren't queued don't change the queue's length.
+  if (proxy_rows.isEmpty()) return;
 
-    emit dataChanged(proxy_index, proxy_index);
+  for (int row : proxy_rows) {
+    emit dataChanged(index(row, 0), index(row, 0));
   }
   emit ItemCountChanged(this->ItemCount());
 }
 
 void Queue::SourceLayoutChanged() {
+  InvalidateSourceRowMap();
+
   // Temporarily disconnect this signal to prevent UpdateTotalLength from
   // being called when SourceDataChanged is handled during this scrub.
   disconnect(count_changed_);
+  QList<int> removed_rows;
   for (int i = 0; i < source_indexes_.count(); ++i) {
-    if (!source_indexes_[i].isValid()) {
-      beginRemoveRows(QModelIndex(), i, i);
-      source_indexes_.removeAt(i);
-      endRemoveRows();
-
-      --i;
-    }
+    if (!source_indexes_[i].isValid()) removed_rows << i;
   }
+  RemoveProxyRows(removed_rows);
   // Re-connect before emitting the signal ourselves.
   count_changed_ =
       connect(this, SIGNAL(ItemCountChanged(int)), SLOT(UpdateTotalLength()));
@@ -151,36 +193,73 @@ QVariant Queue::data(const QModelIndex& proxy_index, int role) const {
   }
 }
 
+void Queue::RemoveProxyRows(QList<int> proxy_rows) {
+  std::sort(proxy_rows.begin(), proxy_rows.end());
+  proxy_rows.erase(std::unique(proxy_rows.begin(), proxy_rows.end()),
+                   proxy_rows.end());
+
+  // Work backwards so the rows that are still to go don't move.
+  int i = proxy_rows.count() - 1;
+  while (i >= 0) {
+    const int last = proxy_rows[i];
+    int first = last;
+    while (i > 0 && proxy_rows[i - 1] == first - 1) {
+      --i;
+      --first;
+    }
+    --i;
+
+    beginRemoveRows(QModelIndex(), first, last);
+    source_indexes_.erase(source_indexes_.begin() + first,
+                          source_indexes_.begin() + last + 1);
+    InvalidateSourceRowMap();
+    endRemoveRows();
+  }
+}
+
 void Queue::ToggleTracks(const QModelIndexList& source_indexes) {
+  // Sort the tracks out first, so toggling lots of them at once doesn't
+  // rebuild the row map after every one.
+  const QHash<int, int>& map = SourceRowMap();
+  QList<int> dequeue_rows;
+  QList<QPersistentModelIndex> enqueue_indexes;
+  QSet<int> seen_rows;
   for (const QModelIndex& source_index : source_indexes) {
-    QModelIndex proxy_index = mapFromSource(source_index);
-    if (proxy_index.isValid()) {
-      // Dequeue the track
-      const int row = proxy_index.row();
-      beginRemoveRows(QModelIndex(), row, row);
-      source_indexes_.removeAt(row);
-      endRemoveRows();
+    if (!source_index.isValid() || seen_rows.contains(source_index.row())) {
+      continue;
+    }
+    seen_rows << source_index.row();
+
+    auto it = map.constFind(source_index.row());
+    if (it != map.constEnd()) {
+      dequeue_rows << it.value();
     } else {
-      // Enqueue the track
-      const int row = source_indexes_.count();
-      beginInsertRows(QModelIndex(), row, row);
-      source_indexes_ << QPersistentModelIndex(source_index);
-      endInsertRows();
+      enqueue_indexes << QPersistentModelIndex(source_index);
     }
   }
+
+  RemoveProxyRows(dequeue_rows);
+
+  if (!enqueue_indexes.isEmpty()) {
+    const int row = source_indexes_.count();
+    beginInsertRows(QModelIndex(), row, row + enqueue_indexes.count() - 1);
+    source_indexes_ << enqueue_indexes;
+    InvalidateSourceRowMap();
+    endInsertRows();
+  }
 }
 
 void Queue::InsertFirst(const QModelIndexList& source_indexes) {
+  if (source_indexes.isEmpty()) return;
+
+  // Any that are already in the queue are removed to be reinserted later
+  const QHash<int, int>& map = SourceRowMap();
+  QList<int> queued_rows;
   for (const QModelIndex& source_index : source_indexes) {
-    QModelIndex proxy_index = mapFromSource(source_index);
-    if (proxy_index.isValid()) {
-      // Already in the queue, so remove it to be reinserted later
-      const int row = proxy_index.row();
-      beginRemoveRows(QModelIndex(), row, row);
-      source_indexes_.removeAt(row);
-      endRemoveRows();
-    }
+    auto it = map.constFind(source_index.row());
+    if (it != map.constEnd()) queued_rows << it.value();
   }
+  RemoveProxyRows(queued_rows);
 
   const int rows = source_indexes.count();
   // Enqueue the tracks at the beginning
@@ -190,6 +269,7 @@ void Queue::InsertFirst(const QModelIndexList& source_indexes) {
     source_indexes_.insert(offset, QPersistentModelIndex(source_index));
     offset++;
   }
+  InvalidateSourceRowMap();
   endInsertRows();
 }
 
@@ -239,6 +319,7 @@ void Queue::Clear() {
 
   beginRemoveRows(QModelIndex(), 0, source_indexes_.count() - 1);
   source_indexes_.clear();
+  InvalidateSourceRowMap();
   endRemoveRows();
 }
 
@@ -261,18 +342,23 @@ void Queue::Move(const QList<int>& proxy_rows, int pos) {
     source_indexes_.insert(i, moved_items[i - start]);
   }
 
-  // Update persistent indexes
+  InvalidateSourceRowMap();
+
+  // Update persistent indexes.  proxy_rows is in ascending order, so the
+  // number of moved rows above each index can be found by bisection.
+  QHash<int, int> dest_offsets;
+  for (int i = 0; i < proxy_rows.count(); ++i) dest_offsets[proxy_rows[i]] = i;
+
   for (const QModelIndex& pidx : persistentIndexList()) {
-    const int dest_offset = proxy_rows.indexOf(pidx.row());
-    if (dest_offset != -1) {
+    auto dest = dest_offsets.constFind(pidx.row());
+    if (dest != dest_offsets.constEnd()) {
       // This index was moved
       changePersistentIndex(
-          pidx, index(start + dest_offset, pidx.column(), QModelIndex()));
+          pidx, index(start + *dest, pidx.column(), QModelIndex()));
     } else {
-      int d = 0;
-      for (int row : proxy_rows) {
-        if (pidx.row() > row) d--;
-      }
+      int d = -int(std::lower_bound(proxy_rows.begin(), proxy_rows.end(),
+                                    pidx.row()) -
+                   proxy_rows.begin());
       if (pidx.row() + d >= start) d += proxy_rows.count();
 
       changePersistentIndex(
@@ -358,6 +444,7 @@ bool Queue::dropMimeData(const QMimeData* data, Qt::DropAction action, int row,
       for (int i = 0; i < source_indexes.count(); ++i) {
         source_indexes_.insert(insert_point + i, source_indexes[i]);
       }
+      InvalidateSourceRowMap();
       endInsertRows();
     }
   }
@@ -386,6 +473,7 @@ int Queue::TakeNext() {
 
   beginRemoveRows(QModelIndex(), 0, 0);
   int ret = source_indexes_.takeFirst().row();
+  InvalidateSourceRowMap();
   endRemoveRows();
 
   return ret;
@@ -402,16 +490,6 @@ void Queue::Remove(QList<int>& proxy_rows) {
 
   // reflects immediately changes in the playlist
   layoutAboutToBeChanged();
-
-  int removed_rows = 0;
-  for (int row : proxy_rows) {
-    // after the first row, the row number needs to be updated
-    const int real_row = row - removed_rows;
-    beginRemoveRows(QModelIndex(), real_row, real_row);
-    source_indexes_.removeAt(real_row);
-    endRemoveRows();
-    removed_rows++;
-  }
-
+  RemoveProxyRows(proxy_rows);
   layoutChanged();
 }
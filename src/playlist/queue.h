@@ -21,6 +21,7 @@
 #include "playlist.h"
 
 #include <QAbstractProxyModel>
+#include <QHash>
 
 class Queue : public QAbstractProxyModel {
   Q_OBJECT
@@ -80,10 +81,22 @@ class Queue : public QAbstractProxyModel {
   void SourceDataChanged(const QModelIndex& top_left,
                          const QModelIndex& bottom_right);
   void SourceLayoutChanged();
+  void InvalidateSourceRowMap() { source_row_map_dirty_ = true; }
   void UpdateTotalLength();
 
  private:
+  // Maps each queued source row to its position in the queue.  Rebuilt on
+  // demand after rows move around, either in the queue or in the playlist,
+  // so the lookups the playlist does while painting and picking the next
+  // track don't have to scan the queue.
+  const QHash<int, int>& SourceRowMap() const;
+
+  // Removes the given queue positions in as few contiguous ranges as possible.
+  void RemoveProxyRows(QList<int> proxy_rows);
+
   QList<QPersistentModelIndex> source_indexes_;
+  mutable QHash<int, int> source_row_map_;
+  mutable bool source_row_map_dirty_;
   const Playlist* playlist_;
   quint64 total_length_ns_;
   QMetaObject::Connection count_changed_;
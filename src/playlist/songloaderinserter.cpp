@@ -15,13 +15,20 @@
    along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <QtConcurrentRun>
-
 #include "playlist.h"
 #include "songloaderinserter.h"
+
+#include <QFuture>
+#include <QHash>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+
 #include "core/logging.h"
+#include "core/remotetypecache.h"
 #include "core/songloader.h"
+#include "core/taskexecutor.h"
 #include "core/taskmanager.h"
+#include "library/librarybackend.h"
 
 SongLoaderInserter::SongLoaderInserter(TaskManager* task_manager,
                                        LibraryBackendInterface* library,
@@ -31,9 +38,12 @@ SongLoaderInserter::SongLoaderInserter(TaskManager* task_manager,
       row_(-1),
       play_now_(true),
       enqueue_(false),
+      playlist_streamed_(false),
       library_(library),
       player_(player) {}
 
+const int SongLoaderInserter::kMaxParallelRemoteLoads = 4;
+
 SongLoaderInserter::~SongLoaderInserter() { qDeleteAll(pending_); }
 
 void SongLoaderInserter::Load(Playlist* destination, int row, bool play_now,
@@ -49,13 +59,45 @@ void SongLoaderInserter::Load(Playlist* destination, int row, bool play_now,
   connect(this, SIGNAL(PreloadFinished()), SLOT(InsertSongs()));
   connect(this, SIGNAL(EffectiveLoadFinished(const SongList&)), destination,
           SLOT(UpdateItems(const SongList&)));
+  connect(this, SIGNAL(PlaylistChunkReady(SongList)),
+          SLOT(InsertPlaylistChunk(SongList)));
+
+  // A single playlist is inserted progressively as it's loaded.  With more
+  // than one URL its songs would end up out of order with the others, and
+  // enqueuing each chunk next would reverse them.
+  const bool stream_playlist = urls.count() == 1 && !enqueue_next;
 
+  // Look up all the local files in the library together, instead of making
+  // each SongLoader query for its own.
+  QList<QUrl> local_urls;
   for (const QUrl& url : urls) {
+    if (url.scheme() == "file") local_urls << url;
+  }
+  QHash<QByteArray, SongList> library_songs;
+  if (!local_urls.isEmpty()) {
+    for (const Song& song : library_->GetSongsByUrls(local_urls)) {
+      library_songs[song.url().toEncoded()] << song;
+    }
+  }
+
+  for (const QUrl& url : urls) {
+    if (url.scheme() == "file") {
+      auto it = library_songs.constFind(url.toEncoded());
+      if (it != library_songs.constEnd()) {
+        songs_ << it.value();
+        continue;
+      }
+    }
+
     SongLoader* loader = new SongLoader(library_, player_, this);
 
-    SongLoader::Result ret = loader->Load(url);
+    SongLoader::Result ret = loader->LoadNotInLibrary(url);
 
     if (ret == SongLoader::BlockingLoadRequired) {
+      if (stream_playlist) {
+        connect(loader, SIGNAL(PlaylistChunkLoaded(SongList)),
+                SLOT(PlaylistChunkLoaded(SongList)), Qt::DirectConnection);
+      }
       pending_.append(loader);
       continue;
     }
@@ -71,7 +113,9 @@ void SongLoaderInserter::Load(Playlist* destination, int row, bool play_now,
     InsertSongs();
     deleteLater();
   } else {
-    QtConcurrent::run(this, &SongLoaderInserter::AsyncLoad);
+    TaskExecutor::Instance()->Run<void>(
+        TaskExecutor::Lane_Interactive,
+        std::bind(&SongLoaderInserter::AsyncLoad, this));
   }
 }
 
@@ -122,12 +166,28 @@ void SongLoaderInserter::AudioCDTagsLoaded(bool success) {
 void SongLoaderInserter::InsertSongs() {
   // Insert songs (that haven't been completely loaded) to allow user to see
   // and play them while not loaded completely
-  if (destination_) {
+  if (destination_ && !songs_.isEmpty()) {
     destination_->InsertSongsOrLibraryItems(songs_, row_, play_now_, enqueue_,
                                             enqueue_next_);
   }
 }
 
+void SongLoaderInserter::PlaylistChunkLoaded(const SongList& songs) {
+  playlist_streamed_ = true;
+  emit PlaylistChunkReady(songs);
+}
+
+void SongLoaderInserter::InsertPlaylistChunk(const SongList& songs) {
+  if (!destination_) return;
+
+  destination_->InsertSongsOrLibraryItems(songs, row_, play_now_, enqueue_,
+                                          enqueue_next_);
+
+  // The next chunk goes after this one, and only the first should play
+  if (row_ != -1) row_ += songs.count();
+  play_now_ = false;
+}
+
 void SongLoaderInserter::AsyncLoad() {
   // First, quick load raw songs.
   int async_progress = 0;
@@ -135,9 +195,13 @@ void SongLoaderInserter::AsyncLoad() {
   task_manager_->SetTaskProgress(async_load_id, async_progress,
                                  pending_.count());
   bool first_loaded = false;
+  const QHash<SongLoader*, int> remote_results = LoadRemoteFilenamesBlocking();
   for (int i = 0; i < pending_.count(); ++i) {
     SongLoader* loader = pending_[i];
-    SongLoader::Result res = loader->LoadFilenamesBlocking();
+    SongLoader::Result res =
+        remote_results.contains(loader)
+            ? SongLoader::Result(remote_results[loader])
+            : loader->LoadFilenamesBlocking();
 
     task_manager_->SetTaskProgress(async_load_id, ++async_progress);
 
@@ -145,6 +209,12 @@ void SongLoaderInserter::AsyncLoad() {
       emit Error(tr("Error loading %1").arg(loader->url().toString()));
       continue;
     }
+    if (playlist_streamed_) {
+      // Its songs have been inserted already, with their metadata.
+      playlist_streamed_ = false;
+      first_loaded = true;
+      continue;
+    }
     if (!first_loaded) {
       // Load everything from the first song.  It'll start playing as soon as
       // we emit PreloadFinished, so it needs to have the duration set to show
@@ -157,6 +227,9 @@ void SongLoaderInserter::AsyncLoad() {
   task_manager_->SetTaskFinished(async_load_id);
   emit PreloadFinished();
 
+  // Keep what the remote urls turned out to be for next time.
+  RemoteTypeCache::Instance()->Save();
+
   // Songs are inserted in playlist, now load them completely.
   async_progress = 0;
   async_load_id = task_manager_->StartTask(tr("Loading tracks info"));
@@ -178,3 +251,30 @@ void SongLoaderInserter::AsyncLoad() {
 
   deleteLater();
 }
+
+QHash<SongLoader*, int> SongLoaderInserter::LoadRemoteFilenamesBlocking() {
+  QHash<SongLoader*, int> ret;
+
+  QList<SongLoader*> remote;
+  for (SongLoader* loader : pending_) {
+    if (!loader->url().isLocalFile()) remote << loader;
+  }
+  // A single playlist might be streamed into the playlist as it loads, which
+  // has to happen in order, so leave it to AsyncLoad.
+  if (remote.count() < 2) return ret;
+
+  // The threads spend their time waiting on servers, not the CPU.
+  QThreadPool pool;
+  pool.setMaxThreadCount(kMaxParallelRemoteLoads);
+
+  QList<QFuture<SongLoader::Result>> futures;
+  for (SongLoader* loader : remote) {
+    futures << QtConcurrent::run(&pool, loader,
+                                 &SongLoader::LoadFilenamesBlocking);
+  }
+  for (int i = 0; i < remote.count(); ++i) {
+    ret[remote[i]] = futures[i].result();
+  }
+
+  return ret;
+}
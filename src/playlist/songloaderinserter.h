@@ -18,6 +18,7 @@
 #ifndef SONGLOADERINSERTER_H
 #define SONGLOADERINSERTER_H
 
+#include <QHash>
 #include <QList>
 #include <QObject>
 #include <QUrl>
@@ -39,6 +40,9 @@ class SongLoaderInserter : public QObject {
                      LibraryBackendInterface* library, const Player* player);
   ~SongLoaderInserter();
 
+  // Remote urls are looked at this many at a time.
+  static const int kMaxParallelRemoteLoads;
+
   void Load(Playlist* destination, int row, bool play_now, bool enqueue,
             bool enqueue_next, const QList<QUrl>& urls);
   void LoadAudioCD(Playlist* destination, int row, bool play_now, bool enqueue,
@@ -48,15 +52,22 @@ class SongLoaderInserter : public QObject {
   void Error(const QString& message);
   void PreloadFinished();
   void EffectiveLoadFinished(const SongList& songs);
+  void PlaylistChunkReady(const SongList& songs);
 
  private slots:
   void DestinationDestroyed();
   void AudioCDTracksLoaded(SongLoader* loader);
   void AudioCDTagsLoaded(bool success);
   void InsertSongs();
+  // Called in the loading thread with each chunk of a playlist being loaded.
+  void PlaylistChunkLoaded(const SongList& songs);
+  void InsertPlaylistChunk(const SongList& songs);
 
  private:
   void AsyncLoad();
+  // Loads the filenames of all the pending remote urls, a few at a time, and
+  // returns the results.  Blocks.
+  QHash<SongLoader*, int> LoadRemoteFilenamesBlocking();
 
  private:
   TaskManager* task_manager_;
@@ -68,6 +79,9 @@ class SongLoaderInserter : public QObject {
   bool enqueue_next_;
 
   SongList songs_;
+  // Set by PlaylistChunkLoaded if the last loader's songs have already been
+  // sent for insertion.  Only touched from the loading thread.
+  bool playlist_streamed_;
 
   QList<SongLoader*> pending_;
   LibraryBackendInterface* library_;
@@ -0,0 +1,46 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "songmimedata.h"
+
+#include <QUrl>
+
+namespace {
+const char* kUriListMimeType = "text/uri-list";
+}
+
+void SongMimeData::SetSongLoader(const SongLoader& loader) {
+  song_loader_ = loader;
+
+  // The URLs aren't known yet, but other applications still need to see
+  // that they can have them.
+  setData(kUriListMimeType, QByteArray());
+}
+
+QVariant SongMimeData::retrieveData(const QString& mimetype,
+                                    QVariant::Type type) const {
+  if (song_loader_ && mimetype == kUriListMimeType) {
+    if (!urls_loaded_) {
+      for (const Song& song : song_loader_()) {
+        urls_ << song.url();
+      }
+      urls_loaded_ = true;
+    }
+    return urls_;
+  }
+
+  return MimeData::retrieveData(mimetype, type);
+}
@@ -18,6 +18,8 @@
 #ifndef SONGMIMEDATA_H
 #define SONGMIMEDATA_H
 
+#include <functional>
+
 #include <QMimeData>
 
 #include "core/mimedata.h"
@@ -29,10 +31,28 @@ class SongMimeData : public MimeData {
   Q_OBJECT
 
  public:
-  SongMimeData() : backend(nullptr) {}
+  typedef std::function<SongList()> SongLoader;
+
+  SongMimeData() : backend(nullptr), urls_loaded_(false) {}
+
+  // Used instead of songs when finding them all would take too long to do
+  // before the drag starts.  The loader can be run in any thread, and is
+  // called when the data is dropped.
+  void SetSongLoader(const SongLoader& loader);
+  const SongLoader& song_loader() const { return song_loader_; }
 
   LibraryBackendInterface* backend;
   SongList songs;
+
+ protected:
+  // Loads the songs right away if something outside Clementine asks for
+  // their URLs.
+  QVariant retrieveData(const QString& mimetype, QVariant::Type type) const;
+
+ private:
+  SongLoader song_loader_;
+  mutable bool urls_loaded_;
+  mutable QList<QVariant> urls_;
 };
 
 #endif  // SONGMIMEDATA_H
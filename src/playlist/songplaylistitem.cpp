@@ -55,6 +55,15 @@ void SongPlaylistItem::Reload() {
                                                 &song_);
 }
 
+bool SongPlaylistItem::GetReloadableSong(Song* song) const {
+  if (song_.url().scheme() != "file") return false;
+
+  *song = song_;
+  return true;
+}
+
+void SongPlaylistItem::SetReloadedSong(const Song& song) { song_ = song; }
+
 Song SongPlaylistItem::Metadata() const {
   if (HasTemporaryMetadata()) return temp_metadata_;
   return song_;
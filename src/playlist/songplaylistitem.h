@@ -33,6 +33,8 @@ class SongPlaylistItem : public PlaylistItem {
   // attributes (if any) but won't parse the CUE!
   bool InitFromQuery(const SqlRow& query);
   void Reload();
+  bool GetReloadableSong(Song* song) const;
+  void SetReloadedSong(const Song& song);
 
   Song Metadata() const;
 
@@ -51,12 +51,18 @@ SongList AsxIniParser::Load(QIODevice* device, const QString& playlist_path,
 
 void AsxIniParser::Save(const SongList& songs, QIODevice* device,
                         const QDir& dir, Playlist::Path path_type) const {
+  SaveChunked(songs.count(), SingleChunk(songs), device, dir, path_type);
+}
+
+void AsxIniParser::SaveChunked(int, const ChunkSource& next_chunk,
+                               QIODevice* device, const QDir& dir,
+                               Playlist::Path path_type) const {
   QTextStream s(device);
-  s << "[Reference]" << endl;
+  s << "[Reference]\n";
 
   int n = 1;
-  for (const Song& song : songs) {
-    s << "Ref" << n << "=" << URLOrFilename(song.url(), dir, path_type) << endl;
+  ForEachSong(next_chunk, [&](const Song& song) {
+    s << "Ref" << n << "=" << URLOrFilename(song.url(), dir, path_type) << "\n";
     ++n;
-  }
+  });
 }
@@ -35,6 +35,9 @@ class AsxIniParser : public ParserBase {
                 const QDir& dir = QDir()) const;
   void Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
             Playlist::Path path_type = Playlist::Path_Automatic) const;
+  void SaveChunked(int song_count, const ChunkSource& next_chunk,
+                   QIODevice* device, const QDir& dir = QDir(),
+                   Playlist::Path path_type = Playlist::Path_Automatic) const;
 };
 
 #endif  // ASXINIPARSER_H
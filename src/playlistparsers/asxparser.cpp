@@ -117,8 +117,14 @@ return_song:
   return song;
 }
 
-void ASXParser::Save(const SongList& songs, QIODevice* device, const QDir&,
+void ASXParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
                      Playlist::Path path_type) const {
+  SaveChunked(songs.count(), SingleChunk(songs), device, dir, path_type);
+}
+
+void ASXParser::SaveChunked(int, const ChunkSource& next_chunk,
+                            QIODevice* device, const QDir&,
+                            Playlist::Path path_type) const {
   QXmlStreamWriter writer(device);
   writer.setAutoFormatting(true);
   writer.setAutoFormattingIndent(2);
@@ -126,7 +132,7 @@ void ASXParser::Save(const SongList& songs, QIODevice* device, const QDir&,
   {
     StreamElement asx("asx", &writer);
     writer.writeAttribute("version", "3.0");
-    for (const Song& song : songs) {
+    ForEachSong(next_chunk, [&](const Song& song) {
       StreamElement entry("entry", &writer);
       writer.writeTextElement("title", song.title());
       {
@@ -136,7 +142,7 @@ void ASXParser::Save(const SongList& songs, QIODevice* device, const QDir&,
       if (!song.artist().isEmpty()) {
         writer.writeTextElement("author", song.artist());
       }
-    }
+    });
   }
   writer.writeEndDocument();
 }
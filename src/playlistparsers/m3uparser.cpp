@@ -21,7 +21,6 @@
 
 #include "playlist/playlist.h"
 
-#include <QBuffer>
 #include <QtDebug>
 
 M3UParser::M3UParser(LibraryBackendInterface* library, QObject* parent)
@@ -30,53 +29,81 @@ M3UParser::M3UParser(LibraryBackendInterface* library, QObject* parent)
 SongList M3UParser::Load(QIODevice* device, const QString& playlist_path,
                          const QDir& dir) const {
   SongList ret;
+  LoadChunked(device, [&ret](const SongList& songs) { ret << songs; },
+              playlist_path, dir);
+  return ret;
+}
 
+void M3UParser::LoadChunked(QIODevice* device, const ChunkCallback& callback,
+                            const QString& playlist_path,
+                            const QDir& dir) const {
   M3UType type = STANDARD;
   Metadata current_metadata;
-
-  QString data = QString::fromUtf8(device->readAll());
-  data.replace('\r', '\n');
-  data.replace("\n\n", "\n");
-  QByteArray bytes = data.toUtf8();
-  QBuffer buffer(&bytes);
-  buffer.open(QIODevice::ReadOnly);
-
-  QString line = QString::fromUtf8(buffer.readLine()).trimmed();
-  if (line.startsWith("#EXTM3U")) {
-    // This is in extended M3U format.
-    type = EXTENDED;
-    line = QString::fromUtf8(buffer.readLine()).trimmed();
-  }
-
-  forever {
-    if (line.startsWith('#')) {
-      // Extended info or comment.
-      if (type == EXTENDED && line.startsWith("#EXT")) {
-        if (!ParseMetadata(line, &current_metadata)) {
-          qLog(Warning) << "Failed to parse metadata: " << line;
+  bool first_line = true;
+
+  // Entries are collected and then loaded a chunk at a time.
+  QStringList locations;
+  QList<Metadata> metadata;
+
+  while (!device->atEnd()) {
+    // Some playlists end their lines with just a \r
+    const QStringList parts = QString::fromUtf8(device->readLine()).split('\r');
+    for (const QString& part : parts) {
+      const QString line = part.trimmed();
+
+      if (first_line) {
+        first_line = false;
+        if (line.startsWith("#EXTM3U")) {
+          // This is in extended M3U format.
+          type = EXTENDED;
+          continue;
         }
       }
-    } else if (!line.isEmpty()) {
-      Song song = LoadSong(line, 0, dir);
-      if (!current_metadata.title.isEmpty()) {
-        song.set_title(current_metadata.title);
-      }
-      if (!current_metadata.artist.isEmpty()) {
-        song.set_artist(current_metadata.artist);
-      }
-      if (current_metadata.length > 0) {
-        song.set_length_nanosec(current_metadata.length);
+
+      if (line.startsWith('#')) {
+        // Extended info or comment.
+        if (type == EXTENDED && line.startsWith("#EXT")) {
+          if (!ParseMetadata(line, &current_metadata)) {
+            qLog(Warning) << "Failed to parse metadata: " << line;
+          }
+        }
+      } else if (!line.isEmpty()) {
+        locations << line;
+        metadata << current_metadata;
+        current_metadata = Metadata();
+
+        if (locations.count() >= kLoadChunkSize) {
+          callback(LoadEntries(locations, metadata, dir));
+          locations.clear();
+          metadata.clear();
+        }
       }
-      ret << song;
+    }
+  }
+
+  if (!locations.isEmpty()) {
+    callback(LoadEntries(locations, metadata, dir));
+  }
+}
+
+SongList M3UParser::LoadEntries(const QStringList& locations,
+                                const QList<Metadata>& metadata,
+                                const QDir& dir) const {
+  SongList ret = LoadSongs(locations, dir);
 
-      current_metadata = Metadata();
+  // Anything in the playlist overrides what was in the library or the file
+  for (int i = 0; i < ret.count(); ++i) {
+    Song& song = ret[i];
+    if (!metadata[i].title.isEmpty()) {
+      song.set_title(metadata[i].title);
     }
-    if (buffer.atEnd()) {
-      break;
+    if (!metadata[i].artist.isEmpty()) {
+      song.set_artist(metadata[i].artist);
+    }
+    if (metadata[i].length > 0) {
+      song.set_length_nanosec(metadata[i].length);
     }
-    line = QString::fromUtf8(buffer.readLine()).trimmed();
   }
-
   return ret;
 }
 
@@ -106,6 +133,12 @@ bool M3UParser::ParseMetadata(const QString& line,
 
 void M3UParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
                      Playlist::Path path_type) const {
+  SaveChunked(songs.count(), SingleChunk(songs), device, dir, path_type);
+}
+
+void M3UParser::SaveChunked(int, const ChunkSource& next_chunk,
+                            QIODevice* device, const QDir& dir,
+                            Playlist::Path path_type) const {
   device->write("#EXTM3U\n");
 
   QSettings s;
@@ -113,9 +146,9 @@ void M3UParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
   bool writeMetadata = s.value(Playlist::kWriteMetadata, true).toBool();
   s.endGroup();
 
-  for (const Song& song : songs) {
+  ForEachSong(next_chunk, [&](const Song& song) {
     if (song.url().isEmpty()) {
-      continue;
+      return;
     }
     if (writeMetadata) {
       QString meta = QString("#EXTINF:%1,%2 - %3\n")
@@ -126,7 +159,7 @@ void M3UParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
     }
     device->write(URLOrFilename(song.url(), dir, path_type).toUtf8());
     device->write("\n");
-  }
+  });
 }
 
 bool M3UParser::TryMagic(const QByteArray& data) const {
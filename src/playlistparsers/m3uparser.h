@@ -41,8 +41,14 @@ class M3UParser : public ParserBase {
 
   SongList Load(QIODevice* device, const QString& playlist_path = "",
                 const QDir& dir = QDir()) const;
+  void LoadChunked(QIODevice* device, const ChunkCallback& callback,
+                   const QString& playlist_path = "",
+                   const QDir& dir = QDir()) const;
   void Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
             Playlist::Path path_type = Playlist::Path_Automatic) const;
+  void SaveChunked(int song_count, const ChunkSource& next_chunk,
+                   QIODevice* device, const QDir& dir = QDir(),
+                   Playlist::Path path_type = Playlist::Path_Automatic) const;
 
  private:
   enum M3UType {
@@ -59,6 +65,8 @@ class M3UParser : public ParserBase {
   };
 
   bool ParseMetadata(const QString& line, Metadata* metadata) const;
+  SongList LoadEntries(const QStringList& locations,
+                       const QList<Metadata>& metadata, const QDir& dir) const;
 
   FRIEND_TEST(M3UParserTest, ParsesMetadata);
   FRIEND_TEST(M3UParserTest, ParsesTrackLocation);
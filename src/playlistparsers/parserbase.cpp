@@ -22,15 +22,54 @@
 #include "library/sqlrow.h"
 #include "playlist/playlist.h"
 
+#include <memory>
+
+#include <QHash>
 #include <QUrl>
 
+const int ParserBase::kLoadChunkSize = 1000;
+const int ParserBase::kSaveChunkSize = 1000;
+
 ParserBase::ParserBase(LibraryBackendInterface* library, QObject* parent)
     : QObject(parent), library_(library) {}
 
-void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
-                          const QDir& dir, Song* song) const {
+void ParserBase::LoadChunked(QIODevice* device, const ChunkCallback& callback,
+                             const QString& playlist_path,
+                             const QDir& dir) const {
+  callback(Load(device, playlist_path, dir));
+}
+
+void ParserBase::SaveChunked(int song_count, const ChunkSource& next_chunk,
+                             QIODevice* device, const QDir& dir,
+                             Playlist::Path path_type) const {
+  SongList songs;
+  songs.reserve(song_count);
+  for (SongList chunk = next_chunk(); !chunk.isEmpty(); chunk = next_chunk()) {
+    songs << chunk;
+  }
+  Save(songs, device, dir, path_type);
+}
+
+void ParserBase::ForEachSong(const ChunkSource& next_chunk,
+                             const std::function<void(const Song&)>& f) {
+  for (SongList chunk = next_chunk(); !chunk.isEmpty(); chunk = next_chunk()) {
+    for (const Song& song : chunk) f(song);
+  }
+}
+
+ParserBase::ChunkSource ParserBase::SingleChunk(const SongList& songs) {
+  std::shared_ptr<bool> done(new bool(false));
+  return [songs, done]() {
+    if (*done) return SongList();
+    *done = true;
+    return songs;
+  };
+}
+
+QString ParserBase::LocalFilename(const QString& filename_or_url,
+                                  const QDir& dir, Song* song) const {
   if (filename_or_url.isEmpty()) {
-    return;
+    return QString();
   }
 
   QString filename = filename_or_url;
@@ -43,7 +82,7 @@ void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
       song->set_url(QUrl::fromUserInput(filename_or_url));
       song->set_filetype(Song::Type_Stream);
       song->set_valid(true);
-      return;
+      return QString();
     }
   }
 
@@ -62,6 +101,16 @@ void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
     filename = QFileInfo(filename).canonicalFilePath();
   }
 
+  return filename;
+}
+
+void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
+                          const QDir& dir, Song* song) const {
+  const QString filename = LocalFilename(filename_or_url, dir, song);
+  if (filename.isEmpty()) {
+    return;
+  }
+
   const QUrl url = QUrl::fromLocalFile(filename);
 
   // Search in the library
@@ -79,6 +128,65 @@ void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
   }
 }
 
+SongList ParserBase::LoadSongs(const QStringList& filenames_or_urls,
+                               const QDir& dir) const {
+  SongList ret;
+  ret.reserve(filenames_or_urls.count());
+
+  QList<int> local;
+  QStringList filenames;
+  QList<QUrl> urls;
+  for (const QString& filename_or_url : filenames_or_urls) {
+    Song song;
+    const QString filename = LocalFilename(filename_or_url, dir, &song);
+    if (!filename.isEmpty()) {
+      local << ret.count();
+      filenames << filename;
+      urls << QUrl::fromLocalFile(filename);
+    }
+    ret << song;
+  }
+
+  if (local.isEmpty()) {
+    return ret;
+  }
+
+  // Search in the library
+  QHash<QByteArray, Song> library_songs;  // encoded filename -> song
+  if (library_) {
+    for (const Song& song : library_->GetSongsByUrls(urls)) {
+      if (song.beginning_nanosec() == 0) {
+        library_songs.insert(song.url().toEncoded(), song);
+      }
+    }
+  }
+
+  // Anything that wasn't found gets its metadata from disk.
+  QList<int> to_read;
+  QStringList to_read_filenames;
+  SongList songs_on_disk;
+  for (int i = 0; i < local.count(); ++i) {
+    const Song library_song = library_songs.value(urls[i].toEncoded());
+    if (library_song.is_valid()) {
+      ret[local[i]] = library_song;
+    } else {
+      to_read << local[i];
+      to_read_filenames << filenames[i];
+      songs_on_disk << ret[local[i]];
+    }
+  }
+
+  if (!to_read.isEmpty()) {
+    TagReaderClient::Instance()->ReadFilesBlocking(to_read_filenames,
+                                                   &songs_on_disk);
+    for (int i = 0; i < to_read.count(); ++i) {
+      ret[to_read[i]] = songs_on_disk[i];
+    }
+  }
+
+  return ret;
+}
+
 Song ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
                           const QDir& dir) const {
   Song song;
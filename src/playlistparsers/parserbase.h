@@ -18,6 +18,8 @@
 #ifndef PARSERBASE_H
 #define PARSERBASE_H
 
+#include <functional>
+
 #include <QObject>
 #include <QDir>
 
@@ -51,10 +53,41 @@ class ParserBase : public QObject {
   // from the parser's point of view).
   virtual SongList Load(QIODevice* device, const QString& playlist_path = "",
                         const QDir& dir = QDir()) const = 0;
+
+  // Loads the playlist like Load(), but passes the songs to callback a chunk
+  // at a time as they are loaded, so the caller can use the start of a long
+  // playlist before the rest has been read.  Parsers that can't do this load
+  // everything first and pass it in one chunk.
+  typedef std::function<void(const SongList&)> ChunkCallback;
+  virtual void LoadChunked(QIODevice* device, const ChunkCallback& callback,
+                           const QString& playlist_path = "",
+                           const QDir& dir = QDir()) const;
+
+  // The number of songs LoadChunked() tries to put in each chunk.
+  static const int kLoadChunkSize;
+
   virtual void Save(
       const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
       Playlist::Path path_type = Playlist::Path_Automatic) const = 0;
 
+  // Saves the playlist like Save(), but takes the songs from next_chunk a
+  // chunk at a time until it returns an empty list, writing each chunk as it
+  // goes, so a huge playlist never has to be in memory all at once.
+  // song_count is the total, for formats that write it before the songs.
+  // Parsers that can't do this collect everything and call Save().
+  typedef std::function<SongList()> ChunkSource;
+  virtual void SaveChunked(
+      int song_count, const ChunkSource& next_chunk, QIODevice* device,
+      const QDir& dir = QDir(),
+      Playlist::Path path_type = Playlist::Path_Automatic) const;
+
+  // The number of songs callers should try to put in each chunk they pass to
+  // SaveChunked().
+  static const int kSaveChunkSize;
+
+  // A ChunkSource that gives all the songs in one chunk.
+  static ChunkSource SingleChunk(const SongList& songs);
+
  protected:
   // Loads a song.  If filename_or_url is a URL (with a scheme other than
   // "file") then it is set on the song and the song marked as a stream.
@@ -66,6 +99,12 @@ class ParserBase : public QObject {
                 const QDir& dir) const;
   void LoadSong(const QString& filename_or_url, qint64 beginning,
                 const QDir& dir, Song* song) const;
+  // Loads several songs at the start of their files, as LoadSong does, but
+  // looks them all up in the library in one go and reads the files that
+  // aren't in the library in one tagreader batch.  Returns one song for each
+  // entry, in the same order.
+  SongList LoadSongs(const QStringList& filenames_or_urls,
+                     const QDir& dir) const;
 
   // If the URL is a file:// URL then returns its path, absolute or relative to
   // the directory depending on the path_type option.
@@ -74,6 +113,17 @@ class ParserBase : public QObject {
   QString URLOrFilename(const QUrl& url, const QDir& dir,
                         Playlist::Path path_type) const;
 
+  // Calls f for every song next_chunk gives.
+  static void ForEachSong(const ChunkSource& next_chunk,
+                          const std::function<void(const Song&)>& f);
+
+ private:
+  // Does the part of LoadSong that needs neither the library nor the file.
+  // Streams are filled in straight away and give an empty string, anything
+  // else gives the absolute, canonical filename to load.
+  QString LocalFilename(const QString& filename_or_url, const QDir& dir,
+                        Song* song) const;
+
  private:
   LibraryBackendInterface* library_;
 };
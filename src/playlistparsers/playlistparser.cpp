@@ -154,6 +154,14 @@ SongList PlaylistParser::LoadFromDevice(QIODevice* device,
 
 void PlaylistParser::Save(const SongList& songs, const QString& filename,
                           Playlist::Path path_type) const {
+  SaveChunked(songs.count(), ParserBase::SingleChunk(songs), filename,
+              path_type);
+}
+
+void PlaylistParser::SaveChunked(int song_count,
+                                 const ParserBase::ChunkSource& next_chunk,
+                                 const QString& filename,
+                                 Playlist::Path path_type) const {
   QFileInfo info(filename);
 
   // Find a parser that supports this file extension
@@ -167,5 +175,6 @@ void PlaylistParser::Save(const SongList& songs, const QString& filename,
   QFile file(filename);
   file.open(QIODevice::WriteOnly);
 
-  return parser->Save(songs, &file, info.absolutePath(), path_type);
+  parser->SaveChunked(song_count, next_chunk, &file, info.absolutePath(),
+                      path_type);
 }
@@ -54,6 +54,10 @@ class PlaylistParser : public QObject {
                           const QDir& dir_hint = QDir()) const;
   void Save(const SongList& songs, const QString& filename,
             Playlist::Path) const;
+  // Writes the songs next_chunk gives straight to the file, see
+  // ParserBase::SaveChunked().
+  void SaveChunked(int song_count, const ParserBase::ChunkSource& next_chunk,
+                   const QString& filename, Playlist::Path path_type) const;
 
  private:
   QString FilterForParser(const ParserBase* parser,
@@ -28,6 +28,7 @@ PLSParser::PLSParser(LibraryBackendInterface* library, QObject* parent)
 SongList PLSParser::Load(QIODevice* device, const QString& playlist_path,
                          const QDir& dir) const {
   QMap<int, Song> songs;
+  QMap<int, QString> files;
   QRegExp n_re("\\d+$");
 
   while (!device->atEnd()) {
@@ -40,14 +41,7 @@ SongList PLSParser::Load(QIODevice* device, const QString& playlist_path,
     int n = n_re.cap(0).toInt();
 
     if (key.startsWith("file")) {
-      Song song = LoadSong(value, 0, dir);
-
-      // Use the title and length we've already loaded if any
-      if (!songs[n].title().isEmpty()) song.set_title(songs[n].title());
-      if (songs[n].length_nanosec() != -1)
-        song.set_length_nanosec(songs[n].length_nanosec());
-
-      songs[n] = song;
+      files[n] = value;
     } else if (key.startsWith("title")) {
       songs[n].set_title(value);
     } else if (key.startsWith("length")) {
@@ -58,24 +52,45 @@ SongList PLSParser::Load(QIODevice* device, const QString& playlist_path,
     }
   }
 
+  // Load all the files at once
+  const SongList loaded = LoadSongs(files.values(), dir);
+  const QList<int> numbers = files.keys();
+  for (int i = 0; i < numbers.count(); ++i) {
+    Song song = loaded[i];
+    const Song entry = songs.value(numbers[i]);
+
+    // Use the title and length from the playlist if any
+    if (!entry.title().isEmpty()) song.set_title(entry.title());
+    if (entry.length_nanosec() != -1)
+      song.set_length_nanosec(entry.length_nanosec());
+
+    songs[numbers[i]] = song;
+  }
+
   return songs.values();
 }
 
 void PLSParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
                      Playlist::Path path_type) const {
+  SaveChunked(songs.count(), SingleChunk(songs), device, dir, path_type);
+}
+
+void PLSParser::SaveChunked(int song_count, const ChunkSource& next_chunk,
+                            QIODevice* device, const QDir& dir,
+                            Playlist::Path path_type) const {
   QTextStream s(device);
-  s << "[playlist]" << endl;
-  s << "Version=2" << endl;
-  s << "NumberOfEntries=" << songs.count() << endl;
+  s << "[playlist]\n";
+  s << "Version=2\n";
+  s << "NumberOfEntries=" << song_count << "\n";
 
   int n = 1;
-  for (const Song& song : songs) {
+  ForEachSong(next_chunk, [&](const Song& song) {
     s << "File" << n << "=" << URLOrFilename(song.url(), dir, path_type)
-      << endl;
-    s << "Title" << n << "=" << song.title() << endl;
-    s << "Length" << n << "=" << song.length_nanosec() / kNsecPerSec << endl;
+      << "\n";
+    s << "Title" << n << "=" << song.title() << "\n";
+    s << "Length" << n << "=" << song.length_nanosec() / kNsecPerSec << "\n";
     ++n;
-  }
+  });
 }
 
 bool PLSParser::TryMagic(const QByteArray& data) const {
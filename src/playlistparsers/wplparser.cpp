@@ -78,6 +78,12 @@ void WplParser::ParseSeq(const QDir& dir, QXmlStreamReader* reader,
 
 void WplParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
                      Playlist::Path path_type) const {
+  SaveChunked(songs.count(), SingleChunk(songs), device, dir, path_type);
+}
+
+void WplParser::SaveChunked(int song_count, const ChunkSource& next_chunk,
+                            QIODevice* device, const QDir& dir,
+                            Playlist::Path path_type) const {
   QXmlStreamWriter writer(device);
   writer.setAutoFormatting(true);
   writer.setAutoFormattingIndent(2);
@@ -89,18 +95,18 @@ void WplParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
     StreamElement head("head", &writer);
     WriteMeta("Generator", "Clementine -- " CLEMENTINE_VERSION_DISPLAY,
               &writer);
-    WriteMeta("ItemCount", QString::number(songs.count()), &writer);
+    WriteMeta("ItemCount", QString::number(song_count), &writer);
   }
 
   {
     StreamElement body("body", &writer);
     {
       StreamElement seq("seq", &writer);
-      for (const Song& song : songs) {
+      ForEachSong(next_chunk, [&](const Song& song) {
         writer.writeStartElement("media");
         writer.writeAttribute("src", URLOrFilename(song.url(), dir, path_type));
         writer.writeEndElement();
-      }
+      });
     }
   }
 }
@@ -34,6 +34,9 @@ class WplParser : public XMLParser {
                 const QDir& dir) const;
   void Save(const SongList& songs, QIODevice* device, const QDir& dir,
             Playlist::Path path_type = Playlist::Path_Automatic) const;
+  void SaveChunked(int song_count, const ChunkSource& next_chunk,
+                   QIODevice* device, const QDir& dir,
+                   Playlist::Path path_type = Playlist::Path_Automatic) const;
 
  private:
   void ParseSeq(const QDir& dir, QXmlStreamReader* reader,
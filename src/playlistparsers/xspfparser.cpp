@@ -41,8 +41,27 @@ SongList XSPFParser::Load(QIODevice* device, const QString& playlist_path,
     return ret;
   }
 
+  SongList entries;
+  QStringList locations;
   while (!reader.atEnd() && Utilities::ParseUntilElement(&reader, "track")) {
-    Song song = ParseTrack(&reader, dir);
+    QString location;
+    entries << ParseTrack(&reader, &location);
+    locations << location;
+  }
+
+  // Load all the tracks at once
+  const SongList loaded = LoadSongs(locations, dir);
+  for (int i = 0; i < loaded.count(); ++i) {
+    Song song = loaded[i];
+    const Song& entry = entries[i];
+
+    // Override metadata with what was in the playlist
+    song.set_title(entry.title());
+    song.set_artist(entry.artist());
+    song.set_album(entry.album());
+    song.set_length_nanosec(entry.length_nanosec());
+    song.set_track(entry.track());
+
     if (song.is_valid()) {
       ret << song;
     }
@@ -50,8 +69,9 @@ SongList XSPFParser::Load(QIODevice* device, const QString& playlist_path,
   return ret;
 }
 
-Song XSPFParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
-  QString title, artist, album, location;
+Song XSPFParser::ParseTrack(QXmlStreamReader* reader,
+                            QString* location) const {
+  QString title, artist, album;
   qint64 nanosec = -1;
   int track_num = -1;
 
@@ -61,7 +81,7 @@ Song XSPFParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
       case QXmlStreamReader::StartElement: {
         QStringRef name = reader->name();
         if (name == "location") {
-          location = reader->readElementText();
+          *location = reader->readElementText();
         } else if (name == "title") {
           title = reader->readElementText();
         } else if (name == "creator") {
@@ -100,9 +120,7 @@ Song XSPFParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
   }
 
 return_song:
-  Song song = LoadSong(location, 0, dir);
-
-  // Override metadata with what was in the playlist
+  Song song;
   song.set_title(title);
   song.set_artist(artist);
   song.set_album(album);
@@ -113,6 +131,12 @@ return_song:
 
 void XSPFParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
                       Playlist::Path path_type) const {
+  SaveChunked(songs.count(), SingleChunk(songs), device, dir, path_type);
+}
+
+void XSPFParser::SaveChunked(int, const ChunkSource& next_chunk,
+                             QIODevice* device, const QDir& dir,
+                             Playlist::Path path_type) const {
   QFileInfo file;
   QXmlStreamWriter writer(device);
   writer.setAutoFormatting(true);
@@ -128,7 +152,7 @@ void XSPFParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
   s.endGroup();
 
   StreamElement tracklist("trackList", &writer);
-  for (const Song& song : songs) {
+  ForEachSong(next_chunk, [&](const Song& song) {
     QString filename_or_url = URLOrFilename(song.url(), dir, path_type);
 
     StreamElement track("track", &writer);
@@ -175,7 +199,7 @@ void XSPFParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
         writer.writeTextElement("image", art_filename);
       }
     }
-  }
+  });
   writer.writeEndDocument();
 }
 
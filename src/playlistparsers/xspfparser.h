@@ -40,9 +40,13 @@ class XSPFParser : public XMLParser {
                 const QDir& dir = QDir()) const;
   void Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
             Playlist::Path path_type = Playlist::Path_Automatic) const;
+  void SaveChunked(int song_count, const ChunkSource& next_chunk,
+                   QIODevice* device, const QDir& dir = QDir(),
+                   Playlist::Path path_type = Playlist::Path_Automatic) const;
 
  private:
-  Song ParseTrack(QXmlStreamReader* reader, const QDir& dir) const;
+  // Reads a track's location and the metadata the playlist gives it.
+  Song ParseTrack(QXmlStreamReader* reader, QString* location) const;
 };
 
 #endif
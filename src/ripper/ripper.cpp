@@ -19,11 +19,11 @@
 
 #include <QFile>
 #include <QMutexLocker>
-#include <QtConcurrentRun>
 
 #include "core/closure.h"
 #include "core/logging.h"
 #include "core/tagreaderclient.h"
+#include "core/taskexecutor.h"
 #include "transcoder/transcoder.h"
 #include "core/utilities.h"
 
@@ -44,12 +44,17 @@ Ripper::Ripper(QObject* parent)
       cancel_requested_(false),
       finished_success_(0),
       finished_failed_(0),
-      files_tagged_(0) {
+      files_tagged_(0),
+      tracks_ripped_(0),
+      tracks_transcoded_(0),
+      ripping_complete_(false) {
   cdio_ = cdio_open(NULL, DRIVER_UNKNOWN);
 
-  connect(this, SIGNAL(RippingComplete()), transcoder_, SLOT(Start()));
+  connect(this, SIGNAL(RippingComplete()), SLOT(AllTracksRipped()));
   connect(transcoder_, SIGNAL(JobComplete(QString, QString, bool)),
           SLOT(TranscodingJobComplete(QString, QString, bool)));
+  connect(transcoder_, SIGNAL(JobProgress(QString, float)),
+          SLOT(TranscodingJobProgress(QString, float)));
   connect(transcoder_, SIGNAL(AllJobsComplete()),
           SLOT(AllTranscodingJobsComplete()));
   connect(transcoder_, SIGNAL(LogLine(QString)), SLOT(LogLine(QString)));
@@ -114,8 +119,17 @@ void Ripper::Start() {
   }
   SetupProgressInterval();
 
+  temporary_directory_ = Utilities::MakeTempDir() + "/";
+  finished_success_ = 0;
+  finished_failed_ = 0;
+  tracks_ripped_ = 0;
+  tracks_transcoded_ = 0;
+  ripping_complete_ = false;
+  transcode_progress_.clear();
+
   qLog(Debug) << "Ripping" << AddedTracks() << "tracks.";
-  QtConcurrent::run(this, &Ripper::Rip);
+  TaskExecutor::Instance()->Run<void>(TaskExecutor::Lane_Bulk,
+                                      std::bind(&Ripper::Rip, this));
 }
 
 void Ripper::Cancel() {
@@ -134,8 +148,14 @@ void Ripper::TranscodingJobComplete(const QString& input, const QString& output,
     finished_success_++;
   else
     finished_failed_++;
+  tracks_transcoded_++;
+  transcode_progress_.remove(input);
   UpdateProgress();
 
+  // The WAV isn't needed any more, so don't let them pile up while the rest
+  // of the disc is ripped.
+  QFile::remove(input);
+
   // The the transcoder does not overwrite files. Instead, it changes
   // the name of the output file. We need to update the transcoded
   // filename for the corresponding track so that we tag the correct
@@ -148,11 +168,41 @@ void Ripper::TranscodingJobComplete(const QString& input, const QString& output,
   }
 }
 
+void Ripper::TranscodingJobProgress(const QString& input, float progress) {
+  transcode_progress_[input] = progress;
+  UpdateProgress();
+}
+
 void Ripper::AllTranscodingJobsComplete() {
+  // The transcoder runs out of work whenever it catches up with the drive.
+  if (!ripping_complete_ || tracks_transcoded_ < tracks_ripped_) return;
+
   RemoveTemporaryDirectory();
   TagFiles();
 }
 
+void Ripper::TrackRipped(int index, const QString& temporary_filename) {
+  {
+    QMutexLocker l(&mutex_);
+    if (cancel_requested_) return;
+  }
+
+  finished_success_++;
+  tracks_ripped_++;
+  UpdateProgress();
+
+  TrackInformation& track = tracks_[index];
+  track.temporary_filename = temporary_filename;
+  transcoder_->AddJob(track.temporary_filename, track.preset,
+                      track.transcoded_filename);
+  transcoder_->Start();
+}
+
+void Ripper::AllTracksRipped() {
+  ripping_complete_ = true;
+  AllTranscodingJobsComplete();
+}
+
 void Ripper::LogLine(const QString& message) { qLog(Debug) << message; }
 
 /*
@@ -208,22 +258,20 @@ void Ripper::Rip() {
     return;
   }
 
-  temporary_directory_ = Utilities::MakeTempDir() + "/";
-  finished_success_ = 0;
-  finished_failed_ = 0;
-
   // Set up progress bar
-  UpdateProgress();
+  QMetaObject::invokeMethod(this, "UpdateProgress", Qt::QueuedConnection);
 
-  for (QList<TrackInformation>::iterator it = tracks_.begin();
-       it != tracks_.end(); ++it) {
+  // This runs in its own thread, so it only reads the track numbers.  The
+  // main thread hands each track to the transcoder as soon as it's read.
+  for (int i = 0; i < tracks_.count(); ++i) {
+    const int track_number = tracks_[i].track_number;
     QString filename =
-        QString("%1%2.wav").arg(temporary_directory_).arg(it->track_number);
+        QString("%1%2.wav").arg(temporary_directory_).arg(track_number);
     QFile destination_file(filename);
     destination_file.open(QIODevice::WriteOnly);
 
-    lsn_t i_first_lsn = cdio_get_track_lsn(cdio_, it->track_number);
-    lsn_t i_last_lsn = cdio_get_track_last_lsn(cdio_, it->track_number);
+    lsn_t i_first_lsn = cdio_get_track_lsn(cdio_, track_number);
+    lsn_t i_last_lsn = cdio_get_track_last_lsn(cdio_, track_number);
     WriteWAVHeader(&destination_file,
                    (i_last_lsn - i_first_lsn + 1) * CDIO_CD_FRAMESIZE_RAW);
 
@@ -245,12 +293,10 @@ void Ripper::Rip() {
         break;
       }
     }
-    finished_success_++;
-    UpdateProgress();
+    destination_file.close();
 
-    it->temporary_filename = filename;
-    transcoder_->AddJob(it->temporary_filename, it->preset,
-                        it->transcoded_filename);
+    QMetaObject::invokeMethod(this, "TrackRipped", Qt::QueuedConnection,
+                              Q_ARG(int, i), Q_ARG(QString, filename));
   }
   emit(RippingComplete());
 }
@@ -265,8 +311,7 @@ void Ripper::SetupProgressInterval() {
 
 void Ripper::UpdateProgress() {
   int progress = (finished_success_ + finished_failed_) * 100;
-  QMap<QString, float> current_jobs = transcoder_->GetProgress();
-  for (float value : current_jobs.values()) {
+  for (float value : transcode_progress_.values()) {
     progress += qBound(0, static_cast<int>(value * 100), 99);
   }
   emit Progress(progress);
@@ -29,7 +29,9 @@
 class QFile;
 
 // Rips selected tracks from an audio CD, transcodes them to a chosen
-// format, and finally tags the files with the supplied metadata.
+// format, and finally tags the files with the supplied metadata.  Each track
+// starts transcoding as soon as it has been read, while the next one is
+// being read from the drive.
 //
 // Usage: Add tracks with AddTrack() and album metadata with
 // SetAlbumInformation(). Then start the ripper with Start(). The ripper
@@ -78,9 +80,14 @@ signals:
  private slots:
   void TranscodingJobComplete(const QString& input, const QString& output,
                               bool success);
+  void TranscodingJobProgress(const QString& input, float progress);
   void AllTranscodingJobsComplete();
   void LogLine(const QString& message);
   void FileTagged(TagReaderReply* reply);
+  // Called in the main thread as Rip() finishes reading each track.
+  void TrackRipped(int index, const QString& temporary_filename);
+  void AllTracksRipped();
+  void UpdateProgress();
 
  private:
   struct TrackInformation {
@@ -113,7 +120,6 @@ signals:
   void WriteWAVHeader(QFile* stream, int32_t i_bytecount);
   void Rip();
   void SetupProgressInterval();
-  void UpdateProgress();
   void RemoveTemporaryDirectory();
   void TagFiles();
 
@@ -125,6 +131,10 @@ signals:
   int finished_success_;
   int finished_failed_;
   int files_tagged_;
+  int tracks_ripped_;
+  int tracks_transcoded_;
+  bool ripping_complete_;
+  QMap<QString, float> transcode_progress_;
   QList<TrackInformation> tracks_;
   AlbumInformation album_;
 };
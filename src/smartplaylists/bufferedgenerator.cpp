@@ -0,0 +1,71 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bufferedgenerator.h"
+
+#include <memory>
+
+#include "core/taskexecutor.h"
+
+namespace smart_playlists {
+
+const int BufferedGenerator::kMaxFetchAttempts = 5;
+
+BufferedGenerator::BufferedGenerator() {}
+
+PlaylistItemList BufferedGenerator::GenerateMore(int count) {
+  QMutexLocker l(&mutex_);
+
+  int attempts = 0;
+  while (buffer_.count() < count && attempts++ < kMaxFetchAttempts) {
+    // Wait for a refill that's already on its way rather than starting
+    // another one.
+    if (!refill_.isRunning()) StartRefill();
+    QFuture<void> refill = refill_;
+
+    l.unlock();
+    refill.waitForFinished();
+    l.relock();
+  }
+
+  const PlaylistItemList ret = buffer_.mid(0, count);
+  buffer_ = buffer_.mid(ret.count());
+
+  // Get the next tracks ready before they're asked for.
+  if (buffer_.count() < GetDynamicFuture() && !refill_.isRunning()) {
+    StartRefill();
+  }
+
+  return ret;
+}
+
+void BufferedGenerator::StartRefill() {
+  // Keep the generator alive until the refill has finished, even if the
+  // playlist lets go of it.
+  std::shared_ptr<BufferedGenerator> self =
+      std::static_pointer_cast<BufferedGenerator>(shared_from_this());
+  refill_ = TaskExecutor::Instance()->Run<void>(TaskExecutor::Lane_Background,
+                                                [self]() { self->Refill(); });
+}
+
+void BufferedGenerator::Refill() {
+  const PlaylistItemList items = Fetch();
+
+  QMutexLocker l(&mutex_);
+  buffer_ << items;
+}
+
+}  // namespace smart_playlists
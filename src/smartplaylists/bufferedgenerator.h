@@ -0,0 +1,60 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SMARTPLAYLISTS_BUFFEREDGENERATOR_H_
+#define SMARTPLAYLISTS_BUFFEREDGENERATOR_H_
+
+#include <QFuture>
+#include <QMutex>
+
+#include "generator.h"
+
+namespace smart_playlists {
+
+// A dynamic generator whose tracks come from somewhere slow, like a web
+// service.  It keeps a buffer of upcoming tracks that is refilled in the
+// background whenever it runs low, so GenerateMore only has to wait for the
+// network when the buffer is empty.
+class BufferedGenerator : public Generator {
+  Q_OBJECT
+
+ public:
+  BufferedGenerator();
+
+  // Number of fetches that can come back empty before GenerateMore gives up.
+  static const int kMaxFetchAttempts;
+
+  bool is_dynamic() const { return true; }
+  PlaylistItemList GenerateMore(int count);
+
+ protected:
+  // Returns the next tracks in the sequence, blocking until they arrive.
+  // Called from a non-UI thread, and never from two threads at once.
+  virtual PlaylistItemList Fetch() = 0;
+
+ private:
+  // Must be called with mutex_ held.
+  void StartRefill();
+  void Refill();
+
+  QMutex mutex_;
+  PlaylistItemList buffer_;
+  QFuture<void> refill_;
+};
+
+}  // namespace smart_playlists
+
+#endif  // SMARTPLAYLISTS_BUFFEREDGENERATOR_H_
@@ -17,9 +17,8 @@
 
 #include "smartplaylists/generatorinserter.h"
 
-#include <QtConcurrentRun>
-
 #include "core/closure.h"
+#include "core/taskexecutor.h"
 #include "core/taskmanager.h"
 #include "playlist/playlist.h"
 #include "smartplaylists/generator.h"
@@ -57,7 +56,9 @@ void GeneratorInserter::Load(Playlist* destination, int row, bool play_now,
   connect(generator.get(), SIGNAL(Error(QString)), SIGNAL(Error(QString)));
 
   QFuture<PlaylistItemList> future =
-      QtConcurrent::run(Generate, generator, dynamic_count);
+      TaskExecutor::Instance()->Run<PlaylistItemList>(
+          TaskExecutor::Lane_Interactive,
+          std::bind(Generate, generator, dynamic_count));
   NewClosure(future, this, SLOT(Finished(QFuture<PlaylistItemList>)), future);
 }
 
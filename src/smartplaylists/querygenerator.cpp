@@ -18,6 +18,10 @@
 #include "querygenerator.h"
 #include "library/librarybackend.h"
 
+#include <algorithm>
+
+#include <QHash>
+#include <QSet>
 #include <QtDebug>
 
 namespace smart_playlists {
@@ -53,6 +57,7 @@ QByteArray QueryGenerator::Save() const {
 
 PlaylistItemList QueryGenerator::Generate() {
   previous_ids_.clear();
+  shuffled_ids_.clear();
   current_pos_ = 0;
   return GenerateMore(0);
 }
@@ -64,12 +69,15 @@ PlaylistItemList QueryGenerator::GenerateMore(int count) {
     search_copy.limit_ = count;
   }
 
-  if (search_copy.sort_type_ != Search::Sort_Random) {
+  SongList songs;
+  if (search_copy.sort_type_ == Search::Sort_Random) {
+    songs = TakeRandomSongs(search_copy.limit_);
+  } else {
     search_copy.first_item_ = current_pos_;
     current_pos_ += search_copy.limit_;
+    songs = backend_->FindSongs(search_copy);
   }
 
-  SongList songs = backend_->FindSongs(search_copy);
   PlaylistItemList items;
   for (const Song& song : songs) {
     items << PlaylistItemPtr(PlaylistItem::NewFromSongsTable(
@@ -82,4 +90,48 @@ PlaylistItemList QueryGenerator::GenerateMore(int count) {
   return items;
 }
 
+SongList QueryGenerator::TakeRandomSongs(int count) {
+  // ORDER BY random() makes SQLite sort every matching song each time, so
+  // instead the matching IDs are shuffled once and handed out in that order.
+  // They're fetched again when they run out, so dynamic playlists keep going
+  // and pick up changes to the library.
+  const QSet<int> recent_ids = previous_ids_.toSet();
+  QList<int> ids;
+  QSet<int> taken_ids;
+  bool refilled = false;
+
+  while (count == -1 || ids.count() < count) {
+    if (shuffled_ids_.isEmpty()) {
+      // Don't go round again if a whole pass didn't find enough songs.
+      if (refilled) break;
+      refilled = true;
+
+      shuffled_ids_ = backend_->FindSongIds(search_);
+      std::random_shuffle(shuffled_ids_.begin(), shuffled_ids_.end());
+      if (shuffled_ids_.isEmpty()) break;
+    }
+
+    const int id = shuffled_ids_.takeLast();
+    if (recent_ids.contains(id) || taken_ids.contains(id)) continue;
+
+    ids << id;
+    taken_ids << id;
+  }
+
+  if (ids.isEmpty()) return SongList();
+
+  // Put the songs back in the shuffled order.  Any that were deleted since
+  // the IDs were read are skipped.
+  QHash<int, Song> songs_by_id;
+  for (const Song& song : backend_->GetSongsById(ids)) {
+    songs_by_id[song.id()] = song;
+  }
+
+  SongList ret;
+  for (int id : ids) {
+    if (songs_by_id.contains(id)) ret << songs_by_id[id];
+  }
+  return ret;
+}
+
 }  // namespace
@@ -44,11 +44,17 @@ class QueryGenerator : public Generator {
   int GetDynamicFuture() { return search_.limit_; }
 
  private:
+  SongList TakeRandomSongs(int count);
+
   Search search_;
   bool dynamic_;
 
   QList<int> previous_ids_;
   int current_pos_;
+
+  // Matching song IDs in a random order, for random sorted searches.  Songs
+  // are taken from the back.
+  QList<int> shuffled_ids_;
 };
 
 }  // namespace
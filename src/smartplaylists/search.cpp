@@ -46,17 +46,7 @@ void Search::Reset() {
 QString Search::ToSql(const QString& songs_table) const {
   QString sql = "SELECT ROWID," + Song::kColumnSpec + " FROM " + songs_table;
 
-  // Add search terms
-  QStringList where_clauses;
-  QStringList term_where_clauses;
-  for (const SearchTerm& term : terms_) {
-    term_where_clauses << term.ToSql();
-  }
-
-  if (!terms_.isEmpty() && search_type_ != Type_All) {
-    QString boolean_op = search_type_ == Type_And ? " AND " : " OR ";
-    where_clauses << "(" + term_where_clauses.join(boolean_op) + ")";
-  }
+  QStringList where_clauses(WhereClauses());
 
   // Restrict the IDs of songs if we're making a dynamic playlist
   if (!id_not_in_.isEmpty()) {
@@ -67,14 +57,7 @@ QString Search::ToSql(const QString& songs_table) const {
     where_clauses << "(ROWID NOT IN (" + numbers + "))";
   }
 
-  // We never want to include songs that have been deleted, but are still kept
-  // in the database in case the directory containing them has just been
-  // unmounted.
-  where_clauses << "unavailable = 0";
-
-  if (!where_clauses.isEmpty()) {
-    sql += " WHERE " + where_clauses.join(" AND ");
-  }
+  sql += " WHERE " + where_clauses.join(" AND ");
 
   // Add sort by
   if (sort_type_ == Sort_Random) {
@@ -95,6 +78,37 @@ QString Search::ToSql(const QString& songs_table) const {
   return sql;
 }
 
+QString Search::ToIdSql(const QString& songs_table) const {
+  return "SELECT ROWID FROM " + songs_table + " WHERE " +
+         WhereClauses().join(" AND ");
+}
+
+QString Search::ToCountSql(const QString& songs_table) const {
+  return "SELECT COUNT(*) FROM " + songs_table + " WHERE " +
+         WhereClauses().join(" AND ");
+}
+
+QStringList Search::WhereClauses() const {
+  // Add search terms
+  QStringList where_clauses;
+  QStringList term_where_clauses;
+  for (const SearchTerm& term : terms_) {
+    term_where_clauses << term.ToSql();
+  }
+
+  if (!terms_.isEmpty() && search_type_ != Type_All) {
+    QString boolean_op = search_type_ == Type_And ? " AND " : " OR ";
+    where_clauses << "(" + term_where_clauses.join(boolean_op) + ")";
+  }
+
+  // We never want to include songs that have been deleted, but are still kept
+  // in the database in case the directory containing them has just been
+  // unmounted.
+  where_clauses << "unavailable = 0";
+
+  return where_clauses;
+}
+
 bool Search::is_valid() const {
   if (search_type_ == Type_All) return true;
   return !terms_.isEmpty();
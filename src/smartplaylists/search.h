@@ -53,6 +53,14 @@ class Search {
 
   void Reset();
   QString ToSql(const QString& songs_table) const;
+  // Selects just the IDs of every matching song, in no particular order.
+  // Ignores the sort, limit and id_not_in_.
+  QString ToIdSql(const QString& songs_table) const;
+  // Counts the matching songs.  Also ignores the sort, limit and id_not_in_.
+  QString ToCountSql(const QString& songs_table) const;
+
+ private:
+  QStringList WhereClauses() const;
 };
 
 }  // namespace
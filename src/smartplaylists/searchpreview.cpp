@@ -20,15 +20,22 @@
 
 #include <memory>
 
-#include <QtConcurrentRun>
+#include <QTimer>
 
-#include "querygenerator.h"
+#include "core/closure.h"
+#include "core/taskexecutor.h"
+#include "library/librarybackend.h"
 #include "playlist/playlist.h"
 
 namespace smart_playlists {
 
+const int SearchPreview::kUpdateDelayMsec = 300;
+
 SearchPreview::SearchPreview(QWidget* parent)
-    : QWidget(parent), ui_(new Ui_SmartPlaylistSearchPreview), model_(nullptr) {
+    : QWidget(parent),
+      ui_(new Ui_SmartPlaylistSearchPreview),
+      model_(nullptr),
+      update_timer_(new QTimer(this)) {
   ui_->setupUi(this);
 
   // Prevent editing songs and saving settings (like header columns and
@@ -40,9 +47,16 @@ SearchPreview::SearchPreview(QWidget* parent)
   bold_font.setBold(true);
   ui_->preview_label->setFont(bold_font);
   ui_->busy_container->hide();
+
+  update_timer_->setSingleShot(true);
+  update_timer_->setInterval(kUpdateDelayMsec);
+  connect(update_timer_, SIGNAL(timeout()), SLOT(RunPendingSearch()));
 }
 
-SearchPreview::~SearchPreview() { delete ui_; }
+SearchPreview::~SearchPreview() {
+  if (cancel_) cancel_->store(1);
+  delete ui_;
+}
 
 void SearchPreview::set_application(Application* app) {
   ui_->tree->SetApplication(app);
@@ -60,70 +74,101 @@ void SearchPreview::set_library(LibraryBackend* backend) {
 void SearchPreview::Update(const Search& search) {
   if (search == last_search_) {
     // This search was the same as the last one we did
+    pending_search_ = Search();
+    update_timer_->stop();
     return;
   }
 
-  if (generator_ || isHidden()) {
-    // It's busy generating something already, or the widget isn't visible
-    pending_search_ = search;
-    return;
-  }
-
-  RunSearch(search);
+  pending_search_ = search;
+  update_timer_->start();
 }
 
 void SearchPreview::showEvent(QShowEvent* e) {
-  if (pending_search_.is_valid() && !generator_) {
-    // There was a search waiting while we were hidden, so run it now
-    RunSearch(pending_search_);
-    pending_search_ = Search();
-  }
+  // There might have been a search waiting while we were hidden
+  RunPendingSearch();
 
   QWidget::showEvent(e);
 }
 
-PlaylistItemList DoRunSearch(GeneratorPtr gen) { return gen->Generate(); }
+void SearchPreview::RunPendingSearch() {
+  if (!pending_search_.is_valid() || isHidden()) return;
+
+  update_timer_->stop();
+  RunSearch(pending_search_);
+  pending_search_ = Search();
+}
+
+SearchPreview::Result SearchPreview::DoRunSearch(
+    LibraryBackend* backend, const Search& search,
+    LibraryQuery::CancelFlag cancel) {
+  Result result;
+  result.search = search;
+
+  Search page = search;
+  page.first_item_ = 0;
+  page.limit_ = search.limit_ == -1
+                    ? Generator::kDefaultLimit
+                    : qMin(search.limit_, Generator::kDefaultLimit);
+
+  const bool ok = backend->FindSongs(page, [&](const SongList& songs) {
+    for (const Song& song : songs) {
+      result.items << PlaylistItemPtr(
+          PlaylistItem::NewFromSongsTable(backend->songs_table(), song));
+    }
+    return true;
+  }, cancel);
+  if (!ok) {
+    result.total = -1;
+    return result;
+  }
+
+  // Only count the rest if there's more than one page.
+  if (result.items.count() < page.limit_) {
+    result.total = result.items.count();
+  } else {
+    result.total = backend->CountSongs(search, cancel);
+    if (result.total != -1 && search.limit_ != -1) {
+      result.total = qMin(result.total, search.limit_);
+    }
+  }
+  return result;
+}
 
 void SearchPreview::RunSearch(const Search& search) {
-  generator_.reset(new QueryGenerator);
-  generator_->set_library(backend_);
-  std::dynamic_pointer_cast<QueryGenerator>(generator_)->Load(search);
+  // Stop the previous search, its results would be thrown away anyway.
+  if (cancel_) cancel_->store(1);
+  cancel_ = std::make_shared<QAtomicInt>(0);
+  last_search_ = search;
 
   ui_->busy_container->show();
   ui_->count_label->hide();
-  QFuture<PlaylistItemList> future = QtConcurrent::run(DoRunSearch, generator_);
-  NewClosure(future, this, SLOT(SearchFinished(QFuture<PlaylistItemList>)),
-             future);
+  QFuture<Result> future = TaskExecutor::Instance()->Run<Result>(
+      TaskExecutor::Lane_Interactive,
+      std::bind(&SearchPreview::DoRunSearch, backend_, search, cancel_));
+  NewClosure(future, this,
+             SLOT(SearchFinished(QFuture<SearchPreview::Result>)), future);
 }
 
-void SearchPreview::SearchFinished(QFuture<PlaylistItemList> future) {
-  last_search_ =
-      std::dynamic_pointer_cast<QueryGenerator>(generator_)->search();
-  generator_.reset();
+void SearchPreview::SearchFinished(QFuture<SearchPreview::Result> future) {
+  const Result result = future.result();
 
-  if (pending_search_.is_valid() && pending_search_ != last_search_) {
-    // There was another search done while we were running - throw away these
-    // results and do that one now instead
-    RunSearch(pending_search_);
-    pending_search_ = Search();
-    return;
-  }
-
-  PlaylistItemList all_items = future.result();
-  PlaylistItemList displayed_items = all_items.mid(0, Generator::kDefaultLimit);
+  // A newer search is on its way
+  if (result.search != last_search_) return;
+  cancel_.reset();
+  ui_->busy_container->hide();
+  if (result.total == -1) return;
 
   model_->Clear();
-  model_->InsertItems(displayed_items);
+  model_->InsertItems(result.items);
 
-  if (displayed_items.count() < all_items.count()) {
+  if (result.items.count() < result.total) {
     ui_->count_label->setText(tr("%1 songs found (showing %2)")
-                                  .arg(all_items.count())
-                                  .arg(displayed_items.count()));
+                                  .arg(result.total)
+                                  .arg(result.items.count()));
   } else {
-    ui_->count_label->setText(tr("%1 songs found").arg(all_items.count()));
+    ui_->count_label->setText(tr("%1 songs found").arg(result.total));
   }
 
-  ui_->busy_container->hide();
   ui_->count_label->show();
 }
 
@@ -19,7 +19,8 @@
 #define SMARTPLAYLISTSEARCHPREVIEW_H
 
 #include "search.h"
-#include "smartplaylists/generator_fwd.h"
+#include "library/libraryquery.h"
+#include "playlist/playlistitem.h"
 
 #include <QFuture>
 #include <QWidget>
@@ -27,6 +28,7 @@
 class Application;
 class LibraryBackend;
 class Playlist;
+class QTimer;
 class Ui_SmartPlaylistSearchPreview;
 
 namespace smart_playlists {
@@ -41,16 +43,34 @@ class SearchPreview : public QWidget {
   void set_application(Application* app);
   void set_library(LibraryBackend* backend);
 
+  // Searches are held back for kUpdateDelayMsec so typing in a search term
+  // only runs the last one.
   void Update(const Search& search);
 
+  static const int kUpdateDelayMsec;
+
  protected:
   void showEvent(QShowEvent*);
 
  private:
+  struct Result {
+    Result() : total(0) {}
+
+    Search search;
+    PlaylistItemList items;
+    // How many songs the search finds altogether, or -1 if it was cancelled.
+    int total;
+  };
+
+  // Only fetches the first page of songs and counts the rest.
+  static Result DoRunSearch(LibraryBackend* backend, const Search& search,
+                            LibraryQuery::CancelFlag cancel);
+
   void RunSearch(const Search& search);
 
  private slots:
-  void SearchFinished(QFuture<PlaylistItemList> future);
+  void RunPendingSearch();
+  void SearchFinished(QFuture<SearchPreview::Result> future);
 
  private:
   Ui_SmartPlaylistSearchPreview* ui_;
@@ -59,9 +79,11 @@ class SearchPreview : public QWidget {
   LibraryBackend* backend_;
   Playlist* model_;
 
+  QTimer* update_timer_;
   Search pending_search_;
   Search last_search_;
-  GeneratorPtr generator_;
+  // Set to cancel the search that's running, if there is one.
+  LibraryQuery::CancelFlag cancel_;
 };
 
 }  // namespace
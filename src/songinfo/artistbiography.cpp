@@ -29,7 +29,6 @@
 #include "core/latch.h"
 #include "core/logging.h"
 #include "core/network.h"
-#include "songinfo/songinfotextview.h"
 #include "ui/iconloader.h"
 
 namespace {
@@ -44,6 +43,7 @@ const char* kWikipediaExtractUrl =
     "https://%1.wikipedia.org/w/"
     "api.php?action=query&format=json&prop=extracts";
 const int kMinimumImageSize = 400;
+const int kCacheLifetimeSecs = 7 * 24 * 60 * 60;
 
 QString GetLocale() {
   QLocale locale;
@@ -52,10 +52,12 @@ QString GetLocale() {
 
 }  // namespace
 
-ArtistBiography::ArtistBiography() : network_(new NetworkAccessManager) {}
+ArtistBiography::ArtistBiography() : network_(NetworkAccessManager::Shared()) {}
 
 ArtistBiography::~ArtistBiography() {}
 
+int ArtistBiography::cache_lifetime_secs() const { return kCacheLifetimeSecs; }
+
 void ArtistBiography::FetchInfo(int id, const Song& metadata) {
   if (metadata.artist().isEmpty()) {
     emit Finished(id);
@@ -101,10 +103,7 @@ void ArtistBiography::FetchInfo(int id, const Song& metadata) {
                 "</a></p>";
 
         text += body;
-        SongInfoTextView* editor = new SongInfoTextView;
-        editor->SetHtml(text);
-        data.contents_ = editor;
-        emit InfoReady(id, data);
+        EmitHtml(id, data, text);
       }
       latch->CountDown();
     }
@@ -282,10 +281,7 @@ void ArtistBiography::FetchWikipediaArticle(int id,
                 .arg(wikipedia_url)
                 .arg(wiki_title);
 
-    SongInfoTextView* editor = new SongInfoTextView;
-    editor->SetHtml(text);
-    data.contents_ = editor;
-    emit InfoReady(id, data);
+    EmitHtml(id, data, text);
     latch->CountDown();
   });
 }
@@ -18,8 +18,6 @@
 #ifndef ARTISTBIOGRAPHY_H
 #define ARTISTBIOGRAPHY_H
 
-#include <memory>
-
 #include "songinfoprovider.h"
 
 class CountdownLatch;
@@ -33,13 +31,14 @@ class ArtistBiography : public SongInfoProvider {
   ~ArtistBiography();
 
   void FetchInfo(int id, const Song& metadata) override;
+  int cache_lifetime_secs() const override;
 
  private:
   void FetchWikipediaImages(int id, const QString& title,
                             CountdownLatch* latch);
   void FetchWikipediaArticle(int id, const QString& url, CountdownLatch* latch);
 
-  std::unique_ptr<NetworkAccessManager> network_;
+  NetworkAccessManager* network_;
 };
 
 #endif  // ARTISTBIOGRAPHY_H
@@ -28,7 +28,11 @@ class CollapsibleInfoPane : public QWidget {
 
  public:
   struct Data {
-    Data() : type_(Type_Biography), relevance_(0) {}
+    Data()
+        : type_(Type_Biography),
+          relevance_(0),
+          contents_(nullptr),
+          content_object_(nullptr) {}
 
     bool operator<(const Data& other) const;
 
@@ -29,7 +29,7 @@ const char* SongInfoBase::kSettingsGroup = "SongInfo";
 
 SongInfoBase::SongInfoBase(QWidget* parent)
     : QWidget(parent),
-      network_(new NetworkAccessManager(this)),
+      network_(NetworkAccessManager::Shared()),
       fetcher_(new SongInfoFetcher(this)),
       current_request_id_(-1),
       scroll_area_(new QScrollArea),
@@ -106,6 +106,13 @@ void SongInfoBase::AddWidget(QWidget* widget) {
   widgets_ << widget;
 }
 
+void SongInfoBase::PrefetchSong(const Song& metadata) {
+  // Don't use up the providers' rate limits if nobody's looking.
+  if (isVisible()) {
+    fetcher_->Prefetch(metadata);
+  }
+}
+
 void SongInfoBase::SongChanged(const Song& metadata) {
   if (isVisible()) {
     MaybeUpdate(metadata);
@@ -44,6 +44,9 @@ class SongInfoBase : public QWidget {
 
  public slots:
   void SongChanged(const Song& metadata);
+  // Fetches info for a song that's probably going to be played next, so it
+  // can be shown straight away.
+  void PrefetchSong(const Song& metadata);
   void SongFinished();
   virtual void ReloadSettings();
 
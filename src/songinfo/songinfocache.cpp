@@ -0,0 +1,132 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "songinfocache.h"
+
+#include <memory>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QNetworkDiskCache>
+#include <QUrlQuery>
+
+#include "core/song.h"
+#include "core/utilities.h"
+
+namespace {
+
+// Bump this when the format of the stored data changes.
+const quint32 kFormatVersion = 1;
+
+}  // namespace
+
+const qint64 SongInfoCache::kMaxCacheSize = 20 * 1024 * 1024;  // 20MB
+
+QMutex SongInfoCache::sMutex;
+QNetworkDiskCache* SongInfoCache::sCache = nullptr;
+
+SongInfoCache::SongInfoCache() {}
+
+QNetworkDiskCache* SongInfoCache::cache() {
+  if (!sCache) {
+    sCache = new QNetworkDiskCache;
+    sCache->setCacheDirectory(
+        Utilities::GetConfigPath(Utilities::Path_SongInfoCache));
+    sCache->setMaximumCacheSize(kMaxCacheSize);
+  }
+  return sCache;
+}
+
+QUrl SongInfoCache::CacheUrl(const QString& provider, const Song& metadata) {
+  QUrl url;
+  url.setScheme("songinfo");
+
+  QUrlQuery query;
+  query.addQueryItem("provider", provider);
+  query.addQueryItem("artist", metadata.artist().toLower());
+  query.addQueryItem("title", metadata.title().toLower());
+  url.setQuery(query);
+
+  return url;
+}
+
+bool SongInfoCache::Find(const QString& provider, const Song& metadata,
+                         Entry* entry) {
+  const QUrl url = CacheUrl(provider, metadata);
+
+  QMutexLocker l(&sMutex);
+  const QNetworkCacheMetaData cache_metadata = cache()->metaData(url);
+  if (!cache_metadata.isValid()) return false;
+
+  if (cache_metadata.expirationDate() < QDateTime::currentDateTime()) {
+    cache()->remove(url);
+    return false;
+  }
+
+  std::unique_ptr<QIODevice> device(cache()->data(url));
+  if (!device) return false;
+
+  QDataStream s(device.get());
+  quint32 version = 0;
+  s >> version;
+  if (version != kFormatVersion) return false;
+
+  qint32 pane_count = 0;
+  s >> entry->images_ >> pane_count;
+  for (int i = 0; i < pane_count && s.status() == QDataStream::Ok; ++i) {
+    Pane pane;
+    qint32 type = 0;
+    qint32 relevance = 0;
+    s >> pane.id_ >> pane.title_ >> pane.icon_ >> type >> relevance >>
+        pane.html_;
+    pane.type_ = CollapsibleInfoPane::Data::Type(type);
+    pane.relevance_ = relevance;
+    entry->panes_ << pane;
+  }
+
+  return s.status() == QDataStream::Ok;
+}
+
+bool SongInfoCache::Contains(const QString& provider, const Song& metadata) {
+  const QUrl url = CacheUrl(provider, metadata);
+
+  QMutexLocker l(&sMutex);
+  const QNetworkCacheMetaData cache_metadata = cache()->metaData(url);
+  return cache_metadata.isValid() &&
+         cache_metadata.expirationDate() >= QDateTime::currentDateTime();
+}
+
+void SongInfoCache::Insert(const QString& provider, const Song& metadata,
+                           const Entry& entry, int lifetime_secs) {
+  QNetworkCacheMetaData cache_metadata;
+  cache_metadata.setUrl(CacheUrl(provider, metadata));
+  cache_metadata.setExpirationDate(
+      QDateTime::currentDateTime().addSecs(lifetime_secs));
+
+  QMutexLocker l(&sMutex);
+  QIODevice* device = cache()->prepare(cache_metadata);
+  if (!device) return;
+
+  QDataStream s(device);
+  s << kFormatVersion << entry.images_ << qint32(entry.panes_.count());
+  for (const Pane& pane : entry.panes_) {
+    s << pane.id_ << pane.title_ << pane.icon_ << qint32(pane.type_)
+      << qint32(pane.relevance_) << pane.html_;
+  }
+
+  cache()->insert(device);
+}
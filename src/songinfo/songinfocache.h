@@ -0,0 +1,73 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SONGINFO_SONGINFOCACHE_H_
+#define SONGINFO_SONGINFOCACHE_H_
+
+#include <QIcon>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QUrl>
+
+#include "collapsibleinfopane.h"
+
+class Song;
+
+class QNetworkDiskCache;
+
+// Keeps what song info providers found for a track on disk, so it can be
+// shown again without asking the provider.  Only panes that are plain HTML
+// (see SongInfoProvider::EmitHtml) and image URLs are stored.  Entries are
+// keyed on the provider's name and the song's artist and title, and expire
+// after a lifetime chosen by the provider.
+//
+// All instances share one cache on disk and all methods are thread-safe.
+class SongInfoCache {
+ public:
+  SongInfoCache();
+
+  static const qint64 kMaxCacheSize;
+
+  struct Pane {
+    QString id_;
+    QString title_;
+    QIcon icon_;
+    CollapsibleInfoPane::Data::Type type_;
+    int relevance_;
+    QString html_;
+  };
+
+  struct Entry {
+    QList<QUrl> images_;
+    QList<Pane> panes_;
+  };
+
+  // Returns false if there's no entry or it has expired.
+  bool Find(const QString& provider, const Song& metadata, Entry* entry);
+  bool Contains(const QString& provider, const Song& metadata);
+  void Insert(const QString& provider, const Song& metadata,
+              const Entry& entry, int lifetime_secs);
+
+ private:
+  static QUrl CacheUrl(const QString& provider, const Song& metadata);
+  static QNetworkDiskCache* cache();
+
+  static QMutex sMutex;
+  static QNetworkDiskCache* sCache;
+};
+
+#endif  // SONGINFO_SONGINFOCACHE_H_
@@ -19,12 +19,47 @@
 #include "songinfoprovider.h"
 #include "core/logging.h"
 
+#include <QSettings>
 #include <QTimer>
 
+#include <algorithm>
+
+const int SongInfoFetcher::kMaxConcurrentLyricsRequests = 3;
+const char* SongInfoFetcher::kStatsSettingsGroup = "SongInfoProviderStats";
+
+namespace {
+
+// Assumed for providers we haven't heard from yet.
+const double kDefaultLatencyMsec = 3000;
+// Weight of the newest sample in the latency average.
+const double kLatencySmoothing = 0.2;
+// How much each step down the user's order adds to a provider's cost.
+const double kRelevanceRankWeight = 0.1;
+
+bool CanCache(const SongInfoProvider* provider, const Song& metadata) {
+  return provider->cache_lifetime_secs() > 0 && !metadata.artist().isEmpty();
+}
+
+}  // namespace
+
 SongInfoFetcher::SongInfoFetcher(QObject* parent)
     : QObject(parent),
+      race_lyrics_(false),
       timeout_duration_(kDefaultTimeoutDuration),
-      next_id_(1) {}
+      next_id_(1) {
+  QSettings s;
+  s.beginGroup(kStatsSettingsGroup);
+  for (const QString& name : s.childKeys()) {
+    const QVariantList values = s.value(name).toList();
+    if (values.count() != 3) continue;
+
+    ProviderStats stats;
+    stats.attempts_ = values[0].toInt();
+    stats.hits_ = values[1].toInt();
+    stats.latency_msec_ = values[2].toDouble();
+    stats_[name] = stats;
+  }
+}
 
 void SongInfoFetcher::AddProvider(SongInfoProvider* provider) {
   providers_ << provider;
@@ -33,13 +68,28 @@ void SongInfoFetcher::AddProvider(SongInfoProvider* provider) {
   connect(provider, SIGNAL(InfoReady(int, CollapsibleInfoPane::Data)),
           SLOT(InfoReady(int, CollapsibleInfoPane::Data)),
           Qt::QueuedConnection);
+  connect(provider, SIGNAL(HtmlReady(int, CollapsibleInfoPane::Data, QString)),
+          SLOT(HtmlReady(int, CollapsibleInfoPane::Data, QString)),
+          Qt::QueuedConnection);
   connect(provider, SIGNAL(Finished(int)), SLOT(ProviderFinished(int)),
           Qt::QueuedConnection);
 }
 
 int SongInfoFetcher::FetchInfo(const Song& metadata) {
+  return StartRequest(metadata, false);
+}
+
+void SongInfoFetcher::Prefetch(const Song& metadata) {
+  StartRequest(metadata, true);
+}
+
+int SongInfoFetcher::StartRequest(const Song& metadata, bool prefetch) {
   const int id = next_id_++;
-  results_[id] = Result();
+  if (!prefetch) {
+    results_[id] = Result();
+  }
+  metadata_[id] = metadata;
+
   timeout_timers_[id] = new QTimer(this);
   timeout_timers_[id]->setSingleShot(true);
   timeout_timers_[id]->setInterval(timeout_duration_);
@@ -47,22 +97,241 @@ int SongInfoFetcher::FetchInfo(const Song& metadata) {
 
   connect(timeout_timers_[id], &QTimer::timeout, [this, id]() { Timeout(id); });
 
+  QList<SongInfoProvider*> racers;
+
   for (SongInfoProvider* provider : providers_) {
-    if (provider->is_enabled()) {
-      waiting_for_[id].append(provider);
-      provider->FetchInfo(id, metadata);
+    if (!provider->is_enabled()) continue;
+
+    if (race_lyrics_ && provider->is_lyrics_source()) {
+      racers << provider;
+      continue;
     }
+
+    if (CanCache(provider, metadata)) {
+      if (prefetch) {
+        if (cache_.Contains(provider->name(), metadata)) continue;
+      } else {
+        SongInfoCache::Entry entry;
+        if (cache_.Find(provider->name(), metadata, &entry)) {
+          // Emit it later, once the caller knows the ID.
+          if (!cached_info_.contains(id)) {
+            metaObject()->invokeMethod(this, "EmitCachedInfo",
+                                       Qt::QueuedConnection, Q_ARG(int, id));
+          }
+          cached_info_[id][provider] = entry;
+          waiting_for_[id].append(provider);
+          continue;
+        }
+      }
+      cache_entries_[id][provider] = SongInfoCache::Entry();
+    } else if (prefetch) {
+      continue;
+    }
+
+    waiting_for_[id].append(provider);
+    provider->FetchInfo(id, metadata);
   }
+
+  if (!racers.isEmpty()) {
+    racers = RaceOrder(racers);
+
+    // Lyrics that any of the sources found before will do, so there's no
+    // race at all if one of them is cached.
+    bool cached = false;
+    for (SongInfoProvider* provider : racers) {
+      if (!CanCache(provider, metadata)) continue;
+
+      if (prefetch) {
+        cached = cache_.Contains(provider->name(), metadata);
+      } else {
+        SongInfoCache::Entry entry;
+        cached = cache_.Find(provider->name(), metadata, &entry);
+        if (cached) {
+          if (!cached_info_.contains(id)) {
+            metaObject()->invokeMethod(this, "EmitCachedInfo",
+                                       Qt::QueuedConnection, Q_ARG(int, id));
+          }
+          cached_info_[id][provider] = entry;
+          waiting_for_[id].append(provider);
+        }
+      }
+      if (cached) break;
+    }
+
+    if (!cached) {
+      races_[id].queued_ = racers;
+      waiting_for_[id].append(racers);
+      StartRacers(id);
+    }
+  }
+
+  // Nothing needed prefetching.
+  if (prefetch && !waiting_for_.contains(id)) {
+    metadata_.remove(id);
+    delete timeout_timers_.take(id);
+  }
+
   return id;
 }
 
+QList<SongInfoProvider*> SongInfoFetcher::RaceOrder(
+    const QList<SongInfoProvider*>& providers) const {
+  QList<SongInfoProvider*> by_relevance(providers);
+  std::stable_sort(by_relevance.begin(), by_relevance.end(),
+                   [](SongInfoProvider* a, SongInfoProvider* b) {
+                     return a->relevance() > b->relevance();
+                   });
+
+  // Each provider's cost is how long we expect to wait for it to find the
+  // lyrics: its average latency divided by its hit rate.  The user's order
+  // still counts for a bit, and breaks ties between providers we know
+  // nothing about.
+  QMap<SongInfoProvider*, double> costs;
+  for (int rank = 0; rank < by_relevance.count(); ++rank) {
+    SongInfoProvider* provider = by_relevance[rank];
+    const ProviderStats stats = stats_.value(provider->name());
+
+    const double latency =
+        stats.attempts_ ? stats.latency_msec_ : kDefaultLatencyMsec;
+    const double hit_rate = (stats.hits_ + 1.0) / (stats.attempts_ + 2.0);
+
+    costs[provider] = latency / hit_rate * (1.0 + kRelevanceRankWeight * rank);
+  }
+
+  std::stable_sort(by_relevance.begin(), by_relevance.end(),
+                   [&costs](SongInfoProvider* a, SongInfoProvider* b) {
+                     return costs[a] < costs[b];
+                   });
+  return by_relevance;
+}
+
+void SongInfoFetcher::StartRacers(int id) {
+  if (!races_.contains(id)) return;
+  Race* race = &races_[id];
+
+  while (race->running_.count() < kMaxConcurrentLyricsRequests &&
+         !race->queued_.isEmpty()) {
+    SongInfoProvider* provider = race->queued_.takeFirst();
+    race->running_[provider].start();
+
+    if (CanCache(provider, metadata_[id])) {
+      cache_entries_[id][provider] = SongInfoCache::Entry();
+    }
+    provider->FetchInfo(id, metadata_[id]);
+  }
+}
+
+void SongInfoFetcher::RecordStats(SongInfoProvider* provider, bool hit,
+                                  qint64 latency_msec) {
+  ProviderStats* stats = &stats_[provider->name()];
+  stats->latency_msec_ =
+      stats->attempts_ ? stats->latency_msec_ +
+                             kLatencySmoothing *
+                                 (latency_msec - stats->latency_msec_)
+                       : latency_msec;
+  stats->attempts_++;
+  if (hit) stats->hits_++;
+
+  QSettings s;
+  s.beginGroup(kStatsSettingsGroup);
+  s.setValue(provider->name(), QVariantList() << stats->attempts_
+                                              << stats->hits_
+                                              << stats->latency_msec_);
+}
+
+void SongInfoFetcher::EmitCachedInfo(int id) {
+  const CacheEntries entries = cached_info_.take(id);
+  for (CacheEntries::const_iterator it = entries.begin(); it != entries.end();
+       ++it) {
+    if (!waiting_for_.contains(id)) return;
+
+    if (results_.contains(id)) {
+      results_[id].images_ << it.value().images_;
+    }
+
+    for (const SongInfoCache::Pane& pane : it.value().panes_) {
+      CollapsibleInfoPane::Data data;
+      data.id_ = pane.id_;
+      data.title_ = pane.title_;
+      data.icon_ = pane.icon_;
+      data.type_ = pane.type_;
+      data.relevance_ = pane.relevance_;
+      SongInfoProvider::SetHtmlContents(pane.html_, &data);
+      AddInfo(id, data, it.key());
+    }
+
+    FinishProvider(id, it.key());
+  }
+}
+
 void SongInfoFetcher::ImageReady(int id, const QUrl& url) {
+  SongInfoProvider* provider = qobject_cast<SongInfoProvider*>(sender());
+  if (cache_entries_.contains(id) && cache_entries_[id].contains(provider)) {
+    cache_entries_[id][provider].images_ << url;
+  }
+
   if (!results_.contains(id)) return;
   results_[id].images_ << url;
 }
 
 void SongInfoFetcher::InfoReady(int id, const CollapsibleInfoPane::Data& data) {
-  if (!results_.contains(id)) return;
+  SongInfoProvider* provider = qobject_cast<SongInfoProvider*>(sender());
+  AddInfo(id, data, provider);
+}
+
+void SongInfoFetcher::HtmlReady(int id, const CollapsibleInfoPane::Data& data,
+                                const QString& html) {
+  SongInfoProvider* provider = qobject_cast<SongInfoProvider*>(sender());
+  if (cache_entries_.contains(id) && cache_entries_[id].contains(provider)) {
+    SongInfoCache::Pane pane;
+    pane.id_ = data.id_;
+    pane.title_ = data.title_;
+    pane.icon_ = data.icon_;
+    pane.type_ = data.type_;
+    pane.relevance_ = data.relevance_;
+    pane.html_ = html;
+    cache_entries_[id][provider].panes_ << pane;
+  }
+
+  AddInfo(id, data, provider);
+}
+
+void SongInfoFetcher::AddInfo(int id, const CollapsibleInfoPane::Data& data,
+                              SongInfoProvider* provider) {
+  if (races_.contains(id) && races_[id].running_.contains(provider)) {
+    Race* race = &races_[id];
+
+    if (race->winner_ && race->winner_ != provider) {
+      // Another source found the lyrics first.
+      delete data.contents_;
+      delete data.content_object_;
+      return;
+    }
+
+    if (!race->winner_) {
+      race->winner_ = provider;
+      RecordStats(provider, true, race->running_[provider].elapsed());
+
+      // Stop the others, we won't wait for them any more.
+      for (SongInfoProvider* other : race->running_.keys()) {
+        if (other == provider) continue;
+        other->Cancel(id);
+        waiting_for_[id].removeAll(other);
+        cache_entries_[id].remove(other);
+      }
+      for (SongInfoProvider* other : race->queued_) {
+        waiting_for_[id].removeAll(other);
+      }
+      race->queued_.clear();
+    }
+  }
+
+  if (!results_.contains(id)) {
+    // Prefetched, or it came in after the timeout.  Nobody will show it.
+    delete data.contents_;
+    delete data.content_object_;
+    return;
+  }
   results_[id].info_ << data;
 
   if (!waiting_for_.contains(id)) return;
@@ -70,26 +339,63 @@ void SongInfoFetcher::InfoReady(int id, const CollapsibleInfoPane::Data& data) {
 }
 
 void SongInfoFetcher::ProviderFinished(int id) {
-  if (!results_.contains(id)) return;
-  if (!waiting_for_.contains(id)) return;
-
   SongInfoProvider* provider = qobject_cast<SongInfoProvider*>(sender());
+
+  if (races_.contains(id) && races_[id].running_.contains(provider)) {
+    Race* race = &races_[id];
+    if (!race->winner_) {
+      // This one didn't find anything, try the next.
+      RecordStats(provider, false, race->running_[provider].elapsed());
+      race->running_.remove(provider);
+      StartRacers(id);
+    }
+  }
+
+  FinishProvider(id, provider);
+}
+
+void SongInfoFetcher::FinishProvider(int id, SongInfoProvider* provider) {
+  if (!waiting_for_.contains(id)) return;
   if (!waiting_for_[id].contains(provider)) return;
 
+  // Don't cache a provider finding nothing, it might have been a network
+  // error.
+  if (cache_entries_.contains(id) && cache_entries_[id].contains(provider)) {
+    const SongInfoCache::Entry entry = cache_entries_[id].take(provider);
+    if (!entry.panes_.isEmpty() || !entry.images_.isEmpty()) {
+      cache_.Insert(provider->name(), metadata_[id], entry,
+                    provider->cache_lifetime_secs());
+    }
+  }
+
   waiting_for_[id].removeAll(provider);
   if (waiting_for_[id].isEmpty()) {
-    emit ResultReady(id, results_.take(id));
+    if (results_.contains(id)) {
+      emit ResultReady(id, results_.take(id));
+    }
     waiting_for_.remove(id);
+    cache_entries_.remove(id);
+    races_.remove(id);
+    metadata_.remove(id);
     delete timeout_timers_.take(id);
   }
 }
 
 void SongInfoFetcher::Timeout(int id) {
-  if (!results_.contains(id)) return;
   if (!waiting_for_.contains(id)) return;
 
   // Emit the results that we have already
-  emit ResultReady(id, results_.take(id));
+  if (results_.contains(id)) {
+    emit ResultReady(id, results_.take(id));
+  }
+
+  // Racers that were too slow count as misses.
+  if (races_.contains(id) && !races_[id].winner_) {
+    const Race& race = races_[id];
+    for (auto it = race.running_.begin(); it != race.running_.end(); ++it) {
+      RecordStats(it.key(), false, it.value().elapsed());
+    }
+  }
 
   // Cancel any providers that we're still waiting for
   for (SongInfoProvider* provider : waiting_for_[id]) {
@@ -97,6 +403,10 @@ void SongInfoFetcher::Timeout(int id) {
     provider->Cancel(id);
   }
   waiting_for_.remove(id);
+  cache_entries_.remove(id);
+  cached_info_.remove(id);
+  races_.remove(id);
+  metadata_.remove(id);
 
   // Remove the timer
   delete timeout_timers_.take(id);
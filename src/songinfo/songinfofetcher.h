@@ -18,11 +18,13 @@
 #ifndef SONGINFOFETCHER_H
 #define SONGINFOFETCHER_H
 
+#include <QElapsedTimer>
 #include <QMap>
 #include <QObject>
 #include <QUrl>
 
 #include "collapsibleinfopane.h"
+#include "songinfocache.h"
 #include "core/song.h"
 
 class SongInfoProvider;
@@ -39,10 +41,24 @@ class SongInfoFetcher : public QObject {
   };
 
   static const int kDefaultTimeoutDuration = 25000;  // msec
+  static const int kMaxConcurrentLyricsRequests;
+  static const char* kStatsSettingsGroup;
 
   void AddProvider(SongInfoProvider* provider);
+
+  // When set, lyrics sources are raced instead of all being asked at once.
+  // A few are asked at a time, and the rest are skipped as soon as one finds
+  // the lyrics.  Sources that answered quickly and often before go first.
+  void set_race_lyrics(bool race) { race_lyrics_ = race; }
+
   int FetchInfo(const Song& metadata);
 
+  // Fetches info for a song that's likely to be shown soon, like the next
+  // track in the playlist, from the providers that can cache it.  Nothing is
+  // emitted, but a FetchInfo for the song later will be answered from the
+  // cache.
+  void Prefetch(const Song& metadata);
+
   QList<SongInfoProvider*> providers() const { return providers_; }
 
 signals:
@@ -52,16 +68,60 @@ signals:
  private slots:
   void ImageReady(int id, const QUrl& url);
   void InfoReady(int id, const CollapsibleInfoPane::Data& data);
+  void HtmlReady(int id, const CollapsibleInfoPane::Data& data,
+                 const QString& html);
   void ProviderFinished(int id);
   void Timeout(int id);
+  void EmitCachedInfo(int id);
 
  private:
+  struct ProviderStats {
+    ProviderStats() : attempts_(0), hits_(0), latency_msec_(0) {}
+
+    int attempts_;
+    int hits_;
+    // Moving average of how long the provider takes to answer.
+    double latency_msec_;
+  };
+
+  struct Race {
+    Race() : winner_(nullptr) {}
+
+    QList<SongInfoProvider*> queued_;
+    QMap<SongInfoProvider*, QElapsedTimer> running_;
+    SongInfoProvider* winner_;
+  };
+
+  int StartRequest(const Song& metadata, bool prefetch);
+  void AddInfo(int id, const CollapsibleInfoPane::Data& data,
+               SongInfoProvider* provider);
+  void FinishProvider(int id, SongInfoProvider* provider);
+
+  QList<SongInfoProvider*> RaceOrder(
+      const QList<SongInfoProvider*>& providers) const;
+  void StartRacers(int id);
+  void RecordStats(SongInfoProvider* provider, bool hit, qint64 latency_msec);
+
+ private:
+  typedef QMap<SongInfoProvider*, SongInfoCache::Entry> CacheEntries;
+
   QList<SongInfoProvider*> providers_;
 
   QMap<int, Result> results_;
   QMap<int, QList<SongInfoProvider*> > waiting_for_;
   QMap<int, QTimer*> timeout_timers_;
 
+  SongInfoCache cache_;
+  QMap<int, Song> metadata_;
+  // What each cacheable provider has returned so far for each request.
+  QMap<int, CacheEntries> cache_entries_;
+  // Cache hits waiting to be emitted.
+  QMap<int, CacheEntries> cached_info_;
+
+  bool race_lyrics_;
+  QMap<int, Race> races_;
+  QMap<QString, ProviderStats> stats_;
+
   int timeout_duration_;
 
   int next_id_;
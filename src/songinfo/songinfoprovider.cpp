@@ -16,7 +16,31 @@
 */
 
 #include "songinfoprovider.h"
+#include "songinfotextview.h"
+#include "ultimatelyricslyric.h"
+
+#include <QCoreApplication>
+#include <QThread>
 
 SongInfoProvider::SongInfoProvider() : enabled_(true) {}
 
 QString SongInfoProvider::name() const { return metaObject()->className(); }
+
+void SongInfoProvider::SetHtmlContents(const QString& html,
+                                       CollapsibleInfoPane::Data* data) {
+  if (QThread::currentThread() == QCoreApplication::instance()->thread()) {
+    SongInfoTextView* editor = new SongInfoTextView;
+    editor->SetHtml(html);
+    data->contents_ = editor;
+  } else {
+    UltimateLyricsLyric* editor = new UltimateLyricsLyric;
+    editor->SetHtml(html);
+    data->content_object_ = editor;
+  }
+}
+
+void SongInfoProvider::EmitHtml(int id, CollapsibleInfoPane::Data data,
+                                const QString& html) {
+  SetHtmlContents(html, &data);
+  emit HtmlReady(id, data, html);
+}
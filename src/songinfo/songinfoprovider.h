@@ -35,14 +35,38 @@ class SongInfoProvider : public QObject {
 
   virtual QString name() const;
 
+  // How long the SongInfoFetcher can keep this provider's results in the
+  // SongInfoCache.  Zero, the default, means they're never cached.  Only
+  // images and panes emitted with EmitHtml are cached.
+  virtual int cache_lifetime_secs() const { return 0; }
+
+  // Lyrics sources are interchangeable, so a SongInfoFetcher can race them
+  // and keep only the first lyrics found.  Higher relevance sources are
+  // tried first.
+  virtual bool is_lyrics_source() const { return false; }
+  virtual int relevance() const { return 0; }
+
   bool is_enabled() const { return enabled_; }
   void set_enabled(bool enabled) { enabled_ = enabled; }
 
+  // Sets the contents of the pane to a view showing this HTML.  Widgets can
+  // only be created on the GUI thread, so on other threads it's a
+  // UltimateLyricsLyric in content_object_ instead.
+  static void SetHtmlContents(const QString& html,
+                              CollapsibleInfoPane::Data* data);
+
 signals:
   void ImageReady(int id, const QUrl& url);
   void InfoReady(int id, const CollapsibleInfoPane::Data& data);
+  void HtmlReady(int id, const CollapsibleInfoPane::Data& data,
+                 const QString& html);
   void Finished(int id);
 
+ protected:
+  // Emits a pane showing this HTML.  Use this instead of InfoReady where
+  // possible so the pane can be cached.
+  void EmitHtml(int id, CollapsibleInfoPane::Data data, const QString& html);
+
  private:
   bool enabled_;
 };
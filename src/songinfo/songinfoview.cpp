@@ -21,10 +21,10 @@
 
 #include <QFuture>
 #include <QSettings>
-#include <QtConcurrentRun>
 
 #include "config.h"
 #include "core/closure.h"
+#include "core/taskexecutor.h"
 #include "songinfo/songinfoprovider.h"
 #include "songinfo/taglyricsinfoprovider.h"
 #include "songinfo/ultimatelyricsprovider.h"
@@ -39,12 +39,16 @@ const char* SongInfoView::kSettingsGroup = "SongInfo";
 SongInfoView::SongInfoView(QWidget* parent)
     : SongInfoBase(parent), ultimate_reader_(new UltimateLyricsReader(this)) {
   // Parse the ultimate lyrics xml file in the background
-  QFuture<ProviderList> future =
-      QtConcurrent::run(ultimate_reader_.get(), &UltimateLyricsReader::Parse,
-                        QString(":lyrics/ultimate_providers.xml"));
+  QFuture<ProviderList> future = TaskExecutor::Instance()->Run<ProviderList>(
+      TaskExecutor::Lane_Background,
+      std::bind(&UltimateLyricsReader::Parse, ultimate_reader_.get(),
+                QString(":lyrics/ultimate_providers.xml")));
   NewClosure(future, this, SLOT(UltimateLyricsParsed(QFuture<ProviderList>)),
              future);
 
+  // Only one set of lyrics is shown, so stop at the first source that has it
+  fetcher_->set_race_lyrics(true);
+
 #ifdef HAVE_LIBLASTFM
   fetcher_->AddProvider(new LastfmTrackInfoProvider);
 #endif
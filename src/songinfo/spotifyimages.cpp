@@ -18,7 +18,7 @@ static const char* kSpotifyImagesUrl =
     "https://data.clementine-player.org/fetchimages";
 }  // namespace
 
-SpotifyImages::SpotifyImages() : network_(new NetworkAccessManager) {}
+SpotifyImages::SpotifyImages() : network_(NetworkAccessManager::Shared()) {}
 
 SpotifyImages::~SpotifyImages() {}
 
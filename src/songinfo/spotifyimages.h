@@ -18,8 +18,6 @@
 #ifndef SPOTIFYIMAGES_H
 #define SPOTIFYIMAGES_H
 
-#include <memory>
-
 #include "songinfo/songinfoprovider.h"
 
 class NetworkAccessManager;
@@ -35,7 +33,7 @@ class SpotifyImages : public SongInfoProvider {
  private:
   void FetchImagesForArtist(int id, const QString& spotify_id);
 
-  std::unique_ptr<NetworkAccessManager> network_;
+  NetworkAccessManager* network_;
 };
 
 #endif  // SPOTIFYIMAGES_H
@@ -5,9 +5,29 @@
 #include "core/signalchecker.h"
 #include "core/waitforsignal.h"
 
+#include <QCache>
+#include <QDateTime>
 #include <QEventLoop>
+#include <QFileInfo>
+#include <QMutex>
+#include <QUrl>
 
 const int StreamDiscoverer::kDiscoveryTimeoutS = 10;
+const int StreamDiscoverer::kCacheSize = 500;
+const qint64 StreamDiscoverer::kRemoteCacheMsec = 10 * 60 * 1000;
+
+namespace {
+
+struct CachedStreamDetails {
+  StreamDetails details_;
+  // 0 for local files, which are checked by mtime instead.
+  qint64 expiry_msec_;
+};
+
+QMutex sCacheMutex;
+QCache<QString, CachedStreamDetails>* sCache = nullptr;
+
+}  // namespace
 
 StreamDiscoverer::StreamDiscoverer() : QObject(nullptr) {
   // Setting up a discoverer:
@@ -30,7 +50,60 @@ StreamDiscoverer::~StreamDiscoverer() {
   g_object_unref(discoverer_);
 }
 
+QString StreamDiscoverer::CacheKey(const QString& url) {
+  const QUrl qurl(url);
+  if (!qurl.isLocalFile()) return url;
+
+  const QFileInfo info(qurl.toLocalFile());
+  return url + "\n" +
+         QString::number(info.lastModified().toMSecsSinceEpoch()) + "\n" +
+         QString::number(info.size());
+}
+
+bool StreamDiscoverer::CachedDetails(const QString& url,
+                                     StreamDetails* details) {
+  const QString key = CacheKey(url);
+
+  QMutexLocker l(&sCacheMutex);
+  if (!sCache) return false;
+
+  CachedStreamDetails* cached = sCache->object(key);
+  if (!cached) return false;
+  if (cached->expiry_msec_ &&
+      cached->expiry_msec_ <= QDateTime::currentMSecsSinceEpoch()) {
+    sCache->remove(key);
+    return false;
+  }
+
+  *details = cached->details_;
+  return true;
+}
+
+void StreamDiscoverer::AddToCache(const QString& url,
+                                  const StreamDetails& details) {
+  CachedStreamDetails* cached = new CachedStreamDetails;
+  cached->details_ = details;
+  cached->expiry_msec_ =
+      QUrl(url).isLocalFile()
+          ? 0
+          : QDateTime::currentMSecsSinceEpoch() + kRemoteCacheMsec;
+  const QString key = CacheKey(url);
+
+  QMutexLocker l(&sCacheMutex);
+  if (!sCache) sCache = new QCache<QString, CachedStreamDetails>(kCacheSize);
+  sCache->insert(key, cached);
+}
+
 void StreamDiscoverer::Discover(const QString& url) {
+  StreamDetails details;
+  if (CachedDetails(url, &details)) {
+    qLog(Debug) << "Discovered" << url << "before";
+    emit DataReady(details);
+    return;
+  }
+
+  discovering_url_ = url;
+
   // Adding the request to discover the url given as a parameter:
   qLog(Debug) << "Discover" << url;
   if (!gst_discoverer_discover_uri_async(discoverer_,
@@ -39,6 +112,7 @@ void StreamDiscoverer::Discover(const QString& url) {
     return;
   }
   WaitForSignal(this, SIGNAL(DiscoverFinished()));
+  discovering_url_.clear();
 }
 
 void StreamDiscoverer::OnDiscovered(GstDiscoverer* discoverer,
@@ -90,6 +164,10 @@ void StreamDiscoverer::OnDiscovered(GstDiscoverer* discoverer,
     gst_caps_unref(stream_caps);
     g_free(decoder_description);
 
+    AddToCache(instance->discovering_url_.isEmpty()
+                   ? discovered_url
+                   : instance->discovering_url_,
+               stream_details);
     emit instance->DataReady(stream_details);
 
   } else {
@@ -24,8 +24,14 @@ class StreamDiscoverer : public QObject {
   StreamDiscoverer();
   ~StreamDiscoverer();
 
+  // Emits DataReady straight away if the url was discovered recently, and
+  // for a local file, hasn't changed since.
   void Discover(const QString& url);
 
+  // Returns true and fills in details if the url has been discovered before
+  // and the result is still good.
+  static bool CachedDetails(const QString& url, StreamDetails* details);
+
 signals:
   void DiscoverFinished();
   void DataReady(const StreamDetails& data);
@@ -33,8 +39,17 @@ signals:
 
  private:
   GstDiscoverer* discoverer_;
+  // As it was given to Discover(), which GStreamer might have rewritten.
+  QString discovering_url_;
 
   static const int kDiscoveryTimeoutS;
+  static const int kCacheSize;
+  // Remote streams might change what they send, so don't trust them forever.
+  static const qint64 kRemoteCacheMsec;
+
+  // The cache key for url, which includes the mtime of local files.
+  static QString CacheKey(const QString& url);
+  static void AddToCache(const QString& url, const StreamDetails& details);
 
   // GstDiscoverer callbacks:
   static void OnDiscovered(GstDiscoverer* discoverer, GstDiscovererInfo* info,
@@ -18,6 +18,7 @@
 #ifndef ULTIMATELYRICSPROVIDER_H
 #define ULTIMATELYRICSPROVIDER_H
 
+#include <QMap>
 #include <QObject>
 #include <QPair>
 #include <QStringList>
@@ -36,6 +37,7 @@ class UltimateLyricsProvider : public SongInfoProvider {
   UltimateLyricsProvider();
 
   static const int kRedirectLimit;
+  static const int kCacheLifetimeSecs;
 
   typedef QPair<QString, QString> RuleItem;
   typedef QList<RuleItem> Rule;
@@ -59,13 +61,31 @@ class UltimateLyricsProvider : public SongInfoProvider {
 
   QString name() const { return name_; }
   int relevance() const { return relevance_; }
+  int cache_lifetime_secs() const { return kCacheLifetimeSecs; }
+  bool is_lyrics_source() const { return true; }
 
   void FetchInfo(int id, const Song& metadata);
+  void Cancel(int id);
 
  private slots:
   void RequestFinished(QNetworkReply* reply, const QString& orig_url, int id);
 
  private:
+  // Several requests can be in flight at once when the next track's lyrics
+  // are prefetched, so keep their state separately.
+  struct Request {
+    Request() : reply_(nullptr), redirect_count_(0), url_hop_(false) {}
+
+    QNetworkReply* reply_;
+    Song metadata_;
+    int redirect_count_;
+    bool url_hop_;
+  };
+
+  void Get(int id, const QUrl& url, const QString& orig_url);
+
+  void RequestDone(int id);
+
   bool ApplyExtractRule(const Rule& rule, QString* content) const;
   void ApplyExcludeRule(const Rule& rule, QString* content) const;
 
@@ -100,9 +120,7 @@ class UltimateLyricsProvider : public SongInfoProvider {
   QList<Rule> exclude_rules_;
   QStringList invalid_indicators_;
 
-  Song metadata_;
-  int redirect_count_;
-  bool url_hop_;
+  QMap<int, Request> requests_;
 };
 
 #endif  // ULTIMATELYRICSPROVIDER_H
@@ -38,7 +38,6 @@
 #endif
 
 const char* TranscodeDialog::kSettingsGroup = "Transcoder";
-const int TranscodeDialog::kProgressInterval = 500;
 const int TranscodeDialog::kMaxDestinationItems = 10;
 
 static bool ComparePresetsByName(const TranscoderPreset& left,
@@ -113,6 +112,8 @@ TranscodeDialog::TranscodeDialog(QWidget* parent)
 
   connect(transcoder_, SIGNAL(JobComplete(QString, QString, bool)),
           SLOT(JobComplete(QString, QString, bool)));
+  connect(transcoder_, SIGNAL(JobProgress(QString, float)),
+          SLOT(JobProgress(QString, float)));
   connect(transcoder_, SIGNAL(LogLine(QString)), SLOT(LogLine(QString)));
   connect(transcoder_, SIGNAL(AllJobsComplete()), SLOT(AllJobsComplete()));
 }
@@ -130,10 +131,7 @@ void TranscodeDialog::SetWorking(bool working) {
   ui_->output_group->setEnabled(!working);
   ui_->progress_group->setVisible(true);
 
-  if (working)
-    progress_timer_.start(kProgressInterval, this);
-  else
-    progress_timer_.stop();
+  job_progress_.clear();
 }
 
 void TranscodeDialog::Start() {
@@ -182,16 +180,21 @@ void TranscodeDialog::JobComplete(const QString& input, const QString& output,
   else
     finished_failed_++;
   queued_--;
+  job_progress_.remove(input);
 
   UpdateStatusText();
   UpdateProgress();
 }
 
+void TranscodeDialog::JobProgress(const QString& input, float progress) {
+  job_progress_[input] = progress;
+  UpdateProgress();
+}
+
 void TranscodeDialog::UpdateProgress() {
   int progress = (finished_success_ + finished_failed_) * 100;
 
-  QMap<QString, float> current_jobs = transcoder_->GetProgress();
-  for (float value : current_jobs.values()) {
+  for (float value : job_progress_.values()) {
     progress += qBound(0, int(value * 100), 99);
   }
 
@@ -280,14 +283,6 @@ void TranscodeDialog::LogLine(const QString& message) {
   log_ui_->log->appendPlainText(QString("%1: %2").arg(date, message));
 }
 
-void TranscodeDialog::timerEvent(QTimerEvent* e) {
-  QDialog::timerEvent(e);
-
-  if (e->timerId() == progress_timer_.timerId()) {
-    UpdateProgress();
-  }
-}
-
 void TranscodeDialog::Options() {
   TranscoderPreset preset = ui_->format->itemData(ui_->format->currentIndex())
                                 .value<TranscoderPreset>();
@@ -18,9 +18,9 @@
 #ifndef TRANSCODEDIALOG_H
 #define TRANSCODEDIALOG_H
 
-#include <QBasicTimer>
 #include <QDialog>
 #include <QFileInfo>
+#include <QMap>
 
 class Transcoder;
 class Ui_TranscodeDialog;
@@ -36,14 +36,10 @@ class TranscodeDialog : public QDialog {
   ~TranscodeDialog();
 
   static const char* kSettingsGroup;
-  static const int kProgressInterval;
   static const int kMaxDestinationItems;
 
   void SetFilenames(const QStringList& filenames);
 
- protected:
-  void timerEvent(QTimerEvent* e);
-
  private slots:
   void Add();
   void Import();
@@ -51,6 +47,7 @@ class TranscodeDialog : public QDialog {
   void Start();
   void Cancel();
   void JobComplete(const QString& input, const QString& output, bool success);
+  void JobProgress(const QString& input, float progress);
   void LogLine(const QString& message);
   void AllJobsComplete();
   void Options();
@@ -68,8 +65,6 @@ class TranscodeDialog : public QDialog {
   Ui_TranscodeLogDialog* log_ui_;
   QDialog* log_dialog_;
 
-  QBasicTimer progress_timer_;
-
   QPushButton* start_button_;
   QPushButton* cancel_button_;
   QPushButton* close_button_;
@@ -81,6 +76,7 @@ class TranscodeDialog : public QDialog {
   int queued_;
   int finished_success_;
   int finished_failed_;
+  QMap<QString, float> job_progress_;
 };
 
 #endif  // TRANSCODEDIALOG_H
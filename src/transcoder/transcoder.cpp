@@ -20,20 +20,27 @@
 #include <algorithm>
 #include <memory>
 
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#endif
+
 #include <QCoreApplication>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QSettings>
 #include <QThread>
 #include <QtDebug>
 
 #include "core/logging.h"
 #include "core/signalchecker.h"
+#include "core/timeconstants.h"
 #include "core/utilities.h"
 
 using std::shared_ptr;
 
 int Transcoder::JobFinishedEvent::sEventType = -1;
+const int Transcoder::kProgressIntervalMsec = 500;
 
 TranscoderPreset::TranscoderPreset(Song::FileType type, const QString& name,
                                    const QString& extension,
@@ -198,6 +205,7 @@ void Transcoder::JobState::PostFinished(bool success) {
 Transcoder::Transcoder(QObject* parent, const QString& settings_postfix)
     : QObject(parent),
       max_threads_(QThread::idealThreadCount()),
+      priority_(TranscodeScheduler::Priority_Normal),
       settings_postfix_(settings_postfix) {
   if (JobFinishedEvent::sEventType == -1)
     JobFinishedEvent::sEventType = QEvent::registerEventType();
@@ -214,6 +222,11 @@ Transcoder::Transcoder(QObject* parent, const QString& settings_postfix)
   }
 }
 
+Transcoder::~Transcoder() {
+  // Give back any slots our jobs were holding.
+  Cancel();
+}
+
 QList<TranscoderPreset> Transcoder::GetAllPresets() {
   QList<TranscoderPreset> ret;
   ret << PresetForFileType(Song::Type_Flac);
@@ -277,10 +290,12 @@ Song::FileType Transcoder::PickBestFormat(QList<Song::FileType> supported) {
 }
 
 void Transcoder::AddJob(const QString& input, const TranscoderPreset& preset,
-                        const QString& output) {
+                        const QString& output, const Song& metadata) {
   Job job;
   job.input = input;
   job.preset = preset;
+  job.input_type = metadata.filetype();
+  job.input_bitrate = metadata.bitrate();
 
   // Use the supplied filename if there was one, otherwise take the file
   // extension off the input filename and append the correct one.
@@ -305,11 +320,14 @@ void Transcoder::AddJob(const QString& input, const TranscoderPreset& preset,
   queued_jobs_ << job;
 }
 
-void Transcoder::AddTemporaryJob(const QString &input, const TranscoderPreset &preset) {
+void Transcoder::AddTemporaryJob(const QString &input, const TranscoderPreset &preset,
+                                 const Song& metadata) {
   Job job;
   job.input = input;
   job.output = Utilities::GetTemporaryFileName();
   job.preset = preset;
+  job.input_type = metadata.filetype();
+  job.input_bitrate = metadata.bitrate();
 
   queued_jobs_ << job;
 }
@@ -319,6 +337,10 @@ void Transcoder::Start() {
                    .arg(queued_jobs_.count())
                    .arg(max_threads()));
 
+  StartJobs();
+}
+
+void Transcoder::StartJobs() {
   forever {
     StartJobStatus status = MaybeStartNextJob();
     if (status == AllThreadsBusy || status == NoMoreJobs) break;
@@ -335,11 +357,17 @@ Transcoder::StartJobStatus Transcoder::MaybeStartNextJob() {
     return NoMoreJobs;
   }
 
+  // The scheduler calls StartJobs() again when it's our turn.
+  if (!TranscodeScheduler::Instance()->Acquire(this, priority_)) {
+    return AllThreadsBusy;
+  }
+
   Job job = queued_jobs_.takeFirst();
   if (StartJob(job)) {
     return StartedSuccessfully;
   }
 
+  TranscodeScheduler::Instance()->Release(this);
   emit JobComplete(job.input, job.output, false);
   return FailedToStart;
 }
@@ -359,6 +387,68 @@ void Transcoder::NewPadCallback(GstElement*, GstPad* pad,
   gst_object_unref(audiopad);
 }
 
+void Transcoder::RemuxPadCallback(GstElement*, GstPad* pad, gpointer data) {
+  JobState* state = reinterpret_cast<JobState*>(data);
+  GstPad* const sinkpad =
+      gst_element_get_compatible_pad(state->remux_element_, pad, nullptr);
+
+  if (!sinkpad) {
+    qLog(Warning) << "Couldn't find a pad to remux" << GST_PAD_NAME(pad)
+                  << "into";
+    return;
+  }
+
+  gst_pad_link(pad, sinkpad);
+  gst_object_unref(sinkpad);
+
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, &ProgressProbeCallback,
+                    state, nullptr);
+}
+
+GstPadProbeReturn Transcoder::ProgressProbeCallback(GstPad* pad,
+                                                    GstPadProbeInfo* info,
+                                                    gpointer data) {
+  JobState* state = reinterpret_cast<JobState*>(data);
+
+  const qint64 now = state->timer_.nsecsElapsed();
+  if (state->last_progress_nanosec_ != -1 &&
+      now - state->last_progress_nanosec_ <
+          kProgressIntervalMsec * kNsecPerMsec) {
+    return GST_PAD_PROBE_OK;
+  }
+  state->last_progress_nanosec_ = now;
+
+  GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+  float progress = 0;
+
+  if (state->mode_ == JobMode_Copy) {
+    if (state->input_size_ <= 0 || !GST_BUFFER_OFFSET_IS_VALID(buffer)) {
+      return GST_PAD_PROBE_OK;
+    }
+    progress = float(GST_BUFFER_OFFSET(buffer)) / state->input_size_;
+  } else {
+    // Ask upstream once - the demuxer or parser knows the duration.
+    if (state->duration_nanosec_ <= 0) {
+      if (GST_PAD_IS_SRC(pad)) {
+        gst_pad_query_duration(pad, GST_FORMAT_TIME,
+                               &state->duration_nanosec_);
+      } else {
+        gst_pad_peer_query_duration(pad, GST_FORMAT_TIME,
+                                    &state->duration_nanosec_);
+      }
+    }
+    if (state->duration_nanosec_ <= 0 || !GST_BUFFER_PTS_IS_VALID(buffer)) {
+      return GST_PAD_PROBE_OK;
+    }
+    progress = float(GST_BUFFER_PTS(buffer)) / state->duration_nanosec_;
+  }
+
+  emit state->parent_->JobProgress(state->job_.input,
+                                   qBound(0.0f, progress, 1.0f));
+
+  return GST_PAD_PROBE_OK;
+}
+
 GstBusSyncReply Transcoder::BusCallbackSync(GstBus*, GstMessage* msg,
                                             gpointer data) {
   JobState* state = reinterpret_cast<JobState*>(data);
@@ -372,6 +462,10 @@ GstBusSyncReply Transcoder::BusCallbackSync(GstBus*, GstMessage* msg,
       state->PostFinished(false);
       break;
 
+    case GST_MESSAGE_STREAM_STATUS:
+      state->StreamStatusMessageReceived(msg);
+      break;
+
     default:
       break;
   }
@@ -392,6 +486,63 @@ void Transcoder::JobState::ReportError(GstMessage* msg) {
       QDir::toNativeSeparators(job_.input), message));
 }
 
+void Transcoder::JobState::StreamStatusMessageReceived(GstMessage* msg) {
+#ifdef Q_OS_LINUX
+  // ENTER and LEAVE are posted from the streaming thread itself.  Threads
+  // come from a pool and get reused, so only the time since ENTER counts.
+  GstStreamStatusType type;
+  GstElement* owner;
+  gst_message_parse_stream_status(msg, &type, &owner);
+
+  if (type != GST_STREAM_STATUS_TYPE_ENTER &&
+      type != GST_STREAM_STATUS_TYPE_LEAVE) {
+    return;
+  }
+
+  clockid_t clock;
+  if (pthread_getcpuclockid(pthread_self(), &clock) != 0) return;
+  const qint64 cpu_nanosec = ThreadCpuNanosec(clock);
+
+  QMutexLocker l(&threads_mutex_);
+  if (type == GST_STREAM_STATUS_TYPE_ENTER) {
+    StreamThread thread;
+    thread.clock_ = clock;
+    thread.cpu_at_enter_nanosec_ = cpu_nanosec;
+    stream_threads_ << thread;
+  } else {
+    for (int i = 0; i < stream_threads_.count(); ++i) {
+      if (stream_threads_[i].clock_ == clock) {
+        finished_threads_cpu_nanosec_ +=
+            cpu_nanosec - stream_threads_[i].cpu_at_enter_nanosec_;
+        stream_threads_.removeAt(i);
+        break;
+      }
+    }
+  }
+#endif
+}
+
+qint64 Transcoder::JobState::cpu_nanosec() const {
+#ifdef Q_OS_LINUX
+  QMutexLocker l(&threads_mutex_);
+  qint64 ret = finished_threads_cpu_nanosec_;
+  for (const StreamThread& thread : stream_threads_) {
+    ret += ThreadCpuNanosec(thread.clock_) - thread.cpu_at_enter_nanosec_;
+  }
+  return ret;
+#else
+  return 0;
+#endif
+}
+
+#ifdef Q_OS_LINUX
+qint64 Transcoder::JobState::ThreadCpuNanosec(clockid_t clock) {
+  timespec time;
+  if (clock_gettime(clock, &time) != 0) return 0;
+  return qint64(time.tv_sec) * kNsecPerSec + time.tv_nsec;
+}
+#endif
+
 bool Transcoder::StartJob(const Job& job) {
   shared_ptr<JobState> state(new JobState(job, this));
 
@@ -405,6 +556,62 @@ bool Transcoder::StartJob(const Job& job) {
 
   // Create all the elements
   GstElement* src = CreateElement("filesrc", state->pipeline_);
+  GstElement* sink = CreateElement("filesink", state->pipeline_);
+
+  if (!src || !sink) return false;
+
+  bool linked = false;
+  state->mode_ = ModeForJob(job);
+  switch (state->mode_) {
+    case JobMode_Copy: {
+      LogLine("Copying the file, it's already in the right format");
+      linked = gst_element_link(src, sink);
+
+      // Progress is measured by how much of the file has been read.
+      state->input_size_ = QFileInfo(job.input).size();
+      GstPad* pad = gst_element_get_static_pad(src, "src");
+      gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+                        &ProgressProbeCallback, state.get(), nullptr);
+      gst_object_unref(pad);
+      break;
+    }
+
+    case JobMode_Remux:
+      LogLine("Remuxing without re-encoding");
+      linked = LinkRemuxElements(state.get(), src, sink);
+      break;
+
+    case JobMode_Transcode:
+      linked = LinkTranscodeElements(state.get(), src, sink);
+      break;
+  }
+
+  if (!linked) return false;
+
+  // Set properties
+  g_object_set(src, "location", job.input.toUtf8().constData(), nullptr);
+  g_object_set(sink, "location", job.output.toUtf8().constData(), nullptr);
+
+  // Set callbacks
+  gst_bus_set_sync_handler(gst_pipeline_get_bus(GST_PIPELINE(state->pipeline_)),
+                           BusCallbackSync, state.get(), nullptr);
+
+  // Start the pipeline
+  state->timer_.start();
+  gst_element_set_state(state->pipeline_, GST_STATE_PLAYING);
+
+  // GStreamer now transcodes in another thread, so we can return now and do
+  // something else.  Keep the JobState object around.  It'll post an event
+  // to our event loop when it finishes.
+  current_jobs_ << state;
+
+  return true;
+}
+
+bool Transcoder::LinkTranscodeElements(JobState* state, GstElement* src,
+                                       GstElement* sink) {
+  const Job& job = state->job_;
+
   GstElement* decode = CreateElement("decodebin", state->pipeline_);
   GstElement* convert = CreateElement("audioconvert", state->pipeline_);
   GstElement* resample = CreateElement("audioresample", state->pipeline_);
@@ -412,9 +619,8 @@ bool Transcoder::StartJob(const Job& job) {
       "Codec/Encoder/Audio", job.preset.codec_mimetype_, state->pipeline_);
   GstElement* muxer = CreateElementForMimeType(
       "Codec/Muxer", job.preset.muxer_mimetype_, state->pipeline_);
-  GstElement* sink = CreateElement("filesink", state->pipeline_);
 
-  if (!src || !decode || !convert || !sink) return false;
+  if (!decode || !convert) return false;
 
   if (!codec && !job.preset.codec_mimetype_.isEmpty()) {
     LogLine(tr("Couldn't find an encoder for %1, check you have the correct "
@@ -437,28 +643,118 @@ bool Transcoder::StartJob(const Job& job) {
   else if (muxer)
     gst_element_link_many(convert, resample, muxer, sink, nullptr);
 
-  // Set properties
-  g_object_set(src, "location", job.input.toUtf8().constData(), nullptr);
-  g_object_set(sink, "location", job.output.toUtf8().constData(), nullptr);
-
-  // Set callbacks
+  // The decoder's pad appears once it knows what the file contains
   state->convert_element_ = convert;
+  CHECKED_GCONNECT(decode, "pad-added", &NewPadCallback, state);
 
-  CHECKED_GCONNECT(decode, "pad-added", &NewPadCallback, state.get());
-  gst_bus_set_sync_handler(gst_pipeline_get_bus(GST_PIPELINE(state->pipeline_)),
-                           BusCallbackSync, state.get(), nullptr);
+  GstPad* pad = gst_element_get_static_pad(convert, "sink");
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, &ProgressProbeCallback,
+                    state, nullptr);
+  gst_object_unref(pad);
 
-  // Start the pipeline
-  gst_element_set_state(state->pipeline_, GST_STATE_PLAYING);
+  return true;
+}
 
-  // GStreamer now transcodes in another thread, so we can return now and do
-  // something else.  Keep the JobState object around.  It'll post an event
-  // to our event loop when it finishes.
-  current_jobs_ << state;
+bool Transcoder::LinkRemuxElements(JobState* state, GstElement* src,
+                                   GstElement* sink) {
+  const Job& job = state->job_;
+
+  GstElement* parse = CreateElement("parsebin", state->pipeline_);
+  GstElement* muxer = CreateElementForMimeType(
+      "Codec/Muxer", job.preset.muxer_mimetype_, state->pipeline_);
+
+  if (!parse) return false;
+
+  if (!muxer && !job.preset.muxer_mimetype_.isEmpty()) {
+    LogLine(tr("Couldn't find a muxer for %1, check you have the correct "
+               "GStreamer plugins installed").arg(job.preset.muxer_mimetype_));
+    return false;
+  }
+
+  gst_element_link(src, parse);
+  if (muxer) {
+    gst_element_link(muxer, sink);
+    state->remux_element_ = muxer;
+  } else {
+    state->remux_element_ = sink;
+  }
+
+  CHECKED_GCONNECT(parse, "pad-added", &RemuxPadCallback, state);
 
   return true;
 }
 
+Transcoder::JobMode Transcoder::ModeForJob(const Job& job) const {
+  const Song::FileType input_type = job.input_type;
+  const Song::FileType output_type = job.preset.type_;
+
+  if (input_type == Song::Type_Unknown || output_type == Song::Type_Unknown) {
+    return JobMode_Transcode;
+  }
+
+  if (input_type == output_type) {
+    switch (input_type) {
+      case Song::Type_Flac:
+      case Song::Type_OggFlac:
+      case Song::Type_Wav:
+        // Encoding lossless audio again gains nothing.
+        return JobMode_Copy;
+
+      default: {
+        // Encoding lossy audio again only loses quality, so it's only worth
+        // it to make the file noticeably smaller.
+        const int target_bitrate = TargetBitrate(output_type);
+        if (target_bitrate > 0 && job.input_bitrate > 0 &&
+            job.input_bitrate <= target_bitrate * 11 / 10) {
+          return JobMode_Copy;
+        }
+        return JobMode_Transcode;
+      }
+    }
+  }
+
+  // FLAC moves between its own container and Ogg without being decoded.
+  if ((input_type == Song::Type_Flac && output_type == Song::Type_OggFlac) ||
+      (input_type == Song::Type_OggFlac && output_type == Song::Type_Flac)) {
+    GstElementFactory* factory = gst_element_factory_find("parsebin");
+    if (factory) {
+      gst_object_unref(factory);
+      return JobMode_Remux;
+    }
+  }
+
+  return JobMode_Transcode;
+}
+
+int Transcoder::TargetBitrate(Song::FileType type) const {
+  // These match the settings written by the TranscoderOptions pages, and are
+  // in kbps like Song::bitrate().
+  QSettings s;
+  switch (type) {
+    case Song::Type_Mpeg:
+      s.beginGroup("Transcoder/lamemp3enc" + settings_postfix_);
+      if (s.value("target", 1).toInt() != 1) return -1;
+      return s.value("bitrate", 128).toInt();
+
+    case Song::Type_Mp4:
+      s.beginGroup("Transcoder/faac" + settings_postfix_);
+      return s.value("bitrate", 128000).toInt() / 1000;
+
+    case Song::Type_OggOpus:
+      s.beginGroup("Transcoder/opusenc" + settings_postfix_);
+      return s.value("bitrate", 128000).toInt() / 1000;
+
+    case Song::Type_OggVorbis: {
+      s.beginGroup("Transcoder/vorbisenc" + settings_postfix_);
+      const int bitrate = s.value("bitrate", -1).toInt();
+      return bitrate > 0 ? bitrate / 1000 : -1;
+    }
+
+    default:
+      return -1;
+  }
+}
+
 Transcoder::JobState::~JobState() {
   if (pipeline_) {
     gst_element_set_state(pipeline_, GST_STATE_NULL);
@@ -485,6 +781,11 @@ bool Transcoder::event(QEvent* e) {
     QString input = (*it)->job_.input;
     QString output = (*it)->job_.output;
 
+    // The streaming threads are still alive until the pipeline is destroyed
+    // below, so their CPU time can be read now.
+    const qint64 wall_nanosec = (*it)->timer_.nsecsElapsed();
+    const qint64 cpu_nanosec = (*it)->cpu_nanosec();
+
     // Remove event handlers from the gstreamer pipeline so they don't get
     // called after the pipeline is shutting down
     gst_bus_set_sync_handler(
@@ -493,6 +794,15 @@ bool Transcoder::event(QEvent* e) {
 
     // Remove it from the list - this will also destroy the GStreamer pipeline
     current_jobs_.erase(it);
+    TranscodeScheduler::Instance()->Release(this);
+
+    if (finished_event->success_) {
+      emit LogLine(QString("Took %1 ms, using %2 ms of CPU time")
+                       .arg(wall_nanosec / kNsecPerMsec)
+                       .arg(cpu_nanosec / kNsecPerMsec));
+      TranscodeScheduler::Instance()->RecordJob(priority_, wall_nanosec,
+                                                cpu_nanosec);
+    }
 
     // Emit the finished signal
     emit JobComplete(input, output, finished_event->success_);
@@ -531,6 +841,9 @@ void Transcoder::Cancel() {
     // Remove the job, this destroys the GStreamer pipeline too
     it = current_jobs_.erase(it);
   }
+
+  // Give back the slots and stop waiting for new ones.
+  TranscodeScheduler::Instance()->Remove(this);
 }
 
 QMap<QString, float> Transcoder::GetProgress() const {
@@ -542,10 +855,18 @@ QMap<QString, float> Transcoder::GetProgress() const {
     gint64 position = 0;
     gint64 duration = 0;
 
-    gst_element_query_position(state->pipeline_, GST_FORMAT_TIME, &position);
-    gst_element_query_duration(state->pipeline_, GST_FORMAT_TIME, &duration);
+    if (!gst_element_query_position(state->pipeline_, GST_FORMAT_TIME,
+                                    &position) ||
+        !gst_element_query_duration(state->pipeline_, GST_FORMAT_TIME,
+                                    &duration)) {
+      // Files that are only being copied don't know about time, just bytes.
+      gst_element_query_position(state->pipeline_, GST_FORMAT_BYTES,
+                                 &position);
+      gst_element_query_duration(state->pipeline_, GST_FORMAT_BYTES,
+                                 &duration);
+    }
 
-    ret[state->job_.input] = float(position) / duration;
+    ret[state->job_.input] = duration > 0 ? float(position) / duration : 0;
   }
 
   return ret;
@@ -22,11 +22,18 @@
 
 #include <gst/gst.h>
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QStringList>
 #include <QEvent>
 #include <QMetaType>
+#include <QMutex>
 
+#ifdef Q_OS_LINUX
+#include <time.h>
+#endif
+
+#include "transcodescheduler.h"
 #include "core/song.h"
 
 struct TranscoderPreset {
@@ -48,6 +55,9 @@ class Transcoder : public QObject {
 
  public:
   Transcoder(QObject* parent = nullptr, const QString& settings_postfix = "");
+  ~Transcoder();
+
+  static const int kProgressIntervalMsec;
 
   static TranscoderPreset PresetForFileType(Song::FileType type);
   static QList<TranscoderPreset> GetAllPresets();
@@ -56,9 +66,19 @@ class Transcoder : public QObject {
   int max_threads() const { return max_threads_; }
   void set_max_threads(int count) { max_threads_ = count; }
 
+  // Decides which transcoder gets the next free slot when several are busy.
+  TranscodeScheduler::Priority priority() const { return priority_; }
+  void set_priority(TranscodeScheduler::Priority priority) {
+    priority_ = priority;
+  }
+
+  // If the input's metadata is given and its codec already matches the
+  // preset, the file is remuxed or copied instead of being re-encoded.
   void AddJob(const QString& input, const TranscoderPreset& preset,
-              const QString& output = QString());
-  void AddTemporaryJob(const QString& input, const TranscoderPreset& preset);
+              const QString& output = QString(),
+              const Song& metadata = Song());
+  void AddTemporaryJob(const QString& input, const TranscoderPreset& preset,
+                       const Song& metadata = Song());
 
   QMap<QString, float> GetProgress() const;
   int QueuedJobsCount() const { return queued_jobs_.count(); }
@@ -71,6 +91,12 @@ signals:
   void JobComplete(const QString& input, const QString& output, bool success);
   void LogLine(const QString& message);
   void AllJobsComplete();
+  // Emitted from the job's own thread, at most every kProgressIntervalMsec.
+  void JobProgress(const QString& input, float progress);
+
+ private slots:
+  // Starts as many queued jobs as the scheduler allows.
+  void StartJobs();
 
  protected:
   bool event(QEvent* e);
@@ -78,9 +104,23 @@ signals:
  private:
   // The description of a file to transcode - lives in the main thread.
   struct Job {
+    Job() : input_type(Song::Type_Unknown), input_bitrate(-1) {}
+
     QString input;
     QString output;
     TranscoderPreset preset;
+
+    Song::FileType input_type;
+    int input_bitrate;
+  };
+
+  // How much of the transcoding pipeline a job actually needs.
+  enum JobMode {
+    JobMode_Transcode,
+    // Same codec in a different container - parse it and mux it again.
+    JobMode_Remux,
+    // Already in the right format - copy the file as it is.
+    JobMode_Copy,
   };
 
   // State held by a job and shared across gstreamer callbacks - lives in the
@@ -89,17 +129,52 @@ signals:
     JobState(const Job& job, Transcoder* parent)
         : job_(job),
           parent_(parent),
+          mode_(JobMode_Transcode),
           pipeline_(nullptr),
-          convert_element_(nullptr) {}
+          convert_element_(nullptr),
+          remux_element_(nullptr),
+          input_size_(0),
+          duration_nanosec_(-1),
+          last_progress_nanosec_(-1) {
+#ifdef Q_OS_LINUX
+      finished_threads_cpu_nanosec_ = 0;
+#endif
+    }
     ~JobState();
 
     void PostFinished(bool success);
     void ReportError(GstMessage* msg);
+    void StreamStatusMessageReceived(GstMessage* msg);
+
+    // CPU time used by the job's streaming threads so far.
+    qint64 cpu_nanosec() const;
 
     Job job_;
     Transcoder* parent_;
+    JobMode mode_;
     GstElement* pipeline_;
     GstElement* convert_element_;
+    // The muxer or sink that parsed streams are linked to in JobMode_Remux.
+    GstElement* remux_element_;
+    QElapsedTimer timer_;
+
+    // Used by the progress probe, in the streaming thread.
+    qint64 input_size_;
+    gint64 duration_nanosec_;
+    qint64 last_progress_nanosec_;
+
+#ifdef Q_OS_LINUX
+    struct StreamThread {
+      clockid_t clock_;
+      qint64 cpu_at_enter_nanosec_;
+    };
+
+    static qint64 ThreadCpuNanosec(clockid_t clock);
+
+    mutable QMutex threads_mutex_;
+    QList<StreamThread> stream_threads_;
+    qint64 finished_threads_cpu_nanosec_;
+#endif
   };
 
   // Event passed from a GStreamer callback to the Transcoder when a job
@@ -122,6 +197,14 @@ signals:
 
   StartJobStatus MaybeStartNextJob();
   bool StartJob(const Job& job);
+  bool LinkTranscodeElements(JobState* state, GstElement* src,
+                             GstElement* sink);
+  bool LinkRemuxElements(JobState* state, GstElement* src, GstElement* sink);
+
+  JobMode ModeForJob(const Job& job) const;
+  // The bitrate the preset's encoder is set to, or -1 if it's set to a
+  // quality level instead.
+  int TargetBitrate(Song::FileType type) const;
 
   GstElement* CreateElement(const QString& factory_name,
                             GstElement* bin = nullptr,
@@ -132,6 +215,10 @@ signals:
   void SetElementProperties(const QString& name, GObject* element);
 
   static void NewPadCallback(GstElement*, GstPad* pad, gpointer data);
+  static void RemuxPadCallback(GstElement*, GstPad* pad, gpointer data);
+  static GstPadProbeReturn ProgressProbeCallback(GstPad* pad,
+                                                 GstPadProbeInfo* info,
+                                                 gpointer data);
   static GstBusSyncReply BusCallbackSync(GstBus*, GstMessage* msg,
                                          gpointer data);
 
@@ -139,6 +226,7 @@ signals:
   typedef QList<std::shared_ptr<JobState>> JobStateList;
 
   int max_threads_;
+  TranscodeScheduler::Priority priority_;
   QList<Job> queued_jobs_;
   JobStateList current_jobs_;
   QString settings_postfix_;
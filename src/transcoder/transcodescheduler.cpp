@@ -0,0 +1,170 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "transcodescheduler.h"
+
+#include <stdlib.h>
+
+#include <QMetaObject>
+#include <QThread>
+#include <QtGlobal>
+
+#include "core/logging.h"
+#include "core/timeconstants.h"
+
+TranscodeScheduler::TranscodeScheduler()
+    : cores_(qMax(1, QThread::idealThreadCount())), running_count_(0) {
+  for (int i = 0; i <= Priority_Background; ++i) {
+    total_jobs_[i] = 0;
+    total_cpu_nanosec_[i] = 0;
+  }
+}
+
+double TranscodeScheduler::SystemLoad() {
+#ifndef Q_OS_WIN32
+  double load = 0;
+  if (getloadavg(&load, 1) == 1) return load;
+#endif
+  return 0;
+}
+
+int TranscodeScheduler::MaxJobs(Priority priority) const {
+  // Our own running jobs show up in the load average too, so only the rest
+  // of it counts against the number of cores.
+  const double other_load = qMax(0.0, SystemLoad() - running_count_);
+  const int ret = qMax(1, cores_ - qRound(other_load));
+
+  switch (priority) {
+    case Priority_Interactive:
+      // Never make someone wait behind a machine full of bulk conversions.
+      return ret + 1;
+    case Priority_Background:
+      // Leave a core free for everything else.
+      return qMax(1, ret - 1);
+    default:
+      return ret;
+  }
+}
+
+bool TranscodeScheduler::Acquire(QObject* transcoder, Priority priority) {
+  QMutexLocker l(&mutex_);
+
+  const bool woken = woken_.remove(transcoder);
+
+  // Don't jump ahead of anyone more important that's already waiting, or of
+  // anyone at the same priority that asked first.
+  bool blocked = false;
+  for (const Waiter& waiter : waiting_) {
+    if (waiter.transcoder_ == transcoder) continue;
+    if (waiter.priority_ < priority ||
+        (!woken && waiter.priority_ == priority)) {
+      blocked = true;
+      break;
+    }
+  }
+
+  if (blocked || running_count_ >= MaxJobs(priority)) {
+    Enqueue(transcoder, priority, woken);
+    return false;
+  }
+
+  for (int i = 0; i < waiting_.count(); ++i) {
+    if (waiting_[i].transcoder_ == transcoder) {
+      waiting_.removeAt(i);
+      break;
+    }
+  }
+
+  running_count_++;
+  running_[transcoder]++;
+  return true;
+}
+
+void TranscodeScheduler::Release(QObject* transcoder) {
+  QMutexLocker l(&mutex_);
+
+  auto it = running_.find(transcoder);
+  if (it == running_.end()) return;
+
+  running_count_--;
+  if (--it.value() == 0) running_.erase(it);
+
+  WakeWaiting();
+}
+
+void TranscodeScheduler::Remove(QObject* transcoder) {
+  QMutexLocker l(&mutex_);
+
+  running_count_ -= running_.take(transcoder);
+  woken_.remove(transcoder);
+  for (int i = 0; i < waiting_.count(); ++i) {
+    if (waiting_[i].transcoder_ == transcoder) {
+      waiting_.removeAt(i);
+      break;
+    }
+  }
+
+  WakeWaiting();
+}
+
+void TranscodeScheduler::Enqueue(QObject* transcoder, Priority priority,
+                                 bool at_front) {
+  for (const Waiter& waiter : waiting_) {
+    if (waiter.transcoder_ == transcoder) return;
+  }
+
+  // A transcoder that was woken but lost the race keeps its place at the
+  // front of its priority.
+  int i = 0;
+  while (i < waiting_.count() &&
+         (waiting_[i].priority_ < priority ||
+          (!at_front && waiting_[i].priority_ == priority))) {
+    ++i;
+  }
+
+  Waiter waiter;
+  waiter.transcoder_ = transcoder;
+  waiter.priority_ = priority;
+  waiting_.insert(i, waiter);
+}
+
+void TranscodeScheduler::WakeWaiting() {
+  int free = 0;
+  if (!waiting_.isEmpty()) {
+    free = MaxJobs(waiting_.first().priority_) - running_count_;
+  }
+
+  while (free-- > 0 && !waiting_.isEmpty()) {
+    QObject* transcoder = waiting_.takeFirst().transcoder_;
+    woken_.insert(transcoder);
+    QMetaObject::invokeMethod(transcoder, "StartJobs", Qt::QueuedConnection);
+  }
+}
+
+void TranscodeScheduler::RecordJob(Priority priority, qint64 wall_nanosec,
+                                   qint64 cpu_nanosec) {
+  QMutexLocker l(&mutex_);
+
+  total_jobs_[priority]++;
+  total_cpu_nanosec_[priority] += cpu_nanosec;
+
+  qLog(Debug) << "Transcode job took" << wall_nanosec / kNsecPerMsec
+              << "ms," << cpu_nanosec / kNsecPerMsec
+              << "ms of CPU time.  Average for priority" << priority << "is"
+              << total_cpu_nanosec_[priority] / total_jobs_[priority] /
+                     kNsecPerMsec
+              << "ms of CPU time per job";
+}
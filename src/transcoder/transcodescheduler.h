@@ -0,0 +1,84 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRANSCODER_TRANSCODESCHEDULER_H_
+#define TRANSCODER_TRANSCODESCHEDULER_H_
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+
+// Shares the CPU between every Transcoder in the application.  A Transcoder
+// asks for a slot before starting each job and gives it back when the job
+// ends.  When there are no free slots it's queued, and its StartJobs()
+// slot is invoked (in its own thread) once one frees up.  Waiting
+// transcoders are served by priority, and in the order they asked within
+// each priority.
+class TranscodeScheduler {
+ public:
+  enum Priority {
+    // Someone is waiting for the result, like a network remote download.
+    Priority_Interactive = 0,
+    Priority_Normal,
+    // Bulk conversions that can take as long as they like.
+    Priority_Background,
+  };
+
+  static TranscodeScheduler* Instance() {
+    static TranscodeScheduler instance;
+    return &instance;
+  }
+
+  // Returns true if the transcoder may start a job now.
+  bool Acquire(QObject* transcoder, Priority priority);
+  void Release(QObject* transcoder);
+  // Drops the transcoder's queued request and any slots it still holds.
+  void Remove(QObject* transcoder);
+
+  // Called once for each job that ran to completion.
+  void RecordJob(Priority priority, qint64 wall_nanosec, qint64 cpu_nanosec);
+
+ private:
+  TranscodeScheduler();
+
+  struct Waiter {
+    QObject* transcoder_;
+    Priority priority_;
+  };
+
+  // The one minute load average, or 0 where that isn't available.
+  static double SystemLoad();
+
+  // Must be called with mutex_ held.
+  int MaxJobs(Priority priority) const;
+  void Enqueue(QObject* transcoder, Priority priority, bool at_front);
+  void WakeWaiting();
+
+  QMutex mutex_;
+  int cores_;
+  int running_count_;
+  QHash<QObject*, int> running_;
+  QList<Waiter> waiting_;
+  // Waiters that have been told a slot is free but haven't claimed it yet.
+  QSet<QObject*> woken_;
+
+  qint64 total_jobs_[Priority_Background + 1];
+  qint64 total_cpu_nanosec_[Priority_Background + 1];
+};
+
+#endif  // TRANSCODER_TRANSCODESCHEDULER_H_
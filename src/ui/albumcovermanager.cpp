@@ -50,11 +50,14 @@
 #include <QMessageBox>
 #include <QPainter>
 #include <QProgressBar>
+#include <QScrollBar>
 #include <QSettings>
 #include <QShortcut>
 #include <QTimer>
 
 const char* AlbumCoverManager::kSettingsGroup = "CoverManager";
+const int AlbumCoverManager::kMaxLoadedCovers = 500;
+const int AlbumCoverManager::kLoadVisibleCoversDelayMsec = 50;
 
 AlbumCoverManager::AlbumCoverManager(Application* app,
                                      LibraryBackend* library_backend,
@@ -64,6 +67,7 @@ AlbumCoverManager::AlbumCoverManager(Application* app,
       ui_(new Ui_CoverManager),
       app_(app),
       album_cover_choice_controller_(new AlbumCoverChoiceController(this)),
+      load_visible_covers_timer_(new QTimer(this)),
       cover_fetcher_(
           new AlbumCoverFetcher(app_->cover_providers(), this, network)),
       cover_searcher_(nullptr),
@@ -113,6 +117,13 @@ AlbumCoverManager::AlbumCoverManager(Application* app,
   QShortcut* close = new QShortcut(QKeySequence::Close, this);
   connect(close, SIGNAL(activated()), SLOT(close()));
 
+  // Covers are only loaded for the albums that are on screen, so wait for
+  // scrolling and resizing to settle before working out which those are.
+  load_visible_covers_timer_->setSingleShot(true);
+  load_visible_covers_timer_->setInterval(kLoadVisibleCoversDelayMsec);
+  connect(load_visible_covers_timer_, SIGNAL(timeout()),
+          SLOT(LoadVisibleCovers()));
+
   EnableCoversButtons();
 }
 
@@ -173,6 +184,8 @@ void AlbumCoverManager::Init() {
           SIGNAL(currentItemChanged(QListWidgetItem*, QListWidgetItem*)),
           SLOT(ArtistChanged(QListWidgetItem*)));
   connect(ui_->filter, SIGNAL(textChanged(QString)), SLOT(UpdateFilter()));
+  connect(ui_->albums->verticalScrollBar(), SIGNAL(valueChanged(int)),
+          load_visible_covers_timer_, SLOT(start()));
   connect(filter_group, SIGNAL(triggered(QAction*)), SLOT(UpdateFilter()));
   connect(ui_->view, SIGNAL(clicked()), ui_->view, SLOT(showMenu()));
   connect(ui_->fetch, SIGNAL(clicked()), SLOT(FetchAlbumCovers()));
@@ -294,6 +307,7 @@ void AlbumCoverManager::ArtistChanged(QListWidgetItem* current) {
 
   ui_->albums->clear();
   context_menu_items_.clear();
+  loaded_covers_.clear();
   CancelRequests();
 
   // Get the list of albums.  How we do it depends on what thing we have
@@ -340,14 +354,10 @@ void AlbumCoverManager::ArtistChanged(QListWidgetItem* current) {
       item->setToolTip(info.album_name);
     }
 
-    if (!info.art_automatic.isEmpty() || !info.art_manual.isEmpty()) {
-      quint64 id = app_->album_cover_loader()->LoadImageAsync(
-          cover_loader_options_, info.art_automatic, info.art_manual,
-          info.first_url.toLocalFile());
-      item->setData(Role_PathAutomatic, info.art_automatic);
-      item->setData(Role_PathManual, info.art_manual);
-      cover_loading_tasks_[id] = item;
-    }
+    // The cover itself is loaded later by LoadVisibleCovers, once the item
+    // has been laid out and scrolled into view.
+    item->setData(Role_PathAutomatic, info.art_automatic);
+    item->setData(Role_PathManual, info.art_manual);
   }
 
   UpdateFilter();
@@ -361,7 +371,87 @@ void AlbumCoverManager::CoverImageLoaded(quint64 id, const QImage& image) {
   if (image.isNull()) return;
 
   item->setIcon(QPixmap::fromImage(image));
-  UpdateFilter();
+  loaded_covers_.removeOne(item);
+  loaded_covers_.append(item);
+}
+
+void AlbumCoverManager::LoadVisibleCovers() {
+  const QRect viewport_rect = ui_->albums->viewport()->rect();
+
+  // Items are laid out in order, so stop at the first one below the viewport.
+  QList<QListWidgetItem*> visible_items;
+  for (int i = 0; i < ui_->albums->count(); ++i) {
+    QListWidgetItem* item = ui_->albums->item(i);
+    if (item->isHidden()) continue;
+
+    const QRect rect = ui_->albums->visualItemRect(item);
+    if (rect.top() > viewport_rect.bottom()) break;
+    if (rect.intersects(viewport_rect)) visible_items << item;
+  }
+
+  const QSet<QListWidgetItem*> visible =
+      QSet<QListWidgetItem*>::fromList(visible_items);
+
+  // Cancel loads for albums that were scrolled away before they finished.
+  QSet<quint64> cancelled;
+  QSet<QListWidgetItem*> loading;
+  for (auto it = cover_loading_tasks_.begin();
+       it != cover_loading_tasks_.end();) {
+    if (visible.contains(it.value())) {
+      loading.insert(it.value());
+      ++it;
+    } else {
+      cancelled.insert(it.key());
+      it = cover_loading_tasks_.erase(it);
+    }
+  }
+  if (!cancelled.isEmpty()) {
+    app_->album_cover_loader()->CancelTasks(cancelled);
+  }
+
+  for (QListWidgetItem* item : visible_items) {
+    if (loading.contains(item) || !ItemHasCover(*item)) continue;
+
+    if (loaded_covers_.removeOne(item)) {
+      // Already loaded - just mark it as recently seen.
+      loaded_covers_.append(item);
+      continue;
+    }
+
+    quint64 id = app_->album_cover_loader()->LoadImageAsync(
+        cover_loader_options_, item->data(Role_PathAutomatic).toString(),
+        item->data(Role_PathManual).toString(),
+        item->data(Role_FirstUrl).toUrl().toLocalFile());
+    cover_loading_tasks_[id] = item;
+  }
+
+  // Drop the covers that have been out of view the longest.
+  while (loaded_covers_.count() > kMaxLoadedCovers) {
+    QListWidgetItem* item = loaded_covers_.takeFirst();
+    item->setIcon(no_cover_item_icon_);
+  }
+}
+
+void AlbumCoverManager::CancelCoverLoad(QListWidgetItem* item) {
+  QSet<quint64> cancelled;
+  for (auto it = cover_loading_tasks_.begin();
+       it != cover_loading_tasks_.end();) {
+    if (it.value() == item) {
+      cancelled.insert(it.key());
+      it = cover_loading_tasks_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  if (!cancelled.isEmpty()) {
+    app_->album_cover_loader()->CancelTasks(cancelled);
+  }
+}
+
+void AlbumCoverManager::ReloadCover(QListWidgetItem* item) {
+  CancelCoverLoad(item);
+  loaded_covers_.removeOne(item);
+  load_visible_covers_timer_->start();
 }
 
 void AlbumCoverManager::UpdateFilter() {
@@ -394,6 +484,9 @@ void AlbumCoverManager::UpdateFilter() {
 
   ui_->total_albums->setText(QString::number(total_count));
   ui_->without_cover->setText(QString::number(without_cover));
+
+  // Hiding items moves the others around.
+  load_visible_covers_timer_->start();
 }
 
 bool AlbumCoverManager::ShouldHide(const QListWidgetItem& item,
@@ -458,6 +551,7 @@ void AlbumCoverManager::AlbumCoverFetched(
 
   if (cover_fetching_tasks_.isEmpty()) {
     EnableCoversButtons();
+    UpdateFilter();
   }
 
   fetch_statistics_ += statistics;
@@ -494,6 +588,10 @@ void AlbumCoverManager::UpdateStatusText() {
 }
 
 bool AlbumCoverManager::eventFilter(QObject* obj, QEvent* event) {
+  if (obj == ui_->albums && event->type() == QEvent::Resize) {
+    load_visible_covers_timer_->start();
+  }
+
   if (obj == ui_->albums && event->type() == QEvent::ContextMenu) {
     context_menu_items_ = ui_->albums->selectedItems();
     if (context_menu_items_.isEmpty()) return false;
@@ -583,10 +681,9 @@ void AlbumCoverManager::FetchSingleCover() {
 
 void AlbumCoverManager::UpdateCoverInList(QListWidgetItem* item,
                                           const QString& cover) {
-  quint64 id = app_->album_cover_loader()->LoadImageAsync(cover_loader_options_,
-                                                          QString(), cover);
   item->setData(Role_PathManual, cover);
-  cover_loading_tasks_[id] = item;
+  ReloadCover(item);
+  UpdateFilter();
 }
 
 void AlbumCoverManager::LoadCoverFromFile() {
@@ -669,6 +766,8 @@ void AlbumCoverManager::UnsetCover() {
 
   // force the 'none' cover on all of the selected items
   for (QListWidgetItem* current : context_menu_items_) {
+    CancelCoverLoad(current);
+    loaded_covers_.removeOne(current);
     current->setIcon(no_cover_item_icon_);
     current->setData(Role_PathManual, cover);
 
@@ -678,6 +777,8 @@ void AlbumCoverManager::UnsetCover() {
       album_cover_choice_controller_->SaveCover(&current_song, cover);
     }
   }
+
+  UpdateFilter();
 }
 
 SongList AlbumCoverManager::GetSongsInAlbum(const QModelIndex& index) const {
@@ -764,10 +865,8 @@ void AlbumCoverManager::SaveAndSetCover(QListWidgetItem* item,
   library_backend_->UpdateManualAlbumArtAsync(artist, albumartist, album, path);
 
   // Update the icon in our list
-  quint64 id = app_->album_cover_loader()->LoadImageAsync(cover_loader_options_,
-                                                          QString(), path);
   item->setData(Role_PathManual, path);
-  cover_loading_tasks_[id] = item;
+  ReloadCover(item);
 }
 
 void AlbumCoverManager::ExportCovers() {
@@ -859,5 +958,9 @@ QImage AlbumCoverManager::GenerateNoCoverImage(
 }
 
 bool AlbumCoverManager::ItemHasCover(const QListWidgetItem& item) const {
-  return item.icon().cacheKey() != no_cover_item_icon_.cacheKey();
+  // Covers are loaded lazily, so look at the paths rather than the icon.
+  const QString art_manual = item.data(Role_PathManual).toString();
+  if (art_manual == Song::kManuallyUnsetCover) return false;
+  return !art_manual.isEmpty() ||
+         !item.data(Role_PathAutomatic).toString().isEmpty();
 }
@@ -43,6 +43,7 @@ class QMenu;
 class QNetworkAccessManager;
 class QPushButton;
 class QProgressBar;
+class QTimer;
 
 class AlbumCoverManager : public QMainWindow {
   Q_OBJECT
@@ -54,6 +55,12 @@ class AlbumCoverManager : public QMainWindow {
 
   static const char* kSettingsGroup;
 
+  // Only this many album covers are kept loaded at once.  Covers for albums
+  // that have been scrolled far out of view are dropped and loaded again
+  // when they next become visible.
+  static const int kMaxLoadedCovers;
+  static const int kLoadVisibleCoversDelayMsec;
+
   LibraryBackend* backend() const;
   QIcon no_cover_icon() const { return no_cover_icon_; }
 
@@ -86,6 +93,7 @@ signals:
   void AlbumCoverFetched(quint64 id, const QImage& image,
                          const CoverSearchStatistics& statistics);
   void CancelRequests();
+  void LoadVisibleCovers();
 
   // On the context menu
   void FetchSingleCover();
@@ -148,6 +156,11 @@ signals:
                   HideCovers hide) const;
   void SaveAndSetCover(QListWidgetItem* item, const QImage& image);
 
+  // Forgets the loaded cover for this item and schedules it to be loaded
+  // again, if it's visible, using the paths in its Role_Path* data.
+  void ReloadCover(QListWidgetItem* item);
+  void CancelCoverLoad(QListWidgetItem* item);
+
  private:
   Ui_CoverManager* ui_;
   Application* app_;
@@ -160,6 +173,9 @@ signals:
 
   AlbumCoverLoaderOptions cover_loader_options_;
   QMap<quint64, QListWidgetItem*> cover_loading_tasks_;
+  // Items showing a loaded cover, least recently visible first.
+  QList<QListWidgetItem*> loaded_covers_;
+  QTimer* load_visible_covers_timer_;
 
   AlbumCoverFetcher* cover_fetcher_;
   QMap<quint64, QListWidgetItem*> cover_fetching_tasks_;
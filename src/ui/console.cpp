@@ -1,5 +1,6 @@
 #include "console.h"
 
+#include <QFileDialog>
 #include <QFont>
 #include <QScrollBar>
 #include <QSqlDatabase>
@@ -9,18 +10,45 @@
 #include "core/application.h"
 #include "core/database.h"
 #include "core/logging.h"
+#include "core/memoryaccounting.h"
+#include "core/perftrace.h"
+#include "core/player.h"
+#include "core/taskmanager.h"
+#include "engines/gstengine.h"
 
 Console::Console(Application* app, QWidget* parent)
     : QDialog(parent), app_(app) {
   ui_.setupUi(this);
   connect(ui_.database_run, SIGNAL(clicked()), SLOT(RunQuery()));
   connect(ui_.qt_dump_button, SIGNAL(clicked()), SLOT(Dump()));
+  connect(ui_.engine_refresh, SIGNAL(clicked()), SLOT(RefreshEngineMetrics()));
+  connect(ui_.tasks_refresh, SIGNAL(clicked()), SLOT(RefreshTasks()));
+  connect(ui_.memory_refresh, SIGNAL(clicked()), SLOT(RefreshMemory()));
+  connect(ui_.profile_refresh, SIGNAL(clicked()), SLOT(RefreshProfile()));
+  connect(ui_.profile_record, SIGNAL(toggled(bool)),
+          SLOT(SetProfiling(bool)));
+  connect(ui_.profile_reset, SIGNAL(clicked()), SLOT(ResetProfile()));
+  connect(ui_.profile_export, SIGNAL(clicked()), SLOT(ExportProfile()));
 
   QFont font("Monospace");
   font.setStyleHint(QFont::TypeWriter);
 
   ui_.database_output->setFont(font);
   ui_.database_query->setFont(font);
+  ui_.engine_output->setFont(font);
+  ui_.tasks_output->setFont(font);
+  ui_.memory_output->setFont(font);
+  ui_.profile_output->setFont(font);
+
+  for (const QString& line : app_->database()->TuningStatus()) {
+    ui_.database_output->append(line);
+  }
+
+  RefreshEngineMetrics();
+  RefreshTasks();
+  RefreshMemory();
+  ui_.profile_record->setChecked(PerfTrace::IsEnabled());
+  RefreshProfile();
 
   QList<QObject*> objs = GetTopLevelObjects();
   for (QObject* obj : objs)
@@ -53,6 +81,91 @@ void Console::RunQuery() {
       ui_.database_output->verticalScrollBar()->maximum());
 }
 
+void Console::RefreshEngineMetrics() {
+  ui_.engine_output->clear();
+
+  GstEngine* engine = qobject_cast<GstEngine*>(app_->player()->engine());
+  if (!engine) return;
+
+  const EngineMetrics metrics = engine->current_metrics();
+  if (metrics.pipeline_id_ == -1) {
+    ui_.engine_output->append(tr("Nothing is playing"));
+    return;
+  }
+
+  for (const QString& line : metrics.ToStrings()) {
+    ui_.engine_output->append(line);
+  }
+}
+
+void Console::RefreshTasks() {
+  ui_.tasks_output->clear();
+
+  TaskManager* task_manager = app_->task_manager();
+  for (const TaskManager::Task& task : task_manager->GetTasks()) {
+    ui_.tasks_output->append(
+        tr("Running: %1 (%2 of %3, since %4)%5")
+            .arg(task.name, QString::number(task.progress),
+                 QString::number(task.progress_max),
+                 task.started.toString("hh:mm:ss"),
+                 task.stalled ? tr(" - stalled") : QString()));
+  }
+
+  for (const TaskManager::TaskStats& stats : task_manager->GetHistory()) {
+    ui_.tasks_output->append(stats.ToString());
+  }
+}
+
+void Console::RefreshMemory() {
+  ui_.memory_output->clear();
+  for (const QString& line : MemoryAccounting::Instance()->ReportLines()) {
+    ui_.memory_output->append(line);
+  }
+}
+
+void Console::RefreshProfile() {
+  ui_.profile_output->clear();
+
+  const QList<PerfTrace::Stats> stats = PerfTrace::GetStats();
+  if (stats.isEmpty()) {
+    ui_.profile_output->append(
+        tr("Nothing recorded yet.  Tick Record, use Clementine for a while "
+           "and press Refresh."));
+    return;
+  }
+
+  ui_.profile_output->append(QString("%1 %2 %3 %4 %5")
+                                 .arg("Scope", -32)
+                                 .arg("Calls", 9)
+                                 .arg("Mean us", 10)
+                                 .arg("p99 us", 10)
+                                 .arg("Max us", 10));
+  for (const PerfTrace::Stats& scope : stats) {
+    ui_.profile_output->append(QString("%1 %2 %3 %4 %5")
+                                   .arg(scope.name_, -32)
+                                   .arg(scope.count_, 9)
+                                   .arg(scope.mean_nsec_ / 1000, 10)
+                                   .arg(scope.p99_nsec_ / 1000, 10)
+                                   .arg(scope.max_nsec_ / 1000, 10));
+  }
+}
+
+void Console::SetProfiling(bool enabled) { PerfTrace::SetEnabled(enabled); }
+
+void Console::ResetProfile() {
+  PerfTrace::Reset();
+  RefreshProfile();
+}
+
+void Console::ExportProfile() {
+  const QString filename = QFileDialog::getSaveFileName(
+      this, tr("Export trace"), "clementine-trace.json",
+      tr("Chrome trace (*.json)"));
+  if (filename.isEmpty()) return;
+
+  PerfTrace::WriteChromeTrace(filename);
+}
+
 void Console::Dump() {
   QString item = ui_.qt_dump_box->currentData().toString();
   QObject* obj = FindTopLevelObject(item);
@@ -15,6 +15,17 @@ class Console : public QDialog {
  private slots:
   // Database
   void RunQuery();
+  // Engine
+  void RefreshEngineMetrics();
+  // Tasks
+  void RefreshTasks();
+  // Memory
+  void RefreshMemory();
+  // Profile
+  void RefreshProfile();
+  void SetProfiling(bool enabled);
+  void ResetProfile();
+  void ExportProfile();
   // Qt
   void Dump();
 
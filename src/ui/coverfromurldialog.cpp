@@ -30,7 +30,7 @@
 CoverFromURLDialog::CoverFromURLDialog(QWidget* parent)
     : QDialog(parent),
       ui_(new Ui_CoverFromURLDialog),
-      network_(new NetworkAccessManager(this)) {
+      network_(NetworkAccessManager::Shared()) {
   ui_->setupUi(this);
   ui_->busy->hide();
 }
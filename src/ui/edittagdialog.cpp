@@ -22,18 +22,20 @@
 
 #include <QDateTime>
 #include <QDir>
+#include <QFileInfo>
 #include <QFuture>
+#include <QHash>
 #include <QLabel>
 #include <QMenu>
 #include <QMessageBox>
 #include <QPushButton>
 #include <QShortcut>
-#include <QtConcurrentRun>
 #include <QtDebug>
 
 #include "core/application.h"
 #include "core/logging.h"
 #include "core/tagreaderclient.h"
+#include "core/taskexecutor.h"
 #include "core/utilities.h"
 #include "covers/albumcoverloader.h"
 #include "covers/coverproviders.h"
@@ -57,7 +59,7 @@ EditTagDialog::EditTagDialog(Application* app, QWidget* parent)
       album_cover_choice_controller_(new AlbumCoverChoiceController(this)),
       loading_(false),
       ignore_edits_(false),
-      tag_fetcher_(new TagFetcher(this)),
+      tag_fetcher_(new TagFetcher(app, this)),
       cover_art_id_(0),
       cover_art_is_set_(false),
       results_dialog_(new TrackSelectionDialog(this)) {
@@ -255,8 +257,9 @@ void EditTagDialog::SetSongs(const SongList& s, const PlaylistItemList& items) {
   ui_->song_list->clear();
 
   // Reload tags in the background
-  QFuture<QList<Data>> future =
-      QtConcurrent::run(this, &EditTagDialog::LoadData, s);
+  QFuture<QList<Data>> future = TaskExecutor::Instance()->Run<QList<Data>>(
+      TaskExecutor::Lane_Interactive,
+      std::bind(&EditTagDialog::LoadData, this, s));
   NewClosure(future, this,
              SLOT(SetSongsFinished(QFuture<QList<EditTagDialog::Data>>)),
              future);
@@ -693,15 +696,50 @@ void EditTagDialog::ButtonClicked(QAbstractButton* button) {
 }
 
 void EditTagDialog::SaveData(const QList<Data>& data) {
-  for (int i = 0; i < data.count(); ++i) {
-    const Data& ref = data[i];
+  QStringList filenames;
+  SongList songs;
+  for (const Data& ref : data) {
     if (ref.current_.IsMetadataEqual(ref.original_)) continue;
 
-    if (!TagReaderClient::Instance()->SaveFileBlocking(
-            ref.current_.url().toLocalFile(), ref.current_)) {
+    filenames << ref.current_.url().toLocalFile();
+    songs << ref.current_;
+  }
+  if (songs.isEmpty()) return;
+
+  const QList<bool> saved =
+      TagReaderClient::Instance()->SaveFilesBlocking(filenames, songs);
+
+  // Update the library ourselves, with the files' new modification times so
+  // the watcher doesn't read each of them again when it notices they changed.
+  // Songs from devices have ids too, so make sure the ids are really ours.
+  QList<int> ids;
+  for (const Song& song : songs) {
+    if (song.is_library_song()) ids << song.id();
+  }
+  QHash<int, QUrl> library_urls;
+  for (const Song& song : app_->library_backend()->GetSongsById(ids)) {
+    library_urls[song.id()] = song.url();
+  }
+
+  SongList library_songs;
+  for (int i = 0; i < songs.count(); ++i) {
+    if (!saved[i]) {
       emit Error(tr("An error occurred writing metadata to '%1'")
-                     .arg(ref.current_.url().toLocalFile()));
+                     .arg(filenames[i]));
+      continue;
     }
+
+    if (library_urls.value(songs[i].id()) == songs[i].url()) {
+      Song song = songs[i];
+      const QFileInfo info(filenames[i]);
+      song.set_mtime(info.lastModified().toTime_t());
+      song.set_filesize(info.size());
+      library_songs << song;
+    }
+  }
+
+  if (!library_songs.isEmpty()) {
+    app_->library_backend()->AddOrUpdateSongs(library_songs);
   }
 }
 
@@ -710,8 +748,9 @@ void EditTagDialog::accept() {
   if (!SetLoading(tr("Saving tracks") + "...")) return;
 
   // Save tags in the background
-  QFuture<void> future =
-      QtConcurrent::run(this, &EditTagDialog::SaveData, data_);
+  QFuture<void> future = TaskExecutor::Instance()->Run<void>(
+      TaskExecutor::Lane_Interactive,
+      std::bind(&EditTagDialog::SaveData, this, data_));
   NewClosure(future, this, SLOT(AcceptFinished()));
 }
 
@@ -138,7 +138,7 @@ signals:
   bool SetLoading(const QString& message);
   void SetSongListVisibility(bool visible);
 
-  // Called by QtConcurrentRun
+  // Run by TaskExecutor
   QList<Data> LoadData(const SongList& songs) const;
   void SaveData(const QList<Data>& data);
 
@@ -23,8 +23,78 @@
 
 #include <QtDebug>
 #include <QDir>
+#include <QIconEngine>
+#include <QPainter>
 #include <QSettings>
 
+namespace {
+
+// Stands in for an icon until something needs to know what it looks like.
+class LazyIconEngine : public QIconEngine {
+ public:
+  LazyIconEngine(const QString& name, IconLoader::IconType icontype)
+      : name_(name), icontype_(icontype), loaded_(false) {}
+
+  void paint(QPainter* painter, const QRect& rect, QIcon::Mode mode,
+             QIcon::State state) {
+    Icon().paint(painter, rect, Qt::AlignCenter, mode, state);
+  }
+
+  QSize actualSize(const QSize& size, QIcon::Mode mode, QIcon::State state) {
+    return Icon().actualSize(size, mode, state);
+  }
+
+  QPixmap pixmap(const QSize& size, QIcon::Mode mode, QIcon::State state) {
+    return Icon().pixmap(size, mode, state);
+  }
+
+  void addPixmap(const QPixmap& pixmap, QIcon::Mode mode, QIcon::State state) {
+    Icon().addPixmap(pixmap, mode, state);
+  }
+
+  void addFile(const QString& filename, const QSize& size, QIcon::Mode mode,
+               QIcon::State state) {
+    Icon().addFile(filename, size, mode, state);
+  }
+
+  QString key() const { return "IconLoader"; }
+
+  QIconEngine* clone() const { return new LazyIconEngine(*this); }
+
+  QList<QSize> availableSizes(QIcon::Mode mode, QIcon::State state) const {
+    return Icon().availableSizes(mode, state);
+  }
+
+  QString iconName() const { return name_; }
+
+  void virtual_hook(int id, void* data) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
+    if (id == QIconEngine::IsNullHook) {
+      *reinterpret_cast<bool*>(data) = Icon().isNull();
+      return;
+    }
+#endif
+    QIconEngine::virtual_hook(id, data);
+  }
+
+ private:
+  QIcon& Icon() const {
+    if (!loaded_) {
+      icon_ = IconLoader::LoadNow(name_, icontype_);
+      loaded_ = true;
+    }
+    return icon_;
+  }
+
+  QString name_;
+  IconLoader::IconType icontype_;
+  mutable bool loaded_;
+  mutable QIcon icon_;
+};
+
+}  // namespace
+
+QHash<QString, QIcon> IconLoader::cache_;
 QList<int> IconLoader::sizes_;
 QString IconLoader::custom_icon_path_;
 QList<QString> IconLoader::icon_sub_path_;
@@ -39,9 +109,29 @@ void IconLoader::Init() {
   QSettings settings;
   settings.beginGroup(Appearance::kSettingsGroup);
   use_sys_icons_ = settings.value("b_use_sys_icons", false).toBool();
+  cache_.clear();
 }
 
 QIcon IconLoader::Load(const QString& name, const IconType& icontype) {
+  // Callers find out whether an icon exists with isNull(), which older Qts
+  // don't ask the engine about.
+#if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
+  if (!name.isEmpty()) return QIcon(new LazyIconEngine(name, icontype));
+#endif
+  return LoadNow(name, icontype);
+}
+
+QIcon IconLoader::LoadNow(const QString& name, const IconType& icontype) {
+  const QString key = QString::number(icontype) + "/" + name;
+  QHash<QString, QIcon>::const_iterator it = cache_.constFind(key);
+  if (it != cache_.constEnd()) return it.value();
+
+  const QIcon ret = Find(name, icontype);
+  cache_.insert(key, ret);
+  return ret;
+}
+
+QIcon IconLoader::Find(const QString& name, const IconType& icontype) {
   QIcon ret;
   // If the icon name is empty
   if (name.isEmpty()) {
@@ -19,6 +19,7 @@
 #ifndef ICONLOADER_H
 #define ICONLOADER_H
 
+#include <QHash>
 #include <QIcon>
 
 class IconLoader {
@@ -31,11 +32,21 @@ class IconLoader {
   };
 
   static void Init();
+  // The icon isn't looked for until it's first painted or asked about, since
+  // most of the icons made at startup are in menus and settings pages that
+  // might never be shown.
   static QIcon Load(const QString& name, const IconType& icontype);
+  // Looks for the icon straight away.  Icons are only looked for once.
+  static QIcon LoadNow(const QString& name, const IconType& icontype);
 
  private:
   IconLoader() {}
 
+  static QIcon Find(const QString& name, const IconType& icontype);
+
+  // Icons that have been looked for, by type and name.  Cleared by Init().
+  static QHash<QString, QIcon> cache_;
+
   static QList<int> sizes_;
   static QString custom_icon_path_;
   static QList<QString> icon_sub_path_;
@@ -54,6 +54,7 @@
 #include "core/network.h"
 #include "core/player.h"
 #include "core/songloader.h"
+#include "core/startuptrace.h"
 #include "core/stylesheetloader.h"
 #include "core/taskmanager.h"
 #include "core/timeconstants.h"
@@ -64,6 +65,7 @@
 #include "devices/deviceviewcontainer.h"
 #include "engines/enginebase.h"
 #include "engines/gstengine.h"
+#include "engines/positionclock.h"
 #include "globalsearch/globalsearch.h"
 #include "globalsearch/globalsearchview.h"
 #include "globalsearch/librarysearchprovider.h"
@@ -142,6 +144,7 @@
 
 #ifdef HAVE_MOODBAR
 #include "moodbar/moodbarcontroller.h"
+#include "moodbar/moodbarloader.h"
 #include "moodbar/moodbarproxystyle.h"
 #endif
 
@@ -218,8 +221,6 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
       playlist_add_to_another_(nullptr),
       playlistitem_actions_separator_(nullptr),
       library_sort_model_(new QSortFilterProxyModel(this)),
-      track_position_timer_(new QTimer(this)),
-      track_slider_timer_(new QTimer(this)),
       initialized_(false),
       dirty_geometry_(false),
       dirty_playback_(false),
@@ -297,12 +298,10 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
   // Do this only after all default tabs have been added
   ui_->tabs->loadSettings(settings_);
 
-  track_position_timer_->setInterval(kTrackPositionUpdateTimeMs);
-  connect(track_position_timer_, SIGNAL(timeout()),
-          SLOT(UpdateTrackPosition()));
-  track_slider_timer_->setInterval(kTrackSliderUpdateTimeMs);
-  connect(track_slider_timer_, SIGNAL(timeout()),
-          SLOT(UpdateTrackSliderPosition()));
+  // The clock only wakes us up while something's playing.  The track slider
+  // subscribes while the window is visible.
+  app_->player()->engine()->position_clock()->Subscribe(
+      this, "UpdateTrackPosition", kTrackPositionUpdateTimeMs);
 
   connect(app_, SIGNAL(SaveSettings(QSettings*)),
           SLOT(SaveSettings(QSettings*)));
@@ -310,6 +309,7 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
   // Start initialising the player
   qLog(Debug) << "Initialising player";
   app_->player()->Init();
+  if (!options.contains_play_options()) PrerollPlayback();
   background_streams_ = new BackgroundStreams(app_->player()->engine(), this);
   background_streams_->LoadStreams();
 
@@ -327,8 +327,6 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
 
   library_view_->view()->setModel(library_sort_model_);
   library_view_->view()->SetApplication(app_);
-  internet_view_->SetApplication(app_);
-  device_view_->SetApplication(app_);
   playlist_list_->SetApplication(app_);
 
   // Icons
@@ -480,6 +478,10 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
           SLOT(IncrementalScan()));
   connect(ui_->action_full_library_scan, SIGNAL(triggered()), app_->library(),
           SLOT(FullScan()));
+#ifndef HAVE_MOODBAR
+  ui_->action_generate_moodbars->setVisible(false);
+  ui_->action_pause_moodbars->setVisible(false);
+#endif
   connect(ui_->action_queue_manager, SIGNAL(triggered()),
           SLOT(ShowQueueManager()));
   connect(ui_->action_add_files_to_transcoder, SIGNAL(triggered()),
@@ -753,12 +755,6 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
   connect(ui_->playlist, SIGNAL(UndoRedoActionsChanged(QAction*, QAction*)),
           SLOT(PlaylistUndoRedoChanged(QAction*, QAction*)));
 
-  playlist_copy_to_device_->setDisabled(
-      app_->device_manager()->connected_devices_model()->rowCount() == 0);
-  connect(app_->device_manager()->connected_devices_model(),
-          SIGNAL(IsEmptyChanged(bool)), playlist_copy_to_device_,
-          SLOT(setDisabled(bool)));
-
   // Global search shortcut
   QAction* global_search_action = new QAction(this);
   global_search_action->setShortcuts(QList<QKeySequence>()
@@ -769,14 +765,6 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
           SLOT(FocusGlobalSearchField()));
 
   // Internet connections
-  connect(app_->internet_model(), SIGNAL(StreamError(QString)),
-          SLOT(ShowErrorDialog(QString)));
-  connect(app_->internet_model(), SIGNAL(StreamMetadataFound(QUrl, Song)),
-          app_->playlist_manager(), SLOT(SetActiveStreamMetadata(QUrl, Song)));
-  connect(app_->internet_model(), SIGNAL(AddToPlaylist(QMimeData*)),
-          SLOT(AddToPlaylist(QMimeData*)));
-  connect(app_->internet_model(), SIGNAL(ScrollToIndex(QModelIndex)),
-          SLOT(ScrollToInternetIndex(QModelIndex)));
 #ifdef HAVE_LIBLASTFM
   connect(app_->scrobbler(), SIGNAL(ButtonVisibilityChanged(bool)),
           SLOT(LastFMButtonVisibilityChanged(bool)));
@@ -787,16 +775,9 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
   connect(app_->scrobbler(), SIGNAL(ScrobbledRadioStream()),
           SLOT(ScrobbledRadioStream()));
 #endif
-  connect(app_->internet_model()->Service<MagnatuneService>(),
-          SIGNAL(DownloadFinished(QStringList)), osd_,
-          SLOT(MagnatuneDownloadFinished(QStringList)));
   connect(internet_view_->tree(), SIGNAL(AddToPlaylistSignal(QMimeData*)),
           SLOT(AddToPlaylist(QMimeData*)));
 
-  // Connections to the saved streams service
-  connect(InternetModel::Service<SavedRadio>(), SIGNAL(ShowAddStreamDialog()),
-          SLOT(AddStream()));
-
 #ifdef Q_OS_DARWIN
   mac::SetApplicationHandler(this);
 #endif
@@ -902,12 +883,6 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
           SLOT(TaskCountChanged(int)));
 
   ui_->track_slider->SetApplication(app);
-#ifdef HAVE_MOODBAR
-  // Moodbar connections
-  connect(app_->moodbar_controller(),
-          SIGNAL(CurrentMoodbarDataChanged(QByteArray)),
-          ui_->track_slider->moodbar_style(), SLOT(SetMoodbarData(QByteArray)));
-#endif
 
   // Now playing widget
   qLog(Debug) << "Creating now playing widget";
@@ -920,8 +895,8 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
           SLOT(AllHail(bool)));
   connect(ui_->action_kittens, SIGNAL(toggled(bool)), ui_->now_playing,
           SLOT(EnableKittens(bool)));
-  connect(ui_->action_kittens, SIGNAL(toggled(bool)), app_->network_remote(),
-          SLOT(EnableKittens(bool)));
+  connect(ui_->action_kittens, SIGNAL(toggled(bool)),
+          app_->network_remote_helper(), SLOT(EnableKittens(bool)));
   QString showConsole =
       QProcessEnvironment::systemEnvironment().value(kShowDebugConsoleKey, "0");
   if (showConsole == "1")
@@ -1004,11 +979,6 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
 
   ReloadSettings();
 
-  // The "GlobalSearchView" requires that "InternetModel" has already been
-  // initialised before reload settings.
-  app_->global_search()->ReloadSettings();
-  global_search_view_->ReloadSettings();
-
   // Reload pretty OSD to avoid issues with fonts
   osd_->ReloadPrettyOSDSettings();
 
@@ -1058,15 +1028,74 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
 
   CheckFullRescanRevisions();
 
-  CommandlineOptionsReceived(options);
+  // The internet services, devices and moodbars aren't needed to draw the
+  // window, so they're set up once the event loop is running.  Anything that
+  // asks for them before then still gets them from Application.
+  QTimer::singleShot(0, this, [this, options]() {
+    InitDeferredSubsystems();
 
-  if (!options.contains_play_options()) LoadPlaybackStatus();
+    CommandlineOptionsReceived(options);
+    if (!options.contains_play_options()) LoadPlaybackStatus();
+  });
 
   initialized_ = true;
 
+  StartupTrace::Mark("Main window created");
   qLog(Debug) << "Started";
 }
 
+void MainWindow::InitDeferredSubsystems() {
+  StartupTrace::Scope trace("Deferred subsystems");
+
+  // Internet connections
+  internet_view_->SetApplication(app_);
+  connect(app_->internet_model(), SIGNAL(StreamError(QString)),
+          SLOT(ShowErrorDialog(QString)));
+  connect(app_->internet_model(), SIGNAL(StreamMetadataFound(QUrl, Song)),
+          app_->playlist_manager(), SLOT(SetActiveStreamMetadata(QUrl, Song)));
+  connect(app_->internet_model(), SIGNAL(AddToPlaylist(QMimeData*)),
+          SLOT(AddToPlaylist(QMimeData*)));
+  connect(app_->internet_model(), SIGNAL(ScrollToIndex(QModelIndex)),
+          SLOT(ScrollToInternetIndex(QModelIndex)));
+  connect(app_->internet_model()->Service<MagnatuneService>(),
+          SIGNAL(DownloadFinished(QStringList)), osd_,
+          SLOT(MagnatuneDownloadFinished(QStringList)));
+
+  // Connections to the saved streams service
+  connect(InternetModel::Service<SavedRadio>(), SIGNAL(ShowAddStreamDialog()),
+          SLOT(AddStream()));
+
+  // The "GlobalSearchView" requires that "InternetModel" has already been
+  // initialised before reload settings.
+  app_->global_search()->ReloadSettings();
+  global_search_view_->ReloadSettings();
+
+  // Devices
+  device_view_->SetApplication(app_);
+  playlist_copy_to_device_->setDisabled(
+      app_->device_manager()->connected_devices_model()->rowCount() == 0);
+  connect(app_->device_manager()->connected_devices_model(),
+          SIGNAL(IsEmptyChanged(bool)), playlist_copy_to_device_,
+          SLOT(setDisabled(bool)));
+
+#ifdef HAVE_MOODBAR
+  // Moodbar connections
+  connect(app_->moodbar_controller(),
+          SIGNAL(CurrentMoodbarDataChanged(QByteArray)),
+          ui_->track_slider->moodbar_style(), SLOT(SetMoodbarData(QByteArray)));
+  connect(ui_->action_generate_moodbars, SIGNAL(triggered()),
+          app_->moodbar_loader(), SLOT(StartLibraryBatch()));
+  connect(ui_->action_pause_moodbars, SIGNAL(toggled(bool)),
+          app_->moodbar_loader(), SLOT(SetLibraryBatchPaused(bool)));
+  connect(app_->moodbar_loader(), &MoodbarLoader::LibraryBatchRunningChanged,
+          this, [this](bool running) {
+            ui_->action_generate_moodbars->setEnabled(!running);
+            ui_->action_pause_moodbars->setEnabled(running);
+            if (!running) ui_->action_pause_moodbars->setChecked(false);
+          });
+#endif
+}
+
 MainWindow::~MainWindow() {
   delete ui_;
 }
@@ -1132,8 +1161,6 @@ void MainWindow::MediaStopped() {
   ui_->action_love->setEnabled(false);
   if (tray_icon_) tray_icon_->LastFMButtonLoveStateChanged(false);
 
-  track_position_timer_->stop();
-  track_slider_timer_->stop();
   ui_->track_slider->SetStopped();
   if (tray_icon_) {
     tray_icon_->SetProgress(0);
@@ -1150,9 +1177,6 @@ void MainWindow::MediaPaused() {
 
   ui_->action_play_pause->setEnabled(true);
 
-  track_position_timer_->stop();
-  track_slider_timer_->stop();
-
   if (tray_icon_) tray_icon_->SetPaused();
 }
 
@@ -1200,10 +1224,6 @@ void MainWindow::MediaPlaying() {
 #else
   if (tray_icon_) tray_icon_->SetPlaying(enable_play_pause);
 #endif
-
-  track_position_timer_->start();
-  track_slider_timer_->start();
-  UpdateTrackPosition();
 }
 
 void MainWindow::VolumeChanged(int volume) {
@@ -1215,6 +1235,15 @@ void MainWindow::SongChanged(const Song& song) {
   setWindowTitle(song.PrettyTitleWithArtist());
   if (tray_icon_) tray_icon_->SetProgress(0);
 
+  // Get the info panes ready for the next track while this one plays.
+  Playlist* playlist = app_->playlist_manager()->active();
+  const int next_row = playlist->next_row();
+  if (next_row != -1 && playlist->has_item_at(next_row)) {
+    const Song next_song = playlist->item_at(next_row)->Metadata();
+    song_info_view_->PrefetchSong(next_song);
+    artist_info_view_->PrefetchSong(next_song);
+  }
+
 #ifdef HAVE_LIBLASTFM
   if (ui_->action_toggle_scrobbling->isVisible())
     SetToggleScrobblingIcon(app_->scrobbler()->IsScrobblingEnabled());
@@ -1309,6 +1338,18 @@ void MainWindow::resizeEvent(QResizeEvent*) {
   app_->DirtySettings();
 }
 
+void MainWindow::showEvent(QShowEvent* event) {
+  QMainWindow::showEvent(event);
+  app_->player()->engine()->position_clock()->Subscribe(
+      this, "UpdateTrackSliderPosition", kTrackSliderUpdateTimeMs);
+}
+
+void MainWindow::hideEvent(QHideEvent* event) {
+  QMainWindow::hideEvent(event);
+  app_->player()->engine()->position_clock()->Unsubscribe(
+      this, "UpdateTrackSliderPosition");
+}
+
 void MainWindow::SaveGeometry(QSettings* settings) {
   if (!initialized_) return;
   dirty_geometry_ = false;
@@ -1338,6 +1379,41 @@ void MainWindow::SavePlaybackStatus(QSettings* settings) {
   } else {
     settings->setValue("playback_position", 0);
   }
+
+  // What PrerollPlayback needs to build the pipeline before the playlists
+  // are loaded.
+  PlaylistItemPtr item = app_->player()->GetCurrentItem();
+  if (item) {
+    const Song& song = item->Metadata();
+    settings->setValue("playback_url", item->Url());
+    settings->setValue("playback_beginning_nanosec", song.beginning_nanosec());
+    settings->setValue("playback_end_nanosec",
+                       song.has_cue() ? song.end_nanosec() : 0);
+  } else {
+    settings->remove("playback_url");
+  }
+}
+
+void MainWindow::PrerollPlayback() {
+  if (!settings_.value("resume_playback_after_start", false).toBool()) return;
+
+  const Engine::State state = static_cast<Engine::State>(
+      settings_.value("playback_state", Engine::Empty).toInt());
+  if (state != Engine::Playing && state != Engine::Paused) return;
+
+  // Other urls are resolved by their url handler when they're played.
+  const QUrl url = settings_.value("playback_url").toUrl();
+  if (!url.isLocalFile()) return;
+
+  GstEngine* engine = qobject_cast<GstEngine*>(app_->player()->engine());
+  if (!engine) return;
+
+  const qint64 offset_nanosec =
+      settings_.value("playback_beginning_nanosec", 0).toLongLong() +
+      settings_.value("playback_position", 0).toLongLong() * kNsecPerSec;
+  engine->Preroll(MediaPlaybackRequest(url),
+                  settings_.value("playback_end_nanosec", 0).toLongLong(),
+                  offset_nanosec);
 }
 
 void MainWindow::LoadPlaybackStatus() {
@@ -1368,18 +1444,23 @@ void MainWindow::ResumePlayback() {
 
   app_->player()->Play();
 
-  connect(track_position_timer_, SIGNAL(timeout()),
-          SLOT(ResumePlaybackPosition()));
+  app_->player()->engine()->position_clock()->Subscribe(
+      this, "ResumePlaybackPosition", kTrackPositionUpdateTimeMs);
 }
 
-void MainWindow::ResumePlaybackPosition() {
+void MainWindow::ResumePlaybackPosition(qint64) {
   // We must wait until the song has a length because
   // seeking a song without length does not work
   if (app_->player()->engine()->length_nanosec() > 0) {
-    disconnect(track_position_timer_, SIGNAL(timeout()), this,
-               SLOT(ResumePlaybackPosition()));
-
-    app_->player()->SeekTo(saved_playback_position_);
+    app_->player()->engine()->position_clock()->Unsubscribe(
+        this, "ResumePlaybackPosition");
+
+    // A prerolled pipeline starts in the right place already.
+    const int position =
+        app_->player()->engine()->position_nanosec() / kNsecPerSec;
+    if (qAbs(position - saved_playback_position_) > 1) {
+      app_->player()->SeekTo(saved_playback_position_);
+    }
   }
 }
 
@@ -1511,13 +1592,14 @@ void MainWindow::Seeked(qlonglong microseconds) {
 /**
  * Update track position, tray icon, playcount
  */
-void MainWindow::UpdateTrackPosition() {
+void MainWindow::UpdateTrackPosition(qint64 position_nanosec) {
   // Track position in seconds
   Playlist* playlist = app_->playlist_manager()->active();
 
   PlaylistItemPtr item(app_->player()->GetCurrentItem());
-  const int position = std::floor(
-      float(app_->player()->engine()->position_nanosec()) / kNsecPerSec + 0.5);
+  if (!item) return;
+
+  const int position = std::floor(float(position_nanosec) / kNsecPerSec + 0.5);
   const int length = app_->player()->engine()->length_nanosec() / kNsecPerSec;
   const int scrobble_point = playlist->scrobble_point_nanosec() / kNsecPerSec;
   const int play_count_point =
@@ -1586,11 +1668,8 @@ void MainWindow::UpdateTrackPosition() {
   }
 }
 
-void MainWindow::UpdateTrackSliderPosition() {
-  PlaylistItemPtr item(app_->player()->GetCurrentItem());
-
-  const int slider_position = std::floor(
-      float(app_->player()->engine()->position_nanosec()) / kNsecPerMsec);
+void MainWindow::UpdateTrackSliderPosition(qint64 position_nanosec) {
+  const int slider_position = std::floor(float(position_nanosec) / kNsecPerMsec);
   const int slider_length =
       app_->player()->engine()->length_nanosec() / kNsecPerMsec;
 
@@ -2877,7 +2956,7 @@ void MainWindow::Exit() {
 void MainWindow::AutoCompleteTags() {
   // Create the tag fetching stuff if it hasn't been already
   if (!tag_fetcher_) {
-    tag_fetcher_.reset(new TagFetcher);
+    tag_fetcher_.reset(new TagFetcher(app_));
     track_selection_dialog_.reset(new TrackSelectionDialog);
     track_selection_dialog_->set_save_on_close(true);
 
@@ -135,6 +135,8 @@ class MainWindow : public QMainWindow, public PlatformInterface {
   void keyPressEvent(QKeyEvent* event);
   void changeEvent(QEvent*);
   void resizeEvent(QResizeEvent*);
+  void showEvent(QShowEvent* event);
+  void hideEvent(QHideEvent* event);
   void closeEvent(QCloseEvent* event);
 
 #ifdef Q_OS_WIN32
@@ -214,8 +216,8 @@ signals:
   void ToggleShowHide();
 
   void Seeked(qlonglong microseconds);
-  void UpdateTrackPosition();
-  void UpdateTrackSliderPosition();
+  void UpdateTrackPosition(qint64 position_nanosec);
+  void UpdateTrackSliderPosition(qint64 position_nanosec);
 
   // Handle visibility of LastFM icons
   void LastFMButtonVisibilityChanged(bool value);
@@ -274,8 +276,14 @@ signals:
   void SaveGeometry(QSettings* settings);
   void SavePlaybackStatus(QSettings* settings);
   void LoadPlaybackStatus();
+  // Starts building the pipeline for the track LoadPlaybackStatus will
+  // resume, while the rest of the window is set up.
+  void PrerollPlayback();
+  // Sets up the parts of the window that depend on subsystems that are slow
+  // to create.  Called once the event loop has started.
+  void InitDeferredSubsystems();
   void ResumePlayback();
-  void ResumePlaybackPosition();
+  void ResumePlaybackPosition(qint64);
 
   void AddSongInfoGenerator(smart_playlists::GeneratorPtr gen);
 
@@ -382,8 +390,6 @@ signals:
 
   QSortFilterProxyModel* library_sort_model_;
 
-  QTimer* track_position_timer_;
-  QTimer* track_slider_timer_;
   QSettings settings_;
 
   bool initialized_;
@@ -28,6 +28,7 @@
 #include <QUrl>
 
 #include "core/application.h"
+#include "networkremote/metricsserver.h"
 #include "networkremote/networkremote.h"
 #include "networkremote/networkremotehelper.h"
 #include "transcoder/transcoder.h"
@@ -93,6 +94,10 @@ void NetworkRemoteSettingsPage::Load() {
   ui_->convert_lossless->setChecked(
       s.value("convert_lossless", false).toBool());
 
+  ui_->use_metrics->setChecked(s.value("use_metrics", false).toBool());
+  ui_->metrics_port->setValue(
+      s.value("metrics_port", MetricsServer::kDefaultPort).toInt());
+
   // Load settings
   QString last_output_format =
       s.value("last_output_format", "audio/x-vorbis").toString();
@@ -143,6 +148,8 @@ void NetworkRemoteSettingsPage::Save() {
   s.setValue("auth_code", ui_->auth_code->value());
   s.setValue("allow_downloads", ui_->allow_downloads->isChecked());
   s.setValue("convert_lossless", ui_->convert_lossless->isChecked());
+  s.setValue("use_metrics", ui_->use_metrics->isChecked());
+  s.setValue("metrics_port", ui_->metrics_port->value());
 
   TranscoderPreset preset = ui_->format->itemData(ui_->format->currentIndex())
                                 .value<TranscoderPreset>();
@@ -28,7 +28,6 @@
 #include <QPushButton>
 #include <QResizeEvent>
 #include <QSettings>
-#include <QtConcurrentRun>
 #include <QtDebug>
 
 #include "iconloader.h"
@@ -36,6 +35,7 @@
 #include "core/musicstorage.h"
 #include "core/organise.h"
 #include "core/tagreaderclient.h"
+#include "core/taskexecutor.h"
 #include "core/utilities.h"
 #include "library/librarybackend.h"
 
@@ -50,6 +50,7 @@ OrganiseDialog::OrganiseDialog(
       task_manager_(task_manager),
       backend_(backend),
       total_size_(0),
+      previews_ok_(false),
       resized_by_user_(false) {
   ui_->setupUi(this);
   connect(ui_->button_box->button(QDialogButtonBox::Reset), SIGNAL(clicked()),
@@ -162,8 +163,9 @@ bool OrganiseDialog::SetUrls(const QList<QUrl>& urls) {
 }
 
 bool OrganiseDialog::SetFilenames(const QStringList& filenames) {
-  songs_future_ =
-      QtConcurrent::run(this, &OrganiseDialog::LoadSongsBlocking, filenames);
+  songs_future_ = TaskExecutor::Instance()->Run<SongList>(
+      TaskExecutor::Lane_Interactive,
+      std::bind(&OrganiseDialog::LoadSongsBlocking, this, filenames));
   NewClosure(songs_future_, [=]() { SetSongs(songs_future_.result()); });
 
   SetLoadingSongs(true);
@@ -215,7 +217,8 @@ void OrganiseDialog::InsertTag(const QString& tag) {
 }
 
 Organise::NewSongInfoList OrganiseDialog::ComputeNewSongsFilenames(
-    const SongList& songs, const OrganiseFormat& format) {
+    const SongList& songs, const OrganiseFormat& format,
+    const CancellationToken* cancel) {
   // Check if we will have multiple files with the same name.
   // If so, they will erase each other if the overwrite flag is set.
   // Better to rename them: e.g. foo.bar -> foo(2).bar
@@ -223,6 +226,8 @@ Organise::NewSongInfoList OrganiseDialog::ComputeNewSongsFilenames(
   Organise::NewSongInfoList new_songs_info;
 
   for (const Song& song : songs) {
+    if (cancel && cancel->is_cancelled()) break;
+
     QString new_filename = format.GetFilenameForSong(song);
     if (filenames.contains(new_filename)) {
       QString song_number = QString::number(++filenames[new_filename]);
@@ -292,22 +297,52 @@ void OrganiseDialog::UpdatePreviews() {
   bool ok = format_valid && !songs_.isEmpty();
   if (capacity != 0 && total_size_ > free) ok = false;
 
-  ui_->button_box->button(QDialogButtonBox::Ok)->setEnabled(ok);
+  // Stop working out the previews for the old format.  The Ok button is
+  // enabled again once the new ones are ready.
+  previews_cancel_.Cancel();
+  previews_cancel_ = CancellationToken();
+  previews_future_ = QFuture<Organise::NewSongInfoList>();
+  ui_->button_box->button(QDialogButtonBox::Ok)->setEnabled(false);
   if (!format_valid) return;
 
-  new_songs_info_ = ComputeNewSongsFilenames(songs_, format_);
-
-  // Update the previews
-  ui_->preview->clear();
   ui_->preview_group->setVisible(has_local_destination);
   ui_->naming_group->setVisible(has_local_destination);
-  if (has_local_destination) {
+  previews_path_ = has_local_destination ? storage->LocalPath() : QString();
+  previews_ok_ = ok;
+
+  const SongList songs = songs_;
+  const OrganiseFormat format = format_;
+  const CancellationToken cancel = previews_cancel_;
+  previews_future_ =
+      TaskExecutor::Instance()->Run<Organise::NewSongInfoList>(
+          TaskExecutor::Lane_Interactive, cancel, [songs, format, cancel]() {
+            return ComputeNewSongsFilenames(songs, format, &cancel);
+          });
+  NewClosure(previews_future_, this,
+             SLOT(PreviewsComputed(QFuture<Organise::NewSongInfoList>)),
+             previews_future_);
+}
+
+void OrganiseDialog::PreviewsComputed(
+    QFuture<Organise::NewSongInfoList> future) {
+  // The format changed while these were being worked out
+  if (future != previews_future_) return;
+
+  new_songs_info_ = future.result();
+
+  ui_->preview->clear();
+  if (!previews_path_.isEmpty()) {
+    QStringList filenames;
+    filenames.reserve(new_songs_info_.count());
     for (const Organise::NewSongInfo& song_info : new_songs_info_) {
-      QString filename = storage->LocalPath() + "/" + song_info.new_filename_;
-      ui_->preview->addItem(QDir::toNativeSeparators(filename));
+      filenames << QDir::toNativeSeparators(previews_path_ + "/" +
+                                            song_info.new_filename_);
     }
+    ui_->preview->addItems(filenames);
   }
 
+  ui_->button_box->button(QDialogButtonBox::Ok)->setEnabled(previews_ok_);
+
   if (!resized_by_user_) {
     adjustSize();
   }
@@ -30,6 +30,7 @@
 #include "core/organise.h"
 #include "core/organiseformat.h"
 #include "core/song.h"
+#include "core/taskexecutor.h"
 #include "library/librarybackend.h"
 
 class LibraryWatcher;
@@ -79,6 +80,7 @@ class OrganiseDialog : public QDialog {
 
   void InsertTag(const QString& tag);
   void UpdatePreviews();
+  void PreviewsComputed(QFuture<Organise::NewSongInfoList> future);
 
   void DestDataChanged(const QModelIndex& begin, const QModelIndex& end);
 
@@ -88,8 +90,10 @@ class OrganiseDialog : public QDialog {
   SongList LoadSongsBlocking(const QStringList& filenames);
   void SetLoadingSongs(bool loading);
 
+  // Gives up early, returning only some of the songs, if cancel is cancelled.
   static Organise::NewSongInfoList ComputeNewSongsFilenames(
-      const SongList& songs, const OrganiseFormat& format);
+      const SongList& songs, const OrganiseFormat& format,
+      const CancellationToken* cancel = nullptr);
 
   Ui_OrganiseDialog* ui_;
   TaskManager* task_manager_;
@@ -104,6 +108,14 @@ class OrganiseDialog : public QDialog {
   Organise::NewSongInfoList new_songs_info_;
   quint64 total_size_;
 
+  // The previews are worked out in the background, and worked out again
+  // whenever the format changes.
+  QFuture<Organise::NewSongInfoList> previews_future_;
+  CancellationToken previews_cancel_;
+  // Empty if the destination isn't a local directory.
+  QString previews_path_;
+  bool previews_ok_;
+
   std::unique_ptr<OrganiseErrorDialog> error_dialog_;
 
   bool resized_by_user_;
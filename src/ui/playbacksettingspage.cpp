@@ -49,26 +49,18 @@ PlaybackSettingsPage::PlaybackSettingsPage(SettingsDialog* dialog)
   ui_->sample_rate->setItemData(2, 48000);
   ui_->sample_rate->setItemData(3, 96000);
   ui_->sample_rate->setItemData(4, 192000);
+
+  if (dialog->gst_engine()) {
+    connect(dialog->gst_engine(), SIGNAL(OutputsChanged()),
+            SLOT(LoadOutputs()));
+  }
 }
 
 PlaybackSettingsPage::~PlaybackSettingsPage() { delete ui_; }
 
 void PlaybackSettingsPage::Load() {
-  const GstEngine* engine = dialog()->gst_engine();
-
   ui_->gst_output->clear();
-  for (const GstEngine::OutputDetails& output : engine->GetOutputsList()) {
-    // Strip components off the icon name until we find one.
-    QStringList components = output.icon_name.split("-");
-    QIcon icon;
-    while (icon.isNull() && !components.isEmpty()) {
-      icon = IconLoader::Load(components.join("-"), IconLoader::Base);
-      components.removeLast();
-    }
-
-    ui_->gst_output->addItem(icon, output.description,
-                             QVariant::fromValue(output));
-  }
+  LoadOutputs();
 
   QSettings s;
 
@@ -90,21 +82,6 @@ void PlaybackSettingsPage::Load() {
   s.endGroup();
 
   s.beginGroup(GstEngine::kSettingsGroup);
-  QString sink = s.value("sink", GstEngine::kAutoSink).toString();
-  QVariant device = s.value("device");
-
-  ui_->gst_output->setCurrentIndex(0);
-  for (int i = 0; i < ui_->gst_output->count(); ++i) {
-    GstEngine::OutputDetails details =
-        ui_->gst_output->itemData(i).value<GstEngine::OutputDetails>();
-
-    if (details.gstreamer_plugin_name == sink &&
-        details.device_property_value == device) {
-      ui_->gst_output->setCurrentIndex(i);
-      break;
-    }
-  }
-
   ui_->replaygain->setChecked(s.value("rgenabled", false).toBool());
   ui_->replaygain_mode->setCurrentIndex(s.value("rgmode", 0).toInt());
   ui_->replaygain_preamp->setValue(s.value("rgpreamp", 0.0).toDouble() * 10 +
@@ -116,6 +93,10 @@ void PlaybackSettingsPage::Load() {
   ui_->sample_rate->setCurrentIndex(ui_->sample_rate->findData(
       s.value("samplerate", GstEngine::kAutoSampleRate).toInt()));
   ui_->buffer_min_fill->setValue(s.value("bufferminfill", 33).toInt());
+  ui_->adaptive_buffering->setChecked(
+      s.value("adaptivebuffering", false).toBool());
+  ui_->prebuffer_lookahead->setValue(
+      s.value("prebufferlookahead", 10000).toInt());
   s.endGroup();
 }
 
@@ -153,9 +134,57 @@ void PlaybackSettingsPage::Save() {
       "samplerate",
       ui_->sample_rate->itemData(ui_->sample_rate->currentIndex()).toInt());
   s.setValue("bufferminfill", ui_->buffer_min_fill->value());
+  s.setValue("adaptivebuffering", ui_->adaptive_buffering->isChecked());
+  s.setValue("prebufferlookahead", ui_->prebuffer_lookahead->value());
   s.endGroup();
 }
 
+void PlaybackSettingsPage::LoadOutputs() {
+  const GstEngine* engine = dialog()->gst_engine();
+
+  // Keep the selected output if it's still there, otherwise select the saved
+  // one.
+  QString sink;
+  QVariant device;
+  if (ui_->gst_output->currentIndex() != -1) {
+    GstEngine::OutputDetails details =
+        ui_->gst_output->currentData().value<GstEngine::OutputDetails>();
+    sink = details.gstreamer_plugin_name;
+    device = details.device_property_value;
+  } else {
+    QSettings s;
+    s.beginGroup(GstEngine::kSettingsGroup);
+    sink = s.value("sink", GstEngine::kAutoSink).toString();
+    device = s.value("device");
+  }
+
+  ui_->gst_output->clear();
+  for (const GstEngine::OutputDetails& output : engine->GetOutputsList()) {
+    // Strip components off the icon name until we find one.
+    QStringList components = output.icon_name.split("-");
+    QIcon icon;
+    while (icon.isNull() && !components.isEmpty()) {
+      icon = IconLoader::Load(components.join("-"), IconLoader::Base);
+      components.removeLast();
+    }
+
+    ui_->gst_output->addItem(icon, output.description,
+                             QVariant::fromValue(output));
+  }
+
+  ui_->gst_output->setCurrentIndex(0);
+  for (int i = 0; i < ui_->gst_output->count(); ++i) {
+    GstEngine::OutputDetails details =
+        ui_->gst_output->itemData(i).value<GstEngine::OutputDetails>();
+
+    if (details.gstreamer_plugin_name == sink &&
+        details.device_property_value == device) {
+      ui_->gst_output->setCurrentIndex(i);
+      break;
+    }
+  }
+}
+
 void PlaybackSettingsPage::RgPreampChanged(int value) {
   float db = float(value) / 10 - 15;
   QString db_str;
@@ -33,6 +33,7 @@ class PlaybackSettingsPage : public SettingsPage {
   void Save();
 
  private slots:
+  void LoadOutputs();
   void FadingOptionsChanged();
   void RgPreampChanged(int value);
   void BufferMinFillChanged(int value);
@@ -23,10 +23,10 @@
 #include <QShortcut>
 #include <QTreeWidget>
 #include <QUrl>
-#include <QtConcurrentRun>
 #include <QtDebug>
 
 #include "core/tagreaderclient.h"
+#include "core/taskexecutor.h"
 #include "ui/iconloader.h"
 
 TrackSelectionDialog::TrackSelectionDialog(QWidget* parent)
@@ -255,8 +255,9 @@ void TrackSelectionDialog::accept() {
     SetLoading(tr("Saving tracks") + "...");
 
     // Save tags in the background
-    QFuture<void> future =
-        QtConcurrent::run(this, &TrackSelectionDialog::SaveData, data_);
+    QFuture<void> future = TaskExecutor::Instance()->Run<void>(
+        TaskExecutor::Lane_Interactive,
+        std::bind(&TrackSelectionDialog::SaveData, this, data_));
     NewClosure(future, this, SLOT(AcceptFinished()));
     return;
   }
@@ -26,28 +26,100 @@
 #endif
 
 #include <QtDebug>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "core/logging.h"
+#include "core/utilities.h"
+
+const int ProjectMPresetModel::kFetchBatchSize = 500;
+const quint32 ProjectMPresetModel::kIndexMagic = 0x504d5049;  // "PMPI"
+const quint32 ProjectMPresetModel::kIndexVersion = 1;
 
 ProjectMPresetModel::ProjectMPresetModel(ProjectMVisualisation* vis,
                                          QObject* parent)
-    : QAbstractItemModel(parent), vis_(vis) {
+    : QAbstractItemModel(parent), vis_(vis), loaded_rows_(0) {
   // Find presets
   QDir preset_dir(vis_->preset_url());
-  QStringList presets(
-      preset_dir.entryList(QStringList() << "*.milk"
-                                         << "*.prjm",
-                           QDir::Files | QDir::NoDotAndDotDot | QDir::Readable,
-                           QDir::Name | QDir::IgnoreCase));
+  const QStringList presets = ListPresets(preset_dir.absolutePath());
 
   for (const QString& filename : presets) {
+    preset_rows_[preset_dir.absoluteFilePath(filename)] = all_presets_.count();
     all_presets_ << Preset(preset_dir.absoluteFilePath(filename), filename,
                            false);
   }
+
+  loaded_rows_ = qMin(kFetchBatchSize, all_presets_.count());
+}
+
+QString ProjectMPresetModel::IndexFilename() {
+  return Utilities::GetConfigPath(Utilities::Path_CacheRoot) +
+         "/projectmpresets.dat";
 }
 
-int ProjectMPresetModel::rowCount(const QModelIndex&) const {
-  if (!vis_) return 0;
-  return all_presets_.count();
+QStringList ProjectMPresetModel::ListPresets(const QString& path) {
+  const QDateTime modified = QFileInfo(path).lastModified();
+
+  QFile file(IndexFilename());
+  if (file.open(QIODevice::ReadOnly)) {
+    QDataStream s(&file);
+    s.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString cached_path;
+    QDateTime cached_modified;
+    QStringList ret;
+    s >> magic >> version;
+    if (magic == kIndexMagic && version == kIndexVersion) {
+      s >> cached_path >> cached_modified >> ret;
+      if (s.status() == QDataStream::Ok && cached_path == path &&
+          cached_modified == modified) {
+        return ret;
+      }
+    }
+    file.close();
+  }
+
+  qLog(Debug) << "Scanning projectM presets in" << path;
+  const QStringList ret = QDir(path).entryList(
+      QStringList() << "*.milk"
+                    << "*.prjm",
+      QDir::Files | QDir::NoDotAndDotDot | QDir::Readable,
+      QDir::Name | QDir::IgnoreCase);
+
+  QDir().mkpath(QFileInfo(IndexFilename()).path());
+  QSaveFile index(IndexFilename());
+  if (index.open(QIODevice::WriteOnly)) {
+    QDataStream s(&index);
+    s.setVersion(QDataStream::Qt_5_0);
+    s << kIndexMagic << kIndexVersion << path << modified << ret;
+    if (s.status() == QDataStream::Ok) index.commit();
+  }
+
+  return ret;
+}
+
+int ProjectMPresetModel::rowCount(const QModelIndex& parent) const {
+  if (!vis_ || parent.isValid()) return 0;
+  return loaded_rows_;
+}
+
+bool ProjectMPresetModel::canFetchMore(const QModelIndex& parent) const {
+  return !parent.isValid() && loaded_rows_ < all_presets_.count();
+}
+
+void ProjectMPresetModel::fetchMore(const QModelIndex& parent) {
+  if (!canFetchMore(parent)) return;
+
+  const int count = qMin(kFetchBatchSize, all_presets_.count() - loaded_rows_);
+  beginInsertRows(QModelIndex(), loaded_rows_, loaded_rows_ + count - 1);
+  loaded_rows_ += count;
+  endInsertRows();
 }
 
 int ProjectMPresetModel::columnCount(const QModelIndex&) const { return 1; }
@@ -105,7 +177,7 @@ void ProjectMPresetModel::SelectAll() {
   }
   vis_->SetSelected(paths, true);
 
-  emit dataChanged(index(0, 0), index(rowCount() - 1, 0));
+  if (rowCount() > 0) emit dataChanged(index(0, 0), index(rowCount() - 1, 0));
 }
 
 void ProjectMPresetModel::SelectNone() {
@@ -114,14 +186,12 @@ void ProjectMPresetModel::SelectNone() {
     all_presets_[i].selected_ = false;
   }
 
-  emit dataChanged(index(0, 0), index(rowCount() - 1, 0));
+  if (rowCount() > 0) emit dataChanged(index(0, 0), index(rowCount() - 1, 0));
 }
 
 void ProjectMPresetModel::MarkSelected(const QString& path, bool selected) {
-  for (int i = 0; i < all_presets_.count(); ++i) {
-    if (path == all_presets_[i].path_) {
-      all_presets_[i].selected_ = selected;
-      return;
-    }
+  auto it = preset_rows_.find(path);
+  if (it != preset_rows_.end()) {
+    all_presets_[it.value()].selected_ = selected;
   }
 }
@@ -19,6 +19,7 @@
 #define PROJECTMPRESETMODEL_H
 
 #include <QAbstractItemModel>
+#include <QHash>
 
 class ProjectMVisualisation;
 
@@ -40,6 +41,8 @@ class ProjectMPresetModel : public QAbstractItemModel {
   QModelIndex parent(const QModelIndex& child) const;
   int rowCount(const QModelIndex& parent = QModelIndex()) const;
   int columnCount(const QModelIndex& parent = QModelIndex()) const;
+  bool canFetchMore(const QModelIndex& parent) const;
+  void fetchMore(const QModelIndex& parent);
   QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
   Qt::ItemFlags flags(const QModelIndex& index) const;
   bool setData(const QModelIndex& index, const QVariant& value,
@@ -51,6 +54,16 @@ class ProjectMPresetModel : public QAbstractItemModel {
   void SelectNone();
 
  private:
+  static const int kFetchBatchSize;
+  static const quint32 kIndexMagic;
+  static const quint32 kIndexVersion;
+
+  // Returns the preset filenames in the directory, sorted by name.  The list
+  // is cached along with the directory's modification time, so the directory
+  // is only listed again when files have been added or removed.
+  static QStringList ListPresets(const QString& path);
+  static QString IndexFilename();
+
   struct Preset {
     Preset(const QString& path, const QString& name, bool selected)
         : path_(path), name_(name), selected_(selected) {}
@@ -62,6 +75,10 @@ class ProjectMPresetModel : public QAbstractItemModel {
 
   ProjectMVisualisation* vis_;
   QList<Preset> all_presets_;
+  QHash<QString, int> preset_rows_;
+
+  // Rows are handed to views a batch at a time as they scroll.
+  int loaded_rows_;
 };
 
 #endif  // PROJECTMPRESETMODEL_H
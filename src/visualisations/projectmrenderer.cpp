@@ -0,0 +1,156 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include "projectmrenderer.h"
+
+#include <QOffscreenSurface>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QTimerEvent>
+
+#include "core/logging.h"
+#include "engines/scoperingbuffer.h"
+
+#ifdef USE_SYSTEM_PROJECTM
+#include <libprojectM/projectM.hpp>
+#else
+#include "projectM.hpp"
+#endif
+
+// Interleaved stereo, so 512 frames - the window projectM analyses.
+const int ProjectMRenderer::kPcmSamples = 1024;
+
+ProjectMRenderer::ProjectMRenderer(Factory factory, ScopeRingBuffer* pcm,
+                                   QMutex* mutex, QOpenGLContext* context,
+                                   QOffscreenSurface* surface)
+    : factory_(factory),
+      pcm_(pcm),
+      projectm_mutex_(mutex),
+      context_(context),
+      surface_(surface),
+      samples_(kPcmSamples),
+      ready_frame_(-1),
+      shown_frame_(-1) {}
+
+ProjectMRenderer::~ProjectMRenderer() {}
+
+void ProjectMRenderer::Init() {
+  if (!context_->makeCurrent(surface_)) {
+    qLog(Error) << "Couldn't make the projectM context current";
+  }
+
+  QMutexLocker l(projectm_mutex_);
+  projectm_.reset(factory_());
+}
+
+void ProjectMRenderer::Shutdown() {
+  timer_.stop();
+
+  context_->makeCurrent(surface_);
+  {
+    QMutexLocker l(projectm_mutex_);
+    projectm_.reset();
+  }
+  {
+    QMutexLocker l(&frame_mutex_);
+    for (int i = 0; i < kFrameCount; ++i) frames_[i].reset();
+    ready_frame_ = -1;
+    shown_frame_ = -1;
+  }
+  context_->doneCurrent();
+  context_.reset();
+}
+
+void ProjectMRenderer::SetSize(const QSize& size) { size_ = size; }
+
+void ProjectMRenderer::SetTextureSize(int size) {
+  if (!projectm_ || !context_->makeCurrent(surface_)) return;
+
+  QMutexLocker l(projectm_mutex_);
+  projectm_->changeTextureSize(size);
+  // The new projectM renderer starts off at the default window size.
+  projectm_size_ = QSize();
+}
+
+void ProjectMRenderer::SetFps(int fps) {
+  if (fps <= 0) {
+    timer_.stop();
+  } else {
+    timer_.start(1000 / fps, Qt::PreciseTimer, this);
+  }
+}
+
+void ProjectMRenderer::timerEvent(QTimerEvent* e) {
+  if (e->timerId() == timer_.timerId()) {
+    RenderFrame();
+  } else {
+    QObject::timerEvent(e);
+  }
+}
+
+void ProjectMRenderer::RenderFrame() {
+  if (!projectm_ || size_.isEmpty()) return;
+  if (!context_->makeCurrent(surface_)) return;
+
+  int target = 0;
+  {
+    QMutexLocker l(&frame_mutex_);
+    while (target == ready_frame_ || target == shown_frame_) ++target;
+  }
+
+  std::unique_ptr<QOpenGLFramebufferObject>& frame = frames_[target];
+  if (!frame || frame->size() != size_) {
+    frame.reset(new QOpenGLFramebufferObject(
+        size_, QOpenGLFramebufferObject::CombinedDepthStencil));
+  }
+  frame->bind();
+
+  {
+    QMutexLocker l(projectm_mutex_);
+
+    int pipeline_id = -1;
+    if (pcm_->ReadLatest(samples_.data(), samples_.size(), &pipeline_id)) {
+      projectm_->pcm()->addPCM16Data(samples_.data(), samples_.size() / 2);
+    }
+
+    if (projectm_size_ != size_) {
+      projectm_->projectM_resetGL(size_.width(), size_.height());
+      projectm_size_ = size_;
+    }
+
+    projectm_->setOutputFramebuffer(frame->handle());
+    projectm_->renderFrame();
+  }
+
+  frame->release();
+
+  // The GUI's context has to see the whole frame.
+  context_->functions()->glFinish();
+
+  {
+    QMutexLocker l(&frame_mutex_);
+    ready_frame_ = target;
+  }
+  emit FrameReady();
+}
+
+GLuint ProjectMRenderer::TakeFrame() {
+  QMutexLocker l(&frame_mutex_);
+  shown_frame_ = ready_frame_;
+  if (shown_frame_ == -1) return 0;
+  return frames_[shown_frame_]->texture();
+}
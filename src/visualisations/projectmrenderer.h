@@ -0,0 +1,108 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROJECTMRENDERER_H
+#define PROJECTMRENDERER_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QBasicTimer>
+#include <QMutex>
+#include <QObject>
+#include <QOpenGLContext>
+#include <QSize>
+
+class projectM;
+class ScopeRingBuffer;
+
+class QOffscreenSurface;
+class QOpenGLFramebufferObject;
+
+// Renders projectM in its own thread, with its own GL context, so a slow
+// preset can't hold up the rest of the UI.  Each frame is drawn into a
+// framebuffer object whose texture is shared with the visualisation window's
+// context.  There are three of them, so the one being drawn on screen and the
+// latest finished one are never drawn over.
+//
+// The renderer owns projectM, and is the only thing that touches it without
+// holding the projectM mutex.  Everything except TakeFrame() has to be
+// called in the render thread.
+class ProjectMRenderer : public QObject {
+  Q_OBJECT
+
+ public:
+  typedef std::function<projectM*()> Factory;
+
+  // Takes ownership of context, which should be moved to the render thread
+  // along with the renderer.  surface must have been created in the GUI
+  // thread, and outlive the renderer.
+  ProjectMRenderer(Factory factory, ScopeRingBuffer* pcm, QMutex* mutex,
+                   QOpenGLContext* context, QOffscreenSurface* surface);
+  ~ProjectMRenderer();
+
+  projectM* projectm() const { return projectm_.get(); }
+
+  // Called in the GUI thread.  Returns the texture with the latest frame in
+  // it, or 0 if nothing's been rendered yet.  The texture isn't drawn over
+  // until a newer one has been taken.
+  GLuint TakeFrame();
+
+ public slots:
+  // Creates projectM.  Must be finished before projectm() is used.
+  void Init();
+  // Destroys projectM and the GL resources.
+  void Shutdown();
+
+  void SetSize(const QSize& size);
+  void SetTextureSize(int size);
+  // Frames are only rendered while fps is more than 0.
+  void SetFps(int fps);
+
+ signals:
+  void FrameReady();
+
+ protected:
+  void timerEvent(QTimerEvent* e);
+
+ private:
+  static const int kFrameCount = 3;
+  static const int kPcmSamples;
+
+  void RenderFrame();
+
+  Factory factory_;
+  ScopeRingBuffer* pcm_;
+  QMutex* projectm_mutex_;
+  std::unique_ptr<QOpenGLContext> context_;
+  QOffscreenSurface* surface_;
+
+  std::unique_ptr<projectM> projectm_;
+  QSize projectm_size_;
+  std::vector<int16_t> samples_;
+
+  QSize size_;
+  QBasicTimer timer_;
+
+  std::unique_ptr<QOpenGLFramebufferObject> frames_[kFrameCount];
+  QMutex frame_mutex_;
+  int ready_frame_;
+  int shown_frame_;
+};
+
+#endif  // PROJECTMRENDERER_H
@@ -17,6 +17,7 @@
 
 #include "config.h"
 #include "projectmpresetmodel.h"
+#include "projectmrenderer.h"
 #include "projectmvisualisation.h"
 #include "visualisationcontainer.h"
 
@@ -26,6 +27,7 @@
 #include <QGLWidget>
 #include <QGraphicsView>
 #include <QMessageBox>
+#include <QOffscreenSurface>
 #include <QPaintEngine>
 #include <QPainter>
 #include <QSettings>
@@ -48,10 +50,13 @@
 
 ProjectMVisualisation::ProjectMVisualisation(QObject* parent)
     : QGraphicsScene(parent),
+      projectm_(nullptr),
       preset_model_(nullptr),
       mode_(Random),
       duration_(15),
-      texture_size_(512) {
+      texture_size_(512),
+      fps_(35),
+      active_(false) {
   connect(this, SIGNAL(sceneRectChanged(QRectF)),
           SLOT(SceneRectChanged(QRectF)));
 
@@ -59,7 +64,14 @@ ProjectMVisualisation::ProjectMVisualisation(QObject* parent)
     default_rating_list_.push_back(3);
 }
 
-ProjectMVisualisation::~ProjectMVisualisation() {}
+ProjectMVisualisation::~ProjectMVisualisation() {
+  if (renderer_) {
+    QMetaObject::invokeMethod(renderer_.get(), "Shutdown",
+                              Qt::BlockingQueuedConnection);
+  }
+  render_thread_.quit();
+  render_thread_.wait();
+}
 
 void ProjectMVisualisation::InitProjectM() {
   // Find the projectM presets
@@ -115,15 +127,47 @@ void ProjectMVisualisation::InitProjectM() {
   s.menuFontURL = font_path.toStdString();
   s.titleFontURL = font_path.toStdString();
 
-  projectm_.reset(new projectM(s));
+  // projectM gets its own context, sharing textures with the one that draws
+  // this scene, and renders into it from another thread.
+  QOpenGLContext* share_context = QOpenGLContext::currentContext();
+  QOpenGLContext* context = new QOpenGLContext;
+  context->setFormat(share_context->format());
+  context->setShareContext(share_context);
+  context->create();
+
+  surface_.reset(new QOffscreenSurface);
+  surface_->setFormat(context->format());
+  surface_->create();
+
+  // Our own preset index fills the playlist in Load(), so don't let projectM
+  // scan the directory as well.
+  renderer_.reset(new ProjectMRenderer(
+      [s]() { return new projectM(s, projectM::FLAG_DISABLE_PLAYLIST_LOAD); },
+      &pcm_, &projectm_mutex_, context, surface_.get()));
+  context->moveToThread(&render_thread_);
+  renderer_->moveToThread(&render_thread_);
+  connect(renderer_.get(), SIGNAL(FrameReady()), SLOT(update()));
+
+  render_thread_.setObjectName("projectM");
+  render_thread_.start();
+  QMetaObject::invokeMethod(renderer_.get(), "Init",
+                            Qt::BlockingQueuedConnection);
+  projectm_ = renderer_->projectm();
+
   preset_model_ = new ProjectMPresetModel(this, this);
   Load();
 
   // Start at a random preset.
-  if (projectm_->getPlaylistSize() > 0) {
-    projectm_->selectPreset(qrand() % projectm_->getPlaylistSize(), true);
+  {
+    QMutexLocker l(&projectm_mutex_);
+    if (projectm_->getPlaylistSize() > 0) {
+      projectm_->selectPreset(qrand() % projectm_->getPlaylistSize(), true);
+    }
   }
 
+  SceneRectChanged(sceneRect());
+  SetActive(active_);
+
   if (font_path.isNull()) {
     qWarning("ProjectM presets could not be found, search path was:\n  %s",
              paths.join("\n  ").toLocal8Bit().constData());
@@ -137,57 +181,133 @@ void ProjectMVisualisation::InitProjectM() {
 void ProjectMVisualisation::drawBackground(QPainter* p, const QRectF&) {
   p->beginNativePainting();
 
-  if (!projectm_) {
+  if (!renderer_) {
     InitProjectM();
   }
 
-  projectm_->projectM_resetGL(sceneRect().width(), sceneRect().height());
-  projectm_->renderFrame();
+  // Just show the latest frame from the render thread.
+  const GLuint texture = renderer_->TakeFrame();
+  if (texture) DrawFrame(texture);
 
   p->endNativePainting();
 }
 
+void ProjectMVisualisation::DrawFrame(GLuint texture) {
+  glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_CURRENT_BIT);
+  glMatrixMode(GL_PROJECTION);
+  glPushMatrix();
+  glLoadIdentity();
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+
+  glDisable(GL_BLEND);
+  glDisable(GL_DEPTH_TEST);
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glColor4f(1.0, 1.0, 1.0, 1.0);
+
+  glBegin(GL_QUADS);
+  glTexCoord2f(0.0, 0.0);
+  glVertex2f(-1.0, -1.0);
+  glTexCoord2f(1.0, 0.0);
+  glVertex2f(1.0, -1.0);
+  glTexCoord2f(1.0, 1.0);
+  glVertex2f(1.0, 1.0);
+  glTexCoord2f(0.0, 1.0);
+  glVertex2f(-1.0, 1.0);
+  glEnd();
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glPopMatrix();
+  glMatrixMode(GL_PROJECTION);
+  glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+  glPopAttrib();
+}
+
 void ProjectMVisualisation::SceneRectChanged(const QRectF& rect) {
-  if (projectm_) projectm_->projectM_resetGL(rect.width(), rect.height());
+  if (renderer_) {
+    QMetaObject::invokeMethod(renderer_.get(), "SetSize",
+                              Q_ARG(QSize, rect.size().toSize()));
+  }
+}
+
+void ProjectMVisualisation::SetFps(int fps) {
+  fps_ = fps;
+  SetActive(active_);
+}
+
+void ProjectMVisualisation::SetActive(bool active) {
+  active_ = active;
+
+  if (renderer_) {
+    QMetaObject::invokeMethod(renderer_.get(), "SetFps",
+                              Q_ARG(int, active_ ? fps_ : 0));
+  }
 }
 
 void ProjectMVisualisation::SetTextureSize(int size) {
   texture_size_ = size;
 
-  if (projectm_) projectm_->changeTextureSize(texture_size_);
+  // Changing the texture size makes new GL resources, so it has to happen in
+  // the render thread.
+  if (renderer_) {
+    QMetaObject::invokeMethod(renderer_.get(), "SetTextureSize",
+                              Q_ARG(int, texture_size_));
+  }
 }
 
 void ProjectMVisualisation::SetDuration(int seconds) {
   duration_ = seconds;
 
-  if (projectm_) projectm_->changePresetDuration(duration_);
+  if (projectm_) {
+    QMutexLocker l(&projectm_mutex_);
+    projectm_->changePresetDuration(duration_);
+  }
 
   Save();
 }
 
 void ProjectMVisualisation::ConsumeBuffer(GstBuffer* buffer, int) {
+  // This is called in the streaming thread.  The render thread reads the
+  // samples that are playing when it draws each frame.
   GstMapInfo map;
-  gst_buffer_map(buffer, &map, GST_MAP_READ);
-  const int samples_per_channel = map.size / sizeof(short) / 2;
-  const short* data = reinterpret_cast<short*>(map.data);
-
-  if (projectm_) {
-    projectm_->pcm()->addPCM16Data(data, samples_per_channel);
+  if (gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+    const quint64 duration = GST_BUFFER_DURATION_IS_VALID(buffer)
+                                 ? GST_BUFFER_DURATION(buffer)
+                                 : 0;
+    pcm_.Write(reinterpret_cast<const int16_t*>(map.data),
+               map.size / sizeof(int16_t), duration, 0);
+    gst_buffer_unmap(buffer, &map);
   }
-
-  gst_buffer_unmap(buffer, &map);
   gst_buffer_unref(buffer);
 }
 
 void ProjectMVisualisation::SetSelected(const QStringList& paths,
                                         bool selected) {
-  for (const QString& path : paths) {
-    int index = IndexOfPreset(path);
-    if (selected && index == -1) {
-      projectm_->addPresetURL(path.toStdString(), std::string(),
-                              default_rating_list_);
-    } else if (!selected && index != -1) {
-      projectm_->removePreset(index);
+  {
+    QMutexLocker l(&projectm_mutex_);
+
+    // Selecting everything can add thousands of presets, so don't search the
+    // playlist for each one.
+    QSet<QString> playlist;
+    if (selected) {
+      for (uint i = 0; i < projectm_->getPlaylistSize(); ++i) {
+        playlist.insert(QString::fromStdString(projectm_->getPresetURL(i)));
+      }
+    }
+
+    for (const QString& path : paths) {
+      if (selected) {
+        if (playlist.contains(path)) continue;
+        projectm_->addPresetURL(path.toStdString(), std::string(),
+                                default_rating_list_);
+        playlist.insert(path);
+      } else {
+        const int index = IndexOfPreset(path);
+        if (index != -1) projectm_->removePreset(index);
+      }
     }
   }
 
@@ -195,7 +315,10 @@ void ProjectMVisualisation::SetSelected(const QStringList& paths,
 }
 
 void ProjectMVisualisation::ClearSelected() {
-  projectm_->clearPlaylist();
+  {
+    QMutexLocker l(&projectm_mutex_);
+    projectm_->clearPlaylist();
+  }
   Save();
 }
 
@@ -212,6 +335,7 @@ void ProjectMVisualisation::Load() {
   mode_ = Mode(s.value("mode", 0).toInt());
   duration_ = s.value("duration", duration_).toInt();
 
+  QMutexLocker l(&projectm_mutex_);
   projectm_->changePresetDuration(duration_);
   projectm_->clearPlaylist();
   switch (mode_) {
@@ -256,10 +380,12 @@ void ProjectMVisualisation::SetMode(Mode mode) {
 }
 
 QString ProjectMVisualisation::preset_url() const {
+  QMutexLocker l(&projectm_mutex_);
   return QString::fromStdString(projectm_->settings().presetURL);
 }
 
 void ProjectMVisualisation::SetImmediatePreset(const QString& path) {
+  QMutexLocker l(&projectm_mutex_);
   int index = IndexOfPreset(path);
   if (index == -1) {
     index = projectm_->addPresetURL(path.toStdString(), std::string(),
@@ -270,7 +396,10 @@ void ProjectMVisualisation::SetImmediatePreset(const QString& path) {
 }
 
 void ProjectMVisualisation::Lock(bool lock) {
-  projectm_->setPresetLock(lock);
+  {
+    QMutexLocker l(&projectm_mutex_);
+    projectm_->setPresetLock(lock);
+  }
 
   if (!lock) Load();
 }
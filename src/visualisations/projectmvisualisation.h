@@ -22,14 +22,20 @@
 
 #include <QGraphicsScene>
 #include <QBasicTimer>
+#include <QMutex>
+#include <QOpenGLContext>
 #include <QSet>
+#include <QThread>
 
 #include "engines/bufferconsumer.h"
+#include "engines/scoperingbuffer.h"
 
 class projectM;
 
 class ProjectMPresetModel;
+class ProjectMRenderer;
 
+class QOffscreenSurface;
 class QTemporaryFile;
 
 class ProjectMVisualisation : public QGraphicsScene, public BufferConsumer {
@@ -46,6 +52,11 @@ class ProjectMVisualisation : public QGraphicsScene, public BufferConsumer {
   Mode mode() const { return mode_; }
   int duration() const { return duration_; }
 
+  // Frames are rendered in the background at this rate while the
+  // visualisation is active.
+  void SetFps(int fps);
+  void SetActive(bool active);
+
   // BufferConsumer
   void ConsumeBuffer(GstBuffer* buffer, int);
 
@@ -69,13 +80,26 @@ class ProjectMVisualisation : public QGraphicsScene, public BufferConsumer {
 
  private:
   void InitProjectM();
+  void DrawFrame(GLuint texture);
   void Load();
   void Save();
 
+  // Must be called with projectm_mutex_ held.
   int IndexOfPreset(const QString& path) const;
 
  private:
-  std::unique_ptr<projectM> projectm_;
+  // PCM from the streaming thread, read by the render thread.
+  ScopeRingBuffer pcm_;
+
+  QThread render_thread_;
+  std::unique_ptr<QOffscreenSurface> surface_;
+  std::unique_ptr<ProjectMRenderer> renderer_;
+
+  // Owned by renderer_, which renders from its own thread.  Everything else
+  // must hold projectm_mutex_ while using it.
+  projectM* projectm_;
+  mutable QMutex projectm_mutex_;
+
   ProjectMPresetModel* preset_model_;
   Mode mode_;
   int duration_;
@@ -85,6 +109,8 @@ class ProjectMVisualisation : public QGraphicsScene, public BufferConsumer {
   std::vector<int> default_rating_list_;
 
   int texture_size_;
+  int fps_;
+  bool active_;
 };
 
 #endif  // PROJECTMVISUALISATION_H
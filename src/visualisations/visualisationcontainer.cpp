@@ -92,6 +92,7 @@ void VisualisationContainer::Init() {
   ChangeOverlayOpacity(0.0);
 
   vis_->SetTextureSize(size_);
+  vis_->SetFps(fps_);
   SizeChanged();
 
   // Selector
@@ -167,7 +168,7 @@ void VisualisationContainer::showEvent(QShowEvent* e) {
   }
 
   QGraphicsView::showEvent(e);
-  update_timer_.start(1000 / fps_, this);
+  vis_->SetActive(true);
 
   if (engine_) engine_->AddBufferConsumer(vis_);
 }
@@ -175,7 +176,7 @@ void VisualisationContainer::showEvent(QShowEvent* e) {
 void VisualisationContainer::hideEvent(QHideEvent* e) {
   qLog(Debug) << "Hiding visualization";
   QGraphicsView::hideEvent(e);
-  update_timer_.stop();
+  vis_->SetActive(false);
 
   if (engine_) engine_->RemoveBufferConsumer(vis_);
 }
@@ -204,11 +205,6 @@ void VisualisationContainer::SizeChanged() {
   if (overlay_) overlay_->resize(size());
 }
 
-void VisualisationContainer::timerEvent(QTimerEvent* e) {
-  QGraphicsView::timerEvent(e);
-  if (e->timerId() == update_timer_.timerId()) scene()->update();
-}
-
 void VisualisationContainer::SetActions(QAction* previous, QAction* play_pause,
                                         QAction* stop, QAction* next) {
   overlay_->SetActions(previous, play_pause, stop, next);
@@ -286,8 +282,8 @@ void VisualisationContainer::SetFps(int fps) {
   s.beginGroup(kSettingsGroup);
   s.setValue("fps", fps_);
 
-  update_timer_.stop();
-  update_timer_.start(1000 / fps_, this);
+  // The scene is redrawn whenever the visualisation has a new frame.
+  vis_->SetFps(fps_);
 }
 
 void VisualisationContainer::ShowPopupMenu(const QPoint& pos) {
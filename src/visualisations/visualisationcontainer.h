@@ -19,7 +19,6 @@
 #define VISUALISATIONCONTAINER_H
 
 #include <QGraphicsView>
-#include <QBasicTimer>
 
 #include "core/song.h"
 
@@ -62,7 +61,6 @@ class VisualisationContainer : public QGraphicsView {
   void hideEvent(QHideEvent* e);
   void closeEvent(QCloseEvent* e);
   void resizeEvent(QResizeEvent* e);
-  void timerEvent(QTimerEvent* e);
   void mouseMoveEvent(QMouseEvent* e);
   void enterEvent(QEvent* e);
   void leaveEvent(QEvent* e);
@@ -92,7 +90,6 @@ class VisualisationContainer : public QGraphicsView {
   GstEngine* engine_;
   ProjectMVisualisation* vis_;
   VisualisationOverlay* overlay_;
-  QBasicTimer update_timer_;
 
   VisualisationSelector* selector_;
 
@@ -24,11 +24,45 @@
 #include "ui/organiseerrordialog.h"
 #include "ui_fileview.h"
 
+#include <QFileIconProvider>
 #include <QFileSystemModel>
+#include <QHash>
 #include <QKeyEvent>
 #include <QMessageBox>
+#include <QMutex>
 #include <QScrollBar>
 
+namespace {
+
+// QFileSystemModel asks for an icon for every file it lists, and the default
+// provider can look inside each file to work out its type, which is slow on
+// network mounts.  This one only asks about the first file with each
+// extension, and never looks inside directories.  It's called from the
+// model's gatherer thread.
+class FileViewIconProvider : public QFileIconProvider {
+ public:
+  QIcon icon(IconType type) const { return QFileIconProvider::icon(type); }
+
+  QIcon icon(const QFileInfo& info) const {
+    if (info.isDir()) return QFileIconProvider::icon(Folder);
+
+    const QString suffix = info.suffix().toLower();
+    QMutexLocker l(&mutex_);
+    auto it = icons_.constFind(suffix);
+    if (it != icons_.constEnd()) return it.value();
+
+    const QIcon ret = QFileIconProvider::icon(info);
+    icons_.insert(suffix, ret);
+    return ret;
+  }
+
+ private:
+  mutable QMutex mutex_;
+  mutable QHash<QString, QIcon> icons_;
+};
+
+}  // namespace
+
 const char* FileView::kFileFilter =
     "*.mp3 *.ogg *.flac *.mpc *.m4a *.m4b *.aac *.wma "
     "*.mp4 *.spx *.wav *.m3u *.m3u8 *.pls *.xspf "
@@ -39,6 +73,7 @@ FileView::FileView(QWidget* parent)
     : QWidget(parent),
       ui_(new Ui_FileView),
       model_(nullptr),
+      icon_provider_(new FileViewIconProvider),
       undo_stack_(new QUndoStack(this)),
       task_manager_(nullptr),
       storage_(new FilesystemMusicStorage("/")) {
@@ -84,7 +119,11 @@ FileView::FileView(QWidget* parent)
   filter_list_ << filter.split(" ");
 }
 
-FileView::~FileView() { delete ui_; }
+FileView::~FileView() {
+  // The model's gatherer thread uses the icon provider, so stop it first.
+  delete model_;
+  delete ui_;
+}
 
 void FileView::SetPath(const QString& path) {
   if (!model_)
@@ -212,6 +251,7 @@ void FileView::showEvent(QShowEvent* e) {
   if (model_) return;
 
   model_ = new QFileSystemModel(this);
+  model_->setIconProvider(icon_provider_.get());
 
   model_->setNameFilters(filter_list_);
   // if an item fails the filter, hide it
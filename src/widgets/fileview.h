@@ -32,6 +32,7 @@ class MusicStorage;
 class TaskManager;
 class Ui_FileView;
 
+class QFileIconProvider;
 class QFileSystemModel;
 class QUndoStack;
 
@@ -99,6 +100,7 @@ signals:
   Ui_FileView* ui_;
 
   QFileSystemModel* model_;
+  std::unique_ptr<QFileIconProvider> icon_provider_;
   QUndoStack* undo_stack_;
 
   TaskManager* task_manager_;
@@ -21,6 +21,7 @@
 #include "ui/iconloader.h"
 
 #include <QContextMenuEvent>
+#include <QDir>
 #include <QFileSystemModel>
 #include <QMenu>
 #include <QtDebug>
@@ -63,12 +64,26 @@ void FileViewList::contextMenuEvent(QContextMenuEvent* e) {
 }
 
 QList<QUrl> FileViewList::UrlListFromSelection() const {
+  QFileSystemModel* fs_model = static_cast<QFileSystemModel*>(model());
+
+  // Resolving every selected file's canonical path costs a few system calls
+  // each, which adds up on network mounts.  Files directly in the root
+  // directory that aren't symlinks can reuse the root's canonical path.
+  const QString root_path = fs_model->rootPath();
+  const QString canonical_root = QFileInfo(root_path).canonicalFilePath();
+
   QList<QUrl> urls;
   for (const QModelIndex& index : menu_selection_.indexes()) {
-    if (index.column() == 0)
-      urls << QUrl::fromLocalFile(static_cast<QFileSystemModel*>(model())
-                                      ->fileInfo(index)
-                                      .canonicalFilePath());
+    if (index.column() != 0) continue;
+
+    const QFileInfo info = fs_model->fileInfo(index);
+    if (!canonical_root.isEmpty() && !info.isSymLink() &&
+        info.absolutePath() == root_path) {
+      urls << QUrl::fromLocalFile(
+          QDir(canonical_root).filePath(info.fileName()));
+    } else {
+      urls << QUrl::fromLocalFile(info.canonicalFilePath());
+    }
   }
   return urls;
 }
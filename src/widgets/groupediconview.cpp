@@ -18,6 +18,8 @@
 #include "groupediconview.h"
 #include "core/multisortfilterproxy.h"
 
+#include <algorithm>
+
 #include <QPainter>
 #include <QPaintEvent>
 #include <QScrollBar>
@@ -30,6 +32,8 @@ const int GroupedIconView::kBarMarginTop = 3;
 GroupedIconView::GroupedIconView(QWidget* parent)
     : QListView(parent),
       proxy_model_(new MultiSortFilterProxy(this)),
+      max_item_height_(0),
+      contents_height_(0),
       default_header_height_(fontMetrics().height() + kBarMarginTop +
                              kBarThickness),
       header_spacing_(10),
@@ -46,6 +50,9 @@ GroupedIconView::GroupedIconView(QWidget* parent)
   proxy_model_->setDynamicSortFilter(true);
 
   connect(proxy_model_, SIGNAL(modelReset()), SLOT(LayoutItems()));
+  connect(proxy_model_, SIGNAL(layoutChanged()), SLOT(LayoutItems()));
+  connect(proxy_model_, SIGNAL(rowsRemoved(QModelIndex, int, int)),
+          SLOT(RowsRemoved(QModelIndex, int, int)));
 }
 
 void GroupedIconView::AddSortSpec(int role, Qt::SortOrder order) {
@@ -109,32 +116,90 @@ void GroupedIconView::resizeEvent(QResizeEvent* e) {
 void GroupedIconView::rowsInserted(const QModelIndex& parent, int start,
                                    int end) {
   QListView::rowsInserted(parent, start, end);
-  LayoutItems();
+
+  // Results usually arrive a few at a time, so only the items after the new
+  // ones move.
+  LayoutItemsFrom(start);
+}
+
+void GroupedIconView::RowsRemoved(const QModelIndex&, int start, int) {
+  LayoutItemsFrom(start);
 }
 
 void GroupedIconView::dataChanged(const QModelIndex& topLeft,
                                   const QModelIndex& bottomRight, const QVector<int> &) {
   QListView::dataChanged(topLeft, bottomRight);
-  LayoutItems();
+
+  // Most changes are to icons that stay the same size, which don't move
+  // anything.
+  const QStyleOptionViewItem option(viewOptions());
+  const int last_row = qMin(bottomRight.row(), visual_rects_.count() - 1);
+  for (int row = topLeft.row(); row <= last_row; ++row) {
+    const QModelIndex index(model()->index(row, 0));
+    const int header = HeaderForRow(row);
+    const QString group = header == -1 ? QString() : headers_[header].text;
+
+    if (ItemSize(option, index) != visual_rects_[row].size() ||
+        index.data(Role_Group).toString() != group) {
+      LayoutItemsFrom(row);
+      return;
+    }
+  }
+}
+
+void GroupedIconView::updateGeometries() {
+  QListView::updateGeometries();
+
+  // QListView sets the range for its own layout, not ours.
+  verticalScrollBar()->setRange(0, contents_height_ - viewport()->height());
 }
 
-void GroupedIconView::LayoutItems() {
+QSize GroupedIconView::ItemSize(const QStyleOptionViewItem& option,
+                                const QModelIndex& index) const {
+  // Asking QListView with rectForIndex() would make it lay out every item
+  // first.
+  return itemDelegate(index)->sizeHint(option, index);
+}
+
+void GroupedIconView::LayoutItems() { LayoutItemsFrom(0); }
+
+void GroupedIconView::LayoutItemsFrom(int first_row) {
   if (!model()) return;
 
   const int count = model()->rowCount();
+  first_row = qBound(0, first_row, visual_rects_.count());
 
   QString last_group;
   QPoint next_position(0, 0);
   int max_row_height = 0;
 
-  visual_rects_.clear();
+  visual_rects_.resize(first_row);
   visual_rects_.reserve(count);
-  headers_.clear();
+  while (!headers_.isEmpty() && headers_.last().first_row >= first_row) {
+    headers_.removeLast();
+  }
 
-  for (int i = 0; i < count; ++i) {
+  if (first_row == 0) {
+    max_item_height_ = 0;
+  } else {
+    // Carry on after the last item that's staying, on the same line.
+    if (!headers_.isEmpty()) last_group = headers_.last().text;
+
+    const QRect& last_rect = visual_rects_.last();
+    next_position = QPoint(last_rect.right() + 1, last_rect.top());
+    for (int i = first_row - 1;
+         i >= 0 && visual_rects_[i].top() == last_rect.top(); --i) {
+      max_row_height = qMax(max_row_height, visual_rects_[i].height());
+    }
+  }
+
+  const QStyleOptionViewItem option(viewOptions());
+  const int header_height = this->header_height();
+
+  for (int i = first_row; i < count; ++i) {
     const QModelIndex index(model()->index(i, 0));
     const QString group = index.data(Role_Group).toString();
-    const QSize size(rectForIndex(index).size());
+    const QSize size(ItemSize(option, index));
 
     // Is this the first item in a new group?
     if (group != last_group) {
@@ -155,7 +220,7 @@ void GroupedIconView::LayoutItems() {
 
       // Move the next item immediately below the header.
       next_position.setX(0);
-      next_position.setY(header.y + header_height() + header_indent_ +
+      next_position.setY(header.y + header_height + header_indent_ +
                          header_spacing_);
       max_row_height = 0;
     }
@@ -185,11 +250,12 @@ void GroupedIconView::LayoutItems() {
     // Update next index
     next_position.setX(this_position.x() + size.width());
     max_row_height = qMax(max_row_height, size.height());
+    max_item_height_ = qMax(max_item_height_, size.height());
   }
 
-  verticalScrollBar()->setRange(
-      0, next_position.y() + max_row_height - viewport()->height());
-  update();
+  contents_height_ = next_position.y() + max_row_height;
+  verticalScrollBar()->setRange(0, contents_height_ - viewport()->height());
+  viewport()->update();
 }
 
 QRect GroupedIconView::visualRect(const QModelIndex& index) const {
@@ -201,11 +267,9 @@ QRect GroupedIconView::visualRect(const QModelIndex& index) const {
 QModelIndex GroupedIconView::indexAt(const QPoint& p) const {
   const QPoint viewport_p = p + QPoint(horizontalOffset(), verticalOffset());
 
-  const int count = visual_rects_.count();
-  for (int i = 0; i < count; ++i) {
-    if (visual_rects_[i].contains(viewport_p)) {
-      return model()->index(i, 0);
-    }
+  const QRect point_rect(viewport_p, QSize(1, 1));
+  for (const QModelIndex& index : IntersectingItems(point_rect)) {
+    if (visual_rects_[index.row()].contains(viewport_p)) return index;
   }
   return QModelIndex();
 }
@@ -274,11 +338,17 @@ void GroupedIconView::paintEvent(QPaintEvent* e) {
     itemDelegate()->paint(&painter, option, *it);
   }
 
-  // Draw headers
-  for (const Header& header : headers_) {
+  // Draw headers.  They're sorted by position too, so skip the ones above
+  // the area we're drawing and stop at the first one below it.
+  const int header_height = this->header_height();
+  auto it = std::lower_bound(
+      headers_.constBegin(), headers_.constEnd(),
+      viewport_rect.top() - header_height,
+      [](const Header& header, int y) { return header.y < y; });
+  for (; it != headers_.constEnd() && it->y <= viewport_rect.bottom(); ++it) {
     const QRect header_rect =
-        QRect(header_indent_, header.y,
-              viewport()->width() - header_indent_ * 2, header_height());
+        QRect(header_indent_, it->y,
+              viewport()->width() - header_indent_ * 2, header_height);
 
     // Is this header contained in the area we're drawing?
     if (!header_rect.intersects(viewport_rect)) {
@@ -288,8 +358,7 @@ void GroupedIconView::paintEvent(QPaintEvent* e) {
     // Draw the header
     DrawHeader(&painter,
                header_rect.translated(-horizontalOffset(), -verticalOffset()),
-               font(), palette(),
-               model()->index(header.first_row, 0).data(Role_Group).toString());
+               font(), palette(), it->text);
   }
 }
 
@@ -310,16 +379,28 @@ QVector<QModelIndex> GroupedIconView::IntersectingItems(const QRect& rect)
     const {
   QVector<QModelIndex> ret;
 
-  const int count = visual_rects_.count();
-  for (int i = 0; i < count; ++i) {
-    if (rect.intersects(visual_rects_[i])) {
-      ret.append(model()->index(i, 0));
+  // Only items whose tops are between these can reach the rect.
+  auto it = std::lower_bound(
+      visual_rects_.constBegin(), visual_rects_.constEnd(),
+      rect.top() - max_item_height_,
+      [](const QRect& item, int y) { return item.top() < y; });
+  for (; it != visual_rects_.constEnd() && it->top() <= rect.bottom(); ++it) {
+    if (rect.intersects(*it)) {
+      ret.append(model()->index(it - visual_rects_.constBegin(), 0));
     }
   }
 
   return ret;
 }
 
+int GroupedIconView::HeaderForRow(int row) const {
+  auto it = std::upper_bound(
+      headers_.constBegin(), headers_.constEnd(), row,
+      [](int r, const Header& header) { return r < header.first_row; });
+  if (it == headers_.constBegin()) return -1;
+  return (it - 1) - headers_.constBegin();
+}
+
 QRegion GroupedIconView::visualRegionForSelection(
     const QItemSelection& selection) const {
   QRegion ret;
@@ -72,6 +72,7 @@ class GroupedIconView : public QListView {
   void resizeEvent(QResizeEvent* e);
 
   // QAbstractItemView
+  void updateGeometries();
   void dataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& = QVector<int>());
   QModelIndex indexAt(const QPoint& p) const;
   void rowsInserted(const QModelIndex& parent, int start, int end);
@@ -82,6 +83,7 @@ class GroupedIconView : public QListView {
 
  private slots:
   void LayoutItems();
+  void RowsRemoved(const QModelIndex& parent, int start, int end);
 
  private:
   static const int kBarThickness;
@@ -93,15 +95,27 @@ class GroupedIconView : public QListView {
     QString text;
   };
 
+  // Lays out the items from first_row on, carrying on from where the items
+  // before it were put.  Rows before first_row must not have changed.
+  void LayoutItemsFrom(int first_row);
+  QSize ItemSize(const QStyleOptionViewItem& option,
+                 const QModelIndex& index) const;
+
   // Returns the items that are wholly or partially inside the rect.
   QVector<QModelIndex> IntersectingItems(const QRect& rect) const;
+  // Returns the header of the group the row is in, or -1 if it's ungrouped.
+  int HeaderForRow(int row) const;
 
   // Returns the index of the item above (d=-1) or below (d=+1) the given item.
   int IndexAboveOrBelow(int index, int d) const;
 
   MultiSortFilterProxy* proxy_model_;
+  // Items are laid out in row order, so the tops of their rects are sorted.
   QVector<QRect> visual_rects_;
   QVector<Header> headers_;
+  // The tallest item, so the items in a rect can be found by their tops.
+  int max_item_height_;
+  int contents_height_;
 
   const int default_header_height_;
   int header_spacing_;
@@ -31,7 +31,10 @@
 
 #include "fullscreenhypnotoad.h"
 #include "core/application.h"
+#include "core/closure.h"
 #include "core/logging.h"
+#include "core/memoryaccounting.h"
+#include "core/taskexecutor.h"
 #include "covers/albumcoverloader.h"
 #include "covers/coverproviders.h"
 #include "covers/currentartloader.h"
@@ -61,6 +64,8 @@ const int NowPlayingWidget::kBottomOffset = 0;
 // Border for large mode
 const int NowPlayingWidget::kTopBorder = 4;
 
+const int NowPlayingWidget::kCoverCacheSizeKb = 16 * 1024;
+
 NowPlayingWidget::NowPlayingWidget(QWidget* parent)
     : QWidget(parent),
       app_(nullptr),
@@ -74,6 +79,9 @@ NowPlayingWidget::NowPlayingWidget(QWidget* parent)
       fit_width_(false),
       show_hide_animation_(new QTimeLine(500, this)),
       fade_animation_(new QTimeLine(1000, this)),
+      scaled_covers_(kCoverCacheSizeKb),
+      cover_key_(0, 0),
+      cover_scale_id_(0),
       details_(new QTextDocument(this)),
       previous_track_opacity_(0.0),
       bask_in_his_glory_action_(nullptr),
@@ -170,6 +178,17 @@ NowPlayingWidget::NowPlayingWidget(QWidget* parent)
 
   connect(album_cover_choice_controller_, SIGNAL(AutomaticCoverSearchDone()),
           this, SLOT(AutomaticCoverSearchDone()));
+
+  // Trimming only drops covers that can be scaled again, so the cache can
+  // grow back afterwards.
+  MemoryAccounting::Instance()->Register(
+      this, "now_playing_covers", "Scaled now playing covers",
+      [this]() { return qint64(scaled_covers_.totalCost()) * 1024; },
+      [this](qint64 bytes) {
+        scaled_covers_.setMaxCost(int(bytes / 1024));
+        scaled_covers_.setMaxCost(kCoverCacheSizeKb);
+      },
+      MemoryAccounting::Priority_Disposable);
 }
 
 NowPlayingWidget::~NowPlayingWidget() {}
@@ -299,8 +318,49 @@ void NowPlayingWidget::UpdateDetailsText() {
 }
 
 void NowPlayingWidget::ScaleCover() {
-  cover_ = QPixmap::fromImage(
-      AlbumCoverLoader::ScaleAndPad(cover_loader_options_, original_));
+  const CoverKey key(original_.cacheKey(),
+                     cover_loader_options_.desired_height_);
+  if (key == cover_key_ && !cover_.isNull()) return;
+
+  const bool same_cover = key.first == cover_key_.first && !cover_.isNull();
+  cover_key_ = key;
+  const int id = ++cover_scale_id_;
+
+  if (QPixmap* cached = scaled_covers_.object(key)) {
+    cover_ = *cached;
+    update();
+    return;
+  }
+
+  // While the widget is being resized the old pixmap stretched to the new
+  // size is good enough until the smooth one is ready.  A new cover needs
+  // something to show straight away, so do a quick, rough scale.
+  if (!same_cover) {
+    cover_ = QPixmap::fromImage(AlbumCoverLoader::ScaleAndPad(
+        cover_loader_options_, original_, Qt::FastTransformation));
+  }
+  update();
+
+  if (original_.isNull()) return;
+
+  const AlbumCoverLoaderOptions options = cover_loader_options_;
+  const QImage original = original_;
+  QFuture<QImage> future = TaskExecutor::Instance()->Run<QImage>(
+      TaskExecutor::Lane_Interactive, [options, original]() {
+        return AlbumCoverLoader::ScaleAndPad(options, original);
+      });
+  NewClosure(future, this, SLOT(CoverScaled(QFuture<QImage>, int)), future,
+             id);
+}
+
+void NowPlayingWidget::CoverScaled(QFuture<QImage> future, int id) {
+  // Something newer has been asked for since.
+  if (id != cover_scale_id_) return;
+
+  QPixmap* pixmap = new QPixmap(QPixmap::fromImage(future.result()));
+  cover_ = *pixmap;
+  scaled_covers_.insert(cover_key_, pixmap,
+                        pixmap->width() * pixmap->height() * 4 / 1024);
   update();
 }
 
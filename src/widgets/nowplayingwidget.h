@@ -20,6 +20,10 @@
 
 #include <memory>
 
+#include <QCache>
+#include <QFuture>
+#include <QPair>
+
 #include <QWidget>
 
 #include "core/song.h"
@@ -51,6 +55,7 @@ class NowPlayingWidget : public QWidget {
   static const int kMaxCoverSize;
   static const int kBottomOffset;
   static const int kTopBorder;
+  static const int kCoverCacheSizeKb;
 
   // Values are saved in QSettings
   enum Mode {
@@ -109,6 +114,8 @@ signals:
 
   void AutomaticCoverSearchDone();
 
+  void CoverScaled(QFuture<QImage> future, int id);
+
  private:
   void CreateModeAction(Mode mode, const QString& text, QActionGroup* group);
   void UpdateDetailsText();
@@ -142,6 +149,14 @@ signals:
   QPixmap cover_;
   // A copy of the original, unscaled album cover.
   QImage original_;
+
+  // Covers are scaled in the background and kept here, keyed by the
+  // original's cacheKey() and the height, so resizing the widget back and
+  // forth doesn't scale the same cover again.
+  typedef QPair<qint64, int> CoverKey;
+  QCache<CoverKey, QPixmap> scaled_covers_;
+  CoverKey cover_key_;
+  int cover_scale_id_;
   QTextDocument* details_;
 
   // Holds the last track while we're fading to the new track
@@ -65,6 +65,7 @@ OSDPretty::OSDPretty(Mode mode, QWidget* parent)
       popup_screen_(nullptr),
       font_(QFont()),
       disable_duration_(false),
+      icon_source_key_(0),
       timeout_(new QTimer(this)),
       fading_enabled_(false),
       fader_(new QTimeLine(300, this)),
@@ -159,6 +160,7 @@ void OSDPretty::Load() {
   foreground_color_ = QColor(s.value("foreground_color", 0).toInt());
   background_color_ = QColor(s.value("background_color", kPresetBlue).toInt());
   background_opacity_ = s.value("background_opacity", 0.85).toDouble();
+  background_layer_ = QPixmap();
   font_.fromString(s.value("font", "Verdana,9,-1,5,50,0,0,0,0,0").toString());
   disable_duration_ = s.value("disable_duration", false).toBool();
 
@@ -208,7 +210,23 @@ QRect OSDPretty::BoxBorder() const {
 }
 
 void OSDPretty::paintEvent(QPaintEvent*) {
+  const qreal ratio = devicePixelRatioF();
+  if (background_layer_.isNull() ||
+      background_layer_.size() != size() * ratio) {
+    RenderBackgroundLayer();
+  }
+
   QPainter p(this);
+  p.drawPixmap(0, 0, background_layer_);
+}
+
+void OSDPretty::RenderBackgroundLayer() {
+  const qreal ratio = devicePixelRatioF();
+  background_layer_ = QPixmap(size() * ratio);
+  background_layer_.setDevicePixelRatio(ratio);
+  background_layer_.fill(Qt::transparent);
+
+  QPainter p(&background_layer_);
   p.setRenderHint(QPainter::Antialiasing);
   p.setRenderHint(QPainter::HighQualityAntialiasing);
 
@@ -266,10 +284,15 @@ void OSDPretty::SetMessage(const QString& summary, const QString& message,
                            const QImage& image) {
 
   if (!image.isNull()) {
-    QImage scaled_image =
-        image.scaled(kMaxIconSize, kMaxIconSize, Qt::KeepAspectRatio,
-                     Qt::SmoothTransformation);
-    ui_->icon->setPixmap(QPixmap::fromImage(scaled_image));
+    // Updates for the same track usually come with the same cover, so only
+    // scale it when it changes.
+    if (image.cacheKey() != icon_source_key_) {
+      QImage scaled_image =
+          image.scaled(kMaxIconSize, kMaxIconSize, Qt::KeepAspectRatio,
+                       Qt::SmoothTransformation);
+      ui_->icon->setPixmap(QPixmap::fromImage(scaled_image));
+      icon_source_key_ = image.cacheKey();
+    }
     ui_->icon->show();
   } else {
     ui_->icon->hide();
@@ -486,11 +509,13 @@ QPoint OSDPretty::current_pos() const {
 
 void OSDPretty::set_background_color(QRgb color) {
   background_color_ = color;
+  background_layer_ = QPixmap();
   if (isVisible()) update();
 }
 
 void OSDPretty::set_background_opacity(qreal opacity) {
   background_opacity_ = opacity;
+  background_layer_ = QPixmap();
   if (isVisible()) update();
 }
 
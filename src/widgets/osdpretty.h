@@ -103,6 +103,8 @@ class OSDPretty : public QWidget {
   void Load();
 
   QRect BoxBorder() const;
+  // Draws the shadow, box and border into background_layer_.
+  void RenderBackgroundLayer();
 
  private slots:
   void FaderValueChanged(qreal value);
@@ -131,6 +133,13 @@ class OSDPretty : public QWidget {
   QPixmap shadow_corner_[4];
   QPixmap background_;
 
+  // Everything behind the text, drawn once and reused until the size or the
+  // colours change.
+  QPixmap background_layer_;
+
+  // The cacheKey() of the image the icon was last scaled from.
+  qint64 icon_source_key_;
+
   // For dragging the OSD
   QPoint original_window_pos_;
   QPoint drag_start_pos_;
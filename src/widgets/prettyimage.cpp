@@ -31,11 +31,11 @@
 #include <QScrollArea>
 #include <QSettings>
 #include <QWindow>
-#include <QtConcurrentRun>
 
 #include "core/closure.h"
 #include "core/logging.h"
 #include "core/network.h"
+#include "core/taskexecutor.h"
 #include "ui/iconloader.h"
 
 const int PrettyImage::kTotalHeight = 200;
@@ -96,9 +96,12 @@ void PrettyImage::ImageFetched(RedirectFollower* follower) {
     state_ = State_CreatingThumbnail;
     image_ = image;
 
-    QFuture<QImage> future =
-        QtConcurrent::run(image_, &QImage::scaled, image_size(),
-                          Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    const QSize size = image_size();
+    QFuture<QImage> future = TaskExecutor::Instance()->Run<QImage>(
+        TaskExecutor::Lane_Interactive, [image, size]() {
+          return image.scaled(size, Qt::KeepAspectRatio,
+                              Qt::SmoothTransformation);
+        });
     NewClosure(future, this, SLOT(ImageScaled(QFuture<QImage>)), future);
   }
 }
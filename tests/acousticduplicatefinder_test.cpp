@@ -0,0 +1,71 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "library/acousticduplicatefinder.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+typedef AcousticDuplicateFinder::Fingerprint Fingerprint;
+
+// A repeatable stand-in for a real fingerprint.
+Fingerprint RandomFingerprint(quint32 seed, int frames) {
+  Fingerprint ret(frames);
+  quint32 state = seed;
+  for (int i = 0; i < frames; ++i) {
+    state = state * 1664525 + 1013904223;
+    ret[i] = state;
+  }
+  return ret;
+}
+
+TEST(AcousticDuplicateFinderTest, IdenticalFingerprintsMatch) {
+  const Fingerprint a =
+      RandomFingerprint(1, AcousticDuplicateFinder::kFingerprintFrames);
+  EXPECT_TRUE(AcousticDuplicateFinder::Matches(a, a));
+}
+
+TEST(AcousticDuplicateFinderTest, ShiftedFingerprintsMatch) {
+  const int frames = AcousticDuplicateFinder::kFingerprintFrames;
+  const Fingerprint a = RandomFingerprint(1, frames + 4);
+  const Fingerprint b = a.mid(4);
+  EXPECT_TRUE(AcousticDuplicateFinder::Matches(a.mid(0, frames), b));
+  EXPECT_TRUE(AcousticDuplicateFinder::Matches(b, a.mid(0, frames)));
+}
+
+TEST(AcousticDuplicateFinderTest, SlightlyDifferentFingerprintsMatch) {
+  const Fingerprint a =
+      RandomFingerprint(1, AcousticDuplicateFinder::kFingerprintFrames);
+  Fingerprint b = a;
+  for (int i = 0; i < b.count(); i += 3) {
+    b[i] ^= 1 << (i % 32);
+  }
+  EXPECT_TRUE(AcousticDuplicateFinder::Matches(a, b));
+}
+
+TEST(AcousticDuplicateFinderTest, DifferentFingerprintsDontMatch) {
+  const int frames = AcousticDuplicateFinder::kFingerprintFrames;
+  EXPECT_FALSE(AcousticDuplicateFinder::Matches(RandomFingerprint(1, frames),
+                                                RandomFingerprint(2, frames)));
+}
+
+TEST(AcousticDuplicateFinderTest, ShortFingerprintsDontMatch) {
+  const Fingerprint a = RandomFingerprint(1, 4);
+  EXPECT_FALSE(AcousticDuplicateFinder::Matches(a, a));
+}
+
+}  // namespace
@@ -37,17 +37,20 @@ class AlbumCoverManagerTest : public ::testing::Test {
 
 TEST_F(AlbumCoverManagerTest, HidesItemsWithCover) {
   QListWidgetItem hidden_item;
+  hidden_item.setData(AlbumCoverManager::Role_PathManual, "/tmp/cover.jpg");
   EXPECT_TRUE(manager_.ShouldHide(hidden_item, QString(), AlbumCoverManager::Hide_WithCovers));
   QListWidgetItem shown_item;
-  shown_item.setIcon(manager_.no_cover_icon_);
+  EXPECT_FALSE(manager_.ShouldHide(shown_item, QString(), AlbumCoverManager::Hide_WithCovers));
+  shown_item.setData(AlbumCoverManager::Role_PathManual,
+                     Song::kManuallyUnsetCover);
   EXPECT_FALSE(manager_.ShouldHide(shown_item, QString(), AlbumCoverManager::Hide_WithCovers));
 }
 
 TEST_F(AlbumCoverManagerTest, HidesItemsWithoutCover) {
   QListWidgetItem hidden_item;
-  hidden_item.setIcon(manager_.no_cover_icon_);
   EXPECT_TRUE(manager_.ShouldHide(hidden_item, QString(), AlbumCoverManager::Hide_WithoutCovers));
   QListWidgetItem shown_item;
+  shown_item.setData(AlbumCoverManager::Role_PathAutomatic, "/tmp/cover.jpg");
   EXPECT_FALSE(manager_.ShouldHide(shown_item, QString(), AlbumCoverManager::Hide_WithoutCovers));
 }
 
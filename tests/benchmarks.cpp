@@ -0,0 +1,247 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Timings for the operations that get slow on big libraries.  Each test
+// records "items" and "elapsed_usec" properties, so
+//   clementine_benchmarks --gtest_output=xml:results.xml
+// gives results that can be compared between builds.  Set
+// CLEMENTINE_BENCHMARK_SONGS to change the size of the library.
+
+#include <memory>
+
+#include "synthetic_library.h"
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include "analyzers/fht.h"
+#include "core/database.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "library/librarymodel.h"
+#include "library/libraryquery.h"
+#include "playlist/playlist.h"
+#include "playlist/playlistsequence.h"
+#include "playlistparsers/m3uparser.h"
+
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QSortFilterProxyModel>
+#include <QVector>
+
+#include <cmath>
+
+namespace {
+
+void RecordTiming(const QElapsedTimer& timer, int items) {
+  ::testing::Test::RecordProperty("items", items);
+  ::testing::Test::RecordProperty(
+      "elapsed_usec", static_cast<int>(timer.nsecsElapsed() / 1000));
+}
+
+class LibraryBenchmark : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    songs_ = new SongList(SyntheticLibrary(SyntheticLibrarySize()));
+  }
+
+  static void TearDownTestCase() {
+    delete songs_;
+    songs_ = nullptr;
+  }
+
+  void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_, Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    backend_->AddDirectory("/synthetic");
+  }
+
+  void PopulateLibrary() { backend_->AddOrUpdateSongs(*songs_); }
+
+  static SongList* songs_;
+
+  std::shared_ptr<Database> database_;
+  std::shared_ptr<LibraryBackend> backend_;
+};
+
+SongList* LibraryBenchmark::songs_ = nullptr;
+
+TEST_F(LibraryBenchmark, AddOrUpdateSongs) {
+  QElapsedTimer timer;
+  timer.start();
+  backend_->AddOrUpdateSongs(*songs_);
+  RecordTiming(timer, songs_->count());
+
+  EXPECT_EQ(songs_->count(), backend_->GetStatistics().songs);
+}
+
+TEST_F(LibraryBenchmark, UpdateUnchangedSongs) {
+  PopulateLibrary();
+
+  QElapsedTimer timer;
+  timer.start();
+  backend_->AddOrUpdateSongs(*songs_);
+  RecordTiming(timer, songs_->count());
+}
+
+TEST_F(LibraryBenchmark, LibraryModelPopulation) {
+  PopulateLibrary();
+  LibraryModel model(backend_, nullptr);
+
+  // Load the artists and then every artist's albums, as if the user had
+  // expanded them all.
+  QElapsedTimer timer;
+  timer.start();
+  model.Init(false);
+  for (int row = 0; row < model.rowCount(QModelIndex()); ++row) {
+    const QModelIndex index = model.index(row, 0);
+    if (model.canFetchMore(index)) model.fetchMore(index);
+  }
+  RecordTiming(timer, songs_->count());
+
+  EXPECT_GT(model.rowCount(QModelIndex()), 0);
+}
+
+TEST_F(LibraryBenchmark, FtsSearch) {
+  PopulateLibrary();
+  const QStringList kQueries = QStringList() << "artist 1"
+                                             << "title 12"
+                                             << "album"
+                                             << "rock"
+                                             << "compilation art";
+
+  QElapsedTimer timer;
+  timer.start();
+  int results = 0;
+  for (const QString& filter : kQueries) {
+    QueryOptions options;
+    options.set_filter(filter);
+    LibraryQuery query(options);
+    results += backend_->ExecLibraryQuery(&query).count();
+  }
+  RecordTiming(timer, kQueries.count());
+
+  EXPECT_GT(results, 0);
+}
+
+TEST_F(LibraryBenchmark, ParseM3U) {
+  // Local files are looked up in the library, so parse with one that has them.
+  PopulateLibrary();
+  QByteArray data = SyntheticM3U(*songs_);
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::ReadOnly);
+  M3UParser parser(backend_.get());
+
+  QElapsedTimer timer;
+  timer.start();
+  const SongList songs = parser.Load(&buffer);
+  RecordTiming(timer, songs.count());
+
+  EXPECT_EQ(songs_->count(), songs.count());
+}
+
+class PlaylistBenchmark : public LibraryBenchmark {
+ protected:
+  PlaylistBenchmark() : playlist_(nullptr, nullptr, nullptr, 1) {}
+
+  Playlist playlist_;
+};
+
+TEST_F(PlaylistBenchmark, Insert) {
+  QElapsedTimer timer;
+  timer.start();
+  playlist_.InsertSongs(*songs_);
+  RecordTiming(timer, songs_->count());
+
+  EXPECT_EQ(songs_->count(), playlist_.rowCount(QModelIndex()));
+}
+
+TEST_F(PlaylistBenchmark, InsertInMiddle) {
+  const int half = songs_->count() / 2;
+  playlist_.InsertSongs(songs_->mid(0, half));
+
+  QElapsedTimer timer;
+  timer.start();
+  playlist_.InsertSongs(songs_->mid(half), half / 2);
+  RecordTiming(timer, songs_->count() - half);
+
+  EXPECT_EQ(songs_->count(), playlist_.rowCount(QModelIndex()));
+}
+
+TEST_F(PlaylistBenchmark, InsertShuffled) {
+  PlaylistSequence sequence;
+  sequence.SetShuffleMode(PlaylistSequence::Shuffle_All);
+  playlist_.set_sequence(&sequence);
+
+  QElapsedTimer timer;
+  timer.start();
+  playlist_.InsertSongs(*songs_);
+  RecordTiming(timer, songs_->count());
+
+  EXPECT_EQ(songs_->count(), playlist_.rowCount(QModelIndex()));
+}
+
+TEST_F(PlaylistBenchmark, Sort) {
+  playlist_.InsertSongs(*songs_);
+
+  QElapsedTimer timer;
+  timer.start();
+  playlist_.sort(Playlist::Column_Artist, Qt::AscendingOrder);
+  playlist_.sort(Playlist::Column_Title, Qt::DescendingOrder);
+  RecordTiming(timer, songs_->count());
+}
+
+TEST_F(PlaylistBenchmark, Filter) {
+  playlist_.InsertSongs(*songs_);
+  QSortFilterProxyModel* proxy = playlist_.proxy();
+
+  // Typing a filter one character at a time, then clearing it.
+  QElapsedTimer timer;
+  timer.start();
+  const QString kFilter = "artist 12";
+  for (int i = 1; i <= kFilter.length(); ++i) {
+    proxy->setFilterFixedString(kFilter.left(i));
+  }
+  proxy->setFilterFixedString(QString());
+  RecordTiming(timer, songs_->count());
+
+  EXPECT_EQ(songs_->count(), proxy->rowCount());
+}
+
+TEST(FHTBenchmark, LogSpectrum) {
+  const int kFrames = 100000;
+
+  FHT fht(9);
+  QVector<float> input(fht.size());
+  for (int i = 0; i < input.size(); ++i) {
+    input[i] = std::sin(i * 0.3) + 0.5 * std::cos(i * 1.7);
+  }
+  QVector<float> data(fht.size());
+  QVector<float> out(fht.size());
+
+  QElapsedTimer timer;
+  timer.start();
+  for (int i = 0; i < kFrames; ++i) {
+    data = input;
+    data.detach();
+    fht.logSpectrum(out.data(), data.data());
+    fht.scale(out.data(), 1.0 / 20);
+  }
+  RecordTiming(timer, kFrames);
+}
+
+}  // namespace
@@ -148,3 +148,42 @@ TEST_F(DatabaseTest, FTSCursorWorks) {
   rc = Database::FTSNext(cursor, &token, &bytes, &start_offset, &end_offset, &position);
   EXPECT_EQ(SQLITE_DONE, rc);
 }
+
+TEST_F(DatabaseTest, FTS5TableUsesUnicodeTokenizer) {
+  QSqlDatabase db = database_->Connect();
+  QSqlQuery insert(db);
+  insert.prepare(
+      "INSERT INTO songs_fts (ROWID, ftstitle, ftsartist)"
+      " VALUES (?, ?, ?)");
+  insert.addBindValue(1);
+  insert.addBindValue("Eple");
+  insert.addBindValue(QString::fromUtf8("Röyksopp"));
+  ASSERT_TRUE(insert.exec());
+
+  QSqlQuery q(db);
+  q.prepare("SELECT ROWID FROM songs_fts WHERE songs_fts MATCH ?");
+  q.addBindValue("ftsartist:royk*");
+  ASSERT_TRUE(q.exec());
+  ASSERT_TRUE(q.next());
+  EXPECT_EQ(1, q.value(0).toInt());
+  EXPECT_FALSE(q.next());
+}
+
+TEST_F(DatabaseTest, ArtistAlbumQueriesUseCoveringIndex) {
+  QSqlQuery q(database_->Connect());
+  q.prepare(
+      "EXPLAIN QUERY PLAN SELECT DISTINCT album FROM songs"
+      " WHERE artist = ? AND +effective_compilation = 0 AND unavailable = 0");
+  q.addBindValue("foo");
+  ASSERT_TRUE(q.exec());
+  ASSERT_TRUE(q.next());
+  EXPECT_TRUE(q.value(3).toString().contains("COVERING INDEX"));
+}
+
+TEST_F(DatabaseTest, InjectedDatabaseHasNoReadConnections) {
+  // Every connection to :memory: is a separate database, so readers have to
+  // share the main one and its mutex.
+  EXPECT_EQ(database_->Mutex(), database_->ReadMutex());
+  EXPECT_EQ(database_->Connect().connectionName(),
+            database_->ConnectForReading().connectionName());
+}
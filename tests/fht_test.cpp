@@ -0,0 +1,126 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "analyzers/fht.h"
+
+#include <cmath>
+
+#include <QElapsedTimer>
+#include <QVector>
+#include <QtDebug>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+QVector<float> TestSignal(int n) {
+  QVector<float> ret(n);
+  for (int i = 0; i < n; ++i) {
+    ret[i] = std::sin(i * 0.3) + 0.5 * std::cos(i * 1.7) + (i % 7) * 0.01;
+  }
+  return ret;
+}
+
+// |X_k|^2 from a straightforward DFT.
+QVector<double> NaivePower(const QVector<float>& x) {
+  const int n = x.size();
+  QVector<double> ret(n / 2);
+  for (int k = 0; k < n / 2; ++k) {
+    double re = 0, im = 0;
+    for (int t = 0; t < n; ++t) {
+      re += x[t] * std::cos(2 * M_PI * k * t / n);
+      im -= x[t] * std::sin(2 * M_PI * k * t / n);
+    }
+    ret[k] = re * re + im * im;
+  }
+  return ret;
+}
+
+class FHTTest : public ::testing::TestWithParam<int> {};
+
+TEST_P(FHTTest, PowerMatchesDFT) {
+  FHT fht(GetParam());
+  QVector<float> data = TestSignal(fht.size());
+  const QVector<double> expected = NaivePower(data);
+
+  fht.power(data.data());
+
+  for (int k = 0; k < fht.size() / 2; ++k) {
+    EXPECT_NEAR(expected[k], data[k], 1e-3 * (1 + expected[k])) << "k = " << k;
+  }
+}
+
+TEST_P(FHTTest, Scale) {
+  FHT fht(GetParam());
+  QVector<float> data = TestSignal(fht.size());
+  const QVector<float> original = data;
+
+  fht.scale(data.data(), 0.25);
+
+  for (int i = 0; i < fht.size() / 2; ++i) {
+    EXPECT_FLOAT_EQ(original[i] * 0.25f, data[i]);
+  }
+  for (int i = fht.size() / 2; i < fht.size(); ++i) {
+    EXPECT_EQ(original[i], data[i]);
+  }
+}
+
+TEST_P(FHTTest, Ewma) {
+  FHT fht(GetParam());
+  QVector<float> d(fht.size(), 1.0);
+  QVector<float> s = TestSignal(fht.size());
+
+  fht.ewma(d.data(), s.data(), 0.75);
+
+  for (int i = 0; i < fht.size() / 2; ++i) {
+    EXPECT_FLOAT_EQ(0.75f + s[i] * 0.25f, d[i]);
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Sizes, FHTTest, ::testing::Values(4, 5, 6, 9));
+
+// Run with --gtest_also_run_disabled_tests to compare builds and hosts.
+TEST(FHTBenchmark, DISABLED_Analyzer) {
+  const int kIterations = 100000;
+
+  FHT fht(9);
+  const QVector<float> input = TestSignal(fht.size());
+  QVector<float> data(fht.size());
+  QVector<float> out(fht.size());
+
+  QElapsedTimer timer;
+  timer.start();
+  for (int i = 0; i < kIterations; ++i) {
+    data = input;
+    data.detach();
+    fht.logSpectrum(out.data(), data.data());
+    fht.scale(out.data(), 1.0 / 20);
+  }
+  qDebug() << "logSpectrum + scale:" << timer.nsecsElapsed() / kIterations
+           << "ns per frame";
+
+  timer.restart();
+  for (int i = 0; i < kIterations; ++i) {
+    data = input;
+    data.detach();
+    fht.spectrum(data.data());
+  }
+  qDebug() << "spectrum:" << timer.nsecsElapsed() / kIterations
+           << "ns per frame";
+}
+
+}  // namespace
@@ -0,0 +1,82 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "core/fileexistencecache.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class FileExistenceCacheTest : public ::testing::Test {
+ protected:
+  QString Touch(const QString& name) {
+    const QString path = dir_.path() + "/" + name;
+    QFile file(path);
+    file.open(QIODevice::WriteOnly);
+    return path;
+  }
+
+  QTemporaryDir dir_;
+};
+
+TEST_F(FileExistenceCacheTest, ChecksUnknownPaths) {
+  FileExistenceCache cache;
+  QStringList paths;
+  for (int i = 0; i < 20; ++i) {
+    paths << (i % 3 ? Touch(QString::number(i))
+                    : dir_.path() + "/missing" + QString::number(i));
+  }
+
+  const QVector<bool> exists = cache.Exists(paths);
+  ASSERT_EQ(paths.count(), exists.count());
+  for (int i = 0; i < paths.count(); ++i) {
+    EXPECT_EQ(i % 3 != 0, exists[i]) << paths[i].toStdString();
+  }
+}
+
+TEST_F(FileExistenceCacheTest, RemembersResults) {
+  FileExistenceCache cache;
+  const QString path = Touch("song.mp3");
+  EXPECT_TRUE(cache.Exists(QStringList() << path)[0]);
+
+  QFile::remove(path);
+  EXPECT_TRUE(cache.Exists(QStringList() << path)[0]);
+}
+
+TEST_F(FileExistenceCacheTest, UsesRecordedResults) {
+  FileExistenceCache cache;
+  const QString path = Touch("song.mp3");
+  cache.Record(path, false);
+  EXPECT_FALSE(cache.Exists(QStringList() << path)[0]);
+}
+
+TEST_F(FileExistenceCacheTest, ExpiresResults) {
+  FileExistenceCache cache(0);
+  const QString path = Touch("song.mp3");
+  cache.Record(path, false);
+
+  // A zero TTL keeps nothing for longer than the current millisecond, so give
+  // the clock a chance to move on.
+  QThread::msleep(2);
+  EXPECT_TRUE(cache.Exists(QStringList() << path)[0]);
+}
+
+}  // namespace
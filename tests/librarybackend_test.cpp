@@ -21,6 +21,7 @@
 #include "gtest/gtest.h"
 
 #include <QFileInfo>
+#include <QSet>
 #include <QSignalSpy>
 #include <QThread>
 #include <QtDebug>
@@ -126,9 +127,216 @@ TEST_F(LibraryBackendTest, AddInvalidSong) {
   ASSERT_EQ(0, spy.count());
 }
 
+TEST_F(LibraryBackendTest, AddManySongs) {
+  // Enough songs to need several multi-row inserts
+  backend_->AddDirectory("/tmp");
+
+  SongList songs;
+  for (int i = 0; i < 100; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/%1.mp3").arg(i)));
+    song.set_title(QString("Title %1").arg(i));
+    songs << song;
+  }
+
+  QSignalSpy spy(backend_.get(), SIGNAL(SongsDiscovered(SongList)));
+  backend_->AddOrUpdateSongs(songs);
+
+  ASSERT_EQ(1, spy.count());
+  SongList added = spy[0][0].value<SongList>();
+  ASSERT_EQ(100, added.count());
+
+  QList<int> ids;
+  for (int i = 0; i < added.count(); ++i) {
+    EXPECT_EQ(songs[i].url(), added[i].url());
+    EXPECT_FALSE(ids.contains(added[i].id()));
+    ids << added[i].id();
+  }
+
+  SongList stored = backend_->GetSongsById(ids);
+  ASSERT_EQ(100, stored.count());
+  for (const Song& song : stored) {
+    EXPECT_EQ(song.title(), added[ids.indexOf(song.id())].title());
+  }
+}
+
+TEST_F(LibraryBackendTest, GetSongsByUrls) {
+  backend_->AddDirectory("/tmp");
+
+  SongList songs;
+  for (int i = 0; i < 100; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/%1.mp3").arg(i)));
+    songs << song;
+  }
+  backend_->AddOrUpdateSongs(songs);
+
+  // Enough URLs to need more than one query, with some repeated and most
+  // not in the library
+  QList<QUrl> urls;
+  for (int i = 0; i < 1500; ++i) {
+    urls << QUrl::fromLocalFile(QString("/tmp/%1.mp3").arg(i));
+  }
+  urls << songs[0].url();
+
+  SongList found = backend_->GetSongsByUrls(urls);
+  ASSERT_EQ(100, found.count());
+
+  QSet<QUrl> found_urls;
+  for (const Song& song : found) {
+    found_urls << song.url();
+  }
+  for (const Song& song : songs) {
+    EXPECT_TRUE(found_urls.contains(song.url()));
+  }
+}
+
 TEST_F(LibraryBackendTest, GetAlbumArtNonExistent) {
 }
 
+TEST_F(LibraryBackendTest, UpdateCompilationsInChangedDirectories) {
+  backend_->AddDirectory("/tmp");
+
+  SongList songs;
+  for (const QString& path : QStringList() << "/tmp/various/1.mp3"
+                                           << "/tmp/various/2.mp3"
+                                           << "/tmp/various/sub/3.mp3") {
+    Song song = MakeDummySong(1);
+    song.set_url(QUrl::fromLocalFile(path));
+    song.set_album("Album");
+    song.set_artist(path);
+    songs << song;
+  }
+  backend_->AddOrUpdateSongs(songs);
+  backend_->UpdateCompilations();
+
+  // The two songs in the same directory have different artists, the one in
+  // the subdirectory is on its own.
+  EXPECT_TRUE(backend_->GetSongById(1).is_compilation());
+  EXPECT_TRUE(backend_->GetSongById(2).is_compilation());
+  EXPECT_FALSE(backend_->GetSongById(3).is_compilation());
+
+  // Nothing changed, so there's nothing to update.
+  QSignalSpy spy(backend_.get(), SIGNAL(SongsDiscovered(SongList)));
+  backend_->UpdateCompilations();
+  EXPECT_EQ(0, spy.count());
+}
+
+TEST_F(LibraryBackendTest, StatisticsFollowChanges) {
+  backend_->AddDirectory("/tmp");
+
+  SongList songs;
+  for (int i = 0; i < 3; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/%1.mp3").arg(i)));
+    song.set_artist(i == 2 ? "Artist 2" : "Artist 1");
+    song.set_album(i == 2 ? "Album 2" : "Album 1");
+    song.set_length_nanosec(1000);
+    songs << song;
+  }
+  backend_->AddOrUpdateSongs(songs.mid(0, 2));
+
+  LibraryBackend::Statistics stats = backend_->GetStatistics();
+  EXPECT_EQ(2, stats.songs);
+  EXPECT_EQ(1, stats.artists);
+  EXPECT_EQ(1, stats.albums);
+  EXPECT_EQ(2000, stats.length_nanosec);
+
+  // Now the statistics are loaded they're updated without reading the table
+  backend_->AddOrUpdateSongs(songs.mid(2));
+  stats = backend_->GetStatistics();
+  EXPECT_EQ(3, stats.songs);
+  EXPECT_EQ(2, stats.artists);
+  EXPECT_EQ(2, stats.albums);
+
+  Song third = backend_->GetSongById(3);
+  ASSERT_TRUE(third.is_valid());
+  backend_->DeleteSongs(SongList() << third);
+  stats = backend_->GetStatistics();
+  EXPECT_EQ(2, stats.songs);
+  EXPECT_EQ(1, stats.artists);
+  EXPECT_EQ(1, stats.albums);
+  EXPECT_EQ(2000, stats.length_nanosec);
+}
+
+TEST_F(LibraryBackendTest, GetAllSongsInBatches) {
+  backend_->AddDirectory("/tmp");
+
+  const int count = LibraryBackend::kSongBatchSize + 10;
+  SongList songs;
+  for (int i = 0; i < count; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/%1.mp3").arg(i)));
+    songs << song;
+  }
+  backend_->AddOrUpdateSongs(songs);
+
+  QList<int> batch_sizes;
+  int last_id = 0;
+  bool ordered = true;
+  EXPECT_TRUE(backend_->GetAllSongs([&](const SongList& batch) {
+    batch_sizes << batch.count();
+    for (const Song& song : batch) {
+      ordered = ordered && song.id() > last_id;
+      last_id = song.id();
+    }
+    return true;
+  }));
+  EXPECT_EQ(QList<int>() << LibraryBackend::kSongBatchSize << 10, batch_sizes);
+  EXPECT_TRUE(ordered);
+
+  // Returning false stops after the first batch
+  batch_sizes.clear();
+  backend_->GetAllSongs([&](const SongList& batch) {
+    batch_sizes << batch.count();
+    return false;
+  });
+  EXPECT_EQ(1, batch_sizes.count());
+}
+
+TEST_F(LibraryBackendTest, RankedSearchInPages) {
+  backend_->AddDirectory("/tmp");
+
+  SongList songs;
+  for (int i = 0; i < 5; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/%1.mp3").arg(i)));
+    song.set_title(QString("Song %1").arg(i));
+    song.set_comment("needle");
+    songs << song;
+  }
+  // A match in the title ranks above matches in the comment.
+  songs[3].set_title("Needle");
+  songs[3].set_comment("");
+  backend_->AddOrUpdateSongs(songs);
+
+  QueryOptions options;
+  options.set_filter("needle");
+
+  QStringList titles;
+  QSet<QString> seen;
+  for (int offset = 0; offset < 6; offset += 2) {
+    LibraryQuery q(options);
+    q.SetColumnSpec("title");
+    q.SetOrderByRelevance();
+    q.SetLimit(2);
+    q.SetOffset(offset);
+    ASSERT_TRUE(backend_->ExecQuery(&q));
+
+    int rows = 0;
+    while (q.Next()) {
+      titles << q.Value(0).toString();
+      seen.insert(titles.last());
+      ++rows;
+    }
+    EXPECT_EQ(offset < 4 ? 2 : 1, rows);
+  }
+
+  ASSERT_EQ(5, titles.count());
+  EXPECT_EQ(5, seen.count());
+  EXPECT_EQ("Needle", titles[0]);
+}
+
 // Test adding a single song to the database, then getting various information
 // back about it.
 class SingleSong : public LibraryBackendTest {
@@ -331,4 +539,119 @@ TEST_F(SingleSong, MarkSongsUnavailable) {
   EXPECT_EQ(0, albums.size());
 }
 
+TEST_F(SingleSong, CancelledQueryReturnsNothing) {
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  LibraryQuery::CancelFlag cancel = std::make_shared<QAtomicInt>(0);
+  LibraryQuery q;
+  q.SetColumnSpec("title");
+  q.SetCancelFlag(cancel);
+  ASSERT_TRUE(backend_->ExecQuery(&q));
+
+  // Cancelling between rows stops the query
+  cancel->store(1);
+  EXPECT_FALSE(q.Next());
+
+  LibraryQuery q2;
+  q2.SetColumnSpec("title");
+  q2.SetCancelFlag(cancel);
+  EXPECT_FALSE(backend_->ExecQuery(&q2));
+}
+
+TEST_F(SingleSong, ReadSomeColumns) {
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  const QStringList columns = QStringList() << "album" << "title";
+  LibraryQuery q;
+  q.SetColumnSpec("%songs_table.ROWID, " + columns.join(", "));
+  ASSERT_TRUE(backend_->ExecQuery(&q));
+  ASSERT_TRUE(q.Next());
+
+  Song song;
+  song.InitFromQueryColumns(q, columns, true);
+  EXPECT_EQ(1, song.id());
+  EXPECT_EQ("Title", song.title());
+  EXPECT_EQ("Album", song.album());
+  EXPECT_TRUE(song.artist().isEmpty());
+}
+
+TEST_F(SingleSong, SongCacheSharesSongs) {
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  SongCache* cache = backend_->song_cache();
+  Song first = cache->Intern(backend_->GetSongById(1));
+  Song second = cache->Intern(backend_->GetSongById(1));
+  EXPECT_EQ(1, cache->count());
+  EXPECT_EQ(&first.title(), &second.title());
+
+  // Changes in the library replace the cached copy
+  Song new_song(song_);
+  new_song.set_id(1);
+  new_song.set_title("A different title");
+  backend_->AddOrUpdateSongs(SongList() << new_song);
+
+  Song third = cache->Intern(backend_->GetSongById(1));
+  EXPECT_EQ("A different title", third.title());
+  Song fourth = cache->Intern(backend_->GetSongById(1));
+  EXPECT_EQ(&third.title(), &fourth.title());
+  EXPECT_EQ("Title", first.title());
+}
+
+TEST_F(SingleSong, StoresSortKeys) {
+  song_.set_artist("The Artist");
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  LibraryQuery q;
+  q.SetColumnSpec("artist_sort_key, albumartist_sort_key, album_sort_key");
+  ASSERT_TRUE(backend_->ExecQuery(&q));
+  ASSERT_TRUE(q.Next());
+  EXPECT_EQ("artist, the", q.Value(0).toString());
+  EXPECT_EQ("artist, the", q.Value(1).toString());
+  EXPECT_EQ("album", q.Value(2).toString());
+}
+
+TEST_F(SingleSong, BatchesStatisticsChanges) {
+  AddDummySong();
+  if (HasFatalFailure()) return;
+
+  QSignalSpy statistics_spy(backend_.get(),
+                            SIGNAL(SongsStatisticsChanged(SongList)));
+  QSignalSpy rating_spy(backend_.get(), SIGNAL(SongsRatingChanged(SongList)));
+
+  backend_->IncrementPlayCountAsync(1);
+  backend_->IncrementPlayCountAsync(1);
+  backend_->IncrementSkipCountAsync(1, 0.5);
+  backend_->UpdateSongRatingAsync(1, 0.6);
+  backend_->UpdateSongRatingAsync(1, 0.8);
+  EXPECT_EQ(0, statistics_spy.count());
+
+  backend_->FlushStatistics();
+
+  // Everything is written together, with one signal each
+  ASSERT_EQ(1, statistics_spy.count());
+  ASSERT_EQ(1, rating_spy.count());
+
+  Song song = backend_->GetSongById(1);
+  EXPECT_EQ(2, song.playcount());
+  EXPECT_EQ(1, song.skipcount());
+  EXPECT_FLOAT_EQ(0.8, song.rating());
+}
+
+TEST_F(SingleSong, PublishesChanges) {
+  QSignalSpy spy(backend_.get(), SIGNAL(SongsChanged(LibraryChanges)));
+
+  AddDummySong();
+  if (HasFatalFailure()) return;
+  backend_->UpdateSongRating(1, 0.5);
+
+  ASSERT_EQ(2, spy.count());
+  LibraryChanges added = spy[0][0].value<LibraryChanges>();
+  LibraryChanges rated = spy[1][0].value<LibraryChanges>();
+  EXPECT_EQ(added.sequence + 1, rated.sequence);
+  EXPECT_EQ(QList<int>() << 1,
+            added.ids(LibraryChanges::Change_Discovered));
+  EXPECT_TRUE(rated.ids(LibraryChanges::Change_Discovered).isEmpty());
+  EXPECT_EQ(QList<int>() << 1, rated.ids(LibraryChanges::Change_Rating));
+}
+
 } // namespace
@@ -29,6 +29,8 @@
 #include <QThread>
 #include <QSignalSpy>
 #include <QSortFilterProxyModel>
+#include <QTemporaryDir>
+#include <QTest>
 
 namespace {
 
@@ -252,9 +254,63 @@ TEST_F(LibraryModelTest, RemoveSongsNotLazyLoaded) {
 
   backend_->DeleteSongs(SongList() << one << two);
 
-  ASSERT_EQ(0, spy_preremove.count());
-  ASSERT_EQ(0, spy_remove.count());
-  ASSERT_EQ(1, spy_reset.count());
+  // The artist is empty now, so it gets removed without resetting the model
+  ASSERT_EQ(0, spy_reset.count());
+  ASSERT_LT(0, spy_remove.count());
+  ASSERT_EQ(spy_preremove.count(), spy_remove.count());
+  EXPECT_EQ(0, model_->rowCount(QModelIndex()));
+}
+
+TEST_F(LibraryModelTest, RemoveSomeSongsNotLazyLoaded) {
+  Song one = AddSong("Title 1", "Artist", "Album", 123); one.set_id(1);
+  Song two = AddSong("Title 2", "Artist", "Album", 123); two.set_id(2);
+  model_->Init(false);
+  ASSERT_EQ(2, model_->rowCount(QModelIndex()));
+
+  QSignalSpy spy_remove(model_.get(), SIGNAL(rowsRemoved(QModelIndex,int,int)));
+  QSignalSpy spy_reset(model_.get(), SIGNAL(modelReset()));
+
+  backend_->DeleteSongs(SongList() << one);
+
+  // The artist still has a song in it
+  EXPECT_EQ(0, spy_reset.count());
+  EXPECT_EQ(0, spy_remove.count());
+  EXPECT_EQ(2, model_->rowCount(QModelIndex()));
+}
+
+TEST_F(LibraryModelTest, BatchedChanges) {
+  Song one = AddSong("Title 1", "Artist", "Album", 123); one.set_id(1);
+  model_->Init(false);
+
+  QModelIndex artist_index = model_->index(0, 0, QModelIndex());
+  model_->fetchMore(artist_index);
+  QModelIndex album_index = model_->index(0, 0, artist_index);
+  model_->fetchMore(album_index);
+  ASSERT_EQ(1, model_->rowCount(album_index));
+
+  // A big import is held back until the batch timer fires
+  SongList songs;
+  for (int i = 0; i < LibraryModel::kBatchChangesThreshold; ++i) {
+    Song song;
+    song.Init(QString("New %1").arg(i), "Artist", "Album", 123);
+    song.set_directory_id(1);
+    song.set_mtime(1);
+    song.set_ctime(1);
+    song.set_filesize(1);
+    song.set_url(QUrl(QString("file:///tmp/new%1").arg(i)));
+    songs << song;
+  }
+
+  QSignalSpy spy_reset(model_.get(), SIGNAL(modelReset()));
+  backend_->AddOrUpdateSongs(songs);
+  EXPECT_EQ(1, model_->rowCount(album_index));
+
+  QTest::qWait(LibraryModel::kBatchChangesMsec * 2);
+
+  // The songs were inserted into the expanded album
+  EXPECT_EQ(0, spy_reset.count());
+  EXPECT_EQ(LibraryModel::kBatchChangesThreshold + 1,
+            model_->rowCount(album_index));
 }
 
 TEST_F(LibraryModelTest, RemoveEmptyAlbums) {
@@ -304,4 +360,88 @@ TEST_F(LibraryModelTest, RemoveEmptyArtists) {
   ASSERT_EQ(0, model_->rowCount(QModelIndex()));
 }
 
+TEST_F(LibraryModelTest, PagedSongs) {
+  backend_->AddDirectory("/tmp");
+  added_dir_ = true;
+
+  SongList songs;
+  for (int i = 0; i < LibraryModel::kPageSize + 10; ++i) {
+    Song song;
+    song.Init(QString("Title %1").arg(i), "Artist", "Album", 123);
+    song.set_directory_id(1);
+    song.set_mtime(1);
+    song.set_ctime(1);
+    song.set_filesize(1);
+    song.set_url(QUrl(QString("file:///tmp/%1").arg(i)));
+    songs << song;
+  }
+  backend_->AddOrUpdateSongs(songs);
+  model_->Init(false);
+
+  QModelIndex artist_index = model_->index(0, 0, QModelIndex());
+  model_->fetchMore(artist_index);
+  QModelIndex album_index = model_->index(0, 0, artist_index);
+  model_->fetchMore(album_index);
+
+  // Only the first page is created until the view asks for more
+  EXPECT_EQ(LibraryModel::kPageSize, model_->rowCount(album_index));
+  EXPECT_TRUE(model_->canFetchMore(album_index));
+
+  model_->fetchMore(album_index);
+  EXPECT_EQ(LibraryModel::kPageSize + 10, model_->rowCount(album_index));
+  EXPECT_FALSE(model_->canFetchMore(album_index));
+
+  // Dragging the album still gets every song
+  EXPECT_EQ(LibraryModel::kPageSize + 10,
+            model_->GetChildSongs(album_index).count());
+}
+
+TEST_F(LibraryModelTest, ChildSongsLoaderMatchesTree) {
+  AddSong("Title 1", "The Artist", "Album B", 123);
+  AddSong("Title 2", "The Artist", "Album A", 123);
+  AddSong("Title 3", "Another", "Album", 123);
+  Song four;
+  four.Init("Title 4", "Someone", "Compilation", 123);
+  four.set_compilation(true);
+  AddSong(four);
+  model_->Init(false);
+
+  QModelIndexList indexes;
+  for (int i = 0; i < model_->rowCount(QModelIndex()); ++i) {
+    indexes << model_->index(i, 0, QModelIndex());
+  }
+
+  // Nothing under the top level has been loaded yet
+  SongList loaded = model_->ChildSongsLoader(indexes)();
+  SongList walked = model_->GetChildSongs(indexes);
+  ASSERT_EQ(4, loaded.count());
+  ASSERT_EQ(walked.count(), loaded.count());
+  for (int i = 0; i < walked.count(); ++i) {
+    EXPECT_EQ(walked[i].title(), loaded[i].title());
+  }
+}
+
+TEST_F(LibraryModelTest, RestoresFromSnapshot) {
+  QTemporaryDir dir;
+  const QString filename = dir.path() + "/librarytree.dat";
+
+  AddSong("Title", "Artist 1", "Album", 123);
+  AddSong("Title", "Artist 2", "Album", 123);
+  model_->set_snapshot_filename(filename);
+  model_->Init(false);
+  QMetaObject::invokeMethod(model_.get(), "SaveSnapshot");
+  ASSERT_TRUE(QFile::exists(filename));
+
+  // The top level is there straight away, without waiting for a query
+  LibraryModel restored(backend_.get(), nullptr);
+  restored.set_snapshot_filename(filename);
+  restored.ResetAsync();
+  ASSERT_EQ(model_->rowCount(QModelIndex()),
+            restored.rowCount(QModelIndex()));
+  for (int i = 0; i < restored.rowCount(QModelIndex()); ++i) {
+    EXPECT_EQ(model_->index(i, 0, QModelIndex()).data().toString(),
+              restored.index(i, 0, QModelIndex()).data().toString());
+  }
+}
+
 } // namespace
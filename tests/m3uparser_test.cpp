@@ -115,6 +115,29 @@ TEST_F(M3UParserTest, ParsesNonExtendedM3U) {
   EXPECT_TRUE(songs[0].artist().isEmpty());
 }
 
+TEST_F(M3UParserTest, LoadsInChunks) {
+  QByteArray data = "#EXTM3U\r";
+  const int count = M3UParser::kLoadChunkSize + 1;
+  for (int i = 0; i < count; ++i) {
+    data += QString("#EXTINF:1,Artist - Title %1\r\n").arg(i).toUtf8();
+    data += QString("http://foo.com/%1.mp3\r\n").arg(i).toUtf8();
+  }
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::ReadOnly);
+
+  M3UParser parser(nullptr);
+  QList<SongList> chunks;
+  parser.LoadChunked(&buffer,
+                     [&chunks](const SongList& songs) { chunks << songs; });
+  ASSERT_EQ(2, chunks.count());
+  ASSERT_EQ(M3UParser::kLoadChunkSize, chunks[0].count());
+  ASSERT_EQ(1, chunks[1].count());
+  EXPECT_EQ("Title 0", chunks[0][0].title());
+  EXPECT_EQ(QUrl(QString("http://foo.com/%1.mp3").arg(count - 1)),
+            chunks[1][0].url());
+  EXPECT_EQ(QString("Title %1").arg(count - 1), chunks[1][0].title());
+}
+
 TEST_F(M3UParserTest, ParsesActualM3U) {
   QFile file(":testdata/test.m3u");
   file.open(QIODevice::ReadOnly);
@@ -19,6 +19,10 @@
 #include "test_utils.h"
 #include "core/mergedproxymodel.h"
 
+#include <memory>
+#include <vector>
+
+#include <QElapsedTimer>
 #include <QStandardItemModel>
 #include <QSignalSpy>
 
@@ -160,3 +164,52 @@ TEST_F(MergedProxyModelTest, SubRemove) {
   EXPECT_EQ(0, after_spy[0][1].toInt());
   EXPECT_EQ(0, after_spy[0][2].toInt());
 }
+
+TEST_F(MergedProxyModelTest, ManySubModels) {
+  // Like the internet sidebar with lots of services merged in.  This doubles
+  // as a benchmark: the time taken to walk the whole tree is recorded in the
+  // test's XML output.
+  const int kSubModels = 200;
+  const int kRowsEach = 50;
+
+  std::vector<std::unique_ptr<QStandardItemModel>> submodels;
+  for (int i = 0; i < kSubModels; ++i) {
+    source_.appendRow(new QStandardItem(QString("parent %1").arg(i)));
+
+    std::unique_ptr<QStandardItemModel> submodel(new QStandardItemModel);
+    for (int j = 0; j < kRowsEach; ++j) {
+      submodel->appendRow(new QStandardItem(QString("%1/%2").arg(i).arg(j)));
+    }
+    merged_.AddSubModel(source_.index(i, 0, QModelIndex()), submodel.get());
+    submodels.push_back(std::move(submodel));
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  for (int pass = 0; pass < 3; ++pass) {
+    ASSERT_EQ(kSubModels, merged_.rowCount(QModelIndex()));
+    for (int i = 0; i < kSubModels; ++i) {
+      const QModelIndex parent_i = merged_.index(i, 0, QModelIndex());
+      ASSERT_EQ(kRowsEach, merged_.rowCount(parent_i));
+      for (int j = 0; j < kRowsEach; ++j) {
+        const QModelIndex child_i = merged_.index(j, 0, parent_i);
+        ASSERT_EQ(QString("%1/%2").arg(i).arg(j), child_i.data().toString());
+        ASSERT_EQ(parent_i, merged_.parent(child_i));
+      }
+    }
+  }
+  RecordProperty("elapsed_usec", static_cast<int>(timer.nsecsElapsed() / 1000));
+
+  // Removing rows from the source moves the merge points that follow them.
+  source_.removeRows(0, kSubModels / 2, QModelIndex());
+  ASSERT_EQ(kSubModels / 2, merged_.rowCount(QModelIndex()));
+  const QModelIndex first_i = merged_.index(0, 0, QModelIndex());
+  EXPECT_EQ(QString("parent %1").arg(kSubModels / 2), first_i.data().toString());
+  ASSERT_EQ(kRowsEach, merged_.rowCount(first_i));
+  EXPECT_EQ(QString("%1/0").arg(kSubModels / 2),
+            merged_.index(0, 0, first_i).data().toString());
+
+  merged_.RemoveSubModel(source_.index(0, 0, QModelIndex()));
+  EXPECT_EQ(0, merged_.rowCount(merged_.index(0, 0, QModelIndex())));
+  EXPECT_EQ(kRowsEach, merged_.rowCount(merged_.index(1, 0, QModelIndex())));
+}
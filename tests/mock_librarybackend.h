@@ -54,6 +54,7 @@ class MockLibraryBackend : public LibraryBackendInterface {
 
   MOCK_METHOD1(GetSongsByUrl, SongList(const QUrl&));
   MOCK_METHOD2(GetSongByUrl, Song(const QUrl&, qint64));
+  MOCK_METHOD1(GetSongsByUrls, SongList(const QList<QUrl>&));
 
   MOCK_METHOD1(AddDirectory, void(const QString&));
   MOCK_METHOD1(RemoveDirectory, void(const Directory&));
@@ -0,0 +1,134 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "moodbar/moodbarstore.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QUrl>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class MoodbarStoreTest : public ::testing::Test {
+ protected:
+  QString PackFilename() const { return dir_.path() + "/moodbars.pack"; }
+
+  static QUrl Url(const QString& name) {
+    return QUrl::fromLocalFile("/music/" + name + ".mp3");
+  }
+
+  static QByteArray Data(char c, int size = 3000) {
+    return QByteArray(size, c);
+  }
+
+  QTemporaryDir dir_;
+};
+
+TEST_F(MoodbarStoreTest, FindMissing) {
+  MoodbarStore store(PackFilename());
+  EXPECT_TRUE(store.Find(Url("a"), 100).isEmpty());
+  EXPECT_FALSE(store.Contains(Url("a"), 100));
+}
+
+TEST_F(MoodbarStoreTest, InsertAndFind) {
+  MoodbarStore store(PackFilename());
+  store.Insert(Url("a"), 100, Data('a'));
+  store.Insert(Url("b"), 200, Data('b', 1500));
+
+  EXPECT_EQ(Data('a'), store.Find(Url("a"), 100));
+  EXPECT_EQ(Data('b', 1500), store.Find(Url("b"), 200));
+  EXPECT_TRUE(store.Contains(Url("a"), 100));
+}
+
+TEST_F(MoodbarStoreTest, MtimeMustMatch) {
+  MoodbarStore store(PackFilename());
+  store.Insert(Url("a"), 100, Data('a'));
+  EXPECT_TRUE(store.Find(Url("a"), 101).isEmpty());
+
+  // A newer version of the file replaces the old data
+  store.Insert(Url("a"), 101, Data('b'));
+  EXPECT_EQ(Data('b'), store.Find(Url("a"), 101));
+  EXPECT_TRUE(store.Find(Url("a"), 100).isEmpty());
+}
+
+TEST_F(MoodbarStoreTest, Reopen) {
+  {
+    MoodbarStore store(PackFilename());
+    store.Insert(Url("a"), 100, Data('a'));
+    store.Insert(Url("a"), 101, Data('b'));
+  }
+
+  MoodbarStore store(PackFilename());
+  EXPECT_EQ(Data('b'), store.Find(Url("a"), 101));
+  EXPECT_TRUE(store.Find(Url("a"), 100).isEmpty());
+}
+
+TEST_F(MoodbarStoreTest, TruncatedRecordIsDropped) {
+  {
+    MoodbarStore store(PackFilename());
+    store.Insert(Url("a"), 100, Data('a'));
+    store.Insert(Url("b"), 100, Data('b'));
+  }
+
+  QFile file(PackFilename());
+  ASSERT_TRUE(file.resize(file.size() - 10));
+
+  MoodbarStore store(PackFilename());
+  EXPECT_EQ(Data('a'), store.Find(Url("a"), 100));
+  EXPECT_TRUE(store.Find(Url("b"), 100).isEmpty());
+
+  store.Insert(Url("c"), 100, Data('c'));
+  EXPECT_EQ(Data('c'), store.Find(Url("c"), 100));
+}
+
+TEST_F(MoodbarStoreTest, CompactedWhenFull) {
+  // Room for about three records
+  MoodbarStore store(PackFilename(), 10000);
+  store.Insert(Url("a"), 100, Data('a'));
+  store.Insert(Url("b"), 100, Data('b'));
+  store.Insert(Url("a"), 101, Data('c'));
+
+  // The old record for a is thrown away to make room, rather than b
+  store.Insert(Url("d"), 100, Data('d'));
+  EXPECT_EQ(Data('b'), store.Find(Url("b"), 100));
+  EXPECT_EQ(Data('c'), store.Find(Url("a"), 101));
+  EXPECT_EQ(Data('d'), store.Find(Url("d"), 100));
+  EXPECT_FALSE(QFile::exists(PackFilename() + ".new"));
+}
+
+TEST_F(MoodbarStoreTest, EmptiedWhenFull) {
+  MoodbarStore store(PackFilename(), 10000);
+  store.Insert(Url("a"), 100, Data('a'));
+  store.Insert(Url("b"), 100, Data('b'));
+  store.Insert(Url("c"), 100, Data('c'));
+  store.Insert(Url("d"), 100, Data('d'));
+
+  EXPECT_TRUE(store.Find(Url("a"), 100).isEmpty());
+  EXPECT_TRUE(store.Find(Url("b"), 100).isEmpty());
+  EXPECT_EQ(Data('d'), store.Find(Url("d"), 100));
+}
+
+TEST_F(MoodbarStoreTest, Clear) {
+  MoodbarStore store(PackFilename());
+  store.Insert(Url("a"), 100, Data('a'));
+  store.Clear();
+  EXPECT_TRUE(store.Find(Url("a"), 100).isEmpty());
+}
+
+}  // namespace
@@ -22,6 +22,8 @@
 
 #include "library/libraryplaylistitem.h"
 #include "playlist/playlist.h"
+#include "playlist/playlistfilter.h"
+#include "playlist/queue.h"
 #include "mock_settingsprovider.h"
 #include "mock_playlistitem.h"
 
@@ -502,4 +504,172 @@ TEST_F(PlaylistTest, LibraryIdMapMulti) {
 }
 
 
+
+TEST_F(PlaylistTest, UndoShuffle) {
+  PlaylistItemList items;
+  for (int i = 0; i < 20; ++i) {
+    items << MakeMockItemP(QString::number(i));
+  }
+  playlist_.InsertItems(items);
+  playlist_.undo_stack()->clear();
+
+  playlist_.Shuffle();
+  ASSERT_EQ(20, playlist_.rowCount(QModelIndex()));
+  ASSERT_TRUE(playlist_.undo_stack()->canUndo());
+  EXPECT_EQ("shuffle songs", playlist_.undo_stack()->undoText());
+
+  PlaylistItemList shuffled = playlist_.GetAllItems();
+  playlist_.undo_stack()->undo();
+  EXPECT_EQ(items, playlist_.GetAllItems());
+  playlist_.undo_stack()->redo();
+  EXPECT_EQ(shuffled, playlist_.GetAllItems());
+}
+
+TEST_F(PlaylistTest, SortAndUndo) {
+  playlist_.InsertItems(PlaylistItemList()
+      << MakeMockItemP("beta") << MakeMockItemP("Alpha")
+      << MakeMockItemP("gamma"));
+
+  playlist_.sort(Playlist::Column_Title, Qt::AscendingOrder);
+  ASSERT_EQ(3, playlist_.rowCount(QModelIndex()));
+  EXPECT_EQ("Alpha", playlist_.item_at(0)->Metadata().title());
+  EXPECT_EQ("beta", playlist_.item_at(1)->Metadata().title());
+  EXPECT_EQ("gamma", playlist_.item_at(2)->Metadata().title());
+
+  playlist_.sort(Playlist::Column_Title, Qt::DescendingOrder);
+  EXPECT_EQ("gamma", playlist_.item_at(0)->Metadata().title());
+  EXPECT_EQ("Alpha", playlist_.item_at(2)->Metadata().title());
+
+  ASSERT_TRUE(playlist_.undo_stack()->canUndo());
+  EXPECT_EQ("sort songs", playlist_.undo_stack()->undoText());
+  playlist_.undo_stack()->undo();
+  playlist_.undo_stack()->undo();
+  EXPECT_EQ("beta", playlist_.item_at(0)->Metadata().title());
+  EXPECT_EQ("Alpha", playlist_.item_at(1)->Metadata().title());
+  EXPECT_EQ("gamma", playlist_.item_at(2)->Metadata().title());
+
+  playlist_.undo_stack()->redo();
+  EXPECT_EQ("Alpha", playlist_.item_at(0)->Metadata().title());
+}
+
+TEST_F(PlaylistTest, FilterNarrowsAndWidens) {
+  Song one;
+  one.Init("Yellow Submarine", "The Beatles", "Revolver", 123);
+  Song two;
+  two.Init("Yellow", "Coldplay", "Parachutes", 123);
+  Song three;
+  three.Init("Help", "The Beatles", "Help", 123);
+
+  playlist_.InsertItems(PlaylistItemList()
+                        << PlaylistItemPtr(new LibraryPlaylistItem(one))
+                        << PlaylistItemPtr(new LibraryPlaylistItem(two))
+                        << PlaylistItemPtr(new LibraryPlaylistItem(three)));
+
+  QSortFilterProxyModel* proxy = playlist_.proxy();
+  proxy->setFilterFixedString("yel");
+  EXPECT_EQ(2, proxy->rowCount());
+  proxy->setFilterFixedString("yellow sub");
+  EXPECT_EQ(1, proxy->rowCount());
+  proxy->setFilterFixedString("yellow");
+  EXPECT_EQ(2, proxy->rowCount());
+  proxy->setFilterFixedString("beatles");
+  EXPECT_EQ(2, proxy->rowCount());
+  proxy->setFilterFixedString("beatles -help");
+  EXPECT_EQ(1, proxy->rowCount());
+  proxy->setFilterFixedString("");
+  EXPECT_EQ(3, proxy->rowCount());
+}
+
+TEST_F(PlaylistTest, NextAndPreviousFollowFilter) {
+  Song one;
+  one.Init("Yellow Submarine", "The Beatles", "Revolver", 123);
+  Song two;
+  two.Init("Help", "The Beatles", "Help", 123);
+  Song three;
+  three.Init("Yellow", "Coldplay", "Parachutes", 123);
+  Song four;
+  four.Init("Mellow Yellow", "Donovan", "Mellow Yellow", 123);
+
+  playlist_.InsertItems(PlaylistItemList()
+                        << PlaylistItemPtr(new LibraryPlaylistItem(one))
+                        << PlaylistItemPtr(new LibraryPlaylistItem(two))
+                        << PlaylistItemPtr(new LibraryPlaylistItem(three))
+                        << PlaylistItemPtr(new LibraryPlaylistItem(four)));
+  playlist_.set_current_row(0);
+  EXPECT_EQ(1, playlist_.next_row());
+
+  // Rows outside the filter are stepped over
+  playlist_.proxy()->setFilterFixedString("yellow");
+  EXPECT_EQ(2, playlist_.next_row());
+  playlist_.set_current_row(3);
+  EXPECT_EQ(2, playlist_.previous_row());
+  EXPECT_EQ(-1, playlist_.next_row());
+
+  // So are skipped rows
+  playlist_.SkipTracks(QModelIndexList() << playlist_.index(2, 0));
+  EXPECT_EQ(0, playlist_.previous_row());
+
+  // And clearing the filter brings the others back
+  playlist_.proxy()->setFilterFixedString("");
+  EXPECT_EQ(1, playlist_.previous_row());
+}
+
+TEST_F(PlaylistTest, FilterRefinement) {
+  EXPECT_TRUE(PlaylistFilter::IsRefinement("yel", "yellow"));
+  EXPECT_TRUE(PlaylistFilter::IsRefinement("yellow", "yellow sub"));
+  EXPECT_FALSE(PlaylistFilter::IsRefinement("", "yellow"));
+  EXPECT_FALSE(PlaylistFilter::IsRefinement("yellow", "yel"));
+  EXPECT_FALSE(PlaylistFilter::IsRefinement("yellow", "yellow OR help"));
+  EXPECT_FALSE(PlaylistFilter::IsRefinement("yellow AND", "yellow AND sub"));
+  EXPECT_FALSE(PlaylistFilter::IsRefinement("yellow", "yellow -sub"));
+  EXPECT_FALSE(PlaylistFilter::IsRefinement("artist", "artist:beatles"));
+  EXPECT_FALSE(PlaylistFilter::IsRefinement("yellow", "yellow \"sub"));
+}
+
+TEST_F(PlaylistTest, QueueFollowsPlaylistChanges) {
+  playlist_.InsertItems(PlaylistItemList()
+      << MakeMockItemP("One") << MakeMockItemP("Two")
+      << MakeMockItemP("Three") << MakeMockItemP("Four"));
+
+  Queue* queue = playlist_.queue();
+  queue->ToggleTracks(QModelIndexList() << playlist_.index(3, 0)
+                                        << playlist_.index(1, 0));
+  ASSERT_EQ(2, queue->ItemCount());
+  EXPECT_EQ(3, queue->PeekNext());
+  EXPECT_EQ(1, queue->PositionOf(playlist_.index(1, 0)));
+  EXPECT_TRUE(queue->ContainsSourceRow(1));
+  EXPECT_FALSE(queue->ContainsSourceRow(2));
+
+  // Removing a row above the queued tracks moves them up
+  playlist_.removeRows(0, 1);
+  EXPECT_EQ(2, queue->PeekNext());
+  EXPECT_TRUE(queue->ContainsSourceRow(0));
+  EXPECT_FALSE(queue->ContainsSourceRow(3));
+
+  // Toggling a queued track dequeues it
+  queue->ToggleTracks(QModelIndexList() << playlist_.index(2, 0));
+  ASSERT_EQ(1, queue->ItemCount());
+  EXPECT_EQ(0, queue->TakeNext());
+  EXPECT_TRUE(queue->is_empty());
+}
+
+TEST_F(PlaylistTest, RunningTotals) {
+  playlist_.InsertItems(PlaylistItemList()
+      << MakeMockItemP("One", "", "", 100) << MakeMockItemP("Two", "", "", 20)
+      << MakeMockItemP("Three", "", "", 3));
+  EXPECT_EQ(123u, playlist_.GetTotalLength());
+  EXPECT_EQ(120u, playlist_.GetRangeLength(0, 1));
+  EXPECT_EQ(23u, playlist_.GetRangeLength(1, 2));
+  EXPECT_EQ(3u, playlist_.GetRangeLength(2, 5));
+
+  // Sorting changes the ranges but not the total
+  playlist_.sort(Playlist::Column_Title, Qt::AscendingOrder);
+  EXPECT_EQ(123u, playlist_.GetTotalLength());
+  EXPECT_EQ(103u, playlist_.GetRangeLength(0, 1));
+
+  playlist_.removeRows(0, 1);
+  EXPECT_EQ(23u, playlist_.GetTotalLength());
+  EXPECT_EQ(20u, playlist_.GetRangeLength(1, 1));
+}
+
 } // namespace
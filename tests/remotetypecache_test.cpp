@@ -0,0 +1,68 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core/remotetypecache.h"
+
+#include <QTemporaryDir>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(RemoteTypeCacheTest, RemembersTypes) {
+  RemoteTypeCache cache;
+  const QUrl url("http://example.com/stream");
+  EXPECT_EQ(QString(), cache.MimeType(url));
+
+  cache.Record(url, "audio/mpeg");
+  EXPECT_EQ("audio/mpeg", cache.MimeType(url));
+  EXPECT_EQ(QString(), cache.MimeType(QUrl("http://example.com/other")));
+}
+
+TEST(RemoteTypeCacheTest, SavesToDisk) {
+  QTemporaryDir dir;
+  const QString filename = dir.path() + "/remotetypes";
+  const QUrl url("http://example.com/list.pls");
+
+  {
+    RemoteTypeCache cache(filename);
+    cache.Record(url, "audio/x-scpls");
+    cache.Save();
+  }
+
+  RemoteTypeCache cache(filename);
+  EXPECT_EQ("audio/x-scpls", cache.MimeType(url));
+}
+
+TEST(RemoteTypeCacheTest, StaysSmall) {
+  RemoteTypeCache cache;
+  for (int i = 0; i < RemoteTypeCache::kMaxEntries * 2; ++i) {
+    cache.Record(QUrl("http://example.com/" + QString::number(i)),
+                 "audio/mpeg");
+  }
+
+  int count = 0;
+  for (int i = 0; i < RemoteTypeCache::kMaxEntries * 2; ++i) {
+    if (!cache.MimeType(QUrl("http://example.com/" + QString::number(i)))
+             .isEmpty()) {
+      ++count;
+    }
+  }
+  EXPECT_LE(count, RemoteTypeCache::kMaxEntries);
+  EXPECT_GE(count, RemoteTypeCache::kMaxEntries / 2);
+}
+
+}  // namespace
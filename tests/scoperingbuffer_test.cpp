@@ -0,0 +1,101 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "engines/scoperingbuffer.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const quint64 kOneHour = 3600ULL * 1000 * 1000 * 1000;
+
+std::vector<int16_t> Samples(int count, int first) {
+  std::vector<int16_t> ret(count);
+  for (int i = 0; i < count; ++i) ret[i] = first + i;
+  return ret;
+}
+
+TEST(ScopeRingBufferTest, EmptyBuffer) {
+  ScopeRingBuffer buffer(1024);
+  std::vector<int16_t> dest(16);
+  int pipeline_id = 0;
+  EXPECT_FALSE(buffer.ReadLatest(dest.data(), dest.size(), &pipeline_id));
+}
+
+TEST(ScopeRingBufferTest, ReadsStartOfLatestBuffer) {
+  ScopeRingBuffer buffer(1024);
+  const std::vector<int16_t> first = Samples(100, 0);
+  const std::vector<int16_t> second = Samples(100, 1000);
+
+  // Buffers that take an hour to play haven't got anywhere yet.
+  buffer.Write(first.data(), first.size(), kOneHour, 1);
+  buffer.Write(second.data(), second.size(), kOneHour, 2);
+
+  std::vector<int16_t> dest(50);
+  int pipeline_id = 0;
+  ASSERT_TRUE(buffer.ReadLatest(dest.data(), dest.size(), &pipeline_id));
+  EXPECT_EQ(2, pipeline_id);
+  EXPECT_EQ(std::vector<int16_t>(second.begin(), second.begin() + 50), dest);
+}
+
+TEST(ScopeRingBufferTest, FollowsPlayback) {
+  ScopeRingBuffer buffer(1024);
+  const std::vector<int16_t> samples = Samples(100, 0);
+
+  // Without a duration the window stays at the start of the buffer.
+  buffer.Write(samples.data(), samples.size(), 0, 1);
+
+  std::vector<int16_t> dest(30);
+  int pipeline_id = 0;
+  ASSERT_TRUE(buffer.ReadLatest(dest.data(), dest.size(), &pipeline_id));
+  EXPECT_EQ(std::vector<int16_t>(samples.begin(), samples.begin() + 30), dest);
+
+  // This one has finished playing, so the window is at the end.
+  buffer.Write(samples.data(), samples.size(), 1, 1);
+  ASSERT_TRUE(buffer.ReadLatest(dest.data(), dest.size(), &pipeline_id));
+  EXPECT_EQ(std::vector<int16_t>(samples.end() - 30, samples.end()), dest);
+}
+
+TEST(ScopeRingBufferTest, WrapsAround) {
+  ScopeRingBuffer buffer(256);
+  for (int i = 0; i < 8; ++i) {
+    const std::vector<int16_t> samples = Samples(100, i * 100);
+    buffer.Write(samples.data(), samples.size(), kOneHour, 1);
+  }
+
+  // The window can't go past the last sample, so it starts in the buffer
+  // before and runs across the end of the ring.
+  std::vector<int16_t> dest(150);
+  int pipeline_id = 0;
+  ASSERT_TRUE(buffer.ReadLatest(dest.data(), dest.size(), &pipeline_id));
+  EXPECT_EQ(Samples(150, 650), dest);
+}
+
+TEST(ScopeRingBufferTest, KeepsEndOfHugeBuffer) {
+  ScopeRingBuffer buffer(256);
+  const std::vector<int16_t> samples = Samples(1000, 0);
+  buffer.Write(samples.data(), samples.size(), 1, 1);
+
+  std::vector<int16_t> dest(256);
+  int pipeline_id = 0;
+  ASSERT_TRUE(buffer.ReadLatest(dest.data(), dest.size(), &pipeline_id));
+  EXPECT_EQ(Samples(256, 744), dest);
+}
+
+}  // namespace
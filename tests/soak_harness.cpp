@@ -0,0 +1,249 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Runs the library's workloads against one database at the same time, the
+// way a busy Clementine does, and prints latency percentiles for each
+// operation as one JSON object per line.
+//
+// Library scans write batches of changed songs, the library view resets its
+// model, global searches run FTS queries and remote clients download the
+// whole library.  A probe also measures how long it waits for the database's
+// write lock.  CLEMENTINE_SOAK_SECONDS sets how long it runs for (default 60)
+// and CLEMENTINE_BENCHMARK_SONGS the size of the library.
+//
+// Every thread's connection to a :memory: database is a different database,
+// so this uses an on-disk one in Qt's test-mode config directory.
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+
+#include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QMutex>
+#include <QStandardPaths>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrentRun>
+
+#include "synthetic_library.h"
+#include "core/database.h"
+#include "core/logging.h"
+#include "core/utilities.h"
+#include "library/directory.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "library/librarymodel.h"
+#include "library/libraryquery.h"
+
+namespace {
+
+const int kScanBatchSize = 200;
+const int kLockProbeIntervalMsec = 5;
+
+class LatencyLog {
+ public:
+  explicit LatencyLog(const QString& operation) : operation_(operation) {}
+
+  void Add(qint64 nsec) {
+    QMutexLocker l(&mutex_);
+    samples_ << nsec;
+  }
+
+  // Records how long timer has been running.
+  void Add(const QElapsedTimer& timer) { Add(timer.nsecsElapsed()); }
+
+  QString Summary() {
+    QMutexLocker l(&mutex_);
+    std::sort(samples_.begin(), samples_.end());
+    return QString(
+               "{\"operation\": \"%1\", \"count\": %2, \"p50_ms\": %3, "
+               "\"p90_ms\": %4, \"p99_ms\": %5, \"max_ms\": %6}")
+        .arg(operation_)
+        .arg(samples_.count())
+        .arg(Percentile(0.5))
+        .arg(Percentile(0.9))
+        .arg(Percentile(0.99))
+        .arg(Percentile(1.0));
+  }
+
+ private:
+  double Percentile(double p) const {
+    if (samples_.isEmpty()) return 0;
+    const int i = qMin(samples_.count() - 1,
+                       static_cast<int>(p * samples_.count()));
+    return samples_[i] / 1e6;
+  }
+
+  const QString operation_;
+  QMutex mutex_;
+  QVector<qint64> samples_;
+};
+
+struct Soak {
+  std::shared_ptr<Database> database;
+  std::shared_ptr<LibraryBackend> backend;
+  int song_count;
+
+  QElapsedTimer clock;
+  qint64 duration_msec;
+
+  bool running() const { return clock.elapsed() < duration_msec; }
+};
+
+// A library scan that finds a batch of changed files.
+void ScanWorkload(Soak* soak, LatencyLog* log) {
+  int iteration = 0;
+  while (soak->running()) {
+    QList<int> ids;
+    const int first = qrand() % soak->song_count + 1;
+    for (int i = 0; i < kScanBatchSize; ++i) {
+      ids << (first + i) % soak->song_count + 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    SongList songs = soak->backend->GetSongsById(ids);
+    for (Song& song : songs) song.set_mtime(++iteration);
+    soak->backend->AddOrUpdateSongs(songs);
+    log->Add(timer);
+  }
+}
+
+// Typing into the global search box.
+void SearchWorkload(Soak* soak, LatencyLog* log) {
+  const QStringList kPrefixes = QStringList() << "artist"
+                                              << "title"
+                                              << "album"
+                                              << "rock"
+                                              << "compilation";
+  while (soak->running()) {
+    QueryOptions options;
+    options.set_filter(QString("%1 %2")
+                           .arg(kPrefixes[qrand() % kPrefixes.count()])
+                           .arg(qrand() % 100));
+    LibraryQuery query(options);
+
+    QElapsedTimer timer;
+    timer.start();
+    soak->backend->ExecLibraryQuery(&query);
+    log->Add(timer);
+  }
+}
+
+// A network remote client downloading the library.
+void RemoteWorkload(Soak* soak, LatencyLog* log) {
+  while (soak->running()) {
+    QElapsedTimer timer;
+    timer.start();
+    soak->backend->GetAllSongs([soak](const SongList&) {
+      return soak->running();
+    });
+    log->Add(timer);
+  }
+}
+
+// How long a writer has to wait for the database.
+void LockProbeWorkload(Soak* soak, LatencyLog* log) {
+  while (soak->running()) {
+    QElapsedTimer timer;
+    timer.start();
+    soak->database->Mutex()->lock();
+    log->Add(timer);
+    soak->database->Mutex()->unlock();
+    QThread::msleep(kLockProbeIntervalMsec);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (qgetenv("QT_QPA_PLATFORM").isEmpty()) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QApplication a(argc, argv);
+  QCoreApplication::setOrganizationName("ClementineSoak");
+  QStandardPaths::setTestModeEnabled(true);
+
+  Q_INIT_RESOURCE(data);
+  logging::Init();
+  logging::SetLevels("*:1");
+
+  qRegisterMetaType<Directory>("Directory");
+  qRegisterMetaType<DirectoryList>("DirectoryList");
+  qRegisterMetaType<Subdirectory>("Subdirectory");
+  qRegisterMetaType<SubdirectoryList>("SubdirectoryList");
+  qRegisterMetaType<SongList>("SongList");
+
+  // Start from an empty database every time.
+  QDir(Utilities::GetConfigPath(Utilities::Path_Root)).removeRecursively();
+
+  Soak soak;
+  soak.database.reset(new Database(nullptr));
+  soak.backend.reset(new LibraryBackend);
+  soak.backend->Init(soak.database, Library::kSongsTable, Library::kDirsTable,
+                     Library::kSubdirsTable, Library::kFtsTable);
+  soak.backend->AddDirectory("/synthetic");
+
+  const SongList songs = SyntheticLibrary(SyntheticLibrarySize());
+  soak.song_count = songs.count();
+  soak.backend->AddOrUpdateSongs(songs);
+
+  LibraryModel model(soak.backend, nullptr);
+  model.Init(false);
+
+  LatencyLog scan_log("library_scan");
+  LatencyLog search_log("global_search");
+  LatencyLog remote_log("remote_library");
+  LatencyLog lock_log("write_lock_wait");
+  LatencyLog reset_log("library_model_reset");
+
+  bool ok = false;
+  const int seconds = qgetenv("CLEMENTINE_SOAK_SECONDS").toInt(&ok);
+  soak.duration_msec = (ok && seconds > 0 ? seconds : 60) * 1000;
+  soak.clock.start();
+
+  QThreadPool::globalInstance()->setMaxThreadCount(
+      qMax(QThreadPool::globalInstance()->maxThreadCount(), 5));
+  QList<QFuture<void>> workloads;
+  workloads << QtConcurrent::run(&ScanWorkload, &soak, &scan_log);
+  workloads << QtConcurrent::run(&SearchWorkload, &soak, &search_log);
+  workloads << QtConcurrent::run(&SearchWorkload, &soak, &search_log);
+  workloads << QtConcurrent::run(&RemoteWorkload, &soak, &remote_log);
+  workloads << QtConcurrent::run(&LockProbeWorkload, &soak, &lock_log);
+
+  // The model lives in the GUI thread, which also has to handle the songs
+  // the scans send it.
+  while (soak.running()) {
+    QElapsedTimer timer;
+    timer.start();
+    model.Reset();
+    reset_log.Add(timer);
+    QCoreApplication::processEvents();
+  }
+
+  for (QFuture<void>& future : workloads) future.waitForFinished();
+
+  for (LatencyLog* log : QList<LatencyLog*>() << &scan_log << &search_log
+                                              << &remote_log << &reset_log
+                                              << &lock_log) {
+    printf("%s\n", log->Summary().toUtf8().constData());
+  }
+  return 0;
+}
@@ -18,6 +18,7 @@
 #include "config.h"
 #include "tagreader.h"
 #include "core/song.h"
+#include "core/timeconstants.h"
 #ifdef HAVE_LIBLASTFM
 #include "internet/lastfm/lastfmcompat.h"
 #endif
@@ -27,12 +28,18 @@
 
 #include "test_utils.h"
 
+#include <iostream>
+
 #include <QStringList>
 #include <QTemporaryFile>
 #include <QTextCodec>
 
 #include <id3v2tag.h>
 
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
 namespace {
 
 class SongTest : public ::testing::Test {
@@ -423,4 +430,83 @@ TEST_F(SongTest, MergeUserSetDataTest) {
   EXPECT_EQ(song_file_with_no_rating.rating(), song_db_with_rating.rating());
 }
 
+TEST_F(SongTest, InternsRepeatedFields) {
+  ::pb::tagreader::SongMetadata pb_song;
+  Song().ToProtobuf(&pb_song);
+  pb_song.set_artist("Some artist");
+  pb_song.set_album("Some album");
+  pb_song.set_genre("Some genre");
+
+  pb_song.set_title("One");
+  Song one;
+  one.InitFromProtobuf(pb_song);
+  pb_song.set_title("Two");
+  Song two;
+  two.InitFromProtobuf(pb_song);
+
+  EXPECT_EQ("Some artist", two.artist());
+  EXPECT_EQ(one.artist().constData(), two.artist().constData());
+  EXPECT_EQ(one.album().constData(), two.album().constData());
+  EXPECT_EQ(one.genre().constData(), two.genre().constData());
+  EXPECT_NE(one.title().constData(), two.title().constData());
+}
+
+TEST_F(SongTest, DuplicateKey) {
+  Song song;
+  song.Init("Title", "Artist", "Album", 180 * kNsecPerSec);
+
+  Song same;
+  same.Init(" title", "ARTIST", "Album ",
+            180 * kNsecPerSec + 200 * kNsecPerMsec);
+  EXPECT_NE(0, song.DuplicateKey());
+  EXPECT_EQ(song.DuplicateKey(), same.DuplicateKey());
+
+  Song longer;
+  longer.Init("Title", "Artist", "Album", 200 * kNsecPerSec);
+  EXPECT_NE(song.DuplicateKey(), longer.DuplicateKey());
+
+  Song other_album;
+  other_album.Init("Title", "Artist", "Other", 180 * kNsecPerSec);
+  EXPECT_NE(song.DuplicateKey(), other_album.DuplicateKey());
+
+  Song untagged;
+  untagged.Init("", "", "", 180 * kNsecPerSec);
+  EXPECT_EQ(0, untagged.DuplicateKey());
+}
+
+#ifdef __GLIBC__
+TEST_F(SongTest, MemoryPerSong) {
+  // Roughly the shape of a real library: lots of tracks per album, lots of
+  // albums per artist.
+  const int kSongs = 20000;
+  ::pb::tagreader::SongMetadata pb_song;
+  Song().ToProtobuf(&pb_song);
+
+  SongList songs;
+  songs.reserve(kSongs);
+  const int before = mallinfo().uordblks;
+  for (int i = 0; i < kSongs; ++i) {
+    pb_song.set_title(QString("Title %1").arg(i).toStdString());
+    pb_song.set_album(QString("Album %1").arg(i / 12).toStdString());
+    pb_song.set_artist(QString("Artist %1").arg(i / 120).toStdString());
+    pb_song.set_albumartist(pb_song.artist());
+    pb_song.set_genre(QString("Genre %1").arg(i % 20).toStdString());
+    pb_song.set_url(QString("file:///music/%1.mp3").arg(i).toStdString());
+
+    Song song;
+    song.InitFromProtobuf(pb_song);
+    songs << song;
+  }
+  const int bytes_per_song = (mallinfo().uordblks - before) / kSongs;
+
+  RecordProperty("BytesPerSong", bytes_per_song);
+  std::cout << "Heap bytes per song: " << bytes_per_song << std::endl;
+
+  // Each song should only pay for its title and URL, not for its own copies
+  // of the album, artist and genre.
+  EXPECT_EQ(songs[0].artist().constData(),
+            songs[kSongs / 1000].artist().constData());
+}
+#endif  // __GLIBC__
+
 }  // namespace
@@ -0,0 +1,93 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "synthetic_library.h"
+
+#include <QStringList>
+#include <QUrl>
+
+#include "core/timeconstants.h"
+
+namespace {
+
+const int kTracksPerAlbum = 10;
+const int kAlbumsPerArtist = 4;
+// Every this many albums is a compilation with a different artist per track.
+const int kCompilationEvery = 25;
+
+const char* kGenres[] = {"Rock", "Pop", "Jazz", "Classical", "Electronic",
+                         "Hip-Hop", "Folk", "Metal", "Blues", "Reggae"};
+
+}  // namespace
+
+SongList SyntheticLibrary(int count, int directory_id) {
+  SongList ret;
+  ret.reserve(count);
+
+  for (int i = 0; i < count; ++i) {
+    const int album_id = i / kTracksPerAlbum;
+    const int artist_id = album_id / kAlbumsPerArtist;
+    const bool compilation = album_id % kCompilationEvery == 0;
+    const int track = i % kTracksPerAlbum + 1;
+
+    const QString artist = compilation
+                               ? QString("Compilation Artist %1").arg(i)
+                               : QString("Artist %1").arg(artist_id);
+    const QString album = QString("Album %1").arg(album_id);
+
+    Song song;
+    song.Init(QString("Title %1").arg(i), artist, album,
+              (120 + i % 240) * kNsecPerSec);
+    song.set_directory_id(directory_id);
+    song.set_url(QUrl::fromLocalFile(
+        QString("/synthetic/%1/%2/%3.mp3").arg(artist_id).arg(album_id).arg(
+            track)));
+    song.set_track(track);
+    song.set_disc(1);
+    song.set_year(1960 + album_id % 60);
+    song.set_genre(kGenres[artist_id % (sizeof(kGenres) / sizeof(*kGenres))]);
+    song.set_filetype(Song::Type_Mpeg);
+    song.set_bitrate(320);
+    song.set_samplerate(44100);
+    song.set_filesize(8 * 1024 * 1024);
+    song.set_mtime(1);
+    song.set_ctime(1);
+    if (compilation) {
+      song.set_albumartist("Various Artists");
+      song.set_compilation(true);
+    }
+    ret << song;
+  }
+  return ret;
+}
+
+int SyntheticLibrarySize(int default_count) {
+  bool ok = false;
+  const int count = qgetenv("CLEMENTINE_BENCHMARK_SONGS").toInt(&ok);
+  return ok && count > 0 ? count : default_count;
+}
+
+QByteArray SyntheticM3U(const SongList& songs) {
+  QStringList lines;
+  lines << "#EXTM3U";
+  for (const Song& song : songs) {
+    lines << QString("#EXTINF:%1,%2 - %3")
+                 .arg(song.length_nanosec() / kNsecPerSec)
+                 .arg(song.artist(), song.title());
+    lines << song.url().toLocalFile();
+  }
+  return lines.join("\n").toUtf8() + "\n";
+}
@@ -0,0 +1,37 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SYNTHETIC_LIBRARY_H
+#define SYNTHETIC_LIBRARY_H
+
+#include <QByteArray>
+
+#include "core/song.h"
+
+// Generates a library of count songs that looks like a real one: ten tracks
+// to an album, a few albums per artist, a handful of compilations and a spread
+// of genres and years.  The same count always gives the same songs.  Each song
+// is under /synthetic/ in directory directory_id.
+SongList SyntheticLibrary(int count, int directory_id = 1);
+
+// Returns the total number of songs benchmarks should use, from the
+// CLEMENTINE_BENCHMARK_SONGS environment variable or default_count.
+int SyntheticLibrarySize(int default_count = 10000);
+
+// An extended M3U playlist of the given songs.
+QByteArray SyntheticM3U(const SongList& songs);
+
+#endif  // SYNTHETIC_LIBRARY_H
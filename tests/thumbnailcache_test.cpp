@@ -0,0 +1,115 @@
+/* This file is part of Clementine.
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "covers/thumbnailcache.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class ThumbnailCacheTest : public ::testing::Test {
+ protected:
+  QString PackFilename() const { return dir_.path() + "/thumbnails.pack"; }
+
+  static QByteArray Key(char c) {
+    return QByteArray(ThumbnailCache::kKeySize, c);
+  }
+
+  static QImage Image(int width, int height, QRgb colour) {
+    QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+    image.fill(colour);
+    return image;
+  }
+
+  QTemporaryDir dir_;
+};
+
+TEST_F(ThumbnailCacheTest, FindMissing) {
+  ThumbnailCache cache(PackFilename());
+  EXPECT_TRUE(cache.Find(Key('a')).isNull());
+}
+
+TEST_F(ThumbnailCacheTest, InsertAndFind) {
+  ThumbnailCache cache(PackFilename());
+  cache.Insert(Key('a'), Image(32, 30, qRgb(255, 0, 0)));
+  cache.Insert(Key('b'), Image(16, 16, qRgb(0, 255, 0)));
+
+  QImage a = cache.Find(Key('a'));
+  ASSERT_FALSE(a.isNull());
+  EXPECT_EQ(QSize(32, 30), a.size());
+  EXPECT_EQ(qRgb(255, 0, 0), a.pixel(31, 29));
+
+  QImage b = cache.Find(Key('b'));
+  ASSERT_FALSE(b.isNull());
+  EXPECT_EQ(QSize(16, 16), b.size());
+  EXPECT_EQ(qRgb(0, 255, 0), b.pixel(0, 0));
+}
+
+TEST_F(ThumbnailCacheTest, Reopen) {
+  {
+    ThumbnailCache cache(PackFilename());
+    cache.Insert(Key('a'), Image(32, 32, qRgb(0, 0, 255)));
+  }
+
+  ThumbnailCache cache(PackFilename());
+  QImage a = cache.Find(Key('a'));
+  ASSERT_FALSE(a.isNull());
+  EXPECT_EQ(qRgb(0, 0, 255), a.pixel(10, 10));
+}
+
+TEST_F(ThumbnailCacheTest, TruncatedRecordIsDropped) {
+  {
+    ThumbnailCache cache(PackFilename());
+    cache.Insert(Key('a'), Image(32, 32, qRgb(0, 0, 255)));
+    cache.Insert(Key('b'), Image(32, 32, qRgb(0, 255, 0)));
+  }
+
+  QFile file(PackFilename());
+  ASSERT_TRUE(file.resize(file.size() - 10));
+
+  ThumbnailCache cache(PackFilename());
+  EXPECT_FALSE(cache.Find(Key('a')).isNull());
+  EXPECT_TRUE(cache.Find(Key('b')).isNull());
+
+  // The space it took up is reused
+  cache.Insert(Key('c'), Image(32, 32, qRgb(255, 0, 0)));
+  EXPECT_EQ(qRgb(255, 0, 0), cache.Find(Key('c')).pixel(0, 0));
+}
+
+TEST_F(ThumbnailCacheTest, EmptiedWhenFull) {
+  // Room for about two 32x32 thumbnails
+  ThumbnailCache cache(PackFilename(), 10000);
+  cache.Insert(Key('a'), Image(32, 32, qRgb(255, 0, 0)));
+  cache.Insert(Key('b'), Image(32, 32, qRgb(0, 255, 0)));
+  cache.Insert(Key('c'), Image(32, 32, qRgb(0, 0, 255)));
+
+  EXPECT_TRUE(cache.Find(Key('a')).isNull());
+  EXPECT_TRUE(cache.Find(Key('b')).isNull());
+  EXPECT_FALSE(cache.Find(Key('c')).isNull());
+}
+
+TEST_F(ThumbnailCacheTest, Clear) {
+  ThumbnailCache cache(PackFilename());
+  cache.Insert(Key('a'), Image(32, 32, qRgb(255, 0, 0)));
+  cache.Clear();
+  EXPECT_TRUE(cache.Find(Key('a')).isNull());
+}
+
+}  // namespace